@@ -0,0 +1,518 @@
+/**
+ * @file servers.cpp
+ * @brief End-to-end latency benchmark of the Flight and REST servers.
+ *
+ * Drives a mix of reads and updates from many concurrent clients through the
+ * `ustore_flight_client` and plain HTTP/1.1 keep-alive connections, either to
+ * servers it starts itself, or to already running ones.
+ *
+ * Unlike the other benchmarks, the load is open-loop: every client sends requests
+ * on a fixed schedule, derived from the target arrival rate, regardless of how long
+ * the previous ones took. Latencies are measured from the moment a request was
+ * scheduled to be sent, rather than from when it actually was. So a stalled server
+ * is charged for all the requests that queued up behind the stall, and the tail
+ * percentiles aren't hidden by the "coordinated omission" of closed-loop clients.
+ */
+
+#include <arpa/inet.h>   // `inet_pton`
+#include <netinet/in.h>  // `sockaddr_in`
+#include <netinet/tcp.h> // `TCP_NODELAY`
+#include <signal.h>      // `kill`
+#include <spawn.h>       // `posix_spawn`
+#include <sys/socket.h>  // `socket`, `connect`
+#include <sys/wait.h>    // `waitpid`
+#include <unistd.h>      // `close`
+
+#include <algorithm>   // `std::transform`
+#include <atomic>      // `std::atomic`
+#include <cctype>      // `std::tolower`
+#include <chrono>      // `std::chrono::steady_clock`
+#include <memory>      // `std::unique_ptr`
+#include <numeric>     // `std::iota`
+#include <random>      // `std::mt19937_64`
+#include <sstream>     // `std::istringstream`
+#include <string_view> //
+#include <thread>      //
+#include <vector>      //
+
+#include <benchmark/benchmark.h>
+#include <fmt/format.h>
+#include <argparse/argparse.hpp>
+
+#include <ustore/ustore.hpp>
+#include <workload.hpp> // `keys_generator_t`, `latency_histogram_t`
+
+namespace bm = benchmark;
+using namespace unum::ustore;
+using steady_clock_t = std::chrono::steady_clock;
+
+extern char** environ;
+
+struct settings_t {
+    std::string flight_url;
+    std::string http_address;
+    std::string flight_server;
+    std::string rest_server;
+    std::string distribution;
+    std::size_t threads_count;
+    std::size_t keys_count;
+    std::size_t value_size;
+    std::size_t batch_size;
+    std::size_t duration;
+    double reads_share;
+    std::vector<std::int64_t> rates;
+};
+
+enum class transport_t {
+    flight_k,
+    http_k,
+};
+
+static settings_t settings;
+static database_t db;
+static std::string value_bytes;
+static std::string http_host;
+static std::uint16_t http_port = 0;
+static std::vector<pid_t> spawned_servers;
+
+void parse_args(int argc, char* argv[], settings_t& settings) {
+    argparse::ArgumentParser program(argv[0]);
+    program.add_argument("-f", "--flight").default_value(std::string("")).help("Flight server URL");
+    program.add_argument("-w", "--http").default_value(std::string("")).help("REST server address, like host:port");
+    program.add_argument("-fs", "--flight_server").default_value(std::string("")).help("Flight server to start");
+    program.add_argument("-rs", "--rest_server").default_value(std::string("")).help("REST server to start");
+    program.add_argument("-d", "--distribution").default_value(std::string("zipfian")).help("uniform or zipfian");
+    program.add_argument("-t", "--threads").default_value(std::string("16")).help("Concurrent clients count");
+    program.add_argument("-k", "--keys").default_value(std::string("100000")).help("Keys count");
+    program.add_argument("-v", "--value_size").default_value(std::string("100")).help("Value size in bytes");
+    program.add_argument("-b", "--batch").default_value(std::string("1")).help("Keys per Flight request");
+    program.add_argument("-n", "--duration").default_value(std::string("10")).help("Seconds per arrival rate");
+    program.add_argument("-r", "--reads").default_value(std::string("0.9")).help("Share of reads in the mix");
+    program.add_argument("-a", "--rates").default_value(std::string("1000,10000,50000")).help("Requests per second");
+
+    program.parse_known_args(argc, argv);
+
+    settings.flight_url = program.get("flight");
+    settings.http_address = program.get("http");
+    settings.flight_server = program.get("flight_server");
+    settings.rest_server = program.get("rest_server");
+    settings.distribution = program.get("distribution");
+    settings.threads_count = std::stoul(program.get("threads"));
+    settings.keys_count = std::stoul(program.get("keys"));
+    settings.value_size = std::stoul(program.get("value_size"));
+    settings.batch_size = std::stoul(program.get("batch"));
+    settings.duration = std::stoul(program.get("duration"));
+    settings.reads_share = std::stod(program.get("reads"));
+
+    std::istringstream rates(program.get("rates"));
+    for (std::string rate; std::getline(rates, rate, ',');)
+        if (!rate.empty())
+            settings.rates.push_back(std::stol(rate));
+
+    if (!settings.threads_count || !settings.keys_count || !settings.batch_size || !settings.duration) {
+        fmt::print("Zero threads, keys, batch size or duration specified\n");
+        exit(1);
+    }
+    if (settings.rates.empty() || std::any_of(settings.rates.begin(), settings.rates.end(), [](auto rate) {
+            return rate <= 0;
+        })) {
+        fmt::print("Arrival rates must be positive\n");
+        exit(1);
+    }
+    if (settings.distribution != "uniform" && settings.distribution != "zipfian") {
+        fmt::print("Unknown keys distribution: {}\n", settings.distribution);
+        exit(1);
+    }
+}
+
+#pragma region - Networking
+
+int connect_to(std::string const& host, std::uint16_t port) noexcept {
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1)
+        return -1;
+
+    int handle = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (handle < 0)
+        return -1;
+    if (::connect(handle, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        ::close(handle);
+        return -1;
+    }
+    int no_delay = 1;
+    ::setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+    return handle;
+}
+
+/**
+ * @brief Polls the @p port, until the server starts accepting connections.
+ */
+bool wait_for_port(std::string const& host, std::uint16_t port) noexcept {
+    for (std::size_t attempt = 0; attempt != 100; ++attempt) {
+        int handle = connect_to(host, port);
+        if (handle >= 0) {
+            ::close(handle);
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    return false;
+}
+
+void spawn_server(std::vector<std::string> args) {
+    std::vector<char*> argv;
+    for (auto& arg : args)
+        argv.push_back(arg.data());
+    argv.push_back(nullptr);
+
+    pid_t pid = 0;
+    if (posix_spawn(&pid, argv[0], nullptr, nullptr, argv.data(), environ) != 0)
+        throw std::runtime_error(fmt::format("Can't start {}", args.front()));
+    spawned_servers.push_back(pid);
+}
+
+void stop_servers() noexcept {
+    for (pid_t pid : spawned_servers) {
+        ::kill(pid, SIGTERM);
+        ::waitpid(pid, nullptr, 0);
+    }
+    spawned_servers.clear();
+}
+
+/**
+ * @brief Minimal blocking HTTP/1.1 client, reusing a single keep-alive connection.
+ * Only supports responses with a `Content-Length`, which is all the REST server sends.
+ */
+class http_connection_t {
+    int socket_ = -1;
+    std::string request_;
+    std::string response_;
+
+    bool receive_more() {
+        char chunk[4096];
+        auto received = ::recv(socket_, chunk, sizeof(chunk), 0);
+        if (received <= 0)
+            return false;
+        response_.append(chunk, static_cast<std::size_t>(received));
+        return true;
+    }
+
+  public:
+    http_connection_t() = default;
+    http_connection_t(http_connection_t const&) = delete;
+    ~http_connection_t() noexcept {
+        if (socket_ >= 0)
+            ::close(socket_);
+    }
+
+    bool connect(std::string const& host, std::uint16_t port) noexcept {
+        socket_ = connect_to(host, port);
+        return socket_ >= 0;
+    }
+
+    /**
+     * @brief Sends a request and waits for the whole response.
+     * @return The HTTP status code, or zero, if the connection broke.
+     */
+    int request(char const* method, std::string_view target, std::string_view body) {
+        request_.clear();
+        fmt::format_to(std::back_inserter(request_),
+                       "{} {} HTTP/1.1\r\nHost: {}\r\nContent-Type: application/octet-stream\r\n"
+                       "Content-Length: {}\r\n\r\n",
+                       method,
+                       target,
+                       http_host,
+                       body.size());
+        request_.append(body);
+        for (std::size_t sent = 0; sent < request_.size();) {
+            auto result = ::send(socket_, request_.data() + sent, request_.size() - sent, MSG_NOSIGNAL);
+            if (result <= 0)
+                return 0;
+            sent += static_cast<std::size_t>(result);
+        }
+
+        std::size_t headers_end = std::string::npos;
+        while ((headers_end = response_.find("\r\n\r\n")) == std::string::npos)
+            if (!receive_more())
+                return 0;
+
+        // Header names are case-insensitive
+        std::string headers = response_.substr(0, headers_end);
+        std::transform(headers.begin(), headers.end(), headers.begin(), [](char c) { return std::tolower(c); });
+        std::size_t content_length = 0;
+        if (auto field = headers.find("content-length:"); field != std::string::npos)
+            content_length = std::stoul(headers.substr(field + 15));
+
+        std::size_t const response_size = headers_end + 4 + content_length;
+        while (response_.size() < response_size)
+            if (!receive_more())
+                return 0;
+
+        int status_code = headers.size() > 12 ? std::atoi(headers.c_str() + 9) : 0;
+        response_.erase(0, response_size);
+        return status_code;
+    }
+};
+
+#pragma endregion - Networking
+
+#pragma region - Clients
+
+/**
+ * @brief Chooses the keys and the kind of every request, and sends it over one of the transports.
+ * @return True, if the request succeeded.
+ */
+class client_t {
+    transport_t transport_;
+    std::mt19937_64 generator_;
+    keys_generator_t keys_;
+    std::bernoulli_distribution reads_;
+    std::vector<ustore_key_t> batch_keys_;
+
+    status_t status_;
+    arena_t arena_;
+    http_connection_t http_;
+    std::string target_;
+
+    bool flight(bool is_read) {
+        if (is_read) {
+            ustore_length_t* found_lengths = nullptr;
+            ustore_read_t read {};
+            read.db = db;
+            read.error = status_.member_ptr();
+            read.arena = arena_.member_ptr();
+            read.tasks_count = batch_keys_.size();
+            read.keys = batch_keys_.data();
+            read.keys_stride = sizeof(ustore_key_t);
+            read.lengths = &found_lengths;
+            ustore_read(&read);
+        }
+        else {
+            auto value = reinterpret_cast<ustore_bytes_cptr_t>(value_bytes.data());
+            auto length = static_cast<ustore_length_t>(value_bytes.size());
+            ustore_write_t write {};
+            write.db = db;
+            write.error = status_.member_ptr();
+            write.arena = arena_.member_ptr();
+            write.tasks_count = batch_keys_.size();
+            write.keys = batch_keys_.data();
+            write.keys_stride = sizeof(ustore_key_t);
+            write.lengths = &length;
+            write.values = &value;
+            ustore_write(&write);
+        }
+        if (status_)
+            return true;
+        status_.release_exception();
+        return false;
+    }
+
+    bool http(bool is_read) {
+        target_.clear();
+        fmt::format_to(std::back_inserter(target_), "/one/{}", batch_keys_.front());
+        int status_code = is_read ? http_.request("GET", target_, {}) : http_.request("PUT", target_, value_bytes);
+        return status_code == 200;
+    }
+
+  public:
+    client_t(transport_t transport, std::size_t seed)
+        : transport_(transport), generator_(seed),
+          keys_(settings.distribution == "uniform" ? key_distribution_t::uniform_k : key_distribution_t::zipfian_k,
+                settings.keys_count),
+          reads_(settings.reads_share), batch_keys_(transport == transport_t::http_k ? 1 : settings.batch_size),
+          arena_(db) {
+        if (transport_ == transport_t::http_k && !http_.connect(http_host, http_port))
+            throw std::runtime_error("Can't connect to the REST server");
+    }
+
+    bool send_random() {
+        for (auto& key : batch_keys_)
+            key = keys_(generator_);
+        bool is_read = reads_(generator_);
+        return transport_ == transport_t::flight_k ? flight(is_read) : http(is_read);
+    }
+
+    bool send_update(ustore_key_t first_key, std::size_t count) {
+        batch_keys_.resize(count);
+        std::iota(batch_keys_.begin(), batch_keys_.end(), first_key);
+        return transport_ == transport_t::flight_k ? flight(false) : http(false);
+    }
+};
+
+/**
+ * @brief Makes sure all the keys are present before reading them, splitting them between threads.
+ * Over HTTP, every key is uploaded separately.
+ */
+void load_keys(transport_t transport) {
+    std::atomic<std::size_t> next_key = 0;
+    std::atomic<std::size_t> failures = 0;
+    std::size_t const step = transport == transport_t::http_k ? 1 : 1024;
+    std::vector<std::thread> threads;
+    for (std::size_t idx = 0; idx != settings.threads_count; ++idx)
+        threads.emplace_back([&, idx] {
+            client_t client(transport, idx + 1);
+            for (std::size_t first = next_key.fetch_add(step); first < settings.keys_count;
+                 first = next_key.fetch_add(step))
+                failures += !client.send_update(first, std::min(step, settings.keys_count - first));
+        });
+    for (auto& thread : threads)
+        thread.join();
+    if (failures)
+        throw std::runtime_error(fmt::format("Failed to load {} batches of keys", failures.load()));
+}
+
+/**
+ * @brief Sends requests at a fixed total rate of `state.range(0)` per second for `duration`
+ * seconds, splitting it evenly between the clients, and reports the latency percentiles.
+ */
+void open_loop(bm::State& state, transport_t transport) {
+
+    std::size_t const threads_count = settings.threads_count;
+    auto const rate_per_client = double(state.range(0)) / double(threads_count);
+    auto const interval = std::chrono::duration_cast<steady_clock_t::duration>(
+        std::chrono::duration<double>(1.0 / rate_per_client));
+    auto const duration = std::chrono::seconds(settings.duration);
+
+    std::vector<latency_histogram_t> latencies(threads_count);
+    std::vector<std::size_t> failures(threads_count);
+    std::vector<std::string> errors(threads_count);
+    double seconds = 0;
+
+    for (auto _ : state) {
+        // Connect and precompute the distributions before the schedule starts
+        std::vector<std::unique_ptr<client_t>> clients;
+        try {
+            for (std::size_t idx = 0; idx != threads_count; ++idx)
+                clients.push_back(std::make_unique<client_t>(transport, idx + 1));
+        }
+        catch (std::exception const& ex) {
+            state.SkipWithError(ex.what());
+            return;
+        }
+
+        std::vector<std::thread> threads;
+        auto const start = steady_clock_t::now() + std::chrono::milliseconds(10);
+        for (std::size_t idx = 0; idx != threads_count; ++idx)
+            threads.emplace_back([&, idx] {
+                try {
+                    // Spread the first requests of different clients over the first interval
+                    auto scheduled = start + interval * idx / threads_count;
+                    for (; scheduled < start + duration; scheduled += interval) {
+                        std::this_thread::sleep_until(scheduled);
+                        bool success = clients[idx]->send_random();
+                        auto latency = steady_clock_t::now() - scheduled;
+                        if (!success) {
+                            ++failures[idx];
+                            continue;
+                        }
+                        auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count();
+                        latencies[idx].record(static_cast<std::uint64_t>(nanoseconds));
+                    }
+                }
+                catch (std::exception const& ex) {
+                    errors[idx] = ex.what();
+                }
+            });
+        for (auto& thread : threads)
+            thread.join();
+        seconds = std::chrono::duration<double>(steady_clock_t::now() - start).count();
+        state.SetIterationTime(seconds);
+    }
+
+    for (auto const& error : errors)
+        if (!error.empty()) {
+            state.SkipWithError(error.c_str());
+            return;
+        }
+
+    latency_histogram_t merged;
+    std::size_t failures_count = 0;
+    for (std::size_t idx = 0; idx != threads_count; ++idx) {
+        merged.merge(latencies[idx]);
+        failures_count += failures[idx];
+    }
+    state.counters["target/s"] = bm::Counter(double(state.range(0)));
+    state.counters["requests/s"] = bm::Counter(double(merged.count()) / seconds);
+    state.counters["fails"] = bm::Counter(double(failures_count));
+    state.counters["p50,us"] = bm::Counter(merged.percentile(0.5) / 1e3);
+    state.counters["p99,us"] = bm::Counter(merged.percentile(0.99) / 1e3);
+    state.counters["p999,us"] = bm::Counter(merged.percentile(0.999) / 1e3);
+    state.counters["max,us"] = bm::Counter(merged.max() / 1e3);
+}
+
+#pragma endregion - Clients
+
+int main(int argc, char** argv) {
+
+    parse_args(argc, argv, settings);
+    bm::Initialize(&argc, argv);
+    value_bytes.assign(settings.value_size, 'v');
+
+    std::vector<std::pair<char const*, transport_t>> transports;
+    try {
+        // 1. Start the servers, if asked to
+        if (!settings.flight_server.empty()) {
+            spawn_server({settings.flight_server, "--port", "38709"});
+            if (settings.flight_url.empty())
+                settings.flight_url = "grpc://127.0.0.1:38709";
+        }
+        if (!settings.rest_server.empty()) {
+            spawn_server({settings.rest_server, "127.0.0.1", "8080", "0"});
+            if (settings.http_address.empty())
+                settings.http_address = "127.0.0.1:8080";
+        }
+        if (!settings.http_address.empty()) {
+            auto colon = settings.http_address.rfind(':');
+            if (colon == std::string::npos)
+                throw std::runtime_error("REST server address must include the port");
+            http_host = settings.http_address.substr(0, colon);
+            http_port = static_cast<std::uint16_t>(std::stoul(settings.http_address.substr(colon + 1)));
+        }
+
+        // 2. Populate the dataset through every transport we will measure
+        if (!settings.flight_url.empty()) {
+            if (!settings.flight_server.empty() && !wait_for_port("127.0.0.1", 38709))
+                throw std::runtime_error("Flight server didn't start");
+            db.open(settings.flight_url.c_str()).throw_unhandled();
+            transports.emplace_back("flight", transport_t::flight_k);
+        }
+        if (http_port) {
+            if (!wait_for_port(http_host, http_port))
+                throw std::runtime_error("REST server isn't reachable");
+            transports.emplace_back("http", transport_t::http_k);
+        }
+        if (transports.empty())
+            throw std::runtime_error("Pass a Flight URL, a REST address or servers to start");
+
+        std::printf("Will load %zu keys...\n", settings.keys_count);
+        for (auto const& transport : transports)
+            load_keys(transport.second);
+    }
+    catch (std::exception const& ex) {
+        fmt::print("{}\n", ex.what());
+        stop_servers();
+        return 1;
+    }
+
+    // 3. Run the actual benchmarks
+    std::printf("Will benchmark...\n");
+    for (auto const& transport : transports) {
+        auto benchmark = bm::RegisterBenchmark(fmt::format("{}_open_loop", transport.first).c_str(),
+                                               &open_loop,
+                                               transport.second)
+                             ->Iterations(1)
+                             ->UseManualTime()
+                             ->Unit(bm::kMillisecond);
+        for (auto rate : settings.rates)
+            benchmark->Arg(rate);
+    }
+
+    bm::RunSpecifiedBenchmarks();
+    bm::Shutdown();
+
+    db.close();
+    stop_servers();
+    return 0;
+}
@@ -0,0 +1,236 @@
+/**
+ * @file transactions.cpp
+ * @brief Scaling of ACID transactions under contention.
+ *
+ * Generates the same concurrent transactional load, as the stress tests:
+ * - "batches": every transaction assigns one value to a batch of consecutive keys,
+ *   or erases them, as in "tests/stress_atomicity.cpp";
+ * - "scattered": every transaction assigns and erases independent keys,
+ *   as in "tests/stress_linearizability.cpp".
+ * Keys are drawn uniformly or from a Zipfian distribution, over key spaces of different sizes.
+ * Every workload is repeated for 1, 2, 4... threads, up to the number of cores, so that
+ * changes to locking and conflict detection can be compared on the scaling curves.
+ *
+ * Reported metrics are the commits and aborts per second, the share of aborted transactions
+ * and the latency percentiles of the committed ones. Results are written as JSON,
+ * unless `--benchmark_out` is passed.
+ */
+
+#include <algorithm>   // `std::any_of`
+#include <chrono>      // `std::chrono::steady_clock`
+#include <random>      // `std::mt19937_64`
+#include <sstream>     // `std::istringstream`
+#include <string_view> //
+#include <thread>      // `std::thread::hardware_concurrency`
+#include <vector>      //
+
+#include <benchmark/benchmark.h>
+#include <fmt/format.h>
+#include <argparse/argparse.hpp>
+
+#include <ustore/ustore.hpp>
+#include <workload.hpp> // `transaction_generator_t`, `latency_histogram_t`
+
+namespace bm = benchmark;
+using namespace unum::ustore;
+
+#if !defined(USTORE_BENCH_CLIENT)
+#define USTORE_BENCH_CLIENT "ustore"
+#endif
+
+struct settings_t {
+    std::string config_path;
+    std::size_t threads_count;
+    std::size_t min_seconds;
+    double erase_probability;
+    std::vector<std::int64_t> batch_sizes;
+    std::vector<std::int64_t> keys_counts;
+};
+
+struct contention_workload_t {
+    char const* name;
+    transaction_shape_t shape;
+    key_distribution_t distribution;
+};
+
+static contention_workload_t const workloads_k[] = {
+    {"txn_batches_uniform", transaction_shape_t::batches_k, key_distribution_t::uniform_k},
+    {"txn_batches_zipfian", transaction_shape_t::batches_k, key_distribution_t::zipfian_k},
+    {"txn_scattered_uniform", transaction_shape_t::scattered_k, key_distribution_t::uniform_k},
+    {"txn_scattered_zipfian", transaction_shape_t::scattered_k, key_distribution_t::zipfian_k},
+};
+
+static database_t db;
+static settings_t settings;
+
+static std::vector<std::int64_t> parse_list(std::string const& joined) {
+    std::vector<std::int64_t> result;
+    std::istringstream stream(joined);
+    for (std::string part; std::getline(stream, part, ',');)
+        if (!part.empty())
+            result.push_back(std::stol(part));
+    return result;
+}
+
+void parse_args(int argc, char* argv[], settings_t& settings) {
+    argparse::ArgumentParser program(argv[0]);
+    program.add_argument("-c", "--cfg").default_value(std::string("")).help("Config path");
+    program.add_argument("-t", "--threads")
+        .default_value(std::to_string(std::thread::hardware_concurrency()))
+        .help("Maximum threads count");
+    program.add_argument("-n", "--min_seconds").default_value(std::string("5")).help("Minimal seconds");
+    program.add_argument("-e", "--erases").default_value(std::string("0.25")).help("Share of erasures");
+    program.add_argument("-b", "--batch_sizes").default_value(std::string("1,10,100")).help("Keys per transaction");
+    program.add_argument("-k", "--keys_counts").default_value(std::string("1000,1000000")).help("Key space sizes");
+
+    program.parse_known_args(argc, argv);
+
+    settings.config_path = program.get("cfg");
+    settings.threads_count = std::stoul(program.get("threads"));
+    settings.min_seconds = std::stoul(program.get("min_seconds"));
+    settings.erase_probability = std::stod(program.get("erases"));
+    settings.batch_sizes = parse_list(program.get("batch_sizes"));
+    settings.keys_counts = parse_list(program.get("keys_counts"));
+
+    auto non_positive = [](std::vector<std::int64_t> const& list) {
+        return list.empty() || std::any_of(list.begin(), list.end(), [](auto size) { return size <= 0; });
+    };
+    if (settings.threads_count == 0) {
+        fmt::print("Zero threads count specified\n");
+        exit(1);
+    }
+    if (non_positive(settings.batch_sizes) || non_positive(settings.keys_counts)) {
+        fmt::print("Batch sizes and key space sizes must be positive\n");
+        exit(1);
+    }
+    if (settings.erase_probability < 0 || settings.erase_probability > 1) {
+        fmt::print("Share of erasures must be between 0 and 1\n");
+        exit(1);
+    }
+}
+
+/**
+ * @brief Runs a workload, where every iteration is a single transaction of `state.range(0)` writes
+ * into a key space of `state.range(1)` keys. Conflicting transactions are not retried,
+ * so every iteration is either a commit or an abort.
+ */
+void contention(bm::State& state, contention_workload_t const& workload) {
+
+    auto const batch_size = static_cast<std::size_t>(state.range(0));
+    auto const keys_count = static_cast<std::uint64_t>(state.range(1));
+    std::mt19937_64 generator(state.thread_index() + 1);
+    transaction_generator_t transactions( //
+        workload.shape,
+        workload.distribution,
+        keys_count,
+        batch_size,
+        settings.erase_probability);
+    latency_histogram_t latencies;
+
+    transaction_t txn;
+    try {
+        txn = db.transact().throw_or_release();
+    }
+    catch (std::exception const& ex) {
+        state.SkipWithError(ex.what());
+        return;
+    }
+
+    // Pre-allocate space for our write sets
+    std::vector<transaction_generator_t::write_t> writes;
+    std::vector<ustore_key_t> assigned;
+    std::vector<ustore_key_t> erased;
+    assigned.reserve(batch_size);
+    erased.reserve(batch_size);
+
+    // Run the benchmark
+    std::size_t commits = 0;
+    std::size_t aborts = 0;
+    for (auto _ : state) {
+
+        transactions(generator, writes);
+        assigned.clear();
+        erased.clear();
+        for (auto const& write : writes)
+            (write.erase ? erased : assigned).push_back(write.key);
+        std::uint64_t const num_value = generator();
+        value_view_t value((byte_t const*)&num_value, sizeof(num_value));
+
+        auto start = std::chrono::steady_clock::now();
+        status_t status = txn.reset();
+        if (status && !assigned.empty())
+            status = txn[strided_range(assigned).immutable()].assign(value);
+        if (status && !erased.empty())
+            status = txn[strided_range(erased).immutable()].erase();
+        if (status)
+            status = txn.commit();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+
+        if (!status) {
+            status.release_exception();
+            aborts += 1;
+            continue;
+        }
+        auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        latencies.record(static_cast<std::uint64_t>(nanoseconds));
+        commits += 1;
+    }
+
+    // These will be summed across threads:
+    state.counters["commits/s"] = bm::Counter(commits, bm::Counter::kIsRate);
+    state.counters["aborts/s"] = bm::Counter(aborts, bm::Counter::kIsRate);
+    state.counters["keys/s"] = bm::Counter(commits * batch_size, bm::Counter::kIsRate);
+
+    // These will be averaged across threads:
+    double attempts = static_cast<double>(commits + aborts);
+    state.counters["abort_rate"] = bm::Counter(attempts ? aborts / attempts : 0, bm::Counter::kAvgThreads);
+    state.counters["p50,us"] = bm::Counter(latencies.percentile(0.5) / 1e3, bm::Counter::kAvgThreads);
+    state.counters["p99,us"] = bm::Counter(latencies.percentile(0.99) / 1e3, bm::Counter::kAvgThreads);
+    state.counters["p999,us"] = bm::Counter(latencies.percentile(0.999) / 1e3, bm::Counter::kAvgThreads);
+}
+
+int main(int argc, char** argv) {
+
+    parse_args(argc, argv, settings);
+
+    // Unless told otherwise, store the results next to the binary, to track them over time
+    std::vector<char*> bm_argv(argv, argv + argc);
+    std::string out_arg = fmt::format("--benchmark_out=transactions_{}.json", USTORE_BENCH_CLIENT);
+    std::string out_format_arg = "--benchmark_out_format=json";
+    bool has_out = std::any_of(bm_argv.begin(), bm_argv.end(), [](char const* arg) {
+        return std::string_view(arg).rfind("--benchmark_out=", 0) == 0;
+    });
+    if (!has_out) {
+        bm_argv.push_back(out_arg.data());
+        bm_argv.push_back(out_format_arg.data());
+    }
+    int bm_argc = static_cast<int>(bm_argv.size());
+    bm::Initialize(&bm_argc, bm_argv.data());
+
+    bm::AddCustomContext("client", USTORE_BENCH_CLIENT);
+    bm::AddCustomContext("erases", std::to_string(settings.erase_probability));
+
+    db.open(settings.config_path.c_str()).throw_unhandled();
+    if (!db.supports_transactions()) {
+        std::printf("Selected UStore Engine doesn't support ACID transactions\n");
+        return 1;
+    }
+    db.clear().throw_unhandled();
+
+    std::printf("Will benchmark...\n");
+    for (auto const& workload : workloads_k)
+        bm::RegisterBenchmark(workload.name, &contention, workload) //
+            ->MinTime(settings.min_seconds)
+            ->UseRealTime()
+            ->ThreadRange(1, static_cast<int>(settings.threads_count))
+            ->ArgNames({"batch", "keys"})
+            ->ArgsProduct({settings.batch_sizes, settings.keys_counts});
+
+    bm::RunSpecifiedBenchmarks();
+    bm::Shutdown();
+
+    // Clear DB after benchmark
+    db.clear().throw_unhandled();
+    db.close();
+    return 0;
+}
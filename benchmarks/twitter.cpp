@@ -670,6 +670,46 @@ static void graph_traverse_two_hops(bm::State& state) {
     state.counters["edges/s"] = bm::Counter(received_edges, bm::Counter::kIsRate);
 }
 
+static void graph_traverse_two_hops_batched(bm::State& state) {
+    arena_t arena(db);
+
+    std::size_t received_bytes = 0;
+    std::size_t received_edges = 0;
+    sample_tweet_id_batches(state, [&](ustore_key_t const* ids_tweets, ustore_size_t count) {
+        // Both hops in a single call
+        ustore_vertex_role_t const role = ustore_vertex_role_any_k;
+        ustore_length_t* edges_offsets = nullptr;
+        ustore_key_t* edges = nullptr;
+
+        status_t status;
+        ustore_graph_traverse_t graph_traverse {};
+        graph_traverse.db = db;
+        graph_traverse.error = status.member_ptr();
+        graph_traverse.arena = arena.member_ptr();
+        graph_traverse.collection = collection_graph_k;
+        graph_traverse.seeds_count = count;
+        graph_traverse.seeds = ids_tweets;
+        graph_traverse.seeds_stride = sizeof(ustore_key_t);
+        graph_traverse.hops_count = 2;
+        graph_traverse.roles = &role;
+        graph_traverse.dedup = ustore_traversal_dedup_hop_k;
+        graph_traverse.edges_offsets = &edges_offsets;
+        graph_traverse.edges = &edges;
+
+        ustore_graph_traverse(&graph_traverse);
+        if (!status)
+            return false;
+
+        std::size_t total_edges = edges_offsets[2];
+        received_bytes += total_edges * 3 * sizeof(ustore_key_t);
+        received_edges += total_edges;
+        return true;
+    });
+    state.counters["bytes/s"] = bm::Counter(received_bytes, bm::Counter::kIsRate);
+    state.counters["bytes/it"] = bm::Counter(received_bytes, bm::Counter::kAvgIterations);
+    state.counters["edges/s"] = bm::Counter(received_edges, bm::Counter::kIsRate);
+}
+
 int main(int argc, char** argv) {
     bm::Initialize(&argc, argv);
 
@@ -884,13 +924,20 @@ int main(int argc, char** argv) {
         ->Arg(settings.mid_batch_size)
         ->Arg(settings.big_batch_size);
 
-    if (can_build_graph)
+    if (can_build_graph) {
         bm::RegisterBenchmark("graph_traverse_two_hops", &graph_traverse_two_hops) //
             ->MinTime(settings.min_seconds)
             ->Threads(settings.threads_count)
             ->Arg(settings.small_batch_size)
             ->Arg(settings.mid_batch_size)
             ->Arg(settings.big_batch_size);
+        bm::RegisterBenchmark("graph_traverse_two_hops_batched", &graph_traverse_two_hops_batched) //
+            ->MinTime(settings.min_seconds)
+            ->Threads(settings.threads_count)
+            ->Arg(settings.small_batch_size)
+            ->Arg(settings.mid_batch_size)
+            ->Arg(settings.big_batch_size);
+    }
 
     bm::RunSpecifiedBenchmarks();
     bm::Shutdown();
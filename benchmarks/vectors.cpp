@@ -0,0 +1,609 @@
+/**
+ * @file vectors.cpp
+ * @brief Approximate Nearest Neighbors Search benchmark for the Vectors modality.
+ *
+ * Loads a standard ANN dataset, like SIFT1M, GIST1M or subsets of Deep1B, and for every
+ * combination of the metric and the scalar type builds a separate collection, measuring:
+ * - Build throughput with `ustore_vectors_write()` and the resulting footprint per vector.
+ * - Queries per second with `ustore_vectors_search()`, for different batch sizes and "ef".
+ * - Recall@k against the exact neighbors, from a ground-truth file or a brute-force scan.
+ *
+ * Supported formats are the ".fvecs", ".bvecs" and ".ivecs" of the INRIA datasets,
+ * and the ".fbin", ".u8bin" and ".ibin" of the Big-ANN benchmark. Without a dataset,
+ * uniformly distributed vectors are generated.
+ *
+ * http://corpus-texmex.irisa.fr
+ * https://big-ann-benchmarks.com
+ */
+
+#include <algorithm>   // `std::partial_sort`
+#include <atomic>      // `std::atomic`
+#include <chrono>      // `std::chrono::steady_clock`
+#include <cmath>       // `std::round`
+#include <cstring>     // `std::memcpy`
+#include <fstream>     // `std::ifstream`
+#include <limits>      // `std::numeric_limits`
+#include <memory>      // `std::unique_ptr`
+#include <mutex>       // `std::once_flag`
+#include <numeric>     // `std::iota`
+#include <random>      // `std::mt19937`
+#include <sstream>     // `std::istringstream`
+#include <string_view> //
+#include <thread>      //
+#include <vector>      //
+
+#include <benchmark/benchmark.h>
+#include <fmt/format.h>
+#include <argparse/argparse.hpp>
+
+#include <ustore/ustore.hpp>
+#include <vector_metrics.hpp> // `f32_to_f16`
+
+namespace bm = benchmark;
+using namespace unum::ustore;
+
+struct settings_t {
+    std::string config_path;
+    std::string base_path;
+    std::string queries_path;
+    std::string ground_truth_path;
+    std::size_t max_base_count;
+    std::size_t max_queries_count;
+    std::size_t dimensions;
+    std::size_t k;
+    std::size_t threads_count;
+    std::size_t write_batch_size;
+    std::size_t connectivity;
+    std::size_t construction_expansion;
+    std::vector<std::int64_t> query_batch_sizes;
+    std::vector<std::int64_t> search_expansions;
+    std::vector<std::string> metrics;
+    std::vector<std::string> scalars;
+};
+
+/**
+ * @brief Row-major matrix of single-precision vectors.
+ */
+struct matrix_t {
+    std::vector<float> scalars;
+    std::size_t dimensions = 0;
+
+    std::size_t rows() const noexcept { return dimensions ? scalars.size() / dimensions : 0; }
+    float const* row(std::size_t idx) const noexcept { return scalars.data() + idx * dimensions; }
+};
+
+/**
+ * @brief Exact neighbors of every query, from the closest.
+ */
+struct ground_truth_t {
+    std::vector<ustore_key_t> keys;
+    std::size_t k = 0;
+
+    ustore_key_t const* row(std::size_t idx) const noexcept { return keys.data() + idx * k; }
+};
+
+/**
+ * @brief Collection with the whole base set, stored with one metric and one scalar type.
+ */
+struct index_t {
+    std::string name;
+    ustore_vector_metric_t metric = ustore_vector_metric_l2_k;
+    ustore_vector_scalar_t scalar_type = ustore_vector_scalar_f32_k;
+    ustore_collection_t collection = ustore_collection_main_k;
+
+    std::vector<std::uint8_t> base;
+    std::vector<std::uint8_t> queries;
+    std::size_t bytes_per_vector = 0;
+    ground_truth_t ground_truth;
+
+    std::once_flag built;
+    double build_seconds = 0;
+    double value_bytes_per_vector = 0;
+    double disk_bytes_per_vector = 0;
+};
+
+static database_t db;
+static settings_t settings;
+static matrix_t base;
+static matrix_t queries;
+static ground_truth_t loaded_ground_truth;
+static std::vector<std::unique_ptr<index_t>> indexes;
+
+std::vector<std::string> split(std::string const& list) {
+    std::vector<std::string> parts;
+    std::istringstream stream(list);
+    for (std::string part; std::getline(stream, part, ',');)
+        if (!part.empty())
+            parts.push_back(part);
+    return parts;
+}
+
+std::vector<std::int64_t> split_numbers(std::string const& list) {
+    std::vector<std::int64_t> numbers;
+    for (auto const& part : split(list))
+        numbers.push_back(std::stol(part));
+    return numbers;
+}
+
+void parse_args(int argc, char* argv[], settings_t& settings) {
+    argparse::ArgumentParser program(argv[0]);
+    program.add_argument("-c", "--cfg").default_value(std::string("")).help("Config path or server URL");
+    program.add_argument("-b", "--base").default_value(std::string("")).help("Base vectors file");
+    program.add_argument("-q", "--queries").default_value(std::string("")).help("Query vectors file");
+    program.add_argument("-g", "--ground_truth").default_value(std::string("")).help("L2 neighbors file");
+    program.add_argument("-n", "--max_base").default_value(std::string("0")).help("Base vectors limit, zero for all");
+    program.add_argument("-m", "--max_queries").default_value(std::string("1000")).help("Query vectors limit");
+    program.add_argument("-d", "--dims").default_value(std::string("128")).help("Dimensions of generated vectors");
+    program.add_argument("-k", "--k").default_value(std::string("10")).help("Neighbors per query");
+    program.add_argument("-t", "--threads")
+        .default_value(std::to_string(std::thread::hardware_concurrency()))
+        .help("Query threads count");
+    program.add_argument("-w", "--write_batch").default_value(std::string("1024")).help("Vectors per write");
+    program.add_argument("-M", "--connectivity").default_value(std::string("16")).help("Index connectivity");
+    program.add_argument("-e", "--ef_construction").default_value(std::string("128")).help("Index expansion");
+    program.add_argument("-qb", "--query_batches").default_value(std::string("1,64")).help("Queries per search");
+    program.add_argument("-ef", "--ef_search").default_value(std::string("0,64,256")).help("Search expansions");
+    program.add_argument("-me", "--metrics").default_value(std::string("l2,cos")).help("Metrics: l2, cos, dot");
+    program.add_argument("-s", "--scalars").default_value(std::string("f32,f16,i8")).help("Types: f32, f16, i8");
+
+    program.parse_known_args(argc, argv);
+
+    settings.config_path = program.get("cfg");
+    settings.base_path = program.get("base");
+    settings.queries_path = program.get("queries");
+    settings.ground_truth_path = program.get("ground_truth");
+    settings.max_base_count = std::stoul(program.get("max_base"));
+    settings.max_queries_count = std::stoul(program.get("max_queries"));
+    settings.dimensions = std::stoul(program.get("dims"));
+    settings.k = std::stoul(program.get("k"));
+    settings.threads_count = std::stoul(program.get("threads"));
+    settings.write_batch_size = std::stoul(program.get("write_batch"));
+    settings.connectivity = std::stoul(program.get("connectivity"));
+    settings.construction_expansion = std::stoul(program.get("ef_construction"));
+    settings.query_batch_sizes = split_numbers(program.get("query_batches"));
+    settings.search_expansions = split_numbers(program.get("ef_search"));
+    settings.metrics = split(program.get("metrics"));
+    settings.scalars = split(program.get("scalars"));
+
+    if (!settings.threads_count || !settings.k || !settings.write_batch_size || !settings.max_queries_count) {
+        fmt::print("Zero threads count, neighbors count, write batch or queries count specified\n");
+        exit(1);
+    }
+    if (settings.base_path.empty() != settings.queries_path.empty()) {
+        fmt::print("Both base and query vectors must be provided\n");
+        exit(1);
+    }
+    if (settings.query_batch_sizes.empty() || settings.search_expansions.empty()) {
+        fmt::print("At least one query batch size and one search expansion must be provided\n");
+        exit(1);
+    }
+}
+
+#pragma region - Datasets
+
+bool ends_with(std::string_view str, std::string_view suffix) noexcept {
+    return str.size() >= suffix.size() && str.substr(str.size() - suffix.size()) == suffix;
+}
+
+/**
+ * @brief Loads up to @p max_rows vectors, or all of them, if zero, upcasting the scalars into `float`s.
+ * The ".*vecs" files prefix every row with its dimensions, and ".*bin" files
+ * start with the number of rows and dimensions of the whole matrix.
+ */
+template <typename scalar_at>
+matrix_t load_matrix(std::string const& path, std::size_t max_rows) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        throw std::runtime_error(fmt::format("Can't open {}", path));
+
+    matrix_t matrix;
+    std::vector<scalar_at> row;
+    bool const headed_rows = ends_with(path, "vecs");
+    std::uint32_t rows = std::numeric_limits<std::uint32_t>::max();
+    std::uint32_t dims = 0;
+    if (!headed_rows) {
+        file.read(reinterpret_cast<char*>(&rows), sizeof(rows));
+        file.read(reinterpret_cast<char*>(&dims), sizeof(dims));
+    }
+
+    for (std::size_t idx = 0; idx != rows && (!max_rows || idx != max_rows); ++idx) {
+        if (headed_rows && !file.read(reinterpret_cast<char*>(&dims), sizeof(dims)))
+            break;
+        if (matrix.dimensions && matrix.dimensions != dims)
+            throw std::runtime_error(fmt::format("Inconsistent dimensions in {}", path));
+        matrix.dimensions = dims;
+        row.resize(dims);
+        if (!file.read(reinterpret_cast<char*>(row.data()), dims * sizeof(scalar_at)))
+            break;
+        matrix.scalars.insert(matrix.scalars.end(), row.begin(), row.end());
+    }
+    return matrix;
+}
+
+matrix_t load_vectors(std::string const& path, std::size_t max_rows) {
+    if (ends_with(path, ".fvecs") || ends_with(path, ".fbin"))
+        return load_matrix<float>(path, max_rows);
+    if (ends_with(path, ".bvecs") || ends_with(path, ".u8bin"))
+        return load_matrix<std::uint8_t>(path, max_rows);
+    if (ends_with(path, ".i8bin"))
+        return load_matrix<std::int8_t>(path, max_rows);
+    throw std::runtime_error(fmt::format("Unknown vectors format: {}", path));
+}
+
+ground_truth_t load_ground_truth(std::string const& path, std::size_t max_rows, std::size_t k) {
+    matrix_t neighbors;
+    if (ends_with(path, ".ivecs") || ends_with(path, ".ibin"))
+        neighbors = load_matrix<std::int32_t>(path, max_rows);
+    else
+        throw std::runtime_error(fmt::format("Unknown neighbors format: {}", path));
+    if (neighbors.dimensions < k)
+        throw std::runtime_error("Ground truth has less than k neighbors per query");
+
+    ground_truth_t ground_truth;
+    ground_truth.k = k;
+    ground_truth.keys.reserve(neighbors.rows() * k);
+    for (std::size_t idx = 0; idx != neighbors.rows(); ++idx)
+        for (std::size_t neighbor_idx = 0; neighbor_idx != k; ++neighbor_idx)
+            ground_truth.keys.push_back(static_cast<ustore_key_t>(neighbors.row(idx)[neighbor_idx]));
+    return ground_truth;
+}
+
+matrix_t generate_vectors(std::size_t rows, std::size_t dims, std::size_t seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+    matrix_t matrix;
+    matrix.dimensions = dims;
+    matrix.scalars.resize(rows * dims);
+    for (auto& scalar : matrix.scalars)
+        scalar = uniform(generator);
+    return matrix;
+}
+
+/**
+ * @brief Scores the similarity of two vectors, so that higher is always closer.
+ */
+float similarity(float const* a, float const* b, std::size_t dims, ustore_vector_metric_t metric) noexcept {
+    float ab = 0, a2 = 0, b2 = 0;
+    for (std::size_t i = 0; i != dims; ++i) {
+        ab += a[i] * b[i];
+        a2 += a[i] * a[i];
+        b2 += b[i] * b[i];
+    }
+    switch (metric) {
+    case ustore_vector_metric_dot_k: return ab;
+    case ustore_vector_metric_cos_k: return a2 && b2 ? ab / std::sqrt(a2 * b2) : 0.f;
+    case ustore_vector_metric_l2_k: return -(a2 + b2 - 2 * ab);
+    }
+    return 0;
+}
+
+/**
+ * @brief Finds the exact neighbors of every query, splitting the queries between threads.
+ */
+ground_truth_t brute_force(ustore_vector_metric_t metric, std::size_t k) {
+    ground_truth_t ground_truth;
+    ground_truth.k = std::min(k, base.rows());
+    ground_truth.keys.resize(queries.rows() * ground_truth.k);
+
+    std::atomic<std::size_t> next_query = 0;
+    auto search = [&] {
+        std::vector<std::pair<float, ustore_key_t>> scores(base.rows());
+        for (std::size_t query_idx = next_query++; query_idx < queries.rows(); query_idx = next_query++) {
+            for (std::size_t base_idx = 0; base_idx != base.rows(); ++base_idx)
+                scores[base_idx] = {similarity(queries.row(query_idx), base.row(base_idx), base.dimensions, metric),
+                                    static_cast<ustore_key_t>(base_idx)};
+            auto top_end = scores.begin() + ground_truth.k;
+            std::partial_sort(scores.begin(), top_end, scores.end(), std::greater<> {});
+            auto row = ground_truth.keys.data() + query_idx * ground_truth.k;
+            std::transform(scores.begin(), top_end, row, [](auto const& score) { return score.second; });
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (std::size_t idx = 0; idx != std::max(1u, std::thread::hardware_concurrency()); ++idx)
+        threads.emplace_back(search);
+    for (auto& thread : threads)
+        thread.join();
+    return ground_truth;
+}
+
+/**
+ * @brief Converts single-precision vectors into the stored @p scalar_type.
+ * Integers are scaled by the same factor, which preserves the order of neighbors.
+ */
+std::vector<std::uint8_t> convert_matrix(matrix_t const& matrix, ustore_vector_scalar_t scalar_type, float scale) {
+    std::vector<std::uint8_t> bytes;
+    switch (scalar_type) {
+    case ustore_vector_scalar_f32_k: {
+        bytes.resize(matrix.scalars.size() * sizeof(float));
+        std::memcpy(bytes.data(), matrix.scalars.data(), bytes.size());
+        break;
+    }
+    case ustore_vector_scalar_f16_k: {
+        bytes.resize(matrix.scalars.size() * sizeof(f16_bits_t));
+        auto halves = reinterpret_cast<f16_bits_t*>(bytes.data());
+        for (std::size_t idx = 0; idx != matrix.scalars.size(); ++idx)
+            halves[idx] = f32_to_f16(matrix.scalars[idx]);
+        break;
+    }
+    case ustore_vector_scalar_i8_k: {
+        bytes.resize(matrix.scalars.size());
+        auto integers = reinterpret_cast<std::int8_t*>(bytes.data());
+        for (std::size_t idx = 0; idx != matrix.scalars.size(); ++idx) {
+            float scaled = std::round(matrix.scalars[idx] * scale);
+            integers[idx] = static_cast<std::int8_t>(std::clamp(scaled, -127.f, 127.f));
+        }
+        break;
+    }
+    default: throw std::runtime_error("Unsupported scalar type");
+    }
+    return bytes;
+}
+
+#pragma endregion - Datasets
+
+#pragma region - Benchmarks
+
+/**
+ * @brief Writes the whole base set into the collection of the @p index,
+ * and estimates the space it takes, including the graph of the index.
+ */
+void build(index_t& index) {
+    status_t status;
+    arena_t arena(db);
+    std::vector<ustore_key_t> keys(settings.write_batch_size);
+
+    ustore_vectors_write_t write {};
+    write.db = db;
+    write.error = status.member_ptr();
+    write.arena = arena.member_ptr();
+    write.dimensions = static_cast<ustore_length_t>(base.dimensions);
+    write.scalar_type = index.scalar_type;
+    write.collections = &index.collection;
+    write.keys = keys.data();
+    write.keys_stride = sizeof(ustore_key_t);
+    write.vectors_stride = index.bytes_per_vector;
+    write.metric = index.metric;
+    write.index_connectivity = settings.connectivity;
+    write.index_expansion = settings.construction_expansion;
+
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t first = 0; first < base.rows(); first += settings.write_batch_size) {
+        auto vectors = static_cast<ustore_bytes_cptr_t>(index.base.data() + first * index.bytes_per_vector);
+        write.tasks_count = std::min(settings.write_batch_size, base.rows() - first);
+        write.vectors_starts = &vectors;
+        std::iota(keys.begin(), keys.begin() + write.tasks_count, static_cast<ustore_key_t>(first));
+        ustore_vectors_write(&write);
+        status.throw_unhandled();
+    }
+    index.build_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    ustore_key_t min_key = std::numeric_limits<ustore_key_t>::min();
+    ustore_key_t max_key = std::numeric_limits<ustore_key_t>::max();
+    ustore_size_t* min_cardinalities = nullptr;
+    ustore_size_t* max_cardinalities = nullptr;
+    ustore_size_t* min_value_bytes = nullptr;
+    ustore_size_t* max_value_bytes = nullptr;
+    ustore_size_t* min_space_usages = nullptr;
+    ustore_size_t* max_space_usages = nullptr;
+    ustore_measure_t measure {};
+    measure.db = db;
+    measure.error = status.member_ptr();
+    measure.arena = arena.member_ptr();
+    measure.tasks_count = 1;
+    measure.collections = &index.collection;
+    measure.start_keys = &min_key;
+    measure.end_keys = &max_key;
+    measure.min_cardinalities = &min_cardinalities;
+    measure.max_cardinalities = &max_cardinalities;
+    measure.min_value_bytes = &min_value_bytes;
+    measure.max_value_bytes = &max_value_bytes;
+    measure.min_space_usages = &min_space_usages;
+    measure.max_space_usages = &max_space_usages;
+    ustore_measure(&measure);
+    status.throw_unhandled();
+    index.value_bytes_per_vector = double(max_value_bytes[0]) / double(base.rows());
+    index.disk_bytes_per_vector = double(max_space_usages[0]) / double(base.rows());
+}
+
+void construct_index(bm::State& state, index_t& index) {
+    for (auto _ : state)
+        std::call_once(index.built, build, std::ref(index));
+
+    state.SetIterationTime(index.build_seconds);
+    state.counters["vectors/s"] = bm::Counter(double(base.rows()) / std::max(index.build_seconds, 1e-9));
+    state.counters["values,B/vector"] = bm::Counter(index.value_bytes_per_vector);
+    state.counters["disk,B/vector"] = bm::Counter(index.disk_bytes_per_vector);
+}
+
+/**
+ * @brief Searches batches of `state.range(0)` queries with the expansion of `state.range(1)`,
+ * cycling through the query set, and compares the matches with the exact neighbors.
+ */
+void search_index(bm::State& state, index_t& index) {
+
+    // If the construction was filtered out, build the index before measuring
+    std::call_once(index.built, build, std::ref(index));
+
+    status_t status;
+    arena_t arena(db);
+    auto const batch_size = static_cast<std::size_t>(std::min<std::int64_t>(state.range(0), queries.rows()));
+    auto const k = index.ground_truth.k;
+    std::vector<ustore_length_t> limits(batch_size, static_cast<ustore_length_t>(k));
+    ustore_bytes_cptr_t batch_start = nullptr;
+    ustore_length_t* found_counts = nullptr;
+    ustore_length_t* found_offsets = nullptr;
+    ustore_key_t* found_keys = nullptr;
+
+    ustore_vectors_search_t search {};
+    search.db = db;
+    search.error = status.member_ptr();
+    search.arena = arena.member_ptr();
+    search.tasks_count = batch_size;
+    search.dimensions = static_cast<ustore_length_t>(queries.dimensions);
+    search.scalar_type = index.scalar_type;
+    search.metric = index.metric;
+    search.collections = &index.collection;
+    search.match_counts_limits = limits.data();
+    search.match_counts_limits_stride = sizeof(ustore_length_t);
+    search.queries_starts = &batch_start;
+    search.queries_stride = index.bytes_per_vector;
+    search.search_expansion = static_cast<ustore_size_t>(state.range(1));
+    search.match_counts = &found_counts;
+    search.match_offsets = &found_offsets;
+    search.match_keys = &found_keys;
+
+    // Every thread starts from a different part of the query set
+    std::size_t const batches_count = queries.rows() / batch_size;
+    std::size_t batch_idx = state.thread_index() * batches_count / state.threads();
+    std::size_t queries_success = 0;
+    std::size_t matches_correct = 0;
+    for (auto _ : state) {
+        std::size_t const first_query = batch_idx * batch_size;
+        batch_start = index.queries.data() + first_query * index.bytes_per_vector;
+        ustore_vectors_search(&search);
+        status.throw_unhandled();
+
+        for (std::size_t idx = 0; idx != batch_size; ++idx) {
+            auto expected = index.ground_truth.row(first_query + idx);
+            auto found = found_keys + found_offsets[idx];
+            for (std::size_t match_idx = 0; match_idx != found_counts[idx]; ++match_idx)
+                matches_correct += std::find(expected, expected + k, found[match_idx]) != expected + k;
+        }
+        queries_success += batch_size;
+        batch_idx = (batch_idx + 1) % batches_count;
+    }
+
+    // These will be summed across threads:
+    state.counters["queries/s"] = bm::Counter(queries_success, bm::Counter::kIsRate);
+
+    // These will be averaged across threads:
+    double recall = queries_success ? double(matches_correct) / double(queries_success * k) : 0.0;
+    state.counters[fmt::format("recall@{}", k)] = bm::Counter(recall, bm::Counter::kAvgThreads);
+}
+
+#pragma endregion - Benchmarks
+
+ustore_vector_metric_t parse_metric(std::string const& name) {
+    if (name == "l2")
+        return ustore_vector_metric_l2_k;
+    if (name == "cos")
+        return ustore_vector_metric_cos_k;
+    if (name == "dot")
+        return ustore_vector_metric_dot_k;
+    throw std::runtime_error(fmt::format("Unknown metric: {}", name));
+}
+
+ustore_vector_scalar_t parse_scalar(std::string const& name) {
+    if (name == "f32")
+        return ustore_vector_scalar_f32_k;
+    if (name == "f16")
+        return ustore_vector_scalar_f16_k;
+    if (name == "i8")
+        return ustore_vector_scalar_i8_k;
+    throw std::runtime_error(fmt::format("Unknown scalar type: {}", name));
+}
+
+int main(int argc, char** argv) {
+
+    parse_args(argc, argv, settings);
+    bm::Initialize(&argc, argv);
+
+    // 1. Prepare the vectors
+    if (settings.base_path.empty()) {
+        std::printf("Will generate vectors...\n");
+        base = generate_vectors(settings.max_base_count ? settings.max_base_count : 100'000, settings.dimensions, 42);
+        queries = generate_vectors(settings.max_queries_count, settings.dimensions, 43);
+    }
+    else {
+        std::printf("Will load vectors...\n");
+        base = load_vectors(settings.base_path, settings.max_base_count);
+        queries = load_vectors(settings.queries_path, settings.max_queries_count);
+    }
+    if (!base.rows() || !queries.rows() || base.dimensions != queries.dimensions) {
+        fmt::print("Base and query vectors must be non-empty and of equal dimensions\n");
+        return 1;
+    }
+    // Neighbors within subsets of the base set differ from the published ones
+    bool const ground_truth_applies = !settings.ground_truth_path.empty() && !settings.max_base_count;
+    if (ground_truth_applies) {
+        loaded_ground_truth = load_ground_truth(settings.ground_truth_path, queries.rows(), settings.k);
+        if (loaded_ground_truth.keys.size() != queries.rows() * settings.k) {
+            fmt::print("Ground truth doesn't cover all the queries\n");
+            return 1;
+        }
+    }
+    std::printf("- loaded %zu base and %zu query vectors of %zu dimensions\n",
+                base.rows(),
+                queries.rows(),
+                base.dimensions);
+
+    float max_magnitude = 0;
+    for (float scalar : base.scalars)
+        max_magnitude = std::max(max_magnitude, std::abs(scalar));
+    float const i8_scale = max_magnitude ? 127.f / max_magnitude : 1.f;
+
+    // 2. Prepare the collections and the exact neighbors
+    db.open(settings.config_path.c_str()).throw_unhandled();
+    if (!db.supports_named_collections() && settings.metrics.size() * settings.scalars.size() > 1) {
+        fmt::print("Engine doesn't support named collections, pass a single metric and scalar type\n");
+        return 1;
+    }
+    for (auto const& metric_name : settings.metrics) {
+        ustore_vector_metric_t metric = parse_metric(metric_name);
+        std::printf("Will find exact %s neighbors...\n", metric_name.c_str());
+        ground_truth_t ground_truth = metric == ustore_vector_metric_l2_k && ground_truth_applies
+                                          ? loaded_ground_truth
+                                          : brute_force(metric, settings.k);
+
+        for (auto const& scalar_name : settings.scalars) {
+            auto index = std::make_unique<index_t>();
+            index->name = fmt::format("{}_{}", metric_name, scalar_name);
+            index->metric = metric;
+            index->scalar_type = parse_scalar(scalar_name);
+            index->base = convert_matrix(base, index->scalar_type, i8_scale);
+            index->queries = convert_matrix(queries, index->scalar_type, i8_scale);
+            index->bytes_per_vector = index->base.size() / base.rows();
+            index->ground_truth = ground_truth;
+            if (db.supports_named_collections()) {
+                ustore_collection_create_t collection_init {};
+                status_t status;
+                std::string collection_name = fmt::format("bench.vectors.{}", index->name);
+                collection_init.db = db;
+                collection_init.error = status.member_ptr();
+                collection_init.name = collection_name.c_str();
+                collection_init.config = "";
+                collection_init.id = &index->collection;
+                ustore_collection_create(&collection_init);
+                status.throw_unhandled();
+            }
+            indexes.push_back(std::move(index));
+        }
+    }
+
+    // 3. Run the actual benchmarks
+    std::printf("Will benchmark...\n");
+    for (auto& index : indexes) {
+        bm::RegisterBenchmark(fmt::format("construct_{}", index->name).c_str(), &construct_index, std::ref(*index))
+            ->Iterations(1)
+            ->UseManualTime()
+            ->Unit(bm::kSecond);
+
+        auto search = bm::RegisterBenchmark(fmt::format("search_{}", index->name).c_str(), //
+                                            &search_index,
+                                            std::ref(*index))
+                          ->UseRealTime()
+                          ->ThreadRange(1, static_cast<int>(settings.threads_count));
+        for (auto batch_size : settings.query_batch_sizes)
+            for (auto expansion : settings.search_expansions)
+                search->Args({batch_size, expansion});
+    }
+
+    bm::RunSpecifiedBenchmarks();
+    bm::Shutdown();
+
+    // Clear DB after benchmark
+    db.clear().throw_unhandled();
+    db.close();
+    return 0;
+}
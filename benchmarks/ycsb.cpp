@@ -0,0 +1,306 @@
+/**
+ * @file ycsb.cpp
+ * @brief Core workloads of the Yahoo! Cloud Serving Benchmark on the binary layer.
+ *
+ * Every engine and the Flight client are measured with the same six workloads:
+ * - A: 50% reads and 50% updates of Zipfian-distributed keys.
+ * - B: 95% reads and 5% updates of Zipfian-distributed keys.
+ * - C: only reads of Zipfian-distributed keys.
+ * - F: 50% reads and 50% read-modify-writes of Zipfian-distributed keys.
+ * - D: 95% reads of the latest keys and 5% inserts of new ones.
+ * - E: 95% short scans from Zipfian-distributed keys and 5% inserts.
+ * Every workload is repeated for all the batch sizes and for 1, 2, 4... threads,
+ * and the results are written as JSON, unless `--benchmark_out` is passed.
+ *
+ * https://github.com/brianfrankcooper/YCSB/wiki/Core-Workloads
+ */
+
+#include <algorithm>   // `std::any_of`
+#include <atomic>      // `std::atomic`
+#include <chrono>      // `std::chrono::steady_clock`
+#include <numeric>     // `std::iota`
+#include <random>      // `std::mt19937_64`
+#include <sstream>     // `std::istringstream`
+#include <string_view> //
+#include <thread>      // `std::thread::hardware_concurrency`
+#include <vector>      //
+
+#include <benchmark/benchmark.h>
+#include <fmt/format.h>
+#include <argparse/argparse.hpp>
+
+#include <ustore/ustore.hpp>
+#include <workload.hpp> // `keys_generator_t`, `operations_mix_t`, `latency_histogram_t`
+
+namespace bm = benchmark;
+using namespace unum::ustore;
+
+#if !defined(USTORE_BENCH_CLIENT)
+#define USTORE_BENCH_CLIENT "ustore"
+#endif
+
+struct settings_t {
+    std::string config_path;
+    std::size_t records_count;
+    std::size_t value_size;
+    std::size_t max_scan_length;
+    std::size_t threads_count;
+    std::size_t min_seconds;
+    std::vector<std::int64_t> batch_sizes;
+};
+
+struct ycsb_workload_t {
+    char const* name;
+    std::array<double, operations_k> weights;
+    key_distribution_t distribution;
+};
+
+/**
+ * @brief Workloads in the order recommended by the YCSB authors,
+ * as D and E grow the dataset, affecting the ones after them.
+ * Weights are given for reads, updates, inserts, scans and read-modify-writes.
+ */
+static ycsb_workload_t const workloads_k[] = {
+    {"ycsb_a", {50, 50, 0, 0, 0}, key_distribution_t::zipfian_k},
+    {"ycsb_b", {95, 5, 0, 0, 0}, key_distribution_t::zipfian_k},
+    {"ycsb_c", {100, 0, 0, 0, 0}, key_distribution_t::zipfian_k},
+    {"ycsb_f", {50, 0, 0, 0, 50}, key_distribution_t::zipfian_k},
+    {"ycsb_d", {95, 0, 5, 0, 0}, key_distribution_t::latest_k},
+    {"ycsb_e", {0, 0, 5, 95, 0}, key_distribution_t::zipfian_k},
+};
+
+static database_t db;
+static settings_t settings;
+static std::vector<char> value_bytes;
+static std::atomic<std::size_t> next_insert_key;
+
+void parse_args(int argc, char* argv[], settings_t& settings) {
+    argparse::ArgumentParser program(argv[0]);
+    program.add_argument("-c", "--cfg").default_value(std::string("")).help("Config path or server URL");
+    program.add_argument("-r", "--records").default_value(std::string("1000000")).help("Records count");
+    program.add_argument("-v", "--value_size").default_value(std::string("100")).help("Value size in bytes");
+    program.add_argument("-l", "--max_scan_length").default_value(std::string("100")).help("Maximum scan length");
+    program.add_argument("-t", "--threads")
+        .default_value(std::to_string(std::thread::hardware_concurrency()))
+        .help("Maximum threads count");
+    program.add_argument("-n", "--min_seconds").default_value(std::string("10")).help("Minimal seconds");
+    program.add_argument("-b", "--batch_sizes").default_value(std::string("1,16,256")).help("Batch sizes");
+
+    program.parse_known_args(argc, argv);
+
+    settings.config_path = program.get("cfg");
+    settings.records_count = std::stoul(program.get("records"));
+    settings.value_size = std::stoul(program.get("value_size"));
+    settings.max_scan_length = std::stoul(program.get("max_scan_length"));
+    settings.threads_count = std::stoul(program.get("threads"));
+    settings.min_seconds = std::stoul(program.get("min_seconds"));
+
+    std::istringstream batch_sizes(program.get("batch_sizes"));
+    for (std::string batch_size; std::getline(batch_sizes, batch_size, ',');)
+        if (!batch_size.empty())
+            settings.batch_sizes.push_back(std::stol(batch_size));
+
+    if (settings.threads_count == 0) {
+        fmt::print("Zero threads count specified\n");
+        exit(1);
+    }
+    if (settings.records_count == 0 || settings.max_scan_length == 0) {
+        fmt::print("Zero records count or scan length specified\n");
+        exit(1);
+    }
+    if (settings.batch_sizes.empty() ||
+        std::any_of(settings.batch_sizes.begin(), settings.batch_sizes.end(), [](auto size) { return size <= 0; })) {
+        fmt::print("Batch sizes must be positive\n");
+        exit(1);
+    }
+}
+
+/**
+ * @brief Populates the main collection with `records_count` consecutive keys.
+ */
+void load_records() {
+    constexpr std::size_t batch_size_k = 4096;
+    status_t status;
+    arena_t arena(db);
+    std::vector<ustore_key_t> keys(batch_size_k);
+    auto value = reinterpret_cast<ustore_bytes_cptr_t>(value_bytes.data());
+    auto length = static_cast<ustore_length_t>(value_bytes.size());
+
+    ustore_write_t write {};
+    write.db = db;
+    write.error = status.member_ptr();
+    write.arena = arena.member_ptr();
+    write.keys = keys.data();
+    write.keys_stride = sizeof(ustore_key_t);
+    write.lengths = &length;
+    write.values = &value;
+
+    for (std::size_t first = 0; first < settings.records_count; first += batch_size_k) {
+        write.tasks_count = std::min(batch_size_k, settings.records_count - first);
+        std::iota(keys.begin(), keys.begin() + write.tasks_count, static_cast<ustore_key_t>(first));
+        ustore_write(&write);
+        status.throw_unhandled();
+    }
+    next_insert_key = settings.records_count;
+}
+
+/**
+ * @brief Runs a workload, where every iteration is a single batch of `state.range(0)` keys.
+ * Latency percentiles are measured per thread and averaged across threads.
+ */
+void ycsb(bm::State& state, ycsb_workload_t const& workload) {
+
+    status_t status;
+    arena_t arena(db);
+    auto const batch_size = static_cast<ustore_size_t>(state.range(0));
+    std::mt19937_64 generator(state.thread_index() + 1);
+    std::uniform_int_distribution<std::size_t> scan_lengths(1, settings.max_scan_length);
+    operations_mix_t mix(workload.weights);
+    keys_generator_t keys(workload.distribution, settings.records_count);
+    keys.grow(next_insert_key.load());
+    latency_histogram_t latencies;
+
+    // Pre-allocate space for our batches
+    std::vector<ustore_key_t> batch_keys(batch_size);
+    std::vector<ustore_length_t> batch_limits(batch_size);
+    auto value = reinterpret_cast<ustore_bytes_cptr_t>(value_bytes.data());
+    auto value_length = static_cast<ustore_length_t>(value_bytes.size());
+    ustore_length_t* found_lengths = nullptr;
+    ustore_length_t* found_counts = nullptr;
+    ustore_key_t* found_keys = nullptr;
+
+    // Define the shape of the tasks
+    ustore_read_t read {};
+    read.db = db;
+    read.error = status.member_ptr();
+    read.arena = arena.member_ptr();
+    read.tasks_count = batch_size;
+    read.keys = batch_keys.data();
+    read.keys_stride = sizeof(ustore_key_t);
+    read.lengths = &found_lengths;
+
+    ustore_write_t write {};
+    write.db = db;
+    write.error = status.member_ptr();
+    write.arena = arena.member_ptr();
+    write.tasks_count = batch_size;
+    write.keys = batch_keys.data();
+    write.keys_stride = sizeof(ustore_key_t);
+    write.lengths = &value_length;
+    write.values = &value;
+
+    ustore_scan_t scan {};
+    scan.db = db;
+    scan.error = status.member_ptr();
+    scan.arena = arena.member_ptr();
+    scan.tasks_count = batch_size;
+    scan.start_keys = batch_keys.data();
+    scan.start_keys_stride = sizeof(ustore_key_t);
+    scan.count_limits = batch_limits.data();
+    scan.count_limits_stride = sizeof(ustore_length_t);
+    scan.counts = &found_counts;
+    scan.keys = &found_keys;
+
+    // Run the benchmark
+    std::size_t batches_success = 0;
+    std::size_t batches_failed = 0;
+    for (auto _ : state) {
+
+        operation_t op = mix(generator);
+        if (op == operation_t::insert_k) {
+            std::size_t first = next_insert_key.fetch_add(batch_size, std::memory_order_relaxed);
+            std::iota(batch_keys.begin(), batch_keys.end(), static_cast<ustore_key_t>(first));
+            keys.grow(first + batch_size);
+        }
+        else
+            for (auto& key : batch_keys)
+                key = keys(generator);
+        if (op == operation_t::scan_k)
+            for (auto& limit : batch_limits)
+                limit = static_cast<ustore_length_t>(scan_lengths(generator));
+
+        auto start = std::chrono::steady_clock::now();
+        switch (op) {
+        case operation_t::read_k: ustore_read(&read); break;
+        case operation_t::update_k:
+        case operation_t::insert_k: ustore_write(&write); break;
+        case operation_t::scan_k: ustore_scan(&scan); break;
+        case operation_t::read_modify_write_k:
+            ustore_read(&read);
+            if (status)
+                ustore_write(&write);
+            break;
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+
+        if (!status) {
+            status.release_exception();
+            batches_failed += 1;
+            continue;
+        }
+        auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        latencies.record(static_cast<std::uint64_t>(nanoseconds));
+        batches_success += 1;
+    }
+
+    // These will be summed across threads:
+    state.counters["batches/s"] = bm::Counter(batches_success, bm::Counter::kIsRate);
+    state.counters["keys/s"] = bm::Counter(batches_success * batch_size, bm::Counter::kIsRate);
+    state.counters["fails"] = bm::Counter(batches_failed);
+
+    // These will be averaged across threads:
+    state.counters["p50,us"] = bm::Counter(latencies.percentile(0.5) / 1e3, bm::Counter::kAvgThreads);
+    state.counters["p99,us"] = bm::Counter(latencies.percentile(0.99) / 1e3, bm::Counter::kAvgThreads);
+    state.counters["p999,us"] = bm::Counter(latencies.percentile(0.999) / 1e3, bm::Counter::kAvgThreads);
+}
+
+int main(int argc, char** argv) {
+
+    parse_args(argc, argv, settings);
+
+    // Unless told otherwise, store the results next to the binary, to track them over time
+    std::vector<char*> bm_argv(argv, argv + argc);
+    std::string out_arg = fmt::format("--benchmark_out=ycsb_{}.json", USTORE_BENCH_CLIENT);
+    std::string out_format_arg = "--benchmark_out_format=json";
+    bool has_out = std::any_of(bm_argv.begin(), bm_argv.end(), [](char const* arg) {
+        return std::string_view(arg).rfind("--benchmark_out=", 0) == 0;
+    });
+    if (!has_out) {
+        bm_argv.push_back(out_arg.data());
+        bm_argv.push_back(out_format_arg.data());
+    }
+    int bm_argc = static_cast<int>(bm_argv.size());
+    bm::Initialize(&bm_argc, bm_argv.data());
+
+    bm::AddCustomContext("client", USTORE_BENCH_CLIENT);
+    bm::AddCustomContext("records", std::to_string(settings.records_count));
+    bm::AddCustomContext("value_size", std::to_string(settings.value_size));
+
+    db.open(settings.config_path.c_str()).throw_unhandled();
+    value_bytes.resize(settings.value_size);
+    std::mt19937_64 generator;
+    std::uniform_int_distribution<int> letters('a', 'z');
+    for (auto& byte : value_bytes)
+        byte = static_cast<char>(letters(generator));
+
+    std::printf("Will load %zu records...\n", settings.records_count);
+    load_records();
+
+    std::printf("Will benchmark...\n");
+    for (auto const& workload : workloads_k) {
+        auto benchmark = bm::RegisterBenchmark(workload.name, &ycsb, workload) //
+                             ->MinTime(settings.min_seconds)
+                             ->UseRealTime()
+                             ->ThreadRange(1, static_cast<int>(settings.threads_count));
+        for (auto batch_size : settings.batch_sizes)
+            benchmark->Arg(batch_size);
+    }
+
+    bm::RunSpecifiedBenchmarks();
+    bm::Shutdown();
+
+    // Clear DB after benchmark
+    db.clear().throw_unhandled();
+    db.close();
+    return 0;
+}
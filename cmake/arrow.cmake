@@ -54,6 +54,8 @@ ExternalProject_Add(
     -DARROW_FLIGHT_SQL=OFF
     -DARROW_WITH_UCX=OFF
     -DARROW_WITH_SNAPPY=ON
+    -DARROW_WITH_LZ4=ON
+    -DARROW_WITH_ZSTD=ON
     -DARROW_BUILD_UTILITIES=OFF
     -DARROW_GANDIVA=OFF
     -DARROW_S3=OFF
@@ -68,6 +70,8 @@ ExternalProject_Add(
     -Dabsl_SOURCE=BUNDLED
     -DProtobuf_SOURCE=BUNDLED
     -DSnappy_SOURCE=BUNDLED
+    -Dlz4_SOURCE=BUNDLED
+    -Dzstd_SOURCE=BUNDLED
     -DgRPC_SOURCE=BUNDLED
     -DZLIB_SOURCE=BUNDLED
     -DThrift_SOURCE=BUNDLED
@@ -21,11 +21,25 @@
 extern "C" {
 #endif
 
+#include <errno.h>    // `EIO`
 #include <inttypes.h> // `int64_t`
+#include <limits.h>   // `CHAR_BIT`
 #include <stdlib.h>   // `malloc`
+#include <string.h>   // `memset`
 
+#include "ustore/blobs.h"
 #include "ustore/docs.h"
 
+/**
+ * @brief Arrow type of the exported "keys" columns. 128-bit keys of
+ * `USTORE_USE_UUID` builds are exported as 16-byte fixed-size binaries.
+ */
+#if defined(USTORE_USE_UUID) && USTORE_USE_UUID
+#define ustore_doc_field_key_k ustore_doc_field_uuid_k
+#else
+#define ustore_doc_field_key_k ustore_doc_field_i64_k
+#endif
+
 #ifndef ARROW_C_DATA_INTERFACE
 #define ARROW_C_DATA_INTERFACE
 
@@ -321,28 +335,325 @@ static void ustore_to_arrow_list( //
 }
 
 /**
- * @brief Placeholder for future streaming exports.
+ * @brief State of a stream, exported by `ustore_to_arrow_stream()`.
+ * Points to the inputs of that call, which must outlive the stream.
+ */
+typedef struct ustore_arrow_stream_t {
+    ustore_database_t db;
+    ustore_transaction_t transaction;
+    ustore_snapshot_t snapshot;
+    ustore_length_t batch_size;
+
+    ustore_key_t start_key;
+    ustore_key_t end_key;
+    ustore_key_t next_key;
+
+    ustore_collection_t const* collections;
+    ustore_size_t collections_count;
+    ustore_size_t collection_idx;
+
+    ustore_str_view_t const* fields;
+    ustore_doc_field_type_t const* types;
+    ustore_size_t fields_count;
+
+    ustore_error_t error;
+} ustore_arrow_stream_t;
+
+/**
+ * @brief Every batch owns the arena, its buffers were exported into.
+ * That's how they are passed to Arrow without copies, and remain valid
+ * after the next batch is fetched.
+ */
+static void ustore_release_arrow_batch(struct ArrowArray* array) {
+    ustore_arena_t arena = (ustore_arena_t)array->private_data;
+    release_malloced_array(array);
+    ustore_arena_free(arena);
+}
+
+static int ustore_arrow_stream_fail(ustore_arrow_stream_t* state, ustore_error_t error) {
+    ustore_error_free(state->error);
+    state->error = error;
+    return EIO;
+}
+
+static bool ustore_arrow_stream_is_docs(ustore_arrow_stream_t const* state) {
+    return state->fields_count != 0;
+}
+
+static ustore_size_t ustore_arrow_stream_columns(ustore_arrow_stream_t const* state) {
+    return 1 + (ustore_arrow_stream_is_docs(state) ? state->fields_count : 1);
+}
+
+static int ustore_arrow_stream_get_schema(struct ArrowArrayStream* stream, struct ArrowSchema* schema) {
+    ustore_arrow_stream_t* state = (ustore_arrow_stream_t*)stream->private_data;
+    bool const is_docs = ustore_arrow_stream_is_docs(state);
+    ustore_size_t const columns_count = ustore_arrow_stream_columns(state);
+
+    // The columns are described by exporting an empty batch and dropping its data
+    struct ArrowArray array;
+    ustore_error_t error = NULL;
+    ustore_to_arrow_schema(0, columns_count, schema, &array, &error);
+    if (!error)
+        ustore_to_arrow_column(0, "keys", ustore_doc_field_key_k, NULL, NULL, NULL, //
+                               schema->children[0], array.children[0], &error);
+    for (ustore_size_t column_idx = 1; !error && column_idx != columns_count; ++column_idx) {
+        ustore_str_view_t name = is_docs ? state->fields[column_idx - 1] : "values";
+        ustore_doc_field_type_t type = is_docs ? state->types[column_idx - 1] : ustore_doc_field_bin_k;
+        ustore_to_arrow_column(0, name, type, NULL, NULL, NULL, //
+                               schema->children[column_idx], array.children[column_idx], &error);
+        // Missing values and fields are marked in the validity bitmaps of every batch
+        schema->children[column_idx]->flags = ARROW_FLAG_NULLABLE;
+    }
+    array.release(&array);
+    if (error) {
+        schema->release(schema);
+        return ustore_arrow_stream_fail(state, error);
+    }
+    return 0;
+}
+
+/**
+ * @brief Scans the next range of keys, moving to the next collection, once one is exhausted.
+ * @return The collection, the keys belong to, or `NULL` at the end of the stream.
+ */
+static ustore_collection_t const* ustore_arrow_stream_scan( //
+    ustore_arrow_stream_t* state,
+    ustore_arena_t* arena,
+    ustore_length_t* found_count,
+    ustore_key_t** found_keys,
+    ustore_error_t* error) {
+
+    *found_count = 0;
+    while (state->collection_idx != state->collections_count) {
+        ustore_collection_t const* collection = state->collections + state->collection_idx;
+        ustore_length_t* found_counts = NULL;
+        if (state->next_key < state->end_key) {
+            ustore_scan_t scan;
+            memset(&scan, 0, sizeof(scan));
+            scan.db = state->db;
+            scan.error = error;
+            scan.transaction = state->transaction;
+            scan.snapshot = state->snapshot;
+            scan.arena = arena;
+            scan.options = ustore_options_default_k;
+            scan.tasks_count = 1;
+            scan.collections = collection;
+            scan.start_keys = &state->next_key;
+            scan.end_keys = &state->end_key;
+            scan.count_limits = &state->batch_size;
+            scan.counts = &found_counts;
+            scan.keys = found_keys;
+            ustore_scan(&scan);
+            if (*error)
+                return NULL;
+            *found_count = found_counts[0];
+        }
+
+        // Short ranges can only come from exhausted collections,
+        // and unlike `end_key - 1`, this condition can't overflow
+        ustore_key_t const last_key = *found_count ? (*found_keys)[*found_count - 1] : state->end_key;
+        if (*found_count < state->batch_size || last_key >= state->end_key - 1) {
+            ++state->collection_idx;
+            state->next_key = state->start_key;
+        }
+        else
+            state->next_key = last_key + 1;
+        if (*found_count)
+            return collection;
+    }
+    return NULL;
+}
+
+static int ustore_arrow_stream_get_next(struct ArrowArrayStream* stream, struct ArrowArray* array) {
+    ustore_arrow_stream_t* state = (ustore_arrow_stream_t*)stream->private_data;
+    static ustore_length_t const zero_size_data = 0;
+    bool const is_docs = ustore_arrow_stream_is_docs(state);
+    ustore_size_t const columns_count = ustore_arrow_stream_columns(state);
+
+    // The end of the stream is marked with a released array
+    ustore_arena_t arena = NULL;
+    ustore_error_t error = NULL;
+    ustore_length_t found_count = 0;
+    ustore_key_t* found_keys = NULL;
+    array->release = NULL;
+    ustore_collection_t const* collection = ustore_arrow_stream_scan(state, &arena, &found_count, &found_keys, &error);
+    if (!collection) {
+        ustore_arena_free(arena);
+        return error ? ustore_arrow_stream_fail(state, error) : 0;
+    }
+
+    // The contents are fetched into the same arena, without discarding the keys
+    ustore_octet_t* found_presences = NULL;
+    ustore_length_t* found_offsets = NULL;
+    ustore_bytes_ptr_t found_values = NULL;
+    ustore_octet_t** validities = NULL;
+    ustore_byte_t** scalars = NULL;
+    ustore_length_t** offsets = NULL;
+    ustore_byte_t* strings = NULL;
+    if (is_docs) {
+        ustore_docs_gather_t gather;
+        memset(&gather, 0, sizeof(gather));
+        gather.db = state->db;
+        gather.error = &error;
+        gather.transaction = state->transaction;
+        gather.snapshot = state->snapshot;
+        gather.arena = &arena;
+        gather.options = ustore_option_dont_discard_memory_k;
+        gather.docs_count = found_count;
+        gather.fields_count = state->fields_count;
+        gather.collections = collection;
+        gather.keys = found_keys;
+        gather.keys_stride = sizeof(ustore_key_t);
+        gather.fields = state->fields;
+        gather.fields_stride = sizeof(ustore_str_view_t);
+        gather.types = state->types;
+        gather.types_stride = sizeof(ustore_doc_field_type_t);
+        gather.columns_validities = &validities;
+        gather.columns_scalars = &scalars;
+        gather.columns_offsets = &offsets;
+        gather.joined_strings = &strings;
+        ustore_docs_gather(&gather);
+    }
+    else {
+        ustore_read_t read;
+        memset(&read, 0, sizeof(read));
+        read.db = state->db;
+        read.error = &error;
+        read.transaction = state->transaction;
+        read.snapshot = state->snapshot;
+        read.arena = &arena;
+        read.options = ustore_option_dont_discard_memory_k;
+        read.tasks_count = found_count;
+        read.collections = collection;
+        read.keys = found_keys;
+        read.keys_stride = sizeof(ustore_key_t);
+        read.presences = &found_presences;
+        read.offsets = &found_offsets;
+        read.values = &found_values;
+        ustore_read(&read);
+    }
+    if (error) {
+        ustore_arena_free(arena);
+        return ustore_arrow_stream_fail(state, error);
+    }
+
+    // Link the buffers, leaving them in the arena
+    struct ArrowSchema schema;
+    ustore_to_arrow_schema(found_count, columns_count, &schema, array, &error);
+    if (!error)
+        ustore_to_arrow_column(found_count, "keys", ustore_doc_field_key_k, NULL, NULL, found_keys, //
+                               schema.children[0], array->children[0], &error);
+    if (!error && !is_docs)
+        ustore_to_arrow_column(found_count,
+                               "values",
+                               ustore_doc_field_bin_k,
+                               found_presences,
+                               found_offsets,
+                               found_values ? (void const*)found_values : (void const*)&zero_size_data,
+                               schema.children[1],
+                               array->children[1],
+                               &error);
+    for (ustore_size_t field_idx = 0; !error && is_docs && field_idx != state->fields_count; ++field_idx) {
+        ustore_doc_field_type_t const type = state->types[field_idx];
+        bool const is_variable_length = type == ustore_doc_field_str_k || type == ustore_doc_field_bin_k;
+        void const* contents = is_variable_length ? (void const*)strings : (void const*)scalars[field_idx];
+        ustore_to_arrow_column(found_count,
+                               state->fields[field_idx],
+                               type,
+                               validities[field_idx],
+                               is_variable_length ? offsets[field_idx] : NULL,
+                               contents ? contents : (void const*)&zero_size_data,
+                               schema.children[field_idx + 1],
+                               array->children[field_idx + 1],
+                               &error);
+    }
+    schema.release(&schema);
+    if (error) {
+        array->release(array);
+        ustore_arena_free(arena);
+        return ustore_arrow_stream_fail(state, error);
+    }
+
+    array->private_data = arena;
+    array->release = &ustore_release_arrow_batch;
+    return 0;
+}
+
+static char const* ustore_arrow_stream_get_last_error(struct ArrowArrayStream* stream) {
+    ustore_arrow_stream_t* state = (ustore_arrow_stream_t*)stream->private_data;
+    return state->error;
+}
+
+static void ustore_arrow_stream_release(struct ArrowArrayStream* stream) {
+    ustore_arrow_stream_t* state = (ustore_arrow_stream_t*)stream->private_data;
+    ustore_error_free(state->error);
+    free(state);
+    stream->release = NULL;
+}
+
+/**
+ * @brief Exports a range of keys from one or more collections as a stream of
+ * `arrow::RecordBatch`es, which DuckDB, Polars and PyArrow consume natively.
+ *
+ * Every `get_next` call scans the next @p batch_size keys in `[min_key, max_key)`,
+ * exhausting the @p collections one after another. Without @p fields, binary
+ * "keys" and "values" columns are exported, reading the blobs. With @p fields,
+ * those are gathered from the documents into columns of given @p types, after "keys".
+ *
+ * Each batch is exported into its own arena, freed once the batch is released.
+ * The @p collections, @p fields and @p types must outlive the stream and the batches.
  */
 static void ustore_to_arrow_stream( //
-    ustore_database_t const,
-    ustore_transaction_t const,
-    ustore_size_t const,
+    ustore_database_t const db,
+    ustore_transaction_t const transaction,
+    ustore_snapshot_t const snapshot,
 
-    ustore_size_t const,
-    ustore_key_t const,
-    ustore_key_t const,
+    ustore_size_t const batch_size,
+    ustore_key_t const min_key,
+    ustore_key_t const max_key,
 
-    ustore_collection_t const*,
-    ustore_size_t const,
+    ustore_collection_t const* collections,
+    ustore_size_t const collections_count,
 
-    ustore_str_view_t const*,
-    ustore_size_t const,
+    ustore_str_view_t const* fields,
+    ustore_doc_field_type_t const* types,
+    ustore_size_t const fields_count,
 
-    ustore_doc_field_type_t const*,
-    ustore_size_t const,
+    struct ArrowArrayStream* stream,
+    ustore_error_t* error) {
+
+    stream->release = NULL;
+    if (!batch_size || batch_size > ustore_length_missing_k) {
+        *error = "Batch size must be positive and fit into `ustore_length_t`";
+        return;
+    }
+
+    ustore_arrow_stream_t* state = (ustore_arrow_stream_t*)malloc(sizeof(ustore_arrow_stream_t));
+    if (!state) {
+        *error = "Failed to allocate memory";
+        return;
+    }
 
-    struct ArrowArrayStream*,
-    ustore_arena_t*) {
+    state->db = db;
+    state->transaction = transaction;
+    state->snapshot = snapshot;
+    state->batch_size = (ustore_length_t)batch_size;
+    state->start_key = min_key;
+    state->end_key = max_key;
+    state->next_key = min_key;
+    state->collections = collections;
+    state->collections_count = collections_count;
+    state->collection_idx = 0;
+    state->fields = fields;
+    state->types = types;
+    state->fields_count = fields_count;
+    state->error = NULL;
+
+    stream->get_schema = &ustore_arrow_stream_get_schema;
+    stream->get_next = &ustore_arrow_stream_get_next;
+    stream->get_last_error = &ustore_arrow_stream_get_last_error;
+    stream->release = &ustore_arrow_stream_release;
+    stream->private_data = state;
 }
 
 static bool check_presence(ustore_octet_t const* begin, size_t idx) {
@@ -0,0 +1,186 @@
+/**
+ * @file async.h
+ * @author Ashot Vardanian
+ * @addtogroup C
+ *
+ * @brief Binary Interface Standard for @b asynchronous requests.
+ *
+ * Any of the blocking calls, like `ustore_read()` or `ustore_docs_gather()`, can
+ * also be submitted into a queue, with the same argument structures. They are
+ * executed in the background, and their completions are either collected with
+ * `ustore_poll()` or delivered to a callback. That way a single event loop can
+ * keep many requests in flight, without running a thread per request.
+ *
+ * The request structures, their inputs, and their arenas must stay alive and
+ * unchanged, until the request is completed. Arenas can't be shared between
+ * requests, that are in flight at the same time.
+ */
+
+#pragma once
+
+#include "db.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Opaque multi-producer queue of submitted requests and their completions.
+ */
+typedef void* ustore_async_t;
+
+/**
+ * @brief Selects the function, that will be called with the submitted request,
+ * and the type of the structure, that the request points to.
+ */
+typedef enum {
+
+    ustore_async_read_k = 0,
+    ustore_async_write_k = 1,
+    ustore_async_scan_k = 2,
+    ustore_async_sample_k = 3,
+    ustore_async_measure_k = 4,
+
+    ustore_async_paths_write_k = 5,
+    ustore_async_paths_read_k = 6,
+    ustore_async_paths_match_k = 7,
+
+    ustore_async_docs_write_k = 8,
+    ustore_async_docs_read_k = 9,
+    ustore_async_docs_gist_k = 10,
+    ustore_async_docs_gather_k = 11,
+
+    ustore_async_graph_find_edges_k = 12,
+    ustore_async_graph_upsert_edges_k = 13,
+    ustore_async_graph_remove_edges_k = 14,
+    ustore_async_graph_upsert_vertices_k = 15,
+    ustore_async_graph_remove_vertices_k = 16,
+
+    ustore_async_vectors_write_k = 17,
+    ustore_async_vectors_read_k = 18,
+    ustore_async_vectors_search_k = 19,
+
+} ustore_async_kind_t;
+
+/**
+ * @brief Is called from a background thread, once the @p request is completed.
+ * Must not block for long, as it delays other requests in the queue.
+ */
+typedef void (*ustore_async_callback_t)(void* user_data, void* request, ustore_error_t error);
+
+/**
+ * @brief Creates a queue for asynchronous requests to a database.
+ * @see `ustore_async_init()`, `ustore_submit()`, `ustore_poll()`.
+ */
+typedef struct ustore_async_init_t {
+
+    /** @brief Already open database instance. */
+    ustore_database_t db;
+    /** @brief Pointer to exported error message. */
+    ustore_error_t* error;
+    /**
+     * @brief Number of background threads, serving the requests.
+     * Zero selects the number of hardware threads.
+     */
+    ustore_size_t threads_count;
+    /**
+     * @brief Maximum number of requests, that were submitted, but not yet
+     * polled or passed to their callbacks. Zero means unlimited.
+     */
+    ustore_size_t capacity;
+    /** @brief The created queue, unless `error` is filled. */
+    ustore_async_t* queue;
+
+} ustore_async_init_t;
+
+/**
+ * @brief Creates a queue for asynchronous requests to a database.
+ * @see `ustore_async_init_t`.
+ */
+void ustore_async_init(ustore_async_init_t*);
+
+/**
+ * @brief Enqueues a request for execution in the background.
+ * @see `ustore_submit()`.
+ */
+typedef struct ustore_submit_t {
+
+    /** @brief The queue, created with `ustore_async_init()`. */
+    ustore_async_t queue;
+    /** @brief Pointer to the submission error, like an overflowing queue. */
+    ustore_error_t* error;
+
+    /** @brief Type of the structure, that @p request points to. */
+    ustore_async_kind_t kind;
+    /**
+     * @brief Arguments structure for the blocking call, like `ustore_read_t`.
+     * Its own `error` member must not be NULL, as it receives the outcome.
+     */
+    void* request;
+    /** @brief Passed back with the completion. */
+    void* user_data;
+    /**
+     * @brief Optional. If set, the completion is passed to it, instead
+     * of being collected by `ustore_poll()`.
+     */
+    ustore_async_callback_t callback;
+
+} ustore_submit_t;
+
+/**
+ * @brief Enqueues a request for execution in the background.
+ * @see `ustore_submit_t`.
+ */
+void ustore_submit(ustore_submit_t*);
+
+/**
+ * @brief Outcome of a request, submitted without a callback.
+ */
+typedef struct ustore_completion_t {
+    ustore_async_kind_t kind;
+    void* request;
+    void* user_data;
+    /** @brief Copy of the error, exported by the request, or NULL on success. */
+    ustore_error_t error;
+} ustore_completion_t;
+
+/**
+ * @brief Collects the completed requests, that were submitted without callbacks.
+ * @see `ustore_poll()`.
+ */
+typedef struct ustore_poll_t {
+
+    /** @brief The queue, created with `ustore_async_init()`. */
+    ustore_async_t queue;
+    /** @brief Pointer to exported error message. */
+    ustore_error_t* error;
+
+    /**
+     * @brief Blocks until at least this many completions are ready,
+     * or until there are no more requests in flight. Zero never blocks.
+     */
+    ustore_size_t min_count;
+    /** @brief Number of slots in @p completions. */
+    ustore_size_t max_count;
+    /** @brief Caller-provided output buffer of `max_count` completions. */
+    ustore_completion_t* completions;
+    /** @brief Number of exported completions. */
+    ustore_size_t* count;
+
+} ustore_poll_t;
+
+/**
+ * @brief Collects the completed requests, that were submitted without callbacks.
+ * @see `ustore_poll_t`.
+ */
+void ustore_poll(ustore_poll_t*);
+
+/**
+ * @brief Waits for all the submitted requests to complete and releases the queue.
+ * Completions, that weren't polled, are discarded.
+ */
+void ustore_async_free(ustore_async_t);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
@@ -397,9 +397,10 @@ void ustore_read(ustore_read_t*);
  * @see `ustore_scan()`.
  *
  * Retrieves the following (upto) `count_limits[i]` keys starting
- * from `start_key[i]` or the smallest following key in each collection.
- * Values are not exported, for that - follow up with a `ustore_read()` or
- * a higher-level interface for Graphs, Docs or other modalities.
+ * from `start_key[i]` or the smallest following key in each collection,
+ * optionally stopping before `end_keys[i]`. Values are only exported,
+ * if `values` or `values_offsets` are requested. Fetching them during
+ * the same pass of the iterator is cheaper, than a following `ustore_read()`.
  *
  * ## Scans vs Iterators
  *
@@ -441,6 +442,7 @@ typedef struct ustore_scan_t {
      *
      * Possible values:
      * - `::ustore_option_scan_bulk_k`: Allows out-of-order retrieval for higher throughput.
+     * - `::ustore_option_scan_sequential_k`: Reads ahead, expecting long ranges.
      * - `::ustore_option_transaction_dont_watch_k`: Disables collision-detection for transactional reads.
      * - `::ustore_option_read_shared_memory_k`: Exports to shared memory to accelerate inter-process communication.
      * - `::ustore_option_dont_discard_memory_k`: Won't reset the `arena` before the operation begins.
@@ -490,6 +492,23 @@ typedef struct ustore_scan_t {
      * Is @b optional.
      */
     ustore_size_t start_keys_stride;
+    /**
+     * @brief Exclusive upper bounds for each scan.
+     *
+     * If `NULL` is passed, scans continue till the end of the collection or the `count_limits`.
+     * Bounds allow engines to stop early and to avoid reading past the needed range from disk.
+     * If multiple scan tasks are passed, the step between them is defined by `end_keys_stride`.
+     * Is @b optional.
+     */
+    ustore_key_t const* end_keys;
+    /**
+     * @brief Step between `end_keys`.
+     *
+     * Contains the number of bytes separating entries in the `end_keys` array.
+     * Zero stride would reuse the same address for all tasks.
+     * Is @b optional.
+     */
+    ustore_size_t end_keys_stride;
     /**
      * @brief Number of consecutive entries to read in each request.
      *
@@ -539,6 +558,20 @@ typedef struct ustore_scan_t {
      * runtime- or library-specific implementations.
      */
     ustore_key_t** keys;
+    /**
+     * @brief Output offsets of the values of exported `keys`.
+     *
+     * Will contain a pointer to an array with one more entry, than the total
+     * number of exported keys. Each marks the beginning of the value in `values`,
+     * so the length of the `i`-th value is `values_offsets[i+1] - values_offsets[i]`.
+     * Is @b optional.
+     */
+    ustore_length_t** values_offsets;
+    /**
+     * @brief Output values tape, in the same order as `keys`.
+     * Is @b optional.
+     */
+    ustore_byte_t** values;
     /// @}
 
 } ustore_scan_t;
@@ -585,6 +618,7 @@ typedef struct ustore_sample_t {
      *
      * Possible values:
      * - `::ustore_option_scan_bulk_k`: Allows out-of-order retrieval for higher throughput.
+     * - `::ustore_option_scan_sequential_k`: Reads ahead, expecting long ranges.
      * - `::ustore_option_transaction_dont_watch_k`: Disables collision-detection for transactional reads.
      * - `::ustore_option_read_shared_memory_k`: Exports to shared memory to accelerate inter-process communication.
      * - `::ustore_option_dont_discard_memory_k`: Won't reset the `arena` before the operation begins.
@@ -713,6 +747,7 @@ typedef struct ustore_measure_t {
      *
      * Possible values:
      * - `::ustore_option_scan_bulk_k`: Allows out-of-order retrieval for higher throughput.
+     * - `::ustore_option_scan_sequential_k`: Reads ahead, expecting long ranges.
      * - `::ustore_option_transaction_dont_watch_k`: Disables collision-detection for transactional reads.
      * - `::ustore_option_read_shared_memory_k`: Exports to shared memory to accelerate inter-process communication.
      * - `::ustore_option_dont_discard_memory_k`: Won't reset the `arena` before the operation begins.
@@ -800,6 +835,99 @@ typedef struct ustore_measure_t {
  */
 void ustore_measure(ustore_measure_t*);
 
+/**
+ * @brief Removes all the keys in half-open ranges `[start_keys[i], end_keys[i])`.
+ * @see `ustore_erase_range()`.
+ *
+ * Unlike the deletions with `ustore_write()`, doesn't need the keys upfront, and maps
+ * to the native range deletions, where available. Every range is removed atomically,
+ * but the whole batch is only atomic, if the engine supports transactions. Can't be
+ * issued from within a transaction.
+ */
+typedef struct ustore_erase_range_t {
+
+    /// @name Context
+    /// @{
+
+    /** @brief Already open database instance. */
+    ustore_database_t db;
+    /**
+     * @brief Pointer to exported error message.
+     * If not NULL, must be deallocated with `ustore_error_free()`.
+     */
+    ustore_error_t* error;
+    /**
+     * @brief Reusable memory handle.
+     * @see `ustore_arena_free()`.
+     */
+    ustore_arena_t* arena;
+    /**
+     * @brief Write options.
+     *
+     * Possible values:
+     * - `::ustore_option_write_flush_k`: Forces to persist the removal before returning.
+     * - `::ustore_option_dont_discard_memory_k`: Won't reset the `arena` before the operation begins.
+     */
+    ustore_options_t options;
+
+    /// @}
+    /// @name Inputs
+    /// @{
+
+    /**
+     * @brief Number of separate ranges packed in this call.
+     * Always equal to the number of provided `start_keys`.
+     */
+    ustore_size_t tasks_count;
+    /**
+     * @brief Sequence of collections owning the ranges.
+     *
+     * If `NULL` is passed, the default collection is assumed.
+     * If multiple collections are passed, the step between them is defined by `collections_stride`.
+     * Is @b optional.
+     */
+    ustore_collection_t const* collections;
+    /**
+     * @brief Step between `collections`.
+     *
+     * Contains the number of bytes separating entries in the `collections` array.
+     * Zero stride would reuse the same address for all tasks.
+     * Is @b optional.
+     */
+    ustore_size_t collections_stride;
+    /**
+     * @brief First keys of every range, which are removed as well.
+     * If multiple ranges are passed, the step between them is defined by `start_keys_stride`.
+     */
+    ustore_key_t const* start_keys;
+    /**
+     * @brief Step between `start_keys`.
+     * Zero stride would reuse the same address for all tasks.
+     * Is @b optional.
+     */
+    ustore_size_t start_keys_stride;
+    /**
+     * @brief Keys following the end of every range, which aren't removed.
+     * If multiple ranges are passed, the step between them is defined by `end_keys_stride`.
+     */
+    ustore_key_t const* end_keys;
+    /**
+     * @brief Step between `end_keys`.
+     * Zero stride would reuse the same address for all tasks.
+     * Is @b optional.
+     */
+    ustore_size_t end_keys_stride;
+
+    /// @}
+
+} ustore_erase_range_t;
+
+/**
+ * @brief Removes all the keys in the given ranges.
+ * @see `ustore_erase_range_t`.
+ */
+void ustore_erase_range(ustore_erase_range_t*);
+
 #ifdef __cplusplus
 } /* end extern "C" */
 #endif
@@ -0,0 +1,130 @@
+/**
+ * @file changes.h
+ * @author Ashot Vardanian
+ * @addtogroup C
+ *
+ * @brief Binary Interface Standard for the @b change-feed of committed writes.
+ *
+ * Lets downstream systems, like search clusters and caches, follow the updates
+ * incrementally, instead of re-scanning the collections. A subscription is a
+ * cursor, positioned after a sequence number. Every poll exports the following
+ * batch of `(collection, key, sequence, value-or-tombstone)` tuples.
+ *
+ * Sequence numbers are strictly increasing and survive restarts, so consumers
+ * can persist the last one they have applied and resume from it later. Engines
+ * only retain a bounded history, configured in the "change_feed" section of the
+ * engine config. Subscribing past the retained history fails, and the consumer
+ * has to re-synchronize with a full scan.
+ *
+ * The feed isn't enabled by default, as it costs an extra log of every write.
+ */
+
+#pragma once
+
+#include "db.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Opaque position in the change-feed of a specific database.
+ */
+typedef void* ustore_changes_t;
+
+typedef struct ustore_changes_subscribe_t {
+    /// @name Context
+    /// @{
+
+    /** @brief Already open database instance. */
+    ustore_database_t db;
+    /** @brief Pointer to exported error message. */
+    ustore_error_t* error;
+    /** @brief Reserved for future use. */
+    ustore_options_t options;
+
+    /// @}
+    /// @name Position
+    /// @{
+
+    /**
+     * @brief The last sequence number, already seen by the consumer.
+     * Only the later changes will be exported. Zero replays all the
+     * retained history.
+     */
+    ustore_sequence_number_t since;
+    /** @brief The new cursor, unless `error` is filled. */
+    ustore_changes_t* cursor;
+    /// @}
+
+} ustore_changes_subscribe_t;
+
+/**
+ * @brief Positions a cursor in the change-feed.
+ * @see `ustore_changes_subscribe_t`, `ustore_changes_free()`.
+ */
+void ustore_changes_subscribe(ustore_changes_subscribe_t*);
+
+typedef struct ustore_changes_poll_t {
+    /// @name Context
+    /// @{
+
+    /** @brief Already open database instance. */
+    ustore_database_t db;
+    /** @brief Pointer to exported error message. */
+    ustore_error_t* error;
+    /**
+     * @brief Reusable memory handle.
+     * @see `ustore_arena_free()`.
+     */
+    ustore_arena_t* arena;
+    /**
+     * @brief Polling options.
+     *
+     * Possible values:
+     * - `::ustore_option_dont_discard_memory_k`: Won't reset the `arena` before the operation begins.
+     */
+    ustore_options_t options;
+    /** @brief Cursor, created with `ustore_changes_subscribe()`. Is advanced past the exported changes. */
+    ustore_changes_t cursor;
+    /** @brief Upper bound for the number of exported changes. Zero selects a default of 4096. */
+    ustore_size_t count_limit;
+
+    /// @}
+    /// @name Outputs
+    /// @{
+
+    /** @brief Number of exported changes. Zero, if the consumer has caught up. */
+    ustore_size_t* count;
+    /** @brief Collections of the updated entries. */
+    ustore_collection_t** collections;
+    /** @brief Keys of the updated entries. */
+    ustore_key_t** keys;
+    /** @brief Strictly increasing sequence numbers of the changes. */
+    ustore_sequence_number_t** sequences;
+    /** @brief Bitset, where unset bits mark the removed entries. */
+    ustore_octet_t** presences;
+    /** @brief Offsets of the new values in the `values` tape. Has `count + 1` entries. */
+    ustore_length_t** offsets;
+    /** @brief Lengths of the new values, or `ustore_length_missing_k` for tombstones. */
+    ustore_length_t** lengths;
+    /** @brief Concatenated new values. */
+    ustore_bytes_ptr_t* values;
+    /// @}
+
+} ustore_changes_poll_t;
+
+/**
+ * @brief Exports the following changes after the cursor, without blocking.
+ * @see `ustore_changes_poll_t`.
+ */
+void ustore_changes_poll(ustore_changes_poll_t*);
+
+/**
+ * @brief Releases the cursor. Doesn't affect the history of changes.
+ */
+void ustore_changes_free(ustore_changes_t);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
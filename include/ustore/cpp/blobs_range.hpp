@@ -8,6 +8,11 @@
  */
 
 #pragma once
+#include <condition_variable> // `std::condition_variable`
+#include <memory>             // `std::unique_ptr`
+#include <mutex>              // `std::mutex`
+#include <new>                // `std::nothrow`
+
 #include "ustore/ustore.h"
 #include "ustore/cpp/ranges.hpp" // `indexed_range_gt`
 
@@ -20,6 +25,172 @@ struct pairs_range_t;
 struct size_range_t;
 struct size_estimates_t;
 
+/**
+ * @brief Background half of the double-buffered `keys_stream_t` and `pairs_stream_t`.
+ *
+ * Scans the next batch of keys, and optionally reads their values, into its own arena
+ * through the asynchronous API, while the stream consumes the previous batch. Once
+ * the batch is taken, the stream swaps the arenas, passing the exhausted one back.
+ *
+ * ## Class Specs
+ * - Concurrency: Must be used from a single thread, besides the queue itself.
+ * - Lifetime: Must live shorter then the queue. Waits for the request in flight.
+ * - Copyable: No. Movable: No, as the submitted requests point into it.
+ * - Exceptions: Never.
+ */
+class scan_prefetch_t {
+
+    ustore_async_t queue_ {nullptr};
+    ustore_collection_t collection_ {ustore_collection_main_k};
+    bool with_values_ {false};
+
+    arena_t arena_;
+    status_t status_;
+    ustore_scan_t scan_ {};
+    ustore_read_t read_ {};
+
+    ustore_key_t start_key_ {0};
+    ustore_length_t count_limit_ {0};
+    ustore_length_t* found_counts_ {nullptr};
+    ustore_key_t* found_keys_ {nullptr};
+    ustore_length_t* found_offsets_ {nullptr};
+    ustore_bytes_ptr_t found_values_ {nullptr};
+
+    std::mutex mutex_;
+    std::condition_variable finished_;
+    bool pending_ {false};
+    bool started_ {false};
+
+    bool submit(ustore_async_kind_t kind, void* request) noexcept {
+        ustore_submit_t submit {};
+        submit.queue = queue_;
+        submit.error = status_.member_ptr();
+        submit.kind = kind;
+        submit.request = request;
+        submit.user_data = this;
+        submit.callback = &on_completion;
+        ustore_submit(&submit);
+        return status_;
+    }
+
+    void finish() noexcept {
+        // Notifying under the lock, as the waiting thread may destroy this object right after
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_ = false;
+        finished_.notify_all();
+    }
+
+    static void on_completion(void* user_data, void* request, ustore_error_t) noexcept {
+        scan_prefetch_t& self = *reinterpret_cast<scan_prefetch_t*>(user_data);
+        bool const needs_values = request == &self.scan_ && self.status_ && self.with_values_ && *self.found_counts_;
+        if (needs_values) {
+            self.read_.tasks_count = *self.found_counts_;
+            self.read_.keys = self.found_keys_;
+            if (self.submit(ustore_async_read_k, &self.read_))
+                return;
+        }
+        self.finish();
+    }
+
+  public:
+    static constexpr ustore_length_t max_read_ahead_k = 64 * 1024;
+
+    scan_prefetch_t(ustore_database_t db,
+                    ustore_collection_t collection,
+                    ustore_transaction_t txn,
+                    ustore_async_t queue,
+                    bool with_values) noexcept
+        : queue_(queue), collection_(collection), with_values_(with_values), arena_(db) {
+
+        scan_.db = db;
+        scan_.error = status_.member_ptr();
+        scan_.transaction = txn;
+        scan_.arena = arena_.member_ptr();
+        scan_.tasks_count = 1;
+        scan_.collections = &collection_;
+        scan_.start_keys = &start_key_;
+        scan_.count_limits = &count_limit_;
+        scan_.counts = &found_counts_;
+        scan_.keys = &found_keys_;
+
+        read_.db = db;
+        read_.error = status_.member_ptr();
+        read_.transaction = txn;
+        read_.arena = arena_.member_ptr();
+        read_.options = ustore_option_dont_discard_memory_k;
+        read_.collections = &collection_;
+        read_.keys_stride = sizeof(ustore_key_t);
+        read_.offsets = &found_offsets_;
+        read_.values = &found_values_;
+    }
+
+    ~scan_prefetch_t() noexcept { join(); }
+
+    scan_prefetch_t(scan_prefetch_t const&) = delete;
+    scan_prefetch_t& operator=(scan_prefetch_t const&) = delete;
+
+    /**
+     * @brief Submits the scan of up to @p count_limit keys, starting from @p start_key.
+     * Must only be called, when no other fetch is in flight.
+     */
+    void start(ustore_key_t start_key, ustore_length_t count_limit) noexcept {
+        status_ = status_t {};
+        start_key_ = start_key;
+        count_limit_ = count_limit;
+        found_counts_ = nullptr;
+        found_keys_ = nullptr;
+        found_offsets_ = nullptr;
+        found_values_ = nullptr;
+        started_ = true;
+        pending_ = true;
+        if (!submit(ustore_async_scan_k, &scan_))
+            pending_ = false;
+    }
+
+    bool is_ready() noexcept {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return !pending_;
+    }
+
+    void join() noexcept {
+        std::unique_lock<std::mutex> lock(mutex_);
+        finished_.wait(lock, [&] { return !pending_; });
+    }
+
+    /**
+     * @brief Waits for the batch, starting at @p start_key, fetching it now, if it wasn't
+     * prefetched, and swaps its arena with the exhausted @p arena of the stream.
+     * Doubles the @p read_ahead, if the prefetched batch wasn't ready yet.
+     */
+    status_t take(ustore_key_t start_key, arena_t& arena, ustore_length_t& read_ahead) noexcept {
+        bool const was_prefetched = started_ && start_key_ == start_key;
+        if (!was_prefetched) {
+            join();
+            start(start_key, read_ahead);
+        }
+
+        bool const has_stalled = was_prefetched && !is_ready();
+        join();
+        started_ = false;
+        if (!status_)
+            return std::move(status_);
+
+        std::swap(arena, arena_);
+        if (has_stalled)
+            read_ahead = std::min<ustore_length_t>(read_ahead * 2, std::max(read_ahead, max_read_ahead_k));
+        return {};
+    }
+
+    ustore_length_t count_limit() const noexcept { return count_limit_; }
+
+    ptr_range_gt<ustore_key_t> keys() const noexcept {
+        return {found_keys_, found_keys_ + (found_counts_ ? *found_counts_ : 0)};
+    }
+    joined_blobs_t values() const noexcept {
+        return {found_counts_ ? *found_counts_ : 0, found_offsets_, found_values_};
+    }
+};
+
 /**
  * @brief Iterator (almost) over the keys in a single collection.
  *
@@ -28,9 +199,14 @@ struct size_estimates_t;
  * Unlike classical iterators, keeps an internal state,
  * which makes it @b non copy-constructible!
  *
+ * Given an asynchronous `queue`, the next batch is scanned in the background,
+ * while the current one is consumed, so range loops don't stall on batch boundaries.
+ * While the consumer outpaces the engine, the batches grow up to `max_read_ahead_k`.
+ *
  * ## Class Specs
  * - Concurrency: Must be used from a single thread!
- * - Lifetime: @b Must live shorter then the collection it belongs to.
+ *   With a `queue`, the transaction is also used from the background.
+ * - Lifetime: @b Must live shorter then the collection it belongs to, and the `queue`.
  * - Copyable: No.
  * - Exceptions: Never.
  */
@@ -46,6 +222,22 @@ class keys_stream_t {
     ustore_key_t next_min_key_ {std::numeric_limits<ustore_key_t>::min()};
     ptr_range_gt<ustore_key_t> fetched_keys_ {};
     std::size_t fetched_offset_ {0};
+    std::unique_ptr<scan_prefetch_t> background_ {};
+
+    status_t prefetch_in_background() noexcept {
+        status_t status = background_->take(next_min_key_, arena_, read_ahead_);
+        if (!status)
+            return status;
+
+        fetched_keys_ = background_->keys();
+        fetched_offset_ = 0;
+
+        auto count = static_cast<ustore_length_t>(fetched_keys_.size());
+        next_min_key_ = count < background_->count_limit() ? ustore_key_unknown_k : fetched_keys_[count - 1] + 1;
+        if (next_min_key_ != ustore_key_unknown_k)
+            background_->start(next_min_key_, read_ahead_);
+        return {};
+    }
 
     status_t prefetch() noexcept {
 
@@ -53,6 +245,8 @@ class keys_stream_t {
             ++fetched_offset_;
             return {};
         }
+        if (background_)
+            return prefetch_in_background();
 
         ustore_length_t* found_counts = nullptr;
         ustore_key_t* found_keys = nullptr;
@@ -91,11 +285,19 @@ class keys_stream_t {
 
     static constexpr std::size_t default_read_ahead_k = 256;
 
+    /**
+     * @param queue Optional asynchronous queue for background prefetching. If the prefetcher
+     *              can't be allocated, the stream silently falls back to blocking scans.
+     */
     keys_stream_t(ustore_database_t db,
                   ustore_collection_t collection = ustore_collection_main_k,
                   std::size_t read_ahead = keys_stream_t::default_read_ahead_k,
-                  ustore_transaction_t txn = nullptr) noexcept
-        : db_(db), collection_(collection), txn_(txn), arena_(db), read_ahead_(static_cast<ustore_size_t>(read_ahead)) {}
+                  ustore_transaction_t txn = nullptr,
+                  ustore_async_t queue = nullptr) noexcept
+        : db_(db), collection_(collection), txn_(txn), arena_(db), read_ahead_(static_cast<ustore_size_t>(read_ahead)) {
+        if (queue)
+            background_.reset(new (std::nothrow) scan_prefetch_t(db, collection, txn, queue, false));
+    }
 
     keys_stream_t(keys_stream_t&&) = default;
     keys_stream_t& operator=(keys_stream_t&&) = default;
@@ -184,6 +386,24 @@ class pairs_stream_t {
     joined_blobs_t values_view_ {};
     joined_blobs_iterator_t values_iterator_ {};
     std::size_t fetched_offset_ {0};
+    std::unique_ptr<scan_prefetch_t> background_ {};
+
+    status_t prefetch_in_background() noexcept {
+        status_t status = background_->take(next_min_key_, arena_, read_ahead_);
+        if (!status)
+            return status;
+
+        fetched_keys_ = background_->keys();
+        fetched_offset_ = 0;
+        values_view_ = background_->values();
+        values_iterator_ = values_view_.begin();
+
+        auto count = static_cast<ustore_length_t>(fetched_keys_.size());
+        next_min_key_ = count < background_->count_limit() ? ustore_key_unknown_k : fetched_keys_[count - 1] + 1;
+        if (next_min_key_ != ustore_key_unknown_k)
+            background_->start(next_min_key_, read_ahead_);
+        return {};
+    }
 
     status_t prefetch() noexcept {
 
@@ -191,6 +411,8 @@ class pairs_stream_t {
             ++fetched_offset_;
             return {};
         }
+        if (background_)
+            return prefetch_in_background();
 
         ustore_length_t* found_counts = nullptr;
         ustore_key_t* found_keys = nullptr;
@@ -247,12 +469,20 @@ class pairs_stream_t {
 
     static constexpr std::size_t default_read_ahead_k = 256;
 
+    /**
+     * @param queue Optional asynchronous queue, to scan and read the next batch in the background.
+     * @see `keys_stream_t`.
+     */
     pairs_stream_t( //
         ustore_database_t db,
         ustore_collection_t collection = ustore_collection_main_k,
         std::size_t read_ahead = pairs_stream_t::default_read_ahead_k,
-        ustore_transaction_t txn = nullptr) noexcept
-        : db_(db), collection_(collection), txn_(txn), arena_(db_), read_ahead_(static_cast<ustore_size_t>(read_ahead)) {}
+        ustore_transaction_t txn = nullptr,
+        ustore_async_t queue = nullptr) noexcept
+        : db_(db), collection_(collection), txn_(txn), arena_(db_), read_ahead_(static_cast<ustore_size_t>(read_ahead)) {
+        if (queue)
+            background_.reset(new (std::nothrow) scan_prefetch_t(db, collection, txn, queue, true));
+    }
 
     pairs_stream_t(pairs_stream_t&&) = default;
     pairs_stream_t& operator=(pairs_stream_t&&) = default;
@@ -365,12 +595,14 @@ class blobs_range_t {
     ustore_collection_t collection_;
     ustore_key_t min_key_;
     ustore_key_t max_key_;
+    ustore_async_t queue_ {nullptr};
 
     template <typename stream_at>
     expected_gt<stream_at> make_stream( //
         ustore_key_t target,
-        std::size_t read_ahead = keys_stream_t::default_read_ahead_k) noexcept {
-        stream_at stream {db_, collection_, read_ahead, txn_};
+        std::size_t read_ahead = keys_stream_t::default_read_ahead_k,
+        ustore_async_t queue = nullptr) noexcept {
+        stream_at stream {db_, collection_, read_ahead, txn_, queue};
         status_t status = stream.seek(target);
         return {std::move(status), std::move(stream)};
     }
@@ -395,7 +627,7 @@ class blobs_range_t {
     ustore_collection_t collection() const noexcept { return collection_; }
 
     expected_gt<keys_stream_t> keys_begin(std::size_t read_ahead = keys_stream_t::default_read_ahead_k) noexcept {
-        return make_stream<keys_stream_t>(min_key_, read_ahead);
+        return make_stream<keys_stream_t>(min_key_, read_ahead, queue_);
     }
 
     expected_gt<keys_stream_t> keys_end() noexcept {
@@ -403,7 +635,7 @@ class blobs_range_t {
     }
 
     expected_gt<pairs_stream_t> pairs_begin(std::size_t read_ahead = pairs_stream_t::default_read_ahead_k) noexcept {
-        return make_stream<pairs_stream_t>(min_key_, read_ahead);
+        return make_stream<pairs_stream_t>(min_key_, read_ahead, queue_);
     }
 
     expected_gt<pairs_stream_t> pairs_end() noexcept {
@@ -446,6 +678,25 @@ class blobs_range_t {
         return result;
     }
 
+    /**
+     * @brief Removes all the keys in `[min_key, max_key)` at once, without fetching them.
+     * Can't be used in transactions.
+     */
+    status_t erase() noexcept {
+        if (txn_)
+            return status_t::status_view("Range erasures can't be transactional");
+        status_t status;
+        ustore_erase_range_t erase {};
+        erase.db = db_;
+        erase.error = status.member_ptr();
+        erase.tasks_count = 1;
+        erase.collections = &collection_;
+        erase.start_keys = &min_key_;
+        erase.end_keys = &max_key_;
+        ustore_erase_range(&erase);
+        return status;
+    }
+
     blobs_range_t& since(ustore_key_t min_key) noexcept {
         min_key_ = min_key;
         return *this;
@@ -454,6 +705,14 @@ class blobs_range_t {
         max_key_ = max_key;
         return *this;
     }
+    /**
+     * @brief Makes the streams, starting at `min_key`, prefetch batches
+     * in the background through the asynchronous @p queue.
+     */
+    blobs_range_t& prefetch_with(ustore_async_t queue) noexcept {
+        queue_ = queue;
+        return *this;
+    }
 
     ustore_key_t min_key() noexcept { return min_key_; }
     ustore_key_t max_key() noexcept { return max_key_; }
@@ -465,6 +724,9 @@ struct keys_range_t {
 
     blobs_range_t members;
 
+    keys_range_t prefetch_with(ustore_async_t queue) const noexcept {
+        return {blobs_range_t(members).prefetch_with(queue)};
+    }
     keys_stream_t begin() noexcept(false) { return members.keys_begin().throw_or_release(); }
     keys_stream_t end() noexcept(false) { return members.keys_end().throw_or_release(); }
     std::size_t size() noexcept(false) {
@@ -507,6 +769,9 @@ struct pairs_range_t {
 
     blobs_range_t members;
 
+    pairs_range_t prefetch_with(ustore_async_t queue) const noexcept {
+        return {blobs_range_t(members).prefetch_with(queue)};
+    }
     pairs_stream_t begin() noexcept(false) { return members.pairs_begin().throw_or_release(); }
     pairs_stream_t end() noexcept(false) { return members.pairs_end().throw_or_release(); }
     std::size_t size() noexcept(false) {
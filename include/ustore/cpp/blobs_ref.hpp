@@ -13,6 +13,7 @@
 #include "ustore/cpp/status.hpp"     // `status_t`
 #include "ustore/cpp/sfinae.hpp"     // `location_store_gt`
 #include "ustore/cpp/docs_table.hpp" // `docs_table_t`
+#include "ustore/cpp/coroutines.hpp" // `read_awaitable_t`
 
 namespace unum::ustore {
 
@@ -138,6 +139,44 @@ class blobs_ref_gt {
         return assign(nullptr, flush);
     }
 
+#if defined(USTORE_CPP_COROUTINES)
+    /**
+     * @brief Awaitable lookup of a single key, that the `batching_scheduler_t`
+     * of this thread packs into one `ustore_read()` with the lookups of other coroutines.
+     */
+    read_awaitable_t value_async(bool watch = true) noexcept {
+        static_assert(is_one_k, "Batches are formed by the scheduler, await single keys");
+        return {request(!watch ? ustore_option_transaction_dont_watch_k : ustore_options_default_k)};
+    }
+
+    /**
+     * @brief Awaitable assignment of a single key, that the `batching_scheduler_t`
+     * of this thread packs into one `ustore_write()` with the writes of other coroutines.
+     * The @p value must stay alive, until the coroutine is resumed.
+     */
+    write_awaitable_t assign_async(value_view_t value, bool flush = false) noexcept {
+        static_assert(is_one_k, "Batches are formed by the scheduler, await single keys");
+        return {request(flush ? ustore_option_write_flush_k : ustore_options_default_k), value};
+    }
+
+  private:
+    blob_request_t request(ustore_options_t options) noexcept {
+        decltype(auto) locs = locations_.ref();
+        auto keys = keys_extractor_t {}.keys(locs);
+        auto collections = keys_extractor_t {}.collections(locs);
+        blob_request_t request;
+        request.db = db_;
+        request.txn = txn_;
+        request.snap = snap_;
+        request.options = options;
+        request.collection = collections ? collections[0] : ustore_collection_main_k;
+        request.key = keys[0];
+        return request;
+    }
+
+  public:
+#endif
+
     /**
      * @brief Keeps the keys, but clears the contents of associated values.
      * @param flush Pass true, if you need the data to be persisted before returning.
@@ -0,0 +1,414 @@
+/**
+ * @file coroutines.hpp
+ * @author Ashot Vardanian
+ * @addtogroup Cpp
+ *
+ * @brief Awaitable single-key reads and writes, micro-batched across coroutines.
+ *
+ * Request handlers are easiest to write per key, but the engines are fastest, when
+ * they receive large batches. With C++20 coroutines, both are possible: every handler
+ * is a `task_t`, that `co_await`s `collection[key].value_async()`, and the
+ * `batching_scheduler_t` of the thread coalesces the awaits of all the coroutines
+ * into single `ustore_write()` and `ustore_read()` calls.
+ *
+ * The rest of the SDK targets C++17, so this header is empty, unless the compiler
+ * supports coroutines, like in `-std=c++20` builds.
+ */
+
+#pragma once
+#if defined(__cpp_impl_coroutine)
+#include <algorithm> // `std::max`
+#include <chrono>    // `std::chrono::steady_clock`
+#include <coroutine> // `std::coroutine_handle`
+#include <deque>     // `std::deque`
+#include <exception> // `std::exception_ptr`
+#include <utility>   // `std::exchange`
+#include <vector>    // `std::vector`
+
+#include "ustore/ustore.h"
+#include "ustore/cpp/types.hpp"  // `arena_t`
+#include "ustore/cpp/status.hpp" // `status_t`
+
+#define USTORE_CPP_COROUTINES 1
+
+namespace unum::ustore {
+
+class batching_scheduler_t;
+
+/**
+ * @brief Fire-and-forget coroutine, started with `batching_scheduler_t::spawn()`.
+ * Exceptions escaping the coroutine are re-thrown from `batching_scheduler_t::run()`.
+ */
+class task_t {
+  public:
+    struct promise_type;
+    using handle_t = std::coroutine_handle<promise_type>;
+
+    struct promise_type {
+        std::exception_ptr exception;
+
+        task_t get_return_object() noexcept { return task_t {handle_t::from_promise(*this)}; }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { exception = std::current_exception(); }
+    };
+
+  private:
+    handle_t handle_;
+
+  public:
+    explicit task_t(handle_t handle) noexcept : handle_(handle) {}
+    task_t(task_t&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+    task_t& operator=(task_t&& other) noexcept {
+        std::swap(handle_, other.handle_);
+        return *this;
+    }
+    task_t(task_t const&) = delete;
+    task_t& operator=(task_t const&) = delete;
+    ~task_t() noexcept {
+        if (handle_)
+            handle_.destroy();
+    }
+
+    handle_t release() noexcept { return std::exchange(handle_, nullptr); }
+};
+
+/**
+ * @brief Binary values, that will be read or written in the next batch.
+ * Describes a single key, the way `blobs_ref_gt` does it.
+ */
+struct blob_request_t {
+    ustore_database_t db {nullptr};
+    ustore_transaction_t txn {nullptr};
+    ustore_snapshot_t snap {0};
+    ustore_options_t options {ustore_options_default_k};
+    ustore_collection_t collection {ustore_collection_main_k};
+    ustore_key_t key {ustore_key_unknown_k};
+};
+
+class read_awaitable_t;
+class write_awaitable_t;
+
+/**
+ * @brief Runs coroutines on the calling thread, deferring their reads and writes,
+ * until a batch of `max_batch_size` requests is collected, `max_delay` passes since
+ * the oldest of them, or none of the coroutines can move on without their results.
+ *
+ * Within a batch, writes are applied before reads, and requests to the same database,
+ * transaction, snapshot and with the same options, are passed to a single call.
+ * The values read are valid, until the coroutine awaits the scheduler again. So batches
+ * may outgrow `max_batch_size`, while the coroutines resumed by the last flush still run.
+ *
+ * ## Class Specs
+ * - Concurrency: One scheduler per thread. Coroutines must not migrate.
+ * - Lifetime: Must outlive the spawned coroutines.
+ * - Copyable: No.
+ * - Exceptions: `spawn()` and `run()` may throw `std::bad_alloc`, or the exceptions of the tasks.
+ */
+class batching_scheduler_t {
+
+    friend class read_awaitable_t;
+    friend class write_awaitable_t;
+    using steady_clock_t = std::chrono::steady_clock;
+
+    std::size_t max_batch_size_;
+    std::chrono::microseconds max_delay_;
+    steady_clock_t::time_point oldest_request_ {};
+
+    std::deque<task_t::handle_t> ready_;
+    std::size_t resumes_before_flush_ {0};
+    std::vector<read_awaitable_t*> reads_;
+    std::vector<write_awaitable_t*> writes_;
+
+    arena_t arena_ {nullptr};
+    std::vector<status_t> errors_;
+    std::vector<ustore_collection_t> collections_;
+    std::vector<ustore_key_t> keys_;
+    std::vector<ustore_bytes_cptr_t> contents_;
+    std::vector<ustore_length_t> lengths_;
+
+    static batching_scheduler_t*& current_ref() noexcept {
+        static thread_local batching_scheduler_t* current = nullptr;
+        return current;
+    }
+
+    std::size_t pending_count() const noexcept { return reads_.size() + writes_.size(); }
+
+    bool is_due() const noexcept {
+        std::size_t count = pending_count();
+        return count >= max_batch_size_ || (count && steady_clock_t::now() - oldest_request_ >= max_delay_);
+    }
+
+    void enqueue(read_awaitable_t* read) noexcept(false);
+    void enqueue(write_awaitable_t* write) noexcept(false);
+    void flush_writes() noexcept(false);
+    void flush_reads() noexcept(false);
+
+    static bool same_group(blob_request_t const& a, blob_request_t const& b) noexcept {
+        return a.db == b.db && a.txn == b.txn && a.snap == b.snap && a.options == b.options;
+    }
+
+    void resume(task_t::handle_t handle) noexcept(false) {
+        handle.resume();
+        if (!handle.done())
+            return;
+        std::exception_ptr exception = handle.promise().exception;
+        handle.destroy();
+        if (exception)
+            std::rethrow_exception(exception);
+    }
+
+  public:
+    static constexpr std::size_t default_max_batch_size_k = 256;
+    static constexpr std::chrono::microseconds default_max_delay_k {100};
+
+    batching_scheduler_t(std::size_t max_batch_size = default_max_batch_size_k,
+                         std::chrono::microseconds max_delay = default_max_delay_k) noexcept
+        : max_batch_size_(std::max<std::size_t>(max_batch_size, 1)), max_delay_(max_delay) {}
+
+    batching_scheduler_t(batching_scheduler_t const&) = delete;
+    batching_scheduler_t& operator=(batching_scheduler_t const&) = delete;
+
+    ~batching_scheduler_t() noexcept;
+
+    /**
+     * @brief The scheduler, that is running on this thread, or `nullptr`.
+     */
+    static batching_scheduler_t* current() noexcept { return current_ref(); }
+
+    void spawn(task_t task) noexcept(false) {
+        if (task_t::handle_t handle = task.release(); handle)
+            ready_.push_back(handle);
+    }
+
+    /**
+     * @brief Submits the collected requests, resuming the coroutines, that awaited them.
+     * Errors are shared by all the requests in a failed call, and are kept until the next flush.
+     */
+    void flush() noexcept(false) {
+        errors_.clear();
+        flush_writes();
+        flush_reads();
+        // The arena and the errors can't be reused, until every resumed coroutine runs
+        resumes_before_flush_ = ready_.size();
+    }
+
+    /**
+     * @brief Runs the spawned coroutines, until all of them are finished.
+     */
+    void run() noexcept(false) {
+        batching_scheduler_t* previous = std::exchange(current_ref(), this);
+        try {
+            while (!ready_.empty() || pending_count()) {
+                while (!ready_.empty()) {
+                    if (!resumes_before_flush_ && is_due())
+                        flush();
+                    task_t::handle_t handle = ready_.front();
+                    ready_.pop_front();
+                    resumes_before_flush_ -= resumes_before_flush_ != 0;
+                    resume(handle);
+                }
+                if (pending_count())
+                    flush();
+            }
+        }
+        catch (...) {
+            current_ref() = previous;
+            throw;
+        }
+        current_ref() = previous;
+    }
+};
+
+/**
+ * @brief Result of `blobs_ref_gt::value_async()`.
+ * Resolves into the value, or a missing value, if the key isn't present.
+ */
+class read_awaitable_t {
+    friend class batching_scheduler_t;
+
+    blob_request_t request_;
+    task_t::handle_t waiter_ {};
+    status_t status_;
+    value_view_t value_;
+
+  public:
+    read_awaitable_t(blob_request_t request) noexcept : request_(request) {}
+
+    bool await_ready() noexcept {
+        if (batching_scheduler_t::current())
+            return false;
+        status_ = status_t::status_view("Awaiting UStore requires a running `batching_scheduler_t`");
+        return true;
+    }
+    void await_suspend(task_t::handle_t waiter) noexcept(false) {
+        waiter_ = waiter;
+        batching_scheduler_t::current()->enqueue(this);
+    }
+    expected_gt<value_view_t> await_resume() noexcept { return {std::move(status_), value_view_t(value_)}; }
+};
+
+/**
+ * @brief Result of `blobs_ref_gt::assign_async()`.
+ * Resolves into the status of the call, it was batched into.
+ * Missing values erase the key. Present values must live until resumed.
+ */
+class write_awaitable_t {
+    friend class batching_scheduler_t;
+
+    blob_request_t request_;
+    value_view_t value_;
+    task_t::handle_t waiter_ {};
+    status_t status_;
+
+  public:
+    write_awaitable_t(blob_request_t request, value_view_t value) noexcept : request_(request), value_(value) {}
+
+    bool await_ready() noexcept {
+        if (batching_scheduler_t::current())
+            return false;
+        status_ = status_t::status_view("Awaiting UStore requires a running `batching_scheduler_t`");
+        return true;
+    }
+    void await_suspend(task_t::handle_t waiter) noexcept(false) {
+        waiter_ = waiter;
+        batching_scheduler_t::current()->enqueue(this);
+    }
+    status_t await_resume() noexcept { return std::move(status_); }
+};
+
+inline batching_scheduler_t::~batching_scheduler_t() noexcept {
+    for (auto handle : ready_)
+        handle.destroy();
+    for (auto read : reads_)
+        read->waiter_.destroy();
+    for (auto write : writes_)
+        write->waiter_.destroy();
+}
+
+inline void batching_scheduler_t::enqueue(read_awaitable_t* read) noexcept(false) {
+    if (!pending_count())
+        oldest_request_ = steady_clock_t::now();
+    reads_.push_back(read);
+}
+
+inline void batching_scheduler_t::enqueue(write_awaitable_t* write) noexcept(false) {
+    if (!pending_count())
+        oldest_request_ = steady_clock_t::now();
+    writes_.push_back(write);
+}
+
+inline void batching_scheduler_t::flush_writes() noexcept(false) {
+    std::vector<write_awaitable_t*> batch = std::move(writes_);
+    writes_.clear();
+
+    // Split the batch into groups, that can be passed to a single call
+    for (std::size_t group_begin = 0; group_begin != batch.size();) {
+        blob_request_t const& first = batch[group_begin]->request_;
+        std::size_t group_end = group_begin + 1;
+        while (group_end != batch.size() && same_group(first, batch[group_end]->request_))
+            ++group_end;
+
+        collections_.clear();
+        keys_.clear();
+        contents_.clear();
+        lengths_.clear();
+        for (std::size_t idx = group_begin; idx != group_end; ++idx) {
+            write_awaitable_t const& write = *batch[idx];
+            collections_.push_back(write.request_.collection);
+            keys_.push_back(write.request_.key);
+            contents_.push_back(reinterpret_cast<ustore_bytes_cptr_t>(write.value_.data()));
+            lengths_.push_back(write.value_ ? static_cast<ustore_length_t>(write.value_.size())
+                                            : ustore_length_missing_k);
+        }
+
+        status_t status;
+        ustore_write_t c {};
+        c.db = first.db;
+        c.error = status.member_ptr();
+        c.transaction = first.txn;
+        c.arena = arena_.member_ptr();
+        c.options = first.options;
+        c.tasks_count = keys_.size();
+        c.collections = collections_.data();
+        c.collections_stride = sizeof(ustore_collection_t);
+        c.keys = keys_.data();
+        c.keys_stride = sizeof(ustore_key_t);
+        c.values = contents_.data();
+        c.values_stride = sizeof(ustore_bytes_cptr_t);
+        c.lengths = lengths_.data();
+        c.lengths_stride = sizeof(ustore_length_t);
+        ustore_write(&c);
+
+        if (!status)
+            errors_.push_back(std::move(status));
+        for (std::size_t idx = group_begin; idx != group_end; ++idx) {
+            write_awaitable_t& write = *batch[idx];
+            write.status_ = status ? status_t {} : status_t::status_view(errors_.back().message());
+            ready_.push_back(write.waiter_);
+        }
+        group_begin = group_end;
+    }
+}
+
+inline void batching_scheduler_t::flush_reads() noexcept(false) {
+    std::vector<read_awaitable_t*> batch = std::move(reads_);
+    reads_.clear();
+    if (batch.empty())
+        return;
+
+    // The arena is shared by all the groups, so only the first one discards
+    // the values of the previous flush, and the others append to it
+    for (std::size_t group_begin = 0; group_begin != batch.size();) {
+        blob_request_t const& first = batch[group_begin]->request_;
+        std::size_t group_end = group_begin + 1;
+        while (group_end != batch.size() && same_group(first, batch[group_end]->request_))
+            ++group_end;
+
+        collections_.clear();
+        keys_.clear();
+        for (std::size_t idx = group_begin; idx != group_end; ++idx) {
+            collections_.push_back(batch[idx]->request_.collection);
+            keys_.push_back(batch[idx]->request_.key);
+        }
+
+        status_t status;
+        ustore_length_t* found_offsets = nullptr;
+        ustore_length_t* found_lengths = nullptr;
+        ustore_bytes_ptr_t found_values = nullptr;
+        ustore_read_t c {};
+        c.db = first.db;
+        c.error = status.member_ptr();
+        c.transaction = first.txn;
+        c.snapshot = first.snap;
+        c.arena = arena_.member_ptr();
+        c.options = group_begin ? ustore_options_t(first.options | ustore_option_dont_discard_memory_k) : first.options;
+        c.tasks_count = keys_.size();
+        c.collections = collections_.data();
+        c.collections_stride = sizeof(ustore_collection_t);
+        c.keys = keys_.data();
+        c.keys_stride = sizeof(ustore_key_t);
+        c.offsets = &found_offsets;
+        c.lengths = &found_lengths;
+        c.values = &found_values;
+        ustore_read(&c);
+
+        if (!status)
+            errors_.push_back(std::move(status));
+        for (std::size_t idx = group_begin; idx != group_end; ++idx) {
+            read_awaitable_t& read = *batch[idx];
+            std::size_t task_idx = idx - group_begin;
+            if (status)
+                read.value_ = value_view_t {found_values + found_offsets[task_idx], found_lengths[task_idx]};
+            else
+                read.status_ = status_t::status_view(errors_.back().message());
+            ready_.push_back(read.waiter_);
+        }
+        group_begin = group_end;
+    }
+}
+
+} // namespace unum::ustore
+
+#endif // defined(__cpp_impl_coroutine)
@@ -330,6 +330,11 @@ class database_t : public std::enable_shared_from_this<database_t> {
         return metadata & ustore_supports_snapshots_k;
     }
 
+    bool supports_merges() {
+        ustore_metadata_t metadata = get_metadata();
+        return metadata & ustore_supports_merges_k;
+    }
+
     expected_gt<context_t> transact() noexcept {
 
         status_t status {};
@@ -14,6 +14,14 @@
 
 namespace unum::ustore {
 
+/**
+ * @brief Columns of edge attributes, matching the edges exported by `graph_collection_t`.
+ */
+struct edges_attributes_t {
+    ptr_range_gt<std::int64_t> timestamps;
+    ptr_range_gt<ustore_float_t> weights;
+};
+
 /**
  * @brief Wraps relational/linking operations with cleaner type system.
  * Controls mainly just the inverted index collection and keeps a local
@@ -58,7 +66,13 @@ class graph_collection_t {
         return status;
     }
 
-    status_t upsert_edges(edges_view_t const& edges) noexcept {
+    /**
+     * @brief Upserts the @p edges, optionally assigning their @p weights and @p timestamps.
+     * Existing edges, upserted without attributes, keep the old ones.
+     */
+    status_t upsert_edges(edges_view_t const& edges,
+                          strided_range_gt<ustore_float_t const> weights = {},
+                          strided_range_gt<std::int64_t const> timestamps = {}) noexcept {
         status_t status;
 
         ustore_graph_upsert_edges_t graph_upsert_edges {};
@@ -74,6 +88,10 @@ class graph_collection_t {
         graph_upsert_edges.sources_stride = edges.source_ids.stride();
         graph_upsert_edges.targets_ids = edges.target_ids.begin().get();
         graph_upsert_edges.targets_stride = edges.target_ids.stride();
+        graph_upsert_edges.timestamps = timestamps.begin().get();
+        graph_upsert_edges.timestamps_stride = timestamps.stride();
+        graph_upsert_edges.weights = weights.begin().get();
+        graph_upsert_edges.weights_stride = weights.stride();
 
         ustore_graph_upsert_edges(&graph_upsert_edges);
         return status;
@@ -227,6 +245,77 @@ class graph_collection_t {
         return ptr_range_gt<ustore_vertex_degree_t> {degrees_per_vertex, degrees_per_vertex + vertices.size()};
     }
 
+    expected_gt<bool> contains_edge(ustore_key_t source, ustore_key_t target, bool watch = true) noexcept {
+        auto maybe_presences = contains_edges({{&source}, 1}, {{&target}, 1}, {}, watch);
+        if (!maybe_presences)
+            return maybe_presences.release_status();
+        return bool((*maybe_presences)[0]);
+    }
+
+    /**
+     * @brief Checks if edges exist between pairs of vertices, without exporting them.
+     * If @p edges_ids are skipped, any edge between the vertices will match.
+     */
+    expected_gt<bits_span_t> contains_edges( //
+        strided_range_gt<ustore_key_t const> sources,
+        strided_range_gt<ustore_key_t const> targets,
+        strided_range_gt<ustore_key_t const> edges_ids = {},
+        bool watch = true) noexcept {
+
+        status_t status;
+        ustore_octet_t* presences = nullptr;
+
+        ustore_graph_contains_edges_t graph_contains_edges {};
+        graph_contains_edges.db = db_;
+        graph_contains_edges.error = status.member_ptr();
+        graph_contains_edges.transaction = transaction_;
+        graph_contains_edges.snapshot = snapshot_;
+        graph_contains_edges.arena = arena_;
+        graph_contains_edges.options = !watch ? ustore_option_transaction_dont_watch_k : ustore_options_default_k;
+        graph_contains_edges.tasks_count = sources.count();
+        graph_contains_edges.collections = &collection_;
+        graph_contains_edges.edges_ids = edges_ids.begin().get();
+        graph_contains_edges.edges_stride = edges_ids.stride();
+        graph_contains_edges.sources_ids = sources.begin().get();
+        graph_contains_edges.sources_stride = sources.stride();
+        graph_contains_edges.targets_ids = targets.begin().get();
+        graph_contains_edges.targets_stride = targets.stride();
+        graph_contains_edges.presences = &presences;
+
+        ustore_graph_contains_edges(&graph_contains_edges);
+        if (!status)
+            return status;
+        return bits_span_t {presences};
+    }
+
+    /**
+     * @brief Materializes the whole graph into a Compressed Sparse Row form.
+     * The result lives in the arena of this collection, unless the @p path is given,
+     * in which case it must be released with `ustore_graph_free_csr()`.
+     */
+    expected_gt<ustore_graph_csr_t> csr( //
+        ustore_vertex_role_t role = ustore_vertex_source_k,
+        ustore_str_view_t path = nullptr) noexcept {
+
+        status_t status;
+        ustore_graph_csr_t csr {};
+        ustore_graph_export_csr_t graph_export_csr {};
+        graph_export_csr.db = db_;
+        graph_export_csr.error = status.member_ptr();
+        graph_export_csr.transaction = transaction_;
+        graph_export_csr.snapshot = snapshot_;
+        graph_export_csr.arena = arena_;
+        graph_export_csr.collection = collection_;
+        graph_export_csr.role = role;
+        graph_export_csr.path = path;
+        graph_export_csr.csr = &csr;
+
+        ustore_graph_export_csr(&graph_export_csr);
+        if (!status)
+            return status;
+        return csr;
+    }
+
     expected_gt<bool> contains(ustore_key_t vertex, bool watch = true) noexcept {
         return blobs_ref_gt<collection_key_field_t>(db_, transaction_, snapshot_, ckf(collection_, vertex), arena_)
             .present(watch);
@@ -248,16 +337,16 @@ class graph_collection_t {
 
     expected_gt<keys_stream_t> vertex_stream(
         std::size_t vertices_read_ahead = keys_stream_t::default_read_ahead_k) const noexcept {
-        blobs_range_t members(db_, transaction_, snapshot_, collection_);
+        blobs_range_t members(db_, transaction_, snapshot_, collection_, ustore_vertex_id_min_k);
         keys_range_t range {members};
         keys_stream_t stream = range.begin();
-        if (auto status = stream.seek_to_first(); !status)
+        if (auto status = stream.seek(ustore_vertex_id_min_k); !status)
             return {std::move(status), {db_}};
         return stream;
     }
 
     std::size_t number_of_vertices() noexcept(false) {
-        blobs_range_t members(db_, transaction_, snapshot_, collection_);
+        blobs_range_t members(db_, transaction_, snapshot_, collection_, ustore_vertex_id_min_k);
         keys_range_t range {members};
         return range.size();
     }
@@ -333,6 +422,51 @@ class graph_collection_t {
         return edges_span_t {edges_begin, edges_begin + edges_count};
     }
 
+    /**
+     * @brief Exports the attributes of the edges of a @p vertex, in the order of `edges_containing()`.
+     */
+    expected_gt<edges_attributes_t> edges_attributes( //
+        ustore_key_t vertex,
+        ustore_vertex_role_t role = ustore_vertex_role_any_k,
+        bool watch = true) noexcept {
+
+        status_t status {};
+        ustore_vertex_degree_t* degrees_per_vertex {};
+        ustore_key_t* edges_per_vertex {};
+        std::int64_t* timestamps_per_edge {};
+        ustore_float_t* weights_per_edge {};
+
+        ustore_graph_find_edges_t graph_find_edges {};
+        graph_find_edges.db = db_;
+        graph_find_edges.error = status.member_ptr();
+        graph_find_edges.transaction = transaction_;
+        graph_find_edges.snapshot = snapshot_;
+        graph_find_edges.arena = arena_;
+        graph_find_edges.options = !watch ? ustore_option_transaction_dont_watch_k : ustore_options_default_k;
+        graph_find_edges.tasks_count = 1;
+        graph_find_edges.collections = &collection_;
+        graph_find_edges.vertices = &vertex;
+        graph_find_edges.roles = &role;
+        graph_find_edges.degrees_per_vertex = &degrees_per_vertex;
+        graph_find_edges.edges_per_vertex = &edges_per_vertex;
+        graph_find_edges.timestamps_per_edge = &timestamps_per_edge;
+        graph_find_edges.weights_per_edge = &weights_per_edge;
+
+        ustore_graph_find_edges(&graph_find_edges);
+
+        if (!status)
+            return status;
+
+        ustore_vertex_degree_t edges_count = degrees_per_vertex[0];
+        if (edges_count == ustore_vertex_degree_missing_k)
+            return edges_attributes_t {};
+
+        return edges_attributes_t {
+            {timestamps_per_edge, timestamps_per_edge + edges_count},
+            {weights_per_edge, weights_per_edge + edges_count},
+        };
+    }
+
     expected_gt<edges_span_t> edges_between(ustore_key_t source, ustore_key_t target, bool watch = true) noexcept {
         auto maybe_all = edges_containing(source, ustore_vertex_source_k, watch);
         if (!maybe_all)
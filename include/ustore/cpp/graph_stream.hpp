@@ -130,7 +130,7 @@ class graph_stream_t {
 
     edge_t edge() const noexcept { return fetched_edges_[fetched_offset_]; }
     edge_t operator*() const noexcept { return edge(); }
-    status_t seek_to_first() noexcept { return seek(std::numeric_limits<ustore_key_t>::min()); }
+    status_t seek_to_first() noexcept { return seek(ustore_vertex_id_min_k); }
     status_t seek_to_next_batch() noexcept {
         auto status = vertex_stream_.seek_to_next_batch();
         if (!status)
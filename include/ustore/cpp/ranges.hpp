@@ -110,6 +110,73 @@ class strided_iterator_gt {
     }
 };
 
+/**
+ * @brief Layouts of strided arguments, that can be resolved at compile time.
+ * - "Contiguous": the stride matches `sizeof(element_t)`, so indexing is a plain pointer offset.
+ * - "Repeating": the stride is zero, so every index maps into the first entry.
+ * - "Dynamic": anything else, the stride is multiplied on every access.
+ */
+enum class stride_kind_t {
+    dynamic_k,
+    contiguous_k,
+    repeating_k,
+};
+
+/**
+ * @brief A `strided_iterator_gt` with the layout fixed at compile time.
+ * Hot loops templated on it avoid the `ptr + i * stride` bytes arithmetic
+ * and compile into tight, often vectorized, code for contiguous inputs.
+ * Should be produced by `visit_strided` once per API call.
+ */
+template <typename element_at, stride_kind_t kind_ak>
+class static_strided_iterator_gt {
+  public:
+    using element_t = element_at;
+    using iterator_category = std::random_access_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = element_t;
+    using pointer = value_type*;
+    using reference = value_type&;
+    static constexpr stride_kind_t kind_k = kind_ak;
+
+  private:
+    element_t* raw_ {nullptr};
+    ustore_size_t stride_ {0};
+
+  public:
+    static_strided_iterator_gt(strided_iterator_gt<element_t> dynamic) noexcept
+        : raw_(dynamic.get()), stride_(dynamic.stride()) {}
+
+    element_t& operator[](ustore_size_t idx) const noexcept {
+        if constexpr (kind_ak == stride_kind_t::contiguous_k)
+            return raw_[idx];
+        else if constexpr (kind_ak == stride_kind_t::repeating_k)
+            return *raw_;
+        else
+            return *(element_t*)((char*)raw_ + stride_ * idx);
+    }
+
+    explicit operator bool() const noexcept { return raw_ != nullptr; }
+    bool repeats() const noexcept { return kind_ak == stride_kind_t::repeating_k; }
+    element_t& operator*() const noexcept { return *raw_; }
+    element_t* get() const noexcept { return raw_; }
+    ustore_size_t stride() const noexcept { return stride_; }
+};
+
+/**
+ * @brief Inspects the stride of @p iterator once and passes the matching
+ * `static_strided_iterator_gt` into @p callback. Every callback is instantiated
+ * three times, so wrap whole loops, rather than individual accesses.
+ */
+template <typename element_at, typename callback_at>
+decltype(auto) visit_strided(strided_iterator_gt<element_at> iterator, callback_at&& callback) {
+    if (iterator.is_continuous())
+        return callback(static_strided_iterator_gt<element_at, stride_kind_t::contiguous_k>(iterator));
+    if (iterator.repeats())
+        return callback(static_strided_iterator_gt<element_at, stride_kind_t::repeating_k>(iterator));
+    return callback(static_strided_iterator_gt<element_at, stride_kind_t::dynamic_k>(iterator));
+}
+
 class bits_span_t {
   public:
     struct ref_t {
@@ -644,12 +711,38 @@ element_at transform_reduce_n(iterator_at begin, std::size_t n, element_at init,
     return init;
 }
 
+/**
+ * @brief Resolves the layout of the strided input once, before the loop.
+ */
+template <typename element_at, typename input_at, typename transform_at = identity_t>
+element_at transform_reduce_n(strided_iterator_gt<input_at> begin,
+                              std::size_t n,
+                              element_at init,
+                              transform_at transform = {}) {
+    return visit_strided(begin, [&](auto begin) {
+        for (std::size_t i = 0; i != n; ++i)
+            init += transform(begin[i]);
+        return init;
+    });
+}
+
 template <typename output_iterator_at, typename iterator_at, typename transform_at = identity_t>
 void transform_n(iterator_at begin, std::size_t n, output_iterator_at output, transform_at transform = {}) {
     for (std::size_t i = 0; i != n; ++i)
         output[i] = transform(begin[i]);
 }
 
+template <typename output_iterator_at, typename input_at, typename transform_at = identity_t>
+void transform_n(strided_iterator_gt<input_at> begin,
+                 std::size_t n,
+                 output_iterator_at output,
+                 transform_at transform = {}) {
+    visit_strided(begin, [&](auto begin) {
+        for (std::size_t i = 0; i != n; ++i)
+            output[i] = transform(begin[i]);
+    });
+}
+
 template <typename element_at, typename iterator_at>
 element_at reduce_n(iterator_at begin, std::size_t n, element_at init) {
     return transform_reduce_n(begin, n, init, [](auto x) { return x; });
@@ -30,11 +30,15 @@ struct place_t {
  * Working with batched data is ugly in C++.
  * This handle doesn't help in the general case,
  * but at least allow reusing the arguments.
+ *
+ * The iterators are template arguments, so that hot loops can be specialized
+ * for contiguous keys and repeating collections with `places_arg_t::visit`.
  */
-struct places_arg_t {
+template <typename collections_iterator_at, typename keys_iterator_at>
+struct places_gt {
     using value_type = place_t;
-    strided_iterator_gt<ustore_collection_t const> collections_begin;
-    strided_iterator_gt<ustore_key_t const> keys_begin;
+    collections_iterator_at collections_begin;
+    keys_iterator_at keys_begin;
     strided_iterator_gt<ustore_str_view_t const> fields_begin;
     ustore_size_t count {0};
 
@@ -49,8 +53,39 @@ struct places_arg_t {
     bool same_collection() const noexcept {
         return strided_range_gt<ustore_collection_t const>(collections_begin, count).same_elements();
     }
+
+    /**
+     * @brief Passes a `places_gt` with layouts resolved at compile time into @p callback.
+     * Only the two most common cases are specialized, to limit the code bloat:
+     * repeating (or missing) collections and contiguous keys.
+     */
+    template <typename callback_at>
+    decltype(auto) visit(callback_at&& callback) const {
+        using collections_t = strided_iterator_gt<ustore_collection_t const>;
+        using keys_t = strided_iterator_gt<ustore_key_t const>;
+        using repeating_collections_t = static_strided_iterator_gt<ustore_collection_t const, stride_kind_t::repeating_k>;
+        using contiguous_keys_t = static_strided_iterator_gt<ustore_key_t const, stride_kind_t::contiguous_k>;
+        static_assert(std::is_same_v<collections_iterator_at, collections_t> && std::is_same_v<keys_iterator_at, keys_t>,
+                      "Layouts are already resolved");
+
+        bool same_collection = collections_begin.repeats();
+        bool contiguous_keys = keys_begin.is_continuous();
+        if (same_collection && contiguous_keys)
+            return callback(places_gt<repeating_collections_t, contiguous_keys_t> {collections_begin,
+                                                                                   keys_begin,
+                                                                                   fields_begin,
+                                                                                   count});
+        if (same_collection)
+            return callback(places_gt<repeating_collections_t, keys_t> {collections_begin, keys_begin, fields_begin, count});
+        if (contiguous_keys)
+            return callback(places_gt<collections_t, contiguous_keys_t> {collections_begin, keys_begin, fields_begin, count});
+        return callback(*this);
+    }
 };
 
+using places_arg_t =
+    places_gt<strided_iterator_gt<ustore_collection_t const>, strided_iterator_gt<ustore_key_t const>>;
+
 /**
  * Working with batched data is ugly in C++.
  * This handle doesn't help in the general case,
@@ -104,6 +139,8 @@ struct scan_t {
     ustore_collection_t collection;
     ustore_key_t min_key;
     ustore_length_t limit;
+    /// @brief Exclusive upper bound.
+    ustore_key_t end_key = std::numeric_limits<ustore_key_t>::max();
 };
 
 /**
@@ -115,13 +152,15 @@ struct scans_arg_t {
     strided_iterator_gt<ustore_key_t const> start_keys;
     strided_iterator_gt<ustore_length_t const> limits;
     ustore_size_t count = 0;
+    strided_iterator_gt<ustore_key_t const> end_keys = {};
 
     inline std::size_t size() const noexcept { return count; }
     inline scan_t operator[](std::size_t i) const noexcept {
         ustore_collection_t collection = collections ? collections[i] : ustore_collection_main_k;
         ustore_key_t min_key = start_keys ? start_keys[i] : std::numeric_limits<ustore_key_t>::min();
         ustore_length_t limit = limits[i];
-        return {collection, min_key, limit};
+        ustore_key_t end_key = end_keys ? end_keys[i] : std::numeric_limits<ustore_key_t>::max();
+        return {collection, min_key, limit, end_key};
     }
 
     bool same_collection() const noexcept {
@@ -250,6 +289,14 @@ inline bool same_collections_are_named(strided_iterator_gt<ustore_collection_t c
     return collections_begin && collections_begin[0] != ustore_collection_main_k;
 }
 
+/**
+ * @brief Options, that only affect the placement of outputs in the arena.
+ */
+inline constexpr int arena_options_k = //
+    ustore_option_arena_huge_pages_k | //
+    ustore_option_arena_numa_local_k | //
+    ustore_option_arena_numa_interleave_k;
+
 template <typename enum_at, typename allowed_mask_at>
 inline bool enum_is_subset(enum_at enum_value, allowed_mask_at allowed) noexcept {
     return (enum_value & ~allowed) == 0;
@@ -264,7 +311,10 @@ inline void validate_write(ustore_transaction_t const c_txn,
     auto allowed_options =                       //
         ustore_option_transaction_dont_watch_k | //
         ustore_option_dont_discard_memory_k |    //
-        ustore_option_write_flush_k;
+        ustore_option_write_flush_k |            //
+        ustore_option_write_bulk_k |             //
+        ustore_option_write_merge_k |            //
+        arena_options_k;
     return_error_if_m(enum_is_subset(c_options, allowed_options), c_error, args_wrong_k, "Invalid options!");
 
     return_error_if_m(places.keys_begin, c_error, args_wrong_k, "No keys were provided!");
@@ -285,7 +335,9 @@ inline void validate_read(ustore_transaction_t const c_txn,
     auto allowed_options =                       //
         ustore_option_transaction_dont_watch_k | //
         ustore_option_dont_discard_memory_k |    //
-        ustore_option_read_shared_memory_k;
+        ustore_option_read_shared_memory_k |     //
+        ustore_option_scan_bulk_k |              //
+        arena_options_k;
     return_error_if_m(enum_is_subset(c_options, allowed_options), c_error, args_wrong_k, "Invalid options!");
 
     return_error_if_m(places.keys_begin, c_error, args_wrong_k, "No keys were provided!");
@@ -300,7 +352,9 @@ inline void validate_scan(ustore_transaction_t const c_txn,
         ustore_option_transaction_dont_watch_k | //
         ustore_option_dont_discard_memory_k |    //
         ustore_option_read_shared_memory_k |     //
-        ustore_option_scan_bulk_k;
+        ustore_option_scan_bulk_k |              //
+        ustore_option_scan_sequential_k |        //
+        arena_options_k;
     return_error_if_m(enum_is_subset(c_options, allowed_options), c_error, args_wrong_k, "Invalid options!");
 
     return_error_if_m(args.limits, c_error, args_wrong_k, "Full scans aren't supported - paginate!");
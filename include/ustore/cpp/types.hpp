@@ -19,6 +19,24 @@ namespace unum::ustore {
 
 enum class byte_t : std::uint8_t {};
 
+/**
+ * @brief Unsigned counterpart of `ustore_key_t`, used in radix sorts and hashes.
+ * Unlike `std::make_unsigned_t`, works for 128-bit keys in strict ISO mode.
+ */
+#if USTORE_USE_UUID
+__extension__ typedef unsigned __int128 ustore_unsigned_key_t;
+#else
+typedef std::uint64_t ustore_unsigned_key_t;
+#endif
+
+/**
+ * @brief Maps signed keys into unsigned integers of the same order,
+ * by flipping the sign bit.
+ */
+inline ustore_unsigned_key_t ordered_unsigned(ustore_key_t key) noexcept {
+    return static_cast<ustore_unsigned_key_t>(key) ^ (ustore_unsigned_key_t(1) << (sizeof(ustore_key_t) * 8 - 1));
+}
+
 /**
  * @brief An OOP-friendly location representation for objects in the DB.
  * Should be used with `stride` set to `sizeof(collection_key_t)`.
@@ -243,30 +261,113 @@ value_view_t value_view(container_at&& container) {
 
 #pragma region Memory Management
 
+/**
+ * @brief Per-thread cache of arenas, released by short-lived `arena_t` objects.
+ * Returned arenas are reset, keeping just their first block warm, so the next
+ * request skips the allocation and the first-touch page faults.
+ *
+ * The pool tracks the high-water mark of arenas simultaneously borrowed by the
+ * thread. Every `trim_period_k` returns, the arenas beyond that mark are freed,
+ * so a single burst doesn't pin its memory forever.
+ */
+class arenas_pool_t {
+  public:
+    static constexpr std::size_t capacity_k = 16;
+    static constexpr std::size_t trim_period_k = 1024;
+
+  private:
+    ustore_arena_t free_[capacity_k] = {};
+    std::size_t free_count_ = 0;
+    std::size_t borrowed_count_ = 0;
+    std::size_t high_water_mark_ = 0;
+    std::size_t returns_count_ = 0;
+
+    arenas_pool_t() = default;
+
+  public:
+    arenas_pool_t(arenas_pool_t const&) = delete;
+    arenas_pool_t& operator=(arenas_pool_t const&) = delete;
+    ~arenas_pool_t() { trim(0); }
+
+    static arenas_pool_t& local() noexcept {
+        thread_local arenas_pool_t pool;
+        return pool;
+    }
+
+    /**
+     * @brief Returns a warm arena, if one is available, or NULL,
+     * in which case the engine will allocate it on first use.
+     */
+    ustore_arena_t borrow() noexcept {
+        ++borrowed_count_;
+        high_water_mark_ = borrowed_count_ > high_water_mark_ ? borrowed_count_ : high_water_mark_;
+        return free_count_ ? free_[--free_count_] : nullptr;
+    }
+
+    /**
+     * @brief Accepts an arena back. It may have been borrowed
+     * from another thread, if the owning object was moved.
+     */
+    void give_back(ustore_arena_t arena) noexcept {
+        borrowed_count_ -= borrowed_count_ != 0;
+        if (arena) {
+            if (free_count_ != capacity_k) {
+                ustore_arena_reset(arena);
+                free_[free_count_++] = arena;
+            }
+            else
+                ustore_arena_free(arena);
+        }
+        if (++returns_count_ % trim_period_k != 0)
+            return;
+        trim(high_water_mark_ - borrowed_count_);
+        high_water_mark_ = borrowed_count_;
+    }
+
+    /**
+     * @brief Frees the cached arenas, beyond the first @p keep_count.
+     */
+    void trim(std::size_t keep_count) noexcept {
+        while (free_count_ > keep_count)
+            ustore_arena_free(free_[--free_count_]);
+    }
+
+    std::size_t size() const noexcept { return free_count_; }
+};
+
 /**
  * @brief A view of a tape received from the DB.
  * Allocates no memory, but is responsible for the cleanup.
+ * Unless constructed without a DB, borrows and returns memory
+ * to the thread-local `arenas_pool_t`.
  */
 class arena_t {
 
     ustore_database_t db_ = nullptr;
     ustore_arena_t memory_ = nullptr;
+    bool pooled_ = false;
 
   public:
-    arena_t(ustore_database_t db) noexcept : db_(db) {}
+    arena_t(ustore_database_t db) noexcept
+        : db_(db), memory_(db ? arenas_pool_t::local().borrow() : nullptr), pooled_(db) {}
     arena_t(arena_t const&) = delete;
     arena_t& operator=(arena_t const&) = delete;
 
     ~arena_t() {
-        ustore_arena_free(memory_);
+        if (pooled_)
+            arenas_pool_t::local().give_back(memory_);
+        else
+            ustore_arena_free(memory_);
         memory_ = nullptr;
     }
 
-    inline arena_t(arena_t&& other) noexcept : db_(other.db_), memory_(std::exchange(other.memory_, nullptr)) {}
+    inline arena_t(arena_t&& other) noexcept
+        : db_(other.db_), memory_(std::exchange(other.memory_, nullptr)), pooled_(std::exchange(other.pooled_, false)) {}
 
     inline arena_t& operator=(arena_t&& other) noexcept {
         std::swap(db_, other.db_);
         std::swap(memory_, other.memory_);
+        std::swap(pooled_, other.pooled_);
         return *this;
     }
 
@@ -316,6 +417,26 @@ inline void hash_combine(std::size_t& seed, hashable_at const& v) {
     seed ^= hasher(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
 }
 
+#if USTORE_USE_UUID
+/**
+ * @brief The standard library has no `std::hash` for 128-bit integers,
+ * so both halves of the key are mixed in, instead of truncating it.
+ */
+inline void hash_combine(std::size_t& seed, ustore_key_t const& v) {
+    auto bits = static_cast<ustore_unsigned_key_t>(v);
+    hash_combine(seed, static_cast<std::uint64_t>(bits));
+    hash_combine(seed, static_cast<std::uint64_t>(bits >> 64));
+}
+#endif
+
+struct key_hash_t {
+    inline std::size_t operator()(ustore_key_t const& key) const noexcept {
+        std::size_t result = SIZE_MAX;
+        hash_combine(result, key);
+        return result;
+    }
+};
+
 struct collection_key_hash_t {
     inline std::size_t operator()(collection_key_t const& sub) const noexcept {
         std::size_t result = SIZE_MAX;
@@ -392,6 +513,41 @@ constexpr ustore_doc_field_type_t ustore_doc_field() {
     return ustore_doc_field_json_k;
 }
 
+constexpr std::size_t doc_field_size_bytes(ustore_doc_field_type_t type) noexcept {
+    switch (type) {
+    default: return 0;
+    case ustore_doc_field_null_k: return 0;
+    case ustore_doc_field_bool_k: return 1;
+    case ustore_doc_field_uuid_k: return 16;
+
+    case ustore_doc_field_i8_k: return 1;
+    case ustore_doc_field_i16_k: return 2;
+    case ustore_doc_field_i32_k: return 4;
+    case ustore_doc_field_i64_k: return 8;
+
+    case ustore_doc_field_u8_k: return 1;
+    case ustore_doc_field_u16_k: return 2;
+    case ustore_doc_field_u32_k: return 4;
+    case ustore_doc_field_u64_k: return 8;
+
+    case ustore_doc_field_f16_k: return 2;
+    case ustore_doc_field_f32_k: return 4;
+    case ustore_doc_field_f64_k: return 8;
+
+    // Offsets and lengths:
+    case ustore_doc_field_bin_k: return 8;
+    case ustore_doc_field_str_k: return 8;
+    }
+}
+
+constexpr bool doc_field_is_variable_length(ustore_doc_field_type_t type) noexcept {
+    switch (type) {
+    case ustore_doc_field_bin_k: return true;
+    case ustore_doc_field_str_k: return true;
+    default: return false;
+    }
+}
+
 } // namespace unum::ustore
 
 namespace std {
@@ -97,8 +97,14 @@ typedef uint64_t ustore_collection_t;
 
 /**
  * @brief The unique identifier of any value within a single collection.
+ * In `USTORE_USE_UUID` builds it is a 128-bit integer, wide enough to hold
+ * a UUID, instead of hashing it down into 64 bits.
  */
+#if defined(USTORE_USE_UUID) && USTORE_USE_UUID
+__extension__ typedef __int128 ustore_key_t;
+#else
 typedef int64_t ustore_key_t;
+#endif
 
 /**
  * @brief The elementary binary piece of any value.
@@ -199,8 +205,46 @@ typedef enum {
      * and may include irrelevant (deleted & duplicate) keys in order to maximize
      * throughput. The purpose is not accelerating the `ustore_scan()`, but the
      * following `ustore_read()`. Generally used for Machine Learning applications.
+     * Multiple tasks of the same `ustore_scan()` call are treated as independent
+     * shards of the key range and are scanned concurrently.
+     */
+    ustore_option_scan_bulk_k = 1 << 3,
+    /**
+     * @brief Hints that the scanned ranges are long and will be consumed
+     * front to back, like in ETL pipelines. Engines read ahead from disk
+     * in large chunks, instead of fetching one block at a time.
+     */
+    ustore_option_scan_sequential_k = 1 << 6,
+    /**
+     * @brief Marks large writes, like initial imports, that may bypass the
+     * regular write path. LSM-tree engines sort such batches and ingest them
+     * as pre-built files, avoiding the memtables and compaction overheads.
+     * Is ignored in transactions and by engines without such a path.
+     */
+    ustore_option_write_bulk_k = 1 << 7,
+    /**
+     * @brief Treats the written values as "merge operands", that the engine
+     * combines with the stored entries, instead of overwriting them. Is used
+     * by modalities to avoid reading entries before updating them. Is only
+     * accepted by engines, reporting `::ustore_supports_merges_k`.
+     */
+    ustore_option_write_merge_k = 1 << 8,
+    /**
+     * @brief Backs new arena blocks with 2 MB pages, reducing TLB misses on
+     * large exports. Explicit huge pages are used, if the OS has them reserved,
+     * otherwise transparent ones are requested.
      */
-    ustore_option_scan_bulk_k = 0, // TODO
+    ustore_option_arena_huge_pages_k = 1 << 9,
+    /**
+     * @brief Places new arena blocks on the NUMA node of the calling thread.
+     * Is meant for threads pinned to a node, that later consume the outputs.
+     */
+    ustore_option_arena_numa_local_k = 1 << 10,
+    /**
+     * @brief Interleaves pages of new arena blocks across all NUMA nodes,
+     * for outputs consumed by threads on different nodes.
+     */
+    ustore_option_arena_numa_interleave_k = 1 << 11,
 
 } ustore_options_t;
 
@@ -226,6 +270,8 @@ typedef enum {
     ustore_supports_named_collections_k = 2,
     /** @brief DataBase supports snapshots. */
     ustore_supports_snapshots_k = 4,
+    /** @brief DataBase supports `::ustore_option_write_merge_k`. */
+    ustore_supports_merges_k = 8,
 } ustore_metadata_t;
 
 /**
@@ -261,6 +307,10 @@ typedef struct ustore_database_init_t {
      *
      * Special:
      * - Flight API Client: `grpc://0.0.0.0:38709`.
+     *   Append `?connections=4` to spread the calling threads across a pool of
+     *   connections, and `&pipeline` to stream reads and writes back-to-back
+     *   over one long-lived exchange per connection. With `&compression=lz4` or
+     *   `&compression=zstd` batches above `compression_threshold` bytes are compressed.
      */
     ustore_str_view_t config;
     /** @brief A pointer to the opened KVS, unless `error` is filled. */
@@ -508,6 +558,9 @@ void ustore_collection_drop(ustore_collection_drop_t*);
  * - "compact": Flushes and compacts all the data in LSM-tree implementations.
  * - "info":    Metadata about the current software version, used for debugging.
  * - "usage":   Metadata about approximate collection sizes, RAM and disk usage.
+ * - `{"stats": ["memory", "ops", "latency"]}`: JSON object with per-collection
+ *   key counts and bytes, memory usage, operation and transaction abort counters,
+ *   and p50/p99 latencies. An empty list requests all of the sections.
  */
 typedef struct ustore_database_control_t {
     /** @brief Already open database instance. */
@@ -629,6 +682,13 @@ void ustore_transaction_commit(ustore_transaction_commit_t*);
  */
 void ustore_arena_free(ustore_arena_t);
 
+/**
+ * @brief Drops the contents of the arena, keeping just its first block
+ * warm for reuse by the following operations.
+ * Passing NULLs is safe.
+ */
+void ustore_arena_reset(ustore_arena_t);
+
 /**
  * @brief Resets the transaction and deallocates the underlying memory.
  * Passing NULLs is safe.
@@ -32,6 +32,15 @@
  * So the primary interfaces of Docs Store are type-agnostic. Vectorized "gather"
  * operations perform the best effort to convert into the requested format, but
  * it's not always possible.
+ *
+ * ## Internal Representation
+ *
+ * Whole documents are validated once, when written, and are persisted pre-parsed,
+ * as binary tapes, in which fields and array elements are found with a few jumps.
+ * Reads of sub-fields, gathers and secondary indexes query those tapes in place,
+ * and only the requested parts are printed back into JSON. Tapes start with a
+ * zero byte, so textual documents, persisted by older versions, remain readable.
+ * Shredded fields and residuals, however, are stored as minified JSON texts.
  */
 
 #pragma once
@@ -84,6 +93,20 @@ typedef enum ustore_doc_field_type_t {
 
 } ustore_doc_field_type_t;
 
+/**
+ * @brief Kinds of scalar values, counted in the histograms of `ustore_docs_gist()`.
+ * Non-negative integers are counted as unsigned.
+ */
+typedef enum ustore_doc_gist_type_t {
+    ustore_doc_gist_null_k = 0,
+    ustore_doc_gist_bool_k = 1,
+    ustore_doc_gist_i64_k = 2,
+    ustore_doc_gist_u64_k = 3,
+    ustore_doc_gist_f64_k = 4,
+    ustore_doc_gist_str_k = 5,
+    ustore_doc_gist_types_k = 6,
+} ustore_doc_gist_type_t;
+
 /**
  * @brief Kind of document modification to be applied on `ustore_docs_write()`.
  */
@@ -95,6 +118,18 @@ typedef enum ustore_doc_modification_t {
     ustore_doc_modify_merge_k = 4,
 } ustore_doc_modification_t;
 
+/**
+ * @brief Comparison of a document field against a literal in `ustore_docs_gather()` filters.
+ */
+typedef enum ustore_doc_compare_t {
+    ustore_doc_compare_eq_k = 0,
+    ustore_doc_compare_ne_k = 1,
+    ustore_doc_compare_lt_k = 2,
+    ustore_doc_compare_le_k = 3,
+    ustore_doc_compare_gt_k = 4,
+    ustore_doc_compare_ge_k = 5,
+} ustore_doc_compare_t;
+
 /*********************************************************/
 /*****************	 Primary Functions	  ****************/
 /*********************************************************/
@@ -110,6 +145,36 @@ typedef enum ustore_doc_modification_t {
  * With documents, you can skip the `keys` and pass just `fields`, which will be
  * used to dynamically extract the keys. To make it compatible with MongoDB and
  * ElasticSearch you can pass @b "_id" into `fields`.
+ *
+ * ## Secondary Indexes
+ *
+ * Pass `indexes_count` pairs of `indexes_fields` and `indexes_collections` to keep
+ * secondary indexes of those fields up to date. Every index lives in its own companion
+ * collection, created with `ustore_collection_create()`, and must be passed with every
+ * write into the indexed documents. The indexes are updated after reading the documents
+ * before and after the write, so pass a `transaction` to update both atomically.
+ * @see `ustore_docs_index_find()`, `ustore_docs_index_build()`.
+ *
+ * ## Shredded Collections
+ *
+ * Table-like collections with a fixed schema can be stored in a columnar way.
+ * Pass `shreds_count` pairs of top-level `shreds_fields` and `shreds_collections`,
+ * and every document will be split: the values of those fields will be stored in
+ * their own companion collections under the key of the document, and the rest of
+ * the object will remain in the original collection. The fields are usually picked
+ * from the output of `ustore_docs_gist()`. The same shreds must be passed to every
+ * `ustore_docs_write()`, `ustore_docs_read()` and `ustore_docs_gather()` touching
+ * those documents, so that single-field reads and gathers only fetch and parse the
+ * requested columns. Whole-document upserts are split in one pass, other kinds of
+ * modifications reassemble the documents first.
+ *
+ * ## Joined Documents
+ *
+ * Bulk imports of NDJSON don't have to split the input into separate documents.
+ * Set `values_joined` and pass a single buffer of JSON documents, separated by
+ * whitespace, one for every task. It will be parsed in one streaming pass, and
+ * whole-document upserts will be converted and written in one batch. Every document
+ * must fit into 16 MB. If `keys` aren't provided, they are taken from the `id_field`.
  */
 
 typedef struct ustore_docs_write_t {
@@ -157,6 +222,37 @@ typedef struct ustore_docs_write_t {
     ustore_size_t values_stride;
 
     ustore_str_view_t id_field; // "_id"
+
+    /**
+     * @brief Marks the first of `values` as one buffer of `tasks_count` concatenated
+     * or newline-delimited JSON documents, starting at the first of `offsets`,
+     * spanning the first of `lengths` bytes or until the NULL-terminator.
+     * @see "Joined Documents" section.
+     */
+    bool values_joined;
+
+    /// @name Secondary Indexes to Maintain
+    /// @{
+    ustore_size_t indexes_count;
+
+    ustore_str_view_t const* indexes_fields;
+    ustore_size_t indexes_fields_stride;
+
+    ustore_collection_t const* indexes_collections;
+    ustore_size_t indexes_collections_stride;
+    /// @}
+
+    /// @name Top-Level Fields Stored in Companion Collections
+    /// @{
+    ustore_size_t shreds_count;
+
+    ustore_str_view_t const* shreds_fields;
+    ustore_size_t shreds_fields_stride;
+
+    ustore_collection_t const* shreds_collections;
+    ustore_size_t shreds_collections_stride;
+    /// @}
+
     /// @}
 
 } ustore_docs_write_t;
@@ -207,6 +303,15 @@ typedef struct ustore_docs_read_t {
     ustore_str_view_t const* fields;
     ustore_size_t fields_stride;
 
+    /** @brief Optional number of shredded fields. @see `ustore_docs_write_t`. */
+    ustore_size_t shreds_count;
+
+    ustore_str_view_t const* shreds_fields;
+    ustore_size_t shreds_fields_stride;
+
+    ustore_collection_t const* shreds_collections;
+    ustore_size_t shreds_collections_stride;
+
     /// @}
     /// @name Outputs
     /// @{
@@ -227,6 +332,133 @@ typedef struct ustore_docs_read_t {
  */
 void ustore_docs_read(ustore_docs_read_t*);
 
+/**
+ * @brief Finds documents by the values of an indexed field.
+ * @see `ustore_docs_index_find()`, `ustore_docs_write_t`.
+ *
+ * ## Indexed Values
+ *
+ * Only scalar fields are indexed: strings, numbers, booleans and nulls.
+ * Numbers are compared as doubles, so `3` and `3.0` are the same value.
+ * The companion collection maps every value to the sorted list of documents,
+ * containing it. Numbers are keyed in an order-preserving way, so ranges
+ * of numbers are answered by scanning only the matching part of the index.
+ * Other values are hashed and only support equality lookups.
+ *
+ * ## Pagination
+ *
+ * Every task exports up to `count_limits` document keys, starting from `start_keys`,
+ * in ascending order. To fetch the next batch, pass the last exported key plus one.
+ */
+typedef struct ustore_docs_index_find_t {
+
+    /// @name Context
+    /// @{
+
+    /** @brief Already open database instance. */
+    ustore_database_t db;
+    /** @brief Pointer to exported error message. */
+    ustore_error_t* error;
+    /** @brief The transaction in which the operation will be watched. */
+    ustore_transaction_t transaction;
+    /** @brief A snapshot captures a point-in-time view of the DB at the time it's created. */
+    ustore_snapshot_t snapshot;
+    /** @brief Reusable memory handle. */
+    ustore_arena_t* arena;
+    /** @brief Read options. @see `ustore_read_t`. */
+    ustore_options_t options;
+
+    /// @}
+    /// @name Inputs
+    /// @{
+
+    ustore_size_t tasks_count;
+
+    /** @brief Companion collections of the indexes, passed to `ustore_docs_write_t`. */
+    ustore_collection_t const* indexes;
+    ustore_size_t indexes_stride;
+
+    /** @brief JSON scalars to match, or the lower bounds of numeric ranges. */
+    ustore_str_view_t const* values_min;
+    ustore_size_t values_min_stride;
+
+    /** @brief Optional inclusive upper bounds of numeric ranges. NULL means equality. */
+    ustore_str_view_t const* values_max;
+    ustore_size_t values_max_stride;
+
+    /** @brief Optional smallest document keys to export. */
+    ustore_key_t const* start_keys;
+    ustore_size_t start_keys_stride;
+
+    ustore_length_t const* count_limits;
+    ustore_size_t count_limits_stride;
+
+    /// @}
+    /// @name Outputs
+    /// @{
+
+    /** @brief Number of matches exported for every task. */
+    ustore_length_t** counts;
+    /** @brief Offsets of every task's matches in `keys`, `tasks_count + 1` entries. */
+    ustore_length_t** offsets;
+    /** @brief Concatenated document keys. */
+    ustore_key_t** keys;
+
+    /// @}
+
+} ustore_docs_index_find_t;
+
+/**
+ * @brief Batched equality and range lookups in secondary indexes.
+ * @see `ustore_docs_index_find_t`.
+ */
+void ustore_docs_index_find(ustore_docs_index_find_t*);
+
+/**
+ * @brief Populates a secondary index from the documents already in a collection.
+ * Needed once, when an index is declared over a non-empty collection, as later
+ * writes keep it up to date. @see `ustore_docs_index_build()`.
+ */
+typedef struct ustore_docs_index_build_t {
+
+    /// @name Context
+    /// @{
+
+    /** @brief Already open database instance. */
+    ustore_database_t db;
+    /** @brief Pointer to exported error message. */
+    ustore_error_t* error;
+    /** @brief The transaction in which the operation will be watched. */
+    ustore_transaction_t transaction;
+    /** @brief Reusable memory handle. */
+    ustore_arena_t* arena;
+    /** @brief Read and Write options. @see `ustore_read_t`, `ustore_write_t`. */
+    ustore_options_t options;
+
+    /// @}
+    /// @name Inputs
+    /// @{
+
+    /** @brief Collection with the documents to index. */
+    ustore_collection_t collection;
+    /**
+     * @brief Field to index, as a name or a JSON-Pointer. NULL indexes the whole values,
+     * which is handy to index a companion collection of a shredded field.
+     */
+    ustore_str_view_t field;
+    /** @brief Companion collection, where the index will be kept. */
+    ustore_collection_t index;
+
+    /// @}
+
+} ustore_docs_index_build_t;
+
+/**
+ * @brief Full-scans a collection, to populate a secondary index.
+ * @see `ustore_docs_index_build_t`.
+ */
+void ustore_docs_index_build(ustore_docs_index_build_t*);
+
 /**
  * @brief Lists fields & paths present in wanted documents or entire collections.
  * @see `ustore_docs_gist()`.
@@ -261,6 +493,13 @@ typedef struct ustore_docs_gist_t {
     ustore_key_t const* keys;
     ustore_size_t keys_stride;
 
+    /**
+     * @brief Number of uniformly random documents to inspect instead of the `keys`.
+     * Those are picked with `ustore_sample()` from the first of `collections`.
+     * Is @b optional, zero inspects exactly the requested `docs_count` documents.
+     */
+    ustore_size_t sample_count;
+
     /// @}
     /// @name Outputs
     /// @{
@@ -269,6 +508,27 @@ typedef struct ustore_docs_gist_t {
     ustore_length_t** offsets;
     ustore_char_t** fields;
 
+    /**
+     * @brief Number of inspected documents, that were present.
+     * Divides `presences` into presence ratios. Is @b optional.
+     */
+    ustore_size_t* docs_present;
+    /**
+     * @brief For each of `fields_count` paths, the number of documents containing it.
+     * Is @b optional.
+     */
+    ustore_size_t** presences;
+    /**
+     * @brief For each of `fields_count` paths, a histogram of `ustore_doc_gist_types_k`
+     * counters, indexed by @c ustore_doc_gist_type_t. Is @b optional.
+     */
+    ustore_size_t** types_counts;
+    /**
+     * @brief For each of `fields_count` paths, the narrowest type for `ustore_docs_gather()`,
+     * that fits all of the observed values. Is @b optional.
+     */
+    ustore_doc_field_type_t** types;
+
     /// @}
 
 } ustore_docs_gist_t;
@@ -314,9 +574,32 @@ void ustore_docs_gist(ustore_docs_gist_t*);
  * Texts requested with `::ustore_doc_field_str_k` will be appended with a null-termination
  * character. Binary strings requested with `::ustore_doc_field_bin_k` - will not.
  * Offsets and lengths will be organized in a @b column-major layout with `docs_count`
- * entries in every column, but the contents of the joined string will be organized
- * in a @b row-major order. It will make the data easier to pass into bulk text-search
- * systems or Language Models training pipelines.
+ * entries in every column, and so will be the contents of the joined string.
+ * Offsets columns have `docs_count + 1` entries, the last marking the end of the column.
+ *
+ * ## Apache Arrow Compatibility
+ *
+ * Every bitmap, scalars column, offsets column and the contents of every strings
+ * column start at 64-byte aligned addresses and are padded to 64 bytes, so they can
+ * be passed into `ustore_to_arrow_column()` without copies. Bitmaps are LSB-first,
+ * like in Arrow. The offsets of strings are relative to `joined_strings`.
+ *
+ * ## Filters
+ *
+ * Optional `filters_count` comparisons of `filters_fields` against JSON scalars in
+ * `filters_values` are evaluated on every document before its columns are exported.
+ * Only the documents passing all of them, are exported, so the columns will have
+ * `*selected_count` entries instead of `docs_count`, and `*selected_indices` will
+ * contain the indices of those documents in the input.
+ *
+ * Numbers are compared by value, strings lexicographically, booleans with `false < true`.
+ * Missing fields and values of different types never pass, even the `!=` comparison.
+ *
+ * ## Shredded Collections
+ *
+ * With `shreds_count` shredded fields, only the companion collections of the requested
+ * fields and filters are read, and only their small values are parsed. The rest of
+ * the documents is only fetched, if some of the fields aren't shredded.
  */
 
 typedef struct ustore_docs_gather_t {
@@ -356,10 +639,37 @@ typedef struct ustore_docs_gather_t {
     ustore_doc_field_type_t const* types;
     ustore_size_t types_stride;
 
+    /** @brief Optional number of comparisons, every exported document must pass. */
+    ustore_size_t filters_count;
+
+    ustore_str_view_t const* filters_fields;
+    ustore_size_t filters_fields_stride;
+
+    ustore_doc_compare_t const* filters_operators;
+    ustore_size_t filters_operators_stride;
+
+    /** @brief JSON scalars to compare with, like `42`, `"text"` or `true`. */
+    ustore_str_view_t const* filters_values;
+    ustore_size_t filters_values_stride;
+
+    /** @brief Optional number of shredded fields. @see `ustore_docs_write_t`. */
+    ustore_size_t shreds_count;
+
+    ustore_str_view_t const* shreds_fields;
+    ustore_size_t shreds_fields_stride;
+
+    ustore_collection_t const* shreds_collections;
+    ustore_size_t shreds_collections_stride;
+
     /// @}
     /// @name Outputs
     /// @{
 
+    /** @brief Number of exported documents, equal to `docs_count` without filters. */
+    ustore_size_t* selected_count;
+    /** @brief Indices of exported documents within the input, sorted in ascending order. */
+    ustore_length_t** selected_indices;
+
     ustore_octet_t*** columns_validities;
     ustore_octet_t*** columns_conversions;
     ustore_octet_t*** columns_collisions;
@@ -47,7 +47,12 @@
  *
  * If working with Hyper-Graphs (multiple vertices linked by one edge), you are expected
  * to use Undirected Graphs, with vertices and hyper-edges mixed together. You would be
- * differentiating them not by parent collection, but by stored metadata at runtime.
+ * differentiating them not by parent collection, but by stored metadata at runtime. *
+ * ## Supernodes
+ *
+ * Vertices with thousands of relations are split into chunks, stored under reserved
+ * keys, all smaller than `ustore_vertex_id_min_k`. Adding or removing an edge rewrites
+ * just one of the chunks, instead of the entire neighborhood of such vertex.
  */
 
 #pragma once
@@ -64,6 +69,12 @@ extern "C" {
 
 extern ustore_key_t ustore_default_edge_id_k;
 
+/**
+ * @brief The smallest allowed vertex ID. Smaller keys in graph collections are
+ * reserved for the chunks of high-degree vertices.
+ */
+extern ustore_key_t ustore_vertex_id_min_k;
+
 /**
  * @brief Every vertex can be either a source or a target in a Directed Graph.
  *
@@ -117,6 +128,13 @@ extern ustore_vertex_degree_t ustore_vertex_degree_missing_k;
  * - First outgoing edges will arrive, sorted by targets.
  * - Then the incoming edges, sorted by the source.
  *
+ * ## Edge Attributes
+ *
+ * The timestamps and weights, assigned by `ustore_graph_upsert_edges()`, are stored
+ * in columns next to the relations, so they can be exported in the same pass.
+ * Both outputs are dense arrays, matching the exported edges one-to-one. Edges
+ * without attributes get a zero timestamp and a unit weight.
+ *
  * ## Checking Entity Existence
  *
  * To check if a node or edge is present - a simpler query is possible.
@@ -165,6 +183,10 @@ typedef struct ustore_graph_find_edges_t {
 
     ustore_vertex_degree_t** degrees_per_vertex;
     ustore_key_t** edges_per_vertex;
+    /** @brief Optional timestamps of exported edges. Requires `edges_per_vertex`. */
+    int64_t** timestamps_per_edge;
+    /** @brief Optional weights of exported edges. Requires `edges_per_vertex`. */
+    ustore_float_t** weights_per_edge;
 
     /// @}
 
@@ -176,9 +198,143 @@ typedef struct ustore_graph_find_edges_t {
  */
 void ustore_graph_find_edges(ustore_graph_find_edges_t*);
 
+/**
+ * @brief Gathers the in- and out-degrees of vertices, without exporting any edges.
+ * @see `ustore_graph_find_degrees()`.
+ *
+ * Unlike `ustore_graph_find_edges_t` with empty `edges_per_vertex`, reports
+ * both directions at once, in dense arrays ready to be wrapped into NumPy or
+ * Arrow buffers. Missing vertices are exported with `::ustore_vertex_degree_missing_k`
+ * in both arrays. Compressed and chunked neighborhoods are never unpacked.
+ */
+typedef struct ustore_graph_find_degrees_t {
+
+    /// @name Context
+    /// @{
+
+    /** @brief Already open database instance. */
+    ustore_database_t db;
+    /** @brief Pointer to exported error message. */
+    ustore_error_t* error;
+    /** @brief The transaction in which the operation will be watched. */
+    ustore_transaction_t transaction;
+    /** @brief A snapshot captures a point-in-time view of the DB at the time it's created. */
+    ustore_snapshot_t snapshot;
+    /** @brief Reusable memory handle. */
+    ustore_arena_t* arena;
+    /** @brief Read options. @see `ustore_read_t`. */
+    ustore_options_t options;
+
+    /// @}
+    /// @name Inputs
+    /// @{
+
+    ustore_size_t tasks_count;
+
+    ustore_collection_t const* collections;
+    ustore_size_t collections_stride;
+
+    ustore_key_t const* vertices;
+    ustore_size_t vertices_stride;
+
+    /// @}
+    /// @name Outputs
+    /// @{
+
+    /** @brief Numbers of edges, where the vertices are the `::ustore_vertex_source_k`. */
+    ustore_vertex_degree_t** out_degrees;
+    /** @brief Numbers of edges, where the vertices are the `::ustore_vertex_target_k`. */
+    ustore_vertex_degree_t** in_degrees;
+
+    /// @}
+
+} ustore_graph_find_degrees_t;
+
+/**
+ * @brief Gathers the in- and out-degrees of vertices.
+ * @see `ustore_graph_find_degrees_t`.
+ */
+void ustore_graph_find_degrees(ustore_graph_find_degrees_t*);
+
+/**
+ * @brief Checks if edges between given vertices exist, without exporting them.
+ * @see `ustore_graph_contains_edges()`.
+ *
+ * Every neighborhood of a source vertex is fetched just once per batch,
+ * and is searched in place, unpacking just the blocks or chunks that
+ * may contain the target.
+ */
+typedef struct ustore_graph_contains_edges_t {
+
+    /// @name Context
+    /// @{
+
+    /** @brief Already open database instance. */
+    ustore_database_t db;
+    /** @brief Pointer to exported error message. */
+    ustore_error_t* error;
+    /** @brief The transaction in which the operation will be watched. */
+    ustore_transaction_t transaction;
+    /** @brief A snapshot captures a point-in-time view of the DB at the time it's created. */
+    ustore_snapshot_t snapshot;
+    /** @brief Reusable memory handle. */
+    ustore_arena_t* arena;
+    /** @brief Read options. @see `ustore_read_t`. */
+    ustore_options_t options;
+
+    /// @}
+    /// @name Inputs
+    /// @{
+
+    ustore_size_t tasks_count;
+
+    ustore_collection_t const* collections;
+    ustore_size_t collections_stride;
+
+    /**
+     * @brief Optional IDs of the edges. If skipped, any edge
+     * between the `sources_ids` and `targets_ids` is matched.
+     */
+    ustore_key_t const* edges_ids;
+    ustore_size_t edges_stride;
+
+    ustore_key_t const* sources_ids;
+    ustore_size_t sources_stride;
+
+    ustore_key_t const* targets_ids;
+    ustore_size_t targets_stride;
+
+    /// @}
+    /// @name Outputs
+    /// @{
+
+    /** @brief Bitset of matched edges, laid out like `ustore_read_t::presences`. */
+    ustore_octet_t** presences;
+    /** @brief Numbers of matching edges, which may exceed one in multi-graphs. */
+    ustore_vertex_degree_t** counts;
+
+    /// @}
+
+} ustore_graph_contains_edges_t;
+
+/**
+ * @brief Checks if edges between given vertices exist.
+ * @see `ustore_graph_contains_edges_t`.
+ */
+void ustore_graph_contains_edges(ustore_graph_contains_edges_t*);
+
 /**
  * @brief Inserts edges between provided vertices.
  * @see `ustore_graph_upsert_edges()`.
+ *
+ * With `::ustore_option_write_bulk_k`, the batch is treated as a part of a large import:
+ * the relations are sorted and grouped by vertex, every neighborhood is rebuilt with a
+ * single linear merge, and all of them are passed to the engine in one bulk write.
+ *
+ * Edges may be given `timestamps` and `weights`. Those are stored along with both ends,
+ * so weighted algorithms and time-windowed traversals don't need to join the graph with
+ * a separate collection. Upserting an existing edge without them keeps the old ones.
+ * Supernodes, that are split into chunks, don't keep the attributes.
  */
 typedef struct ustore_graph_upsert_edges_t {
 
@@ -213,6 +369,14 @@ typedef struct ustore_graph_upsert_edges_t {
     ustore_key_t const* targets_ids;
     ustore_size_t targets_stride;
 
+    /** @brief Optional timestamps of edges, like the creation time. */
+    int64_t const* timestamps;
+    ustore_size_t timestamps_stride;
+
+    /** @brief Optional weights of edges. */
+    ustore_float_t const* weights;
+    ustore_size_t weights_stride;
+
     /// @}
 
 } ustore_graph_upsert_edges_t;
@@ -360,6 +524,510 @@ typedef struct ustore_graph_remove_vertices_t { //
  */
 void ustore_graph_remove_vertices(ustore_graph_remove_vertices_t*);
 
+/*********************************************************/
+/*****************	     Traversals	      ****************/
+/*********************************************************/
+
+/**
+ * @brief Defines which vertices are expanded on the next hop of a traversal.
+ */
+typedef enum {
+
+    /** @brief Every reached vertex is expanded, as many times, as it was reached. */
+    ustore_traversal_dedup_none_k = 0,
+    /** @brief Vertices are unique within every hop, but may be reached again on later ones. */
+    ustore_traversal_dedup_hop_k = 1,
+    /** @brief Every vertex, including the seeds, is expanded at most once. */
+    ustore_traversal_dedup_visited_k = 2,
+
+} ustore_traversal_dedup_t;
+
+/**
+ * @brief Expands a batch of seeds for a number of hops.
+ * @see `ustore_graph_traverse()`.
+ *
+ * ## Output Form
+ *
+ * The `frontiers` contain the vertices reached on every hop, delimited by
+ * `frontiers_offsets`: the vertices reached on hop `i` are the
+ * `frontiers[frontiers_offsets[i] : frontiers_offsets[i+1]]`.
+ * Unless deduplication is disabled, every frontier is sorted.
+ *
+ * The followed edges are exported like in `ustore_graph_find_edges()`, as
+ * source, target and edge ID triplets, delimited by `edges_offsets` in the same way.
+ * Edges leading to the already visited vertices are exported, but not expanded.
+ */
+typedef struct ustore_graph_traverse_t {
+
+    /// @name Context
+    /// @{
+
+    /** @brief Already open database instance. */
+    ustore_database_t db;
+    /** @brief Pointer to exported error message. */
+    ustore_error_t* error;
+    /** @brief The transaction in which the operation will be watched. */
+    ustore_transaction_t transaction;
+    /** @brief A snapshot captures a point-in-time view of the DB at the time it's created. */
+    ustore_snapshot_t snapshot;
+    /** @brief Reusable memory handle. */
+    ustore_arena_t* arena;
+    /** @brief Read options. @see `ustore_read_t`. */
+    ustore_options_t options;
+
+    /// @}
+    /// @name Inputs
+    /// @{
+
+    ustore_collection_t collection;
+
+    ustore_size_t seeds_count;
+    ustore_key_t const* seeds;
+    ustore_size_t seeds_stride;
+
+    ustore_size_t hops_count;
+    /** @brief The role of expanded vertices on every hop. NULL is treated as `::ustore_vertex_role_any_k`. */
+    ustore_vertex_role_t const* roles;
+    /** @brief Step between `roles`. Zero reuses the same role for all hops. */
+    ustore_size_t roles_stride;
+
+    /** @brief Maximum number of edges followed from a single vertex per hop. Zero means unlimited. */
+    ustore_vertex_degree_t fanout_limit;
+    ustore_traversal_dedup_t dedup;
+    /**
+     * @brief Optional pair of inclusive bounds for the timestamps of followed edges.
+     * @see `ustore_graph_upsert_edges_t::timestamps`.
+     */
+    int64_t const* timestamps_window;
+
+    /// @}
+    /// @name Outputs
+    /// @{
+
+    /** @brief Contains `hops_count + 1` offsets into `frontiers`. */
+    ustore_length_t** frontiers_offsets;
+    ustore_key_t** frontiers;
+    /** @brief Contains `hops_count + 1` offsets into `edges`, counted in triplets. */
+    ustore_length_t** edges_offsets;
+    ustore_key_t** edges;
+
+    /// @}
+
+} ustore_graph_traverse_t;
+
+/**
+ * @brief Expands a batch of seeds for a number of hops within a single call,
+ * fetching one batch of neighborhoods per hop.
+ * @see `ustore_graph_traverse_t`.
+ */
+void ustore_graph_traverse(ustore_graph_traverse_t*);
+
+/*********************************************************/
+/*****************	 Read-Only Snapshots  ****************/
+/*********************************************************/
+
+/**
+ * @brief Immutable Compressed Sparse Row representation of a whole graph collection.
+ *
+ * Every vertex is addressed by its position, or "index", in the sorted `vertices`.
+ * The neighbors of the vertex at index `i` are the `neighbors[offsets[i] : offsets[i+1]]`,
+ * themselves stored as indexes, in ascending order. The matching `edges_ids` share offsets.
+ * Unlike the collection itself, whole-graph algorithms can traverse this layout sequentially,
+ * without a single lookup.
+ *
+ * ## Persistence
+ *
+ * If loaded from a file, the arrays point into a read-only memory mapping, which must be
+ * released with `ustore_graph_free_csr()`. The file layout is a 32-byte header, followed
+ * by the five arrays in the order of declaration, and is only portable between machines
+ * of the same endianness.
+ */
+typedef struct ustore_graph_csr_t {
+    ustore_size_t vertices_count;
+    ustore_size_t edges_count;
+
+    /** @brief Sorted IDs of all the vertices, including the isolated ones. */
+    ustore_key_t const* vertices;
+    /** @brief Offsets of every neighborhood. Contains `vertices_count + 1` entries. */
+    ustore_size_t const* offsets;
+    /** @brief Indexes of neighbors in `vertices`. Contains `edges_count` entries. */
+    ustore_size_t const* neighbors;
+    /** @brief IDs of the edges, matching `neighbors`. Contains `edges_count` entries. */
+    ustore_key_t const* edges_ids;
+    /** @brief Weights of the edges, matching `neighbors`. Contains `edges_count` entries. */
+    ustore_float_t const* weights;
+
+    /** @brief Memory-mapped file, backing the arrays. NULL, if they live in an arena. */
+    void* mapping;
+    ustore_size_t mapping_length;
+
+} ustore_graph_csr_t;
+
+/**
+ * @brief Materializes one graph collection into a CSR.
+ * @see `ustore_graph_export_csr()`.
+ */
+typedef struct ustore_graph_export_csr_t {
+
+    /// @name Context
+    /// @{
+
+    /** @brief Already open database instance. */
+    ustore_database_t db;
+    /** @brief Pointer to exported error message. */
+    ustore_error_t* error;
+    /** @brief The transaction in which the operation will be watched. */
+    ustore_transaction_t transaction;
+    /** @brief A snapshot captures a point-in-time view of the DB at the time it's created. */
+    ustore_snapshot_t snapshot;
+    /** @brief Reusable memory handle. */
+    ustore_arena_t* arena;
+    /** @brief Read options. @see `ustore_scan_t`. */
+    ustore_options_t options;
+
+    /// @}
+    /// @name Inputs
+    /// @{
+
+    ustore_collection_t collection;
+    /**
+     * @brief Which relations to export for every vertex.
+     * `::ustore_vertex_source_k` keeps the outgoing edges, `::ustore_vertex_target_k`
+     * the incoming, and `::ustore_vertex_role_any_k` both, forming an undirected graph.
+     */
+    ustore_vertex_role_t role;
+    /**
+     * @brief Optional path of the file to write the CSR into, instead of the `arena`.
+     * If set, the output is mapped from that file. @see `ustore_graph_open_csr()`.
+     */
+    ustore_str_view_t path;
+
+    /// @}
+    /// @name Outputs
+    /// @{
+
+    ustore_graph_csr_t* csr;
+
+    /// @}
+
+} ustore_graph_export_csr_t;
+
+/**
+ * @brief Materializes one graph collection into a CSR.
+ * Pages through the collection once, so the result is only consistent,
+ * if done within a `snapshot` or a `transaction`.
+ * @see `ustore_graph_export_csr_t`.
+ */
+void ustore_graph_export_csr(ustore_graph_export_csr_t*);
+
+/**
+ * @brief Memory-maps a CSR, previously saved with `ustore_graph_export_csr()`.
+ * @see `ustore_graph_open_csr()`.
+ */
+typedef struct ustore_graph_open_csr_t {
+
+    /** @brief Pointer to exported error message. */
+    ustore_error_t* error;
+    /** @brief Path of the file, written by `ustore_graph_export_csr()`. */
+    ustore_str_view_t path;
+    /** @brief The output, to be released with `ustore_graph_free_csr()`. */
+    ustore_graph_csr_t* csr;
+
+} ustore_graph_open_csr_t;
+
+/**
+ * @brief Memory-maps a CSR, previously saved with `ustore_graph_export_csr()`.
+ * @see `ustore_graph_open_csr_t`.
+ */
+void ustore_graph_open_csr(ustore_graph_open_csr_t*);
+
+/**
+ * @brief Unmaps the file, backing the CSR, if any, and resets the structure.
+ */
+void ustore_graph_free_csr(ustore_graph_csr_t*);
+
+/**
+ * @brief Finds the neighborhoods of a batch of vertices in a CSR.
+ * @see `ustore_graph_find_csr_edges()`.
+ *
+ * The outputs are organized exactly like in `ustore_graph_find_edges_t`,
+ * with every edge exported as a triplet of source, target and edge IDs.
+ * Missing vertices are exported with `::ustore_vertex_degree_missing_k`.
+ */
+typedef struct ustore_graph_find_csr_edges_t {
+
+    /// @name Context
+    /// @{
+
+    /** @brief Pointer to exported error message. */
+    ustore_error_t* error;
+    /** @brief Reusable memory handle. */
+    ustore_arena_t* arena;
+    /** @brief Memory options. @see `ustore_arena_free()`. */
+    ustore_options_t options;
+
+    /// @}
+    /// @name Inputs
+    /// @{
+
+    ustore_graph_csr_t const* csr;
+    /**
+     * @brief The role of all `vertices` in the exported edges.
+     * Only changes which end of every edge the center is, as the CSR contains one kind of relations.
+     */
+    ustore_vertex_role_t role;
+
+    ustore_size_t tasks_count;
+
+    ustore_key_t const* vertices;
+    ustore_size_t vertices_stride;
+
+    /// @}
+    /// @name Outputs
+    /// @{
+
+    ustore_vertex_degree_t** degrees_per_vertex;
+    ustore_key_t** edges_per_vertex;
+
+    /// @}
+
+} ustore_graph_find_csr_edges_t;
+
+/**
+ * @brief Finds the neighborhoods of a batch of vertices in a CSR.
+ * @see `ustore_graph_find_csr_edges_t`.
+ */
+void ustore_graph_find_csr_edges(ustore_graph_find_csr_edges_t*);
+
+/*********************************************************/
+/*****************	      Analytics		  ****************/
+/*********************************************************/
+
+/**
+ * @brief Scores the vertices of a CSR snapshot with PageRank.
+ * @see `ustore_graph_pagerank()`.
+ *
+ * Links are followed in the direction of the snapshot, so exports of `::ustore_vertex_source_k`
+ * rank vertices by their incoming edges. Vertices without outgoing links
+ * spread their scores uniformly.
+ */
+typedef struct ustore_graph_pagerank_t {
+
+    /// @name Context
+    /// @{
+
+    /** @brief Already open database instance. Needed only to write into `output_collection`. */
+    ustore_database_t db;
+    /** @brief Pointer to exported error message. */
+    ustore_error_t* error;
+    /** @brief The transaction in which the results will be written. */
+    ustore_transaction_t transaction;
+    /** @brief Reusable memory handle. */
+    ustore_arena_t* arena;
+    /** @brief Write options. @see `ustore_write_t`. */
+    ustore_options_t options;
+
+    /// @}
+    /// @name Inputs
+    /// @{
+
+    /** @brief Snapshot to analyze. Must not live in the same `arena`, as it is reused for outputs. */
+    ustore_graph_csr_t const* csr;
+    /** @brief Probability of following a link, rather than jumping to a random vertex. Zero selects 0.85. */
+    ustore_float_t damping;
+    /** @brief Sum of absolute changes of all scores, below which iterations stop. Zero selects 1e-6. */
+    ustore_float_t tolerance;
+    /** @brief Maximum number of iterations. Zero selects 100. */
+    ustore_size_t iterations_limit;
+    /**
+     * @brief Optional collection, where the result of every vertex is written under
+     * its ID, as a binary scalar of the output type.
+     */
+    ustore_collection_t const* output_collection;
+
+    /// @}
+    /// @name Outputs
+    /// @{
+
+    /** @brief Scores, matching the `csr` vertices and summing up to one. */
+    ustore_float_t** scores;
+
+    /// @}
+
+} ustore_graph_pagerank_t;
+
+/**
+ * @brief Scores the vertices of a CSR snapshot with PageRank.
+ * @see `ustore_graph_pagerank_t`.
+ */
+void ustore_graph_pagerank(ustore_graph_pagerank_t*);
+
+/**
+ * @brief Finds the Weakly Connected Components of a CSR snapshot.
+ * @see `ustore_graph_components()`.
+ */
+typedef struct ustore_graph_components_t {
+
+    /// @name Context
+    /// @{
+
+    /** @brief Already open database instance. Needed only to write into `output_collection`. */
+    ustore_database_t db;
+    /** @brief Pointer to exported error message. */
+    ustore_error_t* error;
+    /** @brief The transaction in which the results will be written. */
+    ustore_transaction_t transaction;
+    /** @brief Reusable memory handle. */
+    ustore_arena_t* arena;
+    /** @brief Write options. @see `ustore_write_t`. */
+    ustore_options_t options;
+
+    /// @}
+    /// @name Inputs
+    /// @{
+
+    /** @brief Snapshot to analyze. Must not live in the same `arena`, as it is reused for outputs. */
+    ustore_graph_csr_t const* csr;
+    /**
+     * @brief Optional collection, where the result of every vertex is written under
+     * its ID, as a binary scalar of the output type.
+     */
+    ustore_collection_t const* output_collection;
+
+    /// @}
+    /// @name Outputs
+    /// @{
+
+    /** @brief Smallest vertex ID in the component of every `csr` vertex. */
+    ustore_key_t** labels;
+
+    /// @}
+
+} ustore_graph_components_t;
+
+/**
+ * @brief Finds the Weakly Connected Components of a CSR snapshot,
+ * ignoring the directions of relations.
+ * @see `ustore_graph_components_t`.
+ */
+void ustore_graph_components(ustore_graph_components_t*);
+
+/**
+ * @brief Computes the Breadth-First Search levels of a CSR snapshot.
+ * @see `ustore_graph_bfs()`.
+ */
+typedef struct ustore_graph_bfs_t {
+
+    /// @name Context
+    /// @{
+
+    /** @brief Already open database instance. Needed only to write into `output_collection`. */
+    ustore_database_t db;
+    /** @brief Pointer to exported error message. */
+    ustore_error_t* error;
+    /** @brief The transaction in which the results will be written. */
+    ustore_transaction_t transaction;
+    /** @brief Reusable memory handle. */
+    ustore_arena_t* arena;
+    /** @brief Write options. @see `ustore_write_t`. */
+    ustore_options_t options;
+
+    /// @}
+    /// @name Inputs
+    /// @{
+
+    /** @brief Snapshot to analyze. Must not live in the same `arena`, as it is reused for outputs. */
+    ustore_graph_csr_t const* csr;
+
+    /** @brief Vertices to start from. Those missing in the `csr` are ignored. */
+    ustore_size_t sources_count;
+    ustore_key_t const* sources;
+    ustore_size_t sources_stride;
+    /**
+     * @brief Optional collection, where the result of every vertex is written under
+     * its ID, as a binary scalar of the output type.
+     */
+    ustore_collection_t const* output_collection;
+
+    /// @}
+    /// @name Outputs
+    /// @{
+
+    /**
+     * @brief Number of hops from the closest source to every `csr` vertex,
+     * following the relations of the snapshot. Unreachable ones get `::ustore_length_missing_k`.
+     */
+    ustore_length_t** levels;
+
+    /// @}
+
+} ustore_graph_bfs_t;
+
+/**
+ * @brief Computes the Breadth-First Search levels, expanding whole frontiers in parallel.
+ * @see `ustore_graph_bfs_t`.
+ */
+void ustore_graph_bfs(ustore_graph_bfs_t*);
+
+/**
+ * @brief Detects communities in a CSR snapshot with the Louvain method.
+ * @see `ustore_graph_louvain()`.
+ *
+ * Relations are treated as undirected edges, weighted by the `weights` of the snapshot,
+ * so it can be exported with any role. After every level of local moves, the communities are
+ * merged into the vertices of the next level, until the modularity stops growing.
+ */
+typedef struct ustore_graph_louvain_t {
+
+    /// @name Context
+    /// @{
+
+    /** @brief Already open database instance. Needed only to write into `output_collection`. */
+    ustore_database_t db;
+    /** @brief Pointer to exported error message. */
+    ustore_error_t* error;
+    /** @brief The transaction in which the results will be written. */
+    ustore_transaction_t transaction;
+    /** @brief Reusable memory handle. */
+    ustore_arena_t* arena;
+    /** @brief Write options. @see `ustore_write_t`. */
+    ustore_options_t options;
+
+    /// @}
+    /// @name Inputs
+    /// @{
+
+    /** @brief Snapshot to analyze. Must not live in the same `arena`, as it is reused for outputs. */
+    ustore_graph_csr_t const* csr;
+    /** @brief Minimal modularity growth, needed to proceed to the next level. Zero selects 1e-7. */
+    ustore_float_t min_modularity_growth;
+    /** @brief Maximum number of passes over all vertices on every level. Zero means unlimited. */
+    ustore_size_t passes_limit;
+    /**
+     * @brief Optional collection, where the result of every vertex is written under
+     * its ID, as a binary scalar of the output type.
+     */
+    ustore_collection_t const* output_collection;
+
+    /// @}
+    /// @name Outputs
+    /// @{
+
+    /** @brief Smallest vertex ID in the community of every `csr` vertex. */
+    ustore_key_t** labels;
+    /** @brief Optional modularity of the final partition. */
+    ustore_float_t* modularity;
+
+    /// @}
+
+} ustore_graph_louvain_t;
+
+/**
+ * @brief Detects communities in a CSR snapshot with the Louvain method.
+ * @see `ustore_graph_louvain_t`.
+ */
+void ustore_graph_louvain(ustore_graph_louvain_t*);
+
 #ifdef __cplusplus
 } /* end extern "C" */
 #endif
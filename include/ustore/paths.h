@@ -17,6 +17,14 @@
  * delimeter/separator can be passed together with the queries to add transparent
  * indexes, that on prefix scan - would narrow down the search space.
  *
+ * Writes with a non-zero `path_separator` maintain mirror "directory" entries,
+ * listing the children of every prefix ending with the separator. Prefix matches
+ * with the same separator walk those listings in lexicographic order, touching
+ * only the directories on the way to the matches, instead of the whole collection.
+ * Maintaining the listings is a Read-Modify-Write, so concurrent writers into the
+ * same directories should use transactions. Paths written without a separator are
+ * invisible to indexed matches, so stick to one separator per collection.
+ *
  * ## Allowed Characters
  *
  * String keys can contain any characters, but if you plan to use `ustore_paths_match()`
@@ -50,3 +50,5 @@
 #include "ustore/docs.h"
 #include "ustore/graph.h"
 #include "ustore/vectors.h"
+#include "ustore/async.h"
+#include "ustore/changes.h"
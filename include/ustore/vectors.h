@@ -79,13 +79,51 @@ typedef struct ustore_vectors_write_t {
     ustore_length_t const* offsets;
     ustore_size_t offsets_stride;
 
-    // @}
+    /// @}
+    /// @name Index
+    /// @{
+
+    /**
+     * @brief Metric, used to organize the HNSW index of the collection.
+     * Must match the metric of the previous writes into the same collection.
+     * Searches with other metrics fall back to exhaustive scans.
+     */
+    ustore_vector_metric_t metric;
+    /**
+     * @brief Number of neighbors per node on upper layers of the index, often called "M".
+     * The bottom layer keeps twice as many. Is fixed at first write. Zero selects a default of 16.
+     */
+    ustore_size_t index_connectivity;
+    /**
+     * @brief Number of candidates tracked while linking new vectors, often called "ef_construction".
+     * Higher values improve the recall at the cost of slower writes. Zero selects a default of 128.
+     */
+    ustore_size_t index_expansion;
+    /**
+     * @brief Optional companion collections, where the quantized copies are also packed
+     * into dense fixed-size blocks of up to 4K vectors, so that exhaustive searches can
+     * stream them. Must differ from the `collections`. Concurrent writes into the same
+     * companion collection must be isolated with transactions.
+     */
+    ustore_collection_t const* packed_collections;
+    ustore_size_t packed_collections_stride;
+    /**
+     * @brief Number of one-byte sub-spaces of Product Quantization in new packed collections.
+     * Zero keeps the `dimensions` bytes of scaled `i8` codes per vector. Must divide the
+     * `dimensions`. Codebooks are trained on the first written batch, which should be
+     * representative and, preferably, contain thousands of vectors.
+     */
+    ustore_size_t packed_subspaces;
+
+    /// @}
 
 } ustore_vectors_write_t;
 
 /**
  * @brief Maps keys to High-Dimensional Vectors.
  * Generalization of @c ustore_write_t to numerical vectors.
+ * Keys must be non-negative, as the negative range of the collection
+ * stores the Hierarchical Navigable Small World index of the vectors.
  * @see `ustore_vectors_write_t`, `ustore_write_t`, `ustore_write()`.
  */
 void ustore_vectors_write(ustore_vectors_write_t*);
@@ -93,7 +131,8 @@ void ustore_vectors_write(ustore_vectors_write_t*);
 /**
  * @brief Retrieves binary representations of vectors.
  * Generalization of @c ustore_read_t to numerical vectors.
- * Packs everything into a @b row-major dense matrix.
+ * Packs everything into a @b row-major dense matrix, that can be
+ * viewed as a 2D tensor of `tasks_count` rows without any copies.
  * @see `ustore_vectors_read()`, `ustore_read_t`, `ustore_read()`.
  */
 typedef struct ustore_vectors_read_t {
@@ -118,6 +157,11 @@ typedef struct ustore_vectors_read_t {
 
     ustore_size_t tasks_count;
     ustore_length_t dimensions;
+    /**
+     * @brief Type of the exported scalars. Vectors stored with other types are converted,
+     * the stored type being inferred from the length of the value. Conversions into `i8`
+     * round to the nearest integer and saturate.
+     */
     ustore_vector_scalar_t scalar_type;
 
     ustore_collection_t const* collections;
@@ -126,20 +170,29 @@ typedef struct ustore_vectors_read_t {
     ustore_key_t const* keys;
     ustore_size_t keys_stride;
 
-    /// @}
-
     /// @}
     /// @name Outputs
     /// @{
+
+    /**
+     * @brief Bitmap of found vectors. Missing ones, as well as the values of unexpected
+     * length, are exported as rows of zeros.
+     */
     ustore_octet_t** presences;
+    /**
+     * @brief Offsets of the rows within `vectors`, with an extra one for the end.
+     * As rows are dense, those are just multiples of the row size.
+     */
     ustore_length_t** offsets;
+    /** @brief The `tasks_count x dimensions` matrix, aligned to 64 bytes. */
     ustore_byte_t** vectors;
+
     /// @}
 
 } ustore_vectors_read_t;
 
 /**
- * @brief Retrieves binary values given string paths.
+ * @brief Retrieves vectors, compacting them into a dense matrix of requested scalars.
  * Generalization of @c ustore_read_t to numerical vectors.
  * @see `ustore_vectors_read_t`, `ustore_read_t`, `ustore_read()`.
  */
@@ -188,6 +241,46 @@ typedef struct ustore_vectors_search_t {
     ustore_length_t const* queries_offsets;
     ustore_size_t queries_offsets_stride;
 
+    /**
+     * @brief Number of candidates tracked on the bottom layer of the index, often called "ef".
+     * Higher values improve the recall at the cost of slower searches.
+     * Zero selects the larger of 64 and the match count limit.
+     */
+    ustore_size_t search_expansion;
+    /**
+     * @brief Optional companion collections, populated via `ustore_vectors_write_t::packed_collections`.
+     * Queries, that the index can't answer, scan the packed blocks instead of the collection itself.
+     */
+    ustore_collection_t const* packed_collections;
+    ustore_size_t packed_collections_stride;
+
+    /// @}
+    /// @name Filter
+    /// @{
+
+    /**
+     * @brief Optional allow-list of keys, shared by all tasks. If set, only those can be matched.
+     * Doesn't have to be sorted. An empty, but non-NULL, list excludes everything.
+     */
+    ustore_key_t const* allowed_keys;
+    ustore_size_t allowed_keys_count;
+    /**
+     * @brief Number of conjunctive equality conditions on the documents, sharing keys with
+     * the vectors. Zero disables the predicate. Vectors without documents are never matched.
+     */
+    ustore_size_t filter_fields_count;
+    /** @brief Collection of the documents, checked with `ustore_docs_gather()`. */
+    ustore_collection_t filter_collection;
+    /** @brief Field names or JSON-Pointers, like in `ustore_docs_gather_t::fields`. */
+    ustore_str_view_t const* filter_fields;
+    ustore_size_t filter_fields_stride;
+    /**
+     * @brief Expected values, compared to the fields gathered as strings.
+     * So numbers and booleans must be formatted as in JSON: "42", "true".
+     */
+    ustore_str_view_t const* filter_values;
+    ustore_size_t filter_values_stride;
+
     /// @}
     /// @name Outputs
     /// @{
@@ -201,6 +294,16 @@ typedef struct ustore_vectors_search_t {
 
 /**
  * @brief Performs K-Approximate Nearest Neighbors Search.
+ * Traverses the HNSW index of the collection, if it was built with the same metric,
+ * otherwise exhaustively compares the query to every vector in the collection.
+ * Collections without an index, populated with plain `ustore_write()`, are compared
+ * in full precision, assuming the `scalar_type` of the query. Packed companion collections,
+ * if provided, are scanned instead of the original ones. Exhaustive searches
+ * are batched, so every collection is scanned once per call, regardless of the
+ * number of queries into it. Filters are applied to every candidate before it is ranked,
+ * so the limits are only ever filled with eligible matches. The graph traversal still passes
+ * through the excluded nodes, to keep it connected, but selective filters make it slower.
+ * Matches are exported from the closest to the farthest.
  * @see `ustore_vectors_search_t`.
  */
 void ustore_vectors_search(ustore_vectors_search_t*);
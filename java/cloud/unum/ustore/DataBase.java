@@ -8,6 +8,8 @@ import java.nio.file.StandardCopyOption;
 import java.util.Map; // Map abstract class
 import java.lang.AutoCloseable; // Finalization
 import java.util.Arrays; // Arrays.equals
+import java.nio.ByteBuffer; // Zero-copy batches
+import java.nio.ByteOrder; // Native offsets
 
 /**
  * @brief An Embedded Persistent Key-Value Store with
@@ -91,6 +93,48 @@ public abstract class DataBase {
         }
     }
 
+    /**
+     * @brief Values of a batch read, exported without copies. The buffers are
+     *        direct views into native memory, which stays valid until the batch
+     *        is closed or passed into the next `getBatch`, which reuses it.
+     *
+     * The layout matches Apache Arrow binary arrays:
+     * - `presences`: a bitset of `count` bits, LSB-first.
+     * - `offsets`: `count + 1` native-order 32-bit offsets into `values`.
+     * - `values`: the contents of all the values, joined together.
+     */
+    public static class Batch implements AutoCloseable {
+
+        public long arenaAddress = 0;
+        public int count = 0;
+        public ByteBuffer presences;
+        public ByteBuffer offsets;
+        public ByteBuffer values;
+
+        public boolean contains(int i) {
+            return (presences.get(i / 8) & (1 << (i % 8))) != 0;
+        }
+
+        /**
+         * @return View of the `i`-th value, or null, if the key is missing.
+         */
+        public ByteBuffer get(int i) {
+            if (!contains(i))
+                return null;
+            ByteBuffer view = values.duplicate();
+            view.limit(offsets.getInt((i + 1) * 4));
+            view.position(offsets.getInt(i * 4));
+            return view.slice();
+        }
+
+        public native void close_();
+
+        @Override
+        public void close() {
+            close_();
+        }
+    }
+
     public static class Transaction implements AutoCloseable {
 
         public long transactionAddress = 0;
@@ -156,6 +200,50 @@ public abstract class DataBase {
             erase(null, key);
         }
 
+        /**
+         * Reads the values of all the `keys` in one call, without copying them
+         * into the Java heap. Keys are passed to the DB without copies as well.
+         */
+        public native void readBatch(String collection, long[] keys, Batch batch);
+
+        public Batch getBatch(String collection, long[] keys, Batch batch) {
+            readBatch(collection, keys, batch);
+            batch.offsets.order(ByteOrder.nativeOrder());
+            return batch;
+        }
+
+        public Batch getBatch(String collection, long[] keys) {
+            return getBatch(collection, keys, new Batch());
+        }
+
+        public Batch getBatch(long[] keys) {
+            return getBatch(null, keys, new Batch());
+        }
+
+        /**
+         * Maps all the `keys` to slices of one direct `values` buffer in one call.
+         * The `i`-th value spans from `offsets[i]` to `offsets[i + 1]`, where `offsets`
+         * is a direct buffer of `keys.length + 1` native-order 32-bit integers.
+         * If `values` are null, the keys are removed.
+         */
+        public native void writeBatch(String collection, long[] keys, ByteBuffer values, ByteBuffer offsets);
+
+        public void putBatch(String collection, long[] keys, ByteBuffer values, ByteBuffer offsets) {
+            writeBatch(collection, keys, values, offsets);
+        }
+
+        public void putBatch(long[] keys, ByteBuffer values, ByteBuffer offsets) {
+            writeBatch(null, keys, values, offsets);
+        }
+
+        public void eraseBatch(String collection, long[] keys) {
+            writeBatch(collection, keys, null, null);
+        }
+
+        public void eraseBatch(long[] keys) {
+            writeBatch(null, keys, null, null);
+        }
+
         /**
          * Removes the key (and its corresponding value) from this collection.
          *
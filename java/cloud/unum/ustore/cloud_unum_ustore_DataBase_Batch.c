@@ -0,0 +1,19 @@
+#include "cloud_unum_ustore_Shared.h"
+#include "cloud_unum_ustore_DataBase_Batch.h"
+
+JNIEXPORT void JNICALL Java_cloud_unum_ustore_DataBase_00024Batch_close_1(JNIEnv* env_java, jobject batch_java) {
+
+    jfieldID arena_field = find_batch_field(env_java, "arenaAddress", "J");
+    ustore_arena_t arena_c = (ustore_arena_t)(*env_java)->GetLongField(env_java, batch_java, arena_field);
+    ustore_arena_free(arena_c);
+
+    // Drop the views, so that the freed memory can't be accessed from Java
+    jfieldID presences_field = find_batch_field(env_java, "presences", "Ljava/nio/ByteBuffer;");
+    jfieldID offsets_field = find_batch_field(env_java, "offsets", "Ljava/nio/ByteBuffer;");
+    jfieldID values_field = find_batch_field(env_java, "values", "Ljava/nio/ByteBuffer;");
+    (*env_java)->SetLongField(env_java, batch_java, arena_field, 0);
+    (*env_java)->SetIntField(env_java, batch_java, find_batch_field(env_java, "count", "I"), 0);
+    (*env_java)->SetObjectField(env_java, batch_java, presences_field, NULL);
+    (*env_java)->SetObjectField(env_java, batch_java, offsets_field, NULL);
+    (*env_java)->SetObjectField(env_java, batch_java, values_field, NULL);
+}
@@ -261,4 +261,162 @@ JNIEXPORT jboolean JNICALL Java_cloud_unum_ustore_DataBase_00024Transaction_comm
 
     ustore_transaction_commit(&txn_commit);
     return error_c ? JNI_FALSE : JNI_TRUE;
-}
\ No newline at end of file
+}
+JNIEXPORT void JNICALL Java_cloud_unum_ustore_DataBase_00024Transaction_readBatch( //
+    JNIEnv* env_java,
+    jobject txn_java,
+    jstring collection_java,
+    jlongArray keys_java,
+    jobject batch_java) {
+
+    ustore_database_t db_ptr_c = db_ptr(env_java, txn_java);
+    if (!db_ptr_c) {
+        forward_error(env_java, "Database is closed!");
+        return;
+    }
+
+    ustore_transaction_t txn_ptr_c = txn_ptr(env_java, txn_java);
+    ustore_collection_t collection_ptr_c = collection_ptr(env_java, db_ptr_c, collection_java);
+    if ((*env_java)->ExceptionCheck(env_java))
+        return;
+
+    // The arena of the batch is reused between reads, invalidating the previous views
+    jfieldID arena_field = find_batch_field(env_java, "arenaAddress", "J");
+    ustore_arena_t arena_c = (ustore_arena_t)(*env_java)->GetLongField(env_java, batch_java, arena_field);
+    jsize keys_count_java = (*env_java)->GetArrayLength(env_java, keys_java);
+
+    // Pin the keys instead of copying them. No other JNI calls are allowed until they are released.
+    // https://docs.oracle.com/en/java/javase/13/docs/specs/jni/functions.html#getprimitivearraycritical-releaseprimitivearraycritical
+    ustore_key_t const* keys_c = (ustore_key_t const*)(*env_java)->GetPrimitiveArrayCritical(env_java, keys_java, NULL);
+    if (!keys_c)
+        return;
+
+    ustore_size_t count_c = (ustore_size_t)keys_count_java;
+    ustore_options_t options_c = ustore_options_default_k;
+    ustore_octet_t* found_presences_c = NULL;
+    ustore_length_t* found_offsets_c = NULL;
+    ustore_bytes_ptr_t found_values_c = NULL;
+    ustore_error_t error_c = NULL;
+    struct ustore_read_t read = {
+        .db = db_ptr_c,
+        .error = &error_c,
+        .transaction = txn_ptr_c,
+        .arena = &arena_c,
+        .options = options_c,
+        .tasks_count = count_c,
+        .collections = &collection_ptr_c,
+        .keys = keys_c,
+        .keys_stride = sizeof(ustore_key_t),
+        .presences = &found_presences_c,
+        .offsets = &found_offsets_c,
+        .values = &found_values_c,
+    };
+
+    ustore_read(&read);
+    (*env_java)->ReleasePrimitiveArrayCritical(env_java, keys_java, (void*)keys_c, JNI_ABORT);
+
+    // Remember the arena even on failure, so that `close` frees it
+    (*env_java)->SetLongField(env_java, batch_java, arena_field, (jlong)arena_c);
+    if (forward_ustore_error(env_java, error_c))
+        return;
+
+    // Export the Arrow-like layout as direct views, instead of copying every value.
+    // Empty regions still need a valid address.
+    static ustore_byte_t empty_c[sizeof(ustore_length_t)] = {0};
+    jlong presences_bytes_java = (jlong)((count_c + 7) / 8);
+    jlong offsets_bytes_java = (jlong)(count_c ? (count_c + 1) * sizeof(ustore_length_t) : 0);
+    jlong values_bytes_java = (jlong)(count_c ? found_offsets_c[count_c] : 0);
+    void* presences_c = presences_bytes_java ? (void*)found_presences_c : (void*)empty_c;
+    void* offsets_c = offsets_bytes_java ? (void*)found_offsets_c : (void*)empty_c;
+    void* values_c = values_bytes_java ? (void*)found_values_c : (void*)empty_c;
+
+    jobject presences_java = (*env_java)->NewDirectByteBuffer(env_java, presences_c, presences_bytes_java);
+    jobject offsets_java = (*env_java)->NewDirectByteBuffer(env_java, offsets_c, offsets_bytes_java);
+    jobject values_java = (*env_java)->NewDirectByteBuffer(env_java, values_c, values_bytes_java);
+    if (!presences_java || !offsets_java || !values_java) {
+        if (!(*env_java)->ExceptionCheck(env_java))
+            forward_error(env_java, "Direct buffers aren't supported by this JVM!");
+        return;
+    }
+
+    (*env_java)->SetIntField(env_java, batch_java, find_batch_field(env_java, "count", "I"), keys_count_java);
+    (*env_java)->SetObjectField(env_java,
+                                batch_java,
+                                find_batch_field(env_java, "presences", "Ljava/nio/ByteBuffer;"),
+                                presences_java);
+    (*env_java)->SetObjectField(env_java,
+                                batch_java,
+                                find_batch_field(env_java, "offsets", "Ljava/nio/ByteBuffer;"),
+                                offsets_java);
+    (*env_java)->SetObjectField(env_java,
+                                batch_java,
+                                find_batch_field(env_java, "values", "Ljava/nio/ByteBuffer;"),
+                                values_java);
+}
+
+JNIEXPORT void JNICALL Java_cloud_unum_ustore_DataBase_00024Transaction_writeBatch( //
+    JNIEnv* env_java,
+    jobject txn_java,
+    jstring collection_java,
+    jlongArray keys_java,
+    jobject values_java,
+    jobject offsets_java) {
+
+    ustore_database_t db_ptr_c = db_ptr(env_java, txn_java);
+    if (!db_ptr_c) {
+        forward_error(env_java, "Database is closed!");
+        return;
+    }
+
+    ustore_transaction_t txn_ptr_c = txn_ptr(env_java, txn_java);
+    ustore_collection_t collection_ptr_c = collection_ptr(env_java, db_ptr_c, collection_java);
+    if ((*env_java)->ExceptionCheck(env_java))
+        return;
+
+    // Without values, all the keys are removed
+    jsize keys_count_java = (*env_java)->GetArrayLength(env_java, keys_java);
+    ustore_bytes_cptr_t values_c = NULL;
+    ustore_length_t const* offsets_c = NULL;
+    if (values_java) {
+        values_c = (ustore_bytes_cptr_t)(*env_java)->GetDirectBufferAddress(env_java, values_java);
+        offsets_c = offsets_java ? (ustore_length_t const*)(*env_java)->GetDirectBufferAddress(env_java, offsets_java)
+                                 : NULL;
+        if (!values_c || !offsets_c) {
+            forward_error(env_java, "Values and offsets must be direct buffers!");
+            return;
+        }
+        jlong offsets_bytes_java = (*env_java)->GetDirectBufferCapacity(env_java, offsets_java);
+        if (offsets_bytes_java < (jlong)((keys_count_java + 1) * sizeof(ustore_length_t))) {
+            forward_error(env_java, "Offsets must contain one more entry than the keys!");
+            return;
+        }
+    }
+
+    // Pin the keys instead of copying them. No other JNI calls are allowed until they are released.
+    ustore_key_t const* keys_c = (ustore_key_t const*)(*env_java)->GetPrimitiveArrayCritical(env_java, keys_java, NULL);
+    if (!keys_c)
+        return;
+
+    ustore_options_t options_c = ustore_options_default_k;
+    ustore_arena_t arena_c = NULL;
+    ustore_error_t error_c = NULL;
+    struct ustore_write_t write = {
+        .db = db_ptr_c,
+        .error = &error_c,
+        .transaction = txn_ptr_c,
+        .arena = &arena_c,
+        .options = options_c,
+        .tasks_count = (ustore_size_t)keys_count_java,
+        .collections = &collection_ptr_c,
+        .keys = keys_c,
+        .keys_stride = sizeof(ustore_key_t),
+        .offsets = offsets_c,
+        .offsets_stride = sizeof(ustore_length_t),
+        .values = values_c ? &values_c : NULL,
+    };
+
+    ustore_write(&write);
+    (*env_java)->ReleasePrimitiveArrayCritical(env_java, keys_java, (void*)keys_c, JNI_ABORT);
+    ustore_arena_free(arena_c);
+    forward_ustore_error(env_java, error_c);
+}
@@ -49,6 +49,20 @@ JNIEXPORT jbyteArray JNICALL Java_cloud_unum_ustore_DataBase_00024Transaction_ge
  */
 JNIEXPORT void JNICALL Java_cloud_unum_ustore_DataBase_00024Transaction_erase(JNIEnv*, jobject, jstring, jlong);
 
+/*
+ * Class:     cloud_unum_ustore_DataBase_Transaction
+ * Method:    readBatch
+ * Signature: (Ljava/lang/String;[JLcloud/unum/ustore/DataBase$Batch;)V
+ */
+JNIEXPORT void JNICALL Java_cloud_unum_ustore_DataBase_00024Transaction_readBatch(JNIEnv*, jobject, jstring, jlongArray, jobject);
+
+/*
+ * Class:     cloud_unum_ustore_DataBase_Transaction
+ * Method:    writeBatch
+ * Signature: (Ljava/lang/String;[JLjava/nio/ByteBuffer;Ljava/nio/ByteBuffer;)V
+ */
+JNIEXPORT void JNICALL Java_cloud_unum_ustore_DataBase_00024Transaction_writeBatch(JNIEnv*, jobject, jstring, jlongArray, jobject, jobject);
+
 #ifdef __cplusplus
 }
 #endif
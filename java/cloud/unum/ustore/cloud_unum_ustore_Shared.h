@@ -13,6 +13,8 @@ jfieldID find_db_field(JNIEnv* env_java);
 
 jfieldID find_txn_field(JNIEnv* env_java);
 
+jfieldID find_batch_field(JNIEnv* env_java, char const* name, char const* signature);
+
 ustore_database_t db_ptr(JNIEnv* env_java, jobject txn_java);
 
 ustore_transaction_t txn_ptr(JNIEnv* env_java, jobject txn_java);
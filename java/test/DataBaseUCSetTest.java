@@ -2,6 +2,8 @@
 import cloud.unum.ustore.DataBaseUCSet;
 import org.junit.Test;
 
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
 import java.util.Arrays;
 
 public class DataBaseUCSetTest {
@@ -20,6 +22,21 @@ public class DataBaseUCSetTest {
         txn.commit();
         assert Arrays.equals(ctx.get("any", 42), "meaning of life".getBytes()) : "Accepted wrong philosophy";
 
+        long[] keys = {1, 2, 3};
+        byte[] joined = "abbccc".getBytes();
+        ByteBuffer values = ByteBuffer.allocateDirect(joined.length);
+        values.put(joined);
+        ByteBuffer offsets = ByteBuffer.allocateDirect(4 * (keys.length + 1)).order(ByteOrder.nativeOrder());
+        offsets.putInt(0).putInt(1).putInt(3).putInt(6);
+        ctx.putBatch(keys, values, offsets);
+        assert Arrays.equals(ctx.get(2), "bb".getBytes()) : "Batch write failed";
+
+        ctx.eraseBatch(new long[] {1});
+        try (DataBaseUCSet.Batch batch = ctx.getBatch(new long[] {1, 3})) {
+            assert batch.get(0) == null : "Batch erase failed";
+            assert batch.get(1).remaining() == 3 : "Batch read failed";
+        }
+
         ctx.close();
         System.out.println("Success!");
     }
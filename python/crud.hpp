@@ -1,13 +1,17 @@
 
 #pragma once
 #include <vector> // `std::vector`
+#include <future> // `std::async`
+#include <mutex>  // `std::mutex`
 
 #include <pybind11/pybind11.h> // `gil_scoped_release`
 #include <Python.h>            // `PyObject`
 #include <arrow/array.h>
+#include <arrow/c/bridge.h> // `ImportRecordBatch`
 #include <arrow/python/pyarrow.h>
 
 #include "ustore/ustore.h"
+#include "ustore/arrow.h"
 #include "cast_args.hpp"
 
 namespace unum::ustore::pyb {
@@ -391,6 +395,249 @@ static py::array_t<ustore_key_t> scan_binary( //
         return py::array_t<ustore_key_t>(found_lengths[0], found_keys);
 }
 
+/**
+ * @brief Iterates over a range of keys in batches of keys and, optionally, values.
+ * While Python consumes one batch, the next one is fetched on a background thread
+ * with the GIL released.
+ *
+ * Every batch is exported from its own arena, which returns into a shared pool only
+ * once Python drops the last Arrow buffer referencing it, so batches may outlive
+ * the iterator. Transactional scans are fetched in the foreground, as the same
+ * transaction may be used from Python in the meantime.
+ */
+class py_scan_stream_t {
+
+    struct arenas_pool_t {
+        std::mutex mutex;
+        std::vector<ustore_arena_t> arenas;
+
+        ~arenas_pool_t() noexcept {
+            for (ustore_arena_t arena : arenas)
+                ustore_arena_free(arena);
+        }
+        ustore_arena_t pop() noexcept {
+            std::unique_lock _ {mutex};
+            if (arenas.empty())
+                return nullptr;
+            ustore_arena_t arena = arenas.back();
+            arenas.pop_back();
+            return arena;
+        }
+        void push(ustore_arena_t arena) noexcept {
+            if (!arena)
+                return;
+            std::unique_lock _ {mutex};
+            try {
+                arenas.push_back(arena);
+            }
+            catch (...) {
+                ustore_arena_free(arena);
+            }
+        }
+    };
+
+    struct batch_t {
+        ustore_arena_t arena = nullptr;
+        ustore_length_t count = 0;
+        ustore_key_t* keys = nullptr;
+        ustore_octet_t* presences = nullptr;
+        ustore_length_t* offsets = nullptr;
+        ustore_bytes_ptr_t values = nullptr;
+    };
+
+    /// @brief Attached to every exported Arrow batch, to return its arena, once released.
+    struct batch_owner_t {
+        std::shared_ptr<arenas_pool_t> pool;
+        ustore_arena_t arena;
+    };
+
+    static void release_batch(ArrowArray* array) {
+        auto owner = static_cast<batch_owner_t*>(array->private_data);
+        release_malloced_array(array);
+        owner->pool->push(owner->arena);
+        delete owner;
+    }
+
+    std::shared_ptr<py_db_t> py_db_ptr_;
+    std::shared_ptr<py_transaction_t> py_txn_ptr_;
+    ustore_database_t db_;
+    ustore_transaction_t txn_;
+    ustore_options_t options_;
+    ustore_collection_t collection_;
+    ustore_key_t next_key_;
+    ustore_key_t end_key_;
+    ustore_length_t batch_size_;
+    bool export_values_;
+    bool export_arrow_;
+    bool exhausted_ = false;
+
+    std::shared_ptr<arenas_pool_t> pool_ = std::make_shared<arenas_pool_t>();
+    std::future<std::pair<status_t, batch_t>> next_batch_;
+
+    /**
+     * @brief Scans the next batch of keys and reads their values into a pooled arena.
+     * May run in the background, but never concurrently with itself.
+     */
+    std::pair<status_t, batch_t> fetch() noexcept {
+        status_t status;
+        batch_t batch;
+        if (exhausted_)
+            return {std::move(status), batch};
+
+        batch.arena = pool_->pop();
+        ustore_length_t* found_counts = nullptr;
+        ustore_scan_t scan {};
+        scan.db = db_;
+        scan.error = status.member_ptr();
+        scan.transaction = txn_;
+        scan.arena = &batch.arena;
+        scan.options = options_;
+        scan.tasks_count = 1;
+        scan.collections = &collection_;
+        scan.start_keys = &next_key_;
+        scan.end_keys = &end_key_;
+        scan.count_limits = &batch_size_;
+        scan.counts = &found_counts;
+        scan.keys = &batch.keys;
+
+        ustore_scan(&scan);
+        if (!status)
+            return {std::move(status), batch};
+
+        batch.count = found_counts[0];
+        ustore_key_t last_key = batch.count ? batch.keys[batch.count - 1] : end_key_;
+        exhausted_ = batch.count < batch_size_ || last_key == std::numeric_limits<ustore_key_t>::max();
+        next_key_ = exhausted_ ? last_key : last_key + 1;
+        if (!export_values_ || !batch.count)
+            return {std::move(status), batch};
+
+        ustore_read_t read {};
+        read.db = db_;
+        read.error = status.member_ptr();
+        read.transaction = txn_;
+        read.arena = &batch.arena;
+        read.options = ustore_options_t(options_ | ustore_option_dont_discard_memory_k);
+        read.tasks_count = batch.count;
+        read.collections = &collection_;
+        read.keys = batch.keys;
+        read.keys_stride = sizeof(ustore_key_t);
+        read.presences = &batch.presences;
+        read.offsets = &batch.offsets;
+        read.values = &batch.values;
+
+        ustore_read(&read);
+        return {std::move(status), batch};
+    }
+
+    void schedule() {
+        if (!exhausted_ && !txn_)
+            next_batch_ = std::async(std::launch::async, [this] { return fetch(); });
+    }
+
+    py::object export_arrow(batch_t const& batch) {
+        static ustore_byte_t const empty_k = 0;
+        status_t status;
+        ArrowSchema schema_c;
+        ArrowArray array_c;
+        ustore_to_arrow_schema(batch.count, export_values_ ? 2 : 1, &schema_c, &array_c, status.member_ptr());
+        ustore_to_arrow_column( //
+            batch.count,
+            "keys",
+            ustore_doc_field_i64_k,
+            nullptr,
+            nullptr,
+            batch.keys,
+            schema_c.children[0],
+            array_c.children[0],
+            status.member_ptr());
+        if (export_values_)
+            ustore_to_arrow_column( //
+                batch.count,
+                "vals",
+                ustore_doc_field_bin_k,
+                batch.presences,
+                batch.offsets,
+                batch.values ? batch.values : &empty_k,
+                schema_c.children[1],
+                array_c.children[1],
+                status.member_ptr());
+        if (!status) {
+            schema_c.release(&schema_c);
+            array_c.release(&array_c);
+            pool_->push(batch.arena);
+            status.throw_unhandled();
+        }
+
+        // From here on, Arrow will release the array and the arena, even on failure
+        array_c.private_data = new batch_owner_t {pool_, batch.arena};
+        array_c.release = &release_batch;
+        std::shared_ptr<arrow::RecordBatch> batch_arrow = arrow::ImportRecordBatch(&array_c, &schema_c).ValueOrDie();
+        PyObject* batch_python = arrow::py::wrap_batch(batch_arrow);
+        return py::reinterpret_steal<py::object>(batch_python);
+    }
+
+    py::object export_python(batch_t const& batch) {
+        py::array_t<ustore_key_t> keys(batch.count, batch.keys);
+        if (!export_values_) {
+            pool_->push(batch.arena);
+            return std::move(keys);
+        }
+
+        py::list values(batch.count);
+        for (ustore_length_t i = 0; i != batch.count; ++i) {
+            if (batch.presences && !check_presence(batch.presences, i)) {
+                values[i] = py::none();
+                continue;
+            }
+            auto begin = reinterpret_cast<char const*>(batch.values) + batch.offsets[i];
+            values[i] = py::bytes(begin, batch.offsets[i + 1] - batch.offsets[i]);
+        }
+        pool_->push(batch.arena);
+        return py::make_tuple(std::move(keys), std::move(values));
+    }
+
+  public:
+    template <typename collection_at>
+    py_scan_stream_t(py_collection_gt<collection_at>& collection,
+                     ustore_key_t start_key,
+                     ustore_key_t end_key,
+                     ustore_length_t batch_size,
+                     bool export_values)
+        : py_db_ptr_(collection.py_db_ptr), py_txn_ptr_(collection.py_txn_ptr), db_(collection.db()),
+          txn_(collection.txn()), options_(collection.options()), collection_(*collection.member_collection()),
+          next_key_(start_key), end_key_(end_key), batch_size_(std::max<ustore_length_t>(batch_size, 1)),
+          export_values_(export_values), export_arrow_(collection.export_into_arrow()) {
+        exhausted_ = end_key_ <= next_key_;
+        schedule();
+    }
+
+    py_scan_stream_t(py_scan_stream_t const&) = delete;
+    ~py_scan_stream_t() noexcept {
+        if (!next_batch_.valid())
+            return;
+        auto result = next_batch_.get();
+        pool_->push(result.second.arena);
+    }
+
+    py::object next() {
+        std::pair<status_t, batch_t> result;
+        {
+            [[maybe_unused]] py::gil_scoped_release release;
+            result = next_batch_.valid() ? next_batch_.get() : fetch();
+        }
+        batch_t const& batch = result.second;
+        if (!result.first || !batch.count) {
+            pool_->push(batch.arena);
+            result.first.throw_unhandled();
+            throw py::stop_iteration();
+        }
+
+        // Start fetching the next batch, while this one is being exported and consumed
+        schedule();
+        return export_arrow_ ? export_arrow(batch) : export_python(batch);
+    }
+};
+
 template <typename collection_at>
 static std::size_t get_length(py_collection_gt<collection_at>& collection) {
     return collection.native.size();
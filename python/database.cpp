@@ -121,6 +121,7 @@ void ustore::wrap_database(py::module& m) {
     auto py_kvrange = py::class_<pairs_range_t>(m, "ItemsRange", py::module_local());
     auto py_kstream = py::class_<py_kstream_t>(m, "KeysStream", py::module_local());
     auto py_kvstream = py::class_<py_kvstream_t>(m, "ItemsStream", py::module_local());
+    auto py_scan_stream = py::class_<py_scan_stream_t>(m, "ScanStream", py::module_local());
 
     // Define `DataBase`
     py_db.def( //
@@ -148,6 +149,19 @@ void ustore::wrap_database(py::module& m) {
     py_collection.def("update", &update_binary);
     py_collection.def("broadcast", &broadcast_binary);
     py_collection.def("scan", &scan_binary<blobs_collection_t>);
+    py_collection.def(
+        "scan_batches",
+        [](py_blobs_collection_t& py_collection,
+           ustore_key_t start,
+           ustore_key_t stop,
+           ustore_length_t batch_size,
+           bool values) {
+            return std::make_unique<py_scan_stream_t>(py_collection, start, stop, batch_size, values);
+        },
+        py::arg("start") = std::numeric_limits<ustore_key_t>::min(),
+        py::arg("stop") = std::numeric_limits<ustore_key_t>::max(),
+        py::arg("batch_size") = 64 * 1024,
+        py::arg("values") = true);
     py_collection.def("__setitem__", &write_binary<blobs_collection_t>);
     py_collection.def("__delitem__", &remove_binary<blobs_collection_t>);
     py_collection.def("__contains__", &has_binary<blobs_collection_t>);
@@ -313,6 +327,14 @@ void ustore::wrap_database(py::module& m) {
     //     return py::array(remaining, keys.begin() + start);
     // });
 
+    // Yields `pyarrow.RecordBatch`-es of "keys" and "vals" columns, or tuples
+    // of a NumPy array of keys and a list of values, if Arrow isn't preferred.
+    py_scan_stream.def(
+        "__iter__",
+        [](py_scan_stream_t& stream) -> py_scan_stream_t& { return stream; },
+        py::return_value_policy::reference_internal);
+    py_scan_stream.def("__next__", &py_scan_stream_t::next);
+
     py_kstream.def("__next__", [](py_kstream_t& kstream) {
         ustore_key_t key = kstream.native.key();
         if (kstream.native.is_end() || kstream.stop)
@@ -4,7 +4,6 @@
 #include "crud.hpp"
 #include "nlohmann.hpp"
 #include "cast_args.hpp"
-#include "algorithms/louvain.cpp"
 
 using namespace unum::ustore::pyb;
 using namespace unum::ustore;
@@ -69,7 +68,7 @@ void compute_degrees(py_graph_gt<type_ak>& graph,
     graph_find_edges.vertices_stride = vertices.stride();
     graph_find_edges.roles = &role;
     graph_find_edges.degrees_per_vertex = degrees;
-    graph_find_edges.edges_per_vertex = &edges_per_vertex;
+    graph_find_edges.edges_per_vertex = weight ? &edges_per_vertex : nullptr;
 
     ustore_graph_find_edges(&graph_find_edges);
     status.throw_unhandled();
@@ -476,7 +475,7 @@ auto degs_call(degree_view_t<type_ak>& degs, std::string weight = "") {
 template <graph_type_t type_ak>
 auto degs_iter(degree_view_t<type_ak>& degs) {
     auto& g = *degs.net_ptr.lock().get();
-    blobs_range_t members(g.index.db(), g.index.txn(), 0, g.index);
+    blobs_range_t members(g.index.db(), g.index.txn(), 0, g.index, ustore_vertex_id_min_k);
     keys_stream_t stream = keys_range_t({members}).begin();
     return degrees_stream_t(std::move(stream), g, degs.weight, degs.roles);
 }
@@ -625,7 +624,7 @@ auto number_of_edges(py_graph_gt<type_ak>& g) {
 
 template <graph_type_t type_ak>
 auto nodes(py_graph_gt<type_ak>& g) {
-    blobs_range_t members(g.index.db(), g.index.txn(), 0, g.index);
+    blobs_range_t members(g.index.db(), g.index.txn(), 0, g.index, ustore_vertex_id_min_k);
     keys_range_t keys {members};
     auto range = std::make_shared<nodes_range_t<type_ak>>(keys, g.vertices_attrs);
     return range;
@@ -661,15 +660,14 @@ auto has_node(py_graph_gt<type_ak>& g, ustore_key_t v) {
 template <graph_type_t type_ak>
 auto has_edge(py_graph_gt<type_ak>& g, ustore_key_t v1, ustore_key_t v2) {
     if (type_ak == digraph_k || type_ak == multidigraph_k)
-        return g.ref().edges_between(v1, v2).throw_or_release().size() != 0;
-    return g.ref().edges_between(v1, v2).throw_or_release().size() != 0 ||
-           g.ref().edges_between(v2, v1).throw_or_release().size() != 0;
+        return g.ref().contains_edge(v1, v2).throw_or_release();
+    return g.ref().contains_edge(v1, v2).throw_or_release() || g.ref().contains_edge(v2, v1).throw_or_release();
 }
 
 template <graph_type_t type_ak>
 auto has_edge_with_id(py_graph_gt<type_ak>& g, ustore_key_t v1, ustore_key_t v2, ustore_key_t e) {
-    auto ids = g.ref().edges_between(v1, v2).throw_or_release().edge_ids;
-    return std::find(ids.begin(), ids.end(), e) != ids.end();
+    bits_span_t presences = g.ref().contains_edges({{&v1}, 1}, {{&v2}, 1}, {{&e}, 1}).throw_or_release();
+    return bool(presences[0]);
 }
 
 template <graph_type_t type_ak>
@@ -699,8 +697,203 @@ auto predecessors(py_graph_gt<type_ak>& g, ustore_key_t n) {
 template <graph_type_t type_ak>
 auto community_louvain(py_graph_gt<type_ak>& g) {
     graph_collection_t graph = g.ref();
-    auto partition = best_partition(graph);
-    return py::cast(partition);
+    ustore_graph_csr_t csr = graph.csr(ustore_vertex_role_any_k).throw_or_release();
+
+    status_t status;
+    arena_t arena(g.index.db());
+    ustore_key_t* labels = nullptr;
+    ustore_graph_louvain_t louvain {};
+    louvain.error = status.member_ptr();
+    louvain.arena = arena.member_ptr();
+    louvain.csr = &csr;
+    louvain.labels = &labels;
+
+    ustore_graph_louvain(&louvain);
+    status.throw_unhandled();
+
+    py::dict partition;
+    for (std::size_t vertex_idx = 0; vertex_idx != csr.vertices_count; ++vertex_idx)
+        partition[py::int_(csr.vertices[vertex_idx])] = py::int_(labels[vertex_idx]);
+    return partition;
+}
+
+/**
+ * @brief Owns the arena of a CSR snapshot, which is exported into NumPy arrays without copies.
+ * Every array references it through a capsule, so the arena is freed with the last of them.
+ */
+struct py_csr_snapshot_t {
+    arena_t arena;
+    ustore_graph_csr_t csr {};
+
+    py_csr_snapshot_t(ustore_database_t db) noexcept : arena(db) {}
+    ~py_csr_snapshot_t() noexcept { ustore_graph_free_csr(&csr); }
+};
+
+template <typename element_at>
+py::array_t<element_at> wrap_into_array( //
+    std::shared_ptr<py_csr_snapshot_t> const& snapshot,
+    element_at const* data,
+    std::size_t count) {
+    auto owner = new std::shared_ptr<py_csr_snapshot_t>(snapshot);
+    py::capsule base(owner, [](void* owner) { delete static_cast<std::shared_ptr<py_csr_snapshot_t>*>(owner); });
+    py::array_t<element_at> array(static_cast<py::ssize_t>(count), data, base);
+    array.attr("setflags")(py::arg("write") = false);
+    return array;
+}
+
+/**
+ * @brief Materializes the whole graph into a CSR, exporting outgoing edges of directed graphs
+ * and both directions of undirected ones, so the neighbors match `g[n]`.
+ */
+template <graph_type_t type_ak>
+std::shared_ptr<py_csr_snapshot_t> export_csr(py_graph_gt<type_ak>& g) {
+    constexpr bool is_directed_k = type_ak == digraph_k || type_ak == multidigraph_k;
+    auto snapshot = std::make_shared<py_csr_snapshot_t>(g.index.db());
+
+    status_t status;
+    ustore_graph_export_csr_t graph_export_csr {};
+    graph_export_csr.db = g.index.db();
+    graph_export_csr.error = status.member_ptr();
+    graph_export_csr.transaction = g.index.txn();
+    graph_export_csr.snapshot = g.index.snap();
+    graph_export_csr.arena = snapshot->arena.member_ptr();
+    graph_export_csr.collection = g.index;
+    graph_export_csr.role = is_directed_k ? ustore_vertex_source_k : ustore_vertex_role_any_k;
+    graph_export_csr.csr = &snapshot->csr;
+    {
+        py::gil_scoped_release release;
+        ustore_graph_export_csr(&graph_export_csr);
+    }
+    status.throw_unhandled();
+    return snapshot;
+}
+
+/**
+ * @brief CSR of a subgraph, induced by a subset of vertices, in NumPy-owned arrays.
+ * Neighbors are indexes in the sorted and deduplicated `vertices`.
+ */
+struct py_csr_subgraph_t {
+    py::array_t<ustore_key_t> vertices;
+    py::array_t<std::int64_t> offsets;
+    py::array_t<std::int64_t> neighbors;
+    py::array_t<ustore_key_t> edges_ids;
+    py::array_t<ustore_float_t> weights;
+};
+
+static py_csr_subgraph_t induced_subgraph(ustore_graph_csr_t const& csr, py::handle nodes) {
+    if (!PySequence_Check(nodes.ptr()))
+        throw std::invalid_argument("Nodes Must Be Sequence");
+
+    std::vector<ustore_key_t> ids(PySequence_Size(nodes.ptr()));
+    py_transform_n(nodes.ptr(), &py_to_scalar<ustore_key_t>, ids.begin());
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+    // Map the kept vertices to their new indexes, preserving the order
+    std::vector<std::int64_t> new_indexes(csr.vertices_count, -1);
+    std::vector<std::size_t> old_indexes;
+    old_indexes.reserve(ids.size());
+    for (ustore_key_t id : ids) {
+        auto it = std::lower_bound(csr.vertices, csr.vertices + csr.vertices_count, id);
+        if (it == csr.vertices + csr.vertices_count || *it != id)
+            continue;
+        new_indexes[it - csr.vertices] = static_cast<std::int64_t>(old_indexes.size());
+        old_indexes.push_back(it - csr.vertices);
+    }
+
+    py_csr_subgraph_t sub;
+    sub.vertices = py::array_t<ustore_key_t>(static_cast<py::ssize_t>(old_indexes.size()));
+    sub.offsets = py::array_t<std::int64_t>(static_cast<py::ssize_t>(old_indexes.size() + 1));
+    auto vertices = sub.vertices.mutable_data();
+    auto offsets = sub.offsets.mutable_data();
+
+    // Count the edges, that stay within the subset
+    offsets[0] = 0;
+    for (std::size_t i = 0; i != old_indexes.size(); ++i) {
+        auto old_index = old_indexes[i];
+        vertices[i] = csr.vertices[old_index];
+        auto kept = std::count_if(csr.neighbors + csr.offsets[old_index],
+                                  csr.neighbors + csr.offsets[old_index + 1],
+                                  [&](ustore_size_t neighbor) { return new_indexes[neighbor] >= 0; });
+        offsets[i + 1] = offsets[i] + kept;
+    }
+
+    auto edges_count = static_cast<py::ssize_t>(offsets[old_indexes.size()]);
+    sub.neighbors = py::array_t<std::int64_t>(edges_count);
+    sub.edges_ids = py::array_t<ustore_key_t>(edges_count);
+    sub.weights = py::array_t<ustore_float_t>(edges_count);
+    auto neighbors = sub.neighbors.mutable_data();
+    auto edges_ids = sub.edges_ids.mutable_data();
+    auto weights = sub.weights.mutable_data();
+
+    std::size_t edge_idx = 0;
+    for (auto old_index : old_indexes) {
+        for (auto i = csr.offsets[old_index]; i != csr.offsets[old_index + 1]; ++i) {
+            auto new_index = new_indexes[csr.neighbors[i]];
+            if (new_index < 0)
+                continue;
+            neighbors[edge_idx] = new_index;
+            edges_ids[edge_idx] = csr.edges_ids[i];
+            weights[edge_idx] = csr.weights[i];
+            ++edge_idx;
+        }
+    }
+    return sub;
+}
+
+/**
+ * @brief Exports the whole graph, or the subgraph induced by @p nodes, in the CSR form:
+ * `(vertices, offsets, neighbors, edges_ids)`. Whole-graph arrays are read-only views
+ * into the exported snapshot, which is freed once all of them are garbage-collected.
+ */
+template <graph_type_t type_ak>
+py::tuple to_csr(py_graph_gt<type_ak>& g, py::object nodes) {
+    auto snapshot = export_csr(g);
+    ustore_graph_csr_t const& csr = snapshot->csr;
+    if (!nodes.is_none()) {
+        auto sub = induced_subgraph(csr, nodes);
+        return py::make_tuple(sub.vertices, sub.offsets, sub.neighbors, sub.edges_ids);
+    }
+
+    // Indexes never exceed `std::int64_t`, so they are exported as signed, like SciPy expects
+    return py::make_tuple( //
+        wrap_into_array(snapshot, csr.vertices, csr.vertices_count),
+        wrap_into_array(snapshot, reinterpret_cast<std::int64_t const*>(csr.offsets), csr.vertices_count + 1),
+        wrap_into_array(snapshot, reinterpret_cast<std::int64_t const*>(csr.neighbors), csr.edges_count),
+        wrap_into_array(snapshot, csr.edges_ids, csr.edges_count));
+}
+
+/**
+ * @brief Exports the adjacency matrix as a `scipy.sparse.csr_array`, with rows and columns
+ * ordered by vertex IDs. If @p weight is false, all the stored entries are ones.
+ * https://networkx.org/documentation/stable/reference/generated/networkx.convert_matrix.to_scipy_sparse_array.html
+ */
+template <graph_type_t type_ak>
+py::object to_scipy_sparse_array(py_graph_gt<type_ak>& g, py::object nodelist, bool weight) {
+    auto snapshot = export_csr(g);
+    ustore_graph_csr_t const& csr = snapshot->csr;
+
+    py::object data, indices, indptr;
+    std::size_t vertices_count = 0;
+    if (!nodelist.is_none()) {
+        auto sub = induced_subgraph(csr, nodelist);
+        vertices_count = sub.vertices.size();
+        data = sub.weights, indices = sub.neighbors, indptr = sub.offsets;
+    }
+    else {
+        vertices_count = csr.vertices_count;
+        data = wrap_into_array(snapshot, csr.weights, csr.edges_count);
+        indices = wrap_into_array(snapshot, reinterpret_cast<std::int64_t const*>(csr.neighbors), csr.edges_count);
+        indptr = wrap_into_array(snapshot, reinterpret_cast<std::int64_t const*>(csr.offsets), csr.vertices_count + 1);
+    }
+    if (!weight)
+        data = py::module_::import("numpy").attr("ones")(py::len(indices), "float32");
+
+    // `csr_array` only appeared in SciPy 1.8, older versions only have matrices
+    auto sparse = py::module_::import("scipy.sparse");
+    auto constructor = py::hasattr(sparse, "csr_array") ? sparse.attr("csr_array") : sparse.attr("csr_matrix");
+    auto shape = py::make_tuple(vertices_count, vertices_count);
+    return constructor(py::make_tuple(data, indices, indptr), py::arg("shape") = shape);
 }
 
 template <graph_type_t type_ak>
@@ -1292,6 +1485,14 @@ void ustore::wrap_networkx(py::module& m, std::string const& name) {
     g.def("clear", &clear<type_ak>);
     g.def("community_louvain", &community_louvain<type_ak>);
 
+    // Bulk exports for vectorized libraries
+    // https://networkx.org/documentation/stable/reference/convert.html#numpy
+    g.def("to_csr", &to_csr<type_ak>, py::arg("nodes") = py::none());
+    g.def("to_scipy_sparse_array",
+          &to_scipy_sparse_array<type_ak>,
+          py::arg("nodelist") = py::none(),
+          py::arg("weight") = true);
+
     if (type_ak == digraph_k || type_ak == multidigraph_k) {
         g.def_property_readonly("in_degree", &in_degree<type_ak>);
         g.def_property_readonly("out_degree", &out_degree<type_ak>);
@@ -85,150 +85,278 @@ void scan_rows_range(py_table_collection_t& df) {
     df.rows_keys = std::move(keys_found);
 }
 
-void correct_table(docs_table_t& table) {
+static ustore_doc_compare_t ustore_doc_compare_from_str(std::string_view operator_name) {
+    if (operator_name == "=="sv)
+        return ustore_doc_compare_eq_k;
+    else if (operator_name == "!="sv)
+        return ustore_doc_compare_ne_k;
+    else if (operator_name == "<"sv)
+        return ustore_doc_compare_lt_k;
+    else if (operator_name == "<="sv)
+        return ustore_doc_compare_le_k;
+    else if (operator_name == ">"sv)
+        return ustore_doc_compare_gt_k;
+    else if (operator_name == ">="sv)
+        return ustore_doc_compare_ge_k;
+
+    throw std::invalid_argument("Unknown comparison operator");
+    return ustore_doc_compare_eq_k;
+}
 
-    std::vector<std::size_t> binary_column_indexes;
-    for (std::size_t collection_idx = 0; collection_idx != table.collections(); ++collection_idx) {
-        column_view_t column = table.column(collection_idx);
-        if (column.type() == ustore_doc_field_str_k || column.type() == ustore_doc_field_bin_k)
-            binary_column_indexes.push_back(collection_idx);
-    }
+static std::string_view trim(std::string_view str) noexcept {
+    auto begin = str.find_first_not_of(" \t\n");
+    if (begin == std::string_view::npos)
+        return {};
+    return str.substr(begin, str.find_last_not_of(" \t\n") - begin + 1);
+}
 
-    if (binary_column_indexes.size() < 2)
-        return;
-
-    // Collecting old offsets and lengths
-    std::size_t offset_index = 0;
-    ustore_length_t contents_length = 0;
-    std::size_t offsets_per_column = table.rows() + 1;
-    std::vector<ustore_length_t> offs(binary_column_indexes.size() * offsets_per_column);
-    std::vector<ustore_length_t> lens(binary_column_indexes.size() * offsets_per_column);
-
-    for (std::size_t column_idx : binary_column_indexes) {
-        column_view_t column = table.column(column_idx);
-        for (ustore_length_t idx = 0; idx != column.size(); ++idx) {
-            offs[offset_index] = column.offsets()[idx];
-            lens[offset_index] = column.lengths()[idx];
-            contents_length += column.lengths()[idx];
-            ++offset_index;
-        }
-        offs[offset_index++] = column.offsets()[column.size()];
+/**
+ * @brief Converts Python literals, like `'text'`, `True` or `4.2`, into JSON scalars.
+ */
+static std::string json_from_literal(std::string_view literal) {
+    bool is_quoted = literal.size() >= 2 && (literal.front() == '\'' || literal.front() == '"') &&
+                     literal.back() == literal.front();
+    if (!is_quoted)
+        return literal == "True"sv ? "true" : literal == "False"sv ? "false" : std::string(literal);
+
+    std::string json = "\"";
+    for (char c : literal.substr(1, literal.size() - 2)) {
+        if (c == '"' || c == '\\')
+            json.push_back('\\');
+        json.push_back(c);
     }
+    json.push_back('"');
+    return json;
+}
 
-    // Correctly write contents and offsets in temporary buffers
-    ustore_length_t offset = 0;
-    auto contents_begin = table.column(0).contents();
-    char buffer[contents_length];
-    for (std::size_t idx = 0; idx != lens.size(); ++idx) {
-        std::memcpy(buffer + offset, contents_begin + offs[idx], lens[idx]);
-        offs[idx] = offset;
-        offset += lens[idx];
+/**
+ * @brief Records a conjunction of comparisons, like `age >= 18 and name != 'Joe'`,
+ * which will be evaluated inside of `ustore_docs_gather()`.
+ * https://pandas.pydata.org/docs/reference/api/pandas.DataFrame.query.html
+ */
+static void add_query(py_table_collection_t& df, std::string_view query) {
+
+    // Split the conjunction, skipping the quoted literals
+    std::vector<std::string_view> clauses;
+    char quote = 0;
+    std::size_t clause_begin = 0;
+    for (std::size_t i = 0; i != query.size(); ++i) {
+        char c = query[i];
+        if (quote)
+            quote = c == quote ? 0 : quote;
+        else if (c == '\'' || c == '"')
+            quote = c;
+        else if (c == '&' || query.substr(i, 5) == " and "sv) {
+            clauses.push_back(query.substr(clause_begin, i - clause_begin));
+            i += c == '&' ? 0 : 4;
+            clause_begin = i + 1;
+        }
     }
-
-    // Rewrite contents and offsets on arena
-    offset_index = 0;
-    std::memcpy(contents_begin, buffer, contents_length);
-    for (std::size_t column_idx : binary_column_indexes) {
-        column_view_t column = table.column(column_idx);
-        std::memcpy(column.offsets(), offs.data() + offset_index, offsets_per_column * sizeof(ustore_length_t));
-        offset_index += offsets_per_column;
+    clauses.push_back(query.substr(clause_begin));
+
+    for (auto clause : clauses) {
+        clause = trim(clause);
+        if (clause.size() > 1 && clause.front() == '(' && clause.back() == ')')
+            clause = trim(clause.substr(1, clause.size() - 2));
+
+        auto operator_begin = clause.find_first_of("<>=!");
+        auto operator_end = clause.find_first_not_of("<>=!", operator_begin);
+        if (operator_begin == std::string_view::npos || operator_end == std::string_view::npos)
+            throw std::invalid_argument("Query must be a conjunction of `field <op> literal` comparisons");
+
+        auto field = trim(clause.substr(0, operator_begin));
+        auto literal = trim(clause.substr(operator_end));
+        if (field.empty() || literal.empty())
+            throw std::invalid_argument("Query must be a conjunction of `field <op> literal` comparisons");
+
+        df.filters_fields.emplace_back(field);
+        df.filters_operators.push_back(
+            ustore_doc_compare_from_str(clause.substr(operator_begin, operator_end - operator_begin)));
+        df.filters_values.push_back(json_from_literal(literal));
     }
+    df.invalidate();
 }
 
-static std::shared_ptr<arrow::RecordBatch> materialize(py_table_collection_t& df) {
-
-    // Extract the keys, if not explicitly defined
+static void scan_rows_if_needed(py_table_collection_t& df) {
     if (std::holds_alternative<std::monostate>(df.rows_keys))
         scan_rows(df);
     else if (std::holds_alternative<py_table_keys_range_t>(df.rows_keys))
         scan_rows_range(df);
+}
 
-    // Slice the keys using `head` and `tail`
-    auto& keys_found = std::get<std::vector<ustore_key_t>>(df.rows_keys);
-    auto keys_begin = keys_found.data();
-    auto keys_end = keys_found.data() + keys_found.size();
-    auto keys_count = keys_found.size();
+/**
+ * @brief Applies `head` and `tail` in the order they were defined,
+ * returning the range of rows remaining out of `count`.
+ */
+static std::pair<std::size_t, std::size_t> slice_rows(py_table_collection_t const& df, std::size_t count) noexcept {
+    std::size_t begin = 0;
+    std::size_t end = count;
     if (df.head_was_defined_last) {
-        if (keys_count > df.tail)
-            keys_begin += keys_count - df.tail;
-        keys_count = keys_end - keys_begin;
-        if (keys_count > df.head)
-            keys_end -= keys_count - df.head;
+        if (end - begin > df.tail)
+            begin = end - df.tail;
+        if (end - begin > df.head)
+            end = begin + df.head;
     }
     else {
-        if (keys_count > df.head)
-            keys_end -= keys_count - df.head;
-        keys_count = keys_end - keys_begin;
-        if (keys_count > df.tail)
-            keys_begin += keys_count - df.tail;
-    }
-    keys_count = keys_end - keys_begin;
-    if (keys_count != keys_found.size()) {
-        std::memmove(keys_found.data(), keys_begin, keys_count);
-        keys_found.resize(keys_count);
+        if (end - begin > df.head)
+            end = begin + df.head;
+        if (end - begin > df.tail)
+            begin = end - df.tail;
     }
+    return {begin, end};
+}
+
+/**
+ * @brief Attached to every materialized Arrow batch, to free the arena
+ * it was gathered into, once Python drops the last buffer referencing it.
+ */
+static void release_gathered_array(ArrowArray* array) {
+    auto arena = static_cast<ustore_arena_t>(array->private_data);
+    release_malloced_array(array);
+    ustore_arena_free(arena);
+}
+
+static std::shared_ptr<arrow::RecordBatch> materialize(py_table_collection_t& df) {
+
+    if (df.cached_batch)
+        return df.cached_batch;
+
+    // Extract the keys, if not explicitly defined
+    scan_rows_if_needed(df);
+    auto const& keys_found = std::get<std::vector<ustore_key_t>>(df.rows_keys);
 
-    auto collection =
-        docs_collection_t(df.binary.db(), df.binary, df.binary.txn(), df.binary.snap(), df.binary.member_arena());
-    auto members = collection[keys_found];
+    // Without filters, `head` and `tail` are applied before gathering, to avoid fetching the documents.
+    // With filters, we can't know in advance, which documents will pass, so the selection is sliced after.
+    bool const has_filters = !df.filters_fields.empty();
+    auto [keys_begin, keys_end] = has_filters //
+                                      ? std::pair<std::size_t, std::size_t> {0, keys_found.size()}
+                                      : slice_rows(df, keys_found.size());
+    auto keys = strided_range(keys_found.data() + keys_begin, keys_found.data() + keys_end).immutable();
 
     // Extract the present fields
     if (std::holds_alternative<std::monostate>(df.columns_names)) {
-        auto fields = members.gist().throw_or_release();
-        auto names = std::vector<ustore_str_view_t>(fields.size());
-        transform_n(fields, names.size(), names.begin(), std::mem_fn(&std::string_view::data));
-        df.columns_names = names;
+        auto collection =
+            docs_collection_t(df.binary.db(), df.binary, df.binary.txn(), df.binary.snap(), df.binary.member_arena());
+        auto fields = collection[keys].gist().throw_or_release();
+        std::vector<std::string> names(fields.size());
+        transform_n(fields, names.size(), names.begin(), [](std::string_view name) { return std::string(name); });
+        df.name_columns(std::move(names));
     }
 
     // Request the fields
     if (std::holds_alternative<std::monostate>(df.columns_types))
         throw std::invalid_argument("Column types must be specified");
 
-    // Now the primary part, performing the exports
-    auto fields = strided_range(std::get<std::vector<ustore_str_view_t>>(df.columns_names)).immutable();
-    table_header_view_t header;
-    header.count = fields.size();
-    header.fields_begin = fields.begin();
-    header.types_begin =
-        std::holds_alternative<ustore_doc_field_type_t>(df.columns_types)
-            ? strided_iterator_gt<ustore_doc_field_type_t const>(&std::get<ustore_doc_field_type_t>(df.columns_types), 0)
-            : strided_iterator_gt<ustore_doc_field_type_t const>(
-                  std::get<std::vector<ustore_doc_field_type_t>>(df.columns_types).data(),
-                  sizeof(ustore_doc_field_type_t));
-    docs_table_t table = members.gather(header).throw_or_release();
-    table_header_view_t table_header = table.header();
-
-    // Exports results into Arrow
+    auto const& fields = std::get<std::vector<ustore_str_view_t>>(df.columns_names);
+    auto types = std::holds_alternative<ustore_doc_field_type_t>(df.columns_types)
+                     ? strided_iterator_gt<ustore_doc_field_type_t const>(
+                           &std::get<ustore_doc_field_type_t>(df.columns_types),
+                           0)
+                     : strided_iterator_gt<ustore_doc_field_type_t const>(
+                           std::get<std::vector<ustore_doc_field_type_t>>(df.columns_types).data(),
+                           sizeof(ustore_doc_field_type_t));
+
+    std::vector<ustore_str_view_t> filters_fields(df.filters_fields.size());
+    std::vector<ustore_str_view_t> filters_values(df.filters_values.size());
+    auto c_str = [](std::string const& str) { return str.c_str(); };
+    transform_n(df.filters_fields.data(), filters_fields.size(), filters_fields.begin(), c_str);
+    transform_n(df.filters_values.data(), filters_values.size(), filters_values.begin(), c_str);
+
+    // Every batch gets its own arena, as it may outlive both the DataFrame and the next export
     status_t status;
+    ustore_arena_t arena = nullptr;
+    ustore_collection_t collection = df.binary;
+    ustore_size_t selected_count = 0;
+    ustore_length_t* selected_indices = nullptr;
+    ustore_octet_t** validities = nullptr;
+    ustore_byte_t** scalars = nullptr;
+    ustore_length_t** offsets = nullptr;
+    ustore_length_t** lengths = nullptr;
+    ustore_byte_t* strings = nullptr;
+
+    ustore_docs_gather_t docs_gather {};
+    docs_gather.db = df.binary.db();
+    docs_gather.error = status.member_ptr();
+    docs_gather.transaction = df.binary.txn();
+    docs_gather.snapshot = df.binary.snap();
+    docs_gather.arena = &arena;
+    docs_gather.docs_count = keys.size();
+    docs_gather.fields_count = fields.size();
+    docs_gather.collections = &collection;
+    docs_gather.keys = keys.begin().get();
+    docs_gather.keys_stride = keys.stride();
+    docs_gather.fields = fields.data();
+    docs_gather.fields_stride = sizeof(ustore_str_view_t);
+    docs_gather.types = types.get();
+    docs_gather.types_stride = types.stride();
+    docs_gather.filters_count = filters_fields.size();
+    docs_gather.filters_fields = filters_fields.data();
+    docs_gather.filters_fields_stride = sizeof(ustore_str_view_t);
+    docs_gather.filters_operators = df.filters_operators.data();
+    docs_gather.filters_operators_stride = sizeof(ustore_doc_compare_t);
+    docs_gather.filters_values = filters_values.data();
+    docs_gather.filters_values_stride = sizeof(ustore_str_view_t);
+    docs_gather.selected_count = &selected_count;
+    docs_gather.selected_indices = &selected_indices;
+    docs_gather.columns_validities = &validities;
+    docs_gather.columns_scalars = &scalars;
+    docs_gather.columns_offsets = &offsets;
+    docs_gather.columns_lengths = &lengths;
+    docs_gather.joined_strings = &strings;
+    {
+        py::gil_scoped_release release;
+        ustore_docs_gather(&docs_gather);
+    }
+    if (!status) {
+        ustore_arena_free(arena);
+        status.throw_unhandled();
+    }
+
+    // Exports results into Arrow. Strings columns are already contiguous and
+    // their offsets are relative to the shared tape, so nothing has to be copied.
+    static ustore_byte_t const empty_k = 0;
     ArrowSchema c_arrow_schema;
     ArrowArray c_arrow_array;
-    ustore_to_arrow_schema( //
-        table.rows(),
-        table.collections(),
-        &c_arrow_schema,
-        &c_arrow_array,
-        status.member_ptr());
-    status.throw_unhandled();
-
-    correct_table(table);
-    // Exports columns one-by-one
-    for (std::size_t collection_idx = 0; collection_idx != table.collections(); ++collection_idx) {
-        column_view_t column = table.column(collection_idx);
+    ustore_to_arrow_schema(selected_count, fields.size(), &c_arrow_schema, &c_arrow_array, status.member_ptr());
+    for (std::size_t field_idx = 0; field_idx != fields.size() && status; ++field_idx) {
+        ustore_doc_field_type_t type = types[field_idx];
+        bool is_string = type == ustore_doc_field_str_k || type == ustore_doc_field_bin_k;
+        void const* contents = is_string ? strings : scalars[field_idx];
         ustore_to_arrow_column( //
-            table.rows(),
-            table_header.fields_begin[collection_idx],
-            table_header.types_begin[collection_idx],
-            column.validities(),
-            column.offsets(),
-            column.contents(),
-            c_arrow_schema.children[collection_idx],
-            c_arrow_array.children[collection_idx],
+            selected_count,
+            fields[field_idx],
+            type,
+            validities[field_idx],
+            offsets[field_idx],
+            contents ? contents : &empty_k,
+            c_arrow_schema.children[field_idx],
+            c_arrow_array.children[field_idx],
             status.member_ptr());
+    }
+    if (!status) {
+        c_arrow_schema.release(&c_arrow_schema);
+        c_arrow_array.release(&c_arrow_array);
+        ustore_arena_free(arena);
         status.throw_unhandled();
     }
 
+    // Remember the keys of the exported rows, slicing the filtered ones
+    auto [rows_begin, rows_end] = has_filters //
+                                      ? slice_rows(df, selected_count)
+                                      : std::pair<std::size_t, std::size_t> {0, selected_count};
+    df.cached_keys.resize(rows_end - rows_begin);
+    for (std::size_t row_idx = rows_begin; row_idx != rows_end; ++row_idx)
+        df.cached_keys[row_idx - rows_begin] = keys[selected_indices ? selected_indices[row_idx] : row_idx];
+
+    // From here on, Arrow will free the arena, even on failure
     // https://github.com/apache/arrow/blob/e0e740bd7a24de68262c0b7e47eeed62a6cbd2a0/cpp/src/arrow/c/bridge.h#L163
-    return arrow::ImportRecordBatch(&c_arrow_array, &c_arrow_schema).ValueOrDie();
+    c_arrow_array.private_data = arena;
+    c_arrow_array.release = &release_gathered_array;
+    auto batch = arrow::ImportRecordBatch(&c_arrow_array, &c_arrow_schema).ValueOrDie();
+    if (rows_end - rows_begin != selected_count)
+        batch = batch->Slice(rows_begin, rows_end - rows_begin);
+    df.cached_batch = batch;
+    return batch;
 }
 
 template <typename array_type_at>
@@ -340,20 +468,21 @@ void ustore::wrap_pandas(py::module& m) {
         // `dtype` can be one string, one enum, a `dict` or a `list[tuple[str, str]]`,
         // where every pair of strings contains a column name and Python type descriptor.
         if (PyDict_Check(dtype_py.ptr())) {
-            std::vector<ustore_str_view_t> columns_names;
+            std::vector<std::string> columns_names;
             std::vector<ustore_doc_field_type_t> columns_types;
             py_scan_dict(dtype_py.ptr(), [&](PyObject* key, PyObject* val) {
-                columns_names.push_back(py_to_str(key));
+                columns_names.emplace_back(py_to_str(key));
                 columns_types.push_back(ustore_doc_field_from_str(py_to_str(val)));
             });
 
-            df.columns_names = columns_names;
+            df.name_columns(std::move(columns_names));
             df.columns_types = columns_types;
         }
         // One type definition for all the columns
         // https://stackoverflow.com/a/45063514/2766161
         else if (PyUnicode_Check(dtype_py.ptr())) {
             df.columns_types = ustore_doc_field_from_str(py_to_str(dtype_py.ptr()));
+            df.invalidate();
         }
         return df.shared_from_this();
     });
@@ -364,9 +493,19 @@ void ustore::wrap_pandas(py::module& m) {
         if (columns_count == std::nullopt || !*columns_count)
             throw std::invalid_argument("Columns must be a non-empty tuple or list");
 
-        auto columns_names = std::vector<ustore_str_view_t>(*columns_count);
+        auto columns_names = std::vector<std::string>(*columns_count);
         py_transform_n(columns_py.ptr(), &py_to_str, columns_names.begin(), *columns_count);
-        df.columns_names = columns_names;
+        df.name_columns(std::move(columns_names));
+        return df.shared_from_this();
+    });
+
+#pragma region Filtering Rows
+
+    // Only simple conjunctions, like `age >= 18 and name != 'Joe'`, are supported.
+    // They are evaluated lazily, together with the gather, skipping the columns of rejected rows.
+    // https://pandas.pydata.org/docs/reference/api/pandas.DataFrame.query.html
+    df.def("query", [](py_table_collection_t& df, std::string const& expr) {
+        add_query(df, expr);
         return df.shared_from_this();
     });
 
@@ -389,22 +528,28 @@ void ustore::wrap_pandas(py::module& m) {
             py_transform_n(rows_py.ptr(), &py_to_scalar<ustore_key_t>, rows_keys.begin(), *rows_count);
             df.rows_keys = rows_keys;
         }
+        df.invalidate();
         return df.shared_from_this();
     });
     df.def("head", [](py_table_collection_t& df, std::size_t count) {
         df.head = count;
         df.head_was_defined_last = true;
+        df.invalidate();
         return df.shared_from_this();
     });
     df.def("tail", [](py_table_collection_t& df, std::size_t count) {
         df.tail = count;
         df.head_was_defined_last = false;
+        df.invalidate();
         return df.shared_from_this();
     });
 
     // Assigns or inserts elements from another DataFrame, passed in the Arrow form.
     // https://pandas.pydata.org/docs/reference/api/pandas.DataFrame.update.html
-    df.def("update", &update);
+    df.def("update", [](py_table_collection_t& df, py::object obj) {
+        df.invalidate();
+        update(df, obj);
+    });
 
     // Primary batch export functions, that output Arrow Tables.
     // Addresses may be: specific IDs or a slice.
@@ -417,12 +562,19 @@ void ustore::wrap_pandas(py::module& m) {
         return py::reinterpret_steal<py::object>(table_python);
     });
 
+    // https://arrow.apache.org/docs/python/generated/pyarrow.RecordBatch.html#pyarrow.RecordBatch.to_pandas
+    df.def("to_pandas", [](py_table_collection_t& df) {
+        auto record_batch = materialize(df);
+        auto batch_python = py::reinterpret_steal<py::object>(arrow::py::wrap_batch(record_batch));
+        return batch_python.attr("to_pandas")();
+    });
+
     // https://pandas.pydata.org/docs/reference/api/pandas.DataFrame.to_json.html
     df.def(
         "to_json",
         [](py_table_collection_t& df, std::string const& path) -> py::object {
             auto batch = materialize(df);
-            auto& keys_found = std::get<std::vector<ustore_key_t>>(df.rows_keys);
+            auto& keys_found = df.cached_keys;
 
             std::string result = "{";
             for (std::size_t i = 0; i != batch->num_columns(); ++i) {
@@ -504,6 +656,7 @@ void ustore::wrap_pandas(py::module& m) {
 
         auto keys = collection.keys().sample(count, df.binary.member_arena()).throw_or_release();
         df.rows_keys = std::vector<ustore_key_t>(keys.begin(), keys.end());
+        df.invalidate();
         return df.shared_from_this();
     });
 
@@ -517,6 +670,7 @@ void ustore::wrap_pandas(py::module& m) {
 
     // https://pandas.pydata.org/docs/reference/api/pandas.DataFrame.merge.html
     df.def("merge", [](py_table_collection_t& df, py_table_collection_t& df_to_merge) {
+        df.invalidate();
         auto collection_to_merge = docs_collection_t(df_to_merge.binary.db(),
                                                      df_to_merge.binary,
                                                      df_to_merge.binary.txn(),
@@ -539,6 +693,7 @@ void ustore::wrap_pandas(py::module& m) {
     });
 
     df.def("insert", [](py_table_collection_t& df, std::string const& column_name, py::object obj) {
+        df.invalidate();
         auto collection =
             docs_collection_t(df.binary.db(), df.binary, df.binary.txn(), df.binary.snap(), df.binary.member_arena());
 
@@ -572,6 +727,7 @@ void ustore::wrap_pandas(py::module& m) {
     });
 
     df.def("insert", [](py_table_collection_t& df, py::object obj) {
+        df.invalidate();
         auto collection =
             docs_collection_t(df.binary.db(), df.binary, df.binary.txn(), df.binary.snap(), df.binary.member_arena());
 
@@ -620,6 +776,7 @@ void ustore::wrap_pandas(py::module& m) {
     // df.def("join", [](py_table_collection_t& df) {});
 
     df.def("drop", [](py_table_collection_t& df, py::object cols) {
+        df.invalidate();
         auto collection =
             docs_collection_t(df.binary.db(), df.binary, df.binary.txn(), df.binary.snap(), df.binary.member_arena());
 
@@ -653,6 +810,7 @@ void ustore::wrap_pandas(py::module& m) {
         if (!PyDict_Check(columns.ptr()))
             throw std::invalid_argument("Expect dictionary");
 
+        df.invalidate();
         scan_rows(df);
         auto& keys = std::get<std::vector<ustore_key_t>>(df.rows_keys);
         auto collection =
@@ -670,6 +828,10 @@ void ustore::wrap_pandas(py::module& m) {
     });
 
     df.def_property_readonly("size", [](py_table_collection_t& df) {
+        if (df.cached_batch || !df.filters_fields.empty()) {
+            auto batch = materialize(df);
+            return static_cast<std::size_t>(batch->num_rows() * batch->num_columns());
+        }
         if (std::holds_alternative<std::monostate>(df.rows_keys))
             scan_rows(df);
         else if (std::holds_alternative<py_table_keys_range_t>(df.rows_keys))
@@ -693,6 +855,10 @@ void ustore::wrap_pandas(py::module& m) {
     });
 
     df.def_property_readonly("shape", [](py_table_collection_t& df) {
+        if (df.cached_batch || !df.filters_fields.empty()) {
+            auto batch = materialize(df);
+            return py::make_tuple(batch->num_rows(), batch->num_columns());
+        }
         if (std::holds_alternative<std::monostate>(df.rows_keys))
             scan_rows(df);
         else if (std::holds_alternative<py_table_keys_range_t>(df.rows_keys))
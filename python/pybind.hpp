@@ -1,6 +1,7 @@
 
 #pragma once
-#include <utility> // `std::pair`
+#include <algorithm> // `std::transform`
+#include <utility>   // `std::pair`
 
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
@@ -152,6 +153,10 @@ struct py_table_keys_range_t {
 /**
  * @brief DataFrame representation, capable of viewing joined contents
  * of multiple collections. When materialized, exports Apache Arrow objects.
+ *
+ * Selections of columns, rows and filters are only recorded, until the first export,
+ * which pushes all of them into a single `ustore_docs_gather()` call. The resulting
+ * batch is cached until any part of the selection changes.
  */
 struct py_table_collection_t : public std::enable_shared_from_this<py_table_collection_t> {
 
@@ -163,10 +168,37 @@ struct py_table_collection_t : public std::enable_shared_from_this<py_table_coll
     std::size_t tail {std::numeric_limits<std::size_t>::max()};
     bool head_was_defined_last {true};
 
+    /** @brief Owns the strings behind `columns_names`, which may outlive the Python arguments. */
+    std::vector<std::string> columns_names_storage;
+
+    /** @brief Conjunction of comparisons, every exported row must pass. */
+    std::vector<std::string> filters_fields;
+    std::vector<ustore_doc_compare_t> filters_operators;
+    std::vector<std::string> filters_values;
+
+    /** @brief Last materialized batch and the keys of its rows. */
+    std::shared_ptr<arrow::RecordBatch> cached_batch;
+    std::vector<ustore_key_t> cached_keys;
+
     py_table_collection_t() = default;
     py_table_collection_t(py_table_collection_t&&) = delete;
     py_table_collection_t(py_table_collection_t const&) = delete;
 
+    void invalidate() noexcept {
+        cached_batch.reset();
+        cached_keys.clear();
+    }
+
+    void name_columns(std::vector<std::string>&& names) {
+        columns_names_storage = std::move(names);
+        std::vector<ustore_str_view_t> views(columns_names_storage.size());
+        std::transform(columns_names_storage.begin(), columns_names_storage.end(), views.begin(), [](auto& name) {
+            return name.c_str();
+        });
+        columns_names = std::move(views);
+        invalidate();
+    }
+
     // Compatibility with Arrow Tables.
     // std::shared_ptr<ar::ChunkedArray> column(int i) const override;
     // std::vector<std::shared_ptr<ar::ChunkedArray>> const& columns() const override;
@@ -119,6 +119,26 @@ def scan(col):
     assert np.array_equal(keys, [60])
 
 
+def scan_batches(col):
+    col.clear()
+    for key in range(100):
+        col[key] = str(key).encode()
+
+    keys = []
+    for batch in col.scan_batches(start=10, stop=90, batch_size=16):
+        assert batch.num_rows <= 16
+        keys.extend(batch['keys'].to_pylist())
+        values = batch['vals'].to_pylist()
+        assert values == [str(key).encode() for key in batch['keys'].to_pylist()]
+    assert keys == list(range(10, 90))
+
+    stream = col.scan_batches(batch_size=1000, values=False)
+    batches = list(stream)
+    assert len(batches) == 1
+    assert batches[0].num_columns == 1
+    assert batches[0].num_rows == 100
+
+
 def iterate(col):
     col.clear()
     col[1] = b'a'
@@ -176,6 +196,7 @@ def test_main_collection():
     only_operators(main)
     batch_insert(main)
     scan(main)
+    scan_batches(main)
     iterate(main)
 
 
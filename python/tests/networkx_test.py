@@ -177,6 +177,31 @@ def test_neighbors():
     digraph.clear()
 
 
+def test_csr():
+    digraph = ustore.DataBase().main.digraph
+
+    # 1 -> 2 -> 3 -> 1, 3 -> 4
+    digraph.add_edges_from(np.array([1, 2, 3, 3]), np.array([2, 3, 1, 4]))
+
+    vertices, offsets, neighbors, edges_ids = digraph.to_csr()
+    assert vertices.tolist() == [1, 2, 3, 4]
+    assert offsets.tolist() == [0, 1, 2, 4, 4]
+    assert neighbors.tolist() == [1, 2, 0, 3]
+    assert len(edges_ids) == 4
+
+    vertices, offsets, neighbors, _ = digraph.to_csr([3, 1, 2])
+    assert vertices.tolist() == [1, 2, 3]
+    assert offsets.tolist() == [0, 1, 2, 3]
+    assert neighbors.tolist() == [1, 2, 0]
+
+    matrix = digraph.to_scipy_sparse_array(weight=False)
+    assert matrix.shape == (4, 4)
+    assert matrix.sum() == 4
+    assert matrix[2, 3] == 1 and matrix[3, 2] == 0
+
+    digraph.clear()
+
+
 def test_degree():
     db = ustore.DataBase()
     graph = ustore.Graph(db, 'graph', relations='edges')
@@ -78,6 +78,23 @@ def test_to_arrow():
     db.clear()
 
 
+def test_lazy_query():
+    db = ustore.DataBase()
+    table = create_table(db)
+    table.astype({'name': 'str', 'tweets': 'int64'})
+
+    popular = table.query("tweets > 3000 and name != 'Joe'").to_arrow()
+    assert popular.to_pylist() == [{'name': 'Andrew', 'tweets': 3935}]
+    # Repeated exports reuse the cached batch, until the selection changes
+    assert table.to_arrow() == popular
+    assert table.shape == (1, 2)
+
+    table.head(1)
+    assert table.to_pandas()['name'].tolist() == ['Andrew']
+
+    db.clear()
+
+
 def test_update():
     db = ustore.DataBase()
     col = db.main
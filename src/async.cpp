@@ -0,0 +1,213 @@
+/**
+ * @file async.cpp
+ * @author Ashot Vardanian
+ *
+ * @brief Asynchronous submission and completion queues.
+ * Sits on top of any @see "ustore.h"-compatible system.
+ *
+ * Requests are served by a pool of background threads, calling the blocking
+ * functions of the underlying engine and modalities. Engines with native
+ * asynchronous IO can later intercept specific kinds of requests, keeping the
+ * interface unchanged.
+ */
+#include <algorithm>          // `std::copy_n`
+#include <condition_variable> // `std::condition_variable`
+#include <deque>              // `std::deque`
+#include <memory>             // `std::make_unique`
+#include <mutex>              // `std::mutex`
+#include <thread>             // `std::thread`
+#include <vector>             // `std::vector`
+
+#include "ustore/async.h"
+#include "ustore/ustore.h"
+
+#include "helpers/linked_memory.hpp" // `return_error_if_m`
+
+/*********************************************************/
+/*****************	 C++ Implementation	  ****************/
+/*********************************************************/
+
+using namespace unum::ustore;
+using namespace unum;
+
+struct async_task_t {
+    ustore_async_kind_t kind;
+    void* request;
+    void* user_data;
+    ustore_async_callback_t callback;
+};
+
+struct async_queue_t {
+    ustore_database_t db = nullptr;
+    std::size_t capacity = 0;
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable submitted;
+    std::condition_variable completed;
+    std::deque<async_task_t> pending;
+    std::deque<ustore_completion_t> done;
+    /// @brief Submitted requests, that weren't yet polled or passed to callbacks.
+    std::size_t in_flight = 0;
+    /// @brief Part of `in_flight`, that will end up in `done`.
+    std::size_t awaiting_poll = 0;
+    bool stopping = false;
+};
+
+template <typename request_at, void (*function_ak)(request_at*)>
+ustore_error_t execute_as(void* request) noexcept {
+    auto& typed = *reinterpret_cast<request_at*>(request);
+    function_ak(&typed);
+    return typed.error ? *typed.error : nullptr;
+}
+
+ustore_error_t execute(ustore_async_kind_t kind, void* request) noexcept {
+    switch (kind) {
+    case ustore_async_read_k: return execute_as<ustore_read_t, ustore_read>(request);
+    case ustore_async_write_k: return execute_as<ustore_write_t, ustore_write>(request);
+    case ustore_async_scan_k: return execute_as<ustore_scan_t, ustore_scan>(request);
+    case ustore_async_sample_k: return execute_as<ustore_sample_t, ustore_sample>(request);
+    case ustore_async_measure_k: return execute_as<ustore_measure_t, ustore_measure>(request);
+
+    case ustore_async_paths_write_k: return execute_as<ustore_paths_write_t, ustore_paths_write>(request);
+    case ustore_async_paths_read_k: return execute_as<ustore_paths_read_t, ustore_paths_read>(request);
+    case ustore_async_paths_match_k: return execute_as<ustore_paths_match_t, ustore_paths_match>(request);
+
+    case ustore_async_docs_write_k: return execute_as<ustore_docs_write_t, ustore_docs_write>(request);
+    case ustore_async_docs_read_k: return execute_as<ustore_docs_read_t, ustore_docs_read>(request);
+    case ustore_async_docs_gist_k: return execute_as<ustore_docs_gist_t, ustore_docs_gist>(request);
+    case ustore_async_docs_gather_k: return execute_as<ustore_docs_gather_t, ustore_docs_gather>(request);
+
+    case ustore_async_graph_find_edges_k:
+        return execute_as<ustore_graph_find_edges_t, ustore_graph_find_edges>(request);
+    case ustore_async_graph_upsert_edges_k:
+        return execute_as<ustore_graph_upsert_edges_t, ustore_graph_upsert_edges>(request);
+    case ustore_async_graph_remove_edges_k:
+        return execute_as<ustore_graph_remove_edges_t, ustore_graph_remove_edges>(request);
+    case ustore_async_graph_upsert_vertices_k:
+        return execute_as<ustore_graph_upsert_vertices_t, ustore_graph_upsert_vertices>(request);
+    case ustore_async_graph_remove_vertices_k:
+        return execute_as<ustore_graph_remove_vertices_t, ustore_graph_remove_vertices>(request);
+
+    case ustore_async_vectors_write_k: return execute_as<ustore_vectors_write_t, ustore_vectors_write>(request);
+    case ustore_async_vectors_read_k: return execute_as<ustore_vectors_read_t, ustore_vectors_read>(request);
+    case ustore_async_vectors_search_k: return execute_as<ustore_vectors_search_t, ustore_vectors_search>(request);
+    default: return "Unknown request kind!";
+    }
+}
+
+bool is_known(ustore_async_kind_t kind) noexcept {
+    return kind >= ustore_async_read_k && kind <= ustore_async_vectors_search_k;
+}
+
+void serve(async_queue_t& queue) noexcept {
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    while (true) {
+        queue.submitted.wait(lock, [&] { return queue.stopping || !queue.pending.empty(); });
+        if (queue.pending.empty())
+            return;
+
+        async_task_t task = queue.pending.front();
+        queue.pending.pop_front();
+        lock.unlock();
+
+        ustore_error_t error = execute(task.kind, task.request);
+        if (task.callback)
+            task.callback(task.user_data, task.request, error);
+
+        lock.lock();
+        if (task.callback)
+            --queue.in_flight;
+        else
+            queue.done.push_back({task.kind, task.request, task.user_data, error});
+        queue.completed.notify_all();
+    }
+}
+
+/*********************************************************/
+/*****************	    C Interface 	  ****************/
+/*********************************************************/
+
+void ustore_async_init(ustore_async_init_t* c_ptr) {
+
+    ustore_async_init_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    return_error_if_m(c.queue, c.error, args_wrong_k, "Output argument is missing");
+
+    safe_section("Starting async workers", c.error, [&] {
+        auto queue = std::make_unique<async_queue_t>();
+        queue->db = c.db;
+        queue->capacity = c.capacity;
+
+        std::size_t threads_count = c.threads_count ? c.threads_count : std::thread::hardware_concurrency();
+        threads_count = std::max<std::size_t>(threads_count, 1);
+        queue->workers.reserve(threads_count);
+        try {
+            for (std::size_t i = 0; i != threads_count; ++i)
+                queue->workers.emplace_back(serve, std::ref(*queue));
+        }
+        catch (...) {
+            ustore_async_free(queue.release());
+            throw;
+        }
+        *c.queue = queue.release();
+    });
+}
+
+void ustore_submit(ustore_submit_t* c_ptr) {
+
+    ustore_submit_t& c = *c_ptr;
+    return_error_if_m(c.queue, c.error, uninitialized_state_k, "Queue is uninitialized");
+    return_error_if_m(c.request, c.error, args_wrong_k, "Request is missing");
+    return_error_if_m(is_known(c.kind), c.error, args_wrong_k, "Unknown request kind");
+
+    auto& queue = *reinterpret_cast<async_queue_t*>(c.queue);
+    safe_section("Submitting request", c.error, [&] {
+        std::unique_lock<std::mutex> lock(queue.mutex);
+        return_error_if_m(!queue.capacity || queue.in_flight < queue.capacity,
+                          c.error,
+                          out_of_memory_k,
+                          "Async queue is full, poll the completions first");
+        queue.pending.push_back({c.kind, c.request, c.user_data, c.callback});
+        ++queue.in_flight;
+        queue.awaiting_poll += !c.callback;
+        queue.submitted.notify_one();
+    });
+}
+
+void ustore_poll(ustore_poll_t* c_ptr) {
+
+    ustore_poll_t& c = *c_ptr;
+    return_error_if_m(c.queue, c.error, uninitialized_state_k, "Queue is uninitialized");
+    return_error_if_m(c.count, c.error, args_wrong_k, "Output argument is missing");
+    return_error_if_m(c.completions || !c.max_count, c.error, args_wrong_k, "Completions buffer is missing");
+
+    auto& queue = *reinterpret_cast<async_queue_t*>(c.queue);
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    std::size_t min_count = std::min<std::size_t>(c.min_count, c.max_count);
+    queue.completed.wait(lock, [&] {
+        return queue.done.size() >= min_count || queue.done.size() == queue.awaiting_poll;
+    });
+
+    std::size_t count = std::min<std::size_t>(queue.done.size(), c.max_count);
+    std::copy_n(queue.done.begin(), count, c.completions);
+    queue.done.erase(queue.done.begin(), queue.done.begin() + count);
+    queue.in_flight -= count;
+    queue.awaiting_poll -= count;
+    *c.count = static_cast<ustore_size_t>(count);
+}
+
+void ustore_async_free(ustore_async_t c_queue) {
+    if (!c_queue)
+        return;
+
+    auto queue = reinterpret_cast<async_queue_t*>(c_queue);
+    {
+        std::unique_lock<std::mutex> lock(queue->mutex);
+        queue->stopping = true;
+        queue->submitted.notify_all();
+    }
+    for (auto& worker : queue->workers)
+        worker.join();
+    delete queue;
+}
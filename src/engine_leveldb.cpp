@@ -6,7 +6,12 @@
  * Has no support for collections, transactions or any non-CRUD jobs.
  */
 #include <mutex>
+#include <atomic>
+#include <thread>
 #include <fstream>
+#include <optional>
+#include <numeric>   // `std::iota`
+#include <algorithm> // `std::sort`
 
 #include <leveldb/db.h>
 #include <leveldb/comparator.h>
@@ -19,6 +24,9 @@
 #include "helpers/linked_array.hpp"   // `uninitialized_array_gt`
 #include "helpers/full_scan.hpp"      // `reservoir_sample_iterator`
 #include "helpers/config_loader.hpp"  // `config_loader_t`
+#include "helpers/parallel.hpp"       // `scan_in_parallel`, `thread_pool_t`
+#include "helpers/stats.hpp"          // `engine_stats_t`
+#include "helpers/change_log.hpp"     // `change_log_t`
 
 using namespace unum::ustore;
 using namespace unum;
@@ -34,28 +42,41 @@ ustore_collection_t const ustore_collection_main_k = 0;
 ustore_length_t const ustore_length_missing_k = std::numeric_limits<ustore_length_t>::max();
 ustore_key_t const ustore_key_unknown_k = std::numeric_limits<ustore_key_t>::max();
 
+/// @brief Smaller batches are read sequentially, as waking the readers costs more.
+static constexpr std::size_t parallel_reads_min_k = 256;
+/// @brief Default number of threads in `level_db_t::readers`, including the caller.
+static constexpr std::size_t parallel_readers_max_k = 8;
+
 using level_native_t = leveldb::DB;
 using level_status_t = leveldb::Status;
 using level_options_t = leveldb::Options;
 using level_iter_uptr_t = std::unique_ptr<leveldb::Iterator>;
 
+/**
+ * @brief Orders the keys numerically. Slices aren't aligned, which matters for
+ * 128-bit keys in `USTORE_USE_UUID` builds, so the keys are copied out.
+ */
 struct key_comparator_t final : public leveldb::Comparator {
 
+    static inline ustore_key_t load(char const* data) noexcept {
+        ustore_key_t key;
+        std::memcpy(&key, data, sizeof(ustore_key_t));
+        return key;
+    }
+
     inline int Compare(leveldb::Slice const& a, leveldb::Slice const& b) const override {
-        auto ai = *reinterpret_cast<ustore_key_t const*>(a.data());
-        auto bi = *reinterpret_cast<ustore_key_t const*>(b.data());
-        if (ai == bi)
-            return 0;
-        return ai < bi ? -1 : 1;
+        auto ai = load(a.data());
+        auto bi = load(b.data());
+        return (ai > bi) - (ai < bi);
     }
 
-    char const* Name() const override { return "Integral"; }
+    char const* Name() const override { return sizeof(ustore_key_t) == 16 ? "Integral128" : "Integral"; }
 
     void FindShortestSeparator(std::string*, leveldb::Slice const&) const override {}
 
     void FindShortSuccessor(std::string* key) const override {
-        auto& int_key = *reinterpret_cast<ustore_key_t*>(key->data());
-        ++int_key;
+        ustore_key_t successor = load(key->data()) + 1;
+        std::memcpy(key->data(), &successor, sizeof(ustore_key_t));
     }
 };
 
@@ -70,6 +91,12 @@ struct level_db_t {
     std::unordered_map<ustore_size_t, level_snapshot_t*> snapshots;
     std::unique_ptr<level_native_t> native;
     std::mutex mutex;
+    /// @brief Serves the point lookups of large batches, as LevelDB has no `MultiGet`.
+    std::unique_ptr<thread_pool_t> readers;
+    /// @brief Optional feed of committed changes, as LevelDB doesn't expose its own log.
+    change_log_t changes;
+
+    engine_stats_t stats;
 };
 
 /*********************************************************/
@@ -95,6 +122,50 @@ inline std::unique_ptr<std::string> make_value(ustore_error_t* c_error) noexcept
     return value_uptr;
 }
 
+inline ustore_key_t to_key(leveldb::Slice const& slice) noexcept {
+    ustore_key_t key;
+    std::memcpy(&key, slice.data(), sizeof(ustore_key_t));
+    return key;
+}
+
+/**
+ * @brief LevelDB has no read-ahead controls, so for `ustore_option_scan_sequential_k`
+ * a background thread walks a separate iterator over the same ranges, pulling the
+ * following data blocks into the block cache, while the caller consumes them.
+ */
+class scan_prefetcher_t {
+    std::atomic<bool> stop_ {false};
+    std::thread thread_;
+
+  public:
+    scan_prefetcher_t(level_native_t& native, leveldb::ReadOptions options, scans_arg_t const& tasks) noexcept(false) {
+        options.fill_cache = true;
+        thread_ = std::thread([this, &native, options, tasks] {
+            try {
+                auto it = level_iter_uptr_t(native.NewIterator(options));
+                for (std::size_t i = 0; i != tasks.count && !stop_.load(std::memory_order_relaxed); ++i) {
+                    scan_t task = tasks[i];
+                    it->Seek(to_slice(task.min_key));
+                    for (ustore_length_t j = 0; it->Valid() && j != task.limit && to_key(it->key()) < task.end_key;
+                         ++j, it->Next())
+                        if (stop_.load(std::memory_order_relaxed))
+                            return;
+                }
+            }
+            catch (...) {
+                // Prefetching is only a hint, the consumer will report the failure
+            }
+        });
+    }
+    scan_prefetcher_t(scan_prefetcher_t const&) = delete;
+    scan_prefetcher_t& operator=(scan_prefetcher_t const&) = delete;
+
+    ~scan_prefetcher_t() noexcept {
+        stop_.store(true, std::memory_order_relaxed);
+        thread_.join();
+    }
+};
+
 bool export_error(level_status_t const& status, ustore_error_t* c_error) {
     if (status.ok())
         return false;
@@ -133,13 +204,20 @@ void ustore_database_init(ustore_database_init_t* c_ptr) {
                           args_wrong_k,
                           "Root isn't a directory");
 
-        // Storage paths
-        return_error_if_m(config.data_directories.empty(), c.error, args_wrong_k, "Multi-disk not supported");
+        // Storage paths: LevelDB keeps all the tables in a single directory
+        return_error_if_m(config.data_directories.empty(),
+                          c.error,
+                          args_wrong_k,
+                          "LevelDB places all the data in the root directory, multi-disk is not supported");
 
         // Engine config
         return_error_if_m(config.engine.config_url.empty(), c.error, args_wrong_k, "Doesn't support URL configs");
 
-        auto fill_options = [](json_t const& js, level_options_t& options) {
+        std::size_t readers_count = std::min<std::size_t>(std::thread::hardware_concurrency(), parallel_readers_max_k);
+        change_feed_config_t change_feed;
+        bool change_feed_valid = true;
+        bool expiration_requested = false;
+        auto fill_options = [&](json_t const& js, level_options_t& options) {
             if (js.contains("write_buffer_size"))
                 options.write_buffer_size = js["write_buffer_size"];
             if (js.contains("max_file_size"))
@@ -157,6 +235,11 @@ void ustore_database_init(ustore_database_init_t* c_ptr) {
             if (js.contains("compression"))
                 if (js["compression"] == "kSnappyCompression" || js["compression"] == "snappy")
                     options.compression = leveldb::kSnappyCompression;
+            if (js.contains("read_threads"))
+                readers_count = js["read_threads"];
+            if (js.contains("change_feed"))
+                change_feed_valid &= change_feed_config_t::parse(js, change_feed);
+            expiration_requested |= js.contains("ttl");
         };
 
         // Load from file
@@ -169,6 +252,11 @@ void ustore_database_init(ustore_database_init_t* c_ptr) {
         // Override with nested
         if (!config.engine.config.empty())
             fill_options(config.engine.config, options);
+        return_error_if_m(change_feed_valid, c.error, args_wrong_k, "Invalid change feed config");
+        return_error_if_m(!expiration_requested,
+                          c.error,
+                          args_wrong_k,
+                          "LevelDB has no compaction filters, so TTLs aren't supported");
 
         auto db_ptr = std::make_unique<level_db_t>();
         level_native_t* native_db = nullptr;
@@ -176,6 +264,12 @@ void ustore_database_init(ustore_database_init_t* c_ptr) {
         return_error_if_m(status.ok(), c.error, args_wrong_k, "Couldn't open LevelDB");
         db_ptr->native = std::unique_ptr<level_native_t>(native_db);
         db_ptr->options = options;
+        if (readers_count > 1)
+            db_ptr->readers = std::make_unique<thread_pool_t>(readers_count);
+        if (change_feed.enabled) {
+            auto change_log_status = db_ptr->changes.open(root / "changes", change_feed);
+            return_error_if_m(change_log_status, c.error, error_unknown_k, change_log_status.message());
+        }
         *c.db = db_ptr.release();
     }
     catch (json_t::type_error const&) {
@@ -339,6 +433,7 @@ void ustore_write(ustore_write_t* c_ptr) {
     return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
 
     level_db_t& db = *reinterpret_cast<level_db_t*>(c.db);
+    stats_timer_t timer {db.stats, stats_op_t::write_k, c.tasks_count, c.error};
     strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
     strided_iterator_gt<ustore_key_t const> keys {c.keys, c.keys_stride};
     strided_iterator_gt<ustore_bytes_cptr_t const> vals {c.values, c.values_stride};
@@ -351,20 +446,101 @@ void ustore_write(ustore_write_t* c_ptr) {
 
     validate_write(c.transaction, places, contents, c.options, c.error);
     return_if_error_m(c.error);
+    return_error_if_m(!(c.options & ustore_option_write_merge_k), c.error, args_wrong_k, "Merges aren't supported!");
 
     leveldb::WriteOptions options;
     if (c.options & ustore_option_write_flush_k)
         options.sync = true;
 
     try {
+        // The changes are logged in the same order, as they are applied
+        std::string change_entries;
+        std::unique_lock<std::mutex> changes_lock {db.changes.mutex(), std::defer_lock};
+        if (db.changes.is_open()) {
+            for (std::size_t i = 0; i != places.size(); ++i)
+                change_log_t::serialize(change_entries, places[i].collection_key(), contents[i]);
+            changes_lock.lock();
+        }
+
         auto func = c.tasks_count == 1 ? &write_one : &write_many;
         func(db, places, contents, options, c.error);
+        return_if_error_m(c.error);
+
+        if (db.changes.is_open()) {
+            auto status = db.changes.append(change_entries, places.size(), options.sync);
+            log_error_if_m(status, c.error, error_unknown_k, "Failed to append to change-log");
+        }
     }
     catch (...) {
         *c.error = "Write Failure";
     }
 }
 
+/**
+ * @brief Splits the batch into chunks of neighboring keys and looks them up concurrently
+ * on `level_db_t::readers`. Every chunk appends into its own buffer, and the values are
+ * passed to the @p enumerator in the original order, once all the lookups are done.
+ */
+template <typename value_enumerator_at>
+void read_enumerate_in_parallel( //
+    level_db_t& db,
+    places_arg_t tasks,
+    leveldb::ReadOptions const& options,
+    value_enumerator_at enumerator,
+    ustore_error_t* c_error) {
+
+    struct found_t {
+        std::size_t chunk = 0;
+        std::size_t offset = 0;
+        ustore_length_t length = ustore_length_missing_k;
+    };
+
+    // Sorting lets the neighboring lookups of a chunk share the same blocks and tables
+    std::vector<std::size_t> order(tasks.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return tasks[a].key < tasks[b].key; });
+
+    // Having a few chunks per thread balances the load, if some lookups hit the disk
+    std::size_t const chunks_count = std::min(db.readers->size() * 4, tasks.size());
+    std::size_t const chunk_size = divide_round_up(tasks.size(), chunks_count);
+    std::vector<found_t> found(tasks.size());
+    std::vector<std::string> buffers(chunks_count);
+    std::vector<ustore_error_t> errors(chunks_count, nullptr);
+
+    db.readers->for_each(chunks_count, [&](std::size_t chunk_idx) noexcept {
+        ustore_error_t* c_chunk_error = &errors[chunk_idx];
+        safe_section("Reading a chunk", c_chunk_error, [&] {
+            std::string& buffer = buffers[chunk_idx];
+            std::string value;
+            std::size_t const begin = chunk_idx * chunk_size;
+            std::size_t const end = std::min(begin + chunk_size, tasks.size());
+            for (std::size_t i = begin; i != end; ++i) {
+                std::size_t task_idx = order[i];
+                level_status_t status = db.native->Get(options, to_slice(tasks[task_idx].key), &value);
+                if (status.IsNotFound())
+                    continue;
+                if (export_error(status, c_chunk_error))
+                    return;
+                found[task_idx] = {chunk_idx, buffer.size(), static_cast<ustore_length_t>(value.size())};
+                buffer.append(value);
+            }
+        });
+    });
+
+    for (ustore_error_t error : errors)
+        return_error_if_m(!error, c_error, error_unknown_k, error);
+
+    for (std::size_t i = 0; i != tasks.size(); ++i) {
+        found_t result = found[i];
+        if (result.length == ustore_length_missing_k) {
+            enumerator(i, value_view_t {});
+            continue;
+        }
+        auto begin = reinterpret_cast<ustore_bytes_cptr_t>(buffers[result.chunk].data()) + result.offset;
+        enumerator(i, value_view_t {begin, result.length});
+    }
+}
+
 template <typename value_enumerator_at>
 void read_enumerate( //
     level_db_t& db,
@@ -374,6 +550,9 @@ void read_enumerate( //
     value_enumerator_at enumerator,
     ustore_error_t* c_error) {
 
+    if (db.readers && db.readers->size() > 1 && tasks.size() >= parallel_reads_min_k)
+        return read_enumerate_in_parallel(db, tasks, options, enumerator, c_error);
+
     for (std::size_t i = 0; i != tasks.size(); ++i) {
         place_t place = tasks[i];
         level_status_t status = db.native->Get(options, to_slice(place.key), &value);
@@ -398,6 +577,7 @@ void ustore_read(ustore_read_t* c_ptr) {
     return_if_error_m(c.error);
 
     level_db_t& db = *reinterpret_cast<level_db_t*>(c.db);
+    stats_timer_t timer {db.stats, stats_op_t::read_k, c.tasks_count, c.error};
     level_snapshot_t& snap = *reinterpret_cast<level_snapshot_t*>(c.snapshot);
     strided_iterator_gt<ustore_key_t const> keys {c.keys, c.keys_stride};
     places_arg_t places {{}, keys, {}, c.tasks_count};
@@ -453,10 +633,12 @@ void ustore_scan(ustore_scan_t* c_ptr) {
     return_if_error_m(c.error);
 
     level_db_t& db = *reinterpret_cast<level_db_t*>(c.db);
+    stats_timer_t timer {db.stats, stats_op_t::scan_k, c.tasks_count, c.error};
     level_snapshot_t& snap = *reinterpret_cast<level_snapshot_t*>(c.snapshot);
     strided_iterator_gt<ustore_key_t const> start_keys {c.start_keys, c.start_keys_stride};
     strided_iterator_gt<ustore_length_t const> limits {c.count_limits, c.count_limits_stride};
-    scans_arg_t scans {{}, start_keys, limits, c.tasks_count};
+    strided_iterator_gt<ustore_key_t const> end_keys {c.end_keys, c.end_keys_stride};
+    scans_arg_t scans {{}, start_keys, limits, c.tasks_count, end_keys};
 
     return_if_error_m(c.error);
 
@@ -470,6 +652,13 @@ void ustore_scan(ustore_scan_t* c_ptr) {
     auto keys_output = *c.keys = arena.alloc<ustore_key_t>(total_keys, c.error).begin();
     return_if_error_m(c.error);
 
+    growing_tape_t values(arena);
+    bool const needs_values = c.values || c.values_offsets;
+    if (needs_values) {
+        values.reserve(total_keys, c.error);
+        return_if_error_m(c.error);
+    }
+
     // 2. Fetch the data
     leveldb::ReadOptions options;
     options.fill_cache = false;
@@ -479,9 +668,26 @@ void ustore_scan(ustore_scan_t* c_ptr) {
         options.snapshot = snap.snapshot;
     }
 
+    // Independent shards are scanned in parallel, each with its own iterator
+    if ((c.options & ustore_option_scan_bulk_k) && !needs_values && scans.count > 1) {
+        auto scan_one = [&](std::size_t task_idx, ustore_key_t* shard_keys, ustore_error_t*) {
+            scan_t task = scans[task_idx];
+            auto it = level_iter_uptr_t(db.native->NewIterator(options));
+            ustore_length_t j = 0;
+            it->Seek(to_slice(task.min_key));
+            for (; it->Valid() && j != task.limit && to_key(it->key()) < task.end_key; ++j, it->Next())
+                shard_keys[j] = to_key(it->key());
+            return j;
+        };
+        return scan_in_parallel(scans, offsets, counts, *c.keys, c.error, scan_one);
+    }
+
     level_iter_uptr_t it;
+    std::optional<scan_prefetcher_t> prefetcher;
     try {
         it = level_iter_uptr_t(db.native->NewIterator(options));
+        if (c.options & ustore_option_scan_sequential_k)
+            prefetcher.emplace(*db.native, options, scans);
     }
     catch (...) {
         *c.error = "Fail To Create Iterator";
@@ -494,7 +700,16 @@ void ustore_scan(ustore_scan_t* c_ptr) {
 
         ustore_size_t j = 0;
         while (it->Valid() && j != task.limit) {
-            std::memcpy(keys_output, it->key().data(), sizeof(ustore_key_t));
+            ustore_key_t key = to_key(it->key());
+            if (key >= task.end_key)
+                break;
+            *keys_output = key;
+            if (needs_values) {
+                leveldb::Slice value = it->value();
+                values.push_back(value_view_t {reinterpret_cast<ustore_bytes_cptr_t>(value.data()), value.size()},
+                                 c.error);
+                return_if_error_m(c.error);
+            }
             ++keys_output;
             ++j;
             it->Next();
@@ -504,6 +719,14 @@ void ustore_scan(ustore_scan_t* c_ptr) {
     }
 
     offsets[scans.size()] = keys_output - *c.keys;
+
+    // 3. Export the values
+    if (c.values_offsets) {
+        *c.values_offsets = values.arrow_offsets(c.error);
+        return_if_error_m(c.error);
+    }
+    if (c.values)
+        *c.values = reinterpret_cast<ustore_bytes_ptr_t>(values.contents().begin().get());
 }
 
 void ustore_sample(ustore_sample_t* c_ptr) {
@@ -517,6 +740,7 @@ void ustore_sample(ustore_sample_t* c_ptr) {
     return_if_error_m(c.error);
 
     level_db_t& db = *reinterpret_cast<level_db_t*>(c.db);
+    stats_timer_t timer {db.stats, stats_op_t::sample_k, c.tasks_count, c.error};
     level_snapshot_t& snap = *reinterpret_cast<level_snapshot_t*>(c.snapshot);
     strided_iterator_gt<ustore_length_t const> lens {c.count_limits, c.count_limits_stride};
     sample_args_t samples {{}, lens, c.tasks_count};
@@ -583,10 +807,11 @@ void ustore_measure(ustore_measure_t* c_ptr) {
     level_status_t status;
 
     for (ustore_size_t i = 0; i != c.tasks_count; ++i) {
+        // LevelDB doesn't count the entries, so only the space usage is bounded
         min_cardinalities[i] = static_cast<ustore_size_t>(0);
-        max_cardinalities[i] = static_cast<ustore_size_t>(0);
+        max_cardinalities[i] = std::numeric_limits<ustore_size_t>::max();
         min_value_bytes[i] = static_cast<ustore_size_t>(0);
-        max_value_bytes[i] = static_cast<ustore_size_t>(0);
+        max_value_bytes[i] = std::numeric_limits<ustore_size_t>::max();
 
         ustore_key_t const min_key = start_keys[i];
         ustore_key_t const max_key = end_keys[i];
@@ -609,6 +834,63 @@ void ustore_measure(ustore_measure_t* c_ptr) {
 /*****************	Collections Management	****************/
 /*********************************************************/
 
+void ustore_erase_range(ustore_erase_range_t* c_ptr) {
+
+    ustore_erase_range_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    if (!c.tasks_count)
+        return;
+    return_error_if_m(c.start_keys && c.end_keys, c.error, args_wrong_k, "Ranges must have both ends");
+
+    level_db_t& db = *reinterpret_cast<level_db_t*>(c.db);
+    stats_timer_t timer {db.stats, stats_op_t::write_k, c.tasks_count, c.error};
+    strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
+    strided_iterator_gt<ustore_key_t const> start_keys {c.start_keys, c.start_keys_stride};
+    strided_iterator_gt<ustore_key_t const> end_keys {c.end_keys, c.end_keys_stride};
+    for (std::size_t i = 0; i != c.tasks_count && collections; ++i)
+        return_error_if_m(collections[i] == ustore_collection_main_k,
+                          c.error,
+                          args_combo_k,
+                          "Collections not supported by LevelDB!");
+
+    // LevelDB has no range tombstones, so the present keys are deleted one by one
+    safe_section("Erasing ranges from LevelDB", c.error, [&] {
+        std::unique_lock<std::mutex> changes_lock {db.changes.mutex(), std::defer_lock};
+        if (db.changes.is_open())
+            changes_lock.lock();
+
+        leveldb::WriteBatch batch;
+        std::string change_entries;
+        std::size_t changes_count = 0;
+        leveldb::ReadOptions read_options;
+        read_options.fill_cache = false;
+        auto it = std::unique_ptr<leveldb::Iterator>(db.native->NewIterator(read_options));
+        for (std::size_t i = 0; i != c.tasks_count; ++i) {
+            ustore_key_t const end_key = end_keys[i];
+            for (it->Seek(to_slice(start_keys[i])); it->Valid() && to_key(it->key()) < end_key; it->Next()) {
+                batch.Delete(it->key());
+                if (!db.changes.is_open())
+                    continue;
+                collection_key_t collection_key {ustore_collection_main_k, to_key(it->key())};
+                change_log_t::serialize(change_entries, collection_key, {});
+                ++changes_count;
+            }
+        }
+        return_error_if_m(it->status().ok(), c.error, error_unknown_k, "Failed to iterate through LevelDB");
+
+        leveldb::WriteOptions options;
+        options.sync = c.options & ustore_option_write_flush_k;
+        level_status_t status = db.native->Write(options, &batch);
+        if (export_error(status, c.error))
+            return;
+
+        if (changes_count) {
+            auto change_log_status = db.changes.append(change_entries, changes_count, options.sync);
+            log_error_if_m(change_log_status, c.error, error_unknown_k, "Failed to append to change-log");
+        }
+    });
+}
+
 void ustore_collection_create(ustore_collection_create_t* c_ptr) {
 
     ustore_collection_create_t& c = *c_ptr;
@@ -627,24 +909,49 @@ void ustore_collection_drop(ustore_collection_drop_t* c_ptr) {
                       "Collections not supported by LevelDB!");
 
     level_db_t& db = *reinterpret_cast<level_db_t*>(c.db);
+    safe_section("Dropping the collection", c.error, [&] {
+        std::unique_lock<std::mutex> changes_lock {db.changes.mutex(), std::defer_lock};
+        if (db.changes.is_open())
+            changes_lock.lock();
+
+        leveldb::WriteBatch batch;
+        std::string change_entries;
+        std::size_t changes_count = 0;
+        auto it = std::unique_ptr<leveldb::Iterator>(db.native->NewIterator(leveldb::ReadOptions()));
+        auto log_change = [&](leveldb::Slice key, value_view_t value) {
+            if (!db.changes.is_open() || key.size() != sizeof(ustore_key_t))
+                return;
+            collection_key_t collection_key;
+            std::memcpy(&collection_key.key, key.data(), sizeof(ustore_key_t));
+            change_log_t::serialize(change_entries, collection_key, value);
+            ++changes_count;
+        };
 
-    leveldb::WriteBatch batch;
-    auto it = std::unique_ptr<leveldb::Iterator>(db.native->NewIterator(leveldb::ReadOptions()));
+        if (c.mode == ustore_drop_keys_vals_k) {
+            for (it->SeekToFirst(); it->Valid(); it->Next()) {
+                batch.Delete(it->key());
+                log_change(it->key(), {});
+            }
+        }
 
-    if (c.mode == ustore_drop_keys_vals_k) {
-        for (it->SeekToFirst(); it->Valid(); it->Next())
-            batch.Delete(it->key());
-    }
+        else if (c.mode == ustore_drop_vals_k) {
+            for (it->SeekToFirst(); it->Valid(); it->Next()) {
+                batch.Put(it->key(), leveldb::Slice());
+                log_change(it->key(), value_view_t::make_empty());
+            }
+        }
 
-    else if (c.mode == ustore_drop_vals_k) {
-        for (it->SeekToFirst(); it->Valid(); it->Next())
-            batch.Put(it->key(), leveldb::Slice());
-    }
+        leveldb::WriteOptions options;
+        options.sync = true;
+        level_status_t status = db.native->Write(options, &batch);
+        if (export_error(status, c.error))
+            return;
 
-    leveldb::WriteOptions options;
-    options.sync = true;
-    level_status_t status = db.native->Write(options, &batch);
-    export_error(status, c.error);
+        if (changes_count) {
+            auto change_log_status = db.changes.append(change_entries, changes_count, true);
+            log_error_if_m(change_log_status, c.error, error_unknown_k, "Failed to append to change-log");
+        }
+    });
 }
 
 void ustore_collection_list(ustore_collection_list_t* c_ptr) {
@@ -668,7 +975,40 @@ void ustore_database_control(ustore_database_control_t* c_ptr) {
         return;
 
     *c.response = NULL;
-    *c.error = "Controls aren't supported in this implementation!";
+    stats_request_t request;
+    return_error_if_m(parse_stats_request(c.request, request), c.error, args_wrong_k, "Unknown control request!");
+
+    level_db_t& db = *reinterpret_cast<level_db_t*>(c.db);
+    std::string response;
+    safe_section("Collecting statistics", c.error, [&] {
+        json_t js = json_t::object();
+        if (request.memory) {
+            // LevelDB only estimates the sizes on disk, and doesn't count the keys
+            std::uint64_t bytes = 0;
+            auto min_key = std::numeric_limits<ustore_key_t>::min();
+            auto max_key = std::numeric_limits<ustore_key_t>::max();
+            leveldb::Range range {to_slice(min_key), to_slice(max_key)};
+            db.native->GetApproximateSizes(&range, 1, &bytes);
+
+            std::string property;
+            std::uint64_t native_bytes = 0;
+            if (db.native->GetProperty("leveldb.approximate-memory-usage", &property))
+                native_bytes = std::stoull(property);
+
+            json_t& memory = js["memory"];
+            memory["collections"] = {{"", {{"bytes", bytes}}}};
+            memory["native_bytes"] = native_bytes;
+            memory["arena_bytes"] = linked_memory_t::reserved_bytes.load();
+            memory["arena_pooled_bytes"] = linked_memory_t::pooled_bytes.load();
+        }
+        if (request.ops)
+            js["ops"] = db.stats.ops_json();
+        if (request.latency)
+            js["latency"] = db.stats.latency_json();
+        response = js.dump();
+    });
+    return_if_error_m(c.error);
+    export_control_response(response, c.arena, c.response, c.error);
 }
 
 /*********************************************************/
@@ -681,12 +1021,66 @@ void ustore_transaction_init(ustore_transaction_init_t* c_ptr) {
     *c.error = "Transactions not supported by LevelDB!";
 }
 
+void ustore_transaction_stage(ustore_transaction_stage_t* c_ptr) {
+
+    ustore_transaction_stage_t& c = *c_ptr;
+    *c.error = "Transactions not supported by LevelDB!";
+}
+
 void ustore_transaction_commit(ustore_transaction_commit_t* c_ptr) {
 
     ustore_transaction_commit_t& c = *c_ptr;
     *c.error = "Transactions not supported by LevelDB!";
 }
 
+/*********************************************************/
+/*****************	     Change Feed	  ****************/
+/*********************************************************/
+
+void ustore_changes_subscribe(ustore_changes_subscribe_t* c_ptr) {
+
+    ustore_changes_subscribe_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    return_error_if_m(c.cursor, c.error, args_wrong_k, "No cursor output");
+
+    level_db_t& db = *reinterpret_cast<level_db_t*>(c.db);
+    return_error_if_m(db.changes.is_open(), c.error, args_combo_k, "Change feed isn't enabled");
+    safe_section("Subscribing to changes", c.error, [&] {
+        auto cursor = std::make_unique<change_log_t::cursor_t>();
+        auto status = db.changes.seek(c.since, *cursor);
+        return_error_if_m(status, c.error, args_wrong_k, status.message());
+        *c.cursor = cursor.release();
+    });
+}
+
+void ustore_changes_poll(ustore_changes_poll_t* c_ptr) {
+
+    ustore_changes_poll_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    return_error_if_m(c.cursor, c.error, uninitialized_state_k, "Cursor is uninitialized");
+
+    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
+    return_if_error_m(c.error);
+
+    level_db_t& db = *reinterpret_cast<level_db_t*>(c.db);
+    return_error_if_m(db.changes.is_open(), c.error, args_combo_k, "Change feed isn't enabled");
+    change_log_t::cursor_t& cursor = *reinterpret_cast<change_log_t::cursor_t*>(c.cursor);
+    safe_section("Polling changes", c.error, [&] {
+        // The cursor only advances, if the changes were exported
+        change_log_t::cursor_t next = cursor;
+        changes_batch_t batch;
+        auto status = db.changes.read(next, c.count_limit ? c.count_limit : changes_count_default_k, batch);
+        return_error_if_m(status, c.error, error_unknown_k, status.message());
+        export_changes(batch, arena, c);
+        return_if_error_m(c.error);
+        cursor = next;
+    });
+}
+
+void ustore_changes_free(ustore_changes_t c_cursor) {
+    delete reinterpret_cast<change_log_t::cursor_t*>(c_cursor);
+}
+
 /*********************************************************/
 /*****************	  Memory Management   ****************/
 /*********************************************************/
@@ -695,6 +1089,10 @@ void ustore_arena_free(ustore_arena_t c_arena) {
     clear_linked_memory(c_arena);
 }
 
+void ustore_arena_reset(ustore_arena_t c_arena) {
+    reset_linked_memory(c_arena);
+}
+
 void ustore_transaction_free(ustore_transaction_t) {
 }
 
@@ -20,8 +20,22 @@
 #include <mutex>
 #include <fstream>
 #include <filesystem>
+#include <atomic>
+#include <numeric>
+#include <algorithm>
+#include <string_view>
+#include <unordered_map>
+#include <optional>
 
 #include <rocksdb/db.h>
+#include <rocksdb/cache.h>
+#include <rocksdb/table.h>
+#include <rocksdb/filter_policy.h>
+#include <rocksdb/merge_operator.h>
+#include <rocksdb/compaction_filter.h>
+#include <rocksdb/slice_transform.h>
+#include <rocksdb/sst_file_writer.h>
+#include <rocksdb/transaction_log.h>
 #include <rocksdb/utilities/options_util.h>
 #include <rocksdb/utilities/checkpoint.h>
 #include <rocksdb/utilities/transaction.h>
@@ -32,6 +46,13 @@
 #include "helpers/linked_array.hpp"   // `uninitialized_array_gt`
 #include "helpers/full_scan.hpp"      // `reservoir_sample_iterator`
 #include "helpers/config_loader.hpp"  // `config_loader_t`
+#include "helpers/parallel.hpp"       // `scan_in_parallel`
+#include "helpers/stats.hpp"          // `engine_stats_t`
+#include "helpers/merge.hpp"          // `merge_entries`
+#include "helpers/value_cache.hpp"    // `value_cache_t`
+#include "helpers/change_log.hpp"     // `changes_batch_t`
+#include "helpers/expiration.hpp"     // `expiration_config_t`
+#include "helpers/hash.hpp"           // `hash_bytes`
 
 namespace stdfs = std::filesystem;
 using namespace unum::ustore;
@@ -51,27 +72,92 @@ using rocks_value_t = rocksdb::PinnableSlice;
 using rocks_txn_t = rocksdb::Transaction;
 using rocks_collection_t = rocksdb::ColumnFamilyHandle;
 
+/**
+ * @brief Orders the keys numerically. Slices aren't aligned, which matters for
+ * 128-bit keys in `USTORE_USE_UUID` builds, so the keys are copied out.
+ * The name reflects the width, so RocksDB refuses to open DBs of the other build.
+ */
 struct key_comparator_t final : public rocksdb::Comparator {
+    static inline ustore_key_t load(rocksdb::Slice const& slice) noexcept {
+        ustore_key_t key;
+        std::memcpy(&key, slice.data(), sizeof(ustore_key_t));
+        return key;
+    }
     inline int Compare(rocksdb::Slice const& a, rocksdb::Slice const& b) const override {
-        auto ai = *reinterpret_cast<ustore_key_t const*>(a.data());
-        auto bi = *reinterpret_cast<ustore_key_t const*>(b.data());
-        if (ai == bi)
-            return 0;
-        return ai < bi ? -1 : 1;
+        auto ai = load(a);
+        auto bi = load(b);
+        return (ai > bi) - (ai < bi);
     }
-    const char* Name() const override { return "i64"; }
+    const char* Name() const override { return sizeof(ustore_key_t) == 16 ? "i128" : "i64"; }
     void FindShortestSeparator(std::string*, rocksdb::Slice const&) const override {}
     void FindShortSuccessor(std::string*) const override {}
     bool CanKeysWithDifferentByteContentsBeEqual() const override { return false; }
     bool IsSameLengthImmediateSuccessor(rocksdb::Slice const& s, rocksdb::Slice const& t) const override {
-        auto si = *reinterpret_cast<ustore_key_t const*>(s.data());
-        auto ti = *reinterpret_cast<ustore_key_t const*>(t.data());
-        return si + 1 == ti;
+        return load(s) + 1 == load(t);
     }
 };
 
 static key_comparator_t key_comparator_k = {};
 
+/**
+ * @brief Resolves the operands of `ustore_option_write_merge_k`, delegating
+ * to the modality, that has produced them. Partial merges aren't implemented,
+ * so RocksDB keeps stacking the operands until a read or a compaction.
+ * In expiring collections, the result inherits the deadline of the latest operand.
+ */
+struct merge_operator_t final : public rocksdb::MergeOperator {
+    bool stamped = false;
+
+    merge_operator_t(bool stamped = false) noexcept : stamped(stamped) {}
+
+    bool FullMergeV2(MergeOperationInput const& merge_in, MergeOperationOutput* merge_out) const override {
+        auto to_view = [](rocksdb::Slice const& slice) {
+            return value_view_t {reinterpret_cast<byte_t const*>(slice.data()), slice.size()};
+        };
+        auto to_stripped_view = [&](rocksdb::Slice const& slice) { return strip_deadline(to_view(slice)); };
+        value_view_t base = merge_in.existing_value ? to_view(*merge_in.existing_value) : value_view_t {};
+        std::vector<value_view_t> operands(merge_in.operand_list.size());
+        if (!stamped) {
+            std::transform(merge_in.operand_list.begin(), merge_in.operand_list.end(), operands.begin(), to_view);
+            return merge_entries(base, {operands.data(), operands.size()}, merge_out->new_value);
+        }
+
+        expiration_time_t deadline = deadline_of(to_view(merge_in.operand_list.back()));
+        base = base && !is_expired(deadline_of(base), expiration_now()) ? strip_deadline(base) : value_view_t {};
+        std::transform(merge_in.operand_list.begin(), merge_in.operand_list.end(), operands.begin(), to_stripped_view);
+        if (!merge_entries(base, {operands.data(), operands.size()}, merge_out->new_value))
+            return false;
+        merge_out->new_value.append(reinterpret_cast<char const*>(&deadline), deadline_length_k);
+        return true;
+    }
+    const char* Name() const override { return "ustore"; }
+};
+
+/**
+ * @brief Drops the expired values of collections with a TTL, whenever their files are compacted.
+ * Merge operands are kept, as they are only resolved on reads and in `merge_operator_t`.
+ */
+struct expiration_filter_t final : public rocksdb::CompactionFilter {
+    bool Filter(int, rocksdb::Slice const&, rocksdb::Slice const& value, std::string*, bool*) const override {
+        value_view_t stamped {reinterpret_cast<byte_t const*>(value.data()), value.size()};
+        return is_expired(deadline_of(stamped), expiration_now());
+    }
+    const char* Name() const override { return "ustore-expiration"; }
+};
+
+static expiration_filter_t expiration_filter_k = {};
+
+/**
+ * @brief Expiring collections have their values stamped with deadlines, so that
+ * they can be dropped by the compactions. RocksDB triggers those for the files,
+ * that are older than the @p ttl, even if the collection isn't updated.
+ */
+void configure_expiration(rocksdb::ColumnFamilyOptions& cf_options, expiration_time_t ttl) noexcept(false) {
+    cf_options.compaction_filter = &expiration_filter_k;
+    cf_options.merge_operator = std::make_shared<merge_operator_t>(true);
+    cf_options.ttl = ttl;
+}
+
 struct rocks_snapshot_t {
     rocksdb::Snapshot const* snapshot = nullptr;
 };
@@ -81,8 +167,230 @@ struct rocks_db_t {
     std::unordered_map<ustore_snapshot_t, rocks_snapshot_t*> snapshots;
     std::unique_ptr<rocks_native_t> native;
     std::mutex mutex;
+
+    /**
+     * @brief Storage paths from `data_directories`, shared by all collections.
+     */
+    std::vector<rocksdb::DbPath> paths;
+
+    /**
+     * @brief Template for new collections, including the table factory,
+     * which references the @b shared block cache, if one is configured.
+     */
+    rocksdb::ColumnFamilyOptions cf_options;
+    std::shared_ptr<rocksdb::Cache> block_cache;
+    /**
+     * @brief Byte-prefixes of our little-endian keys don't follow the numeric
+     * order, so with a prefix extractor all the scans must ignore it.
+     */
+    bool total_order_seek = false;
+
+    /**
+     * @brief Temporary directory for SST files of `ustore_option_write_bulk_k`
+     * batches, which are moved into the DB on ingestion.
+     */
+    stdfs::path ingest_directory;
+    std::atomic<std::size_t> ingested_files {0};
+
+    /**
+     * @brief Optional read-through caches of collections, that have a non-zero
+     * capacity in the "value_cache" config. Like `columns`, these are only
+     * modified by collection management calls.
+     */
+    value_cache_config_t value_cache_config;
+    std::unordered_map<ustore_collection_t, std::unique_ptr<value_cache_t>> value_caches;
+
+    /**
+     * @brief Lifetimes of values in collections, that have one in the "ttl" config.
+     * Those values carry their deadlines in the last bytes, which are stripped on exports.
+     * Like `columns`, these are only modified by collection management calls.
+     */
+    expiration_config_t expiration_config;
+    std::unordered_map<ustore_collection_t, expiration_time_t> ttls;
+
+    /**
+     * @brief If the "change_feed" is configured, the WAL files are archived instead
+     * of being deleted, and are tailed by `ustore_changes_poll()`. All the writes
+     * go through the WAL then, even if they aren't flushed.
+     */
+    bool change_feed = false;
+
+    engine_stats_t stats;
 };
 
+struct rocks_changes_t {
+    rocksdb::SequenceNumber next = 0;
+};
+
+/**
+ * @brief Rotates the shared storage paths for every collection, so that
+ * the upper levels of different collections start on different disks.
+ * The choice only depends on the name and uses a portable hash, so it's stable
+ * across restarts, even if the binary is rebuilt with a different standard library.
+ */
+inline std::vector<rocksdb::DbPath> collection_paths(rocks_db_t const& db, std::string_view name) noexcept(false) {
+    std::vector<rocksdb::DbPath> paths = db.paths;
+    if (paths.size() > 1) {
+        std::size_t first = hash_bytes(name.data(), name.size()) % paths.size();
+        std::rotate(paths.begin(), paths.begin() + first, paths.end());
+    }
+    return paths;
+}
+
+bool parse_compression(json_t const& j_type, rocksdb::CompressionType& type) noexcept {
+    static std::unordered_map<std::string, rocksdb::CompressionType> const types {
+        {"kNoCompression", rocksdb::kNoCompression},
+        {"kSnappyCompression", rocksdb::kSnappyCompression},
+        {"kZlibCompression", rocksdb::kZlibCompression},
+        {"kBZip2Compression", rocksdb::kBZip2Compression},
+        {"kLZ4Compression", rocksdb::kLZ4Compression},
+        {"kLZ4HCCompression", rocksdb::kLZ4HCCompression},
+        {"kXpressCompression", rocksdb::kXpressCompression},
+        {"kZSTD", rocksdb::kZSTD},
+    };
+    if (!j_type.is_string())
+        return false;
+    auto it = types.find(j_type.get<std::string>());
+    if (it == types.end())
+        return false;
+    type = it->second;
+    return true;
+}
+
+/**
+ * @brief Parses "compression", "bottommost_compression" and "compression_per_level"
+ * from the "CFOptions" section. The last one is an array of types, starting from L0.
+ * Frequently, the first levels are kept uncompressed, as they are rewritten often.
+ */
+void load_compression(json_t const& j_cf, rocksdb::ColumnFamilyOptions& cf_options, ustore_error_t* c_error) {
+
+    bool compressed = false;
+    if (j_cf.contains("compression")) {
+        return_error_if_m(parse_compression(j_cf["compression"], cf_options.compression),
+                          c_error,
+                          args_wrong_k,
+                          "Unknown compression type");
+        compressed |= cf_options.compression != rocksdb::kNoCompression;
+    }
+    if (j_cf.contains("bottommost_compression")) {
+        return_error_if_m(parse_compression(j_cf["bottommost_compression"], cf_options.bottommost_compression),
+                          c_error,
+                          args_wrong_k,
+                          "Unknown bottommost compression type");
+        compressed |= cf_options.bottommost_compression != rocksdb::kNoCompression;
+    }
+    if (j_cf.contains("compression_per_level")) {
+        auto const& j_levels = j_cf["compression_per_level"];
+        return_error_if_m(j_levels.is_array(), c_error, args_wrong_k, "Compression per level must be an array");
+        cf_options.compression_per_level.clear();
+        for (auto const& j_level : j_levels) {
+            rocksdb::CompressionType type;
+            return_error_if_m(parse_compression(j_level, type), c_error, args_wrong_k, "Unknown compression type");
+            cf_options.compression_per_level.push_back(type);
+            compressed |= type != rocksdb::kNoCompression;
+        }
+    }
+    if (compressed)
+        log_warning_m(
+            "We discourage general-purpose compression in favour "
+            "of modality-aware compression in UStore\n");
+}
+
+/**
+ * @brief Builds a `BlockBasedTable` factory from the "TableOptions" section:
+ *
+ * - "block_size": Uncompressed size of data blocks, like "16KB".
+ * - "block_cache": Object with the "type", "lru" or "clock", and the "capacity".
+ *   The cache is shared between all collections.
+ * - "bloom_bits_per_key": Enables Bloom filters, 10 bits give ~1% false positives.
+ * - "whole_key_filtering": Whether filters contain the entire keys.
+ * - "prefix_length": Additionally adds fixed-length key prefixes into filters.
+ * - "cache_index_and_filter_blocks": Charges index & filters to the block cache.
+ * - "pin_l0_filter_and_index_blocks_in_cache": Keeps them for the first level.
+ * - "partitioned_index": Two-level indexes and filters, only the top-level is pinned.
+ */
+void load_table_options(json_t const& j_table,
+                        rocks_db_t& db,
+                        rocksdb::ColumnFamilyOptions& cf_options,
+                        ustore_error_t* c_error) {
+
+    rocksdb::BlockBasedTableOptions table_options;
+    return_error_if_m(config_loader_t::parse_volume(j_table, "block_size", table_options.block_size),
+                      c_error,
+                      args_wrong_k,
+                      "Invalid block size");
+
+    if (j_table.contains("block_cache")) {
+        auto const& j_cache = j_table["block_cache"];
+        std::size_t capacity = 8 * 1024 * 1024;
+        return_error_if_m(config_loader_t::parse_volume(j_cache, "capacity", capacity),
+                          c_error,
+                          args_wrong_k,
+                          "Invalid block cache capacity");
+        std::string type = j_cache.value("type", "lru");
+        int shard_bits = j_cache.value("shard_bits", -1);
+        if (type == "clock") {
+            db.block_cache = rocksdb::NewClockCache(capacity, shard_bits);
+            if (!db.block_cache)
+                log_warning_m("Clock cache isn't supported by this RocksDB build, using LRU\n");
+        }
+        else
+            return_error_if_m(type == "lru", c_error, args_wrong_k, "Unknown block cache type");
+        if (!db.block_cache) {
+            rocksdb::LRUCacheOptions cache_options;
+            cache_options.capacity = capacity;
+            cache_options.num_shard_bits = shard_bits;
+            cache_options.high_pri_pool_ratio = j_cache.value("high_pri_pool_ratio", 0.5);
+            db.block_cache = rocksdb::NewLRUCache(cache_options);
+        }
+        table_options.block_cache = db.block_cache;
+    }
+
+    if (j_table.contains("bloom_bits_per_key")) {
+        double bits_per_key = j_table["bloom_bits_per_key"].get<double>();
+        table_options.filter_policy.reset(rocksdb::NewBloomFilterPolicy(bits_per_key));
+        table_options.optimize_filters_for_memory = true;
+    }
+    if (j_table.contains("whole_key_filtering"))
+        table_options.whole_key_filtering = j_table["whole_key_filtering"];
+    if (j_table.contains("prefix_length")) {
+        std::size_t prefix_length = j_table["prefix_length"].get<std::size_t>();
+        return_error_if_m(prefix_length && prefix_length < sizeof(ustore_key_t),
+                          c_error,
+                          args_wrong_k,
+                          "Prefix must be shorter than the key");
+        cf_options.prefix_extractor.reset(rocksdb::NewFixedPrefixTransform(prefix_length));
+    }
+    if (j_table.contains("cache_index_and_filter_blocks")) {
+        table_options.cache_index_and_filter_blocks = j_table["cache_index_and_filter_blocks"];
+        table_options.cache_index_and_filter_blocks_with_high_priority = true;
+    }
+    if (j_table.contains("pin_l0_filter_and_index_blocks_in_cache"))
+        table_options.pin_l0_filter_and_index_blocks_in_cache = j_table["pin_l0_filter_and_index_blocks_in_cache"];
+    if (j_table.value("partitioned_index", false)) {
+        table_options.index_type = rocksdb::BlockBasedTableOptions::kTwoLevelIndexSearch;
+        table_options.partition_filters = table_options.filter_policy != nullptr;
+        table_options.pin_top_level_index_and_filter = true;
+    }
+
+    cf_options.table_factory.reset(rocksdb::NewBlockBasedTableFactory(table_options));
+}
+
+/**
+ * @brief Read-ahead for `ustore_option_scan_sequential_k`, large enough
+ * to saturate NVMe drives with a few concurrent iterators.
+ */
+static constexpr std::size_t scan_readahead_k = 2 * 1024 * 1024;
+
+/**
+ * @brief Options for iterators, that must honor the numeric order of keys.
+ */
+inline rocksdb::ReadOptions scan_options(rocks_db_t const& db) noexcept {
+    rocksdb::ReadOptions options;
+    options.total_order_seek = db.total_order_seek;
+    return options;
+}
+
 inline rocksdb::Slice to_slice(ustore_key_t const& key) noexcept {
     return {reinterpret_cast<char const*>(&key), sizeof(ustore_key_t)};
 }
@@ -91,6 +399,10 @@ inline rocksdb::Slice to_slice(value_view_t value) noexcept {
     return {reinterpret_cast<const char*>(value.begin()), value.size()};
 }
 
+inline value_view_t to_view(rocksdb::Slice const& slice) noexcept {
+    return {reinterpret_cast<byte_t const*>(slice.data()), slice.size()};
+}
+
 inline std::unique_ptr<rocks_value_t> make_value(ustore_error_t* c_error) noexcept {
     std::unique_ptr<rocks_value_t> value_uptr;
     safe_section("Allocating RocksDB-compatible value buffer", c_error, [&] {
@@ -119,6 +431,176 @@ rocks_collection_t* rocks_collection(rocks_db_t& db, ustore_collection_t collect
                                                   : reinterpret_cast<rocks_collection_t*>(collection);
 }
 
+ustore_collection_t collection_id(rocks_collection_t* column) noexcept {
+    return column->GetName() == rocksdb::kDefaultColumnFamilyName ? ustore_collection_main_k
+                                                                  : reinterpret_cast<ustore_collection_t>(column);
+}
+
+std::string collection_name(rocks_collection_t* column) {
+    return column->GetName() == rocksdb::kDefaultColumnFamilyName ? std::string() : column->GetName();
+}
+
+value_cache_t* value_cache(rocks_db_t& db, ustore_collection_t collection) noexcept {
+    if (db.value_caches.empty())
+        return nullptr;
+    auto it = db.value_caches.find(collection);
+    return it != db.value_caches.end() ? it->second.get() : nullptr;
+}
+
+/**
+ * @brief Cached values would outlive their deadlines, so expiring collections aren't cached.
+ */
+void add_value_cache(rocks_db_t& db, rocks_collection_t* column) noexcept(false) {
+    std::string name = collection_name(column);
+    std::size_t capacity = db.value_cache_config.capacity_for(name);
+    if (capacity && !db.expiration_config.ttl_for(name))
+        db.value_caches[collection_id(column)] = std::make_unique<value_cache_t>(capacity);
+}
+
+void add_expiration(rocks_db_t& db, rocks_collection_t* column) noexcept(false) {
+    if (expiration_time_t ttl = db.expiration_config.ttl_for(collection_name(column)); ttl)
+        db.ttls[collection_id(column)] = ttl;
+}
+
+bool expires(rocks_db_t const& db, ustore_collection_t collection) noexcept {
+    return !db.ttls.empty() && db.ttls.count(collection);
+}
+
+/**
+ * @brief Appends the deadline to the @p content, if the @p collection expires.
+ * The result is only valid until the @p buffer is changed.
+ */
+value_view_t stamp(rocks_db_t const& db,
+                   ustore_collection_t collection,
+                   value_view_t content,
+                   std::string& buffer) noexcept(false) {
+    if (!content || db.ttls.empty())
+        return content;
+    auto it = db.ttls.find(collection);
+    return it != db.ttls.end() ? append_deadline(content, expiration_now() + it->second, buffer) : content;
+}
+
+/**
+ * @brief Strips the deadline from the @p value, if the @p collection expires,
+ * hiding it altogether, if the deadline has passed.
+ */
+value_view_t unstamp(rocks_db_t const& db, ustore_collection_t collection, value_view_t value) noexcept {
+    if (!value || !expires(db, collection))
+        return value;
+    return is_expired(deadline_of(value), expiration_now()) ? value_view_t {} : strip_deadline(value);
+}
+
+/**
+ * @brief Drops the cached copies of updated entries. Must follow the update itself.
+ */
+void invalidate_value_caches(rocks_db_t& db, places_arg_t const& places) noexcept {
+    if (db.value_caches.empty())
+        return;
+    for (std::size_t i = 0; i != places.size(); ++i) {
+        place_t place = places[i];
+        if (value_cache_t* cache = value_cache(db, place.collection))
+            cache->invalidate(place.key);
+    }
+}
+
+/**
+ * @brief Collects the keys, updated by a pending transaction, to invalidate their cached copies on commit.
+ */
+struct updated_keys_t final : public rocksdb::WriteBatch::Handler {
+    std::unordered_map<std::uint32_t, ustore_collection_t> collections;
+    std::vector<collection_key_t> keys;
+    std::vector<ustore_collection_t> cleared;
+
+    updated_keys_t(std::unordered_map<std::uint32_t, ustore_collection_t> ids) : collections(std::move(ids)) {}
+
+    rocks_status_t updated(std::uint32_t column_family_id, rocksdb::Slice const& key) {
+        auto it = collections.find(column_family_id);
+        if (it == collections.end())
+            return rocks_status_t::OK();
+        if (key.size() != sizeof(ustore_key_t)) {
+            cleared.push_back(it->second);
+            return rocks_status_t::OK();
+        }
+        ustore_key_t parsed;
+        std::memcpy(&parsed, key.data(), sizeof(ustore_key_t));
+        keys.emplace_back(it->second, parsed);
+        return rocks_status_t::OK();
+    }
+
+    rocks_status_t PutCF(std::uint32_t id, rocksdb::Slice const& key, rocksdb::Slice const&) override {
+        return updated(id, key);
+    }
+    rocks_status_t MergeCF(std::uint32_t id, rocksdb::Slice const& key, rocksdb::Slice const&) override {
+        return updated(id, key);
+    }
+    rocks_status_t DeleteCF(std::uint32_t id, rocksdb::Slice const& key) override { return updated(id, key); }
+    rocks_status_t SingleDeleteCF(std::uint32_t id, rocksdb::Slice const& key) override { return updated(id, key); }
+    rocks_status_t DeleteRangeCF(std::uint32_t id, rocksdb::Slice const&, rocksdb::Slice const&) override {
+        return updated(id, {});
+    }
+};
+
+/**
+ * @brief Collects the changes from archived WAL batches, skipping the ones before `next`.
+ * Every operation in a batch has its own sequence number, even if it's skipped.
+ * Merge operands aren't meaningful on their own, so the latest merged value is exported.
+ */
+struct changes_exporter_t final : public rocksdb::WriteBatch::Handler {
+    rocks_db_t& db;
+    std::unordered_map<std::uint32_t, rocks_collection_t*> const& columns;
+    changes_batch_t& batch;
+    std::size_t limit = 0;
+    rocksdb::SequenceNumber next = 0;
+    rocksdb::SequenceNumber sequence = 0;
+    std::string merged;
+
+    changes_exporter_t(rocks_db_t& db,
+                       std::unordered_map<std::uint32_t, rocks_collection_t*> const& columns,
+                       changes_batch_t& batch,
+                       std::size_t limit,
+                       rocksdb::SequenceNumber next) noexcept
+        : db(db), columns(columns), batch(batch), limit(limit), next(next) {}
+
+    template <typename value_getter_at>
+    rocks_status_t exported(std::uint32_t column_family_id, rocksdb::Slice const& key, value_getter_at&& get) {
+        rocksdb::SequenceNumber current = sequence++;
+        if (current < next)
+            return rocks_status_t::OK();
+        next = current + 1;
+
+        auto it = columns.find(column_family_id);
+        if (it == columns.end() || key.size() != sizeof(ustore_key_t))
+            return rocks_status_t::OK();
+        collection_key_t collection_key;
+        collection_key.collection = collection_id(it->second);
+        std::memcpy(&collection_key.key, key.data(), sizeof(ustore_key_t));
+        value_view_t value = get(it->second, key);
+        batch.push_back(collection_key,
+                        current,
+                        value && expires(db, collection_key.collection) ? strip_deadline(value) : value);
+        return rocks_status_t::OK();
+    }
+
+    rocks_status_t PutCF(std::uint32_t id, rocksdb::Slice const& key, rocksdb::Slice const& value) override {
+        return exported(id, key, [&](rocks_collection_t*, rocksdb::Slice const&) { return to_view(value); });
+    }
+    rocks_status_t MergeCF(std::uint32_t id, rocksdb::Slice const& key, rocksdb::Slice const&) override {
+        return exported(id, key, [&](rocks_collection_t* column, rocksdb::Slice const& key) {
+            rocks_status_t status = db.native->Get(rocksdb::ReadOptions(), column, key, &merged);
+            return status.ok() ? to_view(merged) : value_view_t {};
+        });
+    }
+    rocks_status_t DeleteCF(std::uint32_t id, rocksdb::Slice const& key) override {
+        return exported(id, key, [](rocks_collection_t*, rocksdb::Slice const&) { return value_view_t {}; });
+    }
+    rocks_status_t SingleDeleteCF(std::uint32_t id, rocksdb::Slice const& key) override { return DeleteCF(id, key); }
+    rocks_status_t DeleteRangeCF(std::uint32_t, rocksdb::Slice const&, rocksdb::Slice const&) override {
+        ++sequence;
+        return rocks_status_t::OK();
+    }
+    bool Continue() override { return batch.size() < limit; }
+};
+
 /*********************************************************/
 /*****************	    C Interface 	  ****************/
 /*********************************************************/
@@ -152,6 +634,8 @@ void ustore_database_init(ustore_database_init_t* c_ptr) {
         options.compression = rocksdb::kNoCompression;
         auto cf_options = rocksdb::ColumnFamilyOptions();
         std::vector<rocksdb::ColumnFamilyDescriptor> column_descriptors;
+        bool custom_table = false;
+        change_feed_config_t change_feed;
         return_error_if_m(config.engine.config_url.empty(), c.error, args_wrong_k, "Doesn't support URL configs");
 
         // Load from file
@@ -198,32 +682,75 @@ void ustore_database_init(ustore_database_init_t* c_ptr) {
                     cf_options.target_file_size_multiplier = j_cf["target_file_size_multiplier"];
                 if (j_cf.contains("max_bytes_for_level_multiplier"))
                     cf_options.max_bytes_for_level_multiplier = j_cf["max_bytes_for_level_multiplier"];
-                if (j_cf.contains("compression"))
-                    if (j_cf["compression"] != "kNoCompression")
-                        log_warning_m(
-                            "We discourage general-purpose compression in favour "
-                            "of modality-aware compression in UStore\n");
+                load_compression(j_cf, cf_options, c.error);
+                return_if_error_m(c.error);
             }
+
+            if (js.contains("TableOptions")) {
+                load_table_options(js["TableOptions"], *db_ptr, cf_options, c.error);
+                return_if_error_m(c.error);
+                custom_table = true;
+            }
+
+            return_error_if_m(value_cache_config_t::parse(js, db_ptr->value_cache_config),
+                              c.error,
+                              args_wrong_k,
+                              "Invalid value cache config");
+            return_error_if_m(change_feed_config_t::parse(js, change_feed),
+                              c.error,
+                              args_wrong_k,
+                              "Invalid change feed config");
+            return_error_if_m(expiration_config_t::parse(js, db_ptr->expiration_config),
+                              c.error,
+                              args_wrong_k,
+                              "Invalid TTL config");
         }
 
         rocksdb::ConfigOptions config_options;
         status = rocksdb::LoadLatestOptions(config_options, root, &options, &column_descriptors);
         return_error_if_m(status.ok() || status.IsNotFound(), c.error, error_unknown_k, "Recovering RocksDB state");
 
+        // Storage paths
+        for (auto const& disk : config.data_directories)
+            db_ptr->paths.push_back({disk.path, disk.max_size});
+        options.db_paths = db_ptr->paths;
+
+        // Block caches and prefix extractors aren't fully restored from
+        // the options files, so the nested config takes precedence
         cf_options.comparator = &key_comparator_k;
+        cf_options.merge_operator = std::make_shared<merge_operator_t>();
+        db_ptr->cf_options = cf_options;
         if (column_descriptors.empty())
             column_descriptors.push_back({rocksdb::kDefaultColumnFamilyName, std::move(cf_options)});
         else {
-            for (auto& column_descriptor : column_descriptors)
+            for (auto& column_descriptor : column_descriptors) {
                 column_descriptor.options.comparator = &key_comparator_k;
+                column_descriptor.options.merge_operator = cf_options.merge_operator;
+                if (!custom_table)
+                    continue;
+                column_descriptor.options.table_factory = cf_options.table_factory;
+                column_descriptor.options.prefix_extractor = cf_options.prefix_extractor;
+            }
+        }
+        for (auto& column_descriptor : column_descriptors)
+            db_ptr->total_order_seek |= column_descriptor.options.prefix_extractor != nullptr;
+        for (auto& column_descriptor : column_descriptors)
+            column_descriptor.options.cf_paths = collection_paths(*db_ptr, column_descriptor.name);
+        for (auto& column_descriptor : column_descriptors) {
+            bool is_main = column_descriptor.name == rocksdb::kDefaultColumnFamilyName;
+            std::string name = is_main ? std::string() : column_descriptor.name;
+            if (expiration_time_t ttl = db_ptr->expiration_config.ttl_for(name); ttl)
+                configure_expiration(column_descriptor.options, ttl);
         }
 
         options.create_if_missing = true;
         options.comparator = &key_comparator_k;
 
-        // Storage paths
-        for (auto const& disk : config.data_directories)
-            options.db_paths.push_back({disk.path, disk.max_size});
+        // Archived WAL files back the change-feed
+        if (change_feed.enabled) {
+            options.WAL_size_limit_MB = std::max<std::uint64_t>(change_feed.retention >> 20, 1);
+            db_ptr->change_feed = true;
+        }
 
         rocks_native_t* native_db = nullptr;
         rocksdb::OptimisticTransactionDBOptions txn_options;
@@ -231,6 +758,14 @@ void ustore_database_init(ustore_database_init_t* c_ptr) {
         return_error_if_m(status.ok(), c.error, error_unknown_k, "Opening RocksDB with options");
 
         db_ptr->native = std::unique_ptr<rocks_native_t>(native_db);
+        if (db_ptr->expiration_config.enabled())
+            for (rocks_collection_t* column : db_ptr->columns)
+                add_expiration(*db_ptr, column);
+        if (db_ptr->value_cache_config.enabled())
+            for (rocks_collection_t* column : db_ptr->columns)
+                add_value_cache(*db_ptr, column);
+        db_ptr->ingest_directory = root / "ingest";
+        stdfs::create_directories(db_ptr->ingest_directory);
         *c.db = db_ptr.release();
     });
 }
@@ -238,7 +773,7 @@ void ustore_database_init(ustore_database_init_t* c_ptr) {
 void ustore_get_metadata(ustore_get_metadata_t* c_ptr) {
     ustore_get_metadata_t& c = *c_ptr;
     *c.metadata = ustore_metadata_t(ustore_supports_transactions_k | ustore_supports_named_collections_k |
-                                    ustore_supports_snapshots_k);
+                                    ustore_supports_snapshots_k | ustore_supports_merges_k);
 }
 
 void ustore_snapshot_list(ustore_snapshot_list_t* c_ptr) {
@@ -348,13 +883,15 @@ void write_one( //
 
     bool const safe = c_options & ustore_option_write_flush_k;
     bool const watch = !(c_options & ustore_option_transaction_dont_watch_k);
+    bool const merge = c_options & ustore_option_write_merge_k;
 
     rocksdb::WriteOptions options;
     options.sync = safe;
-    options.disableWAL = !safe;
+    options.disableWAL = !safe && !db.change_feed;
 
     auto place = places[0];
-    auto content = contents[0];
+    std::string stamped;
+    auto content = stamp(db, place.collection, contents[0], stamped);
     auto collection = rocks_collection(db, place.collection);
     auto key = to_slice(place.key);
     rocks_status_t status;
@@ -365,6 +902,10 @@ void write_one( //
                 ? watch //
                       ? txn_ptr->Delete(collection, key)
                       : txn_ptr->DeleteUntracked(collection, key)
+            : merge     //
+                ? watch //
+                      ? txn_ptr->Merge(collection, key, to_slice(content))
+                      : txn_ptr->MergeUntracked(collection, key, to_slice(content))
                 : watch //
                       ? txn_ptr->Put(collection, key, to_slice(content))
                       : txn_ptr->PutUntracked(collection, key, to_slice(content));
@@ -372,6 +913,8 @@ void write_one( //
         status =     //
             !content //
                 ? db.native->Delete(options, collection, key)
+            : merge //
+                ? db.native->Merge(options, collection, key, to_slice(content))
                 : db.native->Put(options, collection, key, to_slice(content));
 
     export_error(status, c_error);
@@ -387,15 +930,18 @@ void write_many( //
 
     bool const safe = c_options & ustore_option_write_flush_k;
     bool const watch = !(c_options & ustore_option_transaction_dont_watch_k);
+    bool const merge = c_options & ustore_option_write_merge_k;
 
     rocksdb::WriteOptions options;
     options.sync = safe;
-    options.disableWAL = !safe;
+    options.disableWAL = !safe && !db.change_feed;
 
+    // Both transactions and batches copy the values, so the buffer is reused
+    std::string stamped;
     if (txn_ptr) {
         for (std::size_t i = 0; i != places.size(); ++i) {
             auto place = places[i];
-            auto content = contents[i];
+            auto content = stamp(db, place.collection, contents[i], stamped);
             auto collection = rocks_collection(db, place.collection);
             auto key = to_slice(place.key);
             auto status =   //
@@ -403,6 +949,10 @@ void write_many( //
                     ? watch //
                           ? txn_ptr->Delete(collection, key)
                           : txn_ptr->DeleteUntracked(collection, key)
+                : merge     //
+                    ? watch //
+                          ? txn_ptr->Merge(collection, key, to_slice(content))
+                          : txn_ptr->MergeUntracked(collection, key, to_slice(content))
                     : watch //
                           ? txn_ptr->Put(collection, key, to_slice(content))
                           : txn_ptr->PutUntracked(collection, key, to_slice(content));
@@ -414,12 +964,12 @@ void write_many( //
         rocksdb::WriteBatch batch;
         for (std::size_t i = 0; i != places.size(); ++i) {
             auto place = places[i];
-            auto content = contents[i];
+            auto content = stamp(db, place.collection, contents[i], stamped);
             auto collection = rocks_collection(db, place.collection);
             auto key = to_slice(place.key);
-            auto status = !content //
-                              ? batch.Delete(collection, key)
-                              : batch.Put(collection, key, to_slice(content));
+            auto status = !content ? batch.Delete(collection, key)
+                          : merge  ? batch.Merge(collection, key, to_slice(content))
+                                   : batch.Put(collection, key, to_slice(content));
             export_error(status, c_error);
         }
 
@@ -428,6 +978,67 @@ void write_many( //
     }
 }
 
+/**
+ * @brief Implements `ustore_option_write_bulk_k`. The batch is sorted and every
+ * collection's part is written into an external SST file, that is ingested,
+ * bypassing the memtables. If the range doesn't overlap with existing data, like
+ * in an empty DB, the file lands straight in the last level, avoiding compactions.
+ */
+void ingest_many( //
+    rocks_db_t& db,
+    places_arg_t const& places,
+    contents_arg_t const& contents,
+    ustore_error_t* c_error) noexcept(false) {
+
+    // SST files must be sorted and can't contain duplicates, so the last write wins
+    std::vector<std::size_t> order(places.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+        return places[a].collection_key() < places[b].collection_key();
+    });
+
+    std::string stamped;
+    for (std::size_t group_begin = 0; group_begin != order.size();) {
+        ustore_collection_t collection_id = places[order[group_begin]].collection;
+        std::size_t group_end = group_begin + 1;
+        while (group_end != order.size() && places[order[group_end]].collection == collection_id)
+            ++group_end;
+
+        auto collection = rocks_collection(db, collection_id);
+        auto file_idx = db.ingested_files.fetch_add(1);
+        std::string path = (db.ingest_directory / ("batch-" + std::to_string(file_idx) + ".sst")).string();
+        rocksdb::SstFileWriter writer(rocksdb::EnvOptions(), db.native->GetOptions(collection), collection);
+        rocks_status_t status = writer.Open(path);
+        if (export_error(status, c_error))
+            return;
+
+        for (std::size_t i = group_begin; i != group_end; ++i) {
+            place_t place = places[order[i]];
+            bool is_overwritten = i + 1 != group_end && places[order[i + 1]].key == place.key;
+            if (is_overwritten)
+                continue;
+            value_view_t content = stamp(db, collection_id, contents[order[i]], stamped);
+            status = content ? writer.Put(to_slice(place.key), to_slice(content)) : writer.Delete(to_slice(place.key));
+            if (export_error(status, c_error))
+                break;
+        }
+        if (!*c_error)
+            status = writer.Finish();
+
+        if (!*c_error && !export_error(status, c_error)) {
+            rocksdb::IngestExternalFileOptions ingest_options;
+            ingest_options.move_files = true;
+            status = db.native->IngestExternalFile(collection, {path}, ingest_options);
+            export_error(status, c_error);
+        }
+
+        std::error_code ignored_error;
+        stdfs::remove(path, ignored_error);
+        return_if_error_m(c_error);
+        group_begin = group_end;
+    }
+}
+
 void ustore_write(ustore_write_t* c_ptr) {
 
     ustore_write_t& c = *c_ptr;
@@ -436,6 +1047,7 @@ void ustore_write(ustore_write_t* c_ptr) {
         return;
 
     rocks_db_t& db = *reinterpret_cast<rocks_db_t*>(c.db);
+    stats_timer_t timer {db.stats, stats_op_t::write_k, c.tasks_count, c.error};
     rocks_txn_t& txn = *reinterpret_cast<rocks_txn_t*>(c.transaction);
     strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
     strided_iterator_gt<ustore_key_t const> keys {c.keys, c.keys_stride};
@@ -450,10 +1062,26 @@ void ustore_write(ustore_write_t* c_ptr) {
     validate_write(c.transaction, places, contents, c.options, c.error);
     return_if_error_m(c.error);
 
+    // Ingesting tiny files would only increase the number of levels to visit
+    // Merge operands can't be deduplicated, so they always take the regular path
+    // Ingested files bypass the WAL, so they would be missing from the change-feed
+    bool const bulk = (c.options & ustore_option_write_bulk_k) && !(c.options & ustore_option_write_merge_k) &&
+                      !db.change_feed;
+    if (bulk && !c.transaction && c.tasks_count > 1) {
+        safe_section("Ingesting into RocksDB", c.error, [&] { ingest_many(db, places, contents, c.error); });
+        invalidate_value_caches(db, places);
+        return;
+    }
+
     safe_section("Writing into RocksDB", c.error, [&] {
         auto func = c.tasks_count == 1 ? &write_one : &write_many;
         func(db, &txn, places, contents, c.options, c.error);
     });
+
+    // Transactional writes only become visible and invalidate on commit.
+    // Failed writes are invalidated as well, which is always safe.
+    if (!c.transaction)
+        invalidate_value_caches(db, places);
 }
 
 template <typename value_enumerator_at>
@@ -493,7 +1121,7 @@ void read_one( //
             return;
         auto begin = reinterpret_cast<ustore_bytes_cptr_t>(value.data());
         auto length = static_cast<ustore_length_t>(value.size());
-        enumerator(0, value_view_t {begin, length});
+        enumerator(0, unstamp(db, place.collection, value_view_t {begin, length}));
     }
     else
         enumerator(0, value_view_t {});
@@ -519,30 +1147,114 @@ void read_many( //
     bool watch = !(c_options & ustore_option_transaction_dont_watch_k);
     std::vector<rocks_collection_t*> cols(places.count);
     std::vector<rocksdb::Slice> keys(places.count);
-    std::vector<std::string> vals(places.count);
     for (std::size_t i = 0; i != places.size(); ++i) {
         place_t place = places[i];
         cols[i] = rocks_collection(db, place.collection);
         keys[i] = to_slice(place.key);
     }
 
+    auto export_values = [&](std::vector<rocks_status_t> const& statuses, auto const& vals) {
+        for (std::size_t i = 0; i != places.size(); ++i) {
+            if (!statuses[i].IsNotFound()) {
+                if (export_error(statuses[i], c_error))
+                    return;
+                auto begin = reinterpret_cast<ustore_bytes_cptr_t>(vals[i].data());
+                auto length = static_cast<ustore_length_t>(vals[i].size());
+                enumerator(i, unstamp(db, places[i].collection, value_view_t {begin, length}));
+            }
+            else
+                enumerator(i, value_view_t {});
+        }
+    };
+
+    // Outside of transactions we use the batched interface, which groups keys
+    // by collections and data-blocks, and pins the values in the block cache
+    // or memtables, instead of copying them into `std::string`s
+    if (!txn_ptr) {
+        std::vector<rocks_value_t> vals(places.count);
+        std::vector<rocks_status_t> statuses(places.count);
+        db.native->MultiGet(options, places.count, cols.data(), keys.data(), vals.data(), statuses.data());
+        export_values(statuses, vals);
+        return;
+    }
+
+    std::vector<std::string> vals(places.count);
     std::vector<rocks_status_t> statuses = //
-        txn_ptr                            //
-            ? watch                        //
-                  ? txn_ptr->MultiGetForUpdate(options, cols, keys, &vals)
-                  : txn_ptr->MultiGet(options, cols, keys, &vals)
-            : db.native->MultiGet(options, cols, keys, &vals);
+        watch                              //
+            ? txn_ptr->MultiGetForUpdate(options, cols, keys, &vals)
+            : txn_ptr->MultiGet(options, cols, keys, &vals);
+    export_values(statuses, vals);
+}
+
+/**
+ * @brief Serves reads outside of transactions and snapshots, from the value caches,
+ * pulling only the missing entries from RocksDB and admitting them into the caches.
+ * Values are exported in the requested order, as the offsets must be monotonic.
+ */
+template <typename value_enumerator_at>
+void read_through_caches( //
+    rocks_db_t& db,
+    places_arg_t places,
+    ustore_options_t const c_options,
+    value_enumerator_at enumerator,
+    ustore_error_t* c_error) noexcept(false) {
+
+    struct found_t {
+        std::size_t offset = 0;
+        ustore_length_t length = ustore_length_missing_k;
+    };
+
+    struct missed_t {
+        std::size_t task = 0;
+        value_cache_t* cache = nullptr;
+        value_cache_t::generation_t generation = 0;
+    };
+
+    std::string tape;
+    std::vector<found_t> found(places.size());
+    std::vector<missed_t> missed;
+    std::vector<ustore_collection_t> missed_collections;
+    std::vector<ustore_key_t> missed_keys;
+    auto append = [&](std::size_t task, value_view_t value) {
+        found[task] = {tape.size(), value ? static_cast<ustore_length_t>(value.size()) : ustore_length_missing_k};
+        if (value.size())
+            tape.append(value.c_str(), value.size());
+    };
+
     for (std::size_t i = 0; i != places.size(); ++i) {
-        if (!statuses[i].IsNotFound()) {
-            if (export_error(statuses[i], c_error))
-                return;
-            auto begin = reinterpret_cast<ustore_bytes_cptr_t>(vals[i].data());
-            auto length = static_cast<ustore_length_t>(vals[i].size());
-            enumerator(i, value_view_t {begin, length});
-        }
-        else
-            enumerator(i, value_view_t {});
+        place_t place = places[i];
+        value_cache_t* cache = value_cache(db, place.collection);
+        value_cache_t::generation_t generation = 0;
+        if (cache && cache->find(place.key, [&](value_view_t value) { append(i, value); }, generation))
+            continue;
+        missed.push_back({i, cache, generation});
+        missed_collections.push_back(place.collection);
+        missed_keys.push_back(place.key);
+    }
+
+    if (!missed.empty()) {
+        strided_iterator_gt<ustore_collection_t const> collections {missed_collections.data(),
+                                                                    sizeof(ustore_collection_t)};
+        strided_iterator_gt<ustore_key_t const> keys {missed_keys.data(), sizeof(ustore_key_t)};
+        places_arg_t missed_places {collections, keys, {}, missed.size()};
+        auto fetched_enumerator = [&](std::size_t i, value_view_t value) {
+            missed_t const& miss = missed[i];
+            append(miss.task, value);
+            if (miss.cache)
+                miss.cache->insert(missed_keys[i], value, miss.generation);
+        };
+        missed.size() == 1 //
+            ? read_one(db, nullptr, nullptr, missed_places, c_options, fetched_enumerator, c_error)
+            : read_many(db, nullptr, nullptr, missed_places, c_options, fetched_enumerator, c_error);
+        return_if_error_m(c_error);
     }
+
+    for (std::size_t i = 0; i != places.size(); ++i)
+        enumerator(i,
+                   found[i].length == ustore_length_missing_k
+                       ? value_view_t {}
+                       : value_view_t {reinterpret_cast<ustore_bytes_cptr_t>(tape.data()) + found[i].offset,
+                                       found[i].length});
 }
 
 void ustore_read(ustore_read_t* c_ptr) {
@@ -557,6 +1269,7 @@ void ustore_read(ustore_read_t* c_ptr) {
     return_if_error_m(c.error);
 
     rocks_db_t& db = *reinterpret_cast<rocks_db_t*>(c.db);
+    stats_timer_t timer {db.stats, stats_op_t::read_k, c.tasks_count, c.error};
     rocks_txn_t& txn = *reinterpret_cast<rocks_txn_t*>(c.transaction);
     rocks_snapshot_t& snap = *reinterpret_cast<rocks_snapshot_t*>(c.snapshot);
 
@@ -586,10 +1299,14 @@ void ustore_read(ustore_read_t* c_ptr) {
         }
     };
 
+    bool const cached = !c.transaction && !c.snapshot && !db.value_caches.empty();
     safe_section("Reading from RocksDB", c.error, [&] {
-        c.tasks_count == 1 //
-            ? read_one(db, &txn, &snap, places, c.options, data_enumerator, c.error)
-            : read_many(db, &txn, &snap, places, c.options, data_enumerator, c.error);
+        if (cached)
+            read_through_caches(db, places, c.options, data_enumerator, c.error);
+        else if (c.tasks_count == 1)
+            read_one(db, &txn, &snap, places, c.options, data_enumerator, c.error);
+        else
+            read_many(db, &txn, &snap, places, c.options, data_enumerator, c.error);
         offs[places.count] = contents.size();
 
         if (needs_export)
@@ -606,12 +1323,14 @@ void ustore_scan(ustore_scan_t* c_ptr) {
     return_if_error_m(c.error);
 
     rocks_db_t& db = *reinterpret_cast<rocks_db_t*>(c.db);
+    stats_timer_t timer {db.stats, stats_op_t::scan_k, c.tasks_count, c.error};
     rocks_txn_t& txn = *reinterpret_cast<rocks_txn_t*>(c.transaction);
     rocks_snapshot_t& snap = *reinterpret_cast<rocks_snapshot_t*>(c.snapshot);
     strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
     strided_iterator_gt<ustore_key_t const> start_keys {c.start_keys, c.start_keys_stride};
     strided_iterator_gt<ustore_length_t const> limits {c.count_limits, c.count_limits_stride};
-    scans_arg_t tasks {collections, start_keys, limits, c.tasks_count};
+    strided_iterator_gt<ustore_key_t const> end_keys {c.end_keys, c.end_keys_stride};
+    scans_arg_t tasks {collections, start_keys, limits, c.tasks_count, end_keys};
 
     validate_scan(c.transaction, tasks, c.options, c.error);
     return_if_error_m(c.error);
@@ -626,40 +1345,110 @@ void ustore_scan(ustore_scan_t* c_ptr) {
     auto keys_output = *c.keys = arena.alloc<ustore_key_t>(total_keys, c.error).begin();
     return_if_error_m(c.error);
 
+    growing_tape_t values(arena);
+    bool const needs_values = c.values || c.values_offsets;
+    if (needs_values) {
+        values.reserve(total_keys, c.error);
+        return_if_error_m(c.error);
+    }
+
     // 2. Fetch the data
-    rocksdb::ReadOptions options;
+    rocksdb::ReadOptions options = scan_options(db);
     options.fill_cache = false;
+    if (c.options & ustore_option_scan_sequential_k)
+        options.readahead_size = scan_readahead_k;
 
     if (c.snapshot)
         options.snapshot = snap.snapshot;
 
+    // Bounded iterators don't step into the following data blocks
+    // and don't have to skip the tombstones past the end of the range
+    auto bound = [](rocksdb::ReadOptions& task_options, rocksdb::Slice& upper_bound, scan_t const& task) {
+        if (task.end_key == std::numeric_limits<ustore_key_t>::max())
+            return;
+        upper_bound = to_slice(task.end_key);
+        task_options.iterate_upper_bound = &upper_bound;
+    };
+
+    // Expired values, that weren't compacted yet, are skipped without counting towards the limits
+    expiration_time_t const now = db.ttls.empty() ? 0 : expiration_now();
+    auto is_expired_at = [&](rocksdb::Iterator& it) noexcept {
+        return is_expired(deadline_of(to_view(it.value())), now);
+    };
+
+    // Independent shards are scanned in parallel, each with its own iterator
+    if ((c.options & ustore_option_scan_bulk_k) && !c.transaction && !needs_values && tasks.count > 1) {
+        auto scan_one = [&](std::size_t task_idx, ustore_key_t* shard_keys, ustore_error_t*) {
+            scan_t task = tasks[task_idx];
+            rocksdb::ReadOptions task_options = options;
+            rocksdb::Slice upper_bound;
+            bound(task_options, upper_bound, task);
+
+            auto collection = rocks_collection(db, task.collection);
+            auto it = std::unique_ptr<rocksdb::Iterator>(db.native->NewIterator(task_options, collection));
+            bool const expiring = expires(db, task.collection);
+            ustore_length_t j = 0;
+            it->Seek(to_slice(task.min_key));
+            for (; it->Valid() && j != task.limit; it->Next()) {
+                if (expiring && is_expired_at(*it))
+                    continue;
+                std::memcpy(shard_keys + j, it->key().data(), sizeof(ustore_key_t));
+                ++j;
+            }
+            return j;
+        };
+        return scan_in_parallel(tasks, offsets, counts, *c.keys, c.error, scan_one);
+    }
+
     for (ustore_size_t i = 0; i != c.tasks_count; ++i) {
         scan_t task = tasks[i];
         auto collection = rocks_collection(db, task.collection);
+        rocksdb::ReadOptions task_options = options;
+        rocksdb::Slice upper_bound;
+        bound(task_options, upper_bound, task);
 
         std::unique_ptr<rocksdb::Iterator> it;
         safe_section("Creating a RocksDB iterator", c.error, [&] {
             it = c.transaction //
-                     ? std::unique_ptr<rocksdb::Iterator>(txn.GetIterator(options, collection))
-                     : std::unique_ptr<rocksdb::Iterator>(db.native->NewIterator(options, collection));
+                     ? std::unique_ptr<rocksdb::Iterator>(txn.GetIterator(task_options, collection))
+                     : std::unique_ptr<rocksdb::Iterator>(db.native->NewIterator(task_options, collection));
         });
         return_if_error_m(c.error);
 
         offsets[i] = keys_output - *c.keys;
 
+        bool const expiring = expires(db, task.collection);
         ustore_size_t j = 0;
         it->Seek(to_slice(task.min_key));
         while (it->Valid() && j != task.limit) {
+            if (expiring && is_expired_at(*it)) {
+                it->Next();
+                continue;
+            }
             std::memcpy(keys_output, it->key().data(), sizeof(ustore_key_t));
+            if (needs_values) {
+                value_view_t value = to_view(it->value());
+                values.push_back(expiring ? strip_deadline(value) : value, c.error);
+                return_if_error_m(c.error);
+            }
             ++keys_output;
             ++j;
             it->Next();
         }
+        return_error_if_m(it->status().ok(), c.error, error_unknown_k, "Failed to iterate through RocksDB");
 
         counts[i] = j;
     }
 
     offsets[tasks.size()] = keys_output - *c.keys;
+
+    // 3. Export the values
+    if (c.values_offsets) {
+        *c.values_offsets = values.arrow_offsets(c.error);
+        return_if_error_m(c.error);
+    }
+    if (c.values)
+        *c.values = reinterpret_cast<ustore_bytes_ptr_t>(values.contents().begin().get());
 }
 
 void ustore_sample(ustore_sample_t* c_ptr) {
@@ -673,6 +1462,7 @@ void ustore_sample(ustore_sample_t* c_ptr) {
     return_if_error_m(c.error);
 
     rocks_db_t& db = *reinterpret_cast<rocks_db_t*>(c.db);
+    stats_timer_t timer {db.stats, stats_op_t::sample_k, c.tasks_count, c.error};
     rocks_txn_t& txn = *reinterpret_cast<rocks_txn_t*>(c.transaction);
     rocks_snapshot_t& snap = *reinterpret_cast<rocks_snapshot_t*>(c.snapshot);
     strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
@@ -690,7 +1480,7 @@ void ustore_sample(ustore_sample_t* c_ptr) {
     return_if_error_m(c.error);
 
     // 2. Fetch the data
-    rocksdb::ReadOptions options;
+    rocksdb::ReadOptions options = scan_options(db);
     options.fill_cache = false;
 
     if (c.snapshot)
@@ -739,6 +1529,8 @@ void ustore_measure(ustore_measure_t* c_ptr) {
     strided_iterator_gt<ustore_key_t const> start_keys {c.start_keys, c.start_keys_stride};
     strided_iterator_gt<ustore_key_t const> end_keys {c.end_keys, c.end_keys_stride};
     rocksdb::SizeApproximationOptions options;
+    // Recent writes are yet to be flushed, but the planner needs to see them too
+    options.include_memtables = true;
 
     rocksdb::Range range;
     uint64_t approximate_size = 0;
@@ -769,6 +1561,62 @@ void ustore_measure(ustore_measure_t* c_ptr) {
     }
 }
 
+void ustore_erase_range(ustore_erase_range_t* c_ptr) {
+
+    ustore_erase_range_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    if (!c.tasks_count)
+        return;
+    return_error_if_m(c.start_keys && c.end_keys, c.error, args_wrong_k, "Ranges must have both ends");
+
+    rocks_db_t& db = *reinterpret_cast<rocks_db_t*>(c.db);
+    stats_timer_t timer {db.stats, stats_op_t::write_k, c.tasks_count, c.error};
+    strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
+    strided_iterator_gt<ustore_key_t const> start_keys {c.start_keys, c.start_keys_stride};
+    strided_iterator_gt<ustore_key_t const> end_keys {c.end_keys, c.end_keys_stride};
+
+    bool const safe = c.options & ustore_option_write_flush_k;
+    rocksdb::WriteOptions options;
+    options.sync = safe;
+    options.disableWAL = !safe && !db.change_feed;
+
+    safe_section("Erasing ranges from RocksDB", c.error, [&] {
+        rocksdb::WriteBatch batch;
+        for (std::size_t i = 0; i != c.tasks_count && !*c.error; ++i) {
+            ustore_collection_t collection_id = collections ? collections[i] : ustore_collection_main_k;
+            ustore_key_t const start_key = start_keys[i];
+            ustore_key_t const end_key = end_keys[i];
+            if (start_key >= end_key)
+                continue;
+
+            // Range tombstones don't name the keys, so the change-feed needs point deletions
+            auto collection = rocks_collection(db, collection_id);
+            if (!db.change_feed) {
+                export_error(batch.DeleteRange(collection, to_slice(start_key), to_slice(end_key)), c.error);
+                continue;
+            }
+
+            rocksdb::ReadOptions read_options = scan_options(db);
+            read_options.fill_cache = false;
+            rocksdb::Slice upper_bound = to_slice(end_key);
+            read_options.iterate_upper_bound = &upper_bound;
+            auto it = std::unique_ptr<rocksdb::Iterator>(db.native->NewIterator(read_options, collection));
+            for (it->Seek(to_slice(start_key)); it->Valid() && !*c.error; it->Next())
+                export_error(batch.Delete(collection, it->key()), c.error);
+            return_error_if_m(it->status().ok(), c.error, error_unknown_k, "Failed to iterate through RocksDB");
+        }
+        return_if_error_m(c.error);
+
+        rocks_status_t status = db.native->Write(options, &batch);
+        export_error(status, c.error);
+    });
+
+    // Failed erasures are invalidated as well, which is always safe
+    for (std::size_t i = 0; i != c.tasks_count; ++i)
+        if (value_cache_t* cache = value_cache(db, collections ? collections[i] : ustore_collection_main_k))
+            cache->clear();
+}
+
 void ustore_collection_create(ustore_collection_create_t* c_ptr) {
 
     ustore_collection_create_t& c = *c_ptr;
@@ -784,13 +1632,20 @@ void ustore_collection_create(ustore_collection_create_t* c_ptr) {
     }
 
     rocks_collection_t* collection = nullptr;
-    auto cf_options = rocksdb::ColumnFamilyOptions();
-    cf_options.comparator = &key_comparator_k;
+    auto cf_options = db.cf_options;
+    cf_options.cf_paths = collection_paths(db, c.name);
+    if (expiration_time_t ttl = db.expiration_config.ttl_for(c.name); ttl)
+        configure_expiration(cf_options, ttl);
     rocks_status_t status = db.native->CreateColumnFamily(std::move(cf_options), c.name, &collection);
-    if (!export_error(status, c.error)) {
-        db.columns.push_back(collection);
-        *c.id = reinterpret_cast<ustore_collection_t>(collection);
-    }
+    if (export_error(status, c.error))
+        return;
+
+    db.columns.push_back(collection);
+    *c.id = reinterpret_cast<ustore_collection_t>(collection);
+    if (db.expiration_config.enabled())
+        safe_section("Assigning lifetime", c.error, [&] { add_expiration(db, collection); });
+    if (db.value_cache_config.enabled())
+        safe_section("Allocating value cache", c.error, [&] { add_value_cache(db, collection); });
 }
 
 void ustore_collection_drop(ustore_collection_drop_t* c_ptr) {
@@ -828,6 +1683,8 @@ void ustore_collection_drop(ustore_collection_drop_t* c_ptr) {
                 if (export_error(status, c.error))
                     return;
                 db.columns.erase(it);
+                db.value_caches.erase(c.id);
+                db.ttls.erase(c.id);
                 break;
             }
         }
@@ -836,22 +1693,28 @@ void ustore_collection_drop(ustore_collection_drop_t* c_ptr) {
     else if (c.mode == ustore_drop_keys_vals_k) {
         rocksdb::WriteBatch batch;
         auto it =
-            std::unique_ptr<rocksdb::Iterator>(db.native->NewIterator(rocksdb::ReadOptions(), collection_ptr_to_clear));
+            std::unique_ptr<rocksdb::Iterator>(db.native->NewIterator(scan_options(db), collection_ptr_to_clear));
         for (it->SeekToFirst(); it->Valid(); it->Next())
             batch.Delete(collection_ptr_to_clear, it->key());
         rocks_status_t status = db.native->Write(options, &batch);
         export_error(status, c.error);
+        if (value_cache_t* cache = value_cache(db, c.id))
+            cache->clear();
         return;
     }
 
     else if (c.mode == ustore_drop_vals_k) {
         rocksdb::WriteBatch batch;
         auto it =
-            std::unique_ptr<rocksdb::Iterator>(db.native->NewIterator(rocksdb::ReadOptions(), collection_ptr_to_clear));
+            std::unique_ptr<rocksdb::Iterator>(db.native->NewIterator(scan_options(db), collection_ptr_to_clear));
+        std::string stamped;
+        value_view_t empty = stamp(db, c.id, value_view_t::make_empty(), stamped);
         for (it->SeekToFirst(); it->Valid(); it->Next())
-            batch.Put(collection_ptr_to_clear, it->key(), rocksdb::Slice());
+            batch.Put(collection_ptr_to_clear, it->key(), to_slice(empty));
         rocks_status_t status = db.native->Write(options, &batch);
         export_error(status, c.error);
+        if (value_cache_t* cache = value_cache(db, c.id))
+            cache->clear();
         return;
     }
 }
@@ -903,8 +1766,59 @@ void ustore_collection_list(ustore_collection_list_t* c_ptr) {
 void ustore_database_control(ustore_database_control_t* c_ptr) {
 
     ustore_database_control_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    return_error_if_m(c.request, c.error, uninitialized_state_k, "Request is uninitialized");
+
     *c.response = NULL;
-    *c.error = "Controls aren't supported in this implementation!";
+    stats_request_t request;
+    return_error_if_m(parse_stats_request(c.request, request), c.error, args_wrong_k, "Unknown control request!");
+
+    rocks_db_t& db = *reinterpret_cast<rocks_db_t*>(c.db);
+    std::string response;
+    safe_section("Collecting statistics", c.error, [&] {
+        json_t js = json_t::object();
+        if (request.memory) {
+            // RocksDB doesn't track exact counts, so these are estimates
+            auto property = [&](rocks_collection_t* column, std::string const& name) {
+                std::uint64_t value = 0;
+                if (column)
+                    db.native->GetIntProperty(column, name, &value);
+                else
+                    db.native->GetIntProperty(name, &value);
+                return value;
+            };
+
+            json_t collections = json_t::object();
+            for (rocks_collection_t* column : db.columns) {
+                std::string name = column->GetName() == rocksdb::kDefaultColumnFamilyName ? "" : column->GetName();
+                collections[name] = {
+                    {"keys", property(column, "rocksdb.estimate-num-keys")},
+                    {"bytes", property(column, "rocksdb.estimate-live-data-size")},
+                    {"memtables_bytes", property(column, "rocksdb.cur-size-all-mem-tables")},
+                };
+                if (value_cache_t* cache = value_cache(db, collection_id(column)))
+                    collections[name]["value_cache"] = cache->stats().json();
+            }
+
+            json_t& memory = js["memory"];
+            memory["collections"] = std::move(collections);
+            memory["block_cache_bytes"] = property(nullptr, "rocksdb.block-cache-usage");
+            memory["table_readers_bytes"] = property(nullptr, "rocksdb.estimate-table-readers-mem");
+            if (db.block_cache) {
+                memory["block_cache_capacity"] = db.block_cache->GetCapacity();
+                memory["block_cache_pinned_bytes"] = db.block_cache->GetPinnedUsage();
+            }
+            memory["arena_bytes"] = linked_memory_t::reserved_bytes.load();
+            memory["arena_pooled_bytes"] = linked_memory_t::pooled_bytes.load();
+        }
+        if (request.ops)
+            js["ops"] = db.stats.ops_json();
+        if (request.latency)
+            js["latency"] = db.stats.latency_json();
+        response = js.dump();
+    });
+    return_if_error_m(c.error);
+    export_control_response(response, c.arena, c.response, c.error);
 }
 
 void ustore_transaction_init(ustore_transaction_init_t* c_ptr) {
@@ -921,7 +1835,7 @@ void ustore_transaction_init(ustore_transaction_init_t* c_ptr) {
     txn_options.set_snapshot = false;
     rocksdb::WriteOptions options;
     options.sync = safe;
-    options.disableWAL = !safe;
+    options.disableWAL = !safe && !db.change_feed;
     auto new_txn = db.native->BeginTransaction(options, txn_options, &txn);
     if (!new_txn)
         *c.error = "Couldn't start a transaction!";
@@ -929,6 +1843,15 @@ void ustore_transaction_init(ustore_transaction_init_t* c_ptr) {
         *c.transaction = new_txn;
 }
 
+/**
+ * Optimistic transactions only validate their keys during the commit itself,
+ * and `rocksdb::Transaction::Prepare()` is only implemented for the pessimistic ones.
+ */
+void ustore_transaction_stage(ustore_transaction_stage_t* c_ptr) {
+    ustore_transaction_stage_t& c = *c_ptr;
+    *c.error = "Optimistic RocksDB transactions can't be staged!";
+}
+
 void ustore_transaction_commit(ustore_transaction_commit_t* c_ptr) {
     ustore_transaction_commit_t& c = *c_ptr;
     if (!c.transaction)
@@ -938,8 +1861,24 @@ void ustore_transaction_commit(ustore_transaction_commit_t* c_ptr) {
     return_if_error_m(c.error);
 
     rocks_db_t& db = *reinterpret_cast<rocks_db_t*>(c.db);
+    stats_timer_t timer {db.stats, stats_op_t::commit_k, 1, c.error};
     rocks_txn_t& txn = *reinterpret_cast<rocks_txn_t*>(c.transaction);
 
+    // The write batch is reset on commit, so the updated keys are collected beforehand
+    std::optional<updated_keys_t> updated;
+    if (!db.value_caches.empty()) {
+        safe_section("Collecting updated keys", c.error, [&] {
+            std::unordered_map<std::uint32_t, ustore_collection_t> ids;
+            for (rocks_collection_t* column : db.columns)
+                if (value_cache(db, collection_id(column)))
+                    ids.emplace(column->GetID(), collection_id(column));
+            updated.emplace(std::move(ids));
+            rocks_status_t status = txn.GetWriteBatch()->GetWriteBatch()->Iterate(&*updated);
+            export_error(status, c.error);
+        });
+        return_if_error_m(c.error);
+    }
+
     if (c.sequence_number)
         db.mutex.lock();
     rocks_status_t status = txn.Commit();
@@ -949,12 +1888,100 @@ void ustore_transaction_commit(ustore_transaction_commit_t* c_ptr) {
             *c.sequence_number = db.native->GetLatestSequenceNumber();
         db.mutex.unlock();
     }
+
+    if (!updated || !status.ok())
+        return;
+    for (collection_key_t const& updated_key : updated->keys)
+        if (value_cache_t* cache = value_cache(db, updated_key.collection))
+            cache->invalidate(updated_key.key);
+    for (ustore_collection_t collection : updated->cleared)
+        if (value_cache_t* cache = value_cache(db, collection))
+            cache->clear();
+}
+
+void ustore_changes_subscribe(ustore_changes_subscribe_t* c_ptr) {
+
+    ustore_changes_subscribe_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    return_error_if_m(c.cursor, c.error, args_wrong_k, "No cursor output");
+
+    rocks_db_t& db = *reinterpret_cast<rocks_db_t*>(c.db);
+    return_error_if_m(db.change_feed, c.error, args_combo_k, "Change feed isn't enabled");
+    safe_section("Subscribing to changes", c.error, [&] {
+        auto cursor = std::make_unique<rocks_changes_t>();
+        cursor->next = c.since + 1;
+
+        // Check, that the following change is still retained
+        if (c.since && cursor->next <= db.native->GetLatestSequenceNumber()) {
+            std::unique_ptr<rocksdb::TransactionLogIterator> it;
+            rocks_status_t status = db.native->GetUpdatesSince(cursor->next, &it);
+            if (export_error(status, c.error))
+                return;
+            return_error_if_m(it->Valid() && it->GetBatch().sequence <= cursor->next,
+                              c.error,
+                              args_wrong_k,
+                              "Requested changes are no longer retained");
+        }
+        *c.cursor = cursor.release();
+    });
+}
+
+void ustore_changes_poll(ustore_changes_poll_t* c_ptr) {
+
+    ustore_changes_poll_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    return_error_if_m(c.cursor, c.error, uninitialized_state_k, "Cursor is uninitialized");
+
+    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
+    return_if_error_m(c.error);
+
+    rocks_db_t& db = *reinterpret_cast<rocks_db_t*>(c.db);
+    return_error_if_m(db.change_feed, c.error, args_combo_k, "Change feed isn't enabled");
+    rocks_changes_t& cursor = *reinterpret_cast<rocks_changes_t*>(c.cursor);
+    safe_section("Polling changes", c.error, [&] {
+        changes_batch_t batch;
+        rocksdb::SequenceNumber next = std::max<rocksdb::SequenceNumber>(cursor.next, 1);
+        if (next <= db.native->GetLatestSequenceNumber()) {
+            std::unordered_map<std::uint32_t, rocks_collection_t*> columns;
+            for (rocks_collection_t* column : db.columns)
+                columns.emplace(column->GetID(), column);
+
+            std::unique_ptr<rocksdb::TransactionLogIterator> it;
+            rocks_status_t status = db.native->GetUpdatesSince(next, &it);
+            if (export_error(status, c.error))
+                return;
+
+            std::size_t limit = c.count_limit ? c.count_limit : changes_count_default_k;
+            changes_exporter_t exporter {db, columns, batch, limit, next};
+            for (; it->Valid() && batch.size() < limit; it->Next()) {
+                rocksdb::BatchResult result = it->GetBatch();
+                exporter.sequence = result.sequence;
+                status = result.writeBatchPtr->Iterate(&exporter);
+                if (export_error(status, c.error))
+                    return;
+            }
+            next = exporter.next;
+        }
+
+        // The cursor only advances, if the changes were exported
+        export_changes(batch, arena, c);
+        return_if_error_m(c.error);
+        cursor.next = next;
+    });
+}
+
+void ustore_changes_free(ustore_changes_t c_cursor) {
+    delete reinterpret_cast<rocks_changes_t*>(c_cursor);
 }
 
 void ustore_arena_free(ustore_arena_t c_arena) {
     clear_linked_memory(c_arena);
 }
 
+void ustore_arena_reset(ustore_arena_t c_arena) {
+    reset_linked_memory(c_arena);
+}
+
 void ustore_transaction_free(ustore_transaction_t c_transaction) {
     if (!c_transaction)
         return;
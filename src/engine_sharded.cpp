@@ -0,0 +1,1556 @@
+/**
+ * @file engine_sharded.cpp
+ * @author Ashot Vardanian
+ *
+ * @brief Meta-engine, partitioning the keys across a few instances of another engine.
+ * The child engine is linked through `helpers/sharded_child.hpp`, so any of the
+ * embedded engines can be sharded, and the modalities work on top, unchanged.
+ *
+ * Keys of all collections are spread by hash or by ranges, configured with:
+ * - "shards": Number of child instances, stored in "shard_0", "shard_1"... subdirectories.
+ * - "partitioning": Either "hash" or "range".
+ * - "boundaries": First keys of every shard, but the first, for "range" partitioning.
+ *   Either JSON integers or decimal strings, as JSON can't hold the 128-bit keys of UUID builds.
+ * The rest of the engine config is forwarded to the children.
+ *
+ * Batched requests are split per shard and dispatched concurrently. Every shard
+ * exports into its own temporary arena, that are merged into the caller's one.
+ * Scans run on every shard and the sorted outputs are merged, like in a merge-sort.
+ *
+ * Transactions have a child transaction in every shard. Commits, that have touched many
+ * shards, first stage all of them with `ustore_transaction_stage()`, which detects the
+ * conflicts and keeps the keys locked, and only then commit them. If a child engine
+ * can't stage, such commits are refused, instead of being partially applied.
+ * Reads of different shards aren't isolated from each other, and snapshots of different
+ * shards may be taken at slightly different times, so `ustore_supports_transactions_k`
+ * is never reported in the metadata.
+ */
+
+#include <mutex>         // `std::unique_lock`
+#include <shared_mutex>  // `std::shared_lock`
+#include <thread>        // `std::thread::hardware_concurrency`
+#include <random>        // `std::mt19937`
+#include <string>        // `std::string`
+#include <vector>        // `std::vector`
+#include <cstring>       // `std::memcpy`
+#include <numeric>       // `std::iota`
+#include <algorithm>     // `std::upper_bound`
+#include <filesystem>    // `std::filesystem::create_directories`
+#include <unordered_map> // `std::unordered_map`
+
+#include <nlohmann/json.hpp> // `nlohmann::json`
+
+#include "ustore/db.h"
+#include "ustore/cpp/ranges_args.hpp" // `places_arg_t`
+#include "helpers/sharded_child.hpp"  // `ustore_shard_read`
+#include "helpers/linked_memory.hpp"  // `linked_memory_lock_t`
+#include "helpers/config_loader.hpp"  // `config_loader_t`
+#include "helpers/parallel.hpp"       // `thread_pool_t`
+#include "helpers/mutex.hpp"          // `shared_mutex_t`
+#include "helpers/stats.hpp"          // `engine_stats_t`
+
+using namespace unum::ustore;
+using namespace unum;
+
+namespace stdfs = std::filesystem;
+using json_t = nlohmann::json;
+
+/*********************************************************/
+/*****************   Structures & Consts  ****************/
+/*********************************************************/
+
+// The constants, like `ustore_collection_main_k`, are defined by the child engine
+
+static constexpr std::size_t default_shards_k = 4;
+
+enum class partitioning_t {
+    hash_k,
+    range_k,
+};
+
+struct sharded_snapshot_t {
+    std::vector<ustore_snapshot_t> children;
+};
+
+struct sharded_txn_t {
+    std::vector<ustore_transaction_t> children;
+    /// @brief Shards, that were accessed since the start, as only those need to be committed.
+    std::vector<char> touched;
+    /// @brief Set, once the children of all the touched shards are staged.
+    bool staged = false;
+    /// @brief Set, if staging has failed and reset some of the children, until the next reset.
+    bool aborted = false;
+};
+
+struct sharded_db_t {
+    std::vector<ustore_database_t> shards;
+    partitioning_t partitioning = partitioning_t::hash_k;
+    /// @brief Sorted first keys of every shard, but the first one, for `partitioning_t::range_k`.
+    std::vector<ustore_key_t> boundaries;
+
+    /// @brief Every named collection may have a different ID in every shard.
+    /// The meta-engine reuses the IDs of the first shard.
+    std::unordered_map<std::string, ustore_collection_t> names;
+    std::unordered_map<ustore_collection_t, std::vector<ustore_collection_t>> collections;
+    shared_mutex_t restructuring_mutex;
+
+    std::unordered_map<ustore_snapshot_t, std::unique_ptr<sharded_snapshot_t>> snapshots;
+    std::mutex snapshots_mutex;
+
+    std::unique_ptr<thread_pool_t> pool;
+    engine_stats_t stats;
+
+    sharded_db_t() = default;
+    sharded_db_t(sharded_db_t const&) = delete;
+    sharded_db_t& operator=(sharded_db_t const&) = delete;
+
+    ~sharded_db_t() noexcept {
+        for (ustore_database_t shard : shards)
+            ustore_shard_database_free(shard);
+    }
+
+    std::size_t shard_of(ustore_key_t key) const noexcept {
+        if (partitioning == partitioning_t::range_k)
+            return std::upper_bound(boundaries.begin(), boundaries.end(), key) - boundaries.begin();
+
+        // The finalizer of SplitMix64, so that the neighboring keys land in different shards.
+        // The key is folded with `key_hash_t` first, so both halves of 128-bit keys matter.
+        auto mixed = static_cast<std::uint64_t>(key_hash_t {}(key));
+        mixed = (mixed ^ (mixed >> 30)) * 0xbf58476d1ce4e5b9ull;
+        mixed = (mixed ^ (mixed >> 27)) * 0x94d049bb133111ebull;
+        mixed = mixed ^ (mixed >> 31);
+        return mixed % shards.size();
+    }
+
+    /**
+     * @brief Translates the collection ID for a specific shard.
+     * Expects the `restructuring_mutex` to be locked by the caller.
+     */
+    ustore_collection_t child_collection(ustore_collection_t collection, std::size_t shard) const noexcept {
+        if (collection == ustore_collection_main_k)
+            return collection;
+        auto it = collections.find(collection);
+        return it != collections.end() ? it->second[shard] : collection;
+    }
+};
+
+/*********************************************************/
+/*****************	 C++ Implementation	  ****************/
+/*********************************************************/
+
+/**
+ * @brief Parses a range boundary, which is either a JSON integer, or a decimal string,
+ * as JSON numbers can't hold the 128-bit keys of `USTORE_USE_UUID` builds.
+ */
+bool parse_boundary(json_t const& js, ustore_key_t& key) noexcept {
+    if (js.is_number_integer()) {
+        key = static_cast<ustore_key_t>(js.get<std::int64_t>());
+        return true;
+    }
+    if (!js.is_string())
+        return false;
+
+    std::string const& str = js.get_ref<std::string const&>();
+    bool const negative = !str.empty() && str.front() == '-';
+    if (str.size() == std::size_t(negative))
+        return false;
+
+    // The magnitude of the smallest key is one larger, than the one of the largest
+    ustore_unsigned_key_t const limit = ustore_unsigned_key_t(1) << (sizeof(ustore_key_t) * 8 - 1);
+    ustore_unsigned_key_t magnitude = 0;
+    for (auto it = str.begin() + negative; it != str.end(); ++it) {
+        if (*it < '0' || *it > '9')
+            return false;
+        unsigned const digit = static_cast<unsigned>(*it - '0');
+        if (magnitude > (limit - digit) / 10)
+            return false;
+        magnitude = magnitude * 10 + digit;
+    }
+    if (!negative && magnitude == limit)
+        return false;
+    key = static_cast<ustore_key_t>(negative ? ~magnitude + 1 : magnitude);
+    return true;
+}
+
+/**
+ * @brief Resolves the transaction and the snapshot handles for every shard.
+ */
+struct shard_context_t {
+    sharded_txn_t* txn = nullptr;
+    sharded_snapshot_t const* snapshot = nullptr;
+
+    ustore_transaction_t transaction_in(std::size_t shard) const noexcept {
+        if (!txn)
+            return nullptr;
+        txn->touched[shard] = 1;
+        return txn->children[shard];
+    }
+
+    ustore_snapshot_t snapshot_in(std::size_t shard) const noexcept { return snapshot ? snapshot->children[shard] : 0; }
+};
+
+shard_context_t shard_context(sharded_db_t& db,
+                              ustore_transaction_t c_txn,
+                              ustore_snapshot_t c_snapshot,
+                              ustore_error_t* c_error) noexcept {
+    shard_context_t context;
+    context.txn = reinterpret_cast<sharded_txn_t*>(c_txn);
+    if (!c_snapshot)
+        return context;
+
+    std::lock_guard<std::mutex> lock {db.snapshots_mutex};
+    auto it = db.snapshots.find(c_snapshot);
+    if (it != db.snapshots.end())
+        context.snapshot = it->second.get();
+    else
+        *c_error = "The snapshot doesn't exist!";
+    return context;
+}
+
+/**
+ * @brief The arenas and the errors of child calls, issued by a single API call.
+ * The arenas are released together, once the results are merged.
+ */
+struct shard_calls_t {
+    std::vector<ustore_arena_t> arenas;
+    std::vector<ustore_error_t> errors;
+
+    shard_calls_t() = default;
+    shard_calls_t(shard_calls_t const&) = delete;
+    shard_calls_t& operator=(shard_calls_t const&) = delete;
+
+    ~shard_calls_t() noexcept {
+        for (ustore_arena_t arena : arenas)
+            ustore_shard_arena_free(arena);
+    }
+
+    void resize(std::size_t shards) noexcept(false) {
+        arenas.resize(shards, nullptr);
+        errors.resize(shards, nullptr);
+    }
+
+    void export_error(ustore_error_t* c_error) const noexcept {
+        for (ustore_error_t error : errors)
+            if (error) {
+                *c_error = error;
+                return;
+            }
+    }
+};
+
+/**
+ * @brief Every shard exports into its own fresh arena, so the caller's
+ * arena-related options only apply to the merged outputs.
+ */
+inline ustore_options_t child_options(ustore_options_t options) noexcept {
+    auto arena_options = ustore_option_dont_discard_memory_k | ustore_option_read_shared_memory_k | arena_options_k;
+    return ustore_options_t(options & ~arena_options);
+}
+
+struct shard_places_t {
+    std::vector<ustore_collection_t> collections;
+    std::vector<ustore_key_t> keys;
+};
+
+/**
+ * @brief The tasks of a batch, grouped by shard.
+ */
+struct partitioned_places_t {
+    std::vector<shard_places_t> shards;
+    /// @brief For every task: the shard and the index of the task in that shard.
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> origins;
+    /// @brief Shards, that received at least one task.
+    std::vector<std::size_t> active;
+};
+
+void partition(sharded_db_t& db, places_arg_t places, partitioned_places_t& parts) noexcept(false) {
+    parts.shards.resize(db.shards.size());
+    parts.origins.resize(places.size());
+
+    std::shared_lock<shared_mutex_t> lock {db.restructuring_mutex};
+    places.visit([&](auto const& places) {
+        for (std::size_t task_idx = 0; task_idx != places.size(); ++task_idx) {
+            place_t place = places[task_idx];
+            std::size_t shard = db.shard_of(place.key);
+            shard_places_t& part = parts.shards[shard];
+            parts.origins[task_idx] = {static_cast<std::uint32_t>(shard), static_cast<std::uint32_t>(part.keys.size())};
+            part.collections.push_back(db.child_collection(place.collection, shard));
+            part.keys.push_back(place.key);
+        }
+    });
+
+    for (std::size_t shard = 0; shard != parts.shards.size(); ++shard)
+        if (!parts.shards[shard].keys.empty())
+            parts.active.push_back(shard);
+}
+
+/**
+ * @brief Translates the collections of a batch, that has to be sent
+ * to every shard, like a scan or a sample.
+ */
+void translate_collections(sharded_db_t& db,
+                           strided_iterator_gt<ustore_collection_t const> collections,
+                           std::size_t count,
+                           std::vector<std::vector<ustore_collection_t>>& translated) noexcept(false) {
+    translated.resize(db.shards.size());
+    std::shared_lock<shared_mutex_t> lock {db.restructuring_mutex};
+    for (std::size_t shard = 0; shard != db.shards.size(); ++shard) {
+        translated[shard].resize(count);
+        for (std::size_t task_idx = 0; task_idx != count; ++task_idx) {
+            auto collection = collections ? collections[task_idx] : ustore_collection_main_k;
+            translated[shard][task_idx] = db.child_collection(collection, shard);
+        }
+    }
+}
+
+/**
+ * @brief Calls @p callback for every shard in @p active on the pool of the DB.
+ * The @p callback must not throw.
+ */
+template <typename callback_at>
+void for_each_shard(sharded_db_t& db, std::vector<std::size_t> const& active, callback_at&& callback) noexcept {
+    db.pool->for_each(active.size(), [&](std::size_t active_idx) noexcept { callback(active[active_idx]); });
+}
+
+inline std::vector<std::size_t> all_shards(sharded_db_t const& db) noexcept(false) {
+    std::vector<std::size_t> shards(db.shards.size());
+    std::iota(shards.begin(), shards.end(), 0);
+    return shards;
+}
+
+inline ustore_size_t add_saturated(ustore_size_t a, ustore_size_t b) noexcept {
+    return a > std::numeric_limits<ustore_size_t>::max() - b ? std::numeric_limits<ustore_size_t>::max() : a + b;
+}
+
+/**
+ * @brief Sums the numeric members of the statistics, reported by different shards.
+ */
+void accumulate_json(json_t& into, json_t const& from) noexcept(false) {
+    if (from.is_object()) {
+        for (auto const& [key, value] : from.items())
+            accumulate_json(into[key], value);
+    }
+    else if (into.is_null())
+        into = from;
+    else if (into.is_number_unsigned() && from.is_number_unsigned())
+        into = into.get<std::uint64_t>() + from.get<std::uint64_t>();
+    else if (into.is_number() && from.is_number())
+        into = into.get<double>() + from.get<double>();
+}
+
+/**
+ * @brief Matches the named collections of all shards by name.
+ * Collections, that are missing in some of the shards, are created there.
+ */
+void sync_collections(sharded_db_t& db, ustore_error_t* c_error) noexcept(false) {
+
+    std::unordered_map<std::string, std::vector<ustore_collection_t>> found;
+    for (std::size_t shard = 0; shard != db.shards.size(); ++shard) {
+        ustore_arena_t c_arena = nullptr;
+        ustore_size_t count = 0;
+        ustore_collection_t* ids = nullptr;
+        ustore_length_t* offsets = nullptr;
+        ustore_char_t* names = nullptr;
+
+        ustore_collection_list_t list {};
+        list.db = db.shards[shard];
+        list.error = c_error;
+        list.arena = &c_arena;
+        list.count = &count;
+        list.ids = &ids;
+        list.offsets = &offsets;
+        list.names = &names;
+        ustore_shard_collection_list(&list);
+        if (!*c_error)
+            for (std::size_t i = 0; i != count; ++i) {
+                auto& ids_in_shards = found[names + offsets[i]];
+                ids_in_shards.resize(db.shards.size(), ustore_collection_main_k);
+                ids_in_shards[shard] = ids[i];
+            }
+        ustore_shard_arena_free(c_arena);
+        return_if_error_m(c_error);
+    }
+
+    for (auto& [name, ids_in_shards] : found) {
+        for (std::size_t shard = 0; shard != db.shards.size(); ++shard) {
+            if (ids_in_shards[shard] != ustore_collection_main_k)
+                continue;
+            ustore_collection_create_t create {};
+            create.db = db.shards[shard];
+            create.error = c_error;
+            create.name = name.c_str();
+            create.id = &ids_in_shards[shard];
+            ustore_shard_collection_create(&create);
+            return_if_error_m(c_error);
+        }
+        db.names.emplace(name, ids_in_shards[0]);
+        db.collections.emplace(ids_in_shards[0], std::move(ids_in_shards));
+    }
+}
+
+/*********************************************************/
+/*****************	    C Interface 	  ****************/
+/*********************************************************/
+
+void ustore_database_init(ustore_database_init_t* c_ptr) {
+
+    ustore_database_init_t& c = *c_ptr;
+    safe_section("Initializing DBMS", c.error, [&] {
+        auto db_ptr = std::make_unique<sharded_db_t>();
+        std::size_t shards_count = default_shards_k;
+        std::vector<std::string> child_configs;
+
+        if (c.config && std::strlen(c.config) > 0) {
+            config_t config;
+            auto status = config_loader_t::load_from_json_string(c.config, config);
+            return_error_if_m(status, c.error, args_wrong_k, status.message());
+
+            json_t engine = config.engine.config.is_object() ? config.engine.config : json_t::object();
+            shards_count = engine.value("shards", shards_count);
+            return_error_if_m(shards_count, c.error, args_wrong_k, "Need at least one shard");
+
+            std::string partitioning = engine.value("partitioning", std::string("hash"));
+            return_error_if_m(partitioning == "hash" || partitioning == "range",
+                              c.error,
+                              args_wrong_k,
+                              "Partitioning must be \"hash\" or \"range\"");
+            if (partitioning == "range") {
+                db_ptr->partitioning = partitioning_t::range_k;
+                json_t boundaries = engine.value("boundaries", json_t::array());
+                return_error_if_m(boundaries.is_array(), c.error, args_wrong_k, "Boundaries must be an array");
+                for (json_t const& boundary : boundaries) {
+                    ustore_key_t key = 0;
+                    return_error_if_m(parse_boundary(boundary, key),
+                                      c.error,
+                                      args_wrong_k,
+                                      "Boundaries must be integers or decimal strings");
+                    db_ptr->boundaries.push_back(key);
+                }
+                return_error_if_m(db_ptr->boundaries.size() + 1 == shards_count,
+                                  c.error,
+                                  args_wrong_k,
+                                  "Range partitioning needs a boundary for every shard, but the first");
+                return_error_if_m(std::is_sorted(db_ptr->boundaries.begin(), db_ptr->boundaries.end()),
+                                  c.error,
+                                  args_wrong_k,
+                                  "Boundaries must be sorted");
+            }
+            engine.erase("shards");
+            engine.erase("partitioning");
+            engine.erase("boundaries");
+
+            // Every shard lives in its own subdirectories of the configured ones
+            for (std::size_t shard = 0; shard != shards_count; ++shard) {
+                std::string subdirectory = "shard_" + std::to_string(shard);
+                config_t child = config;
+                child.engine.config = engine;
+                if (!config.directory.empty()) {
+                    child.directory = (stdfs::path(config.directory) / subdirectory).string();
+                    stdfs::create_directories(child.directory);
+                }
+                for (auto& disk : child.data_directories) {
+                    disk.path = (stdfs::path(disk.path) / subdirectory).string();
+                    stdfs::create_directories(disk.path);
+                }
+                std::string child_config;
+                status = config_loader_t::save_to_json_string(child, child_config);
+                return_error_if_m(status, c.error, args_wrong_k, status.message());
+                child_configs.push_back(std::move(child_config));
+            }
+        }
+        else
+            child_configs.resize(shards_count);
+
+        db_ptr->shards.resize(shards_count, nullptr);
+        for (std::size_t shard = 0; shard != shards_count; ++shard) {
+            ustore_database_init_t init {};
+            init.config = child_configs[shard].c_str();
+            init.db = &db_ptr->shards[shard];
+            init.error = c.error;
+            ustore_shard_database_init(&init);
+            return_if_error_m(c.error);
+        }
+
+        std::size_t threads_count = std::min<std::size_t>(shards_count, std::thread::hardware_concurrency());
+        db_ptr->pool = std::make_unique<thread_pool_t>(threads_count);
+
+        ustore_metadata_t metadata {};
+        ustore_get_metadata_t get_metadata {};
+        get_metadata.db = db_ptr->shards[0];
+        get_metadata.error = c.error;
+        get_metadata.metadata = &metadata;
+        ustore_shard_get_metadata(&get_metadata);
+        return_if_error_m(c.error);
+        if (metadata & ustore_supports_named_collections_k) {
+            sync_collections(*db_ptr, c.error);
+            return_if_error_m(c.error);
+        }
+
+        *c.db = db_ptr.release();
+    });
+}
+
+void ustore_get_metadata(ustore_get_metadata_t* c_ptr) {
+    ustore_get_metadata_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    sharded_db_t& db = *reinterpret_cast<sharded_db_t*>(c.db);
+
+    ustore_get_metadata_t get_metadata = c;
+    get_metadata.db = db.shards[0];
+    ustore_shard_get_metadata(&get_metadata);
+    return_if_error_m(c.error);
+
+    // Commits are atomic within a shard, but not across them
+    *c.metadata = ustore_metadata_t(*c.metadata & ~ustore_supports_transactions_k);
+}
+
+void ustore_snapshot_list(ustore_snapshot_list_t* c_ptr) {
+
+    ustore_snapshot_list_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    return_error_if_m(c.count && c.ids, c.error, args_combo_k, "Need outputs!");
+
+    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
+    return_if_error_m(c.error);
+
+    sharded_db_t& db = *reinterpret_cast<sharded_db_t*>(c.db);
+    std::lock_guard<std::mutex> lock {db.snapshots_mutex};
+    std::size_t snapshots_count = db.snapshots.size();
+    *c.count = static_cast<ustore_size_t>(snapshots_count);
+
+    auto ids = arena.alloc_or_dummy(snapshots_count, c.error, c.ids);
+    return_if_error_m(c.error);
+
+    std::size_t i = 0;
+    for (auto const& [id, _] : db.snapshots)
+        ids[i++] = id;
+}
+
+void ustore_snapshot_create(ustore_snapshot_create_t* c_ptr) {
+
+    ustore_snapshot_create_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    sharded_db_t& db = *reinterpret_cast<sharded_db_t*>(c.db);
+
+    std::unique_ptr<sharded_snapshot_t> snapshot;
+    safe_section("Allocating snapshot handle", c.error, [&] {
+        snapshot = std::make_unique<sharded_snapshot_t>();
+        snapshot->children.resize(db.shards.size(), 0);
+    });
+    return_if_error_m(c.error);
+
+    for (std::size_t shard = 0; shard != db.shards.size() && !*c.error; ++shard) {
+        ustore_snapshot_create_t create {};
+        create.db = db.shards[shard];
+        create.error = c.error;
+        create.id = &snapshot->children[shard];
+        ustore_shard_snapshot_create(&create);
+    }
+
+    // Roll back the snapshots of the other shards
+    if (*c.error) {
+        for (std::size_t shard = 0; shard != db.shards.size(); ++shard) {
+            if (!snapshot->children[shard])
+                continue;
+            ustore_error_t drop_error = nullptr;
+            ustore_snapshot_drop_t drop {};
+            drop.db = db.shards[shard];
+            drop.error = &drop_error;
+            drop.id = snapshot->children[shard];
+            ustore_shard_snapshot_drop(&drop);
+        }
+        return;
+    }
+
+    auto id = reinterpret_cast<ustore_snapshot_t>(snapshot.get());
+    std::lock_guard<std::mutex> lock {db.snapshots_mutex};
+    safe_section("Registering snapshot", c.error, [&] { db.snapshots.emplace(id, std::move(snapshot)); });
+    return_if_error_m(c.error);
+    *c.id = id;
+}
+
+void ustore_snapshot_export(ustore_snapshot_export_t* c_ptr) {
+
+    ustore_snapshot_export_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    return_error_if_m(c.path, c.error, args_wrong_k, "Need a path to export into");
+    sharded_db_t& db = *reinterpret_cast<sharded_db_t*>(c.db);
+
+    shard_context_t context = shard_context(db, nullptr, c.id, c.error);
+    return_if_error_m(c.error);
+
+    for (std::size_t shard = 0; shard != db.shards.size(); ++shard) {
+        std::string path;
+        safe_section("Preparing shard directory", c.error, [&] {
+            stdfs::path shard_path = stdfs::path(c.path) / ("shard_" + std::to_string(shard));
+            stdfs::create_directories(shard_path);
+            path = shard_path.string();
+        });
+        return_if_error_m(c.error);
+
+        ustore_snapshot_export_t export_ {};
+        export_.db = db.shards[shard];
+        export_.error = c.error;
+        export_.id = context.snapshot_in(shard);
+        export_.path = path.c_str();
+        ustore_shard_snapshot_export(&export_);
+        return_if_error_m(c.error);
+    }
+}
+
+void ustore_snapshot_drop(ustore_snapshot_drop_t* c_ptr) {
+
+    ustore_snapshot_drop_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    sharded_db_t& db = *reinterpret_cast<sharded_db_t*>(c.db);
+
+    std::unique_ptr<sharded_snapshot_t> snapshot;
+    {
+        std::lock_guard<std::mutex> lock {db.snapshots_mutex};
+        auto it = db.snapshots.find(c.id);
+        return_error_if_m(it != db.snapshots.end(), c.error, args_wrong_k, "The snapshot doesn't exist!");
+        snapshot = std::move(it->second);
+        db.snapshots.erase(it);
+    }
+
+    for (std::size_t shard = 0; shard != db.shards.size(); ++shard) {
+        ustore_snapshot_drop_t drop {};
+        drop.db = db.shards[shard];
+        drop.error = c.error;
+        drop.id = snapshot->children[shard];
+        ustore_shard_snapshot_drop(&drop);
+    }
+}
+
+void ustore_read(ustore_read_t* c_ptr) {
+
+    ustore_read_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    if (!c.tasks_count)
+        return;
+
+    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
+    return_if_error_m(c.error);
+
+    sharded_db_t& db = *reinterpret_cast<sharded_db_t*>(c.db);
+    stats_timer_t timer {db.stats, stats_op_t::read_k, c.tasks_count, c.error};
+    strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
+    strided_iterator_gt<ustore_key_t const> keys {c.keys, c.keys_stride};
+    places_arg_t places {collections, keys, {}, c.tasks_count};
+    validate_read(c.transaction, places, c.options, c.error);
+    return_if_error_m(c.error);
+
+    shard_context_t context = shard_context(db, c.transaction, c.snapshot, c.error);
+    return_if_error_m(c.error);
+
+    struct shard_read_t {
+        ustore_length_t* offsets = nullptr;
+        ustore_length_t* lengths = nullptr;
+        ustore_byte_t* values = nullptr;
+    };
+
+    // 1. Group the tasks by shard
+    partitioned_places_t parts;
+    std::vector<shard_read_t> results;
+    shard_calls_t calls;
+    safe_section("Partitioning tasks", c.error, [&] {
+        partition(db, places, parts);
+        results.resize(db.shards.size());
+        calls.resize(db.shards.size());
+    });
+    return_if_error_m(c.error);
+
+    // 2. Read from all the shards concurrently
+    bool const needs_values = c.values != nullptr;
+    for_each_shard(db, parts.active, [&](std::size_t shard) noexcept {
+        shard_places_t& part = parts.shards[shard];
+        shard_read_t& result = results[shard];
+        ustore_read_t read {};
+        read.db = db.shards[shard];
+        read.error = &calls.errors[shard];
+        read.transaction = context.transaction_in(shard);
+        read.snapshot = context.snapshot_in(shard);
+        read.arena = &calls.arenas[shard];
+        read.options = child_options(c.options);
+        read.tasks_count = part.keys.size();
+        read.collections = part.collections.data();
+        read.collections_stride = sizeof(ustore_collection_t);
+        read.keys = part.keys.data();
+        read.keys_stride = sizeof(ustore_key_t);
+        read.lengths = &result.lengths;
+        read.offsets = needs_values ? &result.offsets : nullptr;
+        read.values = needs_values ? &result.values : nullptr;
+        ustore_shard_read(&read);
+    });
+    calls.export_error(c.error);
+    return_if_error_m(c.error);
+
+    // 3. Stitch the results into the caller's arena in the original order
+    auto presences = arena.alloc_or_dummy(places.count, c.error, c.presences);
+    return_if_error_m(c.error);
+    auto offs = arena.alloc_or_dummy(places.count + 1, c.error, c.offsets);
+    return_if_error_m(c.error);
+    auto lens = arena.alloc_or_dummy(places.count, c.error, c.lengths);
+    return_if_error_m(c.error);
+
+    std::size_t total_bytes = 0;
+    for (auto [shard, idx_in_shard] : parts.origins)
+        if (ustore_length_t length = results[shard].lengths[idx_in_shard]; length != ustore_length_missing_k)
+            total_bytes += length;
+    ptr_range_gt<byte_t> contents;
+    if (needs_values) {
+        contents = arena.alloc<byte_t>(std::max<std::size_t>(total_bytes, 1), c.error);
+        return_if_error_m(c.error);
+        *c.values = reinterpret_cast<ustore_bytes_ptr_t>(contents.begin());
+    }
+
+    ustore_length_t progress = 0;
+    for (std::size_t task_idx = 0; task_idx != places.count; ++task_idx) {
+        auto [shard, idx_in_shard] = parts.origins[task_idx];
+        shard_read_t const& result = results[shard];
+        ustore_length_t length = result.lengths[idx_in_shard];
+        bool present = length != ustore_length_missing_k;
+        presences[task_idx] = present;
+        lens[task_idx] = length;
+        offs[task_idx] = progress;
+        if (!present)
+            continue;
+        if (needs_values)
+            std::memcpy(contents.begin() + progress, result.values + result.offsets[idx_in_shard], length);
+        progress += length;
+    }
+    offs[places.count] = progress;
+}
+
+void ustore_write(ustore_write_t* c_ptr) {
+
+    ustore_write_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    if (!c.tasks_count)
+        return;
+
+    sharded_db_t& db = *reinterpret_cast<sharded_db_t*>(c.db);
+    stats_timer_t timer {db.stats, stats_op_t::write_k, c.tasks_count, c.error};
+    strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
+    strided_iterator_gt<ustore_key_t const> keys {c.keys, c.keys_stride};
+    strided_iterator_gt<ustore_bytes_cptr_t const> vals {c.values, c.values_stride};
+    strided_iterator_gt<ustore_length_t const> offs {c.offsets, c.offsets_stride};
+    strided_iterator_gt<ustore_length_t const> lens {c.lengths, c.lengths_stride};
+    bits_view_t presences {c.presences};
+
+    places_arg_t places {collections, keys, {}, c.tasks_count};
+    contents_arg_t contents {presences, offs, lens, vals, c.tasks_count};
+    validate_write(c.transaction, places, contents, c.options, c.error);
+    return_if_error_m(c.error);
+
+    shard_context_t context = shard_context(db, c.transaction, 0, c.error);
+    return_if_error_m(c.error);
+
+    struct shard_contents_t {
+        std::vector<ustore_bytes_cptr_t> values;
+        std::vector<ustore_length_t> lengths;
+    };
+
+    // 1. Group the tasks by shard, preserving their order within every shard.
+    // Empty values must have a non-NULL address, or they would be treated as deletions.
+    static ustore_byte_t const empty_value_k = 0;
+    partitioned_places_t parts;
+    std::vector<shard_contents_t> parts_contents;
+    shard_calls_t calls;
+    safe_section("Partitioning tasks", c.error, [&] {
+        partition(db, places, parts);
+        parts_contents.resize(db.shards.size());
+        calls.resize(db.shards.size());
+        for (std::size_t task_idx = 0; task_idx != places.count; ++task_idx) {
+            value_view_t value = contents[task_idx];
+            shard_contents_t& part = parts_contents[parts.origins[task_idx].first];
+            auto begin = value ? reinterpret_cast<ustore_bytes_cptr_t>(value.begin()) : nullptr;
+            part.values.push_back(value && !begin ? &empty_value_k : begin);
+            part.lengths.push_back(value ? static_cast<ustore_length_t>(value.size()) : ustore_length_missing_k);
+        }
+    });
+    return_if_error_m(c.error);
+
+    // 2. Write into all the shards concurrently
+    for_each_shard(db, parts.active, [&](std::size_t shard) noexcept {
+        shard_places_t& part = parts.shards[shard];
+        shard_contents_t& part_contents = parts_contents[shard];
+        ustore_write_t write {};
+        write.db = db.shards[shard];
+        write.error = &calls.errors[shard];
+        write.transaction = context.transaction_in(shard);
+        write.arena = &calls.arenas[shard];
+        write.options = child_options(c.options);
+        write.tasks_count = part.keys.size();
+        write.collections = part.collections.data();
+        write.collections_stride = sizeof(ustore_collection_t);
+        write.keys = part.keys.data();
+        write.keys_stride = sizeof(ustore_key_t);
+        write.lengths = part_contents.lengths.data();
+        write.lengths_stride = sizeof(ustore_length_t);
+        write.values = part_contents.values.data();
+        write.values_stride = sizeof(ustore_bytes_cptr_t);
+        ustore_shard_write(&write);
+    });
+    calls.export_error(c.error);
+}
+
+void ustore_scan(ustore_scan_t* c_ptr) {
+
+    ustore_scan_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    if (!c.tasks_count)
+        return;
+
+    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
+    return_if_error_m(c.error);
+
+    sharded_db_t& db = *reinterpret_cast<sharded_db_t*>(c.db);
+    stats_timer_t timer {db.stats, stats_op_t::scan_k, c.tasks_count, c.error};
+    strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
+    strided_iterator_gt<ustore_key_t const> start_keys {c.start_keys, c.start_keys_stride};
+    strided_iterator_gt<ustore_length_t const> lens {c.count_limits, c.count_limits_stride};
+    strided_iterator_gt<ustore_key_t const> end_keys {c.end_keys, c.end_keys_stride};
+    scans_arg_t scans {collections, start_keys, lens, c.tasks_count, end_keys};
+
+    validate_scan(c.transaction, scans, c.options, c.error);
+    return_if_error_m(c.error);
+
+    shard_context_t context = shard_context(db, c.transaction, c.snapshot, c.error);
+    return_if_error_m(c.error);
+
+    struct shard_scan_t {
+        ustore_length_t* offsets = nullptr;
+        ustore_length_t* counts = nullptr;
+        ustore_key_t* keys = nullptr;
+        ustore_length_t* values_offsets = nullptr;
+        ustore_byte_t* values = nullptr;
+    };
+
+    // 1. Every shard receives all the tasks, as any of them may hold the matching keys
+    std::vector<std::vector<ustore_collection_t>> translated;
+    std::vector<ustore_key_t> mins, ends;
+    std::vector<ustore_length_t> limits;
+    std::vector<shard_scan_t> results;
+    std::vector<std::size_t> active;
+    shard_calls_t calls;
+    safe_section("Preparing scans", c.error, [&] {
+        translate_collections(db, collections, scans.count, translated);
+        mins.resize(scans.count);
+        ends.resize(scans.count);
+        limits.resize(scans.count);
+        for (std::size_t task_idx = 0; task_idx != scans.count; ++task_idx) {
+            scan_t scan = scans[task_idx];
+            mins[task_idx] = scan.min_key;
+            ends[task_idx] = scan.end_key;
+            limits[task_idx] = scan.limit;
+        }
+        results.resize(db.shards.size());
+        active = all_shards(db);
+        calls.resize(db.shards.size());
+    });
+    return_if_error_m(c.error);
+
+    // 2. Scan all the shards concurrently
+    bool const needs_values = c.values || c.values_offsets;
+    for_each_shard(db, active, [&](std::size_t shard) noexcept {
+        shard_scan_t& result = results[shard];
+        ustore_scan_t scan {};
+        scan.db = db.shards[shard];
+        scan.error = &calls.errors[shard];
+        scan.transaction = context.transaction_in(shard);
+        scan.snapshot = context.snapshot_in(shard);
+        scan.arena = &calls.arenas[shard];
+        scan.options = child_options(c.options);
+        scan.tasks_count = scans.count;
+        scan.collections = translated[shard].data();
+        scan.collections_stride = sizeof(ustore_collection_t);
+        scan.start_keys = mins.data();
+        scan.start_keys_stride = sizeof(ustore_key_t);
+        scan.end_keys = ends.data();
+        scan.end_keys_stride = sizeof(ustore_key_t);
+        scan.count_limits = limits.data();
+        scan.count_limits_stride = sizeof(ustore_length_t);
+        scan.offsets = &result.offsets;
+        scan.counts = &result.counts;
+        scan.keys = &result.keys;
+        scan.values_offsets = needs_values ? &result.values_offsets : nullptr;
+        scan.values = needs_values ? &result.values : nullptr;
+        ustore_shard_scan(&scan);
+    });
+    calls.export_error(c.error);
+    return_if_error_m(c.error);
+
+    // 3. Merge the sorted outputs of different shards
+    auto offsets = arena.alloc_or_dummy(scans.count + 1, c.error, c.offsets);
+    return_if_error_m(c.error);
+    auto counts = arena.alloc_or_dummy(scans.count, c.error, c.counts);
+    return_if_error_m(c.error);
+
+    auto total_keys = reduce_n(scans.limits, scans.count, 0ul);
+    auto keys_output = *c.keys = arena.alloc<ustore_key_t>(total_keys, c.error).begin();
+    return_if_error_m(c.error);
+
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> picked;
+    std::vector<std::size_t> cursors, cursors_ends;
+    safe_section("Merging scans", c.error, [&] {
+        cursors.resize(db.shards.size());
+        cursors_ends.resize(db.shards.size());
+        if (needs_values)
+            picked.reserve(total_keys);
+
+        std::size_t exported = 0;
+        for (std::size_t task_idx = 0; task_idx != scans.count; ++task_idx) {
+            offsets[task_idx] = static_cast<ustore_length_t>(exported);
+            for (std::size_t shard = 0; shard != db.shards.size(); ++shard) {
+                cursors[shard] = results[shard].offsets[task_idx];
+                cursors_ends[shard] = cursors[shard] + results[shard].counts[task_idx];
+            }
+
+            ustore_length_t found = 0;
+            for (; found != limits[task_idx]; ++found) {
+                std::size_t best = db.shards.size();
+                for (std::size_t shard = 0; shard != db.shards.size(); ++shard)
+                    if (cursors[shard] != cursors_ends[shard] &&
+                        (best == db.shards.size() ||
+                         results[shard].keys[cursors[shard]] < results[best].keys[cursors[best]]))
+                        best = shard;
+                if (best == db.shards.size())
+                    break;
+
+                keys_output[exported++] = results[best].keys[cursors[best]];
+                if (needs_values)
+                    picked.emplace_back(best, cursors[best]);
+                ++cursors[best];
+            }
+            counts[task_idx] = found;
+        }
+        offsets[scans.count] = static_cast<ustore_length_t>(exported);
+    });
+    return_if_error_m(c.error);
+
+    // 4. Export the values of the matched keys
+    if (!needs_values)
+        return;
+
+    std::size_t total_bytes = 0;
+    for (auto [shard, idx_in_shard] : picked)
+        total_bytes += results[shard].values_offsets[idx_in_shard + 1] - results[shard].values_offsets[idx_in_shard];
+
+    auto values_offsets = arena.alloc<ustore_length_t>(picked.size() + 1, c.error);
+    return_if_error_m(c.error);
+    auto contents = arena.alloc<byte_t>(std::max<std::size_t>(total_bytes, 1), c.error);
+    return_if_error_m(c.error);
+
+    ustore_length_t progress = 0;
+    for (std::size_t i = 0; i != picked.size(); ++i) {
+        auto [shard, idx_in_shard] = picked[i];
+        shard_scan_t const& result = results[shard];
+        ustore_length_t begin = result.values_offsets[idx_in_shard];
+        ustore_length_t length = result.values_offsets[idx_in_shard + 1] - begin;
+        std::memcpy(contents.begin() + progress, result.values + begin, length);
+        values_offsets[i] = progress;
+        progress += length;
+    }
+    values_offsets[picked.size()] = progress;
+
+    if (c.values_offsets)
+        *c.values_offsets = values_offsets.begin();
+    if (c.values)
+        *c.values = reinterpret_cast<ustore_bytes_ptr_t>(contents.begin());
+}
+
+void ustore_sample(ustore_sample_t* c_ptr) {
+
+    ustore_sample_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    if (!c.tasks_count)
+        return;
+
+    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
+    return_if_error_m(c.error);
+
+    sharded_db_t& db = *reinterpret_cast<sharded_db_t*>(c.db);
+    stats_timer_t timer {db.stats, stats_op_t::sample_k, c.tasks_count, c.error};
+    strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
+    strided_iterator_gt<ustore_length_t const> lens {c.count_limits, c.count_limits_stride};
+    sample_args_t samples {collections, lens, c.tasks_count};
+
+    shard_context_t context = shard_context(db, c.transaction, c.snapshot, c.error);
+    return_if_error_m(c.error);
+
+    struct shard_sample_t {
+        ustore_length_t* offsets = nullptr;
+        ustore_length_t* counts = nullptr;
+        ustore_key_t* keys = nullptr;
+    };
+
+    // 1. Sample every shard, as the shards are balanced, when partitioned by hash
+    std::vector<std::vector<ustore_collection_t>> translated;
+    std::vector<ustore_length_t> limits;
+    std::vector<shard_sample_t> results;
+    std::vector<std::size_t> active;
+    shard_calls_t calls;
+    safe_section("Preparing samples", c.error, [&] {
+        translate_collections(db, collections, samples.count, translated);
+        limits.resize(samples.count);
+        for (std::size_t task_idx = 0; task_idx != samples.count; ++task_idx)
+            limits[task_idx] = samples[task_idx].limit;
+        results.resize(db.shards.size());
+        active = all_shards(db);
+        calls.resize(db.shards.size());
+    });
+    return_if_error_m(c.error);
+
+    for_each_shard(db, active, [&](std::size_t shard) noexcept {
+        shard_sample_t& result = results[shard];
+        ustore_sample_t sample {};
+        sample.db = db.shards[shard];
+        sample.error = &calls.errors[shard];
+        sample.transaction = context.transaction_in(shard);
+        sample.snapshot = context.snapshot_in(shard);
+        sample.arena = &calls.arenas[shard];
+        sample.options = child_options(c.options);
+        sample.tasks_count = samples.count;
+        sample.collections = translated[shard].data();
+        sample.collections_stride = sizeof(ustore_collection_t);
+        sample.count_limits = limits.data();
+        sample.count_limits_stride = sizeof(ustore_length_t);
+        sample.offsets = &result.offsets;
+        sample.counts = &result.counts;
+        sample.keys = &result.keys;
+        ustore_shard_sample(&sample);
+    });
+    calls.export_error(c.error);
+    return_if_error_m(c.error);
+
+    // 2. Pick a uniform subset of the keys from all the shards
+    auto offsets = arena.alloc_or_dummy(samples.count + 1, c.error, c.offsets);
+    return_if_error_m(c.error);
+    auto counts = arena.alloc_or_dummy(samples.count, c.error, c.counts);
+    return_if_error_m(c.error);
+
+    auto total_keys = reduce_n(samples.limits, samples.count, 0ul);
+    auto keys_output = *c.keys = arena.alloc<ustore_key_t>(total_keys, c.error).begin();
+    return_if_error_m(c.error);
+
+    std::vector<ustore_key_t> candidates;
+    safe_section("Merging samples", c.error, [&] {
+        std::random_device random_device;
+        std::mt19937 random_generator(random_device());
+        std::size_t exported = 0;
+        for (std::size_t task_idx = 0; task_idx != samples.count; ++task_idx) {
+            candidates.clear();
+            for (shard_sample_t const& result : results) {
+                ustore_key_t const* begin = result.keys + result.offsets[task_idx];
+                candidates.insert(candidates.end(), begin, begin + result.counts[task_idx]);
+            }
+
+            // Partial Fisher-Yates shuffle
+            std::size_t count = std::min<std::size_t>(candidates.size(), limits[task_idx]);
+            for (std::size_t i = 0; i != count; ++i) {
+                std::uniform_int_distribution<std::size_t> distribution(i, candidates.size() - 1);
+                std::swap(candidates[i], candidates[distribution(random_generator)]);
+            }
+
+            offsets[task_idx] = static_cast<ustore_length_t>(exported);
+            counts[task_idx] = static_cast<ustore_length_t>(count);
+            std::copy_n(candidates.begin(), count, keys_output + exported);
+            exported += count;
+        }
+        offsets[samples.count] = static_cast<ustore_length_t>(exported);
+    });
+}
+
+void ustore_measure(ustore_measure_t* c_ptr) {
+
+    ustore_measure_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    if (!c.tasks_count)
+        return;
+
+    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
+    return_if_error_m(c.error);
+
+    auto min_cardinalities = arena.alloc_or_dummy(c.tasks_count, c.error, c.min_cardinalities);
+    auto max_cardinalities = arena.alloc_or_dummy(c.tasks_count, c.error, c.max_cardinalities);
+    auto min_value_bytes = arena.alloc_or_dummy(c.tasks_count, c.error, c.min_value_bytes);
+    auto max_value_bytes = arena.alloc_or_dummy(c.tasks_count, c.error, c.max_value_bytes);
+    auto min_space_usages = arena.alloc_or_dummy(c.tasks_count, c.error, c.min_space_usages);
+    auto max_space_usages = arena.alloc_or_dummy(c.tasks_count, c.error, c.max_space_usages);
+    return_if_error_m(c.error);
+
+    sharded_db_t& db = *reinterpret_cast<sharded_db_t*>(c.db);
+    strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
+
+    shard_context_t context = shard_context(db, c.transaction, c.snapshot, c.error);
+    return_if_error_m(c.error);
+
+    struct shard_measure_t {
+        ustore_size_t* min_cardinalities = nullptr;
+        ustore_size_t* max_cardinalities = nullptr;
+        ustore_size_t* min_value_bytes = nullptr;
+        ustore_size_t* max_value_bytes = nullptr;
+        ustore_size_t* min_space_usages = nullptr;
+        ustore_size_t* max_space_usages = nullptr;
+    };
+
+    std::vector<std::vector<ustore_collection_t>> translated;
+    std::vector<shard_measure_t> results;
+    std::vector<std::size_t> active;
+    shard_calls_t calls;
+    safe_section("Preparing measurements", c.error, [&] {
+        translate_collections(db, collections, c.tasks_count, translated);
+        results.resize(db.shards.size());
+        active = all_shards(db);
+        calls.resize(db.shards.size());
+    });
+    return_if_error_m(c.error);
+
+    for_each_shard(db, active, [&](std::size_t shard) noexcept {
+        shard_measure_t& result = results[shard];
+        ustore_measure_t measure = c;
+        measure.db = db.shards[shard];
+        measure.error = &calls.errors[shard];
+        measure.transaction = context.transaction_in(shard);
+        measure.snapshot = context.snapshot_in(shard);
+        measure.arena = &calls.arenas[shard];
+        measure.options = child_options(c.options);
+        measure.collections = translated[shard].data();
+        measure.collections_stride = sizeof(ustore_collection_t);
+        measure.min_cardinalities = &result.min_cardinalities;
+        measure.max_cardinalities = &result.max_cardinalities;
+        measure.min_value_bytes = &result.min_value_bytes;
+        measure.max_value_bytes = &result.max_value_bytes;
+        measure.min_space_usages = &result.min_space_usages;
+        measure.max_space_usages = &result.max_space_usages;
+        ustore_shard_measure(&measure);
+    });
+    calls.export_error(c.error);
+    return_if_error_m(c.error);
+
+    for (std::size_t task_idx = 0; task_idx != c.tasks_count; ++task_idx) {
+        ustore_size_t sums[6] = {0, 0, 0, 0, 0, 0};
+        for (shard_measure_t const& result : results) {
+            sums[0] = add_saturated(sums[0], result.min_cardinalities[task_idx]);
+            sums[1] = add_saturated(sums[1], result.max_cardinalities[task_idx]);
+            sums[2] = add_saturated(sums[2], result.min_value_bytes[task_idx]);
+            sums[3] = add_saturated(sums[3], result.max_value_bytes[task_idx]);
+            sums[4] = add_saturated(sums[4], result.min_space_usages[task_idx]);
+            sums[5] = add_saturated(sums[5], result.max_space_usages[task_idx]);
+        }
+        min_cardinalities[task_idx] = sums[0];
+        max_cardinalities[task_idx] = sums[1];
+        min_value_bytes[task_idx] = sums[2];
+        max_value_bytes[task_idx] = sums[3];
+        min_space_usages[task_idx] = sums[4];
+        max_space_usages[task_idx] = sums[5];
+    }
+}
+
+void ustore_erase_range(ustore_erase_range_t* c_ptr) {
+
+    ustore_erase_range_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    if (!c.tasks_count)
+        return;
+
+    sharded_db_t& db = *reinterpret_cast<sharded_db_t*>(c.db);
+    strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
+
+    // Any range may span all the shards, so every shard erases all of them
+    std::vector<std::vector<ustore_collection_t>> translated;
+    std::vector<std::size_t> active;
+    shard_calls_t calls;
+    safe_section("Preparing erasures", c.error, [&] {
+        translate_collections(db, collections, c.tasks_count, translated);
+        active = all_shards(db);
+        calls.resize(db.shards.size());
+    });
+    return_if_error_m(c.error);
+
+    for_each_shard(db, active, [&](std::size_t shard) noexcept {
+        ustore_erase_range_t erase = c;
+        erase.db = db.shards[shard];
+        erase.error = &calls.errors[shard];
+        erase.arena = &calls.arenas[shard];
+        erase.options = child_options(c.options);
+        erase.collections = translated[shard].data();
+        erase.collections_stride = sizeof(ustore_collection_t);
+        ustore_shard_erase_range(&erase);
+    });
+    calls.export_error(c.error);
+}
+
+/*********************************************************/
+/*****************	Collections Management	****************/
+/*********************************************************/
+
+void ustore_collection_create(ustore_collection_create_t* c_ptr) {
+
+    ustore_collection_create_t& c = *c_ptr;
+    auto name_len = c.name ? std::strlen(c.name) : 0;
+    return_error_if_m(name_len, c.error, args_wrong_k, "Default collection is always present");
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    sharded_db_t& db = *reinterpret_cast<sharded_db_t*>(c.db);
+
+    std::unique_lock<shared_mutex_t> lock {db.restructuring_mutex};
+    std::string collection_name {c.name, name_len};
+    return_error_if_m(db.names.find(collection_name) == db.names.end(),
+                      c.error,
+                      args_wrong_k,
+                      "Such collection already exists!");
+
+    std::vector<ustore_collection_t> ids;
+    safe_section("Allocating collection handles", c.error, [&] { ids.reserve(db.shards.size()); });
+    return_if_error_m(c.error);
+
+    for (std::size_t shard = 0; shard != db.shards.size() && !*c.error; ++shard) {
+        ustore_collection_t id = ustore_collection_main_k;
+        ustore_collection_create_t create = c;
+        create.db = db.shards[shard];
+        create.id = &id;
+        ustore_shard_collection_create(&create);
+        if (!*c.error)
+            ids.push_back(id);
+    }
+
+    // Roll back the collections in the other shards
+    if (*c.error) {
+        for (std::size_t shard = 0; shard != ids.size(); ++shard) {
+            ustore_error_t drop_error = nullptr;
+            ustore_collection_drop_t drop {};
+            drop.db = db.shards[shard];
+            drop.error = &drop_error;
+            drop.id = ids[shard];
+            drop.mode = ustore_drop_keys_vals_handle_k;
+            ustore_shard_collection_drop(&drop);
+        }
+        return;
+    }
+
+    ustore_collection_t id = ids[0];
+    safe_section("Inserting new collection", c.error, [&] {
+        db.names.emplace(collection_name, id);
+        db.collections.emplace(id, std::move(ids));
+    });
+    return_if_error_m(c.error);
+    *c.id = id;
+}
+
+void ustore_collection_drop(ustore_collection_drop_t* c_ptr) {
+
+    ustore_collection_drop_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+
+    bool invalidate = c.mode == ustore_drop_keys_vals_handle_k;
+    return_error_if_m(c.id != ustore_collection_main_k || !invalidate,
+                      c.error,
+                      args_combo_k,
+                      "Default collection can't be invalidated.");
+
+    sharded_db_t& db = *reinterpret_cast<sharded_db_t*>(c.db);
+    std::unique_lock<shared_mutex_t> lock {db.restructuring_mutex};
+    for (std::size_t shard = 0; shard != db.shards.size(); ++shard) {
+        ustore_collection_drop_t drop = c;
+        drop.db = db.shards[shard];
+        drop.id = db.child_collection(c.id, shard);
+        ustore_shard_collection_drop(&drop);
+        return_if_error_m(c.error);
+    }
+
+    if (!invalidate)
+        return;
+    db.collections.erase(c.id);
+    for (auto it = db.names.begin(); it != db.names.end(); ++it)
+        if (it->second == c.id) {
+            db.names.erase(it);
+            break;
+        }
+}
+
+void ustore_collection_list(ustore_collection_list_t* c_ptr) {
+
+    ustore_collection_list_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    return_error_if_m(c.count && c.names, c.error, args_combo_k, "Need names and outputs!");
+
+    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
+    return_if_error_m(c.error);
+
+    sharded_db_t& db = *reinterpret_cast<sharded_db_t*>(c.db);
+    std::shared_lock<shared_mutex_t> lock {db.restructuring_mutex};
+    std::size_t collections_count = db.names.size();
+    *c.count = static_cast<ustore_size_t>(collections_count);
+
+    // Every string will be null-terminated
+    std::size_t strings_length = 0;
+    for (auto const& name_and_handle : db.names)
+        strings_length += name_and_handle.first.size() + 1;
+    auto names = arena.alloc<char>(strings_length, c.error).begin();
+    *c.names = names;
+    return_if_error_m(c.error);
+
+    // For every collection we also need to export IDs and offsets
+    auto ids = arena.alloc_or_dummy(collections_count, c.error, c.ids);
+    return_if_error_m(c.error);
+    auto offs = arena.alloc_or_dummy(collections_count + 1, c.error, c.offsets);
+    return_if_error_m(c.error);
+
+    std::size_t i = 0;
+    for (auto const& name_and_handle : db.names) {
+        auto len = name_and_handle.first.size();
+        std::memcpy(names, name_and_handle.first.data(), len);
+        names[len] = '\0';
+        ids[i] = name_and_handle.second;
+        offs[i] = static_cast<ustore_length_t>(names - *c.names);
+        names += len + 1;
+        ++i;
+    }
+    offs[i] = static_cast<ustore_length_t>(names - *c.names);
+}
+
+void ustore_database_control(ustore_database_control_t* c_ptr) {
+
+    ustore_database_control_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    return_error_if_m(c.request, c.error, uninitialized_state_k, "Request is uninitialized");
+
+    *c.response = NULL;
+    stats_request_t request;
+    return_error_if_m(parse_stats_request(c.request, request), c.error, args_wrong_k, "Unknown control request!");
+
+    sharded_db_t& db = *reinterpret_cast<sharded_db_t*>(c.db);
+    std::string response;
+    safe_section("Collecting statistics", c.error, [&] {
+        json_t js = json_t::object();
+
+        // Memory usage is summed across shards, while the operations are counted here
+        if (request.memory) {
+            json_t& memory = js["memory"];
+            for (ustore_database_t shard : db.shards) {
+                ustore_arena_t c_arena = nullptr;
+                ustore_str_view_t shard_response = nullptr;
+                ustore_database_control_t control {};
+                control.db = shard;
+                control.arena = &c_arena;
+                control.error = c.error;
+                control.request = R"({"stats": ["memory"]})";
+                control.response = &shard_response;
+                ustore_shard_database_control(&control);
+                if (!*c.error)
+                    accumulate_json(memory, json_t::parse(shard_response)["memory"]);
+                ustore_shard_arena_free(c_arena);
+                return_if_error_m(c.error);
+            }
+        }
+        if (request.ops)
+            js["ops"] = db.stats.ops_json();
+        if (request.latency)
+            js["latency"] = db.stats.latency_json();
+        response = js.dump();
+    });
+    return_if_error_m(c.error);
+    export_control_response(response, c.arena, c.response, c.error);
+}
+
+/*********************************************************/
+/*****************		Transactions	  ****************/
+/*********************************************************/
+
+void ustore_transaction_init(ustore_transaction_init_t* c_ptr) {
+
+    ustore_transaction_init_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    validate_transaction_begin(c.transaction, c.options, c.error);
+    return_if_error_m(c.error);
+
+    sharded_db_t& db = *reinterpret_cast<sharded_db_t*>(c.db);
+    safe_section("Initializing transaction state", c.error, [&] {
+        if (*c.transaction)
+            return;
+
+        auto txn = std::make_unique<sharded_txn_t>();
+        txn->children.resize(db.shards.size(), nullptr);
+        txn->touched.resize(db.shards.size(), 0);
+        *c.transaction = txn.release();
+    });
+    return_if_error_m(c.error);
+
+    // Children are (re)started eagerly, so that all of them see the same moment
+    sharded_txn_t& txn = *reinterpret_cast<sharded_txn_t*>(*c.transaction);
+    std::fill(txn.touched.begin(), txn.touched.end(), 0);
+    txn.staged = false;
+    txn.aborted = false;
+    for (std::size_t shard = 0; shard != db.shards.size(); ++shard) {
+        ustore_transaction_init_t init = c;
+        init.db = db.shards[shard];
+        init.transaction = &txn.children[shard];
+        ustore_shard_transaction_init(&init);
+        return_if_error_m(c.error);
+    }
+}
+
+/**
+ * @brief Stages the children of all the touched shards, so that none of them can fail
+ * to commit because of a conflict. If any of them fails, the already staged ones are
+ * reset, and so must be the whole transaction, before it is used again.
+ */
+void stage_shards(sharded_db_t& db,
+                  sharded_txn_t& txn,
+                  ustore_options_t options,
+                  ustore_sequence_number_t* sequence_number,
+                  ustore_error_t* c_error) noexcept {
+
+    return_error_if_m(!txn.aborted, c_error, args_combo_k, "Transaction must be reset after a failed commit");
+    return_error_if_m(!txn.staged, c_error, args_combo_k, "Transaction is already staged");
+
+    std::size_t shard = 0;
+    ustore_sequence_number_t max_sequence_number = 0;
+    for (; shard != db.shards.size(); ++shard) {
+        if (!txn.touched[shard])
+            continue;
+
+        ustore_sequence_number_t shard_sequence_number = 0;
+        ustore_transaction_stage_t stage {};
+        stage.db = db.shards[shard];
+        stage.error = c_error;
+        stage.transaction = txn.children[shard];
+        stage.options = options;
+        stage.sequence_number = &shard_sequence_number;
+        ustore_shard_transaction_stage(&stage);
+        if (*c_error)
+            break;
+        max_sequence_number = std::max(max_sequence_number, shard_sequence_number);
+    }
+
+    if (!*c_error) {
+        txn.staged = true;
+        if (sequence_number)
+            *sequence_number = max_sequence_number;
+        return;
+    }
+
+    // Staged children keep their keys locked, until they are reset
+    for (std::size_t staged = 0; staged != shard; ++staged) {
+        if (!txn.touched[staged])
+            continue;
+        ustore_error_t reset_error = nullptr;
+        ustore_transaction_init_t init {};
+        init.db = db.shards[staged];
+        init.error = &reset_error;
+        init.transaction = &txn.children[staged];
+        ustore_shard_transaction_init(&init);
+    }
+    txn.aborted = true;
+}
+
+void ustore_transaction_stage(ustore_transaction_stage_t* c_ptr) {
+
+    ustore_transaction_stage_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    validate_transaction_commit(c.transaction, c.options, c.error);
+    return_if_error_m(c.error);
+
+    sharded_db_t& db = *reinterpret_cast<sharded_db_t*>(c.db);
+    sharded_txn_t& txn = *reinterpret_cast<sharded_txn_t*>(c.transaction);
+    stage_shards(db, txn, c.options, c.sequence_number, c.error);
+}
+
+void ustore_transaction_commit(ustore_transaction_commit_t* c_ptr) {
+
+    ustore_transaction_commit_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    sharded_db_t& db = *reinterpret_cast<sharded_db_t*>(c.db);
+    stats_timer_t timer {db.stats, stats_op_t::commit_k, 1, c.error};
+
+    validate_transaction_commit(c.transaction, c.options, c.error);
+    return_if_error_m(c.error);
+
+    // A single shard validates and applies its part atomically on its own
+    sharded_txn_t& txn = *reinterpret_cast<sharded_txn_t*>(c.transaction);
+    return_error_if_m(!txn.aborted, c.error, args_combo_k, "Transaction must be reset after a failed commit");
+    bool const many_shards = std::count(txn.touched.begin(), txn.touched.end(), 1) > 1;
+    if (many_shards && !txn.staged) {
+        stage_shards(db, txn, c.options, nullptr, c.error);
+        return_if_error_m(c.error);
+    }
+
+    // Once staged, the children can only fail to log the changes, so the remaining
+    // shards are still committed, and the first failure is reported
+    ustore_sequence_number_t sequence_number = 0;
+    for (std::size_t shard = 0; shard != db.shards.size(); ++shard) {
+        if (!txn.touched[shard])
+            continue;
+
+        ustore_error_t shard_error = nullptr;
+        ustore_sequence_number_t shard_sequence_number = 0;
+        ustore_transaction_commit_t commit = c;
+        commit.db = db.shards[shard];
+        commit.error = &shard_error;
+        commit.transaction = txn.children[shard];
+        commit.sequence_number = &shard_sequence_number;
+        ustore_shard_transaction_commit(&commit);
+        if (shard_error && !*c.error)
+            *c.error = shard_error;
+        sequence_number = std::max(sequence_number, shard_sequence_number);
+    }
+    txn.staged = false;
+
+    if (c.sequence_number)
+        *c.sequence_number = sequence_number;
+}
+
+/*********************************************************/
+/*****************	     Change Feed	  ****************/
+/*********************************************************/
+
+/**
+ * Every shard numbers its changes independently, so there is no single sequence,
+ * that consumers could resume from.
+ */
+void ustore_changes_subscribe(ustore_changes_subscribe_t* c_ptr) {
+    ustore_changes_subscribe_t& c = *c_ptr;
+    *c.error = "Change feeds aren't supported by the sharded engine!";
+}
+
+void ustore_changes_poll(ustore_changes_poll_t* c_ptr) {
+    ustore_changes_poll_t& c = *c_ptr;
+    *c.error = "Change feeds aren't supported by the sharded engine!";
+}
+
+void ustore_changes_free(ustore_changes_t) {
+}
+
+/*********************************************************/
+/*****************	  Memory Management   ****************/
+/*********************************************************/
+
+void ustore_arena_free(ustore_arena_t c_arena) {
+    clear_linked_memory(c_arena);
+}
+
+void ustore_arena_reset(ustore_arena_t c_arena) {
+    reset_linked_memory(c_arena);
+}
+
+void ustore_transaction_free(ustore_transaction_t const c_transaction) {
+    if (!c_transaction)
+        return;
+    sharded_txn_t& txn = *reinterpret_cast<sharded_txn_t*>(c_transaction);
+    for (ustore_transaction_t child : txn.children)
+        ustore_shard_transaction_free(child);
+    delete &txn;
+}
+
+void ustore_database_free(ustore_database_t c_db) {
+    if (!c_db)
+        return;
+
+    // The destructor releases the child engines
+    sharded_db_t& db = *reinterpret_cast<sharded_db_t*>(c_db);
+    delete &db;
+}
+
+void ustore_error_free(ustore_error_t) {
+}
@@ -9,6 +9,7 @@
 
 #include <stdio.h> // Saving/reading from disk
 
+#include <array>
 #include <map>
 #include <vector>
 #include <string>
@@ -18,9 +19,14 @@
 #include <shared_mutex>
 #include <mutex>      // `std::unique_lock`
 #include <numeric>    // `std::accumulate`
+#include <algorithm>  // `std::remove_if`
 #include <atomic>     // Thread-safe generation counters
+#include <cstdlib>    // `std::malloc`
 #include <filesystem> // Enumerating the directory
 #include <fstream>    // Passing file contents to JSON parser
+#include <thread>     // Background checkpoints
+#include <chrono>     // `std::chrono::milliseconds`
+#include <condition_variable>
 
 // TODO: These alternative containers need further testing:
 // #include <ucset/consistent_avl.hpp> // `ucset::consistent_avl_gt`
@@ -29,8 +35,13 @@
 #include <ucset/locked.hpp>         // `ucset::locked_gt`
 
 #include <nlohmann/json.hpp>        // `nlohmann::json`
+#include <lz4.h>                    // `LZ4_compress_default`
 #include <arrow/io/file.h>          // `arrow::io::ReadableFile`
-#include <parquet/stream_reader.h>  // `parquet::StreamReader`
+#include <arrow/array.h>            // `arrow::BinaryArray`
+#include <arrow/table.h>            // `arrow::Table`
+#include <arrow/builder.h>          // `arrow::BinaryBuilder`
+#include <arrow/ipc/api.h>          // `arrow::ipc::RecordBatchFileReader`
+#include <parquet/arrow/reader.h>   // `parquet::arrow::FileReader`
 #include <parquet/stream_writer.h>  // `parquet::StreamWriter`
 
 #include "ustore/db.h"
@@ -38,6 +49,13 @@
 #include "helpers/linked_memory.hpp"  // `linked_memory_t`
 #include "helpers/linked_array.hpp"   // `unintialized_vector_gt`
 #include "helpers/config_loader.hpp"  // `config_loader_t`
+#include "helpers/write_ahead_log.hpp" // `write_ahead_log_t`
+#include "helpers/change_log.hpp"      // `change_log_t`
+#include "helpers/lru.hpp"             // `lru_cache_gt`
+#include "helpers/parallel.hpp"        // `parallel_for`
+#include "helpers/mutex.hpp"           // `shared_mutex_t`
+#include "helpers/stats.hpp"           // `engine_stats_t`
+#include "helpers/expiration.hpp"      // `expiration_config_t`
 #include "ustore/cpp/ranges_args.hpp" // `places_arg_t`
 
 /*********************************************************/
@@ -59,17 +77,109 @@ using namespace unum;
 namespace stdfs = std::filesystem;
 using json_t = nlohmann::json;
 
-using blob_allocator_t = std::allocator<byte_t>;
+/**
+ * @brief Counts the bytes held in the owned blobs of a single database, to enforce
+ * its `memory_limit`. Every blob is prefixed with the address of the counter it was
+ * charged to, so it can be released without knowing, which database it belongs to.
+ */
+struct blob_allocator_t {
+    using counter_t = std::atomic<std::size_t>;
+    static constexpr std::size_t header_k = sizeof(counter_t*);
+
+    counter_t* counter = nullptr;
+
+    byte_t* allocate(std::size_t n) const noexcept {
+        auto begin = static_cast<byte_t*>(std::malloc(header_k + n));
+        if (!begin)
+            return nullptr;
+        std::memcpy(begin, &counter, header_k);
+        if (counter)
+            counter->fetch_add(n, std::memory_order_relaxed);
+        return begin + header_k;
+    }
+
+    static void deallocate(byte_t* p, std::size_t n) noexcept {
+        byte_t* begin = p - header_k;
+        counter_t* charged = nullptr;
+        std::memcpy(&charged, begin, header_k);
+        if (charged)
+            charged->fetch_sub(n, std::memory_order_relaxed);
+        std::free(begin);
+    }
+};
+
+enum class snapshot_format_t {
+    parquet_k,
+    /// Arrow IPC files are memory-mapped on open, instead of being decoded.
+    arrow_k,
+};
 
 struct ucset_options_t {
     bool encryption = false;
+
+    /**
+     * @brief Compresses values of at least `compression_threshold` bytes with LZ4,
+     * both in memory and in the persisted Parquet snapshots.
+     */
     bool compression = false;
+    size_t compression_threshold = 512;
+
+    /**
+     * @brief Once the owned blobs exceed this many bytes, the least recently
+     * used values of at least `spill_threshold` bytes are evicted to disk.
+     */
     size_t memory_limit = 0;
+    size_t spill_threshold = 256;
+
+    /**
+     * @brief Instead of dumping the entire state on close, log every change
+     * and periodically fold the log into Parquet checkpoints in background.
+     */
+    bool write_ahead_log = false;
+    size_t checkpoint_size = 64ul * 1024ul * 1024ul;
+    size_t checkpoint_interval_ms = 60ul * 1000ul;
+
+    /**
+     * @brief Concurrent commits are applied in groups of up to `group_commit_size`,
+     * sharing a single flush. The first committer of a group may wait for up to
+     * `group_commit_window_us` for others to join it.
+     */
+    size_t group_commit_size = 64;
+    size_t group_commit_window_us = 0;
+
+    snapshot_format_t snapshot_format = snapshot_format_t::parquet_k;
+
+    /**
+     * @brief Logs every committed change into a side log, that can be tailed
+     * with `ustore_changes_poll()`. Unlike the `write_ahead_log`, it isn't
+     * folded into checkpoints, and is only trimmed by its retention limit.
+     */
+    change_feed_config_t change_feed;
+
+    /**
+     * @brief Lifetimes of values in expiring collections, checked on reads and enforced
+     * by a background sweep. Deadlines are persisted in snapshots and in the write-ahead log,
+     * so the values loaded on start keep their remaining lifetimes.
+     */
+    expiration_config_t expiration;
+};
+
+enum class ownership_t : std::uint8_t {
+    owned_k,
+    /// Points into memory-mapped snapshots, which we don't own.
+    borrowed_k,
+    /// Was evicted to the spill file, and the pointer stores the offset in it.
+    spilled_k,
 };
 
 struct pair_t {
     collection_key_t collection_key;
     value_view_t range;
+    ownership_t ownership = ownership_t::owned_k;
+    /// Compressed blobs start with the original length, followed by an LZ4 block.
+    bool is_compressed = false;
+    /// Fits into the padding, so expiring collections cost no extra memory.
+    expiration_time_t expires_at = 0;
 
     pair_t() = default;
     pair_t(pair_t const&) = delete;
@@ -77,10 +187,13 @@ struct pair_t {
 
     pair_t(collection_key_t collection_key) noexcept : collection_key(collection_key) {}
 
-    pair_t(collection_key_t collection_key, value_view_t other, ustore_error_t* c_error) noexcept
+    pair_t(collection_key_t collection_key,
+           value_view_t other,
+           blob_allocator_t const& allocator,
+           ustore_error_t* c_error) noexcept
         : collection_key(collection_key) {
         if (other.size()) {
-            auto begin = blob_allocator_t {}.allocate(other.size());
+            auto begin = allocator.allocate(other.size());
             return_error_if_m(begin != nullptr, c_error, out_of_memory_k, "Failed to copy a blob");
             range = {begin, other.size()};
             std::memcpy(begin, other.begin(), other.size());
@@ -89,23 +202,83 @@ struct pair_t {
             range = other;
     }
 
+    /**
+     * @brief Copies the value, compressing it, if it's at least @p threshold bytes long
+     * and actually shrinks. Zero @p threshold disables compression.
+     */
+    static pair_t compressed(collection_key_t collection_key,
+                             value_view_t other,
+                             std::size_t threshold,
+                             blob_allocator_t const& allocator,
+                             ustore_error_t* c_error) noexcept {
+        if (!threshold || other.size() < threshold)
+            return pair_t {collection_key, other, allocator, c_error};
+
+        thread_local std::vector<char> scratch;
+        int bound = LZ4_compressBound(static_cast<int>(other.size()));
+        try {
+            scratch.resize(sizeof(ustore_length_t) + static_cast<std::size_t>(bound));
+        }
+        catch (...) {
+            return pair_t {collection_key, other, allocator, c_error};
+        }
+
+        auto length = static_cast<ustore_length_t>(other.size());
+        std::memcpy(scratch.data(), &length, sizeof(length));
+        int compressed_length = LZ4_compress_default( //
+            other.c_str(),
+            scratch.data() + sizeof(length),
+            static_cast<int>(other.size()),
+            bound);
+        std::size_t stored_length = sizeof(length) + static_cast<std::size_t>(compressed_length);
+        if (compressed_length <= 0 || stored_length >= other.size())
+            return pair_t {collection_key, other, allocator, c_error};
+
+        pair_t pair {collection_key, value_view_t {scratch.data(), stored_length}, allocator, c_error};
+        pair.is_compressed = true;
+        return pair;
+    }
+
+    static pair_t borrowed(collection_key_t collection_key, value_view_t other) noexcept {
+        pair_t pair {collection_key};
+        pair.range = other;
+        pair.ownership = ownership_t::borrowed_k;
+        return pair;
+    }
+
+    static pair_t spilled(collection_key_t collection_key, std::size_t offset, ustore_length_t length) noexcept {
+        pair_t pair {collection_key};
+        pair.range = value_view_t {reinterpret_cast<ustore_bytes_cptr_t>(offset), length};
+        pair.ownership = ownership_t::spilled_k;
+        return pair;
+    }
+
+    std::size_t spilled_offset() const noexcept { return reinterpret_cast<std::size_t>(range.data()); }
+
     ~pair_t() noexcept {
-        if (range.size())
-            blob_allocator_t {}.deallocate((byte_t*)range.data(), range.size());
+        if (range.size() && ownership == ownership_t::owned_k)
+            blob_allocator_t::deallocate((byte_t*)range.data(), range.size());
         range = {};
     }
 
     pair_t(pair_t&& other) noexcept
-        : collection_key(other.collection_key), range(std::exchange(other.range, value_view_t {})) {}
+        : collection_key(other.collection_key), range(std::exchange(other.range, value_view_t {})),
+          ownership(std::exchange(other.ownership, ownership_t::owned_k)),
+          is_compressed(std::exchange(other.is_compressed, false)),
+          expires_at(std::exchange(other.expires_at, 0)) {}
 
     pair_t& operator=(pair_t&& other) noexcept {
         std::swap(collection_key, other.collection_key);
         std::swap(range, other.range);
+        std::swap(ownership, other.ownership);
+        std::swap(is_compressed, other.is_compressed);
+        std::swap(expires_at, other.expires_at);
         return *this;
     }
 
     operator collection_key_t() const noexcept { return collection_key; }
     explicit operator bool() const noexcept { return range; }
+    bool is_expired(expiration_time_t now) const noexcept { return unum::ustore::is_expired(expires_at, now); }
 };
 
 struct pair_compare_t {
@@ -130,6 +303,45 @@ using ucset_t = locked_gt<consistent_set_gt<pair_t, pair_compare_t>, std::shared
 using transaction_t = typename ucset_t::transaction_t;
 using generation_t = typename ucset_t::generation_t;
 
+/**
+ * @brief Key, written in a transaction, with the original and the stored
+ * (potentially compressed) lengths of its new value, or missing ones, if erased.
+ */
+struct written_key_t {
+    collection_key_t key;
+    ustore_length_t length = ustore_length_missing_k;
+    ustore_length_t stored_length = ustore_length_missing_k;
+};
+
+struct staged_commit_t;
+
+/**
+ * @brief Extends the native transaction with its serialized write-set,
+ * which is logged as a single record on commit.
+ */
+struct txn_t {
+    transaction_t native;
+    std::string log_entries;
+    std::string change_entries;
+    std::size_t changes_count = 0;
+    /// Preserved in live snapshots and accounted in statistics on commit, and tracked for spilling after it.
+    std::vector<written_key_t> written_keys;
+    /// Locks held between `ustore_transaction_stage()` and `ustore_transaction_commit()`.
+    std::unique_ptr<staged_commit_t> staged;
+};
+
+/**
+ * @brief A pending `ustore_transaction_commit()`, waiting for its group.
+ * Lives on the stack of the committing thread.
+ */
+struct commit_request_t {
+    txn_t* txn = nullptr;
+    ustore_options_t options = ustore_options_default_k;
+    ustore_sequence_number_t* sequence_number = nullptr;
+    ustore_error_t error = nullptr;
+    bool done = false;
+};
+
 template <typename set_or_transaction_at, typename callback_at>
 ucset::status_t find_and_watch(set_or_transaction_at& set_or_transaction,
                                collection_key_t collection_key,
@@ -145,26 +357,40 @@ ucset::status_t find_and_watch(set_or_transaction_at& set_or_transaction,
 
     auto find_status = set_or_transaction.find(
         collection_key,
-        [&](pair_t const& pair) noexcept { callback(pair.range); },
-        [&]() noexcept { callback(value_view_t {}); });
+        [&](pair_t const& pair) noexcept { callback(pair); },
+        [&]() noexcept { callback(pair_t {collection_key}); });
     return find_status;
 }
 
-template <typename set_or_transaction_at, typename callback_at>
+struct never_skip_t {
+    bool operator()(pair_t const&) const noexcept { return false; }
+};
+
+/**
+ * @param skip Predicate for pairs, like the expired ones, that are passed over
+ * without being watched or counted towards the @p range_limit.
+ */
+template <typename set_or_transaction_at, typename callback_at, typename skip_at = never_skip_t>
 ucset::status_t scan_and_watch(set_or_transaction_at& set_or_transaction,
                                collection_key_t start,
+                               ustore_key_t end_key,
                                std::size_t range_limit,
                                ustore_options_t options,
-                               callback_at&& callback) noexcept {
+                               callback_at&& callback,
+                               skip_at&& skip = skip_at {}) noexcept {
 
     std::size_t match_idx = 0;
     collection_key_t previous = start;
     bool reached_end = false;
     auto watch_status = ucset::status_t();
     auto callback_pair = [&](pair_t const& pair) noexcept {
-        reached_end = pair.collection_key.collection != previous.collection;
+        reached_end = pair.collection_key.collection != previous.collection || pair.collection_key.key >= end_key;
         if (reached_end)
             return;
+        if (skip(pair)) {
+            previous.key = pair.collection_key.key;
+            return;
+        }
 
         if constexpr (!std::is_same<set_or_transaction_at, ucset_t>()) {
             bool dont_watch = options & ustore_option_transaction_dont_watch_k;
@@ -244,19 +470,117 @@ struct string_less_t : public std::less<std::string_view> {
     using is_transparent = void;
 };
 
+/**
+ * @brief Number of present keys and the stored (potentially compressed) bytes of their values.
+ * Can only drift, if a single batch repeats the same key.
+ */
+struct collection_stats_t {
+    std::size_t keys = 0;
+    std::size_t value_bytes = 0;
+};
+
+/**
+ * @brief Live counterpart of `collection_stats_t`, that concurrent writers update
+ * without locking each other.
+ */
+struct collection_counters_t {
+    std::atomic<std::size_t> keys {0};
+    std::atomic<std::size_t> value_bytes {0};
+};
+
+using keys_mutexes_t = std::array<std::mutex, 64>;
+
+/**
+ * @brief Exclusive ownership of a few stripes of `database_t::keys_mutexes`.
+ * They are always locked in the ascending order, so overlapping batches can't deadlock.
+ */
+class keys_lock_t {
+    keys_mutexes_t* mutexes_ = nullptr;
+    std::uint64_t stripes_ = 0;
+
+  public:
+    keys_lock_t() noexcept = default;
+    keys_lock_t(keys_mutexes_t& mutexes, std::uint64_t stripes) noexcept : mutexes_(&mutexes), stripes_(stripes) {
+        for (std::size_t i = 0; i != mutexes.size(); ++i)
+            if ((stripes_ >> i) & 1u)
+                mutexes[i].lock();
+    }
+    keys_lock_t(keys_lock_t&& other) noexcept
+        : mutexes_(other.mutexes_), stripes_(std::exchange(other.stripes_, 0)) {}
+    keys_lock_t& operator=(keys_lock_t&& other) noexcept {
+        unlock();
+        mutexes_ = other.mutexes_;
+        stripes_ = std::exchange(other.stripes_, 0);
+        return *this;
+    }
+    ~keys_lock_t() noexcept { unlock(); }
+
+    void unlock() noexcept {
+        for (std::size_t i = 0; stripes_ && i != mutexes_->size(); ++i)
+            if ((stripes_ >> i) & 1u)
+                (*mutexes_)[i].unlock();
+        stripes_ = 0;
+    }
+};
+
+/**
+ * @brief Point-in-time view of the DB, that doesn't copy anything upfront.
+ * Instead, writers preserve the "before-image" of every pair they change for the
+ * first time since the snapshot was taken, and the remaining pairs are read from HEAD.
+ * Keys, that were missing at that time, are preserved as missing pairs.
+ */
+struct snapshot_t {
+    std::map<collection_key_t, pair_t> before_images;
+    /// Collections, that were present, when the snapshot was taken.
+    std::vector<std::pair<std::string, ustore_collection_t>> names;
+};
+
 struct database_t {
     /**
      * @brief Rarely-used mutex for global reorganizations, like:
      * - Removing existing collections or adding new ones.
      * - Listing present collections.
      */
-    std::shared_mutex restructuring_mutex;
+    shared_mutex_t restructuring_mutex;
+
+    /**
+     * @brief Memory-mapped Arrow snapshots, referenced by "borrowed" pairs.
+     * Must outlive the `pairs`, so is declared before them.
+     */
+    std::vector<std::shared_ptr<arrow::RecordBatch>> mapped_batches;
+    std::mutex mapped_batches_mutex;
+
+    /**
+     * @brief Bytes held in the owned blobs of this database, to enforce the `memory_limit`.
+     * Pairs are charged to it by the `blobs` allocator, so both must outlive the `pairs`.
+     */
+    blob_allocator_t::counter_t blobs_bytes {0};
+    blob_allocator_t blobs {&blobs_bytes};
 
     /**
      * @brief Primary database state.
      */
     ucset_t pairs;
 
+    /**
+     * @brief Live snapshots, identified by their addresses. While there are none,
+     * writers only share the mutex. Is locked after the `log_mutex`.
+     */
+    shared_mutex_t snapshots_mutex;
+    std::map<ustore_snapshot_t, std::unique_ptr<snapshot_t>> snapshots;
+
+    /**
+     * @brief Totals of every collection, maintained on every change, so that they can be
+     * measured without a walk. Writers hold the stripes of `keys_mutexes`, that their keys
+     * map to, from looking up the pairs they replace until the changes are applied,
+     * so concurrent writes of the same key can't account the replaced pair twice.
+     * The counters are atomic, so the mutex is only locked exclusively to add or remove
+     * collections. Both are locked after the `snapshots_mutex`, the stripes first.
+     */
+    keys_mutexes_t keys_mutexes;
+    shared_mutex_t collections_stats_mutex;
+    std::unordered_map<ustore_collection_t, collection_counters_t> collections_stats;
+
     /**
      * @brief A variable-size set of named collections.
      * It's cleaner to implement it with heterogenous lookups as
@@ -264,17 +588,86 @@ struct database_t {
      */
     std::map<std::string, ustore_collection_t, string_less_t> names;
 
+    /**
+     * @brief Lifetimes of values in the expiring collections, matched by their `names`.
+     * Like the latter, is guarded by the `restructuring_mutex`.
+     */
+    std::unordered_map<ustore_collection_t, expiration_time_t> ttls;
+
     /**
      * @brief Path on disk, from which the data will be read.
      * When closed, we will try saving the DB on disk.
      */
     std::string persisted_directory;
 
-    database_t(ucset_t&& set) noexcept(false) : pairs(std::move(set)) {}
+    /**
+     * @brief Directories across which the collection snapshots are striped.
+     * If none were configured, only contains the `persisted_directory`.
+     * The logs always stay in the `persisted_directory`.
+     */
+    std::vector<std::string> data_directories;
+
+    ucset_options_t options;
+
+    /**
+     * @brief Orders appends to the `log` in the same way changes are applied
+     * to `pairs`. If both are needed, is locked after `restructuring_mutex`.
+     */
+    std::mutex log_mutex;
+    write_ahead_log_t log;
+    std::size_t log_sequence = 0;
+    std::size_t log_size_after_rotation = 0;
+
+    std::thread checkpointer;
+    std::condition_variable checkpointer_wakeup;
+    bool checkpointer_stop = false;
+
+    /**
+     * @brief Periodically removes the expired values, if any collection expires.
+     * Its mutex is never locked together with other mutexes.
+     */
+    std::thread sweeper;
+    std::mutex sweeper_mutex;
+    std::condition_variable sweeper_wakeup;
+    bool sweeper_stop = false;
+
+    /**
+     * @brief Optional feed of committed changes. Its mutex is locked after the `log_mutex`.
+     */
+    change_log_t changes;
+
+    /**
+     * @brief Anonymous file for values evicted under memory pressure, and the recency
+     * of access to the values, that can be evicted. Extents of overwritten and erased
+     * values are found by periodic collections and reused as `spill_gaps`, mapping
+     * offsets to lengths. Is locked after the `snapshots_mutex`.
+     */
+    std::mutex spill_mutex;
+    int spill_handle = -1;
+    std::size_t spill_size = 0;
+    std::size_t spill_collected_bytes = 0;
+    std::size_t spill_written_bytes = 0;
+    std::map<std::size_t, std::size_t> spill_gaps;
+    lru_cache_gt<collection_key_t, ustore_length_t> spill_candidates {std::numeric_limits<std::size_t>::max()};
+
+    /**
+     * @brief Queue of concurrent commits. One of the committing threads at a time
+     * becomes the "leader", applying a group of them and flushing once for all.
+     * Is never locked together with other mutexes.
+     */
+    std::mutex commits_mutex;
+    std::condition_variable commits_arrived;
+    std::condition_variable commits_done;
+    std::vector<commit_request_t*> commits_queue;
+    bool commits_leader_active = false;
+
+    engine_stats_t stats;
 
-    database_t(database_t&& other) noexcept
-        : pairs(std::move(other.pairs)), names(std::move(other.names)),
-          persisted_directory(std::move(other.persisted_directory)) {}
+    database_t(ucset_t&& set) noexcept(false) : pairs(std::move(set)) {}
+    ~database_t() noexcept {
+        if (spill_handle >= 0)
+            ::close(spill_handle);
+    }
 };
 
 ustore_collection_t new_collection(database_t& db) noexcept {
@@ -297,210 +690,1928 @@ void export_error_code(ucset::status_t code, ustore_error_t* c_error) noexcept {
 }
 
 /*********************************************************/
-/*****************	 Writing to Disk	  ****************/
+/*****************	      Snapshots 	  ****************/
 /*********************************************************/
 
-void write_collection( //
-    database_t const& db,
-    ustore_collection_t collection_id,
-    std::string const& collection_path,
-    ustore_error_t* c_error) noexcept(false) {
+/**
+ * @brief Held by writers, while they apply changes. Without live snapshots it's shared,
+ * so writers don't block each other. Otherwise it's exclusive, and the before-images
+ * of the changed pairs are preserved before the lock is returned.
+ */
+struct snapshots_lock_t {
+    std::shared_lock<shared_mutex_t> shared;
+    std::unique_lock<shared_mutex_t> unique;
+};
 
-    std::shared_ptr<arrow::io::FileOutputStream> out_file;
-    PARQUET_ASSIGN_OR_THROW(out_file, arrow::io::FileOutputStream::Open(collection_path));
+/**
+ * @brief Copies the @p pair into every live snapshot, that hasn't preserved its key yet.
+ * Spilled and borrowed values are never modified in-place, so only their locations are copied.
+ * Must be called under an exclusive `database_t::snapshots_mutex`.
+ */
+void preserve_before_image(database_t& db, pair_t const& pair, ustore_error_t* c_error) noexcept {
+    for (auto& [id, snapshot] : db.snapshots) {
+        auto& before_images = snapshot->before_images;
+        auto it = before_images.lower_bound(pair.collection_key);
+        if (it != before_images.end() && it->first == pair.collection_key)
+            continue;
 
-    parquet::schema::NodeVector columns {};
-    columns.push_back(parquet::schema::PrimitiveNode::Make( //
-        "key",
-        parquet::Repetition::REQUIRED,
-        parquet::Type::INT64,
-        parquet::ConvertedType::INT_64));
-    columns.push_back(parquet::schema::PrimitiveNode::Make( //
-        "value",
-        parquet::Repetition::OPTIONAL,
-        parquet::Type::BYTE_ARRAY,
-        parquet::ConvertedType::UTF8));
-    auto schema = std::static_pointer_cast<parquet::schema::GroupNode>(
-        parquet::schema::GroupNode::Make("schema", parquet::Repetition::REQUIRED, columns));
-    parquet::WriterProperties::Builder builder;
-    parquet::StreamWriter os {parquet::ParquetFileWriter::Open(out_file, schema, builder.build())};
-
-    collection_key_t min(collection_id, std::numeric_limits<ustore_key_t>::min());
-    collection_key_t max(collection_id, std::numeric_limits<ustore_key_t>::max());
-    auto status = db.pairs.range(min, max, [&](pair_t& pair) noexcept {
-        std::optional<std::string_view> value;
-        if (pair.range.size())
-            value = std::string_view(pair.range);
-        os << pair.collection_key.key << value << parquet::EndRow;
-    });
-    export_error_code(status, c_error);
-    return_if_error_m(c_error);
+        pair_t copy {pair.collection_key};
+        if (pair.ownership == ownership_t::owned_k)
+            copy = pair_t {pair.collection_key, pair.range, db.blobs, c_error};
+        else
+            copy.range = pair.range, copy.ownership = pair.ownership;
+        return_if_error_m(c_error);
+        copy.is_compressed = pair.is_compressed;
+        copy.expires_at = pair.expires_at;
+        safe_section("Preserving before-image", c_error, [&] {
+            before_images.emplace_hint(it, pair.collection_key, std::move(copy));
+        });
+        return_if_error_m(c_error);
+    }
 }
 
-void write(database_t const& db, std::string const& dir_path, ustore_error_t* c_error) noexcept(false) {
-
-    // Check if the source directory even exists
-    if (!std::filesystem::is_directory(dir_path))
-        return;
+void preserve_before_image(database_t& db, collection_key_t key, ustore_error_t* c_error) noexcept {
+    auto status = db.pairs.find(
+        key,
+        [&](pair_t const& pair) noexcept { preserve_before_image(db, pair, c_error); },
+        [&]() noexcept { preserve_before_image(db, pair_t {key}, c_error); });
+    export_error_code(status, c_error);
+}
 
-    auto main_path = stdfs::path(dir_path) / ".parquet";
-    write_collection(db, ustore_collection_main_k, main_path, c_error);
-    return_if_error_m(c_error);
+/**
+ * @brief Locks the snapshots for the duration of a write.
+ * @param preserve Callback, that preserves the before-images of all the pairs,
+ * which are about to change. Is only called, if there are live snapshots.
+ */
+template <typename preserve_at>
+snapshots_lock_t lock_snapshots_for_write(database_t& db, preserve_at&& preserve) noexcept {
+    snapshots_lock_t lock;
+    lock.shared = std::shared_lock<shared_mutex_t> {db.snapshots_mutex};
+    if (db.snapshots.empty())
+        return lock;
+
+    lock.shared = {};
+    lock.unique = std::unique_lock<shared_mutex_t> {db.snapshots_mutex};
+    if (!db.snapshots.empty())
+        preserve();
+    return lock;
+}
 
-    for (auto const& collection : db.names) {
-        auto const& collection_name = collection.first;
-        auto const collection_path = stdfs::path(dir_path) / (collection_name + ".parquet");
-        write_collection(db, collection.second, collection_path, c_error);
-        return_if_error_m(c_error);
+/**
+ * @brief Must be called under a shared `database_t::snapshots_mutex`,
+ * which must be held, until the returned snapshot is no longer used.
+ */
+snapshot_t const* find_snapshot(database_t const& db, ustore_snapshot_t id, ustore_error_t* c_error) noexcept {
+    auto it = db.snapshots.find(id);
+    if (it == db.snapshots.end()) {
+        *c_error = "The snapshot doesn't exist!";
+        return nullptr;
     }
+    return it->second.get();
 }
 
-bool ends_with(std::string_view str, std::string_view suffix) noexcept {
-    return str.size() >= suffix.size() &&
-           0 == str.compare(str.size() - suffix.size(), suffix.size(), suffix.data(), suffix.size());
+template <typename callback_at>
+ucset::status_t find_in_snapshot(database_t const& db,
+                                 snapshot_t const& snapshot,
+                                 collection_key_t collection_key,
+                                 callback_at&& callback) noexcept {
+    auto it = snapshot.before_images.find(collection_key);
+    if (it != snapshot.before_images.end()) {
+        callback(it->second);
+        return {};
+    }
+    return db.pairs.find(
+        collection_key,
+        [&](pair_t const& pair) noexcept { callback(pair); },
+        [&]() noexcept { callback(pair_t {collection_key}); });
 }
 
-void read(database_t& db, std::string const& path, ustore_error_t* c_error) noexcept(false) {
-
-    // Clear the DB, before refilling it
-    db.names.clear();
-    auto status = db.pairs.clear();
-    export_error_code(status, c_error);
-    return_if_error_m(c_error);
+/**
+ * @brief Merges the current pairs in range with the before-images of the @p snapshot.
+ * The before-images override the current pairs with the same keys, and the ones, that
+ * are missing, hide them.
+ */
+template <typename callback_at>
+ucset::status_t scan_snapshot(database_t const& db,
+                              snapshot_t const& snapshot,
+                              collection_key_t start,
+                              ustore_key_t end_key,
+                              std::size_t range_limit,
+                              callback_at&& callback) noexcept {
+
+    auto images = snapshot.before_images.lower_bound(start);
+    auto images_end = snapshot.before_images.lower_bound(collection_key_t {start.collection, end_key});
+    std::size_t match_idx = 0;
+    auto emit = [&](pair_t const& pair) noexcept {
+        if (!pair)
+            return;
+        callback(pair);
+        ++match_idx;
+    };
 
-    // Check if the source directory even exists
-    if (!std::filesystem::is_directory(path))
-        return;
+    collection_key_t previous = start;
+    bool reached_end = false;
+    auto callback_pair = [&](pair_t const& pair) noexcept {
+        reached_end = pair.collection_key.collection != start.collection || pair.collection_key.key >= end_key;
+        if (reached_end)
+            return;
 
-    // Loop over all persisted collections, reading them one by one
-    std::string_view extension {".parquet"};
-    for (auto const& dir_entry : std::filesystem::directory_iterator {path}) {
-        auto const& collection_path = dir_entry.path();
-        std::string collection_name = collection_path.filename();
-        if (!ends_with(collection_name, extension))
-            continue;
+        previous = pair.collection_key;
+        while (match_idx != range_limit && images != images_end && images->first < pair.collection_key)
+            emit((images++)->second);
+        if (match_idx == range_limit)
+            return;
+        if (images != images_end && images->first == pair.collection_key)
+            emit((images++)->second);
+        else {
+            callback(pair);
+            ++match_idx;
+        }
+    };
 
-        collection_name.resize(collection_name.size() - extension.size());
-        ustore_collection_t collection_id = collection_name.empty() ? ustore_collection_main_k : new_collection(db);
-        if (!collection_name.empty())
-            db.names.emplace(collection_name, collection_id);
-
-        std::shared_ptr<arrow::io::ReadableFile> in_file;
-        PARQUET_ASSIGN_OR_THROW(in_file, arrow::io::ReadableFile::Open(collection_path));
-        parquet::StreamReader os {parquet::ParquetFileReader::Open(in_file)};
-
-        ustore_key_t key;
-        std::optional<std::string> value;
-        while (!os.eof()) {
-            os >> key >> value >> parquet::EndRow;
-
-            pair_t pair;
-            pair.collection_key.collection = collection_id;
-            pair.collection_key.key = key;
-
-            // Converting to our internal representation would require a copy
-            if (value) {
-                auto buf_len = value->size();
-                auto buf_ptr = blob_allocator_t {}.allocate(buf_len);
-                return_error_if_m(buf_ptr != nullptr, c_error, out_of_memory_k, "Failed to allocate a blob");
-                pair.range = value_view_t {buf_ptr, buf_len};
-                std::memcpy(buf_ptr, value->data(), value->size());
-            }
-            else
-                pair.range = value_view_t::make_empty();
+    auto status = db.pairs.find(start, callback_pair, {});
+    while (status && match_idx != range_limit && !reached_end)
+        status = db.pairs.upper_bound(previous, callback_pair, [&]() noexcept { reached_end = true; });
+    if (!status)
+        return status;
 
-            auto status = db.pairs.upsert(std::move(pair));
-            export_error_code(status, c_error);
-            return_if_error_m(c_error);
-        }
-    }
+    // Pairs, that were erased after the snapshot was taken
+    while (match_idx != range_limit && images != images_end)
+        emit((images++)->second);
+    return {};
 }
 
 /*********************************************************/
-/*****************	    C Interface 	  ****************/
+/*****************	Collection Statistics	  ****************/
 /*********************************************************/
 
-void ustore_database_init(ustore_database_init_t* c_ptr) {
+/**
+ * @brief Changes, that a group of writes will make to `database_t::collections_stats`,
+ * which are only applied, if the writes succeed. Most groups touch a single collection.
+ */
+struct stats_deltas_t {
+    struct delta_t {
+        ustore_collection_t collection = ustore_collection_main_k;
+        std::ptrdiff_t keys = 0;
+        std::ptrdiff_t value_bytes = 0;
+    };
+    std::vector<delta_t> collections;
 
-    ustore_database_init_t& c = *c_ptr;
-    safe_section("Initializing DBMS", c.error, [&] {
-        auto maybe_pairs = ucset_t::make();
-        return_error_if_m(maybe_pairs, c.error, error_unknown_k, "Couldn't build consistent set");
-        auto db = database_t(std::move(maybe_pairs).value());
-        auto db_ptr = std::make_unique<database_t>(std::move(db));
+    void add(ustore_collection_t collection, std::ptrdiff_t keys, std::ptrdiff_t value_bytes) noexcept(false) {
+        auto it = std::find_if(collections.begin(), collections.end(), [=](delta_t const& delta) {
+            return delta.collection == collection;
+        });
+        if (it == collections.end())
+            it = collections.insert(it, delta_t {collection});
+        it->keys += keys;
+        it->value_bytes += value_bytes;
+    }
+};
 
-        if (c.config && std::strlen(c.config) > 0) {
-            // Load config
-            config_t config;
-            auto status = config_loader_t::load_from_json_string(c.config, config);
-            return_error_if_m(status, c.error, args_wrong_k, status.message());
+ustore_length_t stored_length(pair_t const& pair) noexcept {
+    return pair ? static_cast<ustore_length_t>(pair.range.size()) : ustore_length_missing_k;
+}
 
-            // Root path
-            stdfs::path root = config.directory;
-            stdfs::file_status root_status = stdfs::status(root);
-            return_error_if_m(root_status.type() == stdfs::file_type::directory,
-                              c.error,
-                              args_wrong_k,
-                              "Root isn't a directory");
+/**
+ * @brief Locks the stripes of `database_t::keys_mutexes`, that the @p count keys map to.
+ * @param key_at Callback, returning the i-th `collection_key_t`.
+ */
+template <typename key_at>
+keys_lock_t lock_keys(database_t& db, std::size_t count, key_at&& key) noexcept {
+    std::uint64_t stripes = 0;
+    for (std::size_t i = 0; i != count; ++i)
+        stripes |= std::uint64_t(1) << (collection_key_hash_t {}(key(i)) % db.keys_mutexes.size());
+    return keys_lock_t {db.keys_mutexes, stripes};
+}
 
-            // Storage paths
-            return_error_if_m(config.data_directories.empty(), c.error, args_wrong_k, "Multi-disk not supported");
+keys_lock_t lock_all_keys(database_t& db) noexcept {
+    return keys_lock_t {db.keys_mutexes, std::numeric_limits<std::uint64_t>::max()};
+}
 
-            // Engine config
-            return_error_if_m(config.engine.config_url.empty(), c.error, args_wrong_k, "Doesn't support URL configs");
-            return_error_if_m(config.engine.config.empty(), c.error, args_wrong_k, "Doesn't support nested configs");
+/**
+ * @brief Looks up the pair, that is about to be replaced by a value of @p new_stored_length
+ * bytes, or erased, if that is missing, and accumulates the difference into @p deltas.
+ * Must be called under the `lock_keys()` stripes of the @p key.
+ */
+void account_write(database_t& db,
+                   collection_key_t key,
+                   ustore_length_t new_stored_length,
+                   stats_deltas_t& deltas,
+                   ustore_error_t* c_error) noexcept {
+    std::ptrdiff_t old_keys = 0;
+    std::ptrdiff_t old_bytes = 0;
+    auto status = db.pairs.find(
+        key,
+        [&](pair_t const& pair) noexcept {
+            old_keys = bool(pair);
+            old_bytes = static_cast<std::ptrdiff_t>(pair.range.size());
+        },
+        []() noexcept {});
+    if (!status)
+        return export_error_code(status, c_error);
 
-            auto fill_options = [](json_t const& js, ucset_options_t& options) {
-                if (js.contains("encryption"))
-                    options.encryption = js["encryption"];
-                if (js.contains("compression"))
-                    options.compression = js["compression"];
-                if (js.contains("memory_limit"))
-                    options.memory_limit = js["memory_limit"];
-            };
+    bool const has_key = new_stored_length != ustore_length_missing_k;
+    std::ptrdiff_t new_bytes = has_key ? static_cast<std::ptrdiff_t>(new_stored_length) : 0;
+    safe_section("Accounting the change", c_error, [&] {
+        deltas.add(key.collection, std::ptrdiff_t(has_key) - old_keys, new_bytes - old_bytes);
+    });
+}
 
-            // Load from file
-            ucset_options_t options;
-            if (!config.engine.config_file_path.empty()) {
-                std::ifstream ifs(config.engine.config_file_path);
-                return_error_if_m(ifs, c.error, args_wrong_k, "Config file not found");
-                auto js = json_t::parse(ifs);
-                fill_options(js, options);
-            }
+/**
+ * @brief Adds the counters of the collections in @p deltas, that have none yet,
+ * so that `apply_stats` can't fail after the changes were applied.
+ */
+void reserve_stats(database_t& db, stats_deltas_t const& deltas, ustore_error_t* c_error) noexcept {
+    auto has_counters = [&](stats_deltas_t::delta_t const& delta) {
+        return db.collections_stats.find(delta.collection) != db.collections_stats.end();
+    };
+    {
+        std::shared_lock<shared_mutex_t> _ {db.collections_stats_mutex};
+        if (std::all_of(deltas.collections.begin(), deltas.collections.end(), has_counters))
+            return;
+    }
+    std::unique_lock<shared_mutex_t> _ {db.collections_stats_mutex};
+    safe_section("Accounting the change", c_error, [&] {
+        for (auto const& delta : deltas.collections)
+            db.collections_stats.try_emplace(delta.collection);
+    });
+}
+
+/**
+ * @brief Must be called under the same stripes, as the `account_write` calls, that filled the @p deltas,
+ * after `reserve_stats`.
+ */
+void apply_stats(database_t& db, stats_deltas_t const& deltas) noexcept {
+    std::shared_lock<shared_mutex_t> _ {db.collections_stats_mutex};
+    for (auto const& delta : deltas.collections) {
+        auto it = db.collections_stats.find(delta.collection);
+        if (it == db.collections_stats.end())
+            continue;
+        it->second.keys.fetch_add(static_cast<std::size_t>(delta.keys), std::memory_order_relaxed);
+        it->second.value_bytes.fetch_add(static_cast<std::size_t>(delta.value_bytes), std::memory_order_relaxed);
+    }
+}
+
+collection_stats_t collection_stats(database_t& db, ustore_collection_t collection) noexcept {
+    std::shared_lock<shared_mutex_t> _ {db.collections_stats_mutex};
+    auto it = db.collections_stats.find(collection);
+    if (it == db.collections_stats.end())
+        return {};
+    return {it->second.keys.load(std::memory_order_relaxed), it->second.value_bytes.load(std::memory_order_relaxed)};
+}
+
+/**
+ * @brief Recomputes `database_t::collections_stats` in one pass,
+ * after the pairs were loaded from disk, bypassing the accounting.
+ */
+void recount_collections(database_t& db, ustore_error_t* c_error) noexcept {
+    std::unique_lock<shared_mutex_t> _ {db.collections_stats_mutex};
+    db.collections_stats.clear();
+    auto status = scan_full(db.pairs, [&](pair_t const& pair) noexcept {
+        if (!pair || *c_error)
+            return;
+        safe_section("Counting collection", c_error, [&] {
+            collection_counters_t& stats = db.collections_stats[pair.collection_key.collection];
+            stats.keys.fetch_add(1, std::memory_order_relaxed);
+            stats.value_bytes.fetch_add(pair.range.size(), std::memory_order_relaxed);
+        });
+    });
+    export_error_code(status, c_error);
+}
+
+void drop_collection(database_t& db, ustore_collection_t id, ustore_drop_mode_t mode, ustore_error_t* c_error) {
+
+    snapshots_lock_t snapshots_lock = lock_snapshots_for_write(db, [&] {
+        auto status = db.pairs.range(id, id + 1, [&](pair_t& pair) noexcept {
+            if (!*c_error)
+                preserve_before_image(db, pair, c_error);
+        });
+        export_error_code(status, c_error);
+    });
+    return_if_error_m(c_error);
+    keys_lock_t keys_lock = lock_all_keys(db);
+    std::unique_lock<shared_mutex_t> stats_lock {db.collections_stats_mutex};
+
+    if (mode == ustore_drop_keys_vals_handle_k) {
+        auto status = db.pairs.erase_range(id, id + 1, no_op_t {});
+        if (!status)
+            return export_error_code(status, c_error);
+
+        db.collections_stats.erase(id);
+        db.ttls.erase(id);
+        for (auto it = db.names.begin(); it != db.names.end(); ++it) {
+            if (id != it->second)
+                continue;
+            db.names.erase(it);
+            break;
+        }
+    }
+
+    else if (mode == ustore_drop_keys_vals_k) {
+        auto status = db.pairs.erase_range(id, id + 1, no_op_t {});
+        if (status)
+            db.collections_stats.erase(id);
+        return export_error_code(status, c_error);
+    }
+
+    else if (mode == ustore_drop_vals_k) {
+        auto status = db.pairs.range(id, id + 1, [&](pair_t& pair) noexcept {
+            expiration_time_t expires_at = pair.expires_at;
+            pair = pair_t {pair.collection_key, value_view_t::make_empty(), db.blobs, nullptr};
+            pair.expires_at = expires_at;
+        });
+        if (auto it = db.collections_stats.find(id); status && it != db.collections_stats.end())
+            it->second.value_bytes = 0;
+        return export_error_code(status, c_error);
+    }
+}
+
+/**
+ * @brief Serializes the changes, that dropping the collection will make, for the change-feed,
+ * as consumers only see individual keys. Handles follow the keys, as they aren't logged.
+ */
+std::size_t serialize_drop(database_t& db,
+                           ustore_collection_t id,
+                           ustore_drop_mode_t mode,
+                           std::string& entries,
+                           ustore_error_t* c_error) noexcept {
+    std::size_t count = 0;
+    value_view_t new_value = mode == ustore_drop_vals_k ? value_view_t::make_empty() : value_view_t {};
+    auto status = db.pairs.range(id, id + 1, [&](pair_t& pair) noexcept {
+        if (*c_error)
+            return;
+        safe_section("Serializing dropped keys", c_error, [&] {
+            change_log_t::serialize(entries, pair.collection_key, new_value);
+            ++count;
+        });
+    });
+    export_error_code(status, c_error);
+    return count;
+}
+
+/*********************************************************/
+/*****************	 Memory Pressure	  ****************/
+/*********************************************************/
+
+/**
+ * @brief Parses sizes either as plain numbers of bytes, or strings like "100GB".
+ */
+std::size_t parse_size(json_t const& js) noexcept(false) {
+    if (js.is_number())
+        return js.get<std::size_t>();
+
+    std::string const str = js.get<std::string>();
+    std::size_t suffix_offset = 0;
+    std::size_t size = std::stoull(str, &suffix_offset);
+    std::string_view suffix = std::string_view(str).substr(suffix_offset);
+    if (suffix.empty() || suffix == "B")
+        return size;
+    if (suffix == "KB")
+        return size << 10;
+    if (suffix == "MB")
+        return size << 20;
+    if (suffix == "GB")
+        return size << 30;
+    if (suffix == "TB")
+        return size << 40;
+    throw std::invalid_argument("Unknown size suffix");
+}
+
+bool can_spill(database_t const& db) noexcept {
+    return db.options.memory_limit && db.spill_handle >= 0;
+}
+
+/**
+ * @brief Marks the values as recently used, so they are evicted last.
+ * Erased and small values are just forgotten.
+ * @param key_and_length Callback, returning the key and value length of the i-th task.
+ */
+template <typename key_and_length_at>
+void track_recency(database_t& db, std::size_t count, key_and_length_at&& key_and_length) noexcept {
+    if (!can_spill(db))
+        return;
+
+    std::unique_lock _ {db.spill_mutex};
+    try {
+        for (std::size_t i = 0; i != count; ++i) {
+            auto [key, length] = key_and_length(i);
+            if (length == ustore_length_missing_k || length < db.options.spill_threshold)
+                db.spill_candidates.pop(key);
+            else
+                db.spill_candidates.insert(key, std::move(length));
+        }
+    }
+    catch (...) {
+        // Tracking is just a hint, losing some of it is fine
+    }
+}
+
+/**
+ * @brief Finds the extents of the spill file, that are no longer referenced by HEAD
+ * or by the before-images of live snapshots, and remembers them as reusable gaps.
+ * The trailing gap is cut off the file. Must be called under the `spill_mutex`
+ * and a shared `database_t::snapshots_mutex`, so that no extent changes its owner.
+ */
+void collect_spill_gaps(database_t& db) noexcept {
+    std::vector<std::pair<std::size_t, std::size_t>> live;
+    bool failed = false;
+    auto append_live = [&](pair_t const& pair) noexcept {
+        if (pair.ownership != ownership_t::spilled_k || !pair.range.size() || failed)
+            return;
+        try {
+            live.emplace_back(pair.spilled_offset(), pair.range.size());
+        }
+        catch (...) {
+            failed = true;
+        }
+    };
+    auto status = scan_full(db.pairs, append_live);
+    for (auto const& [id, snapshot] : db.snapshots)
+        for (auto const& [key, pair] : snapshot->before_images)
+            append_live(pair);
+    // Without the full picture every extent is assumed to be live
+    if (!status || failed)
+        return;
+
+    // Snapshots share extents with HEAD, so the overlapping ones are merged
+    std::sort(live.begin(), live.end());
+    std::map<std::size_t, std::size_t> gaps;
+    std::size_t live_bytes = 0;
+    std::size_t covered = 0;
+    try {
+        for (auto [offset, length] : live) {
+            if (offset > covered)
+                gaps.emplace(covered, offset - covered);
+            live_bytes += offset + length > covered ? offset + length - std::max(offset, covered) : 0;
+            covered = std::max(covered, offset + length);
+        }
+    }
+    catch (...) {
+        return;
+    }
+
+    if (covered < db.spill_size && ::ftruncate(db.spill_handle, static_cast<off_t>(covered)) == 0)
+        db.spill_size = covered;
+    db.spill_gaps = std::move(gaps);
+    db.spill_collected_bytes = live_bytes;
+    db.spill_written_bytes = 0;
+}
+
+/**
+ * @brief Picks the offset for a new spilled value of @p length bytes,
+ * reusing the first gap, that fits it, or growing the file.
+ */
+std::size_t allocate_spill_extent(database_t& db, std::size_t length) noexcept {
+    for (auto it = db.spill_gaps.begin(); it != db.spill_gaps.end(); ++it) {
+        auto [offset, gap_length] = *it;
+        if (gap_length < length)
+            continue;
+        db.spill_gaps.erase(it);
+        if (gap_length != length)
+            db.spill_gaps.emplace(offset + length, gap_length - length);
+        return offset;
+    }
+    return db.spill_size;
+}
+
+/**
+ * @brief Evicts least recently used values into the spill file,
+ * until the owned blobs fit into the `memory_limit`.
+ * Once as many bytes were spilled since the last collection, as were still live after it,
+ * the file is scanned for gaps, so that overwritten values don't grow it indefinitely.
+ */
+void enforce_memory_limit(database_t& db) noexcept {
+    if (!can_spill(db) || db.blobs_bytes.load() <= db.options.memory_limit)
+        return;
+
+    std::shared_lock<shared_mutex_t> snapshots_lock {db.snapshots_mutex};
+    std::unique_lock _ {db.spill_mutex};
+    if (db.spill_written_bytes > std::max(db.spill_collected_bytes, db.options.memory_limit))
+        collect_spill_gaps(db);
+
+    while (db.blobs_bytes.load() > db.options.memory_limit) {
+        auto oldest = db.spill_candidates.pop_oldest();
+        if (!oldest)
+            break;
+
+        collection_key_t key = oldest->first;
+        collection_key_t next_key = key.key != std::numeric_limits<ustore_key_t>::max()
+                                        ? collection_key_t {key.collection, key.key + 1}
+                                        : collection_key_t {key.collection + 1, std::numeric_limits<ustore_key_t>::min()};
+        bool failed = false;
+        auto status = db.pairs.range(key, next_key, [&](pair_t& pair) noexcept {
+            if (pair.ownership != ownership_t::owned_k || !pair.range.size())
+                return;
+            std::size_t offset = allocate_spill_extent(db, pair.range.size());
+            auto written = ::pwrite(db.spill_handle, pair.range.data(), pair.range.size(), static_cast<off_t>(offset));
+            if (written != static_cast<ssize_t>(pair.range.size())) {
+                failed = true;
+                return;
+            }
+            bool is_compressed = pair.is_compressed;
+            expiration_time_t expires_at = pair.expires_at;
+            pair = pair_t::spilled(pair.collection_key, offset, static_cast<ustore_length_t>(pair.range.size()));
+            pair.is_compressed = is_compressed;
+            pair.expires_at = expires_at;
+            db.spill_size = std::max(db.spill_size, offset + pair.range.size());
+            db.spill_written_bytes += pair.range.size();
+        });
+        if (!status || failed)
+            break;
+    }
+}
+
+/**
+ * @brief Returns a view of the stored (potentially compressed) value, that is only valid
+ * until @p buffer is changed. Spilled values are faulted in from disk into the @p buffer.
+ */
+value_view_t read_stored(database_t const& db,
+                         pair_t const& pair,
+                         std::string& buffer,
+                         ustore_error_t* c_error) noexcept {
+    if (pair.ownership != ownership_t::spilled_k)
+        return pair.range;
+
+    safe_section("Allocating a buffer for a spilled value", c_error, [&] { buffer.resize(pair.range.size()); });
+    if (*c_error)
+        return {};
+    auto offset = static_cast<off_t>(pair.spilled_offset());
+    auto read = ::pread(db.spill_handle, buffer.data(), buffer.size(), offset);
+    if (read != static_cast<ssize_t>(buffer.size())) {
+        log_error_m(c_error, error_unknown_k, "Failed to read a spilled value");
+        return {};
+    }
+    return value_view_t {buffer.data(), buffer.size()};
+}
+
+/*********************************************************/
+/*****************	    Compression 	  ****************/
+/*********************************************************/
+
+std::size_t compression_threshold(database_t const& db) noexcept {
+    return db.options.compression ? db.options.compression_threshold : 0;
+}
+
+ustore_length_t decompressed_length(value_view_t stored) noexcept {
+    ustore_length_t length;
+    std::memcpy(&length, stored.data(), sizeof(length));
+    return length;
+}
+
+void decompress(value_view_t stored, byte_t* output, ustore_length_t length, ustore_error_t* c_error) noexcept {
+    int decompressed = LZ4_decompress_safe( //
+        stored.c_str() + sizeof(length),
+        reinterpret_cast<char*>(output),
+        static_cast<int>(stored.size() - sizeof(length)),
+        static_cast<int>(length));
+    return_error_if_m(decompressed == static_cast<int>(length), c_error, error_unknown_k, "Failed to decompress a value");
+}
+
+struct value_buffers_t {
+    std::string stored;
+    std::string decompressed;
+};
+
+/**
+ * @brief Returns a view of the original value, that is only valid until @p buffers are changed.
+ */
+value_view_t materialize(database_t const& db,
+                         pair_t const& pair,
+                         value_buffers_t& buffers,
+                         ustore_error_t* c_error) noexcept {
+    value_view_t stored = read_stored(db, pair, buffers.stored, c_error);
+    if (*c_error || !pair.is_compressed)
+        return stored;
+
+    ustore_length_t length = decompressed_length(stored);
+    safe_section("Allocating a buffer for a decompressed value", c_error, [&] { buffers.decompressed.resize(length); });
+    if (*c_error)
+        return {};
+    decompress(stored, reinterpret_cast<byte_t*>(buffers.decompressed.data()), length, c_error);
+    if (*c_error)
+        return {};
+    return value_view_t {buffers.decompressed.data(), length};
+}
+
+/**
+ * @brief Appends the original value to the @p tape, reading spilled values
+ * through the @p stored_buffer and decompressing straight into the arena.
+ */
+void export_value(database_t const& db,
+                  pair_t const& pair,
+                  growing_tape_t& tape,
+                  std::string& stored_buffer,
+                  ustore_error_t* c_error) noexcept {
+    if (pair.ownership != ownership_t::spilled_k && !pair.is_compressed)
+        return (void)tape.push_back(pair.range, c_error);
+
+    value_view_t stored = read_stored(db, pair, stored_buffer, c_error);
+    return_if_error_m(c_error);
+    if (!pair.is_compressed)
+        return (void)tape.push_back(stored, c_error);
+    ustore_length_t length = decompressed_length(stored);
+    byte_t* output = tape.push_back_uninitialized(length, c_error);
+    return_if_error_m(c_error);
+    decompress(stored, output, length, c_error);
+}
+
+/*********************************************************/
+/*****************	 Writing to Disk	  ****************/
+/*********************************************************/
+
+parquet::StreamWriter open_collection_parquet( //
+    database_t const& db,
+    std::string const& collection_path) noexcept(false) {
+
+    std::shared_ptr<arrow::io::FileOutputStream> out_file;
+    PARQUET_ASSIGN_OR_THROW(out_file, arrow::io::FileOutputStream::Open(collection_path));
+
+    parquet::schema::NodeVector columns {};
+    columns.push_back(parquet::schema::PrimitiveNode::Make( //
+        "key",
+        parquet::Repetition::REQUIRED,
+        parquet::Type::INT64,
+        parquet::ConvertedType::INT_64));
+    columns.push_back(parquet::schema::PrimitiveNode::Make( //
+        "value",
+        parquet::Repetition::OPTIONAL,
+        parquet::Type::BYTE_ARRAY,
+        parquet::ConvertedType::UTF8));
+    columns.push_back(parquet::schema::PrimitiveNode::Make( //
+        "expires_at",
+        parquet::Repetition::REQUIRED,
+        parquet::Type::INT32,
+        parquet::ConvertedType::UINT_32));
+    auto schema = std::static_pointer_cast<parquet::schema::GroupNode>(
+        parquet::schema::GroupNode::Make("schema", parquet::Repetition::REQUIRED, columns));
+    parquet::WriterProperties::Builder builder;
+    if (db.options.compression)
+        builder.compression(parquet::Compression::LZ4);
+    return parquet::StreamWriter {parquet::ParquetFileWriter::Open(out_file, schema, builder.build())};
+}
+
+/**
+ * @brief A pair copied out of the container, with the deadline, that is persisted beside it.
+ */
+struct chunk_row_t {
+    ustore_key_t key = 0;
+    std::optional<std::string> value;
+    expiration_time_t expires_at = 0;
+};
+
+using pairs_chunk_t = std::vector<chunk_row_t>;
+
+/**
+ * @brief Copies up to @p chunk_size pairs of a collection, starting from @p start, into @p chunk.
+ * Every pair is located under a short lock of the container, so concurrent readers and
+ * writers wait for a single lookup at most, and never for the disk.
+ * @return `true`, if the collection may have more pairs past the chunk.
+ */
+bool copy_collection_chunk( //
+    database_t const& db,
+    collection_key_t start,
+    std::size_t chunk_size,
+    pairs_chunk_t& chunk,
+    value_buffers_t& buffers,
+    ustore_error_t* c_error) noexcept(false) {
+
+    chunk.clear();
+    collection_key_t previous = start;
+    bool reached_end = false;
+    auto copy_pair = [&](pair_t const& pair) noexcept {
+        reached_end = pair.collection_key.collection != start.collection;
+        if (reached_end)
+            return;
+        previous = pair.collection_key;
+        safe_section("Copying a chunk of the collection", c_error, [&] {
+            return_if_error_m(c_error);
+            std::optional<std::string> value;
+            if (pair.range.size()) {
+                value_view_t materialized = materialize(db, pair, buffers, c_error);
+                return_if_error_m(c_error);
+                value.emplace(std::string_view(materialized));
+            }
+            chunk.push_back({pair.collection_key.key, std::move(value), pair.expires_at});
+        });
+    };
+
+    auto status = db.pairs.find(start, copy_pair, {});
+    while (status && !*c_error && chunk.size() != chunk_size && !reached_end)
+        status = db.pairs.upper_bound(previous, copy_pair, [&]() noexcept { reached_end = true; });
+    export_error_code(status, c_error);
+    return !*c_error && !reached_end && chunk.size() == chunk_size &&
+           chunk.back().key != std::numeric_limits<ustore_key_t>::max();
+}
+
+/**
+ * @brief Dumps the collection into a Parquet file. The dump is "fuzzy": pairs are copied
+ * out in chunks, so writes, that land in the middle of it, may be partially included.
+ */
+void write_collection_parquet( //
+    database_t const& db,
+    ustore_collection_t collection_id,
+    std::string const& collection_path,
+    ustore_error_t* c_error) noexcept(false) {
+
+    constexpr std::size_t chunk_size = 4 * 1024;
+    parquet::StreamWriter os = open_collection_parquet(db, collection_path);
+    pairs_chunk_t chunk;
+    chunk.reserve(chunk_size);
+    value_buffers_t buffers;
+    collection_key_t start(collection_id, std::numeric_limits<ustore_key_t>::min());
+
+    bool has_more = true;
+    while (has_more) {
+        has_more = copy_collection_chunk(db, start, chunk_size, chunk, buffers, c_error);
+        return_if_error_m(c_error);
+        for (auto const& [key, value, expires_at] : chunk) {
+            std::optional<std::string_view> value_view;
+            if (value)
+                value_view = *value;
+            os << key << value_view << expires_at << parquet::EndRow;
+        }
+        if (has_more)
+            start.key = chunk.back().key + 1;
+    }
+}
+
+/**
+ * @brief Dumps the collection into an Arrow IPC file in batches of up to `batch_size`
+ * rows, that can later be memory-mapped without any parsing. Like the Parquet dump,
+ * it copies pairs out in chunks, and is "fuzzy".
+ */
+void write_collection_arrow( //
+    database_t const& db,
+    ustore_collection_t collection_id,
+    std::string const& collection_path,
+    ustore_error_t* c_error) noexcept(false) {
+
+    constexpr std::int64_t batch_size = 64 * 1024;
+    auto schema = arrow::schema({
+        arrow::field("key", arrow::int64(), false),
+        arrow::field("value", arrow::binary()),
+        arrow::field("expires_at", arrow::uint32(), false),
+    });
+
+    std::shared_ptr<arrow::io::FileOutputStream> out_file;
+    PARQUET_ASSIGN_OR_THROW(out_file, arrow::io::FileOutputStream::Open(collection_path));
+    std::shared_ptr<arrow::ipc::RecordBatchWriter> writer;
+    PARQUET_ASSIGN_OR_THROW(writer, arrow::ipc::MakeFileWriter(out_file, schema));
+
+    arrow::Int64Builder keys;
+    arrow::BinaryBuilder values;
+    arrow::UInt32Builder deadlines;
+    arrow::Status arrow_status;
+    auto flush_batch = [&]() noexcept {
+        std::shared_ptr<arrow::Array> keys_array, values_array, deadlines_array;
+        if (arrow_status = keys.Finish(&keys_array); !arrow_status.ok())
+            return;
+        if (arrow_status = values.Finish(&values_array); !arrow_status.ok())
+            return;
+        if (arrow_status = deadlines.Finish(&deadlines_array); !arrow_status.ok())
+            return;
+        auto batch = arrow::RecordBatch::Make( //
+            schema,
+            keys_array->length(),
+            {keys_array, values_array, deadlines_array});
+        arrow_status = writer->WriteRecordBatch(*batch);
+    };
+
+    constexpr std::size_t chunk_size = 4 * 1024;
+    pairs_chunk_t chunk;
+    chunk.reserve(chunk_size);
+    value_buffers_t buffers;
+    collection_key_t start(collection_id, std::numeric_limits<ustore_key_t>::min());
+
+    bool has_more = true;
+    while (has_more && arrow_status.ok()) {
+        has_more = copy_collection_chunk(db, start, chunk_size, chunk, buffers, c_error);
+        return_if_error_m(c_error);
+        for (auto const& [key, value, expires_at] : chunk) {
+            if (arrow_status = keys.Append(key); !arrow_status.ok())
+                break;
+            if (arrow_status = deadlines.Append(expires_at); !arrow_status.ok())
+                break;
+            arrow_status = value //
+                               ? values.Append(reinterpret_cast<std::uint8_t const*>(value->data()),
+                                               static_cast<std::int32_t>(value->size()))
+                               : values.AppendNull();
+            if (arrow_status.ok() && keys.length() == batch_size)
+                flush_batch();
+            if (!arrow_status.ok())
+                break;
+        }
+        if (has_more)
+            start.key = chunk.back().key + 1;
+    }
+
+    if (arrow_status.ok() && keys.length())
+        flush_batch();
+    return_error_if_m(arrow_status.ok(), c_error, error_unknown_k, "Failed to write Arrow snapshot");
+    PARQUET_THROW_NOT_OK(writer->Close());
+    PARQUET_THROW_NOT_OK(out_file->Close());
+}
+
+/**
+ * @brief Dumps the collection, as it was, when the snapshot was taken, into a Parquet file.
+ * Pairs are copied out in chunks under a shared `database_t::snapshots_mutex`, so writers
+ * wait for a single chunk at most, and never for the disk.
+ */
+void write_snapshot_collection( //
+    database_t& db,
+    ustore_snapshot_t snapshot_id,
+    ustore_collection_t collection_id,
+    std::string const& collection_path,
+    ustore_error_t* c_error) noexcept(false) {
+
+    constexpr std::size_t chunk_size = 4 * 1024;
+    parquet::StreamWriter os = open_collection_parquet(db, collection_path);
+    pairs_chunk_t chunk;
+    chunk.reserve(chunk_size);
+    value_buffers_t buffers;
+    collection_key_t start {collection_id, std::numeric_limits<ustore_key_t>::min()};
+
+    bool has_more = true;
+    while (has_more) {
+        chunk.clear();
+        {
+            std::shared_lock<shared_mutex_t> _ {db.snapshots_mutex};
+            snapshot_t const* snapshot = find_snapshot(db, snapshot_id, c_error);
+            return_if_error_m(c_error);
+            auto end_key = std::numeric_limits<ustore_key_t>::max();
+            auto status = scan_snapshot(db, *snapshot, start, end_key, chunk_size, [&](pair_t const& pair) noexcept {
+                safe_section("Copying a chunk of the snapshot", c_error, [&] {
+                    return_if_error_m(c_error);
+                    std::optional<std::string> value;
+                    if (pair.range.size()) {
+                        value_view_t materialized = materialize(db, pair, buffers, c_error);
+                        return_if_error_m(c_error);
+                        value.emplace(std::string_view(materialized));
+                    }
+                    chunk.push_back({pair.collection_key.key, std::move(value), pair.expires_at});
+                });
+            });
+            export_error_code(status, c_error);
+            return_if_error_m(c_error);
+        }
+
+        for (auto const& [key, value, expires_at] : chunk) {
+            std::optional<std::string_view> value_view;
+            if (value)
+                value_view = *value;
+            os << key << value_view << expires_at << parquet::EndRow;
+        }
+        has_more = chunk.size() == chunk_size;
+        if (has_more)
+            start.key = chunk.back().key + 1;
+    }
+}
+
+std::string_view snapshot_extension(database_t const& db) noexcept {
+    return db.options.snapshot_format == snapshot_format_t::arrow_k ? ".arrow" : ".parquet";
+}
+
+void write_collection( //
+    database_t const& db,
+    ustore_collection_t collection_id,
+    std::string const& collection_path,
+    ustore_error_t* c_error) noexcept(false) {
+    if (db.options.snapshot_format == snapshot_format_t::arrow_k)
+        write_collection_arrow(db, collection_id, collection_path, c_error);
+    else
+        write_collection_parquet(db, collection_id, collection_path, c_error);
+}
+
+bool ends_with(std::string_view str, std::string_view suffix) noexcept {
+    return str.size() >= suffix.size() &&
+           0 == str.compare(str.size() - suffix.size(), suffix.size(), suffix.data(), suffix.size());
+}
+
+/**
+ * @brief Picks one of the `data_directories` for the collection snapshot.
+ * The choice depends only on the name, so the same collection keeps landing
+ * on the same disk, while different collections are spread evenly.
+ */
+std::string const& collection_directory(database_t const& db, std::string_view collection_name) noexcept {
+    auto hash = log_checksum(value_view_t {collection_name.data(), collection_name.size()});
+    return db.data_directories[hash % db.data_directories.size()];
+}
+
+/**
+ * @brief Lists the directories, that may contain snapshots: the configured and
+ * the root one, which may still hold files written before the reconfiguration.
+ */
+std::vector<std::string> snapshot_directories(database_t const& db) noexcept(false) {
+    std::vector<std::string> dirs = db.data_directories;
+    if (std::find(dirs.begin(), dirs.end(), db.persisted_directory) == dirs.end())
+        dirs.push_back(db.persisted_directory);
+    dirs.erase(std::remove_if(dirs.begin(), dirs.end(), [](auto const& dir) { return !stdfs::is_directory(dir); }),
+               dirs.end());
+    return dirs;
+}
+
+/**
+ * @brief Dumps the listed collections into temporary files, replacing the old ones
+ * only when all are ready, and removes the files of dropped collections.
+ * The old files may still be memory-mapped, so they are never overwritten in-place.
+ * Collections are striped across `data_directories` and are written in parallel,
+ * so multiple disks are kept busy at once.
+ */
+template <typename names_at>
+void write(database_t const& db, names_at const& names, ustore_error_t* c_error) noexcept(false) {
+
+    // Check if the target directories even exist
+    std::vector<std::string> dirs = snapshot_directories(db);
+    if (dirs.empty())
+        return;
+
+    std::string extension {snapshot_extension(db)};
+    std::vector<std::pair<ustore_collection_t, std::string>> collections;
+    collections.reserve(names.size() + 1);
+    collections.emplace_back(ustore_collection_main_k, std::string {});
+    for (auto const& [collection_name, collection_id] : names)
+        collections.emplace_back(collection_id, collection_name);
+
+    std::vector<std::string> paths(collections.size());
+    std::vector<ustore_error_t> errors(collections.size(), nullptr);
+    parallel_for(collections.size(), [&](std::size_t idx) {
+        ustore_error_t* c_collection_error = &errors[idx];
+        auto const& [collection_id, collection_name] = collections[idx];
+        paths[idx] = stdfs::path(collection_directory(db, collection_name)) / (collection_name + extension);
+        safe_section("Writing collection", c_collection_error, [&] {
+            write_collection(db, collection_id, paths[idx] + ".tmp", c_collection_error);
+        });
+    });
+    for (ustore_error_t error : errors)
+        return_error_if_m(!error, c_error, error_unknown_k, error);
+
+    for (auto const& collection_path : paths)
+        stdfs::rename(collection_path + ".tmp", collection_path);
+
+    // Remove files of the dropped collections and the ones, that moved to other disks
+    for (auto const& dir_path : dirs) {
+        for (auto const& dir_entry : std::filesystem::directory_iterator {dir_path}) {
+            std::string collection_name = dir_entry.path().filename();
+            if (!ends_with(collection_name, extension))
+                continue;
+            collection_name.resize(collection_name.size() - extension.size());
+            bool is_present = collection_name.empty() || names.find(collection_name) != names.end();
+            bool is_in_place = collection_directory(db, collection_name) == dir_path;
+            if (!is_present || !is_in_place)
+                stdfs::remove(dir_entry.path());
+        }
+    }
+}
+
+void write(database_t const& db, ustore_error_t* c_error) noexcept(false) {
+    write(db, db.names, c_error);
+}
+
+/**
+ * @brief Loads a single persisted collection one row group at a time,
+ * copying values straight from the Arrow buffers into our blobs.
+ * Rows are sorted by key, so every row group is inserted as one batch.
+ * Files, written before the deadlines were persisted, have no "expires_at" column.
+ */
+void read_collection_parquet( //
+    database_t& db,
+    ustore_collection_t collection_id,
+    std::string const& collection_path,
+    ustore_error_t* c_error) noexcept(false) {
+
+    std::shared_ptr<arrow::io::ReadableFile> in_file;
+    PARQUET_ASSIGN_OR_THROW(in_file, arrow::io::ReadableFile::Open(collection_path));
+    std::unique_ptr<parquet::arrow::FileReader> reader;
+    PARQUET_THROW_NOT_OK(parquet::arrow::OpenFile(in_file, arrow::default_memory_pool(), &reader));
+
+    std::vector<pair_t> pairs;
+    for (int group_idx = 0; group_idx != reader->num_row_groups(); ++group_idx) {
+        std::shared_ptr<arrow::Table> table;
+        PARQUET_THROW_NOT_OK(reader->ReadRowGroup(group_idx, &table));
+        PARQUET_ASSIGN_OR_THROW(table, table->CombineChunks());
+        if (!table->num_rows())
+            continue;
+
+        auto keys = std::static_pointer_cast<arrow::Int64Array>(table->column(0)->chunk(0));
+        auto values = std::static_pointer_cast<arrow::BinaryArray>(table->column(1)->chunk(0));
+        std::shared_ptr<arrow::UInt32Array> deadlines;
+        if (auto column = table->GetColumnByName("expires_at"); column && db.options.expiration.enabled())
+            deadlines = std::static_pointer_cast<arrow::UInt32Array>(column->chunk(0));
+        pairs.clear();
+        pairs.reserve(static_cast<std::size_t>(table->num_rows()));
+        for (std::int64_t row_idx = 0; row_idx != keys->length(); ++row_idx) {
+            collection_key_t key {collection_id, keys->Value(row_idx)};
+            value_view_t value = values->IsNull(row_idx) //
+                                     ? value_view_t::make_empty()
+                                     : value_view_t {values->GetView(row_idx)};
+            pairs.push_back(pair_t::compressed(key, value, compression_threshold(db), db.blobs, c_error));
+            return_if_error_m(c_error);
+            if (deadlines)
+                pairs.back().expires_at = deadlines->Value(row_idx);
+        }
+
+        track_recency(db, pairs.size(), [&](std::size_t i) {
+            return std::make_pair(pairs[i].collection_key, static_cast<ustore_length_t>(pairs[i].range.size()));
+        });
+        auto status = db.pairs.upsert(std::make_move_iterator(pairs.begin()), std::make_move_iterator(pairs.end()));
+        export_error_code(status, c_error);
+        return_if_error_m(c_error);
+        enforce_memory_limit(db);
+    }
+}
+
+/**
+ * @brief Memory-maps an Arrow IPC snapshot, pointing the values straight into the
+ * mapped pages. Those are never modified, as every write produces a new pair.
+ */
+void read_collection_arrow( //
+    database_t& db,
+    ustore_collection_t collection_id,
+    std::string const& collection_path,
+    ustore_error_t* c_error) noexcept(false) {
+
+    std::shared_ptr<arrow::io::MemoryMappedFile> in_file;
+    PARQUET_ASSIGN_OR_THROW(in_file,
+                            arrow::io::MemoryMappedFile::Open(collection_path, arrow::io::FileMode::READ));
+    std::shared_ptr<arrow::ipc::RecordBatchFileReader> reader;
+    PARQUET_ASSIGN_OR_THROW(reader, arrow::ipc::RecordBatchFileReader::Open(in_file));
+
+    std::vector<pair_t> pairs;
+    for (int batch_idx = 0; batch_idx != reader->num_record_batches(); ++batch_idx) {
+        std::shared_ptr<arrow::RecordBatch> batch;
+        PARQUET_ASSIGN_OR_THROW(batch, reader->ReadRecordBatch(batch_idx));
+
+        auto keys = std::static_pointer_cast<arrow::Int64Array>(batch->column(0));
+        auto values = std::static_pointer_cast<arrow::BinaryArray>(batch->column(1));
+        std::shared_ptr<arrow::UInt32Array> deadlines;
+        if (auto column = batch->GetColumnByName("expires_at"); column && db.options.expiration.enabled())
+            deadlines = std::static_pointer_cast<arrow::UInt32Array>(column);
+        pairs.clear();
+        pairs.reserve(static_cast<std::size_t>(batch->num_rows()));
+        for (std::int64_t row_idx = 0; row_idx != keys->length(); ++row_idx) {
+            collection_key_t key {collection_id, keys->Value(row_idx)};
+            if (values->IsNull(row_idx))
+                pairs.push_back(pair_t::borrowed(key, value_view_t::make_empty()));
+            else
+                pairs.push_back(pair_t::borrowed(key, value_view_t {values->GetView(row_idx)}));
+            if (deadlines)
+                pairs.back().expires_at = deadlines->Value(row_idx);
+        }
+
+        {
+            std::unique_lock _ {db.mapped_batches_mutex};
+            db.mapped_batches.push_back(batch);
+        }
+        auto status = db.pairs.upsert(std::make_move_iterator(pairs.begin()), std::make_move_iterator(pairs.end()));
+        export_error_code(status, c_error);
+        return_if_error_m(c_error);
+    }
+}
+
+void read(database_t& db, ustore_error_t* c_error) noexcept(false) {
+
+    // Clear the DB, before refilling it
+    db.names.clear();
+    auto status = db.pairs.clear();
+    export_error_code(status, c_error);
+    return_if_error_m(c_error);
+
+    // Enumerate all persisted collections on all disks, registering their names upfront.
+    // If the directories were reconfigured, the same collection may be found twice,
+    // but only the copy in the expected directory is up to date.
+    std::string_view extension = snapshot_extension(db);
+    std::vector<std::pair<ustore_collection_t, std::string>> collections;
+    std::map<std::string, std::size_t> collections_offsets;
+    for (auto const& dir_path : snapshot_directories(db)) {
+        for (auto const& dir_entry : std::filesystem::directory_iterator {dir_path}) {
+            auto const& collection_path = dir_entry.path();
+            std::string collection_name = collection_path.filename();
+            if (!ends_with(collection_name, extension))
+                continue;
+
+            collection_name.resize(collection_name.size() - extension.size());
+            auto offset_it = collections_offsets.find(collection_name);
+            if (offset_it != collections_offsets.end()) {
+                if (collection_directory(db, collection_name) == dir_path)
+                    collections[offset_it->second].second = collection_path;
+                continue;
+            }
+
+            ustore_collection_t collection_id =
+                collection_name.empty() ? ustore_collection_main_k : new_collection(db);
+            if (!collection_name.empty())
+                db.names.emplace(collection_name, collection_id);
+            collections_offsets.emplace(collection_name, collections.size());
+            collections.emplace_back(collection_id, collection_path);
+        }
+    }
+
+    // Load them in parallel, as the `ucset_t` synchronizes the insertions
+    std::vector<ustore_error_t> errors(collections.size(), nullptr);
+    parallel_for(collections.size(), [&](std::size_t idx) {
+        ustore_error_t* c_collection_error = &errors[idx];
+        auto const& [collection_id, collection_path] = collections[idx];
+        safe_section("Reading collection", c_collection_error, [&] {
+            if (db.options.snapshot_format == snapshot_format_t::arrow_k)
+                read_collection_arrow(db, collection_id, collection_path, c_collection_error);
+            else
+                read_collection_parquet(db, collection_id, collection_path, c_collection_error);
+        });
+    });
+
+    for (ustore_error_t error : errors)
+        return_error_if_m(!error, c_error, error_unknown_k, error);
+}
+
+/*********************************************************/
+/*****************	 Write-Ahead Logging  ****************/
+/*********************************************************/
+
+/**
+ * Every change to the state is appended to the log as a single record.
+ * Records only contain final values, so replaying them is idempotent.
+ * Checkpoints rotate the log and dump a "fuzzy" snapshot to Parquet, while
+ * writers keep going. Because of that idempotency, replaying the logs, that
+ * haven't been removed yet, on top of any set of Parquet files yields the
+ * latest state, even if a checkpoint was interrupted half-way.
+ */
+enum class log_record_kind_t : std::uint8_t {
+    upserts_k = 1,
+    collection_create_k = 2,
+    collection_drop_k = 3,
+    erase_range_k = 4,
+    /// Like `upserts_k`, but every value is followed by its deadline.
+    expiring_upserts_k = 5,
+};
+
+template <typename scalar_at>
+void log_append(std::string& record, scalar_at scalar) noexcept(false) {
+    record.append(reinterpret_cast<char const*>(&scalar), sizeof(scalar_at));
+}
+
+/**
+ * @brief Appends an entry of an `upserts_k` record, or of an `expiring_upserts_k` one,
+ * if the @p expires_at deadline is passed.
+ */
+void log_append_upsert(std::string& record,
+                       collection_key_t key,
+                       value_view_t value,
+                       std::optional<expiration_time_t> expires_at = std::nullopt) noexcept(false) {
+    log_append(record, key.collection);
+    log_append(record, key.key);
+    log_append(record, value ? static_cast<ustore_length_t>(value.size()) : ustore_length_missing_k);
+    if (value.size())
+        record.append(value.c_str(), value.size());
+    if (expires_at)
+        log_append(record, *expires_at);
+}
+
+/**
+ * @brief Deadlines are only logged, if some collections may expire.
+ */
+log_record_kind_t upserts_kind(database_t const& db) noexcept {
+    return db.options.expiration.enabled() ? log_record_kind_t::expiring_upserts_k : log_record_kind_t::upserts_k;
+}
+
+struct log_parser_t {
+    byte_t const* begin;
+    byte_t const* end;
+
+    template <typename scalar_at>
+    bool pop(scalar_at& scalar) noexcept {
+        if (static_cast<std::size_t>(end - begin) < sizeof(scalar_at))
+            return false;
+        std::memcpy(&scalar, begin, sizeof(scalar_at));
+        begin += sizeof(scalar_at);
+        return true;
+    }
+
+    bool pop(value_view_t& value, std::size_t length) noexcept {
+        if (static_cast<std::size_t>(end - begin) < length)
+            return false;
+        value = value_view_t {begin, length};
+        begin += length;
+        return true;
+    }
+
+    bool empty() const noexcept { return begin == end; }
+};
+
+std::string log_path(std::string const& dir_path, std::size_t sequence) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016zu.wal", sequence);
+    return stdfs::path(dir_path) / name;
+}
+
+/**
+ * @brief Lists the log files in the directory, sorted by their sequence numbers.
+ */
+std::vector<std::pair<std::size_t, std::string>> list_logs(std::string const& dir_path) noexcept(false) {
+    std::vector<std::pair<std::size_t, std::string>> logs;
+    if (!std::filesystem::is_directory(dir_path))
+        return logs;
+
+    std::string_view extension {".wal"};
+    for (auto const& dir_entry : std::filesystem::directory_iterator {dir_path}) {
+        std::string file_name = dir_entry.path().filename();
+        if (!ends_with(file_name, extension))
+            continue;
+        char* parsed_end = nullptr;
+        std::size_t sequence = std::strtoull(file_name.c_str(), &parsed_end, 10);
+        if (parsed_end != file_name.c_str() + file_name.size() - extension.size())
+            continue;
+        logs.emplace_back(sequence, dir_entry.path());
+    }
+    std::sort(logs.begin(), logs.end());
+    return logs;
+}
+
+void remove_logs(std::string const& dir_path, std::size_t sequence_limit) noexcept(false) {
+    for (auto const& [sequence, path] : list_logs(dir_path))
+        if (sequence < sequence_limit)
+            stdfs::remove(path);
+}
+
+/**
+ * @brief Appends the record, flushing it to persistent memory if was requested.
+ * Must be called under `database_t::log_mutex`.
+ */
+void log_record(database_t& db, std::string const& record, ustore_options_t options, ustore_error_t* c_error) {
+    auto status = db.log.append(std::string_view(record));
+    return_error_if_m(status, c_error, error_unknown_k, "Failed to append to write-ahead log");
+
+    if (options & ustore_option_write_flush_k) {
+        status = db.log.sync();
+        return_error_if_m(status, c_error, error_unknown_k, "Failed to flush write-ahead log");
+    }
+
+    if (db.log.size() >= db.options.checkpoint_size + db.log_size_after_rotation)
+        db.checkpointer_wakeup.notify_one();
+}
+
+/**
+ * @brief Closes the current log and starts a new one, that begins with the
+ * definitions of all present collections, as IDs are not preserved in Parquet files.
+ * Must be called under `database_t::log_mutex` and a shared `database_t::restructuring_mutex`.
+ */
+void rotate_log(database_t& db, ustore_error_t* c_error) noexcept(false) {
+    auto status = db.log.sync();
+    return_error_if_m(status, c_error, error_unknown_k, "Failed to flush write-ahead log");
+    status = db.log.close();
+    return_error_if_m(status, c_error, error_unknown_k, "Failed to close write-ahead log");
+
+    ++db.log_sequence;
+    status = db.log.open(log_path(db.persisted_directory, db.log_sequence).c_str());
+    return_error_if_m(status, c_error, error_unknown_k, "Failed to open write-ahead log");
+
+    std::string record;
+    for (auto const& [name, id] : db.names) {
+        record.clear();
+        log_append(record, log_record_kind_t::collection_create_k);
+        log_append(record, id);
+        record.append(name);
+        status = db.log.append(std::string_view(record));
+        return_error_if_m(status, c_error, error_unknown_k, "Failed to append to write-ahead log");
+    }
+    db.log_size_after_rotation = db.log.size();
+}
+
+/**
+ * @brief Applies all the records from a single log file.
+ * @param ids Maps collection IDs from the log to the ones currently in use.
+ */
+void replay(database_t& db,
+            std::string const& path,
+            std::unordered_map<ustore_collection_t, ustore_collection_t>& ids,
+            ustore_error_t* c_error) noexcept(false) {
+
+    std::vector<pair_t> pairs;
+    auto status = write_ahead_log_t::replay(path.c_str(), [&](value_view_t record) {
+        log_parser_t parser {record.begin(), record.end()};
+        log_record_kind_t kind;
+        if (!parser.pop(kind))
+            return false;
+
+        switch (kind) {
+        case log_record_kind_t::upserts_k:
+        case log_record_kind_t::expiring_upserts_k: {
+            bool const has_deadlines = kind == log_record_kind_t::expiring_upserts_k;
+            pairs.clear();
+            while (!parser.empty()) {
+                collection_key_t key;
+                ustore_length_t length;
+                value_view_t value;
+                expiration_time_t expires_at = 0;
+                if (!parser.pop(key.collection) || !parser.pop(key.key) || !parser.pop(length))
+                    return false;
+                if (length != ustore_length_missing_k && !parser.pop(value, length))
+                    return false;
+                if (has_deadlines && !parser.pop(expires_at))
+                    return false;
+
+                if (key.collection != ustore_collection_main_k) {
+                    auto id_it = ids.find(key.collection);
+                    if (id_it == ids.end())
+                        continue;
+                    key.collection = id_it->second;
+                }
+                pairs.push_back(pair_t::compressed(key, value, compression_threshold(db), db.blobs, c_error));
+                if (*c_error)
+                    return false;
+                if (db.options.expiration.enabled())
+                    pairs.back().expires_at = expires_at;
+            }
+            export_error_code(db.pairs.upsert(std::make_move_iterator(pairs.begin()),
+                                              std::make_move_iterator(pairs.end())),
+                              c_error);
+            return !*c_error;
+        }
+        case log_record_kind_t::collection_create_k: {
+            ustore_collection_t id;
+            value_view_t name;
+            if (!parser.pop(id) || !parser.pop(name, parser.end - parser.begin))
+                return false;
+
+            auto name_it = db.names.find(std::string_view(name));
+            if (name_it != db.names.end()) {
+                ids[id] = name_it->second;
+                return true;
+            }
+            ustore_collection_t new_id = new_collection(db);
+            db.names.emplace(std::string_view(name), new_id);
+            ids[id] = new_id;
+            return true;
+        }
+        case log_record_kind_t::collection_drop_k: {
+            ustore_collection_t id;
+            ustore_drop_mode_t mode;
+            if (!parser.pop(id) || !parser.pop(mode))
+                return false;
+
+            auto id_it = ids.find(id);
+            if (id != ustore_collection_main_k && id_it == ids.end())
+                return true;
+            drop_collection(db, id == ustore_collection_main_k ? id : id_it->second, mode, c_error);
+            if (mode == ustore_drop_keys_vals_handle_k && id_it != ids.end())
+                ids.erase(id_it);
+            return !*c_error;
+        }
+        case log_record_kind_t::erase_range_k: {
+            while (!parser.empty()) {
+                collection_key_t start;
+                ustore_key_t end_key;
+                if (!parser.pop(start.collection) || !parser.pop(start.key) || !parser.pop(end_key))
+                    return false;
+
+                if (start.collection != ustore_collection_main_k) {
+                    auto id_it = ids.find(start.collection);
+                    if (id_it == ids.end())
+                        continue;
+                    start.collection = id_it->second;
+                }
+                auto status = db.pairs.erase_range(start, collection_key_t {start.collection, end_key}, no_op_t {});
+                if (!status)
+                    return false;
+            }
+            return true;
+        }
+        default: return false;
+        }
+    });
+    return_error_if_m(status, c_error, error_unknown_k, "Failed to replay write-ahead log");
+}
+
+/**
+ * @brief Folds the current state into snapshot files, so that the older logs can be removed.
+ * Writers are blocked for the duration of log rotation. After that, collections are
+ * copied out in chunks, each holding the container lock for a single lookup at a time,
+ * and the disk is written without any locks.
+ */
+void checkpoint(database_t& db, ustore_error_t* c_error) noexcept(false) {
+
+    std::size_t sequence = 0;
+    std::map<std::string, ustore_collection_t, string_less_t> names;
+    {
+        std::shared_lock _ {db.restructuring_mutex};
+        std::unique_lock log_lock {db.log_mutex};
+        rotate_log(db, c_error);
+        return_if_error_m(c_error);
+        sequence = db.log_sequence;
+        names = db.names;
+    }
+
+    write(db, names, c_error);
+    return_if_error_m(c_error);
+    remove_logs(db.persisted_directory, sequence);
+}
+
+void checkpoint_in_background(database_t& db) noexcept {
+    std::unique_lock log_lock {db.log_mutex};
+    auto interval = std::chrono::milliseconds(db.options.checkpoint_interval_ms);
+    while (!db.checkpointer_stop) {
+        db.checkpointer_wakeup.wait_for(log_lock, interval, [&] {
+            return db.checkpointer_stop ||
+                   db.log.size() >= db.options.checkpoint_size + db.log_size_after_rotation;
+        });
+        if (db.checkpointer_stop || db.log.size() == db.log_size_after_rotation)
+            continue;
+
+        // Checkpoints need the `restructuring_mutex`, which must be locked first
+        log_lock.unlock();
+        ustore_error_t c_error = nullptr;
+        safe_section("Checkpointing", &c_error, [&] { checkpoint(db, &c_error); });
+        log_lock.lock();
+    }
+}
+
+/*********************************************************/
+/*****************	Erasures & Expiration	  ****************/
+/*********************************************************/
+
+/**
+ * @brief Deadline for a value, that is being written into the @p collection at @p now,
+ * or zero, if it never expires. Must be called under a shared `database_t::restructuring_mutex`.
+ */
+expiration_time_t expiration_deadline(database_t const& db,
+                                      ustore_collection_t collection,
+                                      expiration_time_t now) noexcept {
+    if (!now)
+        return 0;
+    auto it = db.ttls.find(collection);
+    return it != db.ttls.end() ? now + it->second : 0;
+}
+
+/**
+ * @brief Refreshes the lifetimes of collections, after the values and their persisted deadlines
+ * were loaded from disk. Values without deadlines, like the ones from older snapshots or from
+ * collections, that just got a lifetime, get a full one. Deadlines past the current lifetime
+ * are shortened, and the ones in collections, that no longer expire, are cleared.
+ * Must be called before the DB is shared.
+ */
+void assign_ttls(database_t& db, ustore_error_t* c_error) noexcept {
+    safe_section("Assigning lifetimes", c_error, [&] {
+        db.ttls.clear();
+        if (expiration_time_t ttl = db.options.expiration.ttl_for({}); ttl)
+            db.ttls[ustore_collection_main_k] = ttl;
+        for (auto const& [name, id] : db.names)
+            if (expiration_time_t ttl = db.options.expiration.ttl_for(name); ttl)
+                db.ttls[id] = ttl;
+    });
+    return_if_error_m(c_error);
+
+    expiration_time_t const now = expiration_now();
+    auto refresh = [&](ustore_collection_t id) noexcept {
+        expiration_time_t deadline = expiration_deadline(db, id, now);
+        return db.pairs.range(id, id + 1, [&](pair_t& pair) noexcept {
+            if (!deadline || !pair.expires_at || pair.expires_at > deadline)
+                pair.expires_at = deadline;
+        });
+    };
+    auto status = refresh(ustore_collection_main_k);
+    for (auto it = db.names.begin(); status && it != db.names.end(); ++it)
+        status = refresh(it->second);
+    export_error_code(status, c_error);
+}
+
+/**
+ * @brief Erases a group of pairs atomically, with all the bookkeeping of `ustore_write()`.
+ * @param select Callback, that passes every present pair to be erased into its argument.
+ * Is called under the same locks, as the @p erase, so the selection can't go stale.
+ * @param erase Callback, that removes the selected keys from `database_t::pairs`.
+ * @param serialize Callback, that appends the erasure to a write-ahead log record.
+ */
+template <typename select_at, typename erase_at, typename serialize_at>
+void erase_selected(database_t& db,
+                    ustore_options_t options,
+                    select_at&& select,
+                    erase_at&& erase,
+                    serialize_at&& serialize,
+                    ustore_error_t* c_error) noexcept {
+
+    std::unique_lock<std::mutex> log_lock {db.log_mutex, std::defer_lock};
+    if (db.options.write_ahead_log)
+        log_lock.lock();
+    std::unique_lock<std::mutex> changes_lock {db.changes.mutex(), std::defer_lock};
+    if (db.changes.is_open())
+        changes_lock.lock();
+
+    // The erased pairs are only known after the selection, so the before-images
+    // are preserved during it, while no other writer can hold the lock
+    snapshots_lock_t snapshots_lock = lock_snapshots_for_write(db, [] {});
+    keys_lock_t keys_lock = lock_all_keys(db);
+    stats_deltas_t deltas;
+    std::vector<collection_key_t> keys;
+    auto status = select([&](pair_t const& pair) noexcept {
+        if (*c_error)
+            return;
+        if (snapshots_lock.unique)
+            preserve_before_image(db, pair, c_error);
+        return_if_error_m(c_error);
+        safe_section("Collecting erased keys", c_error, [&] {
+            keys.push_back(pair.collection_key);
+            deltas.add(pair.collection_key.collection, -1, -static_cast<std::ptrdiff_t>(pair.range.size()));
+        });
+    });
+    if (!status)
+        return export_error_code(status, c_error);
+    return_if_error_m(c_error);
+    reserve_stats(db, deltas, c_error);
+    return_if_error_m(c_error);
+
+    std::string record;
+    if (db.options.write_ahead_log)
+        safe_section("Serializing log record", c_error, [&] { serialize(record, keys); });
+    std::string change_entries;
+    if (db.changes.is_open())
+        safe_section("Serializing changes", c_error, [&] {
+            for (collection_key_t key : keys)
+                change_log_t::serialize(change_entries, key, value_view_t {});
+        });
+    return_if_error_m(c_error);
+
+    // Log before erasing, so a failed append leaves the pairs in place
+    if (db.options.write_ahead_log) {
+        log_record(db, record, options, c_error);
+        return_if_error_m(c_error);
+    }
+
+    status = erase(keys);
+    if (!status)
+        return export_error_code(status, c_error);
+    apply_stats(db, deltas);
+    keys_lock = {};
+    snapshots_lock = {};
+    log_lock = {};
+    if (db.changes.is_open() && !*c_error) {
+        auto status = db.changes.append(change_entries, keys.size(), options & ustore_option_write_flush_k);
+        log_error_if_m(status, c_error, error_unknown_k, "Failed to append to change-log");
+    }
+    changes_lock = {};
+
+    track_recency(db, keys.size(), [&](std::size_t i) { return std::make_pair(keys[i], ustore_length_missing_k); });
+}
+
+/**
+ * @brief Removes the expired values of every expiring collection in small batches,
+ * so that the writers are never blocked for long.
+ */
+void sweep_expired(database_t& db, ustore_error_t* c_error) noexcept {
+    constexpr std::size_t batch_size_k = 4096;
+
+    std::vector<ustore_collection_t> collections;
+    {
+        std::shared_lock<shared_mutex_t> _ {db.restructuring_mutex};
+        safe_section("Listing expiring collections", c_error, [&] {
+            for (auto const& id_and_ttl : db.ttls)
+                collections.push_back(id_and_ttl.first);
+        });
+    }
+    std::vector<collection_key_t> expired;
+    std::vector<pair_t> removals;
+    safe_section("Allocating expired keys", c_error, [&] {
+        expired.reserve(batch_size_k);
+        removals.reserve(batch_size_k);
+    });
+    return_if_error_m(c_error);
+
+    for (ustore_collection_t collection : collections) {
+        collection_key_t next {collection, std::numeric_limits<ustore_key_t>::min()};
+        bool reached_end = false;
+        while (!reached_end && !*c_error) {
+            expiration_time_t const now = expiration_now();
+            std::size_t visited = 0;
+            expired.clear();
+            auto status = scan_and_watch( //
+                db.pairs,
+                next,
+                std::numeric_limits<ustore_key_t>::max(),
+                batch_size_k,
+                ustore_options_default_k,
+                [&](pair_t const& pair) noexcept {
+                    ++visited;
+                    next.key = pair.collection_key.key;
+                    if (pair && pair.is_expired(now))
+                        expired.push_back(pair.collection_key);
+                });
+            if (!status)
+                return export_error_code(status, c_error);
+            reached_end = visited != batch_size_k || next.key == std::numeric_limits<ustore_key_t>::max();
+            if (!reached_end)
+                ++next.key;
+            if (expired.empty())
+                continue;
+
+            // Values could have been overwritten, since they were scanned
+            erase_selected(
+                db,
+                ustore_options_default_k,
+                [&](auto&& visit) noexcept {
+                    ucset::status_t status;
+                    for (std::size_t i = 0; i != expired.size() && status; ++i)
+                        status = db.pairs.find(
+                            expired[i],
+                            [&](pair_t const& pair) noexcept {
+                                if (pair && pair.is_expired(now))
+                                    visit(pair);
+                            },
+                            []() noexcept {});
+                    return status;
+                },
+                [&](std::vector<collection_key_t> const& keys) noexcept {
+                    // Like in `ustore_write()`, removals are upserts of missing values
+                    removals.clear();
+                    for (collection_key_t key : keys)
+                        removals.emplace_back(key);
+                    return db.pairs.upsert(std::make_move_iterator(removals.begin()),
+                                           std::make_move_iterator(removals.end()));
+                },
+                [&](std::string& record, std::vector<collection_key_t> const& keys) {
+                    log_append(record, log_record_kind_t::upserts_k);
+                    for (collection_key_t key : keys)
+                        log_append_upsert(record, key, value_view_t {});
+                },
+                c_error);
+        }
+    }
+}
+
+void sweep_in_background(database_t& db) noexcept {
+    std::unique_lock sweeper_lock {db.sweeper_mutex};
+    auto interval = std::chrono::seconds(db.options.expiration.sweep_interval);
+    while (!db.sweeper_stop) {
+        db.sweeper_wakeup.wait_for(sweeper_lock, interval, [&] { return db.sweeper_stop; });
+        if (db.sweeper_stop)
+            break;
+
+        sweeper_lock.unlock();
+        ustore_error_t c_error = nullptr;
+        sweep_expired(db, &c_error);
+        sweeper_lock.lock();
+    }
+}
+
+/**
+ * @brief Half-open range of keys in a single collection, to be erased.
+ */
+struct erased_range_t {
+    collection_key_t start;
+    ustore_key_t end_key;
+};
+
+/**
+ * @brief Sorts the ranges and merges the overlapping ones, so that no pair is accounted twice.
+ */
+void merge_ranges(std::vector<erased_range_t>& ranges) noexcept {
+    std::sort(ranges.begin(), ranges.end(), [](erased_range_t const& a, erased_range_t const& b) {
+        return a.start < b.start;
+    });
+    std::size_t merged_count = 0;
+    for (erased_range_t const& range : ranges) {
+        erased_range_t* last = merged_count ? &ranges[merged_count - 1] : nullptr;
+        if (last && last->start.collection == range.start.collection && range.start.key <= last->end_key)
+            last->end_key = std::max(last->end_key, range.end_key);
+        else
+            ranges[merged_count++] = range;
+    }
+    ranges.resize(merged_count);
+}
+
+/*********************************************************/
+/*****************	    C Interface 	  ****************/
+/*********************************************************/
+
+void ustore_database_init(ustore_database_init_t* c_ptr) {
+
+    ustore_database_init_t& c = *c_ptr;
+    safe_section("Initializing DBMS", c.error, [&] {
+        auto maybe_pairs = ucset_t::make();
+        return_error_if_m(maybe_pairs, c.error, error_unknown_k, "Couldn't build consistent set");
+        auto db_ptr = std::make_unique<database_t>(std::move(maybe_pairs).value());
+
+        if (c.config && std::strlen(c.config) > 0) {
+            // Load config
+            config_t config;
+            auto status = config_loader_t::load_from_json_string(c.config, config);
+            return_error_if_m(status, c.error, args_wrong_k, status.message());
+
+            // Root path
+            stdfs::path root = config.directory;
+            stdfs::file_status root_status = stdfs::status(root);
+            return_error_if_m(root_status.type() == stdfs::file_type::directory,
+                              c.error,
+                              args_wrong_k,
+                              "Root isn't a directory");
+
+            // Storage paths, across which the collections are striped
+            for (auto const& disk : config.data_directories) {
+                stdfs::file_status disk_status = stdfs::status(disk.path);
+                return_error_if_m(disk_status.type() == stdfs::file_type::directory,
+                                  c.error,
+                                  args_wrong_k,
+                                  "Data directory isn't a directory");
+                db_ptr->data_directories.push_back(disk.path);
+            }
+            if (db_ptr->data_directories.empty())
+                db_ptr->data_directories.push_back(root);
+
+            // Engine config
+            return_error_if_m(config.engine.config_url.empty(), c.error, args_wrong_k, "Doesn't support URL configs");
+
+            auto fill_options = [](json_t const& js, ucset_options_t& options) -> bool {
+                if (js.contains("encryption"))
+                    options.encryption = js["encryption"];
+                if (js.contains("compression"))
+                    options.compression = js["compression"];
+                if (js.contains("compression_threshold"))
+                    options.compression_threshold = parse_size(js["compression_threshold"]);
+                if (js.contains("memory_limit"))
+                    options.memory_limit = parse_size(js["memory_limit"]);
+                if (js.contains("spill_threshold"))
+                    options.spill_threshold = parse_size(js["spill_threshold"]);
+                if (js.contains("write_ahead_log"))
+                    options.write_ahead_log = js["write_ahead_log"];
+                if (js.contains("checkpoint_size"))
+                    options.checkpoint_size = js["checkpoint_size"];
+                if (js.contains("checkpoint_interval_ms"))
+                    options.checkpoint_interval_ms = js["checkpoint_interval_ms"];
+                if (js.contains("group_commit_size"))
+                    options.group_commit_size = std::max<std::size_t>(js["group_commit_size"].get<std::size_t>(), 1u);
+                if (js.contains("group_commit_window_us"))
+                    options.group_commit_window_us = js["group_commit_window_us"];
+                if (js.contains("snapshot_format"))
+                    options.snapshot_format = js["snapshot_format"] == "arrow" //
+                                                  ? snapshot_format_t::arrow_k
+                                                  : snapshot_format_t::parquet_k;
+                if (js.contains("change_feed") && !change_feed_config_t::parse(js, options.change_feed))
+                    return false;
+                if (js.contains("ttl"))
+                    return expiration_config_t::parse(js, options.expiration);
+                return true;
+            };
+
+            // Load from file
+            ucset_options_t options;
+            if (!config.engine.config_file_path.empty()) {
+                std::ifstream ifs(config.engine.config_file_path);
+                return_error_if_m(ifs, c.error, args_wrong_k, "Config file not found");
+                auto js = json_t::parse(ifs);
+                return_error_if_m(fill_options(js, options),
+                                  c.error,
+                                  args_wrong_k,
+                                  "Invalid change feed or TTL config");
+            }
             // Override with nested
             if (!config.engine.config.empty())
-                fill_options(config.engine.config, options);
+                return_error_if_m(fill_options(config.engine.config, options),
+                                  c.error,
+                                  args_wrong_k,
+                                  "Invalid change feed or TTL config");
 
+            db_ptr->options = options;
             db_ptr->persisted_directory = root;
-            read(*db_ptr, db_ptr->persisted_directory, c.error);
+
+            // The spill file is unlinked right away, so it's removed even after a crash
+            if (options.memory_limit) {
+                std::string spill_path = root / ".spill";
+                db_ptr->spill_handle = ::open(spill_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+                return_error_if_m(db_ptr->spill_handle >= 0, c.error, args_wrong_k, "Can't create a spill file");
+                ::unlink(spill_path.c_str());
+            }
+
+            read(*db_ptr, c.error);
+            return_if_error_m(c.error);
+
+            // Apply the changes, that haven't been checkpointed yet
+            std::unordered_map<ustore_collection_t, ustore_collection_t> ids;
+            for (auto const& [sequence, path] : list_logs(db_ptr->persisted_directory)) {
+                replay(*db_ptr, path, ids, c.error);
+                return_if_error_m(c.error);
+                db_ptr->log_sequence = sequence;
+            }
+            recount_collections(*db_ptr, c.error);
+            return_if_error_m(c.error);
+            if (options.expiration.enabled()) {
+                assign_ttls(*db_ptr, c.error);
+                return_if_error_m(c.error);
+            }
+
+            enforce_memory_limit(*db_ptr);
+            if (options.write_ahead_log) {
+                rotate_log(*db_ptr, c.error);
+                return_if_error_m(c.error);
+                db_ptr->checkpointer = std::thread(checkpoint_in_background, std::ref(*db_ptr));
+            }
+
+            if (options.change_feed.enabled) {
+                auto status = db_ptr->changes.open(root / "changes", options.change_feed);
+                return_error_if_m(status, c.error, error_unknown_k, status.message());
+            }
+            if (options.expiration.enabled())
+                db_ptr->sweeper = std::thread(sweep_in_background, std::ref(*db_ptr));
         }
         *c.db = db_ptr.release();
     });
 }
 
-void ustore_get_metadata(ustore_get_metadata_t* c_ptr) {
-    ustore_get_metadata_t& c = *c_ptr;
-    *c.metadata = ustore_metadata_t(ustore_supports_transactions_k | ustore_supports_named_collections_k);
-}
+void ustore_get_metadata(ustore_get_metadata_t* c_ptr) {
+    ustore_get_metadata_t& c = *c_ptr;
+    *c.metadata = ustore_metadata_t(ustore_supports_transactions_k | ustore_supports_named_collections_k |
+                                    ustore_supports_snapshots_k);
+}
+
+void ustore_snapshot_list(ustore_snapshot_list_t* c_ptr) {
+
+    ustore_snapshot_list_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    return_error_if_m(c.count && c.ids, c.error, args_combo_k, "Need outputs!");
+
+    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
+    return_if_error_m(c.error);
+
+    database_t& db = *reinterpret_cast<database_t*>(c.db);
+    std::shared_lock<shared_mutex_t> snapshots_lock {db.snapshots_mutex};
+    std::size_t snapshots_count = db.snapshots.size();
+    *c.count = static_cast<ustore_size_t>(snapshots_count);
+
+    auto ids = arena.alloc_or_dummy(snapshots_count, c.error, c.ids);
+    return_if_error_m(c.error);
 
-void ustore_snapshot_list(ustore_snapshot_list_t* c_ptr) {
-    ustore_snapshot_list_t& c = *c_ptr;
-    *c.error = "Snapshots not supported by UCSet!";
+    std::size_t i = 0;
+    for (auto const& id_and_snapshot : db.snapshots)
+        ids[i++] = id_and_snapshot.first;
 }
 
 void ustore_snapshot_create(ustore_snapshot_create_t* c_ptr) {
+
     ustore_snapshot_create_t& c = *c_ptr;
-    *c.error = "Snapshots not supported by UCSet!";
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    return_error_if_m(c.id, c.error, args_wrong_k, "Need an output for the snapshot id!");
+
+    database_t& db = *reinterpret_cast<database_t*>(c.db);
+    std::shared_lock restructuring_lock {db.restructuring_mutex};
+    std::unique_lock<shared_mutex_t> snapshots_lock {db.snapshots_mutex};
+    safe_section("Allocating snapshot", c.error, [&] {
+        auto snapshot = std::make_unique<snapshot_t>();
+        snapshot->names.emplace_back(std::string {}, ustore_collection_main_k);
+        for (auto const& [collection_name, collection_id] : db.names)
+            snapshot->names.emplace_back(collection_name, collection_id);
+
+        *c.id = reinterpret_cast<ustore_snapshot_t>(snapshot.get());
+        db.snapshots.emplace(*c.id, std::move(snapshot));
+    });
 }
 
 void ustore_snapshot_export(ustore_snapshot_export_t* c_ptr) {
+
     ustore_snapshot_export_t& c = *c_ptr;
-    *c.error = "Snapshots not supported by UCSet!";
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    return_error_if_m(c.path, c.error, args_wrong_k, "Export path is missing");
+
+    database_t& db = *reinterpret_cast<database_t*>(c.db);
+    std::vector<std::pair<std::string, ustore_collection_t>> names;
+    {
+        std::shared_lock<shared_mutex_t> _ {db.snapshots_mutex};
+        snapshot_t const* snapshot = find_snapshot(db, c.id, c.error);
+        return_if_error_m(c.error);
+        safe_section("Listing collections", c.error, [&] { names = snapshot->names; });
+        return_if_error_m(c.error);
+    }
+
+    // Every collection is copied in parallel, while the writers keep going
+    safe_section("Exporting snapshot", c.error, [&] {
+        stdfs::create_directories(c.path);
+        std::vector<ustore_error_t> errors(names.size(), nullptr);
+        parallel_for(names.size(), [&](std::size_t idx) {
+            ustore_error_t* c_collection_error = &errors[idx];
+            auto const& [collection_name, collection_id] = names[idx];
+            std::string collection_path = stdfs::path(c.path) / (collection_name + ".parquet");
+            safe_section("Writing collection", c_collection_error, [&] {
+                write_snapshot_collection(db, c.id, collection_id, collection_path, c_collection_error);
+            });
+        });
+        for (ustore_error_t error : errors)
+            return_error_if_m(!error, c.error, error_unknown_k, error);
+    });
 }
 
 void ustore_snapshot_drop(ustore_snapshot_drop_t* c_ptr) {
+
     ustore_snapshot_drop_t& c = *c_ptr;
-    *c.error = "Snapshots not supported by UCSet!";
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    if (!c.id)
+        return;
+
+    // Releasing the before-images outside of the lock
+    database_t& db = *reinterpret_cast<database_t*>(c.db);
+    std::unique_ptr<snapshot_t> snapshot;
+    {
+        std::unique_lock<shared_mutex_t> _ {db.snapshots_mutex};
+        auto it = db.snapshots.find(c.id);
+        if (it == db.snapshots.end())
+            return;
+        snapshot = std::move(it->second);
+        db.snapshots.erase(it);
+    }
 }
 
 void ustore_read(ustore_read_t* c_ptr) {
@@ -514,7 +2625,8 @@ void ustore_read(ustore_read_t* c_ptr) {
     return_if_error_m(c.error);
 
     database_t& db = *reinterpret_cast<database_t*>(c.db);
-    transaction_t& txn = *reinterpret_cast<transaction_t*>(c.transaction);
+    stats_timer_t timer {db.stats, stats_op_t::read_k, c.tasks_count, c.error};
+    txn_t& txn = *reinterpret_cast<txn_t*>(c.transaction);
     strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
     strided_iterator_gt<ustore_key_t const> keys {c.keys, c.keys_stride};
     places_arg_t places {collections, keys, {}, c.tasks_count};
@@ -525,20 +2637,44 @@ void ustore_read(ustore_read_t* c_ptr) {
     growing_tape_t tape(arena);
     tape.reserve(places.size(), c.error);
     return_if_error_m(c.error);
-    auto back_inserter = [&](value_view_t value) noexcept {
-        tape.push_back(value, c.error);
+    std::string stored_buffer;
+    auto back_inserter = [&](pair_t const& pair) noexcept {
+        export_value(db, pair, tape, stored_buffer, c.error);
+    };
+    // Until swept, the expired values are hidden from HEAD and transactions, but not from snapshots
+    expiration_time_t const now = db.options.expiration.enabled() ? expiration_now() : 0;
+    auto live_inserter = [&](pair_t const& pair) noexcept {
+        if (pair.is_expired(now))
+            return back_inserter(pair_t {pair.collection_key});
+        back_inserter(pair);
     };
 
-    // 2. Pull the data
-    for (std::size_t task_idx = 0; task_idx != places.size(); ++task_idx) {
-        place_t place = places[task_idx];
-        collection_key_t key = place.collection_key();
-        auto status = c.transaction //
-                          ? find_and_watch(txn, key, c.options, back_inserter)
-                          : find_and_watch(db.pairs, key, c.options, back_inserter);
-        if (!status)
-            return export_error_code(status, c.error);
+    // 2. Pull the data, preferring the snapshot over the transaction, if both are set
+    std::shared_lock<shared_mutex_t> snapshots_lock {db.snapshots_mutex, std::defer_lock};
+    snapshot_t const* snapshot = nullptr;
+    if (c.snapshot) {
+        snapshots_lock.lock();
+        snapshot = find_snapshot(db, c.snapshot, c.error);
+        return_if_error_m(c.error);
     }
+    places.visit([&](auto const& places) {
+        for (std::size_t task_idx = 0; task_idx != places.size(); ++task_idx) {
+            place_t place = places[task_idx];
+            collection_key_t key = place.collection_key();
+            auto status = snapshot        ? find_in_snapshot(db, *snapshot, key, back_inserter)
+                          : c.transaction ? find_and_watch(txn.native, key, c.options, live_inserter)
+                                          : find_and_watch(db.pairs, key, c.options, live_inserter);
+            if (!status)
+                return export_error_code(status, c.error);
+            return_if_error_m(c.error);
+        }
+    });
+    return_if_error_m(c.error);
+    snapshots_lock = {};
+    if (!c.transaction && !c.snapshot)
+        track_recency(db, places.size(), [&](std::size_t i) {
+            return std::make_pair(places[i].collection_key(), tape.lengths()[i]);
+        });
 
     // 3. Export the results
     if (c.presences)
@@ -562,7 +2698,9 @@ void ustore_write(ustore_write_t* c_ptr) {
     return_if_error_m(c.error);
 
     database_t& db = *reinterpret_cast<database_t*>(c.db);
-    transaction_t& txn = *reinterpret_cast<transaction_t*>(c.transaction);
+    stats_timer_t timer {db.stats, stats_op_t::write_k, c.tasks_count, c.error};
+    txn_t& txn = *reinterpret_cast<txn_t*>(c.transaction);
+    return_error_if_m(!c.transaction || !txn.staged, c.error, args_combo_k, "Staged transactions can't be changed");
     strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
     strided_iterator_gt<ustore_key_t const> keys {c.keys, c.keys_stride};
     strided_iterator_gt<ustore_bytes_cptr_t const> vals {c.values, c.values_stride};
@@ -575,6 +2713,13 @@ void ustore_write(ustore_write_t* c_ptr) {
 
     validate_write(c.transaction, places, contents, c.options, c.error);
     return_if_error_m(c.error);
+    return_error_if_m(!(c.options & ustore_option_write_merge_k), c.error, args_wrong_k, "Merges aren't supported!");
+
+    // Lifetimes of the collections can't change, while we are assigning the deadlines
+    std::shared_lock<shared_mutex_t> restructuring_lock {db.restructuring_mutex, std::defer_lock};
+    expiration_time_t const now = db.options.expiration.enabled() ? expiration_now() : 0;
+    if (now)
+        restructuring_lock.lock();
 
     // Writes are the only operations that significantly differ
     // in terms of transactional and batch operations.
@@ -587,56 +2732,136 @@ void ustore_write(ustore_write_t* c_ptr) {
             value_view_t content = contents[i];
             collection_key_t key = place.collection_key();
             if (!dont_watch)
-                if (auto watch_status = txn.watch(key); !watch_status)
+                if (auto watch_status = txn.native.watch(key); !watch_status)
                     return export_error_code(watch_status, c.error);
 
             ucset::status_t status;
+            written_key_t written {key};
+            expiration_time_t const expires_at = expiration_deadline(db, key.collection, now);
             if (content) {
-                pair_t pair {key, content, c.error};
+                pair_t pair = pair_t::compressed(key, content, compression_threshold(db), db.blobs, c.error);
                 return_if_error_m(c.error);
-                status = txn.upsert(std::move(pair));
+                pair.expires_at = expires_at;
+                written.length = static_cast<ustore_length_t>(content.size());
+                written.stored_length = static_cast<ustore_length_t>(pair.range.size());
+                status = txn.native.upsert(std::move(pair));
             }
             else
-                status = txn.erase(key);
+                status = txn.native.erase(key);
 
             if (!status)
                 return export_error_code(status, c.error);
+
+            if (db.options.write_ahead_log)
+                safe_section("Buffering log entries", c.error, [&] {
+                    if (now)
+                        log_append_upsert(txn.log_entries, key, content, expires_at);
+                    else
+                        log_append_upsert(txn.log_entries, key, content);
+                });
+            if (db.changes.is_open())
+                safe_section("Buffering changes", c.error, [&] {
+                    change_log_t::serialize(txn.change_entries, key, content);
+                    ++txn.changes_count;
+                });
+            safe_section("Buffering written keys", c.error, [&] { txn.written_keys.push_back(written); });
+            return_if_error_m(c.error);
         }
         return;
     }
 
-    // Non-transactional but atomic batch-write operation.
-    // It requires producing a copy of input data.
-    else if (c.tasks_count > 1) {
-        uninitialized_array_gt<pair_t> copies(places.count, arena, c.error);
+    // Serialize and compress everything before locking the log
+    std::string record;
+    if (db.options.write_ahead_log) {
+        safe_section("Serializing log record", c.error, [&] {
+            log_append(record, upserts_kind(db));
+            for (std::size_t i = 0; i != places.size(); ++i) {
+                collection_key_t key = places[i].collection_key();
+                if (now)
+                    log_append_upsert(record, key, contents[i], expiration_deadline(db, key.collection, now));
+                else
+                    log_append_upsert(record, key, contents[i]);
+            }
+        });
         return_if_error_m(c.error);
-        initialized_range_gt<pair_t> copies_constructed(copies);
+    }
+    std::string change_entries;
+    if (db.changes.is_open()) {
+        safe_section("Serializing changes", c.error, [&] {
+            for (std::size_t i = 0; i != places.size(); ++i)
+                change_log_t::serialize(change_entries, places[i].collection_key(), contents[i]);
+        });
+        return_if_error_m(c.error);
+    }
 
+    // Non-transactional but atomic batch-write operation.
+    // It requires producing a copy of input data.
+    uninitialized_array_gt<pair_t> copies(places.count, arena, c.error);
+    return_if_error_m(c.error);
+    initialized_range_gt<pair_t> copies_constructed(copies);
+    places.visit([&](auto const& places) {
         for (std::size_t i = 0; i != places.size(); ++i) {
             place_t place = places[i];
             value_view_t content = contents[i];
             collection_key_t key = place.collection_key();
 
-            pair_t pair {key, content, c.error};
+            pair_t pair = pair_t::compressed(key, content, compression_threshold(db), db.blobs, c.error);
             return_if_error_m(c.error);
+            pair.expires_at = expiration_deadline(db, key.collection, now);
             copies[i] = std::move(pair);
         }
+    });
+    return_if_error_m(c.error);
 
-        auto status = db.pairs.upsert(std::make_move_iterator(copies.begin()), std::make_move_iterator(copies.end()));
-        return export_error_code(status, c.error);
+    // The record must reach the log before the change becomes visible, so a failed append
+    // leaves no trace in memory. The apply stays under the `log_mutex`, as otherwise
+    // concurrent writes of the same key could be applied and replayed in different orders.
+    std::unique_lock<std::mutex> log_lock {db.log_mutex, std::defer_lock};
+    if (db.options.write_ahead_log) {
+        log_lock.lock();
+        log_record(db, record, c.options, c.error);
+        return_if_error_m(c.error);
     }
+    std::unique_lock<std::mutex> changes_lock {db.changes.mutex(), std::defer_lock};
+    if (db.changes.is_open())
+        changes_lock.lock();
+
+    snapshots_lock_t snapshots_lock = lock_snapshots_for_write(db, [&] {
+        for (std::size_t i = 0; i != places.size() && !*c.error; ++i)
+            preserve_before_image(db, places[i].collection_key(), c.error);
+    });
+    return_if_error_m(c.error);
 
-    // Just a single non-batch write
-    else {
-        place_t place = places[0];
-        value_view_t content = contents[0];
-        collection_key_t key = place.collection_key();
+    keys_lock_t keys_lock = lock_keys(db, places.size(), [&](std::size_t i) { return copies[i].collection_key; });
+    stats_deltas_t deltas;
+    for (std::size_t i = 0; i != places.size() && !*c.error; ++i)
+        account_write(db, copies[i].collection_key, stored_length(copies[i]), deltas, c.error);
+    return_if_error_m(c.error);
+    reserve_stats(db, deltas, c.error);
+    return_if_error_m(c.error);
 
-        pair_t pair {key, content, c.error};
-        return_if_error_m(c.error);
-        auto status = db.pairs.upsert(std::move(pair));
-        return export_error_code(status, c.error);
+    auto status = places.size() > 1 //
+                      ? db.pairs.upsert(std::make_move_iterator(copies.begin()), std::make_move_iterator(copies.end()))
+                      : db.pairs.upsert(std::move(copies[0]));
+    export_error_code(status, c.error);
+    if (status)
+        apply_stats(db, deltas);
+    keys_lock = {};
+    return_if_error_m(c.error);
+    snapshots_lock = {};
+    log_lock = {};
+
+    if (db.changes.is_open() && !*c.error) {
+        auto status = db.changes.append(change_entries, places.size(), c.options & ustore_option_write_flush_k);
+        log_error_if_m(status, c.error, error_unknown_k, "Failed to append to change-log");
     }
+    changes_lock = {};
+
+    track_recency(db, places.size(), [&](std::size_t i) {
+        value_view_t content = contents[i];
+        return std::make_pair(places[i].collection_key(), content ? content.size() : ustore_length_missing_k);
+    });
+    enforce_memory_limit(db);
 }
 
 void ustore_scan(ustore_scan_t* c_ptr) {
@@ -650,11 +2875,13 @@ void ustore_scan(ustore_scan_t* c_ptr) {
     return_if_error_m(c.error);
 
     database_t& db = *reinterpret_cast<database_t*>(c.db);
-    transaction_t& txn = *reinterpret_cast<transaction_t*>(c.transaction);
+    stats_timer_t timer {db.stats, stats_op_t::scan_k, c.tasks_count, c.error};
+    txn_t& txn = *reinterpret_cast<txn_t*>(c.transaction);
     strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
     strided_iterator_gt<ustore_key_t const> start_keys {c.start_keys, c.start_keys_stride};
     strided_iterator_gt<ustore_length_t const> lens {c.count_limits, c.count_limits_stride};
-    scans_arg_t scans {collections, start_keys, lens, c.tasks_count};
+    strided_iterator_gt<ustore_key_t const> end_keys {c.end_keys, c.end_keys_stride};
+    scans_arg_t scans {collections, start_keys, lens, c.tasks_count, end_keys};
 
     validate_scan(c.transaction, scans, c.options, c.error);
     return_if_error_m(c.error);
@@ -669,7 +2896,43 @@ void ustore_scan(ustore_scan_t* c_ptr) {
     auto keys_output = *c.keys = arena.alloc<ustore_key_t>(total_keys, c.error).begin();
     return_if_error_m(c.error);
 
-    // 2. Fetch the data
+    growing_tape_t values(arena);
+    std::string stored_buffer;
+    bool const needs_values = c.values || c.values_offsets;
+    if (needs_values) {
+        values.reserve(total_keys, c.error);
+        return_if_error_m(c.error);
+    }
+
+    // 2. Fetch the data, with independent shards scanned in parallel.
+    // Transactions track the visited keys, so they are always scanned sequentially.
+    std::shared_lock<shared_mutex_t> snapshots_lock {db.snapshots_mutex, std::defer_lock};
+    snapshot_t const* snapshot = nullptr;
+    if (c.snapshot) {
+        snapshots_lock.lock();
+        snapshot = find_snapshot(db, c.snapshot, c.error);
+        return_if_error_m(c.error);
+    }
+    expiration_time_t const now = db.options.expiration.enabled() ? expiration_now() : 0;
+    auto is_expired = [=](pair_t const& pair) noexcept { return pair.is_expired(now); };
+    bool const is_head = !c.transaction && !snapshot;
+    if ((c.options & ustore_option_scan_bulk_k) && is_head && !needs_values && scans.count > 1) {
+        auto scan_one = [&](std::size_t task_idx, ustore_key_t* shard_keys, ustore_error_t* c_shard_error) {
+            scan_t scan = scans[task_idx];
+            ustore_length_t matched_pairs_count = 0;
+            auto found_pair = [&](pair_t const& pair) noexcept {
+                shard_keys[matched_pairs_count] = pair.collection_key.key;
+                ++matched_pairs_count;
+            };
+            auto previous_key = collection_key_t {scan.collection, scan.min_key};
+            auto status =
+                scan_and_watch(db.pairs, previous_key, scan.end_key, scan.limit, c.options, found_pair, is_expired);
+            export_error_code(status, c_shard_error);
+            return matched_pairs_count;
+        };
+        return scan_in_parallel(scans, offsets, counts, *c.keys, c.error, scan_one);
+    }
+
     for (std::size_t task_idx = 0; task_idx != scans.count; ++task_idx) {
         scan_t scan = scans[task_idx];
         offsets[task_idx] = keys_output - *c.keys;
@@ -679,18 +2942,32 @@ void ustore_scan(ustore_scan_t* c_ptr) {
             *keys_output = pair.collection_key.key;
             ++keys_output;
             ++matched_pairs_count;
+            if (needs_values)
+                export_value(db, pair, values, stored_buffer, c.error);
         };
 
         auto previous_key = collection_key_t {scan.collection, scan.min_key};
-        auto status = c.transaction //
-                          ? scan_and_watch(txn, previous_key, scan.limit, c.options, found_pair)
-                          : scan_and_watch(db.pairs, previous_key, scan.limit, c.options, found_pair);
+        auto status = snapshot ? scan_snapshot(db, *snapshot, previous_key, scan.end_key, scan.limit, found_pair)
+                      : c.transaction //
+                          ? scan_and_watch(
+                                txn.native, previous_key, scan.end_key, scan.limit, c.options, found_pair, is_expired)
+                          : scan_and_watch(
+                                db.pairs, previous_key, scan.end_key, scan.limit, c.options, found_pair, is_expired);
         if (!status)
             return export_error_code(status, c.error);
+        return_if_error_m(c.error);
 
         counts[task_idx] = matched_pairs_count;
     }
     offsets[scans.count] = keys_output - *c.keys;
+
+    // 3. Export the values
+    if (c.values_offsets) {
+        *c.values_offsets = values.arrow_offsets(c.error);
+        return_if_error_m(c.error);
+    }
+    if (c.values)
+        *c.values = (ustore_bytes_ptr_t)values.contents().begin().get();
 }
 
 struct key_from_pair_t {
@@ -726,6 +3003,7 @@ void ustore_sample(ustore_sample_t* c_ptr) {
     return_if_error_m(c.error);
 
     database_t& db = *reinterpret_cast<database_t*>(c.db);
+    stats_timer_t timer {db.stats, stats_op_t::sample_k, c.tasks_count, c.error};
     strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
     strided_iterator_gt<ustore_length_t const> lens {c.count_limits, c.count_limits_stride};
     sample_args_t samples {collections, lens, c.tasks_count};
@@ -779,39 +3057,128 @@ void ustore_measure(ustore_measure_t* c_ptr) {
     return_if_error_m(c.error);
 
     database_t& db = *reinterpret_cast<database_t*>(c.db);
-    transaction_t& txn = *reinterpret_cast<transaction_t*>(c.transaction);
     strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
     strided_iterator_gt<ustore_key_t const> start_keys {c.start_keys, c.start_keys_stride};
     strided_iterator_gt<ustore_key_t const> end_keys {c.end_keys, c.end_keys_stride};
 
+    // Small ranges are walked entirely, and larger ones only bounded
+    constexpr std::size_t walk_limit = 4 * 1024;
     for (ustore_size_t i = 0; i != c.tasks_count; ++i) {
         auto collection = collections[i];
         ustore_key_t const min_key = start_keys[i];
         ustore_key_t const max_key = end_keys[i];
+        collection_stats_t totals = collection_stats(db, collection);
+
+        bool const is_whole = min_key == std::numeric_limits<ustore_key_t>::min() &&
+                              max_key == std::numeric_limits<ustore_key_t>::max();
+        if (is_whole) {
+            min_cardinalities[i] = max_cardinalities[i] = static_cast<ustore_size_t>(totals.keys);
+            min_value_bytes[i] = max_value_bytes[i] = static_cast<ustore_size_t>(totals.value_bytes);
+            min_space_usages[i] = max_space_usages[i] = totals.value_bytes + totals.keys * sizeof(pair_t);
+            continue;
+        }
 
-        collection_key_t min(collection, min_key);
-        collection_key_t max(collection, max_key);
-
+        std::size_t walked = 0;
         std::size_t cardinality = 0;
         std::size_t value_bytes = 0;
-        std::size_t space_usage = 0;
-        auto status = db.pairs.range(min, max, [&](pair_t& pair) noexcept {
+        ustore_key_t last_key = min_key;
+        auto previous_key = collection_key_t {collection, min_key};
+        auto found_pair = [&](pair_t const& pair) noexcept {
+            ++walked;
+            last_key = pair.collection_key.key;
+            if (!pair)
+                return;
             ++cardinality;
             value_bytes += pair.range.size();
-            space_usage += pair.range.size() + sizeof(pair_t);
-        });
+        };
+        auto status = scan_and_watch(db.pairs, previous_key, max_key, walk_limit, c.options, found_pair);
         export_error_code(status, c.error);
         return_if_error_m(c.error);
 
+        // Every key after the last walked one may still be present,
+        // but not more than the rest of the collection
+        std::size_t max_cardinality = cardinality;
+        std::size_t max_bytes = value_bytes;
+        if (walked == walk_limit) {
+            auto remaining_span = static_cast<std::uint64_t>(max_key) - static_cast<std::uint64_t>(last_key) - 1;
+            std::size_t remaining_keys = totals.keys > cardinality ? totals.keys - cardinality : 0;
+            max_cardinality += static_cast<std::size_t>(std::min<std::uint64_t>(remaining_span, remaining_keys));
+            max_bytes = std::max(totals.value_bytes, value_bytes);
+        }
+
         min_cardinalities[i] = static_cast<ustore_size_t>(cardinality);
-        max_cardinalities[i] = std::numeric_limits<ustore_size_t>::max();
+        max_cardinalities[i] = static_cast<ustore_size_t>(max_cardinality);
         min_value_bytes[i] = value_bytes;
-        max_value_bytes[i] = std::numeric_limits<ustore_size_t>::max();
-        min_space_usages[i] = space_usage;
-        max_space_usages[i] = std::numeric_limits<ustore_size_t>::max();
+        max_value_bytes[i] = max_bytes;
+        min_space_usages[i] = value_bytes + cardinality * sizeof(pair_t);
+        max_space_usages[i] = max_bytes + max_cardinality * sizeof(pair_t);
     }
 }
 
+void ustore_erase_range(ustore_erase_range_t* c_ptr) {
+
+    ustore_erase_range_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    if (!c.tasks_count)
+        return;
+    return_error_if_m(c.start_keys && c.end_keys, c.error, args_wrong_k, "Ranges must have both ends");
+
+    database_t& db = *reinterpret_cast<database_t*>(c.db);
+    stats_timer_t timer {db.stats, stats_op_t::write_k, c.tasks_count, c.error};
+    strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
+    strided_iterator_gt<ustore_key_t const> start_keys {c.start_keys, c.start_keys_stride};
+    strided_iterator_gt<ustore_key_t const> end_keys {c.end_keys, c.end_keys_stride};
+
+    std::vector<erased_range_t> ranges;
+    safe_section("Sorting ranges", c.error, [&] {
+        ranges.reserve(c.tasks_count);
+        for (std::size_t i = 0; i != c.tasks_count; ++i) {
+            ustore_collection_t collection = collections ? collections[i] : ustore_collection_main_k;
+            if (start_keys[i] < end_keys[i])
+                ranges.push_back(erased_range_t {collection_key_t {collection, start_keys[i]}, end_keys[i]});
+        }
+        merge_ranges(ranges);
+    });
+    return_if_error_m(c.error);
+    if (ranges.empty())
+        return;
+
+    // All the ranges are selected and erased under the same locks, so the whole batch is atomic
+    erase_selected(
+        db,
+        c.options,
+        [&](auto&& visit) noexcept {
+            ucset::status_t status;
+            for (std::size_t i = 0; i != ranges.size() && status; ++i)
+                status = db.pairs.range( //
+                    ranges[i].start,
+                    collection_key_t {ranges[i].start.collection, ranges[i].end_key},
+                    [&](pair_t& pair) noexcept {
+                        if (pair)
+                            visit(pair);
+                    });
+            return status;
+        },
+        [&](std::vector<collection_key_t> const&) noexcept {
+            ucset::status_t status;
+            for (std::size_t i = 0; i != ranges.size() && status; ++i)
+                status = db.pairs.erase_range( //
+                    ranges[i].start,
+                    collection_key_t {ranges[i].start.collection, ranges[i].end_key},
+                    no_op_t {});
+            return status;
+        },
+        [&](std::string& record, std::vector<collection_key_t> const&) {
+            log_append(record, log_record_kind_t::erase_range_k);
+            for (erased_range_t const& range : ranges) {
+                log_append(record, range.start.collection);
+                log_append(record, range.start.key);
+                log_append(record, range.end_key);
+            }
+        },
+        c.error);
+}
+
 /*********************************************************/
 /*****************	Collections Management	****************/
 /*********************************************************/
@@ -823,14 +3190,35 @@ void ustore_collection_create(ustore_collection_create_t* c_ptr) {
     return_error_if_m(name_len, c.error, args_wrong_k, "Default collection is always present");
     return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
     database_t& db = *reinterpret_cast<database_t*>(c.db);
-    std::unique_lock _ {db.restructuring_mutex};
 
+    // Readers of other collections aren't blocked, until we know the name is free
+    upgrade_lock_t lock {db.restructuring_mutex};
     std::string_view collection_name {c.name, name_len};
     auto collection_it = db.names.find(collection_name);
     return_error_if_m(collection_it == db.names.end(), c.error, args_wrong_k, "Such collection already exists!");
 
     auto new_collection_id = new_collection(db);
-    safe_section("Inserting new collection", c.error, [&] { db.names.emplace(collection_name, new_collection_id); });
+    lock.upgrade();
+
+    // The collection only becomes visible, once it's durable in the log
+    if (db.options.write_ahead_log) {
+        safe_section("Logging new collection", c.error, [&] {
+            std::string record;
+            log_append(record, log_record_kind_t::collection_create_k);
+            log_append(record, new_collection_id);
+            record.append(collection_name);
+            std::unique_lock log_lock {db.log_mutex};
+            log_record(db, record, ustore_option_write_flush_k, c.error);
+        });
+        return_if_error_m(c.error);
+    }
+
+    safe_section("Inserting new collection", c.error, [&] {
+        db.names.emplace(collection_name, new_collection_id);
+        if (expiration_time_t ttl = db.options.expiration.ttl_for(std::string(collection_name)); ttl)
+            db.ttls[new_collection_id] = ttl;
+    });
+    return_if_error_m(c.error);
     *c.id = new_collection_id;
 }
 
@@ -847,30 +3235,35 @@ void ustore_collection_drop(ustore_collection_drop_t* c_ptr) {
 
     database_t& db = *reinterpret_cast<database_t*>(c.db);
     std::unique_lock _ {db.restructuring_mutex};
-
-    if (c.mode == ustore_drop_keys_vals_handle_k) {
-        auto status = db.pairs.erase_range(c.id, c.id + 1, no_op_t {});
-        if (!status)
-            return export_error_code(status, c.error);
-
-        for (auto it = db.names.begin(); it != db.names.end(); ++it) {
-            if (c.id != it->second)
-                continue;
-            db.names.erase(it);
-            break;
-        }
+    std::unique_lock<std::mutex> log_lock {db.log_mutex, std::defer_lock};
+    if (db.options.write_ahead_log)
+        log_lock.lock();
+    std::string change_entries;
+    std::size_t changes_count = 0;
+    std::unique_lock<std::mutex> changes_lock {db.changes.mutex(), std::defer_lock};
+    if (db.changes.is_open()) {
+        changes_lock.lock();
+        changes_count = serialize_drop(db, c.id, c.mode, change_entries, c.error);
+        return_if_error_m(c.error);
     }
 
-    else if (c.mode == ustore_drop_keys_vals_k) {
-        auto status = db.pairs.erase_range(c.id, c.id + 1, no_op_t {});
-        return export_error_code(status, c.error);
+    if (db.options.write_ahead_log) {
+        safe_section("Logging collection removal", c.error, [&] {
+            std::string record;
+            log_append(record, log_record_kind_t::collection_drop_k);
+            log_append(record, c.id);
+            log_append(record, c.mode);
+            log_record(db, record, ustore_option_write_flush_k, c.error);
+        });
+        return_if_error_m(c.error);
     }
 
-    else if (c.mode == ustore_drop_vals_k) {
-        auto status = db.pairs.range(c.id, c.id + 1, [&](pair_t& pair) noexcept {
-            pair = pair_t {pair.collection_key, value_view_t::make_empty(), nullptr};
-        });
-        return export_error_code(status, c.error);
+    drop_collection(db, c.id, c.mode, c.error);
+    return_if_error_m(c.error);
+
+    if (changes_count) {
+        auto status = db.changes.append(change_entries, changes_count, true);
+        log_error_if_m(status, c.error, error_unknown_k, "Failed to append to change-log");
     }
 }
 
@@ -922,13 +3315,164 @@ void ustore_database_control(ustore_database_control_t* c_ptr) {
     return_error_if_m(c.request, c.error, uninitialized_state_k, "Request is uninitialized");
 
     *c.response = NULL;
-    log_error_m(c.error, missing_feature_k, "Controls aren't supported in this implementation!");
+    stats_request_t request;
+    return_error_if_m(parse_stats_request(c.request, request), c.error, args_wrong_k, "Unknown control request!");
+
+    database_t& db = *reinterpret_cast<database_t*>(c.db);
+    std::string response;
+    safe_section("Collecting statistics", c.error, [&] {
+        json_t js = json_t::object();
+        if (request.memory) {
+            std::shared_lock _ {db.restructuring_mutex};
+            json_t collections = json_t::object();
+            auto describe = [&](std::string const& collection_name, ustore_collection_t collection_id) {
+                collection_stats_t stats = collection_stats(db, collection_id);
+                collections[collection_name] = {{"keys", stats.keys}, {"bytes", stats.value_bytes}};
+            };
+            describe({}, ustore_collection_main_k);
+            for (auto const& [collection_name, collection_id] : db.names)
+                describe(collection_name, collection_id);
+
+            json_t& memory = js["memory"];
+            memory["collections"] = std::move(collections);
+            memory["blobs_bytes"] = db.blobs_bytes.load();
+            {
+                std::unique_lock spill_lock {db.spill_mutex};
+                memory["spilled_bytes"] = db.spill_size;
+            }
+            memory["arena_bytes"] = linked_memory_t::reserved_bytes.load();
+            memory["arena_pooled_bytes"] = linked_memory_t::pooled_bytes.load();
+            {
+                std::unique_lock log_lock {db.log_mutex};
+                memory["log_bytes"] = db.log.size();
+            }
+        }
+        if (request.ops)
+            js["ops"] = db.stats.ops_json();
+        if (request.latency)
+            js["latency"] = db.stats.latency_json();
+        response = js.dump();
+    });
+    return_if_error_m(c.error);
+    export_control_response(response, c.arena, c.response, c.error);
 }
 
 /*********************************************************/
 /*****************		Transactions	  ****************/
 /*********************************************************/
 
+/**
+ * @brief Everything a transaction holds between staging and committing: the locks
+ * of the written keys, the snapshots, the log and the change-feed, and the changes
+ * it will make to the statistics. Committing separately staged transactions must
+ * not wait for the commits group, as its leader takes the same locks.
+ */
+struct staged_commit_t {
+    std::unique_lock<std::mutex> log_lock;
+    std::unique_lock<std::mutex> changes_lock;
+    snapshots_lock_t snapshots_lock;
+    keys_lock_t keys_lock;
+    stats_deltas_t deltas;
+};
+
+/**
+ * @brief Preserves the before-images of the written keys, accounts them in statistics
+ * and stages the native transaction, which detects the conflicts. The locks stay in
+ * @p staged, so nothing can change those keys until the transaction is committed.
+ */
+void stage_commit(database_t& db, txn_t& txn, staged_commit_t& staged, ustore_error_t* c_error) noexcept {
+    auto const& written = txn.written_keys;
+    staged.snapshots_lock = lock_snapshots_for_write(db, [&] {
+        for (std::size_t i = 0; i != written.size() && !*c_error; ++i)
+            preserve_before_image(db, written[i].key, c_error);
+    });
+    return_if_error_m(c_error);
+
+    staged.keys_lock = lock_keys(db, written.size(), [&](std::size_t i) { return written[i].key; });
+    for (std::size_t i = 0; i != written.size() && !*c_error; ++i)
+        account_write(db, written[i].key, written[i].stored_length, staged.deltas, c_error);
+    return_if_error_m(c_error);
+    reserve_stats(db, staged.deltas, c_error);
+    return_if_error_m(c_error);
+
+    auto status = txn.native.stage();
+    export_error_code(status, c_error);
+}
+
+/**
+ * @brief Logs the staged @p txn and makes it visible, releasing the keys and snapshots
+ * locks of @p staged. Must be called under the `log_mutex` and the change-feed mutex,
+ * if those are enabled. A failed log append rolls the transaction back.
+ * @param unsynced_records Whether the log has records, that weren't synced yet.
+ * @return True, if the changes were applied, even if the change-feed failed to follow.
+ */
+bool finish_commit(database_t& db,
+                   txn_t& txn,
+                   staged_commit_t& staged,
+                   ustore_options_t options,
+                   ustore_sequence_number_t* sequence_number,
+                   bool& unsynced_records,
+                   ustore_error_t* c_error) noexcept {
+
+    bool const request_flush = options & ustore_option_write_flush_k;
+    if (db.options.write_ahead_log && !txn.log_entries.empty()) {
+        safe_section("Logging transaction", c_error, [&] {
+            txn.log_entries.insert(txn.log_entries.begin(), char(upserts_kind(db)));
+            log_record(db, txn.log_entries, ustore_options_default_k, c_error);
+            txn.log_entries.clear();
+            unsynced_records = true;
+        });
+        if (!*c_error && request_flush && unsynced_records) {
+            unum::ustore::status_t sync_status = db.log.sync();
+            log_error_if_m(sync_status, c_error, error_unknown_k, "Failed to flush write-ahead log");
+            unsynced_records = !sync_status;
+        }
+        if (*c_error) {
+            txn.native.rollback();
+            return false;
+        }
+    }
+
+    auto status = txn.native.commit();
+    if (!status) {
+        export_error_code(status, c_error);
+        return false;
+    }
+    apply_stats(db, staged.deltas);
+    staged.keys_lock = {};
+    staged.snapshots_lock = {};
+
+    if (sequence_number)
+        *sequence_number = txn.native.generation();
+
+    auto const& written = txn.written_keys;
+    if (!written.empty()) {
+        track_recency(db, written.size(), [&](std::size_t i) {
+            return std::make_pair(written[i].key, written[i].length);
+        });
+        txn.written_keys.clear();
+    }
+
+    if (txn.changes_count) {
+        unum::ustore::status_t changes_status = db.changes.append(txn.change_entries, txn.changes_count, request_flush);
+        log_error_if_m(changes_status, c_error, error_unknown_k, "Failed to append to change-log");
+        txn.change_entries.clear();
+        txn.changes_count = 0;
+    }
+    return true;
+}
+
+/**
+ * @brief Saves the whole state for commits, that requested a flush without the write-ahead log.
+ */
+void save_committed(database_t& db, ustore_error_t* c_error) noexcept {
+    safe_section("Saving to disk", c_error, [&] {
+        write(db, c_error);
+        return_if_error_m(c_error);
+        remove_logs(db.persisted_directory, std::numeric_limits<std::size_t>::max());
+    });
+}
+
 void ustore_transaction_init(ustore_transaction_init_t* c_ptr) {
 
     ustore_transaction_init_t& c = *c_ptr;
@@ -943,37 +3487,225 @@ void ustore_transaction_init(ustore_transaction_init_t* c_ptr) {
 
         auto maybe_txn = db.pairs.transaction();
         return_error_if_m(maybe_txn, c.error, error_unknown_k, "Couldn't start a transaction");
-        *c.transaction = std::make_unique<transaction_t>(std::move(maybe_txn).value()).release();
+        *c.transaction = new txn_t {std::move(maybe_txn).value(), {}};
     });
     return_if_error_m(c.error);
 
-    transaction_t& txn = *reinterpret_cast<transaction_t*>(*c.transaction);
-    auto status = txn.reset();
+    txn_t& txn = *reinterpret_cast<txn_t*>(*c.transaction);
+    if (txn.staged) {
+        txn.native.rollback();
+        txn.staged.reset();
+    }
+    txn.log_entries.clear();
+    txn.change_entries.clear();
+    txn.changes_count = 0;
+    txn.written_keys.clear();
+    auto status = txn.native.reset();
     return export_error_code(status, c.error);
 }
 
+/**
+ * @brief Applies a group of commits one after another, so the conflict detection
+ * is the same as for separate commits, but holds the `log_mutex` just once.
+ * Every commit is staged, appended to the log and only then made visible, so a failed
+ * append is rolled back. Commits, that requested a flush, are synced before becoming
+ * visible, but a sync covers all the records appended before it, so the following
+ * commits of the group can skip it.
+ */
+void commit_group(database_t& db, std::vector<commit_request_t*> const& group) noexcept {
+
+    std::unique_lock<std::mutex> log_lock {db.log_mutex, std::defer_lock};
+    if (db.options.write_ahead_log)
+        log_lock.lock();
+    std::unique_lock<std::mutex> changes_lock {db.changes.mutex(), std::defer_lock};
+    if (db.changes.is_open())
+        changes_lock.lock();
+
+    bool flush = false;
+    bool unsynced_records = false;
+    for (commit_request_t* request : group) {
+        txn_t& txn = *request->txn;
+        staged_commit_t staged;
+        stage_commit(db, txn, staged, &request->error);
+        if (request->error)
+            continue;
+
+        bool const committed = finish_commit( //
+            db,
+            txn,
+            staged,
+            request->options,
+            request->sequence_number,
+            unsynced_records,
+            &request->error);
+        flush |= committed && (request->options & ustore_option_write_flush_k);
+    }
+    enforce_memory_limit(db);
+
+    // With the log enabled, the flushes have already happened before the commits
+    if (!flush || db.options.write_ahead_log)
+        return;
+
+    ustore_error_t flush_error = nullptr;
+    save_committed(db, &flush_error);
+
+    for (commit_request_t* request : group)
+        if ((request->options & ustore_option_write_flush_k) && !request->error)
+            request->error = flush_error;
+}
+
+/**
+ * Staged transactions keep the locks of their keys, the log and the change-feed, until they
+ * are committed or reset by the same thread, so that the commit itself can only fail to log.
+ * That's what the sharded engine needs to apply a transaction to many shards at once.
+ */
+void ustore_transaction_stage(ustore_transaction_stage_t* c_ptr) {
+
+    ustore_transaction_stage_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    database_t& db = *reinterpret_cast<database_t*>(c.db);
+    validate_transaction_commit(c.transaction, c.options, c.error);
+    return_if_error_m(c.error);
+
+    txn_t& txn = *reinterpret_cast<txn_t*>(c.transaction);
+    return_error_if_m(!txn.staged, c.error, args_combo_k, "Transaction is already staged");
+    safe_section("Staging transaction", c.error, [&] { txn.staged = std::make_unique<staged_commit_t>(); });
+    return_if_error_m(c.error);
+
+    staged_commit_t& staged = *txn.staged;
+    if (db.options.write_ahead_log)
+        staged.log_lock = std::unique_lock<std::mutex> {db.log_mutex};
+    if (db.changes.is_open())
+        staged.changes_lock = std::unique_lock<std::mutex> {db.changes.mutex()};
+    stage_commit(db, txn, staged, c.error);
+    if (*c.error) {
+        txn.staged.reset();
+        return;
+    }
+    if (c.sequence_number)
+        *c.sequence_number = txn.native.generation();
+}
+
+/**
+ * @brief Commits a transaction, that was staged with `ustore_transaction_stage()`,
+ * bypassing the commits group, as its locks are already held.
+ */
+void commit_staged(database_t& db, txn_t& txn, ustore_transaction_commit_t& c) noexcept {
+    bool unsynced_records = false;
+    bool const committed = finish_commit(db, txn, *txn.staged, c.options, c.sequence_number, unsynced_records, c.error);
+    txn.staged.reset();
+    enforce_memory_limit(db);
+
+    bool const flush = c.options & ustore_option_write_flush_k;
+    if (committed && flush && !db.options.write_ahead_log && !*c.error)
+        save_committed(db, c.error);
+}
+
 void ustore_transaction_commit(ustore_transaction_commit_t* c_ptr) {
 
     ustore_transaction_commit_t& c = *c_ptr;
     return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
     database_t& db = *reinterpret_cast<database_t*>(c.db);
+    stats_timer_t timer {db.stats, stats_op_t::commit_k, 1, c.error};
 
     validate_transaction_commit(c.transaction, c.options, c.error);
     return_if_error_m(c.error);
-    transaction_t& txn = *reinterpret_cast<transaction_t*>(c.transaction);
-    auto status = txn.stage();
-    if (!status)
-        return export_error_code(status, c.error);
-    status = txn.commit();
-    if (!status)
-        return export_error_code(status, c.error);
 
-    if (c.sequence_number)
-        *c.sequence_number = txn.generation();
+    txn_t& txn = *reinterpret_cast<txn_t*>(c.transaction);
+    if (txn.staged)
+        return commit_staged(db, txn, c);
+
+    commit_request_t request;
+    request.txn = &txn;
+    request.options = c.options;
+    request.sequence_number = c.sequence_number;
+
+    std::vector<commit_request_t*> group;
+    safe_section("Reserving commit group", c.error, [&] { group.reserve(db.options.group_commit_size); });
+    return_if_error_m(c.error);
+
+    std::unique_lock commits_lock {db.commits_mutex};
+    safe_section("Enqueueing commit", c.error, [&] { db.commits_queue.push_back(&request); });
+    return_if_error_m(c.error);
+    db.commits_arrived.notify_one();
+
+    while (!request.done) {
+        if (db.commits_leader_active) {
+            db.commits_done.wait(commits_lock);
+            continue;
+        }
+
+        // Become the leader and give others a chance to join the group
+        db.commits_leader_active = true;
+        if (db.options.group_commit_window_us)
+            db.commits_arrived.wait_for(commits_lock,
+                                        std::chrono::microseconds(db.options.group_commit_window_us),
+                                        [&] { return db.commits_queue.size() >= db.options.group_commit_size; });
+
+        auto& queue = db.commits_queue;
+        auto group_size = std::min(queue.size(), db.options.group_commit_size);
+        group.assign(queue.begin(), queue.begin() + group_size);
+        queue.erase(queue.begin(), queue.begin() + group_size);
+        commits_lock.unlock();
+
+        commit_group(db, group);
+
+        commits_lock.lock();
+        for (commit_request_t* member : group)
+            member->done = true;
+        db.commits_leader_active = false;
+        db.commits_done.notify_all();
+    }
 
-    // TODO: Degrade the lock to "shared" state before starting expensive IO
-    if (c.options & ustore_option_write_flush_k)
-        safe_section("Saving to disk", c.error, [&] { write(db, db.persisted_directory, c.error); });
+    *c.error = request.error;
+}
+
+/*********************************************************/
+/*****************	     Change Feed	  ****************/
+/*********************************************************/
+
+void ustore_changes_subscribe(ustore_changes_subscribe_t* c_ptr) {
+
+    ustore_changes_subscribe_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    return_error_if_m(c.cursor, c.error, args_wrong_k, "No cursor output");
+
+    database_t& db = *reinterpret_cast<database_t*>(c.db);
+    return_error_if_m(db.changes.is_open(), c.error, args_combo_k, "Change feed isn't enabled");
+    safe_section("Subscribing to changes", c.error, [&] {
+        auto cursor = std::make_unique<change_log_t::cursor_t>();
+        auto status = db.changes.seek(c.since, *cursor);
+        return_error_if_m(status, c.error, args_wrong_k, status.message());
+        *c.cursor = cursor.release();
+    });
+}
+
+void ustore_changes_poll(ustore_changes_poll_t* c_ptr) {
+
+    ustore_changes_poll_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    return_error_if_m(c.cursor, c.error, uninitialized_state_k, "Cursor is uninitialized");
+
+    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
+    return_if_error_m(c.error);
+
+    database_t& db = *reinterpret_cast<database_t*>(c.db);
+    return_error_if_m(db.changes.is_open(), c.error, args_combo_k, "Change feed isn't enabled");
+    change_log_t::cursor_t& cursor = *reinterpret_cast<change_log_t::cursor_t*>(c.cursor);
+    safe_section("Polling changes", c.error, [&] {
+        // The cursor only advances, if the changes were exported
+        change_log_t::cursor_t next = cursor;
+        changes_batch_t batch;
+        auto status = db.changes.read(next, c.count_limit ? c.count_limit : changes_count_default_k, batch);
+        return_error_if_m(status, c.error, error_unknown_k, status.message());
+        export_changes(batch, arena, c);
+        return_if_error_m(c.error);
+        cursor = next;
+    });
+}
+
+void ustore_changes_free(ustore_changes_t c_cursor) {
+    delete reinterpret_cast<change_log_t::cursor_t*>(c_cursor);
 }
 
 /*********************************************************/
@@ -984,10 +3716,16 @@ void ustore_arena_free(ustore_arena_t c_arena) {
     clear_linked_memory(c_arena);
 }
 
+void ustore_arena_reset(ustore_arena_t c_arena) {
+    reset_linked_memory(c_arena);
+}
+
 void ustore_transaction_free(ustore_transaction_t const c_transaction) {
     if (!c_transaction)
         return;
-    transaction_t& txn = *reinterpret_cast<transaction_t*>(c_transaction);
+    txn_t& txn = *reinterpret_cast<txn_t*>(c_transaction);
+    if (txn.staged)
+        txn.native.rollback();
     delete &txn;
 }
 
@@ -996,9 +3734,35 @@ void ustore_database_free(ustore_database_t c_db) {
         return;
 
     database_t& db = *reinterpret_cast<database_t*>(c_db);
-    if (!db.persisted_directory.empty()) {
+    if (db.sweeper.joinable()) {
+        {
+            std::unique_lock sweeper_lock {db.sweeper_mutex};
+            db.sweeper_stop = true;
+        }
+        db.sweeper_wakeup.notify_one();
+        db.sweeper.join();
+    }
+    if (db.checkpointer.joinable()) {
+        {
+            std::unique_lock log_lock {db.log_mutex};
+            db.checkpointer_stop = true;
+        }
+        db.checkpointer_wakeup.notify_one();
+        db.checkpointer.join();
+    }
+
+    // With a write-ahead log, the recent changes are already on disk
+    if (db.options.write_ahead_log) {
+        unum::ustore::status_t status = db.log.sync();
+        status = db.log.close();
+    }
+    else if (!db.persisted_directory.empty()) {
         ustore_error_t c_error = nullptr;
-        safe_section("Saving to disk", &c_error, [&] { write(db, db.persisted_directory, &c_error); });
+        safe_section("Saving to disk", &c_error, [&] {
+            write(db, &c_error);
+            return_if_error_m(&c_error);
+            remove_logs(db.persisted_directory, std::numeric_limits<std::size_t>::max());
+        });
     }
 
     delete &db;
@@ -7,9 +7,13 @@
  * Understanding the costs of remote communication, might keep a cache.
  */
 
-#include <thread>      // `std::this_thread`
-#include <mutex>       // `std::mutex`
-#include <string_view> // `std::string_view`
+#include <thread>        // `std::this_thread`
+#include <mutex>         // `std::mutex`
+#include <future>        // `std::promise`
+#include <atomic>        // `std::atomic`
+#include <charconv>      // `std::from_chars`
+#include <string_view>   // `std::string_view`
+#include <unordered_map> // `std::unordered_map`
 
 #include <fmt/core.h>  // `fmt::format_to`
 #include <arrow/c/abi.h>
@@ -19,8 +23,10 @@
 
 #include "ustore/db.h"
 #include "ustore/arrow.h"
+#include "ustore/changes.h"
 #include "ustore/cpp/types.hpp" // `ustore_doc_field()`
 #include "helpers/arrow.hpp"
+#include "helpers/mutex.hpp" // `thread_index`
 
 /*********************************************************/
 /*****************   Structures & Consts  ****************/
@@ -37,12 +43,147 @@ ustore_key_t const ustore_key_unknown_k = std::numeric_limits<ustore_key_t>::max
 using namespace unum::ustore;
 using namespace unum;
 
-struct rpc_client_t {
+/**
+ * @brief A long-lived `DoExchange` stream, carrying many requests back-to-back.
+ * Concurrent callers only serialize on writing their frames, and then wait for
+ * their responses, matched by sequence numbers, without blocking each other.
+ */
+class rpc_pipeline_t {
+    using response_t = ar::Result<std::shared_ptr<ar::RecordBatch>>;
+
+    arf::FlightClient::DoExchangeResult stream_;
+    std::atomic<std::uint64_t> next_sequence_ {0};
+    std::mutex writing_;
+
+    std::mutex pending_mutex_;
+    std::unordered_map<std::uint64_t, std::promise<response_t>> pending_;
+    /// Once the stream fails, all the following requests fail with the same status.
+    ar::Status broken_;
+    std::thread receiver_;
+
+    void receive() noexcept {
+        ar::Status ar_status;
+        while (ar_status.ok()) {
+            auto maybe_chunk = stream_.reader->Next();
+            if (!maybe_chunk.ok()) {
+                ar_status = maybe_chunk.status();
+                break;
+            }
+            arf::FlightStreamChunk const& chunk = maybe_chunk.ValueUnsafe();
+            if (!chunk.app_metadata)
+                break;
+
+            std::uint64_t sequence = 0;
+            std::string_view error;
+            std::shared_ptr<ar::RecordBatch> batch;
+            ar_status = unpack_frame(chunk.app_metadata, sequence, error, batch);
+            if (!ar_status.ok())
+                break;
+
+            std::promise<response_t> promise;
+            {
+                std::lock_guard _ {pending_mutex_};
+                auto it = pending_.find(sequence);
+                if (it == pending_.end())
+                    continue;
+                promise = std::move(it->second);
+                pending_.erase(it);
+            }
+            if (error.empty())
+                promise.set_value(std::move(batch));
+            else
+                promise.set_value(ar::Status::ExecutionError(std::string(error)));
+        }
+
+        if (ar_status.ok())
+            ar_status = ar::Status::IOError("Pipeline was closed by the server");
+        std::lock_guard _ {pending_mutex_};
+        broken_ = ar_status;
+        for (auto& [sequence, promise] : pending_)
+            promise.set_value(ar_status);
+        pending_.clear();
+    }
+
+  public:
+    rpc_pipeline_t(arf::FlightClient::DoExchangeResult&& stream)
+        : stream_(std::move(stream)), receiver_([this] { receive(); }) {}
+
+    ~rpc_pipeline_t() noexcept {
+        {
+            std::lock_guard _ {writing_};
+            // The server finishes the stream after answering all the submitted requests
+            [[maybe_unused]] ar::Status ar_status = stream_.writer->DoneWriting();
+        }
+        receiver_.join();
+        [[maybe_unused]] ar::Status ar_status = stream_.writer->Close();
+    }
+
+    /**
+     * @brief Submits a request and blocks until its response arrives.
+     * @return The response batch, which may be empty for writes.
+     */
+    response_t call(std::string_view cmd, ar::RecordBatch const& batch, ar::ipc::IpcWriteOptions const& options) {
+        std::uint64_t sequence = next_sequence_.fetch_add(1, std::memory_order_relaxed);
+        auto maybe_frame = pack_frame(sequence, cmd, &batch, options);
+        if (!maybe_frame.ok())
+            return maybe_frame.status();
+
+        std::future<response_t> response;
+        {
+            std::lock_guard _ {pending_mutex_};
+            if (!broken_.ok())
+                return broken_;
+            response = pending_[sequence].get_future();
+        }
+
+        ar::Status ar_status;
+        {
+            std::lock_guard _ {writing_};
+            ar_status = stream_.writer->WriteMetadata(maybe_frame.MoveValueUnsafe());
+        }
+        if (!ar_status.ok()) {
+            std::lock_guard _ {pending_mutex_};
+            pending_.erase(sequence);
+            return ar_status;
+        }
+        return response.get();
+    }
+};
+
+struct rpc_connection_t {
     std::unique_ptr<arf::FlightClient> flight;
-    std::vector<std::unique_ptr<arf::FlightStreamReader>> readers;
+    /// Only present in the pipelined mode, and is destroyed before the `flight`.
+    std::unique_ptr<rpc_pipeline_t> pipeline;
+};
+
+/**
+ * @brief Client state, shared by all the threads of the process.
+ * Every thread sticks to one of the connections, so concurrent calls
+ * are spread across separate HTTP/2 connections.
+ */
+struct rpc_client_t {
+    std::vector<rpc_connection_t> connections;
+    /// Keeps the memory of the last responses alive, until the next call discards it.
+    std::vector<std::shared_ptr<void>> responses;
+    std::mutex responses_lock;
     linked_memory_t arena;
     std::mutex arena_lock;
     ustore_metadata_t metadata;
+    /// Applies to both the requests and the responses of bulky calls.
+    arrow_compression_t compression;
+
+    rpc_connection_t& connection() noexcept { return connections[thread_index() % connections.size()]; }
+    arf::FlightClient* flight() noexcept { return connection().flight.get(); }
+    rpc_pipeline_t* pipeline() noexcept { return connection().pipeline.get(); }
+
+    void hold_response(std::shared_ptr<void> response) {
+        std::lock_guard _ {responses_lock};
+        responses.push_back(std::move(response));
+    }
+    void discard_responses() noexcept {
+        std::lock_guard _ {responses_lock};
+        responses.clear();
+    }
 };
 
 arf::FlightCallOptions arrow_call_options(arrow_mem_pool_t& pool) {
@@ -58,6 +199,10 @@ void export_options(ustore_options_t options, std::string& cmd) {
         fmt::format_to(std::back_inserter(cmd), "{}&", kParamFlagSharedMemRead);
     if (options & ustore_option_transaction_dont_watch_k)
         fmt::format_to(std::back_inserter(cmd), "{}&", kParamFlagDontWatch);
+    if (options & ustore_option_scan_bulk_k)
+        fmt::format_to(std::back_inserter(cmd), "{}&", kParamFlagScanBulk);
+    if (options & ustore_option_scan_sequential_k)
+        fmt::format_to(std::back_inserter(cmd), "{}&", kParamFlagScanSequential);
 
     // This flag shouldn't be forwarded to the server.
     // In standalone builds it only applies to the client.
@@ -65,6 +210,84 @@ void export_options(ustore_options_t options, std::string& cmd) {
     //     fmt::format_to(std::back_inserter(cmd), "{}&", kParamFlagDontDiscard);
 }
 
+/**
+ * @brief Formats the descriptor of a modality call, executed on the server.
+ * Graph, Docs and Vectors calls are shipped whole, instead of being translated
+ * into many blob-level round-trips, and their results are kept alive until the
+ * next call discards them.
+ */
+std::string modality_cmd(std::string const& name,
+                         ustore_transaction_t transaction,
+                         ustore_snapshot_t snapshot,
+                         ustore_options_t options,
+                         rpc_client_t& db) {
+    std::string cmd;
+    fmt::format_to(std::back_inserter(cmd), "{}?", name);
+    if (transaction)
+        fmt::format_to(std::back_inserter(cmd), "{}=0x{:0>16x}&", kParamTransactionID, std::uintptr_t(transaction));
+    if (snapshot)
+        fmt::format_to(std::back_inserter(cmd), "{}={}&", kParamSnapshotID, snapshot);
+    export_options(options, cmd);
+    export_compression(db.compression, cmd);
+    return cmd;
+}
+
+/**
+ * @brief Submits the arguments packed with `arrow_bundle_t`, and receives the results packed the same way.
+ */
+ar::Result<std::shared_ptr<ar::RecordBatch>> exchange_bundle( //
+    rpc_client_t& db,
+    arf::FlightCallOptions& options,
+    std::string const& cmd,
+    arrow_bundle_t const& bundle) {
+
+    std::shared_ptr<ar::RecordBatch> request = bundle.batch();
+    ar::Status ar_status = arrow_compress_if_large(db.compression, *request, options.write_options);
+    if (!ar_status.ok())
+        return ar_status;
+
+    std::shared_ptr<ar::RecordBatch> response;
+    if (rpc_pipeline_t* pipeline = db.pipeline()) {
+        auto maybe_response = pipeline->call(cmd, *request, options.write_options);
+        if (!maybe_response.ok())
+            return maybe_response.status();
+        response = maybe_response.MoveValueUnsafe();
+    }
+    else {
+        arf::FlightDescriptor descriptor;
+        descriptor.type = arf::FlightDescriptor::UNKNOWN;
+        descriptor.cmd = cmd;
+        ar::Result<arf::FlightClient::DoExchangeResult> result = db.flight()->DoExchange(options, descriptor);
+        if (!result.ok())
+            return result.status();
+        ARROW_RETURN_NOT_OK(result->writer->Begin(request->schema()));
+        ARROW_RETURN_NOT_OK(result->writer->WriteRecordBatch(*request));
+        ARROW_RETURN_NOT_OK(result->writer->DoneWriting());
+
+        auto maybe_table = result->reader->ToTable();
+        if (!maybe_table.ok())
+            return maybe_table.status();
+        auto maybe_batch = combined_batch(maybe_table.MoveValueUnsafe());
+        if (!maybe_batch.ok())
+            return maybe_batch.status();
+        response = maybe_batch.MoveValueUnsafe();
+        db.hold_response(std::move(result->reader));
+    }
+    if (!response)
+        return ar::Status::Invalid("Expecting a response batch");
+    db.hold_response(response);
+    return response;
+}
+
+/**
+ * @brief Exports the address of a result into the output argument of a C call, if it was requested.
+ */
+template <typename scalar_at>
+void export_bundled(ar::RecordBatch const& batch, std::string const& name, scalar_at** output) {
+    if (output)
+        *output = const_cast<scalar_at*>(get_bundled<scalar_at>(batch, name).begin());
+}
+
 /*********************************************************/
 /*****************	    C Interface 	  ****************/
 /*********************************************************/
@@ -77,19 +300,47 @@ void ustore_database_init(ustore_database_init_t* c_ptr) {
         if (!c.config || !std::strlen(c.config))
             c.config = "grpc://0.0.0.0:38709";
 
+        // The URI may end with client-side parameters, like "?connections=4&pipeline"
+        std::string_view uri {c.config};
+        std::string_view params;
+        if (auto params_offset = uri.find('?'); params_offset != std::string_view::npos) {
+            params = uri.substr(params_offset);
+            uri = uri.substr(0, params_offset);
+        }
+        std::size_t connections_count = 1;
+        if (auto connections_param = param_value(params, kParamConnections); connections_param)
+            std::from_chars(connections_param->data(),
+                            connections_param->data() + connections_param->size(),
+                            connections_count);
+        bool const pipelined = param_value(params, kParamFlagPipeline).has_value();
+        return_error_if_m(connections_count, c.error, args_wrong_k, "At least one connection is needed");
+
         auto db_ptr = std::make_unique<rpc_client_t>();
-        auto maybe_location = arf::Location::Parse(c.config);
+        auto maybe_location = arf::Location::Parse(std::string(uri));
         return_error_if_m(maybe_location.ok(), c.error, args_wrong_k, "Server URI");
 
-        auto maybe_flight_ptr = arf::FlightClient::Connect(*maybe_location);
-        return_error_if_m(maybe_flight_ptr.ok(), c.error, network_k, "Flight Client Connection");
+        db_ptr->compression = arrow_compression(params);
+        db_ptr->connections.resize(connections_count);
+        for (rpc_connection_t& connection : db_ptr->connections) {
+            auto maybe_flight_ptr = arf::FlightClient::Connect(*maybe_location);
+            return_error_if_m(maybe_flight_ptr.ok(), c.error, network_k, "Flight Client Connection");
+            connection.flight = maybe_flight_ptr.MoveValueUnsafe();
+            if (!pipelined)
+                continue;
+
+            arf::FlightDescriptor descriptor;
+            descriptor.type = arf::FlightDescriptor::UNKNOWN;
+            descriptor.cmd = kFlightPipeline;
+            auto maybe_stream = connection.flight->DoExchange(descriptor);
+            return_error_if_m(maybe_stream.ok(), c.error, network_k, "Failed to open a pipeline");
+            connection.pipeline = std::make_unique<rpc_pipeline_t>(maybe_stream.MoveValueUnsafe());
+        }
 
         linked_memory(reinterpret_cast<ustore_arena_t*>(&db_ptr->arena), ustore_option_dont_discard_memory_k, c.error);
         return_error_if_m(maybe_location.ok(), c.error, args_wrong_k, "Failed to allocate default arena.");
-        db_ptr->flight = maybe_flight_ptr.MoveValueUnsafe();
 
         arf::Ticket ticket {kFlightRetrieveMetadata};
-        auto maybe_stream = db_ptr->flight->DoGet(ticket);
+        auto maybe_stream = db_ptr->flight()->DoGet(ticket);
         return_error_if_m(maybe_stream.ok(), c.error, network_k, "Failed to act on Arrow server");
         auto& stream_ptr = maybe_stream.ValueUnsafe();
         auto maybe_table = stream_ptr->ToTable();
@@ -113,7 +364,7 @@ void ustore_read(ustore_read_t* c_ptr) {
     return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
     rpc_client_t& db = *reinterpret_cast<rpc_client_t*>(c.db);
     if (!(c.options & ustore_option_dont_discard_memory_k))
-        db.readers.clear();
+        db.discard_responses();
 
     linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
     return_if_error_m(c.error);
@@ -151,6 +402,7 @@ void ustore_read(ustore_read_t* c_ptr) {
     if (partial_mode)
         fmt::format_to(std::back_inserter(descriptor.cmd), "{}={}&", kParamReadPart, partial_mode);
     export_options(c.options, descriptor.cmd);
+    export_compression(db.compression, descriptor.cmd);
 
     bool const has_collections_column = collections && !same_collection;
     constexpr bool has_keys_column = true;
@@ -211,24 +463,41 @@ void ustore_read(ustore_read_t* c_ptr) {
     std::shared_ptr<ar::RecordBatch> batch_ptr = maybe_batch.ValueUnsafe();
     if (batch_ptr->num_rows() == 0)
         return;
-    ar::Result<arf::FlightClient::DoExchangeResult> result = db.flight->DoExchange(options, descriptor);
-    return_error_if_m(result.ok(), c.error, network_k, "Failed to exchange with Arrow server");
-
-    ar_status = result->writer->Begin(batch_ptr->schema());
-    return_error_if_m(ar_status.ok(), c.error, error_unknown_k, "Serializing schema");
 
-    auto input_table = ar::Table::Make(batch_ptr->schema(), batch_ptr->columns(), static_cast<int64_t>(places.size()));
-    ar_status = result->writer->WriteTable(*input_table);
-    return_error_if_m(ar_status.ok(), c.error, error_unknown_k, "Serializing request");
-
-    ar_status = result->writer->DoneWriting();
-    return_error_if_m(ar_status.ok(), c.error, error_unknown_k, "Submitting request");
-
-    // Fetch the responses
-    // Requesting `ToTable` might be more efficient than concatenating and
-    // reallocating directly from our arena, as the underlying Arrow implementation
-    // may know the length of the entire dataset.
-    auto maybe_table = result->reader->ToTable();
+    ar_status = arrow_compress_if_large(db.compression, *batch_ptr, options.write_options);
+    return_error_if_m(ar_status.ok(), c.error, error_unknown_k, "Compression codec is unavailable");
+
+    ar::Result<std::shared_ptr<ar::Table>> maybe_table;
+    if (rpc_pipeline_t* pipeline = db.pipeline()) {
+        auto maybe_response = pipeline->call(descriptor.cmd, *batch_ptr, options.write_options);
+        return_error_if_m(maybe_response.ok(), c.error, network_k, "Failed to exchange with Arrow server");
+        return_error_if_m(maybe_response.ValueUnsafe(), c.error, error_unknown_k, "Expecting a response batch");
+        maybe_table = ar::Table::FromRecordBatches({maybe_response.MoveValueUnsafe()});
+        if (maybe_table.ok())
+            db.hold_response(maybe_table.ValueUnsafe());
+    }
+    else {
+        ar::Result<arf::FlightClient::DoExchangeResult> result = db.flight()->DoExchange(options, descriptor);
+        return_error_if_m(result.ok(), c.error, network_k, "Failed to exchange with Arrow server");
+
+        ar_status = result->writer->Begin(batch_ptr->schema());
+        return_error_if_m(ar_status.ok(), c.error, error_unknown_k, "Serializing schema");
+
+        auto input_table =
+            ar::Table::Make(batch_ptr->schema(), batch_ptr->columns(), static_cast<int64_t>(places.size()));
+        ar_status = result->writer->WriteTable(*input_table);
+        return_error_if_m(ar_status.ok(), c.error, error_unknown_k, "Serializing request");
+
+        ar_status = result->writer->DoneWriting();
+        return_error_if_m(ar_status.ok(), c.error, error_unknown_k, "Submitting request");
+
+        // Fetch the responses
+        // Requesting `ToTable` might be more efficient than concatenating and
+        // reallocating directly from our arena, as the underlying Arrow implementation
+        // may know the length of the entire dataset.
+        maybe_table = result->reader->ToTable();
+        db.hold_response(std::move(result->reader));
+    }
     return_error_if_m(maybe_table.ok(), c.error, error_unknown_k, "Failed to create table");
     auto table = maybe_table.ValueUnsafe();
     return_error_if_m(table->num_columns() == 1, c.error, error_unknown_k, "Expecting one column");
@@ -276,8 +545,6 @@ void ustore_read(ustore_read_t* c_ptr) {
             }
         }
     }
-
-    db.readers.push_back(std::move(result->reader));
 }
 
 void ustore_write(ustore_write_t* c_ptr) {
@@ -302,6 +569,8 @@ void ustore_write(ustore_write_t* c_ptr) {
     bool const same_collection = places.same_collection();
     bool const same_named_collection = same_collection && same_collections_are_named(places.collections_begin);
     bool const write_flush = c.options & ustore_option_write_flush_k;
+    bool const write_bulk = c.options & ustore_option_write_bulk_k;
+    bool const write_merge = c.options & ustore_option_write_merge_k;
 
     bool const has_collections_column = collections && !same_collection;
     constexpr bool has_keys_column = true;
@@ -441,13 +710,25 @@ void ustore_write(ustore_write_t* c_ptr) {
         fmt::format_to(std::back_inserter(descriptor.cmd), "{}=0x{:0>16x}&", kParamCollectionID, collections[0]);
     if (write_flush)
         fmt::format_to(std::back_inserter(descriptor.cmd), "{}&", kParamFlagFlushWrite);
+    if (write_bulk)
+        fmt::format_to(std::back_inserter(descriptor.cmd), "{}&", kParamFlagWriteBulk);
+    if (write_merge)
+        fmt::format_to(std::back_inserter(descriptor.cmd), "{}&", kParamFlagWriteMerge);
 
     // Send the request to server
     ar::Result<std::shared_ptr<ar::RecordBatch>> maybe_batch = ar::ImportRecordBatch(&input_array_c, &input_schema_c);
     return_error_if_m(maybe_batch.ok(), c.error, error_unknown_k, "Can't pack RecordBatch");
 
     std::shared_ptr<ar::RecordBatch> batch_ptr = maybe_batch.ValueUnsafe();
-    ar::Result<arf::FlightClient::DoPutResult> result = db.flight->DoPut(options, descriptor, batch_ptr->schema());
+    ar_status = arrow_compress_if_large(db.compression, *batch_ptr, options.write_options);
+    return_error_if_m(ar_status.ok(), c.error, error_unknown_k, "Compression codec is unavailable");
+    if (rpc_pipeline_t* pipeline = db.pipeline()) {
+        auto maybe_response = pipeline->call(descriptor.cmd, *batch_ptr, options.write_options);
+        return_error_if_m(maybe_response.ok(), c.error, network_k, "Failed to exchange with Arrow server");
+        return;
+    }
+
+    ar::Result<arf::FlightClient::DoPutResult> result = db.flight()->DoPut(options, descriptor, batch_ptr->schema());
     return_error_if_m(result.ok(), c.error, network_k, "Failed to exchange with Arrow server");
 
     // This writer has already been started!
@@ -604,7 +885,15 @@ void ustore_paths_write(ustore_paths_write_t* c_ptr) {
     return_error_if_m(maybe_batch.ok(), c.error, error_unknown_k, "Can't pack RecordBatch");
 
     std::shared_ptr<ar::RecordBatch> batch_ptr = maybe_batch.ValueUnsafe();
-    ar::Result<arf::FlightClient::DoPutResult> result = db.flight->DoPut(options, descriptor, batch_ptr->schema());
+    ar_status = arrow_compress_if_large(db.compression, *batch_ptr, options.write_options);
+    return_error_if_m(ar_status.ok(), c.error, error_unknown_k, "Compression codec is unavailable");
+    if (rpc_pipeline_t* pipeline = db.pipeline()) {
+        auto maybe_response = pipeline->call(descriptor.cmd, *batch_ptr, options.write_options);
+        return_error_if_m(maybe_response.ok(), c.error, network_k, "Failed to exchange with Arrow server");
+        return;
+    }
+
+    ar::Result<arf::FlightClient::DoPutResult> result = db.flight()->DoPut(options, descriptor, batch_ptr->schema());
     return_error_if_m(result.ok(), c.error, network_k, "Failed to exchange with Arrow server");
 
     // This writer has already been started!
@@ -630,7 +919,7 @@ void ustore_paths_match(ustore_paths_match_t* c_ptr) {
     return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
     rpc_client_t& db = *reinterpret_cast<rpc_client_t*>(c.db);
     if (!(c.options & ustore_option_dont_discard_memory_k))
-        db.readers.clear();
+        db.discard_responses();
 
     linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
     return_if_error_m(c.error);
@@ -677,6 +966,7 @@ void ustore_paths_match(ustore_paths_match_t* c_ptr) {
     if (partial_mode)
         fmt::format_to(std::back_inserter(descriptor.cmd), "{}={}&", kParamReadPart, partial_mode);
     export_options(c.options, descriptor.cmd);
+    export_compression(db.compression, descriptor.cmd);
 
     bool const has_collections_column = collections && !same_collection;
     bool const has_previous_column = previous != nullptr;
@@ -789,7 +1079,7 @@ void ustore_paths_match(ustore_paths_match_t* c_ptr) {
     std::shared_ptr<ar::RecordBatch> batch_ptr = maybe_batch.ValueUnsafe();
     if (batch_ptr->num_rows() == 0)
         return;
-    ar::Result<arf::FlightClient::DoExchangeResult> result = db.flight->DoExchange(options, descriptor);
+    ar::Result<arf::FlightClient::DoExchangeResult> result = db.flight()->DoExchange(options, descriptor);
     return_error_if_m(result.ok(), c.error, network_k, "Failed to exchange with Arrow server");
 
     ar_status = result->writer->Begin(batch_ptr->schema());
@@ -825,7 +1115,7 @@ void ustore_paths_match(ustore_paths_match_t* c_ptr) {
             *c.paths_strings = reinterpret_cast<ustore_char_t*>(data_ptr);
     }
 
-    db.readers.push_back(std::move(result->reader));
+    db.hold_response(std::move(result->reader));
 }
 
 void ustore_paths_read(ustore_paths_read_t* c_ptr) {
@@ -834,7 +1124,7 @@ void ustore_paths_read(ustore_paths_read_t* c_ptr) {
     return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
     rpc_client_t& db = *reinterpret_cast<rpc_client_t*>(c.db);
     if (!(c.options & ustore_option_dont_discard_memory_k))
-        db.readers.clear();
+        db.discard_responses();
 
     linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
     return_if_error_m(c.error);
@@ -877,6 +1167,7 @@ void ustore_paths_read(ustore_paths_read_t* c_ptr) {
     if (partial_mode)
         fmt::format_to(std::back_inserter(descriptor.cmd), "{}={}&", kParamReadPart, partial_mode);
     export_options(c.options, descriptor.cmd);
+    export_compression(db.compression, descriptor.cmd);
 
     bool const has_collections_column = collections && !same_collection;
     constexpr bool has_paths_column = true;
@@ -944,7 +1235,7 @@ void ustore_paths_read(ustore_paths_read_t* c_ptr) {
     std::shared_ptr<ar::RecordBatch> batch_ptr = maybe_batch.ValueUnsafe();
     if (batch_ptr->num_rows() == 0)
         return;
-    ar::Result<arf::FlightClient::DoExchangeResult> result = db.flight->DoExchange(options, descriptor);
+    ar::Result<arf::FlightClient::DoExchangeResult> result = db.flight()->DoExchange(options, descriptor);
     return_error_if_m(result.ok(), c.error, network_k, "Failed to exchange with Arrow server");
 
     ar_status = result->writer->Begin(batch_ptr->schema());
@@ -1010,7 +1301,7 @@ void ustore_paths_read(ustore_paths_read_t* c_ptr) {
         }
     }
 
-    db.readers.push_back(std::move(result->reader));
+    db.hold_response(std::move(result->reader));
 }
 
 void ustore_scan(ustore_scan_t* c_ptr) {
@@ -1019,7 +1310,7 @@ void ustore_scan(ustore_scan_t* c_ptr) {
     return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
     rpc_client_t& db = *reinterpret_cast<rpc_client_t*>(c.db);
     if (!(c.options & ustore_option_dont_discard_memory_k))
-        db.readers.clear();
+        db.discard_responses();
 
     linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
     return_if_error_m(c.error);
@@ -1122,6 +1413,7 @@ void ustore_scan(ustore_scan_t* c_ptr) {
     if (same_named_collection)
         fmt::format_to(std::back_inserter(descriptor.cmd), "{}=0x{:0>16x}&", kParamCollectionID, collections[0]);
     export_options(c.options, descriptor.cmd);
+    export_compression(db.compression, descriptor.cmd);
 
     // Send the request to server
     ar::Result<std::shared_ptr<ar::RecordBatch>> maybe_batch = ar::ImportRecordBatch(&input_array_c, &input_schema_c);
@@ -1130,7 +1422,7 @@ void ustore_scan(ustore_scan_t* c_ptr) {
     std::shared_ptr<ar::RecordBatch> batch_ptr = maybe_batch.ValueUnsafe();
     if (batch_ptr->num_rows() == 0)
         return;
-    ar::Result<arf::FlightClient::DoExchangeResult> result = db.flight->DoExchange(options, descriptor);
+    ar::Result<arf::FlightClient::DoExchangeResult> result = db.flight()->DoExchange(options, descriptor);
     return_error_if_m(result.ok(), c.error, network_k, "Failed to exchange with Arrow server");
 
     ar_status = result->writer->Begin(batch_ptr->schema());
@@ -1155,6 +1447,23 @@ void ustore_scan(ustore_scan_t* c_ptr) {
     auto offs_array = std::static_pointer_cast<ar::NumericArray<ar::UInt32Type>>(table->column(1)->chunk(0));
     auto data_ptr = (ustore_key_t*)keys_array->raw_values();
     auto offs_ptr = (ustore_length_t*)offs_array->raw_values();
+    db.hold_response(std::move(result->reader));
+
+    // The bounds aren't forwarded to the server, so the ranges are trimmed
+    // here, compacting the received keys in-place
+    strided_iterator_gt<ustore_key_t const> end_keys {c.end_keys, c.end_keys_stride};
+    if (end_keys && offs_ptr) {
+        ustore_length_t exported = 0;
+        for (std::size_t i = 0; i != places.count; ++i) {
+            ustore_length_t const begin = offs_ptr[i];
+            ustore_length_t const end = offs_ptr[i + 1];
+            offs_ptr[i] = exported;
+            for (ustore_length_t j = begin; j != end; ++j)
+                if (data_ptr[j] < end_keys[i])
+                    data_ptr[exported++] = data_ptr[j];
+        }
+        offs_ptr[places.count] = exported;
+    }
 
     if (c.offsets)
         *c.offsets = offs_ptr;
@@ -1167,7 +1476,48 @@ void ustore_scan(ustore_scan_t* c_ptr) {
             lens[i] = offs_ptr ? offs_ptr[i + 1] - offs_ptr[i] : 0;
     }
 
-    db.readers.push_back(std::move(result->reader));
+    // The values are pulled with a follow-up request, reusing the received keys
+    if (!c.values && !c.values_offsets)
+        return;
+
+    ustore_length_t const found_count = offs_ptr ? offs_ptr[places.count] : 0;
+    if (!found_count) {
+        auto empty_offsets = arena.alloc<ustore_length_t>(1, c.error).begin();
+        return_if_error_m(c.error);
+        empty_offsets[0] = 0;
+        if (c.values_offsets)
+            *c.values_offsets = empty_offsets;
+        if (c.values)
+            *c.values = nullptr;
+        return;
+    }
+
+    ustore_collection_t const* found_collections = collections.get();
+    if (!same_collection) {
+        auto continuous = arena.alloc<ustore_collection_t>(found_count, c.error).begin();
+        return_if_error_m(c.error);
+        for (std::size_t i = 0; i != places.count; ++i)
+            std::fill(continuous + offs_ptr[i], continuous + offs_ptr[i + 1], collections[i]);
+        found_collections = continuous;
+    }
+
+    ustore_read_t read {};
+    read.db = c.db;
+    read.error = c.error;
+    read.transaction = c.transaction;
+    read.snapshot = c.snapshot;
+    read.arena = arena;
+    read.options = ustore_options_t(ustore_option_dont_discard_memory_k |
+                                    (c.options & (ustore_option_transaction_dont_watch_k |
+                                                  ustore_option_read_shared_memory_k)));
+    read.tasks_count = found_count;
+    read.collections = found_collections;
+    read.collections_stride = same_collection ? 0 : sizeof(ustore_collection_t);
+    read.keys = data_ptr;
+    read.keys_stride = sizeof(ustore_key_t);
+    read.offsets = c.values_offsets;
+    read.values = c.values;
+    ustore_read(&read);
 }
 
 void ustore_sample(ustore_sample_t* c_ptr) {
@@ -1176,7 +1526,7 @@ void ustore_sample(ustore_sample_t* c_ptr) {
     return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
     rpc_client_t& db = *reinterpret_cast<rpc_client_t*>(c.db);
     if (!(c.options & ustore_option_dont_discard_memory_k))
-        db.readers.clear();
+        db.discard_responses();
 
     linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
     return_if_error_m(c.error);
@@ -1206,6 +1556,7 @@ void ustore_sample(ustore_sample_t* c_ptr) {
     if (same_named_collection)
         fmt::format_to(std::back_inserter(descriptor.cmd), "{}=0x{:0>16x}&", kParamCollectionID, collections[0]);
     export_options(c.options, descriptor.cmd);
+    export_compression(db.compression, descriptor.cmd);
 
     bool const has_collections_column = collections && !same_collection;
     bool const has_limits_column = true;
@@ -1265,7 +1616,7 @@ void ustore_sample(ustore_sample_t* c_ptr) {
     std::shared_ptr<ar::RecordBatch> batch_ptr = maybe_batch.ValueUnsafe();
     if (batch_ptr->num_rows() == 0)
         return;
-    ar::Result<arf::FlightClient::DoExchangeResult> result = db.flight->DoExchange(options, descriptor);
+    ar::Result<arf::FlightClient::DoExchangeResult> result = db.flight()->DoExchange(options, descriptor);
     return_error_if_m(result.ok(), c.error, network_k, "Failed to Get with Arrow server");
 
     ar_status = result->writer->Begin(batch_ptr->schema());
@@ -1290,6 +1641,23 @@ void ustore_sample(ustore_sample_t* c_ptr) {
     auto offs_array = std::static_pointer_cast<ar::NumericArray<ar::UInt32Type>>(table->column(1)->chunk(0));
     auto data_ptr = (ustore_key_t*)keys_array->raw_values();
     auto offs_ptr = (ustore_length_t*)offs_array->raw_values();
+    db.hold_response(std::move(result->reader));
+
+    // The bounds aren't forwarded to the server, so the ranges are trimmed
+    // here, compacting the received keys in-place
+    strided_iterator_gt<ustore_key_t const> end_keys {c.end_keys, c.end_keys_stride};
+    if (end_keys && offs_ptr) {
+        ustore_length_t exported = 0;
+        for (std::size_t i = 0; i != places.count; ++i) {
+            ustore_length_t const begin = offs_ptr[i];
+            ustore_length_t const end = offs_ptr[i + 1];
+            offs_ptr[i] = exported;
+            for (ustore_length_t j = begin; j != end; ++j)
+                if (data_ptr[j] < end_keys[i])
+                    data_ptr[exported++] = data_ptr[j];
+        }
+        offs_ptr[places.count] = exported;
+    }
 
     if (c.offsets)
         *c.offsets = offs_ptr;
@@ -1302,7 +1670,48 @@ void ustore_sample(ustore_sample_t* c_ptr) {
             lens[i] = offs_ptr ? offs_ptr[i + 1] - offs_ptr[i] : 0;
     }
 
-    db.readers.push_back(std::move(result->reader));
+    // The values are pulled with a follow-up request, reusing the received keys
+    if (!c.values && !c.values_offsets)
+        return;
+
+    ustore_length_t const found_count = offs_ptr ? offs_ptr[places.count] : 0;
+    if (!found_count) {
+        auto empty_offsets = arena.alloc<ustore_length_t>(1, c.error).begin();
+        return_if_error_m(c.error);
+        empty_offsets[0] = 0;
+        if (c.values_offsets)
+            *c.values_offsets = empty_offsets;
+        if (c.values)
+            *c.values = nullptr;
+        return;
+    }
+
+    ustore_collection_t const* found_collections = collections.get();
+    if (!same_collection) {
+        auto continuous = arena.alloc<ustore_collection_t>(found_count, c.error).begin();
+        return_if_error_m(c.error);
+        for (std::size_t i = 0; i != places.count; ++i)
+            std::fill(continuous + offs_ptr[i], continuous + offs_ptr[i + 1], collections[i]);
+        found_collections = continuous;
+    }
+
+    ustore_read_t read {};
+    read.db = c.db;
+    read.error = c.error;
+    read.transaction = c.transaction;
+    read.snapshot = c.snapshot;
+    read.arena = arena;
+    read.options = ustore_options_t(ustore_option_dont_discard_memory_k |
+                                    (c.options & (ustore_option_transaction_dont_watch_k |
+                                                  ustore_option_read_shared_memory_k)));
+    read.tasks_count = found_count;
+    read.collections = found_collections;
+    read.collections_stride = same_collection ? 0 : sizeof(ustore_collection_t);
+    read.keys = data_ptr;
+    read.keys_stride = sizeof(ustore_key_t);
+    read.offsets = c.values_offsets;
+    read.values = c.values;
+    ustore_read(&read);
 }
 
 void ustore_measure(ustore_measure_t* c_ptr) {
@@ -1314,10 +1723,381 @@ void ustore_measure(ustore_measure_t* c_ptr) {
     return_if_error_m(c.error);
 }
 
+void ustore_erase_range(ustore_erase_range_t* c_ptr) {
+
+    ustore_erase_range_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    return_error_if_m(c.start_keys && c.end_keys, c.error, args_wrong_k, "Ranges must have both ends");
+
+    rpc_client_t& db = *reinterpret_cast<rpc_client_t*>(c.db);
+    strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
+    strided_iterator_gt<ustore_key_t const> start_keys {c.start_keys, c.start_keys_stride};
+    strided_iterator_gt<ustore_key_t const> end_keys {c.end_keys, c.end_keys_stride};
+
+    std::lock_guard<std::mutex> lk(db.arena_lock);
+    arrow_mem_pool_t pool(db.arena);
+    arf::FlightCallOptions options = arrow_call_options(pool);
+
+    // Ranges are small, so every one of them is a separate action
+    for (std::size_t i = 0; i != c.tasks_count; ++i) {
+        arf::Action action;
+        fmt::format_to(std::back_inserter(action.type),
+                       "{}?{}=0x{:0>16x}&{}={}&{}={}",
+                       kFlightEraseRange,
+                       kParamCollectionID,
+                       collections ? collections[i] : ustore_collection_main_k,
+                       kParamScanStart,
+                       start_keys[i],
+                       kParamScanEnd,
+                       end_keys[i]);
+        if (c.options & ustore_option_write_flush_k)
+            fmt::format_to(std::back_inserter(action.type), "&{}", kParamFlagFlushWrite);
+
+        ar::Result<std::unique_ptr<arf::ResultStream>> maybe_stream = db.flight()->DoAction(options, action);
+        return_error_if_m(maybe_stream.ok(), c.error, network_k, "Failed to act on Arrow server");
+    }
+}
+
 /*********************************************************/
 /*****************	Collections Management	****************/
 /*********************************************************/
 
+void ustore_graph_find_edges(ustore_graph_find_edges_t* c_ptr) {
+
+    ustore_graph_find_edges_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    if (!c.tasks_count)
+        return;
+    rpc_client_t& db = *reinterpret_cast<rpc_client_t*>(c.db);
+    if (!(c.options & ustore_option_dont_discard_memory_k))
+        db.discard_responses();
+
+    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
+    return_if_error_m(c.error);
+    arrow_mem_pool_t pool(arena);
+    arf::FlightCallOptions options = arrow_call_options(pool);
+
+    bool const want_edges = c.edges_per_vertex;
+    bool const want_attributes = want_edges && (c.timestamps_per_edge || c.weights_per_edge);
+    arrow_bundle_t bundle(&pool);
+    ar::Status ar_status;
+    strided_iterator_gt<ustore_key_t const> vertices {c.vertices, c.vertices_stride};
+    strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
+    strided_iterator_gt<ustore_vertex_role_t const> roles {c.roles, c.roles_stride};
+    ar_status &= bundle.add_scalar<ustore_size_t>(kArgCounts, c.tasks_count);
+    ar_status &= bundle.add(kArgVertices, vertices, c.tasks_count);
+    ar_status &= bundle.add(kArgCols, collections, c.tasks_count);
+    ar_status &= bundle.add(kArgRoles, roles, c.tasks_count);
+    ar_status &= bundle.add_scalar<ustore_octet_t>(kArgWantEdges, want_edges);
+    ar_status &= bundle.add_scalar<ustore_octet_t>(kArgWantAttributes, want_attributes);
+    return_error_if_m(ar_status.ok(), c.error, error_unknown_k, "Can't pack the request");
+
+    std::string cmd = modality_cmd(kFlightGraphFindEdges, c.transaction, c.snapshot, c.options, db);
+    auto maybe_response = exchange_bundle(db, options, cmd, bundle);
+    return_error_if_m(maybe_response.ok(), c.error, network_k, "Failed to exchange with Arrow server");
+    ar::RecordBatch const& response = *maybe_response.ValueUnsafe();
+
+    return_error_if_m(get_bundled<ustore_vertex_degree_t>(response, kArgDegrees).size() == c.tasks_count,
+                      c.error,
+                      error_unknown_k,
+                      "Server returned wrong number of degrees");
+    export_bundled(response, kArgDegrees, c.degrees_per_vertex);
+    if (want_edges)
+        export_bundled(response, kArgEdges, c.edges_per_vertex);
+    if (want_attributes) {
+        export_bundled(response, kArgTimestamps, c.timestamps_per_edge);
+        export_bundled(response, kArgWeights, c.weights_per_edge);
+    }
+}
+
+void ustore_graph_upsert_edges(ustore_graph_upsert_edges_t* c_ptr) {
+
+    ustore_graph_upsert_edges_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    if (!c.tasks_count)
+        return;
+    rpc_client_t& db = *reinterpret_cast<rpc_client_t*>(c.db);
+    if (!(c.options & ustore_option_dont_discard_memory_k))
+        db.discard_responses();
+
+    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
+    return_if_error_m(c.error);
+    arrow_mem_pool_t pool(arena);
+    arf::FlightCallOptions options = arrow_call_options(pool);
+
+    strided_iterator_gt<ustore_key_t const> sources {c.sources_ids, c.sources_stride};
+    strided_iterator_gt<ustore_key_t const> targets {c.targets_ids, c.targets_stride};
+    strided_iterator_gt<ustore_key_t const> edges {c.edges_ids, c.edges_stride};
+    strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
+    strided_iterator_gt<std::int64_t const> timestamps {c.timestamps, c.timestamps_stride};
+    strided_iterator_gt<ustore_float_t const> weights {c.weights, c.weights_stride};
+    arrow_bundle_t bundle(&pool);
+    ar::Status ar_status;
+    ar_status &= bundle.add_scalar<ustore_size_t>(kArgCounts, c.tasks_count);
+    ar_status &= bundle.add(kArgSources, sources, c.tasks_count);
+    ar_status &= bundle.add(kArgTargets, targets, c.tasks_count);
+    ar_status &= bundle.add(kArgEdges, edges, c.tasks_count);
+    ar_status &= bundle.add(kArgCols, collections, c.tasks_count);
+    ar_status &= bundle.add(kArgTimestamps, timestamps, c.tasks_count);
+    ar_status &= bundle.add(kArgWeights, weights, c.tasks_count);
+    return_error_if_m(ar_status.ok(), c.error, error_unknown_k, "Can't pack the request");
+
+    std::string cmd = modality_cmd(kFlightGraphUpsertEdges, c.transaction, 0, c.options, db);
+    auto maybe_response = exchange_bundle(db, options, cmd, bundle);
+    return_error_if_m(maybe_response.ok(), c.error, network_k, "Failed to exchange with Arrow server");
+}
+
+void ustore_docs_write(ustore_docs_write_t* c_ptr) {
+
+    ustore_docs_write_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    if (!c.tasks_count)
+        return;
+    rpc_client_t& db = *reinterpret_cast<rpc_client_t*>(c.db);
+    if (!(c.options & ustore_option_dont_discard_memory_k))
+        db.discard_responses();
+
+    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
+    return_if_error_m(c.error);
+    arrow_mem_pool_t pool(arena);
+    arf::FlightCallOptions options = arrow_call_options(pool);
+
+    strided_iterator_gt<ustore_bytes_cptr_t const> values {c.values, c.values_stride};
+    strided_iterator_gt<ustore_length_t const> offsets {c.offsets, c.offsets_stride};
+    strided_iterator_gt<ustore_length_t const> lengths {c.lengths, c.lengths_stride};
+    bits_view_t presences {c.presences};
+    contents_arg_t contents {presences, offsets, lengths, values, c.tasks_count};
+    strided_iterator_gt<ustore_key_t const> keys {c.keys, c.keys_stride};
+    strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
+    strided_iterator_gt<ustore_collection_t const> indexes_cols {c.indexes_collections, c.indexes_collections_stride};
+    strided_iterator_gt<ustore_collection_t const> shreds_cols {c.shreds_collections, c.shreds_collections_stride};
+
+    arrow_bundle_t bundle(&pool);
+    ar::Status ar_status;
+    ar_status &= bundle.add_scalar<ustore_size_t>(kArgCounts, c.tasks_count);
+    ar_status &= bundle.add_scalar(kArgType, c.type);
+    ar_status &= bundle.add_scalar(kArgModification, c.modification);
+    ar_status &= bundle.add_scalar<ustore_octet_t>(kArgJoined, c.values_joined);
+    ar_status &= bundle.add(kArgKeys, keys, c.tasks_count);
+    ar_status &= bundle.add(kArgCols, collections, c.tasks_count);
+
+    // Documents are joined into one buffer, with NULL entries marked by missing lengths
+    if (c.values_joined) {
+        value_view_t joined = contents[0];
+        ar_status &= bundle.add(kArgVals, joined.data(), joined.size());
+        ar_status &= bundle.add_scalar<ustore_length_t>(kArgOffsets, 0);
+        ar_status &= bundle.add_scalar<ustore_length_t>(kArgLengths, static_cast<ustore_length_t>(joined.size()));
+    }
+    else if (values) {
+        std::size_t total = 0;
+        for (std::size_t i = 0; i != c.tasks_count; ++i)
+            total += contents[i].size();
+        auto joined = arena.alloc<byte_t>(total, c.error);
+        return_if_error_m(c.error);
+        auto joined_offsets = arena.alloc<ustore_length_t>(c.tasks_count, c.error);
+        return_if_error_m(c.error);
+        auto joined_lengths = arena.alloc<ustore_length_t>(c.tasks_count, c.error);
+        return_if_error_m(c.error);
+
+        std::size_t progress = 0;
+        for (std::size_t i = 0; i != c.tasks_count; ++i) {
+            value_view_t value = contents[i];
+            joined_offsets[i] = static_cast<ustore_length_t>(progress);
+            joined_lengths[i] = value ? static_cast<ustore_length_t>(value.size()) : ustore_length_missing_k;
+            if (value)
+                std::memcpy(joined.begin() + progress, value.data(), value.size());
+            progress += value.size();
+        }
+        ar_status &= bundle.add(kArgVals, joined.begin(), total);
+        ar_status &= bundle.add(kArgOffsets, joined_offsets.begin(), c.tasks_count);
+        ar_status &= bundle.add(kArgLengths, joined_lengths.begin(), c.tasks_count);
+    }
+
+    if (c.fields)
+        ar_status &= bundle.add_strings(kArgFields, {c.fields, c.fields_stride}, c.fields_stride ? c.tasks_count : 1);
+    if (c.id_field)
+        ar_status &= bundle.add_strings(kArgIdField, {&c.id_field, 0}, 1);
+    if (c.indexes_count) {
+        ar_status &= bundle.add_strings(kArgIndexesFields,
+                                        {c.indexes_fields, c.indexes_fields_stride},
+                                        c.indexes_count);
+        ar_status &= bundle.add(kArgIndexesCols, indexes_cols, c.indexes_count);
+    }
+    if (c.shreds_count) {
+        ar_status &= bundle.add_strings(kArgShredsFields, {c.shreds_fields, c.shreds_fields_stride}, c.shreds_count);
+        ar_status &= bundle.add(kArgShredsCols, shreds_cols, c.shreds_count);
+    }
+    return_error_if_m(ar_status.ok(), c.error, error_unknown_k, "Can't pack the request");
+
+    std::string cmd = modality_cmd(kFlightDocsWrite, c.transaction, 0, c.options, db);
+    auto maybe_response = exchange_bundle(db, options, cmd, bundle);
+    return_error_if_m(maybe_response.ok(), c.error, network_k, "Failed to exchange with Arrow server");
+}
+
+void ustore_docs_gather(ustore_docs_gather_t* c_ptr) {
+
+    ustore_docs_gather_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    rpc_client_t& db = *reinterpret_cast<rpc_client_t*>(c.db);
+    if (!(c.options & ustore_option_dont_discard_memory_k))
+        db.discard_responses();
+
+    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
+    return_if_error_m(c.error);
+    arrow_mem_pool_t pool(arena);
+    arf::FlightCallOptions options = arrow_call_options(pool);
+
+    strided_iterator_gt<ustore_key_t const> keys {c.keys, c.keys_stride};
+    strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
+    strided_iterator_gt<ustore_doc_field_type_t const> types {c.types, c.types_stride};
+    strided_iterator_gt<ustore_doc_compare_t const> operators {c.filters_operators, c.filters_operators_stride};
+    strided_iterator_gt<ustore_collection_t const> shreds_cols {c.shreds_collections, c.shreds_collections_stride};
+    arrow_bundle_t bundle(&pool);
+    ar::Status ar_status;
+    ar_status &= bundle.add_scalar<ustore_size_t>(kArgCounts, c.docs_count);
+    ar_status &= bundle.add(kArgKeys, keys, c.docs_count);
+    ar_status &= bundle.add(kArgCols, collections, c.docs_count);
+    ar_status &= bundle.add_strings(kArgFields, {c.fields, c.fields_stride}, c.fields_count);
+    ar_status &= bundle.add(kArgTypes, types, c.fields_count);
+    ar_status &= bundle.add_scalar<ustore_octet_t>(kArgWantConversions, c.columns_conversions != nullptr);
+    ar_status &= bundle.add_scalar<ustore_octet_t>(kArgWantCollisions, c.columns_collisions != nullptr);
+    if (c.filters_count) {
+        ar_status &= bundle.add_strings(kArgFiltersFields,
+                                        {c.filters_fields, c.filters_fields_stride},
+                                        c.filters_count);
+        ar_status &= bundle.add(kArgFiltersOperators, operators, c.filters_count);
+        ar_status &= bundle.add_strings(kArgFiltersValues,
+                                        {c.filters_values, c.filters_values_stride},
+                                        c.filters_count);
+    }
+    if (c.shreds_count) {
+        ar_status &= bundle.add_strings(kArgShredsFields, {c.shreds_fields, c.shreds_fields_stride}, c.shreds_count);
+        ar_status &= bundle.add(kArgShredsCols, shreds_cols, c.shreds_count);
+    }
+    return_error_if_m(ar_status.ok(), c.error, error_unknown_k, "Can't pack the request");
+
+    std::string cmd = modality_cmd(kFlightDocsGather, c.transaction, c.snapshot, c.options, db);
+    auto maybe_response = exchange_bundle(db, options, cmd, bundle);
+    return_error_if_m(maybe_response.ok(), c.error, network_k, "Failed to exchange with Arrow server");
+    ar::RecordBatch const& response = *maybe_response.ValueUnsafe();
+
+    auto selected_count = get_bundled<ustore_size_t>(response, kArgCounts);
+    return_error_if_m(selected_count.size() == 1, c.error, error_unknown_k, "Server didn't report the selection");
+    if (c.selected_count)
+        *c.selected_count = selected_count[0];
+    export_bundled(response, kArgSelected, c.selected_indices);
+    export_bundled(response, kArgStrings, c.joined_strings);
+
+    // Rebuild the per-field addresses, pointing into the columns shipped by the server
+    auto addresses = arena.alloc<void*>(c.fields_count * 6, c.error);
+    return_if_error_m(c.error);
+    auto validities = reinterpret_cast<ustore_octet_t**>(addresses.begin());
+    auto conversions = reinterpret_cast<ustore_octet_t**>(addresses.begin() + c.fields_count);
+    auto collisions = reinterpret_cast<ustore_octet_t**>(addresses.begin() + c.fields_count * 2);
+    auto scalars = reinterpret_cast<ustore_byte_t**>(addresses.begin() + c.fields_count * 3);
+    auto offsets = reinterpret_cast<ustore_length_t**>(addresses.begin() + c.fields_count * 4);
+    auto lengths = reinterpret_cast<ustore_length_t**>(addresses.begin() + c.fields_count * 5);
+    for (std::size_t field_idx = 0; field_idx != c.fields_count; ++field_idx) {
+        std::string suffix = "." + std::to_string(field_idx);
+        export_bundled(response, kArgValidities + suffix, &validities[field_idx]);
+        export_bundled(response, kArgConversions + suffix, &conversions[field_idx]);
+        export_bundled(response, kArgCollisions + suffix, &collisions[field_idx]);
+        export_bundled(response, kArgScalars + suffix, &scalars[field_idx]);
+        export_bundled(response, kArgOffsets + suffix, &offsets[field_idx]);
+        export_bundled(response, kArgLengths + suffix, &lengths[field_idx]);
+    }
+    if (c.columns_validities)
+        *c.columns_validities = validities;
+    if (c.columns_conversions)
+        *c.columns_conversions = conversions;
+    if (c.columns_collisions)
+        *c.columns_collisions = collisions;
+    if (c.columns_scalars)
+        *c.columns_scalars = scalars;
+    if (c.columns_offsets)
+        *c.columns_offsets = offsets;
+    if (c.columns_lengths)
+        *c.columns_lengths = lengths;
+}
+
+void ustore_vectors_search(ustore_vectors_search_t* c_ptr) {
+
+    ustore_vectors_search_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    return_error_if_m(c.match_counts_limits, c.error, args_wrong_k, "Match count limits are required");
+    return_error_if_m(!c.filter_fields_count || (c.filter_fields && c.filter_values),
+                      c.error,
+                      args_wrong_k,
+                      "Filter needs both the fields and the expected values");
+    if (!c.tasks_count)
+        return;
+    rpc_client_t& db = *reinterpret_cast<rpc_client_t*>(c.db);
+    if (!(c.options & ustore_option_dont_discard_memory_k))
+        db.discard_responses();
+
+    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
+    return_if_error_m(c.error);
+    arrow_mem_pool_t pool(arena);
+    arf::FlightCallOptions options = arrow_call_options(pool);
+
+    // Gather the queries into one continuous buffer
+    std::size_t scalar_bytes = 0;
+    switch (c.scalar_type) {
+    case ustore_vector_scalar_f32_k: scalar_bytes = sizeof(float); break;
+    case ustore_vector_scalar_f64_k: scalar_bytes = sizeof(double); break;
+    case ustore_vector_scalar_f16_k: scalar_bytes = sizeof(std::int16_t); break;
+    case ustore_vector_scalar_i8_k: scalar_bytes = sizeof(std::int8_t); break;
+    }
+    return_error_if_m(scalar_bytes && c.dimensions, c.error, args_wrong_k, "Unsupported vector shape");
+    std::size_t const query_bytes = scalar_bytes * c.dimensions;
+    strided_iterator_gt<ustore_bytes_cptr_t const> starts {c.queries_starts, c.queries_starts_stride};
+    strided_iterator_gt<ustore_length_t const> offs {c.queries_offsets, c.queries_offsets_stride};
+    auto queries = arena.alloc<byte_t>(query_bytes * c.tasks_count, c.error);
+    return_if_error_m(c.error);
+    for (std::size_t i = 0; i != c.tasks_count; ++i) {
+        ustore_bytes_cptr_t begin = starts[i] + (offs ? offs[i] : 0u) + c.queries_stride * i;
+        std::memcpy(queries.begin() + query_bytes * i, begin, query_bytes);
+    }
+
+    strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
+    strided_iterator_gt<ustore_length_t const> limits {c.match_counts_limits, c.match_counts_limits_stride};
+    strided_iterator_gt<ustore_collection_t const> packed_cols {c.packed_collections, c.packed_collections_stride};
+    arrow_bundle_t bundle(&pool);
+    ar::Status ar_status;
+    ar_status &= bundle.add_scalar<ustore_size_t>(kArgCounts, c.tasks_count);
+    ar_status &= bundle.add_scalar<ustore_length_t>(kArgDimensions, c.dimensions);
+    ar_status &= bundle.add_scalar(kArgScalarType, c.scalar_type);
+    ar_status &= bundle.add_scalar(kArgMetric, c.metric);
+    ar_status &= bundle.add_scalar(kArgMetricThreshold, c.metric_threshold);
+    ar_status &= bundle.add_scalar(kArgSearchExpansion, c.search_expansion);
+    ar_status &= bundle.add(kArgQueries, queries.begin(), queries.size());
+    ar_status &= bundle.add(kArgCols, collections, c.tasks_count);
+    ar_status &= bundle.add(kArgCountLimits, limits, c.tasks_count);
+    ar_status &= bundle.add(kArgPackedCols, packed_cols, c.tasks_count);
+    if (c.allowed_keys)
+        ar_status &= bundle.add(kArgAllowedKeys, c.allowed_keys, c.allowed_keys_count);
+    if (std::size_t count_filters = c.filter_fields_count; count_filters) {
+        ar_status &= bundle.add_scalar(kArgFilterCol, c.filter_collection);
+        ar_status &= bundle.add_strings(kArgFiltersFields, {c.filter_fields, c.filter_fields_stride}, count_filters);
+        ar_status &= bundle.add_strings(kArgFiltersValues, {c.filter_values, c.filter_values_stride}, count_filters);
+    }
+    return_error_if_m(ar_status.ok(), c.error, error_unknown_k, "Can't pack the request");
+
+    std::string cmd = modality_cmd(kFlightVectorsSearch, c.transaction, 0, c.options, db);
+    auto maybe_response = exchange_bundle(db, options, cmd, bundle);
+    return_error_if_m(maybe_response.ok(), c.error, network_k, "Failed to exchange with Arrow server");
+    ar::RecordBatch const& response = *maybe_response.ValueUnsafe();
+
+    return_error_if_m(get_bundled<ustore_length_t>(response, kArgCounts).size() == c.tasks_count,
+                      c.error,
+                      error_unknown_k,
+                      "Server returned wrong number of results");
+    export_bundled(response, kArgCounts, c.match_counts);
+    export_bundled(response, kArgOffsets, c.match_offsets);
+    export_bundled(response, kArgKeys, c.match_keys);
+    export_bundled(response, kArgMetrics, c.match_metrics);
+}
+
 void ustore_collection_create(ustore_collection_create_t* c_ptr) {
 
     ustore_collection_create_t& c = *c_ptr;
@@ -1337,7 +2117,7 @@ void ustore_collection_create(ustore_collection_create_t* c_ptr) {
         std::lock_guard<std::mutex> lk(db.arena_lock);
         arrow_mem_pool_t pool(db.arena);
         arf::FlightCallOptions options = arrow_call_options(pool);
-        maybe_stream = db.flight->DoAction(options, action);
+        maybe_stream = db.flight()->DoAction(options, action);
     }
     return_error_if_m(maybe_stream.ok(), c.error, network_k, "Failed to act on Arrow server");
     auto& stream_ptr = maybe_stream.ValueUnsafe();
@@ -1378,7 +2158,7 @@ void ustore_collection_drop(ustore_collection_drop_t* c_ptr) {
     std::lock_guard<std::mutex> lk(db.arena_lock);
     arrow_mem_pool_t pool(db.arena);
     arf::FlightCallOptions options = arrow_call_options(pool);
-    ar::Result<std::unique_ptr<arf::ResultStream>> maybe_stream = db.flight->DoAction(options, action);
+    ar::Result<std::unique_ptr<arf::ResultStream>> maybe_stream = db.flight()->DoAction(options, action);
     return_error_if_m(maybe_stream.ok(), c.error, network_k, "Failed to act on Arrow server");
 }
 
@@ -1388,7 +2168,7 @@ void ustore_collection_list(ustore_collection_list_t* c_ptr) {
     return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
     rpc_client_t& db = *reinterpret_cast<rpc_client_t*>(c.db);
     if (!(c.options & ustore_option_dont_discard_memory_k))
-        db.readers.clear();
+        db.discard_responses();
 
     linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
     return_if_error_m(c.error);
@@ -1404,7 +2184,7 @@ void ustore_collection_list(ustore_collection_list_t* c_ptr) {
                        kParamTransactionID,
                        std::uintptr_t(c.transaction));
 
-    auto maybe_stream = db.flight->DoGet(options, ticket);
+    auto maybe_stream = db.flight()->DoGet(options, ticket);
     return_error_if_m(maybe_stream.ok(), c.error, network_k, "Failed to act on Arrow server");
     auto& stream_ptr = maybe_stream.ValueUnsafe();
 
@@ -1427,7 +2207,7 @@ void ustore_collection_list(ustore_collection_list_t* c_ptr) {
         *c.ids = (ustore_collection_t*)array->raw_values();
     }
 
-    db.readers.push_back(std::move(stream_ptr));
+    db.hold_response(std::move(stream_ptr));
 }
 
 void ustore_database_control(ustore_database_control_t* c_ptr) {
@@ -1457,7 +2237,7 @@ void ustore_snapshot_list(ustore_snapshot_list_t* c_ptr) {
     rpc_client_t& db = *reinterpret_cast<rpc_client_t*>(c.db);
 
     arf::Ticket ticket {kFlightListSnap};
-    ar::Result<std::unique_ptr<arf::FlightStreamReader>> maybe_stream = db.flight->DoGet(options, ticket);
+    ar::Result<std::unique_ptr<arf::FlightStreamReader>> maybe_stream = db.flight()->DoGet(options, ticket);
     return_error_if_m(maybe_stream.ok(), c.error, network_k, "Failed to act on Arrow server");
 
     auto& stream_ptr = maybe_stream.ValueUnsafe();
@@ -1491,7 +2271,7 @@ void ustore_snapshot_create(ustore_snapshot_create_t* c_ptr) {
         std::lock_guard<std::mutex> lk(db.arena_lock);
         arrow_mem_pool_t pool(db.arena);
         arf::FlightCallOptions options = arrow_call_options(pool);
-        maybe_stream = db.flight->DoAction(options, action);
+        maybe_stream = db.flight()->DoAction(options, action);
     }
     return_error_if_m(maybe_stream.ok(), c.error, network_k, "Failed to act on Arrow server");
     auto& stream_ptr = maybe_stream.ValueUnsafe();
@@ -1525,7 +2305,7 @@ void ustore_snapshot_export(ustore_snapshot_export_t* c_ptr) {
         std::lock_guard<std::mutex> lk(db.arena_lock);
         arrow_mem_pool_t pool(db.arena);
         arf::FlightCallOptions options = arrow_call_options(pool);
-        ar::Result<std::unique_ptr<arf::ResultStream>> maybe_stream = db.flight->DoAction(options, action);
+        ar::Result<std::unique_ptr<arf::ResultStream>> maybe_stream = db.flight()->DoAction(options, action);
         return_error_if_m(maybe_stream.ok(), c.error, network_k, "Failed to act on Arrow server");
     }
     catch (...) {
@@ -1545,7 +2325,7 @@ void ustore_snapshot_drop(ustore_snapshot_drop_t* c_ptr) {
     std::lock_guard<std::mutex> lk(db.arena_lock);
     arrow_mem_pool_t pool(db.arena);
     arf::FlightCallOptions options = arrow_call_options(pool);
-    ar::Result<std::unique_ptr<arf::ResultStream>> maybe_stream = db.flight->DoAction(options, action);
+    ar::Result<std::unique_ptr<arf::ResultStream>> maybe_stream = db.flight()->DoAction(options, action);
     return_error_if_m(maybe_stream.ok(), c.error, network_k, "Failed to act on Arrow server");
 }
 
@@ -1574,7 +2354,7 @@ void ustore_transaction_init(ustore_transaction_init_t* c_ptr) {
         std::lock_guard<std::mutex> lk(db.arena_lock);
         arrow_mem_pool_t pool(db.arena);
         arf::FlightCallOptions options = arrow_call_options(pool);
-        maybe_stream = db.flight->DoAction(options, action);
+        maybe_stream = db.flight()->DoAction(options, action);
     }
     return_error_if_m(maybe_stream.ok(), c.error, network_k, "Failed to act on Arrow server");
 
@@ -1590,6 +2370,14 @@ void ustore_transaction_init(ustore_transaction_init_t* c_ptr) {
     std::memcpy(c.transaction, id_ptr->body->data(), sizeof(ustore_transaction_t));
 }
 
+/**
+ * Staged transactions hold locks on the server, that wouldn't outlive a broken connection.
+ */
+void ustore_transaction_stage(ustore_transaction_stage_t* c_ptr) {
+    ustore_transaction_stage_t& c = *c_ptr;
+    *c.error = "Staging transactions isn't supported by the Arrow Flight client!";
+}
+
 void ustore_transaction_commit(ustore_transaction_commit_t* c_ptr) {
 
     ustore_transaction_commit_t& c = *c_ptr;
@@ -1609,10 +2397,27 @@ void ustore_transaction_commit(ustore_transaction_commit_t* c_ptr) {
     std::lock_guard<std::mutex> lk(db.arena_lock);
     arrow_mem_pool_t pool(db.arena);
     arf::FlightCallOptions options = arrow_call_options(pool);
-    ar::Result<std::unique_ptr<arf::ResultStream>> maybe_stream = db.flight->DoAction(options, action);
+    ar::Result<std::unique_ptr<arf::ResultStream>> maybe_stream = db.flight()->DoAction(options, action);
     return_error_if_m(maybe_stream.ok(), c.error, network_k, "Failed to act on Arrow server");
 }
 
+/*********************************************************/
+/*****************	     Change Feed	  ****************/
+/*********************************************************/
+
+void ustore_changes_subscribe(ustore_changes_subscribe_t* c_ptr) {
+    ustore_changes_subscribe_t& c = *c_ptr;
+    *c.error = "Change feeds aren't supported by the Arrow Flight client!";
+}
+
+void ustore_changes_poll(ustore_changes_poll_t* c_ptr) {
+    ustore_changes_poll_t& c = *c_ptr;
+    *c.error = "Change feeds aren't supported by the Arrow Flight client!";
+}
+
+void ustore_changes_free(ustore_changes_t) {
+}
+
 /*********************************************************/
 /*****************	  Memory Management   ****************/
 /*********************************************************/
@@ -1621,6 +2426,10 @@ void ustore_arena_free(ustore_arena_t c_arena) {
     clear_linked_memory(c_arena);
 }
 
+void ustore_arena_reset(ustore_arena_t c_arena) {
+    reset_linked_memory(c_arena);
+}
+
 void ustore_transaction_free(ustore_transaction_t const c_transaction) {
     if (!c_transaction)
         return;
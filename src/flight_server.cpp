@@ -10,15 +10,26 @@
  */
 #include <csignal>
 #include <mutex>
-#include <fstream>    // `std::ifstream`
-#include <charconv>   // `std::from_chars`
-#include <chrono>     // `std::time_point`
-#include <cstdio>     // `std::printf`
-#include <iostream>   // `std::cerr`
-#include <filesystem> // Enumerating and creating directories
+#include <thread>             // `std::thread`
+#include <condition_variable> // `std::condition_variable`
+#include <memory>             // `std::unique_ptr`
+#include <future>             // `std::async`
+#include <limits>             // `std::numeric_limits`
+#include <atomic>             // `std::atomic`
+#include <fstream>            // `std::ifstream`
+#include <charconv>           // `std::from_chars`
+#include <cctype>             // `std::isspace`
+#include <chrono>             // `std::time_point`
+#include <cstdio>             // `std::printf`
+#include <iostream>           // `std::cerr`
+#include <filesystem>         // Enumerating and creating directories
 #include <unordered_map>
 #include <unordered_set>
 
+#if defined(__linux__)
+#include <sched.h> // `sched_setaffinity`
+#endif
+
 #include <arrow/flight/server.h> // RPC Server Implementation
 #include <clipp.h>               // Command Line Interface
 
@@ -26,6 +37,8 @@
 #include "ustore/cpp/types.hpp" // `hash_combine`
 
 #include "helpers/arrow.hpp"
+#include "helpers/mutex.hpp" // `thread_index`
+#include "helpers/trace.hpp" // `trace_request_scope_t`
 #include "ustore/arrow.h"
 
 using namespace unum::ustore;
@@ -38,11 +51,14 @@ using sys_time_t = std::chrono::time_point<sys_clock_t>;
 
 inline static arf::ActionType const kActionColOpen {kFlightColCreate, "Find a collection descriptor by name."};
 inline static arf::ActionType const kActionColDrop {kFlightColDrop, "Delete a named collection."};
+inline static arf::ActionType const kActionEraseRange {kFlightEraseRange, "Delete a range of keys."};
 inline static arf::ActionType const kActionSnapOpen {kFlightSnapCreate, "Find a snapshot descriptor by name."};
 inline static arf::ActionType const kActionSnapExport {kFlightSnapExport, "Snapshot export."};
 inline static arf::ActionType const kActionSnapDrop {kFlightSnapDrop, "Delete a named snapshot."};
 inline static arf::ActionType const kActionTxnBegin {kFlightTxnBegin, "Starts an ACID transaction and returns its ID."};
 inline static arf::ActionType const kActionTxnCommit {kFlightTxnCommit, "Commit a previously started transaction."};
+inline static arf::ActionType const kActionServerStats {kFlightServerStats, "Queue depths of admission control."};
+inline static arf::ActionType const kActionTrace {kFlightTrace, "Recent spans in Chrome Trace Event JSON."};
 
 struct logger_t {
     bool quiet = false;
@@ -74,46 +90,6 @@ static logger_t logger;
         return return_type(message);                    \
     }
 
-/**
- * @brief Searches for a "value" among key-value pairs passed in URI after path.
- * @param query_params  Must begin with "?" or "/".
- * @param param_name    The name of the URI parameter to match.
- */
-std::optional<std::string_view> param_value(std::string_view query_params, std::string_view param_name) {
-
-    char const* key_begin = query_params.begin();
-    do {
-        key_begin = std::search(key_begin, query_params.end(), param_name.begin(), param_name.end());
-        if (key_begin == query_params.end())
-            return std::nullopt;
-        bool is_suffix = key_begin + param_name.size() == query_params.end();
-        if (is_suffix)
-            return std::string_view {};
-
-        // Check if we have matched a part of bigger key.
-        // In that case skip to next starting point.
-        auto prev_character = *(key_begin - 1);
-        if (prev_character != '?' && prev_character != '&' && prev_character != '/') {
-            key_begin += 1;
-            continue;
-        }
-
-        auto next_character = key_begin[param_name.size()];
-        if (next_character == '&')
-            return std::string_view {};
-
-        if (next_character == '=') {
-            auto value_begin = key_begin + param_name.size() + 1;
-            auto value_end = std::find(value_begin, query_params.end(), '&');
-            return std::string_view {value_begin, static_cast<size_t>(value_end - value_begin)};
-        }
-
-        key_begin += 1;
-    } while (true);
-
-    return std::nullopt;
-}
-
 bool is_query(std::string_view uri, std::string_view name) {
     if (uri.size() > name.size())
         return uri.substr(0, name.size()) == name && uri[name.size()] == '?';
@@ -191,6 +167,45 @@ std::unique_ptr<arf::ResultStream> return_scalar(scalar_at const& scalar) {
     return std::unique_ptr<arf::ResultStream>(results.release());
 }
 
+/**
+ * @brief Exports the whole incoming Flight stream as a single batch.
+ * Requests almost always consist of one batch, which is then exported as is,
+ * without materializing an `ar::Table` and without copying any buffers.
+ * Only multi-batch streams are combined into a new batch allocated from `pool`.
+ */
+ar::Status unpack_stream( //
+    arf::FlightMessageReader& reader,
+    ArrowSchema& schema_c,
+    ArrowArray& batch_c,
+    ar::MemoryPool* pool = ar::default_memory_pool()) {
+
+    auto maybe_schema = reader.GetSchema();
+    if (!maybe_schema.ok())
+        return maybe_schema.status();
+
+    std::vector<std::shared_ptr<ar::RecordBatch>> batches;
+    while (true) {
+        auto maybe_chunk = reader.Next();
+        if (!maybe_chunk.ok())
+            return maybe_chunk.status();
+        std::shared_ptr<ar::RecordBatch>& batch = maybe_chunk.ValueUnsafe().data;
+        if (!batch)
+            break;
+        batches.push_back(std::move(batch));
+    }
+
+    if (batches.size() == 1)
+        return ar::ExportRecordBatch(*batches.front(), &batch_c, &schema_c);
+    return unpack_table(ar::Table::FromRecordBatches(maybe_schema.ValueUnsafe(), batches), schema_c, batch_c, pool);
+}
+
+std::unique_ptr<arf::ResultStream> return_string(std::string&& body) {
+    auto result = std::make_unique<arf::Result>();
+    result->body = ar::Buffer::FromString(std::move(body));
+    auto results = std::make_unique<SingleResultStream>(std::move(result));
+    return std::unique_ptr<arf::ResultStream>(results.release());
+}
+
 std::unique_ptr<arf::ResultStream> return_empty() {
     auto results = std::make_unique<EmptyResultStream>();
     return std::unique_ptr<arf::ResultStream>(results.release());
@@ -266,20 +281,30 @@ struct running_txn_t {
 
 using client_to_txn_t = std::unordered_map<session_id_t, running_txn_t, session_id_hash_t>;
 
-struct aging_txn_order_t {
-    client_to_txn_t const& sessions;
-
-    bool operator()(session_id_t const& a, session_id_t const& b) const noexcept {
-        return sessions.at(a).last_access > sessions.at(b).last_access;
-    }
-};
-
 class sessions_t;
 struct session_lock_t {
+    static constexpr std::size_t no_slot_k = SIZE_MAX;
+
     sessions_t& sessions;
     session_id_t session_id;
     ustore_transaction_t txn = nullptr;
     ustore_arena_t arena = nullptr;
+    /// Index of the checked out arena of a transaction-less request.
+    std::size_t arena_slot = no_slot_k;
+
+    session_lock_t(sessions_t& sessions,
+                   session_id_t session_id,
+                   ustore_transaction_t txn,
+                   ustore_arena_t arena,
+                   std::size_t arena_slot = no_slot_k) noexcept
+        : sessions(sessions), session_id(session_id), txn(txn), arena(arena), arena_slot(arena_slot) {}
+
+    session_lock_t(session_lock_t&& other) noexcept
+        : sessions(other.sessions), session_id(other.session_id), txn(std::exchange(other.txn, nullptr)),
+          arena(std::exchange(other.arena, nullptr)), arena_slot(std::exchange(other.arena_slot, no_slot_k)) {}
+
+    session_lock_t(session_lock_t const&) = delete;
+    session_lock_t& operator=(session_lock_t const&) = delete;
 
     bool is_txn() const noexcept { return txn; }
     ~session_lock_t() noexcept;
@@ -290,59 +315,142 @@ struct session_lock_t {
  * holds ownership of any "transaction handle" or "memory arena" for too long. So if
  * a client goes mute or disconnects, we can reuse same memory for other connections
  * and clients.
+ *
+ * Transactions are spread across `shards_k` shards by the hash of the session ID.
+ * Every shard has its own mutex, map of sessions, and free-lists of handles, so
+ * requests of different sessions rarely collide. A shard without free handles
+ * steals them from others. Transaction-less requests don't touch the shards at
+ * all, and check out an arena from a fixed array of slots with a single atomic
+ * exchange. Idle sessions are evicted by a background sweeper, and never on the
+ * hot path of a request.
  */
 class sessions_t {
-    std::mutex mutex_;
-    // Reusable object handles:
-    std::vector<ustore_arena_t> free_arenas_;
-    std::vector<ustore_transaction_t> free_txns_;
-    /// Links each session to memory used for its operations:
-    client_to_txn_t client_to_txn_;
+
+    static constexpr std::size_t shards_k = 64;
+    static constexpr std::size_t cache_line_k = 64;
+    static constexpr std::chrono::milliseconds sweep_interval_k {1'000};
+
+    struct alignas(cache_line_k) shard_t {
+        std::mutex mutex;
+        /// Links each session to memory used for its operations:
+        client_to_txn_t client_to_txn;
+        // Reusable object handles:
+        std::vector<ustore_arena_t> free_arenas;
+        std::vector<ustore_transaction_t> free_txns;
+    };
+
+    struct alignas(cache_line_k) arena_slot_t {
+        std::atomic<bool> taken {false};
+        ustore_arena_t arena {};
+    };
+
+    std::unique_ptr<shard_t[]> shards_;
+    std::unique_ptr<arena_slot_t[]> arena_slots_;
+    std::size_t arena_slots_count_ = 0;
     ustore_database_t db_ = nullptr;
     // On Postgre 9.6+ is set to same 30 seconds.
-    std::size_t milliseconds_timeout = 30'000;
+    std::chrono::milliseconds timeout_ {30'000};
 
-    running_txn_t pop(ustore_error_t* c_error) noexcept {
+    std::mutex sweeper_mutex_;
+    std::condition_variable sweeper_wake_;
+    bool sweeper_stopping_ = false;
+    std::thread sweeper_;
 
-        auto it = std::min_element(client_to_txn_.begin(), client_to_txn_.end(), [](auto left, auto right) {
-            return left.second.last_access < right.second.last_access && !left.second.executing;
-        });
+    shard_t& shard_of(session_id_t session_id) noexcept {
+        return shards_[session_id_hash_t {}(session_id) % shards_k];
+    }
 
-        auto age = std::chrono::duration_cast<std::chrono::milliseconds>(it->second.last_access - sys_clock_t::now());
-        if (age.count() < milliseconds_timeout || it->second.executing) {
-            log_error_m(c_error, error_unknown_k, "Too many concurrent sessions");
-            return {};
-        }
+    static bool pop_free(shard_t& shard, running_txn_t& running) noexcept {
+        if (shard.free_txns.empty() || shard.free_arenas.empty())
+            return false;
+        running.txn = shard.free_txns.back();
+        running.arena = shard.free_arenas.back();
+        shard.free_txns.pop_back();
+        shard.free_arenas.pop_back();
+        return true;
+    }
 
-        running_txn_t released = it->second;
-        client_to_txn_.erase(it);
-        released.executing = false;
-        return released;
+    static void push_free(shard_t& shard, ustore_transaction_t txn, ustore_arena_t arena) noexcept {
+        // Capacities are reserved upfront, so this never allocates
+        shard.free_txns.push_back(txn);
+        shard.free_arenas.push_back(arena);
     }
 
-    void submit(session_id_t session_id, running_txn_t running_txn) noexcept {
-        running_txn.executing = false;
-        auto res = client_to_txn_.insert_or_assign(session_id, running_txn);
+    /**
+     * @brief Moves the handles of sessions idle for longer than the timeout
+     * into the free-lists of their shards.
+     */
+    void sweep() noexcept {
+        sys_time_t const oldest_allowed = sys_clock_t::now() - timeout_;
+        for (std::size_t shard_idx = 0; shard_idx != shards_k; ++shard_idx) {
+            shard_t& shard = shards_[shard_idx];
+            std::unique_lock _ {shard.mutex};
+            for (auto it = shard.client_to_txn.begin(); it != shard.client_to_txn.end();) {
+                running_txn_t const& running = it->second;
+                if (running.executing || running.last_access > oldest_allowed) {
+                    ++it;
+                    continue;
+                }
+                push_free(shard, running.txn, running.arena);
+                it = shard.client_to_txn.erase(it);
+            }
+        }
+    }
+
+    void sweep_until_stopped() noexcept {
+        std::unique_lock lock {sweeper_mutex_};
+        while (!sweeper_wake_.wait_for(lock, sweep_interval_k, [&] { return sweeper_stopping_; })) {
+            lock.unlock();
+            sweep();
+            lock.lock();
+        }
     }
 
   public:
-    sessions_t(ustore_database_t db, std::size_t n) : db_(db), free_arenas_(n), free_txns_(n), client_to_txn_(n) {
-        std::fill_n(free_arenas_.begin(), n, nullptr);
-        std::fill_n(free_txns_.begin(), n, nullptr);
+    sessions_t(ustore_database_t db, std::size_t n)
+        : shards_(new shard_t[shards_k]), arena_slots_(new arena_slot_t[n]), arena_slots_count_(n), db_(db) {
+
+        // Spread the transaction handles across shards, but let every shard
+        // hold all of them, in case sessions are unevenly distributed.
+        std::size_t per_shard = (n + shards_k - 1) / shards_k;
+        for (std::size_t shard_idx = 0; shard_idx != shards_k; ++shard_idx) {
+            shard_t& shard = shards_[shard_idx];
+            shard.client_to_txn.reserve(per_shard);
+            shard.free_arenas.reserve(n);
+            shard.free_txns.reserve(n);
+            shard.free_arenas.resize(per_shard, nullptr);
+            shard.free_txns.resize(per_shard, nullptr);
+        }
+        sweeper_ = std::thread([this] { sweep_until_stopped(); });
     }
 
     ~sessions_t() noexcept {
-        for (auto a : free_arenas_)
-            ustore_arena_free(a);
-        for (auto t : free_txns_)
-            ustore_transaction_free(t);
+        {
+            std::unique_lock _ {sweeper_mutex_};
+            sweeper_stopping_ = true;
+        }
+        sweeper_wake_.notify_all();
+        sweeper_.join();
+
+        for (std::size_t shard_idx = 0; shard_idx != shards_k; ++shard_idx) {
+            shard_t& shard = shards_[shard_idx];
+            for (auto& [id, running] : shard.client_to_txn)
+                push_free(shard, running.txn, running.arena);
+            for (auto a : shard.free_arenas)
+                ustore_arena_free(a);
+            for (auto t : shard.free_txns)
+                ustore_transaction_free(t);
+        }
+        for (std::size_t slot_idx = 0; slot_idx != arena_slots_count_; ++slot_idx)
+            ustore_arena_free(arena_slots_[slot_idx].arena);
     }
 
     running_txn_t continue_txn(session_id_t session_id, ustore_error_t* c_error) noexcept {
-        std::unique_lock _ {mutex_};
+        shard_t& shard = shard_of(session_id);
+        std::unique_lock _ {shard.mutex};
 
-        auto it = client_to_txn_.find(session_id);
-        if (it == client_to_txn_.end()) {
+        auto it = shard.client_to_txn.find(session_id);
+        if (it == shard.client_to_txn.end()) {
             log_error_m(c_error, args_wrong_k, "Transaction was terminated, start a new one");
             return {};
         }
@@ -355,83 +463,88 @@ class sessions_t {
 
         running.executing = true;
         running.last_access = sys_clock_t::now();
-
-        // Update the heap order.
-        // With a single change shouldn't take more than `log2(n)` operations.
         return running;
     }
 
     running_txn_t request_txn(session_id_t session_id, ustore_error_t* c_error) noexcept {
-        std::unique_lock _ {mutex_};
-
-        auto it = client_to_txn_.find(session_id);
-        if (it != client_to_txn_.end()) {
-            log_error_m(c_error, args_wrong_k, "Such transaction is already running, just continue using it.");
-            return {};
+        shard_t& own_shard = shard_of(session_id);
+        running_txn_t running {};
+        running.executing = true;
+        running.last_access = sys_clock_t::now();
+        {
+            std::unique_lock _ {own_shard.mutex};
+            if (own_shard.client_to_txn.count(session_id)) {
+                log_error_m(c_error, args_wrong_k, "Such transaction is already running, just continue using it.");
+                return {};
+            }
+            if (pop_free(own_shard, running))
+                return running;
         }
 
-        // Consider evicting some of the old sessions, if there are no more empty slots
-        if (free_txns_.empty() || free_arenas_.empty()) {
-            running_txn_t running = pop(c_error);
-            if (*c_error)
-                return {};
-            running.executing = true;
-            running.last_access = sys_clock_t::now();
-            return running;
+        // Steal from the other shards, if this one is exhausted
+        for (std::size_t shard_idx = 0; shard_idx != shards_k; ++shard_idx) {
+            shard_t& shard = shards_[shard_idx];
+            if (&shard == &own_shard)
+                continue;
+            std::unique_lock _ {shard.mutex};
+            if (pop_free(shard, running))
+                return running;
         }
 
-        // If we have free slots
-        running_txn_t running {};
-        running.arena = free_arenas_.back();
-        running.txn = free_txns_.back();
-        running.executing = true;
-        running.last_access = sys_clock_t::now();
-        free_arenas_.pop_back();
-        free_txns_.pop_back();
-        return running;
+        log_error_m(c_error, error_unknown_k, "Too many concurrent sessions");
+        return {};
     }
 
     void hold_txn(session_id_t session_id, running_txn_t running_txn) noexcept {
-        std::unique_lock _ {mutex_};
-        submit(session_id, running_txn);
+        shard_t& shard = shard_of(session_id);
+        std::unique_lock _ {shard.mutex};
+        running_txn.executing = false;
+        running_txn.last_access = sys_clock_t::now();
+        shard.client_to_txn.insert_or_assign(session_id, running_txn);
     }
 
-    void release_txn(running_txn_t running_txn) noexcept {
-        std::unique_lock _ {mutex_};
-        free_arenas_.push_back(running_txn.arena);
-        free_txns_.push_back(running_txn.txn);
+    /**
+     * @brief Returns the handles of a transaction, that was never held.
+     */
+    void release_txn(session_id_t session_id, running_txn_t running_txn) noexcept {
+        shard_t& shard = shard_of(session_id);
+        std::unique_lock _ {shard.mutex};
+        push_free(shard, running_txn.txn, running_txn.arena);
     }
 
     void release_txn(session_id_t session_id) noexcept {
-        std::unique_lock _ {mutex_};
-        auto it = client_to_txn_.find(session_id);
-        if (it == client_to_txn_.end())
+        shard_t& shard = shard_of(session_id);
+        std::unique_lock _ {shard.mutex};
+        auto it = shard.client_to_txn.find(session_id);
+        if (it == shard.client_to_txn.end())
             return;
-        it->second.executing = false;
-        free_arenas_.push_back(it->second.arena);
-        free_txns_.push_back(it->second.txn);
-        client_to_txn_.erase(it);
+        push_free(shard, it->second.txn, it->second.arena);
+        shard.client_to_txn.erase(it);
     }
 
-    ustore_arena_t request_arena(ustore_error_t* c_error) noexcept {
-        std::unique_lock _ {mutex_};
-        // Consider evicting some of the old sessions, if there are no more empty slots
-        if (free_arenas_.empty()) {
-            running_txn_t running = pop(c_error);
-            if (*c_error)
-                return nullptr;
-            free_txns_.push_back(running.txn);
-            return running.arena;
+    /**
+     * @brief Checks out one of the arena slots, starting the search from a
+     * thread-specific position, to avoid collisions of concurrent requests.
+     */
+    std::size_t request_arena(ustore_arena_t& arena, ustore_error_t* c_error) noexcept {
+        std::size_t const first_slot = thread_index() % arena_slots_count_;
+        for (std::size_t shift = 0; shift != arena_slots_count_; ++shift) {
+            std::size_t slot_idx = (first_slot + shift) % arena_slots_count_;
+            arena_slot_t& slot = arena_slots_[slot_idx];
+            if (slot.taken.load(std::memory_order_relaxed) || slot.taken.exchange(true, std::memory_order_acquire))
+                continue;
+            arena = slot.arena;
+            return slot_idx;
         }
 
-        ustore_arena_t arena = free_arenas_.back();
-        free_arenas_.pop_back();
-        return arena;
+        log_error_m(c_error, error_unknown_k, "Too many concurrent sessions");
+        return session_lock_t::no_slot_k;
     }
 
-    void release_arena(ustore_arena_t arena) noexcept {
-        std::unique_lock _ {mutex_};
-        free_arenas_.push_back(arena);
+    void release_arena(std::size_t slot_idx, ustore_arena_t arena) noexcept {
+        arena_slot_t& slot = arena_slots_[slot_idx];
+        slot.arena = arena;
+        slot.taken.store(false, std::memory_order_release);
     }
 
     session_lock_t lock(session_id_t id, ustore_error_t* c_error) noexcept {
@@ -439,8 +552,10 @@ class sessions_t {
             running_txn_t running = continue_txn(id, c_error);
             return {*this, id, running.txn, running.arena};
         }
-        else
-            return {*this, id, nullptr, request_arena(c_error)};
+
+        ustore_arena_t arena = nullptr;
+        std::size_t slot_idx = request_arena(arena, c_error);
+        return {*this, id, nullptr, arena, slot_idx};
     }
 };
 
@@ -448,25 +563,45 @@ session_lock_t::~session_lock_t() noexcept {
     if (is_txn())
         sessions.hold_txn( //
             session_id,
-            running_txn_t {txn, arena, sys_clock_t::now(), true});
-    else
-        sessions.release_arena(arena);
+            running_txn_t {txn, arena, sys_clock_t::now(), false});
+    else if (arena_slot != no_slot_k)
+        sessions.release_arena(arena_slot, arena);
+}
+
+/**
+ * @brief Keeps the session checked out until Arrow releases the exported `array`,
+ * as its buffers reference the session arena. The gRPC layer may hold onto those
+ * buffers for a while after the request handler returns.
+ */
+void bind_session(ArrowArray& array, session_lock_t&& session) {
+    arrow_attach_owner(array, std::make_unique<session_lock_t>(std::move(session)));
 }
 
 struct session_params_t {
     session_id_t session_id;
     std::optional<std::string_view> transaction_id;
+    std::optional<std::string_view> request_id;
     std::optional<std::string_view> snapshot_id;
     std::optional<std::string_view> collection_name;
     std::optional<std::string_view> collection_id;
     std::optional<std::string_view> collection_drop_mode;
     std::optional<std::string_view> read_part;
+    std::optional<std::string_view> scan_start;
+    std::optional<std::string_view> scan_end;
+    std::optional<std::string_view> scan_limit;
+    std::optional<std::string_view> scan_batch;
 
     std::optional<std::string_view> opt_snapshot;
     std::optional<std::string_view> opt_flush;
     std::optional<std::string_view> opt_dont_watch;
     std::optional<std::string_view> opt_shared_memory;
+    std::optional<std::string_view> opt_scan_bulk;
+    std::optional<std::string_view> opt_scan_sequential;
+    std::optional<std::string_view> opt_scan_values;
+    std::optional<std::string_view> opt_write_bulk;
+    std::optional<std::string_view> opt_write_merge;
     std::optional<std::string_view> opt_dont_discard_memory;
+    arrow_compression_t compression;
 };
 
 session_params_t session_params(arf::ServerCallContext const& server_call, std::string_view uri) noexcept {
@@ -483,6 +618,8 @@ session_params_t session_params(arf::ServerCallContext const& server_call, std::
     if (result.transaction_id)
         result.session_id.txn_id = parse_txn_id(*result.transaction_id);
 
+    result.request_id = param_value(params, kParamRequestID);
+
     result.snapshot_id = param_value(params, kParamSnapshotID);
 
     result.collection_name = param_value(params, kParamCollectionName);
@@ -490,17 +627,35 @@ session_params_t session_params(arf::ServerCallContext const& server_call, std::
 
     result.collection_drop_mode = param_value(params, kParamDropMode);
     result.read_part = param_value(params, kParamReadPart);
+    result.scan_start = param_value(params, kParamScanStart);
+    result.scan_end = param_value(params, kParamScanEnd);
+    result.scan_limit = param_value(params, kParamScanLimit);
+    result.scan_batch = param_value(params, kParamScanBatch);
 
     result.opt_flush = param_value(params, kParamFlagFlushWrite);
     result.opt_dont_watch = param_value(params, kParamFlagDontWatch);
     result.opt_shared_memory = param_value(params, kParamFlagSharedMemRead);
+    result.opt_scan_bulk = param_value(params, kParamFlagScanBulk);
+    result.opt_scan_sequential = param_value(params, kParamFlagScanSequential);
+    result.opt_scan_values = param_value(params, kParamFlagScanValues);
+    result.opt_write_bulk = param_value(params, kParamFlagWriteBulk);
+    result.opt_write_merge = param_value(params, kParamFlagWriteMerge);
 
     // This flag shouldn't have been forwarded to the server.
     // In standalone builds it remains on the client.
     // result.opt_dont_discard_memory = param_value(params, kParamFlagDontDiscard);
+    result.compression = arrow_compression(params);
     return result;
 }
 
+/**
+ * @brief Parses the hexadecimal ID, that clients may attach to correlate
+ * the server-side trace spans with their own requests.
+ */
+std::uint64_t parse_request_id(session_params_t const& params) noexcept {
+    return params.request_id ? parse_u64_hex(*params.request_id) : 0;
+}
+
 ustore_options_t ustore_options(session_params_t const& params) noexcept {
     ustore_options_t result = ustore_options_default_k;
     if (params.opt_dont_watch)
@@ -509,6 +664,14 @@ ustore_options_t ustore_options(session_params_t const& params) noexcept {
         result = ustore_options_t(result | ustore_option_write_flush_k);
     if (params.opt_shared_memory)
         result = ustore_options_t(result | ustore_option_read_shared_memory_k);
+    if (params.opt_scan_bulk)
+        result = ustore_options_t(result | ustore_option_scan_bulk_k);
+    if (params.opt_scan_sequential)
+        result = ustore_options_t(result | ustore_option_scan_sequential_k);
+    if (params.opt_write_bulk)
+        result = ustore_options_t(result | ustore_option_write_bulk_k);
+    if (params.opt_write_merge)
+        result = ustore_options_t(result | ustore_option_write_merge_k);
     return result;
 }
 
@@ -522,6 +685,388 @@ ustore_str_view_t get_null_terminated(std::shared_ptr<ar::Buffer> const& buf_ptr
     return buf_ptr ? get_null_terminated(*buf_ptr) : nullptr;
 }
 
+enum request_class_t : std::size_t {
+    request_read_k = 0,
+    request_write_k = 1,
+    request_scan_k = 2,
+};
+
+static constexpr std::size_t request_classes_k = 3;
+static char const* const request_class_names_k[request_classes_k] = {"reads", "writes", "scans"};
+
+bool is_modality_query(std::string_view cmd) noexcept {
+    return is_query(cmd, kFlightGraphFindEdges) || is_query(cmd, kFlightGraphUpsertEdges) ||
+           is_query(cmd, kFlightDocsWrite) || is_query(cmd, kFlightDocsGather) || is_query(cmd, kFlightVectorsSearch);
+}
+
+request_class_t request_class(std::string_view cmd) noexcept {
+    if (is_query(cmd, kFlightWrite) || is_query(cmd, kFlightWritePath) || is_query(cmd, kFlightGraphUpsertEdges) ||
+        is_query(cmd, kFlightDocsWrite))
+        return request_write_k;
+    if (is_query(cmd, kFlightScan) || is_query(cmd, kFlightSample))
+        return request_scan_k;
+    return request_read_k;
+}
+
+struct admission_limits_t {
+    /// Maximum number of requests executing at once, across all classes. Zero means unlimited.
+    std::size_t executing = std::max(std::thread::hardware_concurrency(), 1u);
+    /// Maximum number of executing and waiting requests of every class. Zero means unlimited.
+    std::size_t in_flight[request_classes_k] = {4096, 4096, 256};
+};
+
+/**
+ * @brief Admission control, protecting the engine from oversubscription under bursts.
+ *
+ * Every request first takes a slot of its class, or is rejected immediately, if all
+ * of them are taken. Admitted requests then wait for one of the `executing` slots.
+ * Rejecting fast keeps the queues short, so the tail latency of the accepted
+ * requests stays bounded, and clients can back off or retry elsewhere.
+ */
+class admission_t {
+
+    struct alignas(64) class_state_t {
+        std::atomic<std::size_t> depth {0};
+        std::atomic<std::size_t> peak_depth {0};
+        std::atomic<std::size_t> admitted {0};
+        std::atomic<std::size_t> rejected {0};
+    };
+
+    admission_limits_t limits_;
+    class_state_t classes_[request_classes_k];
+
+    std::mutex executing_mutex_;
+    std::condition_variable executing_released_;
+    std::size_t executing_ = 0;
+
+    void start_executing() noexcept {
+        std::unique_lock lock {executing_mutex_};
+        executing_released_.wait(lock, [&] { return !limits_.executing || executing_ < limits_.executing; });
+        ++executing_;
+    }
+
+    void stop_executing() noexcept {
+        {
+            std::unique_lock _ {executing_mutex_};
+            --executing_;
+        }
+        executing_released_.notify_one();
+    }
+
+  public:
+    class ticket_t {
+        admission_t* admission_ = nullptr;
+        request_class_t class_ = request_read_k;
+        bool executing_ = false;
+
+      public:
+        ticket_t() noexcept = default;
+        ticket_t(admission_t& admission, request_class_t request_class) noexcept
+            : admission_(&admission), class_(request_class) {}
+        ticket_t(ticket_t&& other) noexcept
+            : admission_(std::exchange(other.admission_, nullptr)), class_(other.class_),
+              executing_(std::exchange(other.executing_, false)) {}
+        ticket_t(ticket_t const&) = delete;
+        ticket_t& operator=(ticket_t const&) = delete;
+
+        ~ticket_t() noexcept {
+            if (!admission_)
+                return;
+            if (executing_)
+                admission_->stop_executing();
+            admission_->classes_[class_].depth.fetch_sub(1, std::memory_order_release);
+        }
+
+        explicit operator bool() const noexcept { return admission_; }
+
+        /// @brief Blocks until the request can be executed without oversubscribing the engine.
+        void execute() noexcept {
+            if (!admission_ || executing_)
+                return;
+            admission_->start_executing();
+            executing_ = true;
+        }
+    };
+
+    admission_t(admission_limits_t const& limits) noexcept : limits_(limits) {}
+
+    /// @return An empty ticket, if the class is saturated, and the request must be rejected.
+    ticket_t admit(request_class_t request_class) noexcept {
+        class_state_t& state = classes_[request_class];
+        std::size_t limit = limits_.in_flight[request_class];
+        std::size_t depth = state.depth.fetch_add(1, std::memory_order_acq_rel) + 1;
+        if (limit && depth > limit) {
+            state.depth.fetch_sub(1, std::memory_order_release);
+            state.rejected.fetch_add(1, std::memory_order_relaxed);
+            return {};
+        }
+
+        state.admitted.fetch_add(1, std::memory_order_relaxed);
+        std::size_t peak_depth = state.peak_depth.load(std::memory_order_relaxed);
+        while (depth > peak_depth &&
+               !state.peak_depth.compare_exchange_weak(peak_depth, depth, std::memory_order_relaxed))
+            ;
+        return {*this, request_class};
+    }
+
+    /// @brief Exports the queue depths and counters of every class as a JSON object.
+    std::string stats() const {
+        std::string result = "{";
+        for (std::size_t class_idx = 0; class_idx != request_classes_k; ++class_idx) {
+            class_state_t const& state = classes_[class_idx];
+            char entry[256];
+            std::snprintf(entry,
+                          sizeof(entry),
+                          "\"%s\":{\"depth\":%zu,\"peak_depth\":%zu,\"limit\":%zu,\"admitted\":%zu,\"rejected\":%zu},",
+                          request_class_names_k[class_idx],
+                          state.depth.load(std::memory_order_relaxed),
+                          state.peak_depth.load(std::memory_order_relaxed),
+                          limits_.in_flight[class_idx],
+                          state.admitted.load(std::memory_order_relaxed),
+                          state.rejected.load(std::memory_order_relaxed));
+            result += entry;
+        }
+        result += "\"executing_limit\":" + std::to_string(limits_.executing) + "}";
+        return result;
+    }
+};
+
+static constexpr ustore_size_t scan_batch_default_k = 64 * 1024;
+static constexpr ustore_size_t scan_batch_limit_k = std::numeric_limits<ustore_length_t>::max();
+
+/**
+ * @brief Streams a range of a collection in record batches of keys and, optionally, values.
+ * While one batch is being sent, the next one is already fetched in the background.
+ *
+ * Every batch is exported from one of two arenas, which is reused only after Arrow
+ * releases all the buffers of the previous batch in it. Those can outlive the stream
+ * itself in the outgoing gRPC messages, so the arenas are owned by a shared state.
+ * The admission ticket holds a slot of the scans queue until the stream is closed.
+ */
+class scan_stream_t final : public ar::RecordBatchReader {
+
+    static constexpr std::size_t buffers_k = 2;
+
+    struct state_t {
+        std::mutex mutex;
+        std::condition_variable released;
+        ustore_arena_t arenas[buffers_k] {};
+        bool busy[buffers_k] {};
+        bool cancelled = false;
+
+        ~state_t() noexcept {
+            for (ustore_arena_t arena : arenas)
+                ustore_arena_free(arena);
+        }
+    };
+
+    /// @brief Attached to every exported batch, to mark its arena free, once it's released.
+    struct batch_owner_t {
+        std::shared_ptr<state_t> state;
+        std::size_t buffer_idx;
+    };
+
+    static void release_batch(ArrowArray* array) {
+        auto owner = static_cast<batch_owner_t*>(array->private_data);
+        release_malloced_array(array);
+        {
+            std::unique_lock _ {owner->state->mutex};
+            owner->state->busy[owner->buffer_idx] = false;
+        }
+        owner->state->released.notify_all();
+        delete owner;
+    }
+
+    ustore_database_t db_;
+    ustore_snapshot_t snapshot_;
+    ustore_options_t options_;
+    ustore_collection_t collection_;
+    ustore_key_t next_key_;
+    ustore_size_t remaining_;
+    ustore_size_t batch_size_;
+    bool export_values_;
+    bool exhausted_ = false;
+
+    admission_t::ticket_t ticket_;
+    std::shared_ptr<ar::Schema> schema_;
+    std::shared_ptr<state_t> state_ = std::make_shared<state_t>();
+    std::size_t next_buffer_ = 0;
+    std::future<ar::Result<std::shared_ptr<ar::RecordBatch>>> next_batch_;
+
+    void release_buffer(std::size_t buffer_idx) noexcept {
+        {
+            std::unique_lock _ {state_->mutex};
+            state_->busy[buffer_idx] = false;
+        }
+        state_->released.notify_all();
+    }
+
+    /**
+     * @brief Scans the next batch of keys, reads their values and exports them into Arrow.
+     * Runs in the background, but never concurrently with itself.
+     */
+    ar::Result<std::shared_ptr<ar::RecordBatch>> fetch(std::size_t buffer_idx) noexcept {
+        {
+            std::unique_lock lock {state_->mutex};
+            state_->released.wait(lock, [&] { return !state_->busy[buffer_idx] || state_->cancelled; });
+            if (state_->cancelled)
+                return ar::Status::Cancelled("Stream was closed");
+            state_->busy[buffer_idx] = true;
+        }
+
+        status_t status;
+        ustore_arena_t* arena = &state_->arenas[buffer_idx];
+        ustore_length_t count_limit = static_cast<ustore_length_t>(std::min(batch_size_, remaining_));
+        ustore_length_t* found_counts = nullptr;
+        ustore_key_t* found_keys = nullptr;
+
+        ustore_scan_t scan {};
+        scan.db = db_;
+        scan.error = status.member_ptr();
+        scan.snapshot = snapshot_;
+        scan.arena = arena;
+        scan.options = options_;
+        scan.tasks_count = 1;
+        scan.collections = &collection_;
+        scan.start_keys = &next_key_;
+        scan.count_limits = &count_limit;
+        scan.counts = &found_counts;
+        scan.keys = &found_keys;
+
+        ustore_scan(&scan);
+        if (!status) {
+            release_buffer(buffer_idx);
+            return ar::Status::ExecutionError(status.message());
+        }
+
+        ustore_length_t found_count = found_counts[0];
+        if (!found_count) {
+            exhausted_ = true;
+            release_buffer(buffer_idx);
+            return std::shared_ptr<ar::RecordBatch> {};
+        }
+
+        ustore_key_t last_key = found_keys[found_count - 1];
+        remaining_ -= found_count;
+        exhausted_ = found_count < count_limit || !remaining_ || last_key == std::numeric_limits<ustore_key_t>::max();
+        next_key_ = exhausted_ ? last_key : last_key + 1;
+
+        ustore_octet_t* found_presences = nullptr;
+        ustore_length_t* found_offsets = nullptr;
+        ustore_bytes_ptr_t found_values = nullptr;
+        if (export_values_) {
+            ustore_read_t read {};
+            read.db = db_;
+            read.error = status.member_ptr();
+            read.snapshot = snapshot_;
+            read.arena = arena;
+            read.options = ustore_options_t(options_ | ustore_option_dont_discard_memory_k);
+            read.tasks_count = found_count;
+            read.collections = &collection_;
+            read.keys = found_keys;
+            read.keys_stride = sizeof(ustore_key_t);
+            read.presences = &found_presences;
+            read.offsets = &found_offsets;
+            read.values = &found_values;
+
+            ustore_read(&read);
+            if (!status) {
+                release_buffer(buffer_idx);
+                return ar::Status::ExecutionError(status.message());
+            }
+        }
+
+        ArrowSchema schema_c;
+        ArrowArray array_c;
+        ustore_to_arrow_schema(found_count, schema_->num_fields(), &schema_c, &array_c, status.member_ptr());
+        ustore_to_arrow_column( //
+            found_count,
+            kArgKeys.c_str(),
+            ustore_doc_field<ustore_key_t>(),
+            nullptr,
+            nullptr,
+            ustore_bytes_ptr_t(found_keys),
+            schema_c.children[0],
+            array_c.children[0],
+            status.member_ptr());
+        if (export_values_)
+            ustore_to_arrow_column( //
+                found_count,
+                kArgVals.c_str(),
+                ustore_doc_field_bin_k,
+                found_presences,
+                found_offsets,
+                found_values ? found_values : ustore_bytes_ptr_t(&zero_size_data_k),
+                schema_c.children[1],
+                array_c.children[1],
+                status.member_ptr());
+        schema_c.release(&schema_c);
+        if (!status) {
+            array_c.release(&array_c);
+            release_buffer(buffer_idx);
+            return ar::Status::ExecutionError(status.message());
+        }
+
+        // From here on, Arrow will release the array and the buffer, even on failure
+        array_c.private_data = new batch_owner_t {state_, buffer_idx};
+        array_c.release = &release_batch;
+        return ar::ImportRecordBatch(&array_c, schema_);
+    }
+
+    void schedule() {
+        std::size_t buffer_idx = std::exchange(next_buffer_, (next_buffer_ + 1) % buffers_k);
+        next_batch_ = std::async(std::launch::async, [this, buffer_idx] { return fetch(buffer_idx); });
+    }
+
+  public:
+    scan_stream_t(ustore_database_t db,
+                  ustore_snapshot_t snapshot,
+                  ustore_options_t options,
+                  ustore_collection_t collection,
+                  ustore_key_t start_key,
+                  ustore_size_t limit,
+                  ustore_size_t batch_size,
+                  bool export_values,
+                  admission_t::ticket_t ticket)
+        : db_(db), snapshot_(snapshot), options_(options), collection_(collection), next_key_(start_key),
+          remaining_(limit), batch_size_(std::clamp<ustore_size_t>(batch_size, 1, scan_batch_limit_k)),
+          export_values_(export_values), ticket_(std::move(ticket)) {
+
+        ar::FieldVector fields {ar::field(kArgKeys, ar::int64(), false)};
+        if (export_values_)
+            fields.push_back(ar::field(kArgVals, ar::binary(), true));
+        schema_ = ar::schema(std::move(fields));
+        if (remaining_)
+            schedule();
+    }
+
+    ~scan_stream_t() override {
+        {
+            std::unique_lock _ {state_->mutex};
+            state_->cancelled = true;
+        }
+        state_->released.notify_all();
+        if (next_batch_.valid())
+            next_batch_.wait();
+    }
+
+    std::shared_ptr<ar::Schema> schema() const override { return schema_; }
+
+    ar::Status ReadNext(std::shared_ptr<ar::RecordBatch>* batch) override {
+        batch->reset();
+        if (!next_batch_.valid())
+            return ar::Status::OK();
+
+        ar::Result<std::shared_ptr<ar::RecordBatch>> maybe_batch = next_batch_.get();
+        if (!maybe_batch.ok())
+            return maybe_batch.status();
+        *batch = maybe_batch.MoveValueUnsafe();
+        if (*batch && !exhausted_)
+            schedule();
+        return ar::Status::OK();
+    }
+};
+
 /**
  * @brief Remote Procedure Call implementation on top of Apache Arrow Flight RPC.
  * Currently only implements only the binary interface, which is enough even for
@@ -537,18 +1082,30 @@ ustore_str_view_t get_null_terminated(std::shared_ptr<ar::Buffer> const& buf_ptr
  * - collection_remove?col=x (DoAction): Drops a collection
  * - txn_begin?txn=y (DoAction): Starts a transaction with a potentially custom ID
  * - txn_commit?txn=y (DoAction): Commits a transaction with a given ID
+ * - scan?col=x&start=k&limit=n&batch=b&values (DoGet): Streams keys and values in batches
+ * - pipeline (DoExchange): Carries many framed reads and writes over one stream
+ * - server_stats (DoAction): Returns admission queue depths and counters as JSON
+ * - trace (DoAction): Returns the recent spans in Chrome Trace Event JSON, if built with `USTORE_USE_TRACING`
+ *
+ * Any endpoint accepts a hexadecimal `request_id=z`, that is attached to the spans it records.
+ * - graph_find_edges, graph_upsert_edges, docs_write, docs_gather, vectors_search (DoExchange):
+ *   Execute modality calls on the server, with arguments packed by `arrow_bundle_t`
  *
  * ## Concurrency
  *
  * Flight RPC allows concurrent calls from the same client.
  * In our implementation things are trickier, as transactions are not thread-safe.
+ * Reads, writes and scans are admitted separately, and rejected with `Unavailable`
+ * status once their class is saturated, see `admission_t`.
  */
 class UStoreService : public arf::FlightServerBase {
     database_t db_;
     sessions_t sessions_;
+    admission_t admission_;
 
   public:
-    UStoreService(database_t&& db, std::size_t capacity = 4096) : db_(std::move(db)), sessions_(db_, capacity) {}
+    UStoreService(database_t&& db, admission_limits_t const& limits = {}, std::size_t capacity = 4096)
+        : db_(std::move(db)), sessions_(db_, capacity), admission_(limits) {}
     ~UStoreService() { db_.close(); }
 
     ar::Status ListActions( //
@@ -557,11 +1114,14 @@ class UStoreService : public arf::FlightServerBase {
         *actions = {
             kActionColOpen,
             kActionColDrop,
+            kActionEraseRange,
             kActionSnapOpen,
             kActionSnapExport,
             kActionSnapDrop,
             kActionTxnBegin,
             kActionTxnCommit,
+            kActionServerStats,
+            kActionTrace,
         };
         return ar::Status::OK();
     }
@@ -597,6 +1157,7 @@ class UStoreService : public arf::FlightServerBase {
 
         ar::Status ar_status;
         session_params_t params = session_params(server_call, action.type);
+        trace_request_scope_t request_scope {parse_request_id(params)};
         status_t status;
 
         // Locating the collection ID
@@ -660,6 +1221,41 @@ class UStoreService : public arf::FlightServerBase {
             return ar::Status::OK();
         }
 
+        // Erasing a range of keys
+        if (is_query(action.type, kActionEraseRange.type)) {
+            log_message_if_verbose_m("Action start: Range erase");
+            ustore_key_t start_key = std::numeric_limits<ustore_key_t>::min();
+            ustore_key_t end_key = std::numeric_limits<ustore_key_t>::max();
+            auto parse_decimal = [](std::optional<std::string_view> const& param, ustore_key_t& result) {
+                if (!param)
+                    return true;
+                auto [end, error] = std::from_chars(param->data(), param->data() + param->size(), result);
+                return error == std::errc() && end == param->data() + param->size();
+            };
+            if (!parse_decimal(params.scan_start, start_key) || !parse_decimal(params.scan_end, end_key))
+                log_return_message_m(ar::Status::Invalid, "Malformed range");
+
+            ustore_collection_t c_collection_id = ustore_collection_main_k;
+            if (params.collection_id)
+                c_collection_id = parse_u64_hex(*params.collection_id, ustore_collection_main_k);
+
+            ustore_erase_range_t erase {};
+            erase.db = db_;
+            erase.error = status.member_ptr();
+            erase.options = ustore_options(params);
+            erase.tasks_count = 1;
+            erase.collections = &c_collection_id;
+            erase.start_keys = &start_key;
+            erase.end_keys = &end_key;
+
+            ustore_erase_range(&erase);
+            if (!status)
+                log_return_message_m(ar::Status::ExecutionError, status.message());
+            *results_ptr = return_empty();
+            log_message_if_verbose_m("Action end: Range erase");
+            return ar::Status::OK();
+        }
+
         // Create a snapshot
         if (is_query(action.type, kActionSnapOpen.type)) {
             log_message_if_verbose_m("Action start: Snapshot create");
@@ -753,7 +1349,7 @@ class UStoreService : public arf::FlightServerBase {
 
             ustore_transaction_init(&txn_init);
             if (!status) {
-                sessions_.release_txn(params.session_id);
+                sessions_.release_txn(params.session_id, session);
                 log_return_message_m(ar::Status::ExecutionError, status.message());
             }
 
@@ -793,28 +1389,42 @@ class UStoreService : public arf::FlightServerBase {
             return ar::Status::OK();
         }
 
+        if (is_query(action.type, kActionServerStats.type)) {
+            *results_ptr = return_string(admission_.stats());
+            return ar::Status::OK();
+        }
+
+        if (is_query(action.type, kActionTrace.type)) {
+            *results_ptr = return_string(trace_to_chrome_json());
+            return ar::Status::OK();
+        }
+
         logger.log_message("Unknown action type: %s", action.type.c_str());
 
         log_return_message_m(ar::Status::NotImplemented, "Unknown action type: ", action.type);
     }
 
-    ar::Status DoExchange( //
+    /**
+     * @brief Executes a single `DoExchange`-like request on an already unpacked input.
+     * @return The response batch, referencing the session arena.
+     */
+    ar::Result<std::shared_ptr<ar::RecordBatch>> exchange( //
         arf::ServerCallContext const& server_call,
-        std::unique_ptr<arf::FlightMessageReader> request_ptr,
-        std::unique_ptr<arf::FlightMessageWriter> response_ptr) override {
+        std::string_view cmd,
+        ArrowSchema& input_schema_c,
+        ArrowArray& input_batch_c) {
 
-        ar::Status ar_status;
-        arf::FlightMessageReader& request = *request_ptr;
-        arf::FlightMessageWriter& response = *response_ptr;
-        arf::FlightDescriptor const& desc = request.descriptor();
-        session_params_t params = session_params(server_call, desc.cmd);
-        status_t status;
+        admission_t::ticket_t ticket = admission_.admit(request_class(cmd));
+        if (!ticket)
+            log_return_message_m(ar::Status::Unavailable, "Too many requests in flight");
+        ticket.execute();
 
-        ArrowSchema input_schema_c, output_schema_c;
-        ArrowArray input_batch_c, output_batch_c;
-        if (ar_status = unpack_table(request.ToTable(), input_schema_c, input_batch_c); !ar_status.ok())
-            return ar_status;
+        session_params_t params = session_params(server_call, cmd);
+        trace_request_scope_t request_scope {parse_request_id(params)};
+        status_t status;
 
+        ArrowSchema output_schema_c;
+        ArrowArray output_batch_c;
         bool is_empty_values = false;
 
         /// @param `collections`
@@ -836,7 +1446,10 @@ class UStoreService : public arf::FlightServerBase {
         if (!status)
             log_return_message_m(ar::Status::ExecutionError, status.message());
 
-        if (is_query(desc.cmd, kFlightRead)) {
+        if (is_modality_query(cmd))
+            return exchange_modality(params, cmd, c_snapshot_id, input_schema_c, input_batch_c, std::move(session));
+
+        if (is_query(cmd, kFlightRead)) {
             log_message_if_verbose_m("Process start: Read");
             /// @param `keys`
             auto input_keys = get_keys(input_schema_c, input_batch_c, kArgKeys);
@@ -927,7 +1540,7 @@ class UStoreService : public arf::FlightServerBase {
 
             log_message_if_verbose_m("Process end: Read");
         }
-        else if (is_query(desc.cmd, kFlightReadPath)) {
+        else if (is_query(cmd, kFlightReadPath)) {
             log_message_if_verbose_m("Process start: Read path");
 
             /// @param `keys`
@@ -1017,7 +1630,7 @@ class UStoreService : public arf::FlightServerBase {
                 log_return_message_m(ar::Status::ExecutionError, status.message());
             log_message_if_verbose_m("Process end: Read path");
         }
-        else if (is_query(desc.cmd, kFlightMatchPath)) {
+        else if (is_query(cmd, kFlightMatchPath)) {
             log_message_if_verbose_m("Process start: Match path");
 
             /// @param `previous`
@@ -1132,7 +1745,7 @@ class UStoreService : public arf::FlightServerBase {
                 log_return_message_m(ar::Status::ExecutionError, status.message());
             log_message_if_verbose_m("Process end: Match path");
         }
-        else if (is_query(desc.cmd, kFlightScan)) {
+        else if (is_query(cmd, kFlightScan)) {
             log_message_if_verbose_m("Process start: Scan");
 
             /// @param `start_keys`
@@ -1211,7 +1824,7 @@ class UStoreService : public arf::FlightServerBase {
                 log_return_message_m(ar::Status::ExecutionError, status.message());
             log_message_if_verbose_m("Process end: Scan");
         }
-        else if (is_query(desc.cmd, kFlightSample)) {
+        else if (is_query(cmd, kFlightSample)) {
             log_message_if_verbose_m("Process start: Sample");
 
             /// @param `limits`
@@ -1283,9 +1896,16 @@ class UStoreService : public arf::FlightServerBase {
                 status.member_ptr());
             log_message_if_verbose_m("Process end: Sample");
         }
+        else
+            log_return_message_m(ar::Status::Invalid, "Unknown exchange request");
 
         if (is_empty_values)
             output_batch_c.children[0]->buffers[2] = &zero_size_data_k;
+        // Transactions reuse their arena only on the next request of the same client,
+        // which can't arrive before this response is delivered. Transaction-less arenas,
+        // however, can be immediately checked out by any other request.
+        if (!session.is_txn())
+            bind_session(output_batch_c, std::move(session));
         arrow::Result<std::shared_ptr<arrow::RecordBatch>> maybe_table =
             ar::ImportRecordBatch(&output_batch_c, &output_schema_c);
 
@@ -1293,39 +1913,387 @@ class UStoreService : public arf::FlightServerBase {
             return maybe_table.status();
 
         auto table = maybe_table.ValueUnsafe();
-        ar_status = table->ValidateFull();
+        ar::Status ar_status = table->ValidateFull();
         if (!ar_status.ok())
             return ar_status;
+        return table;
+    }
 
-        ar_status = response.Begin(table->schema());
-        if (!ar_status.ok())
-            return ar_status;
+    /**
+     * @brief Executes a modality call against the embedded engine, so that only the final
+     * results cross the network, instead of the blobs of intermediate reads and writes.
+     * Both the arguments and the results are packed with `arrow_bundle_t`.
+     */
+    ar::Result<std::shared_ptr<ar::RecordBatch>> exchange_modality( //
+        session_params_t const& params,
+        std::string_view cmd,
+        ustore_snapshot_t c_snapshot_id,
+        ArrowSchema& input_schema_c,
+        ArrowArray& input_batch_c,
+        session_lock_t&& session) {
 
-        ar_status = response.WriteRecordBatch(*table);
+        status_t status;
+        arrow_bundle_t response;
+        ustore_options_t options = ustore_options(params);
+        ArrowSchema& in_schema = input_schema_c;
+        ArrowArray& in_batch = input_batch_c;
+        auto add = [&](ar::Status const& ar_status) {
+            if (!ar_status.ok() && status)
+                log_error_m(status.member_ptr(), error_unknown_k, "Failed to pack the response");
+        };
+
+        // The arena lock aliases the session, so it must be released before the session is moved
+        {
+            linked_memory_lock_t arena = linked_memory(&session.arena, options, status.member_ptr());
+            if (!status)
+                log_return_message_m(ar::Status::ExecutionError, status.message());
+
+            if (is_query(cmd, kFlightGraphFindEdges)) {
+                log_message_if_verbose_m("Process start: Graph find edges");
+                ustore_size_t tasks_count = get_bundled_scalar<ustore_size_t>(in_schema, in_batch, kArgCounts);
+                auto vertices = get_bundled_strided<ustore_key_t>(in_schema, in_batch, kArgVertices);
+                auto collections = get_bundled_strided<ustore_collection_t>(in_schema, in_batch, kArgCols);
+                auto roles = get_bundled_strided<ustore_vertex_role_t>(in_schema, in_batch, kArgRoles);
+                bool only_degrees = !get_bundled_scalar<ustore_octet_t>(in_schema, in_batch, kArgWantEdges);
+                bool with_attributes = get_bundled_scalar<ustore_octet_t>(in_schema, in_batch, kArgWantAttributes);
+
+                ustore_vertex_degree_t* degrees = nullptr;
+                ustore_key_t* edges = nullptr;
+                std::int64_t* timestamps = nullptr;
+                ustore_float_t* weights = nullptr;
+
+                ustore_graph_find_edges_t find {};
+                find.db = db_;
+                find.error = status.member_ptr();
+                find.transaction = session.txn;
+                find.snapshot = c_snapshot_id;
+                find.arena = arena;
+                find.options = options;
+                find.tasks_count = vertices ? tasks_count : 0;
+                find.collections = collections.get();
+                find.collections_stride = collections.stride();
+                find.vertices = vertices.get();
+                find.vertices_stride = vertices.stride();
+                find.roles = roles.get();
+                find.roles_stride = roles.stride();
+                find.degrees_per_vertex = &degrees;
+                find.edges_per_vertex = only_degrees ? nullptr : &edges;
+                find.timestamps_per_edge = with_attributes ? &timestamps : nullptr;
+                find.weights_per_edge = with_attributes ? &weights : nullptr;
+                ustore_graph_find_edges(&find);
+                if (!status)
+                    log_return_message_m(ar::Status::ExecutionError, status.message());
+
+                std::size_t count_edges = 0;
+                for (std::size_t i = 0; i != find.tasks_count; ++i)
+                    count_edges += degrees[i] != ustore_vertex_degree_missing_k ? degrees[i] : 0;
+                add(response.add(kArgDegrees, degrees, find.tasks_count));
+                if (edges)
+                    add(response.add(kArgEdges, edges, count_edges * 3));
+                if (timestamps)
+                    add(response.add(kArgTimestamps, timestamps, count_edges));
+                if (weights)
+                    add(response.add(kArgWeights, weights, count_edges));
+                log_message_if_verbose_m("Process end: Graph find edges");
+            }
+            else if (is_query(cmd, kFlightGraphUpsertEdges)) {
+                log_message_if_verbose_m("Process start: Graph upsert edges");
+                ustore_size_t tasks_count = get_bundled_scalar<ustore_size_t>(in_schema, in_batch, kArgCounts);
+                auto sources = get_bundled_strided<ustore_key_t>(in_schema, in_batch, kArgSources);
+                auto targets = get_bundled_strided<ustore_key_t>(in_schema, in_batch, kArgTargets);
+                auto edges = get_bundled_strided<ustore_key_t>(in_schema, in_batch, kArgEdges);
+                auto collections = get_bundled_strided<ustore_collection_t>(in_schema, in_batch, kArgCols);
+                auto timestamps = get_bundled_strided<std::int64_t>(in_schema, in_batch, kArgTimestamps);
+                auto weights = get_bundled_strided<ustore_float_t>(in_schema, in_batch, kArgWeights);
+
+                ustore_graph_upsert_edges_t upsert {};
+                upsert.db = db_;
+                upsert.error = status.member_ptr();
+                upsert.transaction = session.txn;
+                upsert.arena = arena;
+                upsert.options = options;
+                upsert.tasks_count = sources && targets ? tasks_count : 0;
+                upsert.collections = collections.get();
+                upsert.collections_stride = collections.stride();
+                upsert.edges_ids = edges.get();
+                upsert.edges_stride = edges.stride();
+                upsert.sources_ids = sources.get();
+                upsert.sources_stride = sources.stride();
+                upsert.targets_ids = targets.get();
+                upsert.targets_stride = targets.stride();
+                upsert.timestamps = timestamps.get();
+                upsert.timestamps_stride = timestamps.stride();
+                upsert.weights = weights.get();
+                upsert.weights_stride = weights.stride();
+                ustore_graph_upsert_edges(&upsert);
+                if (!status)
+                    log_return_message_m(ar::Status::ExecutionError, status.message());
+                log_message_if_verbose_m("Process end: Graph upsert edges");
+            }
+            else if (is_query(cmd, kFlightDocsWrite)) {
+                log_message_if_verbose_m("Process start: Docs write");
+                auto keys = get_bundled_strided<ustore_key_t>(in_schema, in_batch, kArgKeys);
+                auto collections = get_bundled_strided<ustore_collection_t>(in_schema, in_batch, kArgCols);
+                auto values = get_bundled<byte_t>(in_schema, in_batch, kArgVals);
+                auto offsets = get_bundled_strided<ustore_length_t>(in_schema, in_batch, kArgOffsets);
+                auto lengths = get_bundled_strided<ustore_length_t>(in_schema, in_batch, kArgLengths);
+                auto indexes_cols = get_bundled<ustore_collection_t>(in_schema, in_batch, kArgIndexesCols);
+                auto shreds_cols = get_bundled<ustore_collection_t>(in_schema, in_batch, kArgShredsCols);
+                ptr_range_gt<ustore_str_view_t> fields, id_field, indexes_fields, shreds_fields;
+                get_bundled_strings(in_schema, in_batch, kArgFields, fields, arena, status.member_ptr());
+                get_bundled_strings(in_schema, in_batch, kArgIdField, id_field, arena, status.member_ptr());
+                get_bundled_strings(in_schema, in_batch, kArgIndexesFields, indexes_fields, arena, status.member_ptr());
+                get_bundled_strings(in_schema, in_batch, kArgShredsFields, shreds_fields, arena, status.member_ptr());
+                if (!status)
+                    log_return_message_m(ar::Status::Invalid, status.message());
+
+                ustore_bytes_cptr_t values_begin = values.begin();
+                ustore_docs_write_t write {};
+                write.db = db_;
+                write.error = status.member_ptr();
+                write.transaction = session.txn;
+                write.arena = arena;
+                write.options = options;
+                write.tasks_count = get_bundled_scalar<ustore_size_t>(in_schema, in_batch, kArgCounts);
+                write.type = get_bundled_scalar(in_schema, in_batch, kArgType, ustore_doc_field_default_k);
+                write.modification =
+                    get_bundled_scalar(in_schema, in_batch, kArgModification, ustore_doc_modify_upsert_k);
+                write.collections = collections.get();
+                write.collections_stride = collections.stride();
+                write.keys = keys.get();
+                write.keys_stride = keys.stride();
+                write.fields = fields.begin();
+                write.fields_stride = fields.size() > 1 ? sizeof(ustore_str_view_t) : 0;
+                write.offsets = offsets.get();
+                write.offsets_stride = offsets.stride();
+                write.lengths = lengths.get();
+                write.lengths_stride = lengths.stride();
+                write.values = values_begin ? &values_begin : nullptr;
+                write.values_stride = 0;
+                write.id_field = id_field.size() ? id_field[0] : nullptr;
+                write.values_joined = get_bundled_scalar<ustore_octet_t>(in_schema, in_batch, kArgJoined);
+                write.indexes_count = indexes_cols.size();
+                write.indexes_fields = indexes_fields.begin();
+                write.indexes_fields_stride = sizeof(ustore_str_view_t);
+                write.indexes_collections = indexes_cols.begin();
+                write.indexes_collections_stride = sizeof(ustore_collection_t);
+                write.shreds_count = shreds_cols.size();
+                write.shreds_fields = shreds_fields.begin();
+                write.shreds_fields_stride = sizeof(ustore_str_view_t);
+                write.shreds_collections = shreds_cols.begin();
+                write.shreds_collections_stride = sizeof(ustore_collection_t);
+                ustore_docs_write(&write);
+                if (!status)
+                    log_return_message_m(ar::Status::ExecutionError, status.message());
+                log_message_if_verbose_m("Process end: Docs write");
+            }
+            else if (is_query(cmd, kFlightDocsGather)) {
+                log_message_if_verbose_m("Process start: Docs gather");
+                ustore_size_t docs_count = get_bundled_scalar<ustore_size_t>(in_schema, in_batch, kArgCounts);
+                auto keys = get_bundled_strided<ustore_key_t>(in_schema, in_batch, kArgKeys);
+                auto collections = get_bundled_strided<ustore_collection_t>(in_schema, in_batch, kArgCols);
+                auto types = get_bundled<ustore_doc_field_type_t>(in_schema, in_batch, kArgTypes);
+                auto operators = get_bundled<ustore_doc_compare_t>(in_schema, in_batch, kArgFiltersOperators);
+                auto shreds_cols = get_bundled<ustore_collection_t>(in_schema, in_batch, kArgShredsCols);
+                bool wants_conversions = get_bundled_scalar<ustore_octet_t>(in_schema, in_batch, kArgWantConversions);
+                bool wants_collisions = get_bundled_scalar<ustore_octet_t>(in_schema, in_batch, kArgWantCollisions);
+                ptr_range_gt<ustore_str_view_t> fields, filters_fields, filters_values, shreds_fields;
+                get_bundled_strings(in_schema, in_batch, kArgFields, fields, arena, status.member_ptr());
+                get_bundled_strings(in_schema, in_batch, kArgFiltersFields, filters_fields, arena, status.member_ptr());
+                get_bundled_strings(in_schema, in_batch, kArgFiltersValues, filters_values, arena, status.member_ptr());
+                get_bundled_strings(in_schema, in_batch, kArgShredsFields, shreds_fields, arena, status.member_ptr());
+                if (!status)
+                    log_return_message_m(ar::Status::Invalid, status.message());
+                if (types.size() != fields.size() || operators.size() != filters_fields.size() ||
+                    filters_values.size() != filters_fields.size() || shreds_fields.size() != shreds_cols.size())
+                    log_return_message_m(ar::Status::Invalid, "Mismatching number of fields");
+
+                ustore_size_t selected_count = 0;
+                ustore_length_t* selected_indices = nullptr;
+                ustore_octet_t** validities = nullptr;
+                ustore_octet_t** conversions = nullptr;
+                ustore_octet_t** collisions = nullptr;
+                ustore_byte_t** scalars = nullptr;
+                ustore_length_t** offsets = nullptr;
+                ustore_length_t** lengths = nullptr;
+                ustore_byte_t* strings = nullptr;
+
+                ustore_docs_gather_t gather {};
+                gather.db = db_;
+                gather.error = status.member_ptr();
+                gather.transaction = session.txn;
+                gather.snapshot = c_snapshot_id;
+                gather.arena = arena;
+                gather.options = options;
+                gather.docs_count = keys ? docs_count : 0;
+                gather.fields_count = fields.size();
+                gather.collections = collections.get();
+                gather.collections_stride = collections.stride();
+                gather.keys = keys.get();
+                gather.keys_stride = keys.stride();
+                gather.fields = fields.begin();
+                gather.fields_stride = sizeof(ustore_str_view_t);
+                gather.types = types.begin();
+                gather.types_stride = sizeof(ustore_doc_field_type_t);
+                gather.filters_count = filters_fields.size();
+                gather.filters_fields = filters_fields.begin();
+                gather.filters_fields_stride = sizeof(ustore_str_view_t);
+                gather.filters_operators = operators.begin();
+                gather.filters_operators_stride = sizeof(ustore_doc_compare_t);
+                gather.filters_values = filters_values.begin();
+                gather.filters_values_stride = sizeof(ustore_str_view_t);
+                gather.shreds_count = shreds_cols.size();
+                gather.shreds_fields = shreds_fields.begin();
+                gather.shreds_fields_stride = sizeof(ustore_str_view_t);
+                gather.shreds_collections = shreds_cols.begin();
+                gather.shreds_collections_stride = sizeof(ustore_collection_t);
+                gather.selected_count = &selected_count;
+                gather.selected_indices = &selected_indices;
+                gather.columns_validities = &validities;
+                gather.columns_conversions = wants_conversions ? &conversions : nullptr;
+                gather.columns_collisions = wants_collisions ? &collisions : nullptr;
+                gather.columns_scalars = &scalars;
+                gather.columns_offsets = &offsets;
+                gather.columns_lengths = &lengths;
+                gather.joined_strings = &strings;
+                ustore_docs_gather(&gather);
+                if (!status)
+                    log_return_message_m(ar::Status::ExecutionError, status.message());
+
+                // Every column is shipped separately, so the exact layout of the arena doesn't leak
+                std::size_t const bitmap_bytes = divide_round_up<std::size_t>(selected_count, CHAR_BIT);
+                std::size_t strings_bytes = 0;
+                add(response.add_scalar(kArgCounts, selected_count));
+                add(response.add(kArgSelected, selected_indices, selected_count));
+                for (std::size_t field_idx = 0; validities && field_idx != fields.size(); ++field_idx) {
+                    std::string suffix = "." + std::to_string(field_idx);
+                    add(response.add(kArgValidities + suffix, validities[field_idx], bitmap_bytes));
+                    if (conversions)
+                        add(response.add(kArgConversions + suffix, conversions[field_idx], bitmap_bytes));
+                    if (collisions)
+                        add(response.add(kArgCollisions + suffix, collisions[field_idx], bitmap_bytes));
+                    if (doc_field_is_variable_length(types[field_idx])) {
+                        add(response.add(kArgOffsets + suffix, offsets[field_idx], selected_count + 1));
+                        add(response.add(kArgLengths + suffix, lengths[field_idx], selected_count));
+                        strings_bytes = std::max<std::size_t>(strings_bytes, offsets[field_idx][selected_count]);
+                    }
+                    else {
+                        std::size_t scalars_bytes = doc_field_size_bytes(types[field_idx]) * selected_count;
+                        add(response.add(kArgScalars + suffix, scalars[field_idx], scalars_bytes));
+                    }
+                }
+                add(response.add(kArgStrings, strings, strings_bytes));
+                log_message_if_verbose_m("Process end: Docs gather");
+            }
+            else if (is_query(cmd, kFlightVectorsSearch)) {
+                log_message_if_verbose_m("Process start: Vectors search");
+                auto queries = get_bundled<byte_t>(in_schema, in_batch, kArgQueries);
+                auto collections = get_bundled_strided<ustore_collection_t>(in_schema, in_batch, kArgCols);
+                auto limits = get_bundled_strided<ustore_length_t>(in_schema, in_batch, kArgCountLimits);
+                auto packed_cols = get_bundled_strided<ustore_collection_t>(in_schema, in_batch, kArgPackedCols);
+                auto allowed_keys = get_bundled<ustore_key_t>(in_schema, in_batch, kArgAllowedKeys);
+                ptr_range_gt<ustore_str_view_t> filters_fields, filters_values;
+                get_bundled_strings(in_schema, in_batch, kArgFiltersFields, filters_fields, arena, status.member_ptr());
+                get_bundled_strings(in_schema, in_batch, kArgFiltersValues, filters_values, arena, status.member_ptr());
+                if (!status)
+                    log_return_message_m(ar::Status::Invalid, status.message());
+
+                ustore_size_t tasks_count = get_bundled_scalar<ustore_size_t>(in_schema, in_batch, kArgCounts);
+                ustore_length_t dimensions = get_bundled_scalar<ustore_length_t>(in_schema, in_batch, kArgDimensions);
+                if (!tasks_count || !dimensions || !limits || queries.size() % tasks_count)
+                    log_return_message_m(ar::Status::Invalid, "Malformed vector search request");
+
+                ustore_bytes_cptr_t queries_begin = queries.begin();
+                ustore_length_t* found_counts = nullptr;
+                ustore_length_t* found_offsets = nullptr;
+                ustore_key_t* found_keys = nullptr;
+                ustore_float_t* found_metrics = nullptr;
+
+                ustore_vectors_search_t search {};
+                search.db = db_;
+                search.error = status.member_ptr();
+                search.transaction = session.txn;
+                search.arena = arena;
+                search.options = options;
+                search.tasks_count = tasks_count;
+                search.dimensions = dimensions;
+                search.scalar_type = get_bundled_scalar<ustore_vector_scalar_t>(in_schema, in_batch, kArgScalarType);
+                search.metric = get_bundled_scalar<ustore_vector_metric_t>(in_schema, in_batch, kArgMetric);
+                search.metric_threshold = get_bundled_scalar<ustore_float_t>(in_schema, in_batch, kArgMetricThreshold);
+                search.collections = collections.get();
+                search.collections_stride = collections.stride();
+                search.match_counts_limits = limits.get();
+                search.match_counts_limits_stride = limits.stride();
+                search.queries_starts = &queries_begin;
+                search.queries_starts_stride = 0;
+                search.queries_stride = queries.size() / tasks_count;
+                search.search_expansion = get_bundled_scalar<ustore_size_t>(in_schema, in_batch, kArgSearchExpansion);
+                search.packed_collections = packed_cols.get();
+                search.packed_collections_stride = packed_cols.stride();
+                search.allowed_keys = allowed_keys.begin();
+                search.allowed_keys_count = allowed_keys.size();
+                search.filter_fields_count = filters_fields.size();
+                search.filter_collection = get_bundled_scalar<ustore_collection_t>(in_schema, in_batch, kArgFilterCol);
+                search.filter_fields = filters_fields.begin();
+                search.filter_fields_stride = sizeof(ustore_str_view_t);
+                search.filter_values = filters_values.begin();
+                search.filter_values_stride = sizeof(ustore_str_view_t);
+                search.match_counts = &found_counts;
+                search.match_offsets = &found_offsets;
+                search.match_keys = &found_keys;
+                search.match_metrics = &found_metrics;
+                ustore_vectors_search(&search);
+                if (!status)
+                    log_return_message_m(ar::Status::ExecutionError, status.message());
+
+                std::size_t count_limits_sum = 0;
+                for (std::size_t i = 0; i != tasks_count; ++i)
+                    count_limits_sum += limits[i];
+                add(response.add(kArgCounts, found_counts, tasks_count));
+                add(response.add(kArgOffsets, found_offsets, tasks_count));
+                add(response.add(kArgKeys, found_keys, count_limits_sum));
+                add(response.add(kArgMetrics, found_metrics, count_limits_sum));
+                log_message_if_verbose_m("Process end: Vectors search");
+            }
+            else
+                log_return_message_m(ar::Status::Invalid, "Unknown modality request");
+        }
+        if (!status)
+            log_return_message_m(ar::Status::ExecutionError, status.message());
+
+        // Same as in `exchange`, only transaction-less arenas must be held until the batch is sent
+        std::shared_ptr<ar::RecordBatch> batch = response.batch();
+        if (session.is_txn())
+            return batch;
+
+        ArrowSchema output_schema_c;
+        ArrowArray output_batch_c;
+        ar::Status ar_status = ar::ExportRecordBatch(*batch, &output_batch_c, &output_schema_c);
         if (!ar_status.ok())
             return ar_status;
-
-        return response.Close();
+        bind_session(output_batch_c, std::move(session));
+        return ar::ImportRecordBatch(&output_batch_c, &output_schema_c);
     }
 
-    ar::Status DoPut( //
+    /**
+     * @brief Executes a single `DoPut`-like request on an already unpacked input.
+     */
+    ar::Status put( //
         arf::ServerCallContext const& server_call,
-        std::unique_ptr<arf::FlightMessageReader> request_ptr,
-        std::unique_ptr<arf::FlightMetadataWriter> response_ptr) override {
+        std::string_view cmd,
+        ArrowSchema& input_schema_c,
+        ArrowArray& input_batch_c) {
 
-        ar::Status ar_status;
-        arf::FlightMessageReader& request = *request_ptr;
-        arf::FlightMetadataWriter& response = *response_ptr;
-        arf::FlightDescriptor const& desc = request.descriptor();
-        session_params_t params = session_params(server_call, desc.cmd);
-        status_t status;
+        admission_t::ticket_t ticket = admission_.admit(request_class(cmd));
+        if (!ticket)
+            log_return_message_m(ar::Status::Unavailable, "Too many requests in flight");
+        ticket.execute();
 
-        ArrowSchema input_schema_c;
-        ArrowArray input_batch_c;
-        if (ar_status = unpack_table(request.ToTable(), input_schema_c, input_batch_c); !ar_status.ok())
-            return ar_status;
+        session_params_t params = session_params(server_call, cmd);
+        trace_request_scope_t request_scope {parse_request_id(params)};
+        status_t status;
 
-        if (is_query(desc.cmd, kFlightWrite)) {
+        if (is_query(cmd, kFlightWrite)) {
             log_message_if_verbose_m("Process start: Write");
 
             /// @param `keys`
@@ -1379,7 +2347,7 @@ class UStoreService : public arf::FlightServerBase {
                 log_return_message_m(ar::Status::ExecutionError, status.message());
             log_message_if_verbose_m("Process end: Write");
         }
-        else if (is_query(desc.cmd, kFlightWritePath)) {
+        else if (is_query(cmd, kFlightWritePath)) {
             log_message_if_verbose_m("Process start: Write path");
 
             /// @param `keys`
@@ -1437,9 +2405,124 @@ class UStoreService : public arf::FlightServerBase {
                 log_return_message_m(ar::Status::ExecutionError, status.message());
             log_message_if_verbose_m("Process end: Write path");
         }
+        else
+            log_return_message_m(ar::Status::Invalid, "Unknown put request");
         return ar::Status::OK();
     }
 
+    /**
+     * @brief Serves many requests over one long-lived stream, in the order of their arrival.
+     * Requests and responses are metadata-only messages, framed with `pack_frame`, as their
+     * schemas differ. Clients match the responses by sequence numbers, and don't have to wait
+     * for a round-trip between consecutive requests.
+     */
+    ar::Status exchange_pipelined( //
+        arf::ServerCallContext const& server_call,
+        arf::FlightMessageReader& request,
+        arf::FlightMessageWriter& response) {
+
+        while (true) {
+            auto maybe_chunk = request.Next();
+            if (!maybe_chunk.ok())
+                return maybe_chunk.status();
+            arf::FlightStreamChunk const& chunk = maybe_chunk.ValueUnsafe();
+            if (!chunk.app_metadata)
+                return ar::Status::OK();
+
+            std::uint64_t sequence = 0;
+            std::string_view cmd;
+            std::shared_ptr<ar::RecordBatch> input, output;
+            ArrowSchema input_schema_c {};
+            ArrowArray input_batch_c {};
+            arrow_release_guard_t input_guard {input_schema_c, input_batch_c};
+
+            ar::Status ar_status = unpack_frame(chunk.app_metadata, sequence, cmd, input);
+            if (ar_status.ok() && !input)
+                ar_status = ar::Status::Invalid("Pipelined requests must carry a batch");
+            if (ar_status.ok())
+                ar_status = ar::ExportRecordBatch(*input, &input_batch_c, &input_schema_c);
+            if (ar_status.ok()) {
+                if (is_query(cmd, kFlightWrite) || is_query(cmd, kFlightWritePath))
+                    ar_status = put(server_call, cmd, input_schema_c, input_batch_c);
+                else {
+                    auto maybe_output = exchange(server_call, cmd, input_schema_c, input_batch_c);
+                    ar_status = maybe_output.status();
+                    if (ar_status.ok())
+                        output = maybe_output.MoveValueUnsafe();
+                }
+            }
+
+            ar::ipc::IpcWriteOptions write_options = ar::ipc::IpcWriteOptions::Defaults();
+            if (ar_status.ok() && output)
+                ar_status = arrow_compress_if_large(arrow_compression(cmd), *output, write_options);
+
+            // Failures of individual requests are reported to the client, without closing the stream
+            std::string error = ar_status.ok() ? std::string() : ar_status.ToString();
+            auto maybe_frame = pack_frame(sequence, error, ar_status.ok() ? output.get() : nullptr, write_options);
+            if (!maybe_frame.ok())
+                return maybe_frame.status();
+            ar_status = response.WriteMetadata(maybe_frame.MoveValueUnsafe());
+            if (!ar_status.ok())
+                return ar_status;
+        }
+    }
+
+    ar::Status DoExchange( //
+        arf::ServerCallContext const& server_call,
+        std::unique_ptr<arf::FlightMessageReader> request_ptr,
+        std::unique_ptr<arf::FlightMessageWriter> response_ptr) override {
+
+        ar::Status ar_status;
+        arf::FlightMessageReader& request = *request_ptr;
+        arf::FlightMessageWriter& response = *response_ptr;
+        arf::FlightDescriptor const& desc = request.descriptor();
+        if (is_query(desc.cmd, kFlightPipeline))
+            return exchange_pipelined(server_call, request, response);
+
+        ArrowSchema input_schema_c {};
+        ArrowArray input_batch_c {};
+        arrow_release_guard_t input_guard {input_schema_c, input_batch_c};
+        if (ar_status = unpack_stream(request, input_schema_c, input_batch_c); !ar_status.ok())
+            return ar_status;
+
+        auto maybe_table = exchange(server_call, desc.cmd, input_schema_c, input_batch_c);
+        if (!maybe_table.ok())
+            return maybe_table.status();
+
+        auto const& table = maybe_table.ValueUnsafe();
+        ar::ipc::IpcWriteOptions write_options = ar::ipc::IpcWriteOptions::Defaults();
+        ar_status = arrow_compress_if_large(session_params(server_call, desc.cmd).compression, *table, write_options);
+        if (!ar_status.ok())
+            return ar_status;
+
+        ar_status = response.Begin(table->schema(), write_options);
+        if (!ar_status.ok())
+            return ar_status;
+
+        ar_status = response.WriteRecordBatch(*table);
+        if (!ar_status.ok())
+            return ar_status;
+
+        return response.Close();
+    }
+
+    ar::Status DoPut( //
+        arf::ServerCallContext const& server_call,
+        std::unique_ptr<arf::FlightMessageReader> request_ptr,
+        std::unique_ptr<arf::FlightMetadataWriter>) override {
+
+        ar::Status ar_status;
+        arf::FlightMessageReader& request = *request_ptr;
+        arf::FlightDescriptor const& desc = request.descriptor();
+
+        ArrowSchema input_schema_c {};
+        ArrowArray input_batch_c {};
+        arrow_release_guard_t input_guard {input_schema_c, input_batch_c};
+        if (ar_status = unpack_stream(request, input_schema_c, input_batch_c); !ar_status.ok())
+            return ar_status;
+        return put(server_call, desc.cmd, input_schema_c, input_batch_c);
+    }
+
     ar::Status DoGet( //
         arf::ServerCallContext const& server_call,
         arf::Ticket const& ticket,
@@ -1447,6 +2530,7 @@ class UStoreService : public arf::FlightServerBase {
 
         ar::Status ar_status;
         session_params_t params = session_params(server_call, ticket.ticket);
+        trace_request_scope_t request_scope {parse_request_id(params)};
         status_t status;
 
         if (is_query(ticket.ticket, kFlightRetrieveMetadata)) {
@@ -1456,11 +2540,13 @@ class UStoreService : public arf::FlightServerBase {
             if (!status)
                 return ar::Status::ExecutionError(status.message());
 
-            auto arena = linked_memory(&session.arena, ustore_options_default_k, status.member_ptr());
-            if (!status)
-                return ar::Status::ExecutionError(status.message());
-
-            auto metadata_ptr = arena.alloc<int8_t>(1, status.member_ptr()).begin();
+            int8_t* metadata_ptr = nullptr;
+            {
+                auto arena = linked_memory(&session.arena, ustore_options_default_k, status.member_ptr());
+                if (!status)
+                    return ar::Status::ExecutionError(status.message());
+                metadata_ptr = arena.alloc<int8_t>(1, status.member_ptr()).begin();
+            }
             ustore_get_metadata_t get_metadata {};
             get_metadata.metadata = reinterpret_cast<ustore_metadata_t*>(metadata_ptr);
             ustore_get_metadata(&get_metadata);
@@ -1484,6 +2570,8 @@ class UStoreService : public arf::FlightServerBase {
             if (!status)
                 return ar::Status::ExecutionError(status.message());
 
+            // The batch is streamed after this call returns, while the session arena is still needed
+            bind_session(array_c, std::move(session));
             auto maybe_batch = ar::ImportRecordBatch(&array_c, &schema_c);
             if (!maybe_batch.ok())
                 return maybe_batch.status();
@@ -1560,6 +2648,8 @@ class UStoreService : public arf::FlightServerBase {
             if (!status)
                 log_return_message_m(ar::Status::ExecutionError, status.message());
 
+            // The batch is streamed after this call returns, while the session arena is still needed
+            bind_session(array_c, std::move(session));
             auto maybe_batch = ar::ImportRecordBatch(&array_c, &schema_c);
             if (!maybe_batch.ok())
                 return maybe_batch.status();
@@ -1617,6 +2707,8 @@ class UStoreService : public arf::FlightServerBase {
             if (!status)
                 log_return_message_m(ar::Status::ExecutionError, status.message());
 
+            // The batch is streamed after this call returns, while the session arena is still needed
+            bind_session(array_c, std::move(session));
             auto maybe_batch = ar::ImportRecordBatch(&array_c, &schema_c);
             if (!maybe_batch.ok())
                 return maybe_batch.status();
@@ -1632,11 +2724,163 @@ class UStoreService : public arf::FlightServerBase {
             log_message_if_verbose_m("Process end: List snapshots");
             return ar::Status::OK();
         }
+        else if (is_query(ticket.ticket, kFlightScan)) {
+            log_message_if_verbose_m("Process start: Streaming scan");
+            // The stream outlives this call and is pulled concurrently with other requests,
+            // so it can't borrow a transaction from the session.
+            if (params.transaction_id)
+                log_return_message_m(ar::Status::Invalid, "Streaming scans can't be transactional");
+
+            ustore_collection_t c_collection_id = ustore_collection_main_k;
+            if (params.collection_id)
+                c_collection_id = parse_u64_hex(*params.collection_id, ustore_collection_main_k);
+            ustore_snapshot_t c_snapshot_id = 0;
+            if (params.snapshot_id)
+                c_snapshot_id = parse_snap_id(*params.snapshot_id);
+
+            ustore_key_t start_key = std::numeric_limits<ustore_key_t>::min();
+            ustore_size_t limit = std::numeric_limits<ustore_length_t>::max();
+            ustore_size_t batch_size = scan_batch_default_k;
+            auto parse_decimal = [](std::optional<std::string_view> const& param, auto& result) {
+                if (!param)
+                    return true;
+                auto [end, error] = std::from_chars(param->data(), param->data() + param->size(), result);
+                return error == std::errc() && end == param->data() + param->size();
+            };
+            if (!parse_decimal(params.scan_start, start_key) || !parse_decimal(params.scan_limit, limit) ||
+                !parse_decimal(params.scan_batch, batch_size))
+                log_return_message_m(ar::Status::Invalid, "Malformed scan range");
+
+            // Batches are fetched on the stream's own thread, so only the queue slot is taken
+            admission_t::ticket_t ticket = admission_.admit(request_scan_k);
+            if (!ticket)
+                log_return_message_m(ar::Status::Unavailable, "Too many scans in flight");
+
+            auto reader = std::make_shared<scan_stream_t>( //
+                db_,
+                c_snapshot_id,
+                ustore_options(params),
+                c_collection_id,
+                start_key,
+                limit,
+                batch_size,
+                params.opt_scan_values.has_value(),
+                std::move(ticket));
+            // Scans are bulky, so the decision is made once, for the size of a full batch of keys
+            ar::ipc::IpcWriteOptions write_options = ar::ipc::IpcWriteOptions::Defaults();
+            auto batch_bytes = static_cast<std::int64_t>(std::min(batch_size, limit) * sizeof(ustore_key_t));
+            ar_status = arrow_compress_if_large(params.compression, batch_bytes, write_options);
+            if (!ar_status.ok())
+                return ar_status;
+
+            *response_ptr = std::make_unique<arf::RecordBatchStream>(std::move(reader), write_options);
+            log_message_if_verbose_m("Process end: Streaming scan");
+            return ar::Status::OK();
+        }
         return ar::Status::OK();
     }
 };
 
-ar::Status run_server(ustore_str_view_t config, int port) {
+/**
+ * @brief Parses Linux-style CPU lists, like "0-3,8,10-11".
+ * @return Empty vector, if the list is malformed.
+ */
+std::vector<std::size_t> parse_cpu_list(std::string_view list) {
+    std::vector<std::size_t> cores;
+    while (!list.empty()) {
+        std::string_view range = list.substr(0, list.find(','));
+        list.remove_prefix(std::min(range.size() + 1, list.size()));
+        while (!range.empty() && std::isspace(static_cast<unsigned char>(range.front())))
+            range.remove_prefix(1);
+        while (!range.empty() && std::isspace(static_cast<unsigned char>(range.back())))
+            range.remove_suffix(1);
+        if (range.empty())
+            continue;
+
+        std::size_t first = 0, last = 0;
+        std::size_t dash = range.find('-');
+        std::string_view first_str = range.substr(0, dash);
+        std::string_view last_str = dash == std::string_view::npos ? first_str : range.substr(dash + 1);
+        auto first_result = std::from_chars(first_str.data(), first_str.data() + first_str.size(), first);
+        auto last_result = std::from_chars(last_str.data(), last_str.data() + last_str.size(), last);
+        if (first_result.ec != std::errc() || last_result.ec != std::errc() || first > last)
+            return {};
+        for (std::size_t core = first; core <= last; ++core)
+            cores.push_back(core);
+    }
+    return cores;
+}
+
+/**
+ * @brief Lists the cores of a NUMA node, as reported by the kernel.
+ */
+std::vector<std::size_t> numa_node_cores(std::size_t node) {
+    std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string list;
+    std::getline(file, list);
+    return parse_cpu_list(list);
+}
+
+/**
+ * @brief Restricts the current thread, and all threads it will spawn, to the given cores.
+ * Must be called before the database and the RPC server start their thread pools.
+ */
+ar::Status pin_to_cores(std::vector<std::size_t> const& cores) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (std::size_t core : cores)
+        if (core < CPU_SETSIZE)
+            CPU_SET(core, &set);
+    if (!CPU_COUNT(&set))
+        return ar::Status::Invalid("No valid cores to pin to");
+    if (sched_setaffinity(0, sizeof(set), &set) != 0)
+        return ar::Status::IOError("Failed to set CPU affinity");
+    return ar::Status::OK();
+#else
+    return ar::Status::NotImplemented("CPU affinity is only supported on Linux");
+#endif
+}
+
+struct server_config_t {
+    admission_limits_t limits;
+    /// Linux-style CPU list, like "0-3,8", to pin the server to.
+    std::string cores;
+    /// NUMA node to pin the server to, if non-negative.
+    int numa_node = -1;
+};
+
+ar::Status run_server(ustore_str_view_t config, int port, server_config_t const& server_config) {
+
+    std::vector<std::size_t> cores;
+    if (!server_config.cores.empty()) {
+        cores = parse_cpu_list(server_config.cores);
+        if (cores.empty())
+            log_return_message_m(ar::Status::Invalid, "Malformed CPU list");
+    }
+    if (server_config.numa_node >= 0) {
+        std::vector<std::size_t> node_cores = numa_node_cores(static_cast<std::size_t>(server_config.numa_node));
+        if (node_cores.empty())
+            log_return_message_m(ar::Status::Invalid, "Unknown NUMA node");
+        if (!cores.empty()) {
+            std::sort(node_cores.begin(), node_cores.end());
+            auto not_on_node = [&](std::size_t core) {
+                return !std::binary_search(node_cores.begin(), node_cores.end(), core);
+            };
+            cores.erase(std::remove_if(cores.begin(), cores.end(), not_on_node), cores.end());
+        }
+        else
+            cores = std::move(node_cores);
+        if (cores.empty())
+            log_return_message_m(ar::Status::Invalid, "None of the requested cores is on that NUMA node");
+    }
+    // Threads inherit the affinity mask, so pinning the main one covers the engine and gRPC pools
+    if (!cores.empty()) {
+        ar::Status pin_status = pin_to_cores(cores);
+        if (!pin_status.ok())
+            return pin_status;
+        logger.log_message("Pinned to %zu cores", cores.size());
+    }
 
     database_t db;
     db.open(config).throw_unhandled();
@@ -1653,7 +2897,7 @@ ar::Status run_server(ustore_str_view_t config, int port) {
     arrow_mem_pool_t pool(arena);
     options.memory_manager = ar::CPUDevice::memory_manager(&pool);
 
-    auto server = std::make_unique<UStoreService>(std::move(db));
+    auto server = std::make_unique<UStoreService>(std::move(db), server_config.limits);
     ARROW_RETURN_NOT_OK(server->Init(options));
 
     server->SetShutdownOnSignals({SIGINT});
@@ -1672,12 +2916,24 @@ int main(int argc, char* argv[]) {
     std::string config_path = "/var/lib/ustore/config.json";
     int port = 38709;
     bool help = false;
+    server_config_t server_config;
+    admission_limits_t& limits = server_config.limits;
 
     auto cli = ( //
         (option("--config") & value("path", config_path))
             .doc("Configuration file path. The default configuration file path is " + config_path),
         (option("-p", "--port") & value("port", port))
             .doc("Port to use for connection. The default connection port is 38709"),
+        (option("--threads") & value("threads", limits.executing))
+            .doc("Requests executed at once. Defaults to the number of hardware threads, 0 means unlimited"),
+        (option("--max-reads") & value("reads", limits.in_flight[request_read_k]))
+            .doc("Reads executing or waiting, before new ones are rejected. 0 means unlimited"),
+        (option("--max-writes") & value("writes", limits.in_flight[request_write_k]))
+            .doc("Writes executing or waiting, before new ones are rejected. 0 means unlimited"),
+        (option("--max-scans") & value("scans", limits.in_flight[request_scan_k]))
+            .doc("Scans executing or streaming, before new ones are rejected. 0 means unlimited"),
+        (option("--cores") & value("list", server_config.cores)).doc("CPU list to pin the server to, like 0-3,8"),
+        (option("--numa-node") & value("node", server_config.numa_node)).doc("NUMA node to pin the server to"),
         option("-q", "--quiet").set(logger.quiet).doc("Silence outputs"),
         option("-v", "--verbose").set(logger.verbose).doc("Active outputs"),
         option("-h", "--help").set(help).doc("Print this help information on this tool and exit"));
@@ -1728,5 +2984,5 @@ int main(int argc, char* argv[]) {
         config = std::string((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
     }
 
-    return run_server(config.c_str(), port).ok() ? EXIT_SUCCESS : EXIT_FAILURE;
+    return run_server(config.c_str(), port, server_config).ok() ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -7,6 +7,7 @@
 #pragma once
 #include <algorithm> // `std::sort`
 #include <numeric>   // `std::accumulate`
+#include <cstdint>   // `std::uint64_t`
 #include <forward_list>
 
 namespace unum::ustore {
@@ -35,6 +36,40 @@ element_at inplace_inclusive_prefix_sum(element_at* begin, element_at* const end
     return sum;
 }
 
+/**
+ * @brief Stable LSD radix sort of trivially copyable @p elements by the unsigned keys, that
+ * @p key_of extracts. Skips the passes over bytes, that match in all keys, like the top
+ * bytes of dense identifiers, so they cost just one histogram pass.
+ * The number of passes follows the width of the key, including 128-bit ones.
+ * @param buffer Scratch memory for @p count elements.
+ */
+template <typename element_at, typename key_of_at>
+void radix_sort(element_at* elements, element_at* buffer, std::size_t count, key_of_at&& key_of) noexcept {
+    using key_t = std::decay_t<decltype(key_of(*elements))>;
+    constexpr std::size_t digits_k = sizeof(key_t);
+    std::size_t histograms[digits_k][256] = {};
+    for (std::size_t i = 0; i != count; ++i) {
+        key_t key = key_of(elements[i]);
+        for (std::size_t digit = 0; digit != digits_k; ++digit)
+            ++histograms[digit][(key >> (digit * 8)) & 0xFF];
+    }
+
+    element_at* from = elements;
+    element_at* to = buffer;
+    for (std::size_t digit = 0; digit != digits_k; ++digit) {
+        std::size_t* histogram = histograms[digit];
+        if (std::any_of(histogram, histogram + 256, [=](std::size_t n) { return n == count; }))
+            continue;
+        for (std::size_t byte = 0, offset = 0; byte != 256; ++byte)
+            offset += std::exchange(histogram[byte], offset);
+        for (std::size_t i = 0; i != count; ++i)
+            to[histogram[(key_of(from[i]) >> (digit * 8)) & 0xFF]++] = from[i];
+        std::swap(from, to);
+    }
+    if (from != elements)
+        std::copy_n(from, count, elements);
+}
+
 /**
  * @brief In many "modality" implementations, we may have batches of requests,
  * where distinct queries map into the same entries. In that case, the trivial
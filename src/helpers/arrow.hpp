@@ -7,6 +7,11 @@
 #pragma once
 #include <string>
 #include <string_view>
+#include <optional>  // `std::optional`
+#include <algorithm> // `std::search`
+#include <charconv>  // `std::from_chars`
+#include <cstring>   // `std::memcpy`
+#include <vector>    // `std::vector`
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wall"
@@ -18,6 +23,11 @@
 #include <arrow/table.h>
 #include <arrow/memory_pool.h>
 #include <arrow/c/bridge.h>
+#include <arrow/io/memory.h>
+#include <arrow/ipc/reader.h>
+#include <arrow/ipc/writer.h>
+#include <arrow/util/byte_size.h>
+#include <arrow/util/compression.h>
 #pragma GCC diagnostic pop
 
 #include "linked_memory.hpp"          // `linked_memory_lock_t`
@@ -40,6 +50,7 @@ inline static std::string const kFlightListCols = "list_collections";          /
 inline static std::string const kFlightSample = "sample";                      /// `DoGet`
 inline static std::string const kFlightColCreate = "create_collection";        /// `DoAction`
 inline static std::string const kFlightColDrop = "remove_collection";          /// `DoAction`
+inline static std::string const kFlightEraseRange = "erase_range";              /// `DoAction`
 
 inline static std::string const kFlightListSnap = "list_snapshots";            /// `DoGet`
 inline static std::string const kFlightSnapCreate = "create_snapshot";         /// `DoAction`
@@ -54,8 +65,17 @@ inline static std::string const kFlightRead = "read";                          /
 inline static std::string const kFlightWritePath = "write_path";               /// `DoPut`
 inline static std::string const kFlightMatchPath = "match_path";               /// `DoExchange`
 inline static std::string const kFlightReadPath = "read_path";                 /// `DoExchange`
-inline static std::string const kFlightScan = "scan";                          /// `DoExchange`
+inline static std::string const kFlightScan = "scan";                          /// `DoExchange`, `DoGet`
 inline static std::string const kFlightMeasure = "measure";                    /// `DoExchange`
+inline static std::string const kFlightPipeline = "pipeline";                  /// `DoExchange`
+inline static std::string const kFlightServerStats = "server_stats";           /// `DoAction`
+inline static std::string const kFlightTrace = "trace";                        /// `DoAction`
+
+inline static std::string const kFlightGraphFindEdges = "graph_find_edges";     /// `DoExchange`
+inline static std::string const kFlightGraphUpsertEdges = "graph_upsert_edges"; /// `DoExchange`
+inline static std::string const kFlightDocsWrite = "docs_write";                /// `DoExchange`
+inline static std::string const kFlightDocsGather = "docs_gather";              /// `DoExchange`
+inline static std::string const kFlightVectorsSearch = "vectors_search";        /// `DoExchange`
 
 inline static std::string const kArgSnaps = "snapshots";
 inline static std::string const kArgCols = "collections";
@@ -71,17 +91,71 @@ inline static std::string const kArgPaths = "paths";
 inline static std::string const kArgPatterns = "patterns";
 inline static std::string const kArgPrevPatterns = "prev_patterns";
 
+/// Arguments of modality calls, packed with `arrow_bundle_t`
+inline static std::string const kArgVertices = "vertices";
+inline static std::string const kArgRoles = "roles";
+inline static std::string const kArgEdges = "edges";
+inline static std::string const kArgSources = "sources";
+inline static std::string const kArgTargets = "targets";
+inline static std::string const kArgTimestamps = "timestamps";
+inline static std::string const kArgWeights = "weights";
+inline static std::string const kArgDegrees = "degrees";
+inline static std::string const kArgOffsets = "offsets";
+inline static std::string const kArgType = "type";
+inline static std::string const kArgTypes = "types";
+inline static std::string const kArgModification = "modification";
+inline static std::string const kArgIdField = "id_field";
+inline static std::string const kArgIndexesFields = "indexes_fields";
+inline static std::string const kArgIndexesCols = "indexes_collections";
+inline static std::string const kArgShredsFields = "shreds_fields";
+inline static std::string const kArgShredsCols = "shreds_collections";
+inline static std::string const kArgFiltersFields = "filters_fields";
+inline static std::string const kArgFiltersOperators = "filters_operators";
+inline static std::string const kArgFiltersValues = "filters_values";
+inline static std::string const kArgSelected = "selected";
+inline static std::string const kArgValidities = "validities";
+inline static std::string const kArgConversions = "conversions";
+inline static std::string const kArgCollisions = "collisions";
+inline static std::string const kArgScalars = "scalars";
+inline static std::string const kArgStrings = "strings";
+inline static std::string const kArgQueries = "queries";
+inline static std::string const kArgDimensions = "dimensions";
+inline static std::string const kArgScalarType = "scalar_type";
+inline static std::string const kArgMetric = "metric";
+inline static std::string const kArgMetricThreshold = "metric_threshold";
+inline static std::string const kArgSearchExpansion = "search_expansion";
+inline static std::string const kArgPackedCols = "packed_collections";
+inline static std::string const kArgAllowedKeys = "allowed_keys";
+inline static std::string const kArgFilterCol = "filter_collection";
+inline static std::string const kArgMetrics = "metrics";
+inline static std::string const kArgCounts = "counts";
+inline static std::string const kArgJoined = "joined";
+inline static std::string const kArgWantEdges = "want_edges";
+inline static std::string const kArgWantAttributes = "want_attributes";
+inline static std::string const kArgWantConversions = "want_conversions";
+inline static std::string const kArgWantCollisions = "want_collisions";
+
 inline static std::string const kParamCollectionID = "collection_id";
 inline static std::string const kParamCollectionName = "collection_name";
 inline static std::string const kParamSnapshotID = "snapshot_id";
 inline static std::string const kParamSnapshotExportPath = "snapshot_export_path";
 inline static std::string const kParamTransactionID = "transaction_id";
+inline static std::string const kParamRequestID = "request_id";
 inline static std::string const kParamReadPart = "part";
 inline static std::string const kParamDropMode = "mode";
+inline static std::string const kParamScanStart = "start";
+inline static std::string const kParamScanEnd = "end";
+inline static std::string const kParamScanLimit = "limit";
+inline static std::string const kParamScanBatch = "batch";
 inline static std::string const kParamFlagFlushWrite = "flush";
 inline static std::string const kParamFlagDontWatch = "dont_watch";
 inline static std::string const kParamFlagDontDiscard = "";
 inline static std::string const kParamFlagSharedMemRead = "shared";
+inline static std::string const kParamFlagScanBulk = "bulk";
+inline static std::string const kParamFlagScanSequential = "sequential";
+inline static std::string const kParamFlagScanValues = "values";
+inline static std::string const kParamFlagWriteBulk = "ingest";
+inline static std::string const kParamFlagWriteMerge = "merge";
 
 inline static std::string const kParamReadPartLengths = "lengths";
 inline static std::string const kParamReadPartPresences = "presences";
@@ -90,6 +164,54 @@ inline static std::string const kParamDropModeValues = "values";
 inline static std::string const kParamDropModeContents = "contents";
 inline static std::string const kParamDropModeCollection = "collection";
 
+inline static std::string const kParamConnections = "connections";
+inline static std::string const kParamFlagPipeline = "pipeline";
+inline static std::string const kParamCompression = "compression";
+inline static std::string const kParamCompressionThreshold = "compression_threshold";
+
+inline static std::string const kParamCompressionLZ4 = "lz4";
+inline static std::string const kParamCompressionZSTD = "zstd";
+
+/**
+ * @brief Searches for a "value" among key-value pairs passed in URI after path.
+ * @param query_params  Must begin with "?" or "/".
+ * @param param_name    The name of the URI parameter to match.
+ */
+inline std::optional<std::string_view> param_value(std::string_view query_params, std::string_view param_name) {
+
+    char const* key_begin = query_params.begin();
+    do {
+        key_begin = std::search(key_begin, query_params.end(), param_name.begin(), param_name.end());
+        if (key_begin == query_params.end())
+            return std::nullopt;
+        bool is_suffix = key_begin + param_name.size() == query_params.end();
+        if (is_suffix)
+            return std::string_view {};
+
+        // Check if we have matched a part of bigger key.
+        // In that case skip to next starting point.
+        auto prev_character = *(key_begin - 1);
+        if (prev_character != '?' && prev_character != '&' && prev_character != '/') {
+            key_begin += 1;
+            continue;
+        }
+
+        auto next_character = key_begin[param_name.size()];
+        if (next_character == '&')
+            return std::string_view {};
+
+        if (next_character == '=') {
+            auto value_begin = key_begin + param_name.size() + 1;
+            auto value_end = std::find(value_begin, query_params.end(), '&');
+            return std::string_view {value_begin, static_cast<size_t>(value_end - value_begin)};
+        }
+
+        key_begin += 1;
+    } while (true);
+
+    return std::nullopt;
+}
+
 class arrow_mem_pool_t final : public ar::MemoryPool {
     linked_memory_t resource_;
     int64_t bytes_allocated_ = 0;
@@ -147,6 +269,131 @@ class arrow_mem_pool_t final : public ar::MemoryPool {
     std::string backend_name() const override { return "ustore"; }
 };
 
+/**
+ * @brief Extends the lifetime of `owner` to match the one of an exported `ArrowArray`.
+ * Arrays are often imported into Arrow zero-copy, referencing memory of some arena.
+ * With this wrapper the arena can't be reused until Arrow releases the last such buffer,
+ * which may happen much later, than the request that produced it finishes.
+ */
+template <typename owner_at>
+class arrow_owned_array_gt {
+    void (*release_)(ArrowArray*) = nullptr;
+    void* private_data_ = nullptr;
+    owner_at owner_;
+
+    static void release(ArrowArray* array) noexcept {
+        auto owned = static_cast<arrow_owned_array_gt*>(array->private_data);
+        array->release = owned->release_;
+        array->private_data = owned->private_data_;
+        array->release(array);
+        delete owned;
+    }
+
+  public:
+    arrow_owned_array_gt(ArrowArray& array, owner_at owner) noexcept
+        : release_(array.release), private_data_(array.private_data), owner_(std::move(owner)) {}
+
+    static void attach(ArrowArray& array, owner_at owner) {
+        array.private_data = new arrow_owned_array_gt(array, std::move(owner));
+        array.release = &release;
+    }
+};
+
+template <typename owner_at>
+void arrow_attach_owner(ArrowArray& array, owner_at&& owner) {
+    arrow_owned_array_gt<std::decay_t<owner_at>>::attach(array, std::forward<owner_at>(owner));
+}
+
+/**
+ * @brief Releases an exported `ArrowSchema` and `ArrowArray` pair when leaving the scope.
+ */
+struct arrow_release_guard_t {
+    ArrowSchema& schema;
+    ArrowArray& array;
+
+    ~arrow_release_guard_t() noexcept {
+        if (array.release)
+            array.release(&array);
+        if (schema.release)
+            schema.release(&schema);
+    }
+};
+
+/**
+ * @brief Arrow IPC body compression, negotiated per session through URI parameters,
+ * like "?compression=zstd&compression_threshold=65536". Batches with fewer bytes
+ * than the threshold are sent uncompressed, so point reads don't pay for codecs.
+ */
+struct arrow_compression_t {
+    static constexpr std::int64_t threshold_default_k = 64 * 1024;
+
+    ar::Compression::type codec = ar::Compression::UNCOMPRESSED;
+    std::int64_t threshold = threshold_default_k;
+
+    explicit operator bool() const noexcept { return codec != ar::Compression::UNCOMPRESSED; }
+};
+
+inline arrow_compression_t arrow_compression(std::string_view query_params) noexcept {
+    arrow_compression_t result;
+    auto codec = param_value(query_params, kParamCompression);
+    if (codec == kParamCompressionLZ4)
+        result.codec = ar::Compression::LZ4_FRAME;
+    else if (codec == kParamCompressionZSTD)
+        result.codec = ar::Compression::ZSTD;
+
+    if (auto threshold = param_value(query_params, kParamCompressionThreshold); threshold)
+        std::from_chars(threshold->data(), threshold->data() + threshold->size(), result.threshold);
+    return result;
+}
+
+/**
+ * @brief Appends the parameters, that would be parsed back by `arrow_compression`.
+ */
+inline void export_compression(arrow_compression_t const& compression, std::string& query_params) {
+    if (!compression)
+        return;
+    query_params += kParamCompression;
+    query_params += '=';
+    query_params += compression.codec == ar::Compression::ZSTD ? kParamCompressionZSTD : kParamCompressionLZ4;
+    query_params += '&';
+    query_params += kParamCompressionThreshold;
+    query_params += '=';
+    query_params += std::to_string(compression.threshold);
+    query_params += '&';
+}
+
+/**
+ * @brief Enables compression in `options`, if `bytes` are large enough to benefit from it.
+ * Codecs are stateless between calls, so a single shared instance is used for each type.
+ */
+inline ar::Status arrow_compress_if_large( //
+    arrow_compression_t const& compression,
+    std::int64_t bytes,
+    ar::ipc::IpcWriteOptions& options) {
+
+    options.codec.reset();
+    if (!compression || bytes < compression.threshold)
+        return ar::Status::OK();
+
+    auto make_codec = [](ar::Compression::type type) -> std::shared_ptr<ar::util::Codec> {
+        auto maybe_codec = ar::util::Codec::Create(type);
+        return maybe_codec.ok() ? std::shared_ptr<ar::util::Codec>(maybe_codec.MoveValueUnsafe()) : nullptr;
+    };
+    static std::shared_ptr<ar::util::Codec> const lz4 = make_codec(ar::Compression::LZ4_FRAME);
+    static std::shared_ptr<ar::util::Codec> const zstd = make_codec(ar::Compression::ZSTD);
+    options.codec = compression.codec == ar::Compression::ZSTD ? zstd : lz4;
+    if (!options.codec)
+        return ar::Status::NotImplemented("Arrow was built without this compression codec");
+    return ar::Status::OK();
+}
+
+inline ar::Status arrow_compress_if_large( //
+    arrow_compression_t const& compression,
+    ar::RecordBatch const& batch,
+    ar::ipc::IpcWriteOptions& options) {
+    return arrow_compress_if_large(compression, ar::util::TotalBufferSize(batch), options);
+}
+
 ar::ipc::IpcReadOptions arrow_read_options(arrow_mem_pool_t& pool) {
     ar::ipc::IpcReadOptions options;
     options.memory_pool = &pool;
@@ -163,6 +410,78 @@ ar::ipc::IpcWriteOptions arrow_write_options(arrow_mem_pool_t& pool) {
     return options;
 }
 
+/**
+ * @brief Packs a pipelined request or response into one buffer, sent as Flight metadata.
+ * Starts with an 8-byte sequence number and a 4-byte text length, followed by the text,
+ * padded to 8 bytes, and an Arrow IPC stream with at most one batch. The text is the
+ * command for requests, and the error message for failed responses.
+ */
+inline ar::Result<std::shared_ptr<ar::Buffer>> pack_frame( //
+    std::uint64_t sequence,
+    std::string_view text,
+    ar::RecordBatch const* batch,
+    ar::ipc::IpcWriteOptions const& options = ar::ipc::IpcWriteOptions::Defaults()) {
+
+    static constexpr char padding_k[sizeof(std::uint64_t)] = {};
+    auto maybe_stream = ar::io::BufferOutputStream::Create();
+    if (!maybe_stream.ok())
+        return maybe_stream.status();
+    auto& stream = maybe_stream.ValueUnsafe();
+
+    std::uint32_t text_length = static_cast<std::uint32_t>(text.size());
+    std::size_t header_length = sizeof(sequence) + sizeof(text_length) + text.size();
+    std::size_t padding = divide_round_up<std::size_t>(header_length, sizeof(padding_k)) * sizeof(padding_k) -
+                          header_length;
+    ARROW_RETURN_NOT_OK(stream->Write(&sequence, sizeof(sequence)));
+    ARROW_RETURN_NOT_OK(stream->Write(&text_length, sizeof(text_length)));
+    ARROW_RETURN_NOT_OK(stream->Write(text.data(), static_cast<std::int64_t>(text.size())));
+    ARROW_RETURN_NOT_OK(stream->Write(padding_k, static_cast<std::int64_t>(padding)));
+
+    if (batch) {
+        auto maybe_writer = ar::ipc::MakeStreamWriter(stream, batch->schema(), options);
+        if (!maybe_writer.ok())
+            return maybe_writer.status();
+        auto& writer = maybe_writer.ValueUnsafe();
+        ARROW_RETURN_NOT_OK(writer->WriteRecordBatch(*batch));
+        ARROW_RETURN_NOT_OK(writer->Close());
+    }
+    return stream->Finish();
+}
+
+/**
+ * @brief Parses the output of `pack_frame`. The `text` and `batch` reference `frame` without copies.
+ */
+inline ar::Status unpack_frame( //
+    std::shared_ptr<ar::Buffer> const& frame,
+    std::uint64_t& sequence,
+    std::string_view& text,
+    std::shared_ptr<ar::RecordBatch>& batch) {
+
+    std::uint32_t text_length = 0;
+    std::size_t const frame_length = static_cast<std::size_t>(frame->size());
+    if (frame_length < sizeof(sequence) + sizeof(text_length))
+        return ar::Status::Invalid("Truncated pipeline frame");
+
+    std::memcpy(&sequence, frame->data(), sizeof(sequence));
+    std::memcpy(&text_length, frame->data() + sizeof(sequence), sizeof(text_length));
+    std::size_t header_length = sizeof(sequence) + sizeof(text_length) + text_length;
+    std::size_t padded_length =
+        divide_round_up<std::size_t>(header_length, sizeof(std::uint64_t)) * sizeof(std::uint64_t);
+    if (padded_length > frame_length)
+        return ar::Status::Invalid("Truncated pipeline frame");
+
+    text = {reinterpret_cast<char const*>(frame->data()) + sizeof(sequence) + sizeof(text_length), text_length};
+    batch.reset();
+    if (padded_length == frame_length)
+        return ar::Status::OK();
+
+    auto body = ar::SliceBuffer(frame, static_cast<std::int64_t>(padded_length));
+    auto maybe_reader = ar::ipc::RecordBatchStreamReader::Open(std::make_shared<ar::io::BufferReader>(body));
+    if (!maybe_reader.ok())
+        return maybe_reader.status();
+    return maybe_reader.ValueUnsafe()->ReadNext(&batch);
+}
+
 ar::Result<std::shared_ptr<ar::RecordBatch>> combined_batch(std::shared_ptr<ar::Table> table,
                                                             ar::MemoryPool* pool = ar::default_memory_pool()) {
     return table->num_rows() ? table->CombineChunksToBatch(pool) : ar::RecordBatch::MakeEmpty(table->schema(), pool);
@@ -199,6 +518,206 @@ inline expected_gt<std::size_t> column_idx(ArrowSchema const& schema_c, std::str
     return static_cast<std::size_t>(it - begin);
 }
 
+/**
+ * @brief Packs arguments of different lengths, like vertices and their edges, into one batch.
+ * Every argument becomes a single-row `large_binary` column, wrapping a continuous
+ * array without copies, so the wrapped memory must outlive the batch.
+ * Used to ship the inputs and outputs of modality calls, executed on the server side.
+ */
+class arrow_bundle_t {
+    ar::FieldVector fields_;
+    ar::ArrayVector columns_;
+    ar::MemoryPool* pool_;
+
+    ar::Status add_buffer(std::string_view name, std::shared_ptr<ar::Buffer> data) {
+        auto maybe_offsets = ar::AllocateBuffer(2 * sizeof(std::int64_t), pool_);
+        if (!maybe_offsets.ok())
+            return maybe_offsets.status();
+        std::shared_ptr<ar::Buffer> offsets = maybe_offsets.MoveValueUnsafe();
+        auto offsets_ptr = reinterpret_cast<std::int64_t*>(offsets->mutable_data());
+        offsets_ptr[0] = 0;
+        offsets_ptr[1] = data->size();
+        fields_.push_back(ar::field(std::string(name), ar::large_binary(), false));
+        columns_.push_back(std::make_shared<ar::LargeBinaryArray>(1, std::move(offsets), std::move(data)));
+        return ar::Status::OK();
+    }
+
+  public:
+    arrow_bundle_t(ar::MemoryPool* pool = ar::default_memory_pool()) noexcept : pool_(pool) {}
+
+    ar::Status add(std::string_view name, void const* begin, std::size_t bytes) {
+        auto data = std::make_shared<ar::Buffer>(reinterpret_cast<std::uint8_t const*>(begin),
+                                                 static_cast<std::int64_t>(bytes));
+        return add_buffer(name, std::move(data));
+    }
+
+    template <typename scalar_at>
+    ar::Status add(std::string_view name, scalar_at const* begin, std::size_t count) {
+        return add(name, static_cast<void const*>(begin), count * sizeof(scalar_at));
+    }
+
+    /**
+     * @brief Gathers strided arguments, copying only if those aren't continuous.
+     * Skips NULL arguments and passes zero-stride ones as a single broadcasted entry.
+     */
+    template <typename scalar_at>
+    ar::Status add(std::string_view name, strided_iterator_gt<scalar_at const> begin, std::size_t count) {
+        if (!begin)
+            return ar::Status::OK();
+        if (!begin.stride() || count == 1)
+            return add(name, begin.get(), 1);
+        if (begin.is_continuous())
+            return add(name, begin.get(), count);
+        auto maybe_data = ar::AllocateBuffer(static_cast<std::int64_t>(count * sizeof(scalar_at)), pool_);
+        if (!maybe_data.ok())
+            return maybe_data.status();
+        std::shared_ptr<ar::Buffer> data = maybe_data.MoveValueUnsafe();
+        transform_n(begin, count, reinterpret_cast<std::remove_const_t<scalar_at>*>(data->mutable_data()));
+        return add_buffer(name, std::move(data));
+    }
+
+    template <typename scalar_at>
+    ar::Status add_scalar(std::string_view name, scalar_at scalar) {
+        auto maybe_data = ar::AllocateBuffer(sizeof(scalar_at), pool_);
+        if (!maybe_data.ok())
+            return maybe_data.status();
+        std::shared_ptr<ar::Buffer> data = maybe_data.MoveValueUnsafe();
+        std::memcpy(data->mutable_data(), &scalar, sizeof(scalar_at));
+        return add_buffer(name, std::move(data));
+    }
+
+    /**
+     * @brief Copies NULL-terminated strings back-to-back, keeping them NULL-terminated.
+     * Their lengths go into a companion "<name>.lengths" column, where NULL strings
+     * are marked with `ustore_length_missing_k`.
+     */
+    ar::Status add_strings( //
+        std::string_view name,
+        strided_iterator_gt<ustore_str_view_t const> begin,
+        std::size_t count) {
+        std::vector<ustore_length_t> lengths(count);
+        std::size_t total = 0;
+        for (std::size_t i = 0; i != count; ++i) {
+            lengths[i] = begin[i] ? static_cast<ustore_length_t>(std::strlen(begin[i])) : ustore_length_missing_k;
+            total += begin[i] ? lengths[i] + 1 : 0;
+        }
+
+        auto maybe_data = ar::AllocateBuffer(static_cast<std::int64_t>(total), pool_);
+        if (!maybe_data.ok())
+            return maybe_data.status();
+        std::shared_ptr<ar::Buffer> data = maybe_data.MoveValueUnsafe();
+        auto data_ptr = reinterpret_cast<char*>(data->mutable_data());
+        for (std::size_t i = 0; i != count; ++i) {
+            if (!begin[i])
+                continue;
+            std::memcpy(data_ptr, begin[i], lengths[i] + 1);
+            data_ptr += lengths[i] + 1;
+        }
+        ar::Status ar_status = add_buffer(name, std::move(data));
+        if (!ar_status.ok())
+            return ar_status;
+
+        std::string lengths_name {name};
+        lengths_name += ".lengths";
+        return add_buffer(lengths_name, ar::Buffer::FromVector(std::move(lengths)));
+    }
+
+    std::shared_ptr<ar::RecordBatch> batch() const {
+        return ar::RecordBatch::Make(ar::schema(fields_), 1, columns_);
+    }
+};
+
+/**
+ * @brief Finds an argument packed with `arrow_bundle_t` in an exported batch.
+ * @return NULL range, if the column is missing, and a non-NULL one, if it's just empty.
+ */
+template <typename scalar_at = byte_t>
+ptr_range_gt<scalar_at const> get_bundled(ArrowSchema const& schema_c,
+                                          ArrowArray const& batch_c,
+                                          std::string_view name) noexcept {
+    auto maybe_idx = column_idx(schema_c, name);
+    if (!maybe_idx || std::string_view {schema_c.children[*maybe_idx]->format} != "Z")
+        return {};
+
+    ArrowArray const& array = *batch_c.children[*maybe_idx];
+    if (array.length < 1 || array.n_buffers != 3)
+        return {};
+    auto offsets = reinterpret_cast<std::int64_t const*>(array.buffers[1]) + array.offset;
+    auto data = array.buffers[2] ? reinterpret_cast<byte_t const*>(array.buffers[2])
+                                 : reinterpret_cast<byte_t const*>(zero_size_data_k);
+    auto begin = reinterpret_cast<scalar_at const*>(data + offsets[0]);
+    return {begin, static_cast<std::size_t>(offsets[1] - offsets[0]) / sizeof(scalar_at)};
+}
+
+/**
+ * @brief Finds an argument packed with `arrow_bundle_t` in a received batch.
+ */
+template <typename scalar_at = byte_t>
+ptr_range_gt<scalar_at const> get_bundled(ar::RecordBatch const& batch, std::string const& name) noexcept {
+    auto column = std::dynamic_pointer_cast<ar::LargeBinaryArray>(batch.GetColumnByName(name));
+    if (!column || column->length() < 1)
+        return {};
+    std::string_view view = column->GetView(0);
+    auto data = view.data() ? reinterpret_cast<byte_t const*>(view.data())
+                            : reinterpret_cast<byte_t const*>(zero_size_data_k);
+    return {reinterpret_cast<scalar_at const*>(data), view.size() / sizeof(scalar_at)};
+}
+
+/**
+ * @brief Unpacks the strided argument of `arrow_bundle_t::add`, broadcasting single entries.
+ */
+template <typename scalar_at>
+strided_iterator_gt<scalar_at const> get_bundled_strided(ArrowSchema const& schema_c,
+                                                         ArrowArray const& batch_c,
+                                                         std::string_view name) noexcept {
+    auto range = get_bundled<scalar_at>(schema_c, batch_c, name);
+    if (range.empty())
+        return {};
+    return {range.begin(), range.size() == 1 ? 0 : sizeof(scalar_at)};
+}
+
+template <typename scalar_at>
+scalar_at get_bundled_scalar(ArrowSchema const& schema_c,
+                             ArrowArray const& batch_c,
+                             std::string_view name,
+                             scalar_at missing = {}) noexcept {
+    auto range = get_bundled<scalar_at>(schema_c, batch_c, name);
+    return range.empty() ? missing : range[0];
+}
+
+/**
+ * @brief Unpacks the strings of `arrow_bundle_t::add_strings` into an array of C strings.
+ * Leaves the `strings` NULL, if the argument wasn't passed.
+ */
+inline void get_bundled_strings( //
+    ArrowSchema const& schema_c,
+    ArrowArray const& batch_c,
+    std::string_view name,
+    ptr_range_gt<ustore_str_view_t>& strings,
+    linked_memory_lock_t& arena,
+    ustore_error_t* c_error) {
+
+    std::string lengths_name {name};
+    lengths_name += ".lengths";
+    auto joined = get_bundled<char>(schema_c, batch_c, name);
+    auto lengths = get_bundled<ustore_length_t>(schema_c, batch_c, lengths_name);
+    strings = {};
+    if (!joined.begin() || !lengths.begin())
+        return;
+
+    auto views = arena.alloc<ustore_str_view_t>(lengths.size(), c_error);
+    return_if_error_m(c_error);
+    char const* string = joined.begin();
+    for (std::size_t i = 0; i != lengths.size(); ++i) {
+        bool is_missing = lengths[i] == ustore_length_missing_k;
+        std::size_t consumed = is_missing ? 0 : lengths[i] + 1;
+        return_error_if_m(string + consumed <= joined.end(), c_error, args_wrong_k, "Truncated strings");
+        views[i] = is_missing ? nullptr : string;
+        string += consumed;
+    }
+    strings = views;
+}
+
 /**
  * We have a different methodology of marking NULL entries, than Arrow.
  * We can reuse the `column_lengths` to put-in some NULL markers.
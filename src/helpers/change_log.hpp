@@ -0,0 +1,467 @@
+/**
+ * @file change_log.hpp
+ * @author Ashot Vardanian
+ *
+ * @brief Side log of committed changes, backing the change-feed of engines without a native one.
+ *
+ * The log is split into segments, named after the sequence number of their first change,
+ * like "changes/0000000000000001.changes". Every record in a segment holds one atomic
+ * batch, laid out as `[u64 first sequence][u32 count]` followed by `count` entries of
+ * `[collection][key][u32 length][length bytes]`, where missing lengths mark removals.
+ * Sequence numbers of entries follow each other, so the last number is recovered on
+ * open from the tail of the last segment, once its torn part is truncated.
+ *
+ * Appends must be made under `mutex()`, held around applying the changes to the
+ * storage, so that the order of sequence numbers matches the order of updates.
+ * Readers only lock it to list the segments, and tail the files without blocking
+ * the writers.
+ *
+ * ## Configuration
+ *
+ * Is loaded from the "change_feed" section of the engine config:
+ * @code{.json}
+ * "change_feed": {
+ *     "retention": "1GB" // Oldest segments are removed past this size
+ * }
+ * @endcode
+ * The feed is disabled if the section is missing.
+ */
+#pragma once
+#include <sys/types.h> // `off_t`
+#include <unistd.h>    // `::truncate`
+#include <algorithm>   // `std::find_if`, `std::min`
+#include <cstdio>      // `std::snprintf`
+#include <cstring>     // `std::memcpy`
+#include <filesystem>  // `std::filesystem::directory_iterator`
+#include <mutex>       // `std::mutex`
+#include <string>      // `std::string`
+#include <string_view> // `std::string_view`
+#include <vector>      // `std::vector`
+
+#include <nlohmann/json.hpp> // `nlohmann::json`
+
+#include "ustore/changes.h"            // `ustore_changes_poll_t`
+#include "ustore/cpp/types.hpp"        // `value_view_t`
+#include "ustore/cpp/status.hpp"       // `status_t`
+#include "helpers/config_loader.hpp"   // `config_loader_t::parse_volume`
+#include "helpers/linked_memory.hpp"   // `linked_memory_lock_t`
+#include "helpers/write_ahead_log.hpp" // `write_ahead_log_t`
+
+namespace unum::ustore {
+
+/**
+ * @brief Number of changes exported by a poll, that didn't specify its `count_limit`.
+ */
+constexpr std::size_t changes_count_default_k = 4096;
+
+struct change_feed_config_t {
+    bool enabled = false;
+    std::size_t retention = 1ul << 30;
+
+    /**
+     * @brief Parses the @p engine_config, where the section may be missing.
+     * @return `false` if the section is malformed.
+     */
+    static bool parse(nlohmann::json const& engine_config, change_feed_config_t& result) noexcept {
+        result = {};
+        if (!engine_config.is_object() || !engine_config.contains("change_feed"))
+            return true;
+
+        auto const& section = engine_config["change_feed"];
+        if (!section.is_object() || !config_loader_t::parse_volume(section, "retention", result.retention))
+            return false;
+        result.enabled = true;
+        return true;
+    }
+};
+
+/**
+ * @brief Changes, collected by a single poll, before being exported into an arena.
+ */
+struct changes_batch_t {
+    std::vector<ustore_collection_t> collections;
+    std::vector<ustore_key_t> keys;
+    std::vector<ustore_sequence_number_t> sequences;
+    std::vector<ustore_length_t> lengths;
+    std::string values;
+
+    std::size_t size() const noexcept { return keys.size(); }
+
+    void push_back(collection_key_t key, ustore_sequence_number_t sequence, value_view_t value) noexcept(false) {
+        collections.push_back(key.collection);
+        keys.push_back(key.key);
+        sequences.push_back(sequence);
+        lengths.push_back(value ? static_cast<ustore_length_t>(value.size()) : ustore_length_missing_k);
+        values.append(value.c_str(), value.size());
+    }
+};
+
+/**
+ * @brief Exports the @p batch into the outputs of a poll request.
+ */
+inline void export_changes(changes_batch_t const& batch,
+                           linked_memory_lock_t& arena,
+                           ustore_changes_poll_t& c) noexcept {
+
+    std::size_t count = batch.size();
+    auto collections = arena.alloc_or_dummy(count, c.error, c.collections);
+    return_if_error_m(c.error);
+    auto keys = arena.alloc_or_dummy(count, c.error, c.keys);
+    return_if_error_m(c.error);
+    auto sequences = arena.alloc_or_dummy(count, c.error, c.sequences);
+    return_if_error_m(c.error);
+    auto presences = arena.alloc_or_dummy(count, c.error, c.presences);
+    return_if_error_m(c.error);
+    auto offsets = arena.alloc_or_dummy(count + 1, c.error, c.offsets);
+    return_if_error_m(c.error);
+    auto lengths = arena.alloc_or_dummy(count, c.error, c.lengths);
+    return_if_error_m(c.error);
+
+    ustore_length_t offset = 0;
+    for (std::size_t i = 0; i != count; ++i) {
+        ustore_length_t length = batch.lengths[i];
+        collections[i] = batch.collections[i];
+        keys[i] = batch.keys[i];
+        sequences[i] = batch.sequences[i];
+        presences[i] = length != ustore_length_missing_k;
+        offsets[i] = offset;
+        lengths[i] = length;
+        offset += length != ustore_length_missing_k ? length : 0;
+    }
+    offsets[count] = offset;
+
+    if (c.values) {
+        auto values = arena.alloc<byte_t>(batch.values.size(), c.error);
+        return_if_error_m(c.error);
+        if (batch.values.size())
+            std::memcpy(values.begin(), batch.values.data(), batch.values.size());
+        *c.values = reinterpret_cast<ustore_bytes_ptr_t>(values.begin());
+    }
+    if (c.count)
+        *c.count = static_cast<ustore_size_t>(count);
+}
+
+class change_log_t {
+  public:
+    /**
+     * @brief Position of a reader. Zero `segment` means the oldest retained one.
+     */
+    struct cursor_t {
+        ustore_sequence_number_t next = 1;
+        ustore_sequence_number_t segment = 0;
+        std::size_t offset = 0;
+    };
+
+  private:
+    struct segment_t {
+        ustore_sequence_number_t first = 0;
+        std::string path;
+        std::size_t size = 0;
+    };
+
+    static constexpr std::size_t segment_size_k = 64ul * 1024ul * 1024ul;
+    static constexpr char const* extension_k = ".changes";
+
+    std::mutex mutex_;
+    std::string directory_;
+    std::size_t retention_ = 0;
+    std::vector<segment_t> segments_;
+    write_ahead_log_t log_;
+    ustore_sequence_number_t last_ = 0;
+    std::string record_;
+
+    std::string segment_path(ustore_sequence_number_t first) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016zu%s", static_cast<std::size_t>(first), extension_k);
+        return std::filesystem::path(directory_) / name;
+    }
+
+    std::size_t segment_limit() const noexcept {
+        return std::min(std::max<std::size_t>(retention_ / 4, 1ul << 20), segment_size_k);
+    }
+
+    /**
+     * @brief Passes every entry of a serialized @p record to @p callback.
+     * @return `false` if the record is malformed.
+     */
+    template <typename callback_at>
+    static bool parse(value_view_t record, callback_at&& callback) noexcept {
+        byte_t const* begin = record.begin();
+        byte_t const* end = record.end();
+        auto pop = [&](auto& scalar) {
+            if (static_cast<std::size_t>(end - begin) < sizeof(scalar))
+                return false;
+            std::memcpy(&scalar, begin, sizeof(scalar));
+            begin += sizeof(scalar);
+            return true;
+        };
+
+        ustore_sequence_number_t first = 0;
+        std::uint32_t count = 0;
+        if (!pop(first) || !pop(count))
+            return false;
+        for (std::uint32_t i = 0; i != count; ++i) {
+            collection_key_t key;
+            ustore_length_t length;
+            if (!pop(key.collection) || !pop(key.key) || !pop(length))
+                return false;
+            value_view_t value;
+            if (length != ustore_length_missing_k) {
+                if (static_cast<std::size_t>(end - begin) < length)
+                    return false;
+                value = value_view_t {begin, length};
+                begin += length;
+            }
+            if (!callback(first + i, key, value))
+                return true;
+        }
+        return begin == end;
+    }
+
+    /// @brief Must be called under `mutex_`.
+    status_t start_segment() noexcept {
+        auto status = log_.close();
+        if (!status)
+            return status;
+        try {
+            segment_t segment;
+            segment.first = last_ + 1;
+            segment.path = segment_path(segment.first);
+            status = log_.open(segment.path.c_str());
+            if (!status)
+                return status;
+            segments_.push_back(std::move(segment));
+        }
+        catch (...) {
+            return "Failed to start a new change-log segment";
+        }
+        return {};
+    }
+
+    /// @brief Removes the oldest segments past the retention. Must be called under `mutex_`.
+    void trim() noexcept {
+        std::size_t total = 0;
+        for (segment_t const& segment : segments_)
+            total += segment.size;
+        std::size_t removed = 0;
+        while (segments_.size() - removed > 1 && total > retention_) {
+            total -= segments_[removed].size;
+            ::unlink(segments_[removed].path.c_str());
+            ++removed;
+        }
+        segments_.erase(segments_.begin(), segments_.begin() + removed);
+    }
+
+  public:
+    bool is_open() const noexcept { return log_.is_open(); }
+
+    /**
+     * @brief Orders the appends. Must be held while the logged changes are applied.
+     */
+    std::mutex& mutex() noexcept { return mutex_; }
+
+    /**
+     * @brief Serializes a single entry for `append()`.
+     */
+    static void serialize(std::string& entries, collection_key_t key, value_view_t value) noexcept(false) {
+        ustore_length_t length = value ? static_cast<ustore_length_t>(value.size()) : ustore_length_missing_k;
+        entries.append(reinterpret_cast<char const*>(&key.collection), sizeof(key.collection));
+        entries.append(reinterpret_cast<char const*>(&key.key), sizeof(key.key));
+        entries.append(reinterpret_cast<char const*>(&length), sizeof(length));
+        entries.append(value.c_str(), value.size());
+    }
+
+    /**
+     * @brief Recovers the segments in the @p directory, or creates the first one.
+     */
+    status_t open(std::string const& directory, change_feed_config_t const& config) noexcept {
+        std::unique_lock lock {mutex_};
+        if (log_.is_open())
+            return "Change-log is already opened";
+
+        try {
+            directory_ = directory;
+            retention_ = config.retention;
+            std::filesystem::create_directories(directory_);
+
+            std::string_view extension {extension_k};
+            for (auto const& dir_entry : std::filesystem::directory_iterator {directory_}) {
+                std::string file_name = dir_entry.path().filename();
+                if (file_name.size() <= extension.size() ||
+                    file_name.compare(file_name.size() - extension.size(), extension.size(), extension) != 0)
+                    continue;
+                char* parsed_end = nullptr;
+                segment_t segment;
+                segment.first = std::strtoull(file_name.c_str(), &parsed_end, 10);
+                if (parsed_end != file_name.c_str() + file_name.size() - extension.size() || !segment.first)
+                    continue;
+                segment.path = dir_entry.path();
+                segment.size = static_cast<std::size_t>(std::filesystem::file_size(dir_entry.path()));
+                segments_.push_back(std::move(segment));
+            }
+            std::sort(segments_.begin(), segments_.end(), [](segment_t const& a, segment_t const& b) {
+                return a.first < b.first;
+            });
+        }
+        catch (...) {
+            return "Failed to list change-log segments";
+        }
+
+        if (segments_.empty())
+            return start_segment();
+
+        // The tail of the last segment may have been torn by a crash
+        segment_t& last = segments_.back();
+        std::size_t valid_size = 0;
+        last_ = last.first - 1;
+        auto status = write_ahead_log_t::replay(last.path.c_str(), valid_size, [&](value_view_t record) {
+            ustore_sequence_number_t record_last = last_;
+            bool valid = parse(record, [&](ustore_sequence_number_t sequence, collection_key_t, value_view_t) {
+                record_last = sequence;
+                return true;
+            });
+            if (valid)
+                last_ = record_last;
+            return valid;
+        });
+        if (!status)
+            return status;
+        if (valid_size != last.size && ::truncate(last.path.c_str(), static_cast<off_t>(valid_size)) != 0)
+            return "Failed to truncate the torn change-log tail";
+        last.size = valid_size;
+
+        status = log_.open(last.path.c_str());
+        if (!status)
+            return status;
+        trim();
+        return {};
+    }
+
+    /**
+     * @brief Logs a batch of @p count entries, serialized with `serialize()`.
+     * Must be called under `mutex()`, after the changes were applied.
+     * @param flush Waits for the record to reach persistent memory.
+     */
+    status_t append(std::string_view entries, std::size_t count, bool flush) noexcept {
+        if (!count)
+            return {};
+
+        ustore_sequence_number_t first = last_ + 1;
+        auto count_u32 = static_cast<std::uint32_t>(count);
+        try {
+            record_.clear();
+            record_.append(reinterpret_cast<char const*>(&first), sizeof(first));
+            record_.append(reinterpret_cast<char const*>(&count_u32), sizeof(count_u32));
+            record_.append(entries);
+        }
+        catch (...) {
+            return "Failed to allocate a change-log record";
+        }
+
+        std::size_t old_size = log_.size();
+        auto status = log_.append(std::string_view(record_));
+        if (!status)
+            return status;
+        last_ += count;
+        segments_.back().size += log_.size() - old_size;
+        if (flush) {
+            status = log_.sync();
+            if (!status)
+                return status;
+        }
+
+        if (log_.size() < segment_limit())
+            return {};
+        status = log_.sync();
+        if (!status)
+            return status;
+        status = start_segment();
+        trim();
+        return status;
+    }
+
+    /// @brief The sequence number of the last logged change. Must be called under `mutex()`.
+    ustore_sequence_number_t last() const noexcept { return last_; }
+
+    /**
+     * @brief Positions the @p cursor right after the @p since sequence number.
+     * Zero @p since starts from the oldest retained change.
+     */
+    status_t seek(ustore_sequence_number_t since, cursor_t& cursor) noexcept {
+        std::unique_lock lock {mutex_};
+        cursor = {};
+        cursor.next = since + 1;
+        if (!since)
+            return {};
+
+        auto it = std::find_if(segments_.rbegin(), segments_.rend(), [&](segment_t const& segment) {
+            return segment.first <= cursor.next;
+        });
+        if (it == segments_.rend())
+            return "Requested changes are no longer retained";
+        cursor.segment = it->first;
+        return {};
+    }
+
+    /**
+     * @brief Collects up to @p limit changes after the @p cursor, advancing it.
+     */
+    status_t read(cursor_t& cursor, std::size_t limit, changes_batch_t& batch) noexcept {
+        std::vector<segment_t> segments;
+        {
+            std::unique_lock lock {mutex_};
+            try {
+                segments = segments_;
+            }
+            catch (...) {
+                return "Failed to list change-log segments";
+            }
+        }
+
+        auto it = cursor.segment //
+                      ? std::find_if(segments.begin(),
+                                     segments.end(),
+                                     [&](segment_t const& segment) { return segment.first == cursor.segment; })
+                      : segments.begin();
+        if (it == segments.end())
+            return "Requested changes are no longer retained";
+        cursor.segment = it->first;
+
+        bool failed = false;
+        while (batch.size() < limit) {
+            auto status = write_ahead_log_t::replay(it->path.c_str(), cursor.offset, [&](value_view_t record) {
+                bool fits = true;
+                auto export_change = [&](ustore_sequence_number_t sequence, collection_key_t key, value_view_t value) {
+                    if (sequence < cursor.next)
+                        return true;
+                    if (batch.size() == limit)
+                        return fits = false;
+                    try {
+                        batch.push_back(key, sequence, value);
+                    }
+                    catch (...) {
+                        return fits = !(failed = true);
+                    }
+                    cursor.next = sequence + 1;
+                    return true;
+                };
+                bool valid = parse(record, export_change);
+                // The record is only consumed, if all of its entries were exported
+                return valid && fits;
+            });
+            if (failed)
+                return "Failed to allocate memory for changes";
+            if (!status)
+                return "Requested changes are no longer retained";
+
+            // Only the segments, that have a successor, are complete
+            if (batch.size() == limit || ++it == segments.end())
+                break;
+            cursor.segment = it->first;
+            cursor.offset = 0;
+        }
+        return {};
+    }
+};
+
+} // namespace unum::ustore
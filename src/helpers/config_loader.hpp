@@ -75,13 +75,18 @@ class config_loader_t {
     static inline status_t save_to_json(config_t const& config, json_t& json);
     static inline status_t save_to_json_string(config_t const& config, std::string& str_json);
 
+    /**
+     * @brief Parses a volume, either a number of bytes or a string like "8GB".
+     * Leaves @p bytes untouched, if the @p key is missing.
+     */
+    static inline bool parse_volume(json_t const& json, std::string const& key, size_t& bytes) noexcept;
+    static inline bool parse_bytes(std::string const& str, size_t& bytes) noexcept;
+
   private:
     static inline std::string current_version() noexcept;
     static inline status_t validate_config(json_t const& json) noexcept;
 
     static inline bool parse_version(std::string const& str_version, uint8_t& major, uint8_t& minor) noexcept;
-    static inline bool parse_volume(json_t const& json, std::string const& key, size_t& bytes) noexcept;
-    static inline bool parse_bytes(std::string const& str, size_t& bytes) noexcept;
 };
 
 inline status_t config_loader_t::load_from_json(json_t const& json, config_t& config) {
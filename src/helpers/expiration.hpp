@@ -0,0 +1,170 @@
+/**
+ * @file expiration.hpp
+ * @author Ashot Vardanian
+ *
+ * @brief Per-collection time-to-live of values, shared by the engines, that support it.
+ *
+ * Every value, written into an expiring collection, gets a deadline, measured in whole
+ * seconds since the Unix epoch. Engines hide the values past their deadlines from reads
+ * and scans, and remove them in background, so the expired values can linger in samples
+ * and measurements for a while. Engines, that can't store metadata beside the values,
+ * append the deadline to the value itself, as 4 little-endian bytes.
+ *
+ * ## Configuration
+ *
+ * Is loaded from the "ttl" section of the engine config:
+ * @code{.json}
+ * "ttl": {
+ *     "collections": {"events": "7d", "": 3600}, // Lifetimes in seconds, or with a "s", "m", "h" or "d" suffix
+ *     "sweep_interval": "1m" // How often the engines without compactions remove the expired values
+ * }
+ * @endcode
+ * Collections, that aren't listed, never expire.
+ * The main collection has an empty name.
+ */
+#pragma once
+#include <chrono>        // `std::chrono::system_clock`
+#include <cstdint>       // `std::uint32_t`
+#include <cstring>       // `std::memcpy`
+#include <limits>        // `std::numeric_limits`
+#include <string>        // `std::string`
+#include <unordered_map> // `std::unordered_map`
+
+#include <nlohmann/json.hpp> // `nlohmann::json`
+
+#include "ustore/cpp/types.hpp" // `value_view_t`
+
+namespace unum::ustore {
+
+/**
+ * @brief Seconds since the Unix epoch, where zero means "never".
+ */
+using expiration_time_t = std::uint32_t;
+
+inline expiration_time_t expiration_now() noexcept {
+    auto since_epoch = std::chrono::system_clock::now().time_since_epoch();
+    return static_cast<expiration_time_t>(std::chrono::duration_cast<std::chrono::seconds>(since_epoch).count());
+}
+
+inline bool is_expired(expiration_time_t deadline, expiration_time_t now) noexcept {
+    return deadline && deadline <= now;
+}
+
+struct expiration_config_t {
+    std::unordered_map<std::string, expiration_time_t> collections;
+    expiration_time_t sweep_interval = 60;
+
+    expiration_time_t ttl_for(std::string const& name) const noexcept {
+        auto it = collections.find(name);
+        return it != collections.end() ? it->second : 0;
+    }
+
+    bool enabled() const noexcept { return !collections.empty(); }
+
+    /**
+     * @brief Parses durations, either as plain numbers of seconds, or strings like "7d".
+     * @return `false` if the duration is malformed or zero.
+     */
+    static bool parse_duration(nlohmann::json const& json, expiration_time_t& seconds) noexcept {
+        try {
+            std::uint64_t count = 0;
+            if (json.is_number_unsigned())
+                count = json.get<std::uint64_t>();
+            else if (json.is_string()) {
+                std::string const str = json.get<std::string>();
+                std::size_t suffix_offset = 0;
+                count = std::stoull(str, &suffix_offset);
+                std::string const suffix = str.substr(suffix_offset);
+                if (suffix == "m")
+                    count *= 60;
+                else if (suffix == "h")
+                    count *= 60 * 60;
+                else if (suffix == "d")
+                    count *= 24 * 60 * 60;
+                else if (!suffix.empty() && suffix != "s")
+                    return false;
+            }
+            else
+                return false;
+            if (!count || count > std::numeric_limits<expiration_time_t>::max())
+                return false;
+            seconds = static_cast<expiration_time_t>(count);
+            return true;
+        }
+        catch (...) {
+            return false;
+        }
+    }
+
+    /**
+     * @brief Parses the @p engine_config, where the section may be missing.
+     * @return `false` if the section is malformed.
+     */
+    static bool parse(nlohmann::json const& engine_config, expiration_config_t& result) noexcept {
+        result = {};
+        if (!engine_config.is_object() || !engine_config.contains("ttl"))
+            return true;
+
+        auto const& section = engine_config["ttl"];
+        if (!section.is_object())
+            return false;
+        if (section.contains("sweep_interval") && !parse_duration(section["sweep_interval"], result.sweep_interval))
+            return false;
+        if (!section.contains("collections"))
+            return true;
+
+        auto const& collections = section["collections"];
+        if (!collections.is_object())
+            return false;
+        try {
+            for (auto it = collections.begin(); it != collections.end(); ++it) {
+                expiration_time_t ttl = 0;
+                if (!parse_duration(it.value(), ttl))
+                    return false;
+                result.collections[it.key()] = ttl;
+            }
+        }
+        catch (...) {
+            return false;
+        }
+        return true;
+    }
+};
+
+constexpr std::size_t deadline_length_k = sizeof(expiration_time_t);
+
+/**
+ * @brief Appends the @p deadline to a copy of the @p value in the @p buffer.
+ * Missing values stay missing.
+ */
+inline value_view_t append_deadline(value_view_t value,
+                                    expiration_time_t deadline,
+                                    std::string& buffer) noexcept(false) {
+    if (!value)
+        return value;
+    buffer.resize(value.size() + deadline_length_k);
+    if (value.size())
+        std::memcpy(buffer.data(), value.data(), value.size());
+    std::memcpy(buffer.data() + value.size(), &deadline, deadline_length_k);
+    return value_view_t {buffer.data(), buffer.size()};
+}
+
+/**
+ * @brief Extracts the deadline from a value, previously passed through `append_deadline()`.
+ * Values, that are too short to hold it, are considered expired.
+ */
+inline expiration_time_t deadline_of(value_view_t stamped) noexcept {
+    if (stamped.size() < deadline_length_k)
+        return 1;
+    expiration_time_t deadline;
+    std::memcpy(&deadline, stamped.data() + stamped.size() - deadline_length_k, deadline_length_k);
+    return deadline;
+}
+
+inline value_view_t strip_deadline(value_view_t stamped) noexcept {
+    if (!stamped || stamped.size() < deadline_length_k)
+        return stamped;
+    return value_view_t {stamped.data(), stamped.size() - deadline_length_k};
+}
+
+} // namespace unum::ustore
@@ -6,6 +6,7 @@
  */
 #pragma once
 #include <random>
+#include <vector>
 
 #include "ustore/blobs.h"
 
@@ -24,9 +25,12 @@ void full_scan_collection( //
     callback_should_continue_at&& callback_should_continue) noexcept {
 
     read_ahead = std::max<ustore_length_t>(read_ahead, 2u);
+    options = ustore_options_t(options | ustore_option_scan_sequential_k);
     while (!*error) {
         ustore_length_t* found_blobs_count {};
         ustore_key_t* found_blobs_keys {};
+        ustore_length_t* found_blobs_offsets {};
+        ustore_byte_t* found_blobs_data {};
         ustore_scan_t scan {};
         scan.db = db;
         scan.error = error;
@@ -39,15 +43,139 @@ void full_scan_collection( //
         scan.count_limits = &read_ahead;
         scan.counts = &found_blobs_count;
         scan.keys = &found_blobs_keys;
+        scan.values_offsets = &found_blobs_offsets;
+        scan.values = &found_blobs_data;
 
         ustore_scan(&scan);
         if (*error)
             break;
 
-        if (found_blobs_count[0] <= 1)
+        if (!found_blobs_count[0])
             // We have reached the end of collection
             break;
 
+        ustore_length_t const count_blobs = found_blobs_count[0];
+        joined_blobs_iterator_t found_blobs {found_blobs_offsets, found_blobs_data};
+        for (std::size_t i = 0; i != count_blobs; ++i, ++found_blobs) {
+            value_view_t bucket = *found_blobs;
+            if (!callback_should_continue(found_blobs_keys[i], bucket))
+                return;
+        }
+
+        start_key = found_blobs_keys[count_blobs - 1] + 1;
+    }
+}
+
+/**
+ * @brief Full-scan, that splits `[min_key, max_key]` into @p shards_count equal
+ * sub-ranges and pages through all of them at once. Every round is a single
+ * `ustore_scan()` with `ustore_option_scan_bulk_k`, so the shards are scanned
+ * concurrently, followed by a single `ustore_read()` of everything found.
+ * The @p callback_should_continue receives entries in no particular order.
+ *
+ * The @p arena is only released between the rounds, if the caller doesn't hold
+ * its lock. Passing a dedicated arena keeps the memory usage bounded by a round.
+ */
+template <typename callback_should_continue_at>
+void bulk_scan_collection( //
+    ustore_database_t db,
+    ustore_transaction_t transaction,
+    ustore_collection_t collection,
+    ustore_options_t options,
+    ustore_key_t min_key,
+    ustore_key_t max_key,
+    std::size_t shards_count,
+    ustore_length_t read_ahead,
+    ustore_arena_t* arena,
+    ustore_error_t* error,
+    callback_should_continue_at&& callback_should_continue) noexcept {
+
+    struct shard_t {
+        ustore_key_t next_key;
+        ustore_key_t max_key;
+    };
+
+    std::vector<shard_t> shards;
+    std::vector<ustore_key_t> start_keys;
+    std::vector<ustore_key_t> end_keys;
+    std::vector<ustore_key_t> batch_keys;
+    safe_section("Splitting into shards", error, [&] {
+        shards_count = std::max<std::size_t>(shards_count, 1u);
+        auto span = static_cast<std::uint64_t>(max_key) - static_cast<std::uint64_t>(min_key);
+        auto shard_span = std::max<std::uint64_t>(span / shards_count, 1u);
+        for (std::size_t i = 0; i != shards_count; ++i) {
+            auto begin = static_cast<std::uint64_t>(min_key) + shard_span * i;
+            auto end = i + 1 == shards_count ? static_cast<std::uint64_t>(max_key) : begin + shard_span - 1;
+            shards.push_back({static_cast<ustore_key_t>(begin), static_cast<ustore_key_t>(end)});
+            if (end == static_cast<std::uint64_t>(max_key))
+                break;
+        }
+        start_keys.reserve(shards.size());
+        end_keys.reserve(shards.size());
+        batch_keys.reserve(shards.size() * read_ahead);
+    });
+    read_ahead = std::max<ustore_length_t>(read_ahead, 1u);
+    options = ustore_options_t(options | ustore_option_scan_bulk_k);
+
+    while (!*error && !shards.empty()) {
+        start_keys.clear();
+        end_keys.clear();
+        for (shard_t const& shard : shards) {
+            start_keys.push_back(shard.next_key);
+            end_keys.push_back(shard.max_key == std::numeric_limits<ustore_key_t>::max() ? shard.max_key
+                                                                                        : shard.max_key + 1);
+        }
+
+        ustore_length_t* found_offsets {};
+        ustore_length_t* found_counts {};
+        ustore_key_t* found_keys {};
+        ustore_scan_t scan {};
+        scan.db = db;
+        scan.error = error;
+        scan.transaction = transaction;
+        scan.arena = arena;
+        scan.options = options;
+        scan.tasks_count = shards.size();
+        scan.collections = &collection;
+        scan.start_keys = start_keys.data();
+        scan.start_keys_stride = sizeof(ustore_key_t);
+        scan.end_keys = end_keys.data();
+        scan.end_keys_stride = sizeof(ustore_key_t);
+        scan.count_limits = &read_ahead;
+        scan.offsets = &found_offsets;
+        scan.counts = &found_counts;
+        scan.keys = &found_keys;
+
+        ustore_scan(&scan);
+        if (*error)
+            break;
+
+        // Drop the keys past the end of every shard, and the shards, that are done
+        batch_keys.clear();
+        std::size_t remaining_shards = 0;
+        for (std::size_t i = 0; i != shards.size(); ++i) {
+            shard_t shard = shards[i];
+            ustore_key_t const* shard_keys = found_keys + found_offsets[i];
+            ustore_length_t shard_count = found_counts[i];
+            bool is_done = shard_count < read_ahead;
+            for (ustore_length_t j = 0; j != shard_count; ++j) {
+                if (shard_keys[j] > shard.max_key) {
+                    is_done = true;
+                    break;
+                }
+                batch_keys.push_back(shard_keys[j]);
+            }
+            if (shard_count && !is_done) {
+                is_done = shard_keys[shard_count - 1] == shard.max_key;
+                shard.next_key = shard_keys[shard_count - 1] + 1;
+            }
+            if (!is_done)
+                shards[remaining_shards++] = shard;
+        }
+        shards.resize(remaining_shards);
+        if (batch_keys.empty())
+            continue;
+
         ustore_length_t* found_blobs_offsets {};
         ustore_byte_t* found_blobs_data {};
         ustore_read_t read {};
@@ -56,10 +184,10 @@ void full_scan_collection( //
         read.transaction = transaction;
         read.arena = arena;
         read.options = ustore_options_t(options | ustore_option_dont_discard_memory_k);
-        read.tasks_count = found_blobs_count[0];
+        read.tasks_count = batch_keys.size();
         read.collections = &collection;
         read.collections_stride = 0;
-        read.keys = found_blobs_keys;
+        read.keys = batch_keys.data();
         read.keys_stride = sizeof(ustore_key_t);
         read.offsets = &found_blobs_offsets;
         read.values = &found_blobs_data;
@@ -68,15 +196,12 @@ void full_scan_collection( //
         if (*error)
             break;
 
-        ustore_length_t const count_blobs = found_blobs_count[0];
         joined_blobs_iterator_t found_blobs {found_blobs_offsets, found_blobs_data};
-        for (std::size_t i = 0; i != count_blobs; ++i, ++found_blobs) {
+        for (std::size_t i = 0; i != batch_keys.size(); ++i, ++found_blobs) {
             value_view_t bucket = *found_blobs;
-            if (!callback_should_continue(found_blobs_keys[i], bucket))
+            if (!callback_should_continue(batch_keys[i], bucket))
                 return;
         }
-
-        start_key = found_blobs_keys[count_blobs - 1] + 1;
     }
 }
 
@@ -91,7 +216,6 @@ void reservoir_sample_iterator(level_or_rocks_iterator_at&& iterator,
 
     std::random_device random_device;
     std::mt19937 random_generator(random_device());
-    std::uniform_int_distribution<ustore_key_t> dist(std::numeric_limits<ustore_key_t>::min());
 
     std::size_t i = 0;
     for (iterator->SeekToFirst(); i < sampled_keys.size(); ++i, iterator->Next()) {
@@ -99,8 +223,10 @@ void reservoir_sample_iterator(level_or_rocks_iterator_at&& iterator,
         std::memcpy(&sampled_keys[i], iterator->key().data(), sizeof(ustore_key_t));
     }
 
+    // The slot is drawn from the positions, rather than the keys,
+    // as there is no distribution over the 128-bit keys of UUID builds
     for (std::size_t j = 0; iterator->Valid(); ++i, iterator->Next()) {
-        j = dist(random_generator) % (i + 1);
+        j = std::uniform_int_distribution<std::size_t>(0, i)(random_generator);
         if (j < sampled_keys.size())
             std::memcpy(&sampled_keys[j], iterator->key().data(), sizeof(ustore_key_t));
     }
@@ -0,0 +1,515 @@
+/**
+ * @file graph_algorithms.hpp
+ * @author Ashot Vardanian
+ *
+ * @brief Whole-graph kernels over Compressed Sparse Row snapshots.
+ *
+ * Vertices are addressed by their dense indexes in the snapshot, so all of the state
+ * lives in flat arrays, rather than hash-maps keyed by vertex IDs. Kernels split the
+ * vertices into fixed-size chunks and spread those across threads with `parallel_for`.
+ * The only exception is the local moving phase of Louvain, which is sequential to
+ * stay deterministic, while the graph construction and aggregation around it are not.
+ */
+#pragma once
+#include <algorithm> // `std::sort`
+#include <atomic>    // `std::atomic`
+#include <cmath>     // `std::abs`
+#include <limits>    // `std::numeric_limits`
+#include <utility>   // `std::pair`
+#include <vector>    // `std::vector`
+
+#include "ustore/graph.h"
+#include "ustore/cpp/types.hpp" // `divide_round_up`
+#include "helpers/parallel.hpp" // `parallel_for`
+
+namespace unum::ustore {
+
+constexpr std::size_t graph_chunk_k = 16 * 1024;
+constexpr ustore_size_t graph_unreachable_k = std::numeric_limits<ustore_size_t>::max();
+
+/**
+ * @brief Calls @p callback with every `[begin, end)` chunk of `[0, count)`, in parallel.
+ */
+template <typename callback_at>
+void parallel_for_chunks(std::size_t count, callback_at&& callback) noexcept(false) {
+    parallel_for(divide_round_up(count, graph_chunk_k), [&](std::size_t chunk_idx) {
+        std::size_t begin = chunk_idx * graph_chunk_k;
+        callback(chunk_idx, begin, std::min(begin + graph_chunk_k, count));
+    });
+}
+
+/**
+ * @brief Sums the outputs of @p callback for every `[begin, end)` chunk of `[0, count)`.
+ */
+template <typename callback_at>
+double parallel_sum(std::size_t count, callback_at&& callback) noexcept(false) {
+    std::vector<double> partial_sums(divide_round_up(count, graph_chunk_k));
+    parallel_for_chunks(count, [&](std::size_t chunk_idx, std::size_t begin, std::size_t end) {
+        partial_sums[chunk_idx] = callback(begin, end);
+    });
+    double sum = 0;
+    for (double partial_sum : partial_sums)
+        sum += partial_sum;
+    return sum;
+}
+
+inline std::size_t csr_degree(ustore_graph_csr_t const& csr, std::size_t vertex_idx) noexcept {
+    return csr.offsets[vertex_idx + 1] - csr.offsets[vertex_idx];
+}
+
+/**
+ * @brief Adjacency with reversed relations. The neighbors of every vertex aren't sorted.
+ */
+struct csr_transposed_t {
+    std::vector<ustore_size_t> offsets;
+    std::vector<ustore_size_t> neighbors;
+    /// @brief Weights of the reversed edges, if the @p csr has any.
+    std::vector<ustore_float_t> weights;
+
+    explicit csr_transposed_t(ustore_graph_csr_t const& csr) noexcept(false)
+        : offsets(csr.vertices_count + 1), neighbors(csr.edges_count), weights(csr.weights ? csr.edges_count : 0) {
+
+        std::vector<std::atomic<ustore_size_t>> cursors(csr.vertices_count);
+        parallel_for_chunks(csr.vertices_count, [&](std::size_t, std::size_t begin, std::size_t end) {
+            for (std::size_t i = csr.offsets[begin]; i != csr.offsets[end]; ++i)
+                cursors[csr.neighbors[i]].fetch_add(1, std::memory_order_relaxed);
+        });
+        for (std::size_t vertex_idx = 0; vertex_idx != csr.vertices_count; ++vertex_idx) {
+            offsets[vertex_idx + 1] = offsets[vertex_idx] + cursors[vertex_idx].load(std::memory_order_relaxed);
+            cursors[vertex_idx].store(offsets[vertex_idx], std::memory_order_relaxed);
+        }
+        parallel_for_chunks(csr.vertices_count, [&](std::size_t, std::size_t begin, std::size_t end) {
+            for (std::size_t vertex_idx = begin; vertex_idx != end; ++vertex_idx)
+                for (std::size_t i = csr.offsets[vertex_idx]; i != csr.offsets[vertex_idx + 1]; ++i) {
+                    std::size_t slot = cursors[csr.neighbors[i]].fetch_add(1, std::memory_order_relaxed);
+                    neighbors[slot] = vertex_idx;
+                    if (csr.weights)
+                        weights[slot] = csr.weights[i];
+                }
+        });
+    }
+};
+
+/**
+ * @brief Pull-based PageRank, treating dangling vertices as linked to every vertex.
+ * @return Number of performed iterations.
+ */
+inline std::size_t pagerank(ustore_graph_csr_t const& csr,
+                            double damping,
+                            double tolerance,
+                            std::size_t iterations_limit,
+                            std::vector<double>& ranks) noexcept(false) {
+
+    std::size_t count = csr.vertices_count;
+    ranks.assign(count, count ? 1.0 / count : 0.0);
+    if (!count)
+        return 0;
+
+    csr_transposed_t incoming {csr};
+    std::vector<double> contributions(count);
+    std::vector<double> next_ranks(count);
+    std::size_t iteration = 0;
+    while (iteration != iterations_limit) {
+        ++iteration;
+        double dangling = parallel_sum(count, [&](std::size_t begin, std::size_t end) {
+            double sum = 0;
+            for (std::size_t vertex_idx = begin; vertex_idx != end; ++vertex_idx) {
+                std::size_t degree = csr_degree(csr, vertex_idx);
+                contributions[vertex_idx] = degree ? ranks[vertex_idx] / degree : 0;
+                sum += degree ? 0 : ranks[vertex_idx];
+            }
+            return sum;
+        });
+
+        double base = (1.0 - damping + damping * dangling) / count;
+        double change = parallel_sum(count, [&](std::size_t begin, std::size_t end) {
+            double sum = 0;
+            for (std::size_t vertex_idx = begin; vertex_idx != end; ++vertex_idx) {
+                double rank = 0;
+                for (std::size_t i = incoming.offsets[vertex_idx]; i != incoming.offsets[vertex_idx + 1]; ++i)
+                    rank += contributions[incoming.neighbors[i]];
+                next_ranks[vertex_idx] = base + damping * rank;
+                sum += std::abs(next_ranks[vertex_idx] - ranks[vertex_idx]);
+            }
+            return sum;
+        });
+
+        std::swap(ranks, next_ranks);
+        if (change < tolerance)
+            break;
+    }
+    return iteration;
+}
+
+/**
+ * @brief Lock-free Union-Find over all relations, ignoring their direction.
+ * Roots are always attached to smaller roots, so every component ends up
+ * labeled with the smallest index of its members.
+ */
+inline void connected_components(ustore_graph_csr_t const& csr, std::vector<ustore_size_t>& roots) noexcept(false) {
+
+    std::size_t count = csr.vertices_count;
+    std::vector<std::atomic<ustore_size_t>> parents(count);
+    parallel_for_chunks(count, [&](std::size_t, std::size_t begin, std::size_t end) {
+        for (std::size_t vertex_idx = begin; vertex_idx != end; ++vertex_idx)
+            parents[vertex_idx].store(vertex_idx, std::memory_order_relaxed);
+    });
+
+    // Path halving is a benign race, as it only ever shortcuts to an ancestor
+    auto find = [&](ustore_size_t idx) noexcept {
+        while (true) {
+            ustore_size_t parent = parents[idx].load(std::memory_order_relaxed);
+            if (parent == idx)
+                return idx;
+            ustore_size_t grandparent = parents[parent].load(std::memory_order_relaxed);
+            if (grandparent != parent)
+                parents[idx].compare_exchange_weak(parent, grandparent, std::memory_order_relaxed);
+            idx = grandparent;
+        }
+    };
+    auto unite = [&](ustore_size_t a, ustore_size_t b) noexcept {
+        while (true) {
+            a = find(a), b = find(b);
+            if (a == b)
+                return;
+            if (a < b)
+                std::swap(a, b);
+            ustore_size_t expected = a;
+            if (parents[a].compare_exchange_strong(expected, b, std::memory_order_relaxed))
+                return;
+        }
+    };
+
+    parallel_for_chunks(count, [&](std::size_t, std::size_t begin, std::size_t end) {
+        for (std::size_t vertex_idx = begin; vertex_idx != end; ++vertex_idx)
+            for (std::size_t i = csr.offsets[vertex_idx]; i != csr.offsets[vertex_idx + 1]; ++i)
+                unite(vertex_idx, csr.neighbors[i]);
+    });
+
+    roots.resize(count);
+    parallel_for_chunks(count, [&](std::size_t, std::size_t begin, std::size_t end) {
+        for (std::size_t vertex_idx = begin; vertex_idx != end; ++vertex_idx)
+            roots[vertex_idx] = find(vertex_idx);
+    });
+}
+
+/**
+ * @brief Level-synchronous Breadth-First Search, following the relations of the CSR.
+ * @param levels Receives the number of hops from the closest source, or `graph_unreachable_k`.
+ */
+inline void breadth_first_levels(ustore_graph_csr_t const& csr,
+                                 std::vector<ustore_size_t> const& sources,
+                                 std::vector<ustore_size_t>& levels) noexcept(false) {
+
+    std::vector<std::atomic<ustore_size_t>> visits(csr.vertices_count);
+    for (auto& visit : visits)
+        visit.store(graph_unreachable_k, std::memory_order_relaxed);
+
+    std::vector<ustore_size_t> frontier;
+    for (ustore_size_t source : sources)
+        if (visits[source].exchange(0, std::memory_order_relaxed) == graph_unreachable_k)
+            frontier.push_back(source);
+
+    std::vector<std::vector<ustore_size_t>> discovered;
+    for (ustore_size_t level = 1; !frontier.empty(); ++level) {
+        discovered.clear();
+        discovered.resize(divide_round_up(frontier.size(), graph_chunk_k));
+        parallel_for_chunks(frontier.size(), [&](std::size_t chunk_idx, std::size_t begin, std::size_t end) {
+            for (std::size_t frontier_idx = begin; frontier_idx != end; ++frontier_idx) {
+                ustore_size_t vertex_idx = frontier[frontier_idx];
+                for (std::size_t i = csr.offsets[vertex_idx]; i != csr.offsets[vertex_idx + 1]; ++i) {
+                    ustore_size_t neighbor_idx = csr.neighbors[i];
+                    ustore_size_t expected = graph_unreachable_k;
+                    if (visits[neighbor_idx].load(std::memory_order_relaxed) == graph_unreachable_k &&
+                        visits[neighbor_idx].compare_exchange_strong(expected, level, std::memory_order_relaxed))
+                        discovered[chunk_idx].push_back(neighbor_idx);
+                }
+            }
+        });
+        frontier.clear();
+        for (auto const& chunk : discovered)
+            frontier.insert(frontier.end(), chunk.begin(), chunk.end());
+    }
+
+    levels.resize(csr.vertices_count);
+    for (std::size_t vertex_idx = 0; vertex_idx != csr.vertices_count; ++vertex_idx)
+        levels[vertex_idx] = visits[vertex_idx].load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Undirected weighted graph of the Louvain method.
+ * Self-loops live in `loops`, counting both ends of every internal relation.
+ */
+struct weighted_graph_t {
+    std::vector<ustore_size_t> offsets;
+    std::vector<ustore_size_t> neighbors;
+    std::vector<double> weights;
+    std::vector<double> loops;
+
+    std::size_t size() const noexcept { return loops.size(); }
+};
+
+/**
+ * @brief Merges the vertices of every community into one, summing the weights.
+ * @param communities Dense community index for every vertex of @p graph.
+ */
+inline weighted_graph_t aggregate(weighted_graph_t const& graph,
+                                  std::vector<ustore_size_t> const& communities,
+                                  std::size_t communities_count) noexcept(false) {
+
+    // Bucket the members of every community with a counting sort
+    std::vector<ustore_size_t> members_offsets(communities_count + 1);
+    std::vector<ustore_size_t> members(graph.size());
+    for (ustore_size_t community : communities)
+        ++members_offsets[community + 1];
+    for (std::size_t community = 0; community != communities_count; ++community)
+        members_offsets[community + 1] += members_offsets[community];
+    {
+        std::vector<ustore_size_t> cursors {members_offsets.begin(), members_offsets.end() - 1};
+        for (std::size_t vertex_idx = 0; vertex_idx != graph.size(); ++vertex_idx)
+            members[cursors[communities[vertex_idx]]++] = vertex_idx;
+    }
+
+    // Collect the merged neighborhoods per chunk, as their sizes aren't known upfront
+    using weighted_neighbor_t = std::pair<ustore_size_t, double>;
+    weighted_graph_t result;
+    result.offsets.resize(communities_count + 1);
+    result.loops.resize(communities_count);
+    std::vector<std::vector<weighted_neighbor_t>> chunks(divide_round_up(communities_count, graph_chunk_k));
+    parallel_for_chunks(communities_count, [&](std::size_t chunk_idx, std::size_t begin, std::size_t end) {
+        std::vector<weighted_neighbor_t>& chunk = chunks[chunk_idx];
+        for (std::size_t community = begin; community != end; ++community) {
+            std::size_t chunk_begin = chunk.size();
+            double loop = 0;
+            for (std::size_t j = members_offsets[community]; j != members_offsets[community + 1]; ++j) {
+                ustore_size_t member = members[j];
+                loop += graph.loops[member];
+                for (std::size_t i = graph.offsets[member]; i != graph.offsets[member + 1]; ++i) {
+                    ustore_size_t neighbor_community = communities[graph.neighbors[i]];
+                    if (neighbor_community == community)
+                        loop += graph.weights[i];
+                    else
+                        chunk.emplace_back(neighbor_community, graph.weights[i]);
+                }
+            }
+
+            auto chunk_end = chunk.end();
+            std::sort(chunk.begin() + chunk_begin, chunk_end, [](auto const& a, auto const& b) {
+                return a.first < b.first;
+            });
+            std::size_t merged_end = chunk_begin;
+            for (std::size_t i = chunk_begin; i != chunk.size(); ++i)
+                if (merged_end != chunk_begin && chunk[merged_end - 1].first == chunk[i].first)
+                    chunk[merged_end - 1].second += chunk[i].second;
+                else
+                    chunk[merged_end++] = chunk[i];
+            chunk.resize(merged_end);
+            result.loops[community] = loop;
+            result.offsets[community + 1] = merged_end - chunk_begin;
+        }
+    });
+
+    for (std::size_t community = 0; community != communities_count; ++community)
+        result.offsets[community + 1] += result.offsets[community];
+    result.neighbors.resize(result.offsets.back());
+    result.weights.resize(result.offsets.back());
+    parallel_for(chunks.size(), [&](std::size_t chunk_idx) {
+        std::size_t offset = result.offsets[chunk_idx * graph_chunk_k];
+        for (auto const& neighbor : chunks[chunk_idx])
+            result.neighbors[offset] = neighbor.first, result.weights[offset] = neighbor.second, ++offset;
+    });
+    return result;
+}
+
+/**
+ * @brief Symmetric weighted graph, where every relation of the CSR is an edge of its own weight,
+ * or of unit weight, if the CSR has none. Relations, present in both directions, like in
+ * `ustore_vertex_role_any_k` snapshots, just double all the weights, which doesn't affect the modularity.
+ */
+inline weighted_graph_t symmetrize(ustore_graph_csr_t const& csr) noexcept(false) {
+
+    std::size_t count = csr.vertices_count;
+    csr_transposed_t incoming {csr};
+    weighted_graph_t both;
+    both.offsets.resize(count + 1);
+    both.loops.resize(count);
+    for (std::size_t vertex_idx = 0; vertex_idx != count; ++vertex_idx)
+        both.offsets[vertex_idx + 1] = both.offsets[vertex_idx] + csr_degree(csr, vertex_idx) +
+                                       (incoming.offsets[vertex_idx + 1] - incoming.offsets[vertex_idx]);
+    both.neighbors.resize(both.offsets.back());
+    both.weights.assign(both.offsets.back(), 1.0);
+    parallel_for_chunks(count, [&](std::size_t, std::size_t begin, std::size_t end) {
+        for (std::size_t vertex_idx = begin; vertex_idx != end; ++vertex_idx) {
+            auto output = both.neighbors.begin() + both.offsets[vertex_idx];
+            output = std::copy(csr.neighbors + csr.offsets[vertex_idx],
+                               csr.neighbors + csr.offsets[vertex_idx + 1],
+                               output);
+            std::copy(incoming.neighbors.begin() + incoming.offsets[vertex_idx],
+                      incoming.neighbors.begin() + incoming.offsets[vertex_idx + 1],
+                      output);
+            if (!csr.weights)
+                continue;
+            auto weights = both.weights.begin() + both.offsets[vertex_idx];
+            weights = std::copy(csr.weights + csr.offsets[vertex_idx],
+                                csr.weights + csr.offsets[vertex_idx + 1],
+                                weights);
+            std::copy(incoming.weights.begin() + incoming.offsets[vertex_idx],
+                      incoming.weights.begin() + incoming.offsets[vertex_idx + 1],
+                      weights);
+        }
+    });
+
+    // Aggregating into singleton communities merges the repeated neighbors and self-loops
+    std::vector<ustore_size_t> singletons(count);
+    for (std::size_t vertex_idx = 0; vertex_idx != count; ++vertex_idx)
+        singletons[vertex_idx] = vertex_idx;
+    return aggregate(both, singletons, count);
+}
+
+inline std::vector<double> weighted_degrees(weighted_graph_t const& graph) noexcept(false) {
+    std::vector<double> degrees(graph.size());
+    parallel_for_chunks(graph.size(), [&](std::size_t, std::size_t begin, std::size_t end) {
+        for (std::size_t vertex_idx = begin; vertex_idx != end; ++vertex_idx) {
+            double degree = graph.loops[vertex_idx];
+            for (std::size_t i = graph.offsets[vertex_idx]; i != graph.offsets[vertex_idx + 1]; ++i)
+                degree += graph.weights[i];
+            degrees[vertex_idx] = degree;
+        }
+    });
+    return degrees;
+}
+
+inline double modularity(weighted_graph_t const& graph, std::vector<ustore_size_t> const& communities) noexcept(false) {
+    std::vector<double> degrees = weighted_degrees(graph);
+    std::vector<double> totals(graph.size());
+    std::vector<double> internals(graph.size());
+    double degrees_sum = 0;
+    for (std::size_t vertex_idx = 0; vertex_idx != graph.size(); ++vertex_idx) {
+        ustore_size_t community = communities[vertex_idx];
+        totals[community] += degrees[vertex_idx];
+        internals[community] += graph.loops[vertex_idx];
+        degrees_sum += degrees[vertex_idx];
+        for (std::size_t i = graph.offsets[vertex_idx]; i != graph.offsets[vertex_idx + 1]; ++i)
+            if (communities[graph.neighbors[i]] == community)
+                internals[community] += graph.weights[i];
+    }
+    if (degrees_sum == 0)
+        return 0;
+
+    double result = 0;
+    for (std::size_t community = 0; community != graph.size(); ++community) {
+        double share = totals[community] / degrees_sum;
+        result += internals[community] / degrees_sum - share * share;
+    }
+    return result;
+}
+
+/**
+ * @brief Moves vertices into the neighboring communities with the highest modularity gain,
+ * until nothing moves or the @p passes_limit is reached. Relabels communities densely.
+ * @return Number of communities, equal to the number of vertices, if nothing has moved.
+ */
+inline std::size_t louvain_local_moving(weighted_graph_t const& graph,
+                                        std::size_t passes_limit,
+                                        std::vector<ustore_size_t>& communities) noexcept(false) {
+
+    std::size_t count = graph.size();
+    std::vector<double> degrees = weighted_degrees(graph);
+    std::vector<double> totals {degrees};
+    double degrees_sum = 0;
+    for (double degree : degrees)
+        degrees_sum += degree;
+
+    communities.resize(count);
+    for (std::size_t vertex_idx = 0; vertex_idx != count; ++vertex_idx)
+        communities[vertex_idx] = vertex_idx;
+    if (degrees_sum == 0)
+        return count;
+
+    std::vector<double> weights_to(count);
+    std::vector<ustore_size_t> touched;
+    bool moved_any = false;
+    for (std::size_t pass = 0; pass != passes_limit; ++pass) {
+        bool moved = false;
+        for (std::size_t vertex_idx = 0; vertex_idx != count; ++vertex_idx) {
+            ustore_size_t current = communities[vertex_idx];
+            for (std::size_t i = graph.offsets[vertex_idx]; i != graph.offsets[vertex_idx + 1]; ++i) {
+                ustore_size_t neighbor_community = communities[graph.neighbors[i]];
+                if (weights_to[neighbor_community] == 0)
+                    touched.push_back(neighbor_community);
+                weights_to[neighbor_community] += graph.weights[i];
+            }
+
+            // Compare the gains as if the vertex was isolated first
+            double degree = degrees[vertex_idx];
+            totals[current] -= degree;
+            ustore_size_t best = current;
+            double best_gain = weights_to[current] - totals[current] * degree / degrees_sum;
+            for (ustore_size_t community : touched) {
+                double gain = weights_to[community] - totals[community] * degree / degrees_sum;
+                if (gain > best_gain)
+                    best = community, best_gain = gain;
+            }
+            totals[best] += degree;
+            if (best != current)
+                communities[vertex_idx] = best, moved = true;
+
+            for (ustore_size_t community : touched)
+                weights_to[community] = 0;
+            touched.clear();
+        }
+        moved_any |= moved;
+        if (!moved)
+            break;
+    }
+    if (!moved_any)
+        return count;
+
+    // Relabel densely, preserving the order of first appearance
+    std::vector<ustore_size_t> labels(count, graph_unreachable_k);
+    std::size_t communities_count = 0;
+    for (auto& community : communities) {
+        if (labels[community] == graph_unreachable_k)
+            labels[community] = communities_count++;
+        community = labels[community];
+    }
+    return communities_count;
+}
+
+/**
+ * @brief Multi-level Louvain method for community detection.
+ * @param partition Receives the community index of every vertex of the CSR.
+ * @return Modularity of the final partition.
+ */
+inline double louvain(ustore_graph_csr_t const& csr,
+                      double min_modularity_growth,
+                      std::size_t passes_limit,
+                      std::vector<ustore_size_t>& partition) noexcept(false) {
+
+    std::size_t count = csr.vertices_count;
+    partition.resize(count);
+    for (std::size_t vertex_idx = 0; vertex_idx != count; ++vertex_idx)
+        partition[vertex_idx] = vertex_idx;
+
+    weighted_graph_t graph = symmetrize(csr);
+    double quality = modularity(graph, partition);
+    std::vector<ustore_size_t> communities;
+    while (true) {
+        std::size_t communities_count = louvain_local_moving(graph, passes_limit, communities);
+        if (communities_count == graph.size())
+            break;
+        double new_quality = modularity(graph, communities);
+        if (new_quality - quality <= min_modularity_growth)
+            break;
+
+        parallel_for_chunks(count, [&](std::size_t, std::size_t begin, std::size_t end) {
+            for (std::size_t vertex_idx = begin; vertex_idx != end; ++vertex_idx)
+                partition[vertex_idx] = communities[partition[vertex_idx]];
+        });
+        graph = aggregate(graph, communities, communities_count);
+        quality = new_quality;
+    }
+    return quality;
+}
+
+} // namespace unum::ustore
@@ -0,0 +1,122 @@
+/**
+ * @file hash.hpp
+ * @author Ashot Vardanian
+ *
+ * @brief Portable non-cryptographic hashing of byte strings.
+ *
+ * Unlike `std::hash`, the results are identical across compilers, standard
+ * libraries and platforms, so they can be persisted, as IDs of buckets.
+ * The construction follows wyhash: the input is consumed in 16- or 48-byte
+ * steps, each mixed with a 64x64 to 128-bit multiplication folded back into
+ * 64 bits, with special cases for short inputs, that dominate in practice.
+ */
+#pragma once
+#include <cstdint> // `std::uint64_t`
+#include <cstring> // `std::memcpy`
+
+namespace unum::ustore {
+
+namespace hash_detail {
+
+static constexpr std::uint64_t secret_k[4] = {
+    0x2d358dccaa6c78a5ull,
+    0x8bb84b93962eacc9ull,
+    0x4b33a62ed433d4a3ull,
+    0x4d5a2da51de1aa47ull,
+};
+
+inline void multiply(std::uint64_t& a, std::uint64_t& b) noexcept {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t product = a;
+    product *= b;
+    a = static_cast<std::uint64_t>(product);
+    b = static_cast<std::uint64_t>(product >> 64);
+#else
+    std::uint64_t a_high = a >> 32, a_low = static_cast<std::uint32_t>(a);
+    std::uint64_t b_high = b >> 32, b_low = static_cast<std::uint32_t>(b);
+    std::uint64_t high_high = a_high * b_high, high_low = a_high * b_low;
+    std::uint64_t low_high = a_low * b_high, low_low = a_low * b_low;
+    std::uint64_t middle = high_low + (low_low >> 32) + static_cast<std::uint32_t>(low_high);
+    a = (middle << 32) | static_cast<std::uint32_t>(low_low);
+    b = high_high + (middle >> 32) + (low_high >> 32);
+#endif
+}
+
+inline std::uint64_t mix(std::uint64_t a, std::uint64_t b) noexcept {
+    multiply(a, b);
+    return a ^ b;
+}
+
+template <typename word_at>
+inline std::uint64_t read_little_endian(std::uint8_t const* ptr) noexcept {
+    word_at word;
+    std::memcpy(&word, ptr, sizeof(word));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    if constexpr (sizeof(word_at) == 8)
+        word = __builtin_bswap64(word);
+    else
+        word = __builtin_bswap32(word);
+#endif
+    return word;
+}
+
+inline std::uint64_t read8(std::uint8_t const* ptr) noexcept {
+    return read_little_endian<std::uint64_t>(ptr);
+}
+inline std::uint64_t read4(std::uint8_t const* ptr) noexcept {
+    return read_little_endian<std::uint32_t>(ptr);
+}
+inline std::uint64_t read3(std::uint8_t const* ptr, std::size_t length) noexcept {
+    return (std::uint64_t(ptr[0]) << 16) | (std::uint64_t(ptr[length >> 1]) << 8) | ptr[length - 1];
+}
+
+} // namespace hash_detail
+
+/**
+ * @brief Hashes @p length bytes starting at @p data.
+ * Different @p seed values produce independent hash functions.
+ */
+inline std::uint64_t hash_bytes(void const* data, std::size_t length, std::uint64_t seed = 0) noexcept {
+    using namespace hash_detail;
+    auto ptr = reinterpret_cast<std::uint8_t const*>(data);
+    seed ^= mix(seed ^ secret_k[0], secret_k[1]);
+
+    std::uint64_t a = 0, b = 0;
+    if (length <= 16) {
+        if (length >= 4) {
+            std::size_t shift = (length >> 3) << 2;
+            a = (read4(ptr) << 32) | read4(ptr + shift);
+            b = (read4(ptr + length - 4) << 32) | read4(ptr + length - 4 - shift);
+        }
+        else if (length > 0)
+            a = read3(ptr, length);
+    }
+    else {
+        std::size_t remaining = length;
+        if (remaining > 48) {
+            std::uint64_t seed1 = seed, seed2 = seed;
+            do {
+                seed = mix(read8(ptr) ^ secret_k[1], read8(ptr + 8) ^ seed);
+                seed1 = mix(read8(ptr + 16) ^ secret_k[2], read8(ptr + 24) ^ seed1);
+                seed2 = mix(read8(ptr + 32) ^ secret_k[3], read8(ptr + 40) ^ seed2);
+                ptr += 48;
+                remaining -= 48;
+            } while (remaining > 48);
+            seed ^= seed1 ^ seed2;
+        }
+        while (remaining > 16) {
+            seed = mix(read8(ptr) ^ secret_k[1], read8(ptr + 8) ^ seed);
+            ptr += 16;
+            remaining -= 16;
+        }
+        a = read8(ptr + remaining - 16);
+        b = read8(ptr + remaining - 8);
+    }
+
+    a ^= secret_k[1];
+    b ^= seed;
+    multiply(a, b);
+    return mix(a ^ secret_k[0] ^ length, b ^ secret_k[1]);
+}
+
+} // namespace unum::ustore
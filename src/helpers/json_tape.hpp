@@ -0,0 +1,511 @@
+/**
+ * @file json_tape.hpp
+ * @author Ashot Vardanian
+ *
+ * @brief Pre-parsed binary encoding of JSON documents, that is queried in place.
+ *
+ * Every document starts with a zero byte, that can't start a JSON text, and a version:
+ *
+ *      [u8 0] [u8 version] [root node]
+ *
+ * Every node is a one-byte type, followed by a type-specific payload:
+ *
+ *      null, false, true:  nothing
+ *      signed, unsigned:   [u64]
+ *      real:               [f64]
+ *      string:             [u32 length] [bytes] [u8 0]
+ *      array:              [u32 count] [u32 bytes] [count x u32 offsets] [elements]
+ *      object:             [u32 count] [u32 bytes] [count x u32 offsets] [members]
+ *
+ * Elements and members follow each other in the original order, and every member
+ * is a string node with the key, followed by the value node. The `bytes` span the
+ * offsets and all the children, so containers are skipped without visiting them.
+ * Offsets are relative to the first child. In objects they are sorted by the keys,
+ * so finding a member is a binary search, and finding an element is a single jump.
+ * Resolving a JSON-Pointer takes as many of those steps, as the pointer is deep.
+ *
+ * All the words are unaligned and in the native byte order. Every read is bounds-checked, so
+ * damaged documents result in missing values, instead of out-of-bounds accesses.
+ */
+#pragma once
+#include <algorithm>   // `std::stable_sort`
+#include <cmath>       // `std::isnan`
+#include <cstdint>     // `std::uint32_t`
+#include <cstdio>      // `std::snprintf`
+#include <cstring>     // `std::memcpy`
+#include <iterator>    // `std::back_inserter`
+#include <limits>      // `std::numeric_limits`
+#include <string>      // `std::string`
+#include <string_view> // `std::string_view`
+#include <vector>      // `std::vector`
+
+#include <fmt/format.h> // `fmt::format_to`
+
+#include "ustore/cpp/types.hpp" // `value_view_t`
+
+namespace unum::ustore {
+
+enum class tape_type_t : std::uint8_t {
+    invalid_k = 0,
+    null_k = 1,
+    false_k = 2,
+    true_k = 3,
+    sint_k = 4,
+    uint_k = 5,
+    real_k = 6,
+    string_k = 7,
+    array_k = 8,
+    object_k = 9,
+};
+
+constexpr std::uint8_t tape_magic_k = 0;
+constexpr std::uint8_t tape_version_k = 1;
+constexpr std::size_t bytes_in_tape_header_k = 2;
+constexpr std::size_t bytes_in_container_header_k = 1 + 2 * sizeof(std::uint32_t);
+constexpr std::size_t bytes_in_string_header_k = 1 + sizeof(std::uint32_t);
+
+inline bool is_tape(value_view_t bytes) noexcept {
+    auto data = reinterpret_cast<std::uint8_t const*>(bytes.data());
+    return bytes.size() > bytes_in_tape_header_k && data[0] == tape_magic_k && data[1] == tape_version_k;
+}
+
+/**
+ * @brief Appends a quoted and escaped JSON string.
+ */
+inline void append_json_string(std::string& output, std::string_view str) noexcept(false) {
+    output.push_back('"');
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            output.push_back('\\');
+            output.push_back(c);
+        }
+        else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+            output.append(escaped);
+        }
+        else
+            output.push_back(c);
+    }
+    output.push_back('"');
+}
+
+/**
+ * @brief Non-owning view of a node within a tape, bounded by the end of the document.
+ * Default-constructed and damaged nodes have the `tape_type_t::invalid_k` type.
+ */
+class tape_node_t {
+    std::uint8_t const* begin_ = nullptr;
+    std::uint8_t const* end_ = nullptr;
+
+    std::size_t available() const noexcept { return static_cast<std::size_t>(end_ - begin_); }
+
+    template <typename word_at>
+    word_at read(std::size_t offset) const noexcept {
+        word_at word {};
+        if (available() >= offset + sizeof(word_at))
+            std::memcpy(&word, begin_ + offset, sizeof(word_at));
+        return word;
+    }
+
+    /// @brief Address of the first child of a container, following the offsets.
+    std::uint8_t const* children() const noexcept {
+        return begin_ + bytes_in_container_header_k + sizeof(std::uint32_t) * std::size_t(size());
+    }
+
+    tape_node_t child(std::size_t offset_idx) const noexcept {
+        std::size_t offsets_start = bytes_in_container_header_k + sizeof(std::uint32_t) * offset_idx;
+        std::uint32_t offset = read<std::uint32_t>(offsets_start);
+        std::uint8_t const* child_begin = children() + offset;
+        return child_begin < begin_ + bytes() ? tape_node_t {child_begin, end_} : tape_node_t {};
+    }
+
+  public:
+    tape_node_t() noexcept = default;
+    tape_node_t(std::uint8_t const* begin, std::uint8_t const* end) noexcept : begin_(begin), end_(end) {}
+
+    tape_type_t type() const noexcept {
+        if (begin_ == end_ || *begin_ > static_cast<std::uint8_t>(tape_type_t::object_k))
+            return tape_type_t::invalid_k;
+        return static_cast<tape_type_t>(*begin_);
+    }
+    explicit operator bool() const noexcept { return type() != tape_type_t::invalid_k && bytes(); }
+    std::uint8_t const* data() const noexcept { return begin_; }
+    bool is_container() const noexcept { return type() == tape_type_t::array_k || type() == tape_type_t::object_k; }
+
+    std::int64_t sint() const noexcept { return read<std::int64_t>(1); }
+    std::uint64_t uint() const noexcept { return read<std::uint64_t>(1); }
+    double real() const noexcept { return read<double>(1); }
+    std::string_view str() const noexcept {
+        return {reinterpret_cast<char const*>(begin_ + bytes_in_string_header_k), read<std::uint32_t>(1)};
+    }
+
+    /// @brief Number of elements or members in a container.
+    std::uint32_t size() const noexcept { return is_container() ? read<std::uint32_t>(1) : 0u; }
+
+    /// @brief Number of bytes taken by the node with all of its children, or zero, if it doesn't fit.
+    std::size_t bytes() const noexcept {
+        std::size_t result = 0;
+        switch (type()) {
+        case tape_type_t::null_k:
+        case tape_type_t::false_k:
+        case tape_type_t::true_k: result = 1; break;
+        case tape_type_t::sint_k:
+        case tape_type_t::uint_k:
+        case tape_type_t::real_k: result = 1 + sizeof(std::uint64_t); break;
+        case tape_type_t::string_k:
+            result = available() < bytes_in_string_header_k
+                         ? available() + 1
+                         : bytes_in_string_header_k + std::size_t(read<std::uint32_t>(1)) + 1;
+            break;
+        case tape_type_t::array_k:
+        case tape_type_t::object_k:
+            result = available() < bytes_in_container_header_k
+                         ? available() + 1
+                         : bytes_in_container_header_k + std::size_t(read<std::uint32_t>(1 + sizeof(std::uint32_t)));
+            break;
+        default: break;
+        }
+        return result <= available() ? result : 0;
+    }
+
+    tape_node_t at(std::size_t idx) const noexcept {
+        return type() == tape_type_t::array_k && idx < size() ? child(idx) : tape_node_t {};
+    }
+
+    tape_node_t find(std::string_view key) const noexcept {
+        if (type() != tape_type_t::object_k || !bytes())
+            return {};
+        std::size_t low = 0, high = size();
+        while (low < high) {
+            std::size_t mid = low + (high - low) / 2;
+            tape_node_t member_key = child(mid);
+            if (member_key.type() != tape_type_t::string_k || !member_key.bytes())
+                return {};
+            if (member_key.str() < key)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        tape_node_t member_key = child(low);
+        if (low == size() || member_key.str() != key)
+            return {};
+        return tape_node_t {member_key.begin_ + member_key.bytes(), end_};
+    }
+
+    /**
+     * @brief Visits the children in their original order, calling @p callback with
+     * the key and the value for members, and with an empty key for elements.
+     * @return False, if the container is damaged.
+     */
+    template <typename callback_at>
+    bool for_each(callback_at&& callback) const noexcept(false) {
+        bool is_object = type() == tape_type_t::object_k;
+        std::uint8_t const* const children_end = begin_ + bytes();
+        tape_node_t next {children(), children_end};
+        for (std::uint32_t idx = 0; idx != size(); ++idx) {
+            std::string_view key;
+            if (is_object) {
+                if (next.type() != tape_type_t::string_k || !next.bytes())
+                    return false;
+                key = next.str();
+                next = tape_node_t {next.begin_ + next.bytes(), children_end};
+            }
+            if (!next)
+                return false;
+            callback(key, tape_node_t {next.begin_, end_});
+            next = tape_node_t {next.begin_ + next.bytes(), children_end};
+        }
+        return true;
+    }
+
+    /**
+     * @brief Finds a member by name or a nested value by a JSON-Pointer.
+     * NULL @p field addresses the node itself.
+     * @param on_parent Called with every container, the search descends into.
+     */
+    template <typename on_parent_at>
+    tape_node_t lookup(char const* field, on_parent_at&& on_parent) const noexcept(false) {
+        if (!field)
+            return *this;
+        if (field[0] != '/') {
+            on_parent(*this);
+            return find(field);
+        }
+
+        tape_node_t node = *this;
+        std::string unescaped;
+        for (char const* segment = field + 1; node; ++segment) {
+            char const* segment_end = std::strchr(segment, '/');
+            if (!segment_end)
+                segment_end = segment + std::strlen(segment);
+            std::string_view name {segment, static_cast<std::size_t>(segment_end - segment)};
+            if (name.find('~') != std::string_view::npos) {
+                unescaped.clear();
+                for (std::size_t idx = 0; idx != name.size(); ++idx)
+                    unescaped.push_back(name[idx] == '~' && idx + 1 != name.size()
+                                            ? (name[++idx] == '0' ? '~' : '/')
+                                            : name[idx]);
+                name = unescaped;
+            }
+
+            if (node.is_container())
+                on_parent(node);
+            if (node.type() == tape_type_t::object_k)
+                node = node.find(name);
+            else if (node.type() == tape_type_t::array_k) {
+                std::size_t idx = 0;
+                bool is_index = !name.empty() && name.size() < 20;
+                for (char c : name) {
+                    is_index &= c >= '0' && c <= '9';
+                    idx = idx * 10 + std::size_t(c - '0');
+                }
+                node = is_index ? node.at(idx) : tape_node_t {};
+            }
+            else
+                node = {};
+
+            if (!*segment_end)
+                break;
+            segment = segment_end;
+        }
+        return node;
+    }
+
+    tape_node_t lookup(char const* field) const noexcept(false) {
+        return lookup(field, [](tape_node_t) {});
+    }
+};
+
+inline tape_node_t tape_root(value_view_t bytes) noexcept {
+    if (!is_tape(bytes))
+        return {};
+    auto data = reinterpret_cast<std::uint8_t const*>(bytes.data());
+    return {data + bytes_in_tape_header_k, data + bytes.size()};
+}
+
+/**
+ * @brief Replaces the node at @p field with another @p node, encoded without the tape header,
+ * shifting the sizes and the offsets of the enclosing containers, so nothing else is re-encoded.
+ * @return False, if the node is missing, or the tape would overflow its 32-bit offsets.
+ */
+inline bool tape_replace(std::string& tape, char const* field, std::string_view node) noexcept(false) {
+    auto const tape_begin = reinterpret_cast<std::uint8_t const*>(tape.data());
+    std::vector<std::size_t> parents;
+    tape_node_t target = tape_root(value_view_t(tape.data(), tape.size())).lookup(field, [&](tape_node_t parent) {
+        parents.push_back(static_cast<std::size_t>(parent.data() - tape_begin));
+    });
+    if (!target)
+        return false;
+
+    std::size_t const target_begin = static_cast<std::size_t>(target.data() - tape_begin);
+    std::size_t const old_size = target.bytes();
+    if (tape.size() - old_size + node.size() > std::numeric_limits<std::uint32_t>::max())
+        return false;
+    tape.replace(target_begin, old_size, node.data(), node.size());
+
+    // The sizes of all the parents change, but only the children, that follow the replaced one, move.
+    // Negative differences wrap around, just like the unsigned additions, they are used in.
+    auto const delta = static_cast<std::uint32_t>(node.size() - old_size);
+    auto word_at = [&](std::size_t offset) {
+        std::uint32_t word;
+        std::memcpy(&word, &tape[offset], sizeof(word));
+        return word;
+    };
+    auto add_at = [&](std::size_t offset) {
+        std::uint32_t word = word_at(offset) + delta;
+        std::memcpy(&tape[offset], &word, sizeof(word));
+    };
+    for (std::size_t parent_begin : parents) {
+        std::uint32_t const count = word_at(parent_begin + 1);
+        std::size_t const offsets_begin = parent_begin + bytes_in_container_header_k;
+        std::size_t const children_begin = offsets_begin + sizeof(std::uint32_t) * count;
+        add_at(parent_begin + 1 + sizeof(std::uint32_t));
+        for (std::uint32_t idx = 0; idx != count; ++idx)
+            if (children_begin + word_at(offsets_begin + sizeof(std::uint32_t) * idx) > target_begin)
+                add_at(offsets_begin + sizeof(std::uint32_t) * idx);
+    }
+    return true;
+}
+
+/**
+ * @brief Serializes a node into a minified JSON.
+ * @return False, if the node is damaged.
+ */
+inline bool tape_to_json(tape_node_t node, std::string& output) noexcept(false) {
+    switch (node.type()) {
+    case tape_type_t::null_k: output.append("null"); return true;
+    case tape_type_t::false_k: output.append("false"); return true;
+    case tape_type_t::true_k: output.append("true"); return true;
+    case tape_type_t::sint_k: fmt::format_to(std::back_inserter(output), "{}", node.sint()); return true;
+    case tape_type_t::uint_k: fmt::format_to(std::back_inserter(output), "{}", node.uint()); return true;
+    case tape_type_t::real_k: {
+        double real = node.real();
+        if (std::isnan(real))
+            output.append("NaN");
+        else if (std::isinf(real))
+            output.append(real > 0 ? "Infinity" : "-Infinity");
+        else {
+            // Keep the number floating-point, when parsed again
+            std::size_t printed_offset = output.size();
+            fmt::format_to(std::back_inserter(output), "{}", real);
+            if (output.find_first_of(".eE", printed_offset) == std::string::npos)
+                output.append(".0");
+        }
+        return true;
+    }
+    case tape_type_t::string_k:
+        if (!node)
+            return false;
+        append_json_string(output, node.str());
+        return true;
+    case tape_type_t::array_k:
+    case tape_type_t::object_k: {
+        bool is_object = node.type() == tape_type_t::object_k;
+        bool is_first = true;
+        bool is_valid = bool(node);
+        output.push_back(is_object ? '{' : '[');
+        is_valid = is_valid && node.for_each([&](std::string_view key, tape_node_t child) {
+            if (!is_first)
+                output.push_back(',');
+            is_first = false;
+            if (is_object) {
+                append_json_string(output, key);
+                output.push_back(':');
+            }
+            is_valid = is_valid && tape_to_json(child, output);
+        });
+        output.push_back(is_object ? '}' : ']');
+        return is_valid;
+    }
+    default: return false;
+    }
+}
+
+/**
+ * @brief Appends nodes to a tape in the "depth-first" order, patching the headers
+ * of containers, when they are closed. The exact number of children must be known,
+ * when a container is opened.
+ */
+class tape_builder_t {
+    struct container_t {
+        std::size_t begin = 0;
+        std::uint32_t count = 0;
+        std::uint32_t next = 0;
+        bool is_object = false;
+        bool awaits_value = false;
+    };
+
+    std::string& output_;
+    std::vector<container_t> containers_;
+
+    template <typename word_at>
+    void append_word(word_at word) noexcept(false) {
+        char bytes[sizeof(word_at)];
+        std::memcpy(bytes, &word, sizeof(word_at));
+        output_.append(bytes, sizeof(word_at));
+    }
+
+    template <typename word_at>
+    void write_word(std::size_t offset, word_at word) noexcept {
+        std::memcpy(&output_[offset], &word, sizeof(word_at));
+    }
+
+    /// @brief Records the offset of every element, before it is appended.
+    void begin_node(tape_type_t type) noexcept(false) {
+        if (!containers_.empty()) {
+            container_t& parent = containers_.back();
+            if (parent.awaits_value)
+                parent.awaits_value = false;
+            else
+                record_child(parent);
+        }
+        output_.push_back(static_cast<char>(type));
+    }
+
+    void record_child(container_t& parent) noexcept {
+        std::size_t offsets_begin = parent.begin + bytes_in_container_header_k;
+        std::size_t children_begin = offsets_begin + sizeof(std::uint32_t) * parent.count;
+        auto offset = static_cast<std::uint32_t>(output_.size() - children_begin);
+        write_word(offsets_begin + sizeof(std::uint32_t) * parent.next++, offset);
+    }
+
+    void open(tape_type_t type, std::uint32_t count) noexcept(false) {
+        std::size_t begin = output_.size();
+        begin_node(type);
+        append_word(count);
+        append_word(std::uint32_t(0));
+        output_.append(sizeof(std::uint32_t) * count, '\0');
+        containers_.push_back({begin, count, 0, type == tape_type_t::object_k, false});
+    }
+
+    void append_string(std::string_view str) noexcept(false) {
+        append_word(static_cast<std::uint32_t>(str.size()));
+        output_.append(str.data(), str.size());
+        output_.push_back('\0');
+    }
+
+  public:
+    explicit tape_builder_t(std::string& output) noexcept(false) : output_(output) {
+        output_.push_back(static_cast<char>(tape_magic_k));
+        output_.push_back(static_cast<char>(tape_version_k));
+    }
+
+    void null() noexcept(false) { begin_node(tape_type_t::null_k); }
+    void boolean(bool value) noexcept(false) { begin_node(value ? tape_type_t::true_k : tape_type_t::false_k); }
+    void sint(std::int64_t value) noexcept(false) {
+        begin_node(tape_type_t::sint_k);
+        append_word(value);
+    }
+    void uint(std::uint64_t value) noexcept(false) {
+        begin_node(tape_type_t::uint_k);
+        append_word(value);
+    }
+    void real(double value) noexcept(false) {
+        begin_node(tape_type_t::real_k);
+        append_word(value);
+    }
+    void str(std::string_view value) noexcept(false) {
+        begin_node(tape_type_t::string_k);
+        append_string(value);
+    }
+
+    void open_array(std::uint32_t count) noexcept(false) { open(tape_type_t::array_k, count); }
+    void open_object(std::uint32_t count) noexcept(false) { open(tape_type_t::object_k, count); }
+
+    /// @brief Appends the key of the next member, that must be followed by its value.
+    void key(std::string_view name) noexcept(false) {
+        container_t& parent = containers_.back();
+        record_child(parent);
+        parent.awaits_value = true;
+        output_.push_back(static_cast<char>(tape_type_t::string_k));
+        append_string(name);
+    }
+
+    void close() noexcept(false) {
+        container_t container = containers_.back();
+        containers_.pop_back();
+        std::size_t offsets_begin = container.begin + bytes_in_container_header_k;
+        auto bytes = static_cast<std::uint32_t>(output_.size() - offsets_begin);
+        write_word(container.begin + 1 + sizeof(std::uint32_t), bytes);
+        if (!container.is_object || container.count < 2)
+            return;
+
+        // Sort the members by keys, keeping the duplicates in the original order
+        std::vector<std::uint32_t> offsets(container.count);
+        std::memcpy(offsets.data(), &output_[offsets_begin], sizeof(std::uint32_t) * container.count);
+        std::size_t children_begin = offsets_begin + sizeof(std::uint32_t) * container.count;
+        auto key_at = [&](std::uint32_t offset) {
+            std::size_t key_begin = children_begin + offset;
+            std::uint32_t length;
+            std::memcpy(&length, &output_[key_begin + 1], sizeof(length));
+            return std::string_view(&output_[key_begin + bytes_in_string_header_k], length);
+        };
+        std::stable_sort(offsets.begin(), offsets.end(), [&](std::uint32_t a, std::uint32_t b) {
+            return key_at(a) < key_at(b);
+        });
+        std::memcpy(&output_[offsets_begin], offsets.data(), sizeof(std::uint32_t) * container.count);
+    }
+};
+
+} // namespace unum::ustore
@@ -75,24 +75,22 @@ class limited_priority_queue_gt {
         auto end = ptr_ + length_;
         auto element_ptr = std::lower_bound(ptr_, end, element, &higher_priority);
         if (element_ptr == end) {
-            if (length_ < capacity_) {
-                new (end) element_t(std::move(element));
-                ++length_;
-                return true;
-            }
-            else
-                return false;
-        }
-        else {
             if (length_ == capacity_)
-                std::destroy_at(ptr_ + capacity_ - 1);
-            auto source_ptr = element_ptr;
-            for (; source_ptr + 1 != end; ++source_ptr)
-                source_ptr[1] = std::move(source_ptr[0]);
-            *element_ptr = std::move(element);
-            length_ += length_ < capacity_;
+                return false;
+            new (end) element_t(std::move(element));
+            ++length_;
             return true;
         }
+
+        // Shift the tail by one slot, growing into the free capacity
+        // or dropping the lowest priority entry, if full.
+        if (length_ < capacity_) {
+            new (end) element_t(std::move(end[-1]));
+            ++length_;
+        }
+        std::move_backward(element_ptr, end - 1, end);
+        *element_ptr = std::move(element);
+        return true;
     }
 
     constexpr static std::size_t implicit_memory_usage(std::size_t capacity) noexcept {
@@ -203,6 +203,34 @@ class growing_tape_t {
         return value_view_t {contents_.data() + contents_.size() - value.size(), value.size()};
     }
 
+    /**
+     * @brief Appends a present value of the given length, leaving its contents uninitialized.
+     * @return Memory region to be filled by the caller.
+     */
+    byte_t* push_back_uninitialized(std::size_t length, ustore_error_t* c_error) {
+        auto offset = static_cast<ustore_length_t>(contents_.size());
+        auto old_count = lengths_.size();
+
+        lengths_.push_back(static_cast<ustore_length_t>(length), c_error);
+
+        presences_.resize(divide_round_up(old_count + 1, bits_in_byte_k), c_error);
+        if (*c_error)
+            return nullptr;
+        presences()[old_count] = true;
+
+        offsets_.resize(lengths_.size() + 1, c_error);
+        if (*c_error)
+            return nullptr;
+        offsets_[old_count] = offset;
+        offsets_[old_count + 1] = offset + static_cast<ustore_length_t>(length);
+
+        contents_.resize(contents_.size() + length, c_error);
+        if (*c_error)
+            return nullptr;
+
+        return contents_.data() + offset;
+    }
+
     void add_terminator(byte_t terminator, ustore_error_t* c_error) {
         contents_.push_back(terminator, c_error);
         return_if_error_m(c_error);
@@ -229,6 +257,14 @@ class growing_tape_t {
     strided_range_gt<ustore_length_t> lengths() noexcept {
         return strided_range<ustore_length_t>(lengths_.begin(), lengths_.end());
     }
+    /**
+     * @brief Apache Arrow-compatible offsets, which even for an empty tape contain the trailing zero.
+     */
+    ustore_length_t* arrow_offsets(ustore_error_t* c_error) noexcept {
+        if (offsets_.size() == 0)
+            offsets_.push_back(0, c_error);
+        return offsets_.begin();
+    }
     strided_range_gt<byte_t> contents() noexcept { return strided_range<byte_t>(contents_.begin(), contents_.end()); }
 
     operator joined_blobs_t() noexcept { return {lengths_.size(), offsets_.data(), ustore_bytes_ptr_t(contents_.data())}; }
@@ -3,35 +3,107 @@
  * @author Ashot Vardanian
  *
  * @brief Helper functions Polymorphic Memory Allocators.
+ *
+ * Released arena blocks are kept in a process-wide pool, bounded by
+ * `linked_memory_t::pool_limit_bytes`, and are reused by the following
+ * requests with the same kind and placement, instead of going to the OS.
  */
 #pragma once
-#include <sys/mman.h> // `mmap`
-#include <limits.h>   // `CHAR_BIT`
-#include <cstring>    // `std::memcpy`
-#include <stdexcept>  // `std::runtime_error`
-#include <memory>     // `std::allocator`
-#include <vector>     // `std::vector`
-#include <numeric>    // `std::accumulate`
+#include <sys/mman.h>    // `mmap`
+#include <sys/syscall.h> // `SYS_mbind`
+#include <unistd.h>      // `syscall`
+#include <limits.h>      // `CHAR_BIT`
+#include <cstdio>        // `std::fopen`
+#include <cstring>       // `std::memcpy`
+#include <mutex>         // `std::mutex`
+#include <stdexcept>     // `std::runtime_error`
+#include <memory>        // `std::allocator`
+#include <vector>        // `std::vector`
+#include <numeric>       // `std::accumulate`
+#include <atomic>        // `std::atomic`
 
 #include "ustore/cpp/types.hpp"  // `byte_t`, `next_power_of_two`
 #include "ustore/cpp/ranges.hpp" // `strided_range_gt`
 #include "ustore/cpp/status.hpp" // `out_of_memory_k`
+#include "helpers/trace.hpp"     // `trace_span_m`
 
 namespace unum::ustore {
 
+/**
+ * @brief Online NUMA nodes of the machine, as a bitmask for `mbind`.
+ * Is parsed once from "sysfs", and contains a single node on failures.
+ */
+inline unsigned long numa_nodes_mask() noexcept {
+    static unsigned long const mask = [] {
+        unsigned long result = 1;
+        std::FILE* file = std::fopen("/sys/devices/system/node/online", "r");
+        if (!file)
+            return result;
+        // The format is a list of ranges, like "0-3,8-11"
+        unsigned first = 0, last = 0;
+        char separator = 0;
+        result = 0;
+        while (std::fscanf(file, "%u", &first) == 1) {
+            last = first;
+            if (std::fscanf(file, "%c", &separator) == 1 && separator == '-')
+                if (std::fscanf(file, "%u%c", &last, &separator) < 1)
+                    break;
+            for (unsigned node = first; node <= last && node < sizeof(result) * CHAR_BIT; ++node)
+                result |= 1ul << node;
+            if (separator != ',')
+                break;
+        }
+        std::fclose(file);
+        return result ? result : 1ul;
+    }();
+    return mask;
+}
+
+/**
+ * @brief NUMA node of the CPU, the calling thread is currently running on.
+ */
+inline unsigned current_numa_node() noexcept {
+    unsigned cpu = 0, node = 0;
+#if defined(SYS_getcpu)
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+        node = 0;
+#endif
+    return node;
+}
+
 struct linked_memory_t {
     static constexpr std::size_t initial_size_k = 1024ul * 1024ul;
     static constexpr std::size_t growth_factor_k = 2ul;
+    static constexpr std::size_t huge_page_size_k = 2ul * 1024ul * 1024ul;
 
     struct arena_header_t;
     arena_header_t* first_ptr_ = nullptr;
 
-    enum class kind_t { sys_k = 0, shared_k, unified_k };
+    /// @brief Total capacity of all the arenas in the process, for statistics.
+    static inline std::atomic<std::size_t> reserved_bytes {0};
+    /// @brief Total capacity of released arenas, kept for reuse.
+    static inline std::atomic<std::size_t> pooled_bytes {0};
+    /// @brief Upper bound for `pooled_bytes`, beyond which arenas go back to the OS.
+    static inline std::atomic<std::size_t> pool_limit_bytes {256ul * 1024ul * 1024ul};
+
+    /**
+     * @brief Source of the memory.
+     * - `sys_k`: Heap, or private pages, if a NUMA placement is requested.
+     * - `shared_k`: Shared anonymous pages.
+     * - `huge_k`: Private 2 MB pages. Explicit "hugetlbfs" pages are used, if the OS
+     *   has them reserved, otherwise the range is aligned and advised for transparent ones.
+     */
+    enum class kind_t { sys_k = 0, shared_k, unified_k, huge_k };
+    enum class placement_t { any_k = 0, local_k, interleave_k };
+
     struct arena_header_t {
         arena_header_t* next = nullptr;
         std::size_t capacity = 0;
         std::size_t used = 0;
         kind_t kind = kind_t::sys_k;
+        placement_t placement = placement_t::any_k;
+        unsigned numa_node = 0;
+        bool is_mapped = false;
         bool can_release_memory = false;
 
         void* alloc_internally(std::size_t length, std::size_t alignment) noexcept {
@@ -47,42 +119,165 @@ struct linked_memory_t {
         }
     };
 
-    static arena_header_t* alloc_arena(std::size_t length, kind_t kind) noexcept {
-        void* begin = nullptr;
-        switch (kind) {
-        case kind_t::sys_k: begin = std::malloc(length); break;
-        case kind_t::shared_k:
-            begin = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_SHARED, -1, 0);
-            break;
-        case kind_t::unified_k: break;
+    static inline std::mutex pool_mutex;
+    static inline arena_header_t* pool_first = nullptr;
+
+    static void* map_pages(std::size_t length, int flags) noexcept {
+        void* begin = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | flags, -1, 0);
+        return begin != MAP_FAILED ? begin : nullptr;
+    }
+
+    static void* map_huge_pages(std::size_t length) noexcept {
+#if defined(MAP_HUGETLB)
+        if (void* begin = map_pages(length, MAP_PRIVATE | MAP_HUGETLB); begin)
+            return begin;
+#endif
+        // Transparent huge pages only back aligned ranges, so we over-allocate and trim
+        auto raw = reinterpret_cast<byte_t*>(map_pages(length + huge_page_size_k, MAP_PRIVATE));
+        if (!raw)
+            return nullptr;
+        auto aligned = reinterpret_cast<byte_t*>(next_multiple(std::uintptr_t(raw), huge_page_size_k));
+        if (aligned != raw)
+            munmap(raw, aligned - raw);
+        if (std::size_t tail = (raw + huge_page_size_k) - aligned; tail)
+            munmap(aligned + length, tail);
+#if defined(MADV_HUGEPAGE)
+        madvise(aligned, length, MADV_HUGEPAGE);
+#endif
+        return aligned;
+    }
+
+    /**
+     * @brief Applies the NUMA policy to freshly mapped pages, before they are touched.
+     * Failures are ignored, as placement is only an optimization.
+     */
+    static void place_pages(void* begin, std::size_t length, placement_t placement, unsigned node) noexcept {
+#if defined(SYS_mbind)
+        constexpr int mpol_preferred_k = 1;
+        constexpr int mpol_interleave_k = 3;
+        unsigned long nodes = numa_nodes_mask();
+        if (placement == placement_t::any_k || !(nodes & (nodes - 1)))
+            return;
+        unsigned long mask = placement == placement_t::local_k ? (1ul << node) : nodes;
+        int mode = placement == placement_t::local_k ? mpol_preferred_k : mpol_interleave_k;
+        syscall(SYS_mbind, begin, length, mode, &mask, sizeof(mask) * CHAR_BIT, 0);
+#endif
+    }
+
+    /**
+     * @brief Picks the smallest compatible arena from the pool.
+     */
+    static arena_header_t* reuse_arena(std::size_t length, kind_t kind, placement_t placement, unsigned node) noexcept {
+        std::unique_lock<std::mutex> lock(pool_mutex);
+        arena_header_t** best = nullptr;
+        for (arena_header_t** it = &pool_first; *it; it = &(*it)->next) {
+            arena_header_t& arena = **it;
+            bool fits = arena.kind == kind && arena.placement == placement && arena.capacity >= length &&
+                        (placement != placement_t::local_k || arena.numa_node == node);
+            if (fits && (!best || arena.capacity < (*best)->capacity))
+                best = it;
+        }
+        if (!best)
+            return nullptr;
+
+        arena_header_t* arena = *best;
+        *best = arena->next;
+        pooled_bytes.fetch_sub(arena->capacity, std::memory_order_relaxed);
+        return arena;
+    }
+
+    static bool pool_arena(arena_header_t* arena) noexcept {
+        std::unique_lock<std::mutex> lock(pool_mutex);
+        if (pooled_bytes.load(std::memory_order_relaxed) + arena->capacity >
+            pool_limit_bytes.load(std::memory_order_relaxed))
+            return false;
+        arena->next = std::exchange(pool_first, arena);
+        pooled_bytes.fetch_add(arena->capacity, std::memory_order_relaxed);
+        return true;
+    }
+
+    static arena_header_t* alloc_arena(std::size_t length, kind_t kind, placement_t placement) noexcept {
+        if (kind == kind_t::huge_k)
+            length = next_multiple(length, huge_page_size_k);
+        unsigned node = placement == placement_t::local_k ? current_numa_node() : 0;
+
+        void* begin = reuse_arena(length, kind, placement, node);
+        bool is_mapped = false;
+        if (begin) {
+            length = reinterpret_cast<arena_header_t*>(begin)->capacity;
+            is_mapped = reinterpret_cast<arena_header_t*>(begin)->is_mapped;
+        }
+        else {
+            switch (kind) {
+            case kind_t::sys_k:
+                is_mapped = placement != placement_t::any_k;
+                begin = is_mapped ? map_pages(length, MAP_PRIVATE) : std::malloc(length);
+                break;
+            case kind_t::shared_k:
+                is_mapped = true;
+                begin = map_pages(length, MAP_SHARED);
+                break;
+            case kind_t::unified_k: break;
+            case kind_t::huge_k:
+                is_mapped = true;
+                begin = map_huge_pages(length);
+                break;
+            }
+            if (begin && is_mapped)
+                place_pages(begin, length, placement, node);
         }
         auto header_ptr = (arena_header_t*)begin;
         if (!header_ptr)
             return nullptr;
 
         std::memset(header_ptr, 0, sizeof(arena_header_t));
+        reserved_bytes.fetch_add(length, std::memory_order_relaxed);
         header_ptr->kind = kind;
+        header_ptr->placement = placement;
+        header_ptr->numa_node = node;
+        header_ptr->is_mapped = is_mapped;
         header_ptr->capacity = length;
         header_ptr->used = sizeof(arena_header_t);
         return header_ptr;
     }
 
     static void release_arena(arena_header_t* arena) noexcept {
-        switch (arena->kind) {
-        case kind_t::sys_k: std::free(arena); break;
-        case kind_t::shared_k: munmap(arena, arena->capacity); break;
-        case kind_t::unified_k: break;
+        reserved_bytes.fetch_sub(arena->capacity, std::memory_order_relaxed);
+        if (pool_arena(arena))
+            return;
+        if (arena->is_mapped)
+            munmap(arena, arena->capacity);
+        else
+            std::free(arena);
+    }
+
+    /**
+     * @brief Returns all the pooled arenas to the OS.
+     */
+    static void trim_pool() noexcept {
+        std::unique_lock<std::mutex> lock(pool_mutex);
+        while (arena_header_t* arena = pool_first) {
+            pool_first = arena->next;
+            pooled_bytes.fetch_sub(arena->capacity, std::memory_order_relaxed);
+            if (arena->is_mapped)
+                munmap(arena, arena->capacity);
+            else
+                std::free(arena);
         }
     }
 
     arena_header_t& first_ref() noexcept { return *reinterpret_cast<arena_header_t*>(first_ptr_); }
 
-    bool start_if_null(kind_t kind) noexcept {
-        if (first_ptr_ && first_ptr_->kind == kind)
+    bool start_if_null(kind_t kind, placement_t placement) noexcept {
+        if (first_ptr_ && first_ptr_->kind == kind && first_ptr_->placement == placement)
             return true;
 
-        first_ptr_ = alloc_arena(initial_size_k, kind);
-        first_ptr_->can_release_memory = true;
+        // Pooled arenas may come from requests with other options
+        if (first_ptr_ && first_ptr_->can_release_memory)
+            release_all();
+        first_ptr_ = alloc_arena(initial_size_k, kind, placement);
+        if (first_ptr_)
+            first_ptr_->can_release_memory = true;
         return first_ptr_;
     }
 
@@ -118,8 +313,9 @@ struct linked_memory_t {
         }
 
         // We need to append a new even bigger bucket.
+        trace_span_m("arena.grow");
         auto new_capacity = std::max(last->capacity * growth_factor_k, length + alignment + sizeof(arena_header_t));
-        auto new_arena = alloc_arena(new_capacity, first_ref().kind);
+        auto new_arena = alloc_arena(new_capacity, first_ref().kind, first_ref().placement);
         if (!new_arena)
             return nullptr;
 
@@ -166,9 +362,12 @@ struct linked_memory_lock_t {
 
     operator ustore_arena_t*() const noexcept { return (ustore_arena_t*)&memory.first_ptr_; }
 
-    linked_memory_lock_t(linked_memory_t& memory, linked_memory_t::kind_t kind, bool keep_old_data = false) noexcept
+    linked_memory_lock_t(linked_memory_t& memory,
+                         linked_memory_t::kind_t kind,
+                         linked_memory_t::placement_t placement,
+                         bool keep_old_data = false) noexcept
         : memory(memory) {
-        if (memory.start_if_null(kind))
+        if (memory.start_if_null(kind, placement))
             if ((owns_the_lock = memory.lock_release_calls()) && !keep_old_data)
                 memory.release_partially();
     }
@@ -245,10 +444,17 @@ inline linked_memory_lock_t linked_memory(ustore_arena_t* c_arena, ustore_option
     linked_memory_t& ref = *reinterpret_cast<linked_memory_t*>(c_arena);
     linked_memory_t::kind_t kind = (options & ustore_option_read_shared_memory_k) //
                                        ? linked_memory_t::kind_t::shared_k
+                                   : (options & ustore_option_arena_huge_pages_k) //
+                                       ? linked_memory_t::kind_t::huge_k
                                        : linked_memory_t::kind_t::sys_k;
+    linked_memory_t::placement_t placement = (options & ustore_option_arena_numa_local_k) //
+                                                 ? linked_memory_t::placement_t::local_k
+                                             : (options & ustore_option_arena_numa_interleave_k) //
+                                                 ? linked_memory_t::placement_t::interleave_k
+                                                 : linked_memory_t::placement_t::any_k;
     bool keep_old_data = options & ustore_option_dont_discard_memory_k;
 
-    return linked_memory_lock_t(ref, kind, keep_old_data);
+    return linked_memory_lock_t(ref, kind, placement, keep_old_data);
 }
 
 inline void clear_linked_memory(ustore_arena_t& c_arena) noexcept {
@@ -257,6 +463,12 @@ inline void clear_linked_memory(ustore_arena_t& c_arena) noexcept {
     ref.release_all();
 }
 
+inline void reset_linked_memory(ustore_arena_t& c_arena) noexcept {
+    static_assert(sizeof(ustore_arena_t) == sizeof(linked_memory_t));
+    linked_memory_t& ref = reinterpret_cast<linked_memory_t&>(c_arena);
+    ref.release_partially();
+}
+
 template <typename dangerous_at>
 void safe_section(ustore_str_view_t name, ustore_error_t* c_error, dangerous_at&& dangerous) try {
     dangerous();
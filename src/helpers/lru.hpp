@@ -5,7 +5,10 @@
  * @brief Least-Recently Used cache
  */
 #pragma once
-#include "helpers.hpp"
+#include <list>          // `std::list`
+#include <unordered_map> // `std::unordered_map`
+#include <optional>      // `std::optional`
+#include <utility>       // `std::pair`
 
 namespace unum::ustore {
 
@@ -35,43 +38,39 @@ class lru_cache_gt {
     size_t capacity_;
 
   public:
-    lru_cache_gt(size_t capacity) : capacity_(capacity) { map_.reserve(capacity_); }
+    lru_cache_gt(size_t capacity) : capacity_(capacity) {}
     ~lru_cache_gt() {}
 
     size_t size() const { return map_.size(); }
     size_t capacity() const { return capacity_; }
     bool empty() const { return map_.empty(); }
     bool contains(key_type const& key) { return map_.find(key) != map_.end(); }
+    void reserve(size_t count) { map_.reserve(count); }
 
+    /**
+     * @brief Inserts a new entry or replaces the value of an existing one,
+     * marking it as the most recently used.
+     */
     void insert(key_type const& key, value_type&& value) {
         auto i = map_.find(key);
-        if (i != map_.end())
+        if (i != map_.end()) {
+            i->second.first = std::move(value);
+            list_.splice(list_.begin(), list_, i->second.second);
             return;
+        }
         if (size() >= capacity_)
             evict();
         list_.push_front(key);
-        map_[key] = std::make_pair(std::move(value), list_.begin());
+        map_.emplace(key, std::make_pair(std::move(value), list_.begin()));
     }
 
     value_type const* get_ptr(key_type const& key) {
         auto i = map_.find(key);
         if (i == map_.end())
-            return std::nullopt;
-
-        auto j = i->second.second;
-        if (j != list_.begin()) {
-            list_.erase(j);
-            list_.push_front(key);
+            return nullptr;
 
-            // update iterator in map
-            j = list_.begin();
-            value_type const& value = i->second.first;
-            map_[key] = std::make_pair(value, j);
-            return &value;
-        }
-
-        // the item is already at the front of the most recently
-        // used list so just return it
+        // Move the item to the front of the most recently used list
+        list_.splice(list_.begin(), list_, i->second.second);
         return &i->second.first;
     }
 
@@ -80,16 +79,8 @@ class lru_cache_gt {
         if (i == map_.end())
             return std::nullopt;
 
-        value_type result;
-        auto j = i->second.second;
-        if (j != list_.begin()) {
-            std::swap(result, i->second.first);
-            list_.erase(j);
-        }
-        else {
-            std::swap(result, list_.front());
-            list_.pop_front();
-        }
+        value_type result = std::move(i->second.first);
+        list_.erase(i->second.second);
         map_.erase(i);
         return result;
     }
@@ -100,15 +91,25 @@ class lru_cache_gt {
     }
 
     void evict() {
+        if (list_.empty())
+            return;
         auto i = --list_.end();
         map_.erase(*i);
         list_.erase(i);
     }
 
-    std::optional<std::pair<key_type, std::reference_wrapper<value_type>>> oldset() {
+    /**
+     * @brief Removes and returns the least recently used entry.
+     */
+    std::optional<std::pair<key_type, value_type>> pop_oldest() {
+        if (list_.empty())
+            return std::nullopt;
         auto i = --list_.end();
-        map_.erase(*i);
+        auto j = map_.find(*i);
+        std::pair<key_type, value_type> result {*i, std::move(j->second.first)};
+        map_.erase(j);
         list_.erase(i);
+        return result;
     }
 };
 
@@ -0,0 +1,97 @@
+/**
+ * @file merge.hpp
+ * @author Ashot Vardanian
+ *
+ * @brief Merge operands, that let modalities update entries without reading them.
+ *
+ * Under `ustore_option_write_merge_k` the values passed to `ustore_write()` aren't
+ * stored as is, but are combined with the existing entries by the engine, lazily,
+ * on reads and compactions. Turning read-modify-write cycles into blind writes.
+ *
+ * Every operand starts with a `merge_kind_t` byte, selecting the modality, that
+ * knows the layout of the entry. All operands of the same key must be of the same
+ * kind. Engines, that can't merge natively, don't report `ustore_supports_merges_k`,
+ * and modalities fall back to reading, modifying and writing whole entries.
+ */
+#pragma once
+#include <string> // `std::string`
+
+#include "ustore/db.h"
+#include "ustore/cpp/ranges.hpp" // `ptr_range_gt`
+
+namespace unum::ustore {
+
+enum class merge_kind_t : std::uint8_t {
+    /// @brief Edges inserted into and removed from a vertex in `modality_graph.cpp`.
+    neighborhood_k = 1,
+    /// @brief Paths upserted into and removed from a hash bucket in `modality_paths.cpp`.
+    paths_bucket_k = 2,
+    /// @brief JSON-Patches and JSON-Merge-Patches applied to a document in `modality_docs.cpp`.
+    doc_k = 3,
+};
+
+constexpr std::size_t bytes_in_merge_header_k = sizeof(merge_kind_t);
+
+using merge_operands_t = ptr_range_gt<value_view_t const>;
+
+/**
+ * @brief Combines the @p base entry, that may be missing, with @p operands in order.
+ * Operands, that can't be applied, are skipped, as their writers can't be notified
+ * anymore. Implemented in the modalities, that produce the operands of that kind.
+ * @return `false` if the inputs are corrupted or the memory is exhausted.
+ */
+bool merge_neighborhood(value_view_t base, merge_operands_t operands, std::string& result) noexcept;
+bool merge_paths_bucket(value_view_t base, merge_operands_t operands, std::string& result) noexcept;
+bool merge_doc(value_view_t base, merge_operands_t operands, std::string& result) noexcept;
+
+inline merge_kind_t merge_kind(value_view_t operand) noexcept {
+    return operand.size() >= bytes_in_merge_header_k ? static_cast<merge_kind_t>(operand.data()[0]) : merge_kind_t {};
+}
+
+inline value_view_t merge_body(value_view_t operand) noexcept {
+    return {operand.data() + bytes_in_merge_header_k, operand.size() - bytes_in_merge_header_k};
+}
+
+/**
+ * @brief Dispatches the merge to the modality, that has produced the operands.
+ * Is called by the engines, that report `ustore_supports_merges_k`.
+ */
+inline bool merge_entries(value_view_t base, merge_operands_t operands, std::string& result) noexcept {
+    if (operands.empty()) {
+        result = std::string(base);
+        return true;
+    }
+
+    auto kind = merge_kind(operands[0]);
+    for (value_view_t operand : operands)
+        if (merge_kind(operand) != kind)
+            return false;
+
+    switch (kind) {
+    case merge_kind_t::neighborhood_k: return merge_neighborhood(base, operands, result);
+    case merge_kind_t::paths_bucket_k: return merge_paths_bucket(base, operands, result);
+    case merge_kind_t::doc_k: return merge_doc(base, operands, result);
+    default: return false;
+    }
+}
+
+/**
+ * @brief Checks, if the modalities can issue blind merges instead of reading
+ * the entries first. Transactions keep the read-modify-write path, to preserve
+ * the conflict detection on the touched keys.
+ */
+inline bool can_merge(ustore_database_t db, ustore_transaction_t txn, ustore_options_t options) noexcept {
+    if (txn || (options & ustore_option_write_bulk_k))
+        return false;
+
+    ustore_error_t error = nullptr;
+    ustore_metadata_t metadata {};
+    ustore_get_metadata_t get_metadata {};
+    get_metadata.db = db;
+    get_metadata.error = &error;
+    get_metadata.metadata = &metadata;
+    ustore_get_metadata(&get_metadata);
+    return !error && (metadata & ustore_supports_merges_k);
+}
+
+} // namespace unum::ustore
@@ -1,9 +1,43 @@
+/**
+ * @file mutex.hpp
+ * @author Ashot Vardanian
+ *
+ * @brief Synchronization primitives for read-heavy many-core workloads.
+ */
 #pragma once
+#include <atomic>  // `std::atomic`
+#include <mutex>   // `std::mutex`
+#include <thread>  // `std::this_thread::yield`
+#include <utility> // `std::exchange`
 
 namespace unum::ustore {
 
 /**
- * @brief TODO: A hybrid `shared_mutex` with upgrade and downgrade ability.
+ * @brief Sequential index of the calling thread, assigned on first use.
+ * Is used to spread per-thread state across a fixed number of slots.
+ */
+inline std::size_t thread_index() noexcept {
+    static std::atomic<std::size_t> threads_count {0};
+    thread_local std::size_t const index = threads_count.fetch_add(1, std::memory_order_relaxed);
+    return index;
+}
+
+/**
+ * @brief A hybrid `shared_mutex` with upgrade and downgrade ability.
+ *
+ * Readers don't share a single counter. Every thread is assigned one of
+ * the cache-line-aligned slots, so shared locking only touches a line,
+ * that is rarely accessed by other cores. Writers have to visit all the
+ * slots, which makes exclusive locking more expensive, but that is the
+ * right trade-off for mostly-read metadata, like lists of collections.
+ *
+ * Writers are preferred: once one starts waiting, new readers back off,
+ * until it's done. Only one thread at a time can hold an "upgradable"
+ * lock. It coexists with readers, excludes writers and other upgraders,
+ * and can atomically become exclusive, once the readers are drained.
+ *
+ * Satisfies the `SharedMutex` requirements, so works with `std::unique_lock`
+ * and `std::shared_lock`, and adds the Boost-like upgrade interface.
  *
  * ## Other Implementations
  *
@@ -12,6 +46,145 @@ namespace unum::ustore {
  * https://github.com/yohhoy/yamc
  *
  */
-struct shared_mutex_t {};
+class shared_mutex_t {
+
+    static constexpr std::size_t slots_k = 64;
+    static constexpr std::size_t cache_line_k = 64;
+
+    struct alignas(cache_line_k) slot_t {
+        std::atomic<std::size_t> readers {0};
+    };
+
+    slot_t slots_[slots_k];
+    alignas(cache_line_k) std::atomic<bool> writing_ {false};
+    /// @brief Serializes writers and upgraders between themselves.
+    std::mutex upgrading_;
+
+    static std::size_t thread_slot() noexcept { return thread_index() % slots_k; }
+
+    bool try_enter_shared(std::atomic<std::size_t>& readers) noexcept {
+        readers.fetch_add(1);
+        if (!writing_.load())
+            return true;
+        readers.fetch_sub(1);
+        return false;
+    }
+
+    void wait_for_readers() noexcept {
+        for (slot_t& slot : slots_)
+            while (slot.readers.load())
+                std::this_thread::yield();
+    }
+
+  public:
+    shared_mutex_t() noexcept = default;
+    shared_mutex_t(shared_mutex_t const&) = delete;
+    shared_mutex_t& operator=(shared_mutex_t const&) = delete;
+
+    void lock_shared() noexcept {
+        std::atomic<std::size_t>& readers = slots_[thread_slot()].readers;
+        while (!try_enter_shared(readers))
+            while (writing_.load())
+                std::this_thread::yield();
+    }
+
+    bool try_lock_shared() noexcept { return try_enter_shared(slots_[thread_slot()].readers); }
+    void unlock_shared() noexcept { slots_[thread_slot()].readers.fetch_sub(1); }
+
+    void lock() noexcept {
+        upgrading_.lock();
+        writing_.store(true);
+        wait_for_readers();
+    }
+
+    bool try_lock() noexcept {
+        if (!upgrading_.try_lock())
+            return false;
+        writing_.store(true);
+        for (slot_t& slot : slots_) {
+            if (slot.readers.load()) {
+                writing_.store(false);
+                upgrading_.unlock();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void unlock() noexcept {
+        writing_.store(false);
+        upgrading_.unlock();
+    }
+
+    void lock_upgrade() noexcept { upgrading_.lock(); }
+    bool try_lock_upgrade() noexcept { return upgrading_.try_lock(); }
+    void unlock_upgrade() noexcept { upgrading_.unlock(); }
+
+    /**
+     * @brief Upgrades to an exclusive lock, waiting for the current readers.
+     * Can't deadlock, as there is never more than one upgrader.
+     */
+    void unlock_upgrade_and_lock() noexcept {
+        writing_.store(true);
+        wait_for_readers();
+    }
+
+    void unlock_and_lock_upgrade() noexcept { writing_.store(false); }
+
+    void unlock_and_lock_shared() noexcept {
+        slots_[thread_slot()].readers.fetch_add(1);
+        unlock();
+    }
+
+    void unlock_upgrade_and_lock_shared() noexcept {
+        slots_[thread_slot()].readers.fetch_add(1);
+        upgrading_.unlock();
+    }
+};
+
+/**
+ * @brief RAII wrapper for the upgradable state of `shared_mutex_t`,
+ * similar to `boost::upgrade_lock`. Tracks, if the lock was upgraded,
+ * to release it in the right mode.
+ */
+class upgrade_lock_t {
+    shared_mutex_t* mutex_ = nullptr;
+    bool exclusive_ = false;
+
+  public:
+    explicit upgrade_lock_t(shared_mutex_t& mutex) noexcept : mutex_(&mutex) { mutex_->lock_upgrade(); }
+    upgrade_lock_t(upgrade_lock_t&& other) noexcept
+        : mutex_(std::exchange(other.mutex_, nullptr)), exclusive_(std::exchange(other.exclusive_, false)) {}
+    upgrade_lock_t(upgrade_lock_t const&) = delete;
+    upgrade_lock_t& operator=(upgrade_lock_t const&) = delete;
+    ~upgrade_lock_t() noexcept { unlock(); }
+
+    bool is_exclusive() const noexcept { return exclusive_; }
+
+    void upgrade() noexcept {
+        if (!mutex_ || exclusive_)
+            return;
+        mutex_->unlock_upgrade_and_lock();
+        exclusive_ = true;
+    }
+
+    void downgrade() noexcept {
+        if (!mutex_ || !exclusive_)
+            return;
+        mutex_->unlock_and_lock_upgrade();
+        exclusive_ = false;
+    }
+
+    void unlock() noexcept {
+        if (!mutex_)
+            return;
+        if (exclusive_)
+            mutex_->unlock();
+        else
+            mutex_->unlock_upgrade();
+        mutex_ = nullptr;
+        exclusive_ = false;
+    }
+};
 
 } // namespace unum::ustore
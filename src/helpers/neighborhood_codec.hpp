@@ -0,0 +1,523 @@
+/**
+ * @file neighborhood_codec.hpp
+ * @author Ashot Vardanian
+ *
+ * @brief Compressed encoding of graph neighborhoods.
+ *
+ * A plain neighborhood is a pair of degrees, followed by the sorted `neighborship_t`
+ * arrays of outgoing and incoming relations, 16 bytes per relation. The compressed one
+ * splits both arrays into blocks of up to 128 relations. Within a block, the neighbor IDs
+ * are stored as bit-packed deltas from the previous one, and the edge IDs are bit-packed
+ * separately, as offsets from the smallest in the block. Common cases, like edges without
+ * IDs or runs of consecutive neighbors, take just a few bits per relation:
+ *
+ *      [u32 degree | flag] [u32 degree] [u32 blocks] [u32 blocks] [blocks x block_header_t] [payloads]
+ *
+ * The headers are stored together, so a lookup can binary-search the first neighbor of
+ * every block and only unpack the blocks, that may contain the match. Blocks are
+ * unpacked independently of each other, into fixed-size stack buffers. The highest bit
+ * of the first degree differentiates the two encodings.
+ *
+ * Neighborhoods of supernodes are split into chunks of sorted relations, stored under
+ * reserved keys next to the vertex. The vertex itself keeps just a directory of chunks,
+ * followed by a plain neighborhood of pending relations, merged in without reading them:
+ *
+ *      [u32 flag] [u32 chunks] [u32 next chunk] [u32 reserved] [chunks x chunk_ref_t] [pending]
+ *
+ * Every chunk is a neighborhood of its own, potentially compressed, with all relations
+ * listed as outgoing ones. The two highest bits of the first word mark the directory.
+ *
+ * Plain neighborhoods may also carry the attributes of their edges, as columns of
+ * timestamps and weights, that follow the relations in the same order:
+ *
+ *      [u32 degree] [u32 degree] [relations x neighborship_t] [relations x i64] [relations x f32]
+ *
+ * Such neighborhoods are told apart by their length, and are never compressed or chunked.
+ */
+#pragma once
+#include <algorithm>   // `std::lower_bound`
+#include <cstdint>     // `std::uint64_t`
+#include <cstring>     // `std::memcpy`
+#include <limits>      // `std::numeric_limits`
+#include <type_traits> // `std::is_trivial`
+
+#include "ustore/graph.h"
+#include "ustore/cpp/types.hpp" // `neighborship_t`
+
+namespace unum::ustore {
+
+constexpr ustore_vertex_degree_t compressed_degree_flag_k = 1u << 31;
+constexpr std::size_t neighbors_block_k = 128;
+/// @brief Neighborhoods with fewer relations are kept plain, as they are cheap to rewrite.
+constexpr std::size_t compressed_degrees_min_k = 32;
+
+constexpr ustore_vertex_degree_t chunked_head_flag_k = 3u << 30;
+/// @brief Number of relations in a chunk, after a split.
+constexpr std::size_t neighbors_chunk_k = 4096;
+/// @brief Neighborhoods with more relations are split into chunks, so that updates touch just one of them.
+constexpr std::size_t chunked_degrees_min_k = 2 * neighbors_chunk_k;
+/// @brief Keys below this bound are reserved for chunks, and can't be used as vertex IDs.
+constexpr ustore_key_t chunk_keys_end_k = std::numeric_limits<ustore_key_t>::min() / 2;
+
+struct neighbors_block_header_t {
+    ustore_key_t first_neighbor;
+    ustore_key_t min_edge;
+    /// @brief Offset of the packed words from the start of the payloads.
+    std::uint32_t offset;
+    std::uint8_t neighbor_bits;
+    std::uint8_t edge_bits;
+    std::uint16_t count;
+};
+
+static_assert(sizeof(neighbors_block_header_t) == 24, "The header is persisted as-is");
+
+constexpr std::size_t bytes_in_compressed_header_k = 4 * sizeof(std::uint32_t);
+
+inline std::size_t packed_words(std::size_t count, std::size_t bits) noexcept {
+    return (count * bits + 63) / 64;
+}
+
+inline std::size_t bits_width(std::uint64_t value) noexcept {
+    return value ? 64 - __builtin_clzll(value) : 0;
+}
+
+inline void pack_bits(std::uint64_t const* values, std::size_t count, std::size_t bits, std::uint64_t* words) noexcept {
+    std::fill_n(words, packed_words(count, bits), 0ull);
+    if (!bits)
+        return;
+    for (std::size_t i = 0; i != count; ++i) {
+        std::size_t bit = i * bits, word = bit / 64, shift = bit % 64;
+        words[word] |= values[i] << shift;
+        if (shift + bits > 64)
+            words[word + 1] |= values[i] >> (64 - shift);
+    }
+}
+
+inline void unpack_bits(std::uint64_t const* words,
+                        std::size_t count,
+                        std::size_t bits,
+                        std::uint64_t* values) noexcept {
+    if (!bits) {
+        std::fill_n(values, count, 0ull);
+        return;
+    }
+    std::uint64_t mask = bits == 64 ? ~0ull : (1ull << bits) - 1;
+    for (std::size_t i = 0; i != count; ++i) {
+        std::size_t bit = i * bits, word = bit / 64, shift = bit % 64;
+        std::uint64_t value = words[word] >> shift;
+        if (shift + bits > 64)
+            value |= words[word + 1] << (64 - shift);
+        values[i] = value & mask;
+    }
+}
+
+inline bool is_compressed_neighborhood(value_view_t value) noexcept {
+    if (value.size() < bytes_in_compressed_header_k)
+        return false;
+    ustore_vertex_degree_t first_degree;
+    std::memcpy(&first_degree, value.data(), sizeof(first_degree));
+    return (first_degree & chunked_head_flag_k) == compressed_degree_flag_k;
+}
+
+/**
+ * @brief Upper bound for the size of a compressed neighborhood.
+ */
+inline std::size_t compressed_neighborhood_limit(std::size_t relations) noexcept {
+    std::size_t blocks = (relations + neighbors_block_k - 1) / neighbors_block_k + 2;
+    return bytes_in_compressed_header_k + blocks * (sizeof(neighbors_block_header_t) + 2 * neighbors_block_k * 8);
+}
+
+/**
+ * @brief Compresses a plain neighborhood, as defined by the @p degrees and the @p ships.
+ * @param output Must fit `compressed_neighborhood_limit()` bytes.
+ * @return Number of bytes written into the @p output.
+ */
+inline std::size_t compress_neighborhood(ustore_vertex_degree_t const* degrees,
+                                         neighborship_t const* ships,
+                                         byte_t* output) noexcept {
+
+    std::uint32_t blocks[2];
+    for (std::size_t half = 0; half != 2; ++half)
+        blocks[half] = static_cast<std::uint32_t>((degrees[half] + neighbors_block_k - 1) / neighbors_block_k);
+
+    ustore_vertex_degree_t flagged_degree = degrees[0] | compressed_degree_flag_k;
+    std::memcpy(output, &flagged_degree, sizeof(flagged_degree));
+    std::memcpy(output + 4, &degrees[1], sizeof(degrees[1]));
+    std::memcpy(output + 8, blocks, sizeof(blocks));
+
+    byte_t* headers = output + bytes_in_compressed_header_k;
+    byte_t* payloads = headers + (blocks[0] + blocks[1]) * sizeof(neighbors_block_header_t);
+    std::size_t payloads_length = 0;
+    std::uint64_t deltas[neighbors_block_k];
+    std::uint64_t edges[neighbors_block_k];
+    std::uint64_t words[neighbors_block_k];
+
+    for (std::size_t half = 0, block_idx = 0; half != 2; ++half) {
+        neighborship_t const* half_begin = ships + (half ? degrees[0] : 0);
+        for (std::size_t begin = 0; begin < degrees[half]; begin += neighbors_block_k, ++block_idx) {
+            neighborship_t const* block = half_begin + begin;
+            std::size_t count = std::min<std::size_t>(neighbors_block_k, degrees[half] - begin);
+
+            neighbors_block_header_t header;
+            header.first_neighbor = block[0].neighbor_id;
+            header.min_edge = block[0].edge_id;
+            for (std::size_t i = 0; i != count; ++i)
+                header.min_edge = std::min(header.min_edge, block[i].edge_id);
+
+            std::uint64_t max_delta = 0, max_edge = 0;
+            for (std::size_t i = 0; i != count; ++i) {
+                auto previous = static_cast<std::uint64_t>(i ? block[i - 1].neighbor_id : block[0].neighbor_id);
+                deltas[i] = static_cast<std::uint64_t>(block[i].neighbor_id) - previous;
+                edges[i] = static_cast<std::uint64_t>(block[i].edge_id) - static_cast<std::uint64_t>(header.min_edge);
+                max_delta |= deltas[i];
+                max_edge |= edges[i];
+            }
+
+            header.offset = static_cast<std::uint32_t>(payloads_length);
+            header.neighbor_bits = static_cast<std::uint8_t>(bits_width(max_delta));
+            header.edge_bits = static_cast<std::uint8_t>(bits_width(max_edge));
+            header.count = static_cast<std::uint16_t>(count);
+            std::memcpy(headers + block_idx * sizeof(header), &header, sizeof(header));
+
+            pack_bits(deltas, count, header.neighbor_bits, words);
+            std::size_t neighbor_bytes = packed_words(count, header.neighbor_bits) * 8;
+            std::memcpy(payloads + payloads_length, words, neighbor_bytes);
+            payloads_length += neighbor_bytes;
+
+            pack_bits(edges, count, header.edge_bits, words);
+            std::size_t edge_bytes = packed_words(count, header.edge_bits) * 8;
+            std::memcpy(payloads + payloads_length, words, edge_bytes);
+            payloads_length += edge_bytes;
+        }
+    }
+
+    return static_cast<std::size_t>(payloads - output) + payloads_length;
+}
+
+/**
+ * @brief Read-only view of a compressed neighborhood. Doesn't validate the contents.
+ */
+class compressed_neighborhood_t {
+    value_view_t value_;
+    ustore_vertex_degree_t degrees_[2] {};
+    std::uint32_t blocks_[2] {};
+
+    byte_t const* headers() const noexcept { return value_.data() + bytes_in_compressed_header_k; }
+    byte_t const* payloads() const noexcept {
+        return headers() + (blocks_[0] + blocks_[1]) * sizeof(neighbors_block_header_t);
+    }
+    std::size_t first_block(ustore_vertex_role_t role) const noexcept {
+        return role == ustore_vertex_target_k ? blocks_[0] : 0;
+    }
+
+  public:
+    explicit compressed_neighborhood_t(value_view_t value) noexcept : value_(value) {
+        std::memcpy(degrees_, value.data(), sizeof(degrees_));
+        std::memcpy(blocks_, value.data() + sizeof(degrees_), sizeof(blocks_));
+        degrees_[0] &= ~compressed_degree_flag_k;
+    }
+
+    ustore_vertex_degree_t const* degrees() const noexcept { return degrees_; }
+    ustore_vertex_degree_t degree(ustore_vertex_role_t role) const noexcept {
+        return (role & ustore_vertex_source_k ? degrees_[0] : 0) + (role & ustore_vertex_target_k ? degrees_[1] : 0);
+    }
+
+    /**
+     * @param role Either `::ustore_vertex_source_k` for outgoing or `::ustore_vertex_target_k` for incoming blocks.
+     */
+    std::size_t blocks(ustore_vertex_role_t role) const noexcept {
+        return role == ustore_vertex_target_k ? blocks_[1] : blocks_[0];
+    }
+
+    neighbors_block_header_t header(ustore_vertex_role_t role, std::size_t block_idx) const noexcept {
+        neighbors_block_header_t result;
+        std::memcpy(&result, headers() + (first_block(role) + block_idx) * sizeof(result), sizeof(result));
+        return result;
+    }
+
+    /**
+     * @brief Unpacks a single block into @p output.
+     * @return Number of unpacked relations.
+     */
+    std::size_t decode(ustore_vertex_role_t role, std::size_t block_idx, neighborship_t* output) const noexcept {
+        neighbors_block_header_t block = header(role, block_idx);
+        std::uint64_t words[neighbors_block_k];
+        std::uint64_t values[neighbors_block_k];
+        byte_t const* payload = payloads() + block.offset;
+
+        std::size_t neighbor_bytes = packed_words(block.count, block.neighbor_bits) * 8;
+        std::memcpy(words, payload, neighbor_bytes);
+        unpack_bits(words, block.count, block.neighbor_bits, values);
+        auto neighbor = static_cast<std::uint64_t>(block.first_neighbor);
+        for (std::size_t i = 0; i != block.count; ++i)
+            neighbor += values[i], output[i].neighbor_id = static_cast<ustore_key_t>(neighbor);
+
+        std::memcpy(words, payload + neighbor_bytes, packed_words(block.count, block.edge_bits) * 8);
+        unpack_bits(words, block.count, block.edge_bits, values);
+        for (std::size_t i = 0; i != block.count; ++i)
+            output[i].edge_id = static_cast<ustore_key_t>(static_cast<std::uint64_t>(block.min_edge) + values[i]);
+        return block.count;
+    }
+
+    /**
+     * @brief Unpacks all the relations of the @p role into @p output, sized by `degree()`.
+     */
+    void decode(ustore_vertex_role_t role, neighborship_t* output) const noexcept {
+        for (auto half : {ustore_vertex_source_k, ustore_vertex_target_k})
+            if (role & half)
+                for (std::size_t block_idx = 0; block_idx != blocks(half); ++block_idx)
+                    output += decode(half, block_idx, output);
+    }
+
+    /**
+     * @brief Size of the plain neighborhood, including the degrees header.
+     */
+    std::size_t plain_length() const noexcept {
+        return sizeof(degrees_) + (degrees_[0] + degrees_[1]) * sizeof(neighborship_t);
+    }
+
+    /**
+     * @brief Restores the plain neighborhood into @p output, sized by `plain_length()`.
+     */
+    void decode(byte_t* output) const noexcept {
+        std::memcpy(output, degrees_, sizeof(degrees_));
+        decode(ustore_vertex_role_any_k, reinterpret_cast<neighborship_t*>(output + sizeof(degrees_)));
+    }
+
+    /**
+     * @brief Counts the relations with a specific @p neighbor_id, unpacking only the blocks,
+     * which may contain it.
+     * @param role Either `::ustore_vertex_source_k` or `::ustore_vertex_target_k`.
+     */
+    std::size_t count(ustore_vertex_role_t role, ustore_key_t neighbor_id) const noexcept {
+        return count(role, neighbor_id, neighbor_id);
+    }
+
+    /**
+     * @brief Counts the occurrences of a specific relation, which is either zero or one.
+     * @param role Either `::ustore_vertex_source_k` or `::ustore_vertex_target_k`.
+     */
+    std::size_t count(ustore_vertex_role_t role, neighborship_t ship) const noexcept {
+        return count(role, ship.neighbor_id, ship);
+    }
+
+  private:
+    template <typename needle_at>
+    std::size_t count(ustore_vertex_role_t role, ustore_key_t neighbor_id, needle_at needle) const noexcept {
+        // Find the first block starting after the `neighbor_id`, the previous one may contain it
+        std::size_t blocks_count = blocks(role);
+        std::size_t low = 0, high = blocks_count;
+        while (low < high) {
+            std::size_t mid = (low + high) / 2;
+            if (header(role, mid).first_neighbor < neighbor_id)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+
+        std::size_t result = 0;
+        neighborship_t ships[neighbors_block_k];
+        for (std::size_t block_idx = low ? low - 1 : 0; block_idx < blocks_count; ++block_idx) {
+            if (header(role, block_idx).first_neighbor > neighbor_id)
+                break;
+            std::size_t count = decode(role, block_idx, ships);
+            auto range = std::equal_range(ships, ships + count, needle);
+            result += range.second - range.first;
+        }
+        return result;
+    }
+};
+
+/**
+ * @brief Starts the directory of a chunked neighborhood. Is kept trivial, as it's copied
+ * from and into raw values, so new directories must start from `empty_chunked_head_k`.
+ */
+struct chunked_head_t {
+    ustore_vertex_degree_t flag;
+    std::uint32_t chunks;
+    /// @brief Sequence number, from which the key of the next new chunk is derived.
+    std::uint32_t next_chunk;
+    std::uint32_t reserved;
+};
+
+struct chunk_ref_t {
+    /// @brief The smallest relation in the chunk, or where the chunk starts, if it is empty.
+    neighborship_t first;
+    ustore_key_t key;
+    std::uint32_t role;
+    std::uint32_t count;
+};
+
+static_assert(sizeof(chunked_head_t) == 16, "The header is persisted as-is");
+static_assert(std::is_trivial<chunked_head_t>(), "The header is copied as raw bytes");
+
+constexpr chunked_head_t empty_chunked_head_k {chunked_head_flag_k, 0, 0, 0};
+static_assert(sizeof(chunk_ref_t) == 32, "The header is persisted as-is");
+
+inline bool operator<(chunk_ref_t const& a, chunk_ref_t const& b) noexcept {
+    return a.role != b.role ? a.role < b.role : a.first < b.first;
+}
+
+inline bool is_chunked_neighborhood(value_view_t value) noexcept {
+    if (value.size() < sizeof(chunked_head_t))
+        return false;
+    ustore_vertex_degree_t first_word;
+    std::memcpy(&first_word, value.data(), sizeof(first_word));
+    return (first_word & chunked_head_flag_k) == chunked_head_flag_k;
+}
+
+/**
+ * @brief Derives the key of a new chunk of the @p vertex from its @p sequence number.
+ * Collisions are possible in theory, so the keys must be checked for presence before use.
+ */
+inline ustore_key_t chunk_key(ustore_key_t vertex, std::uint32_t sequence) noexcept {
+    // The SplitMix64 finalizer, truncated to the reserved range
+    std::uint64_t hash = static_cast<std::uint64_t>(vertex) + 0x9E3779B97F4A7C15ull * (sequence + 1ull);
+    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+    hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+    hash ^= hash >> 31;
+    auto reserved_begin = static_cast<std::uint64_t>(std::numeric_limits<ustore_key_t>::min());
+    return static_cast<ustore_key_t>(reserved_begin + (hash >> 2));
+}
+
+/**
+ * @brief Read-only view of the directory of a chunked neighborhood. Doesn't validate the contents.
+ */
+class chunked_neighborhood_t {
+    value_view_t value_;
+    chunked_head_t head_;
+
+  public:
+    explicit chunked_neighborhood_t(value_view_t value) noexcept : value_(value) {
+        std::memcpy(&head_, value.data(), sizeof(head_));
+    }
+
+    chunked_head_t const& head() const noexcept { return head_; }
+    std::size_t chunks() const noexcept { return head_.chunks; }
+    chunk_ref_t chunk(std::size_t chunk_idx) const noexcept {
+        // The `neighborship_t` isn't trivial, so the reference is copied as raw bytes
+        chunk_ref_t result;
+        byte_t const* source = value_.data() + sizeof(head_) + chunk_idx * sizeof(result);
+        std::memcpy(reinterpret_cast<byte_t*>(&result), source, sizeof(result));
+        return result;
+    }
+
+    /**
+     * @brief Plain neighborhood of relations, that were merged in without reading the chunks.
+     * Those may repeat the relations already present in chunks.
+     */
+    value_view_t pending() const noexcept {
+        std::size_t offset = sizeof(head_) + head_.chunks * sizeof(chunk_ref_t);
+        return {value_.data() + offset, value_.size() - offset};
+    }
+
+    /**
+     * @brief Number of relations in chunks, excluding the `pending()` ones.
+     */
+    std::size_t degree(ustore_vertex_role_t role) const noexcept {
+        std::size_t result = 0;
+        for (std::size_t chunk_idx = 0; chunk_idx != chunks(); ++chunk_idx) {
+            chunk_ref_t ref = chunk(chunk_idx);
+            result += (ref.role & role) ? ref.count : 0;
+        }
+        return result;
+    }
+
+    static std::size_t length(std::size_t chunks, std::size_t pending_length) noexcept {
+        return sizeof(chunked_head_t) + chunks * sizeof(chunk_ref_t) + pending_length;
+    }
+
+    /**
+     * @brief Serializes a directory into @p output, sized by `length()`.
+     */
+    static void write(chunked_head_t head, chunk_ref_t const* refs, value_view_t pending, byte_t* output) noexcept {
+        std::memcpy(output, &head, sizeof(head));
+        std::memcpy(output + sizeof(head), refs, head.chunks * sizeof(chunk_ref_t));
+        if (pending.size())
+            std::memcpy(output + sizeof(head) + head.chunks * sizeof(chunk_ref_t), pending.data(), pending.size());
+    }
+};
+
+/**
+ * @brief Attributes of a single edge, stored in the columns of an attributed neighborhood.
+ * Edges, that were never given any, have the default ones.
+ */
+struct edge_attributes_t {
+    std::int64_t timestamp = 0;
+    ustore_float_t weight = 1;
+};
+
+constexpr std::size_t bytes_per_relation_k = sizeof(neighborship_t);
+constexpr std::size_t bytes_per_attributes_k = sizeof(std::int64_t) + sizeof(ustore_float_t);
+
+inline std::size_t plain_neighborhood_length(std::size_t relations) noexcept {
+    return 2 * sizeof(ustore_vertex_degree_t) + relations * bytes_per_relation_k;
+}
+
+inline std::size_t attributed_neighborhood_length(std::size_t relations) noexcept {
+    return plain_neighborhood_length(relations) + relations * bytes_per_attributes_k;
+}
+
+inline std::size_t plain_relations(value_view_t value) noexcept {
+    ustore_vertex_degree_t degrees[2];
+    std::memcpy(degrees, value.data(), sizeof(degrees));
+    return std::size_t(degrees[0]) + degrees[1];
+}
+
+inline bool is_attributed_neighborhood(value_view_t value) noexcept {
+    if (value.size() <= plain_neighborhood_length(0))
+        return false;
+    if (is_compressed_neighborhood(value) || is_chunked_neighborhood(value))
+        return false;
+    return value.size() == attributed_neighborhood_length(plain_relations(value));
+}
+
+/**
+ * @brief Read-only view of the attribute columns of a plain neighborhood.
+ * Neighborhoods without attributes report the default ones for every relation.
+ */
+class attributed_neighborhood_t {
+    byte_t const* columns_ = nullptr;
+    std::size_t relations_ = 0;
+
+  public:
+    explicit attributed_neighborhood_t(value_view_t value) noexcept {
+        if (!is_attributed_neighborhood(value))
+            return;
+        relations_ = plain_relations(value);
+        columns_ = value.data() + plain_neighborhood_length(relations_);
+    }
+
+    explicit operator bool() const noexcept { return columns_; }
+
+    /**
+     * @param relation_idx Offset of the relation among all the relations, outgoing ones first.
+     */
+    edge_attributes_t operator[](std::size_t relation_idx) const noexcept {
+        edge_attributes_t result;
+        if (!columns_)
+            return result;
+        std::memcpy(&result.timestamp, columns_ + relation_idx * sizeof(std::int64_t), sizeof(std::int64_t));
+        std::memcpy(&result.weight,
+                    columns_ + relations_ * sizeof(std::int64_t) + relation_idx * sizeof(ustore_float_t),
+                    sizeof(ustore_float_t));
+        return result;
+    }
+
+    /**
+     * @brief Fills the columns of a neighborhood of @p relations, placing them after the relations
+     * in the @p output, sized by `attributed_neighborhood_length()`.
+     */
+    template <typename attributes_of_at>
+    static void write_columns(std::size_t relations, attributes_of_at&& attributes_of, byte_t* output) noexcept {
+        byte_t* timestamps = output + plain_neighborhood_length(relations);
+        byte_t* weights = timestamps + relations * sizeof(std::int64_t);
+        for (std::size_t relation_idx = 0; relation_idx != relations; ++relation_idx) {
+            edge_attributes_t attributes = attributes_of(relation_idx);
+            std::memcpy(timestamps + relation_idx * sizeof(std::int64_t), &attributes.timestamp, sizeof(std::int64_t));
+            std::memcpy(weights + relation_idx * sizeof(ustore_float_t), &attributes.weight, sizeof(ustore_float_t));
+        }
+    }
+};
+
+} // namespace unum::ustore
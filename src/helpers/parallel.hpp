@@ -0,0 +1,204 @@
+/**
+ * @file parallel.hpp
+ * @author Ashot Vardanian
+ *
+ * @brief Primitives for spreading independent tasks across hardware threads.
+ */
+#pragma once
+#include <algorithm>          // `std::min`
+#include <atomic>             // `std::atomic`
+#include <condition_variable> // `std::condition_variable`
+#include <cstring>            // `std::memmove`
+#include <mutex>              // `std::mutex`
+#include <thread>             // `std::thread`
+#include <type_traits>        // `std::remove_reference_t`
+#include <utility>            // `std::exchange`
+#include <vector>             // `std::vector`
+
+#include "ustore/cpp/ranges_args.hpp" // `scans_arg_t`
+#include "helpers/linked_memory.hpp"  // `safe_section`
+
+namespace unum::ustore {
+
+/**
+ * @brief Calls @p callback with every index in `[0, count)`, spreading them
+ * across all hardware threads, including the calling one.
+ */
+template <typename callback_at>
+void parallel_for(std::size_t count, callback_at&& callback) noexcept(false) {
+    std::size_t threads_count = std::thread::hardware_concurrency();
+    threads_count = std::max<std::size_t>(1, std::min<std::size_t>(threads_count, count));
+    std::atomic<std::size_t> next_idx {0};
+    auto run_in_thread = [&] {
+        std::size_t idx;
+        while ((idx = next_idx.fetch_add(1)) < count)
+            callback(idx);
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(threads_count - 1);
+    for (std::size_t thread_idx = 1; thread_idx < threads_count; ++thread_idx)
+        threads.emplace_back(run_in_thread);
+    run_in_thread();
+    for (auto& thread : threads)
+        thread.join();
+}
+
+/**
+ * @brief A fixed set of worker threads, reused between calls, for latency-sensitive
+ * batches, where spawning threads on every call would cost more than the work itself.
+ * Runs one `for_each()` at a time, concurrent callers wait for their turn.
+ */
+class thread_pool_t {
+
+    using job_t = void (*)(void*, std::size_t);
+
+    std::vector<std::thread> workers_;
+    std::mutex submitting_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    std::size_t generation_ = 0;
+    std::size_t running_ = 0;
+    bool stopping_ = false;
+
+    job_t job_ = nullptr;
+    void* job_context_ = nullptr;
+    std::size_t count_ = 0;
+    std::atomic<std::size_t> next_idx_ {0};
+
+    void drain() noexcept {
+        std::size_t idx;
+        while ((idx = next_idx_.fetch_add(1)) < count_)
+            job_(job_context_, idx);
+    }
+
+    void work() noexcept {
+        std::size_t seen_generation = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock {mutex_};
+                wake_.wait(lock, [&] { return stopping_ || generation_ != seen_generation; });
+                if (stopping_)
+                    return;
+                seen_generation = generation_;
+            }
+            drain();
+            std::lock_guard<std::mutex> lock {mutex_};
+            if (--running_ == 0)
+                done_.notify_one();
+        }
+    }
+
+  public:
+    /**
+     * @param threads_count Including the calling thread, so one means no workers.
+     */
+    explicit thread_pool_t(std::size_t threads_count) noexcept(false) {
+        threads_count = std::max<std::size_t>(threads_count, 1);
+        workers_.reserve(threads_count - 1);
+        for (std::size_t thread_idx = 1; thread_idx < threads_count; ++thread_idx)
+            workers_.emplace_back([this] { work(); });
+    }
+    thread_pool_t(thread_pool_t const&) = delete;
+    thread_pool_t& operator=(thread_pool_t const&) = delete;
+
+    ~thread_pool_t() noexcept {
+        {
+            std::lock_guard<std::mutex> lock {mutex_};
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (auto& worker : workers_)
+            worker.join();
+    }
+
+    std::size_t size() const noexcept { return workers_.size() + 1; }
+
+    /**
+     * @brief Calls @p callback with every index in `[0, count)`, on the workers
+     * and the calling thread. The @p callback must not throw.
+     */
+    template <typename callback_at>
+    void for_each(std::size_t count, callback_at&& callback) noexcept {
+        if (workers_.empty() || count < 2) {
+            for (std::size_t idx = 0; idx != count; ++idx)
+                callback(idx);
+            return;
+        }
+
+        using callback_t = std::remove_reference_t<callback_at>;
+        std::lock_guard<std::mutex> submitting {submitting_};
+        {
+            std::lock_guard<std::mutex> lock {mutex_};
+            job_ = [](void* context, std::size_t idx) { (*static_cast<callback_t*>(context))(idx); };
+            job_context_ = const_cast<void*>(static_cast<void const*>(&callback));
+            count_ = count;
+            next_idx_.store(0);
+            running_ = workers_.size();
+            ++generation_;
+        }
+        wake_.notify_all();
+        drain();
+
+        std::unique_lock<std::mutex> lock {mutex_};
+        done_.wait(lock, [&] { return running_ == 0; });
+    }
+};
+
+/**
+ * @brief Implements `ustore_option_scan_bulk_k`, running the tasks of a single
+ * `ustore_scan()` concurrently. Every task fills its own region of the @p keys
+ * tape, sized by its limit, and the regions are then compacted, so that the
+ * outputs are laid out exactly like in a sequential scan.
+ *
+ * @param offsets, counts May be dummies, so are only written into.
+ * @param scan_one Receives the task index, the output keys and an error slot,
+ * returns the number of exported keys. May throw.
+ */
+template <typename offsets_at, typename counts_at, typename scan_one_at>
+void scan_in_parallel(scans_arg_t const& tasks,
+                      offsets_at&& offsets,
+                      counts_at&& counts,
+                      ustore_key_t* keys,
+                      ustore_error_t* c_error,
+                      scan_one_at&& scan_one) noexcept {
+
+    std::vector<ustore_length_t> reserved_offsets;
+    std::vector<ustore_length_t> found_counts;
+    std::vector<ustore_error_t> errors;
+    safe_section("Scanning in parallel", c_error, [&] {
+        reserved_offsets.resize(tasks.count);
+        found_counts.resize(tasks.count, 0);
+        errors.resize(tasks.count, nullptr);
+
+        ustore_length_t reserved_offset = 0;
+        for (std::size_t task_idx = 0; task_idx != tasks.count; ++task_idx)
+            reserved_offsets[task_idx] = std::exchange(reserved_offset, reserved_offset + tasks[task_idx].limit);
+
+        parallel_for(tasks.count, [&](std::size_t task_idx) {
+            ustore_error_t* c_task_error = &errors[task_idx];
+            safe_section("Scanning a shard", c_task_error, [&] {
+                found_counts[task_idx] = scan_one(task_idx, keys + reserved_offsets[task_idx], c_task_error);
+            });
+        });
+    });
+    return_if_error_m(c_error);
+
+    for (ustore_error_t error : errors)
+        return_error_if_m(!error, c_error, error_unknown_k, error);
+
+    ustore_length_t exported_offset = 0;
+    for (std::size_t task_idx = 0; task_idx != tasks.count; ++task_idx) {
+        std::memmove(keys + exported_offset,
+                     keys + reserved_offsets[task_idx],
+                     found_counts[task_idx] * sizeof(ustore_key_t));
+        offsets[task_idx] = exported_offset;
+        counts[task_idx] = found_counts[task_idx];
+        exported_offset += found_counts[task_idx];
+    }
+    offsets[tasks.count] = exported_offset;
+}
+
+} // namespace unum::ustore
@@ -0,0 +1,172 @@
+/**
+ * @file product_quantizer.hpp
+ * @author Ashot Vardanian
+ *
+ * @brief Product Quantization of dense vectors with asymmetric distance tables.
+ * https://doi.org/10.1109/TPAMI.2010.57
+ *
+ * Every vector is split into equal slices, or "sub-spaces", and each slice
+ * is replaced with the one-byte index of the closest centroid, out of up to
+ * 256 trained for that sub-space. A 768-dimensional vector with 96 sub-spaces
+ * thus takes 96 bytes. Queries are never encoded. Instead, their slices are
+ * compared to every centroid once, and the distance to any encoded vector is
+ * then a sum of table lookups.
+ */
+#pragma once
+#include <algorithm> // `std::min`
+#include <cstdint>   // `std::uint8_t`
+#include <limits>    // `std::numeric_limits`
+#include <vector>    // `std::vector`
+
+#include "helpers/parallel.hpp" // `parallel_for`
+
+namespace unum::ustore {
+
+class product_quantizer_t {
+  public:
+    static constexpr std::size_t centroids_k = 256;
+    static constexpr std::size_t train_iterations_k = 8;
+    /// @brief Training uses at most this many vectors per centroid, sampled evenly from the inputs.
+    static constexpr std::size_t train_samples_per_centroid_k = 16;
+
+  private:
+    std::size_t dimensions_ = 0;
+    std::size_t subspaces_ = 0;
+    /// @brief Row-major `[subspaces x centroids x slice]` matrix.
+    std::vector<float> codebooks_;
+
+    float const* centroid(std::size_t subspace, std::size_t idx) const noexcept {
+        return codebooks_.data() + (subspace * centroids_k + idx) * slice();
+    }
+    float* centroid(std::size_t subspace, std::size_t idx) noexcept {
+        return codebooks_.data() + (subspace * centroids_k + idx) * slice();
+    }
+
+    static float squared_distance(float const* a, float const* b, std::size_t n) noexcept {
+        float d2 = 0;
+        for (std::size_t i = 0; i != n; ++i)
+            d2 += (a[i] - b[i]) * (a[i] - b[i]);
+        return d2;
+    }
+
+    std::uint8_t closest(std::size_t subspace, float const* slice_begin) const noexcept {
+        std::size_t closest_idx = 0;
+        float closest_distance = std::numeric_limits<float>::max();
+        for (std::size_t idx = 0; idx != centroids_k; ++idx) {
+            float d2 = squared_distance(slice_begin, centroid(subspace, idx), slice());
+            if (d2 < closest_distance)
+                closest_idx = idx, closest_distance = d2;
+        }
+        return static_cast<std::uint8_t>(closest_idx);
+    }
+
+  public:
+    product_quantizer_t() = default;
+    product_quantizer_t(std::size_t dimensions, std::size_t subspaces)
+        : dimensions_(dimensions), subspaces_(subspaces), codebooks_(dimensions * centroids_k) {}
+
+    std::size_t dimensions() const noexcept { return dimensions_; }
+    std::size_t subspaces() const noexcept { return subspaces_; }
+    std::size_t slice() const noexcept { return dimensions_ / subspaces_; }
+
+    float const* codebooks() const noexcept { return codebooks_.data(); }
+    float* codebooks() noexcept { return codebooks_.data(); }
+    std::size_t codebooks_bytes() const noexcept { return codebooks_.size() * sizeof(float); }
+
+    /**
+     * @brief Fits the codebooks with Lloyd's k-means, seeded with evenly spaced inputs.
+     * If there are fewer than 256 @p vectors, some centroids are duplicated.
+     * @param vectors Row-major matrix of `count x dimensions` floats.
+     */
+    void train(float const* vectors, std::size_t count) {
+        if (!count)
+            return;
+
+        std::size_t samples_count = std::min(count, centroids_k * train_samples_per_centroid_k);
+        auto sample = [&](std::size_t idx) noexcept {
+            return vectors + (idx * count / samples_count) * dimensions_;
+        };
+
+        for (std::size_t subspace = 0; subspace != subspaces_; ++subspace)
+            for (std::size_t idx = 0; idx != centroids_k; ++idx)
+                std::copy_n(sample(idx * samples_count / centroids_k) + subspace * slice(),
+                            slice(),
+                            centroid(subspace, idx));
+
+        std::vector<std::uint8_t> assignments(samples_count * subspaces_);
+        std::vector<float> sums(slice() * centroids_k);
+        std::vector<std::size_t> counts(centroids_k);
+        for (std::size_t iteration = 0; iteration != train_iterations_k; ++iteration) {
+            parallel_for(samples_count, [&](std::size_t sample_idx) {
+                for (std::size_t subspace = 0; subspace != subspaces_; ++subspace)
+                    assignments[sample_idx * subspaces_ + subspace] =
+                        closest(subspace, sample(sample_idx) + subspace * slice());
+            });
+
+            // Empty clusters keep their previous centroids
+            for (std::size_t subspace = 0; subspace != subspaces_; ++subspace) {
+                std::fill(sums.begin(), sums.end(), 0.f);
+                std::fill(counts.begin(), counts.end(), 0u);
+                for (std::size_t sample_idx = 0; sample_idx != samples_count; ++sample_idx) {
+                    std::size_t idx = assignments[sample_idx * subspaces_ + subspace];
+                    float const* slice_begin = sample(sample_idx) + subspace * slice();
+                    for (std::size_t i = 0; i != slice(); ++i)
+                        sums[idx * slice() + i] += slice_begin[i];
+                    counts[idx]++;
+                }
+                for (std::size_t idx = 0; idx != centroids_k; ++idx)
+                    if (counts[idx])
+                        for (std::size_t i = 0; i != slice(); ++i)
+                            centroid(subspace, idx)[i] = sums[idx * slice() + i] / counts[idx];
+            }
+        }
+    }
+
+    /**
+     * @brief Exports one byte per sub-space into @p codes.
+     * @return Squared norm of the reconstructed vector.
+     */
+    float encode(float const* vector, std::uint8_t* codes) const noexcept {
+        float squared_norm = 0;
+        for (std::size_t subspace = 0; subspace != subspaces_; ++subspace) {
+            codes[subspace] = closest(subspace, vector + subspace * slice());
+            float const* reconstructed = centroid(subspace, codes[subspace]);
+            for (std::size_t i = 0; i != slice(); ++i)
+                squared_norm += reconstructed[i] * reconstructed[i];
+        }
+        return squared_norm;
+    }
+
+    /**
+     * @brief Fills the `[subspaces x 256]` table of partial inner products between
+     * the @p query and the centroids or, if @p squared_distances, the partial squared
+     * Euclidean distances.
+     */
+    void tabulate(float const* query, bool squared_distances, float* table) const noexcept {
+        for (std::size_t subspace = 0; subspace != subspaces_; ++subspace) {
+            float const* slice_begin = query + subspace * slice();
+            for (std::size_t idx = 0; idx != centroids_k; ++idx) {
+                float const* center = centroid(subspace, idx);
+                float partial = 0;
+                if (squared_distances)
+                    partial = squared_distance(slice_begin, center, slice());
+                else
+                    for (std::size_t i = 0; i != slice(); ++i)
+                        partial += slice_begin[i] * center[i];
+                table[subspace * centroids_k + idx] = partial;
+            }
+        }
+    }
+
+    /**
+     * @brief Sums the entries of a @p table, produced by `tabulate()`, addressed by the @p codes.
+     */
+    static float lookup(float const* table, std::uint8_t const* codes, std::size_t subspaces) noexcept {
+        float sum = 0;
+        for (std::size_t subspace = 0; subspace != subspaces; ++subspace)
+            sum += table[subspace * centroids_k + codes[subspace]];
+        return sum;
+    }
+};
+
+} // namespace unum::ustore
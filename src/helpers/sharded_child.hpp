@@ -0,0 +1,87 @@
+/**
+ * @file sharded_child.hpp
+ * @author Ashot Vardanian
+ *
+ * @brief Renames the C API of an engine, so that `engine_sharded.cpp` can link
+ * it into the same library and drive many instances of it as shards.
+ *
+ * The child engine source is compiled a second time with `USTORE_SHARD_CHILD`
+ * defined and this header force-included before anything else. All of its
+ * `ustore_*` entry points become `ustore_shard_*`, while the modalities and the
+ * public symbols of the library belong to the sharded meta-engine. Without the
+ * macro, the header only declares the renamed functions for the meta-engine.
+ */
+#pragma once
+
+#if defined(USTORE_SHARD_CHILD)
+
+#define ustore_database_init ustore_shard_database_init
+#define ustore_database_control ustore_shard_database_control
+#define ustore_get_metadata ustore_shard_get_metadata
+#define ustore_snapshot_list ustore_shard_snapshot_list
+#define ustore_snapshot_create ustore_shard_snapshot_create
+#define ustore_snapshot_export ustore_shard_snapshot_export
+#define ustore_snapshot_drop ustore_shard_snapshot_drop
+#define ustore_read ustore_shard_read
+#define ustore_write ustore_shard_write
+#define ustore_scan ustore_shard_scan
+#define ustore_sample ustore_shard_sample
+#define ustore_measure ustore_shard_measure
+#define ustore_erase_range ustore_shard_erase_range
+#define ustore_collection_create ustore_shard_collection_create
+#define ustore_collection_drop ustore_shard_collection_drop
+#define ustore_collection_list ustore_shard_collection_list
+#define ustore_transaction_init ustore_shard_transaction_init
+#define ustore_transaction_stage ustore_shard_transaction_stage
+#define ustore_transaction_commit ustore_shard_transaction_commit
+#define ustore_changes_subscribe ustore_shard_changes_subscribe
+#define ustore_changes_poll ustore_shard_changes_poll
+#define ustore_changes_free ustore_shard_changes_free
+#define ustore_arena_free ustore_shard_arena_free
+#define ustore_arena_reset ustore_shard_arena_reset
+#define ustore_transaction_free ustore_shard_transaction_free
+#define ustore_database_free ustore_shard_database_free
+#define ustore_error_free ustore_shard_error_free
+
+#else
+
+#include "ustore/db.h"
+#include "ustore/blobs.h"
+#include "ustore/changes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void ustore_shard_database_init(ustore_database_init_t*);
+void ustore_shard_database_control(ustore_database_control_t*);
+void ustore_shard_get_metadata(ustore_get_metadata_t*);
+void ustore_shard_snapshot_list(ustore_snapshot_list_t*);
+void ustore_shard_snapshot_create(ustore_snapshot_create_t*);
+void ustore_shard_snapshot_export(ustore_snapshot_export_t*);
+void ustore_shard_snapshot_drop(ustore_snapshot_drop_t*);
+void ustore_shard_read(ustore_read_t*);
+void ustore_shard_write(ustore_write_t*);
+void ustore_shard_scan(ustore_scan_t*);
+void ustore_shard_sample(ustore_sample_t*);
+void ustore_shard_measure(ustore_measure_t*);
+void ustore_shard_erase_range(ustore_erase_range_t*);
+void ustore_shard_collection_create(ustore_collection_create_t*);
+void ustore_shard_collection_drop(ustore_collection_drop_t*);
+void ustore_shard_collection_list(ustore_collection_list_t*);
+void ustore_shard_transaction_init(ustore_transaction_init_t*);
+void ustore_shard_transaction_stage(ustore_transaction_stage_t*);
+void ustore_shard_transaction_commit(ustore_transaction_commit_t*);
+void ustore_shard_changes_subscribe(ustore_changes_subscribe_t*);
+void ustore_shard_changes_poll(ustore_changes_poll_t*);
+void ustore_shard_changes_free(ustore_changes_t);
+void ustore_shard_arena_free(ustore_arena_t);
+void ustore_shard_arena_reset(ustore_arena_t);
+void ustore_shard_transaction_free(ustore_transaction_t);
+void ustore_shard_database_free(ustore_database_t);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+
+#endif
@@ -0,0 +1,237 @@
+/**
+ * @file stats.hpp
+ * @author Ashot Vardanian
+ *
+ * @brief Cheap operation counters and latency histograms for the engines,
+ * exported through `ustore_database_control()`.
+ *
+ * ## Control Requests
+ *
+ * The request is a JSON object, like `{"stats": ["memory", "ops", "latency"]}`.
+ * An empty list, or `{"stats": true}`, selects all sections. The response is
+ * a JSON object with a member per requested section:
+ * - "memory":  Per-collection key counts and bytes, arenas and engine caches.
+ * - "ops":     Calls, batched tasks and failures per operation kind.
+ * - "latency": Approximate p50, p99 and max latencies in nanoseconds.
+ */
+#pragma once
+#include <array>   // `std::array`
+#include <atomic>  // `std::atomic`
+#include <chrono>  // `std::chrono::steady_clock`
+#include <cstring> // `std::memcpy`
+#include <memory>  // `std::unique_ptr`
+#include <string>  // `std::string`
+
+#include <nlohmann/json.hpp> // `nlohmann::json`
+
+#include "ustore/db.h"
+#include "helpers/linked_memory.hpp" // `linked_memory_lock_t`
+#include "helpers/mutex.hpp"         // `thread_index`
+#include "helpers/trace.hpp"         // `trace_scope_t`
+
+namespace unum::ustore {
+
+enum class stats_op_t : std::size_t {
+    read_k = 0,
+    write_k,
+    scan_k,
+    sample_k,
+    commit_k,
+};
+
+inline static constexpr std::size_t stats_ops_k = 5;
+inline static constexpr std::array<char const*, stats_ops_k> stats_op_names_k {
+    "read",
+    "write",
+    "scan",
+    "sample",
+    "commit",
+};
+
+/**
+ * @brief Sharded counters, where every thread only touches its own cache lines
+ * with relaxed atomic increments, so that the hot path isn't slowed down.
+ * Latencies are collected into log-linear histograms, with 4 buckets per
+ * power of two, bounding the relative error of percentiles to 25%.
+ */
+class engine_stats_t {
+
+    static constexpr std::size_t shards_k = 16;
+    static constexpr std::size_t sub_buckets_log2_k = 2;
+    static constexpr std::size_t sub_buckets_k = 1ul << sub_buckets_log2_k;
+    static constexpr std::size_t buckets_k = 64 * sub_buckets_k;
+
+    using counter_t = std::atomic<std::uint64_t>;
+
+    struct alignas(64) shard_t {
+        counter_t calls[stats_ops_k];
+        counter_t tasks[stats_ops_k];
+        counter_t failures[stats_ops_k];
+        counter_t latencies[stats_ops_k][buckets_k];
+    };
+
+    std::unique_ptr<shard_t[]> shards_ = std::make_unique<shard_t[]>(shards_k);
+
+    static std::size_t bucket(std::uint64_t nanoseconds) noexcept {
+        if (nanoseconds < sub_buckets_k)
+            return nanoseconds;
+        std::size_t msb = 63 - __builtin_clzll(nanoseconds);
+        std::size_t sub = (nanoseconds >> (msb - sub_buckets_log2_k)) & (sub_buckets_k - 1);
+        return (msb - sub_buckets_log2_k + 1) * sub_buckets_k + sub;
+    }
+
+    static std::uint64_t bucket_min(std::size_t idx) noexcept {
+        if (idx < sub_buckets_k)
+            return idx;
+        std::size_t msb = idx / sub_buckets_k + sub_buckets_log2_k - 1;
+        std::uint64_t sub = idx % sub_buckets_k;
+        return (sub_buckets_k + sub) << (msb - sub_buckets_log2_k);
+    }
+
+    static std::uint64_t sum(counter_t const& counter) noexcept { return counter.load(std::memory_order_relaxed); }
+
+  public:
+    void record(stats_op_t op, std::size_t tasks, std::uint64_t nanoseconds, bool failed) noexcept {
+        shard_t& shard = shards_[thread_index() % shards_k];
+        auto op_idx = static_cast<std::size_t>(op);
+        shard.calls[op_idx].fetch_add(1, std::memory_order_relaxed);
+        shard.tasks[op_idx].fetch_add(tasks, std::memory_order_relaxed);
+        if (failed)
+            shard.failures[op_idx].fetch_add(1, std::memory_order_relaxed);
+        shard.latencies[op_idx][bucket(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Exports the "ops" section. Failed commits are reported as aborts.
+     */
+    nlohmann::json ops_json() const {
+        nlohmann::json result = nlohmann::json::object();
+        for (std::size_t op_idx = 0; op_idx != stats_ops_k; ++op_idx) {
+            std::uint64_t calls = 0, tasks = 0, failures = 0;
+            for (std::size_t shard_idx = 0; shard_idx != shards_k; ++shard_idx) {
+                calls += sum(shards_[shard_idx].calls[op_idx]);
+                tasks += sum(shards_[shard_idx].tasks[op_idx]);
+                failures += sum(shards_[shard_idx].failures[op_idx]);
+            }
+            nlohmann::json& op = result[stats_op_names_k[op_idx]];
+            op["calls"] = calls;
+            op["tasks"] = tasks;
+            op["failures"] = failures;
+            if (op_idx == static_cast<std::size_t>(stats_op_t::commit_k))
+                op["abort_rate"] = calls ? double(failures) / double(calls) : 0.0;
+        }
+        return result;
+    }
+
+    nlohmann::json latency_json() const {
+        nlohmann::json result = nlohmann::json::object();
+        for (std::size_t op_idx = 0; op_idx != stats_ops_k; ++op_idx) {
+            std::array<std::uint64_t, buckets_k> histogram {};
+            std::uint64_t total = 0;
+            for (std::size_t bucket_idx = 0; bucket_idx != buckets_k; ++bucket_idx) {
+                for (std::size_t shard_idx = 0; shard_idx != shards_k; ++shard_idx)
+                    histogram[bucket_idx] += sum(shards_[shard_idx].latencies[op_idx][bucket_idx]);
+                total += histogram[bucket_idx];
+            }
+
+            auto percentile = [&](double fraction) -> std::uint64_t {
+                auto wanted = static_cast<std::uint64_t>(fraction * total);
+                std::uint64_t seen = 0;
+                for (std::size_t bucket_idx = 0; bucket_idx != buckets_k; ++bucket_idx)
+                    if ((seen += histogram[bucket_idx]) > wanted)
+                        return bucket_min(bucket_idx);
+                return 0;
+            };
+
+            nlohmann::json& op = result[stats_op_names_k[op_idx]];
+            op["p50_ns"] = percentile(0.5);
+            op["p99_ns"] = percentile(0.99);
+            op["max_ns"] = percentile(1.0 - 1.0 / std::max<double>(total, 1));
+        }
+        return result;
+    }
+};
+
+/**
+ * @brief Measures the lifetime of an API call, recording it into `engine_stats_t`.
+ * The call is considered failed, if the error is set by the time it returns.
+ * In `USTORE_USE_TRACING` builds the call is also traced as a span.
+ */
+class stats_timer_t {
+    using clock_t = std::chrono::steady_clock;
+
+    engine_stats_t& stats_;
+    stats_op_t op_;
+    std::size_t tasks_;
+    ustore_error_t* c_error_;
+    clock_t::time_point start_ = clock_t::now();
+    trace_scope_t trace_;
+
+  public:
+    stats_timer_t(engine_stats_t& stats, stats_op_t op, std::size_t tasks, ustore_error_t* c_error) noexcept
+        : stats_(stats), op_(op), tasks_(tasks), c_error_(c_error),
+          trace_(stats_op_names_k[static_cast<std::size_t>(op)]) {}
+    stats_timer_t(stats_timer_t const&) = delete;
+    stats_timer_t& operator=(stats_timer_t const&) = delete;
+
+    ~stats_timer_t() noexcept {
+        auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(clock_t::now() - start_).count();
+        stats_.record(op_, tasks_, static_cast<std::uint64_t>(nanoseconds), c_error_ && *c_error_);
+    }
+};
+
+struct stats_request_t {
+    bool memory = false;
+    bool ops = false;
+    bool latency = false;
+};
+
+/**
+ * @brief Parses the `{"stats": [...]}` control request.
+ * @return `false` if the request has a different form.
+ */
+inline bool parse_stats_request(ustore_str_view_t request, stats_request_t& parsed) noexcept {
+    auto js = nlohmann::json::parse(request, nullptr, false);
+    if (js.is_discarded() || !js.is_object() || !js.contains("stats"))
+        return false;
+
+    auto const& sections = js["stats"];
+    bool all = (sections.is_boolean() && sections.get<bool>()) || (sections.is_array() && sections.empty());
+    parsed.memory = all;
+    parsed.ops = all;
+    parsed.latency = all;
+    if (!sections.is_array())
+        return sections.is_boolean();
+
+    for (auto const& section : sections) {
+        if (!section.is_string())
+            return false;
+        auto const& name = section.get_ref<std::string const&>();
+        if (name == "memory")
+            parsed.memory = true;
+        else if (name == "ops")
+            parsed.ops = true;
+        else if (name == "latency")
+            parsed.latency = true;
+        else
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Copies the NULL-terminated @p response into the arena.
+ */
+inline void export_control_response(std::string const& response,
+                                    ustore_arena_t* c_arena,
+                                    ustore_str_view_t* c_response,
+                                    ustore_error_t* c_error) noexcept {
+    linked_memory_lock_t arena = linked_memory(c_arena, ustore_options_default_k, c_error);
+    return_if_error_m(c_error);
+    auto exported = arena.alloc<char>(response.size() + 1, c_error);
+    return_if_error_m(c_error);
+    std::memcpy(exported.begin(), response.c_str(), response.size() + 1);
+    *c_response = exported.begin();
+}
+
+} // namespace unum::ustore
@@ -0,0 +1,212 @@
+/**
+ * @file trace.hpp
+ * @author Ashot Vardanian
+ *
+ * @brief Optional instrumentation of the hot paths, enabled by `USTORE_USE_TRACING`.
+ *
+ * Every traced phase, like an engine call, an arena growth or a JSON parsing pass,
+ * is a "span". When tracing is enabled, spans are:
+ * - reported to USDT probes `ustore:span__begin` and `ustore:span__end`,
+ *   if `<sys/sdt.h>` is available, so eBPF tools can attach without restarts;
+ * - recorded into a per-thread ring buffer of the last `trace_ring_t::capacity_k`
+ *   spans, that can be exported in the Chrome Trace Event format, which
+ *   Perfetto and "chrome://tracing" understand.
+ *
+ * Spans carry the request ID of the calling thread, which servers propagate
+ * from their clients with `trace_request_scope_t`.
+ *
+ * When disabled, `trace_span_m` expands into nothing and costs nothing.
+ */
+#pragma once
+#include <algorithm> // `std::min`
+#include <chrono>    // `std::chrono::steady_clock`
+#include <cstdint>   // `std::uint64_t`
+#include <cstdio>    // `std::snprintf`
+#include <memory>    // `std::shared_ptr`
+#include <mutex>     // `std::mutex`
+#include <string>    // `std::string`
+#include <utility>   // `std::exchange`
+#include <vector>    // `std::vector`
+
+#include "helpers/mutex.hpp" // `thread_index`
+
+#if USTORE_USE_TRACING && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define ustore_probe_begin_m(name, request_id) DTRACE_PROBE2(ustore, span__begin, name, request_id)
+#define ustore_probe_end_m(name, request_id, nanoseconds) \
+    DTRACE_PROBE3(ustore, span__end, name, request_id, nanoseconds)
+#endif
+#endif
+
+#if !defined(ustore_probe_begin_m)
+#define ustore_probe_begin_m(name, request_id)
+#define ustore_probe_end_m(name, request_id, nanoseconds)
+#endif
+
+namespace unum::ustore {
+
+struct trace_span_t {
+    /// @brief Static string, naming the phase, like "read" or "docs.parse".
+    char const* name = nullptr;
+    std::uint64_t request_id = 0;
+    std::uint64_t begin_ns = 0;
+    std::uint64_t duration_ns = 0;
+};
+
+/**
+ * @brief Fixed-capacity buffer of the most recent spans of one thread.
+ * The lock is only contended, while the spans are being exported.
+ */
+class trace_ring_t {
+  public:
+    static constexpr std::size_t capacity_k = 16 * 1024;
+
+  private:
+    std::mutex mutex_;
+    std::vector<trace_span_t> spans_ = std::vector<trace_span_t>(capacity_k);
+    std::size_t pushed_ = 0;
+    std::size_t thread_ = thread_index();
+
+  public:
+    void push(trace_span_t const& span) noexcept {
+        std::lock_guard<std::mutex> lock {mutex_};
+        spans_[pushed_++ % capacity_k] = span;
+    }
+
+    template <typename callback_at>
+    void for_each(callback_at&& callback) {
+        std::lock_guard<std::mutex> lock {mutex_};
+        std::size_t count = pushed_ < capacity_k ? pushed_ : capacity_k;
+        for (std::size_t i = pushed_ - count; i != pushed_; ++i)
+            callback(spans_[i % capacity_k]);
+    }
+
+    std::size_t thread() const noexcept { return thread_; }
+};
+
+/**
+ * @brief Process-wide list of the rings of all threads, that have recorded spans.
+ * Rings are shared, so the spans of exited threads can still be exported.
+ */
+struct trace_registry_t {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<trace_ring_t>> rings;
+
+    static trace_registry_t& global() noexcept {
+        static trace_registry_t registry;
+        return registry;
+    }
+
+    static trace_ring_t& local() noexcept(false) {
+        thread_local std::shared_ptr<trace_ring_t> ring = [] {
+            auto ring = std::make_shared<trace_ring_t>();
+            trace_registry_t& registry = global();
+            std::lock_guard<std::mutex> lock {registry.mutex};
+            registry.rings.push_back(ring);
+            return ring;
+        }();
+        return *ring;
+    }
+};
+
+inline std::uint64_t& trace_request_id() noexcept {
+    thread_local std::uint64_t request_id = 0;
+    return request_id;
+}
+
+inline std::uint64_t trace_now_ns() noexcept {
+    auto since_epoch = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(since_epoch).count());
+}
+
+/**
+ * @brief Records the lifetime of a scope as a span.
+ * Is a no-op, unless the project is built with `USTORE_USE_TRACING`.
+ */
+class trace_scope_t {
+#if USTORE_USE_TRACING
+    char const* name_;
+    std::uint64_t begin_ns_;
+
+  public:
+    trace_scope_t(char const* name) noexcept : name_(name), begin_ns_(trace_now_ns()) {
+        ustore_probe_begin_m(name_, trace_request_id());
+    }
+    ~trace_scope_t() noexcept {
+        std::uint64_t duration_ns = trace_now_ns() - begin_ns_;
+        std::uint64_t request_id = trace_request_id();
+        ustore_probe_end_m(name_, request_id, duration_ns);
+        try {
+            trace_registry_t::local().push({name_, request_id, begin_ns_, duration_ns});
+        }
+        catch (...) {
+        }
+    }
+#else
+  public:
+    trace_scope_t(char const*) noexcept {}
+#endif
+    trace_scope_t(trace_scope_t const&) = delete;
+    trace_scope_t& operator=(trace_scope_t const&) = delete;
+};
+
+/**
+ * @brief Assigns the request ID to the spans of the calling thread, until destroyed.
+ */
+class trace_request_scope_t {
+    std::uint64_t previous_;
+
+  public:
+    trace_request_scope_t(std::uint64_t request_id) noexcept
+        : previous_(std::exchange(trace_request_id(), request_id)) {}
+    ~trace_request_scope_t() noexcept { trace_request_id() = previous_; }
+    trace_request_scope_t(trace_request_scope_t const&) = delete;
+    trace_request_scope_t& operator=(trace_request_scope_t const&) = delete;
+};
+
+/**
+ * @brief Exports the recorded spans of all threads as a Chrome Trace Event JSON:
+ * complete "X" events with microsecond timestamps and the request IDs in "args".
+ * Span names are static identifiers, so they are printed without escaping.
+ */
+inline std::string trace_to_chrome_json() noexcept(false) {
+    std::vector<std::shared_ptr<trace_ring_t>> rings;
+    {
+        trace_registry_t& registry = trace_registry_t::global();
+        std::lock_guard<std::mutex> lock {registry.mutex};
+        rings = registry.rings;
+    }
+
+    std::string result = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    char buffer[256];
+    bool first = true;
+    for (auto const& ring : rings)
+        ring->for_each([&](trace_span_t const& span) {
+            int length = std::snprintf(buffer,
+                                       sizeof(buffer),
+                                       "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%zu,"
+                                       "\"args\":{\"request_id\":%llu}}",
+                                       first ? "" : ",",
+                                       span.name,
+                                       span.begin_ns / 1e3,
+                                       span.duration_ns / 1e3,
+                                       ring->thread(),
+                                       static_cast<unsigned long long>(span.request_id));
+            result.append(buffer, std::min<std::size_t>(length, sizeof(buffer) - 1));
+            first = false;
+        });
+    result += "]}";
+    return result;
+}
+
+#define trace_span_concat_m(a, b) a##b
+#define trace_span_name_m(line) trace_span_concat_m(trace_span_, line)
+
+#if USTORE_USE_TRACING
+#define trace_span_m(name) trace_scope_t trace_span_name_m(__LINE__)(name)
+#else
+#define trace_span_m(name)
+#endif
+
+} // namespace unum::ustore
@@ -0,0 +1,346 @@
+/**
+ * @file value_cache.hpp
+ * @author Ashot Vardanian
+ *
+ * @brief Read-through cache of hot values, that any engine can put in front of its storage.
+ *
+ * Every cached collection gets its own byte-bounded `value_cache_t`, split into
+ * shards by key hash, roughly one per core, each with a lock, an LRU order and a
+ * slab allocator for the values. Missing entries are cached as well, as graph and
+ * document lookups often probe absent keys.
+ *
+ * Engines only serve reads outside of transactions and snapshots from the cache,
+ * and must `invalidate()` the keys @b after they have been updated in the storage.
+ * Every invalidation bumps the generation of the shard, so that the readers, which
+ * have missed before the update and fetched the value after it, don't admit stale
+ * copies into the cache.
+ *
+ * ## Configuration
+ *
+ * Is loaded from the "value_cache" section of the engine config:
+ * @code{.json}
+ * "value_cache": {
+ *     "capacity": "64MB", // For every collection, including the main one
+ *     "collections": {"docs": "1GB", "": "0B"} // Per-name overrides
+ * }
+ * @endcode
+ * Zero capacity disables the cache for the collection.
+ */
+#pragma once
+#include <algorithm>     // `std::min`
+#include <array>         // `std::array`
+#include <cstring>       // `std::memcpy`
+#include <limits>        // `std::numeric_limits`
+#include <memory>        // `std::unique_ptr`
+#include <mutex>         // `std::mutex`
+#include <string>        // `std::string`
+#include <thread>        // `std::thread::hardware_concurrency`
+#include <unordered_map> // `std::unordered_map`
+#include <vector>        // `std::vector`
+
+#include <nlohmann/json.hpp> // `nlohmann::json`
+
+#include "ustore/cpp/types.hpp"      // `value_view_t`
+#include "helpers/config_loader.hpp" // `config_loader_t::parse_volume`
+#include "helpers/lru.hpp"           // `lru_cache_gt`
+
+namespace unum::ustore {
+
+/**
+ * @brief Power-of-two size classes, carved out of 1 MB pages.
+ * Pages are only released with the allocator, and freed slots are reused
+ * by values of the same class. Isn't thread-safe.
+ */
+class value_slabs_t {
+  public:
+    static constexpr std::size_t min_class_log2_k = 5;
+    static constexpr std::size_t classes_k = 12;
+    static constexpr std::size_t max_length_k = 1ul << (min_class_log2_k + classes_k - 1);
+    static constexpr std::size_t page_size_k = 1ul << 20;
+
+  private:
+    std::vector<std::unique_ptr<byte_t[]>> pages_;
+    std::array<std::vector<byte_t*>, classes_k> free_;
+
+  public:
+    static std::size_t class_of(std::size_t length) noexcept {
+        std::size_t idx = 0;
+        while ((1ul << (min_class_log2_k + idx)) < length)
+            ++idx;
+        return idx;
+    }
+
+    static std::size_t class_size(std::size_t length) noexcept { return 1ul << (min_class_log2_k + class_of(length)); }
+
+    std::size_t reserved() const noexcept { return pages_.size() * page_size_k; }
+
+    /**
+     * @brief Allocates a slot for a value of up to `max_length_k` bytes.
+     * @throws `std::bad_alloc`, if a new page can't be created.
+     */
+    byte_t* allocate(std::size_t length) noexcept(false) {
+        std::size_t idx = class_of(length);
+        std::vector<byte_t*>& free = free_[idx];
+        if (free.empty()) {
+            std::size_t slot_size = 1ul << (min_class_log2_k + idx);
+            std::size_t slots_count = page_size_k / slot_size;
+            auto page = std::make_unique<byte_t[]>(page_size_k);
+            // Reserving upfront lets `deallocate()` never reallocate
+            free.reserve(free.capacity() + slots_count);
+            pages_.reserve(pages_.size() + 1);
+            for (std::size_t i = 0; i != slots_count; ++i)
+                free.push_back(page.get() + i * slot_size);
+            pages_.push_back(std::move(page));
+        }
+
+        byte_t* slot = free.back();
+        free.pop_back();
+        return slot;
+    }
+
+    void deallocate(byte_t* slot, std::size_t length) noexcept { free_[class_of(length)].push_back(slot); }
+};
+
+struct value_cache_stats_t {
+    std::size_t capacity = 0;
+    std::size_t bytes = 0;
+    std::size_t reserved = 0;
+    std::size_t entries = 0;
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t evictions = 0;
+
+    nlohmann::json json() const {
+        return {
+            {"capacity", capacity},
+            {"bytes", bytes},
+            {"reserved_bytes", reserved},
+            {"entries", entries},
+            {"hits", hits},
+            {"misses", misses},
+            {"evictions", evictions},
+        };
+    }
+};
+
+class value_cache_t {
+  public:
+    using generation_t = std::uint64_t;
+
+  private:
+    struct cached_t {
+        byte_t* begin = nullptr;
+        ustore_length_t length = ustore_length_missing_k;
+    };
+
+    struct alignas(64) shard_t {
+        std::mutex mutex;
+        lru_cache_gt<ustore_key_t, cached_t> lru {std::numeric_limits<std::size_t>::max()};
+        value_slabs_t slabs;
+        std::size_t bytes = 0;
+        generation_t generation = 0;
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        std::uint64_t evictions = 0;
+
+        /// @brief Bytes charged for an entry. Even missing entries aren't free.
+        static std::size_t cost(ustore_length_t length) noexcept {
+            return sizeof(cached_t) + sizeof(ustore_key_t) +
+                   (length == ustore_length_missing_k || !length ? 0 : value_slabs_t::class_size(length));
+        }
+
+        void release(cached_t const& cached) noexcept {
+            bytes -= cost(cached.length);
+            if (cached.begin)
+                slabs.deallocate(cached.begin, cached.length);
+        }
+
+        void evict_oldest() noexcept {
+            auto oldest = lru.pop_oldest();
+            release(oldest->second);
+            ++evictions;
+        }
+    };
+
+    std::unique_ptr<shard_t[]> shards_;
+    std::size_t shards_count_ = 0;
+    std::size_t shard_capacity_ = 0;
+
+    shard_t& shard(ustore_key_t key) const noexcept {
+        // SplitMix64 finalizer, as sequential keys must spread across shards
+        auto hash = static_cast<std::uint64_t>(key);
+        hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ull;
+        hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebull;
+        hash = hash ^ (hash >> 31);
+        return shards_[hash & (shards_count_ - 1)];
+    }
+
+  public:
+    /**
+     * @param capacity Bytes for all the shards together.
+     * @param shards_count Rounded up to a power of two. Zero selects one per hardware thread.
+     */
+    value_cache_t(std::size_t capacity, std::size_t shards_count = 0) noexcept(false) {
+        if (!shards_count)
+            shards_count = std::min<std::size_t>(std::max(std::thread::hardware_concurrency(), 1u), 64);
+        shards_count_ = 1;
+        while (shards_count_ < shards_count)
+            shards_count_ *= 2;
+        shards_ = std::make_unique<shard_t[]>(shards_count_);
+        shard_capacity_ = capacity / shards_count_;
+    }
+
+    /**
+     * @brief Passes the cached value to @p callback, while the shard is locked.
+     * On a miss, exports the @p generation, to be passed to `insert()`.
+     * @return `true` on a hit.
+     */
+    template <typename callback_at>
+    bool find(ustore_key_t key, callback_at&& callback, generation_t& generation) noexcept(false) {
+        shard_t& shard = this->shard(key);
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        cached_t const* cached = shard.lru.get_ptr(key);
+        if (!cached) {
+            ++shard.misses;
+            generation = shard.generation;
+            return false;
+        }
+
+        ++shard.hits;
+        callback(value_view_t {cached->begin, cached->length});
+        return true;
+    }
+
+    /**
+     * @brief Admits a @p value, fetched after a missing `find()`, unless the key
+     * was invalidated in the meantime. May silently drop it instead.
+     */
+    void insert(ustore_key_t key, value_view_t value, generation_t generation) noexcept {
+        ustore_length_t length = value ? static_cast<ustore_length_t>(value.size()) : ustore_length_missing_k;
+        std::size_t cost = shard_t::cost(length);
+        if (cost > shard_capacity_ || value.size() > value_slabs_t::max_length_k)
+            return;
+
+        shard_t& shard = this->shard(key);
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        if (shard.generation != generation || shard.lru.contains(key))
+            return;
+
+        while (shard.bytes + cost > shard_capacity_ && !shard.lru.empty())
+            shard.evict_oldest();
+
+        try {
+            cached_t cached;
+            cached.length = length;
+            if (value.size()) {
+                cached.begin = shard.slabs.allocate(value.size());
+                std::memcpy(cached.begin, value.data(), value.size());
+            }
+            try {
+                shard.lru.insert(key, cached_t {cached});
+            }
+            catch (...) {
+                if (cached.begin)
+                    shard.slabs.deallocate(cached.begin, cached.length);
+                return;
+            }
+            shard.bytes += cost;
+        }
+        catch (...) {
+        }
+    }
+
+    /**
+     * @brief Drops the @p key, if cached. Must be called after the storage is updated.
+     */
+    void invalidate(ustore_key_t key) noexcept {
+        shard_t& shard = this->shard(key);
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        ++shard.generation;
+        if (auto cached = shard.lru.pop(key))
+            shard.release(*cached);
+    }
+
+    void clear() noexcept {
+        for (std::size_t i = 0; i != shards_count_; ++i) {
+            shard_t& shard = shards_[i];
+            std::unique_lock<std::mutex> lock(shard.mutex);
+            ++shard.generation;
+            while (auto oldest = shard.lru.pop_oldest())
+                shard.release(oldest->second);
+        }
+    }
+
+    value_cache_stats_t stats() const noexcept {
+        value_cache_stats_t result;
+        result.capacity = shard_capacity_ * shards_count_;
+        for (std::size_t i = 0; i != shards_count_; ++i) {
+            shard_t& shard = shards_[i];
+            std::unique_lock<std::mutex> lock(shard.mutex);
+            result.bytes += shard.bytes;
+            result.reserved += shard.slabs.reserved();
+            result.entries += shard.lru.size();
+            result.hits += shard.hits;
+            result.misses += shard.misses;
+            result.evictions += shard.evictions;
+        }
+        return result;
+    }
+};
+
+/**
+ * @brief Capacities of value caches for collections, parsed from the "value_cache" config section.
+ * The main collection has an empty name.
+ */
+struct value_cache_config_t {
+    std::size_t capacity = 0;
+    std::unordered_map<std::string, std::size_t> collections;
+
+    std::size_t capacity_for(std::string const& name) const noexcept {
+        auto it = collections.find(name);
+        return it != collections.end() ? it->second : capacity;
+    }
+
+    bool enabled() const noexcept {
+        if (capacity)
+            return true;
+        for (auto const& name_and_capacity : collections)
+            if (name_and_capacity.second)
+                return true;
+        return false;
+    }
+
+    /**
+     * @brief Parses the @p engine_config, where the section may be missing.
+     * @return `false` if the section is malformed.
+     */
+    static bool parse(nlohmann::json const& engine_config, value_cache_config_t& result) noexcept {
+        result = {};
+        if (!engine_config.is_object() || !engine_config.contains("value_cache"))
+            return true;
+
+        auto const& section = engine_config["value_cache"];
+        if (!section.is_object() || !config_loader_t::parse_volume(section, "capacity", result.capacity))
+            return false;
+        if (!section.contains("collections"))
+            return true;
+
+        auto const& collections = section["collections"];
+        if (!collections.is_object())
+            return false;
+        try {
+            for (auto it = collections.begin(); it != collections.end(); ++it) {
+                std::size_t capacity = 0;
+                if (!config_loader_t::parse_volume(collections, it.key(), capacity))
+                    return false;
+                result.collections[it.key()] = capacity;
+            }
+        }
+        catch (...) {
+            return false;
+        }
+        return true;
+    }
+};
+
+} // namespace unum::ustore
@@ -0,0 +1,655 @@
+/**
+ * @file vector_metrics.hpp
+ * @author Ashot Vardanian
+ *
+ * @brief Similarity measures for dense vectors, vectorized for common CPUs.
+ *
+ * Provides serial, AVX2, AVX-512 VNNI and Arm NEON kernels for `i8`,
+ * `f16` and `f32` scalars. Kernels are picked at runtime, depending on
+ * the capabilities of the current CPU. The lookup is meant to be done
+ * once per batch of requests, and the following calls happen through a
+ * plain function pointer, so the hot loops contain no branching.
+ *
+ * All kernels export @b raw metrics, computed over the provided scalars:
+ * - "dot": the inner product,
+ * - "cos": the inner product of normalized vectors,
+ * - "l2": the Euclidean distance.
+ * Scaling the results of quantized inputs back is up to the caller.
+ */
+#pragma once
+#include <cmath>   // `std::sqrt`
+#include <cstdint> // `std::int8_t`
+#include <cstring> // `std::memcpy`
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define USTORE_VECTOR_METRICS_X86 1
+#include <immintrin.h>
+#else
+#define USTORE_VECTOR_METRICS_X86 0
+#endif
+
+#if defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__)) && defined(__linux__)
+#define USTORE_VECTOR_METRICS_ARM 1
+#include <arm_neon.h>
+#include <sys/auxv.h> // `getauxval`
+#include <asm/hwcap.h> // `HWCAP_ASIMDDP`
+#else
+#define USTORE_VECTOR_METRICS_ARM 0
+#endif
+
+#include "ustore/vectors.h"
+
+namespace unum::ustore {
+
+using f16_bits_t = std::uint16_t;
+
+template <typename scalar_at>
+using vector_metric_gt = float (*)(scalar_at const*, scalar_at const*, std::size_t) noexcept;
+
+using i8_metric_t = vector_metric_gt<std::int8_t>;
+using f16_metric_t = vector_metric_gt<f16_bits_t>;
+using f32_metric_t = vector_metric_gt<float>;
+
+enum class simd_isa_t { serial_k = 0, avx2_k, avx512_vnni_k, neon_k, neon_dotprod_k };
+
+/**
+ * @brief Detects the most advanced instruction set, supported by this CPU.
+ * The result is cached after the first call.
+ */
+inline simd_isa_t simd_isa() noexcept {
+    static simd_isa_t const isa = [] {
+#if USTORE_VECTOR_METRICS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+            __builtin_cpu_supports("avx512vnni"))
+            return simd_isa_t::avx512_vnni_k;
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("f16c"))
+            return simd_isa_t::avx2_k;
+#elif USTORE_VECTOR_METRICS_ARM
+        if (getauxval(AT_HWCAP) & HWCAP_ASIMDDP)
+            return simd_isa_t::neon_dotprod_k;
+        return simd_isa_t::neon_k;
+#endif
+        return simd_isa_t::serial_k;
+    }();
+    return isa;
+}
+
+inline float f16_to_f32(f16_bits_t half) noexcept {
+    std::uint32_t sign = (half & 0x8000u) << 16;
+    std::uint32_t exponent = (half >> 10) & 0x1Fu;
+    std::uint32_t mantissa = half & 0x3FFu;
+    std::uint32_t bits;
+    if (exponent == 0x1F)
+        bits = sign | 0x7F800000u | (mantissa << 13);
+    else if (exponent)
+        bits = sign | ((exponent + 112u) << 23) | (mantissa << 13);
+    else if (mantissa) {
+        // Sub-normal halves become normal singles
+        exponent = 113;
+        while (!(mantissa & 0x400u))
+            mantissa <<= 1, --exponent;
+        bits = sign | (exponent << 23) | ((mantissa & 0x3FFu) << 13);
+    }
+    else
+        bits = sign;
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+/**
+ * @brief Rounds a single to the nearest half, ties to even, saturating into infinities.
+ */
+inline f16_bits_t f32_to_f16(float single) noexcept {
+    std::uint32_t bits;
+    std::memcpy(&bits, &single, sizeof(bits));
+    auto sign = static_cast<std::uint32_t>((bits >> 16) & 0x8000u);
+    std::uint32_t magnitude = bits & 0x7FFFFFFFu;
+    auto round = [](std::uint32_t truncated, std::uint32_t remainder, std::uint32_t halfway) noexcept {
+        return truncated + (remainder > halfway || (remainder == halfway && (truncated & 1u)));
+    };
+
+    std::uint32_t half;
+    if (magnitude > 0x7F800000u)
+        half = 0x7E00u;
+    else if (magnitude >= 0x47800000u)
+        half = 0x7C00u;
+    else if (magnitude >= 0x38800000u)
+        // Rounding may carry into the exponent, up to an infinity, which is exactly right
+        half = round((magnitude >> 13) - (112u << 10), magnitude & 0x1FFFu, 0x1000u);
+    else if (magnitude >= 0x33000000u) {
+        // Sub-normal halves
+        std::uint32_t shift = 126u - (magnitude >> 23);
+        std::uint32_t mantissa = (magnitude & 0x7FFFFFu) | 0x800000u;
+        half = round(mantissa >> shift, mantissa & ((1u << shift) - 1u), 1u << (shift - 1u));
+    }
+    else
+        half = 0;
+    return static_cast<f16_bits_t>(sign | half);
+}
+
+inline float cos_from_products(float ab, float a2, float b2) noexcept {
+    return a2 != 0 && b2 != 0 ? ab / (std::sqrt(a2) * std::sqrt(b2)) : 0;
+}
+
+/*********************************************************/
+/*****************	   Serial Kernels	  ****************/
+/*********************************************************/
+
+inline float to_f32(std::int8_t x) noexcept {
+    return x;
+}
+inline float to_f32(f16_bits_t x) noexcept {
+    return f16_to_f32(x);
+}
+inline float to_f32(float x) noexcept {
+    return x;
+}
+inline float to_f32(double x) noexcept {
+    return static_cast<float>(x);
+}
+
+inline void from_f32(float x, std::int8_t& result) noexcept {
+    result = static_cast<std::int8_t>(std::lround(std::fmin(std::fmax(x, -128.f), 127.f)));
+}
+inline void from_f32(float x, f16_bits_t& result) noexcept {
+    result = f32_to_f16(x);
+}
+inline void from_f32(float x, float& result) noexcept {
+    result = x;
+}
+inline void from_f32(float x, double& result) noexcept {
+    result = x;
+}
+
+inline float dot_i8_serial(std::int8_t const* a, std::int8_t const* b, std::size_t n) noexcept {
+    std::int64_t ab = 0;
+    for (std::size_t i = 0; i != n; ++i)
+        ab += std::int32_t(a[i]) * b[i];
+    return float(ab);
+}
+
+inline float cos_i8_serial(std::int8_t const* a, std::int8_t const* b, std::size_t n) noexcept {
+    std::int64_t ab = 0, a2 = 0, b2 = 0;
+    for (std::size_t i = 0; i != n; ++i)
+        ab += std::int32_t(a[i]) * b[i], a2 += std::int32_t(a[i]) * a[i], b2 += std::int32_t(b[i]) * b[i];
+    return cos_from_products(float(ab), float(a2), float(b2));
+}
+
+inline float l2_i8_serial(std::int8_t const* a, std::int8_t const* b, std::size_t n) noexcept {
+    std::int64_t d2 = 0;
+    for (std::size_t i = 0; i != n; ++i) {
+        std::int32_t d = std::int32_t(a[i]) - b[i];
+        d2 += d * d;
+    }
+    return std::sqrt(float(d2));
+}
+
+template <typename scalar_at>
+float dot_serial(scalar_at const* a, scalar_at const* b, std::size_t n) noexcept {
+    float ab = 0;
+    for (std::size_t i = 0; i != n; ++i)
+        ab += to_f32(a[i]) * to_f32(b[i]);
+    return ab;
+}
+
+template <typename scalar_at>
+float cos_serial(scalar_at const* a, scalar_at const* b, std::size_t n) noexcept {
+    float ab = 0, a2 = 0, b2 = 0;
+    for (std::size_t i = 0; i != n; ++i) {
+        float ai = to_f32(a[i]), bi = to_f32(b[i]);
+        ab += ai * bi, a2 += ai * ai, b2 += bi * bi;
+    }
+    return cos_from_products(ab, a2, b2);
+}
+
+template <typename scalar_at>
+float l2_serial(scalar_at const* a, scalar_at const* b, std::size_t n) noexcept {
+    float d2 = 0;
+    for (std::size_t i = 0; i != n; ++i) {
+        float d = to_f32(a[i]) - to_f32(b[i]);
+        d2 += d * d;
+    }
+    return std::sqrt(d2);
+}
+
+/*********************************************************/
+/*****************	    x86 Kernels	      ****************/
+/*********************************************************/
+
+#if USTORE_VECTOR_METRICS_X86
+
+#define USTORE_TARGET_AVX2 __attribute__((target("avx2,fma,f16c")))
+#define USTORE_TARGET_AVX512 __attribute__((target("avx2,fma,f16c,avx512f,avx512bw,avx512vnni")))
+
+USTORE_TARGET_AVX2 inline std::int32_t reduce_i32_avx2(__m256i x) noexcept {
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+}
+
+USTORE_TARGET_AVX2 inline float reduce_f32_avx2(__m256 x) noexcept {
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(x), _mm256_extractf128_ps(x, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+    return _mm_cvtss_f32(sum);
+}
+
+/// Sign-extends 16x `i8` scalars into 16x `i16`, for `_mm256_madd_epi16`.
+USTORE_TARGET_AVX2 inline __m256i load_i8x16_avx2(std::int8_t const* ptr) noexcept {
+    return _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<__m128i const*>(ptr)));
+}
+
+USTORE_TARGET_AVX2 inline float dot_i8_avx2(std::int8_t const* a, std::int8_t const* b, std::size_t n) noexcept {
+    __m256i ab = _mm256_setzero_si256();
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+        ab = _mm256_add_epi32(ab, _mm256_madd_epi16(load_i8x16_avx2(a + i), load_i8x16_avx2(b + i)));
+    return float(reduce_i32_avx2(ab)) + dot_i8_serial(a + i, b + i, n - i);
+}
+
+USTORE_TARGET_AVX2 inline float cos_i8_avx2(std::int8_t const* a, std::int8_t const* b, std::size_t n) noexcept {
+    __m256i ab = _mm256_setzero_si256(), a2 = ab, b2 = ab;
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i ai = load_i8x16_avx2(a + i), bi = load_i8x16_avx2(b + i);
+        ab = _mm256_add_epi32(ab, _mm256_madd_epi16(ai, bi));
+        a2 = _mm256_add_epi32(a2, _mm256_madd_epi16(ai, ai));
+        b2 = _mm256_add_epi32(b2, _mm256_madd_epi16(bi, bi));
+    }
+    std::int64_t ab_sum = reduce_i32_avx2(ab), a2_sum = reduce_i32_avx2(a2), b2_sum = reduce_i32_avx2(b2);
+    for (; i != n; ++i)
+        ab_sum += std::int32_t(a[i]) * b[i], a2_sum += std::int32_t(a[i]) * a[i], b2_sum += std::int32_t(b[i]) * b[i];
+    return cos_from_products(float(ab_sum), float(a2_sum), float(b2_sum));
+}
+
+USTORE_TARGET_AVX2 inline float l2_i8_avx2(std::int8_t const* a, std::int8_t const* b, std::size_t n) noexcept {
+    __m256i d2 = _mm256_setzero_si256();
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i d = _mm256_sub_epi16(load_i8x16_avx2(a + i), load_i8x16_avx2(b + i));
+        d2 = _mm256_add_epi32(d2, _mm256_madd_epi16(d, d));
+    }
+    std::int64_t d2_sum = reduce_i32_avx2(d2);
+    for (; i != n; ++i) {
+        std::int32_t d = std::int32_t(a[i]) - b[i];
+        d2_sum += d * d;
+    }
+    return std::sqrt(float(d2_sum));
+}
+
+USTORE_TARGET_AVX2 inline __m256 load_f32x8_avx2(float const* ptr) noexcept {
+    return _mm256_loadu_ps(ptr);
+}
+
+USTORE_TARGET_AVX2 inline __m256 load_f32x8_avx2(f16_bits_t const* ptr) noexcept {
+    return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<__m128i const*>(ptr)));
+}
+
+template <typename scalar_at>
+USTORE_TARGET_AVX2 float dot_avx2(scalar_at const* a, scalar_at const* b, std::size_t n) noexcept {
+    __m256 ab = _mm256_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        ab = _mm256_fmadd_ps(load_f32x8_avx2(a + i), load_f32x8_avx2(b + i), ab);
+    return reduce_f32_avx2(ab) + dot_serial(a + i, b + i, n - i);
+}
+
+template <typename scalar_at>
+USTORE_TARGET_AVX2 float cos_avx2(scalar_at const* a, scalar_at const* b, std::size_t n) noexcept {
+    __m256 ab = _mm256_setzero_ps(), a2 = ab, b2 = ab;
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 ai = load_f32x8_avx2(a + i), bi = load_f32x8_avx2(b + i);
+        ab = _mm256_fmadd_ps(ai, bi, ab);
+        a2 = _mm256_fmadd_ps(ai, ai, a2);
+        b2 = _mm256_fmadd_ps(bi, bi, b2);
+    }
+    float ab_sum = reduce_f32_avx2(ab), a2_sum = reduce_f32_avx2(a2), b2_sum = reduce_f32_avx2(b2);
+    for (; i != n; ++i) {
+        float ai = to_f32(a[i]), bi = to_f32(b[i]);
+        ab_sum += ai * bi, a2_sum += ai * ai, b2_sum += bi * bi;
+    }
+    return cos_from_products(ab_sum, a2_sum, b2_sum);
+}
+
+template <typename scalar_at>
+USTORE_TARGET_AVX2 float l2_avx2(scalar_at const* a, scalar_at const* b, std::size_t n) noexcept {
+    __m256 d2 = _mm256_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 d = _mm256_sub_ps(load_f32x8_avx2(a + i), load_f32x8_avx2(b + i));
+        d2 = _mm256_fmadd_ps(d, d, d2);
+    }
+    float d2_sum = reduce_f32_avx2(d2);
+    for (; i != n; ++i) {
+        float d = to_f32(a[i]) - to_f32(b[i]);
+        d2_sum += d * d;
+    }
+    return std::sqrt(d2_sum);
+}
+
+/// Sign-extends 32x `i8` scalars into 32x `i16`, for `_mm512_dpwssd_epi32`.
+USTORE_TARGET_AVX512 inline __m512i load_i8x32_avx512(std::int8_t const* ptr) noexcept {
+    return _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(ptr)));
+}
+
+USTORE_TARGET_AVX512 inline float dot_i8_avx512(std::int8_t const* a, std::int8_t const* b, std::size_t n) noexcept {
+    __m512i ab = _mm512_setzero_si512();
+    std::size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+        ab = _mm512_dpwssd_epi32(ab, load_i8x32_avx512(a + i), load_i8x32_avx512(b + i));
+    return float(_mm512_reduce_add_epi32(ab)) + dot_i8_avx2(a + i, b + i, n - i);
+}
+
+USTORE_TARGET_AVX512 inline float cos_i8_avx512(std::int8_t const* a, std::int8_t const* b, std::size_t n) noexcept {
+    __m512i ab = _mm512_setzero_si512(), a2 = ab, b2 = ab;
+    std::size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m512i ai = load_i8x32_avx512(a + i), bi = load_i8x32_avx512(b + i);
+        ab = _mm512_dpwssd_epi32(ab, ai, bi);
+        a2 = _mm512_dpwssd_epi32(a2, ai, ai);
+        b2 = _mm512_dpwssd_epi32(b2, bi, bi);
+    }
+    std::int64_t ab_sum = _mm512_reduce_add_epi32(ab);
+    std::int64_t a2_sum = _mm512_reduce_add_epi32(a2);
+    std::int64_t b2_sum = _mm512_reduce_add_epi32(b2);
+    for (; i != n; ++i)
+        ab_sum += std::int32_t(a[i]) * b[i], a2_sum += std::int32_t(a[i]) * a[i], b2_sum += std::int32_t(b[i]) * b[i];
+    return cos_from_products(float(ab_sum), float(a2_sum), float(b2_sum));
+}
+
+USTORE_TARGET_AVX512 inline float l2_i8_avx512(std::int8_t const* a, std::int8_t const* b, std::size_t n) noexcept {
+    __m512i d2 = _mm512_setzero_si512();
+    std::size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m512i d = _mm512_sub_epi16(load_i8x32_avx512(a + i), load_i8x32_avx512(b + i));
+        d2 = _mm512_dpwssd_epi32(d2, d, d);
+    }
+    std::int64_t d2_sum = _mm512_reduce_add_epi32(d2);
+    for (; i != n; ++i) {
+        std::int32_t d = std::int32_t(a[i]) - b[i];
+        d2_sum += d * d;
+    }
+    return std::sqrt(float(d2_sum));
+}
+
+USTORE_TARGET_AVX512 inline __m512 load_f32x16_avx512(float const* ptr) noexcept {
+    return _mm512_loadu_ps(ptr);
+}
+
+USTORE_TARGET_AVX512 inline __m512 load_f32x16_avx512(f16_bits_t const* ptr) noexcept {
+    return _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(ptr)));
+}
+
+template <typename scalar_at>
+USTORE_TARGET_AVX512 float dot_avx512(scalar_at const* a, scalar_at const* b, std::size_t n) noexcept {
+    __m512 ab = _mm512_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+        ab = _mm512_fmadd_ps(load_f32x16_avx512(a + i), load_f32x16_avx512(b + i), ab);
+    return _mm512_reduce_add_ps(ab) + dot_serial(a + i, b + i, n - i);
+}
+
+template <typename scalar_at>
+USTORE_TARGET_AVX512 float cos_avx512(scalar_at const* a, scalar_at const* b, std::size_t n) noexcept {
+    __m512 ab = _mm512_setzero_ps(), a2 = ab, b2 = ab;
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512 ai = load_f32x16_avx512(a + i), bi = load_f32x16_avx512(b + i);
+        ab = _mm512_fmadd_ps(ai, bi, ab);
+        a2 = _mm512_fmadd_ps(ai, ai, a2);
+        b2 = _mm512_fmadd_ps(bi, bi, b2);
+    }
+    float ab_sum = _mm512_reduce_add_ps(ab), a2_sum = _mm512_reduce_add_ps(a2), b2_sum = _mm512_reduce_add_ps(b2);
+    for (; i != n; ++i) {
+        float ai = to_f32(a[i]), bi = to_f32(b[i]);
+        ab_sum += ai * bi, a2_sum += ai * ai, b2_sum += bi * bi;
+    }
+    return cos_from_products(ab_sum, a2_sum, b2_sum);
+}
+
+template <typename scalar_at>
+USTORE_TARGET_AVX512 float l2_avx512(scalar_at const* a, scalar_at const* b, std::size_t n) noexcept {
+    __m512 d2 = _mm512_setzero_ps();
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512 d = _mm512_sub_ps(load_f32x16_avx512(a + i), load_f32x16_avx512(b + i));
+        d2 = _mm512_fmadd_ps(d, d, d2);
+    }
+    float d2_sum = _mm512_reduce_add_ps(d2);
+    for (; i != n; ++i) {
+        float d = to_f32(a[i]) - to_f32(b[i]);
+        d2_sum += d * d;
+    }
+    return std::sqrt(d2_sum);
+}
+
+#undef USTORE_TARGET_AVX2
+#undef USTORE_TARGET_AVX512
+
+#endif // USTORE_VECTOR_METRICS_X86
+
+/*********************************************************/
+/*****************	    Arm Kernels	      ****************/
+/*********************************************************/
+
+#if USTORE_VECTOR_METRICS_ARM
+
+#define USTORE_TARGET_DOTPROD __attribute__((target("arch=armv8.2-a+dotprod")))
+
+inline float dot_i8_neon(std::int8_t const* a, std::int8_t const* b, std::size_t n) noexcept {
+    int32x4_t ab = vdupq_n_s32(0);
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        int8x16_t ai = vld1q_s8(a + i), bi = vld1q_s8(b + i);
+        ab = vpadalq_s16(ab, vmull_s8(vget_low_s8(ai), vget_low_s8(bi)));
+        ab = vpadalq_s16(ab, vmull_high_s8(ai, bi));
+    }
+    return float(vaddvq_s32(ab)) + dot_i8_serial(a + i, b + i, n - i);
+}
+
+inline float cos_i8_neon(std::int8_t const* a, std::int8_t const* b, std::size_t n) noexcept {
+    int32x4_t ab = vdupq_n_s32(0), a2 = ab, b2 = ab;
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        int8x16_t ai = vld1q_s8(a + i), bi = vld1q_s8(b + i);
+        ab = vpadalq_s16(ab, vmull_s8(vget_low_s8(ai), vget_low_s8(bi)));
+        ab = vpadalq_s16(ab, vmull_high_s8(ai, bi));
+        a2 = vpadalq_s16(a2, vmull_s8(vget_low_s8(ai), vget_low_s8(ai)));
+        a2 = vpadalq_s16(a2, vmull_high_s8(ai, ai));
+        b2 = vpadalq_s16(b2, vmull_s8(vget_low_s8(bi), vget_low_s8(bi)));
+        b2 = vpadalq_s16(b2, vmull_high_s8(bi, bi));
+    }
+    std::int64_t ab_sum = vaddvq_s32(ab), a2_sum = vaddvq_s32(a2), b2_sum = vaddvq_s32(b2);
+    for (; i != n; ++i)
+        ab_sum += std::int32_t(a[i]) * b[i], a2_sum += std::int32_t(a[i]) * a[i], b2_sum += std::int32_t(b[i]) * b[i];
+    return cos_from_products(float(ab_sum), float(a2_sum), float(b2_sum));
+}
+
+inline float l2_i8_neon(std::int8_t const* a, std::int8_t const* b, std::size_t n) noexcept {
+    uint32x4_t d2 = vdupq_n_u32(0);
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        // Absolute differences of signed bytes always fit into unsigned ones
+        uint8x16_t d = vreinterpretq_u8_s8(vabdq_s8(vld1q_s8(a + i), vld1q_s8(b + i)));
+        d2 = vpadalq_u16(d2, vmull_u8(vget_low_u8(d), vget_low_u8(d)));
+        d2 = vpadalq_u16(d2, vmull_high_u8(d, d));
+    }
+    std::int64_t d2_sum = vaddvq_u32(d2);
+    for (; i != n; ++i) {
+        std::int32_t d = std::int32_t(a[i]) - b[i];
+        d2_sum += d * d;
+    }
+    return std::sqrt(float(d2_sum));
+}
+
+USTORE_TARGET_DOTPROD inline float dot_i8_sdot(std::int8_t const* a, std::int8_t const* b, std::size_t n) noexcept {
+    int32x4_t ab = vdupq_n_s32(0);
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+        ab = vdotq_s32(ab, vld1q_s8(a + i), vld1q_s8(b + i));
+    return float(vaddvq_s32(ab)) + dot_i8_serial(a + i, b + i, n - i);
+}
+
+USTORE_TARGET_DOTPROD inline float cos_i8_sdot(std::int8_t const* a, std::int8_t const* b, std::size_t n) noexcept {
+    int32x4_t ab = vdupq_n_s32(0), a2 = ab, b2 = ab;
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        int8x16_t ai = vld1q_s8(a + i), bi = vld1q_s8(b + i);
+        ab = vdotq_s32(ab, ai, bi);
+        a2 = vdotq_s32(a2, ai, ai);
+        b2 = vdotq_s32(b2, bi, bi);
+    }
+    std::int64_t ab_sum = vaddvq_s32(ab), a2_sum = vaddvq_s32(a2), b2_sum = vaddvq_s32(b2);
+    for (; i != n; ++i)
+        ab_sum += std::int32_t(a[i]) * b[i], a2_sum += std::int32_t(a[i]) * a[i], b2_sum += std::int32_t(b[i]) * b[i];
+    return cos_from_products(float(ab_sum), float(a2_sum), float(b2_sum));
+}
+
+USTORE_TARGET_DOTPROD inline float l2_i8_sdot(std::int8_t const* a, std::int8_t const* b, std::size_t n) noexcept {
+    uint32x4_t d2 = vdupq_n_u32(0);
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t d = vreinterpretq_u8_s8(vabdq_s8(vld1q_s8(a + i), vld1q_s8(b + i)));
+        d2 = vdotq_u32(d2, d, d);
+    }
+    std::int64_t d2_sum = vaddvq_u32(d2);
+    for (; i != n; ++i) {
+        std::int32_t d = std::int32_t(a[i]) - b[i];
+        d2_sum += d * d;
+    }
+    return std::sqrt(float(d2_sum));
+}
+
+inline float32x4_t load_f32x4_neon(float const* ptr) noexcept {
+    return vld1q_f32(ptr);
+}
+
+inline float32x4_t load_f32x4_neon(f16_bits_t const* ptr) noexcept {
+    return vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(ptr)));
+}
+
+template <typename scalar_at>
+float dot_neon(scalar_at const* a, scalar_at const* b, std::size_t n) noexcept {
+    float32x4_t ab = vdupq_n_f32(0);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        ab = vfmaq_f32(ab, load_f32x4_neon(a + i), load_f32x4_neon(b + i));
+    return vaddvq_f32(ab) + dot_serial(a + i, b + i, n - i);
+}
+
+template <typename scalar_at>
+float cos_neon(scalar_at const* a, scalar_at const* b, std::size_t n) noexcept {
+    float32x4_t ab = vdupq_n_f32(0), a2 = ab, b2 = ab;
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t ai = load_f32x4_neon(a + i), bi = load_f32x4_neon(b + i);
+        ab = vfmaq_f32(ab, ai, bi);
+        a2 = vfmaq_f32(a2, ai, ai);
+        b2 = vfmaq_f32(b2, bi, bi);
+    }
+    float ab_sum = vaddvq_f32(ab), a2_sum = vaddvq_f32(a2), b2_sum = vaddvq_f32(b2);
+    for (; i != n; ++i) {
+        float ai = to_f32(a[i]), bi = to_f32(b[i]);
+        ab_sum += ai * bi, a2_sum += ai * ai, b2_sum += bi * bi;
+    }
+    return cos_from_products(ab_sum, a2_sum, b2_sum);
+}
+
+template <typename scalar_at>
+float l2_neon(scalar_at const* a, scalar_at const* b, std::size_t n) noexcept {
+    float32x4_t d2 = vdupq_n_f32(0);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t d = vsubq_f32(load_f32x4_neon(a + i), load_f32x4_neon(b + i));
+        d2 = vfmaq_f32(d2, d, d);
+    }
+    float d2_sum = vaddvq_f32(d2);
+    for (; i != n; ++i) {
+        float d = to_f32(a[i]) - to_f32(b[i]);
+        d2_sum += d * d;
+    }
+    return std::sqrt(d2_sum);
+}
+
+#undef USTORE_TARGET_DOTPROD
+
+#endif // USTORE_VECTOR_METRICS_ARM
+
+/*********************************************************/
+/*****************	     Dispatch	      ****************/
+/*********************************************************/
+
+/**
+ * @brief Picks the portable kernel for any scalar type, that has a `to_f32()` overload.
+ */
+template <typename scalar_at>
+vector_metric_gt<scalar_at> serial_metric(ustore_vector_metric_t kind) noexcept {
+    return kind == ustore_vector_metric_dot_k ? &dot_serial<scalar_at>
+           : kind == ustore_vector_metric_l2_k ? &l2_serial<scalar_at>
+                                               : &cos_serial<scalar_at>;
+}
+
+/**
+ * @brief Picks the fastest kernel for quantized `i8` vectors.
+ */
+inline i8_metric_t i8_metric(ustore_vector_metric_t kind, simd_isa_t isa = simd_isa()) noexcept {
+    switch (isa) {
+#if USTORE_VECTOR_METRICS_X86
+    case simd_isa_t::avx512_vnni_k:
+        return kind == ustore_vector_metric_dot_k ? &dot_i8_avx512
+               : kind == ustore_vector_metric_l2_k ? &l2_i8_avx512
+                                                   : &cos_i8_avx512;
+    case simd_isa_t::avx2_k:
+        return kind == ustore_vector_metric_dot_k ? &dot_i8_avx2
+               : kind == ustore_vector_metric_l2_k ? &l2_i8_avx2
+                                                   : &cos_i8_avx2;
+#endif
+#if USTORE_VECTOR_METRICS_ARM
+    case simd_isa_t::neon_dotprod_k:
+        return kind == ustore_vector_metric_dot_k ? &dot_i8_sdot
+               : kind == ustore_vector_metric_l2_k ? &l2_i8_sdot
+                                                   : &cos_i8_sdot;
+    case simd_isa_t::neon_k:
+        return kind == ustore_vector_metric_dot_k ? &dot_i8_neon
+               : kind == ustore_vector_metric_l2_k ? &l2_i8_neon
+                                                   : &cos_i8_neon;
+#endif
+    default:
+        return kind == ustore_vector_metric_dot_k ? &dot_i8_serial
+               : kind == ustore_vector_metric_l2_k ? &l2_i8_serial
+                                                   : &cos_i8_serial;
+    }
+}
+
+/**
+ * @brief Picks the fastest kernel for `f16` or `f32` vectors.
+ */
+template <typename scalar_at>
+vector_metric_gt<scalar_at> float_metric(ustore_vector_metric_t kind, simd_isa_t isa = simd_isa()) noexcept {
+    switch (isa) {
+#if USTORE_VECTOR_METRICS_X86
+    case simd_isa_t::avx512_vnni_k:
+        return kind == ustore_vector_metric_dot_k ? &dot_avx512<scalar_at>
+               : kind == ustore_vector_metric_l2_k ? &l2_avx512<scalar_at>
+                                                   : &cos_avx512<scalar_at>;
+    case simd_isa_t::avx2_k:
+        return kind == ustore_vector_metric_dot_k ? &dot_avx2<scalar_at>
+               : kind == ustore_vector_metric_l2_k ? &l2_avx2<scalar_at>
+                                                   : &cos_avx2<scalar_at>;
+#endif
+#if USTORE_VECTOR_METRICS_ARM
+    case simd_isa_t::neon_dotprod_k:
+    case simd_isa_t::neon_k:
+        return kind == ustore_vector_metric_dot_k ? &dot_neon<scalar_at>
+               : kind == ustore_vector_metric_l2_k ? &l2_neon<scalar_at>
+                                                   : &cos_neon<scalar_at>;
+#endif
+    default: return serial_metric<scalar_at>(kind);
+    }
+}
+
+} // namespace unum::ustore
@@ -0,0 +1,180 @@
+/**
+ * @file write_ahead_log.hpp
+ * @author Ashot Vardanian
+ *
+ * @brief Append-only log of checksummed binary records.
+ * Every record is laid out as `[u32 length][u32 checksum][length bytes]`.
+ * If the process crashes half-way through an append, the torn tail
+ * is detected during replay and ignored. If an append fails, while the
+ * process keeps running, the torn bytes are cut off, as otherwise the
+ * following records would land after them and be unreachable on replay.
+ */
+#pragma once
+#include <fcntl.h>  // `::open`
+#include <unistd.h> // `::write`, `::fdatasync`, `::ftruncate`
+#include <cerrno>   // `errno`
+#include <cstdio>   // `std::FILE`
+#include <cstring>  // `std::memcpy`
+#include <cstdint>  // `std::uint32_t`
+#include <string>   // `std::string`
+#include <utility>  // `std::forward`
+
+#include "ustore/cpp/types.hpp"  // `value_view_t`
+#include "ustore/cpp/status.hpp" // `status_t`
+
+namespace unum::ustore {
+
+/**
+ * @brief 32-bit FNV-1a hash. Isn't cryptographic, but is good enough to
+ * catch partially written or zero-filled tails of log files.
+ */
+inline std::uint32_t log_checksum(value_view_t record) noexcept {
+    std::uint32_t hash = 2166136261u;
+    for (byte_t byte : record)
+        hash = (hash ^ static_cast<std::uint32_t>(byte)) * 16777619u;
+    return hash;
+}
+
+class write_ahead_log_t {
+    int handle_ = -1;
+    std::size_t size_ = 0;
+    /// @brief Set, if a torn record couldn't be cut off, so nothing can be appended safely.
+    bool failed_ = false;
+
+    struct record_header_t {
+        std::uint32_t length = 0;
+        std::uint32_t checksum = 0;
+    };
+
+  public:
+    write_ahead_log_t() = default;
+    write_ahead_log_t(write_ahead_log_t const&) = delete;
+    write_ahead_log_t& operator=(write_ahead_log_t const&) = delete;
+    ~write_ahead_log_t() noexcept {
+        if (handle_ >= 0)
+            ::close(handle_);
+    }
+
+    status_t open(char const* path) noexcept {
+        if (handle_ >= 0)
+            return "Close previous log before opening the new one!";
+        handle_ = ::open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (handle_ < 0)
+            return "Failed to open the write-ahead log";
+        size_ = static_cast<std::size_t>(::lseek(handle_, 0, SEEK_END));
+        failed_ = false;
+        return {};
+    }
+
+    status_t close() noexcept {
+        if (handle_ < 0)
+            return {};
+        int result = ::close(std::exchange(handle_, -1));
+        size_ = 0;
+        if (result != 0)
+            return "Couldn't close the write-ahead log";
+        return {};
+    }
+
+    /**
+     * @brief Hands the record to the OS, so it survives a crash of the process.
+     * To survive a power loss, follow it with `sync()`.
+     */
+    status_t append(value_view_t record) noexcept {
+        if (handle_ < 0)
+            return "Write-ahead log isn't opened";
+        if (failed_)
+            return "Write-ahead log has a torn tail, reopen it to continue";
+
+        record_header_t header;
+        header.length = static_cast<std::uint32_t>(record.size());
+        header.checksum = log_checksum(record);
+        if (!write_all(&header, sizeof(header)) || !write_all(record.data(), record.size())) {
+            if (::ftruncate(handle_, static_cast<off_t>(size_)) != 0)
+                failed_ = true;
+            return "Failed to append to write-ahead log";
+        }
+        size_ += sizeof(header) + record.size();
+        return {};
+    }
+
+    status_t sync() noexcept {
+        if (handle_ < 0)
+            return {};
+        if (::fdatasync(handle_) != 0)
+            return "Failed to flush the write-ahead log to disk";
+        return {};
+    }
+
+    bool is_open() const noexcept { return handle_ >= 0; }
+    std::size_t size() const noexcept { return size_; }
+
+    /**
+     * @brief Passes every complete record in file to @p callback, in order.
+     * Stops at the first torn or corrupted record, as nothing can be
+     * reliably recovered past it.
+     * @param callback Receives a `value_view_t`, returns `false` to stop.
+     */
+    template <typename callback_at>
+    static status_t replay(char const* path, callback_at&& callback) noexcept {
+        std::size_t offset = 0;
+        return replay(path, offset, std::forward<callback_at>(callback));
+    }
+
+    /**
+     * @brief Continues the replay from the @p offset of a previous one, so that
+     * the log can be tailed by readers, while it's still being appended to.
+     * @param offset Is advanced past every record, consumed by the @p callback.
+     * @param callback Receives a `value_view_t`, returns `false` to stop
+     * without consuming the record.
+     */
+    template <typename callback_at>
+    static status_t replay(char const* path, std::size_t& offset, callback_at&& callback) noexcept {
+        std::FILE* file = std::fopen(path, "rb");
+        if (!file)
+            return "Failed to open the write-ahead log";
+        if (offset && std::fseek(file, static_cast<long>(offset), SEEK_SET) != 0) {
+            std::fclose(file);
+            return "Failed to seek in the write-ahead log";
+        }
+
+        std::string buffer;
+        record_header_t header;
+        while (std::fread(&header, sizeof(header), 1, file) == 1) {
+            try {
+                buffer.resize(header.length);
+            }
+            catch (...) {
+                std::fclose(file);
+                return "Failed to allocate memory for a log record";
+            }
+            if (std::fread(buffer.data(), 1, header.length, file) != header.length)
+                break;
+            value_view_t record {buffer.data(), buffer.size()};
+            if (log_checksum(record) != header.checksum)
+                break;
+            if (!callback(record))
+                break;
+            offset += sizeof(header) + header.length;
+        }
+        std::fclose(file);
+        return {};
+    }
+
+  private:
+    bool write_all(void const* data, std::size_t length) noexcept {
+        auto begin = reinterpret_cast<char const*>(data);
+        while (length) {
+            auto written = ::write(handle_, begin, length);
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written < 0)
+                return false;
+            begin += written;
+            length -= static_cast<std::size_t>(written);
+        }
+        return true;
+    }
+};
+
+} // namespace unum::ustore
@@ -5,10 +5,17 @@
  * @brief Document storage using "YYJSON" lib.
  * Sits on top of any @see "ustore.h"-compatible system.
  */
-#include <cstdio>      // `std::snprintf`
-#include <cctype>      // `std::isdigit`
-#include <charconv>    // `std::to_chars`
-#include <string_view> // `std::string_view`
+#include <cstdio>        // `std::snprintf`
+#include <cctype>        // `std::isdigit`
+#include <charconv>      // `std::to_chars`
+#include <string_view>   // `std::string_view`
+#include <optional>      // `std::optional`
+#include <cmath>         // `std::isnan`
+#include <limits>        // `std::numeric_limits`
+#include <numeric>       // `std::iota`
+#include <vector>        // `std::vector`
+#include <array>         // `std::array`
+#include <unordered_map> // `std::unordered_map`
 
 #include <fmt/format.h> // `fmt::format_int`
 
@@ -21,6 +28,12 @@
 #include "helpers/linked_memory.hpp"  // `linked_memory_lock_t`
 #include "helpers/linked_array.hpp"   // `growing_tape_t`
 #include "helpers/algorithm.hpp"      // `transform_n`
+#include "helpers/merge.hpp"          // `can_merge`
+#include "helpers/hash.hpp"           // `hash_bytes`
+#include "helpers/json_tape.hpp"      // `tape_builder_t`
+#include "helpers/full_scan.hpp"      // `full_scan_collection`
+#include "helpers/parallel.hpp"       // `parallel_for`
+#include "helpers/trace.hpp"          // `trace_span_m`
 #include "ustore/cpp/ranges_args.hpp" // `places_arg_t`
 
 /*********************************************************/
@@ -60,9 +73,10 @@ enum class doc_modification_t {
 /// The length of buffer to be used to convert/format/print numerical values into strings.
 constexpr std::size_t printed_number_length_limit_k = 32;
 constexpr std::size_t field_path_len_limit_k = 512;
+/// Every one of the joined documents in `ustore_docs_write_t::values_joined` must fit into this many bytes.
+constexpr std::size_t joined_docs_batch_limit_k = 16ul * 1024ul * 1024ul;
 
 using printed_number_buffer_t = char[printed_number_length_limit_k];
-using field_path_buffer_t = char[field_path_len_limit_k];
 
 /*********************************************************/
 /*****************	 STL Compatibility	  ****************/
@@ -240,6 +254,20 @@ json_t json_parse(value_view_t bytes, linked_memory_lock_t& arena, ustore_error_
     if (bytes.empty())
         return {};
 
+    // Stored documents may be binary tapes, that are printed back, when a mutable DOM is needed
+    std::string tape_json;
+    if (is_tape(bytes)) {
+        bool success = false;
+        safe_section("Printing the tape", c_error, [&] { success = tape_to_json(tape_root(bytes), tape_json); });
+        if (*c_error)
+            return {};
+        if (!success) {
+            *c_error = "Failed to decode the stored document!";
+            return {};
+        }
+        bytes = value_view_t(tape_json);
+    }
+
     json_t result;
     yyjson_alc allocator = wrap_allocator(arena);
     yyjson_read_flag flg = YYJSON_READ_ALLOW_COMMENTS | YYJSON_READ_ALLOW_INF_AND_NAN;
@@ -270,6 +298,133 @@ value_view_t json_dump(json_branch_t json,
     return result;
 }
 
+/**
+ * @brief Appends a mutable JSON branch to a binary tape, @see "helpers/json_tape.hpp".
+ */
+void tape_append(yyjson_mut_val* value, tape_builder_t& tape) noexcept(false) {
+    switch (yyjson_mut_get_type(value)) {
+    case YYJSON_TYPE_BOOL: tape.boolean(yyjson_mut_get_bool(value)); break;
+    case YYJSON_TYPE_NUM:
+        switch (yyjson_mut_get_subtype(value)) {
+        case YYJSON_SUBTYPE_UINT: tape.uint(yyjson_mut_get_uint(value)); break;
+        case YYJSON_SUBTYPE_SINT: tape.sint(yyjson_mut_get_sint(value)); break;
+        default: tape.real(yyjson_mut_get_real(value)); break;
+        }
+        break;
+    case YYJSON_TYPE_STR: tape.str({yyjson_mut_get_str(value), yyjson_mut_get_len(value)}); break;
+    case YYJSON_TYPE_ARR: {
+        tape.open_array(static_cast<std::uint32_t>(yyjson_mut_arr_size(value)));
+        yyjson_mut_arr_iter iter;
+        yyjson_mut_arr_iter_init(value, &iter);
+        while (yyjson_mut_val* element = yyjson_mut_arr_iter_next(&iter))
+            tape_append(element, tape);
+        tape.close();
+        break;
+    }
+    case YYJSON_TYPE_OBJ: {
+        tape.open_object(static_cast<std::uint32_t>(yyjson_mut_obj_size(value)));
+        yyjson_mut_obj_iter iter;
+        yyjson_mut_obj_iter_init(value, &iter);
+        while (yyjson_mut_val* key = yyjson_mut_obj_iter_next(&iter)) {
+            tape.key({yyjson_mut_get_str(key), yyjson_mut_get_len(key)});
+            tape_append(yyjson_mut_obj_iter_get_val(key), tape);
+        }
+        tape.close();
+        break;
+    }
+    default: tape.null(); break;
+    }
+}
+
+/**
+ * @brief Encodes a document into the binary tape, in which it is persisted.
+ * @return False, if the tape would overflow its 32-bit offsets.
+ */
+bool tape_encode(yyjson_mut_val* root, std::string& output) noexcept(false) {
+    output.clear();
+    tape_builder_t tape(output);
+    tape_append(root, tape);
+    return output.size() <= std::numeric_limits<std::uint32_t>::max();
+}
+
+/**
+ * @brief Counts the children of a SIMDJSON container, which saturates beyond 24 bits.
+ */
+template <typename container_at>
+std::uint32_t dom_size(container_at container) noexcept {
+    constexpr std::size_t saturated_k = 0xFFFFFF;
+    std::size_t count = container.size();
+    if (count == saturated_k)
+        count = static_cast<std::size_t>(std::distance(container.begin(), container.end()));
+    return static_cast<std::uint32_t>(count);
+}
+
+/**
+ * @brief Same as the `yyjson_mut_val` variant, but for documents parsed in bulk by SIMDJSON.
+ * Non-negative integers become unsigned, just like in YYJSON.
+ */
+void tape_append(sj::dom::element value, tape_builder_t& tape) noexcept(false) {
+    switch (value.type()) {
+    case sj::dom::element_type::BOOL: tape.boolean(value.get_bool().value()); break;
+    case sj::dom::element_type::INT64: {
+        std::int64_t integer = value.get_int64().value();
+        integer < 0 ? tape.sint(integer) : tape.uint(static_cast<std::uint64_t>(integer));
+        break;
+    }
+    case sj::dom::element_type::UINT64: tape.uint(value.get_uint64().value()); break;
+    case sj::dom::element_type::DOUBLE: tape.real(value.get_double().value()); break;
+    case sj::dom::element_type::STRING: tape.str(value.get_string().value()); break;
+    case sj::dom::element_type::ARRAY: {
+        sj::dom::array array = value.get_array().value();
+        tape.open_array(dom_size(array));
+        for (sj::dom::element element : array)
+            tape_append(element, tape);
+        tape.close();
+        break;
+    }
+    case sj::dom::element_type::OBJECT: {
+        sj::dom::object object = value.get_object().value();
+        tape.open_object(dom_size(object));
+        for (sj::dom::key_value_pair member : object) {
+            tape.key(member.key);
+            tape_append(member.value, tape);
+        }
+        tape.close();
+        break;
+    }
+    default: tape.null(); break;
+    }
+}
+
+bool tape_encode(sj::dom::element root, std::string& output) noexcept(false) {
+    output.clear();
+    tape_builder_t tape(output);
+    tape_append(root, tape);
+    return output.size() <= std::numeric_limits<std::uint32_t>::max();
+}
+
+/**
+ * @brief Appends a document in the format, in which it is persisted.
+ * Unlike `json_dump`, produces binary tapes, that can be queried without parsing.
+ */
+value_view_t stored_dump(json_branch_t json,
+                         linked_memory_lock_t& arena,
+                         growing_tape_t& output,
+                         ustore_error_t* c_error) noexcept {
+
+    if (!json.mut_handle)
+        return json_dump(json, arena, output, c_error);
+
+    std::string tape;
+    bool fits = false;
+    safe_section("Encoding the tape", c_error, [&] { fits = tape_encode(json.mut_handle, tape); });
+    if (*c_error)
+        return {};
+    if (!fits)
+        return json_dump(json, arena, output, c_error);
+    return output.push_back(value_view_t(tape), c_error);
+}
+
 template <typename scalar_at>
 void json_to_scalar(yyjson_val* value,
                     ustore_octet_t mask,
@@ -1256,6 +1411,112 @@ void modify( //
     return_error_if_m(original.mut_handle->root, c_error, 0, "Failed To Modify!");
 }
 
+/**
+ * @brief Appends an escaped JSON-Pointer segment, like: "/a~1b" for the "a/b" member.
+ */
+void append_pointer_segment(std::string& path, std::string_view name) noexcept(false) {
+    path.push_back('/');
+    for (char c : name)
+        c == '~' ? path.append("~0") : c == '/' ? path.append("~1") : path.append(1, c);
+}
+
+/**
+ * @brief Converts a member name or a JSON-Pointer into a JSON-Pointer, that is empty for the root.
+ */
+void append_pointer(std::string& path, ustore_str_view_t field) noexcept(false) {
+    if (!field)
+        return;
+    if (field[0] == '/')
+        path.append(field);
+    else
+        append_pointer_segment(path, field);
+}
+
+/**
+ * @brief Replaces the existing value at the JSON-Pointer @p path, that is empty for the root.
+ */
+bool splice_value(std::string& doc, std::string const& path, yyjson_mut_val* value) noexcept(false) {
+    std::string node;
+    if (!tape_encode(value, node))
+        return false;
+    std::string_view node_without_header = std::string_view(node).substr(bytes_in_tape_header_k);
+    return tape_replace(doc, path.empty() ? nullptr : path.c_str(), node_without_header);
+}
+
+/**
+ * @brief Recursively applies a JSON-Merge-Patch to the object at @p path, if it only replaces existing members.
+ */
+bool splice_merge(std::string& doc, std::string& path, yyjson_mut_val* merge_patch) noexcept(false) {
+    yyjson_mut_obj_iter iter;
+    yyjson_mut_obj_iter_init(merge_patch, &iter);
+    while (yyjson_mut_val* key = yyjson_mut_obj_iter_next(&iter)) {
+        yyjson_mut_val* value = yyjson_mut_obj_iter_get_val(key);
+        if (yyjson_mut_is_null(value))
+            return false;
+
+        std::size_t const path_length = path.size();
+        append_pointer_segment(path, {yyjson_mut_get_str(key), yyjson_mut_get_len(key)});
+        tape_node_t target = tape_root(value_view_t(doc)).lookup(path.c_str());
+        bool success = yyjson_mut_is_obj(value) //
+                           ? target.type() == tape_type_t::object_k && splice_merge(doc, path, value)
+                           : target && splice_value(doc, path, value);
+        if (!success)
+            return false;
+        path.resize(path_length);
+    }
+    return true;
+}
+
+/**
+ * @brief Applies a modification to the binary tape in place, when it only replaces existing
+ * values, so that neither the rest of the document is parsed, nor it is serialized again.
+ * @return False, if the structure must change, and the document must be rebuilt.
+ * In that case @p doc may be partially modified, and must be discarded.
+ */
+bool splice_modification( //
+    std::string& doc,
+    yyjson_mut_val* modifier,
+    ustore_str_view_t field,
+    doc_modification_t const c_modification) noexcept(false) {
+
+    std::string path;
+    append_pointer(path, field);
+    switch (c_modification) {
+    case doc_modification_t::upsert_k:
+    case doc_modification_t::update_k: return !path.empty() && splice_value(doc, path, modifier);
+
+    case doc_modification_t::merge_k: {
+        if (!yyjson_mut_is_obj(modifier))
+            return !path.empty() && !yyjson_mut_is_null(modifier) && splice_value(doc, path, modifier);
+        tape_node_t target = tape_root(value_view_t(doc)).lookup(path.empty() ? nullptr : path.c_str());
+        return target.type() == tape_type_t::object_k && splice_merge(doc, path, modifier);
+    }
+
+    case doc_modification_t::patch_k: {
+        if (!yyjson_mut_is_arr(modifier))
+            return false;
+        std::size_t const path_length = path.size();
+        yyjson_mut_arr_iter iter;
+        yyjson_mut_arr_iter_init(modifier, &iter);
+        while (yyjson_mut_val* operation = yyjson_mut_arr_iter_next(&iter)) {
+            yyjson_mut_val* op = yyjson_mut_obj_get(operation, "op");
+            yyjson_mut_val* op_path = yyjson_mut_obj_get(operation, "path");
+            yyjson_mut_val* value = yyjson_mut_obj_get(operation, "value");
+            if (!yyjson_mut_equals_str(op, "replace") || yyjson_mut_obj_size(operation) != 3 ||
+                !yyjson_mut_is_str(op_path) || !value)
+                return false;
+            path.append(yyjson_mut_get_str(op_path), yyjson_mut_get_len(op_path));
+            if (!splice_value(doc, path, value))
+                return false;
+            path.resize(path_length);
+        }
+        return true;
+    }
+
+    default: return false;
+    }
+}
+
 template <typename callback_at>
 void read_unique_docs( //
     ustore_database_t const c_db,
@@ -1514,10 +1775,29 @@ void read_modify_write( //
     return_if_error_m(c_error);
 
     yyjson_alc allocator = wrap_allocator(arena);
+    std::string spliced;
     auto safe_callback = [&](ustore_size_t task_idx, ustore_str_view_t field, value_view_t binary_doc) {
+        // Replacements of existing values are spliced into the binary tapes, without parsing them
+        json_t parsed_task;
+        if (contents[task_idx] && is_tape(binary_doc)) {
+            parsed_task = any_parse(contents[task_idx], c_type, arena, c_error);
+            return_if_error_m(c_error);
+            bool success = false;
+            safe_section("Splicing the tape", c_error, [&] {
+                spliced.assign(binary_doc.c_str(), binary_doc.size());
+                success = parsed_task.mut_handle &&
+                          splice_modification(spliced, parsed_task.mut_handle->root, field, c_modification);
+            });
+            return_if_error_m(c_error);
+            if (success) {
+                growing_tape.push_back(value_view_t(spliced), c_error);
+                return;
+            }
+        }
+
         json_t parsed = any_parse(binary_doc, internal_format_k, arena, c_error);
         if (!contents[task_idx]) {
-            any_dump({nullptr, parsed.mut_handle->root}, internal_format_k, arena, growing_tape, c_error);
+            stored_dump({nullptr, parsed.mut_handle ? parsed.mut_handle->root : nullptr}, arena, growing_tape, c_error);
             return;
         }
 
@@ -1526,17 +1806,19 @@ void read_modify_write( //
         if (!parsed.mut_handle)
             parsed.mut_handle = yyjson_doc_mut_copy(parsed.handle, &allocator);
 
-        json_t parsed_task = any_parse(contents[task_idx], c_type, arena, c_error);
+        if (!parsed_task)
+            parsed_task = any_parse(contents[task_idx], c_type, arena, c_error);
         return_if_error_m(c_error);
 
         // Perform modifications
         modify(parsed, parsed_task.mut_handle->root, field, c_modification, arena, c_error);
-        any_dump({nullptr, parsed.mut_handle->root}, internal_format_k, arena, growing_tape, c_error);
+        stored_dump({nullptr, parsed.mut_handle->root}, arena, growing_tape, c_error);
         return_if_error_m(c_error);
     };
 
     places_arg_t unique_places;
     auto opts = c_txn ? ustore_options_t(c_options & ~ustore_option_transaction_dont_watch_k) : c_options;
+    opts = ustore_options_t(opts & ~ustore_option_write_bulk_k);
     read_modify_docs(c_db, c_txn, places, opts, c_modification, arena, unique_places, c_error, safe_callback);
     return_if_error_m(c_error);
 
@@ -1562,147 +1844,1512 @@ void read_modify_write( //
     ustore_write(&write);
 }
 
-void ustore_docs_write(ustore_docs_write_t* c_ptr) {
+/**
+ * @brief Every `merge_kind_t::doc_k` operand contains the `doc_modification_t`
+ * byte, the NULL-terminated field, that may be empty, and the JSON modifier.
+ */
+constexpr std::size_t bytes_in_doc_merge_header_k = bytes_in_merge_header_k + 1;
 
-    ustore_docs_write_t& c = *c_ptr;
-    if (!c.tasks_count)
-        return;
+/**
+ * @brief Splits a `merge_kind_t::doc_k` operand into the modification, the field and the modifier.
+ * @return False, if the operand is malformed.
+ */
+bool parse_doc_operand(value_view_t operand,
+                       doc_modification_t& modification,
+                       ustore_str_view_t& field,
+                       value_view_t& modifier) noexcept {
+    if (operand.size() <= bytes_in_doc_merge_header_k)
+        return false;
+    modification = static_cast<doc_modification_t>(operand.data()[bytes_in_merge_header_k]);
+    auto field_begin = operand.c_str() + bytes_in_doc_merge_header_k;
+    auto field_limit = operand.size() - bytes_in_doc_merge_header_k;
+    auto field_length = strnlen(field_begin, field_limit);
+    if (field_length == field_limit)
+        return false;
+    field = field_length ? field_begin : nullptr;
+    modifier = value_view_t {field_begin + field_length + 1, field_limit - field_length - 1};
+    return true;
+}
 
-    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
-    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
-    return_if_error_m(c.error);
+/**
+ * @brief Applies all the @p operands, if each of them can be spliced into the tape in place.
+ * @return False, if the document must be parsed and rebuilt.
+ */
+bool splice_merge_operands(value_view_t base,
+                           merge_operands_t operands,
+                           std::string& result,
+                           linked_memory_lock_t& arena) noexcept(false) {
+    result.assign(base.c_str(), base.size());
+    for (value_view_t operand : operands) {
+        ustore_error_t error = nullptr;
+        doc_modification_t modification;
+        ustore_str_view_t field;
+        value_view_t modifier_bytes;
+        if (!parse_doc_operand(operand, modification, field, modifier_bytes))
+            return false;
+        json_t modifier = json_parse(modifier_bytes, arena, &error);
+        if (error || !modifier.mut_handle)
+            return false;
+        if (!splice_modification(result, modifier.mut_handle->root, field, modification))
+            return false;
+    }
+    return true;
+}
 
-    ptr_range_gt<ustore_key_t> tape;
-    if (!c.keys) {
-        return_error_if_m(c.values, c.error, uninitialized_state_k, "Keys and values is uninitialized");
-        return_error_if_m(c.id_field, c.error, uninitialized_state_k, "Keys and id_field is uninitialized");
+bool merge_doc_in_arena(value_view_t base, merge_operands_t operands, std::string& result, linked_memory_lock_t& arena) {
 
-        tape = arena.alloc<ustore_key_t>(c.tasks_count, c.error);
-        strided_iterator_gt<ustore_bytes_cptr_t const> vals {c.values, c.values_stride};
-        strided_iterator_gt<ustore_length_t const> lens {c.lengths, c.lengths_stride};
+    ustore_error_t error = nullptr;
+    if (is_tape(base) && splice_merge_operands(base, operands, result, arena))
+        return true;
 
-        simdjson::ondemand::parser parser;
-        for (size_t idx = 0; idx < c.tasks_count; ++idx, ++vals, ++lens) {
-            simdjson::ondemand::document doc = parser.iterate(*vals, *lens, 1000000ul);
-            simdjson::ondemand::object data = doc.get_object().value();
+    json_t doc = any_parse(base, internal_format_k, arena, &error);
+    if (error)
+        return false;
 
-            auto result = reset(data)[c.id_field];
-            return_error_if_m((simdjson::SUCCESS == result.error()),
-                              c.error,
-                              uninitialized_state_k,
-                              "Keys and values is uninitialized");
-            return_error_if_m(result.type() == simdjson::ondemand::json_type::number,
-                              c.error,
-                              args_wrong_k,
-                              "The id field does not have the ustore key type");
-            tape[idx] = result;
+    yyjson_alc allocator = wrap_allocator(arena);
+    for (value_view_t operand : operands) {
+        doc_modification_t modification;
+        ustore_str_view_t field;
+        value_view_t modifier_bytes;
+        if (!parse_doc_operand(operand, modification, field, modifier_bytes))
+            return false;
+
+        json_t modifier = json_parse(modifier_bytes, arena, &error);
+        if (error || !modifier)
+            return false;
+
+        // Missing documents are replaced with the modifier, just like in `modify`
+        if (!doc.mut_handle) {
+            doc.mut_handle = yyjson_mut_doc_new(&allocator);
+            doc.mut_handle->root = yyjson_mut_val_mut_copy(doc.mut_handle, modifier.mut_handle->root);
+            continue;
         }
-        c.keys_stride = sizeof(ustore_key_t);
+
+        // Failed modifications must not corrupt the document, so we apply them to a copy
+        json_t modified;
+        modified.mut_handle = yyjson_mut_doc_mut_copy(doc.mut_handle, &allocator);
+        if (!modified.mut_handle)
+            return false;
+        modify(modified, modifier.mut_handle->root, field, modification, arena, &error);
+        if (error)
+            error = nullptr;
+        else
+            doc = std::move(modified);
     }
-    // If user wants the entire doc in the same format, as the one we use internally,
-    // this request can be passed entirely to the underlying Key-Value store.
-    strided_iterator_gt<ustore_str_view_t const> fields {c.fields, c.fields_stride};
-    auto has_fields = fields && (!fields.repeats() || *fields);
-    strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
-    strided_iterator_gt<ustore_key_t const> keys {c.keys ? c.keys : tape.begin(), c.keys_stride};
-    bits_view_t presences {c.presences};
-    strided_iterator_gt<ustore_length_t const> offs {c.offsets, c.offsets_stride};
-    strided_iterator_gt<ustore_length_t const> lens {c.lengths, c.lengths_stride};
-    strided_iterator_gt<ustore_bytes_cptr_t const> vals {c.values, c.values_stride};
-    places_arg_t places {collections, keys, fields, c.tasks_count};
-    contents_arg_t contents {presences, offs, lens, vals, c.tasks_count};
 
-    if (has_fields || c.type != internal_format_k || c.modification != ustore_doc_modify_upsert_k)
-        return read_modify_write(c.db,
-                                 c.transaction,
-                                 places,
-                                 contents,
-                                 c.options,
-                                 static_cast<doc_modification_t>(c.modification),
-                                 c.type,
-                                 arena,
-                                 c.error);
+    if (!doc.mut_handle || !doc.mut_handle->root) {
+        result.clear();
+        return true;
+    }
+
+    if (tape_encode(doc.mut_handle->root, result))
+        return true;
+
+    std::size_t result_length = 0;
+    char* result_begin = yyjson_mut_write_opts(doc.mut_handle, 0, &allocator, &result_length, NULL);
+    if (!result_begin)
+        return false;
+    result.assign(result_begin, result_length);
+    return true;
+}
 
-    // Validate JSONs Before Write
-    ustore_length_t max_length = 0;
-    for (std::size_t i = 0; i != contents.size(); ++i) {
-        if (max_length < contents[i].size() && contents[i].size() != ustore_length_missing_k)
-            max_length = contents[i].size();
+bool unum::ustore::merge_doc(value_view_t base, merge_operands_t operands, std::string& result) noexcept {
+    ustore_arena_t c_arena = nullptr;
+    ustore_error_t error = nullptr;
+    bool success = false;
+    {
+        linked_memory_lock_t arena = linked_memory(&c_arena, ustore_options_default_k, &error);
+        safe_section("Merging documents", &error, [&] { success = merge_doc_in_arena(base, operands, result, arena); });
     }
+    clear_linked_memory(c_arena);
+    return success && !error;
+}
 
-    auto document = arena.alloc<byte_t>(max_length + sj::SIMDJSON_PADDING, c.error);
-    return_if_error_m(c.error);
+/**
+ * @brief Implements JSON-Patches and JSON-Merge-Patches on engines, that support
+ * `ustore_option_write_merge_k`. The modifiers are validated and converted into
+ * the internal format here, but are applied to the documents by the engine.
+ */
+void merge_docs( //
+    ustore_database_t const c_db,
+    places_arg_t const& places,
+    contents_arg_t const& contents,
+    ustore_options_t const c_options,
+    doc_modification_t const c_modification,
+    ustore_doc_field_type_t const c_type,
+    linked_memory_lock_t& arena,
+    ustore_error_t* c_error) noexcept {
+
+    auto merged_places = arena.alloc<collection_key_t>(places.count, c_error);
+    return_if_error_m(c_error);
+    growing_tape_t operands {arena};
+    operands.reserve(places.count, c_error);
+    return_if_error_m(c_error);
 
-    sj::dom::parser parser;
-    for (std::size_t i = 0; i < contents.size(); ++i) {
-        if (!contents[i].size())
+    yyjson_alc allocator = wrap_allocator(arena);
+    std::size_t merged_count = 0;
+    for (std::size_t task_idx = 0; task_idx != places.size(); ++task_idx) {
+        // Missing modifiers leave the documents untouched
+        value_view_t content = contents[task_idx];
+        if (!content)
             continue;
 
-        std::memcpy(document.begin(), contents[i].data(), contents[i].size());
-        std::memset(document.begin() + contents[i].size(), 0, sj::SIMDJSON_PADDING);
-        auto result = parser.parse((const char*)document.begin(), contents[i].size(), false);
-        return_error_if_m(result.error() == sj::SUCCESS, c.error, 0, "Invalid Json!");
+        json_t modifier = any_parse(content, c_type, arena, c_error);
+        return_if_error_m(c_error);
+        return_error_if_m(modifier.mut_handle, c_error, args_wrong_k, "Invalid modifier!");
+        std::size_t modifier_length = 0;
+        char* modifier_begin =
+            yyjson_mut_val_write_opts(modifier.mut_handle->root, 0, &allocator, &modifier_length, NULL);
+        return_error_if_m(modifier_begin, c_error, 0, "Failed to serialize the document!");
+
+        place_t place = places[task_idx];
+        std::size_t field_length = place.field ? std::strlen(place.field) : 0;
+        auto operand_length = bytes_in_doc_merge_header_k + field_length + 1 + modifier_length;
+        byte_t* operand = operands.push_back_uninitialized(operand_length, c_error);
+        return_if_error_m(c_error);
+        operand[0] = static_cast<byte_t>(merge_kind_t::doc_k);
+        operand[1] = static_cast<byte_t>(c_modification);
+        operand += bytes_in_doc_merge_header_k;
+        if (field_length)
+            std::memcpy(operand, place.field, field_length);
+        operand[field_length] = byte_t {0};
+        std::memcpy(operand + field_length + 1, modifier_begin, modifier_length);
+        merged_places[merged_count++] = place.collection_key();
     }
+    if (!merged_count)
+        return;
+
+    auto merged_strided = strided_range(merged_places.begin(), merged_places.begin() + merged_count).immutable();
+    auto collections = merged_strided.members(&collection_key_t::collection);
+    auto keys = merged_strided.members(&collection_key_t::key);
+    ustore_byte_t* tape_begin = reinterpret_cast<ustore_byte_t*>(operands.contents().begin().get());
 
     ustore_write_t write {};
-    write.db = c.db;
-    write.error = c.error;
-    write.transaction = c.transaction;
+    write.db = c_db;
+    write.error = c_error;
     write.arena = arena;
-    write.options = c.options;
-    write.tasks_count = c.tasks_count;
-    write.collections = c.collections;
-    write.collections_stride = c.collections_stride;
-    write.keys = c.keys ? c.keys : tape.begin();
-    write.keys_stride = c.keys_stride;
-    write.presences = c.presences;
-    write.offsets = c.offsets;
-    write.offsets_stride = c.offsets_stride;
-    write.lengths = c.lengths;
-    write.lengths_stride = c.lengths_stride;
-    write.values = c.values;
-    write.values_stride = c.values_stride;
+    write.options = ustore_options_t(c_options | ustore_option_write_merge_k);
+    write.tasks_count = merged_count;
+    write.collections = collections.begin().get();
+    write.collections_stride = collections.begin().stride();
+    write.keys = keys.begin().get();
+    write.keys_stride = keys.begin().stride();
+    write.offsets = operands.offsets().begin().get();
+    write.offsets_stride = operands.offsets().stride();
+    write.lengths = operands.lengths().begin().get();
+    write.lengths_stride = operands.lengths().stride();
+    write.values = &tape_begin;
 
     ustore_write(&write);
 }
 
-void ustore_docs_read(ustore_docs_read_t* c_ptr) {
+/*********************************************************/
+/*****************	 Shredded Documents	  ****************/
+/*********************************************************/
 
-    ustore_docs_read_t& c = *c_ptr;
-    if (!c.tasks_count)
+/**
+ * Shredded documents are split into a residual object, kept in the original
+ * collection, and the values of top-level fields, kept in companion collections
+ * under the same keys. Every part is a minified JSON, so single fields can be
+ * fetched and parsed without the rest of the document, and the whole document
+ * can be spliced back together without parsing. The residual is written even
+ * if it is empty, so that a document exists if and only if its residual does.
+ */
+struct shreds_t {
+    std::vector<std::string_view> fields;
+    std::vector<ustore_collection_t> collections;
+
+    std::size_t size() const noexcept { return fields.size(); }
+    std::size_t residual_idx() const noexcept { return fields.size(); }
+    std::size_t sources_count() const noexcept { return fields.size() + 1; }
+
+    /**
+     * @brief Locates the part of the document, containing the @p field.
+     * @return The index of the shred or `residual_idx()`, and the path within
+     * that part, which is NULL, if the whole part is addressed.
+     */
+    std::pair<std::size_t, ustore_str_view_t> locate(ustore_str_view_t field) const noexcept {
+        if (!field)
+            return {residual_idx(), nullptr};
+        if (field[0] != '/') {
+            auto it = std::find(fields.begin(), fields.end(), std::string_view(field));
+            if (it == fields.end())
+                return {residual_idx(), field};
+            return {static_cast<std::size_t>(it - fields.begin()), nullptr};
+        }
+
+        ustore_str_view_t segment_end = field + 1;
+        while (*segment_end && *segment_end != '/')
+            ++segment_end;
+        std::string_view segment {field + 1, static_cast<std::size_t>(segment_end - field - 1)};
+        for (std::size_t shred_idx = 0; shred_idx != fields.size(); ++shred_idx)
+            if (pointer_segment_equals(segment, fields[shred_idx]))
+                return {shred_idx, *segment_end ? segment_end : nullptr};
+        return {residual_idx(), field};
+    }
+
+    /**
+     * @brief Compares a JSON-Pointer segment, where `~0` and `~1` stand for `~` and `/`,
+     * with an unescaped name.
+     */
+    static bool pointer_segment_equals(std::string_view segment, std::string_view name) noexcept {
+        std::size_t name_idx = 0;
+        for (std::size_t idx = 0; idx != segment.size(); ++idx, ++name_idx) {
+            char c = segment[idx];
+            if (c == '~' && idx + 1 != segment.size())
+                c = segment[++idx] == '0' ? '~' : '/';
+            if (name_idx == name.size() || name[name_idx] != c)
+                return false;
+        }
+        return name_idx == name.size();
+    }
+};
+
+void parse_shreds( //
+    ustore_size_t const c_count,
+    ustore_str_view_t const* c_fields,
+    ustore_size_t const c_fields_stride,
+    ustore_collection_t const* c_collections,
+    ustore_size_t const c_collections_stride,
+    shreds_t& shreds,
+    ustore_error_t* c_error) noexcept {
+
+    if (!c_count)
         return;
 
-    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
-    return_if_error_m(c.error);
+    strided_iterator_gt<ustore_str_view_t const> fields {c_fields, c_fields_stride};
+    strided_iterator_gt<ustore_collection_t const> collections {c_collections, c_collections_stride};
+    return_error_if_m(fields && collections, c_error, args_wrong_k, "Shreds must have fields and collections");
+    safe_section("Parsing shreds", c_error, [&] {
+        shreds.fields.resize(c_count);
+        shreds.collections.resize(c_count);
+        for (std::size_t shred_idx = 0; shred_idx != c_count; ++shred_idx) {
+            ustore_str_view_t field = fields[shred_idx];
+            return_error_if_m(field && field[0] != '/',
+                              c_error,
+                              args_wrong_k,
+                              "Only top-level fields can be shredded");
+            shreds.fields[shred_idx] = field;
+            shreds.collections[shred_idx] = collections[shred_idx];
+        }
+    });
+}
 
-    // If user wants the entire doc in the same format, as the one we use internally,
-    // this request can be passed entirely to the underlying Key-Value store.
-    strided_iterator_gt<ustore_str_view_t const> fields {c.fields, c.fields_stride};
-    auto has_fields = fields && (!fields.repeats() || *fields);
-    if (!has_fields && c.type == internal_format_k) {
-        ustore_read_t read {};
-        read.db = c.db;
-        read.error = c.error;
-        read.transaction = c.transaction;
-        read.snapshot = c.snapshot;
-        read.arena = arena;
-        read.options = c.options;
-        read.tasks_count = c.tasks_count;
-        read.collections = c.collections;
-        read.collections_stride = c.collections_stride;
-        read.keys = c.keys;
-        read.keys_stride = c.keys_stride;
-        read.presences = c.presences;
-        read.offsets = c.offsets;
-        read.lengths = c.lengths;
-        read.values = c.values;
+/**
+ * @brief Parts of shredded documents, read from the needed sources.
+ * The residual parts are always read, if only to check which documents exist.
+ */
+struct shredded_reads_t {
+    std::vector<ustore_length_t*> offsets;
+    std::vector<ustore_byte_t*> values;
+    ustore_octet_t* residual_presences = nullptr;
 
-        return ustore_read(&read);
+    value_view_t at(std::size_t source_idx, std::size_t doc_idx) const noexcept {
+        if (!offsets[source_idx])
+            return {};
+        return *joined_blobs_iterator_t {offsets[source_idx] + doc_idx, values[source_idx]};
     }
 
-    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    bool exists(std::size_t doc_idx) const noexcept {
+        if (residual_presences)
+            return bits_view_t {residual_presences}[doc_idx];
+        return !at(offsets.size() - 1, doc_idx).empty();
+    }
+};
 
-    strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
+shredded_reads_t read_shredded( //
+    ustore_database_t const c_db,
+    ustore_transaction_t const c_txn,
+    ustore_snapshot_t const c_snapshot,
+    places_arg_t const& docs,
+    shreds_t const& shreds,
+    std::vector<bool> const& needed,
+    ustore_options_t const c_options,
+    linked_memory_lock_t& arena,
+    ustore_error_t* c_error) noexcept(false) {
+
+    shredded_reads_t reads;
+    reads.offsets.resize(shreds.sources_count(), nullptr);
+    reads.values.resize(shreds.sources_count(), nullptr);
+    for (std::size_t source_idx = 0; source_idx != shreds.sources_count(); ++source_idx) {
+        bool is_residual = source_idx == shreds.residual_idx();
+        if (!needed[source_idx] && !is_residual)
+            continue;
+
+        ustore_read_t read {};
+        read.db = c_db;
+        read.error = c_error;
+        read.transaction = c_txn;
+        read.snapshot = c_snapshot;
+        read.arena = arena;
+        read.options = c_options;
+        read.tasks_count = docs.count;
+        read.collections = is_residual ? docs.collections_begin.get() : &shreds.collections[source_idx];
+        read.collections_stride = is_residual ? docs.collections_begin.stride() : 0;
+        read.keys = docs.keys_begin.get();
+        read.keys_stride = docs.keys_begin.stride();
+        if (needed[source_idx]) {
+            read.offsets = &reads.offsets[source_idx];
+            read.values = &reads.values[source_idx];
+        }
+        else
+            read.presences = &reads.residual_presences;
+        ustore_read(&read);
+        if (*c_error)
+            break;
+    }
+    return reads;
+}
+
+/**
+ * @brief Splices the shredded values back into the residual object, without parsing.
+ * Missing documents are exported as empty strings.
+ */
+void reassemble_doc(shredded_reads_t const& reads,
+                    shreds_t const& shreds,
+                    std::size_t doc_idx,
+                    std::string& doc) noexcept(false) {
+
+    doc.clear();
+    std::string_view residual = reads.at(shreds.residual_idx(), doc_idx);
+    std::string printed;
+    if (is_tape(residual)) {
+        if (!tape_to_json(tape_root(residual), printed))
+            return;
+        residual = printed;
+    }
+    if (residual.empty())
+        return;
+    if (residual.front() != '{') {
+        doc = residual;
+        return;
+    }
+
+    doc.push_back('{');
+    for (std::size_t shred_idx = 0; shred_idx != shreds.size(); ++shred_idx) {
+        std::string_view value = reads.at(shred_idx, doc_idx);
+        if (value.empty())
+            continue;
+        if (doc.size() > 1)
+            doc.push_back(',');
+        append_json_string(doc, shreds.fields[shred_idx]);
+        doc.push_back(':');
+        doc.append(value);
+    }
+    std::string_view members = residual.substr(1, residual.size() - 2);
+    if (!members.empty() && doc.size() > 1)
+        doc.push_back(',');
+    doc.append(members);
+    doc.push_back('}');
+}
+
+std::vector<std::string> read_reassembled_docs( //
+    ustore_database_t const c_db,
+    ustore_transaction_t const c_txn,
+    std::vector<collection_key_t> const& docs,
+    shreds_t const& shreds,
+    ustore_options_t const c_options,
+    linked_memory_lock_t& arena,
+    ustore_error_t* c_error) noexcept(false) {
+
+    std::vector<std::string> results(docs.size());
+    if (docs.empty())
+        return results;
+
+    places_arg_t places;
+    places.collections_begin = {&docs[0].collection, sizeof(collection_key_t)};
+    places.keys_begin = {&docs[0].key, sizeof(collection_key_t)};
+    places.count = static_cast<ustore_size_t>(docs.size());
+    std::vector<bool> needed(shreds.sources_count(), true);
+    auto reads = read_shredded(c_db, c_txn, {}, places, shreds, needed, c_options, arena, c_error);
+    if (*c_error)
+        return results;
+
+    for (std::size_t doc_idx = 0; doc_idx != docs.size(); ++doc_idx)
+        reassemble_doc(reads, shreds, doc_idx, results[doc_idx]);
+    return results;
+}
+
+/**
+ * @brief Reads only the parts of shredded documents, containing the requested fields,
+ * calling @p callback with every padded JSON and the path within it.
+ */
+template <typename callback_at>
+void read_shredded_docs( //
+    ustore_database_t const c_db,
+    ustore_transaction_t const c_txn,
+    ustore_snapshot_t const c_snapshot,
+    places_arg_t const& places,
+    shreds_t const& shreds,
+    ustore_options_t const c_options,
+    linked_memory_lock_t& arena,
+    ustore_error_t* c_error,
+    callback_at callback) noexcept(false) {
+
+    // Whole documents need all the parts
+    std::size_t const whole_idx = shreds.sources_count();
+    std::vector<std::pair<std::size_t, ustore_str_view_t>> sources(places.size());
+    std::vector<bool> needed(shreds.sources_count(), false);
+    for (std::size_t task_idx = 0; task_idx != places.size(); ++task_idx) {
+        ustore_str_view_t field = places.fields_begin ? places.fields_begin[task_idx] : nullptr;
+        sources[task_idx] = field ? shreds.locate(field) : std::make_pair(whole_idx, field);
+        if (field)
+            needed[sources[task_idx].first] = true;
+        else
+            std::fill(needed.begin(), needed.end(), true);
+    }
+
+    auto reads = read_shredded(c_db, c_txn, c_snapshot, places, shreds, needed, c_options, arena, c_error);
+    return_if_error_m(c_error);
+
+    std::string doc;
+    for (std::size_t task_idx = 0; task_idx != places.size(); ++task_idx) {
+        auto [source_idx, field] = sources[task_idx];
+        if (source_idx == whole_idx)
+            reassemble_doc(reads, shreds, task_idx, doc);
+        else
+            doc = std::string_view(reads.at(source_idx, task_idx));
+        if (doc.empty()) {
+            callback(task_idx, field, value_view_t::make_empty());
+            continue;
+        }
+
+        std::size_t doc_length = doc.size();
+        doc.resize(doc_length + sj::SIMDJSON_PADDING, '\0');
+        callback(task_idx, field, value_view_t(doc.data(), doc_length));
+        return_if_error_m(c_error);
+    }
+}
+
+/**
+ * @brief Splits the documents into residuals and shredded values, writing all of
+ * them in one batch. Patches and other modifications are first applied to the
+ * reassembled documents with the regular path, and are split afterwards.
+ */
+void write_shredded_docs( //
+    ustore_docs_write_t& c,
+    places_arg_t const& places,
+    contents_arg_t const& contents,
+    linked_memory_lock_t& arena) noexcept {
+
+    shreds_t shreds;
+    parse_shreds(c.shreds_count,
+                 c.shreds_fields,
+                 c.shreds_fields_stride,
+                 c.shreds_collections,
+                 c.shreds_collections_stride,
+                 shreds,
+                 c.error);
+    return_if_error_m(c.error);
+
+    safe_section("Shredding documents", c.error, [&] {
+        strided_iterator_gt<ustore_str_view_t const> fields {c.fields, c.fields_stride};
+        auto has_fields = fields && (!fields.repeats() || *fields);
+        std::vector<collection_key_t> docs;
+        std::vector<value_view_t> contents_per_doc;
+        ustore_doc_field_type_t contents_type = c.type;
+        ustore_length_t* found_offsets {};
+        ustore_byte_t* found_values {};
+
+        if (!has_fields && c.modification == ustore_doc_modify_upsert_k) {
+            // Only the last submission of every document matters
+            std::vector<std::size_t> tasks(places.size());
+            std::iota(tasks.begin(), tasks.end(), 0);
+            std::stable_sort(tasks.begin(), tasks.end(), [&](std::size_t a, std::size_t b) {
+                return places[a].collection_key() < places[b].collection_key();
+            });
+            for (std::size_t idx = 0; idx != tasks.size(); ++idx) {
+                collection_key_t doc = places[tasks[idx]].collection_key();
+                if (idx + 1 != tasks.size() && places[tasks[idx + 1]].collection_key() == doc)
+                    continue;
+                docs.push_back(doc);
+                contents_per_doc.push_back(contents[tasks[idx]]);
+            }
+        }
+        else {
+            docs.resize(places.size());
+            for (std::size_t task_idx = 0; task_idx != places.size(); ++task_idx)
+                docs[task_idx] = places[task_idx].collection_key();
+            sort_and_deduplicate(docs);
+
+            // Put the whole documents back, to modify them as usual
+            auto whole_docs = read_reassembled_docs(c.db, c.transaction, docs, shreds, c.options, arena, c.error);
+            return_if_error_m(c.error);
+            std::vector<ustore_bytes_cptr_t> whole_values(docs.size());
+            std::vector<ustore_length_t> whole_lengths(docs.size());
+            for (std::size_t doc_idx = 0; doc_idx != docs.size(); ++doc_idx) {
+                std::string const& whole_doc = whole_docs[doc_idx];
+                whole_values[doc_idx] = whole_doc.empty() ? nullptr : (ustore_bytes_cptr_t)whole_doc.data();
+                whole_lengths[doc_idx] = static_cast<ustore_length_t>(whole_doc.size());
+            }
+
+            ustore_write_t write {};
+            write.db = c.db;
+            write.error = c.error;
+            write.transaction = c.transaction;
+            write.arena = arena;
+            write.options = c.options;
+            write.tasks_count = static_cast<ustore_size_t>(docs.size());
+            write.collections = &docs[0].collection;
+            write.collections_stride = sizeof(collection_key_t);
+            write.keys = &docs[0].key;
+            write.keys_stride = sizeof(collection_key_t);
+            write.lengths = whole_lengths.data();
+            write.lengths_stride = sizeof(ustore_length_t);
+            write.values = whole_values.data();
+            write.values_stride = sizeof(ustore_bytes_cptr_t);
+            ustore_write(&write);
+            return_if_error_m(c.error);
+
+            ustore_docs_write_t unshredded = c;
+            unshredded.arena = arena;
+            unshredded.keys = places.keys_begin.get();
+            unshredded.keys_stride = places.keys_begin.stride();
+            unshredded.shreds_count = 0;
+            ustore_docs_write(&unshredded);
+            return_if_error_m(c.error);
+
+            ustore_read_t read {};
+            read.db = c.db;
+            read.error = c.error;
+            read.transaction = c.transaction;
+            read.arena = arena;
+            read.options = c.options;
+            read.tasks_count = static_cast<ustore_size_t>(docs.size());
+            read.collections = &docs[0].collection;
+            read.collections_stride = sizeof(collection_key_t);
+            read.keys = &docs[0].key;
+            read.keys_stride = sizeof(collection_key_t);
+            read.offsets = &found_offsets;
+            read.values = &found_values;
+            ustore_read(&read);
+            return_if_error_m(c.error);
+
+            contents_type = internal_format_k;
+            for (std::size_t doc_idx = 0; doc_idx != docs.size(); ++doc_idx)
+                contents_per_doc.push_back(*joined_blobs_iterator_t {found_offsets + doc_idx, found_values});
+        }
+
+        // Every document produces a residual and a value for each shred, which are
+        // `ustore_length_missing_k` long for the parts that must be removed.
+        std::size_t const sources_count = shreds.sources_count();
+        std::size_t const parts_count = docs.size() * sources_count;
+        std::vector<ustore_collection_t> parts_collections(parts_count);
+        std::vector<ustore_key_t> parts_keys(parts_count);
+        std::vector<ustore_length_t> parts_offsets(parts_count);
+        std::vector<ustore_length_t> parts_lengths(parts_count, ustore_length_missing_k);
+        std::vector<byte_t> tape;
+        auto append_part = [&](std::size_t part_idx, char const* part, std::size_t length) {
+            parts_offsets[part_idx] = static_cast<ustore_length_t>(tape.size());
+            parts_lengths[part_idx] = static_cast<ustore_length_t>(length);
+            auto bytes = reinterpret_cast<byte_t const*>(part);
+            tape.insert(tape.end(), bytes, bytes + length);
+        };
+
+        yyjson_alc allocator = wrap_allocator(arena);
+        for (std::size_t doc_idx = 0; doc_idx != docs.size(); ++doc_idx) {
+            std::size_t const parts_begin = doc_idx * sources_count;
+            for (std::size_t source_idx = 0; source_idx != sources_count; ++source_idx) {
+                bool is_residual = source_idx == shreds.residual_idx();
+                parts_collections[parts_begin + source_idx] =
+                    is_residual ? docs[doc_idx].collection : shreds.collections[source_idx];
+                parts_keys[parts_begin + source_idx] = docs[doc_idx].key;
+            }
+
+            value_view_t content = contents_per_doc[doc_idx];
+            if (content.empty())
+                continue;
+            json_t parsed = any_parse(content, contents_type, arena, c.error);
+            return_if_error_m(c.error);
+            return_error_if_m(parsed.mut_handle, c.error, args_wrong_k, "Failed to parse document!");
+
+            yyjson_mut_doc* doc = parsed.mut_handle;
+            yyjson_mut_val* root = yyjson_mut_doc_get_root(doc);
+            std::size_t part_length = 0;
+            if (yyjson_mut_is_obj(root)) {
+                for (std::size_t shred_idx = 0; shred_idx != shreds.size(); ++shred_idx) {
+                    std::string_view name = shreds.fields[shred_idx];
+                    yyjson_mut_val* value = yyjson_mut_obj_getn(root, name.data(), name.size());
+                    if (!value)
+                        continue;
+                    char* part = yyjson_mut_val_write_opts(value, 0, &allocator, &part_length, NULL);
+                    return_error_if_m(part, c.error, 0, "Failed to serialize the document!");
+                    append_part(parts_begin + shred_idx, part, part_length);
+                    yyjson_mut_obj_remove(root, yyjson_mut_strncpy(doc, name.data(), name.size()));
+                }
+            }
+            char* residual = yyjson_mut_write_opts(doc, 0, &allocator, &part_length, NULL);
+            return_error_if_m(residual, c.error, 0, "Failed to serialize the document!");
+            append_part(parts_begin + shreds.residual_idx(), residual, part_length);
+        }
+
+        std::vector<ustore_bytes_cptr_t> parts_values(parts_count);
+        for (std::size_t part_idx = 0; part_idx != parts_count; ++part_idx)
+            parts_values[part_idx] =
+                parts_lengths[part_idx] == ustore_length_missing_k ? nullptr : (ustore_bytes_cptr_t)tape.data();
+
+        ustore_write_t write {};
+        write.db = c.db;
+        write.error = c.error;
+        write.transaction = c.transaction;
+        write.arena = arena;
+        write.options = c.options;
+        write.tasks_count = static_cast<ustore_size_t>(parts_count);
+        write.collections = parts_collections.data();
+        write.collections_stride = sizeof(ustore_collection_t);
+        write.keys = parts_keys.data();
+        write.keys_stride = sizeof(ustore_key_t);
+        write.offsets = parts_offsets.data();
+        write.offsets_stride = sizeof(ustore_length_t);
+        write.lengths = parts_lengths.data();
+        write.lengths_stride = sizeof(ustore_length_t);
+        write.values = parts_values.data();
+        write.values_stride = sizeof(ustore_bytes_cptr_t);
+        ustore_write(&write);
+    });
+}
+
+/*********************************************************/
+/*****************	 Secondary Indexes	  ****************/
+/*********************************************************/
+
+/**
+ * Every entry of an index collection is a posting list of all the documents,
+ * which contain a certain value in the indexed field. It is a concatenation of
+ * `[doc key: 8 bytes][type: 1 byte][length: 4 bytes][value bytes]` records,
+ * sorted by the type, value bytes and the document key. The records keep the
+ * value bytes, as different strings may hash into the same entry.
+ *
+ * Numbers are keyed by an order-preserving transformation of their `double`
+ * representation, so ranges of numbers become ranges of keys. Other values
+ * are keyed by their hashes. Numbers carry no bytes, as their keys are unique.
+ */
+enum class indexed_type_t : std::uint8_t {
+    null_k = 0,
+    bool_k = 1,
+    number_k = 2,
+    string_k = 3,
+};
+
+constexpr std::size_t posting_header_size_k = sizeof(ustore_key_t) + sizeof(std::uint8_t) + sizeof(std::uint32_t);
+constexpr ustore_length_t index_scan_read_ahead_k = 256;
+constexpr std::size_t index_build_batch_k = 4096;
+
+struct indexed_value_t {
+    ustore_key_t key = 0;
+    indexed_type_t type = indexed_type_t::null_k;
+    std::string bytes;
+
+    bool operator==(indexed_value_t const& other) const noexcept {
+        return type == other.type && bytes == other.bytes && key == other.key;
+    }
+    bool operator!=(indexed_value_t const& other) const noexcept { return !operator==(other); }
+};
+
+struct posting_t {
+    ustore_key_t doc = 0;
+    indexed_type_t type = indexed_type_t::null_k;
+    std::string_view bytes;
+
+    bool operator<(posting_t const& other) const noexcept {
+        return type != other.type    ? type < other.type
+               : bytes != other.bytes ? bytes < other.bytes
+                                      : doc < other.doc;
+    }
+    bool operator==(posting_t const& other) const noexcept {
+        return doc == other.doc && type == other.type && bytes == other.bytes;
+    }
+};
+
+/**
+ * @brief Describes a change to a single posting list.
+ * The value is kept by-value, as the source documents are gone by the time
+ * the posting lists are updated.
+ */
+struct posting_change_t {
+    ustore_collection_t index = ustore_collection_main_k;
+    ustore_key_t doc = 0;
+    indexed_value_t value;
+    bool is_insertion = false;
+};
+
+ustore_key_t number_to_index_key(double number) noexcept {
+    // Both zeros must map into the same key
+    if (number == 0)
+        number = 0;
+    std::int64_t bits;
+    std::memcpy(&bits, &number, sizeof(bits));
+    // Negative numbers are ordered in reverse, when compared as integers
+    return bits < 0 ? bits ^ std::numeric_limits<std::int64_t>::max() : bits;
+}
+
+ustore_key_t bytes_to_index_key(indexed_type_t type, std::string_view bytes) noexcept {
+    auto hash = hash_bytes(bytes.data(), bytes.size(), static_cast<std::uint64_t>(type));
+    auto key = static_cast<ustore_key_t>(hash);
+    return key == ustore_key_unknown_k ? key - 1 : key;
+}
+
+/**
+ * @brief Extracts any numeric JSON value as a `double`, rejecting `NaN`s.
+ */
+bool json_to_number(yyjson_val* value, double& number) noexcept {
+    switch (yyjson_get_subtype(value)) {
+    case YYJSON_SUBTYPE_UINT: number = static_cast<double>(yyjson_get_uint(value)); break;
+    case YYJSON_SUBTYPE_SINT: number = static_cast<double>(yyjson_get_sint(value)); break;
+    case YYJSON_SUBTYPE_REAL: number = yyjson_get_real(value); break;
+    default: return false;
+    }
+    return !std::isnan(number);
+}
+
+/**
+ * @brief Converts a scalar JSON value into its representation in the index.
+ * @return Empty object for arrays, objects, `NaN`s and missing values.
+ */
+std::optional<indexed_value_t> index_json(yyjson_val* value) noexcept(false) {
+    indexed_value_t result;
+    switch (yyjson_get_type(value)) {
+    case YYJSON_TYPE_NULL:
+        result.type = indexed_type_t::null_k;
+        break;
+    case YYJSON_TYPE_BOOL:
+        result.type = indexed_type_t::bool_k;
+        result.bytes = yyjson_is_true(value) ? "1" : "0";
+        break;
+    case YYJSON_TYPE_STR:
+        result.type = indexed_type_t::string_k;
+        result.bytes = std::string(yyjson_get_str(value), yyjson_get_len(value));
+        break;
+    case YYJSON_TYPE_NUM: {
+        double number = 0;
+        if (!json_to_number(value, number))
+            return std::nullopt;
+        result.type = indexed_type_t::number_k;
+        result.key = number_to_index_key(number);
+        return result;
+    }
+    default: return std::nullopt;
+    }
+    result.key = bytes_to_index_key(result.type, result.bytes);
+    return result;
+}
+
+/**
+ * @brief Compares a JSON value with a literal, converted by `index_json()`.
+ * @return Negative, zero or positive number, or an empty object if the types differ.
+ */
+std::optional<int> compare_json(yyjson_val* value, indexed_value_t const& literal) noexcept {
+    auto three_way = [](auto a, auto b) { return static_cast<int>(a > b) - static_cast<int>(a < b); };
+    switch (yyjson_get_type(value)) {
+    case YYJSON_TYPE_NULL:
+        if (literal.type == indexed_type_t::null_k)
+            return 0;
+        break;
+    case YYJSON_TYPE_BOOL:
+        if (literal.type == indexed_type_t::bool_k)
+            return three_way(yyjson_is_true(value), literal.bytes == "1");
+        break;
+    case YYJSON_TYPE_STR:
+        if (literal.type == indexed_type_t::string_k)
+            return three_way(std::string_view(yyjson_get_str(value), yyjson_get_len(value)).compare(literal.bytes), 0);
+        break;
+    case YYJSON_TYPE_NUM: {
+        // The keys of numbers preserve their order
+        double number = 0;
+        if (literal.type == indexed_type_t::number_k && json_to_number(value, number))
+            return three_way(number_to_index_key(number), literal.key);
+        break;
+    }
+    default: break;
+    }
+    return std::nullopt;
+}
+
+/**
+ * @brief Parses a JSON document or a scalar, calling @p callback with its root.
+ * Unlike `json_parse()`, skips the mutable copy.
+ */
+template <typename callback_at>
+void with_parsed_json(value_view_t bytes, linked_memory_lock_t& arena, callback_at&& callback) noexcept(false) {
+    if (bytes.empty())
+        return;
+    yyjson_alc allocator = wrap_allocator(arena);
+    yyjson_read_flag flg = YYJSON_READ_ALLOW_COMMENTS | YYJSON_READ_ALLOW_INF_AND_NAN;
+    yyjson_doc* doc = yyjson_read_opts((char*)bytes.data(), (size_t)bytes.size(), flg, &allocator, NULL);
+    if (!doc)
+        return;
+    callback(yyjson_doc_get_root(doc));
+    yyjson_doc_free(doc);
+}
+
+/**
+ * @brief Stored document, that is either a binary tape, queried in place, or a parsed
+ * textual JSON. Uses the default allocator, so that it can be reused across documents
+ * in any thread.
+ */
+class stored_doc_t {
+    static constexpr std::size_t scalars_limit_k = 4096;
+
+    yyjson_doc* parsed_ = nullptr;
+    tape_node_t tape_;
+    yyjson_mut_doc* scalars_ = nullptr;
+    std::size_t scalars_count_ = 0;
+
+  public:
+    stored_doc_t() noexcept = default;
+    stored_doc_t(stored_doc_t const&) = delete;
+    stored_doc_t& operator=(stored_doc_t const&) = delete;
+    stored_doc_t(stored_doc_t&& other) noexcept
+        : parsed_(std::exchange(other.parsed_, nullptr)), tape_(std::exchange(other.tape_, {})),
+          scalars_(std::exchange(other.scalars_, nullptr)), scalars_count_(std::exchange(other.scalars_count_, 0)) {}
+    ~stored_doc_t() noexcept {
+        clear();
+        if (scalars_)
+            yyjson_mut_doc_free(scalars_);
+    }
+
+    void clear() noexcept {
+        if (parsed_)
+            yyjson_doc_free(parsed_);
+        parsed_ = nullptr;
+        tape_ = {};
+    }
+
+    /**
+     * @brief Replaces the document, invalidating the previously found values.
+     * @return False, if the document can't be parsed.
+     */
+    bool reset(value_view_t bytes) noexcept {
+        clear();
+        if (scalars_count_ >= scalars_limit_k) {
+            yyjson_mut_doc_free(scalars_);
+            scalars_ = nullptr;
+            scalars_count_ = 0;
+        }
+        if (bytes.empty())
+            return true;
+        if (is_tape(bytes)) {
+            tape_ = tape_root(bytes);
+            return bool(tape_);
+        }
+        yyjson_read_flag const read_flags = YYJSON_READ_ALLOW_COMMENTS | YYJSON_READ_ALLOW_INF_AND_NAN;
+        parsed_ = yyjson_read_opts((char*)bytes.data(), bytes.size(), read_flags, NULL, NULL);
+        return parsed_;
+    }
+
+    /** @brief The root of a parsed textual document, or NULL for tapes. */
+    yyjson_val* root() const noexcept { return parsed_ ? yyjson_doc_get_root(parsed_) : nullptr; }
+    /** @brief The root of a binary tape, or an empty node for textual documents. */
+    tape_node_t tape() const noexcept { return tape_; }
+
+    /**
+     * @brief Finds a member by name or a nested value by a JSON-Pointer.
+     * Values found in tapes are materialized as standalone scalars, while
+     * the containers only preserve their types.
+     */
+    yyjson_val* lookup(ustore_str_view_t field) noexcept(false) {
+        if (parsed_)
+            return json_lookup(yyjson_doc_get_root(parsed_), field);
+
+        tape_node_t node = tape_ ? tape_.lookup(field) : tape_node_t {};
+        if (!node)
+            return nullptr;
+        if (!scalars_)
+            scalars_ = yyjson_mut_doc_new(NULL);
+        if (!scalars_)
+            return nullptr;
+
+        ++scalars_count_;
+        yyjson_mut_val* value = nullptr;
+        switch (node.type()) {
+        case tape_type_t::null_k: value = yyjson_mut_null(scalars_); break;
+        case tape_type_t::false_k: value = yyjson_mut_false(scalars_); break;
+        case tape_type_t::true_k: value = yyjson_mut_true(scalars_); break;
+        case tape_type_t::sint_k: value = yyjson_mut_sint(scalars_, node.sint()); break;
+        case tape_type_t::uint_k: value = yyjson_mut_uint(scalars_, node.uint()); break;
+        case tape_type_t::real_k: value = yyjson_mut_real(scalars_, node.real()); break;
+        case tape_type_t::string_k: value = yyjson_mut_strn(scalars_, node.str().data(), node.str().size()); break;
+        case tape_type_t::array_k: value = yyjson_mut_arr(scalars_); break;
+        case tape_type_t::object_k: value = yyjson_mut_obj(scalars_); break;
+        default: break;
+        }
+        // Scalars share the layout of immutable values, just like in `json_branch_t::punned`
+        return reinterpret_cast<yyjson_val*>(value);
+    }
+};
+
+template <typename callback_at>
+void for_each_posting(value_view_t entry, callback_at&& callback) noexcept(false) {
+    byte_t const* begin = entry.begin();
+    byte_t const* end = entry.end();
+    while (begin + posting_header_size_k <= end) {
+        posting_t posting;
+        std::uint32_t length;
+        std::memcpy(&posting.doc, begin, sizeof(ustore_key_t));
+        posting.type = static_cast<indexed_type_t>(begin[sizeof(ustore_key_t)]);
+        std::memcpy(&length, begin + sizeof(ustore_key_t) + sizeof(std::uint8_t), sizeof(length));
+        begin += posting_header_size_k;
+        posting.bytes = std::string_view(reinterpret_cast<char const*>(begin), length);
+        begin += length;
+        callback(posting);
+    }
+}
+
+void append_posting(posting_t const& posting, std::vector<byte_t>& entry) noexcept(false) {
+    std::size_t offset = entry.size();
+    auto length = static_cast<std::uint32_t>(posting.bytes.size());
+    entry.resize(offset + posting_header_size_k + length);
+    byte_t* output = entry.data() + offset;
+    std::memcpy(output, &posting.doc, sizeof(ustore_key_t));
+    output[sizeof(ustore_key_t)] = static_cast<byte_t>(posting.type);
+    std::memcpy(output + sizeof(ustore_key_t) + sizeof(std::uint8_t), &length, sizeof(length));
+    std::memcpy(output + posting_header_size_k, posting.bytes.data(), length);
+}
+
+/**
+ * @brief Reads the documents and extracts the indexed values from them.
+ * @return Optional values for every `(document, field)` pair, in the row-major order.
+ */
+std::vector<std::optional<indexed_value_t>> read_indexed_values( //
+    ustore_database_t const c_db,
+    ustore_transaction_t const c_txn,
+    std::vector<collection_key_t> const& docs,
+    std::vector<ustore_str_view_t> const& fields,
+    shreds_t const& shreds,
+    ustore_options_t const c_options,
+    linked_memory_lock_t& arena,
+    ustore_error_t* c_error) noexcept(false) {
+
+    std::vector<std::optional<indexed_value_t>> results(docs.size() * fields.size());
+    if (docs.empty())
+        return results;
+
+    stored_doc_t stored;
+    auto export_values = [&](std::size_t doc_idx, value_view_t doc) {
+        if (!stored.reset(doc))
+            return;
+        for (std::size_t field_idx = 0; field_idx != fields.size(); ++field_idx)
+            if (yyjson_val* value = stored.lookup(fields[field_idx]))
+                results[doc_idx * fields.size() + field_idx] = index_json(value);
+    };
+
+    if (shreds.size()) {
+        auto whole_docs = read_reassembled_docs(c_db, c_txn, docs, shreds, c_options, arena, c_error);
+        if (*c_error)
+            return results;
+        for (std::size_t doc_idx = 0; doc_idx != docs.size(); ++doc_idx)
+            export_values(doc_idx, std::string_view(whole_docs[doc_idx]));
+        return results;
+    }
+
+    ustore_length_t* found_offsets {};
+    ustore_length_t* found_lengths {};
+    ustore_byte_t* found_values {};
+    ustore_read_t read {};
+    read.db = c_db;
+    read.error = c_error;
+    read.transaction = c_txn;
+    read.arena = arena;
+    read.options = c_options;
+    read.tasks_count = static_cast<ustore_size_t>(docs.size());
+    read.collections = &docs[0].collection;
+    read.collections_stride = sizeof(collection_key_t);
+    read.keys = &docs[0].key;
+    read.keys_stride = sizeof(collection_key_t);
+    read.offsets = &found_offsets;
+    read.lengths = &found_lengths;
+    read.values = &found_values;
+    ustore_read(&read);
+    if (*c_error)
+        return results;
+
+    for (std::size_t doc_idx = 0; doc_idx != docs.size(); ++doc_idx)
+        if (found_lengths[doc_idx] != ustore_length_missing_k)
+            export_values(doc_idx, {found_values + found_offsets[doc_idx], found_lengths[doc_idx]});
+    return results;
+}
+
+/**
+ * @brief Applies insertions and removals to the posting lists with one
+ * batched read and one batched write of all the affected index entries.
+ */
+void apply_posting_changes( //
+    ustore_database_t const c_db,
+    ustore_transaction_t const c_txn,
+    std::vector<posting_change_t>& changes,
+    ustore_options_t const c_options,
+    linked_memory_lock_t& arena,
+    ustore_error_t* c_error) noexcept(false) {
+
+    if (changes.empty())
+        return;
+
+    // Group the changes by entries, keeping the submission order
+    std::stable_sort(changes.begin(), changes.end(), [](posting_change_t const& a, posting_change_t const& b) {
+        return collection_key_t {a.index, a.value.key} < collection_key_t {b.index, b.value.key};
+    });
+    std::vector<collection_key_t> entries_keys;
+    for (posting_change_t const& change : changes) {
+        collection_key_t entry_key {change.index, change.value.key};
+        if (entries_keys.empty() || entries_keys.back() != entry_key)
+            entries_keys.push_back(entry_key);
+    }
+
+    ustore_length_t* found_offsets {};
+    ustore_length_t* found_lengths {};
+    ustore_byte_t* found_values {};
+    ustore_read_t read {};
+    read.db = c_db;
+    read.error = c_error;
+    read.transaction = c_txn;
+    read.arena = arena;
+    read.options = c_options;
+    read.tasks_count = static_cast<ustore_size_t>(entries_keys.size());
+    read.collections = &entries_keys[0].collection;
+    read.collections_stride = sizeof(collection_key_t);
+    read.keys = &entries_keys[0].key;
+    read.keys_stride = sizeof(collection_key_t);
+    read.offsets = &found_offsets;
+    read.lengths = &found_lengths;
+    read.values = &found_values;
+    ustore_read(&read);
+    return_if_error_m(c_error);
+
+    std::vector<byte_t> tape;
+    std::vector<ustore_length_t> offsets(entries_keys.size() + 1);
+    std::vector<ustore_length_t> lengths(entries_keys.size());
+    std::vector<posting_t> postings;
+    auto change_it = changes.begin();
+    for (std::size_t entry_idx = 0; entry_idx != entries_keys.size(); ++entry_idx) {
+        postings.clear();
+        if (found_lengths[entry_idx] != ustore_length_missing_k) {
+            value_view_t entry {found_values + found_offsets[entry_idx], found_lengths[entry_idx]};
+            for_each_posting(entry, [&](posting_t const& posting) { postings.push_back(posting); });
+        }
+
+        for (; change_it != changes.end() && collection_key_t {change_it->index, change_it->value.key} ==
+                                                 entries_keys[entry_idx];
+             ++change_it) {
+            posting_t posting {change_it->doc, change_it->value.type, change_it->value.bytes};
+            auto it = std::lower_bound(postings.begin(), postings.end(), posting);
+            bool exists = it != postings.end() && *it == posting;
+            if (change_it->is_insertion && !exists)
+                postings.insert(it, posting);
+            else if (!change_it->is_insertion && exists)
+                postings.erase(it);
+        }
+
+        offsets[entry_idx] = static_cast<ustore_length_t>(tape.size());
+        for (posting_t const& posting : postings)
+            append_posting(posting, tape);
+        lengths[entry_idx] = postings.empty() ? ustore_length_missing_k
+                                              : static_cast<ustore_length_t>(tape.size()) - offsets[entry_idx];
+    }
+
+    // Empty posting lists are removed
+    std::vector<ustore_bytes_cptr_t> values(entries_keys.size());
+    for (std::size_t entry_idx = 0; entry_idx != entries_keys.size(); ++entry_idx)
+        values[entry_idx] = lengths[entry_idx] == ustore_length_missing_k ? nullptr : (ustore_bytes_cptr_t)tape.data();
+
+    ustore_write_t write {};
+    write.db = c_db;
+    write.error = c_error;
+    write.transaction = c_txn;
+    write.arena = arena;
+    write.options = c_options;
+    write.tasks_count = static_cast<ustore_size_t>(entries_keys.size());
+    write.collections = &entries_keys[0].collection;
+    write.collections_stride = sizeof(collection_key_t);
+    write.keys = &entries_keys[0].key;
+    write.keys_stride = sizeof(collection_key_t);
+    write.offsets = offsets.data();
+    write.offsets_stride = sizeof(ustore_length_t);
+    write.lengths = lengths.data();
+    write.lengths_stride = sizeof(ustore_length_t);
+    write.values = values.data();
+    write.values_stride = sizeof(ustore_bytes_cptr_t);
+    ustore_write(&write);
+}
+
+/**
+ * @brief Writes the documents and updates the secondary indexes, comparing the
+ * indexed fields in the documents before and after the write. That way every
+ * kind of modification, including patches, is handled the same way.
+ */
+void write_indexed_docs( //
+    ustore_docs_write_t& c,
+    places_arg_t const& places,
+    linked_memory_lock_t& arena) noexcept {
+
+    safe_section("Updating secondary indexes", c.error, [&] {
+        strided_iterator_gt<ustore_str_view_t const> indexes_fields {c.indexes_fields, c.indexes_fields_stride};
+        strided_iterator_gt<ustore_collection_t const> indexes {c.indexes_collections, c.indexes_collections_stride};
+        return_error_if_m(indexes_fields && indexes, c.error, args_wrong_k, "Indexes must have fields and collections");
+
+        std::vector<ustore_str_view_t> fields(c.indexes_count);
+        for (std::size_t index_idx = 0; index_idx != c.indexes_count; ++index_idx)
+            fields[index_idx] = indexes_fields[index_idx];
+
+        shreds_t shreds;
+        parse_shreds(c.shreds_count,
+                     c.shreds_fields,
+                     c.shreds_fields_stride,
+                     c.shreds_collections,
+                     c.shreds_collections_stride,
+                     shreds,
+                     c.error);
+        return_if_error_m(c.error);
+
+        std::vector<collection_key_t> docs(places.size());
+        for (std::size_t task_idx = 0; task_idx != places.size(); ++task_idx)
+            docs[task_idx] = places[task_idx].collection_key();
+        sort_and_deduplicate(docs);
+
+        auto old_values = read_indexed_values(c.db, c.transaction, docs, fields, shreds, c.options, arena, c.error);
+        return_if_error_m(c.error);
+
+        ustore_docs_write_t unindexed = c;
+        unindexed.arena = arena;
+        unindexed.keys = places.keys_begin.get();
+        unindexed.keys_stride = places.keys_begin.stride();
+        unindexed.indexes_count = 0;
+        ustore_docs_write(&unindexed);
+        return_if_error_m(c.error);
+
+        auto new_values = read_indexed_values(c.db, c.transaction, docs, fields, shreds, c.options, arena, c.error);
+        return_if_error_m(c.error);
+
+        std::vector<posting_change_t> changes;
+        for (std::size_t doc_idx = 0; doc_idx != docs.size(); ++doc_idx) {
+            for (std::size_t index_idx = 0; index_idx != fields.size(); ++index_idx) {
+                auto& old_value = old_values[doc_idx * fields.size() + index_idx];
+                auto& new_value = new_values[doc_idx * fields.size() + index_idx];
+                if (old_value == new_value)
+                    continue;
+                if (old_value)
+                    changes.push_back({indexes[index_idx], docs[doc_idx].key, std::move(*old_value), false});
+                if (new_value)
+                    changes.push_back({indexes[index_idx], docs[doc_idx].key, std::move(*new_value), true});
+            }
+        }
+        apply_posting_changes(c.db, c.transaction, changes, c.options, arena, c.error);
+    });
+}
+
+/**
+ * @brief Passes the documents, already converted into the stored format, to the underlying store.
+ */
+void write_stored_docs(ustore_docs_write_t& c,
+                       ustore_key_t const* keys,
+                       ustore_size_t keys_stride,
+                       growing_tape_t& stored,
+                       linked_memory_lock_t& arena) noexcept {
+
+    ustore_byte_t* stored_begin = reinterpret_cast<ustore_byte_t*>(stored.contents().begin().get());
+    ustore_write_t write {};
+    write.db = c.db;
+    write.error = c.error;
+    write.transaction = c.transaction;
+    write.arena = arena;
+    write.options = c.options;
+    write.tasks_count = c.tasks_count;
+    write.collections = c.collections;
+    write.collections_stride = c.collections_stride;
+    write.keys = keys;
+    write.keys_stride = keys_stride;
+    write.offsets = stored.offsets().begin().get();
+    write.offsets_stride = stored.offsets().stride();
+    write.lengths = stored.lengths().begin().get();
+    write.lengths_stride = stored.lengths().stride();
+    write.values = &stored_begin;
+
+    ustore_write(&write);
+}
+
+/**
+ * @brief Parses a buffer of many concatenated JSON documents in one streaming pass.
+ * Whole-document upserts are converted into tapes on the fly and written in one batch,
+ * other requests are split into separate documents and passed to `ustore_docs_write()`.
+ */
+void write_joined_docs(ustore_docs_write_t& c, linked_memory_lock_t& arena) noexcept {
+
+    return_error_if_m(c.values && *c.values, c.error, uninitialized_state_k, "No documents provided");
+    return_error_if_m(c.type == ustore_doc_field_json_k, c.error, args_wrong_k, "Only JSONs can be joined");
+    return_error_if_m(c.keys || c.id_field, c.error, uninitialized_state_k, "Keys and id_field is uninitialized");
+
+    // SIMDJSON needs a padded copy, which will also be referenced by the split documents
+    auto joined_begin = reinterpret_cast<char const*>(*c.values) + (c.offsets ? *c.offsets : 0u);
+    std::size_t joined_length = c.lengths ? *c.lengths : std::strlen(joined_begin);
+    auto padded = arena.alloc<char>(joined_length + sj::SIMDJSON_PADDING, c.error);
+    return_if_error_m(c.error);
+    std::memcpy(padded.begin(), joined_begin, joined_length);
+    std::memset(padded.begin() + joined_length, 0, sj::SIMDJSON_PADDING);
+
+    strided_iterator_gt<ustore_str_view_t const> fields {c.fields, c.fields_stride};
+    auto has_fields = fields && (!fields.repeats() || *fields);
+    bool const can_store_directly = !has_fields && c.modification == ustore_doc_modify_upsert_k &&
+                                    !c.indexes_count && !c.shreds_count;
+
+    auto keys = arena.alloc<ustore_key_t>(c.keys ? 0 : c.tasks_count, c.error);
+    return_if_error_m(c.error);
+    auto offsets = arena.alloc<ustore_length_t>(can_store_directly ? 0 : c.tasks_count, c.error);
+    return_if_error_m(c.error);
+    auto lengths = arena.alloc<ustore_length_t>(can_store_directly ? 0 : c.tasks_count, c.error);
+    return_if_error_m(c.error);
+    growing_tape_t stored {arena};
+    stored.reserve(can_store_directly ? c.tasks_count : 0, c.error);
+    return_if_error_m(c.error);
+
+    safe_section("Parsing joined documents", c.error, [&] {
+        sj::dom::parser parser;
+        sj::dom::document_stream docs;
+        std::size_t batch_size = std::min(joined_length, joined_docs_batch_limit_k);
+        auto error = parser.parse_many(padded.begin(), joined_length, batch_size).get(docs);
+        return_error_if_m(!error, c.error, args_wrong_k, sj::error_message(error));
+
+        std::size_t doc_idx = 0;
+        std::string tape;
+        for (auto doc_it = docs.begin(); doc_it != docs.end(); ++doc_it, ++doc_idx) {
+            sj::dom::element doc;
+            error = (*doc_it).get(doc);
+            return_error_if_m(!error, c.error, args_wrong_k, sj::error_message(error));
+            return_error_if_m(doc_idx < c.tasks_count, c.error, args_wrong_k, "More documents than tasks");
+
+            if (!c.keys) {
+                std::int64_t key = 0;
+                error = doc.at_key(c.id_field).get(key);
+                return_error_if_m(error != sj::NO_SUCH_FIELD,
+                                  c.error,
+                                  uninitialized_state_k,
+                                  "Keys and values is uninitialized");
+                return_error_if_m(!error, c.error, args_wrong_k, "The id field does not have the ustore key type");
+                keys[doc_idx] = key;
+            }
+
+            std::string_view source = doc_it.source();
+            if (!can_store_directly) {
+                offsets[doc_idx] = static_cast<ustore_length_t>(source.data() - padded.begin());
+                lengths[doc_idx] = static_cast<ustore_length_t>(source.size());
+            }
+            // Tapes that don't fit into 32-bit offsets are kept as text
+            else if (tape_encode(doc, tape))
+                stored.push_back(value_view_t(tape), c.error);
+            else
+                stored.push_back(value_view_t(source.data(), source.size()), c.error);
+            return_if_error_m(c.error);
+        }
+        return_error_if_m(!docs.truncated_bytes(), c.error, args_wrong_k, "Invalid Json!");
+        return_error_if_m(doc_idx == c.tasks_count, c.error, args_wrong_k, "Fewer documents than tasks");
+    });
+    return_if_error_m(c.error);
+
+    ustore_key_t const* keys_begin = c.keys ? c.keys : keys.begin();
+    ustore_size_t keys_stride = c.keys ? c.keys_stride : sizeof(ustore_key_t);
+    if (can_store_directly)
+        return write_stored_docs(c, keys_begin, keys_stride, stored, arena);
+
+    auto padded_begin = reinterpret_cast<ustore_bytes_cptr_t>(padded.begin());
+    ustore_docs_write_t split = c;
+    split.keys = keys_begin;
+    split.keys_stride = keys_stride;
+    split.presences = nullptr;
+    split.offsets = offsets.begin();
+    split.offsets_stride = sizeof(ustore_length_t);
+    split.lengths = lengths.begin();
+    split.lengths_stride = sizeof(ustore_length_t);
+    split.values = &padded_begin;
+    split.values_stride = 0;
+    split.values_joined = false;
+    ustore_docs_write(&split);
+}
+
+#if !defined(USTORE_FLIGHT_CLIENT)
+void ustore_docs_write(ustore_docs_write_t* c_ptr) {
+    trace_span_m("docs_write");
+
+    ustore_docs_write_t& c = *c_ptr;
+    if (!c.tasks_count)
+        return;
+
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
+    return_if_error_m(c.error);
+
+    if (c.values_joined)
+        return write_joined_docs(c, arena);
+
+    ptr_range_gt<ustore_key_t> tape;
+    if (!c.keys) {
+        return_error_if_m(c.values, c.error, uninitialized_state_k, "Keys and values is uninitialized");
+        return_error_if_m(c.id_field, c.error, uninitialized_state_k, "Keys and id_field is uninitialized");
+
+        tape = arena.alloc<ustore_key_t>(c.tasks_count, c.error);
+        strided_iterator_gt<ustore_bytes_cptr_t const> vals {c.values, c.values_stride};
+        strided_iterator_gt<ustore_length_t const> lens {c.lengths, c.lengths_stride};
+
+        simdjson::ondemand::parser parser;
+        for (size_t idx = 0; idx < c.tasks_count; ++idx, ++vals, ++lens) {
+            simdjson::ondemand::document doc = parser.iterate(*vals, *lens, 1000000ul);
+            simdjson::ondemand::object data = doc.get_object().value();
+
+            auto result = reset(data)[c.id_field];
+            return_error_if_m((simdjson::SUCCESS == result.error()),
+                              c.error,
+                              uninitialized_state_k,
+                              "Keys and values is uninitialized");
+            return_error_if_m(result.type() == simdjson::ondemand::json_type::number,
+                              c.error,
+                              args_wrong_k,
+                              "The id field does not have the ustore key type");
+            tape[idx] = result;
+        }
+        c.keys_stride = sizeof(ustore_key_t);
+    }
+    // If user wants the entire doc in the same format, as the one we use internally,
+    // this request can be passed entirely to the underlying Key-Value store.
+    strided_iterator_gt<ustore_str_view_t const> fields {c.fields, c.fields_stride};
+    auto has_fields = fields && (!fields.repeats() || *fields);
+    strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
+    strided_iterator_gt<ustore_key_t const> keys {c.keys ? c.keys : tape.begin(), c.keys_stride};
+    bits_view_t presences {c.presences};
+    strided_iterator_gt<ustore_length_t const> offs {c.offsets, c.offsets_stride};
+    strided_iterator_gt<ustore_length_t const> lens {c.lengths, c.lengths_stride};
+    strided_iterator_gt<ustore_bytes_cptr_t const> vals {c.values, c.values_stride};
+    places_arg_t places {collections, keys, fields, c.tasks_count};
+    contents_arg_t contents {presences, offs, lens, vals, c.tasks_count};
+
+    if (c.indexes_count)
+        return write_indexed_docs(c, places, arena);
+    if (c.shreds_count)
+        return write_shredded_docs(c, places, contents, arena);
+
+    // Patches can be applied without reading the documents first. Failing ones
+    // are skipped by the engine, instead of failing the whole batch.
+    auto modification = static_cast<doc_modification_t>(c.modification);
+    bool is_patch = modification == doc_modification_t::patch_k || modification == doc_modification_t::merge_k;
+    if (is_patch && can_merge(c.db, c.transaction, c.options))
+        return merge_docs(c.db, places, contents, c.options, modification, c.type, arena, c.error);
+
+    if (has_fields || c.type != internal_format_k || c.modification != ustore_doc_modify_upsert_k)
+        return read_modify_write(c.db,
+                                 c.transaction,
+                                 places,
+                                 contents,
+                                 c.options,
+                                 static_cast<doc_modification_t>(c.modification),
+                                 c.type,
+                                 arena,
+                                 c.error);
+
+    // Validate JSONs and convert them into binary tapes, that are later queried without parsing
+    growing_tape_t stored {arena};
+    stored.reserve(contents.size(), c.error);
+    return_if_error_m(c.error);
+    {
+        trace_span_m("docs.parse");
+        for (std::size_t i = 0; i != contents.size(); ++i) {
+            value_view_t content = contents[i];
+            if (content.empty()) {
+                stored.push_back(content, c.error);
+                return_if_error_m(c.error);
+                continue;
+            }
+
+            json_t parsed = json_parse(content, arena, c.error);
+            return_if_error_m(c.error);
+            return_error_if_m(parsed.mut_handle, c.error, args_wrong_k, "Invalid Json!");
+            stored_dump({nullptr, parsed.mut_handle->root}, arena, stored, c.error);
+            return_if_error_m(c.error);
+        }
+    }
+
+    write_stored_docs(c, c.keys ? c.keys : tape.begin(), c.keys_stride, stored, arena);
+}
+#endif // Forwarded to the server in `flight_client.cpp`
+
+void ustore_docs_read(ustore_docs_read_t* c_ptr) {
+    trace_span_m("docs_read");
+
+    ustore_docs_read_t& c = *c_ptr;
+    if (!c.tasks_count)
+        return;
+
+    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
+    return_if_error_m(c.error);
+
+    // If user wants the entire doc in the same format, as the one we use internally,
+    // this request can be passed entirely to the underlying Key-Value store.
+    strided_iterator_gt<ustore_str_view_t const> fields {c.fields, c.fields_stride};
+    auto has_fields = fields && (!fields.repeats() || *fields);
+    if (!has_fields && c.type == internal_format_k && !c.shreds_count) {
+        ustore_read_t read {};
+        read.db = c.db;
+        read.error = c.error;
+        read.transaction = c.transaction;
+        read.snapshot = c.snapshot;
+        read.arena = arena;
+        read.options = c.options;
+        read.tasks_count = c.tasks_count;
+        read.collections = c.collections;
+        read.collections_stride = c.collections_stride;
+        read.keys = c.keys;
+        read.keys_stride = c.keys_stride;
+        read.presences = c.presences;
+
+        ustore_length_t* found_offsets = nullptr;
+        ustore_length_t* found_lengths = nullptr;
+        ustore_byte_t* found_begin = nullptr;
+        read.offsets = &found_offsets;
+        read.lengths = &found_lengths;
+        read.values = &found_begin;
+        ustore_read(&read);
+        return_if_error_m(c.error);
+
+        // Binary tapes are printed back into JSON, while the textual documents are exported as is
+        auto found_at = [&](std::size_t i) {
+            return found_lengths[i] == ustore_length_missing_k
+                       ? value_view_t {}
+                       : value_view_t {found_begin + found_offsets[i], found_lengths[i]};
+        };
+        bool has_tapes = false;
+        for (std::size_t i = 0; i != c.tasks_count && !has_tapes; ++i)
+            has_tapes = is_tape(found_at(i));
+        if (has_tapes) {
+            growing_tape_t printed {arena};
+            printed.reserve(c.tasks_count, c.error);
+            return_if_error_m(c.error);
+            std::string json;
+            for (std::size_t i = 0; i != c.tasks_count; ++i) {
+                value_view_t found = found_at(i);
+                if (is_tape(found)) {
+                    json.clear();
+                    bool success = false;
+                    safe_section("Printing the tape", c.error, [&] { success = tape_to_json(tape_root(found), json); });
+                    return_if_error_m(c.error);
+                    return_error_if_m(success, c.error, error_unknown_k, "Failed to decode the stored document!");
+                    found = value_view_t(json);
+                }
+                printed.push_back(found, c.error);
+                printed.add_terminator(byte_t {0}, c.error);
+                return_if_error_m(c.error);
+            }
+            found_offsets = printed.offsets().begin().get();
+            found_lengths = printed.lengths().begin().get();
+            found_begin = reinterpret_cast<ustore_byte_t*>(printed.contents().begin().get());
+        }
+
+        if (c.offsets)
+            *c.offsets = found_offsets;
+        if (c.lengths)
+            *c.lengths = found_lengths;
+        if (c.values)
+            *c.values = found_begin;
+        return;
+    }
+
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+
+    strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
     strided_iterator_gt<ustore_key_t const> keys {c.keys, c.keys_stride};
     places_arg_t places {collections, keys, fields, c.tasks_count};
 
@@ -1712,6 +3359,7 @@ void ustore_docs_read(ustore_docs_read_t* c_ptr) {
     growing_tape.reserve(places.size(), c.error);
     return_if_error_m(c.error);
     sj::ondemand::parser parser;
+    std::string tape_json;
 
     auto safe_callback = [&](ustore_size_t, ustore_str_view_t field, value_view_t binary_doc) {
         if (binary_doc.empty()) {
@@ -1719,6 +3367,32 @@ void ustore_docs_read(ustore_docs_read_t* c_ptr) {
             return;
         }
 
+        // Only the requested part of a binary tape is printed for the following conversions
+        if (is_tape(binary_doc)) {
+            bool found = false, success = false;
+            tape_json.clear();
+            safe_section("Printing the tape", c.error, [&] {
+                tape_node_t branch = tape_root(binary_doc).lookup(field);
+                found = bool(branch);
+                success = found && tape_to_json(branch, tape_json);
+            });
+            return_if_error_m(c.error);
+            if (!found) {
+                growing_tape.push_back(value_view_t {}, c.error);
+                return;
+            }
+            return_error_if_m(success, c.error, error_unknown_k, "Failed to decode the stored document!");
+            if (c.type == ustore_doc_field_json_k) {
+                growing_tape.push_back(value_view_t(tape_json), c.error);
+                growing_tape.add_terminator(byte_t {0}, c.error);
+                return;
+            }
+            std::size_t json_length = tape_json.size();
+            tape_json.resize(json_length + sj::SIMDJSON_PADDING, '\0');
+            binary_doc = value_view_t(tape_json.data(), json_length);
+            field = nullptr;
+        }
+
         std::string_view result;
         auto padded_doc =
             sj::padded_string_view(binary_doc.c_str(), binary_doc.size(), binary_doc.size() + sj::SIMDJSON_PADDING);
@@ -1756,15 +3430,39 @@ void ustore_docs_read(ustore_docs_read_t* c_ptr) {
     };
 
     places_arg_t unique_places;
-    read_modify_docs(c.db,
-                     c.transaction,
-                     places,
-                     c.options,
-                     doc_modification_t::nothing_k,
-                     arena,
-                     unique_places,
-                     c.error,
-                     safe_callback);
+    if (c.shreds_count) {
+        shreds_t shreds;
+        parse_shreds(c.shreds_count,
+                     c.shreds_fields,
+                     c.shreds_fields_stride,
+                     c.shreds_collections,
+                     c.shreds_collections_stride,
+                     shreds,
+                     c.error);
+        return_if_error_m(c.error);
+        safe_section("Reading shredded documents", c.error, [&] {
+            read_shredded_docs(c.db,
+                               c.transaction,
+                               c.snapshot,
+                               places,
+                               shreds,
+                               c.options,
+                               arena,
+                               c.error,
+                               safe_callback);
+        });
+        return_if_error_m(c.error);
+    }
+    else
+        read_modify_docs(c.db,
+                         c.transaction,
+                         places,
+                         c.options,
+                         doc_modification_t::nothing_k,
+                         arena,
+                         unique_places,
+                         c.error,
+                         safe_callback);
 
     if (c.offsets)
         *c.offsets = growing_tape.offsets().begin().get();
@@ -1774,39 +3472,305 @@ void ustore_docs_read(ustore_docs_read_t* c_ptr) {
         *c.values = reinterpret_cast<ustore_byte_t*>(growing_tape.contents().begin().get());
 }
 
+void ustore_docs_index_find(ustore_docs_index_find_t* c_ptr) {
+    trace_span_m("docs_index_find");
+
+    ustore_docs_index_find_t& c = *c_ptr;
+    if (!c.tasks_count)
+        return;
+
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    return_error_if_m(c.values_min, c.error, args_wrong_k, "Values to match are missing");
+    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
+    return_if_error_m(c.error);
+
+    strided_iterator_gt<ustore_collection_t const> indexes {c.indexes, c.indexes_stride};
+    strided_iterator_gt<ustore_str_view_t const> values_min {c.values_min, c.values_min_stride};
+    strided_iterator_gt<ustore_str_view_t const> values_max {c.values_max, c.values_max_stride};
+    strided_iterator_gt<ustore_key_t const> start_keys {c.start_keys, c.start_keys_stride};
+    strided_iterator_gt<ustore_length_t const> count_limits {c.count_limits, c.count_limits_stride};
+
+    auto counts = arena.alloc_or_dummy(c.tasks_count, c.error, c.counts);
+    return_if_error_m(c.error);
+    auto offsets = arena.alloc_or_dummy(c.tasks_count + 1, c.error, c.offsets);
+    return_if_error_m(c.error);
+
+    safe_section("Searching secondary indexes", c.error, [&] {
+        auto parse_value = [&](ustore_str_view_t json) {
+            std::optional<indexed_value_t> result;
+            if (json)
+                with_parsed_json(value_view_t(json), arena, [&](yyjson_val* root) { result = index_json(root); });
+            return result;
+        };
+
+        std::vector<std::vector<ustore_key_t>> matches(c.tasks_count);
+        std::vector<collection_key_t> entries_keys;
+        std::vector<std::size_t> entries_tasks;
+        std::vector<indexed_value_t> equalities(c.tasks_count);
+        for (std::size_t task_idx = 0; task_idx != c.tasks_count; ++task_idx) {
+            auto index = indexes ? indexes[task_idx] : ustore_collection_main_k;
+            auto min_value = parse_value(values_min[task_idx]);
+            return_error_if_m(min_value, c.error, args_wrong_k, "Only scalar values can be matched");
+            if (!values_max || !values_max[task_idx]) {
+                // Equality lookups are batched into a single read
+                entries_keys.push_back({index, min_value->key});
+                entries_tasks.push_back(task_idx);
+                equalities[task_idx] = std::move(*min_value);
+                continue;
+            }
+
+            auto max_value = parse_value(values_max[task_idx]);
+            return_error_if_m(max_value, c.error, args_wrong_k, "Only scalar values can be matched");
+            bool are_numbers = min_value->type == indexed_type_t::number_k && //
+                               max_value->type == indexed_type_t::number_k;
+            return_error_if_m(are_numbers, c.error, args_wrong_k, "Only numbers can be matched by ranges");
+            if (max_value->key < min_value->key)
+                continue;
+
+            // Ranges are scanned, skipping the hashed entries, that fall into the same interval
+            ustore_key_t start_key = min_value->key;
+            ustore_key_t end_key = max_value->key;
+            ustore_length_t read_ahead = index_scan_read_ahead_k;
+            while (true) {
+                ustore_length_t* found_counts {};
+                ustore_key_t* found_keys {};
+                ustore_length_t* found_offsets {};
+                ustore_byte_t* found_values {};
+                ustore_scan_t scan {};
+                scan.db = c.db;
+                scan.error = c.error;
+                scan.transaction = c.transaction;
+                scan.snapshot = c.snapshot;
+                scan.arena = arena;
+                scan.options = ustore_options_t(c.options | ustore_option_scan_sequential_k);
+                scan.tasks_count = 1;
+                scan.collections = &index;
+                scan.start_keys = &start_key;
+                scan.count_limits = &read_ahead;
+                scan.counts = &found_counts;
+                scan.keys = &found_keys;
+                scan.values_offsets = &found_offsets;
+                scan.values = &found_values;
+                ustore_scan(&scan);
+                return_if_error_m(c.error);
+
+                joined_blobs_iterator_t found_entries {found_offsets, found_values};
+                bool reached_end = found_counts[0] < read_ahead;
+                for (std::size_t i = 0; i != found_counts[0]; ++i, ++found_entries) {
+                    if (found_keys[i] > end_key) {
+                        reached_end = true;
+                        break;
+                    }
+                    for_each_posting(*found_entries, [&](posting_t const& posting) {
+                        if (posting.type == indexed_type_t::number_k)
+                            matches[task_idx].push_back(posting.doc);
+                    });
+                }
+                if (reached_end || found_keys[found_counts[0] - 1] == end_key)
+                    break;
+                start_key = found_keys[found_counts[0] - 1] + 1;
+            }
+        }
+
+        if (!entries_keys.empty()) {
+            ustore_length_t* found_offsets {};
+            ustore_length_t* found_lengths {};
+            ustore_byte_t* found_values {};
+            ustore_read_t read {};
+            read.db = c.db;
+            read.error = c.error;
+            read.transaction = c.transaction;
+            read.snapshot = c.snapshot;
+            read.arena = arena;
+            read.options = c.options;
+            read.tasks_count = static_cast<ustore_size_t>(entries_keys.size());
+            read.collections = &entries_keys[0].collection;
+            read.collections_stride = sizeof(collection_key_t);
+            read.keys = &entries_keys[0].key;
+            read.keys_stride = sizeof(collection_key_t);
+            read.offsets = &found_offsets;
+            read.lengths = &found_lengths;
+            read.values = &found_values;
+            ustore_read(&read);
+            return_if_error_m(c.error);
+
+            for (std::size_t entry_idx = 0; entry_idx != entries_keys.size(); ++entry_idx) {
+                if (found_lengths[entry_idx] == ustore_length_missing_k)
+                    continue;
+                std::size_t task_idx = entries_tasks[entry_idx];
+                indexed_value_t const& value = equalities[task_idx];
+                value_view_t entry {found_values + found_offsets[entry_idx], found_lengths[entry_idx]};
+                for_each_posting(entry, [&](posting_t const& posting) {
+                    if (posting.type == value.type && posting.bytes == value.bytes)
+                        matches[task_idx].push_back(posting.doc);
+                });
+            }
+        }
+
+        // Export the matches in the order of document keys, starting from the requested ones
+        std::size_t total_count = 0;
+        for (std::size_t task_idx = 0; task_idx != c.tasks_count; ++task_idx) {
+            auto& task_matches = matches[task_idx];
+            sort_and_deduplicate(task_matches);
+            ustore_key_t start_key = start_keys ? start_keys[task_idx] : std::numeric_limits<ustore_key_t>::min();
+            auto begin = std::lower_bound(task_matches.begin(), task_matches.end(), start_key);
+            task_matches.erase(task_matches.begin(), begin);
+            if (count_limits && task_matches.size() > count_limits[task_idx])
+                task_matches.resize(count_limits[task_idx]);
+            counts[task_idx] = static_cast<ustore_length_t>(task_matches.size());
+            offsets[task_idx] = static_cast<ustore_length_t>(total_count);
+            total_count += task_matches.size();
+        }
+        offsets[c.tasks_count] = static_cast<ustore_length_t>(total_count);
+
+        if (!c.keys)
+            return;
+        auto keys = arena.alloc<ustore_key_t>(total_count, c.error);
+        return_if_error_m(c.error);
+        auto keys_output = keys.begin();
+        for (std::size_t task_idx = 0; task_idx != c.tasks_count; ++task_idx)
+            keys_output = std::copy(matches[task_idx].begin(), matches[task_idx].end(), keys_output);
+        *c.keys = keys.begin();
+    });
+}
+
+void ustore_docs_index_build(ustore_docs_index_build_t* c_ptr) {
+    trace_span_m("docs_index_build");
+
+    ustore_docs_index_build_t& c = *c_ptr;
+    return_error_if_m(c.db, c.error, uninitialized_state_k, "DataBase is uninitialized");
+    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
+    return_if_error_m(c.error);
+
+    safe_section("Building secondary index", c.error, [&] {
+        std::vector<posting_change_t> changes;
+        stored_doc_t stored;
+        full_scan_collection(c.db,
+                             c.transaction,
+                             c.collection,
+                             c.options,
+                             std::numeric_limits<ustore_key_t>::min(),
+                             index_scan_read_ahead_k,
+                             arena,
+                             c.error,
+                             [&](ustore_key_t doc, value_view_t bytes) {
+                                 yyjson_val* value = stored.reset(bytes) ? stored.lookup(c.field) : nullptr;
+                                 auto indexed = value ? index_json(value) : std::nullopt;
+                                 if (indexed)
+                                     changes.push_back({c.index, doc, std::move(*indexed), true});
+                                 if (changes.size() < index_build_batch_k)
+                                     return true;
+                                 apply_posting_changes(c.db, c.transaction, changes, c.options, arena, c.error);
+                                 changes.clear();
+                                 return !*c.error;
+                             });
+        return_if_error_m(c.error);
+        apply_posting_changes(c.db, c.transaction, changes, c.options, arena, c.error);
+    });
+}
+
 /*********************************************************/
 /*****************	 Tabular Exports	  ****************/
 /*********************************************************/
 
-void gist_recursively(yyjson_val* node,
-                      field_path_buffer_t& path,
-                      uninitialized_array_gt<std::string_view>& sorted_paths,
-                      growing_tape_t& exported_paths,
-                      ustore_error_t* c_error) {
+constexpr std::size_t gist_docs_per_thread_k = 1024;
+
+/**
+ * @brief Paths and kinds of values met by one thread in `ustore_docs_gist()`,
+ * listed in the order of their first appearance.
+ */
+struct gist_chunk_t {
+    struct path_stats_t {
+        ustore_size_t presences = 0;
+        std::array<ustore_size_t, ustore_doc_gist_types_k> types_counts {};
+    };
+
+    std::unordered_map<std::string, std::size_t> indices;
+    std::vector<std::pair<std::string_view, path_stats_t>> paths;
+    ustore_size_t docs_present = 0;
+
+    path_stats_t& at(std::string const& path) noexcept(false) {
+        auto [it, inserted] = indices.try_emplace(path, paths.size());
+        // Keys of node-based maps never move, so they can be referenced
+        if (inserted)
+            paths.emplace_back(std::string_view(it->first), path_stats_t {});
+        return paths[it->second].second;
+    }
+
+    void count(std::string const& path, ustore_doc_gist_type_t type, ustore_error_t* c_error) noexcept(false) {
+        return_error_if_m(path.size() < field_path_len_limit_k, c_error, args_wrong_k, "Path is too long!");
+        path_stats_t& stats = at(path);
+        ++stats.presences;
+        ++stats.types_counts[type];
+    }
+
+    void merge(gist_chunk_t const& other) noexcept(false) {
+        docs_present += other.docs_present;
+        for (auto const& [path, other_stats] : other.paths) {
+            path_stats_t& stats = at(std::string(path));
+            stats.presences += other_stats.presences;
+            for (std::size_t type_idx = 0; type_idx != ustore_doc_gist_types_k; ++type_idx)
+                stats.types_counts[type_idx] += other_stats.types_counts[type_idx];
+        }
+    }
+};
+
+ustore_doc_gist_type_t gist_type(yyjson_val* node) noexcept {
+    switch (yyjson_get_type(node)) {
+    case YYJSON_TYPE_BOOL: return ustore_doc_gist_bool_k;
+    case YYJSON_TYPE_STR: return ustore_doc_gist_str_k;
+    case YYJSON_TYPE_NUM:
+        switch (yyjson_get_subtype(node)) {
+        case YYJSON_SUBTYPE_SINT: return ustore_doc_gist_i64_k;
+        case YYJSON_SUBTYPE_UINT: return ustore_doc_gist_u64_k;
+        default: return ustore_doc_gist_f64_k;
+        }
+    default: return ustore_doc_gist_null_k;
+    }
+}
+
+ustore_doc_gist_type_t gist_type(tape_node_t node) noexcept {
+    switch (node.type()) {
+    case tape_type_t::false_k:
+    case tape_type_t::true_k: return ustore_doc_gist_bool_k;
+    case tape_type_t::sint_k: return ustore_doc_gist_i64_k;
+    case tape_type_t::uint_k: return ustore_doc_gist_u64_k;
+    case tape_type_t::real_k: return ustore_doc_gist_f64_k;
+    case tape_type_t::string_k: return ustore_doc_gist_str_k;
+    default: return ustore_doc_gist_null_k;
+    }
+}
+
+/**
+ * @brief Picks the narrowest type for `ustore_docs_gather()`, that fits all the observed values,
+ * relying on the conversions it supports: booleans to numbers and anything to strings.
+ */
+ustore_doc_field_type_t gist_gather_type(ustore_size_t const* types_counts) noexcept {
+    if (types_counts[ustore_doc_gist_str_k])
+        return ustore_doc_field_str_k;
+    if (types_counts[ustore_doc_gist_f64_k])
+        return ustore_doc_field_f64_k;
+    if (types_counts[ustore_doc_gist_i64_k])
+        return ustore_doc_field_i64_k;
+    if (types_counts[ustore_doc_gist_u64_k])
+        return ustore_doc_field_u64_k;
+    if (types_counts[ustore_doc_gist_bool_k])
+        return ustore_doc_field_bool_k;
+    return ustore_doc_field_null_k;
+}
 
-    auto path_len = std::strlen(path);
-    auto constexpr slash_len = 1;
-    auto constexpr terminator_len = 1;
+void gist_recursively(yyjson_val* node, std::string& path, gist_chunk_t& chunk, ustore_error_t* c_error) {
 
+    std::size_t const path_len = path.size();
     if (yyjson_is_obj(node)) {
-        yyjson_val *key, *val;
+        yyjson_val* key;
         yyjson_obj_iter iter;
         yyjson_obj_iter_init(node, &iter);
         while ((key = yyjson_obj_iter_next(&iter)) && !*c_error) {
-            val = yyjson_obj_iter_get_val(key);
-            char const* key_name = yyjson_get_str(key);
-            size_t key_len = yyjson_get_len(key);
-            if (path_len + slash_len + key_len + terminator_len >= field_path_len_limit_k) {
-                *c_error = "Path is too long!";
-                return;
-            }
-
-            path[path_len] = '/';
-            std::memcpy(path + path_len + slash_len, key_name, key_len);
-            path[path_len + slash_len + key_len] = 0;
-            gist_recursively(val, path, sorted_paths, exported_paths, c_error);
+            append_pointer_segment(path, std::string_view(yyjson_get_str(key), yyjson_get_len(key)));
+            gist_recursively(yyjson_obj_iter_get_val(key), path, chunk, c_error);
+            path.resize(path_len);
         }
-        path[path_len] = 0;
     }
     else if (yyjson_is_arr(node)) {
         std::size_t idx = 0;
@@ -1814,135 +3778,264 @@ void gist_recursively(yyjson_val* node,
         yyjson_arr_iter iter;
         yyjson_arr_iter_init(node, &iter);
         while ((val = yyjson_arr_iter_next(&iter)) && !*c_error) {
-
-            path[path_len] = '/';
-            auto result = print_number(path + path_len + slash_len, path + field_path_len_limit_k, idx);
-            if (result.empty()) {
-                *c_error = "Path is too long!";
-                return;
-            }
-
-            gist_recursively(val, path, sorted_paths, exported_paths, c_error);
+            path.push_back('/');
+            path.append(fmt::format_int(idx).c_str());
+            gist_recursively(val, path, chunk, c_error);
+            path.resize(path_len);
             ++idx;
         }
-        path[path_len] = 0;
     }
-    else {
+    else
+        chunk.count(path, gist_type(node), c_error);
+}
 
-        std::string_view path_str = std::string_view(path, path_len);
-        std::size_t idx = std::lower_bound(sorted_paths.begin(), sorted_paths.end(), path_str) - sorted_paths.begin();
-        if (idx != sorted_paths.size() && sorted_paths[idx] == path_str)
-            // This same path is already exported
-            return;
+void gist_recursively(tape_node_t node, std::string& path, gist_chunk_t& chunk, ustore_error_t* c_error) {
 
-        auto exported_path = exported_paths.push_back(path, c_error);
-        return_if_error_m(c_error);
-        exported_paths.add_terminator(byte_t {0}, c_error);
-        return_if_error_m(c_error);
+    std::size_t const path_len = path.size();
+    if (!node.is_container())
+        return chunk.count(path, gist_type(node), c_error);
 
-        path_str = std::string_view(exported_path.c_str(), exported_path.size());
-        sorted_paths.insert(idx, &path_str, &path_str + 1, c_error);
-    }
+    bool const is_object = node.type() == tape_type_t::object_k;
+    std::size_t idx = 0;
+    bool is_valid = node.for_each([&](std::string_view key, tape_node_t child) {
+        if (*c_error)
+            return;
+        if (is_object)
+            append_pointer_segment(path, key);
+        else {
+            path.push_back('/');
+            path.append(fmt::format_int(idx).c_str());
+        }
+        gist_recursively(child, path, chunk, c_error);
+        path.resize(path_len);
+        ++idx;
+    });
+    return_error_if_m(is_valid, c_error, error_unknown_k, "Damaged binary document!");
 }
 
 void ustore_docs_gist(ustore_docs_gist_t* c_ptr) {
+    trace_span_m("docs_gist");
 
     ustore_docs_gist_t& c = *c_ptr;
-    if (!c.docs_count)
+    if (!c.docs_count && !c.sample_count)
         return;
 
     linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
     return_if_error_m(c.error);
 
+    ustore_size_t docs_count = c.docs_count;
+    ustore_collection_t const* collections = c.collections;
+    ustore_size_t collections_stride = c.collections_stride;
+    ustore_key_t const* keys = c.keys;
+    ustore_size_t keys_stride = c.keys_stride;
+
+    // Sampling replaces the requested keys with random ones from the first collection
+    if (c.sample_count) {
+        ustore_length_t sample_limit = static_cast<ustore_length_t>(c.sample_count);
+        ustore_length_t* found_counts = nullptr;
+        ustore_key_t* found_keys = nullptr;
+        ustore_sample_t sample {};
+        sample.db = c.db;
+        sample.error = c.error;
+        sample.transaction = c.transaction;
+        sample.snapshot = c.snapshot;
+        sample.arena = arena;
+        sample.options = c.options;
+        sample.tasks_count = 1;
+        sample.collections = c.collections;
+        sample.count_limits = &sample_limit;
+        sample.counts = &found_counts;
+        sample.keys = &found_keys;
+
+        ustore_sample(&sample);
+        return_if_error_m(c.error);
+
+        docs_count = found_counts[0];
+        collections_stride = 0;
+        keys = found_keys;
+        keys_stride = sizeof(ustore_key_t);
+    }
+
     ustore_byte_t* found_binary_begin {};
     ustore_length_t* found_binary_offs {};
-    ustore_read_t read {};
-    read.db = c.db;
-    read.error = c.error;
-    read.transaction = c.transaction;
-    read.snapshot = c.snapshot;
-    read.arena = arena;
-    read.options = c.options;
-    read.tasks_count = c.docs_count;
-    read.collections = c.collections;
-    read.collections_stride = c.collections_stride;
-    read.keys = c.keys;
-    read.keys_stride = c.keys_stride;
-    read.presences = nullptr;
-    read.offsets = &found_binary_offs;
-    read.lengths = nullptr;
-    read.values = &found_binary_begin;
-
-    ustore_read(&read);
-    return_if_error_m(c.error);
+    if (docs_count) {
+        ustore_read_t read {};
+        read.db = c.db;
+        read.error = c.error;
+        read.transaction = c.transaction;
+        read.snapshot = c.snapshot;
+        read.arena = arena;
+        read.options = c.options;
+        read.tasks_count = docs_count;
+        read.collections = collections;
+        read.collections_stride = collections_stride;
+        read.keys = keys;
+        read.keys_stride = keys_stride;
+        read.presences = nullptr;
+        read.offsets = &found_binary_offs;
+        read.lengths = nullptr;
+        read.values = &found_binary_begin;
 
-    strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
-    strided_iterator_gt<ustore_key_t const> keys {c.keys, c.keys_stride};
+        ustore_read(&read);
+        return_if_error_m(c.error);
+    }
 
-    joined_blobs_t found_binaries {c.docs_count, found_binary_offs, found_binary_begin};
-    joined_blobs_iterator_t found_binary_it = found_binaries.begin();
+    // Every thread collects paths into its own hash-map, to be merged in order,
+    // so that paths are listed in the order of their first appearance.
+    joined_blobs_t found_binaries {docs_count, found_binary_offs, found_binary_begin};
+    std::size_t const chunks_count = divide_round_up<std::size_t>(docs_count, gist_docs_per_thread_k);
+    std::vector<gist_chunk_t> chunks(chunks_count);
+    std::vector<ustore_error_t> chunks_errors(chunks_count, nullptr);
+    gist_chunk_t merged;
+    safe_section("Inspecting documents", c.error, [&] {
+        parallel_for(chunks_count, [&](std::size_t chunk_idx) {
+            ustore_error_t* chunk_error = &chunks_errors[chunk_idx];
+            safe_section("Inspecting a chunk", chunk_error, [&] {
+                gist_chunk_t& chunk = chunks[chunk_idx];
+                std::string path;
+                stored_doc_t doc;
+                std::size_t docs_begin = chunk_idx * gist_docs_per_thread_k;
+                std::size_t docs_end = std::min<std::size_t>(docs_begin + gist_docs_per_thread_k, docs_count);
+                for (std::size_t doc_idx = docs_begin; doc_idx != docs_end && !*chunk_error; ++doc_idx) {
+                    value_view_t binary_doc = found_binaries[doc_idx];
+                    if (!binary_doc)
+                        continue;
+
+                    return_error_if_m(doc.reset(binary_doc), chunk_error, args_wrong_k, "Failed to parse document!");
+                    if (tape_node_t root = doc.tape())
+                        gist_recursively(root, path, chunk, chunk_error);
+                    else if (yyjson_val* root = doc.root())
+                        gist_recursively(root, path, chunk, chunk_error);
+                    else
+                        continue;
+                    ++chunk.docs_present;
+                }
+            });
+        });
+        for (ustore_error_t error : chunks_errors)
+            return_error_if_m(!error, c.error, error_unknown_k, error);
+        for (gist_chunk_t const& chunk : chunks)
+            merged.merge(chunk);
+    });
+    return_if_error_m(c.error);
 
-    // Export all the elements into a heap-allocated hash-set, keeping only unique entries
-    field_path_buffer_t field_name = {0};
-    uninitialized_array_gt<std::string_view> sorted_paths(arena);
+    // Export the paths, followed by their statistics
+    std::size_t const fields_count = merged.paths.size();
     growing_tape_t exported_paths(arena);
-    for (ustore_size_t doc_idx = 0; doc_idx != c.docs_count; ++doc_idx, ++found_binary_it) {
-        value_view_t binary_doc = *found_binary_it;
-        if (!binary_doc)
-            continue;
-
-        json_t doc = any_parse(binary_doc, internal_format_k, arena, c.error);
+    exported_paths.reserve(fields_count, c.error);
+    return_if_error_m(c.error);
+    for (auto const& [path, stats] : merged.paths) {
+        exported_paths.push_back(value_view_t(path.data(), path.size()), c.error);
         return_if_error_m(c.error);
-        if (!doc)
-            continue;
-
-        yyjson_val* root = yyjson_doc_get_root(doc.handle);
-        gist_recursively(root, field_name, sorted_paths, exported_paths, c.error);
+        exported_paths.add_terminator(byte_t {0}, c.error);
         return_if_error_m(c.error);
     }
 
     if (c.fields_count)
-        *c.fields_count = static_cast<ustore_size_t>(sorted_paths.size());
+        *c.fields_count = static_cast<ustore_size_t>(fields_count);
     if (c.offsets)
         *c.offsets = exported_paths.offsets().begin().get();
     if (c.fields)
         *c.fields = reinterpret_cast<ustore_char_t*>(exported_paths.contents().begin().get());
-}
+    if (c.docs_present)
+        *c.docs_present = merged.docs_present;
 
-std::size_t doc_field_size_bytes(ustore_doc_field_type_t type) {
-    switch (type) {
-    default: return 0;
-    case ustore_doc_field_null_k: return 0;
-    case ustore_doc_field_bool_k: return 1;
-    case ustore_doc_field_uuid_k: return 16;
+    if (c.presences) {
+        auto presences = arena.alloc<ustore_size_t>(fields_count, c.error);
+        return_if_error_m(c.error);
+        for (std::size_t field_idx = 0; field_idx != fields_count; ++field_idx)
+            presences[field_idx] = merged.paths[field_idx].second.presences;
+        *c.presences = presences.begin();
+    }
 
-    case ustore_doc_field_i8_k: return 1;
-    case ustore_doc_field_i16_k: return 2;
-    case ustore_doc_field_i32_k: return 4;
-    case ustore_doc_field_i64_k: return 8;
+    if (c.types_counts || c.types) {
+        auto types_counts = arena.alloc<ustore_size_t>(fields_count * ustore_doc_gist_types_k, c.error);
+        return_if_error_m(c.error);
+        for (std::size_t field_idx = 0; field_idx != fields_count; ++field_idx)
+            std::copy_n(merged.paths[field_idx].second.types_counts.data(),
+                        ustore_doc_gist_types_k,
+                        types_counts.begin() + field_idx * ustore_doc_gist_types_k);
+        if (c.types_counts)
+            *c.types_counts = types_counts.begin();
+
+        if (c.types) {
+            auto types = arena.alloc<ustore_doc_field_type_t>(fields_count, c.error);
+            return_if_error_m(c.error);
+            for (std::size_t field_idx = 0; field_idx != fields_count; ++field_idx)
+                types[field_idx] = gist_gather_type(types_counts.begin() + field_idx * ustore_doc_gist_types_k);
+            *c.types = types.begin();
+        }
+    }
+}
 
-    case ustore_doc_field_u8_k: return 1;
-    case ustore_doc_field_u16_k: return 2;
-    case ustore_doc_field_u32_k: return 4;
-    case ustore_doc_field_u64_k: return 8;
+/**
+ * Every worker thread gathers a contiguous range of documents, sized as a
+ * multiple of 512, so that the bitmaps of different threads never share a
+ * 64-byte cache line, and no bits are lost to concurrent read-modify-writes.
+ */
+constexpr std::size_t gathered_docs_per_thread_k = 4096;
 
-    case ustore_doc_field_f16_k: return 2;
-    case ustore_doc_field_f32_k: return 4;
-    case ustore_doc_field_f64_k: return 8;
+/**
+ * Columns and bitmaps are aligned and padded to 64 bytes, so that they can be
+ * passed into Apache Arrow without copies.
+ * https://arrow.apache.org/docs/format/Columnar.html#buffer-alignment-and-padding
+ */
+constexpr std::size_t gathered_alignment_k = 64;
 
-    // Offsets and lengths:
-    case ustore_doc_field_bin_k: return 8;
-    case ustore_doc_field_str_k: return 8;
+/**
+ * @brief Single comparison of a `ustore_docs_gather_t` filter.
+ */
+struct doc_filter_t {
+    /** @brief The part of a shredded document, that @p field is looked up in. */
+    std::size_t source = 0;
+    ustore_str_view_t field = nullptr;
+    ustore_doc_compare_t comparison = ustore_doc_compare_eq_k;
+    indexed_value_t literal;
+
+    bool passes(stored_doc_t& doc) const noexcept(false) {
+        yyjson_val* value = doc.lookup(field);
+        std::optional<int> order = value ? compare_json(value, literal) : std::nullopt;
+        if (!order)
+            return false;
+        switch (comparison) {
+        case ustore_doc_compare_eq_k: return *order == 0;
+        case ustore_doc_compare_ne_k: return *order != 0;
+        case ustore_doc_compare_lt_k: return *order < 0;
+        case ustore_doc_compare_le_k: return *order <= 0;
+        case ustore_doc_compare_gt_k: return *order > 0;
+        case ustore_doc_compare_ge_k: return *order >= 0;
+        default: return false;
+        }
     }
-}
+};
 
-bool doc_field_is_variable_length(ustore_doc_field_type_t type) {
-    switch (type) {
-    case ustore_doc_field_bin_k: return true;
-    case ustore_doc_field_str_k: return true;
-    default: return false;
+/**
+ * @brief Parts of a gathered document, with the default allocator,
+ * as the arena can't be shared between threads.
+ */
+struct gathered_doc_t {
+    std::vector<stored_doc_t> parts;
+
+    explicit gathered_doc_t(std::size_t sources_count) noexcept(false) : parts(sources_count) {}
+
+    /**
+     * @brief Prepares all the read parts of the @p doc_idx -th document.
+     * @return False, if the document is missing or can't be parsed.
+     */
+    bool parse(shredded_reads_t const& reads, std::size_t doc_idx, ustore_error_t* c_error) noexcept {
+        for (stored_doc_t& part : parts)
+            part.clear();
+        if (!reads.exists(doc_idx))
+            return false;
+        for (std::size_t source_idx = 0; source_idx != parts.size(); ++source_idx) {
+            if (!parts[source_idx].reset(reads.at(source_idx, doc_idx))) {
+                log_error_m(c_error, 0, "Failed to parse document!");
+                return false;
+            }
+        }
+        return true;
     }
-}
+};
 
 struct column_begin_t {
     ustore_octet_t* validities;
@@ -1964,34 +4057,40 @@ struct column_begin_t {
         json_to_scalar(value, mask, valid, convert, collide, scalar);
     }
 
+    /**
+     * @brief Appends the string into a thread-local @p output, exporting its offset within it.
+     * Offsets are later shifted, when all the threads report their strings lengths.
+     */
     inline void set_str(std::size_t doc_idx,
                         yyjson_val* value,
                         printed_number_buffer_t& print_buffer,
-                        string_t& output,
-                        bool with_separator,
-                        bool is_last,
-                        ustore_error_t* c_error) noexcept {
+                        std::string& output,
+                        bool with_separator) noexcept(false) {
 
         ustore_octet_t mask = static_cast<ustore_octet_t>(1 << (doc_idx % CHAR_BIT));
         ustore_octet_t& valid = validities[doc_idx / CHAR_BIT];
         ustore_octet_t& convert = conversions[doc_idx / CHAR_BIT];
         ustore_octet_t& collide = collisions[doc_idx / CHAR_BIT];
-        ustore_length_t& off = str_offsets[doc_idx];
-        ustore_length_t& len = str_lengths[doc_idx];
 
         auto str = json_to_string(value, mask, valid, convert, collide, print_buffer);
-        off = static_cast<ustore_length_t>(output.size());
-        len = static_cast<ustore_length_t>(str.size());
-        output.insert(output.size(), str.begin(), str.end(), c_error);
-        return_if_error_m(c_error);
+        str_offsets[doc_idx] = static_cast<ustore_length_t>(output.size());
+        str_lengths[doc_idx] = static_cast<ustore_length_t>(str.size());
+        output.append(str.data(), str.size());
+        if (with_separator)
+            output.push_back('\0');
+    }
+
+    inline void skip_str(std::size_t doc_idx, std::string& output, bool with_separator) noexcept(false) {
+        str_offsets[doc_idx] = static_cast<ustore_length_t>(output.size());
+        str_lengths[doc_idx] = 0;
         if (with_separator)
-            output.push_back('\0', c_error);
-        if (is_last)
-            str_offsets[doc_idx + 1] = static_cast<ustore_length_t>(output.size());
+            output.push_back('\0');
     }
 };
 
+#if !defined(USTORE_FLIGHT_CLIENT)
 void ustore_docs_gather(ustore_docs_gather_t* c_ptr) {
+    trace_span_m("docs_gather");
 
     ustore_docs_gather_t& c = *c_ptr;
     if (!c.docs_count || !c.fields_count)
@@ -2000,54 +4099,132 @@ void ustore_docs_gather(ustore_docs_gather_t* c_ptr) {
     linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
     return_if_error_m(c.error);
 
-    // Retrieve the entire documents before we can sample internal fields
-    ustore_byte_t* found_binary_begin {};
-    ustore_length_t* found_binary_offs {};
-    ustore_read_t read {};
-    read.db = c.db;
-    read.error = c.error;
-    read.transaction = c.transaction;
-    read.snapshot = c.snapshot;
-    read.arena = arena;
-    read.options = c.options;
-    read.tasks_count = c.docs_count;
-    read.collections = c.collections;
-    read.collections_stride = c.collections_stride;
-    read.keys = c.keys;
-    read.keys_stride = c.keys_stride;
-    read.offsets = &found_binary_offs;
-    read.values = &found_binary_begin;
+    strided_iterator_gt<ustore_str_view_t const> fields {c.fields, c.fields_stride};
+    strided_iterator_gt<ustore_doc_field_type_t const> types {c.types, c.types_stride};
+    strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
+    strided_iterator_gt<ustore_key_t const> keys {c.keys, c.keys_stride};
+    places_arg_t docs {collections, keys, {}, c.docs_count};
+
+    // Without shreds, all the fields are looked up in the residual, which is the entire document.
+    // Otherwise, only the columns of requested fields and filters are fetched.
+    shreds_t shreds;
+    parse_shreds(c.shreds_count,
+                 c.shreds_fields,
+                 c.shreds_fields_stride,
+                 c.shreds_collections,
+                 c.shreds_collections_stride,
+                 shreds,
+                 c.error);
+    return_if_error_m(c.error);
 
-    ustore_read(&read);
+    std::vector<std::pair<std::size_t, ustore_str_view_t>> fields_sources;
+    std::vector<bool> needed_sources;
+    std::vector<doc_filter_t> filters;
+    shredded_reads_t reads;
+    safe_section("Reading documents", c.error, [&] {
+        needed_sources.resize(shreds.sources_count(), false);
+        fields_sources.resize(c.fields_count);
+        for (ustore_size_t field_idx = 0; field_idx != c.fields_count; ++field_idx) {
+            ustore_str_view_t field = fields[field_idx];
+            return_error_if_m(field || !shreds.size(), c.error, args_wrong_k, "Can't gather whole shredded documents");
+            fields_sources[field_idx] = shreds.locate(field);
+            needed_sources[fields_sources[field_idx].first] = true;
+        }
+
+        if (c.filters_count) {
+            strided_iterator_gt<ustore_str_view_t const> filters_fields {c.filters_fields, c.filters_fields_stride};
+            strided_iterator_gt<ustore_doc_compare_t const> filters_operators {c.filters_operators,
+                                                                               c.filters_operators_stride};
+            strided_iterator_gt<ustore_str_view_t const> filters_values {c.filters_values, c.filters_values_stride};
+            return_error_if_m(filters_fields && filters_values,
+                              c.error,
+                              args_wrong_k,
+                              "Filters need fields and values");
+
+            filters.resize(c.filters_count);
+            for (std::size_t filter_idx = 0; filter_idx != c.filters_count; ++filter_idx) {
+                doc_filter_t& filter = filters[filter_idx];
+                auto [source_idx, field] = shreds.locate(filters_fields[filter_idx]);
+                filter.source = source_idx;
+                filter.field = field;
+                needed_sources[filter.source] = true;
+                filter.comparison = filters_operators ? filters_operators[filter_idx] : ustore_doc_compare_eq_k;
+                std::optional<indexed_value_t> literal;
+                if (ustore_str_view_t json = filters_values[filter_idx])
+                    with_parsed_json(value_view_t(json), arena, [&](yyjson_val* root) { literal = index_json(root); });
+                return_error_if_m(literal, c.error, args_wrong_k, "Filters can only compare with JSON scalars");
+                filter.literal = std::move(*literal);
+            }
+        }
+
+        reads = read_shredded(c.db, c.transaction, c.snapshot, docs, shreds, needed_sources, c.options, arena, c.error);
+    });
     return_if_error_m(c.error);
 
-    strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
-    strided_iterator_gt<ustore_key_t const> keys {c.keys, c.keys_stride};
-    strided_iterator_gt<ustore_str_view_t const> fields {c.fields, c.fields_stride};
-    strided_iterator_gt<ustore_doc_field_type_t const> types {c.types, c.types_stride};
+    // Evaluate the filters before exporting anything, so that only the passing documents
+    // are converted and take memory. Those are parsed twice, but are expected to be few.
+    std::vector<ustore_length_t> selected;
+    safe_section("Filtering documents", c.error, [&] {
+        if (!c.filters_count)
+            return;
+
+        std::size_t chunks_count = divide_round_up(c.docs_count, gathered_docs_per_thread_k);
+        std::vector<std::vector<ustore_length_t>> chunks_selected(chunks_count);
+        std::vector<ustore_error_t> chunks_errors(chunks_count, nullptr);
+        parallel_for(chunks_count, [&](std::size_t chunk_idx) {
+            safe_section("Filtering a chunk", &chunks_errors[chunk_idx], [&] {
+                gathered_doc_t doc {shreds.sources_count()};
+                std::size_t docs_begin = chunk_idx * gathered_docs_per_thread_k;
+                std::size_t docs_end = std::min<std::size_t>(docs_begin + gathered_docs_per_thread_k, c.docs_count);
+                for (std::size_t doc_idx = docs_begin; doc_idx != docs_end; ++doc_idx) {
+                    bool exists = doc.parse(reads, doc_idx, &chunks_errors[chunk_idx]);
+                    return_if_error_m(&chunks_errors[chunk_idx]);
+                    if (!exists)
+                        continue;
+                    bool passes = std::all_of(filters.begin(), filters.end(), [&](doc_filter_t const& filter) {
+                        return filter.passes(doc.parts[filter.source]);
+                    });
+                    if (passes)
+                        chunks_selected[chunk_idx].push_back(static_cast<ustore_length_t>(doc_idx));
+                }
+            });
+        });
+        for (ustore_error_t error : chunks_errors)
+            return_error_if_m(!error, c.error, error_unknown_k, error);
+        for (auto const& chunk_selected : chunks_selected)
+            selected.insert(selected.end(), chunk_selected.begin(), chunk_selected.end());
+    });
+    return_if_error_m(c.error);
 
-    joined_blobs_t found_binaries {c.docs_count, found_binary_offs, found_binary_begin};
-    joined_blobs_iterator_t found_binary_it = found_binaries.begin();
+    // From here on, the exported rows are addressed by `row_idx`
+    std::size_t const rows_count = c.filters_count ? selected.size() : c.docs_count;
+    auto doc_idx_at = [&](std::size_t row_idx) { return c.filters_count ? selected[row_idx] : row_idx; };
+    if (c.selected_count)
+        *c.selected_count = rows_count;
+    if (c.selected_indices) {
+        auto indices = arena.alloc<ustore_length_t>(rows_count, c.error);
+        return_if_error_m(c.error);
+        for (std::size_t row_idx = 0; row_idx != rows_count; ++row_idx)
+            indices[row_idx] = static_cast<ustore_length_t>(doc_idx_at(row_idx));
+        *c.selected_indices = indices.begin();
+    }
 
     // Estimate the amount of memory needed to store at least scalars and columns addresses
-    // TODO: Align offsets of bitmaps to 64-byte boundaries for Arrow
-    // https://arrow.apache.org/docs/format/Columnar.html#buffer-alignment-and-padding
-    // TODO: Align offsets of bitmaps to 64-byte boundaries for Arrow
-    // https://arrow.apache.org/docs/format/Columnar.html#buffer-alignment-and-padding
+    auto aligned = [](std::size_t bytes) { return next_multiple<std::size_t>(bytes, gathered_alignment_k); };
     bool wants_conversions = c.columns_conversions;
     bool wants_collisions = c.columns_collisions;
-    std::size_t slots_per_bitmap = divide_round_up<std::size_t>(c.docs_count, bits_in_byte_k);
+    std::size_t slots_per_bitmap = divide_round_up<std::size_t>(rows_count, bits_in_byte_k);
     std::size_t count_bitmaps = 1ul + wants_conversions + wants_collisions;
-    std::size_t bytes_per_bitmap = sizeof(ustore_octet_t) * slots_per_bitmap;
+    std::size_t bytes_per_bitmap = aligned(sizeof(ustore_octet_t) * slots_per_bitmap);
     std::size_t bytes_per_addresses_row = sizeof(void*) * c.fields_count;
-    std::size_t bytes_for_addresses = bytes_per_addresses_row * 6 + sizeof(ustore_length_t);
-    std::size_t bytes_for_bitmaps = bytes_per_bitmap * count_bitmaps * c.fields_count * c.fields_count;
-    std::size_t bytes_per_scalars_row = transform_reduce_n(types, c.fields_count, 0ul, &doc_field_size_bytes);
-    std::size_t bytes_for_scalars = bytes_per_scalars_row * c.docs_count;
-
-    std::size_t string_columns = transform_reduce_n(types, c.fields_count, 0ul, doc_field_is_variable_length);
-    bool has_string_columns = string_columns != 0;
-    bool has_scalar_columns = string_columns != c.fields_count;
+    std::size_t bytes_for_addresses = aligned(bytes_per_addresses_row * 6);
+    std::size_t bytes_for_bitmaps = bytes_per_bitmap * count_bitmaps * c.fields_count;
+    std::size_t bytes_for_offsets = aligned(sizeof(ustore_length_t) * (rows_count + 1));
+    std::size_t bytes_for_lengths = aligned(sizeof(ustore_length_t) * rows_count);
+    std::size_t bytes_for_scalars = transform_reduce_n(types, c.fields_count, 0ul, [&](ustore_doc_field_type_t type) {
+        return doc_field_is_variable_length(type) ? bytes_for_offsets + bytes_for_lengths
+                                                  : aligned(doc_field_size_bytes(type) * rows_count);
+    });
 
     // Preallocate at least a minimum amount of memory.
     // It will be organized in the following way:
@@ -2058,7 +4235,11 @@ void ustore_docs_gather(ustore_docs_gather_t* c_ptr) {
     // 5. lengths of all strings
     // 6. scalars for all fields
 
-    auto tape = arena.alloc<byte_t>(bytes_for_addresses + bytes_for_bitmaps + bytes_for_scalars, c.error);
+    auto tape = arena.alloc<byte_t>( //
+        bytes_for_addresses + bytes_for_bitmaps + bytes_for_scalars,
+        c.error,
+        gathered_alignment_k);
+    return_if_error_m(c.error);
     byte_t* const tape_ptr = tape.begin();
 
     // If those pointers were not provided, we can reuse the validity bitmap
@@ -2067,38 +4248,38 @@ void ustore_docs_gather(ustore_docs_gather_t* c_ptr) {
     // ! to avoid overwriting.
     auto first_collection_validities = reinterpret_cast<ustore_octet_t*>(tape_ptr + bytes_for_addresses);
     auto first_collection_conversions = wants_conversions //
-                                            ? first_collection_validities + slots_per_bitmap * c.fields_count
+                                            ? first_collection_validities + bytes_per_bitmap * c.fields_count
                                             : first_collection_validities;
     auto first_collection_collisions = wants_collisions //
-                                           ? first_collection_conversions + slots_per_bitmap * c.fields_count
+                                           ? first_collection_conversions + bytes_per_bitmap * c.fields_count
                                            : first_collection_validities;
     auto first_collection_scalars =
         reinterpret_cast<ustore_byte_t*>(tape_ptr + bytes_for_addresses + bytes_for_bitmaps);
 
+    // Missing documents leave all the bits unset
+    std::memset(first_collection_validities, 0, bytes_for_bitmaps);
+
     // 1, 2, 3. Export validity maps addresses
     std::size_t tape_progress = 0;
-    {
-        auto addresses = reinterpret_cast<ustore_octet_t**>(tape_ptr + tape_progress);
-        if (c.columns_validities)
-            *c.columns_validities = addresses;
-        for (ustore_size_t field_idx = 0; field_idx != c.fields_count; ++field_idx)
-            addresses[field_idx] = first_collection_validities + field_idx * slots_per_bitmap;
-        tape_progress += bytes_per_addresses_row;
-    }
+    auto addresses_validities = reinterpret_cast<ustore_octet_t**>(tape_ptr + tape_progress);
+    if (c.columns_validities)
+        *c.columns_validities = addresses_validities;
+    for (ustore_size_t field_idx = 0; field_idx != c.fields_count; ++field_idx)
+        addresses_validities[field_idx] = first_collection_validities + field_idx * bytes_per_bitmap;
+    tape_progress += bytes_per_addresses_row;
+
     if (wants_conversions) {
         auto addresses = reinterpret_cast<ustore_octet_t**>(tape_ptr + tape_progress);
-        if (c.columns_conversions)
-            *c.columns_conversions = addresses;
+        *c.columns_conversions = addresses;
         for (ustore_size_t field_idx = 0; field_idx != c.fields_count; ++field_idx)
-            addresses[field_idx] = first_collection_conversions + field_idx * slots_per_bitmap;
+            addresses[field_idx] = first_collection_conversions + field_idx * bytes_per_bitmap;
         tape_progress += bytes_per_addresses_row;
     }
     if (wants_collisions) {
         auto addresses = reinterpret_cast<ustore_octet_t**>(tape_ptr + tape_progress);
-        if (c.columns_collisions)
-            *c.columns_collisions = addresses;
+        *c.columns_collisions = addresses;
         for (ustore_size_t field_idx = 0; field_idx != c.fields_count; ++field_idx)
-            addresses[field_idx] = first_collection_collisions + field_idx * slots_per_bitmap;
+            addresses[field_idx] = first_collection_collisions + field_idx * bytes_per_bitmap;
         tape_progress += bytes_per_addresses_row;
     }
 
@@ -2117,79 +4298,146 @@ void ustore_docs_gather(ustore_docs_gather_t* c_ptr) {
         auto scalars_tape = first_collection_scalars;
         for (ustore_size_t field_idx = 0; field_idx != c.fields_count; ++field_idx) {
             ustore_doc_field_type_t type = types[field_idx];
-            switch (type) {
-            case ustore_doc_field_str_k:
-            case ustore_doc_field_bin_k:
+            if (doc_field_is_variable_length(type)) {
                 addresses_offs[field_idx] = reinterpret_cast<ustore_length_t*>(scalars_tape);
-                addresses_lens[field_idx] = addresses_offs[field_idx] + c.docs_count + 1;
+                addresses_lens[field_idx] = reinterpret_cast<ustore_length_t*>(scalars_tape + bytes_for_offsets);
                 addresses_scalars[field_idx] = nullptr;
-                break;
-            default:
+                scalars_tape += bytes_for_offsets + bytes_for_lengths;
+            }
+            else {
                 addresses_offs[field_idx] = nullptr;
                 addresses_lens[field_idx] = nullptr;
                 addresses_scalars[field_idx] = reinterpret_cast<ustore_byte_t*>(scalars_tape);
-                break;
+                scalars_tape += aligned(doc_field_size_bytes(type) * rows_count);
             }
-            scalars_tape += doc_field_size_bytes(type) * c.docs_count + sizeof(ustore_length_t);
         }
     }
 
-    // Go though all the documents extracting and type-checking the relevant parts
-    printed_number_buffer_t print_buffer;
-    string_t string_tape(arena);
-    for (ustore_size_t doc_idx = 0; doc_idx != c.docs_count; ++doc_idx, ++found_binary_it) {
-        value_view_t binary_doc = *found_binary_it;
-        json_t doc = any_parse(binary_doc, internal_format_k, arena, c.error);
-        return_if_error_m(c.error);
-        if (!doc)
-            continue;
-        yyjson_val* root = yyjson_doc_get_root(doc.handle);
-
+    // Every thread fills its own slice of the shared columns, but strings are
+    // collected in thread-local buffers, until their total lengths are known.
+    std::size_t chunks_count = divide_round_up(rows_count, gathered_docs_per_thread_k);
+    std::vector<std::vector<std::string>> chunks_strings;
+    std::vector<ustore_error_t> chunks_errors;
+    std::vector<std::size_t> chunks_offsets;
+    std::vector<column_begin_t> columns;
+    safe_section("Gathering documents", c.error, [&] {
+        chunks_strings.resize(chunks_count);
+        chunks_errors.resize(chunks_count, nullptr);
+        chunks_offsets.resize(chunks_count * c.fields_count);
+        columns.resize(c.fields_count);
         for (ustore_size_t field_idx = 0; field_idx != c.fields_count; ++field_idx) {
-
-            // Find this field within document
-            ustore_doc_field_type_t type = types[field_idx];
-            ustore_str_view_t field = fields[field_idx];
-            yyjson_val* found_value = json_lookup(root, field);
-
-            column_begin_t column {};
-            column.validities = (*c.columns_validities)[field_idx];
-            column.conversions = (*(c.columns_conversions ? c.columns_conversions : c.columns_validities))[field_idx];
-            column.collisions = (*(c.columns_collisions ? c.columns_collisions : c.columns_validities))[field_idx];
+            column_begin_t& column = columns[field_idx];
+            column.validities = addresses_validities[field_idx];
+            column.conversions = wants_conversions ? (*c.columns_conversions)[field_idx] : column.validities;
+            column.collisions = wants_collisions ? (*c.columns_collisions)[field_idx] : column.validities;
             column.scalars = addresses_scalars[field_idx];
             column.str_offsets = addresses_offs[field_idx];
             column.str_lengths = addresses_lens[field_idx];
+        }
 
-            bool is_last = doc_idx == c.docs_count - 1;
-            // Export the types
-            switch (type) {
-
-            case ustore_doc_field_bool_k: column.set<bool>(doc_idx, found_value); break;
-
-            case ustore_doc_field_i8_k: column.set<std::int8_t>(doc_idx, found_value); break;
-            case ustore_doc_field_i16_k: column.set<std::int16_t>(doc_idx, found_value); break;
-            case ustore_doc_field_i32_k: column.set<std::int32_t>(doc_idx, found_value); break;
-            case ustore_doc_field_i64_k: column.set<std::int64_t>(doc_idx, found_value); break;
-
-            case ustore_doc_field_u8_k: column.set<std::uint8_t>(doc_idx, found_value); break;
-            case ustore_doc_field_u16_k: column.set<std::uint16_t>(doc_idx, found_value); break;
-            case ustore_doc_field_u32_k: column.set<std::uint32_t>(doc_idx, found_value); break;
-            case ustore_doc_field_u64_k: column.set<std::uint64_t>(doc_idx, found_value); break;
-
-            case ustore_doc_field_f32_k: column.set<float>(doc_idx, found_value); break;
-            case ustore_doc_field_f64_k: column.set<double>(doc_idx, found_value); break;
+        // First pass: go though all the documents extracting and type-checking the relevant parts
+        parallel_for(chunks_count, [&](std::size_t chunk_idx) {
+            safe_section("Gathering a chunk", &chunks_errors[chunk_idx], [&] {
+                trace_span_m("docs.gather_chunk");
+                std::vector<std::string>& strings = chunks_strings[chunk_idx];
+                strings.resize(c.fields_count);
+                printed_number_buffer_t print_buffer;
+                gathered_doc_t doc {shreds.sources_count()};
+                std::size_t rows_begin = chunk_idx * gathered_docs_per_thread_k;
+                std::size_t rows_end = std::min<std::size_t>(rows_begin + gathered_docs_per_thread_k, rows_count);
+                for (std::size_t row_idx = rows_begin; row_idx != rows_end; ++row_idx) {
+                    bool exists = doc.parse(reads, doc_idx_at(row_idx), &chunks_errors[chunk_idx]);
+                    return_if_error_m(&chunks_errors[chunk_idx]);
+
+                    for (ustore_size_t field_idx = 0; field_idx != c.fields_count; ++field_idx) {
+
+                        // Find this field within document
+                        ustore_doc_field_type_t type = types[field_idx];
+                        column_begin_t& column = columns[field_idx];
+                        if (!exists) {
+                            if (doc_field_is_variable_length(type))
+                                column.skip_str(row_idx, strings[field_idx], type == ustore_doc_field_str_k);
+                            continue;
+                        }
+                        auto [source_idx, field] = fields_sources[field_idx];
+                        yyjson_val* found_value = doc.parts[source_idx].lookup(field);
+
+                        // Export the types
+                        switch (type) {
+
+                        case ustore_doc_field_bool_k: column.set<bool>(row_idx, found_value); break;
+
+                        case ustore_doc_field_i8_k: column.set<std::int8_t>(row_idx, found_value); break;
+                        case ustore_doc_field_i16_k: column.set<std::int16_t>(row_idx, found_value); break;
+                        case ustore_doc_field_i32_k: column.set<std::int32_t>(row_idx, found_value); break;
+                        case ustore_doc_field_i64_k: column.set<std::int64_t>(row_idx, found_value); break;
+
+                        case ustore_doc_field_u8_k: column.set<std::uint8_t>(row_idx, found_value); break;
+                        case ustore_doc_field_u16_k: column.set<std::uint16_t>(row_idx, found_value); break;
+                        case ustore_doc_field_u32_k: column.set<std::uint32_t>(row_idx, found_value); break;
+                        case ustore_doc_field_u64_k: column.set<std::uint64_t>(row_idx, found_value); break;
+
+                        case ustore_doc_field_f32_k: column.set<float>(row_idx, found_value); break;
+                        case ustore_doc_field_f64_k: column.set<double>(row_idx, found_value); break;
+
+                        case ustore_doc_field_str_k:
+                            column.set_str(row_idx, found_value, print_buffer, strings[field_idx], true);
+                            break;
+                        case ustore_doc_field_bin_k:
+                            column.set_str(row_idx, found_value, print_buffer, strings[field_idx], false);
+                            break;
+
+                        default: break;
+                        }
+                    }
+                }
+            });
+        });
+    });
+    return_if_error_m(c.error);
+    for (ustore_error_t error : chunks_errors)
+        return_error_if_m(!error, c.error, error_unknown_k, error);
+
+    // Every strings column is contiguous and aligned, like Arrow expects,
+    // with threads contributing their parts in the order of documents.
+    std::size_t joined_length = 0;
+    for (ustore_size_t field_idx = 0; field_idx != c.fields_count; ++field_idx) {
+        if (!doc_field_is_variable_length(types[field_idx]))
+            continue;
+        joined_length = aligned(joined_length);
+        for (std::size_t chunk_idx = 0; chunk_idx != chunks_count; ++chunk_idx) {
+            chunks_offsets[chunk_idx * c.fields_count + field_idx] = joined_length;
+            joined_length += chunks_strings[chunk_idx][field_idx].size();
+        }
+        addresses_offs[field_idx][rows_count] = static_cast<ustore_length_t>(joined_length);
+    }
+    return_error_if_m(joined_length <= std::numeric_limits<ustore_length_t>::max(),
+                      c.error,
+                      args_wrong_k,
+                      "Gathered strings don't fit into 32-bit offsets");
 
-            case ustore_doc_field_str_k:
-                column.set_str(doc_idx, found_value, print_buffer, string_tape, true, is_last, c.error);
-                break;
-            case ustore_doc_field_bin_k:
-                column.set_str(doc_idx, found_value, print_buffer, string_tape, false, is_last, c.error);
-                break;
+    auto joined = arena.alloc<byte_t>(joined_length, c.error, gathered_alignment_k);
+    return_if_error_m(c.error);
 
-            default: break;
+    // Second pass: shift the offsets and copy the strings
+    safe_section("Joining strings", c.error, [&] {
+        parallel_for(chunks_count, [&](std::size_t chunk_idx) {
+            std::size_t rows_begin = chunk_idx * gathered_docs_per_thread_k;
+            std::size_t rows_end = std::min<std::size_t>(rows_begin + gathered_docs_per_thread_k, rows_count);
+            for (ustore_size_t field_idx = 0; field_idx != c.fields_count; ++field_idx) {
+                if (!doc_field_is_variable_length(types[field_idx]))
+                    continue;
+                std::string const& strings = chunks_strings[chunk_idx][field_idx];
+                std::size_t chunk_offset = chunks_offsets[chunk_idx * c.fields_count + field_idx];
+                std::memcpy(joined.begin() + chunk_offset, strings.data(), strings.size());
+                ustore_length_t* offsets = addresses_offs[field_idx];
+                for (std::size_t row_idx = rows_begin; row_idx != rows_end; ++row_idx)
+                    offsets[row_idx] += static_cast<ustore_length_t>(chunk_offset);
             }
-        }
-    }
+        });
+    });
 
-    *c.joined_strings = reinterpret_cast<ustore_byte_t*>(string_tape.data());
+    if (c.joined_strings)
+        *c.joined_strings = reinterpret_cast<ustore_byte_t*>(joined.begin());
 }
+#endif // Forwarded to the server in `flight_client.cpp`
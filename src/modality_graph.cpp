@@ -10,15 +10,31 @@
  * - output degree
  * - inbound neighborships: neighbor ID + edge ID
  * - outbound neighborships: neighbor ID + edge ID
+ *
+ * Neighborhoods of high-degree vertices are block-wise compressed before being written,
+ * and unpacked into the arena once read. Neighborhoods, that were given edge attributes,
+ * stay plain and keep them in columns after the relations. @see "helpers/neighborhood_codec.hpp".
  */
 
+#include <atomic>   // `std::atomic`
 #include <numeric>  // `std::accumulate`
 #include <optional> // `std::optional`
 #include <limits>   // `std::numeric_limits`
 
+#include <fcntl.h>    // `open`
+#include <sys/mman.h> // `mmap`
+#include <sys/stat.h> // `fstat`
+#include <unistd.h>   // `close`
+
 #include "ustore/ustore.hpp"
-#include "helpers/linked_memory.hpp" // `linked_memory_lock_t`
-#include "helpers/algorithm.hpp"     // `equal_subrange`
+#include "helpers/linked_memory.hpp"      // `linked_memory_lock_t`
+#include "helpers/algorithm.hpp"          // `equal_subrange`
+#include "helpers/merge.hpp"              // `can_merge`
+#include "helpers/parallel.hpp"           // `parallel_for`
+#include "helpers/file.hpp"               // `file_handle_t`
+#include "helpers/neighborhood_codec.hpp" // `compressed_neighborhood_t`
+#include "helpers/graph_algorithms.hpp"   // `louvain`
+#include "helpers/trace.hpp"              // `trace_span_m`
 
 /*********************************************************/
 /*****************	 C++ Implementation	  ****************/
@@ -29,6 +45,7 @@ using namespace unum;
 
 ustore_key_t ustore_default_edge_id_k = std::numeric_limits<ustore_key_t>::max();
 ustore_vertex_degree_t ustore_vertex_degree_missing_k = std::numeric_limits<ustore_vertex_degree_t>::max();
+ustore_key_t ustore_vertex_id_min_k = chunk_keys_end_k;
 
 constexpr std::size_t bytes_in_degrees_header_k = 2 * sizeof(ustore_vertex_degree_t);
 
@@ -36,6 +53,9 @@ struct updated_entry_t : public collection_key_t {
     ustore_bytes_ptr_t content = nullptr;
     ustore_length_t length = ustore_length_missing_k;
     ustore_vertex_degree_t degree_delta = 0;
+    /// @brief The original attributed neighborhood, which `content` was stripped from.
+    value_view_t attributed;
+    bool attributes_changed = false;
     inline operator value_view_t() const noexcept { return {content, length}; }
 };
 
@@ -63,6 +83,51 @@ ptr_range_gt<neighborship_t const> neighbors(value_view_t bytes, ustore_vertex_r
     return neighbors(degrees, reinterpret_cast<ustore_key_t const*>(degrees + 2), role);
 }
 
+/**
+ * @brief Unpacks a compressed neighborhood into the @p arena.
+ * Plain and missing values are returned as-is.
+ */
+value_view_t decompress(value_view_t value, linked_memory_lock_t& arena, ustore_error_t* c_error) noexcept {
+    if (!is_compressed_neighborhood(value))
+        return value;
+
+    compressed_neighborhood_t compressed {value};
+    auto plain = arena.alloc<byte_t>(compressed.plain_length(), c_error);
+    if (*c_error)
+        return {};
+    compressed.decode(plain.begin());
+    return {plain.begin(), plain.size()};
+}
+
+/**
+ * @brief Compresses the neighborhoods of high-degree vertices before they are written,
+ * replacing the contents with @p arena buffers. Entries, that don't shrink, are kept plain.
+ */
+void compress(strided_range_gt<updated_entry_t> entries, linked_memory_lock_t& arena, ustore_error_t* c_error) {
+    for (std::size_t i = 0; i != entries.size(); ++i) {
+        updated_entry_t& entry = entries[i];
+        if (entry.length == ustore_length_missing_k || entry.length < bytes_in_degrees_header_k)
+            continue;
+        if (is_chunked_neighborhood(entry) || is_attributed_neighborhood(entry))
+            continue;
+
+        auto degrees = reinterpret_cast<ustore_vertex_degree_t const*>(entry.content);
+        std::size_t relations = degrees[0] + degrees[1];
+        if (relations < compressed_degrees_min_k)
+            continue;
+
+        auto buffer = arena.alloc<byte_t>(compressed_neighborhood_limit(relations), c_error);
+        return_if_error_m(c_error);
+        auto ships = reinterpret_cast<neighborship_t const*>(degrees + 2);
+        auto length = compress_neighborhood(degrees, ships, buffer.begin());
+        if (length >= entry.length)
+            continue;
+
+        entry.content = reinterpret_cast<ustore_bytes_ptr_t>(buffer.begin());
+        entry.length = static_cast<ustore_length_t>(length);
+    }
+}
+
 struct neighborhood_t {
     ustore_key_t center = 0;
     ptr_range_gt<neighborship_t const> targets;
@@ -303,6 +368,578 @@ void erase_from_entry(updated_entry_t& entry,
     entry.length -= sizeof(neighborship_t) * len;
 }
 
+/**
+ * @brief Replaces the chunked neighborhoods among @p values with plain ones, fetching the chunks
+ * of the requested roles in a single batched read. With @p pending_only, the directories without
+ * pending relations are kept as they are, as they already know their exact degrees.
+ */
+template <typename collection_at, typename role_at>
+void gather_chunks( //
+    ustore_database_t const c_db,
+    ustore_transaction_t const c_transaction,
+    ustore_snapshot_t const c_snapshot,
+    ptr_range_gt<value_view_t> values,
+    collection_at&& collection_of,
+    role_at&& role_of,
+    bool pending_only,
+    ustore_options_t const c_options,
+    linked_memory_lock_t& arena,
+    ustore_error_t* c_error) {
+
+    auto is_gathered = [&](value_view_t value) {
+        return is_chunked_neighborhood(value) &&
+               (!pending_only || !neighbors(chunked_neighborhood_t {value}.pending()).empty());
+    };
+
+    std::size_t gathered_count = 0;
+    std::size_t chunks_count = 0;
+    for (std::size_t i = 0; i != values.size(); ++i) {
+        if (!is_gathered(values[i]))
+            continue;
+        chunked_neighborhood_t chunked {values[i]};
+        for (std::size_t chunk_idx = 0; chunk_idx != chunked.chunks(); ++chunk_idx)
+            chunks_count += (chunked.chunk(chunk_idx).role & role_of(i)) != 0;
+        ++gathered_count;
+    }
+    if (!gathered_count)
+        return;
+
+    auto chunks_keys = arena.alloc<collection_key_t>(chunks_count, c_error);
+    return_if_error_m(c_error);
+    for (std::size_t i = 0, passed = 0; i != values.size(); ++i) {
+        if (!is_gathered(values[i]))
+            continue;
+        chunked_neighborhood_t chunked {values[i]};
+        for (std::size_t chunk_idx = 0; chunk_idx != chunked.chunks(); ++chunk_idx)
+            if (chunk_ref_t ref = chunked.chunk(chunk_idx); ref.role & role_of(i))
+                chunks_keys[passed++] = {collection_of(i), ref.key};
+    }
+
+    ustore_bytes_ptr_t found_values = nullptr;
+    ustore_length_t* found_offsets = nullptr;
+    if (chunks_count) {
+        auto chunks_strided = chunks_keys.strided().immutable();
+        auto collections = chunks_strided.members(&collection_key_t::collection);
+        auto keys = chunks_strided.members(&collection_key_t::key);
+        ustore_read_t read {};
+        read.db = c_db;
+        read.error = c_error;
+        read.transaction = c_transaction;
+        read.snapshot = c_snapshot;
+        read.arena = arena;
+        read.options = c_options;
+        read.tasks_count = chunks_count;
+        read.collections = collections.begin().get();
+        read.collections_stride = collections.begin().stride();
+        read.keys = keys.begin().get();
+        read.keys_stride = keys.begin().stride();
+        read.offsets = &found_offsets;
+        read.values = &found_values;
+
+        ustore_read(&read);
+        return_if_error_m(c_error);
+    }
+
+    // Chunks of the same role don't overlap and are sorted, so their concatenation is sorted too,
+    // but the pending relations must be merged in and deduplicated
+    joined_blobs_t found_chunks {chunks_count, found_offsets, found_values};
+    joined_blobs_iterator_t found_chunks_it = found_chunks.begin();
+    for (std::size_t i = 0; i != values.size(); ++i) {
+        if (!is_gathered(values[i]))
+            continue;
+        chunked_neighborhood_t chunked {values[i]};
+        value_view_t pending = chunked.pending();
+
+        std::size_t chunked_relations = 0;
+        ptr_range_gt<neighborship_t const> chunks_ships[2];
+        auto chunks_ships_buffer = arena.alloc<neighborship_t>(chunked.degree(role_of(i)), c_error);
+        return_if_error_m(c_error);
+        for (std::size_t half = 0; half != 2; ++half) {
+            auto half_role = half ? ustore_vertex_target_k : ustore_vertex_source_k;
+            neighborship_t* half_begin = chunks_ships_buffer.begin() + chunked_relations;
+            for (std::size_t chunk_idx = 0; chunk_idx != chunked.chunks(); ++chunk_idx) {
+                chunk_ref_t ref = chunked.chunk(chunk_idx);
+                if (!(ref.role & role_of(i)) || ref.role != half_role)
+                    continue;
+                value_view_t chunk = decompress(*found_chunks_it, arena, c_error);
+                return_if_error_m(c_error);
+                ++found_chunks_it;
+                auto ships = neighbors(chunk, ustore_vertex_source_k);
+                auto copied = std::min<std::size_t>(ships.size(), chunks_ships_buffer.size() - chunked_relations);
+                std::copy_n(ships.begin(), copied, chunks_ships_buffer.begin() + chunked_relations);
+                chunked_relations += copied;
+            }
+            chunks_ships[half] = {half_begin, chunks_ships_buffer.begin() + chunked_relations};
+        }
+
+        std::size_t relations_limit = chunked_relations + neighbors(pending).size();
+        auto plain = arena.alloc<byte_t>(bytes_in_degrees_header_k + relations_limit * sizeof(neighborship_t), c_error);
+        return_if_error_m(c_error);
+        ustore_vertex_degree_t degrees[2] {};
+        auto ships = reinterpret_cast<neighborship_t*>(plain.begin() + bytes_in_degrees_header_k);
+        for (std::size_t half = 0; half != 2; ++half) {
+            auto half_role = half ? ustore_vertex_target_k : ustore_vertex_source_k;
+            if (!(role_of(i) & half_role))
+                continue;
+            auto pending_ships = neighbors(pending, half_role);
+            auto end = std::set_union(chunks_ships[half].begin(),
+                                      chunks_ships[half].end(),
+                                      pending_ships.begin(),
+                                      pending_ships.end(),
+                                      ships);
+            degrees[half] = static_cast<ustore_vertex_degree_t>(end - ships);
+            ships = end;
+        }
+        std::memcpy(plain.begin(), degrees, sizeof(degrees));
+        values[i] = {plain.begin(), static_cast<std::size_t>(reinterpret_cast<byte_t*>(ships) - plain.begin())};
+    }
+}
+
+/**
+ * @brief An update of a chunked neighborhood, deferred until the relevant chunks are read.
+ * Erasures without a specific edge ID remove all the relations with the neighbor.
+ */
+struct chunk_update_t {
+    std::size_t entry_idx = 0;
+    ustore_vertex_role_t role = ustore_vertex_role_unknown_k;
+    neighborship_t ship;
+    bool erase = false;
+    bool any_edge = false;
+};
+
+/**
+ * @brief Splits the neighborhoods of supernodes into chunks and updates them,
+ * reading and rewriting only the chunks, that the updated relations fall into.
+ * The directories are patched in place, while the chunks are collected into `writes`,
+ * to be submitted in the same batch.
+ */
+class chunks_updater_t {
+
+    static constexpr ustore_key_t unassigned_key_k = std::numeric_limits<ustore_key_t>::max();
+
+    struct supernode_t {
+        std::size_t entry_idx = 0;
+        chunked_head_t head = empty_chunked_head_k;
+        std::vector<chunk_ref_t> refs;
+        std::vector<std::vector<neighborship_t>> contents;
+        std::vector<bool> dirty;
+        std::size_t updates_begin = 0;
+        std::size_t updates_end = 0;
+        bool changed = false;
+    };
+
+    std::vector<chunk_update_t> updates_;
+    std::vector<supernode_t> supernodes_;
+
+    /**
+     * @brief Finds the chunks of the @p node, that the @p update may change,
+     * creating an empty one, if the role has none to insert into.
+     */
+    static std::pair<std::size_t, std::size_t> locate(supernode_t& node, chunk_update_t const& update) {
+        auto role_less = [](chunk_ref_t const& ref, std::uint32_t role) { return ref.role < role; };
+        auto role_begin = std::lower_bound(node.refs.begin(), node.refs.end(), std::uint32_t(update.role), role_less);
+        auto role_end = role_begin;
+        while (role_end != node.refs.end() && role_end->role == std::uint32_t(update.role))
+            ++role_end;
+
+        if (role_begin == role_end) {
+            if (update.erase)
+                return {0, 0};
+            std::size_t idx = role_begin - node.refs.begin();
+            chunk_ref_t ref {update.ship, unassigned_key_k, std::uint32_t(update.role), 0};
+            node.refs.insert(role_begin, ref);
+            node.contents.emplace(node.contents.begin() + idx);
+            node.dirty.insert(node.dirty.begin() + idx, true);
+            return {idx, idx + 1};
+        }
+
+        // The relations smaller than the first chunk still belong to it
+        auto first_less = [](neighborship_t const& ship, chunk_ref_t const& ref) { return ship < ref.first; };
+        neighborship_t low = update.ship, high = update.ship;
+        if (update.any_edge)
+            low.edge_id = std::numeric_limits<ustore_key_t>::min(), high.edge_id = ustore_key_unknown_k;
+        auto first = std::upper_bound(role_begin, role_end, low, first_less);
+        auto last = std::upper_bound(role_begin, role_end, high, first_less);
+        first = first == role_begin ? first : first - 1;
+        last = std::max(last, first + 1);
+        return {std::size_t(first - node.refs.begin()), std::size_t(last - node.refs.begin())};
+    }
+
+    static bool apply(supernode_t& node, std::size_t chunk_idx, chunk_update_t const& update) {
+        std::vector<neighborship_t>& ships = node.contents[chunk_idx];
+        if (!update.erase) {
+            auto it = std::lower_bound(ships.begin(), ships.end(), update.ship);
+            if (it != ships.end() && *it == update.ship)
+                return false;
+            ships.insert(it, update.ship);
+            node.refs[chunk_idx].first = std::min(node.refs[chunk_idx].first, update.ship);
+            return true;
+        }
+
+        auto range = update.any_edge ? std::equal_range(ships.begin(), ships.end(), update.ship.neighbor_id)
+                                     : std::equal_range(ships.begin(), ships.end(), update.ship);
+        ships.erase(range.first, range.second);
+        return range.first != range.second;
+    }
+
+    template <typename callback_at>
+    void for_each_update(supernode_t& node, callback_at&& callback) {
+        for (std::size_t update_idx = node.updates_begin; update_idx != node.updates_end; ++update_idx) {
+            chunk_update_t const& update = updates_[update_idx];
+            auto range = locate(node, update);
+            for (std::size_t chunk_idx = range.first; chunk_idx != range.second; ++chunk_idx)
+                callback(chunk_idx, update);
+        }
+    }
+
+    void read_chunks(ustore_database_t const c_db,
+                     ustore_transaction_t const c_transaction,
+                     strided_range_gt<updated_entry_t> entries,
+                     ustore_options_t const c_options,
+                     linked_memory_lock_t& arena,
+                     ustore_error_t* c_error) {
+
+        std::vector<collection_key_t> keys;
+        std::vector<std::pair<std::size_t, std::size_t>> targets;
+        for (std::size_t node_idx = 0; node_idx != supernodes_.size(); ++node_idx) {
+            supernode_t& node = supernodes_[node_idx];
+            for (std::size_t chunk_idx = 0; chunk_idx != node.refs.size(); ++chunk_idx)
+                if (node.dirty[chunk_idx] && node.refs[chunk_idx].key != unassigned_key_k)
+                    keys.push_back({entries[node.entry_idx].collection, node.refs[chunk_idx].key}),
+                        targets.emplace_back(node_idx, chunk_idx);
+        }
+        if (keys.empty())
+            return;
+
+        ustore_bytes_ptr_t found_values = nullptr;
+        ustore_length_t* found_offsets = nullptr;
+        ustore_read_t read {};
+        read.db = c_db;
+        read.error = c_error;
+        read.transaction = c_transaction;
+        read.arena = arena;
+        read.options = c_options;
+        read.tasks_count = keys.size();
+        read.collections = &keys.front().collection;
+        read.collections_stride = sizeof(collection_key_t);
+        read.keys = &keys.front().key;
+        read.keys_stride = sizeof(collection_key_t);
+        read.offsets = &found_offsets;
+        read.values = &found_values;
+
+        ustore_read(&read);
+        return_if_error_m(c_error);
+
+        joined_blobs_t found_chunks {keys.size(), found_offsets, found_values};
+        joined_blobs_iterator_t found_chunks_it = found_chunks.begin();
+        for (auto [node_idx, chunk_idx] : targets) {
+            value_view_t chunk = decompress(*found_chunks_it, arena, c_error);
+            return_if_error_m(c_error);
+            ++found_chunks_it;
+            auto ships = neighbors(chunk, ustore_vertex_source_k);
+            supernodes_[node_idx].contents[chunk_idx].assign(ships.begin(), ships.end());
+        }
+    }
+
+    /**
+     * @brief Assigns keys to the new chunks, making sure they aren't used by anyone else.
+     */
+    void assign_keys(ustore_database_t const c_db,
+                     ustore_transaction_t const c_transaction,
+                     strided_range_gt<updated_entry_t> entries,
+                     ustore_options_t const c_options,
+                     linked_memory_lock_t& arena,
+                     ustore_error_t* c_error) {
+
+        std::vector<std::pair<std::size_t, std::size_t>> unassigned;
+        for (std::size_t node_idx = 0; node_idx != supernodes_.size(); ++node_idx)
+            for (std::size_t chunk_idx = 0; chunk_idx != supernodes_[node_idx].refs.size(); ++chunk_idx)
+                if (supernodes_[node_idx].refs[chunk_idx].key == unassigned_key_k)
+                    unassigned.emplace_back(node_idx, chunk_idx);
+
+        std::vector<collection_key_t> candidates;
+        while (!unassigned.empty()) {
+            candidates.clear();
+            for (auto [node_idx, chunk_idx] : unassigned) {
+                supernode_t& node = supernodes_[node_idx];
+                updated_entry_t const& entry = entries[node.entry_idx];
+                node.refs[chunk_idx].key = chunk_key(entry.key, node.head.next_chunk++);
+                candidates.push_back({entry.collection, node.refs[chunk_idx].key});
+            }
+
+            ustore_octet_t* found_presences = nullptr;
+            ustore_read_t read {};
+            read.db = c_db;
+            read.error = c_error;
+            read.transaction = c_transaction;
+            read.arena = arena;
+            read.options = c_options;
+            read.tasks_count = candidates.size();
+            read.collections = &candidates.front().collection;
+            read.collections_stride = sizeof(collection_key_t);
+            read.keys = &candidates.front().key;
+            read.keys_stride = sizeof(collection_key_t);
+            read.presences = &found_presences;
+
+            ustore_read(&read);
+            return_if_error_m(c_error);
+
+            // Retry the keys, that are taken, or were derived twice in this batch
+            std::vector<collection_key_t> sorted = candidates;
+            std::sort(sorted.begin(), sorted.end());
+            bits_view_t presences {found_presences};
+            std::size_t retried = 0;
+            for (std::size_t i = 0; i != unassigned.size(); ++i) {
+                auto repeats = std::equal_range(sorted.begin(), sorted.end(), candidates[i]);
+                if (presences[i] || repeats.second - repeats.first > 1)
+                    unassigned[retried++] = unassigned[i];
+            }
+            unassigned.resize(retried);
+        }
+    }
+
+    /**
+     * @brief Splits the overgrown chunks, drops the empty ones and recomputes the directory.
+     */
+    void rebalance(supernode_t& node, std::vector<updated_entry_t>& removed, ustore_collection_t collection) {
+        std::vector<chunk_ref_t> refs;
+        std::vector<std::vector<neighborship_t>> contents;
+        std::vector<bool> dirty;
+        for (std::size_t chunk_idx = 0; chunk_idx != node.refs.size(); ++chunk_idx) {
+            chunk_ref_t ref = node.refs[chunk_idx];
+            std::vector<neighborship_t>& ships = node.contents[chunk_idx];
+            if (!node.dirty[chunk_idx]) {
+                refs.push_back(ref), contents.emplace_back(), dirty.push_back(false);
+                continue;
+            }
+            if (ships.empty()) {
+                if (ref.key != unassigned_key_k)
+                    removed.push_back(updated_entry_t {{collection, ref.key}});
+                continue;
+            }
+
+            bool overgrown = ships.size() > chunked_degrees_min_k;
+            std::size_t pieces = overgrown ? divide_round_up(ships.size(), neighbors_chunk_k) : 1;
+            for (std::size_t piece = 0; piece != pieces; ++piece) {
+                std::size_t begin = ships.size() * piece / pieces;
+                std::size_t end = ships.size() * (piece + 1) / pieces;
+                chunk_ref_t piece_ref {ships[begin], piece ? unassigned_key_k : ref.key, ref.role, 0};
+                piece_ref.count = static_cast<std::uint32_t>(end - begin);
+                refs.push_back(piece_ref);
+                contents.emplace_back(ships.begin() + begin, ships.begin() + end);
+                dirty.push_back(true);
+            }
+        }
+        node.refs = std::move(refs);
+        node.contents = std::move(contents);
+        node.dirty = std::move(dirty);
+    }
+
+  public:
+    std::vector<updated_entry_t> writes;
+
+    void defer(std::size_t entry_idx, ustore_vertex_role_t role, neighborship_t ship, bool erase, bool any_edge) {
+        updates_.push_back({entry_idx, role, ship, erase, any_edge});
+    }
+
+    /**
+     * @brief Removes all the chunks of a vertex, that is being deleted.
+     */
+    void drop(updated_entry_t const& entry) {
+        if (!is_chunked_neighborhood(entry))
+            return;
+        chunked_neighborhood_t chunked {entry};
+        for (std::size_t chunk_idx = 0; chunk_idx != chunked.chunks(); ++chunk_idx)
+            writes.push_back(updated_entry_t {{entry.collection, chunked.chunk(chunk_idx).key}});
+    }
+
+    /**
+     * @brief Schedules a plain neighborhood, that has outgrown `chunked_degrees_min_k`, to be split.
+     */
+    void split(std::size_t entry_idx, updated_entry_t const& entry) {
+        supernode_t node;
+        node.entry_idx = entry_idx;
+        node.changed = true;
+        for (auto half : {ustore_vertex_source_k, ustore_vertex_target_k}) {
+            auto ships = neighbors(entry, half);
+            for (std::size_t begin = 0; begin < ships.size(); begin += neighbors_chunk_k) {
+                std::size_t end = std::min(begin + neighbors_chunk_k, ships.size());
+                node.refs.push_back({ships[begin], unassigned_key_k, std::uint32_t(half), 0});
+                node.contents.emplace_back(ships.begin() + begin, ships.begin() + end);
+                node.dirty.push_back(true);
+            }
+        }
+        supernodes_.push_back(std::move(node));
+    }
+
+    /**
+     * @brief Applies the deferred updates and the splits, replacing the contents of the
+     * affected @p entries with new directories, and appending the chunks to `writes`.
+     */
+    void update(ustore_database_t const c_db,
+                ustore_transaction_t const c_transaction,
+                strided_range_gt<updated_entry_t> entries,
+                ustore_options_t const c_options,
+                linked_memory_lock_t& arena,
+                ustore_error_t* c_error) {
+
+        auto opts = c_transaction ? ustore_options_t(c_options & ~ustore_option_transaction_dont_watch_k) : c_options;
+        opts = ustore_options_t(opts & ~ustore_option_write_bulk_k);
+
+        // Open the directories, scheduling the pending relations ahead of the new updates
+        std::stable_sort(updates_.begin(), updates_.end(), [](chunk_update_t const& a, chunk_update_t const& b) {
+            return a.entry_idx < b.entry_idx;
+        });
+        std::vector<chunk_update_t> ordered;
+        for (std::size_t begin = 0, end = 0; begin != updates_.size(); begin = end) {
+            std::size_t entry_idx = updates_[begin].entry_idx;
+            while (end != updates_.size() && updates_[end].entry_idx == entry_idx)
+                ++end;
+            updated_entry_t const& entry = entries[entry_idx];
+            if (!is_chunked_neighborhood(entry))
+                continue;
+
+            chunked_neighborhood_t chunked {entry};
+            supernode_t node;
+            node.entry_idx = entry_idx;
+            node.head = chunked.head();
+            for (std::size_t chunk_idx = 0; chunk_idx != chunked.chunks(); ++chunk_idx)
+                node.refs.push_back(chunked.chunk(chunk_idx));
+            node.contents.resize(node.refs.size());
+            node.dirty.resize(node.refs.size());
+            node.updates_begin = ordered.size();
+            for (auto half : {ustore_vertex_source_k, ustore_vertex_target_k})
+                for (neighborship_t ship : neighbors(chunked.pending(), half))
+                    ordered.push_back({entry_idx, half, ship, false, false});
+            node.changed = ordered.size() != node.updates_begin;
+            ordered.insert(ordered.end(), updates_.begin() + begin, updates_.begin() + end);
+            node.updates_end = ordered.size();
+            supernodes_.push_back(std::move(node));
+        }
+        updates_ = std::move(ordered);
+
+        // Only read the chunks, that some update falls into
+        for (supernode_t& node : supernodes_)
+            for_each_update(node, [&](std::size_t chunk_idx, chunk_update_t const&) { node.dirty[chunk_idx] = true; });
+        read_chunks(c_db, c_transaction, entries, opts, arena, c_error);
+        return_if_error_m(c_error);
+        for (supernode_t& node : supernodes_)
+            for_each_update(node, [&](std::size_t chunk_idx, chunk_update_t const& update) {
+                node.changed |= apply(node, chunk_idx, update);
+            });
+
+        std::vector<updated_entry_t> removed;
+        for (supernode_t& node : supernodes_)
+            if (node.changed)
+                rebalance(node, removed, entries[node.entry_idx].collection);
+        assign_keys(c_db, c_transaction, entries, opts, arena, c_error);
+        return_if_error_m(c_error);
+        writes.insert(writes.end(), removed.begin(), removed.end());
+
+        // Export the changed chunks and directories
+        for (supernode_t& node : supernodes_) {
+            if (!node.changed)
+                continue;
+            updated_entry_t& entry = entries[node.entry_idx];
+            for (std::size_t chunk_idx = 0; chunk_idx != node.refs.size(); ++chunk_idx) {
+                if (!node.dirty[chunk_idx])
+                    continue;
+                std::vector<neighborship_t> const& ships = node.contents[chunk_idx];
+                std::size_t length = bytes_in_degrees_header_k + ships.size() * sizeof(neighborship_t);
+                auto chunk = arena.alloc<byte_t>(length, c_error);
+                return_if_error_m(c_error);
+                ustore_vertex_degree_t degrees[2] = {static_cast<ustore_vertex_degree_t>(ships.size()), 0};
+                std::memcpy(chunk.begin(), degrees, sizeof(degrees));
+                std::memcpy(chunk.begin() + sizeof(degrees), ships.data(), ships.size() * sizeof(neighborship_t));
+
+                updated_entry_t chunk_entry {{entry.collection, node.refs[chunk_idx].key}};
+                chunk_entry.content = reinterpret_cast<ustore_bytes_ptr_t>(chunk.begin());
+                chunk_entry.length = static_cast<ustore_length_t>(length);
+                writes.push_back(chunk_entry);
+            }
+
+            // Entirely emptied supernodes become plain again
+            node.head.chunks = static_cast<std::uint32_t>(node.refs.size());
+            std::size_t length = node.refs.empty() ? bytes_in_degrees_header_k //
+                                                   : chunked_neighborhood_t::length(node.refs.size(), 0);
+            auto head = arena.alloc<byte_t>(length, c_error);
+            return_if_error_m(c_error);
+            if (node.refs.empty())
+                std::memset(head.begin(), 0, length);
+            else
+                chunked_neighborhood_t::write(node.head, node.refs.data(), {}, head.begin());
+            entry.content = reinterpret_cast<ustore_bytes_ptr_t>(head.begin());
+            entry.length = static_cast<ustore_length_t>(length);
+            entry.degree_delta = std::max<ustore_vertex_degree_t>(entry.degree_delta, 1);
+        }
+    }
+};
+
+/**
+ * @brief Combines the updated vertices with the chunks, that must be written with them.
+ */
+strided_range_gt<updated_entry_t> append_chunks(ptr_range_gt<updated_entry_t> entries,
+                                                std::vector<updated_entry_t> const& chunks,
+                                                linked_memory_lock_t& arena,
+                                                ustore_error_t* c_error) noexcept {
+    if (chunks.empty())
+        return entries.strided();
+    auto combined = arena.alloc<updated_entry_t>(entries.size() + chunks.size(), c_error);
+    if (*c_error)
+        return {};
+    std::copy(entries.begin(), entries.end(), combined.begin());
+    std::copy(chunks.begin(), chunks.end(), combined.begin() + entries.size());
+    return combined.strided();
+}
+
+/**
+ * @brief Parses the degree of a neighborhood of any kind, without unpacking it.
+ * The pending relations of chunked neighborhoods must be folded in beforehand.
+ */
+ustore_vertex_degree_t degree_of(value_view_t value, ustore_vertex_role_t role) {
+    if (is_compressed_neighborhood(value))
+        return compressed_neighborhood_t {value}.degree(role);
+    if (is_chunked_neighborhood(value))
+        return static_cast<ustore_vertex_degree_t>(chunked_neighborhood_t {value}.degree(role));
+    return static_cast<ustore_vertex_degree_t>(neighbors(value, role).size());
+}
+
+/**
+ * @brief Counts the outgoing relations of a plain or compressed neighborhood,
+ * matching the @p needle, which is either a neighbor ID or an exact `neighborship_t`.
+ */
+template <typename needle_at>
+std::size_t count_relations(value_view_t value, needle_at needle) {
+    if (is_compressed_neighborhood(value))
+        return compressed_neighborhood_t {value}.count(ustore_vertex_source_k, needle);
+    auto ships = neighbors(value, ustore_vertex_source_k);
+    auto range = std::equal_range(ships.begin(), ships.end(), needle);
+    return static_cast<std::size_t>(range.second - range.first);
+}
+
+/**
+ * @brief Enumerates the outgoing chunks of a supernode, which may hold relations with @p neighbor_id:
+ * the last one starting before it, and all the ones starting with it.
+ */
+template <typename callback_at>
+void for_each_chunk_with(chunked_neighborhood_t const& chunked, ustore_key_t neighbor_id, callback_at&& callback) {
+    std::size_t last_before = chunked.chunks();
+    std::size_t first_after = chunked.chunks();
+    for (std::size_t chunk_idx = 0; chunk_idx != chunked.chunks() && first_after == chunked.chunks(); ++chunk_idx) {
+        chunk_ref_t ref = chunked.chunk(chunk_idx);
+        if (ref.role != ustore_vertex_source_k)
+            continue;
+        if (ref.first.neighbor_id < neighbor_id)
+            last_before = chunk_idx;
+        else if (ref.first.neighbor_id > neighbor_id)
+            first_after = chunk_idx;
+    }
+    std::size_t chunk_idx = last_before != chunked.chunks() ? last_before : 0;
+    for (; chunk_idx != first_after; ++chunk_idx)
+        if (chunk_ref_t ref = chunked.chunk(chunk_idx); ref.role == ustore_vertex_source_k)
+            callback(ref);
+}
+
 template <bool export_center_ak = true, bool export_neighbor_ak = true, bool export_edge_ak = true>
 void export_edge_tuples( //
     ustore_database_t const c_db,
@@ -323,6 +960,8 @@ void export_edge_tuples( //
 
     ustore_vertex_degree_t** c_degrees_per_vertex,
     ustore_key_t** c_neighborships_per_vertex,
+    std::int64_t** c_timestamps_per_edge,
+    ustore_float_t** c_weights_per_edge,
 
     linked_memory_lock_t& arena,
     ustore_error_t* c_error) {
@@ -357,14 +996,35 @@ void export_edge_tuples( //
 
     find_edges_t find_edges {collections, vertices.begin(), roles, c_vertices_count};
 
-    // Estimate the amount of memory we will need for the arena
+    // Unpack the compressed neighborhoods and gather the chunked ones,
+    // estimating the amount of memory we will need for the arena on the way
+    auto plain_values = arena.alloc<value_view_t>(c_vertices_count, c_error);
+    return_if_error_m(c_error);
+    joined_blobs_iterator_t found_it = values.begin();
+    for (ustore_size_t i = 0; i != c_vertices_count; ++i, ++found_it) {
+        plain_values[i] = *found_it;
+        if constexpr (tuple_size_k != 0) {
+            plain_values[i] = decompress(*found_it, arena, c_error);
+            return_if_error_m(c_error);
+        }
+    }
+    gather_chunks(
+        c_db,
+        c_transaction,
+        c_snapshot,
+        plain_values,
+        [&](std::size_t i) { return find_edges[i].collection; },
+        [&](std::size_t i) { return find_edges[i].role; },
+        tuple_size_k == 0,
+        c_options,
+        arena,
+        c_error);
+    return_if_error_m(c_error);
+
     std::size_t count_ids = 0;
     if constexpr (tuple_size_k != 0) {
-        joined_blobs_iterator_t values_it = values.begin();
-        for (ustore_size_t i = 0; i != c_vertices_count; ++i, ++values_it) {
-            value_view_t value = *values_it;
-            count_ids += neighbors(value, find_edges[i].role).size();
-        }
+        for (ustore_size_t i = 0; i != c_vertices_count; ++i)
+            count_ids += neighbors(plain_values[i], find_edges[i].role).size();
         count_ids *= tuple_size_k;
     }
 
@@ -373,11 +1033,29 @@ void export_edge_tuples( //
     return_if_error_m(c_error);
     auto degrees = arena.alloc_or_dummy(c_vertices_count, c_error, c_degrees_per_vertex);
     return_if_error_m(c_error);
+    std::size_t count_edges = tuple_size_k ? count_ids / tuple_size_k : 0;
+    auto timestamps = arena.alloc_or_dummy(count_edges, c_error, c_timestamps_per_edge);
+    return_if_error_m(c_error);
+    auto weights = arena.alloc_or_dummy(count_edges, c_error, c_weights_per_edge);
+    return_if_error_m(c_error);
+    bool export_attributes = c_timestamps_per_edge || c_weights_per_edge;
 
     std::size_t passed_ids = 0;
-    joined_blobs_iterator_t values_it = values.begin();
-    for (std::size_t i = 0; i != c_vertices_count; ++i, ++values_it) {
-        value_view_t value = *values_it;
+    std::size_t passed_edges = 0;
+    auto export_attributes_of = [&](value_view_t value, ptr_range_gt<neighborship_t const> ships) {
+        if (!export_attributes)
+            return;
+        attributed_neighborhood_t attributed {value};
+        std::size_t first_idx = static_cast<std::size_t>(ships.begin() - neighbors(value).begin());
+        for (std::size_t j = 0; j != ships.size(); ++j, ++passed_edges) {
+            edge_attributes_t attributes = attributed[first_idx + j];
+            timestamps[passed_edges] = attributes.timestamp;
+            weights[passed_edges] = attributes.weight;
+        }
+    };
+
+    for (std::size_t i = 0; i != c_vertices_count; ++i) {
+        value_view_t value = plain_values[i];
         find_edge_t find_edge = find_edges[i];
 
         // Some values may be missing
@@ -386,6 +1064,12 @@ void export_edge_tuples( //
             continue;
         }
 
+        // The degrees of compressed and chunked neighborhoods are readable without unpacking
+        if constexpr (tuple_size_k == 0) {
+            degrees[i] = degree_of(value, find_edge.role);
+            continue;
+        }
+
         ustore_vertex_degree_t degree = 0;
         if (find_edge.role & ustore_vertex_source_k) {
             auto ns = neighbors(value, ustore_vertex_source_k);
@@ -399,6 +1083,7 @@ void export_edge_tuples( //
                         ids[passed_ids + export_center_ak + export_neighbor_ak] = n.edge_id;
                     passed_ids += tuple_size_k;
                 }
+            export_attributes_of(value, ns);
             degree += static_cast<ustore_vertex_degree_t>(ns.size());
         }
         if (find_edge.role & ustore_vertex_target_k) {
@@ -413,6 +1098,7 @@ void export_edge_tuples( //
                         ids[passed_ids + export_center_ak + export_neighbor_ak] = n.edge_id;
                     passed_ids += tuple_size_k;
                 }
+            export_attributes_of(value, ns);
             degree += static_cast<ustore_vertex_degree_t>(ns.size());
         }
         degrees[i] = degree;
@@ -434,6 +1120,7 @@ void pull_and_link_for_updates( //
     auto collections = unique_entries.immutable().members(&updated_entry_t::collection);
     auto keys = unique_entries.immutable().members(&updated_entry_t::key);
     auto opts = c_transaction ? ustore_options_t(c_options & ~ustore_option_transaction_dont_watch_k) : c_options;
+    opts = ustore_options_t(opts & ~ustore_option_write_bulk_k);
     ustore_read_t read {};
     read.db = c_db;
     read.error = c_error;
@@ -454,111 +1141,400 @@ void pull_and_link_for_updates( //
     // Link the response buffer to `unique_entries`
     joined_blobs_t found_binaries {unique_count, found_binary_offs, found_binary_begin};
     for (std::size_t i = 0; i != unique_count; ++i) {
-        auto found_binary = found_binaries[i];
+        value_view_t found_binary = decompress(found_binaries[i], arena, c_error);
+        return_if_error_m(c_error);
+
+        // The relations are patched in place, so we keep the original to look up the old attributes
+        if (is_attributed_neighborhood(found_binary)) {
+            auto plain = arena.alloc<byte_t>(plain_neighborhood_length(plain_relations(found_binary)), c_error);
+            return_if_error_m(c_error);
+            std::memcpy(plain.begin(), found_binary.data(), plain.size());
+            unique_entries[i].attributed = found_binary;
+            found_binary = {plain.begin(), plain.size()};
+        }
         unique_entries[i].content = ustore_bytes_ptr_t(found_binary.data());
         unique_entries[i].length =
             found_binary ? static_cast<ustore_length_t>(found_binary.size()) : ustore_length_missing_k;
     }
 }
 
-template <bool erase_ak>
-void update_neighborhoods( //
-    ustore_database_t const c_db,
-    ustore_transaction_t const c_transaction,
+/**
+ * @brief Attributes, assigned to a relation of a vertex by an upsert.
+ * Missing columns keep the attributes the relation had before.
+ */
+struct attributed_relation_t {
+    collection_key_t vertex;
+    ustore_vertex_role_t role = ustore_vertex_role_unknown_k;
+    neighborship_t ship;
+    std::int64_t const* timestamp = nullptr;
+    ustore_float_t const* weight = nullptr;
+};
+
+inline bool operator<(attributed_relation_t const& a, attributed_relation_t const& b) noexcept {
+    if (a.vertex != b.vertex)
+        return a.vertex < b.vertex;
+    return a.role != b.role ? a.role < b.role : a.ship < b.ship;
+}
+
+/**
+ * @brief Collects the attributes of upserted edges for both of their ends, sorting them
+ * by vertex and relation. Repeated relations keep their order, so the last ones win.
+ */
+ptr_range_gt<attributed_relation_t const> sort_attributes( //
     ustore_size_t const c_tasks_count,
+    strided_iterator_gt<ustore_collection_t const> edge_collections,
+    strided_iterator_gt<ustore_key_t const> edges_ids,
+    strided_iterator_gt<ustore_key_t const> sources_ids,
+    strided_iterator_gt<ustore_key_t const> targets_ids,
+    strided_iterator_gt<std::int64_t const> timestamps,
+    strided_iterator_gt<ustore_float_t const> weights,
+    linked_memory_lock_t& arena,
+    ustore_error_t* c_error) {
 
-    ustore_collection_t const* c_collections,
-    ustore_size_t const c_collections_stride,
+    if (!timestamps && !weights)
+        return {};
+    auto relations = arena.alloc<attributed_relation_t>(c_tasks_count * 2, c_error);
+    if (*c_error)
+        return {};
+    for (std::size_t i = 0; i != c_tasks_count; ++i) {
+        auto collection = edge_collections[i];
+        auto edge_id = edges_ids ? edges_ids[i] : ustore_key_unknown_k;
+        auto timestamp = timestamps ? &timestamps[i] : nullptr;
+        auto weight = weights ? &weights[i] : nullptr;
+        relations[i * 2] = {{collection, sources_ids[i]}, ustore_vertex_source_k, {targets_ids[i], edge_id}};
+        relations[i * 2 + 1] = {{collection, targets_ids[i]}, ustore_vertex_target_k, {sources_ids[i], edge_id}};
+        relations[i * 2].timestamp = relations[i * 2 + 1].timestamp = timestamp;
+        relations[i * 2].weight = relations[i * 2 + 1].weight = weight;
+    }
+    safe_section("Sorting attributes", c_error, [&] { std::stable_sort(relations.begin(), relations.end()); });
+    if (*c_error)
+        return {};
+    return {relations.begin(), relations.end()};
+}
 
-    ustore_key_t const* c_edges_ids,
-    ustore_size_t const c_edges_stride,
+/**
+ * @brief Fills the attribute columns of an updated @p plain neighborhood into the @p output, sized by
+ * `attributed_neighborhood_length()`. The relations, that were already present in the @p old value,
+ * keep their attributes, unless the sorted @p overrides of the vertex replace them.
+ */
+void attach_attributes(value_view_t plain,
+                       value_view_t old,
+                       ptr_range_gt<attributed_relation_t const> overrides,
+                       byte_t* output) noexcept {
+
+    std::size_t relations = plain_relations(plain);
+    std::memcpy(output, plain.data(), plain_neighborhood_length(relations));
+    attributed_neighborhood_t old_attributes {old};
+    auto ships = neighbors(plain);
+    auto outgoing = neighbors(plain, ustore_vertex_source_k).size();
+    auto by_relation = [](attributed_relation_t const& a, attributed_relation_t const& b) {
+        return a.role != b.role ? a.role < b.role : a.ship < b.ship;
+    };
+    attributed_neighborhood_t::write_columns(
+        relations,
+        [&](std::size_t relation_idx) {
+            auto role = relation_idx < outgoing ? ustore_vertex_source_k : ustore_vertex_target_k;
+            neighborship_t ship = ships[relation_idx];
+            edge_attributes_t result;
+            if (old_attributes) {
+                auto old_ships = neighbors(old, role);
+                auto it = std::lower_bound(old_ships.begin(), old_ships.end(), ship);
+                if (it != old_ships.end() && *it == ship)
+                    result = old_attributes[it - neighbors(old).begin()];
+            }
+            attributed_relation_t needle;
+            needle.role = role;
+            needle.ship = ship;
+            auto matches = std::equal_range(overrides.begin(), overrides.end(), needle, by_relation);
+            for (auto match = matches.first; match != matches.second; ++match) {
+                if (match->timestamp)
+                    result.timestamp = *match->timestamp;
+                if (match->weight)
+                    result.weight = *match->weight;
+            }
+            return result;
+        },
+        output);
+}
 
-    ustore_key_t const* c_sources_ids,
-    ustore_size_t const c_sources_stride,
+/**
+ * @brief Attaches the attribute columns to the updated @p entries, that either had them before,
+ * or are targeted by the sorted @p overrides. Chunked neighborhoods of supernodes drop them.
+ */
+void attach_attributes(ptr_range_gt<updated_entry_t> entries,
+                       ptr_range_gt<attributed_relation_t const> overrides,
+                       linked_memory_lock_t& arena,
+                       ustore_error_t* c_error) noexcept {
 
-    ustore_key_t const* c_targets_ids,
-    ustore_size_t const c_targets_stride,
+    for (updated_entry_t& entry : entries) {
+        if (entry.length == ustore_length_missing_k || entry.length < bytes_in_degrees_header_k)
+            continue;
+        if (is_chunked_neighborhood(entry))
+            continue;
+        attributed_relation_t needle;
+        needle.vertex = entry;
+        auto matches = std::equal_range(overrides.begin(), overrides.end(), needle, [](auto const& a, auto const& b) {
+            return a.vertex < b.vertex;
+        });
+        ptr_range_gt<attributed_relation_t const> vertex_overrides {matches.first, matches.second};
+        std::size_t relations = plain_relations(entry);
+        if ((!entry.attributed && vertex_overrides.empty()) || !relations)
+            continue;
 
-    ustore_options_t const c_options,
+        auto buffer = arena.alloc<byte_t>(attributed_neighborhood_length(relations), c_error);
+        return_if_error_m(c_error);
+        attach_attributes(entry, entry.attributed, vertex_overrides, buffer.begin());
+        entry.content = reinterpret_cast<ustore_bytes_ptr_t>(buffer.begin());
+        entry.length = static_cast<ustore_length_t>(buffer.size());
+        entry.attributes_changed |= !vertex_overrides.empty();
+    }
+}
 
-    linked_memory_lock_t& arena,
-    ustore_error_t* c_error) {
+/**
+ * @brief A single edge insertion into a `merge_kind_t::neighborhood_k` operand.
+ * Operands are just arrays of those, following the header byte.
+ */
+struct neighborship_insert_t {
+    neighborship_t ship;
+    ustore_vertex_role_t role = ustore_vertex_role_unknown_k;
+};
 
-    strided_iterator_gt<ustore_collection_t const> edge_collections {c_collections, c_collections_stride};
-    strided_iterator_gt<ustore_key_t const> edges_ids {c_edges_ids, c_edges_stride};
-    strided_iterator_gt<ustore_key_t const> sources_ids {c_sources_ids, c_sources_stride};
-    strided_iterator_gt<ustore_key_t const> targets_ids {c_targets_ids, c_targets_stride};
+struct merged_insert_t : public collection_key_t {
+    neighborship_insert_t insert;
+};
 
-    // Fetch all the data related to touched vertices, and deduplicate them
-    auto unique_entries = arena.alloc<updated_entry_t>(c_tasks_count * 2, c_error);
-    return_if_error_m(c_error);
-    std::fill(unique_entries.begin(), unique_entries.end(), updated_entry_t {});
-    for (ustore_size_t i = 0; i != c_tasks_count; ++i)
-        unique_entries[i].collection = edge_collections[i], unique_entries[i].key = sources_ids[i];
-    for (ustore_size_t i = 0; i != c_tasks_count; ++i)
-        unique_entries[c_tasks_count + i].collection = edge_collections[i],
-                                       unique_entries[c_tasks_count + i].key = targets_ids[i];
+bool unum::ustore::merge_neighborhood(value_view_t base, merge_operands_t operands, std::string& result) noexcept {
+    trace_span_m("graph.merge_neighborhood");
 
-    // Lets put all the unique IDs in the beginning of the range,
-    // and then refill the tail with replicas
-    auto unique_count = sort_and_deduplicate(unique_entries.begin(), unique_entries.end());
-    unique_entries = {unique_entries.begin(), unique_count};
+    std::size_t inserts_count = 0;
+    for (value_view_t operand : operands) {
+        auto body = merge_body(operand);
+        if (body.size() % sizeof(neighborship_insert_t))
+            return false;
+        inserts_count += body.size() / sizeof(neighborship_insert_t);
+    }
 
-    // Fetch the existing entries
-    auto unique_strided = unique_entries.strided();
-    pull_and_link_for_updates(c_db, c_transaction, unique_strided, c_options, arena, c_error);
-    return_if_error_m(c_error);
+    // Chunks can't be updated from within a merge, so supernodes collect the relations in their
+    // directories, until the next read-modify-write folds them into chunks
+    value_view_t directory;
+    if (is_chunked_neighborhood(base)) {
+        directory = base;
+        base = chunked_neighborhood_t {directory}.pending();
+    }
 
-    // Define our primary for-loop
-    auto for_each_task = [&](auto entry_role_target_edge_callback) {
-        for (std::size_t i = 0; i != c_tasks_count; ++i) {
-            auto collection = edge_collections[i];
-            auto source_id = sources_ids[i];
-            auto target_id = targets_ids[i];
-            auto edge_id = edges_ids ? edges_ids[i] : ustore_key_unknown_k;
-            auto source_idx = offset_in_sorted(unique_entries, collection_key_t {collection, source_id});
-            auto target_idx = offset_in_sorted(unique_entries, collection_key_t {collection, target_id});
-            entry_role_target_edge_callback(unique_entries[source_idx], ustore_vertex_source_k, target_id, edge_id);
-            entry_role_target_edge_callback(unique_entries[target_idx], ustore_vertex_target_k, source_id, edge_id);
+    // Compressed neighborhoods are unpacked, patched and compressed again
+    std::string plain;
+    if (is_compressed_neighborhood(base)) {
+        compressed_neighborhood_t compressed {base};
+        try {
+            plain.resize(compressed.plain_length());
         }
-    };
+        catch (...) {
+            return false;
+        }
+        compressed.decode(reinterpret_cast<byte_t*>(plain.data()));
+        base = value_view_t {plain};
+    }
 
-    if constexpr (erase_ak)
-        for_each_task(&erase_from_entry);
-    else {
-        // Unlike erasing, which can reuse the memory, her we need three passes:
-        // 1. estimating final size
-        for_each_task(&count_inserts_into_entry);
-        // 2. reallocating into bigger buffers
-        for (std::size_t i = 0; i != unique_count; ++i) {
-            auto& unique_entry = unique_entries[i];
-            auto bytes_present = unique_entry.length != ustore_length_missing_k ? unique_entry.length : 0;
-            auto bytes_for_relations = unique_entry.degree_delta * sizeof(neighborship_t);
-            auto bytes_for_degrees = bytes_present > bytes_in_degrees_header_k ? 0 : bytes_in_degrees_header_k;
-            auto new_size = bytes_present + bytes_for_relations + bytes_for_degrees;
-            auto new_buffer = arena.alloc<byte_t>(new_size, c_error);
-            return_if_error_m(c_error);
-            std::memcpy(new_buffer.begin(), unique_entry.content, bytes_present);
+    // Attributed neighborhoods are patched without their columns, that are attached back afterwards
+    value_view_t attributed;
+    if (is_attributed_neighborhood(base)) {
+        attributed = base;
+        base = {base.data(), plain_neighborhood_length(plain_relations(base))};
+    }
 
-            unique_entry.content = (ustore_bytes_ptr_t)new_buffer.begin();
-            // No need to grow `length` here, we will update in `insert_into_entry` later
-            unique_entry.length = bytes_present;
+    // Every insertion can grow the entry by at most one relation
+    auto bytes_present = base.size();
+    auto bytes_limit = bytes_present + bytes_in_degrees_header_k + inserts_count * sizeof(neighborship_t);
+    try {
+        result.resize(bytes_limit);
+    }
+    catch (...) {
+        return false;
+    }
+    std::memcpy(result.data(), base.data(), bytes_present);
+
+    updated_entry_t entry;
+    entry.content = reinterpret_cast<ustore_bytes_ptr_t>(result.data());
+    entry.length = static_cast<ustore_length_t>(bytes_present);
+    for (value_view_t operand : operands) {
+        auto body = merge_body(operand);
+        for (std::size_t offset = 0; offset != body.size(); offset += sizeof(neighborship_insert_t)) {
+            neighborship_insert_t insert;
+            std::memcpy(reinterpret_cast<byte_t*>(&insert), body.data() + offset, sizeof(neighborship_insert_t));
+            insert_into_entry(entry, insert.role, insert.ship.neighbor_id, insert.ship.edge_id);
         }
-        // 3. performing insertions
-        for_each_task(&insert_into_entry);
     }
+    result.resize(entry.length);
+
+    if (attributed) {
+        try {
+            plain.resize(attributed_neighborhood_length(plain_relations(value_view_t {result})));
+        }
+        catch (...) {
+            return false;
+        }
+        attach_attributes(value_view_t {result}, attributed, {}, reinterpret_cast<byte_t*>(plain.data()));
+        std::swap(plain, result);
+        return true;
+    }
+
+    if (directory) {
+        chunked_neighborhood_t chunked {directory};
+        try {
+            plain.resize(chunked_neighborhood_t::length(chunked.chunks(), result.size()));
+        }
+        catch (...) {
+            return false;
+        }
+        std::memcpy(plain.data(), directory.data(), plain.size() - result.size());
+        std::memcpy(plain.data() + plain.size() - result.size(), result.data(), result.size());
+        std::swap(plain, result);
+        return true;
+    }
+
+    auto degrees = reinterpret_cast<ustore_vertex_degree_t const*>(result.data());
+    std::size_t relations = result.size() < bytes_in_degrees_header_k ? 0 : degrees[0] + degrees[1];
+    if (relations < compressed_degrees_min_k)
+        return true;
+    try {
+        plain.resize(compressed_neighborhood_limit(relations));
+    }
+    catch (...) {
+        return false;
+    }
+    auto ships = reinterpret_cast<neighborship_t const*>(degrees + 2);
+    auto length = compress_neighborhood(degrees, ships, reinterpret_cast<byte_t*>(plain.data()));
+    if (length < result.size()) {
+        plain.resize(length);
+        std::swap(plain, result);
+    }
+    return true;
+}
+
+/**
+ * @brief Implements edge upserts on engines, that support `ustore_option_write_merge_k`.
+ * Instead of pulling both neighborhoods of every edge, we append a merge operand
+ * per touched vertex, and let the engine apply the insertions later.
+ */
+void merge_into_neighborhoods( //
+    ustore_database_t const c_db,
+    ustore_size_t const c_tasks_count,
+    strided_iterator_gt<ustore_collection_t const> edge_collections,
+    strided_iterator_gt<ustore_key_t const> edges_ids,
+    strided_iterator_gt<ustore_key_t const> sources_ids,
+    strided_iterator_gt<ustore_key_t const> targets_ids,
+    ustore_options_t const c_options,
+    linked_memory_lock_t& arena,
+    ustore_error_t* c_error) {
+
+    trace_span_m("graph.merge_into_neighborhoods");
+    auto inserts = arena.alloc<merged_insert_t>(c_tasks_count * 2, c_error);
+    return_if_error_m(c_error);
+    for (ustore_size_t i = 0; i != c_tasks_count; ++i) {
+        auto collection = edge_collections[i];
+        auto edge_id = edges_ids ? edges_ids[i] : ustore_key_unknown_k;
+        inserts[i * 2] = {{collection, sources_ids[i]}, {{targets_ids[i], edge_id}, ustore_vertex_source_k}};
+        inserts[i * 2 + 1] = {{collection, targets_ids[i]}, {{sources_ids[i], edge_id}, ustore_vertex_target_k}};
+    }
+
+    // Group the insertions by vertex, to produce a single operand for each
+    std::sort(inserts.begin(), inserts.end(), [](merged_insert_t const& a, merged_insert_t const& b) {
+        return collection_key_t(a) < collection_key_t(b);
+    });
+    std::size_t unique_count = 0;
+    for (std::size_t i = 0; i != inserts.size(); ++i)
+        unique_count += i == 0 || collection_key_t(inserts[i]) != collection_key_t(inserts[i - 1]);
+
+    auto unique_keys = arena.alloc<collection_key_t>(unique_count, c_error);
+    return_if_error_m(c_error);
+    auto offsets = arena.alloc<ustore_length_t>(unique_count + 1, c_error);
+    return_if_error_m(c_error);
+    auto tape = arena.alloc<byte_t>(unique_count * bytes_in_merge_header_k +
+                                        inserts.size() * sizeof(neighborship_insert_t),
+                                    c_error);
+    return_if_error_m(c_error);
+
+    std::size_t unique_idx = 0;
+    std::size_t tape_offset = 0;
+    for (std::size_t i = 0; i != inserts.size(); ++i) {
+        if (i == 0 || collection_key_t(inserts[i]) != collection_key_t(inserts[i - 1])) {
+            unique_keys[unique_idx] = inserts[i];
+            offsets[unique_idx] = static_cast<ustore_length_t>(tape_offset);
+            tape[tape_offset] = static_cast<byte_t>(merge_kind_t::neighborhood_k);
+            tape_offset += bytes_in_merge_header_k;
+            ++unique_idx;
+        }
+        std::memcpy(tape.begin() + tape_offset, &inserts[i].insert, sizeof(neighborship_insert_t));
+        tape_offset += sizeof(neighborship_insert_t);
+    }
+    offsets[unique_count] = static_cast<ustore_length_t>(tape_offset);
+
+    auto unique_strided = unique_keys.strided().immutable();
+    auto collections = unique_strided.members(&collection_key_t::collection);
+    auto keys = unique_strided.members(&collection_key_t::key);
+    ustore_bytes_ptr_t tape_begin = reinterpret_cast<ustore_bytes_ptr_t>(tape.begin());
+
+    ustore_write_t write {};
+    write.db = c_db;
+    write.error = c_error;
+    write.arena = arena;
+    write.options = ustore_options_t(c_options | ustore_option_write_merge_k);
+    write.tasks_count = unique_count;
+    write.collections = collections.begin().get();
+    write.collections_stride = collections.begin().stride();
+    write.keys = keys.begin().get();
+    write.keys_stride = keys.begin().stride();
+    write.offsets = offsets.begin();
+    write.offsets_stride = sizeof(ustore_length_t);
+    write.values = &tape_begin;
+
+    ustore_write(&write);
+}
+
+/**
+ * @brief Splits the overgrown neighborhoods, applies the updates deferred for supernodes,
+ * attaches the edge @p attributes, and writes back all the changed entries along with the chunks in a single batch.
+ */
+void write_neighborhoods( //
+    ustore_database_t const c_db,
+    ustore_transaction_t const c_transaction,
+    ptr_range_gt<updated_entry_t> unique_entries,
+    chunks_updater_t& supernodes,
+    ptr_range_gt<attributed_relation_t const> attributes,
+    ustore_options_t const c_options,
+    linked_memory_lock_t& arena,
+    ustore_error_t* c_error) {
+
+    // Supernodes only rewrite the chunks they touch, and the overgrown neighborhoods are split
+    safe_section("Updating supernodes", c_error, [&] {
+        for (std::size_t i = 0; i != unique_entries.size(); ++i)
+            if (!is_chunked_neighborhood(unique_entries[i]))
+                if (neighbors(unique_entries[i]).size() > chunked_degrees_min_k)
+                    supernodes.split(i, unique_entries[i]);
+        supernodes.update(c_db, c_transaction, unique_entries.strided(), c_options, arena, c_error);
+    });
+    return_if_error_m(c_error);
+    attach_attributes(unique_entries, attributes, arena, c_error);
+    return_if_error_m(c_error);
 
     // Some of the requested updates may have been completely useless, like:
-    // > upserting an existing relation.
+    // > upserting an existing relation without attributes.
     // > removing a missing relation.
     // So we can further optimize by cancelling those writes.
-    std::partition(unique_entries.begin(), unique_entries.end(), std::mem_fn(&updated_entry_t::degree_delta));
+    std::partition(unique_entries.begin(), unique_entries.end(), [](updated_entry_t const& entry) {
+        return entry.degree_delta || entry.attributes_changed;
+    });
 
-    // Dump the data back to disk!
-    auto collections = unique_strided.immutable().members(&updated_entry_t::collection);
-    auto keys = unique_strided.immutable().members(&updated_entry_t::key);
-    auto contents = unique_strided.immutable().members(&updated_entry_t::content);
-    auto lengths = unique_strided.immutable().members(&updated_entry_t::length);
+    // Dump the data back to disk, along with the chunks!
+    auto written = append_chunks(unique_entries, supernodes.writes, arena, c_error);
+    return_if_error_m(c_error);
+    compress(written, arena, c_error);
+    return_if_error_m(c_error);
+    auto collections = written.immutable().members(&updated_entry_t::collection);
+    auto keys = written.immutable().members(&updated_entry_t::key);
+    auto contents = written.immutable().members(&updated_entry_t::content);
+    auto lengths = written.immutable().members(&updated_entry_t::length);
 
     ustore_write_t write {};
     write.db = c_db;
@@ -566,7 +1542,7 @@ void update_neighborhoods( //
     write.transaction = c_transaction;
     write.arena = arena;
     write.options = c_options;
-    write.tasks_count = unique_count;
+    write.tasks_count = written.size();
     write.collections = collections.begin().get();
     write.collections_stride = collections.begin().stride();
     write.keys = keys.begin().get();
@@ -579,7 +1555,307 @@ void update_neighborhoods( //
     ustore_write(&write);
 }
 
+/**
+ * @brief A relation of a vertex, sorted and grouped with others in bulk upserts.
+ */
+struct grouped_relation_t {
+    collection_key_t vertex;
+    ustore_vertex_role_t role = ustore_vertex_role_unknown_k;
+    neighborship_t ship;
+};
+
+/**
+ * @brief Implements `ustore_option_write_bulk_k` upserts, which are likely to be large imports.
+ * Instead of inserting edges one by one, they are radix-sorted and grouped by vertices,
+ * so that every neighborhood is rebuilt with a single linear merge and written back in one batch.
+ */
+void bulk_insert_into_neighborhoods( //
+    ustore_database_t const c_db,
+    ustore_transaction_t const c_transaction,
+    ustore_size_t const c_tasks_count,
+    strided_iterator_gt<ustore_collection_t const> edge_collections,
+    strided_iterator_gt<ustore_key_t const> edges_ids,
+    strided_iterator_gt<ustore_key_t const> sources_ids,
+    strided_iterator_gt<ustore_key_t const> targets_ids,
+    ptr_range_gt<attributed_relation_t const> attributes,
+    ustore_options_t const c_options,
+    linked_memory_lock_t& arena,
+    ustore_error_t* c_error) {
+
+    auto relations = arena.alloc<grouped_relation_t>(c_tasks_count * 2, c_error);
+    return_if_error_m(c_error);
+    auto relations_buffer = arena.alloc<grouped_relation_t>(c_tasks_count * 2, c_error);
+    return_if_error_m(c_error);
+    bool same_collection = true;
+    for (std::size_t i = 0; i != c_tasks_count; ++i) {
+        auto collection = edge_collections[i];
+        auto edge_id = edges_ids ? edges_ids[i] : ustore_key_unknown_k;
+        relations[i * 2] = {{collection, sources_ids[i]}, ustore_vertex_source_k, {targets_ids[i], edge_id}};
+        relations[i * 2 + 1] = {{collection, targets_ids[i]}, ustore_vertex_target_k, {sources_ids[i], edge_id}};
+        same_collection &= collection == edge_collections[0];
+    }
+
+    // Flipping the sign bit orders signed keys as unsigned ones
+    radix_sort(relations.begin(), relations_buffer.begin(), relations.size(), [](grouped_relation_t const& r) {
+        return ordered_unsigned(r.vertex.key);
+    });
+    if (!same_collection)
+        std::stable_sort(relations.begin(), relations.end(), [](auto const& a, auto const& b) {
+            return a.vertex.collection < b.vertex.collection;
+        });
+
+    // Within each group, order the relations like the neighborhoods do: outgoing first
+    auto by_role_and_ship = [](grouped_relation_t const& a, grouped_relation_t const& b) {
+        return a.role != b.role ? a.role < b.role : a.ship < b.ship;
+    };
+    auto same_relation = [](grouped_relation_t const& a, grouped_relation_t const& b) {
+        return a.role == b.role && a.ship == b.ship;
+    };
+    std::size_t groups_count = 0;
+    std::size_t relations_count = 0;
+    for (std::size_t begin = 0, end = 0; begin != relations.size(); begin = end) {
+        while (end != relations.size() && relations[end].vertex == relations[begin].vertex)
+            ++end;
+        std::sort(relations.begin() + begin, relations.begin() + end, by_role_and_ship);
+        auto unique_end = std::unique(relations.begin() + begin, relations.begin() + end, same_relation);
+        relations_count = std::copy(relations.begin() + begin, unique_end, relations.begin() + relations_count) -
+                          relations.begin();
+        relations_buffer[groups_count++].vertex = relations[relations_count - 1].vertex;
+    }
+
+    // The groups are already ordered, just like the deduplicated entries of regular upserts
+    auto unique_entries = arena.alloc<updated_entry_t>(groups_count, c_error);
+    return_if_error_m(c_error);
+    std::fill(unique_entries.begin(), unique_entries.end(), updated_entry_t {});
+    for (std::size_t i = 0; i != groups_count; ++i)
+        static_cast<collection_key_t&>(unique_entries[i]) = relations_buffer[i].vertex;
+    pull_and_link_for_updates(c_db, c_transaction, unique_entries.strided(), c_options, arena, c_error);
+    return_if_error_m(c_error);
+
+    chunks_updater_t supernodes;
+    safe_section("Merging relations", c_error, [&] {
+        for (std::size_t i = 0, begin = 0; i != groups_count && !*c_error; ++i) {
+            updated_entry_t& entry = unique_entries[i];
+            std::size_t end = begin;
+            while (end != relations_count && relations[end].vertex == entry)
+                ++end;
+            auto group = ptr_range_gt<grouped_relation_t> {relations.begin() + begin, relations.begin() + end};
+            auto targets_begin = std::partition_point(group.begin(), group.end(), [](grouped_relation_t const& r) {
+                return r.role == ustore_vertex_source_k;
+            });
+            begin = end;
+
+            if (is_chunked_neighborhood(entry)) {
+                for (grouped_relation_t const& relation : group)
+                    supernodes.defer(i, relation.role, relation.ship, false, false);
+                continue;
+            }
+
+            std::size_t old_degree = neighbors(entry).size();
+            auto merged = arena.alloc<byte_t>( //
+                bytes_in_degrees_header_k + (old_degree + group.size()) * sizeof(neighborship_t),
+                c_error);
+            if (*c_error)
+                return;
+            ustore_vertex_degree_t degrees[2] {};
+            auto merged_ships = reinterpret_cast<neighborship_t*>(merged.begin() + bytes_in_degrees_header_k);
+            auto merged_end = merged_ships;
+            for (std::size_t half = 0; half != 2; ++half) {
+                auto half_role = half ? ustore_vertex_target_k : ustore_vertex_source_k;
+                auto old_ships = neighbors(entry, half_role);
+                auto new_begin = half ? targets_begin : group.begin();
+                auto new_end = half ? group.end() : targets_begin;
+                auto half_begin = merged_end;
+                for (; new_begin != new_end; ++new_begin) {
+                    auto old_end = std::lower_bound(old_ships.begin(), old_ships.end(), new_begin->ship);
+                    half_begin = std::copy(old_ships.begin(), old_end, half_begin);
+                    old_ships = {old_end, old_ships.end()};
+                    if (old_ships.size() && old_ships[0] == new_begin->ship)
+                        continue;
+                    *half_begin++ = new_begin->ship;
+                }
+                half_begin = std::copy(old_ships.begin(), old_ships.end(), half_begin);
+                degrees[half] = static_cast<ustore_vertex_degree_t>(half_begin - merged_end);
+                merged_end = half_begin;
+            }
+            std::memcpy(merged.begin(), degrees, sizeof(degrees));
+
+            std::size_t new_degree = static_cast<std::size_t>(merged_end - merged_ships);
+            std::size_t new_length = bytes_in_degrees_header_k + new_degree * sizeof(neighborship_t);
+            entry.content = reinterpret_cast<ustore_bytes_ptr_t>(merged.begin());
+            entry.length = static_cast<ustore_length_t>(new_length);
+            entry.degree_delta = static_cast<ustore_vertex_degree_t>(new_degree - old_degree);
+        }
+    });
+    return_if_error_m(c_error);
+
+    write_neighborhoods(c_db, c_transaction, unique_entries, supernodes, attributes, c_options, arena, c_error);
+}
+
+template <bool erase_ak>
+void update_neighborhoods( //
+    ustore_database_t const c_db,
+    ustore_transaction_t const c_transaction,
+    ustore_size_t const c_tasks_count,
+
+    ustore_collection_t const* c_collections,
+    ustore_size_t const c_collections_stride,
+
+    ustore_key_t const* c_edges_ids,
+    ustore_size_t const c_edges_stride,
+
+    ustore_key_t const* c_sources_ids,
+    ustore_size_t const c_sources_stride,
+
+    ustore_key_t const* c_targets_ids,
+    ustore_size_t const c_targets_stride,
+
+    std::int64_t const* c_timestamps,
+    ustore_size_t const c_timestamps_stride,
+
+    ustore_float_t const* c_weights,
+    ustore_size_t const c_weights_stride,
+
+    ustore_options_t const c_options,
+
+    linked_memory_lock_t& arena,
+    ustore_error_t* c_error) {
+
+    trace_span_m("graph.update_neighborhoods");
+    strided_iterator_gt<ustore_collection_t const> edge_collections {c_collections, c_collections_stride};
+    strided_iterator_gt<ustore_key_t const> edges_ids {c_edges_ids, c_edges_stride};
+    strided_iterator_gt<ustore_key_t const> sources_ids {c_sources_ids, c_sources_stride};
+    strided_iterator_gt<ustore_key_t const> targets_ids {c_targets_ids, c_targets_stride};
+    strided_iterator_gt<std::int64_t const> timestamps {c_timestamps, c_timestamps_stride};
+    strided_iterator_gt<ustore_float_t const> weights {c_weights, c_weights_stride};
+
+    // Insertions are idempotent and commutative, so they don't need the current state,
+    // unless they assign attributes, which the merge operands can't carry
+    if constexpr (!erase_ak)
+        if (!c_timestamps && !c_weights && can_merge(c_db, c_transaction, c_options))
+            return merge_into_neighborhoods(c_db,
+                                            c_tasks_count,
+                                            edge_collections,
+                                            edges_ids,
+                                            sources_ids,
+                                            targets_ids,
+                                            c_options,
+                                            arena,
+                                            c_error);
+
+    auto attributes = sort_attributes(c_tasks_count,
+                                      edge_collections,
+                                      edges_ids,
+                                      sources_ids,
+                                      targets_ids,
+                                      timestamps,
+                                      weights,
+                                      arena,
+                                      c_error);
+    return_if_error_m(c_error);
+
+    if constexpr (!erase_ak)
+        if (c_options & ustore_option_write_bulk_k)
+            return bulk_insert_into_neighborhoods(c_db,
+                                                  c_transaction,
+                                                  c_tasks_count,
+                                                  edge_collections,
+                                                  edges_ids,
+                                                  sources_ids,
+                                                  targets_ids,
+                                                  attributes,
+                                                  c_options,
+                                                  arena,
+                                                  c_error);
+
+    // Fetch all the data related to touched vertices, and deduplicate them
+    auto unique_entries = arena.alloc<updated_entry_t>(c_tasks_count * 2, c_error);
+    return_if_error_m(c_error);
+    std::fill(unique_entries.begin(), unique_entries.end(), updated_entry_t {});
+    for (ustore_size_t i = 0; i != c_tasks_count; ++i)
+        unique_entries[i].collection = edge_collections[i], unique_entries[i].key = sources_ids[i];
+    for (ustore_size_t i = 0; i != c_tasks_count; ++i)
+        unique_entries[c_tasks_count + i].collection = edge_collections[i],
+                                       unique_entries[c_tasks_count + i].key = targets_ids[i];
+
+    // Lets put all the unique IDs in the beginning of the range,
+    // and then refill the tail with replicas
+    auto unique_count = sort_and_deduplicate(unique_entries.begin(), unique_entries.end());
+    unique_entries = {unique_entries.begin(), unique_count};
+
+    // Fetch the existing entries
+    auto unique_strided = unique_entries.strided();
+    pull_and_link_for_updates(c_db, c_transaction, unique_strided, c_options, arena, c_error);
+    return_if_error_m(c_error);
+
+    // Define our primary for-loop
+    auto for_each_task = [&](auto entry_role_target_edge_callback) {
+        for (std::size_t i = 0; i != c_tasks_count; ++i) {
+            auto collection = edge_collections[i];
+            auto source_id = sources_ids[i];
+            auto target_id = targets_ids[i];
+            auto edge_id = edges_ids ? edges_ids[i] : ustore_key_unknown_k;
+            auto source_idx = offset_in_sorted(unique_entries, collection_key_t {collection, source_id});
+            auto target_idx = offset_in_sorted(unique_entries, collection_key_t {collection, target_id});
+            entry_role_target_edge_callback(unique_entries[source_idx], ustore_vertex_source_k, target_id, edge_id);
+            entry_role_target_edge_callback(unique_entries[target_idx], ustore_vertex_target_k, source_id, edge_id);
+        }
+    };
+
+    // Supernodes defer their updates, until the relevant chunks are read
+    chunks_updater_t supernodes;
+    auto deferring = [&](auto update_plain) {
+        return [&, update_plain](updated_entry_t& entry,
+                                 ustore_vertex_role_t role,
+                                 ustore_key_t id,
+                                 ustore_key_t edge) {
+            if (!is_chunked_neighborhood(entry))
+                return update_plain(entry, role, id, edge);
+            auto entry_idx = static_cast<std::size_t>(&entry - unique_entries.begin());
+            supernodes.defer(entry_idx, role, neighborship_t {id, edge}, erase_ak, false);
+        };
+    };
+
+    if constexpr (erase_ak)
+        safe_section("Erasing relations", c_error, [&] { for_each_task(deferring(&erase_from_entry)); });
+    else {
+        // Unlike erasing, which can reuse the memory, her we need three passes:
+        // 1. estimating final size
+        for_each_task([](updated_entry_t& entry, ustore_vertex_role_t role, ustore_key_t id, ustore_key_t edge) {
+            if (!is_chunked_neighborhood(entry))
+                count_inserts_into_entry(entry, role, id, edge);
+        });
+        // 2. reallocating into bigger buffers
+        for (std::size_t i = 0; i != unique_count; ++i) {
+            auto& unique_entry = unique_entries[i];
+            auto bytes_present = unique_entry.length != ustore_length_missing_k ? unique_entry.length : 0;
+            auto bytes_for_relations = unique_entry.degree_delta * sizeof(neighborship_t);
+            auto bytes_for_degrees = bytes_present > bytes_in_degrees_header_k ? 0 : bytes_in_degrees_header_k;
+            auto new_size = bytes_present + bytes_for_relations + bytes_for_degrees;
+            auto new_buffer = arena.alloc<byte_t>(new_size, c_error);
+            return_if_error_m(c_error);
+            std::memcpy(new_buffer.begin(), unique_entry.content, bytes_present);
+
+            unique_entry.content = (ustore_bytes_ptr_t)new_buffer.begin();
+            // No need to grow `length` here, we will update in `insert_into_entry` later
+            unique_entry.length = bytes_present;
+        }
+        // 3. performing insertions
+        safe_section("Inserting relations", c_error, [&] { for_each_task(deferring(&insert_into_entry)); });
+    }
+    return_if_error_m(c_error);
+
+    write_neighborhoods(c_db, c_transaction, unique_entries, supernodes, attributes, c_options, arena, c_error);
+}
+
+bool are_vertex_ids(ustore_key_t const* ids, ustore_size_t stride, ustore_size_t count) noexcept {
+    strided_range_gt<ustore_key_t const> range {{ids, stride}, count};
+    return std::all_of(range.begin(), range.end(), [](ustore_key_t id) { return id >= ustore_vertex_id_min_k; });
+}
+
+#if !defined(USTORE_FLIGHT_CLIENT)
 void ustore_graph_find_edges(ustore_graph_find_edges_t* c_ptr) {
+    trace_span_m("graph_find_edges");
 
     ustore_graph_find_edges_t& c = *c_ptr;
     if (!c.tasks_count)
@@ -606,15 +1882,214 @@ void ustore_graph_find_edges(ustore_graph_find_edges_t* c_ptr) {
         c.options,
         c.degrees_per_vertex,
         c.edges_per_vertex,
+        only_degrees ? nullptr : c.timestamps_per_edge,
+        only_degrees ? nullptr : c.weights_per_edge,
+        arena,
+        c.error);
+}
+#endif // Forwarded to the server in `flight_client.cpp`
+
+void ustore_graph_find_degrees(ustore_graph_find_degrees_t* c_ptr) {
+    trace_span_m("graph_find_degrees");
+
+    ustore_graph_find_degrees_t& c = *c_ptr;
+    if (!c.tasks_count)
+        return;
+
+    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
+    return_if_error_m(c.error);
+
+    ustore_bytes_ptr_t found_values = nullptr;
+    ustore_length_t* found_offsets = nullptr;
+    ustore_length_t* found_lengths = nullptr;
+    ustore_read_t read {};
+    read.db = c.db;
+    read.error = c.error;
+    read.transaction = c.transaction;
+    read.snapshot = c.snapshot;
+    read.arena = arena;
+    read.options = c.options;
+    read.tasks_count = c.tasks_count;
+    read.collections = c.collections;
+    read.collections_stride = c.collections_stride;
+    read.keys = c.vertices;
+    read.keys_stride = c.vertices_stride;
+    read.offsets = &found_offsets;
+    read.lengths = &found_lengths;
+    read.values = &found_values;
+
+    ustore_read(&read);
+    return_if_error_m(c.error);
+
+    // Only the supernodes with pending relations need their chunks, to deduplicate those
+    strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
+    embedded_blobs_t found {c.tasks_count, found_offsets, found_lengths, found_values};
+    auto values = arena.alloc<value_view_t>(c.tasks_count, c.error);
+    return_if_error_m(c.error);
+    for (std::size_t i = 0; i != c.tasks_count; ++i)
+        values[i] = found[i];
+    gather_chunks(
+        c.db,
+        c.transaction,
+        c.snapshot,
+        values,
+        [&](std::size_t i) { return collections ? collections[i] : ustore_collection_main_k; },
+        [](std::size_t) { return ustore_vertex_role_any_k; },
+        true,
+        c.options,
         arena,
         c.error);
+    return_if_error_m(c.error);
+
+    auto out_degrees = arena.alloc_or_dummy(c.tasks_count, c.error, c.out_degrees);
+    return_if_error_m(c.error);
+    auto in_degrees = arena.alloc_or_dummy(c.tasks_count, c.error, c.in_degrees);
+    return_if_error_m(c.error);
+    for (std::size_t i = 0; i != c.tasks_count; ++i) {
+        value_view_t value = values[i];
+        out_degrees[i] = value ? degree_of(value, ustore_vertex_source_k) : ustore_vertex_degree_missing_k;
+        in_degrees[i] = value ? degree_of(value, ustore_vertex_target_k) : ustore_vertex_degree_missing_k;
+    }
 }
 
+void ustore_graph_contains_edges(ustore_graph_contains_edges_t* c_ptr) {
+    trace_span_m("graph_contains_edges");
+
+    ustore_graph_contains_edges_t& c = *c_ptr;
+    if (!c.tasks_count)
+        return;
+
+    return_error_if_m(c.sources_ids && c.targets_ids, c.error, args_wrong_k, "Sources and targets are required");
+    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
+    return_if_error_m(c.error);
+
+    strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
+    strided_iterator_gt<ustore_key_t const> edges_ids {c.edges_ids, c.edges_stride};
+    strided_iterator_gt<ustore_key_t const> sources_ids {c.sources_ids, c.sources_stride};
+    strided_iterator_gt<ustore_key_t const> targets_ids {c.targets_ids, c.targets_stride};
+    auto source_of = [&](std::size_t i) {
+        return collection_key_t {collections ? collections[i] : ustore_collection_main_k, sources_ids[i]};
+    };
+
+    // Batches often start from the same vertex, so each neighborhood is fetched once
+    auto unique_sources = arena.alloc<collection_key_t>(c.tasks_count, c.error);
+    return_if_error_m(c.error);
+    for (std::size_t i = 0; i != c.tasks_count; ++i)
+        unique_sources[i] = source_of(i);
+    auto unique_count = sort_and_deduplicate(unique_sources.begin(), unique_sources.end());
+    unique_sources = {unique_sources.begin(), unique_count};
+
+    auto read_values = [&](ptr_range_gt<collection_key_t> places) {
+        auto places_strided = places.strided().immutable();
+        auto places_collections = places_strided.members(&collection_key_t::collection);
+        auto places_keys = places_strided.members(&collection_key_t::key);
+        ustore_bytes_ptr_t found_values = nullptr;
+        ustore_length_t* found_offsets = nullptr;
+        ustore_read_t read {};
+        read.db = c.db;
+        read.error = c.error;
+        read.transaction = c.transaction;
+        read.snapshot = c.snapshot;
+        read.arena = arena;
+        read.options = c.options;
+        read.tasks_count = places.size();
+        read.collections = places_collections.begin().get();
+        read.collections_stride = places_collections.begin().stride();
+        read.keys = places_keys.begin().get();
+        read.keys_stride = places_keys.begin().stride();
+        read.offsets = &found_offsets;
+        read.values = &found_values;
+        ustore_read(&read);
+        return joined_blobs_t {*c.error ? 0 : places.size(), found_offsets, found_values};
+    };
+    joined_blobs_t sources_values = read_values(unique_sources);
+    return_if_error_m(c.error);
+    auto source_value = [&](std::size_t i) {
+        return sources_values[offset_in_sorted(unique_sources, source_of(i))];
+    };
+
+    // Supernodes need one more batched read, limited to the chunks, that may contain the targets
+    std::size_t chunks_count = 0;
+    for (std::size_t i = 0; i != c.tasks_count; ++i)
+        if (value_view_t value = source_value(i); is_chunked_neighborhood(value))
+            for_each_chunk_with(chunked_neighborhood_t {value}, targets_ids[i], [&](chunk_ref_t) { ++chunks_count; });
+
+    auto chunks_keys = arena.alloc<collection_key_t>(chunks_count, c.error);
+    return_if_error_m(c.error);
+    for (std::size_t i = 0, passed = 0; i != c.tasks_count; ++i)
+        if (value_view_t value = source_value(i); is_chunked_neighborhood(value))
+            for_each_chunk_with(chunked_neighborhood_t {value}, targets_ids[i], [&](chunk_ref_t ref) {
+                chunks_keys[passed++] = {source_of(i).collection, ref.key};
+            });
+    joined_blobs_t chunks_values;
+    if (chunks_count) {
+        chunks_values = read_values(chunks_keys);
+        return_if_error_m(c.error);
+    }
+
+    auto presences = arena.alloc_or_dummy(c.tasks_count, c.error, c.presences);
+    return_if_error_m(c.error);
+    auto counts = arena.alloc_or_dummy(c.tasks_count, c.error, c.counts);
+    return_if_error_m(c.error);
+
+    joined_blobs_iterator_t chunks_it = chunks_values.begin();
+    std::vector<neighborship_t> matches;
+    auto count_matches = [&](value_view_t value, ustore_key_t target, auto needle) -> std::size_t {
+        if (!is_chunked_neighborhood(value))
+            return count_relations(value, needle);
+
+        // Chunks never overlap, but the pending relations may repeat them
+        chunked_neighborhood_t chunked {value};
+        value_view_t pending = chunked.pending();
+        std::size_t pending_count = count_relations(pending, needle);
+        std::size_t result = 0;
+        matches.clear();
+        for_each_chunk_with(chunked, target, [&](chunk_ref_t) {
+            value_view_t chunk = *chunks_it;
+            ++chunks_it;
+            if (!pending_count) {
+                result += count_relations(chunk, needle);
+                return;
+            }
+            chunk = decompress(chunk, arena, c.error);
+            auto ships = neighbors(chunk, ustore_vertex_source_k);
+            auto range = std::equal_range(ships.begin(), ships.end(), needle);
+            matches.insert(matches.end(), range.first, range.second);
+        });
+        if (!pending_count)
+            return result;
+        auto pending_ships = neighbors(pending, ustore_vertex_source_k);
+        auto range = std::equal_range(pending_ships.begin(), pending_ships.end(), needle);
+        matches.insert(matches.end(), range.first, range.second);
+        sort_and_deduplicate(matches);
+        return matches.size();
+    };
+
+    safe_section("Searching neighborhoods", c.error, [&] {
+        for (std::size_t i = 0; i != c.tasks_count && !*c.error; ++i) {
+            value_view_t value = source_value(i);
+            ustore_key_t target = targets_ids[i];
+            std::size_t count = edges_ids //
+                                    ? count_matches(value, target, neighborship_t {target, edges_ids[i]})
+                                    : count_matches(value, target, target);
+            presences[i] = count != 0;
+            counts[i] = static_cast<ustore_vertex_degree_t>(count);
+        }
+    });
+}
+
+#if !defined(USTORE_FLIGHT_CLIENT)
 void ustore_graph_upsert_edges(ustore_graph_upsert_edges_t* c_ptr) {
+    trace_span_m("graph_upsert_edges");
 
     ustore_graph_upsert_edges_t& c = *c_ptr;
     if (!c.tasks_count)
         return;
+    return_error_if_m(are_vertex_ids(c.sources_ids, c.sources_stride, c.tasks_count) &&
+                          are_vertex_ids(c.targets_ids, c.targets_stride, c.tasks_count),
+                      c.error,
+                      args_wrong_k,
+                      "Vertex IDs below `ustore_vertex_id_min_k` are reserved");
 
     linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
     return_if_error_m(c.error);
@@ -631,12 +2106,18 @@ void ustore_graph_upsert_edges(ustore_graph_upsert_edges_t* c_ptr) {
         c.sources_stride,
         c.targets_ids,
         c.targets_stride,
+        c.timestamps,
+        c.timestamps_stride,
+        c.weights,
+        c.weights_stride,
         c.options,
         arena,
         c.error);
 }
+#endif // Forwarded to the server in `flight_client.cpp`
 
 void ustore_graph_remove_edges(ustore_graph_remove_edges_t* c_ptr) {
+    trace_span_m("graph_remove_edges");
 
     ustore_graph_remove_edges_t& c = *c_ptr;
     if (!c.tasks_count)
@@ -657,16 +2138,25 @@ void ustore_graph_remove_edges(ustore_graph_remove_edges_t* c_ptr) {
         c.sources_stride,
         c.targets_ids,
         c.targets_stride,
+        nullptr,
+        0,
+        nullptr,
+        0,
         c.options,
         arena,
         c.error);
 }
 
 void ustore_graph_upsert_vertices(ustore_graph_upsert_vertices_t* c_ptr) {
+    trace_span_m("graph_upsert_vertices");
 
     ustore_graph_upsert_vertices_t& c = *c_ptr;
     if (!c.tasks_count)
         return;
+    return_error_if_m(are_vertex_ids(c.vertices, c.vertices_stride, c.tasks_count),
+                      c.error,
+                      args_wrong_k,
+                      "Vertex IDs below `ustore_vertex_id_min_k` are reserved");
 
     linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
     return_if_error_m(c.error);
@@ -677,7 +2167,7 @@ void ustore_graph_upsert_vertices(ustore_graph_upsert_vertices_t* c_ptr) {
     read.error = c.error;
     read.transaction = c.transaction;
     read.arena = arena;
-    read.options = c.options;
+    read.options = ustore_options_t(c.options & ~ustore_option_write_bulk_k);
     read.tasks_count = c.tasks_count;
     read.collections = c.collections;
     read.collections_stride = c.collections_stride;
@@ -717,6 +2207,7 @@ void ustore_graph_upsert_vertices(ustore_graph_upsert_vertices_t* c_ptr) {
 }
 
 void ustore_graph_remove_vertices(ustore_graph_remove_vertices_t* c_ptr) {
+    trace_span_m("graph_remove_vertices");
 
     ustore_graph_remove_vertices_t& c = *c_ptr;
     if (!c.tasks_count)
@@ -746,13 +2237,17 @@ void ustore_graph_remove_vertices(ustore_graph_remove_vertices_t* c_ptr) {
         c.options,
         &degrees_per_vertex,
         &neighbors_per_vertex,
+        nullptr,
+        nullptr,
         arena,
         c.error);
     return_if_error_m(c.error);
 
     // Enumerate the opposite ends, from which that same reference must be removed.
     // Here all the keys will be in the sorted order.
+    std::replace(degrees_per_vertex, degrees_per_vertex + c.tasks_count, ustore_vertex_degree_missing_k, 0u);
     auto unique_count = std::accumulate(degrees_per_vertex, degrees_per_vertex + c.tasks_count, c.tasks_count);
+    ustore_key_t const* exported_neighbors = neighbors_per_vertex;
     auto unique_entries = arena.alloc<updated_entry_t>(unique_count, c.error);
     return_if_error_m(c.error);
     std::fill(unique_entries.begin(), unique_entries.end(), updated_entry_t {});
@@ -778,35 +2273,57 @@ void ustore_graph_remove_vertices(ustore_graph_remove_vertices_t* c_ptr) {
     pull_and_link_for_updates(c.db, c.transaction, unique_strided, c.options, arena, c.error);
     return_if_error_m(c.error);
 
-    // From every opposite end - remove a match, and only then - the content itself
-    for (std::size_t i = 0; i != unique_strided.size(); ++i) {
-        auto vertex_collection = vertex_collections[i];
-        auto vertex_id = vertices[i];
-        auto vertex_role = vertex_roles ? vertex_roles[i] : ustore_vertex_role_any_k;
-
-        auto vertex_idx = offset_in_sorted(unique_entries, collection_key_t {vertex_collection, vertex_id});
-        updated_entry_t& vertex_value = unique_entries[vertex_idx];
-
-        for (neighborship_t n : neighbors(vertex_value, vertex_role)) {
-            auto neighbor_idx = offset_in_sorted(unique_entries, collection_key_t {vertex_collection, n.neighbor_id});
-            updated_entry_t& neighbor_value = unique_entries[neighbor_idx];
-            if (vertex_role == ustore_vertex_role_any_k) {
-                erase_from_entry(neighbor_value, ustore_vertex_source_k, vertex_id);
-                erase_from_entry(neighbor_value, ustore_vertex_target_k, vertex_id);
+    // From every opposite end - remove a match, and only then - the content itself.
+    // The neighbors are taken from the export, as the vertex itself may be chunked.
+    chunks_updater_t supernodes;
+    auto erase = [&](updated_entry_t& entry, ustore_vertex_role_t role, ustore_key_t vertex_id) {
+        if (!is_chunked_neighborhood(entry))
+            return erase_from_entry(entry, role, vertex_id);
+        auto entry_idx = static_cast<std::size_t>(&entry - unique_entries.begin());
+        supernodes.defer(entry_idx, role, neighborship_t {vertex_id, 0}, true, true);
+    };
+    safe_section("Removing vertices", c.error, [&] {
+        ustore_key_t const* vertex_neighbors = exported_neighbors;
+        for (std::size_t i = 0; i != c.tasks_count; ++i) {
+            auto vertex_collection = vertex_collections[i];
+            auto vertex_id = vertices[i];
+            auto vertex_role = vertex_roles ? vertex_roles[i] : ustore_vertex_role_any_k;
+
+            auto vertex_idx = offset_in_sorted(unique_entries, collection_key_t {vertex_collection, vertex_id});
+            updated_entry_t& vertex_value = unique_entries[vertex_idx];
+
+            for (std::size_t j = 0; j != degrees_per_vertex[i]; ++j) {
+                auto neighbor_id = vertex_neighbors[j];
+                auto neighbor_idx = offset_in_sorted(unique_entries, collection_key_t {vertex_collection, neighbor_id});
+                updated_entry_t& neighbor_value = unique_entries[neighbor_idx];
+                if (vertex_role == ustore_vertex_role_any_k) {
+                    erase(neighbor_value, ustore_vertex_source_k, vertex_id);
+                    erase(neighbor_value, ustore_vertex_target_k, vertex_id);
+                }
+                else
+                    erase(neighbor_value, invert(vertex_role), vertex_id);
             }
-            else
-                erase_from_entry(neighbor_value, invert(vertex_role), vertex_id);
-        }
+            vertex_neighbors += degrees_per_vertex[i];
 
-        vertex_value.content = nullptr;
-        vertex_value.length = ustore_length_missing_k;
-    }
+            supernodes.drop(vertex_value);
+            vertex_value.content = nullptr;
+            vertex_value.length = ustore_length_missing_k;
+        }
+        supernodes.update(c.db, c.transaction, unique_strided, c.options, arena, c.error);
+    });
+    return_if_error_m(c.error);
+    attach_attributes(unique_entries, {}, arena, c.error);
+    return_if_error_m(c.error);
 
     // Now we will go through all the explicitly deleted vertices
-    auto collections = unique_strided.immutable().members(&updated_entry_t::collection);
-    auto keys = unique_strided.immutable().members(&updated_entry_t::key);
-    auto lengths = unique_strided.immutable().members(&updated_entry_t::length);
-    auto contents = unique_strided.immutable().members(&updated_entry_t::content);
+    auto written = append_chunks(unique_entries, supernodes.writes, arena, c.error);
+    return_if_error_m(c.error);
+    compress(written, arena, c.error);
+    return_if_error_m(c.error);
+    auto collections = written.immutable().members(&updated_entry_t::collection);
+    auto keys = written.immutable().members(&updated_entry_t::key);
+    auto lengths = written.immutable().members(&updated_entry_t::length);
+    auto contents = written.immutable().members(&updated_entry_t::content);
 
     ustore_write_t write {};
     write.db = c.db;
@@ -814,7 +2331,7 @@ void ustore_graph_remove_vertices(ustore_graph_remove_vertices_t* c_ptr) {
     write.transaction = c.transaction;
     write.arena = arena;
     write.options = c.options;
-    write.tasks_count = unique_count;
+    write.tasks_count = written.size();
     write.collections = collections.begin().get();
     write.collections_stride = collections.begin().stride();
     write.keys = keys.begin().get();
@@ -825,4 +2342,667 @@ void ustore_graph_remove_vertices(ustore_graph_remove_vertices_t* c_ptr) {
     write.values_stride = contents.begin().stride();
 
     ustore_write(&write);
-}
\ No newline at end of file
+}
+
+/*********************************************************/
+/*****************	     Traversals	      ****************/
+/*********************************************************/
+
+void ustore_graph_traverse(ustore_graph_traverse_t* c_ptr) {
+    trace_span_m("graph_traverse");
+
+    ustore_graph_traverse_t& c = *c_ptr;
+    return_error_if_m(c.dedup == ustore_traversal_dedup_none_k || c.dedup == ustore_traversal_dedup_hop_k ||
+                          c.dedup == ustore_traversal_dedup_visited_k,
+                      c.error,
+                      args_wrong_k,
+                      "Unknown deduplication mode");
+
+    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
+    return_if_error_m(c.error);
+
+    strided_range_gt<ustore_key_t const> seeds {{c.seeds, c.seeds_stride}, c.seeds_count};
+    strided_iterator_gt<ustore_vertex_role_t const> roles {c.roles, c.roles_stride};
+    bool dedup = c.dedup != ustore_traversal_dedup_none_k;
+    std::size_t limit = c.fanout_limit ? c.fanout_limit : std::numeric_limits<std::size_t>::max();
+
+    // The frontiers of consecutive hops have unpredictable sizes,
+    // so they are collected into vectors and copied into the arena at the end
+    std::vector<ustore_key_t> expanded, reached, visited, merged, frontiers, edges;
+    std::vector<ustore_length_t> frontiers_offsets, edges_offsets;
+    safe_section("Traversing the graph", c.error, [&] {
+        expanded.assign(seeds.begin(), seeds.end());
+        if (dedup)
+            sort_and_deduplicate(expanded);
+        if (c.dedup == ustore_traversal_dedup_visited_k)
+            visited = expanded;
+        frontiers_offsets.push_back(0);
+        edges_offsets.push_back(0);
+
+        for (std::size_t hop = 0; hop != c.hops_count; ++hop) {
+            ustore_vertex_role_t role = roles ? roles[hop] : ustore_vertex_role_any_k;
+            ustore_vertex_degree_t* degrees = nullptr;
+            ustore_key_t* ids = nullptr;
+            std::int64_t* timestamps = nullptr;
+            reached.clear();
+            if (!expanded.empty()) {
+                export_edge_tuples<true, true, true>( //
+                    c.db,
+                    c.transaction,
+                    c.snapshot,
+                    expanded.size(),
+                    &c.collection,
+                    0,
+                    expanded.data(),
+                    sizeof(ustore_key_t),
+                    &role,
+                    0,
+                    c.options,
+                    &degrees,
+                    &ids,
+                    c.timestamps_window ? &timestamps : nullptr,
+                    nullptr,
+                    arena,
+                    c.error);
+                return_if_error_m(c.error);
+            }
+
+            for (std::size_t i = 0; i != expanded.size(); ++i) {
+                if (degrees[i] == ustore_vertex_degree_missing_k)
+                    continue;
+                std::size_t followed = 0;
+                for (std::size_t j = 0; j != degrees[i] && followed != limit; ++j) {
+                    ustore_key_t const* edge = ids + j * 3;
+                    bool in_window = !timestamps || (timestamps[j] >= c.timestamps_window[0] &&
+                                                     timestamps[j] <= c.timestamps_window[1]);
+                    if (!in_window)
+                        continue;
+                    reached.push_back(edge[0] == expanded[i] ? edge[1] : edge[0]);
+                    if (c.edges)
+                        edges.insert(edges.end(), edge, edge + 3);
+                    ++followed;
+                }
+                ids += degrees[i] * 3;
+                if (timestamps)
+                    timestamps += degrees[i];
+            }
+
+            if (dedup)
+                sort_and_deduplicate(reached);
+            if (c.dedup == ustore_traversal_dedup_visited_k) {
+                auto news_end = std::set_difference( //
+                    reached.begin(),
+                    reached.end(),
+                    visited.begin(),
+                    visited.end(),
+                    reached.begin());
+                reached.erase(news_end, reached.end());
+                merged.clear();
+                std::merge(visited.begin(), visited.end(), reached.begin(), reached.end(), std::back_inserter(merged));
+                std::swap(visited, merged);
+            }
+
+            frontiers.insert(frontiers.end(), reached.begin(), reached.end());
+            frontiers_offsets.push_back(static_cast<ustore_length_t>(frontiers.size()));
+            edges_offsets.push_back(static_cast<ustore_length_t>(edges.size() / 3));
+            std::swap(expanded, reached);
+        }
+    });
+    return_if_error_m(c.error);
+
+    auto export_into_arena = [&](auto const& vector, auto** output) {
+        if (!output)
+            return;
+        arena.alloc_or_dummy(vector.size(), c.error, output);
+        return_if_error_m(c.error);
+        std::copy(vector.begin(), vector.end(), *output);
+    };
+    export_into_arena(frontiers_offsets, c.frontiers_offsets);
+    return_if_error_m(c.error);
+    export_into_arena(frontiers, c.frontiers);
+    return_if_error_m(c.error);
+    export_into_arena(edges_offsets, c.edges_offsets);
+    return_if_error_m(c.error);
+    export_into_arena(edges, c.edges);
+}
+
+/*********************************************************/
+/*****************	 Read-Only Snapshots  ****************/
+/*********************************************************/
+
+/**
+ * @brief Prefix of the files, written by `ustore_graph_export_csr()`,
+ * followed by the arrays of `ustore_graph_csr_t` in the order of declaration.
+ */
+struct csr_file_header_t {
+    char magic[8];
+    std::uint64_t version;
+    std::uint64_t vertices_count;
+    std::uint64_t edges_count;
+};
+
+static_assert(sizeof(csr_file_header_t) == 32, "The header is persisted as-is");
+
+constexpr char csr_file_magic_k[8] = {'u', 's', 't', 'o', 'r', 'c', 's', 'r'};
+constexpr std::uint64_t csr_file_version_k = 2;
+constexpr ustore_length_t csr_read_ahead_k = 4096;
+constexpr std::size_t csr_parallel_chunk_k = 64 * 1024;
+
+std::size_t csr_file_length(std::size_t vertices_count, std::size_t edges_count) noexcept {
+    return sizeof(csr_file_header_t) + (vertices_count * 2 + 1) * sizeof(ustore_size_t) +
+           edges_count * (2 * sizeof(ustore_key_t) + sizeof(ustore_float_t));
+}
+
+/**
+ * @brief Growing CSR, that collects the neighborhoods, while the collection is paged through.
+ * The neighbors are collected as IDs at first, and are only later replaced with indexes.
+ */
+struct csr_builder_t {
+    std::vector<ustore_key_t> vertices;
+    std::vector<ustore_size_t> offsets {0};
+    std::vector<ustore_key_t> neighbors;
+    std::vector<ustore_key_t> edges_ids;
+    std::vector<ustore_float_t> weights;
+    std::vector<neighborship_t> decompressed;
+
+    void append(ustore_key_t vertex, value_view_t value, ustore_vertex_role_t role) {
+        attributed_neighborhood_t attributed {value};
+        auto append_ship = [&](neighborship_t ship, std::size_t relation_idx) {
+            neighbors.push_back(ship.neighbor_id), edges_ids.push_back(ship.edge_id);
+            weights.push_back(attributed[relation_idx].weight);
+        };
+
+        ptr_range_gt<neighborship_t const> targets, sources;
+        if (is_compressed_neighborhood(value)) {
+            compressed_neighborhood_t compressed {value};
+            auto degrees = compressed.degrees();
+            decompressed.resize(degrees[0] + degrees[1]);
+            compressed.decode(ustore_vertex_role_any_k, decompressed.data());
+            targets = {decompressed.data(), decompressed.data() + degrees[0]};
+            sources = {decompressed.data() + degrees[0], decompressed.data() + decompressed.size()};
+        }
+        else {
+            targets = ::neighbors(value, ustore_vertex_source_k);
+            sources = ::neighbors(value, ustore_vertex_target_k);
+        }
+
+        // Both halves are sorted, so the merged neighborhood will be too.
+        // The attributes follow the relations, outgoing ones first.
+        vertices.push_back(vertex);
+        std::size_t target_idx = role & ustore_vertex_source_k ? 0 : targets.size();
+        std::size_t source_idx = role & ustore_vertex_target_k ? 0 : sources.size();
+        while (target_idx != targets.size() || source_idx != sources.size()) {
+            bool take_source = target_idx == targets.size() ||
+                               (source_idx != sources.size() && sources[source_idx] < targets[target_idx]);
+            if (take_source)
+                append_ship(sources[source_idx], targets.size() + source_idx), ++source_idx;
+            else
+                append_ship(targets[target_idx], target_idx), ++target_idx;
+        }
+        offsets.push_back(neighbors.size());
+    }
+
+    /**
+     * @brief Replaces the neighbor IDs with their indexes. Neighbors, that aren't
+     * present in the collection, like the members of a Joining Graph, are dropped.
+     * The indexes reuse the memory of `neighbors`. @see `indexes()`.
+     */
+    void index() {
+        static_assert(sizeof(ustore_size_t) == sizeof(ustore_key_t));
+        constexpr ustore_size_t missing_k = std::numeric_limits<ustore_size_t>::max();
+        std::atomic<bool> has_missing {false};
+        std::size_t chunks = divide_round_up(neighbors.size(), csr_parallel_chunk_k);
+        parallel_for(chunks, [&](std::size_t chunk_idx) {
+            std::size_t begin = chunk_idx * csr_parallel_chunk_k;
+            std::size_t end = std::min(begin + csr_parallel_chunk_k, neighbors.size());
+            for (std::size_t i = begin; i != end; ++i) {
+                auto it = std::lower_bound(vertices.begin(), vertices.end(), neighbors[i]);
+                bool found = it != vertices.end() && *it == neighbors[i];
+                ustore_size_t idx = found ? static_cast<ustore_size_t>(it - vertices.begin()) : missing_k;
+                std::memcpy(&neighbors[i], &idx, sizeof(idx));
+                if (!found)
+                    has_missing = true;
+            }
+        });
+        if (!has_missing)
+            return;
+
+        std::size_t kept = 0;
+        for (std::size_t vertex_idx = 0; vertex_idx != vertices.size(); ++vertex_idx) {
+            std::size_t begin = offsets[vertex_idx], end = offsets[vertex_idx + 1];
+            offsets[vertex_idx] = kept;
+            for (std::size_t i = begin; i != end; ++i) {
+                ustore_size_t idx;
+                std::memcpy(&idx, &neighbors[i], sizeof(idx));
+                if (idx == missing_k)
+                    continue;
+                neighbors[kept] = neighbors[i];
+                edges_ids[kept] = edges_ids[i];
+                weights[kept] = weights[i];
+                ++kept;
+            }
+        }
+        offsets.back() = kept;
+        neighbors.resize(kept);
+        edges_ids.resize(kept);
+        weights.resize(kept);
+    }
+
+    ustore_size_t const* indexes() const noexcept { return reinterpret_cast<ustore_size_t const*>(neighbors.data()); }
+};
+
+/**
+ * @brief Passes every entry of the @p collection to the @p callback in the sorted order,
+ * paging through a private arena, so that the memory use doesn't grow with the collection.
+ */
+template <typename callback_at>
+void scan_neighborhoods(ustore_graph_export_csr_t const& c, callback_at&& callback) {
+    ustore_arena_t scan_arena = nullptr;
+    ustore_key_t start_key = ustore_vertex_id_min_k;
+    ustore_length_t read_ahead = csr_read_ahead_k;
+    ustore_options_t options = ustore_options_t(c.options | ustore_option_scan_sequential_k);
+    options = ustore_options_t(options & ~(ustore_option_dont_discard_memory_k | ustore_option_read_shared_memory_k));
+    while (!*c.error) {
+        ustore_length_t* found_counts {};
+        ustore_key_t* found_keys {};
+        ustore_length_t* found_offsets {};
+        ustore_byte_t* found_values {};
+        ustore_scan_t scan {};
+        scan.db = c.db;
+        scan.error = c.error;
+        scan.transaction = c.transaction;
+        scan.snapshot = c.snapshot;
+        scan.arena = &scan_arena;
+        scan.options = options;
+        scan.tasks_count = 1;
+        scan.collections = &c.collection;
+        scan.start_keys = &start_key;
+        scan.count_limits = &read_ahead;
+        scan.counts = &found_counts;
+        scan.keys = &found_keys;
+        scan.values_offsets = &found_offsets;
+        scan.values = &found_values;
+
+        ustore_scan(&scan);
+        if (*c.error)
+            break;
+
+        ustore_length_t count = found_counts[0];
+        joined_blobs_iterator_t found_values_it {found_offsets, found_values};
+        for (std::size_t i = 0; i != count; ++i, ++found_values_it)
+            callback(found_keys[i], *found_values_it);
+
+        if (count < read_ahead || found_keys[count - 1] == std::numeric_limits<ustore_key_t>::max())
+            break;
+        start_key = found_keys[count - 1] + 1;
+    }
+    ustore_arena_free(scan_arena);
+}
+
+void map_csr(ustore_str_view_t path, ustore_graph_csr_t& csr, ustore_error_t* c_error) {
+    int descriptor = ::open(path, O_RDONLY);
+    return_error_if_m(descriptor >= 0, c_error, args_wrong_k, "Couldn't open the CSR file");
+    struct stat file_stat;
+    bool has_stat = ::fstat(descriptor, &file_stat) == 0;
+    std::size_t length = has_stat ? static_cast<std::size_t>(file_stat.st_size) : 0;
+    void* mapping = length >= sizeof(csr_file_header_t)
+                        ? ::mmap(nullptr, length, PROT_READ, MAP_SHARED, descriptor, 0)
+                        : MAP_FAILED;
+    ::close(descriptor);
+    return_error_if_m(mapping != MAP_FAILED, c_error, args_wrong_k, "Couldn't map the CSR file");
+
+    csr_file_header_t header;
+    std::memcpy(&header, mapping, sizeof(header));
+    bool is_valid = std::equal(header.magic, header.magic + sizeof(header.magic), csr_file_magic_k) &&
+                    header.version == csr_file_version_k &&
+                    csr_file_length(header.vertices_count, header.edges_count) == length;
+    if (!is_valid) {
+        ::munmap(mapping, length);
+        log_error_m(c_error, args_wrong_k, "Not a CSR file or an unsupported version");
+        return;
+    }
+
+    auto begin = reinterpret_cast<byte_t const*>(mapping) + sizeof(csr_file_header_t);
+    csr.vertices_count = header.vertices_count;
+    csr.edges_count = header.edges_count;
+    csr.vertices = reinterpret_cast<ustore_key_t const*>(begin);
+    csr.offsets = reinterpret_cast<ustore_size_t const*>(csr.vertices + csr.vertices_count);
+    csr.neighbors = reinterpret_cast<ustore_size_t const*>(csr.offsets + csr.vertices_count + 1);
+    csr.edges_ids = reinterpret_cast<ustore_key_t const*>(csr.neighbors + csr.edges_count);
+    csr.weights = reinterpret_cast<ustore_float_t const*>(csr.edges_ids + csr.edges_count);
+    csr.mapping = mapping;
+    csr.mapping_length = length;
+}
+
+void save_csr(ustore_str_view_t path, csr_builder_t const& builder, ustore_error_t* c_error) {
+    csr_file_header_t header;
+    std::memcpy(header.magic, csr_file_magic_k, sizeof(header.magic));
+    header.version = csr_file_version_k;
+    header.vertices_count = builder.vertices.size();
+    header.edges_count = builder.neighbors.size();
+
+    file_handle_t handle;
+    status_t status = handle.open(path, "wb");
+    return_error_if_m(status, c_error, args_wrong_k, "Couldn't create the CSR file");
+    auto dump = [&](void const* data, std::size_t bytes) noexcept {
+        return !bytes || std::fwrite(data, bytes, 1, handle) == 1;
+    };
+    bool is_written = dump(&header, sizeof(header)) &&
+                      dump(builder.vertices.data(), builder.vertices.size() * sizeof(ustore_key_t)) &&
+                      dump(builder.offsets.data(), builder.offsets.size() * sizeof(ustore_size_t)) &&
+                      dump(builder.neighbors.data(), builder.neighbors.size() * sizeof(ustore_size_t)) &&
+                      dump(builder.edges_ids.data(), builder.edges_ids.size() * sizeof(ustore_key_t)) &&
+                      dump(builder.weights.data(), builder.weights.size() * sizeof(ustore_float_t));
+    status = handle.close();
+    return_error_if_m(is_written && status, c_error, error_unknown_k, "Couldn't write the CSR file");
+}
+
+void ustore_graph_export_csr(ustore_graph_export_csr_t* c_ptr) {
+    trace_span_m("graph_export_csr");
+
+    ustore_graph_export_csr_t& c = *c_ptr;
+    return_error_if_m(c.csr, c.error, args_wrong_k, "No output CSR structure");
+    return_error_if_m(c.role != ustore_vertex_role_unknown_k, c.error, args_wrong_k, "The role must be known");
+    *c.csr = ustore_graph_csr_t {};
+
+    // Supernodes are gathered through a separate arena, as the scan pages through its own
+    csr_builder_t builder;
+    ustore_arena_t chunks_arena = nullptr;
+    auto chunks_options = ustore_options_t(c.options & ~ustore_option_dont_discard_memory_k);
+    auto collection_of = [&](std::size_t) { return c.collection; };
+    auto role_of = [&](std::size_t) { return c.role; };
+    safe_section("Building CSR", c.error, [&] {
+        scan_neighborhoods(c, [&](ustore_key_t vertex, value_view_t value) {
+            if (!is_chunked_neighborhood(value))
+                return builder.append(vertex, value, c.role);
+            linked_memory_lock_t chunks = linked_memory(&chunks_arena, chunks_options, c.error);
+            return_if_error_m(c.error);
+            ptr_range_gt<value_view_t> values {&value, &value + 1};
+            gather_chunks(c.db,
+                          c.transaction,
+                          c.snapshot,
+                          values,
+                          collection_of,
+                          role_of,
+                          false,
+                          c.options,
+                          chunks,
+                          c.error);
+            return_if_error_m(c.error);
+            builder.append(vertex, value, c.role);
+        });
+        return_if_error_m(c.error);
+        builder.index();
+    });
+    ustore_arena_free(chunks_arena);
+    return_if_error_m(c.error);
+
+    if (c.path) {
+        save_csr(c.path, builder, c.error);
+        return_if_error_m(c.error);
+        return map_csr(c.path, *c.csr, c.error);
+    }
+
+    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
+    return_if_error_m(c.error);
+    auto vertices = arena.alloc<ustore_key_t>(builder.vertices.size(), c.error);
+    return_if_error_m(c.error);
+    auto offsets = arena.alloc<ustore_size_t>(builder.offsets.size(), c.error);
+    return_if_error_m(c.error);
+    auto neighbors = arena.alloc<ustore_size_t>(builder.neighbors.size(), c.error);
+    return_if_error_m(c.error);
+    auto edges_ids = arena.alloc<ustore_key_t>(builder.edges_ids.size(), c.error);
+    return_if_error_m(c.error);
+    auto weights = arena.alloc<ustore_float_t>(builder.weights.size(), c.error);
+    return_if_error_m(c.error);
+
+    std::copy(builder.vertices.begin(), builder.vertices.end(), vertices.begin());
+    std::copy(builder.offsets.begin(), builder.offsets.end(), offsets.begin());
+    std::copy_n(builder.indexes(), builder.neighbors.size(), neighbors.begin());
+    std::copy(builder.edges_ids.begin(), builder.edges_ids.end(), edges_ids.begin());
+    std::copy(builder.weights.begin(), builder.weights.end(), weights.begin());
+
+    c.csr->vertices_count = builder.vertices.size();
+    c.csr->edges_count = builder.neighbors.size();
+    c.csr->vertices = vertices.begin();
+    c.csr->offsets = offsets.begin();
+    c.csr->neighbors = neighbors.begin();
+    c.csr->edges_ids = edges_ids.begin();
+    c.csr->weights = weights.begin();
+}
+
+void ustore_graph_open_csr(ustore_graph_open_csr_t* c_ptr) {
+    trace_span_m("graph_open_csr");
+
+    ustore_graph_open_csr_t& c = *c_ptr;
+    return_error_if_m(c.path && c.csr, c.error, args_wrong_k, "Path and output CSR structure are required");
+    *c.csr = ustore_graph_csr_t {};
+    map_csr(c.path, *c.csr, c.error);
+}
+
+void ustore_graph_free_csr(ustore_graph_csr_t* csr) {
+    if (!csr)
+        return;
+    if (csr->mapping)
+        ::munmap(csr->mapping, csr->mapping_length);
+    *csr = ustore_graph_csr_t {};
+}
+
+void ustore_graph_find_csr_edges(ustore_graph_find_csr_edges_t* c_ptr) {
+    trace_span_m("graph_find_csr_edges");
+
+    ustore_graph_find_csr_edges_t& c = *c_ptr;
+    if (!c.tasks_count)
+        return;
+    return_error_if_m(c.csr, c.error, args_wrong_k, "No CSR to search");
+
+    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
+    return_if_error_m(c.error);
+
+    ustore_graph_csr_t const& csr = *c.csr;
+    strided_iterator_gt<ustore_key_t const> vertices {c.vertices, c.vertices_stride};
+    auto locate = [&](ustore_key_t vertex) noexcept {
+        auto it = std::lower_bound(csr.vertices, csr.vertices + csr.vertices_count, vertex);
+        return it != csr.vertices + csr.vertices_count && *it == vertex ? std::size_t(it - csr.vertices)
+                                                                        : csr.vertices_count;
+    };
+
+    auto degrees = arena.alloc_or_dummy(c.tasks_count, c.error, c.degrees_per_vertex);
+    return_if_error_m(c.error);
+    std::size_t count_edges = 0;
+    for (std::size_t i = 0; i != c.tasks_count; ++i) {
+        std::size_t idx = locate(vertices[i]);
+        bool found = idx != csr.vertices_count;
+        std::size_t degree = found ? csr.offsets[idx + 1] - csr.offsets[idx] : 0;
+        degrees[i] = found ? static_cast<ustore_vertex_degree_t>(degree) : ustore_vertex_degree_missing_k;
+        count_edges += degree;
+    }
+    if (!c.edges_per_vertex)
+        return;
+
+    auto ids = arena.alloc<ustore_key_t>(count_edges * 3, c.error);
+    return_if_error_m(c.error);
+    *c.edges_per_vertex = ids.begin();
+    bool center_is_target = c.role == ustore_vertex_target_k;
+    for (std::size_t i = 0, passed_ids = 0; i != c.tasks_count; ++i) {
+        if (degrees[i] == ustore_vertex_degree_missing_k)
+            continue;
+        std::size_t idx = locate(vertices[i]);
+        for (std::size_t j = csr.offsets[idx]; j != csr.offsets[idx + 1]; ++j, passed_ids += 3) {
+            ids[passed_ids + center_is_target] = vertices[i];
+            ids[passed_ids + !center_is_target] = csr.vertices[csr.neighbors[j]];
+            ids[passed_ids + 2] = csr.edges_ids[j];
+        }
+    }
+}
+
+/*********************************************************/
+/*****************	      Analytics		  ****************/
+/*********************************************************/
+
+constexpr std::size_t analytics_write_batch_k = 1024 * 1024;
+
+/**
+ * @brief Exports the per-vertex @p results of an analytics kernel, optionally
+ * writing them into the `output_collection` in bounded batches.
+ */
+template <typename analytics_at, typename scalar_at>
+void export_per_vertex(analytics_at& c,
+                       ptr_range_gt<scalar_at> results,
+                       scalar_at** output,
+                       linked_memory_lock_t& arena) noexcept {
+
+    if (output)
+        *output = results.begin();
+    if (!c.output_collection || results.empty())
+        return;
+
+    // All values have the same length, so a single range of offsets serves every batch
+    std::size_t batch_size = std::min(analytics_write_batch_k, results.size());
+    auto offsets = arena.alloc<ustore_length_t>(batch_size, c.error);
+    return_if_error_m(c.error);
+    for (std::size_t i = 0; i != batch_size; ++i)
+        offsets[i] = static_cast<ustore_length_t>(i * sizeof(scalar_at));
+    ustore_length_t length = sizeof(scalar_at);
+
+    for (std::size_t begin = 0; begin < results.size(); begin += batch_size) {
+        auto values = reinterpret_cast<ustore_bytes_cptr_t>(results.begin() + begin);
+        ustore_write_t write {};
+        write.db = c.db;
+        write.error = c.error;
+        write.transaction = c.transaction;
+        write.arena = arena;
+        write.options = c.options;
+        write.tasks_count = std::min(batch_size, results.size() - begin);
+        write.collections = c.output_collection;
+        write.keys = c.csr->vertices + begin;
+        write.keys_stride = sizeof(ustore_key_t);
+        write.offsets = offsets.begin();
+        write.offsets_stride = sizeof(ustore_length_t);
+        write.lengths = &length;
+        write.values = &values;
+
+        ustore_write(&write);
+        return_if_error_m(c.error);
+    }
+}
+
+/**
+ * @brief Labels every vertex with the ID of the smallest member of its community.
+ */
+void label_communities(ustore_graph_csr_t const& csr,
+                       std::vector<ustore_size_t> const& communities,
+                       ptr_range_gt<ustore_key_t> labels) noexcept(false) {
+
+    std::vector<ustore_size_t> representatives(csr.vertices_count, graph_unreachable_k);
+    for (std::size_t vertex_idx = 0; vertex_idx != csr.vertices_count; ++vertex_idx) {
+        ustore_size_t& representative = representatives[communities[vertex_idx]];
+        if (representative == graph_unreachable_k)
+            representative = vertex_idx;
+        labels[vertex_idx] = csr.vertices[representative];
+    }
+}
+
+void ustore_graph_pagerank(ustore_graph_pagerank_t* c_ptr) {
+    trace_span_m("graph_pagerank");
+
+    ustore_graph_pagerank_t& c = *c_ptr;
+    return_error_if_m(c.csr, c.error, args_wrong_k, "No CSR to analyze");
+    return_error_if_m(c.damping >= 0 && c.damping < 1, c.error, args_wrong_k, "Damping must be in [0, 1)");
+
+    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
+    return_if_error_m(c.error);
+    auto scores = arena.alloc<ustore_float_t>(c.csr->vertices_count, c.error);
+    return_if_error_m(c.error);
+
+    safe_section("Ranking vertices", c.error, [&] {
+        std::vector<double> ranks;
+        pagerank(*c.csr,
+                 c.damping != 0 ? c.damping : 0.85,
+                 c.tolerance != 0 ? c.tolerance : 1e-6,
+                 c.iterations_limit ? c.iterations_limit : 100,
+                 ranks);
+        std::transform(ranks.begin(), ranks.end(), scores.begin(), [](double rank) {
+            return static_cast<ustore_float_t>(rank);
+        });
+    });
+    return_if_error_m(c.error);
+    export_per_vertex(c, scores, c.scores, arena);
+}
+
+void ustore_graph_components(ustore_graph_components_t* c_ptr) {
+    trace_span_m("graph_components");
+
+    ustore_graph_components_t& c = *c_ptr;
+    return_error_if_m(c.csr, c.error, args_wrong_k, "No CSR to analyze");
+
+    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
+    return_if_error_m(c.error);
+    auto labels = arena.alloc<ustore_key_t>(c.csr->vertices_count, c.error);
+    return_if_error_m(c.error);
+
+    safe_section("Finding components", c.error, [&] {
+        std::vector<ustore_size_t> roots;
+        connected_components(*c.csr, roots);
+        for (std::size_t vertex_idx = 0; vertex_idx != roots.size(); ++vertex_idx)
+            labels[vertex_idx] = c.csr->vertices[roots[vertex_idx]];
+    });
+    return_if_error_m(c.error);
+    export_per_vertex(c, labels, c.labels, arena);
+}
+
+void ustore_graph_bfs(ustore_graph_bfs_t* c_ptr) {
+    trace_span_m("graph_bfs");
+
+    ustore_graph_bfs_t& c = *c_ptr;
+    return_error_if_m(c.csr, c.error, args_wrong_k, "No CSR to analyze");
+
+    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
+    return_if_error_m(c.error);
+    ustore_graph_csr_t const& csr = *c.csr;
+    auto levels = arena.alloc<ustore_length_t>(csr.vertices_count, c.error);
+    return_if_error_m(c.error);
+
+    strided_range_gt<ustore_key_t const> sources {{c.sources, c.sources_stride}, c.sources_count};
+    safe_section("Searching breadth-first", c.error, [&] {
+        std::vector<ustore_size_t> sources_indexes;
+        for (ustore_key_t source : sources) {
+            auto it = std::lower_bound(csr.vertices, csr.vertices + csr.vertices_count, source);
+            if (it != csr.vertices + csr.vertices_count && *it == source)
+                sources_indexes.push_back(static_cast<ustore_size_t>(it - csr.vertices));
+        }
+
+        std::vector<ustore_size_t> hops;
+        breadth_first_levels(csr, sources_indexes, hops);
+        std::transform(hops.begin(), hops.end(), levels.begin(), [](ustore_size_t hop) {
+            return hop == graph_unreachable_k ? ustore_length_missing_k : static_cast<ustore_length_t>(hop);
+        });
+    });
+    return_if_error_m(c.error);
+    export_per_vertex(c, levels, c.levels, arena);
+}
+
+void ustore_graph_louvain(ustore_graph_louvain_t* c_ptr) {
+    trace_span_m("graph_louvain");
+
+    ustore_graph_louvain_t& c = *c_ptr;
+    return_error_if_m(c.csr, c.error, args_wrong_k, "No CSR to analyze");
+
+    linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
+    return_if_error_m(c.error);
+    auto labels = arena.alloc<ustore_key_t>(c.csr->vertices_count, c.error);
+    return_if_error_m(c.error);
+
+    safe_section("Detecting communities", c.error, [&] {
+        std::vector<ustore_size_t> partition;
+        double quality = louvain(*c.csr,
+                                 c.min_modularity_growth != 0 ? c.min_modularity_growth : 1e-7,
+                                 c.passes_limit ? c.passes_limit : std::numeric_limits<std::size_t>::max(),
+                                 partition);
+        label_communities(*c.csr, partition, labels);
+        if (c.modularity)
+            *c.modularity = static_cast<ustore_float_t>(quality);
+    });
+    return_if_error_m(c.error);
+    export_per_vertex(c, labels, c.labels, arena);
+}
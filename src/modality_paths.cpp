@@ -7,24 +7,39 @@
  *
  * For every string key hash we store:
  * - N = number of entries (1 if no collisions appeared)
- * - N key offsets
- * - N value lengths
+ * - N one-byte fingerprints of keys
+ * - N+1 key offsets
+ * - N+1 value offsets
  * - N concatenated keys
  * - N concatenated values
  *
  * ## Mirror "Directory" Entries for Nested Paths
  *
- * Furthermore, we need to store mirror entries, that will
- * store the directory tree. In other words, for an input
- * like @b home/user/media/name we would keep:
- * - home/: @b home/user
- * - home/user/: @b home/user/media
- * - home/user/media/: @b home/user/media/name
+ * Furthermore, if the `path_separator` is passed on writes, we
+ * store mirror entries, that reflect the directory tree. In other
+ * words, for an input like @b home/user/media/name we would keep:
+ * - (root): @b home/
+ * - home/: @b user/
+ * - home/user/: @b media/
+ * - home/user/media/: @b name
  *
- * The mirror "directory" entries can have negative IDs.
- * Their values would be structured differently.
+ * The mirror "directory" entries are regular bucket members with
+ * NUL-prefixed keys. Their values are sorted lists of children names.
+ * Prefix matches with the same separator walk that tree, instead of
+ * scanning the whole collection.
  */
 
+#include <cctype>        // `std::isdigit`
+#include <map>           // `std::map`
+#include <memory>        // `std::shared_ptr`
+#include <mutex>         // `std::mutex`
+#include <numeric>       // `std::partial_sum`
+#include <set>           // `std::set`
+#include <string>        // `std::string`
+#include <thread>        // `std::thread::hardware_concurrency`
+#include <unordered_map> // `std::unordered_map`
+#include <vector>        // `std::vector`
+
 #define PCRE2_CODE_UNIT_WIDTH 8
 #include <pcre2.h>
 
@@ -35,6 +50,10 @@
 #include "helpers/linked_array.hpp"  // `uninitialized_array_gt`
 #include "helpers/algorithm.hpp"     // `sort_and_deduplicate`
 #include "helpers/full_scan.hpp"     // `full_scan_collection`
+#include "helpers/merge.hpp"         // `can_merge`
+#include "helpers/parallel.hpp"      // `thread_pool_t`
+#include "helpers/hash.hpp"          // `hash_bytes`
+#include "helpers/trace.hpp"         // `trace_span_m`
 
 /*********************************************************/
 /*****************	 C++ Implementation	  ****************/
@@ -43,10 +62,28 @@
 using namespace unum::ustore;
 using namespace unum;
 
+/**
+ * @brief Maps paths to the IDs of their buckets. The hash is persisted,
+ * so unlike `std::hash`, it must be identical on every platform.
+ */
 struct hash_t {
     ustore_key_t operator()(std::string_view key_str) const noexcept {
-        using ucset_t = std::hash<std::string_view>;
-        auto result = ucset_t {}(key_str);
+        auto result = hash_bytes(key_str.data(), key_str.size());
+#ifdef USTORE_DEBUG
+        result %= 10ul;
+#endif
+        return static_cast<ustore_key_t>(result);
+    }
+};
+
+/**
+ * @brief Bucket IDs used before `hash_t` switched to `hash_bytes`.
+ * Paths, missing from their buckets, are also looked up in their legacy ones,
+ * and are moved out of those on their next update, so older collections stay readable.
+ */
+struct legacy_hash_t {
+    ustore_key_t operator()(std::string_view key_str) const noexcept {
+        auto result = std::hash<std::string_view> {}(key_str);
 #ifdef USTORE_DEBUG
         result %= 10ul;
 #endif
@@ -54,25 +91,96 @@ struct hash_t {
     }
 };
 
+/**
+ * @brief Members of the same bucket share the primary hash,
+ * so fingerprints must be derived from an independent one.
+ */
+constexpr std::uint64_t fingerprint_seed_k = 0x9E3779B97F4A7C15ull;
+
+std::uint8_t fingerprint(std::string_view key_str) noexcept {
+    return static_cast<std::uint8_t>(hash_bytes(key_str.data(), key_str.size(), fingerprint_seed_k) >> 56);
+}
+
+/**
+ * @brief Buckets come in two layouts, distinguished by the top bit of the first counter.
+ *
+ * The legacy layout stores:
+ * - N = number of entries
+ * - N key lengths, N value lengths
+ * - N concatenated keys, N concatenated values
+ *
+ * The fingerprinted layout, used for all new writes, stores:
+ * - N = number of entries, with the top bit set
+ * - N one-byte key fingerprints, padded to a multiple of 8 bytes
+ * - N+1 key offsets, N+1 value offsets, counted from the bucket start
+ * - N concatenated keys, N concatenated values
+ *
+ * So a lookup compares fingerprints eight at a time, and only touches
+ * the keys, that match, instead of recomputing offsets and comparing all keys.
+ */
 constexpr std::size_t counter_size_k = sizeof(ustore_length_t);
 constexpr std::size_t bytes_in_header_k = counter_size_k;
+constexpr ustore_length_t fingerprinted_bucket_flag_k = ustore_length_t(1u) << 31;
+constexpr std::size_t fingerprints_alignment_k = sizeof(std::uint64_t);
 
 ustore_length_t get_bucket_size(value_view_t bucket) noexcept {
     auto lengths = reinterpret_cast<ustore_length_t const*>(bucket.data());
-    return bucket.size() > bytes_in_header_k ? *lengths : 0u;
+    return bucket.size() > bytes_in_header_k ? (*lengths & ~fingerprinted_bucket_flag_k) : 0u;
 }
 
-ptr_range_gt<ustore_length_t const> get_bucket_counters(value_view_t bucket, ustore_length_t size) noexcept {
+bool is_fingerprinted_bucket(value_view_t bucket) noexcept {
     auto lengths = reinterpret_cast<ustore_length_t const*>(bucket.data());
-    return {lengths, lengths + size * 2u + 1u};
+    return bucket.size() > bytes_in_header_k && (*lengths & fingerprinted_bucket_flag_k);
+}
+
+std::size_t bytes_for_fingerprints(std::size_t size) noexcept {
+    return divide_round_up(size, fingerprints_alignment_k) * fingerprints_alignment_k;
 }
 
+/**
+ * @brief Parsed view of a fingerprinted bucket.
+ */
+struct fingerprinted_bucket_t {
+    ustore_length_t size = 0;
+    std::uint8_t const* fingerprints = nullptr;
+    ustore_length_t const* keys_offsets = nullptr;
+    ustore_length_t const* vals_offsets = nullptr;
+    char const* begin = nullptr;
+
+    fingerprinted_bucket_t(value_view_t bucket, ustore_length_t bucket_size) noexcept
+        : size(bucket_size), fingerprints(reinterpret_cast<std::uint8_t const*>(bucket.data()) + bytes_in_header_k),
+          keys_offsets(reinterpret_cast<ustore_length_t const*>(fingerprints + bytes_for_fingerprints(size))),
+          vals_offsets(keys_offsets + size + 1u), begin(bucket.c_str()) {}
+
+    std::string_view key(std::size_t i) const noexcept {
+        return {begin + keys_offsets[i], keys_offsets[i + 1] - keys_offsets[i]};
+    }
+    value_view_t value(std::size_t i) const noexcept {
+        return {reinterpret_cast<byte_t const*>(begin) + vals_offsets[i], vals_offsets[i + 1] - vals_offsets[i]};
+    }
+    std::string_view keys_joined() const noexcept {
+        return {begin + keys_offsets[0], keys_offsets[size] - keys_offsets[0]};
+    }
+};
+
 consecutive_strs_iterator_t get_bucket_keys(value_view_t bucket, ustore_length_t size) noexcept {
     auto lengths = reinterpret_cast<ustore_length_t const*>(bucket.data());
     auto bytes_for_counters = size * 2u * counter_size_k;
     return {lengths + 1u, bucket.data() + bytes_in_header_k + bytes_for_counters};
 }
 
+/**
+ * @brief All the keys of the bucket, concatenated without any separators.
+ */
+std::string_view get_bucket_keys_joined(value_view_t bucket, ustore_length_t size) noexcept {
+    if (is_fingerprinted_bucket(bucket))
+        return fingerprinted_bucket_t(bucket, size).keys_joined();
+    auto lengths = reinterpret_cast<ustore_length_t const*>(bucket.data());
+    auto bytes_for_counters = size * 2u * counter_size_k;
+    auto bytes_for_keys = std::accumulate(lengths + 1u, lengths + 1u + size, 0ul);
+    return {bucket.c_str() + bytes_in_header_k + bytes_for_counters, bytes_for_keys};
+}
+
 consecutive_blobs_iterator_t get_bucket_vals(value_view_t bucket, ustore_length_t size) noexcept {
     auto lengths = reinterpret_cast<ustore_length_t const*>(bucket.data());
     auto bytes_for_counters = size * 2u * counter_size_k;
@@ -93,6 +201,12 @@ void for_each_in_bucket(value_view_t bucket, bucket_member_callback_at member_ca
     auto bucket_size = get_bucket_size(bucket);
     if (!bucket_size)
         return;
+    if (is_fingerprinted_bucket(bucket)) {
+        fingerprinted_bucket_t parsed {bucket, bucket_size};
+        for (std::size_t i = 0; i != bucket_size; ++i)
+            member_callback(bucket_member_t {i, parsed.key(i), parsed.value(i)});
+        return;
+    }
     auto bucket_keys = get_bucket_keys(bucket, bucket_size);
     auto bucket_vals = get_bucket_vals(bucket, bucket_size);
     for (std::size_t i = 0; i != bucket_size; ++i, ++bucket_keys, ++bucket_vals)
@@ -101,10 +215,36 @@ void for_each_in_bucket(value_view_t bucket, bucket_member_callback_at member_ca
 
 bucket_member_t find_in_bucket(value_view_t bucket, std::string_view key_str) noexcept {
     bucket_member_t result;
-    for_each_in_bucket(bucket, [&](bucket_member_t const& member) {
-        if (member.key == key_str)
-            result = member;
-    });
+    auto bucket_size = get_bucket_size(bucket);
+    if (!bucket_size)
+        return result;
+
+    if (!is_fingerprinted_bucket(bucket)) {
+        for_each_in_bucket(bucket, [&](bucket_member_t const& member) {
+            if (member.key == key_str)
+                result = member;
+        });
+        return result;
+    }
+
+    // Compare eight fingerprints at a time, "SIMD Within A Register". The zero-byte
+    // detection may report false positives above a real match, but never misses one.
+    // The padding past the last fingerprint is skipped by the bounds check below.
+    fingerprinted_bucket_t parsed {bucket, bucket_size};
+    std::uint64_t const low_bits = 0x0101010101010101ull;
+    std::uint64_t const high_bits = 0x8080808080808080ull;
+    std::uint64_t const broadcasted = low_bits * fingerprint(key_str);
+    for (std::size_t i = 0; i < bucket_size; i += fingerprints_alignment_k) {
+        std::uint64_t word;
+        std::memcpy(&word, parsed.fingerprints + i, sizeof(word));
+        word ^= broadcasted;
+        if (!((word - low_bits) & ~word & high_bits))
+            continue;
+        auto end = std::min<std::size_t>(i + fingerprints_alignment_k, bucket_size);
+        for (std::size_t j = i; j != end; ++j)
+            if (parsed.fingerprints[j] == static_cast<std::uint8_t>(broadcasted) && parsed.key(j) == key_str)
+                return {j, parsed.key(j), parsed.value(j)};
+    }
     return result;
 }
 
@@ -146,105 +286,598 @@ bool is_prefix(std::string_view prefix_or_pattern) noexcept {
 }
 
 /**
- * @brief Removes part of variable length string.
- * @return The shortened view of the input. Will start from same address.
+ * @brief Single upsert or removal of a path within a bucket.
+ * Removals are marked with missing values.
+ */
+struct bucket_change_t {
+    std::string_view key;
+    value_view_t value;
+};
+
+/**
+ * @brief Sorts the @p changes by key, keeping only the last change of every key.
+ * @return The end of the remaining unique changes.
  */
-value_view_t remove_part(value_view_t full, value_view_t part) noexcept {
-    auto removed_length = part.size();
-    auto moved_length = full.size() - part.size();
-    std::memmove((void*)part.begin(), (void*)part.end(), moved_length);
-    return {full.begin(), full.size() - removed_length};
+bucket_change_t* deduplicate_changes(bucket_change_t* begin, bucket_change_t* end) noexcept {
+    auto less = [](bucket_change_t const& a, bucket_change_t const& b) noexcept { return a.key < b.key; };
+    std::stable_sort(begin, end, less);
+    auto output = begin;
+    for (auto it = begin; it != end; ++it) {
+        bool is_last = it + 1 == end || it[1].key != it->key;
+        if (is_last)
+            *output++ = *it;
+    }
+    return output;
 }
 
-void remove_from_bucket(value_view_t& bucket, std::string_view key_str) noexcept {
-    // If the entry was present, it must be clamped.
-    // Matching key and length entry will be removed.
-    auto [old_idx, old_key, old_val] = find_in_bucket(bucket, key_str);
-    if (!old_val)
-        return;
+/**
+ * @brief Rebuilds the @p bucket in the fingerprinted layout, applying all the
+ * @p changes at once. Those must be sorted and unique, @see `deduplicate_changes`.
+ * Legacy buckets are converted on their first update.
+ */
+void update_in_bucket( //
+    value_view_t& bucket,
+    ptr_range_gt<bucket_change_t const> changes,
+    linked_memory_lock_t& arena,
+    ustore_error_t* c_error) noexcept {
+
+    auto is_changed = [&](std::string_view key) noexcept {
+        auto it = std::lower_bound(changes.begin(), changes.end(), key, [](bucket_change_t const& change, auto key) {
+            return change.key < key;
+        });
+        return it != changes.end() && it->key == key;
+    };
 
-    // Most of the time slots contain just one entry
-    auto old_size = get_bucket_size(bucket);
-    if (old_size == 1) {
+    std::size_t new_size = 0;
+    std::size_t bytes_for_contents = 0;
+    bool touches_members = false;
+    for_each_in_bucket(bucket, [&](bucket_member_t const& member) {
+        if (is_changed(member.key)) {
+            touches_members = true;
+            return;
+        }
+        ++new_size;
+        bytes_for_contents += member.key.size() + member.value.size();
+    });
+    for (bucket_change_t const& change : changes) {
+        if (!change.value)
+            continue;
+        ++new_size;
+        bytes_for_contents += change.key.size() + change.value.size();
+    }
+    if (!new_size) {
         bucket = {};
         return;
     }
+    // Removals of missing entries alone don't need a rebuild
+    bool has_upserts = std::any_of(changes.begin(), changes.end(), [](bucket_change_t const& change) {
+        return static_cast<bool>(change.value);
+    });
+    if (!has_upserts && !touches_members)
+        return;
+
+    auto bytes_before_contents =
+        bytes_in_header_k + bytes_for_fingerprints(new_size) + (new_size + 1u) * 2u * counter_size_k;
+    auto new_bytes = bytes_before_contents + bytes_for_contents;
+    auto new_begin = arena.alloc<byte_t>(new_bytes, c_error).begin();
+    return_if_error_m(c_error);
 
-    bucket = remove_part(bucket, old_val);
-    bucket = remove_part(bucket, old_key);
+    std::memset(new_begin, 0, bytes_before_contents);
+    auto new_header = reinterpret_cast<ustore_length_t*>(new_begin);
+    *new_header = static_cast<ustore_length_t>(new_size) | fingerprinted_bucket_flag_k;
+    auto new_fingerprints = reinterpret_cast<std::uint8_t*>(new_begin + bytes_in_header_k);
+    auto new_keys_offsets = reinterpret_cast<ustore_length_t*>(new_fingerprints + bytes_for_fingerprints(new_size));
+    auto new_vals_offsets = new_keys_offsets + new_size + 1u;
 
-    // Remove the value counter
-    auto begin = bucket.data();
-    value_view_t value_length_bytes {begin + counter_size_k * (old_size + old_idx + 1u), counter_size_k};
-    bucket = remove_part(bucket, value_length_bytes);
-    value_view_t key_length_bytes {begin + counter_size_k * (old_idx + 1u), counter_size_k};
-    bucket = remove_part(bucket, key_length_bytes);
+    // Keys and values are written in two passes, to keep them in separate contiguous ranges
+    std::size_t new_idx = 0;
+    ustore_length_t progress = static_cast<ustore_length_t>(bytes_before_contents);
+    auto append_key = [&](std::string_view member_key) {
+        new_fingerprints[new_idx] = fingerprint(member_key);
+        new_keys_offsets[new_idx++] = progress;
+        std::memcpy(new_begin + progress, member_key.data(), member_key.size());
+        progress += static_cast<ustore_length_t>(member_key.size());
+    };
+    auto append_val = [&](value_view_t member_val) {
+        new_vals_offsets[new_idx++] = progress;
+        if (member_val.size())
+            std::memcpy(new_begin + progress, member_val.data(), member_val.size());
+        progress += static_cast<ustore_length_t>(member_val.size());
+    };
+
+    for_each_in_bucket(bucket, [&](bucket_member_t const& member) {
+        if (!is_changed(member.key))
+            append_key(member.key);
+    });
+    for (bucket_change_t const& change : changes)
+        if (change.value)
+            append_key(change.key);
+    new_keys_offsets[new_idx] = progress;
 
-    // Decrement the size
-    auto lengths = (ustore_length_t*)begin;
-    lengths[0] -= 1u;
+    new_idx = 0;
+    for_each_in_bucket(bucket, [&](bucket_member_t const& member) {
+        if (!is_changed(member.key))
+            append_val(member.value);
+    });
+    for (bucket_change_t const& change : changes)
+        if (change.value)
+            append_val(change.value);
+    new_vals_offsets[new_idx] = progress;
+
+    bucket = {new_begin, new_bytes};
 }
 
-void upsert_in_bucket( //
-    value_view_t& bucket,
-    std::string_view key,
-    value_view_t val,
+/**
+ * @brief Every `merge_kind_t::paths_bucket_k` operand contains a single upsert or
+ * removal: a presence byte, key and value lengths, followed by their contents.
+ */
+struct path_merge_header_t {
+    ustore_length_t key_length = 0;
+    ustore_length_t value_length = 0;
+    bool present = false;
+};
+
+constexpr std::size_t bytes_in_path_merge_header_k = bytes_in_merge_header_k + sizeof(path_merge_header_t);
+
+bool unum::ustore::merge_paths_bucket(value_view_t base, merge_operands_t operands, std::string& result) noexcept {
+    ustore_arena_t c_arena = nullptr;
+    ustore_error_t error = nullptr;
+    {
+        linked_memory_lock_t arena = linked_memory(&c_arena, ustore_options_default_k, &error);
+
+        // Copying into the arena keeps the counters aligned
+        auto bucket_copy = arena.alloc<byte_t>(base.size(), &error);
+        if (!error && base.size())
+            std::memcpy(bucket_copy.begin(), base.data(), base.size());
+        value_view_t bucket = base ? value_view_t {bucket_copy.begin(), base.size()} : value_view_t {};
+
+        // Parse all the operands first, to rebuild the bucket only once
+        auto changes = arena.alloc<bucket_change_t>(operands.size(), &error);
+        for (std::size_t i = 0; !error && i != operands.size(); ++i) {
+            value_view_t operand = operands[i];
+            path_merge_header_t header;
+            if (operand.size() < bytes_in_path_merge_header_k) {
+                error = "Corrupted operand";
+                break;
+            }
+            std::memcpy(&header, operand.data() + bytes_in_merge_header_k, sizeof(path_merge_header_t));
+            if (operand.size() != bytes_in_path_merge_header_k + header.key_length + header.value_length) {
+                error = "Corrupted operand";
+                break;
+            }
+            auto key_begin = operand.c_str() + bytes_in_path_merge_header_k;
+            std::string_view key_str {key_begin, header.key_length};
+            value_view_t value {key_begin + header.key_length, header.value_length};
+            changes[i] = {key_str, header.present ? value : value_view_t {}};
+        }
+
+        if (!error) {
+            auto changes_end = deduplicate_changes(changes.begin(), changes.end());
+            update_in_bucket(bucket, {changes.begin(), changes_end}, arena, &error);
+        }
+
+        if (!error)
+            safe_section("Exporting the bucket", &error, [&] { result = std::string(bucket); });
+    }
+    clear_linked_memory(c_arena);
+    return !error;
+}
+
+/**
+ * @brief Mirror "directory" entries live in the same buckets as regular paths, under
+ * reserved keys made of a NUL character followed by the directory path, including
+ * the trailing separator. The root directory is addressed by a lonely NUL character.
+ * Their values concatenate the NUL-terminated names of children in sorted order.
+ * Nested directories keep the trailing separator in their names, leaves never do.
+ */
+constexpr char directory_marker_k = '\0';
+
+bool is_directory_entry(std::string_view key_str) noexcept {
+    return !key_str.empty() && key_str.front() == directory_marker_k;
+}
+
+std::string directory_entry_key(std::string_view directory) {
+    std::string key_str;
+    key_str.reserve(directory.size() + 1);
+    key_str.push_back(directory_marker_k);
+    key_str.append(directory);
+    return key_str;
+}
+
+template <typename child_callback_at>
+void for_each_child(value_view_t listing, child_callback_at&& child_callback) {
+    std::string_view names {listing.c_str(), listing.size()};
+    while (!names.empty()) {
+        auto name_length = names.find('\0');
+        if (name_length == std::string_view::npos)
+            name_length = names.size();
+        if (!child_callback(names.substr(0, name_length)))
+            break;
+        names.remove_prefix(std::min(name_length + 1, names.size()));
+    }
+}
+
+/**
+ * @brief Fetches the listings of multiple directories in a single batch.
+ * Missing directories are exported as empty views.
+ */
+std::vector<value_view_t> read_directories( //
+    ustore_database_t c_db,
+    ustore_transaction_t c_transaction,
+    std::vector<ustore_collection_t> const& collections,
+    std::vector<std::string> const& keys,
+    ustore_options_t c_options,
     linked_memory_lock_t& arena,
-    ustore_error_t* c_error) noexcept {
+    ustore_error_t* c_error) {
 
-    auto old_size = get_bucket_size(bucket);
-    auto old_bytes_for_counters = old_size * 2u * counter_size_k;
-    auto old_lengths = reinterpret_cast<ustore_length_t const*>(bucket.data());
-    auto old_bytes_for_keys = bucket ? std::accumulate(old_lengths + 1u, old_lengths + 1u + old_size, 0ul) : 0ul;
-    auto old_bytes_for_vals =
-        bucket ? std::accumulate(old_lengths + 1u + old_size, old_lengths + 1u + old_size * 2ul, 0ul) : 0ul;
-    auto [old_idx, old_key, old_val] = find_in_bucket(bucket, key);
-    bool is_missing = !old_val;
-
-    auto new_size = old_size + is_missing;
-    auto new_bytes_for_counters = new_size * 2u * counter_size_k;
-    auto new_bytes_for_keys = old_bytes_for_keys - old_key.size() + key.size();
-    auto new_bytes_for_vals = old_bytes_for_vals - old_val.size() + val.size();
-    auto new_bytes = bytes_in_header_k + new_bytes_for_counters + new_bytes_for_keys + new_bytes_for_vals;
+    std::vector<ustore_str_view_t> keys_begins(keys.size());
+    std::vector<ustore_length_t> keys_lengths(keys.size());
+    for (std::size_t i = 0; i != keys.size(); ++i)
+        keys_begins[i] = keys[i].data(), keys_lengths[i] = static_cast<ustore_length_t>(keys[i].size());
+
+    ustore_length_t* listings_offsets = nullptr;
+    ustore_length_t* listings_lengths = nullptr;
+    ustore_byte_t* listings_values = nullptr;
+    ustore_paths_read_t read {};
+    read.db = c_db;
+    read.error = c_error;
+    read.transaction = c_transaction;
+    read.arena = arena;
+    read.options = c_options;
+    read.tasks_count = static_cast<ustore_size_t>(keys.size());
+    read.collections = collections.data();
+    read.collections_stride = sizeof(ustore_collection_t);
+    read.paths = keys_begins.data();
+    read.paths_stride = sizeof(ustore_str_view_t);
+    read.paths_lengths = keys_lengths.data();
+    read.paths_lengths_stride = sizeof(ustore_length_t);
+    read.offsets = &listings_offsets;
+    read.lengths = &listings_lengths;
+    read.values = &listings_values;
+    ustore_paths_read(&read);
+
+    std::vector<value_view_t> listings(keys.size());
+    if (*c_error)
+        return listings;
+    for (std::size_t i = 0; i != keys.size(); ++i)
+        if (listings_lengths[i] != ustore_length_missing_k)
+            listings[i] = value_view_t {listings_values + listings_offsets[i], listings_lengths[i]};
+    return listings;
+}
 
-    auto new_begin = arena.alloc<byte_t>(new_bytes, c_error).begin();
-    return_if_error_m(c_error);
-    auto new_lengths = reinterpret_cast<ustore_length_t*>(new_begin);
-    new_lengths[0] = new_size;
-    auto new_keys_lengths = new_lengths + 1ul;
-    auto new_vals_lengths = new_lengths + 1ul + new_size;
-    auto new_keys_output = new_begin + bytes_in_header_k + new_bytes_for_counters;
-    auto new_vals_output = new_begin + bytes_in_header_k + new_bytes_for_counters + new_bytes_for_keys;
-
-    auto old_keys = get_bucket_keys(bucket, old_size);
-    auto old_vals = get_bucket_vals(bucket, old_size);
-    std::size_t new_idx = 0;
-    for (std::size_t i = 0; i != old_size; ++i, ++old_keys, ++old_vals) {
-        if (!is_missing && i == old_idx)
-            continue;
+/**
+ * @brief Updates the mirror "directory" entries of every path in the batch.
+ * Upserts register the path in every one of its parent directories, while
+ * removals unregister it and clean up the directories, that became empty.
+ *
+ * The update is a Read-Modify-Write of the listings. Concurrent writers
+ * into the same directories should use transactions to avoid lost updates.
+ */
+void update_directories(ustore_paths_write_t& c, contents_arg_t const& keys_str_args, linked_memory_lock_t& arena) {
+
+    struct directory_t {
+        std::set<std::string> children;
+        bool changed = false;
+    };
+    using directory_key_t = std::pair<ustore_collection_t, std::string>;
+
+    strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
+    bits_view_t presences {c.values_presences};
+    strided_iterator_gt<ustore_length_t const> offs {c.values_offsets, c.values_offsets_stride};
+    strided_iterator_gt<ustore_length_t const> lens {c.values_lengths, c.values_lengths_stride};
+    strided_iterator_gt<ustore_bytes_cptr_t const> vals {c.values_bytes, c.values_bytes_stride};
+    contents_arg_t contents {presences, offs, lens, vals, c.tasks_count};
+    char const separator = c.path_separator;
+
+    safe_section("Updating directories", c.error, [&] {
+        // Collect all the parent directories, including the root one
+        std::map<directory_key_t, directory_t> directories;
+        for (std::size_t i = 0; i != c.tasks_count; ++i) {
+            std::string_view key_str = keys_str_args[i];
+            auto collection = collections ? collections[i] : ustore_collection_main_k;
+            directories[{collection, {}}];
+            for (auto split = key_str.find(separator); split != std::string_view::npos;
+                 split = key_str.find(separator, split + 1))
+                directories[{collection, std::string(key_str.substr(0, split + 1))}];
+        }
+
+        std::vector<ustore_collection_t> read_collections;
+        std::vector<std::string> read_keys;
+        read_collections.reserve(directories.size());
+        read_keys.reserve(directories.size());
+        for (auto const& [collection_and_directory, _] : directories)
+            read_collections.push_back(collection_and_directory.first),
+                read_keys.push_back(directory_entry_key(collection_and_directory.second));
+
+        auto opts = c.transaction ? ustore_options_t(c.options & ~ustore_option_transaction_dont_watch_k) : c.options;
+        auto listings = read_directories(c.db, c.transaction, read_collections, read_keys, opts, arena, c.error);
+        return_if_error_m(c.error);
+        std::size_t listing_idx = 0;
+        for (auto& [_, directory] : directories)
+            for_each_child(listings[listing_idx++], [&](std::string_view name) {
+                directory.children.emplace(name);
+                return true;
+            });
+
+        // Apply the updates in the order they were submitted
+        for (std::size_t i = 0; i != c.tasks_count; ++i) {
+            std::string_view key_str = keys_str_args[i];
+            auto collection = collections ? collections[i] : ustore_collection_main_k;
+            auto last_split = key_str.rfind(separator);
+            auto leaf_offset = last_split == std::string_view::npos ? 0 : last_split + 1;
+
+            if (contents[i]) {
+                std::size_t parent_length = 0;
+                for (auto split = key_str.find(separator); split != std::string_view::npos;
+                     split = key_str.find(separator, split + 1)) {
+                    auto& parent = directories[{collection, std::string(key_str.substr(0, parent_length))}];
+                    parent.changed |= parent.children.emplace(key_str.substr(parent_length, split + 1 - parent_length))
+                                          .second;
+                    parent_length = split + 1;
+                }
+                auto& parent = directories[{collection, std::string(key_str.substr(0, leaf_offset))}];
+                parent.changed |= parent.children.emplace(key_str.substr(leaf_offset)).second;
+                continue;
+            }
 
-        value_view_t old_key = *old_keys;
-        value_view_t old_val = *old_vals;
-        new_keys_lengths[new_idx] = static_cast<ustore_length_t>(old_key.size());
-        new_vals_lengths[new_idx] = static_cast<ustore_length_t>(old_val.size());
-        std::memcpy(new_keys_output, old_key.data(), old_key.size());
-        std::memcpy(new_vals_output, old_val.data(), old_val.size());
+            // Walk up the tree, until we meet a non-empty directory or the root
+            std::string_view child = key_str.substr(leaf_offset);
+            std::string_view directory = key_str.substr(0, leaf_offset);
+            while (true) {
+                auto& parent = directories[{collection, std::string(directory)}];
+                parent.changed |= parent.children.erase(std::string(child)) != 0;
+                if (!parent.children.empty() || directory.empty())
+                    break;
+                auto grand_split = directory.substr(0, directory.size() - 1).rfind(separator);
+                auto grand_length = grand_split == std::string_view::npos ? 0 : grand_split + 1;
+                child = directory.substr(grand_length);
+                directory = directory.substr(0, grand_length);
+            }
+        }
+
+        // Serialize and write back the listings, that have changed
+        std::vector<ustore_collection_t> write_collections;
+        std::vector<std::string> write_keys;
+        std::vector<std::string> write_listings;
+        for (auto const& [collection_and_directory, directory] : directories) {
+            if (!directory.changed)
+                continue;
+            std::string listing;
+            for (auto const& name : directory.children)
+                listing.append(name).push_back('\0');
+            write_collections.push_back(collection_and_directory.first);
+            write_keys.push_back(directory_entry_key(collection_and_directory.second));
+            write_listings.push_back(std::move(listing));
+        }
+        if (write_keys.empty())
+            return;
+
+        std::vector<ustore_str_view_t> keys_begins(write_keys.size());
+        std::vector<ustore_length_t> keys_lengths(write_keys.size());
+        std::vector<ustore_bytes_cptr_t> listings_begins(write_keys.size());
+        std::vector<ustore_length_t> listings_lengths(write_keys.size());
+        for (std::size_t i = 0; i != write_keys.size(); ++i) {
+            // Empty listings are removed, instead of being stored
+            bool is_empty = write_listings[i].empty();
+            keys_begins[i] = write_keys[i].data();
+            keys_lengths[i] = static_cast<ustore_length_t>(write_keys[i].size());
+            listings_begins[i] = is_empty ? nullptr : reinterpret_cast<ustore_bytes_cptr_t>(write_listings[i].data());
+            listings_lengths[i] = static_cast<ustore_length_t>(write_listings[i].size());
+        }
+
+        ustore_paths_write_t write {};
+        write.db = c.db;
+        write.error = c.error;
+        write.transaction = c.transaction;
+        write.arena = arena;
+        write.options = c.options;
+        write.tasks_count = static_cast<ustore_size_t>(write_keys.size());
+        write.collections = write_collections.data();
+        write.collections_stride = sizeof(ustore_collection_t);
+        write.paths = keys_begins.data();
+        write.paths_stride = sizeof(ustore_str_view_t);
+        write.paths_lengths = keys_lengths.data();
+        write.paths_lengths_stride = sizeof(ustore_length_t);
+        write.values_bytes = listings_begins.data();
+        write.values_bytes_stride = sizeof(ustore_bytes_cptr_t);
+        write.values_lengths = listings_lengths.data();
+        write.values_lengths_stride = sizeof(ustore_length_t);
+        ustore_paths_write(&write);
+    });
+}
+
+/**
+ * @brief Implements path writes on engines, that support `ustore_option_write_merge_k`.
+ * Every path produces its own operand, so the buckets aren't read at all.
+ */
+void merge_into_buckets(ustore_paths_write_t& c, contents_arg_t const& keys_str_args, linked_memory_lock_t& arena) {
+
+    strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
+    bits_view_t presences {c.values_presences};
+    strided_iterator_gt<ustore_length_t const> offs {c.values_offsets, c.values_offsets_stride};
+    strided_iterator_gt<ustore_length_t const> lens {c.values_lengths, c.values_lengths_stride};
+    strided_iterator_gt<ustore_bytes_cptr_t const> vals {c.values_bytes, c.values_bytes_stride};
+    contents_arg_t contents {presences, offs, lens, vals, c.tasks_count};
 
-        new_keys_output += old_key.size();
-        new_vals_output += old_val.size();
-        ++new_idx;
+    auto col_keys = arena.alloc<collection_key_t>(c.tasks_count, c.error);
+    return_if_error_m(c.error);
+    growing_tape_t operands {arena};
+    operands.reserve(c.tasks_count, c.error);
+    return_if_error_m(c.error);
+
+    hash_t hash;
+    for (std::size_t i = 0; i != c.tasks_count; ++i) {
+        std::string_view key_str = keys_str_args[i];
+        value_view_t value = contents[i];
+        col_keys[i] = {collections ? collections[i] : ustore_collection_main_k, hash(key_str)};
+
+        path_merge_header_t header;
+        header.key_length = static_cast<ustore_length_t>(key_str.size());
+        header.value_length = static_cast<ustore_length_t>(value.size());
+        header.present = value;
+        auto operand_length = bytes_in_path_merge_header_k + key_str.size() + value.size();
+        byte_t* operand = operands.push_back_uninitialized(operand_length, c.error);
+        return_if_error_m(c.error);
+        operand[0] = static_cast<byte_t>(merge_kind_t::paths_bucket_k);
+        std::memcpy(operand + bytes_in_merge_header_k, &header, sizeof(path_merge_header_t));
+        operand += bytes_in_path_merge_header_k;
+        std::memcpy(operand, key_str.data(), key_str.size());
+        if (value.size())
+            std::memcpy(operand + key_str.size(), value.data(), value.size());
     }
 
-    // Append the new entry at the end
-    new_keys_lengths[new_idx] = static_cast<ustore_length_t>(key.size());
-    new_vals_lengths[new_idx] = static_cast<ustore_length_t>(val.size());
-    std::memcpy(new_keys_output, key.data(), key.size());
-    std::memcpy(new_vals_output, val.data(), val.size());
+    auto col_keys_strided = col_keys.strided().immutable();
+    auto write_collections = col_keys_strided.members(&collection_key_t::collection);
+    auto write_keys = col_keys_strided.members(&collection_key_t::key);
+    ustore_byte_t* tape_begin = reinterpret_cast<ustore_byte_t*>(operands.contents().begin().get());
 
-    bucket = {new_begin, new_bytes};
+    ustore_write_t write {};
+    write.db = c.db;
+    write.error = c.error;
+    write.arena = arena;
+    write.options = ustore_options_t(c.options | ustore_option_write_merge_k);
+    write.tasks_count = c.tasks_count;
+    write.collections = write_collections.begin().get();
+    write.collections_stride = write_collections.begin().stride();
+    write.keys = write_keys.begin().get();
+    write.keys_stride = write_keys.begin().stride();
+    write.offsets = operands.offsets().begin().get();
+    write.offsets_stride = operands.offsets().stride();
+    write.lengths = operands.lengths().begin().get();
+    write.lengths_stride = operands.lengths().stride();
+    write.values = &tape_begin;
+
+    ustore_write(&write);
+}
+
+/**
+ * @brief Removes the paths of a batch from their legacy buckets, @see `legacy_hash_t`.
+ * Runs after the main write, so a failure in between leaves a shadowed copy, instead of a lost one.
+ * Only the buckets, that actually contained some of the paths, are written back.
+ */
+void remove_from_legacy_buckets(ustore_paths_write_t& c,
+                                contents_arg_t const& keys_str_args,
+                                linked_memory_lock_t& arena) {
+
+    hash_t hash;
+    legacy_hash_t legacy_hash;
+    strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
+    auto tasks_col_keys = arena.alloc<collection_key_t>(c.tasks_count, c.error);
+    return_if_error_m(c.error);
+    auto unique_col_keys = arena.alloc<collection_key_t>(c.tasks_count, c.error);
+    return_if_error_m(c.error);
+
+    std::size_t legacy_count = 0;
+    for (std::size_t i = 0; i != c.tasks_count; ++i) {
+        std::string_view key_str = keys_str_args[i];
+        ustore_key_t legacy_key = legacy_hash(key_str);
+        tasks_col_keys[i] = {collections ? collections[i] : ustore_collection_main_k, legacy_key};
+        if (legacy_key != hash(key_str))
+            unique_col_keys[legacy_count++] = tasks_col_keys[i];
+    }
+    if (!legacy_count)
+        return;
+    auto unique_end = sort_and_deduplicate(unique_col_keys.begin(), unique_col_keys.begin() + legacy_count);
+    unique_col_keys = {unique_col_keys.begin(), unique_end};
+
+    ustore_length_t* buckets_offsets {};
+    ustore_byte_t* buckets_values {};
+    auto unique_col_keys_strided = strided_range(unique_col_keys.begin(), unique_col_keys.end()).immutable();
+    auto read_collections = unique_col_keys_strided.members(&collection_key_t::collection).begin();
+    auto read_keys = unique_col_keys_strided.members(&collection_key_t::key).begin();
+    auto opts = c.transaction ? ustore_options_t(c.options & ~ustore_option_transaction_dont_watch_k) : c.options;
+    ustore_read_t read {};
+    read.db = c.db;
+    read.error = c.error;
+    read.transaction = c.transaction;
+    read.arena = arena;
+    read.options = opts;
+    read.tasks_count = static_cast<ustore_size_t>(unique_col_keys.size());
+    read.collections = read_collections.get();
+    read.collections_stride = read_collections.stride();
+    read.keys = read_keys.get();
+    read.keys_stride = read_keys.stride();
+    read.offsets = &buckets_offsets;
+    read.values = &buckets_values;
+    ustore_read(&read);
+    return_if_error_m(c.error);
+
+    // Collect the removals of the paths, that are really there, grouped by bucket
+    joined_blobs_t joined_buckets {unique_col_keys.size(), buckets_offsets, buckets_values};
+    uninitialized_array_gt<value_view_t> buckets(unique_col_keys.size(), arena, c.error);
+    return_if_error_m(c.error);
+    transform_n(joined_buckets.begin(), unique_col_keys.size(), buckets.begin());
+    auto changes = arena.alloc<bucket_change_t>(c.tasks_count, c.error);
+    return_if_error_m(c.error);
+    auto changes_buckets = arena.alloc<ustore_size_t>(c.tasks_count, c.error);
+    return_if_error_m(c.error);
+
+    std::size_t changes_count = 0;
+    for (std::size_t i = 0; i != c.tasks_count; ++i) {
+        std::string_view key_str = keys_str_args[i];
+        if (tasks_col_keys[i].key == hash(key_str))
+            continue;
+        auto bucket_idx = offset_in_sorted(unique_col_keys, tasks_col_keys[i]);
+        if (!find_in_bucket(buckets[bucket_idx], key_str))
+            continue;
+        changes[changes_count] = {key_str, value_view_t {}};
+        changes_buckets[changes_count] = static_cast<ustore_size_t>(bucket_idx);
+        ++changes_count;
+    }
+    if (!changes_count)
+        return;
+
+    // Rebuild the affected buckets, grouping the removals of every one of them
+    auto written_col_keys = arena.alloc<collection_key_t>(changes_count, c.error);
+    return_if_error_m(c.error);
+    uninitialized_array_gt<value_view_t> written_buckets(changes_count, arena, c.error);
+    return_if_error_m(c.error);
+    std::size_t written_count = 0;
+    for (std::size_t change_idx = 0; change_idx != changes_count;) {
+        auto bucket_idx = changes_buckets[change_idx];
+        auto group_begin = changes.begin() + change_idx;
+        auto group_end = group_begin;
+        for (std::size_t other_idx = change_idx; other_idx != changes_count; ++other_idx)
+            if (changes_buckets[other_idx] == bucket_idx) {
+                std::swap(*group_end, changes[other_idx]);
+                std::swap(changes_buckets[group_end - changes.begin()], changes_buckets[other_idx]);
+                ++group_end;
+            }
+        change_idx = group_end - changes.begin();
+        group_end = deduplicate_changes(group_begin, group_end);
+
+        value_view_t bucket = buckets[bucket_idx];
+        update_in_bucket(bucket, {group_begin, group_end}, arena, c.error);
+        return_if_error_m(c.error);
+        written_col_keys[written_count] = unique_col_keys[bucket_idx];
+        written_buckets[written_count] = bucket;
+        ++written_count;
+    }
+
+    auto written_col_keys_strided =
+        strided_range(written_col_keys.begin(), written_col_keys.begin() + written_count).immutable();
+    auto write_collections = written_col_keys_strided.members(&collection_key_t::collection).begin();
+    auto write_keys = written_col_keys_strided.members(&collection_key_t::key).begin();
+    ustore_write_t write {};
+    write.db = c.db;
+    write.error = c.error;
+    write.transaction = c.transaction;
+    write.arena = arena;
+    write.options = ustore_options_t(opts & ~ustore_option_write_merge_k);
+    write.tasks_count = static_cast<ustore_size_t>(written_count);
+    write.collections = write_collections.get();
+    write.collections_stride = write_collections.stride();
+    write.keys = write_keys.get();
+    write.keys_stride = write_keys.stride();
+    write.lengths = written_buckets[0].member_length();
+    write.lengths_stride = sizeof(value_view_t);
+    write.values = written_buckets[0].member_ptr();
+    write.values_stride = sizeof(value_view_t);
+    ustore_write(&write);
 }
 
 void ustore_paths_write(ustore_paths_write_t* c_ptr) {
+    trace_span_m("paths_write");
 
     ustore_paths_write_t& c = *c_ptr;
     linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
@@ -256,6 +889,19 @@ void ustore_paths_write(ustore_paths_write_t* c_ptr) {
     keys_str_args.contents_begin = {(ustore_bytes_cptr_t const*)c.paths, c.paths_stride};
     keys_str_args.count = c.tasks_count;
 
+    if (c.path_separator) {
+        update_directories(c, keys_str_args, arena);
+        return_if_error_m(c.error);
+    }
+
+    if (can_merge(c.db, c.transaction, c.options)) {
+        merge_into_buckets(c, keys_str_args, arena);
+        return_if_error_m(c.error);
+        return remove_from_legacy_buckets(c, keys_str_args, arena);
+    }
+
+    auto tasks_col_keys = arena.alloc<collection_key_t>(c.tasks_count, c.error);
+    return_if_error_m(c.error);
     auto unique_col_keys = arena.alloc<collection_key_t>(c.tasks_count, c.error);
     return_if_error_m(c.error);
 
@@ -263,7 +909,8 @@ void ustore_paths_write(ustore_paths_write_t* c_ptr) {
     hash_t hash;
     strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
     for (std::size_t i = 0; i != c.tasks_count; ++i)
-        unique_col_keys[i] = {collections ? collections[i] : ustore_collection_main_k, hash(keys_str_args[i])};
+        tasks_col_keys[i] = {collections ? collections[i] : ustore_collection_main_k, hash(keys_str_args[i])};
+    std::copy(tasks_col_keys.begin(), tasks_col_keys.end(), unique_col_keys.begin());
 
     // We must sort and deduplicate this bucket IDs
     unique_col_keys = {unique_col_keys.begin(), sort_and_deduplicate(unique_col_keys.begin(), unique_col_keys.end())};
@@ -310,21 +957,35 @@ void ustore_paths_write(ustore_paths_write_t* c_ptr) {
     strided_iterator_gt<ustore_bytes_cptr_t const> vals {c.values_bytes, c.values_bytes_stride};
     contents_arg_t contents {presences, offs, lens, vals, c.tasks_count};
 
-    // Update every unique bucket
+    // Group the changes by bucket with a stable counting sort, so that every
+    // bucket is rebuilt only once, no matter how many paths it receives.
+    auto tasks_buckets = arena.alloc<ustore_size_t>(c.tasks_count, c.error);
+    return_if_error_m(c.error);
+    auto groups_offsets = arena.alloc<ustore_size_t>(unique_places.count + 1, c.error);
+    return_if_error_m(c.error);
+    auto grouped_changes = arena.alloc<bucket_change_t>(c.tasks_count, c.error);
+    return_if_error_m(c.error);
+
+    std::fill(groups_offsets.begin(), groups_offsets.end(), 0);
     for (std::size_t i = 0; i != c.tasks_count; ++i) {
-        std::string_view key_str = keys_str_args[i];
-        ustore_key_t key = hash(key_str);
-        value_view_t new_val = contents[i];
-        collection_key_t collection_key {collections ? collections[i] : ustore_collection_main_k, key};
-        auto bucket_idx = offset_in_sorted(unique_col_keys, collection_key);
-        value_view_t& bucket = updated_buckets[bucket_idx];
-
-        if (new_val) {
-            upsert_in_bucket(bucket, key_str, new_val, arena, c.error);
-            return_if_error_m(c.error);
-        }
-        else
-            remove_from_bucket(bucket, key_str);
+        auto bucket_idx = offset_in_sorted(unique_col_keys, tasks_col_keys[i]);
+        tasks_buckets[i] = static_cast<ustore_size_t>(bucket_idx);
+        ++groups_offsets[bucket_idx + 1];
+    }
+    std::partial_sum(groups_offsets.begin(), groups_offsets.end(), groups_offsets.begin());
+    auto groups_progress = arena.alloc<ustore_size_t>(unique_places.count, c.error);
+    return_if_error_m(c.error);
+    std::copy(groups_offsets.begin(), groups_offsets.end() - 1, groups_progress.begin());
+    for (std::size_t i = 0; i != c.tasks_count; ++i)
+        grouped_changes[groups_progress[tasks_buckets[i]]++] = {keys_str_args[i], contents[i]};
+
+    // Update every unique bucket
+    for (std::size_t bucket_idx = 0; bucket_idx != unique_places.count; ++bucket_idx) {
+        auto group_begin = grouped_changes.begin() + groups_offsets[bucket_idx];
+        auto group_end = grouped_changes.begin() + groups_offsets[bucket_idx + 1];
+        group_end = deduplicate_changes(group_begin, group_end);
+        update_in_bucket(updated_buckets[bucket_idx], {group_begin, group_end}, arena, c.error);
+        return_if_error_m(c.error);
     }
 
     ustore_write_t write {};
@@ -345,9 +1006,12 @@ void ustore_paths_write(ustore_paths_write_t* c_ptr) {
 
     // Once all is updated, we can safely write back
     ustore_write(&write);
+    return_if_error_m(c.error);
+    remove_from_legacy_buckets(c, keys_str_args, arena);
 }
 
 void ustore_paths_read(ustore_paths_read_t* c_ptr) {
+    trace_span_m("paths_read");
 
     ustore_paths_read_t& c = *c_ptr;
     linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
@@ -396,26 +1060,78 @@ void ustore_paths_read(ustore_paths_read_t* c_ptr) {
     return_if_error_m(c.error);
 
     // Some of the entries will contain more then one key-value pair in case of collisions.
-    ustore_length_t exported_volume = 0;
     joined_blobs_t buckets {c.tasks_count, buckets_offsets, buckets_values};
+    auto found = arena.alloc<value_view_t>(c.tasks_count, c.error);
+    return_if_error_m(c.error);
+    std::size_t legacy_count = 0;
+    legacy_hash_t legacy_hash;
+    for (std::size_t i = 0; i != c.tasks_count; ++i) {
+        std::string_view key_str = keys_str_args[i];
+        found[i] = find_in_bucket(buckets[i], key_str).value;
+        legacy_count += !found[i] && legacy_hash(key_str) != buckets_keys[i];
+    }
+
+    // Paths, that were missing, may still be in their legacy buckets
+    if (legacy_count) {
+        auto legacy_tasks = arena.alloc<ustore_size_t>(legacy_count, c.error);
+        return_if_error_m(c.error);
+        auto legacy_collections = arena.alloc<ustore_collection_t>(legacy_count, c.error);
+        return_if_error_m(c.error);
+        auto legacy_keys = arena.alloc<ustore_key_t>(legacy_count, c.error);
+        return_if_error_m(c.error);
+        strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
+        for (std::size_t i = 0, j = 0; i != c.tasks_count; ++i) {
+            ustore_key_t legacy_key = legacy_hash(keys_str_args[i]);
+            if (found[i] || legacy_key == buckets_keys[i])
+                continue;
+            legacy_tasks[j] = static_cast<ustore_size_t>(i);
+            legacy_collections[j] = collections ? collections[i] : ustore_collection_main_k;
+            legacy_keys[j] = legacy_key;
+            ++j;
+        }
+
+        ustore_length_t* legacy_offsets {};
+        ustore_byte_t* legacy_values {};
+        read.tasks_count = static_cast<ustore_size_t>(legacy_count);
+        read.collections = legacy_collections.begin();
+        read.collections_stride = sizeof(ustore_collection_t);
+        read.keys = legacy_keys.begin();
+        read.offsets = &legacy_offsets;
+        read.values = &legacy_values;
+        ustore_read(&read);
+        return_if_error_m(c.error);
+
+        joined_blobs_t legacy_buckets {legacy_count, legacy_offsets, legacy_values};
+        for (std::size_t j = 0; j != legacy_count; ++j)
+            found[legacy_tasks[j]] = find_in_bucket(legacy_buckets[j], keys_str_args[legacy_tasks[j]]).value;
+    }
+
+    // Values are exported in place, overwriting the buckets, unless some come from the legacy ones
+    ustore_byte_t* exported_values = buckets_values;
+    if (legacy_count) {
+        std::size_t exported_size = 0;
+        for (std::size_t i = 0; i != c.tasks_count; ++i)
+            exported_size += found[i] ? found[i].size() + 1 : 0;
+        exported_values = arena.alloc<ustore_byte_t>(exported_size, c.error).begin();
+        return_if_error_m(c.error);
+    }
+
+    ustore_length_t exported_volume = 0;
     auto presences =
         arena.alloc_or_dummy(divide_round_up<std::size_t>(c.tasks_count, bits_in_byte_k), c.error, c.presences);
     auto lengths = arena.alloc_or_dummy(c.tasks_count, c.error, c.lengths);
     auto offsets = arena.alloc_or_dummy(c.tasks_count, c.error, c.offsets);
 
     for (std::size_t i = 0; i != c.tasks_count; ++i) {
-        std::string_view key_str = keys_str_args[i];
-        value_view_t bucket = buckets[i];
-
         // Now that we have found our match - clamp everything else.
-        value_view_t val = find_in_bucket(bucket, key_str).value;
+        value_view_t val = found[i];
         if (val) {
             presences[i] = true;
             offsets[i] = exported_volume;
             lengths[i] = static_cast<ustore_length_t>(val.size());
             if (c.values)
-                std::memmove(buckets_values + exported_volume, val.data(), val.size());
-            buckets_values[exported_volume + val.size()] = ustore_byte_t {0};
+                std::memmove(exported_values + exported_volume, val.data(), val.size());
+            exported_values[exported_volume + val.size()] = ustore_byte_t {0};
             exported_volume += static_cast<ustore_length_t>(val.size()) + 1;
         }
         else {
@@ -427,15 +1143,92 @@ void ustore_paths_read(ustore_paths_read_t* c_ptr) {
 
     offsets[c.tasks_count] = exported_volume;
     if (c.values)
-        *c.values = buckets_values;
+        *c.values = exported_values;
 }
 
+/**
+ * @brief Prefix matching, that only visits the mirror "directory" entries
+ * on the way to the requested prefix and below it. Subtrees are visited in
+ * lexicographical order, so the @p previous_path can be used to skip the
+ * branches, that were exported on earlier pages.
+ */
+void indexed_w_prefix( //
+    ustore_database_t const c_db,
+    ustore_transaction_t const c_transaction,
+    ustore_collection_t c_collection,
+    ustore_char_t const c_separator,
+    std::string_view prefix,
+    std::string_view previous_path,
+    ustore_length_t c_count_limit,
+    ustore_options_t const c_options,
+    ustore_length_t& count,
+    growing_tape_t& paths,
+    linked_memory_lock_t& arena,
+    ustore_error_t* c_error) {
+
+    count = 0;
+    safe_section("Listing directories", c_error, [&] {
+        std::vector<ustore_collection_t> collections {c_collection};
+        std::vector<std::string> keys(1);
+
+        // Returns `false` when the traversal must stop
+        auto visit = [&](auto& visit_ref, std::string const& directory, std::string_view partial) -> bool {
+            keys.front() = directory_entry_key(directory);
+            auto listings = read_directories(c_db, c_transaction, collections, keys, c_options, arena, c_error);
+            if (*c_error)
+                return false;
+
+            bool should_continue = true;
+            for_each_child(listings.front(), [&](std::string_view name) {
+                if (!starts_with(name, partial))
+                    // Names are sorted, so the matching ones are contiguous
+                    return name < partial;
+
+                std::string path = directory;
+                path.append(name);
+                bool is_directory = !name.empty() && name.back() == c_separator;
+                if (is_directory) {
+                    bool was_exported = path < previous_path && !starts_with(previous_path, path);
+                    if (!was_exported)
+                        should_continue = visit_ref(visit_ref, path, {});
+                    return should_continue;
+                }
+
+                if (!previous_path.empty() && path <= previous_path)
+                    return true;
+                paths.push_back(std::string_view(path), c_error);
+                if (!*c_error)
+                    paths.add_terminator(byte_t {0}, c_error);
+                should_continue = !*c_error && ++count < c_count_limit;
+                return should_continue;
+            });
+            return should_continue;
+        };
+
+        auto last_split = prefix.rfind(c_separator);
+        auto directory_length = last_split == std::string_view::npos ? 0 : last_split + 1;
+        if (c_count_limit)
+            visit(visit, std::string(prefix.substr(0, directory_length)), prefix.substr(directory_length));
+    });
+}
+
+/**
+ * @brief Candidates are buffered and passed to the matcher in batches of this size,
+ * so that expensive predicates can be evaluated on multiple threads at once.
+ */
+constexpr std::size_t scanned_paths_batch_k = 4096;
+
 /**
  * - Same collection
  * - One scan request
  * - May have previous results
+ *
+ * The @p matcher must provide two member functions:
+ * - `may_match(std::string_view)`, to skip entire buckets by their concatenated keys,
+ * - `match(paths, matches)`, to mark every matching path in a batch of candidates.
+ * The matches are still exported in the order of the scan, so pagination is preserved.
  */
-template <typename predicate_at>
+template <typename matcher_at>
 void full_scan_collection_w_predicate( //
     ustore_database_t c_db,
     ustore_transaction_t c_transaction,
@@ -447,39 +1240,71 @@ void full_scan_collection_w_predicate( //
     growing_tape_t& paths,
     linked_memory_lock_t& arena,
     ustore_error_t* c_error,
-    predicate_at predicate) {
+    matcher_at& matcher) {
 
+    // The previous path may still be in its legacy bucket, so the scan starts from the lower of the two
     hash_t hash;
+    legacy_hash_t legacy_hash;
     bool has_reached_previous = previous_path.empty();
-    ustore_key_t start_key = !previous_path.empty() ? hash(previous_path) : std::numeric_limits<ustore_key_t>::min();
+    ustore_key_t start_key = !previous_path.empty() //
+                                 ? std::min(hash(previous_path), legacy_hash(previous_path))
+                                 : std::numeric_limits<ustore_key_t>::min();
+
+    // The scanned buckets remain valid until the `arena` lock is released,
+    // so we can keep views into them across multiple scan rounds.
+    std::vector<std::string_view> candidates;
+    std::vector<char> matches;
+    safe_section("Allocating candidates", c_error, [&] {
+        candidates.reserve(scanned_paths_batch_k);
+        matches.reserve(scanned_paths_batch_k);
+    });
+    return_if_error_m(c_error);
 
     paths_count = 0;
-    auto scan_in_bucket = [&](ustore_key_t, value_view_t bucket) noexcept {
-        for_each_in_bucket(bucket, [&](bucket_member_t const& member) {
-            if (!predicate(member.key))
+    auto flush_candidates = [&]() noexcept {
+        matches.resize(candidates.size());
+        matcher.match(candidates, matches);
+        for (std::size_t i = 0; i != candidates.size() && !*c_error; ++i) {
+            if (!matches[i])
                 // Skip irrelevant entries
-                return;
-            if (member.key == previous_path) {
+                continue;
+            if (candidates[i] == previous_path) {
                 // We may have reached the boundary between old results and new ones
                 has_reached_previous = true;
-                return;
+                continue;
             }
             if (!has_reached_previous)
                 // Skip the results we have already seen
-                return;
+                continue;
             if (paths_count >= c_count_limit)
                 // We have more than we need
-                return;
+                break;
 
             // All the matches in this section should be exported
-            paths.push_back(member.key, c_error);
+            paths.push_back(candidates[i], c_error);
             return_if_error_m(c_error);
             paths.add_terminator(byte_t {0}, c_error);
             return_if_error_m(c_error);
             ++paths_count;
-        });
+        }
+        candidates.clear();
+    };
+
+    auto scan_in_bucket = [&](ustore_key_t, value_view_t bucket) noexcept {
+        auto bucket_size = get_bucket_size(bucket);
+        if (!bucket_size)
+            return true;
+        if (!matcher.may_match(get_bucket_keys_joined(bucket, bucket_size)))
+            return true;
 
-        return paths_count < c_count_limit;
+        for_each_in_bucket(bucket, [&](bucket_member_t const& member) {
+            if (!is_directory_entry(member.key))
+                // Skip the mirror directories
+                candidates.push_back(member.key);
+        });
+        if (candidates.size() >= scanned_paths_batch_k)
+            flush_candidates();
+        return !*c_error && paths_count < c_count_limit;
     };
 
     full_scan_collection(c_db,
@@ -491,8 +1316,22 @@ void full_scan_collection_w_predicate( //
                          arena,
                          c_error,
                          scan_in_bucket);
+    if (!*c_error)
+        flush_candidates();
 }
 
+struct prefix_matcher_t {
+    std::string_view prefix;
+
+    bool may_match(std::string_view bucket_keys) const noexcept {
+        return bucket_keys.find(prefix) != std::string_view::npos;
+    }
+    void match(std::vector<std::string_view> const& paths, std::vector<char>& matches) const noexcept {
+        for (std::size_t i = 0; i != paths.size(); ++i)
+            matches[i] = starts_with(paths[i], prefix);
+    }
+};
+
 void full_scan_w_prefix( //
     ustore_database_t const c_db,
     ustore_transaction_t const c_transaction,
@@ -506,6 +1345,7 @@ void full_scan_w_prefix( //
     linked_memory_lock_t& arena,
     ustore_error_t* c_error) {
 
+    prefix_matcher_t matcher {prefix};
     full_scan_collection_w_predicate( //
         c_db,
         c_transaction,
@@ -517,23 +1357,229 @@ void full_scan_w_prefix( //
         paths,
         arena,
         c_error,
-        [=](std::string_view body) { return starts_with(body, prefix); });
+        matcher);
 }
 
-struct pcre2_ctx_t {
-    linked_memory_lock_t& arena;
-    ustore_error_t* c_error;
+/**
+ * @brief Extracts the longest literal substring, that every match of the RegEx @p pattern
+ * must contain. Conservative: returns an empty string, if the pattern has alternations,
+ * inline options or any other construct, that makes the guarantee hard to prove.
+ */
+std::string required_literal(std::string_view pattern) {
+    if (pattern.find("(?") != std::string_view::npos)
+        return {};
+
+    std::string longest, current;
+    auto end_run = [&] {
+        if (current.size() > longest.size())
+            longest = current;
+        current.clear();
+    };
+    int groups_depth = 0;
+    for (std::size_t i = 0; i != pattern.size(); ++i) {
+        char c = pattern[i];
+        switch (c) {
+        case '\\':
+            // Escapes may start classes, like `\d`, or literal blocks, like `\Q...\E`
+            end_run();
+            ++i;
+            break;
+        case '[': {
+            end_run();
+            // The closing bracket may appear first in the class, as in `[]a]` or `[^]a]`
+            std::size_t j = i + 1;
+            if (j < pattern.size() && pattern[j] == '^')
+                ++j;
+            if (j < pattern.size() && pattern[j] == ']')
+                ++j;
+            while (j < pattern.size() && pattern[j] != ']')
+                j += pattern[j] == '\\' ? 2 : 1;
+            if (j >= pattern.size())
+                return {};
+            i = j;
+            break;
+        }
+        case '(': end_run(), ++groups_depth; break;
+        case ')': end_run(), --groups_depth; break;
+        case '|': return {};
+        case '?':
+        case '*':
+            // The previous character becomes optional
+            if (!current.empty())
+                current.pop_back();
+            end_run();
+            break;
+        case '{': {
+            // Bounded repetitions, like `{n}` or `{m,n}`, may also make it optional.
+            // Otherwise the brace is a literal, that we conservatively skip.
+            if (!current.empty())
+                current.pop_back();
+            end_run();
+            std::size_t j = i + 1;
+            while (j < pattern.size() && (std::isdigit(static_cast<unsigned char>(pattern[j])) || pattern[j] == ','))
+                ++j;
+            if (j < pattern.size() && pattern[j] == '}')
+                i = j;
+            break;
+        }
+        case '+':
+            // The previous character is still required, but may repeat
+            end_run();
+            break;
+        case '.':
+        case '^':
+        case '$': end_run(); break;
+        default:
+            if (groups_depth == 0)
+                current.push_back(c);
+            break;
+        }
+    }
+    end_run();
+    return longest;
+}
+
+/**
+ * @brief Compiled RegEx pattern, shared between queries and threads.
+ * Every thread must use its own `pcre2_match_data`.
+ */
+struct compiled_regex_t {
+    pcre2_code* code = nullptr;
+    bool is_jit = false;
+    std::string literal;
+
+    compiled_regex_t() = default;
+    compiled_regex_t(compiled_regex_t const&) = delete;
+    compiled_regex_t& operator=(compiled_regex_t const&) = delete;
+    ~compiled_regex_t() noexcept { pcre2_code_free(code); }
 };
 
-static void* pcre2_malloc(PCRE2_SIZE length, void* ctx_ptr) noexcept {
-    pcre2_ctx_t& ctx = *reinterpret_cast<pcre2_ctx_t*>(ctx_ptr);
-    return ctx.arena.alloc<byte_t>(static_cast<std::size_t>(length), ctx.c_error).begin();
-}
+/**
+ * @brief Process-wide cache of compiled patterns, as the same listing jobs tend to be
+ * repeated while paginating. The compiled code outlives the arenas, so it is allocated
+ * with the default PCRE2 allocator. Once full, the cache is simply flushed.
+ */
+class regex_cache_t {
+    static constexpr std::size_t capacity_k = 64;
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::shared_ptr<compiled_regex_t const>> entries_;
+
+  public:
+    std::shared_ptr<compiled_regex_t const> get(std::string_view pattern, ustore_error_t* c_error) noexcept(false) {
+        std::string pattern_copy {pattern};
+        {
+            std::lock_guard<std::mutex> lock {mutex_};
+            auto it = entries_.find(pattern_copy);
+            if (it != entries_.end())
+                return it->second;
+        }
+
+        // Compile outside of the lock, concurrent misses on the same pattern are harmless
+        auto regex = std::make_shared<compiled_regex_t>();
+        // https://www.pcre.org/current/doc/html/pcre2_compile.html
+        int pcre2_pattern_error_code = 0;
+        PCRE2_SIZE pcre2_pattern_error_offset = 0;
+        regex->code = pcre2_compile( //
+            PCRE2_SPTR8(pattern.data()),
+            PCRE2_SIZE(pattern.size()),
+            PCRE2_MATCH_INVALID_UTF,
+            &pcre2_pattern_error_code,
+            &pcre2_pattern_error_offset,
+            nullptr);
+        if (!regex->code) {
+            log_error_m(c_error, args_wrong_k, "Failed to compile the RegEx query");
+            return {};
+        }
+
+        // https://www.pcre.org/current/doc/html/pcre2_jit_compile.html
+        // If JIT isn't available on this platform, we fall back to the interpreter.
+        regex->is_jit = pcre2_jit_compile(regex->code, PCRE2_JIT_COMPLETE) == 0;
+        regex->literal = required_literal(pattern);
+
+        std::lock_guard<std::mutex> lock {mutex_};
+        if (entries_.size() >= capacity_k)
+            entries_.clear();
+        entries_.emplace(std::move(pattern_copy), regex);
+        return regex;
+    }
+};
+
+static regex_cache_t regex_cache;
 
-static void pcre2_free(void*, void*) noexcept {
-    // Our arenas only grow, we don't dealloc!
+/**
+ * @brief Workers for `regex_matcher_t`, started on first use and shared by all queries,
+ * as paginated listings would otherwise spawn new threads for every page.
+ */
+static thread_pool_t& regex_matching_pool() noexcept(false) {
+    static thread_pool_t pool {std::thread::hardware_concurrency()};
+    return pool;
 }
 
+/**
+ * @brief Matches a batch of paths against a RegEx, splitting it between multiple threads,
+ * each with its own `pcre2_match_data`. Paths, that lack the required literal substring,
+ * are rejected without calling into PCRE2.
+ */
+struct regex_matcher_t {
+    /** @brief Small batches aren't worth waking up other threads. */
+    static constexpr std::size_t paths_per_thread_k = 256;
+
+    compiled_regex_t const& regex;
+    ustore_error_t* c_error;
+
+    bool may_match(std::string_view bucket_keys) const noexcept {
+        return regex.literal.empty() || bucket_keys.find(regex.literal) != std::string_view::npos;
+    }
+
+    void match(std::vector<std::string_view> const& paths, std::vector<char>& matches) const noexcept {
+        std::size_t threads_count = std::max<std::size_t>(std::thread::hardware_concurrency(), 1u);
+        std::size_t chunks_count = std::min(threads_count, divide_round_up(paths.size(), paths_per_thread_k));
+        chunks_count = std::max<std::size_t>(chunks_count, 1u);
+        std::size_t chunk_size = divide_round_up(paths.size(), chunks_count);
+        std::atomic<bool> failed {false};
+
+        auto match_chunk = [&](std::size_t chunk_idx) noexcept {
+            // https://www.pcre.org/current/doc/html/pcre2_match_data_create_from_pattern.html
+            pcre2_match_data* match_data = pcre2_match_data_create_from_pattern(regex.code, nullptr);
+            if (!match_data) {
+                failed = true;
+                return;
+            }
+            std::size_t begin = chunk_idx * chunk_size;
+            std::size_t end = std::min(begin + chunk_size, paths.size());
+            for (std::size_t i = begin; i < end; ++i) {
+                std::string_view path = paths[i];
+                if (!regex.literal.empty() && path.find(regex.literal) == std::string_view::npos) {
+                    matches[i] = false;
+                    continue;
+                }
+                // https://www.pcre.org/current/doc/html/pcre2_jit_match.html
+                auto match = regex.is_jit ? &pcre2_jit_match : &pcre2_match;
+                auto found_matches = match( //
+                    regex.code,
+                    PCRE2_SPTR(path.data()),
+                    PCRE2_SIZE(path.size()),
+                    PCRE2_SIZE(0), // start offset
+                    PCRE2_NO_UTF_CHECK,
+                    match_data,
+                    NULL);
+                matches[i] = found_matches > 0;
+            }
+            pcre2_match_data_free(match_data);
+        };
+
+        if (chunks_count == 1)
+            match_chunk(0);
+        else
+            safe_section("Matching in parallel", c_error, [&] {
+                regex_matching_pool().for_each(chunks_count, match_chunk);
+            });
+        if (failed)
+            log_error_m(c_error, out_of_memory_k, "Failed to allocate memory for RegEx pattern matches");
+    }
+};
+
 void full_scan_w_regex( //
     ustore_database_t const c_db,
     ustore_transaction_t const c_transaction,
@@ -547,64 +1593,29 @@ void full_scan_w_regex( //
     linked_memory_lock_t& arena,
     ustore_error_t* c_error) {
 
-    pcre2_ctx_t ctx {arena, c_error};
-
-    // https://www.pcre.org/current/doc/html/pcre2_compile.html
-    pcre2_general_context* pcre2_context = pcre2_general_context_create(&pcre2_malloc, &pcre2_free, &ctx);
-    pcre2_compile_context* pcre2_compile_context = pcre2_compile_context_create(pcre2_context);
-    int pcre2_pattern_error_code = 0;
-    PCRE2_SIZE pcre2_pattern_error_offset = 0;
-    pcre2_code* pcre2_code = pcre2_compile( //
-        PCRE2_SPTR8(pattern.data()),
-        PCRE2_SIZE(pattern.size()),
-        PCRE2_MATCH_INVALID_UTF,
-        &pcre2_pattern_error_code,
-        &pcre2_pattern_error_offset,
-        pcre2_compile_context);
-
-    // https://www.pcre.org/current/doc/html/pcre2_jit_compile.html
-    auto jit_status = pcre2_jit_compile(pcre2_code, PCRE2_JIT_COMPLETE);
-    if (jit_status != 0)
-        *c_error = "Failed to JIT-compile the RegEx query";
-
-    pcre2_match_data* match_data = pcre2_match_data_create_from_pattern(pcre2_code, pcre2_context);
-    if (!match_data)
-        *c_error = "Failed to allocate memory for RegEx pattern matches";
-
-    if (!*c_error)
-        full_scan_collection_w_predicate( //
-            c_db,
-            c_transaction,
-            c_collection,
-            previous_path,
-            c_count_limit,
-            c_options,
-            count,
-            paths,
-            arena,
-            c_error,
-            [=](std::string_view body) {
-                // https://www.pcre.org/current/doc/html/pcre2_jit_match.html
-                // pcre2_match_data match_data;
-                // pcre2_match_context match_context;
-                auto found_matches = pcre2_jit_match( //
-                    pcre2_code,
-                    PCRE2_SPTR(body.data()),
-                    PCRE2_SIZE(body.size()),
-                    PCRE2_SIZE(0), // start offset
-                    PCRE2_NO_UTF_CHECK,
-                    match_data,
-                    NULL);
-                return found_matches > 0;
-            });
+    count = 0;
+    std::shared_ptr<compiled_regex_t const> regex;
+    safe_section("Compiling RegEx", c_error, [&] { regex = regex_cache.get(pattern, c_error); });
+    if (*c_error || !regex)
+        return;
 
-    pcre2_match_data_free(match_data);
-    pcre2_code_free(pcre2_code);
-    pcre2_compile_context_free(pcre2_compile_context);
-    pcre2_general_context_free(pcre2_context);
+    regex_matcher_t matcher {*regex, c_error};
+    full_scan_collection_w_predicate( //
+        c_db,
+        c_transaction,
+        c_collection,
+        previous_path,
+        c_count_limit,
+        c_options,
+        count,
+        paths,
+        arena,
+        c_error,
+        matcher);
 }
 
 void ustore_paths_match(ustore_paths_match_t* c_ptr) {
+    trace_span_m("paths_match");
 
     ustore_paths_match_t const& c = *c_ptr;
     linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
@@ -637,6 +1648,21 @@ void ustore_paths_match(ustore_paths_match_t* c_ptr) {
         auto pattern = patterns_args[i];
         auto previous = previous_args[i];
         auto limit = count_limits[i];
+        if (c.path_separator && is_prefix(pattern)) {
+            indexed_w_prefix(c.db,
+                             c.transaction,
+                             col,
+                             c.path_separator,
+                             pattern,
+                             previous,
+                             limit,
+                             c.options,
+                             found_counts[i],
+                             found_paths,
+                             arena,
+                             c.error);
+            continue;
+        }
         auto func = is_prefix(pattern) ? &full_scan_w_prefix : &full_scan_w_regex;
         func(c.db,
              c.transaction,
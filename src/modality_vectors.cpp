@@ -6,19 +6,45 @@
  * Sits on top of any @see "ustore.h"-compatible system.
  *
  * Internally quantizes often f32/f16 vectors into i8 representations,
- * later constructing a Navigable Small World Graph on those vectors.
- * During search relies on an algorithm resembling A*, adding a
- * stochastic component.
+ * scaled separately for every vector, later constructing a Hierarchical Navigable Small World Graph on those
+ * vectors. During search greedily descends through the layers of that
+ * graph, expanding a bounded beam of candidates on the bottom one.
+ *
+ * The originals are stored under their keys, and the index nodes mirror
+ * them in the negative range of the same collection: key `k` maps into
+ * `-1 - k`. The lowest key holds the index header. Every node contains
+ * the quantized vector and the neighbors lists for each of its layers:
+ *
+ *      [f32 scale] [f32 squared norm] [dims x i8 quants] [u8 levels] { [u16 count] [count x ustore_key_t] } x levels
+ *
+ * Optionally, the quantized copies are also packed into fixed-size blocks of a companion
+ * collection, that exhaustive searches stream without any per-key lookups. Those may use
+ * Product Quantization instead, to fit every vector into just a few dozen bytes.
+ * @see `packed_vectors_t`.
  */
-#include <cmath> // `std::sqrt`
+#include <cmath>         // `std::sqrt`
+#include <cstring>       // `std::memcpy`
+#include <limits>        // `std::numeric_limits`
+#include <map>           // `std::map`
+#include <memory>        // `std::unique_ptr`
+#include <numeric>       // `std::accumulate`
+#include <queue>         // `std::priority_queue`
+#include <string_view>   // `std::string_view`
+#include <unordered_map> // `std::unordered_map`
+#include <unordered_set> // `std::unordered_set`
 
 #include "ustore/vectors.h"
+#include "ustore/docs.h" // `ustore_docs_gather`
 #include "ustore/cpp/ranges_args.hpp" // `places_arg_t`
 
 #include "helpers/linked_memory.hpp"          // `linked_memory_lock_t`
 #include "helpers/algorithm.hpp"              // `transform_n`
-#include "helpers/full_scan.hpp"              // `full_scan_collection`
+#include "helpers/full_scan.hpp"              // `bulk_scan_collection`
 #include "helpers/limited_priority_queue.hpp" // `limited_priority_queue_gt`
+#include "helpers/vector_metrics.hpp"         // `i8_metric`
+#include "helpers/product_quantizer.hpp"      // `product_quantizer_t`
+#include "helpers/parallel.hpp"               // `thread_pool_t`
+#include "helpers/trace.hpp"                  // `trace_span_m`
 
 /*********************************************************/
 /*****************	 C++ Implementation	  ****************/
@@ -29,7 +55,6 @@ using namespace unum;
 
 using real_t = float;
 using quant_t = std::int8_t;
-using quant_product_t = std::int16_t;
 
 struct match_t {
     ustore_key_t key;
@@ -42,86 +67,75 @@ struct lower_similarity_t {
 
 using pq_t = limited_priority_queue_gt<match_t, lower_similarity_t>;
 
-static constexpr quant_t float_scaling_k = 100;
-static constexpr quant_product_t product_scaling_k = float_scaling_k * float_scaling_k;
+static constexpr real_t quant_max_k = 127;
 
-template <typename number_at>
-number_at square(number_at n) noexcept {
-    return n * n;
-}
+static constexpr std::size_t index_connectivity_default_k = 16;
+static constexpr std::size_t index_connectivity_max_k = 1024;
+static constexpr std::size_t index_expansion_default_k = 128;
+static constexpr std::size_t search_expansion_default_k = 64;
+static constexpr std::size_t index_levels_max_k = 16;
+static constexpr std::size_t exhaustive_block_k = 4096;
+static constexpr std::size_t exhaustive_tile_k = 64;
+static constexpr std::size_t exhaustive_parallel_threshold_k = 1u << 16;
+static constexpr ustore_length_t exhaustive_read_ahead_k = 1024;
+static constexpr ustore_key_t index_header_key_k = std::numeric_limits<ustore_key_t>::min();
 
-struct metric_dot_t {
-    real_t operator()(quant_t const* a, quant_t const* b, std::size_t dims) const noexcept {
-        std::int64_t sum = 0;
-        for (std::size_t i = 0; i != dims; ++i) {
-            quant_product_t ai = a[i];
-            quant_product_t bi = b[i];
-            sum += ai * bi;
-        }
-        return real_t(sum) / product_scaling_k;
-    }
+struct entry_t {
+    collection_key_t collection_key;
+    value_view_t value;
 };
 
-struct metric_cos_t {
-    real_t operator()(quant_t const* a, quant_t const* b, std::size_t dims) const noexcept {
-        std::int64_t sum = 0, a_norm = 0, b_norm = 0;
-        for (std::size_t i = 0; i != dims; ++i) {
-            quant_product_t ai = a[i];
-            quant_product_t bi = b[i];
-            sum += ai * bi;
-            a_norm += square(ai);
-            b_norm += square(bi);
-        }
-        auto nominator = real_t(sum) / product_scaling_k;
-        auto denominator = std::sqrt(real_t(a_norm) / product_scaling_k) * //
-                           std::sqrt(real_t(b_norm) / product_scaling_k);
-        return nominator / denominator;
-    }
+/**
+ * @brief Per-vector parameters of the quantized codes, persisted next to them.
+ */
+struct quant_meta_t {
+    /// @brief Multiplier, that restores the original scalars from the codes.
+    real_t scale = 0;
+    /// @brief Squared Euclidean norm of the restored vector.
+    real_t squared_norm = 0;
 };
 
-struct metric_l2_t {
+static_assert(sizeof(quant_meta_t) == 8, "The parameters are persisted as-is");
 
-    real_t operator()(quant_t const* a, std::size_t dims) const noexcept {
-        std::int64_t sum = 0;
-        for (std::size_t i = 0; i != dims; ++i)
-            sum += square<quant_product_t>(a[i]);
-        return std::sqrt(real_t(sum) / product_scaling_k);
-    }
-
-    real_t operator()(quant_t const* a, quant_t const* b, std::size_t dims) const noexcept {
-        std::int64_t sum = 0;
-        for (std::size_t i = 0; i != dims; ++i)
-            sum += square<quant_product_t>(a[i] - b[i]);
-        return std::sqrt(real_t(sum) / product_scaling_k);
-    }
-};
-
-struct entry_t {
-    collection_key_t collection_key;
-    value_view_t value;
+/**
+ * @brief Quantized vector, viewed together with its parameters.
+ */
+struct quant_view_t {
+    quant_t const* codes = nullptr;
+    quant_meta_t meta;
 };
 
+/**
+ * @brief Maps the largest absolute component of every vector to the edge of the `i8` range,
+ * so that inputs of any magnitude use all the precision, without overflowing.
+ * The squared norm is computed with the same kernel, as the searches, to produce
+ * exact zeros for identical vectors.
+ */
 template <typename float_at = real_t>
-void quantize(float_at const* originals, std::size_t dims, quant_t* quants) noexcept {
+quant_meta_t quantize(float_at const* originals, std::size_t dims, quant_t* quants) noexcept {
+    real_t max_magnitude = 0;
+    for (std::size_t i = 0; i != dims; ++i)
+        max_magnitude = std::max(max_magnitude, std::fabs(to_f32(originals[i])));
+
+    quant_meta_t meta;
+    meta.scale = max_magnitude / quant_max_k;
+    real_t inverse = max_magnitude != 0 ? quant_max_k / max_magnitude : 0;
     for (std::size_t i = 0; i != dims; ++i)
-        quants[i] = static_cast<quant_t>(originals[i] * float_scaling_k);
+        quants[i] = static_cast<quant_t>(std::lround(to_f32(originals[i]) * inverse));
+    meta.squared_norm = (meta.scale * meta.scale) * i8_metric(ustore_vector_metric_dot_k)(quants, quants, dims);
+    return meta;
 }
 
-void quantize(byte_t const* bytes, ustore_vector_scalar_t scalar_type, std::size_t dims, quant_t* quants) noexcept {
+quant_meta_t quantize(byte_t const* bytes,
+                      ustore_vector_scalar_t scalar_type,
+                      std::size_t dims,
+                      quant_t* quants) noexcept {
     switch (scalar_type) {
     case ustore_vector_scalar_f32_k: return quantize((real_t const*)bytes, dims, quants);
     case ustore_vector_scalar_f64_k: return quantize((double const*)bytes, dims, quants);
-    case ustore_vector_scalar_f16_k: return quantize((std::int16_t const*)bytes, dims, quants);
+    case ustore_vector_scalar_f16_k: return quantize((f16_bits_t const*)bytes, dims, quants);
     case ustore_vector_scalar_i8_k: return quantize((quant_t const*)bytes, dims, quants);
-    }
-}
-
-real_t metric(quant_t const* a, quant_t const* b, std::size_t dims, ustore_vector_metric_t kind) noexcept {
-    switch (kind) {
-    case ustore_vector_metric_dot_k: return metric_dot_t {}(a, b, dims);
-    case ustore_vector_metric_cos_k: return metric_cos_t {}(a, b, dims);
-    case ustore_vector_metric_l2_k: return metric_l2_t {}(a, b, dims);
-    default: return 0;
+    default: return {};
     }
 }
 
@@ -135,6 +149,103 @@ ustore_length_t size_bytes(ustore_vector_scalar_t scalar_type) noexcept {
     }
 }
 
+/**
+ * @brief Converts @p dims scalars between any supported types.
+ * Integers are rounded to the nearest and saturated.
+ */
+void convert(byte_t const* input,
+             ustore_vector_scalar_t input_type,
+             std::size_t dims,
+             ustore_vector_scalar_t output_type,
+             byte_t* output) noexcept {
+    if (input_type == output_type) {
+        std::memcpy(output, input, dims * size_bytes(input_type));
+        return;
+    }
+
+    auto convert_from = [&](auto const* typed_input) noexcept {
+        auto convert_into = [&](auto* typed_output) noexcept {
+            for (std::size_t i = 0; i != dims; ++i)
+                from_f32(to_f32(typed_input[i]), typed_output[i]);
+        };
+        switch (output_type) {
+        case ustore_vector_scalar_f32_k: return convert_into((real_t*)output);
+        case ustore_vector_scalar_f64_k: return convert_into((double*)output);
+        case ustore_vector_scalar_f16_k: return convert_into((f16_bits_t*)output);
+        case ustore_vector_scalar_i8_k: return convert_into((quant_t*)output);
+        }
+    };
+    switch (input_type) {
+    case ustore_vector_scalar_f32_k: return convert_from((real_t const*)input);
+    case ustore_vector_scalar_f64_k: return convert_from((double const*)input);
+    case ustore_vector_scalar_f16_k: return convert_from((f16_bits_t const*)input);
+    case ustore_vector_scalar_i8_k: return convert_from((quant_t const*)input);
+    }
+}
+
+void upcast(byte_t const* bytes, ustore_vector_scalar_t scalar_type, std::size_t dims, real_t* output) noexcept {
+    convert(bytes, scalar_type, dims, ustore_vector_scalar_f32_k, reinterpret_cast<byte_t*>(output));
+}
+
+/**
+ * @brief Infers the type of stored scalars from the length of a value,
+ * as all the supported types differ in size.
+ */
+bool stored_scalar_type(std::size_t length, std::size_t dims, ustore_vector_scalar_t& scalar_type) noexcept {
+    for (auto candidate : {ustore_vector_scalar_f32_k,
+                           ustore_vector_scalar_f16_k,
+                           ustore_vector_scalar_i8_k,
+                           ustore_vector_scalar_f64_k}) {
+        if (length != dims * size_bytes(candidate))
+            continue;
+        scalar_type = candidate;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Distance between quantized vectors, that is always lower for closer ones.
+ * Similarity measures, like "cos" and "dot", are negated. As vectors have different
+ * scales, every metric is derived from the inner product of the codes and the norms.
+ * The kernel is resolved on construction.
+ */
+struct quant_distance_t {
+    i8_metric_t kernel = nullptr;
+    ustore_vector_metric_t kind = ustore_vector_metric_cos_k;
+
+    quant_distance_t() = default;
+    explicit quant_distance_t(ustore_vector_metric_t kind) noexcept
+        : kernel(i8_metric(ustore_vector_metric_dot_k)), kind(kind) {}
+
+    real_t operator()(quant_view_t a, quant_view_t b, std::size_t dims) const noexcept {
+        real_t ab = (a.meta.scale * b.meta.scale) * kernel(a.codes, b.codes, dims);
+        real_t a2 = a.meta.squared_norm, b2 = b.meta.squared_norm;
+        switch (kind) {
+        case ustore_vector_metric_dot_k: return -ab;
+        case ustore_vector_metric_l2_k: return std::sqrt(std::max(a2 + b2 - 2 * ab, real_t(0)));
+        default: return -cos_from_products(ab, a2, b2);
+        }
+    }
+};
+
+/**
+ * @brief Converts distances into metrics and vice versa, being its own inverse.
+ */
+real_t distance_to_metric(real_t distance, ustore_vector_metric_t kind) noexcept {
+    return kind == ustore_vector_metric_l2_k ? distance : -distance;
+}
+
+inline bool is_vector_key(ustore_key_t key) noexcept {
+    return key >= 0 && key != std::numeric_limits<ustore_key_t>::max();
+}
+inline ustore_key_t node_key(ustore_key_t key) noexcept {
+    return -1 - key;
+}
+inline ustore_key_t original_key(ustore_key_t node_key) noexcept {
+    return -1 - node_key;
+}
+
 struct vectors_arg_t {
     strided_iterator_gt<ustore_bytes_cptr_t const> contents;
     strided_iterator_gt<ustore_length_t const> offsets;
@@ -153,7 +264,876 @@ struct vectors_arg_t {
     }
 };
 
+/**
+ * @brief Reads a batch of values from one collection into the @p scratch arena,
+ * passing them to the @p callback. Missing entries are reported with empty views.
+ */
+template <typename callback_at>
+void read_values(ustore_database_t db,
+                 ustore_transaction_t transaction,
+                 ustore_collection_t collection,
+                 ustore_options_t options,
+                 ustore_arena_t* scratch,
+                 ustore_error_t* error,
+                 ustore_key_t const* keys,
+                 std::size_t count,
+                 callback_at&& callback) {
+    ustore_octet_t* presences = nullptr;
+    ustore_length_t* offsets = nullptr;
+    ustore_length_t* lengths = nullptr;
+    ustore_bytes_ptr_t values = nullptr;
+
+    ustore_read_t read {};
+    read.db = db;
+    read.error = error;
+    read.transaction = transaction;
+    read.arena = scratch;
+    read.options = options;
+    read.tasks_count = count;
+    read.collections = &collection;
+    read.collections_stride = 0;
+    read.keys = keys;
+    read.keys_stride = sizeof(ustore_key_t);
+    read.presences = &presences;
+    read.offsets = &offsets;
+    read.lengths = &lengths;
+    read.values = &values;
+    ustore_read(&read);
+    return_if_error_m(error);
+
+    for (std::size_t i = 0; i != count; ++i) {
+        bool present = lengths[i] != ustore_length_missing_k;
+        callback(i, present ? value_view_t {values + offsets[i], lengths[i]} : value_view_t {});
+    }
+}
+
+/**
+ * @brief Decides, which candidates of a `ustore_vectors_search()` call are eligible.
+ * The documents predicate is evaluated for whole batches of keys with a single
+ * `ustore_docs_gather()`, and the verdicts are cached for the rest of the call.
+ * Keys must be `prefetch()`-ed before asking, if they are `allowed()`.
+ */
+class vectors_filter_t {
+
+    ustore_vectors_search_t const& c_;
+    bool has_allow_list_ = false;
+    std::vector<ustore_key_t> allowed_;
+    std::unordered_map<ustore_key_t, bool, key_hash_t> verdicts_;
+    std::vector<ustore_key_t> pending_;
+    std::vector<ustore_doc_field_type_t> types_;
+    ustore_arena_t scratch_ = nullptr;
+
+    static std::string_view unterminated(std::string_view str) noexcept {
+        return !str.empty() && str.back() == '\0' ? str.substr(0, str.size() - 1) : str;
+    }
+
+    void evaluate_pending() {
+        ustore_octet_t** validities = nullptr;
+        ustore_length_t** offsets = nullptr;
+        ustore_length_t** lengths = nullptr;
+        ustore_byte_t* strings = nullptr;
+
+        ustore_docs_gather_t gather {};
+        gather.db = c_.db;
+        gather.error = c_.error;
+        gather.transaction = c_.transaction;
+        gather.arena = &scratch_;
+        gather.options = c_.options;
+        gather.docs_count = pending_.size();
+        gather.fields_count = c_.filter_fields_count;
+        gather.collections = &c_.filter_collection;
+        gather.collections_stride = 0;
+        gather.keys = pending_.data();
+        gather.keys_stride = sizeof(ustore_key_t);
+        gather.fields = c_.filter_fields;
+        gather.fields_stride = c_.filter_fields_stride;
+        gather.types = types_.data();
+        gather.types_stride = sizeof(ustore_doc_field_type_t);
+        gather.columns_validities = &validities;
+        gather.columns_offsets = &offsets;
+        gather.columns_lengths = &lengths;
+        gather.joined_strings = &strings;
+        ustore_docs_gather(&gather);
+        return_if_error_m(c_.error);
+
+        strided_iterator_gt<ustore_str_view_t const> values {c_.filter_values, c_.filter_values_stride};
+        for (std::size_t doc_idx = 0; doc_idx != pending_.size(); ++doc_idx) {
+            bool eligible = true;
+            for (std::size_t field_idx = 0; field_idx != c_.filter_fields_count && eligible; ++field_idx) {
+                bits_span_t validity {validities[field_idx]};
+                auto begin = reinterpret_cast<char const*>(strings) + offsets[field_idx][doc_idx];
+                std::string_view gathered {begin, lengths[field_idx][doc_idx]};
+                eligible = validity[doc_idx] && unterminated(gathered) == values[field_idx];
+            }
+            verdicts_.emplace(pending_[doc_idx], eligible);
+        }
+    }
+
+  public:
+    explicit vectors_filter_t(ustore_vectors_search_t const& c)
+        : c_(c), has_allow_list_(c.allowed_keys != nullptr),
+          types_(c.filter_fields_count, ustore_doc_field_str_k) {
+        if (has_allow_list_) {
+            allowed_.assign(c.allowed_keys, c.allowed_keys + c.allowed_keys_count);
+            std::sort(allowed_.begin(), allowed_.end());
+        }
+    }
+    ~vectors_filter_t() noexcept { ustore_arena_free(scratch_); }
+    vectors_filter_t(vectors_filter_t const&) = delete;
+    vectors_filter_t& operator=(vectors_filter_t const&) = delete;
+
+    bool active() const noexcept { return has_allow_list_ || c_.filter_fields_count; }
+    ustore_error_t* error() const noexcept { return c_.error; }
+
+    /**
+     * @brief Evaluates the documents predicate for the @p keys, that weren't checked yet.
+     * Keys outside of the allow-list are skipped, as their documents don't matter.
+     */
+    template <typename keys_at>
+    void prefetch(keys_at const& keys) {
+        if (!c_.filter_fields_count)
+            return;
+        pending_.clear();
+        for (ustore_key_t key : keys)
+            if (key != ustore_key_unknown_k && in_allow_list(key) && !verdicts_.count(key))
+                pending_.push_back(key);
+        std::sort(pending_.begin(), pending_.end());
+        pending_.erase(std::unique(pending_.begin(), pending_.end()), pending_.end());
+        if (!pending_.empty())
+            evaluate_pending();
+    }
+
+    bool in_allow_list(ustore_key_t key) const noexcept {
+        return !has_allow_list_ || std::binary_search(allowed_.begin(), allowed_.end(), key);
+    }
+
+    bool allowed(ustore_key_t key) const noexcept {
+        if (!in_allow_list(key))
+            return false;
+        if (!c_.filter_fields_count)
+            return true;
+        auto it = verdicts_.find(key);
+        return it != verdicts_.end() && it->second;
+    }
+};
+
+/**
+ * @brief Persistent part of the index, shared by all the nodes of a collection.
+ */
+struct index_header_t {
+    ustore_key_t entry = 0;
+    std::uint32_t dimensions = 0;
+    std::uint16_t connectivity = 0;
+    std::uint8_t metric = 0;
+    std::uint8_t max_level = 0;
+};
+
+static_assert(sizeof(index_header_t) == 16, "The header is persisted as-is");
+
+struct index_node_t {
+    std::vector<quant_t> quants;
+    quant_meta_t meta;
+    std::vector<std::vector<ustore_key_t>> neighbors;
+    bool dirty = false;
+
+    std::size_t levels() const noexcept { return neighbors.size(); }
+    quant_view_t view() const noexcept { return {quants.data(), meta}; }
+};
+
+struct candidate_t {
+    real_t distance;
+    ustore_key_t key;
+};
+
+struct closer_t {
+    bool operator()(candidate_t const& a, candidate_t const& b) const noexcept { return a.distance < b.distance; }
+};
+
+struct farther_t {
+    bool operator()(candidate_t const& a, candidate_t const& b) const noexcept { return a.distance > b.distance; }
+};
+
+/**
+ * @brief Hierarchical Navigable Small World index over a single collection.
+ * https://arxiv.org/abs/1603.09320
+ *
+ * Caches every node it has visited, fetching the missing neighbors of the
+ * expanded candidates in batches. Modified nodes are only marked dirty and
+ * are submitted later with a single `ustore_write()`, together with originals.
+ * Levels are derived from the hash of the key, so re-inserting with the same
+ * key keeps the shape of the graph.
+ */
+class hnsw_t {
+
+    ustore_database_t db_ = nullptr;
+    ustore_transaction_t transaction_ = nullptr;
+    ustore_collection_t collection_ = ustore_collection_main_k;
+    ustore_options_t options_ = ustore_options_default_k;
+    ustore_error_t* error_ = nullptr;
+    ustore_arena_t scratch_ = nullptr;
+
+    index_header_t header_;
+    quant_distance_t distance_;
+    bool exists_ = false;
+    bool header_dirty_ = false;
+
+    std::unordered_map<ustore_key_t, index_node_t, key_hash_t> nodes_;
+    std::unordered_set<ustore_key_t, key_hash_t> missing_;
+    std::vector<ustore_key_t> pending_;
+
+    std::size_t dims() const noexcept { return header_.dimensions; }
+    ustore_vector_metric_t kind() const noexcept { return static_cast<ustore_vector_metric_t>(header_.metric); }
+    std::size_t neighbors_limit(std::size_t level) const noexcept {
+        return level ? header_.connectivity : header_.connectivity * 2u;
+    }
+
+    real_t distance(quant_view_t query, ustore_key_t key) const noexcept {
+        return distance_(query, nodes_.at(key).view(), dims());
+    }
+
+    template <typename callback_at>
+    void read_batch(ustore_key_t const* keys, std::size_t count, callback_at&& callback) {
+        read_values(db_, transaction_, collection_, options_, &scratch_, error_, keys, count, callback);
+    }
+
+    bool parse(value_view_t value, index_node_t& node) const {
+        byte_t const* it = value.begin();
+        byte_t const* end = value.end();
+        if (std::size_t(end - it) < sizeof(quant_meta_t) + dims() + 1u)
+            return false;
+
+        std::memcpy(&node.meta, it, sizeof(quant_meta_t));
+        it += sizeof(quant_meta_t);
+        node.quants.resize(dims());
+        std::memcpy(node.quants.data(), it, dims());
+        it += dims();
+        auto levels = static_cast<std::size_t>(*it++);
+        if (!levels || levels > index_levels_max_k)
+            return false;
+
+        node.neighbors.resize(levels);
+        for (auto& neighbors : node.neighbors) {
+            std::uint16_t count = 0;
+            if (std::size_t(end - it) < sizeof(count))
+                return false;
+            std::memcpy(&count, it, sizeof(count));
+            it += sizeof(count);
+            if (std::size_t(end - it) < count * sizeof(ustore_key_t))
+                return false;
+            neighbors.resize(count);
+            if (count)
+                std::memcpy(neighbors.data(), it, count * sizeof(ustore_key_t));
+            it += count * sizeof(ustore_key_t);
+        }
+        return true;
+    }
+
+    void serialize(index_node_t const& node, std::string& output) const {
+        output.append(reinterpret_cast<char const*>(&node.meta), sizeof(quant_meta_t));
+        output.append(reinterpret_cast<char const*>(node.quants.data()), node.quants.size());
+        output.push_back(static_cast<char>(node.levels()));
+        for (auto const& neighbors : node.neighbors) {
+            auto count = static_cast<std::uint16_t>(neighbors.size());
+            output.append(reinterpret_cast<char const*>(&count), sizeof(count));
+            if (count)
+                output.append(reinterpret_cast<char const*>(neighbors.data()), count * sizeof(ustore_key_t));
+        }
+    }
+
+    /**
+     * @brief Makes sure all the requested nodes, that exist, are present in `nodes_`.
+     */
+    template <typename keys_at>
+    void fetch(keys_at const& keys) {
+        pending_.clear();
+        for (ustore_key_t key : keys)
+            if (!nodes_.count(key) && !missing_.count(key))
+                pending_.push_back(node_key(key));
+        if (pending_.empty())
+            return;
+
+        read_batch(pending_.data(), pending_.size(), [&](std::size_t i, value_view_t value) {
+            ustore_key_t key = original_key(pending_[i]);
+            index_node_t node;
+            if (value && parse(value, node))
+                nodes_.emplace(key, std::move(node));
+            else
+                missing_.insert(key);
+        });
+    }
+
+    index_node_t* find(ustore_key_t key) noexcept {
+        auto it = nodes_.find(key);
+        return it != nodes_.end() ? &it->second : nullptr;
+    }
+
+    std::size_t random_level(ustore_key_t key) const noexcept {
+        // SplitMix64 finalizer
+        auto x = static_cast<std::uint64_t>(key) + 0x9E3779B97F4A7C15ull;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        x ^= x >> 31;
+        double uniform = (double(x >> 11) + 1.0) / double(1ull << 53);
+        auto level = static_cast<std::size_t>(-std::log(uniform) / std::log(double(header_.connectivity)));
+        return std::min(level, index_levels_max_k - 1u);
+    }
+
+    /**
+     * @brief Beam search within a single layer of the graph.
+     * @param[inout] entries Starting points on input, `ef` closest nodes on output, sorted by distance.
+     * @param filter Optional, excludes nodes from the outputs, but not from the traversal.
+     */
+    void search_layer(quant_view_t query,
+                      std::vector<candidate_t>& entries,
+                      std::size_t ef,
+                      std::size_t level,
+                      vectors_filter_t* filter = nullptr) {
+        std::unordered_set<ustore_key_t, key_hash_t> visited;
+        std::priority_queue<candidate_t, std::vector<candidate_t>, farther_t> candidates;
+        std::priority_queue<candidate_t, std::vector<candidate_t>, closer_t> results;
+        auto eligible = [&](ustore_key_t key) noexcept { return !filter || filter->allowed(key); };
+        std::vector<ustore_key_t> unvisited;
+        if (filter) {
+            for (auto const& entry : entries)
+                unvisited.push_back(entry.key);
+            filter->prefetch(unvisited);
+            return_if_error_m(error_);
+        }
+        for (auto const& entry : entries) {
+            if (!visited.insert(entry.key).second)
+                continue;
+            candidates.push(entry);
+            if (!eligible(entry.key))
+                continue;
+            results.push(entry);
+            if (results.size() > ef)
+                results.pop();
+        }
+
+        while (!candidates.empty()) {
+            candidate_t closest = candidates.top();
+            if (results.size() >= ef && closest.distance > results.top().distance)
+                break;
+            candidates.pop();
+
+            index_node_t* node = find(closest.key);
+            if (!node || node->levels() <= level)
+                continue;
+
+            unvisited.clear();
+            for (ustore_key_t neighbor : node->neighbors[level])
+                if (visited.insert(neighbor).second)
+                    unvisited.push_back(neighbor);
+            fetch(unvisited);
+            return_if_error_m(error_);
+            if (filter) {
+                filter->prefetch(unvisited);
+                return_if_error_m(error_);
+            }
+
+            for (ustore_key_t neighbor : unvisited) {
+                if (!find(neighbor))
+                    continue;
+                candidate_t candidate {distance(query, neighbor), neighbor};
+                if (results.size() >= ef && candidate.distance >= results.top().distance)
+                    continue;
+                candidates.push(candidate);
+                if (!eligible(neighbor))
+                    continue;
+                results.push(candidate);
+                if (results.size() > ef)
+                    results.pop();
+            }
+        }
+
+        entries.resize(results.size());
+        for (auto it = entries.rbegin(); it != entries.rend(); ++it)
+            *it = results.top(), results.pop();
+    }
+
+    /**
+     * @brief Greedily descends from the entry point down to the `target_level`.
+     */
+    candidate_t descend(quant_view_t query, std::size_t target_level) {
+        fetch(std::initializer_list<ustore_key_t> {header_.entry});
+        if (*error_ || !find(header_.entry))
+            return {0, ustore_key_unknown_k};
+
+        std::vector<candidate_t> entries {{distance(query, header_.entry), header_.entry}};
+        for (std::size_t level = header_.max_level; level > target_level && !*error_; --level)
+            search_layer(query, entries, 1, level);
+        return entries.front();
+    }
+
+    /**
+     * @brief Diversity heuristic: skips candidates, that are closer to an already selected neighbor,
+     * than to the base node. Tops up the selection with the skipped ones, if too few remain.
+     * @param candidates Sorted by the distance to the base node.
+     */
+    void select_neighbors(std::vector<candidate_t>& candidates, std::size_t limit) const {
+        if (candidates.size() <= limit)
+            return;
+
+        std::vector<candidate_t> selected, skipped;
+        selected.reserve(limit);
+        for (auto const& candidate : candidates) {
+            if (selected.size() == limit)
+                break;
+            quant_view_t quants = nodes_.at(candidate.key).view();
+            bool diverse = std::all_of(selected.begin(), selected.end(), [&](candidate_t const& neighbor) {
+                return distance(quants, neighbor.key) >= candidate.distance;
+            });
+            (diverse ? selected : skipped).push_back(candidate);
+        }
+        for (std::size_t i = 0; i != skipped.size() && selected.size() != limit; ++i)
+            selected.push_back(skipped[i]);
+        candidates = std::move(selected);
+    }
+
+    void link(ustore_key_t from, ustore_key_t to, std::size_t level) {
+        index_node_t* node = find(from);
+        if (!node || node->levels() <= level)
+            return;
+
+        auto& neighbors = node->neighbors[level];
+        if (std::find(neighbors.begin(), neighbors.end(), to) != neighbors.end())
+            return;
+        neighbors.push_back(to);
+        node->dirty = true;
+
+        std::size_t limit = neighbors_limit(level);
+        if (neighbors.size() <= limit)
+            return;
+
+        // Shrink the overflowing list, preferring the closest and the most diverse neighbors
+        fetch(neighbors);
+        return_if_error_m(error_);
+        std::vector<candidate_t> candidates;
+        candidates.reserve(neighbors.size());
+        for (ustore_key_t neighbor : neighbors)
+            if (find(neighbor))
+                candidates.push_back({distance(node->view(), neighbor), neighbor});
+        std::sort(candidates.begin(), candidates.end(), closer_t {});
+        select_neighbors(candidates, limit);
+
+        neighbors.clear();
+        for (auto const& candidate : candidates)
+            neighbors.push_back(candidate.key);
+    }
+
+  public:
+    hnsw_t(ustore_database_t db,
+           ustore_transaction_t transaction,
+           ustore_collection_t collection,
+           ustore_options_t options,
+           ustore_error_t* error) noexcept
+        : db_(db), transaction_(transaction), collection_(collection), error_(error) {
+        // Scratch reads don't need to be watched, if only the written nodes would be checked for conflicts
+        options_ = ustore_options_t((options & arena_options_k) | ustore_option_transaction_dont_watch_k);
+    }
+
+    hnsw_t(hnsw_t&& other) noexcept
+        : db_(other.db_), transaction_(other.transaction_), collection_(other.collection_), options_(other.options_),
+          error_(other.error_), scratch_(std::exchange(other.scratch_, nullptr)), header_(other.header_),
+          distance_(other.distance_), exists_(other.exists_), header_dirty_(other.header_dirty_),
+          nodes_(std::move(other.nodes_)), missing_(std::move(other.missing_)) {}
+
+    hnsw_t(hnsw_t const&) = delete;
+    hnsw_t& operator=(hnsw_t const&) = delete;
+    hnsw_t& operator=(hnsw_t&&) = delete;
+
+    ~hnsw_t() noexcept { ustore_arena_free(scratch_); }
+
+    bool exists() const noexcept { return exists_; }
+    index_header_t const& header() const noexcept { return header_; }
+
+    /**
+     * @brief Loads the header of an existing index, if any.
+     */
+    void open() {
+        read_batch(&index_header_key_k, 1, [&](std::size_t, value_view_t value) {
+            exists_ = value.size() == sizeof(index_header_t);
+            if (exists_)
+                std::memcpy(&header_, value.data(), sizeof(index_header_t));
+        });
+        distance_ = quant_distance_t(kind());
+    }
+
+    /**
+     * @brief Initializes the header of a new index.
+     */
+    void create(std::size_t dimensions, ustore_vector_metric_t metric, std::size_t connectivity) noexcept {
+        header_.dimensions = static_cast<std::uint32_t>(dimensions);
+        header_.metric = static_cast<std::uint8_t>(metric);
+        header_.connectivity = static_cast<std::uint16_t>(connectivity);
+        distance_ = quant_distance_t(metric);
+    }
+
+    void insert(ustore_key_t key, quant_view_t quants, std::size_t expansion) {
+
+        fetch(std::initializer_list<ustore_key_t> {key});
+        return_if_error_m(error_);
+
+        // Re-inserted nodes keep their levels, but get new vectors and neighbors
+        index_node_t* existing = find(key);
+        index_node_t& node = existing ? *existing : nodes_[key];
+        std::size_t level = existing ? node.levels() - 1u : random_level(key);
+        node.quants.assign(quants.codes, quants.codes + dims());
+        node.meta = quants.meta;
+        node.neighbors.resize(level + 1u);
+        node.dirty = true;
+        missing_.erase(key);
+
+        if (!exists_) {
+            header_.entry = key;
+            header_.max_level = static_cast<std::uint8_t>(level);
+            exists_ = header_dirty_ = true;
+            return;
+        }
+
+        candidate_t entry = descend(quants, level);
+        return_if_error_m(error_);
+        if (entry.key == ustore_key_unknown_k) {
+            // The entry point has vanished, so this node starts a new graph
+            header_.entry = key;
+            header_.max_level = static_cast<std::uint8_t>(level);
+            header_dirty_ = true;
+            return;
+        }
+
+        std::vector<candidate_t> entries {entry};
+        std::vector<candidate_t> selected;
+        for (std::size_t l = std::min<std::size_t>(level, header_.max_level) + 1u; l != 0; --l) {
+            std::size_t current_level = l - 1u;
+            search_layer(quants, entries, expansion, current_level);
+            return_if_error_m(error_);
+
+            selected.clear();
+            for (auto const& candidate : entries)
+                if (candidate.key != key)
+                    selected.push_back(candidate);
+            select_neighbors(selected, header_.connectivity);
+
+            // The `node` reference is stable, as `std::unordered_map` never relocates its nodes
+            auto& neighbors = node.neighbors[current_level];
+            neighbors.clear();
+            for (auto const& neighbor : selected)
+                neighbors.push_back(neighbor.key);
+            for (auto const& neighbor : selected) {
+                link(neighbor.key, key, current_level);
+                return_if_error_m(error_);
+            }
+        }
+
+        if (level > header_.max_level) {
+            header_.entry = key;
+            header_.max_level = static_cast<std::uint8_t>(level);
+            header_dirty_ = true;
+        }
+    }
+
+    /**
+     * @brief Finds up to `ef` approximate nearest neighbors, sorted by distance.
+     * The upper layers are only used for navigation, so the @p filter applies to the bottom one.
+     */
+    void search(quant_view_t query, std::size_t ef, std::vector<candidate_t>& results, vectors_filter_t* filter) {
+        results.clear();
+        if (!exists_)
+            return;
+
+        candidate_t entry = descend(query, 0);
+        if (*error_ || entry.key == ustore_key_unknown_k)
+            return;
+
+        results.push_back(entry);
+        search_layer(query, results, ef, 0, filter);
+    }
+
+    /**
+     * @brief Serializes the header and the modified nodes into `(key, value)` pairs.
+     */
+    void serialize(std::vector<std::pair<collection_key_t, std::string>>& output) const {
+        for (auto const& key_and_node : nodes_) {
+            if (!key_and_node.second.dirty)
+                continue;
+            output.emplace_back(collection_key_t {collection_, node_key(key_and_node.first)}, std::string {});
+            serialize(key_and_node.second, output.back().second);
+        }
+        if (header_dirty_) {
+            std::string header(sizeof(index_header_t), '\0');
+            std::memcpy(header.data(), &header_, sizeof(index_header_t));
+            output.emplace_back(collection_key_t {collection_, index_header_key_k}, std::move(header));
+        }
+    }
+};
+
+/**
+ * @brief Persistent part of a packed companion collection.
+ * Collections with product quantization follow it with the codebooks.
+ */
+struct packed_header_t {
+    std::uint32_t dimensions = 0;
+    std::uint32_t block_capacity = 0;
+    std::uint64_t slots_count = 0;
+    std::uint32_t subspaces = 0;
+    std::uint32_t reserved = 0;
+};
+
+static_assert(sizeof(packed_header_t) == 24, "The header is persisted as-is");
+
+/**
+ * @brief A vector to be packed, in all of its representations.
+ */
+struct packed_input_t {
+    ustore_key_t key = ustore_key_unknown_k;
+    quant_view_t quants;
+    value_view_t original;
+};
+
+/**
+ * @brief Quantized copies of vectors, packed into fixed-size blocks of a companion collection.
+ *
+ * Every vector gets a permanent slot on first write, and slot `s` lives in the block `s / capacity`,
+ * stored under the key `s / capacity`. The slot of key `k` is kept under `-1 - k`, and the lowest
+ * key holds the header. Blocks start with the keys of their slots, unused ones being unknown,
+ * followed by the parameters and the row-major matrix of codes:
+ *
+ *      [capacity x ustore_key_t] [capacity x quant_meta_t] [capacity x codes]
+ *
+ * Codes are either `dims` scaled `i8` quants, or `subspaces` bytes of product quantization,
+ * with codebooks trained on the first written batch. As the capacity is a multiple of 64,
+ * all parts start at cache-line aligned offsets, so scans can compare queries to the whole
+ * block in place.
+ */
+class packed_vectors_t {
+
+    ustore_database_t db_ = nullptr;
+    ustore_transaction_t transaction_ = nullptr;
+    ustore_collection_t collection_ = ustore_collection_main_k;
+    ustore_options_t options_ = ustore_options_default_k;
+    ustore_error_t* error_ = nullptr;
+    ustore_arena_t scratch_ = nullptr;
+
+    packed_header_t header_;
+    product_quantizer_t quantizer_;
+    bool exists_ = false;
+    bool trained_ = false;
+    bool header_dirty_ = false;
+
+    std::unordered_map<ustore_key_t, std::uint64_t, key_hash_t> new_slots_;
+    std::map<ustore_key_t, std::string> blocks_;
+
+    std::size_t dims() const noexcept { return header_.dimensions; }
+
+  public:
+    packed_vectors_t(ustore_database_t db,
+                     ustore_transaction_t transaction,
+                     ustore_collection_t collection,
+                     ustore_options_t options,
+                     ustore_error_t* error) noexcept
+        : db_(db), transaction_(transaction), collection_(collection), error_(error) {
+        options_ = ustore_options_t((options & arena_options_k) | ustore_option_transaction_dont_watch_k);
+    }
+
+    packed_vectors_t(packed_vectors_t&& other) noexcept
+        : db_(other.db_), transaction_(other.transaction_), collection_(other.collection_), options_(other.options_),
+          error_(other.error_), scratch_(std::exchange(other.scratch_, nullptr)), header_(other.header_),
+          quantizer_(std::move(other.quantizer_)), exists_(other.exists_), trained_(other.trained_),
+          header_dirty_(other.header_dirty_), new_slots_(std::move(other.new_slots_)),
+          blocks_(std::move(other.blocks_)) {}
+
+    packed_vectors_t(packed_vectors_t const&) = delete;
+    packed_vectors_t& operator=(packed_vectors_t const&) = delete;
+    packed_vectors_t& operator=(packed_vectors_t&&) = delete;
+
+    ~packed_vectors_t() noexcept { ustore_arena_free(scratch_); }
+
+    bool exists() const noexcept { return exists_; }
+    packed_header_t const& header() const noexcept { return header_; }
+    product_quantizer_t const& quantizer() const noexcept { return quantizer_; }
+
+    bool is_product() const noexcept { return header_.subspaces != 0; }
+    std::size_t capacity() const noexcept { return header_.block_capacity; }
+    std::size_t code_bytes() const noexcept { return is_product() ? header_.subspaces : dims(); }
+    std::size_t metas_offset() const noexcept { return capacity() * sizeof(ustore_key_t); }
+    std::size_t codes_offset() const noexcept { return metas_offset() + capacity() * sizeof(quant_meta_t); }
+
+    /**
+     * @brief Bytes of a single block value, or zero if the layout isn't defined yet.
+     */
+    std::size_t block_bytes() const noexcept { return codes_offset() + capacity() * code_bytes(); }
+
+    void open() {
+        read_values(db_,
+                    transaction_,
+                    collection_,
+                    options_,
+                    &scratch_,
+                    error_,
+                    &index_header_key_k,
+                    1,
+                    [&](std::size_t, value_view_t value) {
+                        if (value.size() < sizeof(packed_header_t))
+                            return;
+                        std::memcpy(&header_, value.data(), sizeof(packed_header_t));
+                        if (!is_product()) {
+                            exists_ = value.size() == sizeof(packed_header_t);
+                            return;
+                        }
+                        quantizer_ = product_quantizer_t(header_.dimensions, header_.subspaces);
+                        exists_ = value.size() == sizeof(packed_header_t) + quantizer_.codebooks_bytes();
+                        trained_ = exists_;
+                        if (exists_)
+                            std::memcpy(quantizer_.codebooks(),
+                                        value.data() + sizeof(packed_header_t),
+                                        quantizer_.codebooks_bytes());
+                    });
+    }
+
+    /**
+     * @brief Initializes the header, sizing blocks to about a MiB, but no more than 4K vectors.
+     * @param subspaces Zero for scaled `i8` quants, or the number of bytes of product quantization.
+     */
+    void create(std::size_t dimensions, std::size_t subspaces) {
+        header_ = {};
+        header_.dimensions = static_cast<std::uint32_t>(dimensions);
+        header_.subspaces = static_cast<std::uint32_t>(subspaces);
+        std::size_t capacity = (std::size_t(1) << 20) / code_bytes();
+        capacity = std::min<std::size_t>(std::max<std::size_t>(capacity, exhaustive_tile_k), exhaustive_block_k);
+        header_.block_capacity = static_cast<std::uint32_t>(capacity / exhaustive_tile_k * exhaustive_tile_k);
+        if (is_product())
+            quantizer_ = product_quantizer_t(dimensions, subspaces);
+        exists_ = header_dirty_ = true;
+        trained_ = false;
+    }
+
+    /**
+     * @brief Places the vectors into their slots, allocating new slots for unseen keys.
+     * For repeated keys, the last vector wins.
+     */
+    void insert(std::vector<packed_input_t> const& vectors, ustore_vector_scalar_t scalar_type) {
+        if (vectors.empty())
+            return;
+
+        // Product quantization needs full-precision inputs, and the first batch trains the codebooks
+        std::vector<std::uint8_t> product_codes;
+        std::vector<real_t> product_norms;
+        if (is_product()) {
+            std::vector<real_t> floats(vectors.size() * dims());
+            for (std::size_t i = 0; i != vectors.size(); ++i)
+                upcast(vectors[i].original.begin(), scalar_type, dims(), floats.data() + i * dims());
+            if (!trained_) {
+                quantizer_.train(floats.data(), vectors.size());
+                trained_ = header_dirty_ = true;
+            }
+            product_codes.resize(vectors.size() * code_bytes());
+            product_norms.resize(vectors.size());
+            for (std::size_t i = 0; i != vectors.size(); ++i)
+                product_norms[i] =
+                    quantizer_.encode(floats.data() + i * dims(), product_codes.data() + i * code_bytes());
+        }
+
+        // Find the slots of previously written vectors
+        std::vector<ustore_key_t> map_keys(vectors.size());
+        std::vector<std::uint64_t> slots(vectors.size(), std::numeric_limits<std::uint64_t>::max());
+        transform_n(vectors.begin(), vectors.size(), map_keys.begin(), [](packed_input_t const& input) {
+            return node_key(input.key);
+        });
+        read_values(db_,
+                    transaction_,
+                    collection_,
+                    options_,
+                    &scratch_,
+                    error_,
+                    map_keys.data(),
+                    map_keys.size(),
+                    [&](std::size_t i, value_view_t value) {
+                        if (value.size() == sizeof(std::uint64_t))
+                            std::memcpy(&slots[i], value.data(), sizeof(std::uint64_t));
+                    });
+        return_if_error_m(error_);
+
+        // Allocate slots for the new ones, once per key
+        for (std::size_t i = 0; i != vectors.size(); ++i) {
+            if (slots[i] != std::numeric_limits<std::uint64_t>::max())
+                continue;
+            auto it = new_slots_.find(vectors[i].key);
+            if (it == new_slots_.end()) {
+                it = new_slots_.emplace(vectors[i].key, header_.slots_count++).first;
+                header_dirty_ = true;
+            }
+            slots[i] = it->second;
+        }
+
+        // Load the touched blocks, that were already persisted
+        std::vector<ustore_key_t> block_keys;
+        for (std::uint64_t slot : slots) {
+            auto block_key = static_cast<ustore_key_t>(slot / capacity());
+            if (blocks_.emplace(block_key, std::string {}).second)
+                block_keys.push_back(block_key);
+        }
+        read_values(db_,
+                    transaction_,
+                    collection_,
+                    options_,
+                    &scratch_,
+                    error_,
+                    block_keys.data(),
+                    block_keys.size(),
+                    [&](std::size_t i, value_view_t value) {
+                        std::string& block = blocks_[block_keys[i]];
+                        if (value.size() == block_bytes()) {
+                            block.assign(reinterpret_cast<char const*>(value.data()), value.size());
+                            return;
+                        }
+                        block.assign(block_bytes(), '\0');
+                        for (std::size_t slot_idx = 0; slot_idx != capacity(); ++slot_idx)
+                            std::memcpy(block.data() + slot_idx * sizeof(ustore_key_t),
+                                        &ustore_key_unknown_k,
+                                        sizeof(ustore_key_t));
+                    });
+        return_if_error_m(error_);
+
+        // Patch the blocks in memory
+        for (std::size_t i = 0; i != vectors.size(); ++i) {
+            std::string& block = blocks_[static_cast<ustore_key_t>(slots[i] / capacity())];
+            std::size_t slot_idx = slots[i] % capacity();
+            quant_meta_t meta = vectors[i].quants.meta;
+            void const* codes = vectors[i].quants.codes;
+            if (is_product()) {
+                meta = quant_meta_t {1, product_norms[i]};
+                codes = product_codes.data() + i * code_bytes();
+            }
+            std::memcpy(block.data() + slot_idx * sizeof(ustore_key_t), &vectors[i].key, sizeof(ustore_key_t));
+            std::memcpy(block.data() + metas_offset() + slot_idx * sizeof(quant_meta_t), &meta, sizeof(meta));
+            std::memcpy(block.data() + codes_offset() + slot_idx * code_bytes(), codes, code_bytes());
+        }
+    }
+
+    /**
+     * @brief Serializes the modified blocks, the new slots and the header into `(key, value)` pairs.
+     */
+    void serialize(std::vector<std::pair<collection_key_t, std::string>>& output) const {
+        for (auto const& key_and_block : blocks_)
+            output.emplace_back(collection_key_t {collection_, key_and_block.first}, key_and_block.second);
+        for (auto const& key_and_slot : new_slots_) {
+            std::string slot(sizeof(std::uint64_t), '\0');
+            std::memcpy(slot.data(), &key_and_slot.second, sizeof(std::uint64_t));
+            output.emplace_back(collection_key_t {collection_, node_key(key_and_slot.first)}, std::move(slot));
+        }
+        if (header_dirty_) {
+            std::size_t codebooks_bytes = is_product() ? quantizer_.codebooks_bytes() : 0u;
+            std::string header(sizeof(packed_header_t) + codebooks_bytes, '\0');
+            std::memcpy(header.data(), &header_, sizeof(packed_header_t));
+            if (codebooks_bytes)
+                std::memcpy(header.data() + sizeof(packed_header_t), quantizer_.codebooks(), codebooks_bytes);
+            output.emplace_back(collection_key_t {collection_, index_header_key_k}, std::move(header));
+        }
+    }
+};
+
 void ustore_vectors_write(ustore_vectors_write_t* c_ptr) {
+    trace_span_m("vectors_write");
 
     ustore_vectors_write_t& c = *c_ptr;
     linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
@@ -162,107 +1142,131 @@ void ustore_vectors_write(ustore_vectors_write_t* c_ptr) {
     strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
     strided_iterator_gt<ustore_key_t const> keys {c.keys, c.keys_stride};
     places_arg_t places_args {collections, keys, {}, c.tasks_count};
+    strided_iterator_gt<ustore_collection_t const> packed_collections {c.packed_collections,
+                                                                      c.packed_collections_stride};
 
     strided_iterator_gt<ustore_bytes_cptr_t const> starts {c.vectors_starts, c.vectors_starts_stride};
     strided_iterator_gt<ustore_length_t const> offs {c.offsets, c.offsets_stride};
     vectors_arg_t vectors_args {starts, offs, c.vectors_stride, c.scalar_type, c.dimensions, c.tasks_count};
 
-    // For each input key we must get its
-    auto quantized_entries = arena.alloc<entry_t>(c.tasks_count * 2u, c.error);
-    return_if_error_m(c.error);
+    return_error_if_m(c.dimensions, c.error, args_wrong_k, "Vectors must have at least one dimension");
+    for (std::size_t task_idx = 0; task_idx != c.tasks_count; ++task_idx)
+        return_error_if_m(is_vector_key(places_args[task_idx].key),
+                          c.error,
+                          args_wrong_k,
+                          "Vector keys must be non-negative");
+
+    auto connectivity = c.index_connectivity ? c.index_connectivity : index_connectivity_default_k;
+    auto expansion = c.index_expansion ? c.index_expansion : index_expansion_default_k;
+    connectivity = std::min<std::size_t>(std::max<std::size_t>(connectivity, 2u), index_connectivity_max_k);
+
+    return_error_if_m(!c.packed_subspaces || c.dimensions % c.packed_subspaces == 0,
+                      c.error,
+                      args_wrong_k,
+                      "Dimensions must be divisible by the number of sub-spaces");
 
     auto quantized_vectors = arena.alloc<quant_t>(c.tasks_count * c.dimensions, c.error);
     return_if_error_m(c.error);
+    auto quantized_metas = arena.alloc<quant_meta_t>(c.tasks_count, c.error);
+    return_if_error_m(c.error);
+    auto quantized = [&](std::size_t task_idx) noexcept {
+        return quant_view_t {quantized_vectors.begin() + task_idx * c.dimensions, quantized_metas[task_idx]};
+    };
+    for (std::size_t task_idx = 0; task_idx != c.tasks_count; ++task_idx)
+        quantized_metas[task_idx] = quantize(vectors_args[task_idx].begin(),
+                                             c.scalar_type,
+                                             c.dimensions,
+                                             quantized_vectors.begin() + task_idx * c.dimensions);
+
+    // Link the new vectors into the indexes of their collections in memory,
+    // so that the nodes touched by many inserts are only written once.
+    std::vector<std::pair<collection_key_t, std::string>> index_entries;
+    safe_section("Updating the vectors index", c.error, [&] {
+        std::unordered_map<ustore_collection_t, hnsw_t> indexes;
+        for (std::size_t task_idx = 0; task_idx != c.tasks_count && !*c.error; ++task_idx) {
+            auto place = places_args[task_idx];
+            auto it = indexes.find(place.collection);
+            if (it == indexes.end()) {
+                hnsw_t index {c.db, c.transaction, place.collection, c.options, c.error};
+                it = indexes.emplace(place.collection, std::move(index)).first;
+                it->second.open();
+                return_if_error_m(c.error);
+                if (!it->second.exists())
+                    it->second.create(c.dimensions, c.metric, connectivity);
+                return_error_if_m(it->second.header().dimensions == c.dimensions,
+                                  c.error,
+                                  args_wrong_k,
+                                  "Vector dimensions don't match the index");
+                return_error_if_m(it->second.header().metric == c.metric,
+                                  c.error,
+                                  args_wrong_k,
+                                  "Vector metric doesn't match the index");
+            }
+            it->second.insert(place.key, quantized(task_idx), expansion);
+        }
+        return_if_error_m(c.error);
+        for (auto const& collection_and_index : indexes)
+            collection_and_index.second.serialize(index_entries);
+        if (!packed_collections)
+            return;
+
+        // Pack the quantized copies into the blocks of the companion collections
+        std::unordered_map<ustore_collection_t, std::vector<packed_input_t>> packs_inputs;
+        for (std::size_t task_idx = 0; task_idx != c.tasks_count; ++task_idx) {
+            auto place = places_args[task_idx];
+            return_error_if_m(packed_collections[task_idx] != place.collection,
+                              c.error,
+                              args_wrong_k,
+                              "Packed vectors need a separate collection");
+            packs_inputs[packed_collections[task_idx]].push_back(
+                packed_input_t {place.key, quantized(task_idx), vectors_args[task_idx]});
+        }
+        for (auto const& collection_and_inputs : packs_inputs) {
+            packed_vectors_t pack {c.db, c.transaction, collection_and_inputs.first, c.options, c.error};
+            pack.open();
+            return_if_error_m(c.error);
+            if (!pack.exists())
+                pack.create(c.dimensions, c.packed_subspaces);
+            return_error_if_m(pack.header().dimensions == c.dimensions,
+                              c.error,
+                              args_wrong_k,
+                              "Vector dimensions don't match the packed collection");
+            pack.insert(collection_and_inputs.second, c.scalar_type);
+            return_if_error_m(c.error);
+            pack.serialize(index_entries);
+        }
+    });
+    return_if_error_m(c.error);
+
+    // For each input key we must write the original and the modified index nodes
+    auto entries = arena.alloc<entry_t>(c.tasks_count + index_entries.size(), c.error);
+    return_if_error_m(c.error);
 
     // Add the original entries
     for (std::size_t task_idx = 0; task_idx != c.tasks_count; ++task_idx) {
-        entry_t& entry = quantized_entries[task_idx];
+        entry_t& entry = entries[task_idx];
         entry.collection_key.collection = places_args[task_idx].collection;
         entry.collection_key.key = places_args[task_idx].key;
         entry.value = vectors_args[task_idx];
     }
 
-    // Add the mirror tasks for quantized copies
-    for (std::size_t task_idx = 0; task_idx != c.tasks_count; ++task_idx) {
-        auto original_begin = vectors_args[task_idx].begin();
-        auto quantized_begin = quantized_vectors.begin() + task_idx * c.dimensions;
-        entry_t& entry = quantized_entries[c.tasks_count + task_idx];
-        entry.collection_key.collection = places_args[task_idx].collection;
-        entry.collection_key.key = -places_args[task_idx].key;
-        entry.value = value_view_t {(ustore_bytes_cptr_t)quantized_begin, c.dimensions};
-        quantize(original_begin, c.scalar_type, c.dimensions, quantized_begin);
-    }
-
-#if 0 // Future Complex Index Logic
-
-    // Search greedily for closest entries to the provided vectors.
-    ustore_length_t starting_samples_limit = 128;
-    std::size_t max_search_rounds = 10;
-    std::size_t max_neighbors = 4;
-
-    // First, we need to random sample some starting points.
-    ustore_length_t* starting_samples_offsets = NULL;
-    ustore_length_t* starting_samples_counts = NULL;
-    ustore_key_t* starting_samples_keys = NULL;
-    ustore_sample_t sample {};
-    sample.db = c.db;
-    sample.error = c.error;
-    sample.transaction = c.transaction;
-    sample.arena = c.arena;
-    sample.options = c.options;
-    sample.collections = &first.collection_key.collection;
-    sample.collections_stride = sizeof(entry_t);
-    sample.count_limits = &starting_samples_limit;
-    sample.count_limits_stride = 0;
-    sample.offsets = &starting_samples_offsets;
-    sample.counts = &starting_samples_counts;
-    sample.keys = &starting_samples_keys;
-    ustore_sample(&sample);
-    return_if_error_m(c.error);
-
-    // Allocate two priority queues per request.
-    // One will be used for top candidates, the other one for top results.
-    std::size_t bytes_per_queue = pq_t::implicit_memory_usage(max_neighbors);
-    std::size_t bytes_for_queues = c.tasks_count * 2ul * bytes_per_queue;
-    auto buffer_for_queues = arena.alloc<byte_t>(bytes_for_queues, c.error);
-    for (std::size_t task_idx = 0; task_idx != c.tasks_count; ++task_idx) {
-        implicit_init(buffer_for_queues + bytes_per_queue * (task_idx * 2ul), max_neighbors);
-        implicit_init(buffer_for_queues + bytes_per_queue * (task_idx * 2ul + 1ul), max_neighbors);
-    }
-
-    // First organize connections between the vectors in
-    // the current batch mapping into the same space.
-    // ! This is a quadratic complexity step.
-    for (std::size_t a_idx = 0; a_idx != c.tasks_count; ++a_idx) {
-        auto a_place = places_args[a_idx];
-        auto a_quants = quantized_vectors.begin() + a_idx * c.dimensions;
-        for (std::size_t b_idx = 0; b_idx != c.tasks_count; ++b_idx) {
-            auto b_place = places_args[b_idx];
-            auto b_quants = quantized_vectors.begin() + b_idx * c.dimensions;
-            if (a_place.collection != b_place.collection)
-                continue;
-
-            match_t match;
-            match.key = key;
-            match.metric = metric(a_quants, b_quants, c.dimensions, c.metric);
-            pq.push(match);
-        }
+    // Add the index nodes and the packed blocks, including the quantized copies
+    for (std::size_t entry_idx = 0; entry_idx != index_entries.size(); ++entry_idx) {
+        entry_t& entry = entries[c.tasks_count + entry_idx];
+        std::string const& value = index_entries[entry_idx].second;
+        entry.collection_key = index_entries[entry_idx].first;
+        entry.value = value_view_t {reinterpret_cast<byte_t const*>(value.data()), value.size()};
     }
 
-    // Greedily search for multiple rounds.
-
-    // Introduce bidirectional links.
-#endif
-
-    // Submit both original and quantized entries
-    entry_t& first = quantized_entries[0];
+    // Submit both original and index entries
+    entry_t& first = entries[0];
     ustore_write_t write {};
     write.db = c.db;
     write.error = c.error;
     write.transaction = c.transaction;
     write.arena = c.arena;
     write.options = c.options;
-    write.tasks_count = c.tasks_count * 2u;
+    write.tasks_count = entries.size();
     write.collections = &first.collection_key.collection;
     write.collections_stride = sizeof(entry_t);
     write.keys = &first.collection_key.key;
@@ -275,42 +1279,398 @@ void ustore_vectors_write(ustore_vectors_write_t* c_ptr) {
 }
 
 void ustore_vectors_read(ustore_vectors_read_t* c_ptr) {
+    trace_span_m("vectors_read");
 
     ustore_vectors_read_t& c = *c_ptr;
     linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
     return_if_error_m(c.error);
 
-    strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
     strided_iterator_gt<ustore_key_t const> keys {c.keys, c.keys_stride};
-    places_arg_t places_args {collections, keys, {}, c.tasks_count};
+    std::size_t const vector_bytes = c.dimensions * size_bytes(c.scalar_type);
+    return_error_if_m(vector_bytes, c.error, args_wrong_k, "Vectors must have at least one dimension");
 
-    auto vector_size = c.dimensions * size_bytes(c.scalar_type);
+    // Stored values are only needed until they are compacted, so they go into a scratch arena
+    ustore_arena_t scratch = nullptr;
+    ustore_length_t* stored_offsets = nullptr;
+    ustore_length_t* stored_lengths = nullptr;
+    ustore_bytes_ptr_t stored_values = nullptr;
 
-    // Read from disk, but potentially re-layout the data response.
     ustore_read_t read {};
     read.db = c.db;
     read.error = c.error;
     read.transaction = c.transaction;
-    read.arena = arena;
-    read.options = c.options;
+    read.arena = &scratch;
+    auto scratch_options = ustore_option_dont_discard_memory_k | ustore_option_read_shared_memory_k;
+    read.options = ustore_options_t(c.options & ~scratch_options);
     read.tasks_count = c.tasks_count;
     read.collections = c.collections;
     read.collections_stride = c.collections_stride;
     read.keys = keys.get();
     read.keys_stride = keys.stride();
-    read.offsets = c.offsets;
-    read.presences = c.presences;
-    read.values = c.vectors;
+    read.offsets = &stored_offsets;
+    read.lengths = &stored_lengths;
+    read.values = &stored_values;
     ustore_read(&read);
+
+    // Compact into a dense row-major matrix, aligned to cache lines, zeroing the missing rows
+    auto presences = arena.alloc_or_dummy(c.tasks_count, c.error, c.presences);
+    auto offsets = arena.alloc_or_dummy(c.tasks_count + 1, c.error, c.offsets);
+    auto vectors = arena.alloc<byte_t>(c.tasks_count * vector_bytes, c.error, 64);
+    if (!*c.error) {
+        for (std::size_t task_idx = 0; task_idx != c.tasks_count; ++task_idx) {
+            byte_t* row = vectors.begin() + task_idx * vector_bytes;
+            ustore_length_t length = stored_lengths[task_idx];
+            ustore_vector_scalar_t type = c.scalar_type;
+            bool present = length != ustore_length_missing_k && stored_scalar_type(length, c.dimensions, type);
+            if (present)
+                convert(reinterpret_cast<byte_t const*>(stored_values + stored_offsets[task_idx]),
+                        type,
+                        c.dimensions,
+                        c.scalar_type,
+                        row);
+            else
+                std::memset(row, 0, vector_bytes);
+            presences[task_idx] = present;
+            offsets[task_idx] = static_cast<ustore_length_t>(task_idx * vector_bytes);
+        }
+        offsets[c.tasks_count] = static_cast<ustore_length_t>(c.tasks_count * vector_bytes);
+        if (c.vectors)
+            *c.vectors = reinterpret_cast<ustore_byte_t*>(vectors.begin());
+    }
+    ustore_arena_free(scratch);
+}
+
+/**
+ * @brief Queries of a single `ustore_vectors_search()` call, that need
+ * an exhaustive pass over the same collection.
+ */
+struct exhaustive_batch_t {
+    enum source_t {
+        /// @brief Full-precision originals in the positive range of the collection.
+        originals_k,
+        /// @brief Quantized copies in the index nodes, in the negative range of the collection.
+        nodes_k,
+        /// @brief Quantized copies in the blocks of a packed companion collection.
+        packed_k,
+    };
+
+    /// @brief The scanned collection, which is the companion one for `packed_k`.
+    ustore_collection_t collection = ustore_collection_main_k;
+    source_t source = originals_k;
+    /// @brief Layout of the `packed_k` companion collection.
+    packed_vectors_t const* pack = nullptr;
+    std::vector<std::size_t> tasks;
+};
+
+/**
+ * @brief Closest matches for every query of a batch, gathered over blocks of vectors.
+ *
+ * Every block is compared to all the queries tile by tile, so that a tile stays in cache,
+ * while the queries are traversed. Heavy blocks are split between threads, each keeping
+ * its own top-k queue per query, and those are merged in the end.
+ * Ineligible vectors are masked out before that, so they never reach the queues.
+ */
+class batch_matches_t {
+
+    ustore_vector_metric_t metric_;
+    ustore_float_t threshold_;
+    std::vector<std::size_t> const& limits_;
+    std::unique_ptr<thread_pool_t>& pool_;
+    vectors_filter_t& filter_;
+    std::size_t threads_count_;
+
+    std::vector<match_t> memory_;
+    std::vector<pq_t> queues_;
+    std::vector<ustore_key_t> eligible_keys_;
+
+  public:
+    batch_matches_t(ustore_vectors_search_t const& c,
+                    std::vector<std::size_t> const& limits,
+                    std::unique_ptr<thread_pool_t>& pool,
+                    vectors_filter_t& filter)
+        : metric_(c.metric), threshold_(c.metric_threshold), limits_(limits), pool_(pool), filter_(filter),
+          threads_count_(std::max<std::size_t>(std::thread::hardware_concurrency(), 1u)) {
+
+        // One set of queues per chunk of a block, so that threads never share them
+        std::size_t limits_sum = std::accumulate(limits.begin(), limits.end(), std::size_t(0));
+        memory_.resize(threads_count_ * limits_sum);
+        queues_.reserve(threads_count_ * queries_count());
+        for (std::size_t chunk_idx = 0, offset = 0; chunk_idx != threads_count_; ++chunk_idx)
+            for (std::size_t query_idx = 0; query_idx != queries_count(); offset += limits[query_idx++])
+                queues_.emplace_back(memory_.data() + offset, memory_.data() + offset + limits[query_idx]);
+    }
+
+    batch_matches_t(batch_matches_t const&) = delete;
+    batch_matches_t& operator=(batch_matches_t const&) = delete;
+
+    std::size_t queries_count() const noexcept { return limits_.size(); }
+
+    /**
+     * @brief Compares all the queries to the @p count vectors of a block, skipping unknown @p keys.
+     * @param distance Callable, receiving the indexes of the query and of the vector in the block.
+     */
+    template <typename distance_at>
+    void evaluate(ustore_key_t const* keys, std::size_t count, distance_at&& distance) {
+
+        if (filter_.active()) {
+            filter_.prefetch(range_gt<ustore_key_t const*> {keys, keys + count});
+            return_if_error_m(filter_.error());
+            eligible_keys_.resize(count);
+            for (std::size_t vector_idx = 0; vector_idx != count; ++vector_idx) {
+                ustore_key_t key = keys[vector_idx];
+                eligible_keys_[vector_idx] = filter_.allowed(key) ? key : ustore_key_unknown_k;
+            }
+            keys = eligible_keys_.data();
+        }
+
+        auto evaluate_chunk = [&](std::size_t chunk_idx, std::size_t begin, std::size_t end) noexcept {
+            pq_t* chunk_queues = queues_.data() + chunk_idx * queries_count();
+            for (std::size_t tile_begin = begin; tile_begin < end; tile_begin += exhaustive_tile_k) {
+                std::size_t tile_end = std::min(tile_begin + exhaustive_tile_k, end);
+                for (std::size_t query_idx = 0; query_idx != queries_count(); ++query_idx) {
+                    pq_t& pq = chunk_queues[query_idx];
+                    for (std::size_t vector_idx = tile_begin; vector_idx != tile_end; ++vector_idx) {
+                        if (keys[vector_idx] == ustore_key_unknown_k)
+                            continue;
+                        real_t vector_distance = distance(query_idx, vector_idx);
+                        if (distance_to_metric(vector_distance, metric_) < threshold_)
+                            continue;
+                        pq.push(match_t {keys[vector_idx], -vector_distance});
+                    }
+                }
+            }
+        };
+
+        std::size_t tiles = divide_round_up(count, exhaustive_tile_k);
+        bool is_heavy = count * queries_count() >= exhaustive_parallel_threshold_k;
+        std::size_t chunks = is_heavy ? std::min(threads_count_, tiles) : 1u;
+        std::size_t chunk_size = divide_round_up(tiles, chunks) * exhaustive_tile_k;
+        auto evaluate_one = [&](std::size_t chunk_idx) noexcept {
+            std::size_t begin = std::min(count, chunk_idx * chunk_size);
+            evaluate_chunk(chunk_idx, begin, std::min(count, begin + chunk_size));
+        };
+        if (chunks > 1 && !pool_)
+            pool_ = std::make_unique<thread_pool_t>(threads_count_);
+        if (chunks > 1)
+            pool_->for_each(chunks, evaluate_one);
+        else
+            evaluate_one(0);
+    }
+
+    /**
+     * @brief Merges the per-chunk queues.
+     * @param[out] results Closest matches per query, sorted, ranked by the negated distance.
+     */
+    void merge(std::vector<std::vector<match_t>>& results) const {
+        results.resize(queries_count());
+        for (std::size_t query_idx = 0; query_idx != queries_count(); ++query_idx) {
+            auto& merged = results[query_idx];
+            merged.resize(limits_[query_idx]);
+            pq_t pq {merged.data(), merged.data() + merged.size()};
+            for (std::size_t chunk_idx = 0; chunk_idx != threads_count_; ++chunk_idx)
+                for (match_t const& match : queues_[chunk_idx * queries_count() + query_idx])
+                    pq.push(match);
+            merged.resize(pq.size());
+        }
+    }
+};
+
+/**
+ * @brief Passes every entry within `[min_key, max_key]` to the @p callback,
+ * paging through a private arena, so that the memory use doesn't grow with the collection.
+ */
+template <typename callback_at>
+void scan_range(ustore_vectors_search_t const& c,
+                ustore_collection_t collection,
+                ustore_key_t min_key,
+                ustore_key_t max_key,
+                callback_at&& callback) {
+    ustore_arena_t scan_arena = nullptr;
+    bulk_scan_collection(c.db,
+                         c.transaction,
+                         collection,
+                         c.options,
+                         min_key,
+                         max_key,
+                         std::max<std::size_t>(std::thread::hardware_concurrency(), 1u),
+                         exhaustive_read_ahead_k,
+                         &scan_arena,
+                         c.error,
+                         callback);
+    ustore_arena_free(scan_arena);
+}
+
+/**
+ * @brief Passes every block of a packed companion collection to the @p callback.
+ * Only the keys and the parameters are copied, as the alignment of the values isn't
+ * guaranteed, while the codes are referenced in place.
+ */
+template <typename callback_at>
+void scan_packed(ustore_vectors_search_t const& c, exhaustive_batch_t const& batch, callback_at&& callback) {
+    packed_vectors_t const& pack = *batch.pack;
+    std::vector<ustore_key_t> keys(pack.capacity());
+    std::vector<quant_meta_t> metas(pack.capacity());
+    auto stream = [&](ustore_key_t, value_view_t value) noexcept {
+        if (value.size() != pack.block_bytes())
+            return true;
+        std::memcpy(keys.data(), value.data(), keys.size() * sizeof(ustore_key_t));
+        std::memcpy(metas.data(), value.data() + pack.metas_offset(), metas.size() * sizeof(quant_meta_t));
+        callback(keys.data(), metas.data(), value.data() + pack.codes_offset(), pack.capacity());
+        return true;
+    };
+    scan_range(c, batch.collection, 0, std::numeric_limits<ustore_key_t>::max() - 1, stream);
+}
+
+/**
+ * @brief Compares the queries to the full-precision originals, gathered into contiguous blocks.
+ * @param scale Multiplier, that turns the @p kernel output into a distance.
+ */
+template <typename scalar_at>
+void scan_originals(ustore_vectors_search_t const& c,
+                    exhaustive_batch_t const& batch,
+                    vectors_arg_t const& queries_args,
+                    vector_metric_gt<scalar_at> kernel,
+                    real_t scale,
+                    batch_matches_t& matches) {
+
+    std::size_t const dims = c.dimensions;
+    std::size_t const vector_bytes = dims * sizeof(scalar_at);
+    std::vector<scalar_at> queries(batch.tasks.size() * dims);
+    for (std::size_t query_idx = 0; query_idx != batch.tasks.size(); ++query_idx)
+        std::memcpy(queries.data() + query_idx * dims, queries_args[batch.tasks[query_idx]].begin(), vector_bytes);
+
+    std::vector<ustore_key_t> block_keys;
+    std::vector<scalar_at> block_vectors(exhaustive_block_k * dims);
+    block_keys.reserve(exhaustive_block_k);
+    auto evaluate_block = [&] {
+        matches.evaluate(block_keys.data(), block_keys.size(), [&](std::size_t query_idx, std::size_t vector_idx) {
+            return kernel(queries.data() + query_idx * dims, block_vectors.data() + vector_idx * dims, dims) * scale;
+        });
+        block_keys.clear();
+    };
+
+    auto gather = [&](ustore_key_t key, value_view_t value) noexcept {
+        if (value.size() != vector_bytes)
+            return true;
+        std::memcpy(block_vectors.data() + block_keys.size() * dims, value.data(), vector_bytes);
+        block_keys.push_back(key);
+        if (block_keys.size() == exhaustive_block_k)
+            evaluate_block();
+        return true;
+    };
+    scan_range(c, batch.collection, 0, std::numeric_limits<ustore_key_t>::max() - 1, gather);
+    return_if_error_m(c.error);
+    if (!block_keys.empty())
+        evaluate_block();
+}
+
+/**
+ * @brief Compares the quantized queries to the scaled `i8` codes of the index nodes,
+ * gathered into contiguous blocks, or to the packed blocks in place.
+ */
+void scan_quants(ustore_vectors_search_t const& c,
+                 exhaustive_batch_t const& batch,
+                 vectors_arg_t const& queries_args,
+                 quant_distance_t const& distance,
+                 batch_matches_t& matches) {
+
+    std::size_t const dims = c.dimensions;
+    std::vector<quant_t> queries(batch.tasks.size() * dims);
+    std::vector<quant_meta_t> queries_metas(batch.tasks.size());
+    for (std::size_t query_idx = 0; query_idx != batch.tasks.size(); ++query_idx)
+        queries_metas[query_idx] = quantize(queries_args[batch.tasks[query_idx]].begin(),
+                                            c.scalar_type,
+                                            dims,
+                                            queries.data() + query_idx * dims);
+
+    auto evaluate_block = [&](ustore_key_t const* keys, quant_meta_t const* metas, void const* codes, std::size_t n) {
+        quant_t const* vectors = reinterpret_cast<quant_t const*>(codes);
+        matches.evaluate(keys, n, [&](std::size_t query_idx, std::size_t vector_idx) {
+            quant_view_t query {queries.data() + query_idx * dims, queries_metas[query_idx]};
+            return distance(query, quant_view_t {vectors + vector_idx * dims, metas[vector_idx]}, dims);
+        });
+    };
+
+    if (batch.source == exhaustive_batch_t::packed_k)
+        return scan_packed(c, batch, evaluate_block);
+
+    std::vector<ustore_key_t> block_keys;
+    std::vector<quant_meta_t> block_metas;
+    std::vector<quant_t> block_vectors(exhaustive_block_k * dims);
+    block_keys.reserve(exhaustive_block_k);
+    block_metas.reserve(exhaustive_block_k);
+    auto evaluate_gathered = [&] {
+        evaluate_block(block_keys.data(), block_metas.data(), block_vectors.data(), block_keys.size());
+        block_keys.clear();
+        block_metas.clear();
+    };
+
+    auto gather = [&](ustore_key_t key, value_view_t value) noexcept {
+        if (value.size() < sizeof(quant_meta_t) + dims)
+            return true;
+        quant_meta_t meta;
+        std::memcpy(&meta, value.data(), sizeof(quant_meta_t));
+        std::memcpy(block_vectors.data() + block_keys.size() * dims, value.data() + sizeof(quant_meta_t), dims);
+        block_keys.push_back(original_key(key));
+        block_metas.push_back(meta);
+        if (block_keys.size() == exhaustive_block_k)
+            evaluate_gathered();
+        return true;
+    };
+    scan_range(c, batch.collection, index_header_key_k + 1, -1, gather);
     return_if_error_m(c.error);
+    if (!block_keys.empty())
+        evaluate_gathered();
+}
+
+/**
+ * @brief Compares the full-precision queries to the product-quantized packed blocks,
+ * summing the entries of per-query distance tables.
+ */
+void scan_products(ustore_vectors_search_t const& c,
+                   exhaustive_batch_t const& batch,
+                   vectors_arg_t const& queries_args,
+                   batch_matches_t& matches) {
 
-    // From here on, if we have the offsets don't form identical-length chunks,
-    // we must compact the range:
+    product_quantizer_t const& quantizer = batch.pack->quantizer();
+    std::size_t const dims = c.dimensions;
+    std::size_t const subspaces = quantizer.subspaces();
+    std::size_t const table_size = subspaces * product_quantizer_t::centroids_k;
+    bool const is_l2 = c.metric == ustore_vector_metric_l2_k;
+
+    std::vector<real_t> query(dims);
+    std::vector<real_t> tables(batch.tasks.size() * table_size);
+    std::vector<real_t> queries_squared_norms(batch.tasks.size());
+    for (std::size_t query_idx = 0; query_idx != batch.tasks.size(); ++query_idx) {
+        upcast(queries_args[batch.tasks[query_idx]].begin(), c.scalar_type, dims, query.data());
+        quantizer.tabulate(query.data(), is_l2, tables.data() + query_idx * table_size);
+        queries_squared_norms[query_idx] = std::inner_product(query.begin(), query.end(), query.begin(), 0.f);
+    }
+
+    auto evaluate_block = [&](ustore_key_t const* keys, quant_meta_t const* metas, void const* codes, std::size_t n) {
+        std::uint8_t const* vectors = reinterpret_cast<std::uint8_t const*>(codes);
+        matches.evaluate(keys, n, [&](std::size_t query_idx, std::size_t vector_idx) {
+            real_t const* table = tables.data() + query_idx * table_size;
+            real_t sum = product_quantizer_t::lookup(table, vectors + vector_idx * subspaces, subspaces);
+            switch (c.metric) {
+            case ustore_vector_metric_l2_k: return std::sqrt(std::max(sum, real_t(0)));
+            case ustore_vector_metric_dot_k: return -sum;
+            default: return -cos_from_products(sum, queries_squared_norms[query_idx], metas[vector_idx].squared_norm);
+            }
+        });
+    };
+    scan_packed(c, batch, evaluate_block);
 }
 
+#if !defined(USTORE_FLIGHT_CLIENT)
 void ustore_vectors_search(ustore_vectors_search_t* c_ptr) {
+    trace_span_m("vectors_search");
 
     ustore_vectors_search_t const& c = *c_ptr;
+    return_error_if_m(!c.filter_fields_count || (c.filter_fields && c.filter_values),
+                      c.error,
+                      args_wrong_k,
+                      "Filter needs both the fields and the expected values");
     linked_memory_lock_t arena = linked_memory(c.arena, c.options, c.error);
     return_if_error_m(c.error);
 
@@ -319,12 +1679,12 @@ void ustore_vectors_search(ustore_vectors_search_t* c_ptr) {
     vectors_arg_t queries_args {starts, offs, c.queries_stride, c.scalar_type, c.dimensions, c.tasks_count};
 
     strided_iterator_gt<ustore_collection_t const> collections {c.collections, c.collections_stride};
+    strided_iterator_gt<ustore_collection_t const> packed_collections {c.packed_collections,
+                                                                      c.packed_collections_stride};
     strided_range_gt<ustore_length_t const> count_limits {{c.match_counts_limits, c.match_counts_limits_stride},
                                                        c.tasks_count};
 
-    auto count_limits_max = ustore_length_t {0};
-    auto count_limits_sum = transform_reduce_n(count_limits.begin(), c.tasks_count, 0ul, [&](ustore_length_t l) {
-        count_limits_max = std::max(count_limits_max, l);
+    auto count_limits_sum = transform_reduce_n(count_limits.begin(), c.tasks_count, 0ul, [](ustore_length_t l) {
         return l;
     });
 
@@ -337,45 +1697,146 @@ void ustore_vectors_search(ustore_vectors_search_t* c_ptr) {
     auto found_metrics = arena.alloc_or_dummy(count_limits_sum, c.error, c.match_metrics);
     return_if_error_m(c.error);
 
-    auto temp_matches = arena.alloc<match_t>(count_limits_max, c.error);
-    return_if_error_m(c.error);
     auto quant_query = arena.alloc<quant_t>(c.dimensions, c.error);
     return_if_error_m(c.error);
 
-    ustore_length_t total_exported_matches = 0;
-    for (std::size_t i = 0; i != c.tasks_count && !*c.error; ++i) {
-        auto col = collections ? collections[i] : ustore_collection_main_k;
-        auto query = queries_args[i];
-        auto limit = count_limits[i];
-        quantize(query.begin(), c.scalar_type, c.dimensions, quant_query.begin());
+    // Resolve the kernels once for the whole batch
+    quant_distance_t quant_distance {c.metric};
+    real_t original_scale = distance_to_metric(1, c.metric);
+    auto i8_kernel = i8_metric(c.metric);
+    auto f16_kernel = float_metric<f16_bits_t>(c.metric);
+    auto f32_kernel = float_metric<float>(c.metric);
+    auto f64_kernel = serial_metric<double>(c.metric);
 
-        pq_t pq {temp_matches.begin(), temp_matches.begin() + limit};
+    // Every task gets a region of the outputs, sized by its limit, compacted in the end
+    std::vector<ustore_length_t> reserved_offsets;
+    std::vector<ustore_length_t> exported_counts;
+    auto export_matches = [&](std::size_t task_idx, std::vector<match_t> const& matches) noexcept {
+        ustore_length_t offset = reserved_offsets[task_idx];
+        for (std::size_t j = 0; j != matches.size(); ++j) {
+            found_keys[offset + j] = matches[j].key;
+            found_metrics[offset + j] = distance_to_metric(-matches[j].metric, c.metric);
+        }
+        exported_counts[task_idx] = static_cast<ustore_length_t>(matches.size());
+    };
 
-        auto callback = [&](ustore_key_t key, value_view_t vector) noexcept {
-            if (key >= 0)
-                return false;
-            match_t match;
-            match.key = key;
-            match.metric = metric(quant_query.begin(), (quant_t const*)vector.data(), c.dimensions, c.metric);
-            if (match.metric < c.metric_threshold)
-                return true;
+    safe_section("Searching vectors", c.error, [&] {
+        reserved_offsets.resize(c.tasks_count);
+        exported_counts.resize(c.tasks_count, 0);
+        for (std::size_t i = 0, offset = 0; i != c.tasks_count; offset += count_limits[i++])
+            reserved_offsets[i] = static_cast<ustore_length_t>(offset);
 
-            pq.push(match);
-            return true;
-        };
+        // Indexes are reused between queries into the same collection, to cache the visited nodes.
+        // Queries, that can't use an index, are grouped to scan every collection only once.
+        std::unordered_map<ustore_collection_t, hnsw_t> indexes;
+        std::unordered_map<ustore_collection_t, packed_vectors_t> packs;
+        std::vector<exhaustive_batch_t> batches;
+        vectors_filter_t filter {c};
+        std::vector<candidate_t> candidates;
+        std::vector<match_t> matches;
 
-        auto min_key = std::numeric_limits<ustore_key_t>::min();
-        full_scan_collection(c.db, c.transaction, col, c.options, min_key, limit, arena, c.error, callback);
-        auto count = pq.size();
+        for (std::size_t i = 0; i != c.tasks_count && !*c.error; ++i) {
+            auto col = collections ? collections[i] : ustore_collection_main_k;
+            auto query = queries_args[i];
+            auto limit = count_limits[i];
 
-        found_counts[i] = count;
-        found_offsets[i] = total_exported_matches;
+            auto it = indexes.find(col);
+            if (it == indexes.end()) {
+                it = indexes.emplace(col, hnsw_t {c.db, c.transaction, col, c.options, c.error}).first;
+                it->second.open();
+                return_if_error_m(c.error);
+            }
+
+            hnsw_t& index = it->second;
+            bool can_use_index = index.exists() && index.header().metric == c.metric &&
+                                 index.header().dimensions == c.dimensions;
+            if (!can_use_index) {
+                // Prefer the dense packed blocks, if those are available, over the scattered entries
+                exhaustive_batch_t key {col};
+                key.source = index.exists() ? exhaustive_batch_t::nodes_k : exhaustive_batch_t::originals_k;
+                if (packed_collections) {
+                    auto packed_col = packed_collections[i];
+                    auto pack = packs.find(packed_col);
+                    if (pack == packs.end()) {
+                        packed_vectors_t new_pack {c.db, c.transaction, packed_col, c.options, c.error};
+                        pack = packs.emplace(packed_col, std::move(new_pack)).first;
+                        pack->second.open();
+                        return_if_error_m(c.error);
+                    }
+                    if (pack->second.exists() && pack->second.header().dimensions == c.dimensions)
+                        key = {packed_col, exhaustive_batch_t::packed_k, &pack->second};
+                }
+                auto batch = std::find_if(batches.begin(), batches.end(), [&](exhaustive_batch_t const& batch) {
+                    return batch.collection == key.collection && batch.source == key.source;
+                });
+                if (batch == batches.end())
+                    batch = batches.insert(batches.end(), std::move(key));
+                batch->tasks.push_back(i);
+                continue;
+            }
 
-        for (std::size_t j = 0; j != count; ++j)
-            found_keys[total_exported_matches + j] = std::abs(temp_matches[j].key), //
-                found_metrics[total_exported_matches + j] = temp_matches[j].metric;
+            quant_meta_t query_meta = quantize(query.begin(), c.scalar_type, c.dimensions, quant_query.begin());
+            std::size_t ef = c.search_expansion ? c.search_expansion : search_expansion_default_k;
+            quant_view_t quant_view {quant_query.begin(), query_meta};
+            index.search(quant_view, std::max<std::size_t>(ef, limit), candidates, filter.active() ? &filter : nullptr);
+            return_if_error_m(c.error);
 
-        total_exported_matches += count;
-        pq.clear();
+            matches.clear();
+            for (std::size_t j = 0; j != candidates.size() && matches.size() != limit; ++j)
+                if (distance_to_metric(candidates[j].distance, c.metric) >= c.metric_threshold)
+                    matches.push_back(match_t {candidates[j].key, -candidates[j].distance});
+            export_matches(i, matches);
+        }
+        return_if_error_m(c.error);
+
+        std::unique_ptr<thread_pool_t> pool;
+        std::vector<std::vector<match_t>> results;
+        std::vector<std::size_t> limits;
+        for (exhaustive_batch_t const& batch : batches) {
+            limits.clear();
+            for (std::size_t task_idx : batch.tasks)
+                limits.push_back(count_limits[task_idx]);
+
+            batch_matches_t batch_matches {c, limits, pool, filter};
+            if (batch.source == exhaustive_batch_t::packed_k && batch.pack->is_product())
+                scan_products(c, batch, queries_args, batch_matches);
+            else if (batch.source != exhaustive_batch_t::originals_k)
+                scan_quants(c, batch, queries_args, quant_distance, batch_matches);
+            else
+                switch (c.scalar_type) {
+                case ustore_vector_scalar_f32_k:
+                    scan_originals(c, batch, queries_args, f32_kernel, original_scale, batch_matches);
+                    break;
+                case ustore_vector_scalar_f16_k:
+                    scan_originals(c, batch, queries_args, f16_kernel, original_scale, batch_matches);
+                    break;
+                case ustore_vector_scalar_f64_k:
+                    scan_originals(c, batch, queries_args, f64_kernel, original_scale, batch_matches);
+                    break;
+                case ustore_vector_scalar_i8_k:
+                    scan_originals(c, batch, queries_args, i8_kernel, original_scale, batch_matches);
+                    break;
+                }
+            return_if_error_m(c.error);
+            batch_matches.merge(results);
+
+            for (std::size_t j = 0; j != batch.tasks.size(); ++j)
+                export_matches(batch.tasks[j], results[j]);
+        }
+    });
+    return_if_error_m(c.error);
+
+    // Compact the outputs, moving every region to the end of the previous one
+    ustore_length_t exported_offset = 0;
+    for (std::size_t i = 0; i != c.tasks_count; ++i) {
+        ustore_length_t count = exported_counts[i];
+        for (std::size_t j = 0; j != count; ++j) {
+            found_keys[exported_offset + j] = found_keys[reserved_offsets[i] + j];
+            found_metrics[exported_offset + j] = found_metrics[reserved_offsets[i] + j];
+        }
+        found_offsets[i] = exported_offset;
+        found_counts[i] = count;
+        exported_offset += count;
     }
-}
\ No newline at end of file
+}
+#endif // Forwarded to the server in `flight_client.cpp`
@@ -6,14 +6,22 @@
  * @brief A web server implementing @b REST backend on top of any other
  * UStore implementation using pre-release draft of C++23 Networking TS,
  * through the means of @b Boost.Beast, @b Boost.ASIO and @b NLohmann.JSON.
+ *
+ * Every connection keeps its memory arena, transaction handle and resolved
+ * collection names across keep-alive requests, and every thread runs its own
+ * `io_context`, accepting connections on a separate `SO_REUSEPORT` socket.
  */
 
 #include <cstdlib>
+#include <cstring>
+#include <limits>
 #include <memory>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <algorithm>
 #include <functional>
+#include <unordered_map>
 #include <thread>   // Thread pool
 #include <charconv> // Parsing integers
 #include <iostream> // Logging to `std::cerr`
@@ -46,12 +54,16 @@
 #elif defined(_MSC_VER)
 #endif
 
+#include <simdjson.h>          // Parsing NDJSON batches
+#include <mpack_header_only.h> // Parsing and exporting MsgPack batches
+
 #include "ustore/ustore.hpp"
 
 namespace beast = boost::beast;   // from <boost/beast.hpp>
 namespace http = beast::http;     // from <boost/beast/http.hpp>
 namespace net = boost::asio;      // from <boost/asio.hpp>
 using tcp = boost::asio::ip::tcp; // from <boost/asio/ip/tcp.hpp>
+namespace sj = simdjson;
 
 using namespace unum::ustore;
 using namespace unum;
@@ -59,35 +71,130 @@ using namespace unum;
 static constexpr char const* server_name_k = "unum-cloud/ustore/beast_server";
 static constexpr char const* mime_binary_k = "application/octet-stream";
 static constexpr char const* mime_json_k = "application/json";
+static constexpr char const* mime_ndjson_k = "application/x-ndjson";
 static constexpr char const* mime_msgpack_k = "application/msgpack";
 static constexpr char const* mime_cbor_k = "application/cbor";
 static constexpr char const* mime_bson_k = "application/bson";
 static constexpr char const* mime_ubjson_k = "application/ubjson";
+static constexpr char const* mime_arrow_k = "application/vnd.apache.arrow.stream";
 
 ustore_doc_field_type_t mime_to_format(beast::string_view mime) {
-    if (mime == mime_json_k)
-        return ustore_field_json_k;
-    else if (mime == "application/json-patch+json")
-        return ustore_format_json_patch_k;
+    if (mime == mime_json_k || mime == mime_ndjson_k)
+        return ustore_doc_field_json_k;
     else if (mime == mime_msgpack_k)
-        return ustore_format_msgpack_k;
+        return ustore_doc_field_msgpack_k;
     else if (mime == mime_bson_k)
-        return ustore_format_bson_k;
-    else if (mime == mime_cbor_k)
-        return ustore_format_cbor_k;
-    else if (mime == mime_ubjson_k)
-        return ustore_format_ubjson_k;
-    else if (mime == "application/vnd.apache.arrow.stream" || mime == "application/vnd.apache.arrow.file")
-        return ustore_format_arrow_k;
-    else if (mime == "application/vnd.apache.parquet")
-        return ustore_format_parquet_k;
+        return ustore_doc_field_bson_k;
     else
         return ustore_doc_field_default_k;
 }
 
 struct db_w_clients_t : public std::enable_shared_from_this<db_w_clients_t> {
     database_t session;
-    int running_transactions;
+    bool supports_transactions = false;
+};
+
+/**
+ * @brief Resources of a single client connection, reused across all of
+ * its keep-alive requests, instead of being rebuilt per request.
+ *
+ * The arena is only reset by the next call, so responses can reference
+ * its memory until they are written. The transaction is created lazily
+ * and reset, rather than reallocated, by @c begin().
+ */
+class connection_state_t {
+    std::shared_ptr<db_w_clients_t> db_;
+    arena_t arena_;
+    ustore_transaction_t txn_ = nullptr;
+    std::unordered_map<std::string, ustore_collection_t> collections_;
+
+  public:
+    /// @name Batch buffers, keeping their capacity between requests.
+    /// @{
+    std::vector<ustore_collection_t> read_collections;
+    std::vector<ustore_key_t> read_keys;
+    std::vector<ustore_collection_t> write_collections;
+    std::vector<ustore_key_t> write_keys;
+    std::vector<ustore_bytes_cptr_t> write_values;
+    std::vector<ustore_length_t> write_offsets;
+    std::vector<ustore_length_t> write_lengths;
+    std::string write_tape;
+    sj::ondemand::parser json_parser;
+    /// @}
+
+    connection_state_t(std::shared_ptr<db_w_clients_t> const& db) noexcept : db_(db), arena_(db->session) {}
+    connection_state_t(connection_state_t const&) = delete;
+    ~connection_state_t() noexcept {
+        if (txn_)
+            ustore_transaction_free(txn_);
+    }
+
+    ustore_database_t db() const noexcept { return db_->session; }
+    ustore_transaction_t txn() const noexcept { return txn_; }
+    ustore_arena_t* arena() noexcept { return arena_.member_ptr(); }
+
+    /**
+     * @brief Starts a new transaction for the upcoming request, reusing the
+     * handle of the previous one. A no-op for engines without transactions.
+     */
+    status_t begin() noexcept {
+        status_t status;
+        if (!db_->supports_transactions)
+            return status;
+
+        ustore_transaction_init_t txn_init {};
+        txn_init.db = db();
+        txn_init.error = status.member_ptr();
+        txn_init.transaction = &txn_;
+        ustore_transaction_init(&txn_init);
+        return status;
+    }
+
+    status_t commit() noexcept {
+        status_t status;
+        if (!txn_)
+            return status;
+
+        ustore_transaction_commit_t txn_commit {};
+        txn_commit.db = db();
+        txn_commit.error = status.member_ptr();
+        txn_commit.transaction = txn_;
+        ustore_transaction_commit(&txn_commit);
+        return status;
+    }
+
+    /**
+     * @brief Resolves a collection name, creating it if missing.
+     * Empty names map to the main collection. Results are cached.
+     */
+    expected_gt<ustore_collection_t> collection(std::string_view name) noexcept {
+        if (name.empty())
+            return ustore_collection_t {ustore_collection_main_k};
+
+        auto name_str = std::string(name);
+        auto it = collections_.find(name_str);
+        if (it != collections_.end())
+            return ustore_collection_t {it->second};
+
+        auto maybe_collection = db_->session.find_or_create(name_str.c_str());
+        if (!maybe_collection)
+            return maybe_collection.release_status();
+
+        auto collection = static_cast<ustore_collection_t>(*maybe_collection);
+        collections_.emplace(std::move(name_str), collection);
+        return collection;
+    }
+
+    void clear_batch() noexcept {
+        read_collections.clear();
+        read_keys.clear();
+        write_collections.clear();
+        write_keys.clear();
+        write_values.clear();
+        write_offsets.clear();
+        write_lengths.clear();
+        write_tape.clear();
+    }
 };
 
 void log_failure(beast::error_code ec, char const* what) {
@@ -130,15 +237,14 @@ std::optional<beast::string_view> param_value(beast::string_view query_params, b
 }
 
 template <typename body_at, typename allocator_at, typename send_response_at>
-void respond_to_one(db_session_t& session,
+void respond_to_one(connection_state_t& connection,
                     http::request<body_at, http::basic_fields<allocator_at>>&& req,
                     send_response_at&& send_response) {
 
     http::verb received_verb = req.method();
     beast::string_view received_path = req.target();
 
-    transaction_t txn(session.db());
-    blobs_collection_t collection;
+    ustore_collection_t collection = ustore_collection_main_k;
     ustore_key_t key = 0;
     ustore_options_t options = ustore_options_default_k;
 
@@ -160,22 +266,17 @@ void respond_to_one(db_session_t& session,
 
     // Parse the collection name string.
     if (auto collection_val = param_value(params_str, "col="); collection_val) {
-        char collection_name_buffer[65] = {0};
-        std::memcpy(collection_name_buffer, collection_val->data(), std::min(collection_val->size(), 64ul));
-
-        status_t status;
-        ustore_collection_create_t collection_init {
-            .db = session.db(),
-            .error = error.member_ptr(),
-            .name = collection_name_buffer,
-            .id = &collection.raw,
-        };
-
-        ustore_collection_create(&collection_init);
-        if (!status)
-            return send_response(make_error(req, http::status::internal_server_error, error.raw));
+        auto maybe_collection = connection.collection({collection_val->data(), collection_val->size()});
+        if (!maybe_collection)
+            return send_response(
+                make_error(req, http::status::internal_server_error, maybe_collection.release_status().message()));
+        collection = *maybe_collection;
     }
 
+    status_t status = connection.begin();
+    if (!status)
+        return send_response(make_error(req, http::status::internal_server_error, status.message()));
+
     // Once we know, which collection, key and transaction user is
     // interested in - perform the actions depending on verbs.
     switch (received_verb) {
@@ -183,31 +284,31 @@ void respond_to_one(db_session_t& session,
         // Read the data:
     case http::verb::get: {
 
-        arena_t tape(session.db());
-        status_t status;
-        ustore_read_t read {
-            .db = session.db(),
-            .error = error.member_ptr(),
-            .transaction = txn.raw,
-            .options = options,
-            .collections = &collection.raw,
-            .keys = &key,
-            .keys_stride = 1,
-            .lengths = &tape.capacity,
-            .values = &tape.ptr,
-        };
+        ustore_length_t* found_lengths = nullptr;
+        ustore_byte_t* found_values = nullptr;
+        ustore_read_t read {};
+        read.db = connection.db();
+        read.error = status.member_ptr();
+        read.transaction = connection.txn();
+        read.arena = connection.arena();
+        read.options = options;
+        read.tasks_count = 1;
+        read.collections = &collection;
+        read.keys = &key;
+        read.lengths = &found_lengths;
+        read.values = &found_values;
 
         ustore_read(&read);
         if (!status)
-            return send_response(make_error(req, http::status::internal_server_error, error.raw));
+            return send_response(make_error(req, http::status::internal_server_error, status.message()));
 
-        ustore_bytes_ptr_t begin = tape.ptr + sizeof(ustore_length_t);
-        ustore_length_t len = reinterpret_cast<ustore_length_t*>(tape.ptr)[0];
-        if (!len)
+        ustore_length_t len = found_lengths[0];
+        if (len == ustore_length_missing_k)
             return send_response(make_error(req, http::status::not_found, "Missing key"));
 
+        // The arena outlives the response, as it is only reset by the next request.
         http::buffer_body::value_type body;
-        body.data = begin;
+        body.data = found_values;
         body.size = len;
         body.more = false;
 
@@ -226,30 +327,27 @@ void respond_to_one(db_session_t& session,
         // Check the data:
     case http::verb::head: {
 
-        arena_t tape(session.db());
-        status_t status;
-        options = ustore_option_read_lengths_k;
-        ustore_read_t read {
-            .db = session.db(),
-            .transaction = txn.raw,
-            .collections = &collection.raw,
-            .keys = &key,
-            .keys_stride = 1,
-            .options = options,
-            .lengths = &tape.capacity,
-            .values = &tape.ptr,
-            .error = error.member_ptr(),
-        };
+        ustore_length_t* found_lengths = nullptr;
+        ustore_read_t read {};
+        read.db = connection.db();
+        read.error = status.member_ptr();
+        read.transaction = connection.txn();
+        read.arena = connection.arena();
+        read.options = options;
+        read.tasks_count = 1;
+        read.collections = &collection;
+        read.keys = &key;
+        read.lengths = &found_lengths;
 
         ustore_read(&read);
         if (!status)
-            return send_response(make_error(req, http::status::internal_server_error, error.raw));
+            return send_response(make_error(req, http::status::internal_server_error, status.message()));
 
-        ustore_length_t len = reinterpret_cast<ustore_length_t*>(tape.ptr)[0];
-        if (!len)
+        ustore_length_t len = found_lengths[0];
+        if (len == ustore_length_missing_k)
             return send_response(make_error(req, http::status::not_found, "Missing key"));
 
-        http::response<http::empty_body> res;
+        http::response<http::empty_body> res {http::status::ok, req.version()};
         res.set(http::field::server, server_name_k);
         res.set(http::field::content_type, mime_binary_k);
         res.content_length(len);
@@ -259,27 +357,24 @@ void respond_to_one(db_session_t& session,
 
     // Insert data if it's missing:
     case http::verb::post: {
-        arena_t tape(session.db());
-        status_t status;
-        options = ustore_option_read_lengths_k;
-        ustore_read_t read {
-            .db = session.db(),
-            .transaction = txn.raw,
-            .collections = &collection.raw,
-            .keys = &key,
-            .keys_stride = 1,
-            .options = options,
-            .lengths = &tape.capacity,
-            .values = &tape.ptr,
-            .error = error.member_ptr(),
-        };
+
+        ustore_length_t* found_lengths = nullptr;
+        ustore_read_t read {};
+        read.db = connection.db();
+        read.error = status.member_ptr();
+        read.transaction = connection.txn();
+        read.arena = connection.arena();
+        read.options = options;
+        read.tasks_count = 1;
+        read.collections = &collection;
+        read.keys = &key;
+        read.lengths = &found_lengths;
 
         ustore_read(&read);
         if (!status)
-            return send_response(make_error(req, http::status::internal_server_error, error.raw));
+            return send_response(make_error(req, http::status::internal_server_error, status.message()));
 
-        ustore_length_t len = reinterpret_cast<ustore_length_t*>(tape.ptr)[0];
-        if (len)
+        if (found_lengths[0] != ustore_length_missing_k)
             return send_response(make_error(req, http::status::conflict, "Duplicate key"));
 
         [[fallthrough]];
@@ -299,60 +394,59 @@ void respond_to_one(db_session_t& session,
             return send_response(
                 make_error(req, http::status::unsupported_media_type, "Only binary payload is allowed"));
 
-        status_t status;
-        auto value = req.body();
-        auto value_ptr = reinterpret_cast<ustore_bytes_ptr_t>(value.data());
+        auto& value = req.body();
+        auto value_ptr = reinterpret_cast<ustore_bytes_cptr_t>(value.data());
         auto value_len = static_cast<ustore_length_t>(*opt_payload_len);
-        ustore_length_t value_off = 0;
-
-        ustore_write_t write {
-            .db = session.db(),
-            .error = error.member_ptr(),
-            .transaction = txn.raw,
-            .options = options.collections = &collection.raw,
-            .keys = &key,
-            .keys_stride = 1,
-            .offsets = &value_off,
-            .lengths = &value_len,
-            .values = &value_ptr,
-        };
+
+        ustore_write_t write {};
+        write.db = connection.db();
+        write.error = status.member_ptr();
+        write.transaction = connection.txn();
+        write.arena = connection.arena();
+        write.options = options;
+        write.tasks_count = 1;
+        write.collections = &collection;
+        write.keys = &key;
+        write.lengths = &value_len;
+        write.values = &value_ptr;
 
         ustore_write(&write);
         if (!status)
-            return send_response(make_error(req, http::status::internal_server_error, error.raw));
+            return send_response(make_error(req, http::status::internal_server_error, status.message()));
 
-        http::response<http::empty_body> res;
+        status = connection.commit();
+        if (!status)
+            return send_response(make_error(req, http::status::conflict, status.message()));
+
+        http::response<http::empty_body> res {http::status::ok, req.version()};
         res.set(http::field::server, server_name_k);
         res.set(http::field::content_type, mime_binary_k);
         res.keep_alive(req.keep_alive());
         return send_response(std::move(res));
     }
 
-        // Upsert data:
+        // Remove data:
     case http::verb::delete_: {
 
-        status_t status;
-        ustore_bytes_ptr_t value_ptr = nullptr;
-        ustore_length_t value_len = 0;
-        ustore_length_t value_off = 0;
-
-        ustore_write_t write {
-            .db = session.db(),
-            .error = error.member_ptr(),
-            .transaction = txn.raw,
-            .options = options.collections = &collection.raw,
-            .keys = &key,
-            .keys_stride = 1,
-            .offsets = &value_off,
-            .lengths = &value_len,
-            .values = &value_ptr,
-        };
+        ustore_write_t write {};
+        write.db = connection.db();
+        write.error = status.member_ptr();
+        write.transaction = connection.txn();
+        write.arena = connection.arena();
+        write.options = options;
+        write.tasks_count = 1;
+        write.collections = &collection;
+        write.keys = &key;
 
         ustore_write(&write);
         if (!status)
-            return send_response(make_error(req, http::status::internal_server_error, error.raw));
+            return send_response(make_error(req, http::status::internal_server_error, status.message()));
+
+        status = connection.commit();
+        if (!status)
+            return send_response(make_error(req, http::status::conflict, status.message()));
 
-        http::response<http::empty_body> res;
+        http::response<http::empty_body> res {http::status::ok, req.version()};
         res.set(http::field::server, server_name_k);
         res.set(http::field::content_type, mime_binary_k);
         res.keep_alive(req.keep_alive());
@@ -367,15 +461,14 @@ void respond_to_one(db_session_t& session,
 }
 
 template <typename body_at, typename allocator_at, typename send_response_at>
-void respond_to_aos(db_session_t& session,
+void respond_to_aos(connection_state_t& connection,
                     http::request<body_at, http::basic_fields<allocator_at>>&& req,
                     send_response_at&& send_response) {
 
     http::verb received_verb = req.method();
     beast::string_view received_path = req.target();
 
-    transaction_t txn(session.db());
-    std::vector<blobs_collection_t> collections(session.db());
+    std::vector<ustore_collection_t> collections;
     ustore_options_t options = ustore_options_default_k;
     std::vector<ustore_key_t> keys;
 
@@ -391,23 +484,12 @@ void respond_to_aos(db_session_t& session,
 
     // Parse the collection name string.
     if (auto collection_val = param_value(params_str, "col="); collection_val) {
-        char collection_name_buffer[65] = {0};
-        std::memcpy(collection_name_buffer, collection_val->data(), std::min(collection_val->size(), 64ul));
-
-        status_t status;
-        blobs_collection_t collection(session.db());
-        ustore_collection_create_t collection_init {
-            .db = session.db(),
-            .error = error.member_ptr(),
-            .name = collection_name_buffer,
-            .id = &collection.raw,
-        };
-
-        ustore_collection_create(&collection_init);
-        if (!status)
-            return send_response(make_error(req, http::status::internal_server_error, error.raw));
+        auto maybe_collection = connection.collection({collection_val->data(), collection_val->size()});
+        if (!maybe_collection)
+            return send_response(
+                make_error(req, http::status::internal_server_error, maybe_collection.release_status().message()));
 
-        collections.raw_array.emplace_back(std::exchange(collection.raw, nullptr));
+        collections.push_back(*maybe_collection);
         // ustore_option_read_colocated(&options, true);
     }
 
@@ -429,6 +511,7 @@ void respond_to_aos(db_session_t& session,
     auto payload = req.body();
     auto payload_ptr = reinterpret_cast<char const*>(payload.data());
     auto payload_len = static_cast<ustore_size_t>(*opt_payload_len);
+    boost::ignore_unused(received_verb, options, payload_format, payload_ptr, payload_len);
 
 #if 0
     // Once we know, which collection, key and transaction user is
@@ -460,9 +543,9 @@ void respond_to_aos(db_session_t& session,
         }
 
         // Pull the entire objects before we start sampling their fields
-        arena_t tape(session.db());
+        arena_t tape(connection.db());
         status_t status;
-        // ustore_read(session.db(),
+        // ustore_read(connection.db(),
         //          txn.raw,
         //          keys.data(),
         //          keys.size(),
@@ -542,28 +625,630 @@ void respond_to_aos(db_session_t& session,
     return send_response(std::move(res));
 }
 
+/**
+ * @brief Enqueues one operation of a `/batch` request into the connection buffers.
+ * Values are copied into the shared tape, as parsers may reuse their memory.
+ */
+status_t enqueue_batch_op(connection_state_t& connection,
+                          std::string_view op,
+                          std::string_view collection_name,
+                          ustore_key_t key,
+                          value_view_t value) noexcept {
+
+    auto maybe_collection = connection.collection(collection_name);
+    if (!maybe_collection)
+        return maybe_collection.release_status();
+
+    if (op == "read") {
+        connection.read_collections.push_back(*maybe_collection);
+        connection.read_keys.push_back(key);
+    }
+    else if (op == "write" || op == "remove") {
+        bool is_removal = op == "remove";
+        if (!is_removal && !value)
+            return status_t::status_view("Writes must provide a \"value\"");
+
+        connection.write_collections.push_back(*maybe_collection);
+        connection.write_keys.push_back(key);
+        connection.write_offsets.push_back(static_cast<ustore_length_t>(connection.write_tape.size()));
+        connection.write_lengths.push_back(is_removal ? ustore_length_missing_k
+                                                      : static_cast<ustore_length_t>(value.size()));
+        if (!is_removal && !value.empty())
+            connection.write_tape.append(value.c_str(), value.size());
+    }
+    else
+        return status_t::status_view("Operations must be one of: \"read\", \"write\", \"remove\"");
+
+    return {};
+}
+
+/**
+ * @brief Parses newline-delimited JSON objects, like:
+ * `{"op":"write","col":"name","key":42,"value":"..."}`.
+ */
+status_t parse_batch_ndjson(connection_state_t& connection, std::string& payload) noexcept {
+
+    auto payload_length = payload.size();
+    payload.resize(payload_length + sj::SIMDJSON_PADDING, '\0');
+
+    char const* const payload_end = payload.data() + payload_length;
+    char const* line_begin = payload.data();
+    while (line_begin < payload_end) {
+        char const* line_end = std::find(line_begin, payload_end, '\n');
+        std::size_t line_length = static_cast<std::size_t>(line_end - line_begin);
+        std::size_t line_capacity = static_cast<std::size_t>(payload.data() + payload.size() - line_begin);
+        bool is_blank = std::all_of(line_begin, line_end, [](char c) { return c == ' ' || c == '\r' || c == '\t'; });
+        if (is_blank) {
+            line_begin = line_end + 1;
+            continue;
+        }
+
+        sj::ondemand::document doc;
+        sj::ondemand::object object;
+        auto line = sj::padded_string_view(line_begin, line_length, line_capacity);
+        if (connection.json_parser.iterate(line).get(doc) || doc.get_object().get(object))
+            return status_t::status_view("Every NDJSON line must be an object");
+
+        std::string_view op, collection_name;
+        std::string_view value_str;
+        bool has_value = false;
+        int64_t key = 0;
+        for (auto field : object) {
+            std::string_view field_name;
+            sj::ondemand::value field_value;
+            if (field.unescaped_key().get(field_name) || field.value().get(field_value))
+                return status_t::status_view("Failed to parse NDJSON field");
+
+            sj::error_code error = sj::SUCCESS;
+            if (field_name == "op")
+                error = field_value.get_string().get(op);
+            else if (field_name == "col")
+                error = field_value.get_string().get(collection_name);
+            else if (field_name == "key")
+                error = field_value.get_int64().get(key);
+            else if (field_name == "value") {
+                error = field_value.get_string().get(value_str);
+                has_value = true;
+            }
+            if (error)
+                return status_t::status_view("Fields \"op\", \"col\" and \"value\" must be strings, \"key\" - integer");
+        }
+
+        // Unescaped strings are backed by the parser, which is reset on the next line,
+        // and `op` and `col` are consumed right away.
+        value_view_t value = has_value ? value_view_t {value_str} : value_view_t {};
+        if (status_t status = enqueue_batch_op(connection, op, collection_name, key, value); !status)
+            return status;
+        line_begin = line_end + 1;
+    }
+
+    payload.resize(payload_length);
+    return {};
+}
+
+/**
+ * @brief Parses a MsgPack array of maps with the same fields as `parse_batch_ndjson`.
+ * Here the "value" may be either a string or a binary blob.
+ */
+status_t parse_batch_msgpack(connection_state_t& connection, std::string const& payload) noexcept {
+
+    mpack_reader_t reader;
+    mpack_reader_init_data(&reader, payload.data(), payload.size());
+    mpack_tag_t array_tag = mpack_read_tag(&reader);
+    if (mpack_tag_type(&array_tag) != mpack_type_array) {
+        mpack_reader_destroy(&reader);
+        return status_t::status_view("MsgPack batch must be an array of maps");
+    }
+
+    status_t status;
+    uint32_t ops_count = mpack_tag_array_count(&array_tag);
+    for (uint32_t op_idx = 0; op_idx != ops_count && status; ++op_idx) {
+        mpack_tag_t map_tag = mpack_read_tag(&reader);
+        if (mpack_tag_type(&map_tag) != mpack_type_map) {
+            status = status_t::status_view("MsgPack batch must be an array of maps");
+            break;
+        }
+
+        std::string_view op, collection_name;
+        value_view_t value;
+        int64_t key = 0;
+        uint32_t fields_count = mpack_tag_map_count(&map_tag);
+        for (uint32_t field_idx = 0; field_idx != fields_count; ++field_idx) {
+            mpack_tag_t name_tag = mpack_read_tag(&reader);
+            if (mpack_tag_type(&name_tag) != mpack_type_str) {
+                status = status_t::status_view("MsgPack batch fields must be named with strings");
+                break;
+            }
+            uint32_t name_length = mpack_tag_str_length(&name_tag);
+            auto field_name = std::string_view(mpack_read_bytes_inplace(&reader, name_length), name_length);
+            mpack_done_str(&reader);
+
+            mpack_tag_t tag = mpack_read_tag(&reader);
+            mpack_type_t type = mpack_tag_type(&tag);
+            if (field_name == "key" && type == mpack_type_uint)
+                key = static_cast<int64_t>(mpack_tag_uint_value(&tag));
+            else if (field_name == "key" && type == mpack_type_int)
+                key = mpack_tag_int_value(&tag);
+            else if (type == mpack_type_str) {
+                uint32_t length = mpack_tag_str_length(&tag);
+                auto data = std::string_view(mpack_read_bytes_inplace(&reader, length), length);
+                mpack_done_str(&reader);
+                if (field_name == "op")
+                    op = data;
+                else if (field_name == "col")
+                    collection_name = data;
+                else if (field_name == "value")
+                    value = value_view_t {data};
+            }
+            else if (type == mpack_type_bin) {
+                uint32_t length = mpack_tag_bin_length(&tag);
+                auto data = mpack_read_bytes_inplace(&reader, length);
+                mpack_done_bin(&reader);
+                if (field_name == "value")
+                    value = value_view_t {reinterpret_cast<ustore_bytes_cptr_t>(data), length};
+            }
+            else if (type == mpack_type_array || type == mpack_type_map) {
+                status = status_t::status_view("MsgPack batch fields can't be nested");
+                break;
+            }
+        }
+        if (!status)
+            break;
+
+        mpack_done_map(&reader);
+        if (mpack_reader_error(&reader) != mpack_ok)
+            status = status_t::status_view("Failed to parse MsgPack batch");
+        else
+            status = enqueue_batch_op(connection, op, collection_name, key, value);
+    }
+
+    if (status)
+        mpack_done_array(&reader);
+    if (mpack_reader_destroy(&reader) != mpack_ok && status)
+        status = status_t::status_view("Failed to parse MsgPack batch");
+    return status;
+}
+
+/**
+ * @brief Appends `{"key":int,"value":str|null}` lines to the output.
+ * Binary values are only escaped, not encoded, so MsgPack or BSON should be preferred.
+ */
+void export_ndjson(ustore_key_t const* keys,
+                   ustore_length_t const* offsets,
+                   ustore_length_t const* lengths,
+                   ustore_bytes_cptr_t values,
+                   std::size_t count,
+                   std::string& output) {
+
+    char key_str[32];
+    for (std::size_t i = 0; i != count; ++i) {
+        auto key_end = std::to_chars(key_str, key_str + sizeof(key_str), keys[i]).ptr;
+        output += "{\"key\":";
+        output.append(key_str, key_end);
+        if (lengths[i] == ustore_length_missing_k) {
+            output += ",\"value\":null}\n";
+            continue;
+        }
+
+        output += ",\"value\":\"";
+        auto value = std::string_view(reinterpret_cast<char const*>(values) + offsets[i], lengths[i]);
+        for (char c : value) {
+            static constexpr char hex_k[] = "0123456789abcdef";
+            auto u = static_cast<unsigned char>(c);
+            if (c == '"' || c == '\\')
+                output += '\\', output += c;
+            else if (u < 0x20)
+                output += "\\u00", output += hex_k[u >> 4], output += hex_k[u & 0xF];
+            else
+                output += c;
+        }
+        output += "\"}\n";
+    }
+}
+
+/**
+ * @brief Appends a sequence of `{"key":int,"value":bin|nil}` MsgPack maps to the output,
+ * without an enclosing array, so that entries can be streamed before their count is known.
+ */
+void export_msgpack(ustore_key_t const* keys,
+                    ustore_length_t const* offsets,
+                    ustore_length_t const* lengths,
+                    ustore_bytes_cptr_t values,
+                    std::size_t count,
+                    std::string& output) {
+
+    // Map header, two short keys, a 64-bit integer and a binary header per entry.
+    std::size_t capacity = 0;
+    for (std::size_t i = 0; i != count; ++i)
+        capacity += 26 + (lengths[i] == ustore_length_missing_k ? 0 : lengths[i]);
+    std::size_t const initial_size = output.size();
+    output.resize(initial_size + capacity);
+
+    mpack_writer_t writer;
+    mpack_writer_init(&writer, output.data() + initial_size, capacity);
+    for (std::size_t i = 0; i != count; ++i) {
+        mpack_start_map(&writer, 2);
+        mpack_write_cstr(&writer, "key");
+        mpack_write_i64(&writer, keys[i]);
+        mpack_write_cstr(&writer, "value");
+        if (lengths[i] == ustore_length_missing_k)
+            mpack_write_nil(&writer);
+        else
+            mpack_write_bin(&writer, reinterpret_cast<char const*>(values) + offsets[i], lengths[i]);
+        mpack_finish_map(&writer);
+    }
+
+    output.resize(initial_size + mpack_writer_buffer_used(&writer));
+    mpack_writer_destroy(&writer);
+}
+
+template <typename scalar_at>
+void append_little_endian(std::string& output, scalar_at scalar) {
+    for (std::size_t byte_idx = 0; byte_idx != sizeof(scalar_at); ++byte_idx)
+        output += static_cast<char>((static_cast<uint64_t>(scalar) >> (byte_idx * 8)) & 0xFF);
+}
+
+/**
+ * @brief Appends a sequence of `{"key":int64,"value":binary|null}` BSON documents to
+ * the output, like `mongodump` does. The format is simple enough to skip `libbson`.
+ */
+void export_bson(ustore_key_t const* keys,
+                 ustore_length_t const* offsets,
+                 ustore_length_t const* lengths,
+                 ustore_bytes_cptr_t values,
+                 std::size_t count,
+                 std::string& output) {
+
+    constexpr char bson_int64_k = 0x12;
+    constexpr char bson_binary_k = 0x05;
+    constexpr char bson_null_k = 0x0A;
+    constexpr char bson_subtype_generic_k = 0x00;
+
+    for (std::size_t i = 0; i != count; ++i) {
+        bool is_missing = lengths[i] == ustore_length_missing_k;
+        // Size prefix, the "key" field, the "value" field and the terminator.
+        int32_t doc_size = 4 + (1 + 4 + 8) + (1 + 6 + (is_missing ? 0 : 5 + lengths[i])) + 1;
+        append_little_endian(output, doc_size);
+        output += bson_int64_k;
+        output.append("key", 4);
+        append_little_endian(output, keys[i]);
+        if (is_missing) {
+            output += bson_null_k;
+            output.append("value", 6);
+        }
+        else {
+            output += bson_binary_k;
+            output.append("value", 6);
+            append_little_endian(output, static_cast<int32_t>(lengths[i]));
+            output += bson_subtype_generic_k;
+            output.append(reinterpret_cast<char const*>(values) + offsets[i], lengths[i]);
+        }
+        output += '\0';
+    }
+}
+
+using export_entries_t = void (*)(ustore_key_t const*,
+                                  ustore_length_t const*,
+                                  ustore_length_t const*,
+                                  ustore_bytes_cptr_t,
+                                  std::size_t,
+                                  std::string&);
+
+/**
+ * @brief Executes a list of reads, writes and removals as just one `ustore_write`
+ * followed by one `ustore_read`, so reads observe the writes of the same batch.
+ * The response lists the read values in the order of requests, using the
+ * same format as the input: NDJSON or MsgPack.
+ */
+template <typename body_at, typename allocator_at, typename send_response_at>
+void respond_to_batch(connection_state_t& connection,
+                      http::request<body_at, http::basic_fields<allocator_at>>&& req,
+                      send_response_at&& send_response) {
+
+    if (req.method() != http::verb::post)
+        return send_response(make_error(req, http::status::method_not_allowed, "Batches must be POST-ed"));
+
+    auto payload_type = req[http::field::content_type];
+    bool is_msgpack = payload_type == mime_msgpack_k;
+    if (!is_msgpack && payload_type != mime_ndjson_k)
+        return send_response(
+            make_error(req, http::status::unsupported_media_type, "Batches must be NDJSON or MsgPack arrays"));
+
+    connection.clear_batch();
+    status_t status = is_msgpack ? parse_batch_msgpack(connection, req.body()) //
+                                 : parse_batch_ndjson(connection, req.body());
+    if (!status)
+        return send_response(make_error(req, http::status::bad_request, status.message()));
+
+    status = connection.begin();
+    if (!status)
+        return send_response(make_error(req, http::status::internal_server_error, status.message()));
+
+    std::size_t const writes_count = connection.write_keys.size();
+    std::size_t const reads_count = connection.read_keys.size();
+    if (writes_count) {
+        // The tape has stopped growing, so the addresses can be resolved.
+        auto tape = reinterpret_cast<ustore_bytes_cptr_t>(connection.write_tape.data());
+        connection.write_values.resize(writes_count);
+        for (std::size_t i = 0; i != writes_count; ++i)
+            connection.write_values[i] = connection.write_lengths[i] == ustore_length_missing_k ? nullptr : tape;
+
+        ustore_write_t write {};
+        write.db = connection.db();
+        write.error = status.member_ptr();
+        write.transaction = connection.txn();
+        write.arena = connection.arena();
+        write.tasks_count = writes_count;
+        write.collections = connection.write_collections.data();
+        write.collections_stride = sizeof(ustore_collection_t);
+        write.keys = connection.write_keys.data();
+        write.keys_stride = sizeof(ustore_key_t);
+        write.offsets = connection.write_offsets.data();
+        write.offsets_stride = sizeof(ustore_length_t);
+        write.lengths = connection.write_lengths.data();
+        write.lengths_stride = sizeof(ustore_length_t);
+        write.values = connection.write_values.data();
+        write.values_stride = sizeof(ustore_bytes_cptr_t);
+
+        ustore_write(&write);
+        if (!status)
+            return send_response(make_error(req, http::status::internal_server_error, status.message()));
+    }
+
+    ustore_length_t* found_offsets = nullptr;
+    ustore_length_t* found_lengths = nullptr;
+    ustore_byte_t* found_values = nullptr;
+    if (reads_count) {
+        ustore_read_t read {};
+        read.db = connection.db();
+        read.error = status.member_ptr();
+        read.transaction = connection.txn();
+        read.arena = connection.arena();
+        read.tasks_count = reads_count;
+        read.collections = connection.read_collections.data();
+        read.collections_stride = sizeof(ustore_collection_t);
+        read.keys = connection.read_keys.data();
+        read.keys_stride = sizeof(ustore_key_t);
+        read.offsets = &found_offsets;
+        read.lengths = &found_lengths;
+        read.values = &found_values;
+
+        ustore_read(&read);
+        if (!status)
+            return send_response(make_error(req, http::status::internal_server_error, status.message()));
+    }
+
+    if (writes_count) {
+        status = connection.commit();
+        if (!status)
+            return send_response(make_error(req, http::status::conflict, status.message()));
+    }
+
+    std::string response_str;
+    if (is_msgpack) {
+        // MsgPack "array 32" header, followed by the big-endian count
+        response_str += static_cast<char>(0xDD);
+        for (int shift = 24; shift >= 0; shift -= 8)
+            response_str += static_cast<char>((reads_count >> shift) & 0xFF);
+    }
+    auto export_entries = is_msgpack ? &export_msgpack : &export_ndjson;
+    export_entries(connection.read_keys.data(), found_offsets, found_lengths, found_values, reads_count, response_str);
+
+    http::response<http::string_body> res {
+        std::piecewise_construct,
+        std::make_tuple(std::move(response_str)),
+        std::make_tuple(http::status::ok, req.version()),
+    };
+    res.set(http::field::server, server_name_k);
+    res.set(http::field::content_type, is_msgpack ? mime_msgpack_k : mime_ndjson_k);
+    res.content_length(res.body().size());
+    res.keep_alive(req.keep_alive());
+    return send_response(std::move(res));
+}
+
+/// Number of entries fetched and sent in every chunk of range scans.
+static constexpr ustore_size_t scan_page_k = 4096;
+
+/**
+ * @brief State of a range scan, streamed in chunks with "Transfer-Encoding: chunked".
+ * Every chunk is fetched only after the previous one was written.
+ */
+struct range_scan_t {
+    ustore_collection_t collection = ustore_collection_main_k;
+    ustore_key_t next_key = std::numeric_limits<ustore_key_t>::min();
+    ustore_key_t end_key = std::numeric_limits<ustore_key_t>::max();
+    ustore_size_t remaining = std::numeric_limits<ustore_size_t>::max();
+    export_entries_t export_entries = &export_ndjson;
+    bool bounded = false;
+    bool exhausted = false;
+};
+
+/**
+ * @brief Scans the next page of keys, reads their values with the memory arena
+ * of the connection and exports them into the @p chunk. Leaves the chunk empty,
+ * once the range is exhausted.
+ */
+status_t fetch_scan_page(connection_state_t& connection, range_scan_t& scan, std::string& chunk) noexcept {
+
+    status_t status;
+    chunk.clear();
+    if (scan.exhausted)
+        return status;
+
+    ustore_length_t count_limit = static_cast<ustore_length_t>(std::min(scan_page_k, scan.remaining));
+    ustore_length_t* found_counts = nullptr;
+    ustore_key_t* found_keys = nullptr;
+
+    ustore_scan_t scan_args {};
+    scan_args.db = connection.db();
+    scan_args.error = status.member_ptr();
+    scan_args.arena = connection.arena();
+    scan_args.tasks_count = 1;
+    scan_args.collections = &scan.collection;
+    scan_args.start_keys = &scan.next_key;
+    scan_args.end_keys = scan.bounded ? &scan.end_key : nullptr;
+    scan_args.count_limits = &count_limit;
+    scan_args.counts = &found_counts;
+    scan_args.keys = &found_keys;
+
+    ustore_scan(&scan_args);
+    if (!status)
+        return status;
+
+    ustore_length_t found_count = found_counts[0];
+    if (!found_count) {
+        scan.exhausted = true;
+        return status;
+    }
+
+    ustore_key_t last_key = found_keys[found_count - 1];
+    scan.remaining -= found_count;
+    bool is_last_key = last_key == std::numeric_limits<ustore_key_t>::max();
+    scan.exhausted = found_count < count_limit || !scan.remaining || is_last_key;
+    scan.next_key = scan.exhausted ? last_key : last_key + 1;
+
+    ustore_length_t* found_offsets = nullptr;
+    ustore_length_t* found_lengths = nullptr;
+    ustore_byte_t* found_values = nullptr;
+    ustore_read_t read {};
+    read.db = connection.db();
+    read.error = status.member_ptr();
+    read.arena = connection.arena();
+    read.options = ustore_option_dont_discard_memory_k;
+    read.tasks_count = found_count;
+    read.collections = &scan.collection;
+    read.keys = found_keys;
+    read.keys_stride = sizeof(ustore_key_t);
+    read.offsets = &found_offsets;
+    read.lengths = &found_lengths;
+    read.values = &found_values;
+
+    ustore_read(&read);
+    if (!status)
+        return status;
+
+    scan.export_entries(found_keys, found_offsets, found_lengths, found_values, found_count, chunk);
+    return status;
+}
+
+/**
+ * @brief Picks the first supported MIME type from the "Accept" header,
+ * defaulting to NDJSON. Returns an empty view, if none is supported.
+ */
+beast::string_view negotiate_mime(beast::string_view accept) {
+    if (accept.empty())
+        return mime_ndjson_k;
+
+    while (!accept.empty()) {
+        auto entry_end = std::find(accept.begin(), accept.end(), ',');
+        auto entry = beast::string_view {accept.begin(), static_cast<size_t>(entry_end - accept.begin())};
+        accept.remove_prefix(std::min(accept.size(), entry.size() + 1));
+
+        // Drop the parameters, like "q=0.9", and the surrounding whitespaces
+        entry = entry.substr(0, entry.find(';'));
+        while (!entry.empty() && entry.front() == ' ')
+            entry.remove_prefix(1);
+        while (!entry.empty() && entry.back() == ' ')
+            entry.remove_suffix(1);
+
+        if (entry == mime_ndjson_k || entry == mime_json_k || entry == "*/*" || entry == "application/*")
+            return mime_ndjson_k;
+        if (entry == mime_msgpack_k || entry == mime_bson_k || entry == mime_arrow_k)
+            return entry;
+    }
+    return {};
+}
+
+/**
+ * @brief Streams a range of a collection, paging through `ustore_scan` and `ustore_read`
+ * while writing, so the memory usage is bounded by a single page.
+ * Receives: `GET /col/name?from=int&to=int&limit=int`, where `to` is exclusive.
+ * Failures on the first page are answered with an error, and on later pages - reset the connection.
+ */
+template <typename body_at, typename allocator_at, typename send_response_at>
+void respond_to_range(connection_state_t& connection,
+                      http::request<body_at, http::basic_fields<allocator_at>>&& req,
+                      send_response_at&& send_response) {
+
+    if (req.method() != http::verb::get)
+        return send_response(make_error(req, http::status::method_not_allowed, "Collections can only be scanned"));
+
+    beast::string_view received_path = req.target();
+    auto name_begin = received_path.begin() + 5;
+    auto name_end = std::find(name_begin, received_path.end(), '?');
+    auto params_str = beast::string_view {name_end, static_cast<size_t>(received_path.end() - name_end)};
+
+    range_scan_t scan;
+    auto maybe_collection = connection.collection({name_begin, static_cast<size_t>(name_end - name_begin)});
+    if (!maybe_collection)
+        return send_response(
+            make_error(req, http::status::internal_server_error, maybe_collection.release_status().message()));
+    scan.collection = *maybe_collection;
+
+    auto parse_param = [&](beast::string_view name, auto& result) {
+        auto value = param_value(params_str, name);
+        if (!value)
+            return true;
+        auto parse_result = std::from_chars(value->data(), value->data() + value->size(), result);
+        return parse_result.ec == std::errc();
+    };
+    if (!parse_param("from=", scan.next_key) || !parse_param("to=", scan.end_key) ||
+        !parse_param("limit=", scan.remaining))
+        return send_response(make_error(req, http::status::bad_request, "Couldn't parse the integer range"));
+    scan.bounded = param_value(params_str, "to=").has_value();
+    scan.exhausted = !scan.remaining || (scan.bounded && scan.end_key <= scan.next_key);
+
+    auto mime = negotiate_mime(req[http::field::accept]);
+    if (mime == mime_arrow_k)
+        return send_response(
+            make_error(req, http::status::not_acceptable, "Arrow streams are served by the Flight server"));
+    if (mime.empty())
+        return send_response(
+            make_error(req, http::status::not_acceptable, "Ranges are exported in NDJSON, MsgPack or BSON"));
+
+    switch (mime_to_format(mime)) {
+    case ustore_doc_field_msgpack_k: scan.export_entries = &export_msgpack; break;
+    case ustore_doc_field_bson_k: scan.export_entries = &export_bson; break;
+    default: scan.export_entries = &export_ndjson; break;
+    }
+
+    // The first page is fetched before the headers are sent,
+    // so that its failures can still be reported with a status code.
+    std::string first_chunk;
+    status_t status = fetch_scan_page(connection, scan, first_chunk);
+    if (!status)
+        return send_response(make_error(req, http::status::internal_server_error, status.message()));
+
+    http::response<http::empty_body> res {http::status::ok, req.version()};
+    res.set(http::field::server, server_name_k);
+    res.set(http::field::content_type, mime);
+    res.chunked(true);
+    res.keep_alive(req.keep_alive());
+    return send_response.stream(std::move(res), std::move(scan), std::move(first_chunk));
+}
+
 /**
  * @brief Primary dispatch point, routing incoming HTTP requests
  *        into underlying UStore calls, preparing results and sending back.
  */
 template <typename body_at, typename allocator_at, typename send_response_at>
-void route_request(db_session_t& session,
+void route_request(connection_state_t& connection,
                    http::request<body_at, http::basic_fields<allocator_at>>&& req,
                    send_response_at&& send_response) {
 
-    http::verb received_verb = req.method();
     beast::string_view received_path = req.target();
-    fmt::print("Received path: {} {}\n",
-               std::string(beast::http::to_string(received_verb)),
-               std::string(received_path));
 
     // Modifying single entries:
     if (received_path.starts_with("/one/"))
-        return respond_to_one(session, std::move(req), send_response);
+        return respond_to_one(connection, std::move(req), send_response);
 
-    // Modifying collections:
-    else if (received_path.starts_with("/col/")) {
-    }
+    // Batching many single-entry operations:
+    else if (received_path == "/batch" || received_path.starts_with("/batch?"))
+        return respond_to_batch(connection, std::move(req), send_response);
+
+    // Streaming collections:
+    else if (received_path.starts_with("/col/"))
+        return respond_to_range(connection, std::move(req), send_response);
 
     // Global operations:
     else if (received_path.starts_with("/all/")) {
@@ -575,7 +1260,7 @@ void route_request(db_session_t& session,
 
     // Array-of-Structures:
     else if (received_path.starts_with("/aos/"))
-        return respond_to_aos(session, std::move(req), send_response);
+        return respond_to_aos(connection, std::move(req), send_response);
 
     // Structure-of-Arrays:
     else if (received_path.starts_with("/soa/"))
@@ -588,6 +1273,9 @@ void route_request(db_session_t& session,
     return send_response(make_error(req, http::status::bad_request, "Unknown request"));
 }
 
+/// Limits the size of request bodies, mostly relevant for `/batch` requests.
+static constexpr std::size_t body_limit_k = 64ul * 1024ul * 1024ul;
+
 /**
  * @brief A communication channel/session for a single client.
  */
@@ -616,19 +1304,92 @@ class web_db_session_t : public std::enable_shared_from_this<web_db_session_t> {
                 *sp,
                 beast::bind_front_handler(&web_db_session_t::on_write, self_.shared_from_this(), sp->need_eof()));
         }
+
+        void stream(http::response<http::empty_body>&& header, range_scan_t&& scan, std::string&& first_chunk) const {
+            self_.start_stream(std::move(header), std::move(scan), std::move(first_chunk));
+        }
     };
 
     beast::tcp_stream stream_;
     beast::flat_buffer buffer_;
-    std::shared_ptr<db_w_clients_t> db_;
-    db_session_t db_session_;
-    http::request<http::string_body> req_;
+    connection_state_t connection_;
+    std::optional<http::request_parser<http::string_body>> parser_;
     std::shared_ptr<void> res_;
     send_request_t send_request_;
 
+    /// @name Range scans, streamed in chunks.
+    /// @{
+    range_scan_t scan_;
+    http::response<http::empty_body> scan_header_;
+    std::optional<http::response_serializer<http::empty_body>> scan_serializer_;
+    std::string scan_chunk_;
+    /// @}
+
+    void start_stream(http::response<http::empty_body>&& header, range_scan_t&& scan, std::string&& first_chunk) {
+        scan_ = std::move(scan);
+        scan_header_ = std::move(header);
+        scan_chunk_ = std::move(first_chunk);
+        scan_serializer_.emplace(scan_header_);
+        http::async_write_header(stream_,
+                                 *scan_serializer_,
+                                 beast::bind_front_handler(&web_db_session_t::on_stream_header, shared_from_this()));
+    }
+
+    void on_stream_header(beast::error_code ec, std::size_t bytes_transferred) {
+        boost::ignore_unused(bytes_transferred);
+
+        if (ec)
+            return log_failure(ec, "stream");
+
+        write_stream_chunk();
+    }
+
+    void on_stream_write(beast::error_code ec, std::size_t bytes_transferred) {
+        boost::ignore_unused(bytes_transferred);
+
+        if (ec)
+            return log_failure(ec, "stream");
+
+        status_t status = fetch_scan_page(connection_, scan_, scan_chunk_);
+        if (!status)
+            return abort_stream(status);
+
+        write_stream_chunk();
+    }
+
+    /**
+     * @brief Sends the fetched chunk, or the last empty one, if the range is exhausted.
+     */
+    void write_stream_chunk() {
+        stream_.expires_after(std::chrono::seconds(30));
+        if (!scan_chunk_.empty())
+            return net::async_write(
+                stream_,
+                http::make_chunk(net::buffer(scan_chunk_)),
+                beast::bind_front_handler(&web_db_session_t::on_stream_write, shared_from_this()));
+
+        net::async_write(stream_,
+                         http::make_chunk_last(),
+                         beast::bind_front_handler(&web_db_session_t::on_write,
+                                                   shared_from_this(),
+                                                   scan_header_.need_eof()));
+    }
+
+    /**
+     * @brief Reports a failure after the headers were sent, when the status code can't be changed.
+     * The connection is reset before the last chunk, instead of being shut down gracefully,
+     * so that clients treat the truncated body as an error, rather than a shorter range.
+     */
+    void abort_stream(status_t const& status) {
+        std::cerr << "stream: " << status.message() << "\n";
+        beast::error_code ec;
+        stream_.socket().set_option(net::socket_base::linger(true, 0), ec);
+        stream_.socket().close(ec);
+    }
+
   public:
     web_db_session_t(tcp::socket&& socket, std::shared_ptr<db_w_clients_t> const& session)
-        : stream_(std::move(socket)), db_(session), db_session_(session->session()), send_request_(*this) {}
+        : stream_(std::move(socket)), connection_(session), send_request_(*this) {}
 
     /**
      * @brief Start the asynchronous operation.
@@ -645,7 +1406,8 @@ class web_db_session_t : public std::enable_shared_from_this<web_db_session_t> {
     void do_read() {
         // Make the request empty before reading,
         // otherwise the operation behavior is undefined.
-        req_ = {};
+        parser_.emplace();
+        parser_->body_limit(body_limit_k);
 
         // Set the timeout.
         stream_.expires_after(std::chrono::seconds(30));
@@ -653,7 +1415,7 @@ class web_db_session_t : public std::enable_shared_from_this<web_db_session_t> {
         // Read a request
         http::async_read(stream_,
                          buffer_,
-                         req_,
+                         *parser_,
                          beast::bind_front_handler(&web_db_session_t::on_read, shared_from_this()));
     }
 
@@ -668,7 +1430,7 @@ class web_db_session_t : public std::enable_shared_from_this<web_db_session_t> {
             return log_failure(ec, "read");
 
         // send_at the response
-        route_request(db_session_, std::move(req_), send_request_);
+        route_request(connection_, parser_->release(), send_request_);
     }
 
     void on_write(bool close, beast::error_code ec, std::size_t bytes_transferred) {
@@ -697,9 +1459,19 @@ class web_db_session_t : public std::enable_shared_from_this<web_db_session_t> {
 
 //------------------------------------------------------------------------------
 
+#if defined(SO_REUSEPORT)
+using reuse_port_t = net::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+static constexpr bool supports_reuse_port_k = true;
+#else
+static constexpr bool supports_reuse_port_k = false;
+#endif
+
 /**
  * @brief Spins on sockets, listening for new connection requests.
  *        Once accepted, allocates and dispatches a new @c web_db_session_t.
+ *
+ * With @b `SO_REUSEPORT` every thread gets a separate listener bound to the
+ * same port, and the kernel balances incoming connections between them.
  */
 class listener_t : public std::enable_shared_from_this<listener_t> {
     net::io_context& io_context_;
@@ -707,9 +1479,12 @@ class listener_t : public std::enable_shared_from_this<listener_t> {
     std::shared_ptr<db_w_clients_t> db_;
 
   public:
-    listener_t(net::io_context& io_context, tcp::endpoint endpoint, std::shared_ptr<db_w_clients_t> const& session)
+    listener_t(net::io_context& io_context,
+               tcp::endpoint endpoint,
+               std::shared_ptr<db_w_clients_t> const& session,
+               bool reuse_port)
         : io_context_(io_context), acceptor_(net::make_strand(io_context)), db_(session) {
-        connect_to(endpoint);
+        connect_to(endpoint, reuse_port);
     }
 
     // Start accepting incoming connections
@@ -733,7 +1508,7 @@ class listener_t : public std::enable_shared_from_this<listener_t> {
         do_accept();
     }
 
-    void connect_to(tcp::endpoint endpoint) {
+    void connect_to(tcp::endpoint endpoint, bool reuse_port) {
         beast::error_code ec;
 
         // Open the acceptor
@@ -746,6 +1521,16 @@ class listener_t : public std::enable_shared_from_this<listener_t> {
         if (ec)
             return log_failure(ec, "set_option");
 
+#if defined(SO_REUSEPORT)
+        // Allow several listeners on the same port
+        if (reuse_port)
+            acceptor_.set_option(reuse_port_t(true), ec);
+        if (ec)
+            return log_failure(ec, "set_option");
+#else
+        boost::ignore_unused(reuse_port);
+#endif
+
         // Bind to the server address
         acceptor_.bind(endpoint, ec);
         if (ec)
@@ -764,10 +1549,11 @@ int main(int argc, char* argv[]) {
 
     // Check command line arguments
     if (argc < 4) {
-        std::cerr << "Usage: ustore_beast_server <address> <port> <threads> <db_config_path>?\n"
+        std::cerr << "Usage: ustore_rest_server_* <address> <port> <threads> <db_config_path>?\n"
+                  << "Passing 0 threads will start one per hardware core.\n"
                   << "Example:\n"
-                  << "    ustore_beast_server 0.0.0.0 8080 1\n"
-                  << "    ustore_beast_server 0.0.0.0 8080 1 ./config.json\n"
+                  << "    ustore_rest_server_ucset 0.0.0.0 8080 1\n"
+                  << "    ustore_rest_server_ucset 0.0.0.0 8080 0 ./config.json\n"
                   << "";
         return EXIT_FAILURE;
     }
@@ -775,7 +1561,9 @@ int main(int argc, char* argv[]) {
     // Parse the arguments
     auto const address = net::ip::make_address(argv[1]);
     auto const port = static_cast<unsigned short>(std::atoi(argv[2]));
-    auto const threads = std::max<int>(1, std::atoi(argv[3]));
+    auto const requested_threads = std::atoi(argv[3]);
+    auto const hardware_threads = static_cast<int>(std::thread::hardware_concurrency());
+    auto const threads = requested_threads > 0 ? requested_threads : std::max<int>(1, hardware_threads);
     auto db_config = std::string();
 
     // Read the configuration file
@@ -789,29 +1577,32 @@ int main(int argc, char* argv[]) {
 
     // Check if we can initialize the DB
     auto session = std::make_shared<db_w_clients_t>();
-    status_t status;
-    ustore_database_init_t database {
-        .config = db_config.c_str(),
-        .db = &session->raw,
-        .error = error.member_ptr(),
-    };
-
-    ustore_database_init(&database);
+    status_t status = session->session.open(db_config.c_str());
     if (!status) {
-        std::cerr << "Couldn't initialize DB: " << error.raw << std::endl;
+        std::cerr << "Couldn't initialize DB: " << status.message() << std::endl;
         return EXIT_FAILURE;
     }
+    session->supports_transactions = session->session.supports_transactions();
+
+    // With `SO_REUSEPORT` every thread polls its own context and listener,
+    // avoiding contention on a shared queue. Otherwise, all threads share one.
+    auto const contexts_count = supports_reuse_port_k ? threads : 1;
+    auto const threads_per_context = supports_reuse_port_k ? 1 : threads;
+    std::vector<std::unique_ptr<net::io_context>> io_contexts(contexts_count);
+    for (auto& io_context : io_contexts) {
+        io_context = std::make_unique<net::io_context>(threads_per_context);
+        auto endpoint = tcp::endpoint {address, port};
+        std::make_shared<listener_t>(*io_context, endpoint, session, supports_reuse_port_k)->run();
+    }
 
-    // Create and launch a listening port
-    auto io_context = net::io_context {threads};
-    std::make_shared<listener_t>(io_context, tcp::endpoint {address, port}, session)->run();
-
-    // Run the I/O service on the requested number of threads
+    // Run the I/O services on the requested number of threads
     std::vector<std::thread> v;
     v.reserve(threads - 1);
-    for (auto i = threads - 1; i > 0; --i)
+    for (auto i = threads - 1; i > 0; --i) {
+        auto& io_context = *io_contexts[i % contexts_count];
         v.emplace_back([&io_context] { io_context.run(); });
-    io_context.run();
+    }
+    io_contexts.front()->run();
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -5,12 +5,23 @@
 #include <unistd.h>   // `close` files
 
 #include <ctime>
+#include <queue>
+#include <cctype>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
 #include <vector>
+#include <limits>
+#include <memory>
+#include <optional>
 #include <cstring>
 #include <numeric>
 #include <fstream>
 #include <algorithm>
 #include <filesystem>
+#include <condition_variable>
 
 #include <arrow/api.h>
 #include <arrow/array.h>
@@ -23,8 +34,9 @@
 #include <arrow/io/api.h>
 #include <arrow/io/file.h>
 #include <arrow/compute/api_aggregate.h>
+#include <arrow/ipc/api.h>
 #include <parquet/arrow/reader.h>
-#include <parquet/stream_writer.h>
+#include <parquet/arrow/writer.h>
 #include <parquet/exception.h>
 
 #include <simdjson.h>
@@ -32,8 +44,9 @@
 
 #include <ustore/ustore.hpp>
 #include <ustore/cpp/ranges.hpp>
-#include <ustore/cpp/blobs_range.hpp>   // `keys_stream_t`
-#include <../helpers/linked_memory.hpp> // `linked_memory_lock_t`
+#include <ustore/cpp/blobs_range.hpp>        // `keys_stream_t`
+#include <../helpers/linked_memory.hpp>      // `linked_memory_lock_t`
+#include <../helpers/neighborhood_codec.hpp> // `compress_neighborhood`
 
 #include "dataset.h"
 
@@ -46,22 +59,22 @@ constexpr ustore_str_view_t prefix_k = "{";
 // 2 vertices and 1 edge
 constexpr ustore_size_t vertices_edge_k = 3;
 
+constexpr ustore_size_t export_range_keys_k = 4096;
+
 using tape_t = ptr_range_gt<ustore_char_t>;
 using fields_t = strided_iterator_gt<ustore_str_view_t const>;
 using lengths_t = strided_iterator_gt<ustore_length_t const>;
-using keys_length_t = std::pair<ustore_key_t*, ustore_size_t>;
-using val_t = std::pair<ustore_bytes_ptr_t, ustore_size_t>;
 using counts_t = ptr_range_gt<ustore_size_t>;
 using chunked_array_t = std::shared_ptr<arrow::ChunkedArray>;
 using array_t = std::shared_ptr<arrow::Array>;
 using int_builder_t = arrow::NumericBuilder<arrow::Int64Type>;
-using docs_t = ptr_range_gt<value_view_t>;
 using edges_t = ptr_range_gt<edge_t>;
 
 enum ustore_dataset_ext_t {
     parquet_k = 0,
     csv_k,
     ndjson_k,
+    arrow_k,
     unknown_k,
 };
 using ext_t = ustore_dataset_ext_t;
@@ -265,6 +278,14 @@ std::string generate_file_name() {
     return fmt::format("{}_{}", out, get_time_since_epoch());
 }
 
+ext_t export_format(ustore_str_view_t ext) {
+    return strcmp_(ext, ".parquet")                              ? parquet_k
+           : strcmp_(ext, ".csv")                                ? csv_k
+           : strcmp_(ext, ".ndjson")                             ? ndjson_k
+           : strcmp_(ext, ".arrow") || strcmp_(ext, ".feather") ? arrow_k
+                                                                  : unknown_k;
+}
+
 template <typename task_at>
 void validate_docs_fields(task_at& task) {
     if (!task.fields_count && !task.fields)
@@ -370,6 +391,37 @@ void check_for_id_field(ustore_docs_import_t& imp) {
     return_error_if_m(state, imp.error, 0, "Fields must contain id_field");
 }
 
+/**
+ * @brief Imports into empty collections don't have to be merged with existing
+ * entries, so they are marked with `ustore_option_write_bulk_k`, letting the
+ * engines ingest batches directly, bypassing the usual write path.
+ */
+template <typename import_at>
+bool is_empty_collection(import_at& c) {
+    ustore_key_t const start_key = std::numeric_limits<ustore_key_t>::min();
+    ustore_length_t const limit = 1;
+    ustore_length_t* found_counts = nullptr;
+    ustore_scan_t scan {
+        .db = c.db,
+        .error = c.error,
+        .arena = c.arena,
+        .options = ustore_option_dont_discard_memory_k,
+        .tasks_count = 1,
+        .collections = &c.collection,
+        .start_keys = &start_key,
+        .count_limits = &limit,
+        .counts = &found_counts,
+    };
+    ustore_scan(&scan);
+    return !*c.error && !found_counts[0];
+}
+
+template <typename import_at>
+void mark_bulk_if_empty(import_at& c) {
+    if (is_empty_collection(c))
+        c.options = ustore_options_t(c.options | ustore_option_write_bulk_k);
+}
+
 template <typename ustore_docs_task_at>
 void prepare_fields(ustore_docs_task_at& c, linked_memory_lock_t& arena, fields_t& fields_output) {
 
@@ -675,22 +727,27 @@ void fields_parser( //
 
 #pragma region - Upserting
 
-void upsert_docs(ustore_docs_import_t& c, docs_t& docs, ustore_size_t task_count) {
+/**
+ * @brief Upserts a buffer of whitespace-separated documents, parsing them in one pass.
+ * Doesn't keep the memory of the previous writes, so batches must not live in the arena.
+ */
+void upsert_joined_docs(ustore_docs_import_t& c, value_view_t joined, ustore_size_t task_count) {
 
+    ustore_length_t length = static_cast<ustore_length_t>(joined.size());
+    auto begin = reinterpret_cast<ustore_bytes_cptr_t>(joined.data());
     ustore_docs_write_t docs_write {
         .db = c.db,
         .error = c.error,
         .arena = c.arena,
-        .options = ustore_option_dont_discard_memory_k,
+        .options = ustore_options_t(c.options & ustore_option_write_bulk_k),
         .tasks_count = task_count,
         .type = ustore_doc_field_json_k,
         .modification = ustore_doc_modify_upsert_k,
         .collections = &c.collection,
-        .lengths = docs[0].member_length(),
-        .lengths_stride = sizeof(value_view_t),
-        .values = docs[0].member_ptr(),
-        .values_stride = sizeof(value_view_t),
+        .lengths = &length,
+        .values = &begin,
         .id_field = c.id_field,
+        .values_joined = true,
     };
 
     ustore_docs_write(&docs_write);
@@ -703,7 +760,7 @@ void upsert_graph(ustore_graph_import_t& c, edges_t const& edges_src, ustore_siz
         .db = c.db,
         .error = c.error,
         .arena = c.arena,
-        .options = ustore_option_dont_discard_memory_k,
+        .options = ustore_options_t(ustore_option_dont_discard_memory_k | (c.options & ustore_option_write_bulk_k)),
         .tasks_count = task_count,
         .collections = &c.collection,
         .edges_ids = strided.edge_ids.begin().get(),
@@ -764,449 +821,810 @@ void import_csv(import_at& c, std::shared_ptr<arrow::Table>& table) {
 }
 #pragma endregion - Files Importing
 
-#pragma region - Docs
+#pragma region - Pipelining
 
-void parse_arrow_table_docs(ustore_docs_import_t& c,
-                            std::shared_ptr<arrow::Table> const& table,
-                            linked_memory_lock_t& arena) {
+/**
+ * @brief Joined NDJSON documents, ready for `upsert_joined_docs()`.
+ * Either owns the `content`, or references the mapped file with `joined`.
+ */
+struct docs_batch_t {
+    std::string content;
+    std::string_view joined;
+    ustore_size_t count = 0;
 
-    fields_t fields;
-    ustore_size_t used_mem = 0;
-    ustore_char_t* field = nullptr;
-    std::string json = "{";
-    ustore_char_t* json_cstr = nullptr;
-    arrow_visitor_t visitor(json);
-
-    if (!c.fields) {
-        auto clmn_names = table->ColumnNames();
-        c.fields_count = clmn_names.size();
-        auto names = arena.alloc<ustore_str_view_t>(c.fields_count, c.error);
-        return_if_error_m(c.error);
+    value_view_t view() const noexcept {
+        std::string_view str = content.empty() ? joined : std::string_view(content);
+        return value_view_t(str.data(), str.size());
+    }
+};
 
-        for (ustore_size_t idx = 0; idx < c.fields_count; ++idx) {
-            field = arena.alloc<ustore_char_t>(clmn_names[idx].size() + 1, c.error).begin();
-            return_if_error_m(c.error);
-            std::memcpy(field, clmn_names[idx].data(), clmn_names[idx].size() + 1);
-            names[idx] = field;
-        }
+/**
+ * @brief Connects the stages of imports, blocking the producers while it is full,
+ * so that the faster stages can't outrun the slower ones and exhaust the memory.
+ */
+template <typename element_at>
+class bounded_queue_gt {
+    std::mutex mutex_;
+    std::condition_variable pushed_;
+    std::condition_variable popped_;
+    std::deque<element_at> elements_;
+    std::size_t capacity_ = 0;
+    std::size_t producers_ = 0;
+    bool cancelled_ = false;
 
-        c.fields_stride = sizeof(ustore_str_view_t);
-        fields = fields_t {names.begin(), c.fields_stride};
-    }
-    else {
-        fields = fields_t {c.fields, c.fields_stride};
-        c.fields_count = c.fields_count;
+  public:
+    bounded_queue_gt(std::size_t capacity, std::size_t producers) noexcept
+        : capacity_(std::max<std::size_t>(capacity, 1)), producers_(producers) {}
+
+    /**
+     * @return `false` if the queue was cancelled, dropping the @p element.
+     */
+    bool push(element_at&& element) noexcept(false) {
+        std::unique_lock<std::mutex> lock {mutex_};
+        popped_.wait(lock, [&] { return cancelled_ || elements_.size() < capacity_; });
+        if (cancelled_)
+            return false;
+        elements_.push_back(std::move(element));
+        pushed_.notify_one();
+        return true;
     }
 
-    auto columns = arena.alloc<chunked_array_t>(c.fields_count, c.error);
-    return_if_error_m(c.error);
-    auto chunks = arena.alloc<array_t>(c.fields_count, c.error);
-    return_if_error_m(c.error);
+    /**
+     * @return `false` if the queue was cancelled, or all the producers are done and it is drained.
+     */
+    bool pop(element_at& element) noexcept(false) {
+        std::unique_lock<std::mutex> lock {mutex_};
+        pushed_.wait(lock, [&] { return cancelled_ || !elements_.empty() || !producers_; });
+        if (cancelled_ || elements_.empty())
+            return false;
+        element = std::move(elements_.front());
+        elements_.pop_front();
+        popped_.notify_one();
+        return true;
+    }
 
-    auto columns_begin = columns.begin();
-    auto chunks_begin = chunks.begin();
+    /**
+     * @brief Must be called by every producer, once it is done.
+     */
+    void close() noexcept {
+        std::lock_guard<std::mutex> lock {mutex_};
+        if (--producers_ == 0)
+            pushed_.notify_all();
+    }
 
-    for (ustore_size_t idx = 0; idx < c.fields_count; ++idx, ++columns_begin, ++chunks_begin) {
-        new (columns_begin) chunked_array_t();
-        new (chunks_begin) array_t();
-        chunked_array_t column = table->GetColumnByName(fields[idx]);
-        return_error_if_m(column, c.error, 0, fmt::format("{} is not exist", fields[idx]).c_str());
-        columns[idx] = column;
+    /**
+     * @brief Wakes up all the producers and consumers, to stop the pipeline on failures.
+     */
+    void cancel() noexcept {
+        {
+            std::lock_guard<std::mutex> lock {mutex_};
+            cancelled_ = true;
+        }
+        pushed_.notify_all();
+        popped_.notify_all();
     }
+};
 
-    ustore_size_t count = columns[0]->num_chunks();
-    auto values = arena.alloc<value_view_t>(table->num_rows(), c.error);
-    return_if_error_m(c.error);
+/**
+ * @brief Collects the failures of a single pipeline thread, as exceptions can't cross threads.
+ */
+struct stage_status_t {
+    ustore_error_t error = nullptr;
+    std::string exception;
 
-    ustore_size_t idx = 0;
-    for (ustore_size_t chunk_idx = 0, g_idx = 0; chunk_idx != count; ++chunk_idx, g_idx = 0) {
+    bool ok() const noexcept { return !error; }
 
-        for (auto column : columns) {
-            chunks[g_idx] = column->chunk(chunk_idx);
-            ++g_idx;
+    template <typename callback_at>
+    void run(ustore_str_view_t name, callback_at&& callback) noexcept {
+        try {
+            callback();
         }
-
-        for (ustore_size_t value_idx = 0; value_idx < columns[0]->chunk(chunk_idx)->length(); ++value_idx) {
-
-            g_idx = 0;
-            for (auto it = fields; g_idx < c.fields_count; ++g_idx, ++it) {
-                fmt::format_to(std::back_inserter(json), "\"{}\":", *it);
-                visitor.idx = value_idx;
-                auto status = arrow::VisitArrayInline(*chunks[g_idx].get(), &visitor);
-                if (!status.ok()) {
-                    auto ptr = arena.alloc<char>(status.message().size() + 1, c.error);
-                    return_if_error_m(c.error);
-                    std::memcpy(ptr.data(), status.message().c_str(), status.message().size() + 1);
-                    *c.error = ptr.data();
-                }
+        catch (std::bad_alloc const&) {
+            error = "Out of memory";
+        }
+        catch (std::exception const& ex) {
+            error = name;
+            try {
+                exception = ex.what();
             }
-
-            json[json.size() - 1] = '}';
-            json.push_back('\n');
-            json_cstr = arena.alloc<ustore_char_t>(json.size() + 1, c.error).begin();
-            return_if_error_m(c.error);
-            std::memcpy(json_cstr, json.data(), json.size() + 1);
-
-            values[idx] = json_cstr;
-            used_mem += json.size();
-            json = "{";
-            ++idx;
-
-            if (used_mem >= c.max_batch_size) {
-                upsert_docs(c, values, idx);
-                return_if_error_m(c.error);
-                used_mem = 0;
-                idx = 0;
+            catch (...) {
             }
         }
+        catch (...) {
+            error = name;
+        }
     }
-    if (idx != 0)
-        upsert_docs(c, values, idx);
-}
+};
 
-void import_whole_ndjson(ustore_docs_import_t& c,
-                         simdjson::ondemand::document_stream& docs,
-                         ustore_size_t rows_count,
-                         linked_memory_lock_t& arena) {
+/**
+ * @brief Imports documents in three concurrent stages, connected with bounded queues.
+ * The calling thread reads the file in chunks, `parsers_count` threads convert them into
+ * batches of joined documents, and `writers_count` threads upsert those, each into its
+ * own arena, so the memory is recycled between batches.
+ *
+ * @param read Receives the next chunk and an error slot, returns `false` at the end of file.
+ * @param make_parser Is called once in every parser thread, producing its own state: a callable,
+ * that receives a chunk, a function to emit the batches and an error slot. May throw.
+ */
+template <typename chunk_at, typename read_at, typename make_parser_at>
+void import_in_parallel(ustore_docs_import_t& c, read_at&& read, make_parser_at&& make_parser) {
+
+    ustore_size_t const hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+    ustore_size_t const parsers_count = c.parsers_count ? c.parsers_count : hardware_threads;
+    ustore_size_t const writers_count = c.writers_count ? c.writers_count : hardware_threads;
+
+    // Every consumer may have one element waiting for it, beside the one it is processing
+    bounded_queue_gt<chunk_at> chunks(parsers_count, 1);
+    bounded_queue_gt<docs_batch_t> batches(writers_count, parsers_count);
+    std::vector<stage_status_t> statuses(1 + parsers_count + writers_count);
+    auto cancel = [&] {
+        chunks.cancel();
+        batches.cancel();
+    };
 
-    ustore_size_t idx = 0;
-    ustore_size_t used_mem = 0;
+    std::mutex progress_mutex;
+    ustore_size_t imported_count = 0;
+    auto report_progress = [&](ustore_size_t count) {
+        std::lock_guard<std::mutex> lock {progress_mutex};
+        imported_count += count;
+        if (c.imported_count)
+            *c.imported_count = imported_count;
+        if (c.callback)
+            c.callback(c.callback_payload);
+    };
 
-    auto values = arena.alloc<value_view_t>(rows_count, c.error);
-    return_if_error_m(c.error);
+    auto parse_chunks = [&](stage_status_t& status) {
+        status.run("Failed to parse documents", [&] {
+            auto parse = make_parser();
+            auto emit = [&](docs_batch_t&& batch) {
+                return batches.push(std::move(batch));
+            };
+            chunk_at chunk;
+            while (status.ok() && chunks.pop(chunk))
+                parse(chunk, emit, &status.error);
+        });
+        if (!status.ok())
+            cancel();
+        batches.close();
+    };
 
-    for (auto doc : docs) {
-        simdjson::ondemand::object object = doc.get_object().value();
-        values[idx] = rewinded(object).raw_json().value();
-        used_mem += values[idx].size();
-        ++idx;
-        if (used_mem >= c.max_batch_size) {
-            upsert_docs(c, values, idx);
-            return_if_error_m(c.error);
-            idx = 0;
-        }
+    auto write_batches = [&](stage_status_t& status) {
+        status.run("Failed to import documents", [&] {
+            arena_t arena(c.db);
+            ustore_docs_import_t task = c;
+            task.error = &status.error;
+            task.arena = arena.member_ptr();
+            docs_batch_t batch;
+            while (status.ok() && batches.pop(batch)) {
+                upsert_joined_docs(task, batch.view(), batch.count);
+                if (status.ok())
+                    report_progress(batch.count);
+            }
+        });
+        if (!status.ok())
+            cancel();
+    };
+
+    std::vector<std::thread> threads;
+    stage_status_t& reader = statuses.front();
+    reader.run("Failed to read the dataset", [&] {
+        threads.reserve(parsers_count + writers_count);
+        for (ustore_size_t idx = 0; idx != parsers_count; ++idx)
+            threads.emplace_back(parse_chunks, std::ref(statuses[1 + idx]));
+        for (ustore_size_t idx = 0; idx != writers_count; ++idx)
+            threads.emplace_back(write_batches, std::ref(statuses[1 + parsers_count + idx]));
+
+        chunk_at chunk;
+        while (read(chunk, &reader.error))
+            if (!chunks.push(std::move(chunk)))
+                break;
+    });
+    if (!reader.ok())
+        cancel();
+    chunks.close();
+    for (auto& thread : threads)
+        thread.join();
+
+    for (auto const& status : statuses) {
+        if (!status.exception.empty())
+            throw std::runtime_error(status.exception);
+        return_error_if_m(status.ok(), c.error, 0, status.error);
     }
-    if (idx != 0)
-        upsert_docs(c, values, idx);
 }
 
-void import_sub_ndjson(ustore_docs_import_t& c,
-                       simdjson::ondemand::document_stream& docs,
-                       ustore_size_t rows_count,
-                       linked_memory_lock_t& arena) {
-
-    fields_t fields;
-    prepare_fields(c, arena, fields);
-    ustore_size_t max_size = c.fields_count * symbols_count_k;
-    for (ustore_size_t idx = 0; idx < c.fields_count; ++idx)
-        max_size += std::strlen(fields[idx]);
+/**
+ * @brief Rows of an export, formatted by one of the workers.
+ * NDJSON rows are kept as `text`, the rest as a `record_batch`.
+ *
+ * Every range of keys may be formatted into several batches, numbered with `part`.
+ * The `sequence` is the number of the range, and an empty batch marked as `last`
+ * follows the parts of every range, so the writer can restore the order of keys.
+ */
+struct export_batch_t {
+    std::shared_ptr<arrow::RecordBatch> record_batch;
+    std::string text;
+    ustore_size_t count = 0;
+    std::size_t sequence = 0;
+    std::size_t part = 0;
+    bool last = false;
+};
 
-    auto values = arena.alloc<value_view_t>(rows_count, c.error);
-    return_if_error_m(c.error);
+/**
+ * @brief Output file of an export, with a fixed schema, for every supported format.
+ * Every Parquet batch becomes a separate row group, and ".arrow" and ".feather"
+ * files are written in the Arrow IPC file format, also known as Feather V2.
+ */
+class export_file_t {
+    ext_t format_ = unknown_k;
+    std::shared_ptr<arrow::Schema> schema_;
+    std::shared_ptr<arrow::io::FileOutputStream> stream_;
+    std::shared_ptr<arrow::ipc::RecordBatchWriter> batches_writer_;
+    std::unique_ptr<parquet::arrow::FileWriter> parquet_writer_;
 
-    ustore_size_t used_mem = 0;
-    std::string json = "{";
-    ustore_char_t* json_cstr = nullptr;
+  public:
+    void open(ustore_str_view_t extension,
+              ext_t format,
+              std::shared_ptr<arrow::Schema> schema,
+              ustore_error_t* error) noexcept(false) {
+
+        format_ = format;
+        schema_ = std::move(schema);
+        auto maybe_stream = arrow::io::FileOutputStream::Open(fmt::format("{}{}", generate_file_name(), extension));
+        return_error_if_m(maybe_stream.ok(), error, 0, "Can't open file");
+        stream_ = *maybe_stream;
+
+        if (format_ == parquet_k) {
+            auto status = parquet::arrow::FileWriter::Open( //
+                *schema_,
+                arrow::default_memory_pool(),
+                stream_,
+                parquet::default_writer_properties(),
+                &parquet_writer_);
+            return_error_if_m(status.ok(), error, 0, "Can't instantiate writer");
+        }
+        else if (format_ == csv_k || format_ == arrow_k) {
+            auto maybe_writer = format_ == csv_k
+                                    ? arrow::csv::MakeCSVWriter(stream_, schema_, arrow::csv::WriteOptions::Defaults())
+                                    : arrow::ipc::MakeFileWriter(stream_, schema_);
+            return_error_if_m(maybe_writer.ok(), error, 0, "Can't instantiate writer");
+            batches_writer_ = *maybe_writer;
+        }
+    }
 
-    counts_t counts = arena.alloc<ustore_size_t>(c.fields_count, c.error);
-    return_if_error_m(c.error);
+    void write(export_batch_t const& batch, ustore_error_t* error) noexcept(false) {
+        if (format_ == ndjson_k) {
+            auto status = stream_->Write(batch.text.data(), batch.text.size());
+            return_error_if_m(status.ok(), error, 0, "Can't write in file");
+            return;
+        }
+        if (format_ == parquet_k) {
+            auto maybe_table = arrow::Table::FromRecordBatches(schema_, {batch.record_batch});
+            return_error_if_m(maybe_table.ok(), error, 0, "Can't make table");
+            auto status = parquet_writer_->WriteTable(**maybe_table, batch.record_batch->num_rows());
+            return_error_if_m(status.ok(), error, 0, "Can't write in file");
+            return;
+        }
+        return_error_if_m(batches_writer_->WriteRecordBatch(*batch.record_batch).ok(), error, 0, "Can't write in file");
+    }
 
-    auto tape = arena.alloc<ustore_char_t>(max_size, c.error);
-    return_if_error_m(c.error);
-    fields_parser(c.error, arena, c.fields_count, fields, counts, tape);
+    void close(ustore_error_t* error) noexcept(false) {
+        if (parquet_writer_)
+            return_error_if_m(parquet_writer_->Close().ok(), error, 0, "Can't finish file");
+        if (batches_writer_)
+            return_error_if_m(batches_writer_->Close().ok(), error, 0, "Can't finish file");
+        if (stream_ && !stream_->closed())
+            return_error_if_m(stream_->Close().ok(), error, 0, "Failed to close file");
+    }
+};
 
-    ustore_size_t idx = 0;
-    for (auto doc : docs) {
-        simdjson::ondemand::object object = doc.get_object().value();
-        simdjson_object_parser(object, counts, fields, c.fields_count, tape, json);
+/**
+ * @brief Exports a collection in three concurrent stages, connected with bounded queues.
+ * The calling thread splits the key space into ranges of consecutive present keys,
+ * `threads_count` workers fetch and format those ranges concurrently, each into its own arena,
+ * and a single writer appends the batches to the @p file, in the order of the ranges.
+ * Batches, that arrive ahead of their turn, are held back by the writer, so the rows
+ * of the file are sorted like the keys, regardless of the number of workers.
+ *
+ * @param format Receives the keys of a range, an arena, a function to emit the batches
+ * and an error slot. May throw.
+ */
+template <typename export_at, typename format_at>
+void export_in_parallel(export_at& c, export_file_t& file, format_at&& format) {
+
+    ustore_size_t const hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+    ustore_size_t const workers_count = c.threads_count ? c.threads_count : hardware_threads;
+
+    struct range_t {
+        std::vector<ustore_key_t> keys;
+        std::size_t sequence = 0;
+    };
+    bounded_queue_gt<range_t> ranges(workers_count, 1);
+    bounded_queue_gt<export_batch_t> batches(workers_count, workers_count);
+    std::vector<stage_status_t> statuses(2 + workers_count);
+    auto cancel = [&] {
+        ranges.cancel();
+        batches.cancel();
+    };
 
-        json.push_back('\n');
-        json_cstr = arena.alloc<ustore_char_t>(json.size() + 1, c.error).begin();
-        return_if_error_m(c.error);
-        std::memcpy(json_cstr, json.data(), json.size() + 1);
+    auto format_ranges = [&](stage_status_t& status) {
+        status.run("Failed to format rows", [&] {
+            arena_t arena(c.db);
+            range_t range;
+            std::size_t part = 0;
+            auto emit = [&](export_batch_t&& batch) {
+                batch.sequence = range.sequence;
+                batch.part = part++;
+                return batches.push(std::move(batch));
+            };
+            while (status.ok() && ranges.pop(range)) {
+                part = 0;
+                format(range.keys, arena.member_ptr(), emit, &status.error);
+                if (!status.ok())
+                    break;
+                export_batch_t end;
+                end.last = true;
+                if (!emit(std::move(end)))
+                    break;
+            }
+        });
+        if (!status.ok())
+            cancel();
+        batches.close();
+    };
 
-        values[idx] = json_cstr;
-        used_mem += json.size();
-        json = "{";
-        ++idx;
+    auto write_batches = [&](stage_status_t& status) {
+        status.run("Failed to write rows", [&] {
+            ustore_size_t exported_count = 0;
+            std::size_t next_sequence = 0;
+            std::size_t next_part = 0;
+            std::map<std::pair<std::size_t, std::size_t>, export_batch_t> pending;
+            export_batch_t batch;
+            while (status.ok() && batches.pop(batch)) {
+                pending.emplace(std::make_pair(batch.sequence, batch.part), std::move(batch));
+                for (auto it = pending.begin(); status.ok() && it != pending.end(); it = pending.erase(it)) {
+                    if (it->first != std::make_pair(next_sequence, next_part))
+                        break;
+                    if (it->second.last) {
+                        ++next_sequence;
+                        next_part = 0;
+                        continue;
+                    }
+                    ++next_part;
+                    file.write(it->second, &status.error);
+                    if (!status.ok())
+                        break;
+                    exported_count += it->second.count;
+                    if (c.exported_count)
+                        *c.exported_count = exported_count;
+                    if (c.callback)
+                        c.callback(c.callback_payload);
+                }
+            }
+        });
+        if (!status.ok())
+            cancel();
+    };
 
-        if (used_mem >= c.max_batch_size) {
-            upsert_docs(c, values, idx);
-            return_if_error_m(c.error);
-            idx = 0;
+    std::vector<std::thread> threads;
+    stage_status_t& reader = statuses.front();
+    reader.run("Failed to split keys", [&] {
+        threads.reserve(1 + workers_count);
+        threads.emplace_back(write_batches, std::ref(statuses[1]));
+        for (ustore_size_t idx = 0; idx != workers_count; ++idx)
+            threads.emplace_back(format_ranges, std::ref(statuses[2 + idx]));
+
+        keys_stream_t stream(c.db, c.collection, export_range_keys_k);
+        status_t status = stream.seek_to_first();
+        std::size_t sequence = 0;
+        while (status && !stream.is_end()) {
+            auto keys = stream.keys_batch();
+            if (keys.size() && !ranges.push(range_t {{keys.begin(), keys.end()}, sequence++}))
+                break;
+            status = stream.seek_to_next_batch();
         }
+        return_error_if_m(status, &reader.error, 0, "Failed to scan keys");
+    });
+    if (!reader.ok())
+        cancel();
+    ranges.close();
+    for (auto& thread : threads)
+        thread.join();
+
+    for (auto const& status : statuses) {
+        if (!status.exception.empty())
+            throw std::runtime_error(status.exception);
+        return_error_if_m(status.ok(), c.error, 0, status.error);
     }
-    if (idx != 0)
-        upsert_docs(c, values, idx);
+    file.close(c.error);
 }
 
-void import_ndjson_docs(ustore_docs_import_t& c, linked_memory_lock_t& arena) {
-
-    auto handle = open(c.paths_pattern, O_RDONLY);
-    return_error_if_m(handle != -1, c.error, 0, "Can't open file");
+#pragma endregion - Pipelining
 
-    ustore_size_t file_size = std::filesystem::file_size(std::filesystem::path(c.paths_pattern));
-    auto begin = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, handle, 0);
-    return_error_if_m(begin != MAP_FAILED, c.error, 0, "Failed to mmap content");
-    std::string_view mapped_content = std::string_view(reinterpret_cast<ustore_char_t const*>(begin), file_size);
-    auto res = madvise(begin, file_size, MADV_SEQUENTIAL);
-    return_error_if_m(res == 0, c.error, 0, "Failed to madvise content");
+#pragma region - Docs
 
-    std::ifstream file(c.paths_pattern);
-    ustore_size_t rows_count =
-        std::count(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>(), '\n') + 1;
+/**
+ * @brief Picks the columns, that will become the fields of documents: the requested ones, or all.
+ */
+void resolve_arrow_fields(ustore_docs_import_t& c,
+                          arrow::Schema const& schema,
+                          linked_memory_lock_t& arena,
+                          fields_t& fields,
+                          ustore_size_t& fields_count) {
 
-    simdjson::ondemand::parser parser;
-    simdjson::ondemand::document_stream docs = parser.iterate_many( //
-        mapped_content.data(),
-        mapped_content.size(),
-        1000000ul);
+    if (c.fields) {
+        fields = fields_t {c.fields, c.fields_stride};
+        fields_count = c.fields_count;
+        return;
+    }
 
-    if (!c.fields)
-        import_whole_ndjson(c, docs, rows_count, arena);
-    else
-        import_sub_ndjson(c, docs, rows_count, arena);
+    fields_count = static_cast<ustore_size_t>(schema.num_fields());
+    auto names = arena.alloc<ustore_str_view_t>(fields_count, c.error);
     return_if_error_m(c.error);
 
-    res = munmap((void*)mapped_content.data(), mapped_content.size());
-    return_error_if_m(res == 0, c.error, 0, "Failed to munmap content");
-    close(handle);
-    return_error_if_m(res == 0, c.error, 0, "Failed to close decriptor");
+    for (ustore_size_t idx = 0; idx < fields_count; ++idx) {
+        std::string const& name = schema.field(static_cast<int>(idx))->name();
+        auto field = arena.alloc<ustore_char_t>(name.size() + 1, c.error);
+        return_if_error_m(c.error);
+        std::memcpy(field.begin(), name.c_str(), name.size() + 1);
+        names[idx] = field.begin();
+    }
+    fields = fields_t {names.begin(), sizeof(ustore_str_view_t)};
 }
 
-void export_whole_docs( //
-    ustore_error_t* error,
-    linked_memory_lock_t& arena,
-    ptr_range_gt<ustore_key_t const>& keys,
-    ptr_range_gt<ustore_key_t>* keys_ptr,
-    ptr_range_gt<ustore_char_t*>* docs_ptr,
-    parquet::StreamWriter* os_ptr,
-    val_t const& values,
-    int handle,
-    ext_t pcn) {
-
-    ptr_range_gt<ustore_char_t*>& docs_vec = *docs_ptr;
-    ptr_range_gt<ustore_key_t>& keys_vec = *keys_ptr;
-    parquet::StreamWriter& os = *os_ptr;
-
-    ustore_size_t idx = 0;
-    auto iter = keys.begin();
-
-    simdjson::ondemand::parser parser;
-    simdjson::ondemand::document_stream docs = parser.iterate_many( //
-        values.first,
-        values.second,
-        1000000ul);
+/**
+ * @brief Formats every row of the @p record_batch into a JSON object on a separate line,
+ * emitting the documents every time they exceed `max_batch_size` bytes.
+ */
+template <typename emit_at>
+void parse_arrow_batch_docs(ustore_docs_import_t const& c,
+                            arrow::RecordBatch const& record_batch,
+                            fields_t const& fields,
+                            ustore_size_t fields_count,
+                            emit_at&& emit,
+                            ustore_error_t* error) {
+
+    std::vector<array_t> columns(fields_count);
+    for (ustore_size_t idx = 0; idx < fields_count; ++idx) {
+        columns[idx] = record_batch.GetColumnByName(fields[idx]);
+        return_error_if_m(columns[idx], error, 0, "Requested field doesn't exist");
+    }
 
-    for (auto doc : docs) {
-        simdjson::ondemand::object obj = doc.get_object().value();
-        auto value = rewinded(obj).raw_json().value();
-        auto json = std::string(value.data(), value.size());
-        json.pop_back();
-
-        if (pcn == parquet_k) {
-            os << *iter << json.data();
-            os << parquet::EndRow;
-        }
-        else if (pcn == csv_k) {
-            keys_vec[idx] = *iter;
-            docs_vec[idx] = arena.alloc<ustore_char_t>(json.size() + 1, error).begin();
-            return_if_error_m(error);
-            std::memcpy(docs_vec[idx], json.data(), json.size() + 1);
-            ++idx;
+    docs_batch_t docs;
+    arrow_visitor_t visitor(docs.content);
+    for (std::int64_t row_idx = 0; row_idx != record_batch.num_rows(); ++row_idx) {
+
+        docs.content.append(prefix_k);
+        visitor.idx = static_cast<ustore_size_t>(row_idx);
+        for (ustore_size_t idx = 0; idx < fields_count; ++idx) {
+            fmt::format_to(std::back_inserter(docs.content), "\"{}\":", fields[idx]);
+            auto status = arrow::VisitArrayInline(*columns[idx], &visitor);
+            if (!status.ok())
+                throw std::runtime_error(status.message());
         }
-        else {
-            auto str = fmt::format("{{\"_id\":{},\"doc\":{}}}\n", *iter, json.data());
-            write(handle, str.data(), str.size());
+        docs.content.back() = '}';
+        docs.content.push_back('\n');
+        ++docs.count;
+
+        // The visitor keeps referencing the same `content` member, once it is reset
+        if (docs.content.size() >= c.max_batch_size) {
+            if (!emit(std::move(docs)))
+                return;
+            docs.content.clear();
+            docs.count = 0;
         }
-        ++iter;
     }
+    if (docs.count)
+        emit(std::move(docs));
 }
 
-void export_sub_docs( //
-    ustore_docs_export_t& c,
-    linked_memory_lock_t& arena,
-    parquet::StreamWriter* os_ptr,
-    ptr_range_gt<ustore_char_t*>* docs_ptr,
-    ptr_range_gt<ustore_key_t>* keys_ptr,
-    ptr_range_gt<ustore_key_t const>& keys,
-    ptr_range_gt<ustore_char_t> const& tape,
-    fields_t const& fields,
-    counts_t const& counts,
-    val_t const& values,
-    int handle,
-    ext_t pcn) {
-
-    ptr_range_gt<ustore_char_t*>& docs_vec = *docs_ptr;
-    ptr_range_gt<ustore_key_t>& keys_vec = *keys_ptr;
-    parquet::StreamWriter& os = *os_ptr;
+/**
+ * @brief Row groups are decoded in the parser threads, each with its own file reader.
+ */
+void import_parquet_docs(ustore_docs_import_t& c, linked_memory_lock_t& arena) {
 
-    ustore_size_t idx = 0;
-    auto iter = keys.begin();
-    std::string json = prefix_k;
+    auto open_reader = [&](std::unique_ptr<parquet::arrow::FileReader>& reader) {
+        auto maybe_input = arrow::io::ReadableFile::Open(c.paths_pattern);
+        return maybe_input.ok() && parquet::arrow::OpenFile(*maybe_input, arrow::default_memory_pool(), &reader).ok();
+    };
 
-    simdjson::ondemand::parser parser;
-    simdjson::ondemand::document_stream docs = parser.iterate_many( //
-        values.first,
-        values.second,
-        1000000ul);
+    std::unique_ptr<parquet::arrow::FileReader> file_reader;
+    return_error_if_m(open_reader(file_reader), c.error, 0, "Can't instantiate reader");
+    std::shared_ptr<arrow::Schema> schema;
+    return_error_if_m(file_reader->GetSchema(&schema).ok(), c.error, 0, "Can't read schema");
 
-    for (auto doc : docs) {
-        simdjson::ondemand::object obj = doc.get_object().value();
-        simdjson_object_parser(obj, counts, fields, c.fields_count, tape, json);
+    fields_t fields;
+    ustore_size_t fields_count = 0;
+    resolve_arrow_fields(c, *schema, arena, fields, fields_count);
+    return_if_error_m(c.error);
 
-        if (pcn == parquet_k) {
-            os << *iter << json.data();
-            os << parquet::EndRow;
-        }
-        else if (pcn == csv_k) {
-            keys_vec[idx] = *iter;
-            docs_vec[idx] = arena.alloc<ustore_char_t>(json.size() + 1, c.error).begin();
-            return_if_error_m(c.error);
-            std::memcpy(docs_vec[idx], json.data(), json.size() + 1);
-            ++idx;
-        }
-        else {
-            auto str = fmt::format("{{\"_id\":{},\"doc\":{}}}\n", *iter, json.data());
-            write(handle, str.data(), str.size());
-        }
-        json = prefix_k;
-        ++iter;
-    }
-}
+    int const row_groups_count = file_reader->num_row_groups();
+    int next_row_group = 0;
+    auto read = [&](int& row_group, ustore_error_t*) {
+        if (next_row_group == row_groups_count)
+            return false;
+        row_group = next_row_group++;
+        return true;
+    };
 
-void make_parquet(ustore_docs_export_t& c, parquet::StreamWriter& os) {
+    auto make_parser = [&] {
+        std::unique_ptr<parquet::arrow::FileReader> reader;
+        if (!open_reader(reader))
+            throw std::runtime_error("Can't instantiate reader");
 
-    parquet::schema::NodeVector nodes;
-    nodes.push_back(parquet::schema::PrimitiveNode::Make( //
-        "_id",
-        parquet::Repetition::REQUIRED,
-        parquet::Type::INT64,
-        parquet::ConvertedType::INT_64));
+        return [&, reader = std::move(reader)](int row_group, auto& emit, ustore_error_t* error) {
+            std::shared_ptr<arrow::Table> table;
+            return_error_if_m(reader->ReadRowGroup(row_group, &table).ok(), error, 0, "Can't read row group");
+
+            arrow::TableBatchReader batches(*table);
+            std::shared_ptr<arrow::RecordBatch> record_batch;
+            while (true) {
+                return_error_if_m(batches.ReadNext(&record_batch).ok(), error, 0, "Can't read row group");
+                if (!record_batch)
+                    break;
+                parse_arrow_batch_docs(c, *record_batch, fields, fields_count, emit, error);
+                return_if_error_m(error);
+            }
+        };
+    };
 
-    nodes.push_back(parquet::schema::PrimitiveNode::Make( //
-        "doc",
-        parquet::Repetition::REQUIRED,
-        parquet::Type::BYTE_ARRAY,
-        parquet::ConvertedType::UTF8));
+    import_in_parallel<int>(c, read, make_parser);
+}
 
-    std::shared_ptr<parquet::schema::GroupNode> schema = std::static_pointer_cast<parquet::schema::GroupNode>(
-        parquet::schema::GroupNode::Make("schema", parquet::Repetition::REQUIRED, nodes));
+/**
+ * @brief Blocks of rows are parsed by the Arrow reader itself, on its own thread pool.
+ */
+void import_csv_docs(ustore_docs_import_t& c, linked_memory_lock_t& arena) {
 
-    auto maybe_outfile =
-        arrow::io::FileOutputStream::Open(fmt::format("{}{}", generate_file_name(), c.paths_extension));
-    return_error_if_m(maybe_outfile.ok(), c.error, 0, "Can't open file");
-    auto outfile = *maybe_outfile;
+    auto maybe_input = arrow::io::ReadableFile::Open(c.paths_pattern);
+    return_error_if_m(maybe_input.ok(), c.error, 0, "Can't open file");
 
-    parquet::WriterProperties::Builder builder;
-    builder.memory_pool(arrow::default_memory_pool());
-    builder.write_batch_size(c.max_batch_size);
+    auto maybe_reader = arrow::csv::StreamingReader::Make( //
+        arrow::io::default_io_context(),
+        *maybe_input,
+        arrow::csv::ReadOptions::Defaults(),
+        arrow::csv::ParseOptions::Defaults(),
+        arrow::csv::ConvertOptions::Defaults());
+    return_error_if_m(maybe_reader.ok(), c.error, 0, "Can't instantiate reader");
+    std::shared_ptr<arrow::csv::StreamingReader> reader = *maybe_reader;
 
-    os = parquet::StreamWriter {parquet::ParquetFileWriter::Open(outfile, schema, builder.build())};
-}
+    fields_t fields;
+    ustore_size_t fields_count = 0;
+    resolve_arrow_fields(c, *reader->schema(), arena, fields, fields_count);
+    return_if_error_m(c.error);
 
-int make_ndjson(ustore_docs_export_t& docs) {
-    return open(fmt::format("{}{}", generate_file_name(), docs.paths_extension).data(),
-                O_CREAT | O_WRONLY,
-                S_IRUSR | S_IWUSR);
-}
+    using record_batch_t = std::shared_ptr<arrow::RecordBatch>;
+    auto read = [&](record_batch_t& record_batch, ustore_error_t* error) {
+        if (!reader->ReadNext(&record_batch).ok()) {
+            log_error_m(error, 0, "Can't read file");
+            return false;
+        }
+        return record_batch != nullptr;
+    };
 
-void write_in_parquet( //
-    ustore_docs_export_t& c,
-    linked_memory_lock_t& arena,
-    parquet::StreamWriter& ostream,
-    ptr_range_gt<ustore_key_t const>& keys,
-    ptr_range_gt<ustore_char_t> const& tape,
-    fields_t const& fields,
-    counts_t const& counts,
-    val_t const& values) {
+    auto make_parser = [&] {
+        return [&](record_batch_t& record_batch, auto& emit, ustore_error_t* error) {
+            parse_arrow_batch_docs(c, *record_batch, fields, fields_count, emit, error);
+        };
+    };
 
-    if (c.fields)
-        export_sub_docs(c, arena, &ostream, nullptr, nullptr, keys, tape, fields, counts, values, 0, parquet_k);
-    else
-        export_whole_docs(c.error, arena, keys, nullptr, nullptr, &ostream, values, 0, parquet_k);
+    import_in_parallel<record_batch_t>(c, read, make_parser);
 }
 
-void write_in_csv( //
-    ustore_docs_export_t& c,
-    linked_memory_lock_t& arena,
-    ptr_range_gt<ustore_char_t*>& docs_vec,
-    ptr_range_gt<ustore_key_t>& keys_vec,
-    ptr_range_gt<ustore_key_t const>& keys,
-    int_builder_t& int_builder,
-    arrow::StringBuilder& string_builder,
-    ptr_range_gt<ustore_char_t> const& tape,
-    fields_t const& fields,
-    counts_t const& counts,
-    val_t const& values,
-    ustore_size_t size) {
+/**
+ * @brief Part of a memory-mapped NDJSON file, cut on a line boundary.
+ * Is followed by enough bytes of the file for SIMDJSON to parse it in place, if `is_padded`.
+ */
+struct ndjson_chunk_t {
+    std::string_view content;
+    bool is_padded = false;
+};
 
-    arrow::Status status;
-    status = int_builder.Resize(int_builder.capacity() + size);
-    return_error_if_m(status.ok(), c.error, 0, "Can't resize builder");
-    status = string_builder.Resize(string_builder.capacity() + size);
-    return_error_if_m(status.ok(), c.error, 0, "Can't resize builder");
-
-    if (c.fields)
-        export_sub_docs(c, arena, nullptr, &docs_vec, &keys_vec, keys, tape, fields, counts, values, 0, csv_k);
-    else
-        export_whole_docs(c.error, arena, keys, &keys_vec, &docs_vec, nullptr, values, 0, csv_k);
-
-    status = int_builder.AppendValues(keys_vec.begin(), size);
-    return_error_if_m(status.ok(), c.error, 0, "Can't append keys");
-    status = string_builder.AppendValues((ustore_char_t const**)docs_vec.begin(), size);
-    return_error_if_m(status.ok(), c.error, 0, "Can't append docs");
-}
+void import_ndjson_docs(ustore_docs_import_t& c, linked_memory_lock_t& arena) {
 
-void end_csv( //
-    ustore_docs_export_t& c,
-    arrow::StringBuilder& string_builder,
-    int_builder_t& int_builder) {
+    // Sub-documents are assembled from a template, shared by all the parsers
+    fields_t fields;
+    counts_t counts;
+    tape_t tape;
+    if (c.fields) {
+        prepare_fields(c, arena, fields);
+        return_if_error_m(c.error);
+        ustore_size_t max_size = c.fields_count * symbols_count_k;
+        for (ustore_size_t idx = 0; idx < c.fields_count; ++idx)
+            max_size += std::strlen(fields[idx]);
 
-    array_t keys_array;
-    array_t docs_array;
-    arrow::Status status;
+        counts = arena.alloc<ustore_size_t>(c.fields_count, c.error);
+        return_if_error_m(c.error);
+        tape = arena.alloc<ustore_char_t>(max_size, c.error);
+        return_if_error_m(c.error);
+        fields_parser(c.error, arena, c.fields_count, fields, counts, tape);
+        return_if_error_m(c.error);
+    }
 
-    status = int_builder.Finish(&keys_array);
-    return_error_if_m(status.ok(), c.error, 0, "Can't finish array(keys)");
-    status = string_builder.Finish(&docs_array);
-    return_error_if_m(status.ok(), c.error, 0, "Can't finish array(docs)");
+    auto handle = open(c.paths_pattern, O_RDONLY);
+    return_error_if_m(handle != -1, c.error, 0, "Can't open file");
 
-    arrow::FieldVector fields;
-    fields.push_back(arrow::field("_id", arrow::int64()));
-    fields.push_back(arrow::field("doc", arrow::large_binary()));
-    std::shared_ptr<arrow::Schema> schema = std::make_shared<arrow::Schema>(fields);
+    ustore_size_t file_size = std::filesystem::file_size(std::filesystem::path(c.paths_pattern));
+    auto begin = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, handle, 0);
+    return_error_if_m(begin != MAP_FAILED, c.error, 0, "Failed to mmap content");
+    std::string_view mapped_content = std::string_view(reinterpret_cast<ustore_char_t const*>(begin), file_size);
+    auto res = madvise(begin, file_size, MADV_SEQUENTIAL);
+    return_error_if_m(res == 0, c.error, 0, "Failed to madvise content");
 
-    std::shared_ptr<arrow::Table> table;
-    table = arrow::Table::Make(schema, {keys_array, docs_array});
+    ustore_size_t offset = 0;
+    auto read = [&](ndjson_chunk_t& chunk, ustore_error_t*) {
+        if (offset == mapped_content.size())
+            return false;
+        ustore_size_t end = mapped_content.size();
+        if (c.max_batch_size < end - offset) {
+            ustore_size_t newline = mapped_content.find('\n', offset + c.max_batch_size);
+            if (newline != std::string_view::npos)
+                end = newline + 1;
+        }
+        chunk.content = mapped_content.substr(offset, end - offset);
+        chunk.is_padded = mapped_content.size() - end >= simdjson::SIMDJSON_PADDING;
+        offset = end;
+        return true;
+    };
 
-    auto maybe_outstream =
-        arrow::io::FileOutputStream::Open(fmt::format("{}{}", generate_file_name(), c.paths_extension));
-    return_error_if_m(maybe_outstream.ok(), c.error, 0, "Can't open file");
-    std::shared_ptr<arrow::io::FileOutputStream> outstream = *maybe_outstream;
+    // Whole documents are only counted, as they can be passed to the writers without copies
+    auto make_parser = [&] {
+        return [&, parser = simdjson::ondemand::parser {}](ndjson_chunk_t& chunk, auto& emit, ustore_error_t*) mutable {
+            std::string json;
+            simdjson::padded_string padded;
+            std::string_view source = chunk.content;
+            if (!chunk.is_padded) {
+                padded = simdjson::padded_string(source);
+                source = padded;
+            }
+            simdjson::ondemand::document_stream docs = parser.iterate_many(source.data(), source.size(), 1000000ul);
+
+            docs_batch_t batch;
+            if (!c.fields)
+                batch.joined = chunk.content;
+            for (auto doc : docs) {
+                simdjson::ondemand::object object = doc.get_object().value();
+                if (c.fields) {
+                    json = prefix_k;
+                    simdjson_object_parser(object, counts, fields, c.fields_count, tape, json);
+                    batch.content.append(json);
+                    batch.content.push_back('\n');
+                }
+                else
+                    rewinded(object).raw_json().value();
+                ++batch.count;
+            }
+            if (batch.count)
+                emit(std::move(batch));
+        };
+    };
 
-    status = arrow::csv::WriteCSV(*table, arrow::csv::WriteOptions::Defaults(), outstream.get());
-    return_error_if_m(status.ok(), c.error, 0, "Can't write in file");
+    try {
+        import_in_parallel<ndjson_chunk_t>(c, read, make_parser);
+    }
+    catch (...) {
+        munmap(begin, file_size);
+        close(handle);
+        throw;
+    }
+
+    res = munmap(begin, file_size);
+    return_error_if_m(res == 0, c.error, 0, "Failed to munmap content");
+    res = close(handle);
+    return_error_if_m(res == 0, c.error, 0, "Failed to close decriptor");
 }
 
-int end_ndjson(int fd) {
-    return close(fd);
+/**
+ * @brief Exported documents are rows of two columns: the "_id" and the JSON "doc".
+ */
+std::shared_ptr<arrow::Schema> docs_export_schema() {
+    return arrow::schema({
+        arrow::field("_id", arrow::int64(), false),
+        arrow::field("doc", arrow::utf8(), false),
+    });
 }
 
-void write_in_ndjson( //
-    ustore_docs_export_t& c,
-    linked_memory_lock_t& arena,
-    ptr_range_gt<ustore_key_t const>& keys,
-    ptr_range_gt<ustore_char_t> const& tape,
+/**
+ * @brief Accumulates the exported rows, until they exceed `max_batch_size` bytes.
+ */
+class docs_export_batch_t {
+    ext_t format_;
+    std::shared_ptr<arrow::Schema> schema_;
+    arrow::Int64Builder keys_;
+    arrow::StringBuilder docs_;
+    export_batch_t batch_;
+    ustore_size_t size_ = 0;
+
+  public:
+    docs_export_batch_t(ext_t format, std::shared_ptr<arrow::Schema> schema) noexcept
+        : format_(format), schema_(std::move(schema)) {}
+
+    ustore_size_t size() const noexcept { return size_; }
+
+    void append(ustore_key_t key, std::string_view json) noexcept(false) {
+        size_ += sizeof(ustore_key_t) + json.size();
+        ++batch_.count;
+        if (format_ == ndjson_k) {
+            fmt::format_to(std::back_inserter(batch_.text), "{{\"_id\":{},\"doc\":{}}}\n", key, json);
+            return;
+        }
+        if (!keys_.Append(key).ok() || !docs_.Append(json.data(), static_cast<std::int32_t>(json.size())).ok())
+            throw std::runtime_error("Can't append docs");
+    }
+
+    export_batch_t release() noexcept(false) {
+        if (format_ != ndjson_k) {
+            array_t keys_array;
+            array_t docs_array;
+            if (!keys_.Finish(&keys_array).ok() || !docs_.Finish(&docs_array).ok())
+                throw std::runtime_error("Can't finish arrays");
+            batch_.record_batch = arrow::RecordBatch::Make(schema_, keys_array->length(), {keys_array, docs_array});
+        }
+        size_ = 0;
+        return std::exchange(batch_, export_batch_t {});
+    }
+};
+
+template <typename emit_at>
+void export_docs_range( //
+    ustore_docs_export_t const& c,
+    ext_t format,
+    std::shared_ptr<arrow::Schema> const& schema,
     fields_t const& fields,
     counts_t const& counts,
-    val_t const& values,
-    int handle) {
+    tape_t const& tape,
+    std::vector<ustore_key_t> const& keys,
+    ustore_arena_t* arena,
+    emit_at&& emit,
+    ustore_error_t* error) {
+
+    ustore_length_t* offsets = nullptr;
+    ustore_length_t* lengths = nullptr;
+    ustore_bytes_ptr_t values = nullptr;
+    ustore_docs_read_t docs_read {
+        .db = c.db,
+        .error = error,
+        .arena = arena,
+        .options = ustore_options_default_k,
+        .tasks_count = keys.size(),
+        .collections = &c.collection,
+        .keys = keys.data(),
+        .keys_stride = sizeof(ustore_key_t),
+        .offsets = &offsets,
+        .lengths = &lengths,
+        .values = &values,
+    };
+    ustore_docs_read(&docs_read);
+    return_if_error_m(error);
+
+    simdjson::ondemand::parser parser;
+    std::string padded;
+    std::string json;
+    docs_export_batch_t batch(format, schema);
+    for (ustore_size_t idx = 0; idx != keys.size(); ++idx) {
+        // Documents could have been removed since the keys were scanned
+        if (lengths[idx] == ustore_length_missing_k)
+            continue;
+
+        std::string_view doc(reinterpret_cast<ustore_char_t const*>(values + offsets[idx]), lengths[idx]);
+        while (doc.size() && std::isspace(static_cast<unsigned char>(doc.back())))
+            doc.remove_suffix(1);
+
+        if (c.fields) {
+            padded.reserve(doc.size() + simdjson::SIMDJSON_PADDING);
+            padded.assign(doc);
+            simdjson::ondemand::document parsed = parser.iterate(padded.data(), padded.size(), padded.capacity());
+            simdjson::ondemand::object object = parsed.get_object().value();
+            json = prefix_k;
+            simdjson_object_parser(object, counts, fields, c.fields_count, tape, json);
+            doc = json;
+        }
 
-    if (c.fields)
-        export_sub_docs(c, arena, nullptr, nullptr, nullptr, keys, tape, fields, counts, values, handle, ndjson_k);
-    else
-        export_whole_docs(c.error, arena, keys, nullptr, nullptr, nullptr, values, handle, ndjson_k);
+        batch.append(keys[idx], doc);
+        if (batch.size() >= c.max_batch_size && !emit(batch.release()))
+            return;
+    }
+    if (batch.size())
+        emit(batch.release());
 }
 
 #pragma region - Main Functions(Docs)
@@ -1227,6 +1645,8 @@ void ustore_docs_import(ustore_docs_import_t* c_ptr) {
     if (!c.arena)
         c.arena = arena_t(c.db).member_ptr();
 
+    mark_bulk_if_empty(c);
+    return_if_error_m(c.error);
     auto arena = linked_memory(c.arena, c.options, c.error);
     return_if_error_m(c.error);
 
@@ -1241,15 +1661,13 @@ void ustore_docs_import(ustore_docs_import_t* c_ptr) {
         auto ext = std::filesystem::path(c.paths_pattern).extension();
         if (ext == ".ndjson")
             import_ndjson_docs(c, arena);
-        else {
-            std::shared_ptr<arrow::Table> table;
-            if (ext == ".parquet")
-                import_parquet(c, table);
-            else if (ext == ".csv")
-                import_csv(c, table);
-            parse_arrow_table_docs(c, table, arena);
-            return_if_error_m(c.error);
-        }
+        else if (ext == ".parquet")
+            import_parquet_docs(c, arena);
+        else if (ext == ".csv")
+            import_csv_docs(c, arena);
+        else
+            log_error_m(c.error, 0, "Not supported format");
+        return_if_error_m(c.error);
     }
     catch (std::exception const& ex) {
         handle_exception(ex.what());
@@ -1267,11 +1685,7 @@ void ustore_docs_export(ustore_docs_export_t* c_ptr) {
     return_error_if_m(c.paths_extension, c.error, uninitialized_state_k, "Paths extension is uninitialized");
     return_error_if_m(c.max_batch_size, c.error, uninitialized_state_k, "Max batch size is 0");
 
-    auto ext = c.paths_extension;
-    ext_t pcn = strcmp_(ext, ".parquet")  ? parquet_k
-                : strcmp_(ext, ".csv")    ? csv_k
-                : strcmp_(ext, ".ndjson") ? ndjson_k
-                                          : unknown_k;
+    ext_t pcn = export_format(c.paths_extension);
     return_error_if_m(!(pcn == unknown_k), c.error, 0, "Not supported format");
 
     if (!c.arena)
@@ -1287,119 +1701,34 @@ void ustore_docs_export(ustore_docs_export_t* c_ptr) {
     };
 
     try {
-        int handle = 0;
-        parquet::StreamWriter os;
-        ptr_range_gt<ustore_char_t*> docs_vec;
-        ptr_range_gt<ustore_key_t> keys_vec;
-        arrow::StringBuilder string_builder;
-        int_builder_t int_builder;
-
-        ustore_size_t task_count = 1'000'000;
-        keys_stream_t stream(c.db, c.collection, task_count);
-
+        // Sub-documents are assembled from a template, shared by all the workers
         fields_t fields;
-        ptr_range_gt<ustore_char_t> tape;
-        auto counts = arena.alloc<ustore_size_t>(c.fields_count, c.error);
-        return_if_error_m(c.error);
-
-        if (pcn == parquet_k)
-            make_parquet(c, os);
-        else if (pcn == csv_k) {
-            keys_vec = arena.alloc<ustore_key_t>(task_count, c.error);
-            return_if_error_m(c.error);
-            docs_vec = arena.alloc<ustore_char_t*>(task_count, c.error);
-            return_if_error_m(c.error);
-        }
-        else
-            handle = make_ndjson(c);
-
+        counts_t counts;
+        tape_t tape;
         if (c.fields) {
             prepare_fields(c, arena, fields);
+            return_if_error_m(c.error);
             ustore_size_t max_size = c.fields_count * symbols_count_k;
             for (ustore_size_t idx = 0; idx < c.fields_count; ++idx)
                 max_size += std::strlen(fields[idx]);
 
+            counts = arena.alloc<ustore_size_t>(c.fields_count, c.error);
+            return_if_error_m(c.error);
             tape = arena.alloc<ustore_char_t>(max_size, c.error);
             return_if_error_m(c.error);
             fields_parser(c.error, arena, c.fields_count, fields, counts, tape);
             return_if_error_m(c.error);
         }
 
-        auto status = stream.seek_to_first();
-        return_error_if_m(status, c.error, 0, "No batches in stream");
-
-        while (!stream.is_end()) {
-            val_t values {nullptr, 0};
-            ustore_length_t* offsets = nullptr;
-            ustore_length_t* lengths = nullptr;
-            auto keys = stream.keys_batch();
-
-            ustore_docs_read_t docs_read {
-                .db = c.db,
-                .error = c.error,
-                .arena = c.arena,
-                .options = ustore_option_dont_discard_memory_k,
-                .tasks_count = keys.size(),
-                .collections = &c.collection,
-                .keys = keys.begin(),
-                .keys_stride = sizeof(ustore_key_t),
-                .lengths = &lengths,
-            };
-            ustore_docs_read(&docs_read);
-            return_if_error_m(c.error);
-
-            for (ustore_size_t idx = 0; idx < keys.size(); ++idx) {
-                ustore_size_t pre_idx = idx;
-                ustore_size_t size = 0;
-
-                do {
-                    size += lengths[idx];
-                    ++idx;
-                } while (size < c.max_batch_size && idx < keys.size());
-
-                ustore_docs_read_t docs_read {
-                    .db = c.db,
-                    .error = c.error,
-                    .arena = c.arena,
-                    .options = ustore_option_dont_discard_memory_k,
-                    .tasks_count = idx - pre_idx,
-                    .collections = &c.collection,
-                    .keys = keys.begin() + pre_idx,
-                    .keys_stride = sizeof(ustore_key_t),
-                    .offsets = &offsets,
-                    .values = &values.first,
-                };
-                ustore_docs_read(&docs_read);
-                return_if_error_m(c.error);
-                values.second = offsets[idx - pre_idx - 1] + lengths[idx - 1];
-
-                if (pcn == parquet_k)
-                    write_in_parquet(c, arena, os, keys, tape, fields, counts, values);
-                else if (pcn == csv_k)
-                    write_in_csv(c,
-                                 arena,
-                                 docs_vec,
-                                 keys_vec,
-                                 keys,
-                                 int_builder,
-                                 string_builder,
-                                 tape,
-                                 fields,
-                                 counts,
-                                 values,
-                                 idx - pre_idx);
-                else
-                    write_in_ndjson(c, arena, keys, tape, fields, counts, values, handle);
-                return_if_error_m(c.error);
-            }
-            status = stream.seek_to_next_batch();
-            return_error_if_m(status, c.error, 0, "Invalid batch");
-        }
+        auto schema = docs_export_schema();
+        export_file_t file;
+        file.open(c.paths_extension, pcn, schema, c.error);
+        return_if_error_m(c.error);
 
-        if (pcn == csv_k)
-            end_csv(c, string_builder, int_builder);
-        else if (pcn == ndjson_k)
-            return_error_if_m(end_ndjson(handle) == 0, c.error, 0, "Failed to close decriptor");
+        auto format = [&](auto const& keys, ustore_arena_t* range_arena, auto& emit, ustore_error_t* error) {
+            export_docs_range(c, pcn, schema, fields, counts, tape, keys, range_arena, emit, error);
+        };
+        export_in_parallel(c, file, format);
     }
     catch (std::exception const& ex) {
         handle_exception(ex.what());
@@ -1412,10 +1741,12 @@ void ustore_docs_export(ustore_docs_export_t* c_ptr) {
 
 #pragma region - Graph
 
+template <typename upsert_at>
 void parse_arrow_table_graph(ustore_graph_import_t& c,
                              ustore_size_t task_count,
                              std::shared_ptr<arrow::Table> const& table,
-                             linked_memory_lock_t& arena) {
+                             linked_memory_lock_t& arena,
+                             upsert_at&& upsert) {
 
     auto sources = table->GetColumnByName(c.source_id_field);
     return_error_if_m(sources, c.error, 0, "The source field does not exist");
@@ -1446,17 +1777,21 @@ void parse_arrow_table_graph(ustore_graph_import_t& c,
             vertices_edges[idx] = edge;
             ++idx;
             if (idx == task_count) {
-                upsert_graph(c, vertices_edges, idx);
+                upsert(vertices_edges, idx);
                 return_if_error_m(c.error);
                 idx = 0;
             }
         }
     }
     if (idx != 0)
-        upsert_graph(c, vertices_edges, idx);
+        upsert(vertices_edges, idx);
 }
 
-void import_ndjson_graph(ustore_graph_import_t& c, ustore_size_t task_count, linked_memory_lock_t& arena) {
+template <typename upsert_at>
+void import_ndjson_graph(ustore_graph_import_t& c,
+                         ustore_size_t task_count,
+                         linked_memory_lock_t& arena,
+                         upsert_at&& upsert) {
 
     auto edges = arena.alloc<edge_t>(task_count, c.error);
     return_if_error_m(c.error);
@@ -1490,13 +1825,13 @@ void import_ndjson_graph(ustore_graph_import_t& c, ustore_size_t task_count, lin
         edges[idx] = edge_t {get_data(data, c.source_id_field), get_data(data, c.target_id_field), edge};
         ++idx;
         if (idx == task_count) {
-            upsert_graph(c, edges, idx);
+            upsert(edges, idx);
             return_if_error_m(c.error);
             idx = 0;
         }
     }
     if (idx != 0)
-        upsert_graph(c, edges, idx);
+        upsert(edges, idx);
     return_if_error_m(c.error);
 
     res = munmap((void*)mapped_content.data(), mapped_content.size());
@@ -1505,169 +1840,343 @@ void import_ndjson_graph(ustore_graph_import_t& c, ustore_size_t task_count, lin
     return_error_if_m(res == 0, c.error, 0, "Failed to close decriptor");
 }
 
-void make_parquet_graph(ustore_graph_export_t& c, parquet::StreamWriter& os) {
-    parquet::schema::NodeVector fields;
-    fields.push_back(parquet::schema::PrimitiveNode::Make( //
-        c.source_id_field,
-        parquet::Repetition::REQUIRED,
-        parquet::Type::INT64,
-        parquet::ConvertedType::INT_64));
+/**
+ * @brief Exported edges are rows of two or three columns, named after the requested fields.
+ */
+std::shared_ptr<arrow::Schema> graph_export_schema(ustore_graph_export_t const& c) {
+    arrow::FieldVector fields;
+    fields.push_back(arrow::field(c.source_id_field, arrow::int64(), false));
+    fields.push_back(arrow::field(c.target_id_field, arrow::int64(), false));
+    if (c.edge_id_field)
+        fields.push_back(arrow::field(c.edge_id_field, arrow::int64(), false));
+    return arrow::schema(fields);
+}
 
-    fields.push_back(parquet::schema::PrimitiveNode::Make( //
-        c.target_id_field,
-        parquet::Repetition::REQUIRED,
-        parquet::Type::INT64,
-        parquet::ConvertedType::INT_64));
+template <typename emit_at>
+void export_graph_range( //
+    ustore_graph_export_t const& c,
+    ext_t format,
+    std::shared_ptr<arrow::Schema> const& schema,
+    std::vector<ustore_key_t> const& vertices,
+    ustore_arena_t* arena,
+    emit_at&& emit,
+    ustore_error_t* error) {
+
+    ustore_vertex_degree_t* degrees = nullptr;
+    ustore_key_t* ids_in_edges = nullptr;
+    ustore_vertex_role_t const role = ustore_vertex_source_k;
+    ustore_graph_find_edges_t graph_find {
+        .db = c.db,
+        .error = error,
+        .arena = arena,
+        .options = ustore_options_default_k,
+        .tasks_count = vertices.size(),
+        .collections = &c.collection,
+        .vertices = vertices.data(),
+        .vertices_stride = sizeof(ustore_key_t),
+        .roles = &role,
+        .degrees_per_vertex = &degrees,
+        .edges_per_vertex = &ids_in_edges,
+    };
+    ustore_graph_find_edges(&graph_find);
+    return_if_error_m(error);
 
-    if (c.edge_id_field)
-        fields.push_back(parquet::schema::PrimitiveNode::Make( //
-            c.edge_id_field,
-            parquet::Repetition::REQUIRED,
-            parquet::Type::INT64,
-            parquet::ConvertedType::INT_64));
+    ustore_size_t edges_count =
+        std::transform_reduce(degrees, degrees + vertices.size(), 0ul, std::plus {}, [](ustore_vertex_degree_t d) {
+            return d != ustore_vertex_degree_missing_k ? d : 0;
+        });
+    ustore_size_t const max_edges_per_batch =
+        std::max<ustore_size_t>(1, c.max_batch_size / (sizeof(ustore_key_t) * vertices_edge_k));
+
+    for (ustore_size_t first_edge = 0; first_edge < edges_count; first_edge += max_edges_per_batch) {
+        ustore_size_t const batch_edges = std::min(max_edges_per_batch, edges_count - first_edge);
+        ustore_key_t const* data = ids_in_edges + first_edge * vertices_edge_k;
+
+        export_batch_t batch;
+        batch.count = batch_edges;
+        if (format == ndjson_k) {
+            for (ustore_size_t idx = 0; idx != batch_edges; ++idx, data += vertices_edge_k) {
+                if (c.edge_id_field)
+                    fmt::format_to( //
+                        std::back_inserter(batch.text),
+                        "{{\"{}\":{},\"{}\":{},\"{}\":{}}}\n",
+                        c.source_id_field,
+                        data[0],
+                        c.target_id_field,
+                        data[1],
+                        c.edge_id_field,
+                        data[2]);
+                else
+                    fmt::format_to( //
+                        std::back_inserter(batch.text),
+                        "{{\"{}\":{},\"{}\":{}}}\n",
+                        c.source_id_field,
+                        data[0],
+                        c.target_id_field,
+                        data[1]);
+            }
+        }
+        else {
+            std::vector<array_t> columns(schema->num_fields());
+            for (ustore_size_t column_idx = 0; column_idx != columns.size(); ++column_idx) {
+                int_builder_t builder;
+                return_error_if_m(builder.Reserve(batch_edges).ok(), error, 0, "Can't resize builder");
+                for (ustore_size_t idx = 0; idx != batch_edges; ++idx)
+                    builder.UnsafeAppend(data[idx * vertices_edge_k + column_idx]);
+                return_error_if_m(builder.Finish(&columns[column_idx]).ok(), error, 0, "Can't finish array");
+            }
+            batch.record_batch = arrow::RecordBatch::Make(schema, batch_edges, std::move(columns));
+        }
 
-    std::shared_ptr<parquet::schema::GroupNode> schema = std::static_pointer_cast<parquet::schema::GroupNode>(
-        parquet::schema::GroupNode::Make("schema", parquet::Repetition::REQUIRED, fields));
+        if (!emit(std::move(batch)))
+            return;
+    }
+}
 
-    auto maybe_outfile =
-        arrow::io::FileOutputStream::Open(fmt::format("{}{}", generate_file_name(), c.paths_extension));
-    return_error_if_m(maybe_outfile.ok(), c.error, 0, "Can't open file");
-    auto outfile = *maybe_outfile;
+#pragma region - Bulk Graph Import
 
-    parquet::WriterProperties::Builder builder;
-    builder.memory_pool(arrow::default_memory_pool());
-    builder.write_batch_size(c.max_batch_size / vertices_edge_k);
+/**
+ * @brief One half of an imported edge, as seen from one of its vertices.
+ * Ordered by vertex, then role, then neighborship, just like the relations within neighborhoods.
+ */
+struct vertex_relation_t {
+    ustore_key_t vertex = 0;
+    ustore_vertex_role_t role = ustore_vertex_role_unknown_k;
+    neighborship_t ship;
 
-    os = parquet::StreamWriter {parquet::ParquetFileWriter::Open(outfile, schema, builder.build())};
-}
+    friend bool operator<(vertex_relation_t const& a, vertex_relation_t const& b) noexcept {
+        return a.vertex != b.vertex ? a.vertex < b.vertex : a.role != b.role ? a.role < b.role : a.ship < b.ship;
+    }
+    friend bool operator==(vertex_relation_t const& a, vertex_relation_t const& b) noexcept {
+        return a.vertex == b.vertex && a.role == b.role && a.ship == b.ship;
+    }
+};
 
-template <typename docs_graph_at>
-int make_ndjson(docs_graph_at& docs_graph) {
-    return open(fmt::format("{}{}", generate_file_name(), docs_graph.paths_extension).data(),
-                O_CREAT | O_WRONLY,
-                S_IRUSR | S_IWUSR);
-}
+/**
+ * @brief External sort of the relations of imported edges, within a memory budget.
+ * Once the buffer is full, it is sorted, deduplicated and spilled into an anonymous
+ * temporary file. At the end, those runs are merged, visiting every relation once.
+ */
+class relations_sorter_t {
+    struct file_closer_t {
+        void operator()(std::FILE* file) const noexcept { std::fclose(file); }
+    };
+    using file_t = std::unique_ptr<std::FILE, file_closer_t>;
+
+    struct run_cursor_t {
+        std::FILE* file = nullptr;
+        std::vector<vertex_relation_t> chunk;
+        std::size_t position = 0;
+
+        bool next(std::size_t chunk_capacity) noexcept(false) {
+            if (++position < chunk.size())
+                return true;
+            chunk.resize(chunk_capacity);
+            chunk.resize(std::fread(chunk.data(), sizeof(vertex_relation_t), chunk_capacity, file));
+            position = 0;
+            return !chunk.empty();
+        }
+        vertex_relation_t const& current() const noexcept { return chunk[position]; }
+    };
 
-void write_in_file_graph( //
-    ustore_graph_export_t& c,
-    keys_length_t const& ids,
-    int_builder_t& sources_builder,
-    int_builder_t& targets_builder,
-    int_builder_t& edges_builder,
-    ptr_range_gt<ustore_key_t>& sources,
-    ptr_range_gt<ustore_key_t>& targets,
-    ptr_range_gt<ustore_key_t>& edges,
-    parquet::StreamWriter& os,
-    int handle,
-    ext_t pcn) {
-
-    ustore_size_t csv_idx = 0;
-    ustore_key_t* data = nullptr;
+    std::size_t capacity_ = 0;
+    std::vector<vertex_relation_t> buffer_;
+    std::vector<file_t> runs_;
 
-    arrow::Status status;
-    status = sources_builder.Resize(sources_builder.capacity() + (ids.second / vertices_edge_k));
-    return_error_if_m(status.ok(), c.error, 0, "Can't resize builder");
-    status = targets_builder.Resize(targets_builder.capacity() + (ids.second / vertices_edge_k));
-    return_error_if_m(status.ok(), c.error, 0, "Can't resize builder");
-    status = edges_builder.Resize(edges_builder.capacity() + (ids.second / vertices_edge_k));
-    return_error_if_m(status.ok(), c.error, 0, "Can't resize builder");
-
-    if (!c.edge_id_field) {
-        data = ids.first;
-        for (ustore_size_t idx = 0; idx < ids.second; idx += 3, ++csv_idx) {
-            if (pcn == parquet_k)
-                os << data[idx] << data[idx + 1] << parquet::EndRow;
-            else if (pcn == csv_k) {
-                sources[csv_idx] = data[idx];
-                targets[csv_idx] = data[idx + 1];
-            }
-            else {
-                auto str = fmt::format( //
-                    "{{\"{}\":{},\"{}\":{}}}\n",
-                    c.source_id_field,
-                    data[idx],
-                    c.target_id_field,
-                    data[idx + 1]);
-                write(handle, str.data(), str.size());
+    void sort_buffer() noexcept(false) {
+        std::sort(buffer_.begin(), buffer_.end());
+        buffer_.erase(std::unique(buffer_.begin(), buffer_.end()), buffer_.end());
+    }
+
+    void spill(ustore_error_t* error) noexcept(false) {
+        sort_buffer();
+        file_t file {std::tmpfile()};
+        return_error_if_m(file, error, 0, "Can't create a temporary file");
+        auto written = std::fwrite(buffer_.data(), sizeof(vertex_relation_t), buffer_.size(), file.get());
+        return_error_if_m(written == buffer_.size(), error, 0, "Can't write a temporary file");
+        runs_.push_back(std::move(file));
+        buffer_.clear();
+    }
+
+  public:
+    relations_sorter_t(ustore_size_t memory_limit) noexcept
+        : capacity_(std::max<std::size_t>(memory_limit / sizeof(vertex_relation_t), 2)) {}
+
+    std::size_t runs_count() const noexcept { return runs_.size(); }
+
+    void append(edges_t const& edges, ustore_size_t count, ustore_error_t* error) noexcept(false) {
+        for (ustore_size_t idx = 0; idx != count; ++idx) {
+            edge_t const& edge = edges[idx];
+            return_error_if_m(edge.source_id >= ustore_vertex_id_min_k && edge.target_id >= ustore_vertex_id_min_k,
+                              error,
+                              args_wrong_k,
+                              "Vertex IDs below `ustore_vertex_id_min_k` are reserved");
+            if (buffer_.size() + 2 > capacity_) {
+                spill(error);
+                return_if_error_m(error);
             }
+            buffer_.push_back({edge.source_id, ustore_vertex_source_k, {edge.target_id, edge.id}});
+            buffer_.push_back({edge.target_id, ustore_vertex_target_k, {edge.source_id, edge.id}});
         }
     }
-    else {
-        data = ids.first;
-        for (ustore_size_t idx = 0; idx < ids.second; idx += 3, ++csv_idx) {
-            if (pcn == parquet_k)
-                os << data[idx] << data[idx + 1] << data[idx + 2] << parquet::EndRow;
-            else if (pcn == csv_k) {
-                sources[csv_idx] = data[idx];
-                targets[csv_idx] = data[idx + 1];
-                edges[csv_idx] = data[idx + 2];
-            }
-            else {
-                auto str = fmt::format( //
-                    "{{\"{}\":{},\"{}\":{},\"{}\":{}}}\n",
-                    c.source_id_field,
-                    data[idx],
-                    c.target_id_field,
-                    data[idx + 1],
-                    c.edge_id_field,
-                    data[idx + 2]);
-                write(handle, str.data(), str.size());
+
+    /**
+     * @brief Passes all the relations to the @p callback in sorted order, without repetitions.
+     */
+    template <typename callback_at>
+    void merge(callback_at&& callback, ustore_error_t* error) noexcept(false) {
+        if (runs_.empty()) {
+            sort_buffer();
+            for (auto const& relation : buffer_)
+                callback(relation);
+            return;
+        }
+
+        if (!buffer_.empty()) {
+            spill(error);
+            return_if_error_m(error);
+        }
+        std::vector<vertex_relation_t>().swap(buffer_);
+
+        // The budget is split between the read-ahead buffers of all runs
+        std::size_t const chunk_capacity = std::max<std::size_t>(capacity_ / runs_.size(), 1024);
+        std::vector<run_cursor_t> cursors(runs_.size());
+        auto is_greater = [&](std::size_t a, std::size_t b) {
+            return cursors[b].current() < cursors[a].current();
+        };
+        std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(is_greater)> heap(is_greater);
+        for (std::size_t idx = 0; idx != runs_.size(); ++idx) {
+            std::rewind(runs_[idx].get());
+            cursors[idx].file = runs_[idx].get();
+            cursors[idx].position = 0;
+            if (cursors[idx].next(chunk_capacity))
+                heap.push(idx);
+        }
+
+        std::optional<vertex_relation_t> last;
+        while (!heap.empty() && !*error) {
+            std::size_t idx = heap.top();
+            heap.pop();
+            vertex_relation_t const& relation = cursors[idx].current();
+            if (!last || !(*last == relation)) {
+                callback(relation);
+                last = relation;
             }
+            if (cursors[idx].next(chunk_capacity))
+                heap.push(idx);
+            else
+                return_error_if_m(!std::ferror(cursors[idx].file), error, 0, "Can't read a temporary file");
         }
     }
-    status = sources_builder.AppendValues(sources.begin(), csv_idx);
-    return_error_if_m(status.ok(), c.error, 0, "Can't append sources");
-    status = targets_builder.AppendValues(targets.begin(), csv_idx);
-    return_error_if_m(status.ok(), c.error, 0, "Can't append targets");
-    if (c.edge_id_field) {
-        status = edges_builder.AppendValues(edges.begin(), csv_idx);
-        return_error_if_m(status.ok(), c.error, 0, "Can't append edges");
-    }
-}
+};
 
-void end_csv_graph( //
-    ustore_graph_export_t& c,
-    int_builder_t& sources_builder,
-    int_builder_t& targets_builder,
-    int_builder_t& edges_builder) {
+/**
+ * @brief Assembles complete neighborhoods from sorted relations and writes them in batches
+ * of roughly `max_batch_size` bytes. Large neighborhoods are compressed, like `ustore_graph_upsert_edges`
+ * does, while the supernodes aren't split into chunks, until they are updated.
+ */
+class neighborhoods_writer_t {
+    ustore_graph_import_t& c_;
+    std::vector<ustore_key_t> keys_;
+    std::vector<ustore_length_t> offsets_;
+    std::vector<ustore_length_t> lengths_;
+    std::vector<byte_t> contents_;
+
+    ustore_key_t vertex_ = 0;
+    ustore_vertex_degree_t degrees_[2] {};
+    std::vector<neighborship_t> ships_;
+    std::vector<byte_t> compressed_;
+
+    void finish_vertex() noexcept(false) {
+        std::size_t const relations = ships_.size();
+        std::size_t const plain_length = sizeof(degrees_) + relations * sizeof(neighborship_t);
+        std::size_t const offset = contents_.size();
+
+        std::size_t compressed_length = plain_length;
+        if (relations >= compressed_degrees_min_k) {
+            compressed_.resize(compressed_neighborhood_limit(relations));
+            compressed_length = compress_neighborhood(degrees_, ships_.data(), compressed_.data());
+        }
+        if (compressed_length < plain_length)
+            contents_.insert(contents_.end(), compressed_.begin(), compressed_.begin() + compressed_length);
+        else {
+            contents_.resize(offset + plain_length);
+            std::memcpy(contents_.data() + offset, degrees_, sizeof(degrees_));
+            auto ships = contents_.data() + offset + sizeof(degrees_);
+            std::memcpy(ships, ships_.data(), relations * sizeof(neighborship_t));
+        }
 
-    array_t sources_array;
-    array_t targets_array;
-    array_t edges_array;
+        keys_.push_back(vertex_);
+        offsets_.push_back(static_cast<ustore_length_t>(offset));
+        lengths_.push_back(static_cast<ustore_length_t>(contents_.size() - offset));
+        ships_.clear();
+        degrees_[0] = degrees_[1] = 0;
+    }
 
-    auto status = sources_builder.Finish(&sources_array);
-    return_error_if_m(status.ok(), c.error, 0, "Can't finish array(sources)");
-    status = targets_builder.Finish(&targets_array);
-    return_error_if_m(status.ok(), c.error, 0, "Can't finish array(targets)");
-    if (c.edge_id_field) {
-        status = edges_builder.Finish(&edges_array);
-        return_error_if_m(status.ok(), c.error, 0, "Can't finish array(edges)");
+    void flush() noexcept {
+        if (keys_.empty())
+            return;
+        auto values = reinterpret_cast<ustore_bytes_cptr_t>(contents_.data());
+        ustore_write_t write {
+            .db = c_.db,
+            .error = c_.error,
+            .arena = c_.arena,
+            .options = ustore_options_t(ustore_option_dont_discard_memory_k | ustore_option_write_bulk_k),
+            .tasks_count = keys_.size(),
+            .collections = &c_.collection,
+            .keys = keys_.data(),
+            .keys_stride = sizeof(ustore_key_t),
+            .offsets = offsets_.data(),
+            .offsets_stride = sizeof(ustore_length_t),
+            .lengths = lengths_.data(),
+            .lengths_stride = sizeof(ustore_length_t),
+            .values = &values,
+        };
+        ustore_write(&write);
+        keys_.clear();
+        offsets_.clear();
+        lengths_.clear();
+        contents_.clear();
     }
 
-    arrow::FieldVector fields;
-    fields.push_back(arrow::field(c.source_id_field, arrow::int64()));
-    fields.push_back(arrow::field(c.target_id_field, arrow::int64()));
-    if (c.edge_id_field)
-        fields.push_back(arrow::field(c.edge_id_field, arrow::int64()));
+  public:
+    neighborhoods_writer_t(ustore_graph_import_t& c) noexcept : c_(c) {}
 
-    std::shared_ptr<arrow::Schema> schema = std::make_shared<arrow::Schema>(fields);
-    std::shared_ptr<arrow::Table> table = nullptr;
+    void append(vertex_relation_t const& relation) noexcept(false) {
+        if (*c_.error)
+            return;
+        if (ships_.size() && relation.vertex != vertex_) {
+            finish_vertex();
+            if (contents_.size() >= c_.max_batch_size)
+                flush();
+        }
+        vertex_ = relation.vertex;
+        ++degrees_[relation.role == ustore_vertex_target_k];
+        ships_.push_back(relation.ship);
+    }
 
-    if (c.edge_id_field)
-        table = arrow::Table::Make(schema, {sources_array, targets_array, edges_array});
-    else
-        table = arrow::Table::Make(schema, {sources_array, targets_array});
-    return_error_if_m(table, c.error, 0, "Can't make schema");
-
-    auto maybe_outstream =
-        arrow::io::FileOutputStream::Open(fmt::format("{}{}", generate_file_name(), c.paths_extension));
-    return_error_if_m(maybe_outstream.ok(), c.error, 0, "Can't open file");
-    std::shared_ptr<arrow::io::FileOutputStream> outstream = *maybe_outstream;
-
-    status = arrow::csv::WriteCSV(*table, arrow::csv::WriteOptions::Defaults(), outstream.get());
-    return_error_if_m(status.ok(), c.error, 0, "Can't write in file");
+    void close() noexcept(false) {
+        if (*c_.error)
+            return;
+        if (ships_.size())
+            finish_vertex();
+        flush();
+    }
+};
+
+/**
+ * @brief Writes every neighborhood once, instead of updating them in every batch of edges.
+ * Only valid for collections that were empty before the import.
+ */
+void write_sorted_neighborhoods(ustore_graph_import_t& c, relations_sorter_t& sorter) {
+    neighborhoods_writer_t writer(c);
+    sorter.merge([&](vertex_relation_t const& relation) { writer.append(relation); }, c.error);
+    return_if_error_m(c.error);
+    writer.close();
 }
 
+#pragma endregion - Bulk Graph Import
+
 #pragma region - Main Functions(Graph)
 
 void ustore_graph_import(ustore_graph_import_t* c_ptr) {
@@ -1683,6 +2192,11 @@ void ustore_graph_import(ustore_graph_import_t* c_ptr) {
     if (!c.arena)
         c.arena = arena_t(c.db).member_ptr();
 
+    // Empty collections have no neighborhoods to merge with, so we can build them from scratch
+    bool const is_empty = is_empty_collection(c);
+    return_if_error_m(c.error);
+    if (is_empty)
+        c.options = ustore_options_t(c.options | ustore_option_write_bulk_k);
     auto arena = linked_memory(c.arena, c.options, c.error);
     return_if_error_m(c.error);
 
@@ -1696,17 +2210,27 @@ void ustore_graph_import(ustore_graph_import_t* c_ptr) {
     try {
         auto ext = std::filesystem::path(c.paths_pattern).extension();
         ustore_size_t task_count = c.max_batch_size / sizeof(edge_t);
+        relations_sorter_t sorter(c.max_batch_size);
+        auto upsert = [&](edges_t const& edges, ustore_size_t count) {
+            if (is_empty)
+                sorter.append(edges, count, c.error);
+            else
+                upsert_graph(c, edges, count);
+        };
+
         if (ext == ".ndjson")
-            import_ndjson_graph(c, task_count, arena);
+            import_ndjson_graph(c, task_count, arena, upsert);
         else {
             std::shared_ptr<arrow::Table> table;
             if (ext == ".parquet")
                 import_parquet(c, table);
             else if (ext == ".csv")
                 import_csv(c, table);
-            parse_arrow_table_graph(c, task_count, table, arena);
-            return_if_error_m(c.error);
+            parse_arrow_table_graph(c, task_count, table, arena, upsert);
         }
+        return_if_error_m(c.error);
+        if (is_empty)
+            write_sorted_neighborhoods(c, sorter);
     }
     catch (std::exception const& ex) {
         handle_exception(ex.what());
@@ -1724,11 +2248,7 @@ void ustore_graph_export(ustore_graph_export_t* c_ptr) {
     return_error_if_m(c.paths_extension, c.error, uninitialized_state_k, "Paths extension is uninitialized");
     return_error_if_m(c.max_batch_size, c.error, uninitialized_state_k, "Max batch size is 0");
 
-    auto ext = c.paths_extension;
-    ext_t pcn = strcmp_(ext, ".parquet")  ? parquet_k
-                : strcmp_(ext, ".csv")    ? csv_k
-                : strcmp_(ext, ".ndjson") ? ndjson_k
-                                          : unknown_k;
+    ext_t pcn = export_format(c.paths_extension);
     return_error_if_m(!(pcn == unknown_k), c.error, 0, "Not supported format");
 
     if (!c.arena)
@@ -1744,85 +2264,15 @@ void ustore_graph_export(ustore_graph_export_t* c_ptr) {
     };
 
     try {
-        parquet::StreamWriter os;
-        int handle = 0;
-
-        if (pcn == parquet_k)
-            make_parquet_graph(c, os);
-        else if (pcn == ndjson_k)
-            handle = make_ndjson(c);
-
-        ustore_vertex_degree_t* degrees = nullptr;
-        ustore_vertex_role_t const role = ustore_vertex_source_k;
-
-        ustore_size_t count = 0;
-        ustore_size_t batch_ids = 0;
-        ustore_size_t total_ids = 0;
-        ustore_size_t task_count = c.max_batch_size / sizeof(edge_t);
-
-        int_builder_t sources_builder;
-        int_builder_t targets_builder;
-        int_builder_t edges_builder;
-        auto sources = arena.alloc<ustore_key_t>(task_count, c.error);
-        return_if_error_m(c.error);
-        auto targets = arena.alloc<ustore_key_t>(task_count, c.error);
-        return_if_error_m(c.error);
-        ptr_range_gt<ustore_key_t> edges;
-        if (c.edge_id_field)
-            edges = arena.alloc<ustore_key_t>(task_count, c.error);
+        auto schema = graph_export_schema(c);
+        export_file_t file;
+        file.open(c.paths_extension, pcn, schema, c.error);
         return_if_error_m(c.error);
 
-        keys_stream_t stream(c.db, c.collection, task_count, nullptr);
-        auto status = stream.seek_to_first();
-        return_error_if_m(status, c.error, 0, "No batches in stream");
-
-        while (!stream.is_end()) {
-            keys_length_t ids_in_edges {nullptr, 0};
-            count = stream.keys_batch().size();
-
-            ustore_graph_find_edges_t graph_find {
-                .db = c.db,
-                .error = c.error,
-                .arena = c.arena,
-                .options = ustore_option_dont_discard_memory_k,
-                .tasks_count = count,
-                .collections = &c.collection,
-                .vertices = stream.keys_batch().begin(),
-                .vertices_stride = sizeof(ustore_key_t),
-                .roles = &role,
-                .degrees_per_vertex = &degrees,
-                .edges_per_vertex = &ids_in_edges.first,
-            };
-            ustore_graph_find_edges(&graph_find);
-            return_if_error_m(c.error);
-
-            batch_ids =
-                std::transform_reduce(degrees, degrees + count, 0ul, std::plus {}, [](ustore_vertex_degree_t d) {
-                    return d != ustore_vertex_degree_missing_k ? d : 0;
-                });
-            batch_ids *= vertices_edge_k;
-            total_ids += batch_ids;
-            ids_in_edges.second = batch_ids;
-
-            write_in_file_graph( //
-                c,
-                ids_in_edges,
-                sources_builder,
-                targets_builder,
-                edges_builder,
-                sources,
-                targets,
-                edges,
-                os,
-                handle,
-                pcn);
-            status = stream.seek_to_next_batch();
-            return_error_if_m(status, c.error, 0, "Invalid batch");
-        }
-        if (pcn == csv_k)
-            end_csv_graph(c, sources_builder, targets_builder, edges_builder);
-        else if (pcn == ndjson_k)
-            return_error_if_m(end_ndjson(handle) == 0, c.error, 0, "Failed to close decriptor");
+        auto format = [&](auto const& vertices, ustore_arena_t* range_arena, auto& emit, ustore_error_t* error) {
+            export_graph_range(c, pcn, schema, vertices, range_arena, emit, error);
+        };
+        export_in_parallel(c, file, format);
     }
     catch (std::exception const& ex) {
         handle_exception(ex.what());
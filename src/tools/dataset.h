@@ -31,8 +31,20 @@ typedef struct ustore_docs_import_t {
     ustore_str_view_t id_field;           // "_id"
     ustore_collection_t paths_collection; // ustore_collection_main_k
 
+    ustore_size_t parsers_count;   // std::thread::hardware_concurrency()
+    ustore_size_t writers_count;   // std::thread::hardware_concurrency()
+    ustore_size_t* imported_count; // optional, updated before every `callback`
+
 } ustore_docs_import_t;
 
+/**
+ * Files are read in chunks of roughly `max_batch_size` bytes, cut on line or row-group
+ * boundaries, converted into documents by `parsers_count` threads and upserted by
+ * `writers_count` threads, with a few batches in flight per thread. The `callback` is
+ * called from the writers, one at a time, after every batch. As batches are written
+ * in any order, it isn't defined which document is kept, if identifiers repeat.
+ */
+
 void ustore_docs_import(ustore_docs_import_t*);
 
 typedef struct ustore_docs_export_t {
@@ -52,8 +64,19 @@ typedef struct ustore_docs_export_t {
     ustore_str_view_t const* fields; // optional
     ustore_size_t fields_stride;     // optional
 
+    ustore_size_t threads_count;   // std::thread::hardware_concurrency()
+    ustore_size_t* exported_count; // optional, updated before every `callback`
+
 } ustore_docs_export_t;
 
+/**
+ * Writes ".parquet", ".csv", ".ndjson" or ".arrow" files, the last being the Arrow IPC
+ * format, also opened as ".feather". Keys are scanned in ranges, that `threads_count`
+ * threads read and format concurrently, while a single thread writes the batches of up
+ * to `max_batch_size` bytes, calling the `callback` after each. Every batch is a separate
+ * Parquet row group and batches are written in any order.
+ */
+
 void ustore_docs_export(ustore_docs_export_t*);
 
 
@@ -76,6 +99,12 @@ typedef struct ustore_graph_import_t {
 
 } ustore_graph_import_t;
 
+/**
+ * Imports into empty collections sort the relations of all edges externally, in runs
+ * of `max_batch_size` bytes, spilled into temporary files, so that every neighborhood
+ * is written just once, with bulk writes. Other imports upsert the edges in batches.
+ */
+
 void ustore_graph_import(ustore_graph_import_t*);
 
 typedef struct ustore_graph_export_t {
@@ -95,8 +124,16 @@ typedef struct ustore_graph_export_t {
     ustore_str_view_t target_id_field; // "target"
     ustore_str_view_t edge_id_field;   // "edge"
 
+    ustore_size_t threads_count;   // std::thread::hardware_concurrency()
+    ustore_size_t* exported_count; // optional, updated before every `callback`
+
 } ustore_graph_export_t;
 
+/**
+ * Exports the edges of every source vertex, in the same formats and stages,
+ * as `ustore_docs_export`.
+ */
+
 void ustore_graph_export(ustore_graph_export_t*);
 
 #ifdef __cplusplus
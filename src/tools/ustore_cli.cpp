@@ -5,6 +5,12 @@
 
 #include <iostream>            // `std::cout`, `std::cerr`
 #include <regex>               // `std::regex`, `std::regex_token_iterator`
+#include <thread>              // `std::thread`
+#include <atomic>              // `std::atomic`
+#include <mutex>               // `std::mutex`
+#include <chrono>              // `std::chrono::steady_clock`
+#include <numeric>             // `std::iota`
+#include <optional>            // `std::optional`
 
 #include <fmt/format.h>        // `fmt::format`, `fmt::print`
 
@@ -14,6 +20,7 @@
 
 #include "ustore/cpp/db.hpp"   // `database_t`
 #include "dataset.h"           // `import`, `export`
+#include "workload.hpp"        // `latency_histogram_t`, `keys_generator_t`
 
 using namespace unum::ustore;
 using namespace unum;
@@ -113,7 +120,8 @@ void docs_import(database_t& db,
                  std::string const& collection_name,
                  std::string const& input_file,
                  std::string const& id_field,
-                 std::size_t max_batch_size) {
+                 std::size_t max_batch_size,
+                 bool bulk) {
     status_t status;
     arena_t arena(db);
     ustore_collection_t collection = db.find(collection_name);
@@ -122,7 +130,7 @@ void docs_import(database_t& db,
         .db = db,
         .error = status.member_ptr(),
         .arena = arena.member_ptr(),
-        .options = ustore_options_default_k,
+        .options = bulk ? ustore_option_write_bulk_k : ustore_options_default_k,
         .collection = collection,
         .paths_pattern = input_file.c_str(),
         .max_batch_size = max_batch_size,
@@ -162,6 +170,350 @@ void docs_export(database_t& db,
 }
 #pragma endregion - Import / Export
 
+#pragma region - Benchmark
+
+struct bench_args_t {
+    std::string distribution = "uniform";
+    std::size_t keys_count = 1'000'000;
+    std::size_t value_size = 100;
+    std::size_t batch_size = 1;
+    std::size_t scan_length = 100;
+    std::size_t threads_count = 1;
+    std::size_t duration = 10;
+    std::size_t interval = 1;
+    double reads = 50;
+    double writes = 50;
+    double inserts = 0;
+    double scans = 0;
+    double rmws = 0;
+    bool transactional = false;
+    bool load = false;
+};
+
+/**
+ * @brief Measurements of a single client thread, collected by the reporter under the mutex.
+ * Latencies are kept twice: for the current interval and for the whole run.
+ */
+struct alignas(64) bench_thread_stats_t {
+    std::mutex mutex;
+    std::array<latency_histogram_t, operations_k> interval;
+    std::array<latency_histogram_t, operations_k> total;
+    std::array<std::size_t, operations_k> failures {};
+    std::size_t tasks = 0;
+};
+
+class bench_client_t {
+    database_t& db_;
+    bench_args_t const& args_;
+    ustore_collection_t collection_;
+    std::atomic<std::size_t>& next_insert_key_;
+
+    arena_t arena_;
+    status_t status_;
+    std::mt19937_64 generator_;
+    keys_generator_t keys_;
+    std::vector<ustore_key_t> batch_keys_;
+    std::vector<ustore_length_t> scan_limits_;
+    std::vector<char> value_;
+
+    void read(ustore_transaction_t txn) noexcept {
+        ustore_length_t* lengths = nullptr;
+        ustore_byte_t* values = nullptr;
+        ustore_read_t read {
+            .db = db_,
+            .error = status_.member_ptr(),
+            .transaction = txn,
+            .arena = arena_.member_ptr(),
+            .options = ustore_options_default_k,
+            .tasks_count = batch_keys_.size(),
+            .collections = &collection_,
+            .keys = batch_keys_.data(),
+            .keys_stride = sizeof(ustore_key_t),
+            .lengths = &lengths,
+            .values = &values,
+        };
+        ustore_read(&read);
+    }
+
+    void write(ustore_transaction_t txn) noexcept {
+        auto value = reinterpret_cast<ustore_bytes_cptr_t>(value_.data());
+        auto length = static_cast<ustore_length_t>(value_.size());
+        ustore_write_t write {
+            .db = db_,
+            .error = status_.member_ptr(),
+            .transaction = txn,
+            .arena = arena_.member_ptr(),
+            .options = ustore_options_default_k,
+            .tasks_count = batch_keys_.size(),
+            .collections = &collection_,
+            .keys = batch_keys_.data(),
+            .keys_stride = sizeof(ustore_key_t),
+            .lengths = &length,
+            .values = &value,
+        };
+        ustore_write(&write);
+    }
+
+    void scan(ustore_transaction_t txn) noexcept {
+        scan_limits_.assign(batch_keys_.size(), static_cast<ustore_length_t>(args_.scan_length));
+        ustore_length_t* counts = nullptr;
+        ustore_key_t* keys = nullptr;
+        ustore_scan_t scan {
+            .db = db_,
+            .error = status_.member_ptr(),
+            .transaction = txn,
+            .arena = arena_.member_ptr(),
+            .options = ustore_options_default_k,
+            .tasks_count = batch_keys_.size(),
+            .collections = &collection_,
+            .start_keys = batch_keys_.data(),
+            .start_keys_stride = sizeof(ustore_key_t),
+            .count_limits = scan_limits_.data(),
+            .count_limits_stride = sizeof(ustore_length_t),
+            .counts = &counts,
+            .keys = &keys,
+        };
+        ustore_scan(&scan);
+    }
+
+  public:
+    bench_client_t(database_t& db,
+                   bench_args_t const& args,
+                   ustore_collection_t collection,
+                   key_distribution_t distribution,
+                   std::atomic<std::size_t>& next_insert_key,
+                   std::size_t seed)
+        : db_(db), args_(args), collection_(collection), next_insert_key_(next_insert_key), arena_(db),
+          generator_(seed), keys_(distribution, args.keys_count), value_(args.value_size) {
+        std::uniform_int_distribution<int> bytes('a', 'z');
+        for (auto& byte : value_)
+            byte = static_cast<char>(bytes(generator_));
+    }
+
+    void run(operations_mix_t const& mix, bench_thread_stats_t& stats, std::atomic<bool> const& stop) {
+        using steady_clock_t = std::chrono::steady_clock;
+        std::optional<context_t> txn;
+        if (args_.transactional)
+            txn.emplace(db_.transact().throw_or_release());
+
+        while (!stop.load(std::memory_order_relaxed)) {
+            operation_t op = mix(generator_);
+            batch_keys_.resize(args_.batch_size);
+            if (op == operation_t::insert_k) {
+                std::size_t first = next_insert_key_.fetch_add(args_.batch_size, std::memory_order_relaxed);
+                std::iota(batch_keys_.begin(), batch_keys_.end(), static_cast<ustore_key_t>(first));
+                keys_.grow(first + args_.batch_size);
+            }
+            else
+                for (auto& key : batch_keys_)
+                    key = keys_(generator_);
+
+            status_ = status_t {};
+            auto start = steady_clock_t::now();
+            ustore_transaction_t raw_txn = txn ? txn->txn() : nullptr;
+            switch (op) {
+            case operation_t::read_k: read(raw_txn); break;
+            case operation_t::update_k:
+            case operation_t::insert_k: write(raw_txn); break;
+            case operation_t::scan_k: scan(raw_txn); break;
+            case operation_t::read_modify_write_k:
+                read(raw_txn);
+                if (status_)
+                    write(raw_txn);
+                break;
+            }
+            if (txn) {
+                if (status_)
+                    status_ = txn->commit();
+                status_t reset_status = txn->reset();
+                reset_status.throw_unhandled();
+            }
+            auto elapsed = steady_clock_t::now() - start;
+            auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+
+            auto op_idx = static_cast<std::size_t>(op);
+            std::lock_guard<std::mutex> lock(stats.mutex);
+            if (!status_) {
+                ++stats.failures[op_idx];
+                status_.release_error();
+                continue;
+            }
+            stats.interval[op_idx].record(static_cast<std::uint64_t>(nanoseconds));
+            stats.total[op_idx].record(static_cast<std::uint64_t>(nanoseconds));
+            stats.tasks += batch_keys_.size();
+        }
+    }
+};
+
+void bench_print_header() {
+    print(yellow_k,
+          "{:>8} {:>6} {:>12} {:>10} {:>10} {:>10} {:>10} {:>10} {:>8}",
+          "time, s",
+          "op",
+          "ops/s",
+          "mean, us",
+          "p50, us",
+          "p99, us",
+          "p999, us",
+          "max, us",
+          "failed");
+}
+
+void bench_print_row(double seconds,
+                     std::size_t op_idx,
+                     latency_histogram_t const& histogram,
+                     std::size_t failures,
+                     double elapsed) {
+    if (!histogram.count() && !failures)
+        return;
+    auto us = [](std::uint64_t nanoseconds) {
+        return double(nanoseconds) / 1e3;
+    };
+    fmt::print("{:>8.1f} {:>6} {:>12.0f} {:>10.1f} {:>10.1f} {:>10.1f} {:>10.1f} {:>10.1f} {:>8}\n",
+               seconds,
+               operation_names_k[op_idx],
+               double(histogram.count()) / elapsed,
+               histogram.mean() / 1e3,
+               us(histogram.percentile(0.5)),
+               us(histogram.percentile(0.99)),
+               us(histogram.percentile(0.999)),
+               us(histogram.max()),
+               failures);
+}
+
+/**
+ * @brief Fills the first `keys_count` keys in batches, so that reads and updates find them.
+ */
+bool bench_load(database_t& db, bench_args_t const& args, ustore_collection_t collection) {
+    constexpr std::size_t batch_size_k = 4096;
+    status_t status;
+    arena_t arena(db);
+    std::vector<ustore_key_t> keys(batch_size_k);
+    std::vector<char> value(args.value_size, 'v');
+    auto value_ptr = reinterpret_cast<ustore_bytes_cptr_t>(value.data());
+    auto length = static_cast<ustore_length_t>(value.size());
+
+    for (std::size_t first = 0; first < args.keys_count && status; first += batch_size_k) {
+        std::size_t count = std::min(batch_size_k, args.keys_count - first);
+        std::iota(keys.begin(), keys.begin() + count, static_cast<ustore_key_t>(first));
+        ustore_write_t write {
+            .db = db,
+            .error = status.member_ptr(),
+            .arena = arena.member_ptr(),
+            .options = ustore_options_default_k,
+            .tasks_count = count,
+            .collections = &collection,
+            .keys = keys.data(),
+            .keys_stride = sizeof(ustore_key_t),
+            .lengths = &length,
+            .values = &value_ptr,
+        };
+        ustore_write(&write);
+    }
+    if (!status)
+        print(red_k, "Failed to load the dataset: {}", status.message());
+    return static_cast<bool>(status);
+}
+
+/**
+ * @brief Runs a closed-loop workload from `threads_count` clients for `duration` seconds,
+ * printing the throughput and latency percentiles of every operation kind each `interval`.
+ */
+void bench_run(database_t& db, std::string const& collection_name, bench_args_t const& args) {
+    key_distribution_t distribution;
+    if (args.distribution == "uniform")
+        distribution = key_distribution_t::uniform_k;
+    else if (args.distribution == "zipfian")
+        distribution = key_distribution_t::zipfian_k;
+    else if (args.distribution == "latest")
+        distribution = key_distribution_t::latest_k;
+    else {
+        print(red_k, "Unknown key distribution {}", args.distribution);
+        return;
+    }
+    if (!args.batch_size || !args.threads_count || !args.keys_count) {
+        print(red_k, "Batch size, threads count and keys count must be positive");
+        return;
+    }
+
+    ustore_collection_t collection = db.find(collection_name);
+    if (args.load && !bench_load(db, args, collection))
+        return;
+
+    operations_mix_t mix({args.reads, args.writes, args.inserts, args.scans, args.rmws});
+    std::atomic<std::size_t> next_insert_key {args.keys_count};
+    std::atomic<bool> stop {false};
+    std::vector<bench_thread_stats_t> stats(args.threads_count);
+    std::vector<std::string> errors(args.threads_count);
+    std::vector<std::thread> threads;
+    threads.reserve(args.threads_count);
+
+    // Zipfian normalization constants are computed independently by every client
+    for (std::size_t idx = 0; idx != args.threads_count; ++idx)
+        threads.emplace_back([&, idx] {
+            try {
+                bench_client_t client(db, args, collection, distribution, next_insert_key, idx + 1);
+                client.run(mix, stats[idx], stop);
+            }
+            catch (std::exception const& ex) {
+                errors[idx] = ex.what();
+            }
+        });
+
+    using steady_clock_t = std::chrono::steady_clock;
+    auto const start = steady_clock_t::now();
+    auto const interval = std::chrono::seconds(std::max<std::size_t>(args.interval, 1));
+    auto const deadline = start + std::chrono::seconds(args.duration);
+    auto last_report = start;
+    bench_print_header();
+
+    auto collect = [&](bool whole_run) {
+        std::array<latency_histogram_t, operations_k> merged;
+        std::array<std::size_t, operations_k> failures {};
+        for (auto& thread_stats : stats) {
+            std::lock_guard<std::mutex> lock(thread_stats.mutex);
+            for (std::size_t op_idx = 0; op_idx != operations_k; ++op_idx) {
+                merged[op_idx].merge(whole_run ? thread_stats.total[op_idx] : thread_stats.interval[op_idx]);
+                if (whole_run)
+                    failures[op_idx] += thread_stats.failures[op_idx];
+                else
+                    thread_stats.interval[op_idx].clear();
+            }
+        }
+        return std::make_pair(merged, failures);
+    };
+
+    while (steady_clock_t::now() < deadline) {
+        auto next_report = std::min(last_report + interval, deadline);
+        std::this_thread::sleep_until(next_report);
+        auto now = steady_clock_t::now();
+        double seconds = std::chrono::duration<double>(now - start).count();
+        double elapsed = std::chrono::duration<double>(now - last_report).count();
+        auto [merged, failures] = collect(false);
+        for (std::size_t op_idx = 0; op_idx != operations_k; ++op_idx)
+            bench_print_row(seconds, op_idx, merged[op_idx], failures[op_idx], elapsed);
+        last_report = now;
+    }
+
+    stop.store(true, std::memory_order_relaxed);
+    for (auto& thread : threads)
+        thread.join();
+    for (auto const& error : errors)
+        if (!error.empty())
+            print(red_k, "Client failed: {}", error);
+
+    double seconds = std::chrono::duration<double>(steady_clock_t::now() - start).count();
+    std::size_t tasks = 0;
+    for (auto& thread_stats : stats)
+        tasks += thread_stats.tasks;
+    auto [merged, failures] = collect(true);
+    print(green_k, "Summary over {:.1f} seconds, {:.0f} keys/s:", seconds, double(tasks) / seconds);
+    bench_print_header();
+    for (std::size_t op_idx = 0; op_idx != operations_k; ++op_idx)
+        bench_print_row(seconds, op_idx, merged[op_idx], failures[op_idx], seconds);
+}
+#pragma endregion - Benchmark
+
 #pragma region - Interface
 
 // List of CLI arguments
@@ -179,6 +531,9 @@ struct cli_args_t {
     std::string output_ext;
     std::string export_path;
     std::size_t memory_limit;
+    bool bulk = false;
+
+    bench_args_t bench;
 };
 
 // CLI arguments parser
@@ -194,7 +549,8 @@ bool parse_cli_args(int argc, char* argv[], cli_args_t& arg) {
           required("list").set(arg.action, std::string("list")) |
           ((required("import").set(arg.action, std::string("import")) &
             (required("--input") & value("input", arg.input_file)).doc("Input file path") &
-            (required("--id") & value("id field", arg.id_field)).doc("The field which data will use as key(s)")) |
+            (required("--id") & value("id field", arg.id_field)).doc("The field which data will use as key(s)") &
+            option("--bulk").set(arg.bulk).doc("Ingest batches directly, even if the collection isn't empty")) |
            (required("export").set(arg.action, std::string("export")) &
             (required("--output") & value("output", arg.output_ext)).doc("Output file path"))) &
               ((required("--mlimit") & value("memory limit", arg.memory_limit))
@@ -207,8 +563,29 @@ bool parse_cli_args(int argc, char* argv[], cli_args_t& arg) {
                       (required("drop").set(arg.action, std::string("drop")) & value("snapshot id", arg.snap_id)) |
                       (required("list").set(arg.action, std::string("list")))));
 
+    auto& bench_args = arg.bench;
+    auto bench =
+        (option("bench").set(arg.db_object, std::string("bench")) &
+         ((option("--name") & value("collection name", arg.col_name)),
+          (option("--distribution") & value("uniform|zipfian|latest", bench_args.distribution))
+              .doc("Keys distribution"),
+          (option("--keys") & value("count", bench_args.keys_count)).doc("Number of keys to choose from"),
+          (option("--value-size") & value("bytes", bench_args.value_size)).doc("Size of written values"),
+          (option("--reads") & value("weight", bench_args.reads)).doc("Relative frequency of reads"),
+          (option("--writes") & value("weight", bench_args.writes)).doc("Relative frequency of updates"),
+          (option("--inserts") & value("weight", bench_args.inserts)).doc("Relative frequency of inserts of new keys"),
+          (option("--scans") & value("weight", bench_args.scans)).doc("Relative frequency of scans"),
+          (option("--rmw") & value("weight", bench_args.rmws)).doc("Relative frequency of read-modify-writes"),
+          (option("--scan-length") & value("count", bench_args.scan_length)).doc("Number of keys per scan"),
+          (option("--batch") & value("count", bench_args.batch_size)).doc("Number of keys in every operation"),
+          (option("--threads") & value("count", bench_args.threads_count)).doc("Number of concurrent clients"),
+          (option("--duration") & value("seconds", bench_args.duration)).doc("Duration of the benchmark"),
+          (option("--interval") & value("seconds", bench_args.interval)).doc("Interval between reports"),
+          option("--txn").set(b.transactional).doc("Run every operation in a separate transaction"),
+          option("--load").set(b.load).doc("Fill the keys before measuring")));
+
     auto cli = ((required("--url") & value("URL", arg.url)).doc("Server URL"),
-                (collection | snapshot),
+                (collection | snapshot | bench),
                 option("-h", "--help").set(arg.help).doc("Print this help information on this tool and exit"));
 
     if (!parse(argc, argv, cli)) {
@@ -232,7 +609,7 @@ bool execute(cli_args_t& arg, database_t& db) {
         else if (arg.action == "list")
             collection_list(db);
         else if (arg.action == "import")
-            docs_import(db, arg.col_name, arg.input_file, arg.id_field, arg.memory_limit);
+            docs_import(db, arg.col_name, arg.input_file, arg.id_field, arg.memory_limit, arg.bulk);
         else if (arg.action == "export")
             docs_export(db, arg.col_name, arg.output_ext, arg.memory_limit);
         else
@@ -252,6 +629,10 @@ bool execute(cli_args_t& arg, database_t& db) {
             print(red_k, "Invalid snapshot action {}", arg.action);
         return true;
     }
+    else if (arg.db_object == "bench") {
+        bench_run(db, arg.col_name, arg.bench);
+        return true;
+    }
 
     return false;
 }
@@ -322,6 +703,9 @@ bool parse_snapshot_args(cli_args_t& cli_arg, std::vector<std::string>& cmd_line
 }
 
 bool parse_import_args(cli_args_t& cli_arg, std::vector<std::string>& cmd_line) {
+    cli_arg.bulk = cmd_line.back() == "--bulk";
+    if (cli_arg.bulk)
+        cmd_line.pop_back();
     if (cmd_line.size() != 9 && cmd_line.size() != 7) {
         print(red_k, "Invalid input");
         return false;
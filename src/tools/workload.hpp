@@ -0,0 +1,299 @@
+/**
+ * @file workload.hpp
+ * @author Ashot Vardanian
+ *
+ * @brief Synthetic workloads for load testing: key distributions, operation mixes,
+ * transactional write sets and high dynamic range latency histograms,
+ * shared by the CLI and the benchmarks.
+ *
+ * Histograms are log-linear, like the ones in "helpers/stats.hpp", but with 128 buckets
+ * per power of two, bounding the relative error of percentiles to 1%. They are plain
+ * arrays of counters, so every thread records into its own, and they are merged later.
+ */
+#pragma once
+#include <array>     // `std::array`
+#include <cmath>     // `std::pow`
+#include <cstdint>   // `std::uint64_t`
+#include <random>    // `std::mt19937_64`
+#include <vector>    // `std::vector`
+#include <algorithm> // `std::max`
+
+#include "ustore/db.h"
+
+namespace unum::ustore {
+
+class latency_histogram_t {
+
+    static constexpr std::size_t sub_buckets_log2_k = 7;
+    static constexpr std::size_t sub_buckets_k = 1ul << sub_buckets_log2_k;
+    static constexpr std::size_t buckets_k = (64 - sub_buckets_log2_k + 1) * sub_buckets_k;
+
+    std::array<std::uint64_t, buckets_k> counts_ {};
+    std::uint64_t total_ = 0;
+    std::uint64_t max_ = 0;
+    std::uint64_t sum_ = 0;
+
+    static std::size_t bucket(std::uint64_t value) noexcept {
+        if (value < sub_buckets_k)
+            return value;
+        std::size_t msb = 63 - __builtin_clzll(value);
+        std::size_t sub = (value >> (msb - sub_buckets_log2_k)) & (sub_buckets_k - 1);
+        return (msb - sub_buckets_log2_k + 1) * sub_buckets_k + sub;
+    }
+
+    static std::uint64_t bucket_min(std::size_t idx) noexcept {
+        if (idx < sub_buckets_k)
+            return idx;
+        std::size_t msb = idx / sub_buckets_k + sub_buckets_log2_k - 1;
+        std::uint64_t sub = idx % sub_buckets_k;
+        return (sub_buckets_k + sub) << (msb - sub_buckets_log2_k);
+    }
+
+  public:
+    void record(std::uint64_t value, std::uint64_t count = 1) noexcept {
+        counts_[bucket(value)] += count;
+        total_ += count;
+        sum_ += value * count;
+        max_ = std::max(max_, value);
+    }
+
+    /**
+     * @brief Records the @p value, along with the samples that a stalled closed-loop
+     * client would have missed, if the @p interval between requests was expected.
+     * That's how HdrHistogram corrects for the "coordinated omission".
+     */
+    void record_corrected(std::uint64_t value, std::uint64_t interval) noexcept {
+        record(value);
+        if (!interval)
+            return;
+        for (std::uint64_t missed = value > interval ? value - interval : 0; missed >= interval; missed -= interval)
+            record(missed);
+    }
+
+    void merge(latency_histogram_t const& other) noexcept {
+        for (std::size_t idx = 0; idx != buckets_k; ++idx)
+            counts_[idx] += other.counts_[idx];
+        total_ += other.total_;
+        sum_ += other.sum_;
+        max_ = std::max(max_, other.max_);
+    }
+
+    void clear() noexcept { *this = latency_histogram_t {}; }
+
+    std::uint64_t count() const noexcept { return total_; }
+    std::uint64_t max() const noexcept { return max_; }
+    double mean() const noexcept { return total_ ? double(sum_) / double(total_) : 0.0; }
+
+    /**
+     * @brief Returns the smallest value, that isn't exceeded by the given @p fraction of samples.
+     */
+    std::uint64_t percentile(double fraction) const noexcept {
+        if (!total_)
+            return 0;
+        auto wanted = static_cast<std::uint64_t>(std::ceil(fraction * double(total_)));
+        wanted = std::max<std::uint64_t>(wanted, 1);
+        std::uint64_t seen = 0;
+        for (std::size_t idx = 0; idx != buckets_k; ++idx)
+            if ((seen += counts_[idx]) >= wanted)
+                return idx + 1 < buckets_k ? std::min(bucket_min(idx + 1) - 1, max_) : max_;
+        return max_;
+    }
+};
+
+/**
+ * @brief Zipfian distribution over `[0, count)`, as in "Quickly Generating Billion-Record
+ * Synthetic Databases" by Gray et al. and the YCSB. The most popular items are then
+ * scattered over the key space with a hash, so they don't form a contiguous range.
+ */
+class zipfian_distribution_t {
+    std::uint64_t count_ = 1;
+    double theta_ = 0.99;
+    double alpha_ = 0;
+    double zeta_n_ = 0;
+    double eta_ = 0;
+    double half_pow_theta_ = 0;
+
+    static double zeta(std::uint64_t count, double theta) noexcept {
+        double sum = 0;
+        for (std::uint64_t idx = 1; idx <= count; ++idx)
+            sum += 1.0 / std::pow(double(idx), theta);
+        return sum;
+    }
+
+    static std::uint64_t scramble(std::uint64_t value) noexcept {
+        // The finalizer of MurmurHash3
+        value ^= value >> 33;
+        value *= 0xff51afd7ed558ccdull;
+        value ^= value >> 33;
+        value *= 0xc4ceb9fe1a85ec53ull;
+        value ^= value >> 33;
+        return value;
+    }
+
+  public:
+    zipfian_distribution_t(std::uint64_t count = 1, double theta = 0.99) noexcept
+        : count_(std::max<std::uint64_t>(count, 1)), theta_(theta) {
+        double zeta_2 = zeta(2, theta_);
+        zeta_n_ = zeta(count_, theta_);
+        alpha_ = 1.0 / (1.0 - theta_);
+        eta_ = (1.0 - std::pow(2.0 / double(count_), 1.0 - theta_)) / (1.0 - zeta_2 / zeta_n_);
+        half_pow_theta_ = 1.0 + std::pow(0.5, theta_);
+    }
+
+    /**
+     * @brief Samples the popularity rank, where zero is the most popular item.
+     */
+    template <typename generator_at>
+    std::uint64_t rank(generator_at& generator) const noexcept {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(generator);
+        double uz = u * zeta_n_;
+        if (uz < 1.0)
+            return 0;
+        if (uz < half_pow_theta_)
+            return 1;
+        auto rank = static_cast<std::uint64_t>(double(count_) * std::pow(eta_ * u - eta_ + 1.0, alpha_));
+        return std::min(rank, count_ - 1);
+    }
+
+    template <typename generator_at>
+    std::uint64_t operator()(generator_at& generator) const noexcept {
+        return scramble(rank(generator)) % count_;
+    }
+};
+
+enum class key_distribution_t {
+    uniform_k,
+    zipfian_k,
+    latest_k,
+};
+
+/**
+ * @brief Samples keys from `[0, count)`. The "latest" distribution is Zipfian too,
+ * but skewed towards the most recently inserted keys, as in the YCSB workload D.
+ */
+class keys_generator_t {
+    key_distribution_t distribution_;
+    std::uint64_t count_;
+    zipfian_distribution_t zipfian_;
+
+  public:
+    keys_generator_t(key_distribution_t distribution, std::uint64_t count) noexcept
+        : distribution_(distribution), count_(std::max<std::uint64_t>(count, 1)), zipfian_(count_) {}
+
+    std::uint64_t count() const noexcept { return count_; }
+    void grow(std::uint64_t count) noexcept { count_ = std::max(count_, count); }
+
+    template <typename generator_at>
+    ustore_key_t operator()(generator_at& generator) const noexcept {
+        switch (distribution_) {
+        case key_distribution_t::uniform_k: {
+            std::uniform_int_distribution<std::uint64_t> uniform(0, count_ - 1);
+            return static_cast<ustore_key_t>(uniform(generator));
+        }
+        case key_distribution_t::zipfian_k: return static_cast<ustore_key_t>(zipfian_(generator) % count_);
+        case key_distribution_t::latest_k: {
+            // The normalization constant isn't recomputed on inserts, as that is too expensive,
+            // so the ranks are drawn from the initial key space and counted from the newest key
+            std::uint64_t offset = zipfian_.rank(generator) % count_;
+            return static_cast<ustore_key_t>(count_ - 1 - offset);
+        }
+        }
+        return 0;
+    }
+};
+
+enum class operation_t {
+    read_k,
+    update_k,
+    insert_k,
+    scan_k,
+    read_modify_write_k,
+};
+
+constexpr std::size_t operations_k = 5;
+constexpr char const* operation_names_k[operations_k] = {"read", "update", "insert", "scan", "rmw"};
+
+/**
+ * @brief Picks the next operation of a mix, given the relative weights of every kind.
+ */
+class operations_mix_t {
+    std::array<double, operations_k> cumulative_ {};
+
+  public:
+    operations_mix_t(std::array<double, operations_k> const& weights = {1, 0, 0, 0, 0}) noexcept {
+        double total = 0;
+        for (std::size_t idx = 0; idx != operations_k; ++idx)
+            cumulative_[idx] = total += std::max(weights[idx], 0.0);
+        if (total > 0)
+            for (auto& bound : cumulative_)
+                bound /= total;
+    }
+
+    template <typename generator_at>
+    operation_t operator()(generator_at& generator) const noexcept {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(generator);
+        for (std::size_t idx = 0; idx != operations_k; ++idx)
+            if (u < cumulative_[idx])
+                return static_cast<operation_t>(idx);
+        return operation_t::read_k;
+    }
+};
+
+enum class transaction_shape_t {
+    batches_k,
+    scattered_k,
+};
+
+/**
+ * @brief Generates the write sets of transactions, shaped like the ones of the stress tests:
+ * - "batches": a batch of consecutive keys, all assigned the same value or all erased,
+ *   as in "tests/stress_atomicity.cpp". The batch itself is drawn from the distribution.
+ * - "scattered": independent assignments and erasures of keys, drawn from the distribution,
+ *   as in "tests/stress_linearizability.cpp".
+ * Skewing the distribution concentrates the conflicts between concurrent transactions.
+ */
+class transaction_generator_t {
+    transaction_shape_t shape_;
+    keys_generator_t keys_; // Draws batch indexes for `batches_k` and keys for `scattered_k`
+    std::size_t batch_size_;
+    double erase_probability_;
+
+  public:
+    struct write_t {
+        ustore_key_t key;
+        bool erase;
+    };
+
+    transaction_generator_t(transaction_shape_t shape,
+                            key_distribution_t distribution,
+                            std::uint64_t keys_count,
+                            std::size_t batch_size,
+                            double erase_probability = 0) noexcept
+        : shape_(shape),
+          keys_(distribution,
+                shape == transaction_shape_t::batches_k ? keys_count / std::max<std::size_t>(batch_size, 1)
+                                                        : keys_count),
+          batch_size_(std::max<std::size_t>(batch_size, 1)), erase_probability_(erase_probability) {}
+
+    std::size_t batch_size() const noexcept { return batch_size_; }
+
+    /**
+     * @brief Overwrites @p writes with `batch_size()` entries of the next transaction.
+     */
+    template <typename generator_at>
+    void operator()(generator_at& generator, std::vector<write_t>& writes) const {
+        std::bernoulli_distribution erasing(erase_probability_);
+        writes.resize(batch_size_);
+        if (shape_ == transaction_shape_t::batches_k) {
+            auto first = static_cast<ustore_key_t>(keys_(generator) * batch_size_);
+            bool erase = erasing(generator);
+            for (std::size_t idx = 0; idx != batch_size_; ++idx)
+                writes[idx] = {static_cast<ustore_key_t>(first + idx), erase};
+        }
+        else
+            for (auto& write : writes)
+                write = {keys_(generator), erasing(generator)};
+    }
+};
+
+} // namespace unum::ustore
@@ -0,0 +1,123 @@
+/**
+ * @file test_coroutines.cpp
+ * @author Ashot Vardanian
+ *
+ * @brief Tests for the C++20 coroutines SDK, built separately from the C++17 unit tests.
+ */
+
+#include <string>
+#include <filesystem>
+
+#include <gtest/gtest.h>
+#include <fmt/format.h>
+
+#include "ustore/ustore.hpp"
+
+#if !defined(USTORE_CPP_COROUTINES)
+#error "This test must be compiled with C++20 coroutines support"
+#endif
+
+using namespace unum::ustore;
+using namespace unum;
+
+static char const* path() {
+    char* path = std::getenv("USTORE_TEST_PATH");
+    if (path)
+        return std::strlen(path) ? path : nullptr;
+
+#if defined(USTORE_TEST_PATH)
+    return USTORE_TEST_PATH;
+#else
+    return nullptr;
+#endif
+}
+
+static std::string config() {
+    auto dir = path();
+    if (!dir)
+        return "";
+    return fmt::format(R"({{"version": "1.0", "directory": "{}"}})", dir);
+}
+
+void clear_environment() {
+    namespace stdfs = std::filesystem;
+    auto directory_str = path() ? std::string_view(path()) : "";
+    if (!directory_str.empty()) {
+        stdfs::remove_all(directory_str);
+        stdfs::create_directories(stdfs::path(directory_str));
+    }
+}
+
+/**
+ * Spawns a coroutine per key, that writes and reads it back, checking that the
+ * scheduler coalesces them into batches.
+ */
+TEST(db, coroutines_batching) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+    blobs_collection_t collection = db.main();
+
+    constexpr std::size_t keys_size = 100;
+    std::size_t matches_count = 0;
+    auto handler = [&](ustore_key_t key) -> task_t {
+        std::string value = std::to_string(key);
+        value_view_t value_view(value.c_str(), value.size());
+        status_t status = co_await collection[key].assign_async(value_view);
+        EXPECT_TRUE(status);
+        auto maybe_value = co_await collection[key].value_async();
+        EXPECT_TRUE(maybe_value);
+        matches_count += *maybe_value == value_view;
+    };
+
+    batching_scheduler_t scheduler(16);
+    for (ustore_key_t key = 0; key != static_cast<ustore_key_t>(keys_size); ++key)
+        scheduler.spawn(handler(key));
+    scheduler.run();
+    EXPECT_EQ(matches_count, keys_size);
+    EXPECT_EQ(collection.keys().size(), keys_size);
+}
+
+/**
+ * Erases every other key with a missing value, mixing the erasing and the
+ * overwriting coroutines in the same batches, and checks that the erased
+ * keys are read back as missing.
+ */
+TEST(db, coroutines_erase) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+    blobs_collection_t collection = db.main();
+
+    constexpr std::size_t keys_size = 64;
+    for (ustore_key_t key = 0; key != static_cast<ustore_key_t>(keys_size); ++key)
+        EXPECT_TRUE(collection[key].assign("initial"));
+
+    std::size_t present_count = 0;
+    std::size_t missing_count = 0;
+    auto handler = [&](ustore_key_t key) -> task_t {
+        bool erase = key % 2;
+        EXPECT_TRUE(co_await collection[key].assign_async(erase ? value_view_t {} : value_view_t {"updated"}));
+        auto maybe_value = co_await collection[key].value_async();
+        EXPECT_TRUE(maybe_value);
+        if (erase)
+            missing_count += !*maybe_value;
+        else
+            present_count += *maybe_value == value_view_t {"updated"};
+    };
+
+    batching_scheduler_t scheduler(8);
+    for (ustore_key_t key = 0; key != static_cast<ustore_key_t>(keys_size); ++key)
+        scheduler.spawn(handler(key));
+    scheduler.run();
+    EXPECT_EQ(present_count, keys_size / 2);
+    EXPECT_EQ(missing_count, keys_size / 2);
+}
+
+int main(int argc, char** argv) {
+    clear_environment();
+    ::testing::InitGoogleTest(&argc, argv);
+    int status = RUN_ALL_TESTS();
+    clear_environment();
+    return status;
+}
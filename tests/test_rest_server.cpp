@@ -0,0 +1,518 @@
+/**
+ * @file test_rest_server.cpp
+ * @author Ashot Vardanian
+ *
+ * @brief Tests of the REST server, forked for the duration of the tests
+ * and queried over HTTP with a synchronous Boost.Beast client.
+ */
+
+#include <string>
+#include <vector>
+#include <limits>
+#include <fstream>
+#include <numeric>
+#include <charconv>
+#include <filesystem>
+#include <unistd.h>   // `fork`, `execl`
+#include <csignal>    // `kill`
+#include <sys/wait.h> // `waitpid`
+
+#include <gtest/gtest.h>
+#include <fmt/format.h>
+
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/ip/tcp.hpp>
+
+#include <mpack_header_only.h> // Building and parsing MsgPack batches
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace net = boost::asio;
+using tcp = boost::asio::ip::tcp;
+
+static constexpr char const* server_address_k = "127.0.0.1";
+static constexpr char const* mime_ndjson_k = "application/x-ndjson";
+static constexpr char const* mime_msgpack_k = "application/msgpack";
+static unsigned short server_port = 0;
+
+static char const* path() {
+    char* path = std::getenv("USTORE_TEST_PATH");
+    if (path)
+        return std::strlen(path) ? path : nullptr;
+
+#if defined(USTORE_TEST_PATH)
+    return USTORE_TEST_PATH;
+#else
+    return nullptr;
+#endif
+}
+
+/**
+ * @brief The server reads its configuration from a file, so it is stored next
+ * to the directory of the DB, rather than inside of it.
+ */
+static std::string config_path() {
+    auto dir = path();
+    return dir ? fmt::format("{}.json", dir) : std::string();
+}
+
+void clear_environment() {
+    namespace stdfs = std::filesystem;
+    auto directory_str = path() ? std::string_view(path()) : "";
+    if (!directory_str.empty()) {
+        stdfs::remove_all(directory_str);
+        stdfs::create_directories(stdfs::path(directory_str));
+    }
+}
+
+/**
+ * @brief Keeps a single keep-alive connection to the server, like most clients do,
+ * so consecutive requests share the state of the connection on the server side.
+ */
+class client_t {
+    net::io_context io_context_;
+    beast::tcp_stream stream_;
+    beast::flat_buffer buffer_;
+
+  public:
+    /// Number of non-empty chunks in the last response, if it was chunked.
+    std::size_t chunks_count = 0;
+
+    client_t() : stream_(io_context_) {
+        stream_.connect(tcp::endpoint {net::ip::make_address(server_address_k), server_port});
+    }
+    ~client_t() noexcept {
+        beast::error_code ec;
+        stream_.socket().shutdown(tcp::socket::shutdown_both, ec);
+    }
+
+    http::response<http::string_body> send(http::verb verb,
+                                           std::string const& target,
+                                           std::string body = {},
+                                           beast::string_view content_type = {},
+                                           beast::string_view accept = {}) {
+
+        http::request<http::string_body> req {verb, target, 11};
+        req.set(http::field::host, server_address_k);
+        if (!content_type.empty())
+            req.set(http::field::content_type, content_type);
+        if (!accept.empty())
+            req.set(http::field::accept, accept);
+        req.body() = std::move(body);
+        req.prepare_payload();
+        http::write(stream_, req);
+
+        http::response_parser<http::string_body> parser;
+        parser.body_limit(std::numeric_limits<std::uint64_t>::max());
+        chunks_count = 0;
+        auto count_chunk = [&](std::uint64_t size, beast::string_view, beast::error_code&) {
+            chunks_count += size != 0;
+        };
+        parser.on_chunk_header(count_chunk);
+        http::read(stream_, buffer_, parser);
+        return parser.release();
+    }
+
+    http::response<http::string_body> post_batch(std::string body, beast::string_view content_type = mime_ndjson_k) {
+        return send(http::verb::post, "/batch", std::move(body), content_type);
+    }
+};
+
+static std::string ndjson_write(std::int64_t key, std::string_view value) {
+    return fmt::format(R"({{"op":"write","key":{},"value":"{}"}})"
+                       "\n",
+                       key,
+                       value);
+}
+
+static std::string ndjson_op(std::string_view op, std::int64_t key) {
+    return fmt::format(R"({{"op":"{}","key":{}}})"
+                       "\n",
+                       op,
+                       key);
+}
+
+/**
+ * @brief Entry of a MsgPack batch response. Missing values are marked with `is_missing`.
+ */
+struct msgpack_entry_t {
+    std::int64_t key = 0;
+    std::string value;
+    bool is_missing = false;
+};
+
+/**
+ * @brief Parses the `{"key":int,"value":bin|nil}` maps, that the server returns for MsgPack batches.
+ */
+static std::vector<msgpack_entry_t> parse_msgpack_entries(std::string const& payload) {
+    std::vector<msgpack_entry_t> entries;
+    mpack_reader_t reader;
+    mpack_reader_init_data(&reader, payload.data(), payload.size());
+    mpack_tag_t array_tag = mpack_read_tag(&reader);
+    EXPECT_EQ(mpack_tag_type(&array_tag), mpack_type_array);
+    uint32_t entries_count = mpack_tag_array_count(&array_tag);
+    for (uint32_t entry_idx = 0; entry_idx != entries_count; ++entry_idx) {
+        msgpack_entry_t entry;
+        mpack_tag_t map_tag = mpack_read_tag(&reader);
+        EXPECT_EQ(mpack_tag_type(&map_tag), mpack_type_map);
+        uint32_t fields_count = mpack_tag_map_count(&map_tag);
+        for (uint32_t field_idx = 0; field_idx != fields_count; ++field_idx) {
+            mpack_tag_t name_tag = mpack_read_tag(&reader);
+            uint32_t name_length = mpack_tag_str_length(&name_tag);
+            auto name = std::string_view(mpack_read_bytes_inplace(&reader, name_length), name_length);
+            mpack_done_str(&reader);
+
+            mpack_tag_t tag = mpack_read_tag(&reader);
+            mpack_type_t type = mpack_tag_type(&tag);
+            if (name == "key")
+                entry.key = type == mpack_type_uint ? static_cast<std::int64_t>(mpack_tag_uint_value(&tag))
+                                                    : mpack_tag_int_value(&tag);
+            else if (type == mpack_type_nil)
+                entry.is_missing = true;
+            else if (type == mpack_type_bin) {
+                uint32_t length = mpack_tag_bin_length(&tag);
+                entry.value = std::string(mpack_read_bytes_inplace(&reader, length), length);
+                mpack_done_bin(&reader);
+            }
+        }
+        mpack_done_map(&reader);
+        entries.push_back(std::move(entry));
+    }
+    mpack_done_array(&reader);
+    EXPECT_EQ(mpack_reader_destroy(&reader), mpack_ok);
+    return entries;
+}
+
+/**
+ * @brief Starts a MsgPack batch of @p ops_count maps, to be filled with the `msgpack_*` helpers.
+ */
+static void msgpack_start(mpack_writer_t& writer, std::string& buffer, uint32_t ops_count) {
+    buffer.resize(4096);
+    mpack_writer_init(&writer, buffer.data(), buffer.size());
+    mpack_start_array(&writer, ops_count);
+}
+
+static void msgpack_op(mpack_writer_t& writer, char const* op, std::int64_t key) {
+    mpack_start_map(&writer, 2);
+    mpack_write_cstr(&writer, "op");
+    mpack_write_cstr(&writer, op);
+    mpack_write_cstr(&writer, "key");
+    mpack_write_i64(&writer, key);
+    mpack_finish_map(&writer);
+}
+
+static void msgpack_write(mpack_writer_t& writer, std::int64_t key, std::string_view value, bool as_binary) {
+    mpack_start_map(&writer, 3);
+    mpack_write_cstr(&writer, "op");
+    mpack_write_cstr(&writer, "write");
+    mpack_write_cstr(&writer, "key");
+    mpack_write_i64(&writer, key);
+    mpack_write_cstr(&writer, "value");
+    if (as_binary)
+        mpack_write_bin(&writer, value.data(), static_cast<uint32_t>(value.size()));
+    else
+        mpack_write_str(&writer, value.data(), static_cast<uint32_t>(value.size()));
+    mpack_finish_map(&writer);
+}
+
+static void msgpack_finish(mpack_writer_t& writer, std::string& buffer) {
+    mpack_finish_array(&writer);
+    buffer.resize(mpack_writer_buffer_used(&writer));
+    EXPECT_EQ(mpack_writer_destroy(&writer), mpack_ok);
+}
+
+/**
+ * @brief Writes consecutive keys, using the decimal representation of every key as its value.
+ */
+static void fill_range(client_t& client, std::int64_t first_key, std::size_t count) {
+    std::string batch;
+    for (std::size_t idx = 0; idx != count; ++idx) {
+        std::int64_t key = first_key + static_cast<std::int64_t>(idx);
+        batch += ndjson_write(key, std::to_string(key));
+    }
+    auto res = client.post_batch(batch);
+    ASSERT_EQ(res.result(), http::status::ok);
+}
+
+/**
+ * @brief Parses the keys of NDJSON scan results, checking that every value matches its key.
+ */
+static std::vector<std::int64_t> parse_scanned_keys(std::string const& body) {
+    std::vector<std::int64_t> keys;
+    std::string_view remaining = body;
+    constexpr std::string_view key_prefix_k = "{\"key\":";
+    while (!remaining.empty()) {
+        auto line_end = remaining.find('\n');
+        if (line_end == std::string_view::npos) {
+            ADD_FAILURE() << "Every NDJSON line must end with a newline";
+            break;
+        }
+        auto line = remaining.substr(0, line_end);
+        remaining.remove_prefix(line_end + 1);
+
+        std::int64_t key = 0;
+        std::from_chars(line.data() + key_prefix_k.size(), line.data() + line.size(), key);
+        EXPECT_EQ(line, fmt::format("{{\"key\":{},\"value\":\"{}\"}}", key, key));
+        keys.push_back(key);
+    }
+    return keys;
+}
+
+static std::vector<std::int64_t> consecutive_keys(std::int64_t first_key, std::size_t count) {
+    std::vector<std::int64_t> keys(count);
+    std::iota(keys.begin(), keys.end(), first_key);
+    return keys;
+}
+
+/**
+ * Writes, removes and reads keys in NDJSON batches, expecting reads to observe
+ * the writes of the same batch, and the values to be escaped in the response.
+ */
+TEST(rest, batch_ndjson) {
+    client_t client;
+    auto res = client.post_batch(ndjson_write(3, "three"));
+    ASSERT_EQ(res.result(), http::status::ok);
+    EXPECT_EQ(res.body(), "");
+
+    std::string batch;
+    batch += ndjson_write(1, "one");
+    batch += ndjson_write(2, R"(say \"hi\")");
+    batch += ndjson_op("remove", 3);
+    batch += "\n";
+    batch += ndjson_op("read", 1);
+    batch += ndjson_op("read", 2);
+    batch += ndjson_op("read", 3);
+    res = client.post_batch(batch);
+    ASSERT_EQ(res.result(), http::status::ok);
+    EXPECT_EQ(res[http::field::content_type], mime_ndjson_k);
+    EXPECT_EQ(res.body(),
+              "{\"key\":1,\"value\":\"one\"}\n"
+              "{\"key\":2,\"value\":\"say \\\"hi\\\"\"}\n"
+              "{\"key\":3,\"value\":null}\n");
+}
+
+/**
+ * Mixes string and binary values in MsgPack batches, that must be answered
+ * with an array of maps in the same order as the reads.
+ */
+TEST(rest, batch_msgpack) {
+    client_t client;
+    mpack_writer_t writer;
+    std::string batch;
+    msgpack_start(writer, batch, 5);
+    msgpack_write(writer, 10, std::string_view("bin\0ary", 7), true);
+    msgpack_write(writer, 11, "text", false);
+    msgpack_op(writer, "read", 11);
+    msgpack_op(writer, "read", 10);
+    msgpack_op(writer, "read", 12);
+    msgpack_finish(writer, batch);
+
+    auto res = client.post_batch(batch, mime_msgpack_k);
+    ASSERT_EQ(res.result(), http::status::ok);
+    EXPECT_EQ(res[http::field::content_type], mime_msgpack_k);
+    auto entries = parse_msgpack_entries(res.body());
+    ASSERT_EQ(entries.size(), 3u);
+    EXPECT_EQ(entries[0].key, 11);
+    EXPECT_EQ(entries[0].value, "text");
+    EXPECT_EQ(entries[1].key, 10);
+    EXPECT_EQ(entries[1].value, std::string("bin\0ary", 7));
+    EXPECT_EQ(entries[2].key, 12);
+    EXPECT_TRUE(entries[2].is_missing);
+}
+
+/**
+ * Batches are parsed entirely before being executed, so an invalid operation
+ * in the middle of a batch must reject the whole batch, without applying the
+ * writes preceding it, and without breaking the keep-alive connection.
+ */
+TEST(rest, batch_error_midway) {
+    client_t client;
+
+    std::string batch;
+    batch += ndjson_write(20, "twenty");
+    batch += ndjson_write(21, "twenty one");
+    batch += ndjson_op("erase", 22);
+    batch += ndjson_write(23, "twenty three");
+    auto res = client.post_batch(batch);
+    EXPECT_EQ(res.result(), http::status::bad_request);
+    EXPECT_FALSE(res.body().empty());
+
+    batch.clear();
+    batch += ndjson_write(24, "twenty four");
+    batch += "{\"op\":\"write\",\"key\":\n";
+    res = client.post_batch(batch);
+    EXPECT_EQ(res.result(), http::status::bad_request);
+
+    mpack_writer_t writer;
+    msgpack_start(writer, batch, 3);
+    msgpack_write(writer, 25, "twenty five", true);
+    msgpack_op(writer, "read", 25);
+    mpack_start_map(&writer, 2);
+    mpack_write_cstr(&writer, "op");
+    mpack_start_array(&writer, 0);
+    mpack_finish_array(&writer);
+    mpack_write_cstr(&writer, "key");
+    mpack_write_i64(&writer, 26);
+    mpack_finish_map(&writer);
+    msgpack_finish(writer, batch);
+    res = client.post_batch(batch, mime_msgpack_k);
+    EXPECT_EQ(res.result(), http::status::bad_request);
+
+    batch.clear();
+    for (std::int64_t key = 20; key != 26; ++key)
+        batch += ndjson_op("read", key);
+    res = client.post_batch(batch);
+    ASSERT_EQ(res.result(), http::status::ok);
+    std::string expected;
+    for (std::int64_t key = 20; key != 26; ++key)
+        expected += fmt::format("{{\"key\":{},\"value\":null}}\n", key);
+    EXPECT_EQ(res.body(), expected);
+}
+
+/**
+ * Only NDJSON and MsgPack batches are accepted, and only with POST.
+ */
+TEST(rest, batch_unsupported) {
+    client_t client;
+    auto res = client.post_batch(ndjson_op("read", 1), "application/bson");
+    EXPECT_EQ(res.result(), http::status::unsupported_media_type);
+    res = client.send(http::verb::get, "/batch");
+    EXPECT_EQ(res.result(), http::status::method_not_allowed);
+}
+
+/**
+ * Scans a range, that spans several pages, until the end of the collection.
+ * Every page must be sent in a separate chunk, without gaps or duplicates.
+ * The keys are larger than in any other test, so nothing else is in the range.
+ */
+TEST(rest, scan_chunks) {
+    constexpr std::size_t page_size = 4096;
+    constexpr std::size_t keys_count = page_size * 2 + 100;
+    constexpr std::int64_t first_key = 1'000'000;
+
+    client_t client;
+    fill_range(client, first_key, keys_count);
+
+    auto res = client.send(http::verb::get, fmt::format("/col/?from={}", first_key));
+    ASSERT_EQ(res.result(), http::status::ok);
+    EXPECT_TRUE(res.chunked());
+    EXPECT_EQ(res[http::field::content_type], mime_ndjson_k);
+    EXPECT_EQ(client.chunks_count, 3u);
+    EXPECT_EQ(parse_scanned_keys(res.body()), consecutive_keys(first_key, keys_count));
+
+    // The connection must remain usable after the last chunk
+    res = client.post_batch(ndjson_op("read", first_key));
+    ASSERT_EQ(res.result(), http::status::ok);
+    EXPECT_EQ(res.body(), fmt::format("{{\"key\":{},\"value\":\"{}\"}}\n", first_key, first_key));
+}
+
+/**
+ * Bounds scans with `from`, `to` and `limit` around the page size,
+ * where an off-by-one error would duplicate, skip or add an entry.
+ */
+TEST(rest, scan_page_boundary) {
+    constexpr std::size_t page_size = 4096;
+    constexpr std::size_t keys_count = page_size * 2 + 10;
+    constexpr std::int64_t first_key = 500'000;
+
+    client_t client;
+    fill_range(client, first_key, keys_count);
+
+    auto scan = [&](std::string const& params) {
+        auto res = client.send(http::verb::get, "/col/" + params);
+        EXPECT_EQ(res.result(), http::status::ok);
+        return parse_scanned_keys(res.body());
+    };
+
+    // Exactly one page, limited by the count
+    EXPECT_EQ(scan(fmt::format("?from={}&limit={}", first_key, page_size)), consecutive_keys(first_key, page_size));
+    EXPECT_EQ(client.chunks_count, 1u);
+
+    // One entry past the page
+    EXPECT_EQ(scan(fmt::format("?from={}&limit={}", first_key, page_size + 1)),
+              consecutive_keys(first_key, page_size + 1));
+    EXPECT_EQ(client.chunks_count, 2u);
+
+    // Exactly one page, limited by the exclusive upper bound
+    std::int64_t from = first_key + 100;
+    EXPECT_EQ(scan(fmt::format("?from={}&to={}", from, from + page_size)), consecutive_keys(from, page_size));
+    EXPECT_EQ(client.chunks_count, 1u);
+
+    // Both bounds, where the limit is the tighter one
+    from = first_key + 10;
+    EXPECT_EQ(scan(fmt::format("?from={}&to={}&limit={}", from, from + 5000, 4500)), consecutive_keys(from, 4500));
+    EXPECT_EQ(client.chunks_count, 2u);
+
+    // The upper bound is the tighter one, and falls into the second page
+    EXPECT_EQ(scan(fmt::format("?from={}&to={}&limit={}", from, from + 4500, 5000)), consecutive_keys(from, 4500));
+
+    // Empty ranges
+    EXPECT_EQ(scan(fmt::format("?from={}&to={}", first_key, first_key)), std::vector<std::int64_t> {});
+    EXPECT_EQ(scan(fmt::format("?from={}&limit=0", first_key)), std::vector<std::int64_t> {});
+    EXPECT_EQ(client.chunks_count, 0u);
+
+    auto res = client.send(http::verb::get, "/col/?from=first");
+    EXPECT_EQ(res.result(), http::status::bad_request);
+}
+
+int main(int argc, char** argv) {
+    clear_environment();
+
+    // Pick a free port, letting the kernel choose it
+    {
+        net::io_context io_context;
+        tcp::acceptor acceptor(io_context, tcp::endpoint {net::ip::make_address(server_address_k), 0});
+        server_port = acceptor.local_endpoint().port();
+    }
+
+    std::string cfg_path = config_path();
+    if (!cfg_path.empty()) {
+        std::ofstream cfg(cfg_path);
+        cfg << fmt::format(R"({{"version": "1.0", "directory": "{}"}})", path());
+    }
+
+    std::string srv_path = argv[0];
+    srv_path = srv_path.substr(0, srv_path.find_last_of("/") + 1) + "ustore_rest_server_" + USTORE_ENGINE_NAME;
+    std::string port_str = std::to_string(server_port);
+
+    auto srv_id = fork();
+    if (srv_id == 0) {
+        execl(srv_path.c_str(),
+              srv_path.c_str(),
+              server_address_k,
+              port_str.c_str(),
+              "1",
+              cfg_path.c_str(),
+              (char*)(NULL));
+        std::exit(EXIT_FAILURE);
+    }
+
+    // Wait until the server starts accepting connections
+    bool is_running = false;
+    for (std::size_t attempt = 0; attempt != 100 && !is_running; ++attempt) {
+        net::io_context io_context;
+        tcp::socket socket(io_context);
+        beast::error_code ec;
+        socket.connect(tcp::endpoint {net::ip::make_address(server_address_k), server_port}, ec);
+        is_running = !ec;
+        if (!is_running)
+            usleep(50000); // 50 ms
+    }
+
+    int status = EXIT_FAILURE;
+    if (is_running) {
+        ::testing::InitGoogleTest(&argc, argv);
+        status = RUN_ALL_TESTS();
+    }
+    else
+        std::printf("Couldn't start the server: %s\n", srv_path.c_str());
+
+    kill(srv_id, SIGKILL);
+    waitpid(srv_id, nullptr, 0);
+    clear_environment();
+    if (!cfg_path.empty())
+        std::filesystem::remove(cfg_path);
+    return status;
+}
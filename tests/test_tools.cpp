@@ -18,6 +18,7 @@
 #include <arrow/result.h>
 #include <arrow/status.h>
 #include <arrow/io/api.h>
+#include <arrow/ipc/api.h>
 #include <arrow/csv/api.h>
 #include <arrow/io/file.h>
 #include <arrow/csv/writer.h>
@@ -53,6 +54,7 @@ constexpr size_t rows_count_k = 1000;
 static constexpr ustore_str_view_t ext_parquet_k = ".parquet";
 static constexpr ustore_str_view_t ext_ndjson_k = ".ndjson";
 static constexpr ustore_str_view_t ext_csv_k = ".csv";
+static constexpr ustore_str_view_t ext_arrow_k = ".arrow";
 
 constexpr size_t prefixes_count_k = 4;
 constexpr ustore_str_view_t prefixes_ak[prefixes_count_k] = {
@@ -546,6 +548,15 @@ void fill_array_from_table(graph_t& array, std::shared_ptr<arrow::Table>& table)
     }
 }
 
+std::shared_ptr<arrow::Table> read_arrow_file(ustore_str_view_t file_name) {
+    auto input = *arrow::io::ReadableFile::Open(file_name);
+    auto reader = *arrow::ipc::RecordBatchFileReader::Open(input);
+    std::vector<std::shared_ptr<arrow::RecordBatch>> batches(reader->num_record_batches());
+    for (int idx = 0; idx != reader->num_record_batches(); ++idx)
+        batches[idx] = *reader->ReadRecordBatch(idx);
+    return *arrow::Table::FromRecordBatches(reader->schema(), batches);
+}
+
 void fill_array(ustore_str_view_t file_name, graph_t& array) {
 
     auto ext = std::filesystem::path(file_name).extension();
@@ -581,6 +592,8 @@ void fill_array(ustore_str_view_t file_name, graph_t& array) {
                 *arrow::csv::TableReader::Make(io_context, input, read_options, parse_options, convert_options);
             table = *reader->Read();
         }
+        else if (ext == ".arrow")
+            table = read_arrow_file(file_name);
         fill_array_from_table(array, table);
     }
 }
@@ -743,6 +756,8 @@ void fill_docs_w_keys(ustore_str_view_t file_name) {
                 *arrow::csv::TableReader::Make(io_context, input, read_options, parse_options, convert_options);
             table = *reader->Read();
         }
+        else if (ext == ".arrow")
+            table = read_arrow_file(file_name);
         fill_from_table(table);
     }
 }
@@ -1081,6 +1096,7 @@ bool test_whole_docs(ustore_str_view_t file, ustore_str_view_t ext, comparator c
 
     EXPECT_TRUE(status);
 
+    size_t exported_count = 0;
     ustore_docs_export_t exdocs {
         .db = db,
         .error = status.member_ptr(),
@@ -1091,10 +1107,12 @@ bool test_whole_docs(ustore_str_view_t file, ustore_str_view_t ext, comparator c
         .max_batch_size = max_batch_size_k,
         .callback = nullptr,
         .callback_payload = nullptr,
+        .exported_count = &exported_count,
     };
     ustore_docs_export(&exdocs);
 
     EXPECT_TRUE(status);
+    EXPECT_GT(exported_count, 0ul);
 
     for (const auto& entry : fs::directory_iterator(path_k))
         updated_paths.push_back(entry.path());
@@ -1118,6 +1136,76 @@ bool test_whole_docs(ustore_str_view_t file, ustore_str_view_t ext, comparator c
     return true;
 }
 
+void count_imported_batch(ustore_callback_payload_t payload) {
+    ++*reinterpret_cast<size_t*>(payload);
+}
+
+/**
+ * Imports the same file twice: in small batches on several threads,
+ * and in one batch on a single thread, expecting identical results.
+ */
+bool test_parallel_docs_import(ustore_str_view_t file) {
+    clear_environment();
+
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    auto parallel_collection = db.main();
+    auto sequential_collection = *db["sequential"];
+    arena_t arena(db);
+    status_t status;
+
+    std::string dataset_path = file;
+    if (std::strcmp(sample_path_k, file) != 0)
+        dataset_path = home_path / dataset_path.substr(2);
+
+    size_t batches_count = 0;
+    ustore_size_t parallel_count = 0;
+    ustore_docs_import_t parallel {
+        .db = db,
+        .error = status.member_ptr(),
+        .arena = arena.member_ptr(),
+        .options = ustore_options_default_k,
+        .collection = parallel_collection,
+        .paths_pattern = dataset_path.c_str(),
+        .max_batch_size = 4096,
+        .callback = count_imported_batch,
+        .callback_payload = &batches_count,
+        .id_field = fields_paths_ak[0],
+        .parsers_count = 3,
+        .writers_count = 2,
+        .imported_count = &parallel_count,
+    };
+    ustore_docs_import(&parallel);
+    EXPECT_TRUE(status);
+
+    ustore_size_t sequential_count = 0;
+    ustore_docs_import_t sequential {
+        .db = db,
+        .error = status.member_ptr(),
+        .arena = arena.member_ptr(),
+        .options = ustore_options_default_k,
+        .collection = sequential_collection,
+        .paths_pattern = dataset_path.c_str(),
+        .max_batch_size = max_batch_size_k,
+        .callback = nullptr,
+        .callback_payload = nullptr,
+        .id_field = fields_paths_ak[0],
+        .parsers_count = 1,
+        .writers_count = 1,
+        .imported_count = &sequential_count,
+    };
+    ustore_docs_import(&sequential);
+    EXPECT_TRUE(status);
+
+    EXPECT_GT(parallel_count, 0);
+    EXPECT_GT(batches_count, 1);
+    EXPECT_EQ(parallel_count, sequential_count);
+    EXPECT_EQ(parallel_collection.size(), sequential_collection.size());
+
+    db.clear().throw_unhandled();
+    return true;
+}
+
 bool test_crash_cases_graph_import(ustore_str_view_t file) {
     database_t db;
     auto collection = db.main();
@@ -1526,6 +1614,66 @@ bool test_crash_cases_docs_export(ustore_str_view_t ext) {
     return true;
 }
 
+/**
+ * Imports the same edges into an empty collection, with a tiny memory budget, so that
+ * they are sorted externally, and into a non-empty one, that is updated batch by batch.
+ */
+bool test_bulk_graph_import(ustore_str_view_t file) {
+    clear_environment();
+
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    graph_collection_t bulk = db.main<graph_collection_t>();
+    graph_collection_t incremental = *db.find_or_create<graph_collection_t>("incremental");
+    arena_t arena(db);
+    status_t status;
+
+    std::string dataset_path = file;
+    dataset_path = home_path / dataset_path.substr(2);
+
+    ustore_graph_import_t bulk_import {
+        .db = db,
+        .error = status.member_ptr(),
+        .arena = arena.member_ptr(),
+        .options = ustore_options_default_k,
+        .collection = bulk,
+        .paths_pattern = dataset_path.c_str(),
+        .max_batch_size = 64 * 1024,
+        .callback = nullptr,
+        .callback_payload = nullptr,
+        .source_id_field = source_field_k,
+        .target_id_field = target_field_k,
+        .edge_id_field = edge_field_k,
+    };
+    ustore_graph_import(&bulk_import);
+    EXPECT_TRUE(status);
+
+    // A single unrelated edge keeps the second import on the regular path
+    ustore_key_t const max_key = std::numeric_limits<ustore_key_t>::max();
+    edge_t const sentinel {max_key - 2, max_key - 1};
+    EXPECT_TRUE(incremental.upsert_edge(sentinel));
+    ustore_graph_import_t incremental_import = bulk_import;
+    incremental_import.collection = incremental;
+    incremental_import.max_batch_size = max_batch_size_k;
+    ustore_graph_import(&incremental_import);
+    EXPECT_TRUE(status);
+
+    EXPECT_EQ(bulk.number_of_vertices() + 2, incremental.number_of_vertices());
+    auto stream = *bulk.vertex_stream();
+    for (; !stream.is_end(); ++stream) {
+        ustore_key_t vertex = stream.key();
+        // Both lookups share the default arena, so the first result must be copied
+        auto found = *incremental.edges_containing(vertex);
+        std::vector<edge_t> expected(found.begin(), found.end());
+        auto imported = *bulk.edges_containing(vertex);
+        EXPECT_EQ(imported.size(), expected.size());
+        EXPECT_TRUE(std::equal(imported.begin(), imported.end(), expected.begin(), expected.end()));
+    }
+
+    db.clear().throw_unhandled();
+    return true;
+}
+
 TEST(import_export_graph, ndjosn_ndjson) {
     test_graph(ndjson_path_k, ext_ndjson_k);
 }
@@ -1535,6 +1683,9 @@ TEST(import_export_graph, ndjosn_parquet) {
 TEST(import_export_graph, ndjosn_csv) {
     test_graph(ndjson_path_k, ext_csv_k);
 }
+TEST(import_export_graph, ndjosn_arrow) {
+    test_graph(ndjson_path_k, ext_arrow_k);
+}
 
 TEST(import_export_graph, parquet_ndjson) {
     test_graph(parquet_path_k, ext_ndjson_k);
@@ -1565,6 +1716,9 @@ TEST(import_export_docs_whole, ndjosn_parquet) {
 TEST(import_export_docs_whole, ndjosn_csv) {
     test_whole_docs(sample_path_k, ext_csv_k, cmp_ndjson_docs_whole);
 }
+TEST(import_export_docs_whole, ndjosn_arrow) {
+    test_whole_docs(sample_path_k, ext_arrow_k, cmp_ndjson_docs_whole);
+}
 
 TEST(import_export_docs_whole, parquet_ndjson) {
     test_whole_docs(parquet_path_k, ext_ndjson_k, cmp_table_docs_whole, true);
@@ -1616,6 +1770,23 @@ TEST(import_export_docs_sub, csv_csv) {
     test_sub_docs(csv_path_k, ext_csv_k, cmp_table_docs_sub, true);
 }
 
+TEST(import_docs_parallel, ndjson) {
+    test_parallel_docs_import(sample_path_k);
+}
+TEST(import_docs_parallel, parquet) {
+    test_parallel_docs_import(parquet_path_k);
+}
+TEST(import_docs_parallel, csv) {
+    test_parallel_docs_import(csv_path_k);
+}
+
+TEST(import_graph_bulk, ndjson) {
+    test_bulk_graph_import(ndjson_path_k);
+}
+TEST(import_graph_bulk, parquet) {
+    test_bulk_graph_import(parquet_path_k);
+}
+
 TEST(crash_cases, graph_import) {
     test_crash_cases_graph_import(ndjson_path_k);
     test_crash_cases_graph_import(parquet_path_k);
@@ -7,12 +7,16 @@
  */
 
 #include <vector>
+#include <map>
 #include <unordered_set>
 #include <filesystem>
 #include <fstream>
+#include <random>
+#include <cmath>
 #include <iostream>
 #include <unistd.h>
 #include <thread>
+#include <atomic>
 #include <mutex>
 #include <shared_mutex>
 #include <csignal>
@@ -25,6 +29,7 @@
 
 #include <ustore/arrow.h>
 #include "ustore/ustore.hpp"
+#include "limited_priority_queue.hpp" // `limited_priority_queue_gt`
 
 using namespace unum::ustore;
 using namespace unum;
@@ -469,6 +474,42 @@ TEST(db, named_collections_list) {
     EXPECT_TRUE(db.main().clear());
 }
 
+/**
+ * Creates, lists and drops collections from multiple threads at once.
+ * Only one of the threads racing for the same name may succeed in creating it.
+ */
+TEST(db, named_collections_concurrent) {
+
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    if (!db.supports_named_collections())
+        return;
+    EXPECT_TRUE(db.clear());
+
+    constexpr std::size_t threads_count = 8;
+    constexpr std::size_t names_count = 32;
+    std::atomic<std::size_t> created_count {0};
+    auto create_and_list = [&] {
+        for (std::size_t i = 0; i != names_count; ++i) {
+            std::string name = fmt::format("col{}", i);
+            if (db.create(name.c_str()))
+                ++created_count;
+            EXPECT_TRUE(*db.contains(name.c_str()));
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i != threads_count; ++i)
+        threads.emplace_back(create_and_list);
+    for (auto& thread : threads)
+        thread.join();
+    EXPECT_EQ(created_count.load(), names_count);
+
+    for (std::size_t i = 0; i != names_count; ++i)
+        EXPECT_TRUE(db.drop(fmt::format("col{}", i).c_str()));
+    EXPECT_TRUE(db.clear());
+}
+
 /**
  * Tests clearing values in a collection, which would preserve the keys,
  * but empty the binary strings.
@@ -546,6 +587,477 @@ TEST(db, presences) {
     }
 }
 
+/**
+ * Large batches may be served concurrently by some engines,
+ * but the values must still be exported in the requested order.
+ */
+TEST(db, batch_read_large) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+    auto main = db.main();
+
+    constexpr std::size_t keys_count = 4096;
+    for (std::size_t i = 0; i != keys_count; ++i)
+        if (i % 3)
+            main[i] = std::to_string(i).c_str();
+
+    // Shuffle the keys, as engines may reorder them internally
+    std::vector<ustore_key_t> keys(keys_count);
+    for (std::size_t i = 0; i != keys_count; ++i)
+        keys[i] = static_cast<ustore_key_t>((i * 7) % keys_count);
+
+    auto values = main[keys].value().throw_or_release();
+    EXPECT_EQ(values.size(), keys_count);
+    auto it = values.begin();
+    for (std::size_t i = 0; i != keys_count; ++i, ++it) {
+        value_view_t retrieved = *it;
+        if (keys[i] % 3) {
+            std::string expected = std::to_string(keys[i]);
+            EXPECT_EQ(retrieved, value_view_t(expected.c_str(), expected.size()));
+        }
+        else
+            EXPECT_EQ(retrieved.size(), 0ul);
+    }
+}
+
+/**
+ * Engines specialize their loops for contiguous, repeating and arbitrarily
+ * strided arguments. All of those layouts must be resolved identically.
+ */
+TEST(db, batch_read_strided_layouts) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+    auto main = db.main();
+
+    struct task_t {
+        ustore_key_t key;
+        std::uint32_t padding;
+    };
+    constexpr std::size_t keys_count = 64;
+    std::vector<ustore_key_t> keys(keys_count);
+    std::vector<task_t> tasks(keys_count);
+    for (std::size_t i = 0; i != keys_count; ++i) {
+        keys[i] = tasks[i].key = static_cast<ustore_key_t>(i);
+        main[keys[i]] = std::to_string(i).c_str();
+    }
+
+    auto check = [&](keys_view_t view, auto expected_key) {
+        auto values = main[view].value().throw_or_release();
+        EXPECT_EQ(values.size(), keys_count);
+        auto it = values.begin();
+        for (std::size_t i = 0; i != keys_count; ++i, ++it) {
+            std::string expected = std::to_string(expected_key(i));
+            EXPECT_EQ(*it, value_view_t(expected.c_str(), expected.size()));
+        }
+    };
+    check({{keys.data(), sizeof(ustore_key_t)}, keys_count}, [](std::size_t i) { return i; });
+    check({{&tasks[0].key, sizeof(task_t)}, keys_count}, [](std::size_t i) { return i; });
+    check({{&keys[7], 0}, keys_count}, [](std::size_t) { return 7; });
+}
+
+/**
+ * Arena placement options are only hints for the allocator,
+ * and must not affect the exported values.
+ */
+TEST(db, arena_placement_options) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+    auto main = db.main();
+
+    constexpr std::size_t keys_count = 1000;
+    std::vector<ustore_key_t> keys(keys_count);
+    std::iota(keys.begin(), keys.end(), 0);
+    for (ustore_key_t key : keys)
+        main[key] = std::to_string(key).c_str();
+
+    for (auto options : {ustore_option_arena_huge_pages_k,
+                         ustore_option_arena_numa_local_k,
+                         ustore_options_t(ustore_option_arena_huge_pages_k | ustore_option_arena_numa_interleave_k)}) {
+        // Freed arenas are recycled, so the second round reuses the blocks of the first
+        for (std::size_t round = 0; round != 2; ++round) {
+            arena_t arena(db);
+            status_t status {};
+            ustore_bytes_ptr_t found_values = nullptr;
+            ustore_length_t* found_offsets = nullptr;
+            ustore_read_t read {};
+            read.db = db;
+            read.error = status.member_ptr();
+            read.arena = arena.member_ptr();
+            read.options = options;
+            read.tasks_count = keys_count;
+            read.keys = keys.data();
+            read.keys_stride = sizeof(ustore_key_t);
+            read.values = &found_values;
+            read.offsets = &found_offsets;
+            ustore_read(&read);
+            EXPECT_TRUE(status);
+
+            for (std::size_t i = 0; i != keys_count; ++i) {
+                std::string expected = std::to_string(keys[i]);
+                value_view_t retrieved {found_values + found_offsets[i], found_offsets[i + 1] - found_offsets[i]};
+                EXPECT_EQ(retrieved, value_view_t(expected.c_str(), expected.size()));
+            }
+        }
+    }
+}
+
+/**
+ * Short-lived arenas are returned into a thread-local pool and reset,
+ * so the next request on the same thread starts with warm memory.
+ */
+TEST(db, arenas_pool_reuse) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+    auto main = db.main();
+    main[1] = "first";
+    main[2] = "second";
+
+    arenas_pool_t& pool = arenas_pool_t::local();
+    pool.trim(0);
+    ustore_arena_t reused = nullptr;
+    {
+        arena_t arena(db);
+        EXPECT_EQ(*main[1].on(arena).value(), "first");
+        reused = *arena.member_ptr();
+    }
+    EXPECT_EQ(pool.size(), 1ul);
+    {
+        arena_t arena(db);
+        EXPECT_EQ(*arena.member_ptr(), reused);
+        EXPECT_EQ(pool.size(), 0ul);
+        EXPECT_EQ(*main[2].on(arena).value(), "second");
+    }
+    EXPECT_EQ(pool.size(), 1ul);
+    pool.trim(0);
+    EXPECT_EQ(pool.size(), 0ul);
+}
+
+/**
+ * Engines with a read-through value cache must never serve stale entries,
+ * neither after direct writes, nor after transaction commits.
+ */
+TEST(db, value_cache_invalidation) {
+    std::string cached_config = config();
+    if (path())
+        cached_config = fmt::format( //
+            R"({{"version": "1.0", "directory": "{}", "engine": {{"config": {{"value_cache": {{"capacity": "8MB"}}}}}}}})",
+            path());
+
+    database_t db;
+    EXPECT_TRUE(db.open(cached_config.c_str()));
+    EXPECT_TRUE(db.clear());
+    auto main = db.main();
+
+    std::array<ustore_key_t, 3> keys {1, 2, 3};
+    main[1] = "first";
+    EXPECT_EQ(*main[1].value(), "first");
+    EXPECT_EQ(*main[1].value(), "first");
+    EXPECT_FALSE(*main[2].present());
+
+    // Missing entries can be cached too
+    main[2] = "second";
+    EXPECT_EQ(*main[2].value(), "second");
+    main[1] = "updated";
+    EXPECT_EQ(*main[1].value(), "updated");
+    auto values = main[keys].value().throw_or_release();
+    auto it = values.begin();
+    EXPECT_EQ(*it, value_view_t("updated"));
+    EXPECT_EQ(*++it, value_view_t("second"));
+    EXPECT_FALSE(*++it);
+
+    EXPECT_TRUE(main[1].erase());
+    EXPECT_FALSE(*main[1].present());
+
+    if (!db.supports_transactions())
+        return;
+    transaction_t txn = *db.transact();
+    EXPECT_TRUE(txn.main().at(2).assign("committed"));
+    EXPECT_EQ(*main[2].value(), "second");
+    EXPECT_TRUE(txn.commit());
+    EXPECT_EQ(*main[2].value(), "committed");
+}
+
+/**
+ * Submits independent writes and reads into an asynchronous queue,
+ * collecting some of the completions by polling and others via callbacks.
+ */
+TEST(db, async_submit_poll) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+
+    ustore_async_t queue = nullptr;
+    status_t status {};
+    ustore_async_init_t init {};
+    init.db = db;
+    init.error = status.member_ptr();
+    init.threads_count = 4;
+    init.queue = &queue;
+    ustore_async_init(&init);
+    EXPECT_TRUE(status);
+
+    constexpr std::size_t requests_count = 16;
+    std::array<ustore_key_t, requests_count> keys;
+    std::array<std::string, requests_count> values;
+    std::array<ustore_bytes_cptr_t, requests_count> values_ptrs;
+    std::array<ustore_length_t, requests_count> lengths;
+    std::array<status_t, requests_count> statuses;
+    std::array<ustore_write_t, requests_count> writes {};
+    for (std::size_t i = 0; i != requests_count; ++i) {
+        keys[i] = static_cast<ustore_key_t>(i);
+        values[i] = std::to_string(i * 10);
+        values_ptrs[i] = reinterpret_cast<ustore_bytes_cptr_t>(values[i].c_str());
+        lengths[i] = static_cast<ustore_length_t>(values[i].size());
+
+        writes[i].db = db;
+        writes[i].error = statuses[i].member_ptr();
+        writes[i].keys = &keys[i];
+        writes[i].values = &values_ptrs[i];
+        writes[i].lengths = &lengths[i];
+
+        ustore_submit_t submit {};
+        submit.queue = queue;
+        submit.error = status.member_ptr();
+        submit.kind = ustore_async_write_k;
+        submit.request = &writes[i];
+        submit.user_data = &keys[i];
+        ustore_submit(&submit);
+        EXPECT_TRUE(status);
+    }
+
+    std::array<ustore_completion_t, requests_count> completions;
+    std::size_t completed_count = 0;
+    while (completed_count != requests_count) {
+        ustore_size_t count = 0;
+        ustore_poll_t poll {};
+        poll.queue = queue;
+        poll.error = status.member_ptr();
+        poll.min_count = 1;
+        poll.max_count = static_cast<ustore_size_t>(requests_count - completed_count);
+        poll.completions = completions.data() + completed_count;
+        poll.count = &count;
+        ustore_poll(&poll);
+        EXPECT_TRUE(status);
+        EXPECT_GT(count, 0u);
+        completed_count += count;
+    }
+    for (auto const& completion : completions) {
+        EXPECT_EQ(completion.kind, ustore_async_write_k);
+        EXPECT_EQ(completion.error, nullptr);
+    }
+
+    // Read everything back, with a callback per request
+    std::vector<arena_t> arenas;
+    arenas.reserve(requests_count);
+    std::array<ustore_read_t, requests_count> reads {};
+    std::array<ustore_bytes_ptr_t, requests_count> found_values {};
+    std::array<ustore_length_t*, requests_count> found_offsets {};
+    std::array<ustore_length_t*, requests_count> found_lengths {};
+    std::atomic<std::size_t> matches_count = 0;
+    auto callback = [](void* user_data, void*, ustore_error_t error) {
+        if (!error)
+            ++*reinterpret_cast<std::atomic<std::size_t>*>(user_data);
+    };
+    for (std::size_t i = 0; i != requests_count; ++i) {
+        reads[i].db = db;
+        reads[i].error = statuses[i].member_ptr();
+        arenas.emplace_back(db);
+        reads[i].arena = arenas[i].member_ptr();
+        reads[i].tasks_count = 1;
+        reads[i].keys = &keys[i];
+        reads[i].values = &found_values[i];
+        reads[i].offsets = &found_offsets[i];
+        reads[i].lengths = &found_lengths[i];
+
+        ustore_submit_t submit {};
+        submit.queue = queue;
+        submit.error = status.member_ptr();
+        submit.kind = ustore_async_read_k;
+        submit.request = &reads[i];
+        submit.user_data = &matches_count;
+        submit.callback = callback;
+        ustore_submit(&submit);
+        EXPECT_TRUE(status);
+    }
+
+    // Releasing the queue waits for the requests in flight
+    ustore_async_free(queue);
+    EXPECT_EQ(matches_count.load(), requests_count);
+    for (std::size_t i = 0; i != requests_count; ++i) {
+        EXPECT_TRUE(statuses[i]);
+        value_view_t retrieved {found_values[i] + found_offsets[i][0], found_lengths[i][0]};
+        EXPECT_EQ(retrieved, value_view_t(values[i].c_str(), values[i].size()));
+    }
+}
+
+#if !defined(USTORE_ENGINE_IS_UDISK)
+
+/**
+ * Tails the feed of committed changes, checking the order of updates and removals,
+ * and resumes it from the last seen sequence number after the database is reopened.
+ * Engines and clients without a change-feed are skipped.
+ */
+TEST(db, change_feed) {
+    if (!path())
+        return;
+    std::string feed_config = fmt::format( //
+        R"({{"version": "1.0", "directory": "{}", "engine": {{"config": {{"change_feed": {{"retention": "64MB"}}}}}}}})",
+        path());
+
+    struct change_t {
+        ustore_key_t key;
+        ustore_sequence_number_t sequence;
+        std::optional<std::string> value;
+    };
+    auto subscribe = [](database_t& db, ustore_sequence_number_t since, ustore_changes_t& cursor) {
+        status_t status;
+        ustore_changes_subscribe_t subscribe {};
+        subscribe.db = db;
+        subscribe.error = status.member_ptr();
+        subscribe.since = since;
+        subscribe.cursor = &cursor;
+        ustore_changes_subscribe(&subscribe);
+        return status;
+    };
+    auto poll = [](database_t& db, ustore_changes_t cursor) {
+        arena_t arena(db);
+        status_t status;
+        ustore_size_t count = 0;
+        ustore_key_t* keys = nullptr;
+        ustore_sequence_number_t* sequences = nullptr;
+        ustore_octet_t* presences = nullptr;
+        ustore_length_t* offsets = nullptr;
+        ustore_length_t* lengths = nullptr;
+        ustore_bytes_ptr_t values = nullptr;
+        ustore_changes_poll_t poll {};
+        poll.db = db;
+        poll.error = status.member_ptr();
+        poll.arena = arena.member_ptr();
+        poll.cursor = cursor;
+        poll.count = &count;
+        poll.keys = &keys;
+        poll.sequences = &sequences;
+        poll.presences = &presences;
+        poll.offsets = &offsets;
+        poll.lengths = &lengths;
+        poll.values = &values;
+        ustore_changes_poll(&poll);
+        EXPECT_TRUE(status);
+
+        std::vector<change_t> changes;
+        bits_view_t presents {presences};
+        for (std::size_t i = 0; i != count; ++i) {
+            change_t change {keys[i], sequences[i], std::nullopt};
+            if (presents[i])
+                change.value = std::string(reinterpret_cast<char const*>(values) + offsets[i], lengths[i]);
+            changes.push_back(std::move(change));
+        }
+        return changes;
+    };
+
+    ustore_sequence_number_t last_sequence = 0;
+    {
+        database_t db;
+        EXPECT_TRUE(db.open(feed_config.c_str()));
+        EXPECT_TRUE(db.clear());
+
+        ustore_changes_t cursor = nullptr;
+        if (!subscribe(db, 0, cursor))
+            return;
+
+        // Skip the history, left by earlier runs and the cleanup
+        while (true) {
+            auto changes = poll(db, cursor);
+            if (changes.empty())
+                break;
+            last_sequence = changes.back().sequence;
+        }
+
+        auto main = db.main();
+        main[1] = "first";
+        main[2] = "second";
+        EXPECT_TRUE(main[1].erase());
+
+        auto changes = poll(db, cursor);
+        EXPECT_EQ(changes.size(), 3u);
+        if (changes.size() == 3u) {
+            EXPECT_EQ(changes[0].key, 1);
+            EXPECT_EQ(changes[0].value, std::optional<std::string>("first"));
+            EXPECT_EQ(changes[1].key, 2);
+            EXPECT_EQ(changes[1].value, std::optional<std::string>("second"));
+            EXPECT_EQ(changes[2].key, 1);
+            EXPECT_FALSE(changes[2].value);
+            EXPECT_GT(changes[0].sequence, last_sequence);
+            EXPECT_GT(changes[1].sequence, changes[0].sequence);
+            EXPECT_GT(changes[2].sequence, changes[1].sequence);
+            last_sequence = changes[2].sequence;
+        }
+        EXPECT_TRUE(poll(db, cursor).empty());
+        ustore_changes_free(cursor);
+    }
+
+    // Sequence numbers survive restarts
+    database_t db;
+    EXPECT_TRUE(db.open(feed_config.c_str()));
+    ustore_changes_t cursor = nullptr;
+    EXPECT_TRUE(subscribe(db, last_sequence, cursor));
+    EXPECT_TRUE(poll(db, cursor).empty());
+
+    db.main()[3] = "third";
+    auto changes = poll(db, cursor);
+    EXPECT_EQ(changes.size(), 1u);
+    if (changes.size() == 1u) {
+        EXPECT_EQ(changes[0].key, 3);
+        EXPECT_EQ(changes[0].value, std::optional<std::string>("third"));
+        EXPECT_GT(changes[0].sequence, last_sequence);
+    }
+    ustore_changes_free(cursor);
+    EXPECT_TRUE(db.clear());
+}
+
+#endif
+
+/**
+ * Requests engine statistics through the free-form control interface.
+ * Remote and other engines may not support it, so failures are skipped.
+ */
+TEST(db, control_stats) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+    auto main = db.main();
+    for (ustore_key_t i = 0; i != 100; ++i)
+        main[i] = "value";
+
+    ustore_str_view_t response = nullptr;
+    arena_t arena(db);
+    status_t status {};
+    ustore_database_control_t control {};
+    control.db = db;
+    control.error = status.member_ptr();
+    control.arena = arena.member_ptr();
+    control.request = R"({"stats": ["memory", "ops", "latency"]})";
+    control.response = &response;
+    ustore_database_control(&control);
+    if (!status)
+        return;
+
+    auto js = nlohmann::json::parse(response);
+    EXPECT_TRUE(js.contains("memory"));
+    EXPECT_TRUE(js["memory"]["collections"].contains(""));
+    EXPECT_GE(js["ops"]["write"]["calls"].get<std::size_t>(), 100u);
+    auto const& write_latency = js["latency"]["write"];
+    EXPECT_GE(write_latency["p99_ns"].get<std::size_t>(), write_latency["p50_ns"].get<std::size_t>());
+
+    control.request = R"({"stats": ["unknown"]})";
+    ustore_database_control(&control);
+    EXPECT_FALSE(status);
+}
+
 TEST(db, scan) {
     database_t db;
     EXPECT_TRUE(db.open(config().c_str()));
@@ -569,6 +1081,55 @@ TEST(db, scan) {
     EXPECT_EQ(key, keys_size);
 }
 
+/**
+ * Streams keys and pairs, prefetching the batches in the background.
+ */
+TEST(db, scan_prefetched) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+    blobs_collection_t collection = db.main();
+
+    ustore_async_t queue = nullptr;
+    status_t status;
+    ustore_async_init_t init {};
+    init.db = db;
+    init.error = status.member_ptr();
+    init.threads_count = 2;
+    init.queue = &queue;
+    ustore_async_init(&init);
+    EXPECT_TRUE(status);
+
+    constexpr std::size_t keys_size = 1000;
+    std::array<ustore_key_t, keys_size> keys;
+    std::iota(std::begin(keys), std::end(keys), 0);
+    value_view_t value("value");
+    EXPECT_TRUE(collection[keys].assign(value));
+
+    {
+        keys_stream_t stream(db, collection, 64, nullptr, queue);
+        EXPECT_TRUE(stream.seek_to_first());
+        ustore_key_t key = 0;
+        while (!stream.is_end()) {
+            EXPECT_EQ(stream.key(), key++);
+            ++stream;
+        }
+        EXPECT_EQ(key, keys_size);
+
+        // Seeking discards the batch in flight
+        EXPECT_TRUE(stream.seek(500));
+        EXPECT_EQ(stream.key(), 500);
+    }
+
+    ustore_key_t key = 0;
+    for (auto pair : collection.items().prefetch_with(queue)) {
+        EXPECT_EQ(pair.first, key++);
+        EXPECT_EQ(pair.second, value);
+    }
+    EXPECT_EQ(key, keys_size);
+    ustore_async_free(queue);
+}
+
 /**
  * Ordered batched scan over the main collection.
  */
@@ -607,1625 +1168,4664 @@ TEST(db, batch_scan) {
 }
 
 /**
- * Checks the "Read Commited" consistency guarantees of transactions.
- * Readers can't see the contents of pending (not committed) transactions.
- * https://jepsen.io/consistency/models/read-committed
+ * Bulk scan over multiple shards of the main collection at once.
+ * Shards are scanned concurrently, but the outputs are laid out in order.
  */
-TEST(db, transaction_read_commited) {
+TEST(db, bulk_scan) {
+
     database_t db;
     EXPECT_TRUE(db.open(config().c_str()));
-    if (!db.supports_transactions())
-        return;
     EXPECT_TRUE(db.clear());
-    EXPECT_TRUE(db.transact());
-    transaction_t txn = *db.transact();
+    blobs_collection_t collection = db.main();
 
-    triplet_t triplet;
+    std::array<ustore_key_t, 1000> keys;
+    std::iota(std::begin(keys), std::end(keys), 0);
+    auto ref = collection[keys];
+    value_view_t value("value");
+    EXPECT_TRUE(ref.assign(value));
 
-    auto txn_ref = txn[triplet.keys];
-    round_trip(txn_ref, triplet);
+    constexpr std::size_t shards_count = 4;
+    std::array<ustore_key_t, shards_count> start_keys {0, 250, 500, 950};
+    ustore_length_t limit = 100;
+
+    ustore_length_t* found_offsets = nullptr;
+    ustore_length_t* found_counts = nullptr;
+    ustore_key_t* found_keys = nullptr;
+    arena_t arena(db);
+    status_t status {};
+    ustore_scan_t scan {};
+    scan.db = db;
+    scan.error = status.member_ptr();
+    scan.arena = arena.member_ptr();
+    scan.options = ustore_option_scan_bulk_k;
+    scan.tasks_count = shards_count;
+    scan.start_keys = start_keys.data();
+    scan.start_keys_stride = sizeof(ustore_key_t);
+    scan.count_limits = &limit;
+    scan.offsets = &found_offsets;
+    scan.counts = &found_counts;
+    scan.keys = &found_keys;
+
+    ustore_scan(&scan);
+    EXPECT_TRUE(status);
 
+    std::array<ustore_length_t, shards_count> expected_counts {100, 100, 100, 50};
+    for (std::size_t i = 0; i != shards_count; ++i) {
+        EXPECT_EQ(found_counts[i], expected_counts[i]);
+        for (std::size_t j = 0; j != found_counts[i]; ++j)
+            EXPECT_EQ(found_keys[found_offsets[i] + j], start_keys[i] + static_cast<ustore_key_t>(j));
+    }
+    EXPECT_EQ(found_offsets[shards_count], 350);
+}
+
+TEST(db, scan_bounds_and_values) {
+
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
     blobs_collection_t collection = db.main();
-    auto collection_ref = collection[triplet.keys];
 
-    // Check for missing values before commit
-    check_length(collection_ref, ustore_length_missing_k);
-    EXPECT_TRUE(txn.commit());
-    EXPECT_TRUE(txn.reset());
+    std::array<ustore_key_t, 100> keys;
+    std::iota(std::begin(keys), std::end(keys), 0);
+    std::array<ustore_key_t, 100> values;
+    std::iota(std::begin(values), std::end(values), 1000);
+    std::array<ustore_length_t, 100> value_offsets;
+    for (std::size_t i = 0; i != value_offsets.size(); ++i)
+        value_offsets[i] = static_cast<ustore_length_t>(i * sizeof(ustore_key_t));
+    ustore_length_t const value_length = sizeof(ustore_key_t);
+    contents_arg_t contents {};
+    contents.offsets_begin = {value_offsets.data(), sizeof(ustore_length_t)};
+    contents.lengths_begin = {&value_length, 0};
+    auto values_ptr = reinterpret_cast<ustore_bytes_cptr_t>(values.data());
+    contents.contents_begin = {&values_ptr, 0};
+    contents.count = values.size();
+    EXPECT_TRUE(collection[keys].assign(contents));
+
+    constexpr std::size_t tasks_count = 2;
+    std::array<ustore_key_t, tasks_count> start_keys {10, 90};
+    std::array<ustore_key_t, tasks_count> end_keys {15, 1000};
+    ustore_length_t limit = 20;
+
+    ustore_length_t* found_offsets = nullptr;
+    ustore_length_t* found_counts = nullptr;
+    ustore_key_t* found_keys = nullptr;
+    ustore_length_t* found_values_offsets = nullptr;
+    ustore_byte_t* found_values = nullptr;
+    arena_t arena(db);
+    status_t status {};
+    ustore_scan_t scan {};
+    scan.db = db;
+    scan.error = status.member_ptr();
+    scan.arena = arena.member_ptr();
+    scan.options = ustore_option_scan_sequential_k;
+    scan.tasks_count = tasks_count;
+    scan.start_keys = start_keys.data();
+    scan.start_keys_stride = sizeof(ustore_key_t);
+    scan.end_keys = end_keys.data();
+    scan.end_keys_stride = sizeof(ustore_key_t);
+    scan.count_limits = &limit;
+    scan.offsets = &found_offsets;
+    scan.counts = &found_counts;
+    scan.keys = &found_keys;
+    scan.values_offsets = &found_values_offsets;
+    scan.values = &found_values;
+
+    ustore_scan(&scan);
+    EXPECT_TRUE(status);
 
-    // Validate that values match after commit
-    check_equalities(collection_ref, triplet);
+    std::array<ustore_length_t, tasks_count> expected_counts {5, 10};
+    for (std::size_t i = 0; i != tasks_count; ++i) {
+        EXPECT_EQ(found_counts[i], expected_counts[i]);
+        for (std::size_t j = 0; j != found_counts[i]; ++j) {
+            std::size_t idx = found_offsets[i] + j;
+            ustore_key_t key = found_keys[idx];
+            EXPECT_EQ(key, start_keys[i] + static_cast<ustore_key_t>(j));
+            EXPECT_EQ(found_values_offsets[idx + 1] - found_values_offsets[idx], sizeof(ustore_key_t));
+            ustore_key_t value;
+            std::memcpy(&value, found_values + found_values_offsets[idx], sizeof(ustore_key_t));
+            EXPECT_EQ(value, key + 1000);
+        }
+    }
+    EXPECT_EQ(found_offsets[tasks_count], 15);
 }
 
+#if defined(USTORE_ENGINE_IS_UCSET)
+
 /**
- * Checks the "Snapshot Isolation" consistency guarantees of transactions.
- * If needed, readers can initiate snapshot-backed transactions.
- * All the reads, directed to that snapshot will not see newer operations,
- * affecting the HEAD state. From a consistency standpoint, it is a downgrade
- * from "Strictly Serializable" ACID transactions, but it is extremely useful
- * for numerous Business Intelligence applications.
- * https://jepsen.io/consistency/models/snapshot-isolation
+ * Measures whole collections from the maintained statistics, and checks,
+ * that the bounds of partial ranges include the actual number of keys.
  */
-TEST(db, transaction_snapshot_isolation) {
+TEST(db, measure_bounds) {
+
     database_t db;
     EXPECT_TRUE(db.open(config().c_str()));
-    if (!db.supports_snapshots())
-        return;
     EXPECT_TRUE(db.clear());
+    blobs_collection_t collection = db.main();
 
-    triplet_t triplet;
-    triplet_t triplet_same_v;
-    triplet_same_v.vals = {'D', 'D', 'D'};
+    std::vector<ustore_key_t> keys(10'000);
+    std::iota(std::begin(keys), std::end(keys), 0);
+    EXPECT_TRUE(collection[keys].assign(value_view_t("value")));
+    std::array<ustore_key_t, 3> erased_keys {1, 2, 3};
+    EXPECT_TRUE(collection[erased_keys].erase());
+    EXPECT_TRUE(collection.at(4).assign("longer value"));
+
+    auto whole = *collection.members().size_estimates();
+    EXPECT_EQ(whole.cardinality.min, keys.size() - erased_keys.size());
+    EXPECT_EQ(whole.cardinality.max, keys.size() - erased_keys.size());
+    EXPECT_EQ(whole.bytes_in_values.min, (keys.size() - erased_keys.size()) * 5 + 7);
+
+    auto small = *collection.members(0, 100).size_estimates();
+    EXPECT_EQ(small.cardinality.min, 97u);
+    EXPECT_EQ(small.cardinality.max, 97u);
+
+    auto large = *collection.members(100, 9'000).size_estimates();
+    EXPECT_LE(large.cardinality.min, 8'900u);
+    EXPECT_GE(large.cardinality.max, 8'900u);
+    EXPECT_LE(large.cardinality.max, keys.size() - erased_keys.size());
+}
 
-    blobs_collection_t collection = db.main();
-    auto collection_ref = collection[triplet.keys];
+/**
+ * Concurrent writers overwrite the same keys, while the statistics are only guarded
+ * by striped locks and atomic counters. Every key must still be counted exactly once.
+ */
+TEST(db, measure_concurrent_overwrites) {
 
-    check_length(collection_ref, ustore_length_missing_k);
-    round_trip(collection_ref, triplet);
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
 
-    auto snap = *db.snapshot();
-    auto snap_ref = snap[triplet.keys];
-    round_trip(snap_ref, triplet);
-    round_trip(collection_ref, triplet_same_v);
+    constexpr std::size_t threads_count = 4;
+    constexpr ustore_key_t keys_count = 1'000;
+    std::vector<std::thread> threads;
+    for (std::size_t thread_idx = 0; thread_idx != threads_count; ++thread_idx)
+        threads.emplace_back([&db, thread_idx] {
+            blobs_collection_t collection = db.main();
+            for (std::size_t round = 0; round != 10; ++round)
+                for (ustore_key_t key = 0; key != keys_count; ++key)
+                    EXPECT_TRUE(collection[key].assign(thread_idx % 2 ? "odd" : "even"));
+        });
+    for (auto& thread : threads)
+        thread.join();
+
+    auto whole = *db.main().members().size_estimates();
+    EXPECT_EQ(whole.cardinality.min, static_cast<std::size_t>(keys_count));
+    EXPECT_EQ(whole.cardinality.max, static_cast<std::size_t>(keys_count));
+    EXPECT_GE(whole.bytes_in_values.min, static_cast<std::size_t>(keys_count) * 3);
+    EXPECT_LE(whole.bytes_in_values.max, static_cast<std::size_t>(keys_count) * 4);
+}
 
-    // Validate that values match
-    auto maybe_retrieved = snap_ref.value();
-    auto const& retrieved = *maybe_retrieved;
-    auto it = retrieved.begin();
-    auto cont = triplet_same_v.contents_full();
-    for (std::size_t i = 0; i != cont.size(); ++i, ++it) {
-        auto expected_len = cont[i].size();
-        auto expected_begin = cont[i].begin();
+/**
+ * Prepares an empty directory for the write-ahead log tests and returns a config,
+ * that enables the log with the given @p checkpoints options.
+ */
+static std::string write_ahead_log_config(std::string const& directory, char const* checkpoints) {
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    return fmt::format( //
+        R"({{"version": "1.0", "directory": "{}", "engine": {{"config": {{"write_ahead_log": true, {}}}}}}})",
+        directory,
+        checkpoints);
+}
 
-        value_view_t retrieved_view = *it;
-        value_view_t expected_view(expected_begin, expected_begin + expected_len);
-        EXPECT_EQ(retrieved_view.size(), expected_view.size());
-        EXPECT_NE(retrieved_view, expected_view);
+static std::vector<std::filesystem::path> write_ahead_logs(std::string const& directory) {
+    std::vector<std::filesystem::path> logs;
+    for (auto const& entry : std::filesystem::directory_iterator(directory))
+        if (entry.path().extension() == ".wal")
+            logs.push_back(entry.path());
+    std::sort(logs.begin(), logs.end());
+    return logs;
+}
+
+/**
+ * Writes with checkpoints postponed, so that after reopening, the state
+ * can only be restored by replaying the write-ahead log.
+ */
+TEST(db, write_ahead_log_replay) {
+    if (!path())
+        return;
+    std::string directory = std::string(path()) + "/wal_replay";
+    std::string wal_config = write_ahead_log_config(directory, R"("checkpoint_interval_ms": 3600000)");
+
+    database_t db;
+    EXPECT_TRUE(db.open(wal_config.c_str()));
+    {
+        blobs_collection_t main = db.main();
+        for (ustore_key_t k = 0; k != 100; ++k)
+            EXPECT_TRUE(main[k].assign(std::to_string(k).c_str()));
+        std::array<ustore_key_t, 2> erased_keys {10, 20};
+        EXPECT_TRUE(main[erased_keys].erase());
+        blobs_collection_t named = *db.create("named");
+        EXPECT_TRUE(named[7].assign("seven"));
     }
+    db.close();
+    EXPECT_FALSE(write_ahead_logs(directory).empty());
 
-    snap = *db.snapshot();
-    auto ref = snap[triplet_same_v.keys];
-    round_trip(ref, triplet_same_v);
+    EXPECT_TRUE(db.open(wal_config.c_str()));
+    blobs_collection_t main = db.main();
+    EXPECT_EQ(main.keys().size(), 98ul);
+    EXPECT_EQ(*main[42].value(), "42");
+    EXPECT_FALSE(*main[10].present());
+    EXPECT_TRUE(*db.contains("named"));
+    EXPECT_EQ(*(*db["named"])[7].value(), "seven");
+    db.close();
 }
 
-TEST(db, snapshots_list) {
+/**
+ * Cuts a few bytes off the newest log, as if the process crashed half-way
+ * through an append. Every complete record must survive, the torn one is dropped,
+ * and the database must keep accepting writes after reopening.
+ */
+TEST(db, write_ahead_log_truncated_tail) {
+    if (!path())
+        return;
+    std::string directory = std::string(path()) + "/wal_truncated";
+    std::string wal_config = write_ahead_log_config(directory, R"("checkpoint_interval_ms": 3600000)");
 
     database_t db;
-    EXPECT_TRUE(db.open(config().c_str()));
-    if (!db.supports_snapshots())
-        return;
-    EXPECT_TRUE(db.clear());
+    EXPECT_TRUE(db.open(wal_config.c_str()));
+    {
+        blobs_collection_t main = db.main();
+        for (ustore_key_t k = 0; k != 100; ++k)
+            EXPECT_TRUE(main[k].assign(std::to_string(k).c_str()));
+    }
+    db.close();
 
-    auto snap_1 = *db.snapshot();
-    auto snapshots = snap_1.snapshots();
-    auto snaps = *snapshots;
+    auto logs = write_ahead_logs(directory);
+    EXPECT_FALSE(logs.empty());
+    auto newest = logs.back();
+    std::filesystem::resize_file(newest, std::filesystem::file_size(newest) - 3);
 
-    EXPECT_EQ(snaps.size(), 1u);
+    EXPECT_TRUE(db.open(wal_config.c_str()));
+    {
+        blobs_collection_t main = db.main();
+        EXPECT_EQ(main.keys().size(), 99ul);
+        EXPECT_EQ(*main[98].value(), "98");
+        EXPECT_FALSE(*main[99].present());
+        EXPECT_TRUE(main[99].assign("again"));
+    }
+    db.close();
 
-    auto snap_2 = *db.snapshot();
-    snapshots = snap_2.snapshots();
-    snaps = *snapshots;
-    EXPECT_EQ(snaps.size(), 2u);
+    EXPECT_TRUE(db.open(wal_config.c_str()));
+    EXPECT_EQ(*db.main()[99].value(), "again");
+    EXPECT_EQ(db.main().keys().size(), 100ul);
+    db.close();
+}
 
-    auto snap_3 = *db.snapshot();
-    snapshots = snap_3.snapshots();
-    snaps = *snapshots;
+/**
+ * Forces frequent checkpoints and waits for the logs, that preceded them, to be removed.
+ * The state must then be restored from the checkpointed files and the remaining log.
+ */
+TEST(db, write_ahead_log_checkpoint) {
+    if (!path())
+        return;
+    std::string directory = std::string(path()) + "/wal_checkpoint";
+    std::string wal_config =
+        write_ahead_log_config(directory, R"("checkpoint_size": 1, "checkpoint_interval_ms": 10)");
 
-    EXPECT_EQ(snaps.size(), 3u);
+    database_t db;
+    EXPECT_TRUE(db.open(wal_config.c_str()));
+    auto initial_logs = write_ahead_logs(directory);
+    {
+        blobs_collection_t main = db.main();
+        for (ustore_key_t k = 0; k != 100; ++k)
+            EXPECT_TRUE(main[k].assign(std::to_string(k).c_str()));
+    }
 
-    snap_1 = *db.snapshot();
-    snapshots = snap_1.snapshots();
-    snaps = *snapshots;
-    EXPECT_EQ(snaps.size(), 4u);
+    auto is_removed = [&](std::filesystem::path const& log) { return !std::filesystem::exists(log); };
+    for (std::size_t attempt = 0; attempt != 500; ++attempt) {
+        if (std::all_of(initial_logs.begin(), initial_logs.end(), is_removed))
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_TRUE(std::all_of(initial_logs.begin(), initial_logs.end(), is_removed));
+    EXPECT_TRUE(db.main()[100].assign("after checkpoint"));
+    db.close();
 
-    EXPECT_TRUE(db.clear());
+    EXPECT_TRUE(db.open(wal_config.c_str()));
+    blobs_collection_t main = db.main();
+    EXPECT_EQ(main.keys().size(), 101ul);
+    EXPECT_EQ(*main[0].value(), "0");
+    EXPECT_EQ(*main[99].value(), "99");
+    EXPECT_EQ(*main[100].value(), "after checkpoint");
+    db.close();
+}
 
-    snapshots = snap_1.snapshots();
-    snaps = *snapshots;
-    EXPECT_EQ(snaps.size(), 0u);
+/**
+ * Prepares an empty directory for the persistence tests and returns a config,
+ * that passes the given @p options to the engine.
+ */
+static std::string persisted_config(std::string const& directory, char const* options) {
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    return fmt::format( //
+        R"({{"version": "1.0", "directory": "{}", "engine": {{"config": {{{}}}}}}})",
+        directory,
+        options);
 }
 
-TEST(db, transaction_with_snapshot) {
+/**
+ * Snapshots are loaded in bulk, a whole row group at a time, with collections in parallel.
+ * Every pair must survive the round trip into the right collection, including the values,
+ * that are empty, and the collections, that have none at all.
+ */
+TEST(db, parquet_bulk_load) {
+    if (!path())
+        return;
+    std::string config = persisted_config(std::string(path()) + "/parquet_bulk", "");
+    constexpr ustore_key_t keys_count = 10'000;
+    std::array<char const*, 2> names {"first", "second"};
 
     database_t db;
-    EXPECT_TRUE(db.open(config().c_str()));
-    if (!db.supports_snapshots())
+    EXPECT_TRUE(db.open(config.c_str()));
+    {
+        blobs_collection_t main = db.main();
+        for (ustore_key_t key = 0; key != keys_count; ++key)
+            EXPECT_TRUE(main[key].assign(fmt::format("main-{}", key).c_str()));
+        EXPECT_TRUE(main[keys_count].assign(""));
+        for (char const* name : names) {
+            blobs_collection_t named = *db.create(name);
+            for (ustore_key_t key = 0; key != keys_count; key += 3)
+                EXPECT_TRUE(named[key].assign(fmt::format("{}-{}", name, key).c_str()));
+        }
+        EXPECT_TRUE(db.create("empty"));
+    }
+    db.close();
+
+    EXPECT_TRUE(db.open(config.c_str()));
+    blobs_collection_t main = db.main();
+    EXPECT_EQ(main.keys().size(), static_cast<std::size_t>(keys_count + 1));
+    for (ustore_key_t key = 0; key != keys_count; key += 997)
+        EXPECT_EQ(*main[key].value(), fmt::format("main-{}", key).c_str());
+    EXPECT_TRUE(*main[keys_count].present());
+    EXPECT_EQ(*main[keys_count].value(), "");
+
+    for (char const* name : names) {
+        blobs_collection_t named = *db[name];
+        EXPECT_EQ(named.keys().size(), static_cast<std::size_t>((keys_count + 2) / 3));
+        for (ustore_key_t key = 0; key != keys_count; key += 999)
+            EXPECT_EQ(*named[key].value(), fmt::format("{}-{}", name, key).c_str());
+        EXPECT_FALSE(*named[1].present());
+    }
+    EXPECT_TRUE(*db.contains("empty"));
+    EXPECT_EQ((*db["empty"]).keys().size(), 0u);
+    db.close();
+}
+
+/**
+ * Arrow snapshots are memory-mapped, and the loaded values point straight into the mapping.
+ * Overwriting or erasing some of them must leave the rest intact, both in memory and after
+ * the next snapshot replaces the file, that is still mapped.
+ */
+TEST(db, arrow_mapped_round_trip) {
+    if (!path())
         return;
-    EXPECT_TRUE(db.clear());
+    std::string config = persisted_config(std::string(path()) + "/arrow_mapped", R"("snapshot_format": "arrow")");
+    constexpr ustore_key_t keys_count = 1'000;
+    auto make_value = [](ustore_key_t key) { return fmt::format("mapped-{}", key); };
 
-    triplet_t triplet;
-    triplet_t triplet_same_v;
-    triplet_same_v.vals = {'D', 'D', 'D'};
+    database_t db;
+    EXPECT_TRUE(db.open(config.c_str()));
+    {
+        blobs_collection_t main = db.main();
+        for (ustore_key_t key = 0; key != keys_count; ++key)
+            EXPECT_TRUE(main[key].assign(make_value(key).c_str()));
+    }
+    db.close();
 
-    blobs_collection_t collection = db.main();
-    auto collection_ref = collection[triplet.keys];
+    for (std::size_t reopening = 0; reopening != 2; ++reopening) {
+        EXPECT_TRUE(db.open(config.c_str()));
+        blobs_collection_t main = db.main();
+        EXPECT_EQ(main.keys().size(), static_cast<std::size_t>(keys_count) - 100 * reopening);
+        for (ustore_key_t key = 200; key != keys_count; ++key)
+            EXPECT_EQ(*main[key].value(), make_value(key).c_str());
+
+        if (!reopening) {
+            for (ustore_key_t key = 0; key != 100; ++key)
+                EXPECT_TRUE(main[key].assign(fmt::format("overwritten-{}", key).c_str()));
+            std::array<ustore_key_t, 100> erased;
+            std::iota(erased.begin(), erased.end(), 100);
+            EXPECT_TRUE(main[erased].erase());
+        }
+        for (ustore_key_t key = 0; key != 100; ++key)
+            EXPECT_EQ(*main[key].value(), fmt::format("overwritten-{}", key).c_str());
+        EXPECT_FALSE(*main[150].present());
+        EXPECT_EQ(*main[keys_count - 1].value(), make_value(keys_count - 1).c_str());
+        db.close();
+    }
+}
 
-    check_length(collection_ref, ustore_length_missing_k);
-    round_trip(collection_ref, triplet);
+/**
+ * Values, that expired while the DB was closed, must stay expired after reopening,
+ * whether they are loaded from a snapshot or replayed from the write-ahead log,
+ * instead of being granted another full lifetime.
+ */
+TEST(db, ttl_deadlines_persisted) {
+    if (!path())
+        return;
+    auto expiring_config = [](std::string const& directory, char const* extras) {
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+        return fmt::format( //
+            R"({{"version": "1.0", "directory": "{}", "engine": {{"config": {{"ttl": {{"collections": {{"": 1}}}}{}}}}}}})",
+            directory,
+            extras);
+    };
+    std::string const snapshot_config = expiring_config(std::string(path()) + "/ttl_snapshot", "");
+    std::string const log_config = expiring_config( //
+        std::string(path()) + "/ttl_log",
+        R"(, "write_ahead_log": true, "checkpoint_interval_ms": 3600000)");
+
+    for (std::string const& config : {snapshot_config, log_config}) {
+        database_t db;
+        EXPECT_TRUE(db.open(config.c_str()));
+        EXPECT_TRUE(db.main()[1].assign("expiring"));
+        EXPECT_TRUE((*db.create("lasting"))[1].assign("lasting"));
+        db.close();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(2'500));
+
+    for (std::string const& config : {snapshot_config, log_config}) {
+        database_t db;
+        EXPECT_TRUE(db.open(config.c_str()));
+        EXPECT_FALSE(*db.main()[1].present());
+        EXPECT_EQ(*(*db["lasting"])[1].value(), "lasting");
+        db.close();
+    }
+}
 
-    auto snap = *db.snapshot();
-    auto snap_ref = snap[triplet.keys];
-    check_equalities(snap_ref, triplet);
+static nlohmann::json memory_stats(database_t& db) {
+    ustore_str_view_t response = nullptr;
+    arena_t arena(db);
+    status_t status;
+    ustore_database_control_t control {};
+    control.db = db;
+    control.error = status.member_ptr();
+    control.arena = arena.member_ptr();
+    control.request = R"({"stats": ["memory"]})";
+    control.response = &response;
+    ustore_database_control(&control);
+    EXPECT_TRUE(status);
+    return status ? nlohmann::json::parse(response)["memory"] : nlohmann::json::object();
+}
 
-    round_trip(collection_ref, triplet_same_v);
+/**
+ * Keeps overwriting and erasing values larger than the `memory_limit` allows to hold,
+ * so most of them live in the spill file. Values must read back intact, and the file
+ * must reuse the extents of the dead values, instead of growing with every round.
+ */
+TEST(db, spill_reuses_extents) {
+    if (!path())
+        return;
+    std::string directory = std::string(path()) + "/spill";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    std::string spill_config = fmt::format( //
+        R"({{"version": "1.0", "directory": "{}", "engine": {{"config": {{"memory_limit": 4096, "spill_threshold": 64}}}}}})",
+        directory);
+
+    constexpr ustore_key_t keys_count = 64;
+    constexpr std::size_t value_length = 256;
+    constexpr std::size_t rounds_count = 16;
+    auto make_value = [](std::size_t round, ustore_key_t key) {
+        return std::string(value_length, static_cast<char>('a' + (round + static_cast<std::size_t>(key)) % 26));
+    };
 
-    transaction_t txn = *db.transact();
-    auto txn_ref_1 = txn[triplet.keys];
-    check_equalities(txn_ref_1, triplet_same_v);
+    database_t db;
+    EXPECT_TRUE(db.open(spill_config.c_str()));
+    blobs_collection_t main = db.main();
+    for (std::size_t round = 0; round != rounds_count; ++round) {
+        for (ustore_key_t key = 0; key != keys_count; ++key)
+            EXPECT_TRUE(main[key].assign(make_value(round, key).c_str()));
+        for (ustore_key_t key = 0; key != keys_count; ++key)
+            EXPECT_EQ(*main[key].value(), make_value(round, key));
+        if (round % 4 == 3) {
+            std::array<ustore_key_t, keys_count / 2> erased;
+            std::iota(erased.begin(), erased.end(), 0);
+            EXPECT_TRUE(main[erased].erase());
+            EXPECT_FALSE(*main[0].present());
+        }
+    }
 
-    txn.set_snapshot(snap.snap());
-    auto txn_ref_2 = txn[triplet.keys];
-    check_equalities(txn_ref_2, triplet);
+    auto memory = memory_stats(db);
+    EXPECT_LE(memory["blobs_bytes"].get<std::size_t>(), 4096u);
+    EXPECT_GT(memory["spilled_bytes"].get<std::size_t>(), 0u);
+    EXPECT_LE(memory["spilled_bytes"].get<std::size_t>(), 4 * value_length * static_cast<std::size_t>(keys_count));
+    db.close();
+}
 
-    snap = *db.snapshot();
-    txn.set_snapshot(snap.snap());
+/**
+ * Only values of at least `compression_threshold` bytes, that actually shrink, are compressed.
+ * Short, compressible and incompressible values must all read back intact, both from memory
+ * and from the reloaded snapshot, while the compressible ones take less space.
+ */
+TEST(db, compression_round_trip) {
+    if (!path())
+        return;
+    std::string config = persisted_config( //
+        std::string(path()) + "/compression",
+        R"("compression": true, "compression_threshold": 64)");
+
+    std::string const short_value(63, 'a');
+    std::string const compressible_value(4096, 'b');
+    std::string incompressible_value(256, '\0');
+    std::mt19937 generator(42);
+    for (char& c : incompressible_value)
+        c = static_cast<char>(generator());
+    auto as_view = [](std::string const& str) { return value_view_t {str.data(), str.size()}; };
+    auto check_values = [&](blobs_collection_t& main) {
+        EXPECT_EQ(*main[1].value(), as_view(short_value));
+        EXPECT_EQ(*main[2].value(), as_view(compressible_value));
+        EXPECT_EQ(*main[3].value(), as_view(incompressible_value));
+        EXPECT_EQ(*main[2].length(), compressible_value.size());
+    };
 
-    auto txn_ref_3 = txn[triplet.keys];
-    check_equalities(txn_ref_3, triplet_same_v);
+    database_t db;
+    EXPECT_TRUE(db.open(config.c_str()));
+    {
+        blobs_collection_t main = db.main();
+        EXPECT_TRUE(main[1].assign(as_view(short_value)));
+        EXPECT_TRUE(main[2].assign(as_view(compressible_value)));
+        EXPECT_TRUE(main[3].assign(as_view(incompressible_value)));
+        check_values(main);
+
+        std::size_t raw_bytes = short_value.size() + compressible_value.size() + incompressible_value.size();
+        auto stored_bytes = memory_stats(db)["collections"][""]["bytes"].get<std::size_t>();
+        EXPECT_LT(stored_bytes, raw_bytes);
+        EXPECT_GE(stored_bytes, short_value.size() + incompressible_value.size());
+    }
+    db.close();
+
+    EXPECT_TRUE(db.open(config.c_str()));
+    blobs_collection_t main = db.main();
+    check_values(main);
+    db.close();
 }
 
-TEST(db, set_wrong_snapshot) {
+#endif
+
+#if defined(USTORE_ENGINE_IS_SHARDED)
 
+/**
+ * Hash partitioning scatters the neighboring keys across shards,
+ * so every scan has to merge the sorted outputs of all of them.
+ */
+TEST(db, sharded_scan_merge) {
     database_t db;
     EXPECT_TRUE(db.open(config().c_str()));
-    if (!db.supports_snapshots())
-        return;
     EXPECT_TRUE(db.clear());
-
-    triplet_t triplet;
+    EXPECT_FALSE(db.supports_transactions());
     blobs_collection_t collection = db.main();
-    auto collection_ref = collection[triplet.keys];
-
-    check_length(collection_ref, ustore_length_missing_k);
-    round_trip(collection_ref, triplet);
 
-    auto snap = *db.snapshot();
-
-    auto snap_ref = snap[triplet.keys];
-    check_equalities(snap_ref, triplet);
+    std::vector<ustore_key_t> keys;
+    for (ustore_key_t k = -500; k != 1000; k += 3)
+        keys.push_back(k);
+    EXPECT_TRUE(collection[keys].assign(value_view_t("value")));
 
-    auto snapshots = snap.snapshots();
-    auto snaps = *snapshots;
-    EXPECT_EQ(snaps.size(), 1u);
+    keys_stream_t stream(db, collection, 64);
+    EXPECT_TRUE(stream.seek_to_first());
+    std::size_t idx = 0;
+    for (; !stream.is_end(); ++stream, ++idx)
+        EXPECT_EQ(stream.key(), keys[idx]);
+    EXPECT_EQ(idx, keys.size());
+
+    EXPECT_TRUE(stream.seek(101));
+    EXPECT_EQ(stream.key(), 103);
+    EXPECT_EQ(collection.keys().size(), keys.size());
+}
 
-    auto snapshot = snap.snap();
+/**
+ * Range partitioning with boundaries, given both as numbers and as strings.
+ * Keys around the boundaries must be found, scanned in order and persisted,
+ * and malformed boundaries must be rejected.
+ */
+TEST(db, sharded_range_partitioning) {
+    if (!path())
+        return;
+    std::string directory = std::string(path()) + "/sharded_range";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    auto range_config = [&](char const* boundaries) {
+        return fmt::format( //
+            R"({{"version": "1.0", "directory": "{}", "engine": {{"config": {{"shards": 3, "partitioning": "range", "boundaries": {}}}}}}})",
+            directory,
+            boundaries);
+    };
 
-    ustore_snapshot_t wrong_snap = 1u;
-    snap.set_snapshot(wrong_snap);
+    database_t db;
+    EXPECT_FALSE(db.open(range_config("[200, 100]").c_str()));
+    EXPECT_FALSE(db.open(range_config("[100]").c_str()));
+    EXPECT_FALSE(db.open(range_config(R"([100, "2x0"])").c_str()));
 
-    auto wrong_snap_ref = snap[triplet.keys];
-    EXPECT_FALSE(wrong_snap_ref.value());
+    std::string valid_config = range_config(R"([100, "200"])");
+    EXPECT_TRUE(db.open(valid_config.c_str()));
+    {
+        blobs_collection_t collection = db.main();
+        std::vector<ustore_key_t> keys(300);
+        std::iota(keys.begin(), keys.end(), 0);
+        for (ustore_key_t key : keys)
+            EXPECT_TRUE(collection[key].assign(std::to_string(key).c_str()));
+
+        keys_stream_t stream(db, collection, 32);
+        EXPECT_TRUE(stream.seek(90));
+        for (ustore_key_t key = 90; key != 300; ++key, ++stream)
+            EXPECT_EQ(stream.key(), key);
+        EXPECT_TRUE(stream.is_end());
+    }
+    db.close();
 
-    snap.set_snapshot(snapshot);
-    auto right_snap_ref = snap[triplet.keys];
-    EXPECT_TRUE(right_snap_ref.value());
+    EXPECT_TRUE(db.open(valid_config.c_str()));
+    blobs_collection_t collection = db.main();
+    EXPECT_EQ(collection.keys().size(), 300ul);
+    for (ustore_key_t key : {0, 99, 100, 199, 200, 299})
+        EXPECT_EQ(*collection[key].value(), std::to_string(key));
+    db.close();
 }
 
 /**
- * Exports snapshot as a database, loads and checks contents
+ * Transactions, that have touched many shards, are staged in all of them before any is
+ * committed. A conflict in the second shard must fail the whole commit, leaving the first
+ * shard unchanged, and the transaction must be reset before it is used again.
  */
-TEST(db, export_snapshot) {
+TEST(db, sharded_transaction_conflict) {
     if (!path())
         return;
+    std::string directory = std::string(path()) + "/sharded_txn";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    std::string config = fmt::format( //
+        R"({{"version": "1.0", "directory": "{}", "engine": {{"config": {{"shards": 2, "partitioning": "range", "boundaries": [1000]}}}}}})",
+        directory);
 
     database_t db;
-    std::string dir = fmt::format("{}/original/", path());
-    std::string dir1 = fmt::format("{}/export1/", path());
-    std::string dir2 = fmt::format("{}/export2/", path());
-    auto config = fmt::format(R"({{"version": "1.0", "directory": "{}"}})", dir);
-    std::filesystem::remove_all(dir);
-    std::filesystem::remove_all(dir1);
-    std::filesystem::remove_all(dir2);
-    std::filesystem::create_directory(dir);
-    std::filesystem::create_directory(dir1);
-    std::filesystem::create_directory(dir2);
-
     EXPECT_TRUE(db.open(config.c_str()));
-    if (!db.supports_snapshots())
-        return;
     EXPECT_TRUE(db.clear());
+    transaction_t txn1 = *db.transact();
+    transaction_t txn2 = *db.transact();
 
-    triplet_t triplet;
-    triplet_t triplet_same_v;
-    triplet_same_v.vals = {'D', 'D', 'D'};
-
-    blobs_collection_t collection = db.main();
-    auto collection_ref = collection[triplet.keys];
-    round_trip(collection_ref, triplet);
+    EXPECT_TRUE(txn1.main().at(1).assign("first"));
+    EXPECT_TRUE(txn1.main().at(2000).assign("first"));
+    EXPECT_TRUE(txn2.main().at(2000).assign("second"));
+    EXPECT_TRUE(txn2.commit());
+    EXPECT_FALSE(txn1.commit());
+    EXPECT_FALSE(txn1.commit());
 
-    // Export snapshot
-    auto snap1 = *db.snapshot();
-    EXPECT_TRUE(snap1.export_to(dir1.c_str()));
-    check_equalities(collection_ref, triplet);
+    blobs_collection_t main = db.main();
+    EXPECT_FALSE(*main[1].present());
+    EXPECT_EQ(*main[2000].value(), "second");
+
+    // After a reset, the same keys can be written again
+    EXPECT_TRUE(txn1.reset());
+    EXPECT_TRUE(txn1.main().at(1).assign("third"));
+    EXPECT_TRUE(txn1.main().at(2000).assign("third"));
+    if (txn1.commit()) {
+        EXPECT_EQ(*main[1].value(), "third");
+        EXPECT_EQ(*main[2000].value(), "third");
+    }
+    else
+        EXPECT_FALSE(*main[1].present());
+    db.close();
+}
 
-    // Load exported snapshot
-    database_t db1;
-    config = fmt::format(R"({{"version": "1.0", "directory": "{}"}})", dir1);
-    EXPECT_TRUE(db1.open(config.c_str()));
-    // Check values
-    auto collection1 = db1.main();
-    auto collection_ref1 = collection1[triplet.keys];
-    check_equalities(collection_ref1, triplet);
+/**
+ * Named collections exist in every shard, possibly under different IDs.
+ * After reopening, they must be matched by name, listed once and dropped everywhere.
+ */
+TEST(db, sharded_collections_sync) {
+    if (!path())
+        return;
 
-    // Change original
-    round_trip(collection_ref, triplet_same_v);
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+    {
+        blobs_collection_t first = *db.create("first");
+        blobs_collection_t second = *db.create("second");
+        std::vector<ustore_key_t> keys(100);
+        std::iota(keys.begin(), keys.end(), 0);
+        EXPECT_TRUE(first[keys].assign(value_view_t("first")));
+        EXPECT_TRUE(second[keys].assign(value_view_t("second")));
+        EXPECT_TRUE(db.drop("first"));
+    }
+    db.close();
 
-    // Export one more snapshot
-    auto snap2 = *db.snapshot();
-    EXPECT_TRUE(snap2.export_to(dir2.c_str()));
-    check_equalities(collection_ref, triplet_same_v);
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_FALSE(*db.contains("first"));
+    EXPECT_TRUE(*db.contains("second"));
+
+    auto cols = *db.collections();
+    std::size_t count = 0;
+    for (; !cols.names.is_end(); ++cols.names, ++count)
+        EXPECT_EQ(std::string(*cols.names), "second");
+    EXPECT_EQ(count, 1ul);
+
+    blobs_collection_t second = *db["second"];
+    EXPECT_EQ(second.keys().size(), 100ul);
+    EXPECT_EQ(*second[42].value(), "second");
+    EXPECT_TRUE(db.drop("second"));
+    db.close();
+}
 
-    // Load second exported snapshot
-    database_t db2;
-    config = fmt::format(R"({{"version": "1.0", "directory": "{}"}})", dir2);
-    EXPECT_TRUE(db2.open(config.c_str()));
-    // Check values
-    auto collection2 = db2.main();
-    auto collection_ref2 = collection2[triplet_same_v.keys];
-    check_equalities(collection_ref2, triplet_same_v);
+#endif
 
-    // Check snapshots
-    check_equalities(collection_ref1, triplet);
-    check_equalities(collection_ref2, triplet_same_v);
-    // Change snapshots
-    round_trip(collection_ref1, triplet_same_v);
-    round_trip(collection_ref2, triplet);
-    // Check snapshots
-    check_equalities(collection_ref1, triplet_same_v);
-    check_equalities(collection_ref2, triplet);
-}
+#if defined(USTORE_ENGINE_IS_ROCKSDB)
 
 /**
- * Creates news collection under unique names.
- * Fill data in collection. Checking/dropping/checking collection data by thread.
+ * Every named collection starts its storage paths from a different data directory,
+ * picked by the hash of its name, so the flushed tables are striped across all of them.
+ * The names below are chosen to cover all four directories.
  */
-TEST(db, snapshot_with_threads) {
-    database_t db;
-    EXPECT_TRUE(db.open(config().c_str()));
-    if (!db.supports_snapshots())
+TEST(db, rocksdb_paths_striping) {
+    if (!path())
         return;
-    EXPECT_TRUE(db.clear());
-
-    triplet_t triplet;
-    triplet_t triplet_same_v;
-    triplet_same_v.vals = {'D', 'D', 'D'};
-
-    blobs_collection_t collection = db.main();
-    auto ref = collection[triplet.keys];
-    round_trip(ref, triplet);
+    namespace stdfs = std::filesystem;
+    std::string directory = std::string(path()) + "/striping";
+    stdfs::remove_all(directory);
+
+    std::vector<std::string> disks;
+    std::string disks_json;
+    for (std::size_t i = 0; i != 4; ++i) {
+        disks.push_back(fmt::format("{}/disk_{}", directory, i));
+        stdfs::create_directories(disks.back());
+        disks_json += fmt::format(R"({}{{"path": "{}"}})", i ? ", " : "", disks.back());
+    }
+    std::string config = fmt::format( //
+        R"({{"version": "1.0", "directory": "{}", "data_directories": [{}]}})",
+        directory,
+        disks_json);
 
-    auto snap = *db.snapshot();
-    auto snap_ref = snap[triplet.keys];
+    // Unless flushed explicitly, writes skip the WAL, so closing flushes the memtables
+    std::array<ustore_key_t, 3> keys {1, 2, 3};
+    database_t db;
+    EXPECT_TRUE(db.open(config.c_str()));
+    for (std::size_t i = 0; i != 8; ++i) {
+        blobs_collection_t collection = *db[fmt::format("stripe_{}", i).c_str()];
+        EXPECT_TRUE(collection[keys].assign("value"));
+    }
+    db.close();
 
-    round_trip(ref, triplet_same_v);
+    for (auto const& disk : disks) {
+        std::size_t tables = 0;
+        for (auto const& entry : stdfs::directory_iterator(disk))
+            tables += entry.path().extension() == ".sst";
+        EXPECT_GT(tables, 0ul) << disk;
+    }
 
-    std::shared_mutex mutex;
-    bool is_deleted = false;
-    auto task_read = [&]() {
-        while (true) {
-            std::shared_lock _ {mutex};
-            if (is_deleted) {
-                auto ref = snap[triplet.keys];
-                check_equalities(ref, triplet_same_v);
-                break;
-            }
-            check_equalities(snap_ref, triplet);
-        }
-    };
+    // The same paths must be derived after a restart, for the tables to be found
+    EXPECT_TRUE(db.open(config.c_str()));
+    for (std::size_t i = 0; i != 8; ++i) {
+        blobs_collection_t collection = *db[fmt::format("stripe_{}", i).c_str()];
+        EXPECT_EQ(collection.keys().size(), keys.size());
+        EXPECT_EQ(*collection[2].value(), "value");
+    }
+    EXPECT_TRUE(db.clear());
+    db.close();
+}
 
-    auto task_reset = [&]() {
-        std::unique_lock _ {mutex};
-        snap.set_snapshot(0);
-        is_deleted = true;
-    };
+#endif
 
-    std::thread t1(task_read);
-    std::thread t2(task_reset);
-    t1.join();
-    t2.join();
-}
+/**
+ * Bulk writes may be ingested as pre-sorted files, bypassing the regular
+ * write path, but must preserve the batch order for repeated keys.
+ */
+TEST(db, write_bulk) {
 
-TEST(db, transaction_erase_missing) {
     database_t db;
     EXPECT_TRUE(db.open(config().c_str()));
-    if (!db.supports_transactions())
-        return;
     EXPECT_TRUE(db.clear());
-    EXPECT_TRUE(db.transact());
-    transaction_t txn1 = *db.transact();
-    transaction_t txn2 = *db.transact();
+    blobs_collection_t collection = db.main();
+    collection[9] = "old";
 
-    EXPECT_TRUE(txn2.main().at(-7297309151944849401).erase());
-    EXPECT_TRUE(txn1.main().at(-8640850744835793378).erase());
-    EXPECT_TRUE(txn1.commit());
-    EXPECT_TRUE(txn2.commit());
+    constexpr std::size_t tasks_count = 6;
+    std::array<ustore_key_t, tasks_count> keys {5, 3, 5, 7, 3, 9};
+    std::array<char const*, tasks_count> values {"a", "b", "c", "d", nullptr, "new"};
+    std::array<ustore_length_t, tasks_count> lengths {1, 1, 1, 1, ustore_length_missing_k, 3};
 
-    EXPECT_EQ(db.main().at(-8640850744835793378).value(), value_view_t {});
-    EXPECT_EQ(db.main().at(-7297309151944849401).value(), value_view_t {});
-    EXPECT_EQ(db.main().keys().size(), 0u);
+    status_t status {};
+    ustore_write_t write {};
+    write.db = db;
+    write.error = status.member_ptr();
+    write.options = ustore_option_write_bulk_k;
+    write.tasks_count = tasks_count;
+    write.keys = keys.data();
+    write.keys_stride = sizeof(ustore_key_t);
+    write.lengths = lengths.data();
+    write.lengths_stride = sizeof(ustore_length_t);
+    write.values = reinterpret_cast<ustore_bytes_cptr_t const*>(values.data());
+    write.values_stride = sizeof(char const*);
+    ustore_write(&write);
+    EXPECT_TRUE(status);
+
+    EXPECT_EQ(*collection[5].value(), "c");
+    EXPECT_EQ(*collection[7].value(), "d");
+    EXPECT_EQ(*collection[9].value(), "new");
+    EXPECT_EQ(collection.keys().size(), 3ul);
 }
 
-TEST(db, transaction_write_conflicting) {
+#if !defined(USTORE_ENGINE_IS_UDISK)
+
+/**
+ * Range erasures remove the half-open range without touching its neighbors,
+ * and ignore empty ranges.
+ */
+TEST(db, erase_range) {
+
     database_t db;
     EXPECT_TRUE(db.open(config().c_str()));
-    if (!db.supports_transactions())
-        return;
     EXPECT_TRUE(db.clear());
-    EXPECT_TRUE(db.transact());
-    transaction_t txn1 = *db.transact();
-    transaction_t txn2 = *db.transact();
+    blobs_collection_t collection = db.main();
 
-    EXPECT_TRUE(txn2.main().at(6).assign("a"));
-    EXPECT_TRUE(txn1.main().at(6).assign("b"));
-    EXPECT_TRUE(txn1.commit());
-    EXPECT_FALSE(txn2.commit());
+    std::vector<ustore_key_t> keys(10);
+    std::iota(std::begin(keys), std::end(keys), 1);
+    EXPECT_TRUE(collection[keys].assign(value_view_t("value")));
+
+    EXPECT_TRUE(collection.members(3, 7).erase());
+    EXPECT_TRUE(collection.members(9, 9).erase());
+    EXPECT_EQ(collection.keys().size(), 6ul);
+    for (ustore_key_t key : keys)
+        EXPECT_EQ(*collection[key].present(), key < 3 || key >= 7);
+
+    // Ranges in one batch may overlap
+    std::array<ustore_key_t, 2> start_keys {1, 2};
+    std::array<ustore_key_t, 2> end_keys {3, 8};
+    status_t status;
+    ustore_erase_range_t erase {};
+    erase.db = db;
+    erase.error = status.member_ptr();
+    erase.tasks_count = 2;
+    erase.start_keys = start_keys.data();
+    erase.start_keys_stride = sizeof(ustore_key_t);
+    erase.end_keys = end_keys.data();
+    erase.end_keys_stride = sizeof(ustore_key_t);
+    ustore_erase_range(&erase);
+    EXPECT_TRUE(status);
+    EXPECT_EQ(collection.keys().size(), 3ul);
+    EXPECT_EQ(*collection[8].value(), "value");
 }
 
+#endif
+
 /**
- *
+ * Checks the "Read Commited" consistency guarantees of transactions.
+ * Readers can't see the contents of pending (not committed) transactions.
+ * https://jepsen.io/consistency/models/read-committed
  */
-TEST(db, transaction_sequenced_commit) {
+TEST(db, transaction_read_commited) {
     database_t db;
     EXPECT_TRUE(db.open(config().c_str()));
     if (!db.supports_transactions())
         return;
     EXPECT_TRUE(db.clear());
-
     EXPECT_TRUE(db.transact());
     transaction_t txn = *db.transact();
 
     triplet_t triplet;
+
     auto txn_ref = txn[triplet.keys];
+    round_trip(txn_ref, triplet);
 
-    EXPECT_TRUE(txn_ref.assign(triplet.contents()));
-    auto maybe_sequence_number = txn.sequenced_commit();
-    EXPECT_TRUE(maybe_sequence_number);
-    auto current_sequence_number = *maybe_sequence_number;
-    EXPECT_GT(current_sequence_number, 0);
-    EXPECT_TRUE(txn.reset());
-#if 0
-    auto previous_sequence_number = current_sequence_number;
-    EXPECT_TRUE(txn_ref.value());
-    maybe_sequence_number = txn.sequenced_commit();
-    EXPECT_TRUE(maybe_sequence_number);
-    current_sequence_number = *maybe_sequence_number;
-    EXPECT_EQ(current_sequence_number, previous_sequence_number);
+    blobs_collection_t collection = db.main();
+    auto collection_ref = collection[triplet.keys];
+
+    // Check for missing values before commit
+    check_length(collection_ref, ustore_length_missing_k);
+    EXPECT_TRUE(txn.commit());
     EXPECT_TRUE(txn.reset());
 
-    previous_sequence_number = current_sequence_number;
-    EXPECT_TRUE(txn_ref.assign(triplet.contents()));
-    maybe_sequence_number = txn.sequenced_commit();
-    EXPECT_TRUE(maybe_sequence_number);
-    current_sequence_number = *maybe_sequence_number;
-    EXPECT_GT(current_sequence_number, previous_sequence_number);
-#endif
+    // Validate that values match after commit
+    check_equalities(collection_ref, triplet);
 }
 
-#pragma region Paths Modality
-
 /**
- * Tests "Paths" Modality, with variable length keys.
- * Reads, writes, prefix matching and pattern matching.
+ * Checks the "Snapshot Isolation" consistency guarantees of transactions.
+ * If needed, readers can initiate snapshot-backed transactions.
+ * All the reads, directed to that snapshot will not see newer operations,
+ * affecting the HEAD state. From a consistency standpoint, it is a downgrade
+ * from "Strictly Serializable" ACID transactions, but it is extremely useful
+ * for numerous Business Intelligence applications.
+ * https://jepsen.io/consistency/models/snapshot-isolation
  */
-TEST(db, paths) {
-
+TEST(db, transaction_snapshot_isolation) {
     database_t db;
     EXPECT_TRUE(db.open(config().c_str()));
+    if (!db.supports_snapshots())
+        return;
     EXPECT_TRUE(db.clear());
 
-    char const* keys[] {"Facebook", "Apple", "Amazon", "Netflix", "Google", "Nvidia", "Adobe"};
-    char const* vals[] {"F", "A", "A", "N", "G", "N", "A"};
-    std::size_t keys_count = sizeof(keys) / sizeof(keys[0]);
-    ustore_char_t separator = '\0';
-
-    arena_t arena(db);
-    status_t status {};
-    ustore_paths_write_t paths_write {};
-    paths_write.db = db;
-    paths_write.error = status.member_ptr();
-    paths_write.arena = arena.member_ptr();
-    paths_write.tasks_count = keys_count;
-    paths_write.path_separator = separator;
-    paths_write.paths = keys;
-    paths_write.paths_stride = sizeof(char const*);
-    paths_write.values_bytes = reinterpret_cast<ustore_bytes_cptr_t*>(vals);
-    paths_write.values_bytes_stride = sizeof(char const*);
+    triplet_t triplet;
+    triplet_t triplet_same_v;
+    triplet_same_v.vals = {'D', 'D', 'D'};
 
-    ustore_paths_write(&paths_write);
-    char* vals_recovered {};
-    ustore_paths_read_t paths_read {};
-    paths_read.db = db;
-    paths_read.error = status.member_ptr();
-    paths_read.arena = arena.member_ptr();
-    paths_read.tasks_count = keys_count;
-    paths_read.path_separator = separator;
-    paths_read.paths = keys;
-    paths_read.paths_stride = sizeof(char const*);
-    paths_read.values = reinterpret_cast<ustore_bytes_ptr_t*>(&vals_recovered);
+    blobs_collection_t collection = db.main();
+    auto collection_ref = collection[triplet.keys];
 
-    ustore_paths_read(&paths_read);
-    EXPECT_TRUE(status);
-    EXPECT_EQ(std::string_view(vals_recovered, keys_count * 2),
-              std::string_view("F\0A\0A\0N\0G\0N\0A\0", keys_count * 2));
+    check_length(collection_ref, ustore_length_missing_k);
+    round_trip(collection_ref, triplet);
 
-    // Try getting either "Netflix" or "Nvidia" as one of the keys with "N" prefix
-    ustore_str_view_t prefix = "N";
-    ustore_length_t max_count = 1;
-    ustore_length_t* results_counts {};
-    ustore_length_t* tape_offsets {};
-    ustore_char_t* tape_begin {};
-    ustore_paths_match_t paths_match {};
-    paths_match.db = db;
-    paths_match.error = status.member_ptr();
-    paths_match.arena = arena.member_ptr();
-    paths_match.tasks_count = 1;
-    paths_match.match_counts_limits = &max_count;
-    paths_match.patterns = &prefix;
-    paths_match.match_counts = &results_counts;
-    paths_match.paths_offsets = &tape_offsets;
-    paths_match.paths_strings = &tape_begin;
+    auto snap = *db.snapshot();
+    auto snap_ref = snap[triplet.keys];
+    round_trip(snap_ref, triplet);
+    round_trip(collection_ref, triplet_same_v);
 
-    ustore_paths_match(&paths_match);
-    auto first_match_for_a = std::string_view(tape_begin);
-    EXPECT_EQ(results_counts[0], 1);
-    EXPECT_TRUE(first_match_for_a == "Netflix" || first_match_for_a == "Nvidia");
+    // Validate that values match
+    auto maybe_retrieved = snap_ref.value();
+    auto const& retrieved = *maybe_retrieved;
+    auto it = retrieved.begin();
+    auto cont = triplet_same_v.contents_full();
+    for (std::size_t i = 0; i != cont.size(); ++i, ++it) {
+        auto expected_len = cont[i].size();
+        auto expected_begin = cont[i].begin();
 
-    // Try getting the remaining results, which is the other one from that same pair
-    max_count = 10;
-    paths_match.previous = &tape_begin;
-    paths_match.options = ustore_option_dont_discard_memory_k;
-    ustore_paths_match(&paths_match);
-    auto second_match_for_a = std::string_view(tape_begin);
-    EXPECT_EQ(results_counts[0], 1);
-    EXPECT_TRUE(second_match_for_a == "Netflix" || second_match_for_a == "Nvidia");
-    EXPECT_NE(first_match_for_a, second_match_for_a);
-
-    // Try performing parallel queries in the same collection
-    ustore_str_view_t prefixes[2] = {"A", "N"};
-    std::size_t prefixes_count = sizeof(prefixes) / sizeof(prefixes[0]);
-    max_count = 10;
-    paths_match.tasks_count = prefixes_count;
-    paths_match.patterns = prefixes;
-    paths_match.patterns_stride = sizeof(ustore_str_view_t);
-    paths_match.previous = nullptr;
-    ustore_paths_match(&paths_match);
-    auto total_count = std::accumulate(results_counts, results_counts + prefixes_count, 0ul);
-    strings_tape_iterator_t tape_iterator {total_count, tape_begin};
-    std::set<std::string> tape_parts;
-    while (!tape_iterator.is_end()) {
-        tape_parts.insert(*tape_iterator);
-        ++tape_iterator;
+        value_view_t retrieved_view = *it;
+        value_view_t expected_view(expected_begin, expected_begin + expected_len);
+        EXPECT_EQ(retrieved_view.size(), expected_view.size());
+        EXPECT_NE(retrieved_view, expected_view);
     }
-    EXPECT_EQ(results_counts[0], 3);
-    EXPECT_EQ(results_counts[1], 2);
-    EXPECT_NE(tape_parts.find("Netflix"), tape_parts.end());
-    EXPECT_NE(tape_parts.find("Adobe"), tape_parts.end());
 
-    // Now try matching a Regular Expression
-    prefix = "Netflix|Google";
-    paths_match.tasks_count = 1;
-    paths_match.patterns = &prefix;
-    ustore_paths_match(&paths_match);
-    first_match_for_a = std::string_view(tape_begin);
-    second_match_for_a = std::string_view(tape_begin + tape_offsets[1]);
-    EXPECT_EQ(results_counts[0], 2);
-    EXPECT_TRUE(first_match_for_a == "Netflix" || first_match_for_a == "Google");
-    EXPECT_TRUE(second_match_for_a == "Netflix" || second_match_for_a == "Google");
+    snap = *db.snapshot();
+    auto ref = snap[triplet_same_v.keys];
+    round_trip(ref, triplet_same_v);
+}
 
-    // Try a more complex regular expression
-    prefix = "A.*e";
-    ustore_paths_match(&paths_match);
-    first_match_for_a = std::string_view(tape_begin);
-    second_match_for_a = std::string_view(tape_begin + tape_offsets[1]);
-    EXPECT_EQ(results_counts[0], 2);
-    EXPECT_TRUE(first_match_for_a == "Apple" || first_match_for_a == "Adobe");
-    EXPECT_TRUE(second_match_for_a == "Apple" || second_match_for_a == "Adobe");
+TEST(db, snapshots_list) {
 
-    // Existing single letter prefix
-    prefix = "A";
-    ustore_paths_match(&paths_match);
-    first_match_for_a = std::string_view(tape_begin);
-    second_match_for_a = std::string_view(tape_begin + tape_offsets[1]);
-    EXPECT_EQ(results_counts[0], 3);
-    EXPECT_TRUE(first_match_for_a == "Apple" || first_match_for_a == "Adobe" || first_match_for_a == "Amazon");
-    EXPECT_TRUE(second_match_for_a == "Apple" || second_match_for_a == "Adobe" || second_match_for_a == "Amazon");
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    if (!db.supports_snapshots())
+        return;
+    EXPECT_TRUE(db.clear());
 
-    // Missing single letter prefix
-    prefix = "X";
-    ustore_paths_match(&paths_match);
-    EXPECT_EQ(results_counts[0], 0);
-    EXPECT_EQ(*paths_match.error, nullptr);
+    auto snap_1 = *db.snapshot();
+    auto snapshots = snap_1.snapshots();
+    auto snaps = *snapshots;
 
-    // Missing pattern
-    prefix = "X.*";
-    ustore_paths_match(&paths_match);
-    EXPECT_EQ(results_counts[0], 0);
-    EXPECT_EQ(*paths_match.error, nullptr);
+    EXPECT_EQ(snaps.size(), 1u);
 
-    // Try a more complex regular expression
-    prefix = "oo:18:\\*";
-    ustore_paths_match(&paths_match);
-    EXPECT_EQ(results_counts[0], 0);
-    EXPECT_EQ(*paths_match.error, nullptr);
+    auto snap_2 = *db.snapshot();
+    snapshots = snap_2.snapshots();
+    snaps = *snapshots;
+    EXPECT_EQ(snaps.size(), 2u);
 
-    // Try an even more complex regular expression
-    prefix = "oo:18:\\\\*";
-    ustore_paths_match(&paths_match);
-    EXPECT_EQ(results_counts[0], 0);
-    EXPECT_EQ(*paths_match.error, nullptr);
+    auto snap_3 = *db.snapshot();
+    snapshots = snap_3.snapshots();
+    snaps = *snapshots;
+
+    EXPECT_EQ(snaps.size(), 3u);
+
+    snap_1 = *db.snapshot();
+    snapshots = snap_1.snapshots();
+    snaps = *snapshots;
+    EXPECT_EQ(snaps.size(), 4u);
 
     EXPECT_TRUE(db.clear());
 
-    // Try an even more complex regular expression on empty DB
-    prefix = "oo:18:\\\\*";
-    ustore_paths_match(&paths_match);
-    EXPECT_EQ(results_counts[0], 0);
-    EXPECT_EQ(*paths_match.error, nullptr);
+    snapshots = snap_1.snapshots();
+    snaps = *snapshots;
+    EXPECT_EQ(snaps.size(), 0u);
 }
 
-/**
- * Tests "Paths" Modality, by forming bidirectional linked lists from string-to-string mappings.
- * Uses different-length unique strings. As the underlying modality may be implemented as a bucketed hash-map,
- * this test helps catch problems in bucket reorganization.
- */
-TEST(db, paths_linked_list) {
-    constexpr std::size_t count = 1000;
+TEST(db, transaction_with_snapshot) {
+
     database_t db;
     EXPECT_TRUE(db.open(config().c_str()));
+    if (!db.supports_snapshots())
+        return;
     EXPECT_TRUE(db.clear());
 
-    arena_t arena(db);
-    ustore_char_t separator = '\0';
-    status_t status;
+    triplet_t triplet;
+    triplet_t triplet_same_v;
+    triplet_same_v.vals = {'D', 'D', 'D'};
 
-    ustore_paths_write_t paths_write {};
-    paths_write.db = db;
-    paths_write.error = status.member_ptr();
-    paths_write.arena = arena.member_ptr();
-    paths_write.tasks_count = 1;
-    paths_write.path_separator = separator;
+    blobs_collection_t collection = db.main();
+    auto collection_ref = collection[triplet.keys];
 
-    ustore_paths_read_t paths_read {};
-    paths_read.db = db;
-    paths_read.error = status.member_ptr();
-    paths_read.arena = arena.member_ptr();
-    paths_read.tasks_count = 1;
-    paths_read.path_separator = separator;
+    check_length(collection_ref, ustore_length_missing_k);
+    round_trip(collection_ref, triplet);
 
-    // Generate some random strings for our tests
-    constexpr auto alphabet = "abcdefghijklmnop";
-    auto make_random_str = []() {
-        auto str = std::string();
-        auto len = static_cast<std::size_t>(std::rand() % 100) + 8;
-        for (std::size_t i = 0; i != len; ++i)
-            str.push_back(alphabet[std::rand() % 16]);
-        return str;
-    };
-    std::set<std::string> unique;
-    while (unique.size() != count)
-        unique.insert(make_random_str());
+    auto snap = *db.snapshot();
+    auto snap_ref = snap[triplet.keys];
+    check_equalities(snap_ref, triplet);
 
-    // Lets form a linked list, where every key maps into the the next key.
-    // Then we will traverse the linked list from start to end.
-    // Then we will re-link it in reverse order and traverse again.
-    std::vector<ustore_str_view_t> begins(unique.size());
-    std::transform(unique.begin(), unique.end(), begins.begin(), [](std::string const& str) { return str.c_str(); });
+    round_trip(collection_ref, triplet_same_v);
 
-    // Link forward
-    for (std::size_t i = 0; i + 1 != begins.size(); ++i) {
-        ustore_str_view_t smaller = begins[i];
-        ustore_str_view_t bigger = begins[i + 1];
-        paths_write.paths = &smaller;
-        paths_write.values_bytes = reinterpret_cast<ustore_bytes_cptr_t*>(&bigger);
-        ustore_paths_write(&paths_write);
-        EXPECT_TRUE(status);
+    transaction_t txn = *db.transact();
+    auto txn_ref_1 = txn[triplet.keys];
+    check_equalities(txn_ref_1, triplet_same_v);
 
-        // Check if it was successfully written:
-        ustore_str_span_t bigger_received = nullptr;
-        paths_read.paths = &smaller;
-        paths_read.values = reinterpret_cast<ustore_bytes_ptr_t*>(&bigger_received);
-        ustore_paths_read(&paths_read);
-        EXPECT_TRUE(status);
-        EXPECT_EQ(std::string_view(bigger), std::string_view(bigger_received));
-    }
+    txn.set_snapshot(snap.snap());
+    auto txn_ref_2 = txn[triplet.keys];
+    check_equalities(txn_ref_2, triplet);
 
-    // Traverse forward, counting the entries and checking the order
-    for (std::size_t i = 0; i + 1 != begins.size(); ++i) {
-        ustore_str_view_t smaller = begins[i];
-        ustore_str_view_t bigger = begins[i + 1];
-        ustore_str_span_t bigger_received = nullptr;
-        paths_read.paths = &smaller;
-        paths_read.values = reinterpret_cast<ustore_bytes_ptr_t*>(&bigger_received);
-        ustore_paths_read(&paths_read);
-        EXPECT_TRUE(status);
-        EXPECT_EQ(std::string_view(bigger), std::string_view(bigger_received));
-    }
+    snap = *db.snapshot();
+    txn.set_snapshot(snap.snap());
 
-    // Re-link in reverse order
-    for (std::size_t i = 0; i + 1 != begins.size(); ++i) {
-        ustore_str_view_t smaller = begins[i];
-        ustore_str_view_t bigger = begins[i + 1];
-        paths_write.paths = &bigger;
-        paths_write.values_bytes = reinterpret_cast<ustore_bytes_cptr_t*>(&smaller);
-        ustore_paths_write(&paths_write);
-        EXPECT_TRUE(status);
+    auto txn_ref_3 = txn[triplet.keys];
+    check_equalities(txn_ref_3, triplet_same_v);
+}
 
-        // Check if it was successfully over-written:
-        ustore_str_span_t smaller_received = nullptr;
-        paths_read.paths = &bigger;
-        paths_read.values = reinterpret_cast<ustore_bytes_ptr_t*>(&smaller_received);
-        ustore_paths_read(&paths_read);
-        EXPECT_TRUE(status);
-        EXPECT_EQ(std::string_view(smaller), std::string_view(smaller_received));
-    }
+TEST(db, set_wrong_snapshot) {
 
-    // Traverse backwards, counting the entries and checking the order
-    for (std::size_t i = 0; i + 1 != begins.size(); ++i) {
-        ustore_str_view_t smaller = begins[i];
-        ustore_str_view_t bigger = begins[i + 1];
-        ustore_str_span_t smaller_received = nullptr;
-        paths_read.paths = &bigger;
-        paths_read.values = reinterpret_cast<ustore_bytes_ptr_t*>(&smaller_received);
-        ustore_paths_read(&paths_read);
-        EXPECT_TRUE(status);
-        EXPECT_EQ(std::string_view(smaller), std::string_view(smaller_received));
-    }
-}
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    if (!db.supports_snapshots())
+        return;
+    EXPECT_TRUE(db.clear());
 
-#pragma region Documents Modality
+    triplet_t triplet;
+    blobs_collection_t collection = db.main();
+    auto collection_ref = collection[triplet.keys];
 
-std::vector<std::string> make_three_flat_docs() {
-    auto json1 = R"( {"person": "Alice", "age": 24} )"_json.dump();
-    auto json2 = R"( {"person": "Bob", "age": 25} )"_json.dump();
-    auto json3 = R"( {"person": "Carl", "age": 26} )"_json.dump();
-    return {json1, json2, json3};
-}
+    check_length(collection_ref, ustore_length_missing_k);
+    round_trip(collection_ref, triplet);
 
-std::vector<std::string> make_three_nested_docs() {
-    auto json1 = R"( {"person": {"name":"Alice", "age": 24}} )"_json.dump();
-    auto json2 = R"( {"person": [{"name":"Bob", "age": 25}]} )"_json.dump();
-    auto json3 = R"( {"person": "Carl", "age": 26} )"_json.dump();
-    return {json1, json2, json3};
+    auto snap = *db.snapshot();
+
+    auto snap_ref = snap[triplet.keys];
+    check_equalities(snap_ref, triplet);
+
+    auto snapshots = snap.snapshots();
+    auto snaps = *snapshots;
+    EXPECT_EQ(snaps.size(), 1u);
+
+    auto snapshot = snap.snap();
+
+    ustore_snapshot_t wrong_snap = 1u;
+    snap.set_snapshot(wrong_snap);
+
+    auto wrong_snap_ref = snap[triplet.keys];
+    EXPECT_FALSE(wrong_snap_ref.value());
+
+    snap.set_snapshot(snapshot);
+    auto right_snap_ref = snap[triplet.keys];
+    EXPECT_TRUE(right_snap_ref.value());
 }
 
 /**
- * Tests "Documents" Modality, mapping integers to structured hierarchical documents.
- * Takes a basic flat JSON document, and checks if it can be imported in JSON, BSON
- * and MessagePack forms, and later be properly accessed at field-level.
+ * Exports snapshot as a database, loads and checks contents
  */
-TEST(db, docs_flat) {
+TEST(db, export_snapshot) {
+    if (!path())
+        return;
 
     database_t db;
-    EXPECT_TRUE(db.open(config().c_str()));
+    std::string dir = fmt::format("{}/original/", path());
+    std::string dir1 = fmt::format("{}/export1/", path());
+    std::string dir2 = fmt::format("{}/export2/", path());
+    auto config = fmt::format(R"({{"version": "1.0", "directory": "{}"}})", dir);
+    std::filesystem::remove_all(dir);
+    std::filesystem::remove_all(dir1);
+    std::filesystem::remove_all(dir2);
+    std::filesystem::create_directory(dir);
+    std::filesystem::create_directory(dir1);
+    std::filesystem::create_directory(dir2);
+
+    EXPECT_TRUE(db.open(config.c_str()));
+    if (!db.supports_snapshots())
+        return;
     EXPECT_TRUE(db.clear());
 
-    // JSON
-    docs_collection_t collection = db.main<docs_collection_t>();
-    auto jsons = make_three_flat_docs();
-    collection[1] = jsons[0].c_str();
-    collection[2] = jsons[1].c_str();
-    collection[3] = jsons[2].c_str();
-    M_EXPECT_EQ_JSON(*collection[1].value(), jsons[0]);
-    M_EXPECT_EQ_JSON(*collection[ckf(2, "person")].value(), "\"Bob\"");
-    M_EXPECT_EQ_JSON(*collection[ckf(3, "age")].value(), "26");
+    triplet_t triplet;
+    triplet_t triplet_same_v;
+    triplet_same_v.vals = {'D', 'D', 'D'};
 
-    // Binary
-    auto maybe_person = collection[ckf(1, "person")].value(ustore_doc_field_str_k);
-    EXPECT_EQ(std::string_view(maybe_person->c_str(), maybe_person->size()), std::string_view("Alice"));
+    blobs_collection_t collection = db.main();
+    auto collection_ref = collection[triplet.keys];
+    round_trip(collection_ref, triplet);
 
-    // BSON
-    bson_error_t error;
-    bson_t* bson = bson_new_from_json((uint8_t*)jsons[0].c_str(), -1, &error);
-    uint8_t const* buffer = bson_get_data(bson);
-    auto view = value_view_t(buffer, bson->len);
-    collection.at(4, ustore_doc_field_bson_k) = view;
-    M_EXPECT_EQ_JSON(*collection[4].value(), jsons[0]);
-    M_EXPECT_EQ_JSON(*collection[ckf(4, "person")].value(), "\"Alice\"");
-    M_EXPECT_EQ_JSON(*collection[ckf(4, "age")].value(), "24");
-    bson_clear(&bson);
+    // Export snapshot
+    auto snap1 = *db.snapshot();
+    EXPECT_TRUE(snap1.export_to(dir1.c_str()));
+    check_equalities(collection_ref, triplet);
 
-    // MsgPack
-    auto message_pack = *collection[1].value(ustore_doc_field_msgpack_k);
-    collection.at(5, ustore_doc_field_msgpack_k) = message_pack;
-    M_EXPECT_EQ_JSON(*collection[5].value(), jsons[0]);
-    M_EXPECT_EQ_JSON(*collection[ckf(5, "person")].value(), "\"Alice\"");
-    M_EXPECT_EQ_JSON(*collection[ckf(5, "age")].value(), "24");
+    // Load exported snapshot
+    database_t db1;
+    config = fmt::format(R"({{"version": "1.0", "directory": "{}"}})", dir1);
+    EXPECT_TRUE(db1.open(config.c_str()));
+    // Check values
+    auto collection1 = db1.main();
+    auto collection_ref1 = collection1[triplet.keys];
+    check_equalities(collection_ref1, triplet);
+
+    // Change original
+    round_trip(collection_ref, triplet_same_v);
+
+    // Export one more snapshot
+    auto snap2 = *db.snapshot();
+    EXPECT_TRUE(snap2.export_to(dir2.c_str()));
+    check_equalities(collection_ref, triplet_same_v);
+
+    // Load second exported snapshot
+    database_t db2;
+    config = fmt::format(R"({{"version": "1.0", "directory": "{}"}})", dir2);
+    EXPECT_TRUE(db2.open(config.c_str()));
+    // Check values
+    auto collection2 = db2.main();
+    auto collection_ref2 = collection2[triplet_same_v.keys];
+    check_equalities(collection_ref2, triplet_same_v);
+
+    // Check snapshots
+    check_equalities(collection_ref1, triplet);
+    check_equalities(collection_ref2, triplet_same_v);
+    // Change snapshots
+    round_trip(collection_ref1, triplet_same_v);
+    round_trip(collection_ref2, triplet);
+    // Check snapshots
+    check_equalities(collection_ref1, triplet_same_v);
+    check_equalities(collection_ref2, triplet);
 }
 
 /**
- * Tries adding 3 simple nested JSONs, using JSON-Pointers
- * to retrieve specific fields across multiple keys.
+ * Creates news collection under unique names.
+ * Fill data in collection. Checking/dropping/checking collection data by thread.
  */
-TEST(db, docs_nested_batch) {
-
+TEST(db, snapshot_with_threads) {
     database_t db;
     EXPECT_TRUE(db.open(config().c_str()));
+    if (!db.supports_snapshots())
+        return;
     EXPECT_TRUE(db.clear());
-    docs_collection_t collection = db.main<docs_collection_t>();
 
-    auto jsons = make_three_nested_docs();
-    std::string continuous_jsons = jsons[0] + jsons[1] + jsons[2];
-    auto vals_begin = reinterpret_cast<ustore_bytes_ptr_t>(continuous_jsons.data());
-    std::array<ustore_length_t, 4> offsets = {
-        0,
-        static_cast<ustore_length_t>(jsons[0].size()),
-        static_cast<ustore_length_t>(jsons[0].size() + jsons[1].size()),
-        static_cast<ustore_length_t>(jsons[0].size() + jsons[1].size() + jsons[2].size()),
-    };
-    contents_arg_t values {};
-    values.offsets_begin = {offsets.data(), sizeof(ustore_length_t)};
-    values.contents_begin = {&vals_begin, 0};
-
-    std::array<ustore_key_t, 3> keys = {1, 2, 3};
-    auto ref = collection[keys];
-    EXPECT_TRUE(ref.assign(values));
-
-    // Read One By One
-    M_EXPECT_EQ_JSON(*collection[1].value(), jsons[0]);
-    M_EXPECT_EQ_JSON(*collection[2].value(), jsons[1]);
-    M_EXPECT_EQ_JSON(*collection[3].value(), jsons[2]);
-
-    auto expected = R"({"name":"Alice", "age": 24})"_json.dump();
-    M_EXPECT_EQ_JSON(*collection[ckf(1, "person")].value(), expected);
-
-    expected = R"([{"name":"Bob", "age": 25}])"_json.dump();
-    M_EXPECT_EQ_JSON(*collection[ckf(2, "person")].value(), expected);
-    M_EXPECT_EQ_JSON(*collection[ckf(2, "/person/0/name")].value(), "\"Bob\"");
+    triplet_t triplet;
+    triplet_t triplet_same_v;
+    triplet_same_v.vals = {'D', 'D', 'D'};
 
-    // Read sorted keys
-    check_equalities(ref, values);
+    blobs_collection_t collection = db.main();
+    auto ref = collection[triplet.keys];
+    round_trip(ref, triplet);
 
-    // Read not sorted keys
-    std::array<ustore_key_t, 3> not_sorted_keys = {1, 3, 2};
-    auto not_sorted_ref = collection[not_sorted_keys];
-    std::string not_sorted_jsons = jsons[0] + jsons[2] + jsons[1];
-    vals_begin = reinterpret_cast<ustore_bytes_ptr_t>(not_sorted_jsons.data());
-    offsets[2] = jsons[0].size() + jsons[2].size();
-    offsets[3] = jsons[0].size() + jsons[2].size() + jsons[1].size();
-    check_equalities(not_sorted_ref, values);
+    auto snap = *db.snapshot();
+    auto snap_ref = snap[triplet.keys];
 
-    // Read duplicate keys
-    std::array<ustore_key_t, 3> duplicate_keys = {1, 2, 1};
-    auto duplicate_ref = collection[duplicate_keys];
-    std::string duplicate_jsons = jsons[0] + jsons[1] + jsons[0];
-    vals_begin = reinterpret_cast<ustore_bytes_ptr_t>(duplicate_jsons.data());
-    offsets[2] = jsons[0].size() + jsons[1].size();
-    offsets[3] = jsons[0].size() + jsons[1].size() + jsons[0].size();
-    check_equalities(duplicate_ref, values);
+    round_trip(ref, triplet_same_v);
 
-    // Read with fields
-    std::array<collection_key_field_t, 3> keys_with_fields = {
-        ckf(1, "person"),
-        ckf(2, "/person/0/name"),
-        ckf(3, "age"),
+    std::shared_mutex mutex;
+    bool is_deleted = false;
+    auto task_read = [&]() {
+        while (true) {
+            std::shared_lock _ {mutex};
+            if (is_deleted) {
+                auto ref = snap[triplet.keys];
+                check_equalities(ref, triplet_same_v);
+                break;
+            }
+            check_equalities(snap_ref, triplet);
+        }
     };
-    auto ref_with_fields = collection[keys_with_fields];
-    auto field_value1 = R"({"name":"Alice", "age": 24})"_json.dump();
-    auto field_value2 = R"("Bob")"_json.dump();
-    auto field_value3 = R"(26)"_json.dump();
-    std::string field_values = field_value1 + field_value2 + field_value3;
-    vals_begin = reinterpret_cast<ustore_bytes_ptr_t>(field_values.data());
-    offsets[1] = field_value1.size();
-    offsets[2] = field_value1.size() + field_value2.size();
-    offsets[3] = field_value1.size() + field_value2.size() + field_value3.size();
-    check_equalities(ref_with_fields, values);
 
-    // Check Invalid Json Write
-    std::string invalid_json = R"({"name":"Alice", } "age": 24})";
-    offsets[1] = jsons[0].size();
-    offsets[2] = jsons[0].size() + jsons[1].size();
-    offsets[3] = jsons[0].size() + jsons[1].size() + invalid_json.size();
-    continuous_jsons = jsons[0] + jsons[1] + invalid_json;
-    vals_begin = reinterpret_cast<ustore_bytes_ptr_t>(continuous_jsons.data());
+    auto task_reset = [&]() {
+        std::unique_lock _ {mutex};
+        snap.set_snapshot(0);
+        is_deleted = true;
+    };
 
-    EXPECT_FALSE(ref.assign(values));
+    std::thread t1(task_read);
+    std::thread t2(task_reset);
+    t1.join();
+    t2.join();
 }
 
 /**
- * Performs basic JSON Paths, JSON Merge-Patches, and sub-document level updates.
+ * Scans a snapshot, while HEAD keeps changing through single writes,
+ * batch writes and transactions, expecting to see only the older state.
  */
-TEST(db, docs_modify) {
+TEST(db, snapshot_scan_after_changes) {
     database_t db;
     EXPECT_TRUE(db.open(config().c_str()));
+    if (!db.supports_snapshots())
+        return;
     EXPECT_TRUE(db.clear());
-    docs_collection_t collection = db.main<docs_collection_t>();
-    auto jsons = make_three_nested_docs();
-    collection[1] = jsons[0].c_str();
-    M_EXPECT_EQ_JSON(*collection[1].value(), jsons[0]);
 
-    // Update
-    auto modifier = R"( {"person": {"name":"Charles", "age": 28}} )"_json.dump();
-    EXPECT_TRUE(collection[1].update(modifier.c_str()));
-    auto result = collection[1].value();
-    M_EXPECT_EQ_JSON(result->c_str(), modifier.c_str());
+    blobs_collection_t collection = db.main();
+    std::array<ustore_key_t, 10> keys;
+    std::iota(std::begin(keys), std::end(keys), 0);
+    EXPECT_TRUE(collection[keys].assign(value_view_t("old")));
 
-    // Update By Field
-    modifier = R"( {"name": "Alice", "age": 24} )"_json.dump();
-    EXPECT_TRUE(collection[ckf(1, "/person")].update(modifier.c_str()));
-    result = collection[1].value();
-    M_EXPECT_EQ_JSON(result->c_str(), jsons[0].c_str());
+    auto snap = *db.snapshot();
+    EXPECT_TRUE(collection.at(3).erase());
+    EXPECT_TRUE(collection.at(20).assign("new"));
+    std::array<ustore_key_t, 2> overwritten_keys {5, 6};
+    EXPECT_TRUE(collection[overwritten_keys].assign(value_view_t("new")));
+    if (db.supports_transactions()) {
+        transaction_t txn = *db.transact();
+        EXPECT_TRUE(txn.main().at(7).assign("new"));
+        EXPECT_TRUE(txn.commit());
+    }
 
-    // Insert
-    EXPECT_FALSE(collection[1].insert(jsons[1].c_str()));
-    EXPECT_TRUE(collection[2].insert(jsons[1].c_str()));
-    result = collection[2].value();
-    M_EXPECT_EQ_JSON(result->c_str(), jsons[1].c_str());
+    auto scan_keys = [&](ustore_snapshot_t snapshot, std::vector<ustore_key_t> const& expected_keys) {
+        ustore_key_t start_key = std::numeric_limits<ustore_key_t>::min();
+        ustore_length_t limit = 100;
+        ustore_length_t* found_counts = nullptr;
+        ustore_key_t* found_keys = nullptr;
+        ustore_length_t* found_values_offsets = nullptr;
+        ustore_byte_t* found_values = nullptr;
+        arena_t arena(db);
+        status_t status {};
+        ustore_scan_t scan {};
+        scan.db = db;
+        scan.error = status.member_ptr();
+        scan.snapshot = snapshot;
+        scan.arena = arena.member_ptr();
+        scan.tasks_count = 1;
+        scan.start_keys = &start_key;
+        scan.count_limits = &limit;
+        scan.counts = &found_counts;
+        scan.keys = &found_keys;
+        scan.values_offsets = &found_values_offsets;
+        scan.values = &found_values;
+        ustore_scan(&scan);
+        EXPECT_TRUE(status);
 
-    // Insert By Field
+        EXPECT_EQ(found_counts[0], expected_keys.size());
+        for (std::size_t i = 0; i != found_counts[0]; ++i) {
+            EXPECT_EQ(found_keys[i], expected_keys[i]);
+            auto value = std::string_view(reinterpret_cast<char const*>(found_values + found_values_offsets[i]),
+                                          found_values_offsets[i + 1] - found_values_offsets[i]);
+            if (snapshot)
+                EXPECT_EQ(value, "old");
+        }
+    };
+    scan_keys(snap.snap(), {0, 1, 2, 3, 4, 5, 6, 7, 8, 9});
+    scan_keys(0, {0, 1, 2, 4, 5, 6, 7, 8, 9, 20});
+
+    EXPECT_TRUE(db.drop_snapshot(snap.snap()));
+    EXPECT_EQ((*snap.snapshots()).size(), 0u);
+}
+
+TEST(db, transaction_erase_missing) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    if (!db.supports_transactions())
+        return;
+    EXPECT_TRUE(db.clear());
+    EXPECT_TRUE(db.transact());
+    transaction_t txn1 = *db.transact();
+    transaction_t txn2 = *db.transact();
+
+    EXPECT_TRUE(txn2.main().at(-7297309151944849401).erase());
+    EXPECT_TRUE(txn1.main().at(-8640850744835793378).erase());
+    EXPECT_TRUE(txn1.commit());
+    EXPECT_TRUE(txn2.commit());
+
+    EXPECT_EQ(db.main().at(-8640850744835793378).value(), value_view_t {});
+    EXPECT_EQ(db.main().at(-7297309151944849401).value(), value_view_t {});
+    EXPECT_EQ(db.main().keys().size(), 0u);
+}
+
+TEST(db, transaction_write_conflicting) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    if (!db.supports_transactions())
+        return;
+    EXPECT_TRUE(db.clear());
+    EXPECT_TRUE(db.transact());
+    transaction_t txn1 = *db.transact();
+    transaction_t txn2 = *db.transact();
+
+    EXPECT_TRUE(txn2.main().at(6).assign("a"));
+    EXPECT_TRUE(txn1.main().at(6).assign("b"));
+    EXPECT_TRUE(txn1.commit());
+    EXPECT_FALSE(txn2.commit());
+}
+
+/**
+ * Commits non-conflicting transactions from multiple threads at once,
+ * some of which request flushing, and checks that none are lost.
+ */
+TEST(db, transaction_concurrent_commits) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    if (!db.supports_transactions())
+        return;
+    EXPECT_TRUE(db.clear());
+
+    constexpr std::size_t threads_count = 8;
+    constexpr std::size_t commits_per_thread = 64;
+    auto commit_in_thread = [&](std::size_t thread_idx) {
+        transaction_t txn = *db.transact();
+        for (std::size_t i = 0; i != commits_per_thread; ++i) {
+            auto key = static_cast<ustore_key_t>(thread_idx * commits_per_thread + i);
+            EXPECT_TRUE(txn.main().at(key).assign("value"));
+            EXPECT_TRUE(txn.commit(i % 8 == 0));
+            EXPECT_TRUE(txn.reset());
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i != threads_count; ++i)
+        threads.emplace_back(commit_in_thread, i);
+    for (auto& thread : threads)
+        thread.join();
+
+    std::vector<ustore_key_t> keys(threads_count * commits_per_thread);
+    std::iota(keys.begin(), keys.end(), 0);
+    auto presences = db.main()[keys].present().throw_or_release();
+    for (std::size_t i = 0; i != keys.size(); ++i)
+        EXPECT_TRUE(presences[i]);
+    EXPECT_TRUE(db.clear());
+}
+
+/**
+ *
+ */
+TEST(db, transaction_sequenced_commit) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    if (!db.supports_transactions())
+        return;
+    EXPECT_TRUE(db.clear());
+
+    EXPECT_TRUE(db.transact());
+    transaction_t txn = *db.transact();
+
+    triplet_t triplet;
+    auto txn_ref = txn[triplet.keys];
+
+    EXPECT_TRUE(txn_ref.assign(triplet.contents()));
+    auto maybe_sequence_number = txn.sequenced_commit();
+    EXPECT_TRUE(maybe_sequence_number);
+    auto current_sequence_number = *maybe_sequence_number;
+    EXPECT_GT(current_sequence_number, 0);
+    EXPECT_TRUE(txn.reset());
+#if 0
+    auto previous_sequence_number = current_sequence_number;
+    EXPECT_TRUE(txn_ref.value());
+    maybe_sequence_number = txn.sequenced_commit();
+    EXPECT_TRUE(maybe_sequence_number);
+    current_sequence_number = *maybe_sequence_number;
+    EXPECT_EQ(current_sequence_number, previous_sequence_number);
+    EXPECT_TRUE(txn.reset());
+
+    previous_sequence_number = current_sequence_number;
+    EXPECT_TRUE(txn_ref.assign(triplet.contents()));
+    maybe_sequence_number = txn.sequenced_commit();
+    EXPECT_TRUE(maybe_sequence_number);
+    current_sequence_number = *maybe_sequence_number;
+    EXPECT_GT(current_sequence_number, previous_sequence_number);
+#endif
+}
+
+#pragma region Paths Modality
+
+/**
+ * Tests "Paths" Modality, with variable length keys.
+ * Reads, writes, prefix matching and pattern matching.
+ */
+TEST(db, paths) {
+
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+
+    char const* keys[] {"Facebook", "Apple", "Amazon", "Netflix", "Google", "Nvidia", "Adobe"};
+    char const* vals[] {"F", "A", "A", "N", "G", "N", "A"};
+    std::size_t keys_count = sizeof(keys) / sizeof(keys[0]);
+    ustore_char_t separator = '\0';
+
+    arena_t arena(db);
+    status_t status {};
+    ustore_paths_write_t paths_write {};
+    paths_write.db = db;
+    paths_write.error = status.member_ptr();
+    paths_write.arena = arena.member_ptr();
+    paths_write.tasks_count = keys_count;
+    paths_write.path_separator = separator;
+    paths_write.paths = keys;
+    paths_write.paths_stride = sizeof(char const*);
+    paths_write.values_bytes = reinterpret_cast<ustore_bytes_cptr_t*>(vals);
+    paths_write.values_bytes_stride = sizeof(char const*);
+
+    ustore_paths_write(&paths_write);
+    char* vals_recovered {};
+    ustore_paths_read_t paths_read {};
+    paths_read.db = db;
+    paths_read.error = status.member_ptr();
+    paths_read.arena = arena.member_ptr();
+    paths_read.tasks_count = keys_count;
+    paths_read.path_separator = separator;
+    paths_read.paths = keys;
+    paths_read.paths_stride = sizeof(char const*);
+    paths_read.values = reinterpret_cast<ustore_bytes_ptr_t*>(&vals_recovered);
+
+    ustore_paths_read(&paths_read);
+    EXPECT_TRUE(status);
+    EXPECT_EQ(std::string_view(vals_recovered, keys_count * 2),
+              std::string_view("F\0A\0A\0N\0G\0N\0A\0", keys_count * 2));
+
+    // Try getting either "Netflix" or "Nvidia" as one of the keys with "N" prefix
+    ustore_str_view_t prefix = "N";
+    ustore_length_t max_count = 1;
+    ustore_length_t* results_counts {};
+    ustore_length_t* tape_offsets {};
+    ustore_char_t* tape_begin {};
+    ustore_paths_match_t paths_match {};
+    paths_match.db = db;
+    paths_match.error = status.member_ptr();
+    paths_match.arena = arena.member_ptr();
+    paths_match.tasks_count = 1;
+    paths_match.match_counts_limits = &max_count;
+    paths_match.patterns = &prefix;
+    paths_match.match_counts = &results_counts;
+    paths_match.paths_offsets = &tape_offsets;
+    paths_match.paths_strings = &tape_begin;
+
+    ustore_paths_match(&paths_match);
+    auto first_match_for_a = std::string_view(tape_begin);
+    EXPECT_EQ(results_counts[0], 1);
+    EXPECT_TRUE(first_match_for_a == "Netflix" || first_match_for_a == "Nvidia");
+
+    // Try getting the remaining results, which is the other one from that same pair
+    max_count = 10;
+    paths_match.previous = &tape_begin;
+    paths_match.options = ustore_option_dont_discard_memory_k;
+    ustore_paths_match(&paths_match);
+    auto second_match_for_a = std::string_view(tape_begin);
+    EXPECT_EQ(results_counts[0], 1);
+    EXPECT_TRUE(second_match_for_a == "Netflix" || second_match_for_a == "Nvidia");
+    EXPECT_NE(first_match_for_a, second_match_for_a);
+
+    // Try performing parallel queries in the same collection
+    ustore_str_view_t prefixes[2] = {"A", "N"};
+    std::size_t prefixes_count = sizeof(prefixes) / sizeof(prefixes[0]);
+    max_count = 10;
+    paths_match.tasks_count = prefixes_count;
+    paths_match.patterns = prefixes;
+    paths_match.patterns_stride = sizeof(ustore_str_view_t);
+    paths_match.previous = nullptr;
+    ustore_paths_match(&paths_match);
+    auto total_count = std::accumulate(results_counts, results_counts + prefixes_count, 0ul);
+    strings_tape_iterator_t tape_iterator {total_count, tape_begin};
+    std::set<std::string> tape_parts;
+    while (!tape_iterator.is_end()) {
+        tape_parts.insert(*tape_iterator);
+        ++tape_iterator;
+    }
+    EXPECT_EQ(results_counts[0], 3);
+    EXPECT_EQ(results_counts[1], 2);
+    EXPECT_NE(tape_parts.find("Netflix"), tape_parts.end());
+    EXPECT_NE(tape_parts.find("Adobe"), tape_parts.end());
+
+    // Now try matching a Regular Expression
+    prefix = "Netflix|Google";
+    paths_match.tasks_count = 1;
+    paths_match.patterns = &prefix;
+    ustore_paths_match(&paths_match);
+    first_match_for_a = std::string_view(tape_begin);
+    second_match_for_a = std::string_view(tape_begin + tape_offsets[1]);
+    EXPECT_EQ(results_counts[0], 2);
+    EXPECT_TRUE(first_match_for_a == "Netflix" || first_match_for_a == "Google");
+    EXPECT_TRUE(second_match_for_a == "Netflix" || second_match_for_a == "Google");
+
+    // Try a more complex regular expression
+    prefix = "A.*e";
+    ustore_paths_match(&paths_match);
+    first_match_for_a = std::string_view(tape_begin);
+    second_match_for_a = std::string_view(tape_begin + tape_offsets[1]);
+    EXPECT_EQ(results_counts[0], 2);
+    EXPECT_TRUE(first_match_for_a == "Apple" || first_match_for_a == "Adobe");
+    EXPECT_TRUE(second_match_for_a == "Apple" || second_match_for_a == "Adobe");
+
+    // Repeated and optional characters can't be required from the candidates
+    prefix = "Go+gle";
+    ustore_paths_match(&paths_match);
+    EXPECT_EQ(results_counts[0], 1);
+    EXPECT_EQ(std::string_view(tape_begin), "Google");
+    prefix = "Nvidx?ia";
+    ustore_paths_match(&paths_match);
+    EXPECT_EQ(results_counts[0], 1);
+    EXPECT_EQ(std::string_view(tape_begin), "Nvidia");
+
+    // Bounded repetitions are quantifiers, and their counts aren't literals
+    prefix = "Go{2}gle";
+    ustore_paths_match(&paths_match);
+    EXPECT_EQ(results_counts[0], 1);
+    EXPECT_EQ(std::string_view(tape_begin), "Google");
+    prefix = "Ama{1,3}zon";
+    ustore_paths_match(&paths_match);
+    EXPECT_EQ(results_counts[0], 1);
+    EXPECT_EQ(std::string_view(tape_begin), "Amazon");
+    prefix = "^N[a-z]{4,6}$";
+    ustore_paths_match(&paths_match);
+    EXPECT_EQ(results_counts[0], 2);
+
+    // Existing single letter prefix
+    prefix = "A";
+    ustore_paths_match(&paths_match);
+    first_match_for_a = std::string_view(tape_begin);
+    second_match_for_a = std::string_view(tape_begin + tape_offsets[1]);
+    EXPECT_EQ(results_counts[0], 3);
+    EXPECT_TRUE(first_match_for_a == "Apple" || first_match_for_a == "Adobe" || first_match_for_a == "Amazon");
+    EXPECT_TRUE(second_match_for_a == "Apple" || second_match_for_a == "Adobe" || second_match_for_a == "Amazon");
+
+    // Missing single letter prefix
+    prefix = "X";
+    ustore_paths_match(&paths_match);
+    EXPECT_EQ(results_counts[0], 0);
+    EXPECT_EQ(*paths_match.error, nullptr);
+
+    // Missing pattern
+    prefix = "X.*";
+    ustore_paths_match(&paths_match);
+    EXPECT_EQ(results_counts[0], 0);
+    EXPECT_EQ(*paths_match.error, nullptr);
+
+    // Try a more complex regular expression
+    prefix = "oo:18:\\*";
+    ustore_paths_match(&paths_match);
+    EXPECT_EQ(results_counts[0], 0);
+    EXPECT_EQ(*paths_match.error, nullptr);
+
+    // Try an even more complex regular expression
+    prefix = "oo:18:\\\\*";
+    ustore_paths_match(&paths_match);
+    EXPECT_EQ(results_counts[0], 0);
+    EXPECT_EQ(*paths_match.error, nullptr);
+
+    EXPECT_TRUE(db.clear());
+
+    // Try an even more complex regular expression on empty DB
+    prefix = "oo:18:\\\\*";
+    ustore_paths_match(&paths_match);
+    EXPECT_EQ(results_counts[0], 0);
+    EXPECT_EQ(*paths_match.error, nullptr);
+}
+
+/**
+ * Tests "Paths" Modality with separators, that maintain the mirror "directory"
+ * entries and answer prefix matches by walking them, instead of full scans.
+ */
+TEST(db, paths_directories) {
+
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+
+    char const* keys[] {"home/user/media/a", "home/user/media/b", "home/user/notes", "home/guest", "tmp"};
+    std::size_t keys_count = sizeof(keys) / sizeof(keys[0]);
+    ustore_char_t separator = '/';
+
+    arena_t arena(db);
+    status_t status {};
+    ustore_paths_write_t paths_write {};
+    paths_write.db = db;
+    paths_write.error = status.member_ptr();
+    paths_write.arena = arena.member_ptr();
+    paths_write.tasks_count = keys_count;
+    paths_write.path_separator = separator;
+    paths_write.paths = keys;
+    paths_write.paths_stride = sizeof(char const*);
+    paths_write.values_bytes = reinterpret_cast<ustore_bytes_cptr_t const*>(keys);
+    paths_write.values_bytes_stride = sizeof(char const*);
+    ustore_paths_write(&paths_write);
+    EXPECT_TRUE(status);
+
+    ustore_str_view_t prefix = "home/user/";
+    ustore_length_t max_count = 10;
+    ustore_length_t* results_counts {};
+    ustore_length_t* tape_offsets {};
+    ustore_char_t* tape_begin {};
+    ustore_paths_match_t paths_match {};
+    paths_match.db = db;
+    paths_match.error = status.member_ptr();
+    paths_match.arena = arena.member_ptr();
+    paths_match.tasks_count = 1;
+    paths_match.path_separator = separator;
+    paths_match.match_counts_limits = &max_count;
+    paths_match.patterns = &prefix;
+    paths_match.match_counts = &results_counts;
+    paths_match.paths_offsets = &tape_offsets;
+    paths_match.paths_strings = &tape_begin;
+
+    // Indexed matches are exported in lexicographic order
+    ustore_paths_match(&paths_match);
+    EXPECT_TRUE(status);
+    EXPECT_EQ(results_counts[0], 3);
+    EXPECT_EQ(std::string_view(tape_begin + tape_offsets[0]), "home/user/media/a");
+    EXPECT_EQ(std::string_view(tape_begin + tape_offsets[1]), "home/user/media/b");
+    EXPECT_EQ(std::string_view(tape_begin + tape_offsets[2]), "home/user/notes");
+
+    // Prefixes may end in the middle of a segment, and pages continue after the previous match
+    prefix = "home/";
+    max_count = 2;
+    ustore_str_view_t previous = "home/user/media/a";
+    paths_match.previous = &previous;
+    ustore_paths_match(&paths_match);
+    EXPECT_EQ(results_counts[0], 2);
+    EXPECT_EQ(std::string_view(tape_begin + tape_offsets[0]), "home/user/media/b");
+    EXPECT_EQ(std::string_view(tape_begin + tape_offsets[1]), "home/user/notes");
+    paths_match.previous = nullptr;
+
+    // Removals clean up the directories, that became empty
+    char const* removed_keys[] {"home/user/media/a", "home/user/media/b"};
+    paths_write.tasks_count = 2;
+    paths_write.paths = removed_keys;
+    paths_write.values_bytes = nullptr;
+    ustore_paths_write(&paths_write);
+    EXPECT_TRUE(status);
+
+    prefix = "home/user/m";
+    max_count = 10;
+    ustore_paths_match(&paths_match);
+    EXPECT_EQ(results_counts[0], 0);
+
+    // Full scans without the separator skip the mirror entries
+    prefix = "";
+    paths_match.path_separator = '\0';
+    ustore_paths_match(&paths_match);
+    EXPECT_EQ(results_counts[0], 3);
+
+    EXPECT_TRUE(db.clear());
+}
+
+/**
+ * Tests "Paths" Modality with batches, that change the same paths multiple times.
+ * The last change of every path must win, regardless of how buckets are grouped.
+ */
+TEST(db, paths_repeated_in_batch) {
+
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+
+    char const* keys[] {"alpha", "beta", "alpha", "gamma", "beta", "alpha"};
+    char const* vals[] {"1", "2", "3", "4", nullptr, "5"};
+    std::size_t keys_count = sizeof(keys) / sizeof(keys[0]);
+
+    arena_t arena(db);
+    status_t status {};
+    ustore_paths_write_t paths_write {};
+    paths_write.db = db;
+    paths_write.error = status.member_ptr();
+    paths_write.arena = arena.member_ptr();
+    paths_write.tasks_count = keys_count;
+    paths_write.paths = keys;
+    paths_write.paths_stride = sizeof(char const*);
+    paths_write.values_bytes = reinterpret_cast<ustore_bytes_cptr_t*>(vals);
+    paths_write.values_bytes_stride = sizeof(char const*);
+    ustore_paths_write(&paths_write);
+    EXPECT_TRUE(status);
+
+    char const* read_keys[] {"alpha", "beta", "gamma"};
+    ustore_length_t* lengths {};
+    ustore_length_t* offsets {};
+    char* vals_recovered {};
+    ustore_paths_read_t paths_read {};
+    paths_read.db = db;
+    paths_read.error = status.member_ptr();
+    paths_read.arena = arena.member_ptr();
+    paths_read.tasks_count = 3;
+    paths_read.paths = read_keys;
+    paths_read.paths_stride = sizeof(char const*);
+    paths_read.lengths = &lengths;
+    paths_read.offsets = &offsets;
+    paths_read.values = reinterpret_cast<ustore_bytes_ptr_t*>(&vals_recovered);
+    ustore_paths_read(&paths_read);
+    EXPECT_TRUE(status);
+    EXPECT_EQ(std::string_view(vals_recovered + offsets[0], lengths[0]), "5");
+    EXPECT_EQ(lengths[1], ustore_length_missing_k);
+    EXPECT_EQ(std::string_view(vals_recovered + offsets[2], lengths[2]), "4");
+
+    EXPECT_TRUE(db.clear());
+}
+
+/**
+ * Reads a single path, returning an empty optional, if it's missing.
+ */
+static std::optional<std::string> paths_read_one(database_t& db, arena_t& arena, char const* path) {
+    status_t status {};
+    ustore_length_t* lengths {};
+    ustore_length_t* offsets {};
+    char* values {};
+    ustore_paths_read_t paths_read {};
+    paths_read.db = db;
+    paths_read.error = status.member_ptr();
+    paths_read.arena = arena.member_ptr();
+    paths_read.tasks_count = 1;
+    paths_read.paths = &path;
+    paths_read.lengths = &lengths;
+    paths_read.offsets = &offsets;
+    paths_read.values = reinterpret_cast<ustore_bytes_ptr_t*>(&values);
+    ustore_paths_read(&paths_read);
+    EXPECT_TRUE(status);
+    if (!status || lengths[0] == ustore_length_missing_k)
+        return std::nullopt;
+    return std::string(values + offsets[0], lengths[0]);
+}
+
+/**
+ * New buckets carry one-byte fingerprints of their keys, flagged by the top bit of
+ * the entries counter. Lookups must still tell apart the members of the same bucket.
+ */
+TEST(db, paths_fingerprinted_buckets) {
+
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+
+    std::vector<std::string> keys;
+    std::vector<std::string> vals;
+    for (std::size_t i = 0; i != 100; ++i)
+        keys.push_back(fmt::format("fingerprinted/{}", i)), vals.push_back(std::to_string(i));
+    std::vector<char const*> keys_ptrs, vals_ptrs;
+    for (std::size_t i = 0; i != keys.size(); ++i)
+        keys_ptrs.push_back(keys[i].c_str()), vals_ptrs.push_back(vals[i].c_str());
+
+    arena_t arena(db);
+    status_t status {};
+    ustore_paths_write_t paths_write {};
+    paths_write.db = db;
+    paths_write.error = status.member_ptr();
+    paths_write.arena = arena.member_ptr();
+    paths_write.tasks_count = keys.size();
+    paths_write.paths = keys_ptrs.data();
+    paths_write.paths_stride = sizeof(char const*);
+    paths_write.values_bytes = reinterpret_cast<ustore_bytes_cptr_t*>(vals_ptrs.data());
+    paths_write.values_bytes_stride = sizeof(char const*);
+    ustore_paths_write(&paths_write);
+    EXPECT_TRUE(status);
+
+    // Every stored bucket must be in the new layout
+    blobs_collection_t main = db.main();
+    std::vector<ustore_key_t> buckets_ids;
+    for (ustore_key_t bucket_id : main.keys())
+        buckets_ids.push_back(bucket_id);
+    std::size_t members = 0;
+    for (ustore_key_t bucket_id : buckets_ids) {
+        auto bucket = *main[bucket_id].value();
+        ustore_length_t header = 0;
+        EXPECT_GE(bucket.size(), sizeof(header));
+        std::memcpy(&header, bucket.data(), sizeof(header));
+        EXPECT_TRUE(header & (ustore_length_t(1u) << 31));
+        members += header & ~(ustore_length_t(1u) << 31);
+    }
+    EXPECT_EQ(members, keys.size());
+
+    for (std::size_t i = 0; i != keys.size(); ++i)
+        EXPECT_EQ(paths_read_one(db, arena, keys[i].c_str()), vals[i]);
+    EXPECT_EQ(paths_read_one(db, arena, "fingerprinted/100"), std::nullopt);
+    EXPECT_TRUE(db.clear());
+}
+
+/**
+ * Buckets, written before the switch to a portable hash, live under `std::hash` IDs,
+ * in a layout without fingerprints. They must stay readable and matchable,
+ * and every path must move out of them on its next update.
+ */
+TEST(db, paths_legacy_buckets) {
+
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+    blobs_collection_t main = db.main();
+
+    auto legacy_bucket_id = [](std::string_view path) {
+        auto result = std::hash<std::string_view> {}(path);
+#ifdef USTORE_DEBUG
+        result %= 10ul;
+#endif
+        return static_cast<ustore_key_t>(result);
+    };
+    auto legacy_bucket = [](std::string_view path, std::string_view value) {
+        ustore_length_t counters[3] {1, static_cast<ustore_length_t>(path.size()), static_cast<ustore_length_t>(value.size())};
+        std::string bucket(reinterpret_cast<char const*>(counters), sizeof(counters));
+        return bucket.append(path).append(value);
+    };
+
+    // In debug builds the IDs are folded into ten buckets, so pick paths, that don't collide
+    std::vector<std::string> paths;
+    for (std::size_t i = 0; paths.size() != 2; ++i) {
+        std::string path = fmt::format("legacy/{}", i);
+        bool collides = std::any_of(paths.begin(), paths.end(), [&](std::string const& other) {
+            return legacy_bucket_id(other) == legacy_bucket_id(path);
+        });
+        if (!collides)
+            paths.push_back(path);
+    }
+    std::string first = legacy_bucket(paths[0], "old");
+    std::string second = legacy_bucket(paths[1], "kept");
+    EXPECT_TRUE(main[legacy_bucket_id(paths[0])].assign(value_view_t(std::string_view(first))));
+    EXPECT_TRUE(main[legacy_bucket_id(paths[1])].assign(value_view_t(std::string_view(second))));
+
+    arena_t arena(db);
+    EXPECT_EQ(paths_read_one(db, arena, paths[0].c_str()), "old");
+    EXPECT_EQ(paths_read_one(db, arena, paths[1].c_str()), "kept");
+
+    // Full scans visit the legacy buckets, like any other
+    status_t status {};
+    ustore_str_view_t prefix = "legacy/";
+    ustore_length_t max_count = 10;
+    ustore_length_t* results_counts {};
+    ustore_length_t* tape_offsets {};
+    ustore_char_t* tape_begin {};
+    ustore_paths_match_t paths_match {};
+    paths_match.db = db;
+    paths_match.error = status.member_ptr();
+    paths_match.arena = arena.member_ptr();
+    paths_match.tasks_count = 1;
+    paths_match.match_counts_limits = &max_count;
+    paths_match.patterns = &prefix;
+    paths_match.match_counts = &results_counts;
+    paths_match.paths_offsets = &tape_offsets;
+    paths_match.paths_strings = &tape_begin;
+    ustore_paths_match(&paths_match);
+    EXPECT_TRUE(status);
+    EXPECT_EQ(results_counts[0], 2);
+
+    // Updating the first path converts it, leaving the second one in place
+    char const* updated_path = paths[0].c_str();
+    char const* updated_value = "new";
+    ustore_paths_write_t paths_write {};
+    paths_write.db = db;
+    paths_write.error = status.member_ptr();
+    paths_write.arena = arena.member_ptr();
+    paths_write.tasks_count = 1;
+    paths_write.paths = &updated_path;
+    paths_write.values_bytes = reinterpret_cast<ustore_bytes_cptr_t const*>(&updated_value);
+    ustore_paths_write(&paths_write);
+    EXPECT_TRUE(status);
+
+    EXPECT_EQ(paths_read_one(db, arena, paths[0].c_str()), "new");
+    EXPECT_EQ(paths_read_one(db, arena, paths[1].c_str()), "kept");
+#if !defined(USTORE_DEBUG)
+    // Unless the IDs are folded, the new bucket can't coincide with the legacy ones
+    EXPECT_EQ(main.keys().size(), 2ul);
+#endif
+    ustore_paths_match(&paths_match);
+    EXPECT_TRUE(status);
+    EXPECT_EQ(results_counts[0], 2);
+
+    // Removals must also clean up the legacy copies, or those would resurface
+    char const* removed_path = paths[1].c_str();
+    paths_write.paths = &removed_path;
+    paths_write.values_bytes = nullptr;
+    ustore_paths_write(&paths_write);
+    EXPECT_TRUE(status);
+    EXPECT_EQ(paths_read_one(db, arena, paths[1].c_str()), std::nullopt);
+#if !defined(USTORE_DEBUG)
+    EXPECT_FALSE(*main[legacy_bucket_id(paths[1])].present());
+#endif
+
+    EXPECT_TRUE(db.clear());
+}
+
+/**
+ * Tests "Paths" Modality, by forming bidirectional linked lists from string-to-string mappings.
+ * Uses different-length unique strings. As the underlying modality may be implemented as a bucketed hash-map,
+ * this test helps catch problems in bucket reorganization.
+ */
+TEST(db, paths_linked_list) {
+    constexpr std::size_t count = 1000;
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+
+    arena_t arena(db);
+    ustore_char_t separator = '\0';
+    status_t status;
+
+    ustore_paths_write_t paths_write {};
+    paths_write.db = db;
+    paths_write.error = status.member_ptr();
+    paths_write.arena = arena.member_ptr();
+    paths_write.tasks_count = 1;
+    paths_write.path_separator = separator;
+
+    ustore_paths_read_t paths_read {};
+    paths_read.db = db;
+    paths_read.error = status.member_ptr();
+    paths_read.arena = arena.member_ptr();
+    paths_read.tasks_count = 1;
+    paths_read.path_separator = separator;
+
+    // Generate some random strings for our tests
+    constexpr auto alphabet = "abcdefghijklmnop";
+    auto make_random_str = []() {
+        auto str = std::string();
+        auto len = static_cast<std::size_t>(std::rand() % 100) + 8;
+        for (std::size_t i = 0; i != len; ++i)
+            str.push_back(alphabet[std::rand() % 16]);
+        return str;
+    };
+    std::set<std::string> unique;
+    while (unique.size() != count)
+        unique.insert(make_random_str());
+
+    // Lets form a linked list, where every key maps into the the next key.
+    // Then we will traverse the linked list from start to end.
+    // Then we will re-link it in reverse order and traverse again.
+    std::vector<ustore_str_view_t> begins(unique.size());
+    std::transform(unique.begin(), unique.end(), begins.begin(), [](std::string const& str) { return str.c_str(); });
+
+    // Link forward
+    for (std::size_t i = 0; i + 1 != begins.size(); ++i) {
+        ustore_str_view_t smaller = begins[i];
+        ustore_str_view_t bigger = begins[i + 1];
+        paths_write.paths = &smaller;
+        paths_write.values_bytes = reinterpret_cast<ustore_bytes_cptr_t*>(&bigger);
+        ustore_paths_write(&paths_write);
+        EXPECT_TRUE(status);
+
+        // Check if it was successfully written:
+        ustore_str_span_t bigger_received = nullptr;
+        paths_read.paths = &smaller;
+        paths_read.values = reinterpret_cast<ustore_bytes_ptr_t*>(&bigger_received);
+        ustore_paths_read(&paths_read);
+        EXPECT_TRUE(status);
+        EXPECT_EQ(std::string_view(bigger), std::string_view(bigger_received));
+    }
+
+    // Traverse forward, counting the entries and checking the order
+    for (std::size_t i = 0; i + 1 != begins.size(); ++i) {
+        ustore_str_view_t smaller = begins[i];
+        ustore_str_view_t bigger = begins[i + 1];
+        ustore_str_span_t bigger_received = nullptr;
+        paths_read.paths = &smaller;
+        paths_read.values = reinterpret_cast<ustore_bytes_ptr_t*>(&bigger_received);
+        ustore_paths_read(&paths_read);
+        EXPECT_TRUE(status);
+        EXPECT_EQ(std::string_view(bigger), std::string_view(bigger_received));
+    }
+
+    // Re-link in reverse order
+    for (std::size_t i = 0; i + 1 != begins.size(); ++i) {
+        ustore_str_view_t smaller = begins[i];
+        ustore_str_view_t bigger = begins[i + 1];
+        paths_write.paths = &bigger;
+        paths_write.values_bytes = reinterpret_cast<ustore_bytes_cptr_t*>(&smaller);
+        ustore_paths_write(&paths_write);
+        EXPECT_TRUE(status);
+
+        // Check if it was successfully over-written:
+        ustore_str_span_t smaller_received = nullptr;
+        paths_read.paths = &bigger;
+        paths_read.values = reinterpret_cast<ustore_bytes_ptr_t*>(&smaller_received);
+        ustore_paths_read(&paths_read);
+        EXPECT_TRUE(status);
+        EXPECT_EQ(std::string_view(smaller), std::string_view(smaller_received));
+    }
+
+    // Traverse backwards, counting the entries and checking the order
+    for (std::size_t i = 0; i + 1 != begins.size(); ++i) {
+        ustore_str_view_t smaller = begins[i];
+        ustore_str_view_t bigger = begins[i + 1];
+        ustore_str_span_t smaller_received = nullptr;
+        paths_read.paths = &bigger;
+        paths_read.values = reinterpret_cast<ustore_bytes_ptr_t*>(&smaller_received);
+        ustore_paths_read(&paths_read);
+        EXPECT_TRUE(status);
+        EXPECT_EQ(std::string_view(smaller), std::string_view(smaller_received));
+    }
+}
+
+#pragma region Documents Modality
+
+std::vector<std::string> make_three_flat_docs() {
+    auto json1 = R"( {"person": "Alice", "age": 24} )"_json.dump();
+    auto json2 = R"( {"person": "Bob", "age": 25} )"_json.dump();
+    auto json3 = R"( {"person": "Carl", "age": 26} )"_json.dump();
+    return {json1, json2, json3};
+}
+
+std::vector<std::string> make_three_nested_docs() {
+    auto json1 = R"( {"person": {"name":"Alice", "age": 24}} )"_json.dump();
+    auto json2 = R"( {"person": [{"name":"Bob", "age": 25}]} )"_json.dump();
+    auto json3 = R"( {"person": "Carl", "age": 26} )"_json.dump();
+    return {json1, json2, json3};
+}
+
+/**
+ * Tests "Documents" Modality, mapping integers to structured hierarchical documents.
+ * Takes a basic flat JSON document, and checks if it can be imported in JSON, BSON
+ * and MessagePack forms, and later be properly accessed at field-level.
+ */
+TEST(db, docs_flat) {
+
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+
+    // JSON
+    docs_collection_t collection = db.main<docs_collection_t>();
+    auto jsons = make_three_flat_docs();
+    collection[1] = jsons[0].c_str();
+    collection[2] = jsons[1].c_str();
+    collection[3] = jsons[2].c_str();
+    M_EXPECT_EQ_JSON(*collection[1].value(), jsons[0]);
+    M_EXPECT_EQ_JSON(*collection[ckf(2, "person")].value(), "\"Bob\"");
+    M_EXPECT_EQ_JSON(*collection[ckf(3, "age")].value(), "26");
+
+    // Binary
+    auto maybe_person = collection[ckf(1, "person")].value(ustore_doc_field_str_k);
+    EXPECT_EQ(std::string_view(maybe_person->c_str(), maybe_person->size()), std::string_view("Alice"));
+
+    // BSON
+    bson_error_t error;
+    bson_t* bson = bson_new_from_json((uint8_t*)jsons[0].c_str(), -1, &error);
+    uint8_t const* buffer = bson_get_data(bson);
+    auto view = value_view_t(buffer, bson->len);
+    collection.at(4, ustore_doc_field_bson_k) = view;
+    M_EXPECT_EQ_JSON(*collection[4].value(), jsons[0]);
+    M_EXPECT_EQ_JSON(*collection[ckf(4, "person")].value(), "\"Alice\"");
+    M_EXPECT_EQ_JSON(*collection[ckf(4, "age")].value(), "24");
+    bson_clear(&bson);
+
+    // MsgPack
+    auto message_pack = *collection[1].value(ustore_doc_field_msgpack_k);
+    collection.at(5, ustore_doc_field_msgpack_k) = message_pack;
+    M_EXPECT_EQ_JSON(*collection[5].value(), jsons[0]);
+    M_EXPECT_EQ_JSON(*collection[ckf(5, "person")].value(), "\"Alice\"");
+    M_EXPECT_EQ_JSON(*collection[ckf(5, "age")].value(), "24");
+}
+
+/**
+ * Tries adding 3 simple nested JSONs, using JSON-Pointers
+ * to retrieve specific fields across multiple keys.
+ */
+TEST(db, docs_nested_batch) {
+
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+    docs_collection_t collection = db.main<docs_collection_t>();
+
+    auto jsons = make_three_nested_docs();
+    std::string continuous_jsons = jsons[0] + jsons[1] + jsons[2];
+    auto vals_begin = reinterpret_cast<ustore_bytes_ptr_t>(continuous_jsons.data());
+    std::array<ustore_length_t, 4> offsets = {
+        0,
+        static_cast<ustore_length_t>(jsons[0].size()),
+        static_cast<ustore_length_t>(jsons[0].size() + jsons[1].size()),
+        static_cast<ustore_length_t>(jsons[0].size() + jsons[1].size() + jsons[2].size()),
+    };
+    contents_arg_t values {};
+    values.offsets_begin = {offsets.data(), sizeof(ustore_length_t)};
+    values.contents_begin = {&vals_begin, 0};
+
+    std::array<ustore_key_t, 3> keys = {1, 2, 3};
+    auto ref = collection[keys];
+    EXPECT_TRUE(ref.assign(values));
+
+    // Read One By One
+    M_EXPECT_EQ_JSON(*collection[1].value(), jsons[0]);
+    M_EXPECT_EQ_JSON(*collection[2].value(), jsons[1]);
+    M_EXPECT_EQ_JSON(*collection[3].value(), jsons[2]);
+
+    auto expected = R"({"name":"Alice", "age": 24})"_json.dump();
+    M_EXPECT_EQ_JSON(*collection[ckf(1, "person")].value(), expected);
+
+    expected = R"([{"name":"Bob", "age": 25}])"_json.dump();
+    M_EXPECT_EQ_JSON(*collection[ckf(2, "person")].value(), expected);
+    M_EXPECT_EQ_JSON(*collection[ckf(2, "/person/0/name")].value(), "\"Bob\"");
+
+    // Read sorted keys
+    check_equalities(ref, values);
+
+    // Read not sorted keys
+    std::array<ustore_key_t, 3> not_sorted_keys = {1, 3, 2};
+    auto not_sorted_ref = collection[not_sorted_keys];
+    std::string not_sorted_jsons = jsons[0] + jsons[2] + jsons[1];
+    vals_begin = reinterpret_cast<ustore_bytes_ptr_t>(not_sorted_jsons.data());
+    offsets[2] = jsons[0].size() + jsons[2].size();
+    offsets[3] = jsons[0].size() + jsons[2].size() + jsons[1].size();
+    check_equalities(not_sorted_ref, values);
+
+    // Read duplicate keys
+    std::array<ustore_key_t, 3> duplicate_keys = {1, 2, 1};
+    auto duplicate_ref = collection[duplicate_keys];
+    std::string duplicate_jsons = jsons[0] + jsons[1] + jsons[0];
+    vals_begin = reinterpret_cast<ustore_bytes_ptr_t>(duplicate_jsons.data());
+    offsets[2] = jsons[0].size() + jsons[1].size();
+    offsets[3] = jsons[0].size() + jsons[1].size() + jsons[0].size();
+    check_equalities(duplicate_ref, values);
+
+    // Read with fields
+    std::array<collection_key_field_t, 3> keys_with_fields = {
+        ckf(1, "person"),
+        ckf(2, "/person/0/name"),
+        ckf(3, "age"),
+    };
+    auto ref_with_fields = collection[keys_with_fields];
+    auto field_value1 = R"({"name":"Alice", "age": 24})"_json.dump();
+    auto field_value2 = R"("Bob")"_json.dump();
+    auto field_value3 = R"(26)"_json.dump();
+    std::string field_values = field_value1 + field_value2 + field_value3;
+    vals_begin = reinterpret_cast<ustore_bytes_ptr_t>(field_values.data());
+    offsets[1] = field_value1.size();
+    offsets[2] = field_value1.size() + field_value2.size();
+    offsets[3] = field_value1.size() + field_value2.size() + field_value3.size();
+    check_equalities(ref_with_fields, values);
+
+    // Check Invalid Json Write
+    std::string invalid_json = R"({"name":"Alice", } "age": 24})";
+    offsets[1] = jsons[0].size();
+    offsets[2] = jsons[0].size() + jsons[1].size();
+    offsets[3] = jsons[0].size() + jsons[1].size() + invalid_json.size();
+    continuous_jsons = jsons[0] + jsons[1] + invalid_json;
+    vals_begin = reinterpret_cast<ustore_bytes_ptr_t>(continuous_jsons.data());
+
+    EXPECT_FALSE(ref.assign(values));
+}
+
+/**
+ * Performs basic JSON Paths, JSON Merge-Patches, and sub-document level updates.
+ */
+TEST(db, docs_modify) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+    docs_collection_t collection = db.main<docs_collection_t>();
+    auto jsons = make_three_nested_docs();
+    collection[1] = jsons[0].c_str();
+    M_EXPECT_EQ_JSON(*collection[1].value(), jsons[0]);
+
+    // Update
+    auto modifier = R"( {"person": {"name":"Charles", "age": 28}} )"_json.dump();
+    EXPECT_TRUE(collection[1].update(modifier.c_str()));
+    auto result = collection[1].value();
+    M_EXPECT_EQ_JSON(result->c_str(), modifier.c_str());
+
+    // Update By Field
+    modifier = R"( {"name": "Alice", "age": 24} )"_json.dump();
+    EXPECT_TRUE(collection[ckf(1, "/person")].update(modifier.c_str()));
+    result = collection[1].value();
+    M_EXPECT_EQ_JSON(result->c_str(), jsons[0].c_str());
+
+    // Insert
+    EXPECT_FALSE(collection[1].insert(jsons[1].c_str()));
+    EXPECT_TRUE(collection[2].insert(jsons[1].c_str()));
+    result = collection[2].value();
+    M_EXPECT_EQ_JSON(result->c_str(), jsons[1].c_str());
+
+    // Insert By Field
     modifier = R"("Doe" )"_json.dump();
     auto expected = R"({"person": [{"name":"Bob", "age": 25, "surname" : "Doe"}]})"_json.dump();
     EXPECT_TRUE(collection[ckf(2, "/person/0/surname")].insert(modifier.c_str()));
     result = collection[2].value();
     M_EXPECT_EQ_JSON(result->c_str(), expected.c_str());
 
-    // Upsert
-    EXPECT_TRUE(collection[1].upsert(jsons[2].c_str()));
-    result = collection[1].value();
-    M_EXPECT_EQ_JSON(result->c_str(), jsons[2].c_str());
+    // Upsert
+    EXPECT_TRUE(collection[1].upsert(jsons[2].c_str()));
+    result = collection[1].value();
+    M_EXPECT_EQ_JSON(result->c_str(), jsons[2].c_str());
+
+    // Upsert By Field
+    modifier = R"("Charles")"_json.dump();
+    expected = R"( {"person": "Charles", "age": 26} )"_json.dump();
+    EXPECT_TRUE(collection[ckf(1, "/person")].upsert(modifier.c_str()));
+    result = collection[1].value();
+    M_EXPECT_EQ_JSON(result->c_str(), expected.c_str());
+
+    modifier = R"(70)"_json.dump();
+    expected = R"( {"person": "Charles", "age": 26, "weight" : 70} )"_json.dump();
+    EXPECT_TRUE(collection[ckf(1, "/weight")].upsert(modifier.c_str()));
+    result = collection[1].value();
+    M_EXPECT_EQ_JSON(result->c_str(), expected.c_str());
+}
+
+/**
+ * Uses a well-known repository of JSON-Patches and JSON-MergePatches,
+ * to validate that document modifications work adequately in corner cases.
+ */
+TEST(db, docs_merge_and_patch) {
+    using json_t = nlohmann::json;
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+    docs_collection_t collection = db.main<docs_collection_t>();
+
+    std::ifstream f_patch("tests/patch.json");
+    json_t j_object = json_t::parse(f_patch);
+    for (auto it : j_object) {
+        auto doc = it["doc"].dump();
+        auto patch = it["patch"].dump();
+        auto expected = it["expected"].dump();
+        collection[1] = doc.c_str();
+        EXPECT_TRUE(collection[1].patch(patch.c_str()));
+        auto maybe_value = collection[1].value();
+        EXPECT_TRUE(maybe_value);
+        M_EXPECT_EQ_JSON(maybe_value->c_str(), expected.c_str());
+    }
+
+    std::ifstream f_merge("tests/merge.json");
+    j_object = json_t::parse(f_merge);
+    for (auto it : j_object) {
+        auto doc = it["doc"].dump();
+        auto merge = it["merge"].dump();
+        auto expected = it["expected"].dump();
+        collection[1] = doc.c_str();
+        EXPECT_TRUE(collection[1].merge(merge.c_str()));
+        auto maybe_value = collection[1].value();
+        EXPECT_TRUE(maybe_value);
+        M_EXPECT_EQ_JSON(maybe_value->c_str(), expected.c_str());
+    }
+}
+
+/**
+ * Fills document collection with info about Alice, Bob and Carl,
+ * sampling it later in a form of a table, using both low-level APIs,
+ * and higher-level compile-time C++ meta-programming abstractions.
+ */
+TEST(db, docs_table) {
+    using json_t = nlohmann::json;
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+
+    // Inject basic data
+    docs_collection_t collection = db.main<docs_collection_t>();
+    auto json_alice = R"( { "person": "Alice", "age": 27, "height": 1 } )"_json.dump();
+    auto json_bob = R"( { "person": "Bob", "age": "27", "weight": 2 } )"_json.dump();
+    auto json_carl = R"( { "person": "Carl", "age": 24 } )"_json.dump();
+    collection[1] = json_alice.c_str();
+    collection[2] = json_bob.c_str();
+    collection[3] = json_carl.c_str();
+    M_EXPECT_EQ_JSON(*collection[1].value(), json_alice.c_str());
+    M_EXPECT_EQ_JSON(*collection[2].value(), json_bob.c_str());
+
+    // Just column names
+    {
+        auto maybe_fields = collection[1].gist();
+        auto fields = *maybe_fields;
+
+        std::vector<std::string> parsed;
+        for (auto field : fields)
+            parsed.emplace_back(field.data());
+
+        EXPECT_NE(std::find(parsed.begin(), parsed.end(), "/person"), parsed.end());
+        EXPECT_NE(std::find(parsed.begin(), parsed.end(), "/height"), parsed.end());
+        EXPECT_NE(std::find(parsed.begin(), parsed.end(), "/age"), parsed.end());
+        EXPECT_EQ(std::find(parsed.begin(), parsed.end(), "/weight"), parsed.end());
+    }
+
+    // Single cell
+    {
+        auto header = table_header().with<std::uint32_t>("age");
+        auto maybe_table = collection[1].gather(header);
+        auto table = *maybe_table;
+        auto col0 = table.column<0>();
+
+        EXPECT_EQ(col0[0].value, 27);
+        EXPECT_FALSE(col0[0].converted);
+    }
+
+    // Single row
+    {
+        auto header = table_header() //
+                          .with<std::uint32_t>("age")
+                          .with<std::int32_t>("age")
+                          .with<std::string_view>("age");
+
+        auto maybe_table = collection[1].gather(header);
+        auto table = *maybe_table;
+        auto col0 = table.column<0>();
+        auto col1 = table.column<1>();
+        auto col2 = table.column<2>();
+
+        EXPECT_EQ(col0[0].value, 27);
+        EXPECT_FALSE(col0[0].converted);
+        EXPECT_EQ(col1[0].value, 27);
+        EXPECT_TRUE(col1[0].converted);
+        EXPECT_STREQ(col2[0].value.data(), "27");
+        EXPECT_TRUE(col2[0].converted);
+    }
+
+    // Single column
+    {
+        auto header = table_header().with<std::int32_t>("age");
+        auto maybe_table = collection[{1, 2, 3, 123456}].gather(header);
+        auto table = *maybe_table;
+        auto col0 = table.column<0>();
+
+        EXPECT_EQ(col0[0].value, 27);
+        EXPECT_EQ(col0[1].value, 27);
+        EXPECT_TRUE(col0[1].converted);
+        EXPECT_EQ(col0[2].value, 24);
+    }
+
+    // Single strings column
+    {
+        auto header = table_header().with<std::string_view>("age");
+        auto maybe_table = collection[{1, 2, 3, 123456}].gather(header);
+        auto table = *maybe_table;
+        auto col0 = table.column<0>();
+
+        EXPECT_STREQ(col0[0].value.data(), "27");
+        EXPECT_TRUE(col0[0].converted);
+        EXPECT_STREQ(col0[1].value.data(), "27");
+        EXPECT_STREQ(col0[2].value.data(), "24");
+    }
+
+    // Multi-column
+    {
+        auto header = table_header() //
+                          .with<std::int32_t>("age")
+                          .with<std::string_view>("age")
+                          .with<std::string_view>("person")
+                          .with<float>("person")
+                          .with<std::int32_t>("height")
+                          .with<std::uint64_t>("weight");
+
+        auto maybe_table = collection[{1, 2, 3, 123456, 654321}].gather(header);
+        auto table = *maybe_table;
+        auto col0 = table.column<0>();
+        auto col1 = table.column<1>();
+        auto col2 = table.column<2>();
+        auto col3 = table.column<3>();
+        auto col4 = table.column<4>();
+        auto col5 = table.column<5>();
+
+        EXPECT_EQ(col0[0].value, 27);
+        EXPECT_EQ(col0[1].value, 27);
+        EXPECT_TRUE(col0[1].converted);
+        EXPECT_EQ(col0[2].value, 24);
+
+        EXPECT_STREQ(col1[0].value.data(), "27");
+        EXPECT_TRUE(col1[0].converted);
+        EXPECT_STREQ(col1[1].value.data(), "27");
+        EXPECT_STREQ(col1[2].value.data(), "24");
+    }
+
+    // Multi-column Type-punned exports
+    {
+        table_header_t header {{
+            field_type_t {"age", ustore_doc_field_i32_k},
+            field_type_t {"age", ustore_doc_field_str_k},
+            field_type_t {"person", ustore_doc_field_str_k},
+            field_type_t {"person", ustore_doc_field_f32_k},
+            field_type_t {"height", ustore_doc_field_i32_k},
+            field_type_t {"weight", ustore_doc_field_u64_k},
+        }};
+
+        auto maybe_table = collection[{1, 2, 3, 123456, 654321}].gather(header);
+        auto table = *maybe_table;
+        auto col0 = table.column(0).as<std::int32_t>();
+        auto col1 = table.column(1).as<value_view_t>();
+        auto col2 = table.column(2).as<value_view_t>();
+        auto col3 = table.column(3).as<float>();
+        auto col4 = table.column(4).as<std::int32_t>();
+        auto col5 = table.column(5).as<std::uint64_t>();
+
+        EXPECT_EQ(col0[0].value, 27);
+        EXPECT_EQ(col0[1].value, 27);
+        EXPECT_TRUE(col0[1].converted);
+        EXPECT_EQ(col0[2].value, 24);
+
+        EXPECT_STREQ(col1[0].value.c_str(), "27");
+        EXPECT_TRUE(col1[0].converted);
+        EXPECT_STREQ(col1[1].value.c_str(), "27");
+        EXPECT_STREQ(col1[2].value.c_str(), "24");
+    }
+}
+
+/**
+ * Gathers columns only from the documents, that pass a conjunction of comparisons.
+ */
+TEST(db, docs_gather_filtered) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+
+    docs_collection_t collection = db.main<docs_collection_t>();
+    collection[1] = R"( { "person": "Alice", "age": 27 } )";
+    collection[2] = R"( { "person": "Bob", "age": "27" } )";
+    collection[3] = R"( { "person": "Carl", "age": 24 } )";
+    collection[4] = R"( { "person": "Dave", "age": 42 } )";
+
+    ustore_key_t keys[] = {1, 2, 3, 4, 5};
+    ustore_str_view_t fields[] = {"person", "age"};
+    ustore_doc_field_type_t types[] = {ustore_doc_field_str_k, ustore_doc_field_i32_k};
+    ustore_str_view_t filters_fields[] = {"age", "person"};
+    ustore_doc_compare_t filters_operators[] = {ustore_doc_compare_ge_k, ustore_doc_compare_ne_k};
+    ustore_str_view_t filters_values[] = {"25", R"("Dave")"};
+
+    arena_t arena(db);
+    status_t status;
+    ustore_size_t selected_count = 0;
+    ustore_length_t* selected_indices = nullptr;
+    ustore_octet_t** validities = nullptr;
+    ustore_byte_t** scalars = nullptr;
+    ustore_length_t** offsets = nullptr;
+    ustore_length_t** lengths = nullptr;
+    ustore_byte_t* strings = nullptr;
+
+    ustore_docs_gather_t docs_gather {};
+    docs_gather.db = db;
+    docs_gather.error = status.member_ptr();
+    docs_gather.arena = arena.member_ptr();
+    docs_gather.docs_count = 5;
+    docs_gather.fields_count = 2;
+    docs_gather.keys = keys;
+    docs_gather.keys_stride = sizeof(ustore_key_t);
+    docs_gather.fields = fields;
+    docs_gather.fields_stride = sizeof(ustore_str_view_t);
+    docs_gather.types = types;
+    docs_gather.types_stride = sizeof(ustore_doc_field_type_t);
+    docs_gather.filters_count = 2;
+    docs_gather.filters_fields = filters_fields;
+    docs_gather.filters_fields_stride = sizeof(ustore_str_view_t);
+    docs_gather.filters_operators = filters_operators;
+    docs_gather.filters_operators_stride = sizeof(ustore_doc_compare_t);
+    docs_gather.filters_values = filters_values;
+    docs_gather.filters_values_stride = sizeof(ustore_str_view_t);
+    docs_gather.selected_count = &selected_count;
+    docs_gather.selected_indices = &selected_indices;
+    docs_gather.columns_validities = &validities;
+    docs_gather.columns_scalars = &scalars;
+    docs_gather.columns_offsets = &offsets;
+    docs_gather.columns_lengths = &lengths;
+    docs_gather.joined_strings = &strings;
+    ustore_docs_gather(&docs_gather);
+    EXPECT_TRUE(status);
+
+    // Only Alice passes: Bob's age is a string, Carl is too young and Dave is excluded
+    EXPECT_EQ(selected_count, 1u);
+    EXPECT_EQ(selected_indices[0], 0u);
+    EXPECT_EQ(reinterpret_cast<std::int32_t const*>(scalars[1])[0], 27);
+    EXPECT_STREQ(reinterpret_cast<char const*>(strings) + offsets[0][0], "Alice");
+    EXPECT_EQ(lengths[0][0], 5u);
+    EXPECT_TRUE(validities[0][0] & 1);
+}
+
+/**
+ * Gathers enough documents to be split between several threads, with some of them missing
+ * and some lacking the strings field. Strings columns are joined from the parts of every
+ * thread, so offsets must continue across the chunk boundaries, and the bits of missing
+ * values must stay unset, even when they share a byte of the bitmap with present ones.
+ */
+TEST(db, docs_gather_chunks) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+
+    // Every third document is missing, and every fifth of the present ones has no name
+    constexpr std::size_t docs_count = 3 * 4096 + 100;
+    auto is_missing = [](std::size_t idx) { return idx % 3 == 0; };
+    auto is_nameless = [](std::size_t idx) { return idx % 5 == 0; };
+    auto name = [](std::size_t idx) { return fmt::format("doc-{}", idx); };
+
+    docs_collection_t collection = db.main<docs_collection_t>();
+    std::vector<ustore_key_t> keys(docs_count);
+    std::iota(keys.begin(), keys.end(), 0);
+    for (std::size_t idx = 0; idx != docs_count; ++idx) {
+        if (is_missing(idx))
+            continue;
+        std::string json = is_nameless(idx) //
+                               ? fmt::format(R"({{"age":{}}})", idx)
+                               : fmt::format(R"({{"name":"{}","age":{}}})", name(idx), idx);
+        collection[keys[idx]] = json.c_str();
+    }
+
+    ustore_str_view_t fields[] = {"name", "age"};
+    ustore_doc_field_type_t types[] = {ustore_doc_field_str_k, ustore_doc_field_i32_k};
+
+    arena_t arena(db);
+    status_t status;
+    ustore_octet_t** validities = nullptr;
+    ustore_byte_t** scalars = nullptr;
+    ustore_length_t** offsets = nullptr;
+    ustore_length_t** lengths = nullptr;
+    ustore_byte_t* strings = nullptr;
+
+    ustore_docs_gather_t docs_gather {};
+    docs_gather.db = db;
+    docs_gather.error = status.member_ptr();
+    docs_gather.arena = arena.member_ptr();
+    docs_gather.docs_count = docs_count;
+    docs_gather.fields_count = 2;
+    docs_gather.keys = keys.data();
+    docs_gather.keys_stride = sizeof(ustore_key_t);
+    docs_gather.fields = fields;
+    docs_gather.fields_stride = sizeof(ustore_str_view_t);
+    docs_gather.types = types;
+    docs_gather.types_stride = sizeof(ustore_doc_field_type_t);
+    docs_gather.columns_validities = &validities;
+    docs_gather.columns_scalars = &scalars;
+    docs_gather.columns_offsets = &offsets;
+    docs_gather.columns_lengths = &lengths;
+    docs_gather.joined_strings = &strings;
+    ustore_docs_gather(&docs_gather);
+    EXPECT_TRUE(status);
+
+    auto is_valid = [&](std::size_t field_idx, std::size_t idx) {
+        return ((validities[field_idx][idx / 8] >> (idx % 8)) & 1) != 0;
+    };
+    auto ages = reinterpret_cast<std::int32_t const*>(scalars[1]);
+    for (std::size_t idx = 0; idx != docs_count; ++idx) {
+        bool has_name = !is_missing(idx) && !is_nameless(idx);
+        EXPECT_EQ(is_valid(0, idx), has_name) << idx;
+        EXPECT_EQ(is_valid(1, idx), !is_missing(idx)) << idx;
+        if (!is_missing(idx))
+            EXPECT_EQ(ages[idx], static_cast<std::int32_t>(idx));
+
+        // Every string, including the empty ones, is followed by a NULL-terminator
+        std::string expected = has_name ? name(idx) : std::string();
+        EXPECT_EQ(lengths[0][idx], expected.size()) << idx;
+        EXPECT_EQ(offsets[0][idx + 1] - offsets[0][idx], expected.size() + 1) << idx;
+        EXPECT_STREQ(reinterpret_cast<char const*>(strings) + offsets[0][idx], expected.c_str()) << idx;
+    }
+    EXPECT_TRUE(db.clear());
+}
+
+/**
+ * Streams blobs and documents into Arrow batches with `ustore_to_arrow_stream()`,
+ * checking that batches remain valid after the next ones are fetched.
+ */
+TEST(db, arrow_stream) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+    status_t status;
+
+    // Blobs are exported as keys and values
+    {
+        blobs_collection_t collection = db.main();
+        std::array<ustore_key_t, 10> keys;
+        std::iota(keys.begin(), keys.end(), 0);
+        value_view_t value("value");
+        EXPECT_TRUE(collection[keys].assign(value));
+
+        ustore_collection_t collections[] = {collection};
+        ArrowArrayStream stream;
+        ustore_to_arrow_stream( //
+            db,
+            nullptr,
+            0,
+            4,
+            1,
+            100,
+            collections,
+            1,
+            nullptr,
+            nullptr,
+            0,
+            &stream,
+            status.member_ptr());
+        EXPECT_TRUE(status);
+
+        ArrowSchema schema;
+        EXPECT_EQ(stream.get_schema(&stream, &schema), 0);
+        EXPECT_STREQ(schema.format, "+s");
+        EXPECT_EQ(schema.n_children, 2);
+        EXPECT_STREQ(schema.children[0]->format, "l");
+        EXPECT_STREQ(schema.children[1]->format, "z");
+        schema.release(&schema);
+
+        std::vector<ArrowArray> batches;
+        ArrowArray batch;
+        while (stream.get_next(&stream, &batch) == 0 && batch.release)
+            batches.push_back(batch);
+        EXPECT_EQ(batch.release, nullptr);
+        stream.release(&stream);
+
+        ASSERT_EQ(batches.size(), 3u);
+        EXPECT_EQ(batches[0].length, 4);
+        EXPECT_EQ(batches[2].length, 1);
+        auto first_keys = reinterpret_cast<ustore_key_t const*>(batches[0].children[0]->buffers[1]);
+        auto last_keys = reinterpret_cast<ustore_key_t const*>(batches[2].children[0]->buffers[1]);
+        EXPECT_EQ(first_keys[0], 1);
+        EXPECT_EQ(last_keys[0], 9);
+        auto offsets = reinterpret_cast<ustore_length_t const*>(batches[0].children[1]->buffers[1]);
+        auto values = reinterpret_cast<char const*>(batches[0].children[1]->buffers[2]);
+        EXPECT_EQ(std::string_view(values + offsets[1], offsets[2] - offsets[1]), "value");
+        for (auto& exported : batches)
+            exported.release(&exported);
+    }
+
+    EXPECT_TRUE(db.clear());
+
+    // Documents are exported as keys and the requested fields
+    {
+        docs_collection_t collection = db.main<docs_collection_t>();
+        collection[1] = R"( { "person": "Alice", "age": 27 } )";
+        collection[2] = R"( { "person": "Bob" } )";
+        collection[3] = R"( { "person": "Carl", "age": 24 } )";
+
+        ustore_collection_t collections[] = {collection};
+        ustore_str_view_t fields[] = {"person", "age"};
+        ustore_doc_field_type_t types[] = {ustore_doc_field_str_k, ustore_doc_field_i32_k};
+        ArrowArrayStream stream;
+        ustore_to_arrow_stream( //
+            db,
+            nullptr,
+            0,
+            2,
+            0,
+            100,
+            collections,
+            1,
+            fields,
+            types,
+            2,
+            &stream,
+            status.member_ptr());
+        EXPECT_TRUE(status);
+
+        ArrowSchema schema;
+        EXPECT_EQ(stream.get_schema(&stream, &schema), 0);
+        EXPECT_EQ(schema.n_children, 3);
+        EXPECT_STREQ(schema.children[1]->name, "person");
+        EXPECT_STREQ(schema.children[1]->format, "u");
+        EXPECT_STREQ(schema.children[2]->format, "i");
+        schema.release(&schema);
+
+        ArrowArray first, second, end;
+        EXPECT_EQ(stream.get_next(&stream, &first), 0);
+        EXPECT_EQ(stream.get_next(&stream, &second), 0);
+        EXPECT_EQ(stream.get_next(&stream, &end), 0);
+        EXPECT_EQ(end.release, nullptr);
+        stream.release(&stream);
+
+        ASSERT_EQ(first.length, 2);
+        ASSERT_EQ(second.length, 1);
+        ArrowArray const& persons = *first.children[1];
+        ArrowArray const& ages = *first.children[2];
+        auto strings = reinterpret_cast<char const*>(persons.buffers[2]);
+        EXPECT_STREQ(strings + reinterpret_cast<ustore_length_t const*>(persons.buffers[1])[1], "Bob");
+        EXPECT_EQ(reinterpret_cast<std::int32_t const*>(ages.buffers[1])[0], 27);
+        EXPECT_TRUE(check_presence(reinterpret_cast<ustore_octet_t const*>(ages.buffers[0]), 0));
+        EXPECT_FALSE(check_presence(reinterpret_cast<ustore_octet_t const*>(ages.buffers[0]), 1));
+        first.release(&first);
+        second.release(&second);
+    }
+}
+
+/**
+ * Maintains a secondary index over the "age" field, while documents are
+ * added, updated and removed, querying it by exact values and ranges.
+ */
+TEST(db, docs_secondary_index) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    if (!db.supports_named_collections())
+        return;
+    EXPECT_TRUE(db.clear());
+
+    docs_collection_t docs = *db.create<docs_collection_t>("people");
+    blobs_collection_t ages = *db.create("people_by_age");
+    ustore_collection_t docs_collection = docs;
+    ustore_collection_t index_collection = ages;
+    ustore_str_view_t index_field = "age";
+
+    arena_t arena(db);
+    status_t status;
+
+    auto write = [&](std::vector<ustore_key_t> const& keys, std::vector<char const*> const& jsons) {
+        std::vector<ustore_length_t> lengths(jsons.size());
+        for (std::size_t i = 0; i != jsons.size(); ++i)
+            lengths[i] = jsons[i] ? std::strlen(jsons[i]) : ustore_length_missing_k;
+        ustore_docs_write_t docs_write {};
+        docs_write.db = db;
+        docs_write.error = status.member_ptr();
+        docs_write.arena = arena.member_ptr();
+        docs_write.type = ustore_doc_field_json_k;
+        docs_write.tasks_count = keys.size();
+        docs_write.collections = &docs_collection;
+        docs_write.keys = keys.data();
+        docs_write.keys_stride = sizeof(ustore_key_t);
+        docs_write.lengths = lengths.data();
+        docs_write.lengths_stride = sizeof(ustore_length_t);
+        docs_write.values = reinterpret_cast<ustore_bytes_cptr_t const*>(jsons.data());
+        docs_write.values_stride = sizeof(char const*);
+        docs_write.indexes_count = 1;
+        docs_write.indexes_fields = &index_field;
+        docs_write.indexes_collections = &index_collection;
+        ustore_docs_write(&docs_write);
+        EXPECT_TRUE(status);
+    };
+
+    auto find = [&](ustore_collection_t index, char const* min, char const* max) {
+        ustore_length_t* found_counts {};
+        ustore_key_t* found_keys {};
+        ustore_docs_index_find_t index_find {};
+        index_find.db = db;
+        index_find.error = status.member_ptr();
+        index_find.arena = arena.member_ptr();
+        index_find.tasks_count = 1;
+        index_find.indexes = &index;
+        index_find.values_min = &min;
+        index_find.values_max = max ? &max : nullptr;
+        index_find.counts = &found_counts;
+        index_find.keys = &found_keys;
+        ustore_docs_index_find(&index_find);
+        EXPECT_TRUE(status);
+        return std::vector<ustore_key_t>(found_keys, found_keys + found_counts[0]);
+    };
+
+    using keys_t = std::vector<ustore_key_t>;
+    write({1, 2, 3, 4},
+          {R"({"person":"Alice","age":27})",
+           R"({"person":"Bob","age":"27"})",
+           R"({"person":"Carl","age":24.0})",
+           R"({"person":"Dave","age":27})"});
+    EXPECT_EQ(find(index_collection, "27", nullptr), (keys_t {1, 4}));
+    EXPECT_EQ(find(index_collection, "\"27\"", nullptr), (keys_t {2}));
+    EXPECT_EQ(find(index_collection, "24", nullptr), (keys_t {3}));
+    EXPECT_EQ(find(index_collection, "20", "30"), (keys_t {1, 3, 4}));
+    EXPECT_EQ(find(index_collection, "-30", "25"), (keys_t {3}));
+
+    // Updates and removals must move the documents between the entries
+    write({1, 4}, {R"({"person":"Alice","age":-1})", nullptr});
+    EXPECT_EQ(find(index_collection, "27", nullptr), (keys_t {}));
+    EXPECT_EQ(find(index_collection, "-30", "25"), (keys_t {1, 3}));
+
+    // Building an index from scratch must produce the same results
+    blobs_collection_t built = *db.create("people_by_age_built");
+    ustore_collection_t built_collection = built;
+    ustore_docs_index_build_t index_build {};
+    index_build.db = db;
+    index_build.error = status.member_ptr();
+    index_build.arena = arena.member_ptr();
+    index_build.collection = docs_collection;
+    index_build.field = index_field;
+    index_build.index = built_collection;
+    ustore_docs_index_build(&index_build);
+    EXPECT_TRUE(status);
+    EXPECT_EQ(find(built_collection, "-30", "30"), (keys_t {1, 3}));
+    EXPECT_EQ(find(built_collection, "\"27\"", nullptr), (keys_t {2}));
+}
+
+/**
+ * Keeps the "age" field of documents in a separate collection, checking that
+ * whole documents, single fields and gathers look the same, as without shredding.
+ */
+TEST(db, docs_shredded) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    if (!db.supports_named_collections())
+        return;
+    EXPECT_TRUE(db.clear());
+
+    blobs_collection_t residuals = *db.create("rows");
+    blobs_collection_t ages = *db.create("rows_ages");
+    ustore_collection_t docs_collection = residuals;
+    ustore_collection_t ages_collection = ages;
+    ustore_str_view_t shredded_field = "age";
+
+    arena_t arena(db);
+    status_t status;
+
+    auto write = [&](ustore_doc_modification_t modification,
+                     std::vector<ustore_key_t> const& keys,
+                     std::vector<char const*> const& jsons) {
+        std::vector<ustore_length_t> lengths(jsons.size());
+        for (std::size_t i = 0; i != jsons.size(); ++i)
+            lengths[i] = jsons[i] ? std::strlen(jsons[i]) : ustore_length_missing_k;
+        ustore_docs_write_t docs_write {};
+        docs_write.db = db;
+        docs_write.error = status.member_ptr();
+        docs_write.arena = arena.member_ptr();
+        docs_write.type = ustore_doc_field_json_k;
+        docs_write.modification = modification;
+        docs_write.tasks_count = keys.size();
+        docs_write.collections = &docs_collection;
+        docs_write.keys = keys.data();
+        docs_write.keys_stride = sizeof(ustore_key_t);
+        docs_write.lengths = lengths.data();
+        docs_write.lengths_stride = sizeof(ustore_length_t);
+        docs_write.values = reinterpret_cast<ustore_bytes_cptr_t const*>(jsons.data());
+        docs_write.values_stride = sizeof(char const*);
+        docs_write.shreds_count = 1;
+        docs_write.shreds_fields = &shredded_field;
+        docs_write.shreds_collections = &ages_collection;
+        ustore_docs_write(&docs_write);
+        EXPECT_TRUE(status);
+    };
+
+    auto read = [&](ustore_key_t key, ustore_str_view_t field) {
+        ustore_length_t* found_offsets {};
+        ustore_length_t* found_lengths {};
+        ustore_byte_t* found_values {};
+        ustore_docs_read_t docs_read {};
+        docs_read.db = db;
+        docs_read.error = status.member_ptr();
+        docs_read.arena = arena.member_ptr();
+        docs_read.type = ustore_doc_field_json_k;
+        docs_read.tasks_count = 1;
+        docs_read.collections = &docs_collection;
+        docs_read.keys = &key;
+        docs_read.fields = field ? &field : nullptr;
+        docs_read.shreds_count = 1;
+        docs_read.shreds_fields = &shredded_field;
+        docs_read.shreds_collections = &ages_collection;
+        docs_read.offsets = &found_offsets;
+        docs_read.lengths = &found_lengths;
+        docs_read.values = &found_values;
+        ustore_docs_read(&docs_read);
+        EXPECT_TRUE(status);
+        return std::string(reinterpret_cast<char const*>(found_values) + found_offsets[0], found_lengths[0]);
+    };
+
+    write(ustore_doc_modify_upsert_k,
+          {1, 2, 3},
+          {R"({"person":"Alice","age":27})", R"({"person":"Bob"})", R"({"age":24,"tags":["a"]})"});
+    EXPECT_EQ(*residuals[1].value(), R"({"person":"Alice"})");
+    EXPECT_EQ(*ages[1].value(), "27");
+    EXPECT_FALSE(*ages[2].present());
+    EXPECT_EQ(*residuals[3].value(), R"({"tags":["a"]})");
+
+    EXPECT_EQ(read(1, nullptr), R"({"age":27,"person":"Alice"})");
+    EXPECT_EQ(read(1, "age"), "27");
+    EXPECT_EQ(read(1, "person"), R"("Alice")");
+    EXPECT_EQ(read(3, "/tags/0"), R"("a")");
+
+    // Patches are applied to the reassembled documents
+    write(ustore_doc_modify_patch_k, {1}, {R"([{"op":"replace","path":"/age","value":28}])"});
+    EXPECT_EQ(*ages[1].value(), "28");
+    EXPECT_EQ(*residuals[1].value(), R"({"person":"Alice"})");
+
+    // Gathers only need the companion collection
+    ustore_key_t keys[] = {1, 2, 3, 4};
+    ustore_doc_field_type_t type = ustore_doc_field_i32_k;
+    ustore_octet_t** validities = nullptr;
+    ustore_octet_t** collisions = nullptr;
+    ustore_byte_t** scalars = nullptr;
+    ustore_docs_gather_t docs_gather {};
+    docs_gather.db = db;
+    docs_gather.error = status.member_ptr();
+    docs_gather.arena = arena.member_ptr();
+    docs_gather.docs_count = 4;
+    docs_gather.fields_count = 1;
+    docs_gather.collections = &docs_collection;
+    docs_gather.keys = keys;
+    docs_gather.keys_stride = sizeof(ustore_key_t);
+    docs_gather.fields = &shredded_field;
+    docs_gather.types = &type;
+    docs_gather.shreds_count = 1;
+    docs_gather.shreds_fields = &shredded_field;
+    docs_gather.shreds_collections = &ages_collection;
+    docs_gather.columns_validities = &validities;
+    docs_gather.columns_collisions = &collisions;
+    docs_gather.columns_scalars = &scalars;
+    ustore_docs_gather(&docs_gather);
+    EXPECT_TRUE(status);
+    EXPECT_EQ(validities[0][0] & 0x0F, 0b0101);
+    EXPECT_EQ(collisions[0][0] & 0x0F, 0b0010);
+    EXPECT_EQ(reinterpret_cast<std::int32_t const*>(scalars[0])[0], 28);
+    EXPECT_EQ(reinterpret_cast<std::int32_t const*>(scalars[0])[2], 24);
+
+    // Removals drop all the parts
+    write(ustore_doc_modify_upsert_k, {3}, {nullptr});
+    EXPECT_FALSE(*residuals[3].present());
+    EXPECT_FALSE(*ages[3].present());
+}
+
+/**
+ * Documents are persisted pre-parsed, but are exported as JSON, and the
+ * textual documents, written through the binary interface, remain readable.
+ */
+TEST(db, docs_pre_parsed) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+
+    docs_collection_t docs = db.main<docs_collection_t>();
+    blobs_collection_t blobs = db.main();
+    auto json = R"({"name":"Alice","age":24,"tags":["a",{"b":1.5}]})";
+    docs[1] = json;
+    EXPECT_EQ(std::string_view(*blobs[1].value()).front(), '\0');
+    EXPECT_EQ(*docs[1].value(), json);
+    EXPECT_EQ(*docs[ckf(1, "name")].value(), R"("Alice")");
+    EXPECT_EQ(*docs[ckf(1, "/tags/1/b")].value(), "1.5");
+    EXPECT_EQ(*docs[ckf(1, "/tags/1")].value(ustore_doc_field_str_k), R"({"b":1.5})");
+
+    blobs[2] = R"({"name": "Bob", "age": 25})";
+    EXPECT_EQ(*docs[ckf(2, "age")].value(), "25");
+    EXPECT_TRUE(docs[2].patch(R"([{"op":"replace","path":"/age","value":26}])"));
+    EXPECT_EQ(std::string_view(*blobs[2].value()).front(), '\0');
+    EXPECT_EQ(*docs[2].value(), R"({"name":"Bob","age":26})");
+}
+
+/**
+ * Replacements of existing values are spliced into the stored documents,
+ * while the structural changes fall back to rebuilding them.
+ */
+TEST(db, docs_modify_in_place) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+
+    docs_collection_t docs = db.main<docs_collection_t>();
+    docs[1] = R"({"name":"Alice","age":24,"tags":["a",{"b":1}]})";
+    EXPECT_TRUE(docs[ckf(1, "/age")].update("25"));
+    EXPECT_TRUE(docs[ckf(1, "/tags/1/b")].upsert(R"("long enough to move the rest")"));
+    EXPECT_EQ(*docs[1].value(), R"({"name":"Alice","age":25,"tags":["a",{"b":"long enough to move the rest"}]})");
+
+    EXPECT_TRUE(docs[1].patch(R"([{"op":"replace","path":"/tags","value":[]}])"));
+    EXPECT_TRUE(docs[1].merge(R"({"name":"Bob"})"));
+    EXPECT_EQ(*docs[1].value(), R"({"name":"Bob","age":25,"tags":[]})");
+    EXPECT_EQ(*docs[ckf(1, "name")].value(), R"("Bob")");
+
+    EXPECT_TRUE(docs[1].merge(R"({"age":null,"weight":70})"));
+    EXPECT_EQ(*docs[1].value(), R"({"name":"Bob","tags":[],"weight":70})");
+}
+
+/**
+ * Upserts a whole NDJSON buffer in one call, taking the keys from the documents.
+ */
+TEST(db, docs_joined) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+
+    arena_t arena(db);
+    status_t status;
+    ustore_collection_t collection = ustore_collection_main_k;
+    char const* joined = R"({"_id":1,"name":"Alice"}
+{"_id":2,"name":"Bob","tags":[1,-2]}
+{"_id":3,"name":"Carl"}
+)";
+
+    ustore_docs_write_t docs_write {};
+    docs_write.db = db;
+    docs_write.error = status.member_ptr();
+    docs_write.arena = arena.member_ptr();
+    docs_write.tasks_count = 3;
+    docs_write.type = ustore_doc_field_json_k;
+    docs_write.modification = ustore_doc_modify_upsert_k;
+    docs_write.collections = &collection;
+    docs_write.values = reinterpret_cast<ustore_bytes_cptr_t const*>(&joined);
+    docs_write.id_field = "_id";
+    docs_write.values_joined = true;
+    ustore_docs_write(&docs_write);
+    EXPECT_TRUE(status);
+
+    docs_collection_t docs = db.main<docs_collection_t>();
+    EXPECT_EQ(*docs[1].value(), R"({"_id":1,"name":"Alice"})");
+    EXPECT_EQ(*docs[2].value(), R"({"_id":2,"name":"Bob","tags":[1,-2]})");
+    EXPECT_EQ(*docs[ckf(3, "name")].value(), R"("Carl")");
+
+    // The number of documents must match the number of tasks
+    docs_write.tasks_count = 2;
+    ustore_docs_write(&docs_write);
+    EXPECT_FALSE(status);
+}
+
+/**
+ * Samples the documents to list their paths with per-path presence counts
+ * and type histograms, that suggest the types for later gathering.
+ */
+TEST(db, docs_gist_sampled) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+
+    docs_collection_t docs = db.main<docs_collection_t>();
+    docs[1] = R"({"name":"Alice","age":27})";
+    docs[2] = R"({"name":"Bob","age":-3,"height":1.8})";
+    docs[3] = R"({"name":"Carl","age":"old","tags":[true]})";
+
+    arena_t arena(db);
+    status_t status;
+    ustore_size_t fields_count = 0;
+    ustore_length_t* offsets = nullptr;
+    ustore_char_t* fields = nullptr;
+    ustore_size_t docs_present = 0;
+    ustore_size_t* presences = nullptr;
+    ustore_size_t* types_counts = nullptr;
+    ustore_doc_field_type_t* types = nullptr;
+
+    ustore_docs_gist_t docs_gist {};
+    docs_gist.db = db;
+    docs_gist.error = status.member_ptr();
+    docs_gist.arena = arena.member_ptr();
+    docs_gist.sample_count = 3;
+    docs_gist.fields_count = &fields_count;
+    docs_gist.offsets = &offsets;
+    docs_gist.fields = &fields;
+    docs_gist.docs_present = &docs_present;
+    docs_gist.presences = &presences;
+    docs_gist.types_counts = &types_counts;
+    docs_gist.types = &types;
+    ustore_docs_gist(&docs_gist);
+    EXPECT_TRUE(status);
+    EXPECT_EQ(fields_count, 4u);
+    EXPECT_EQ(docs_present, 3u);
+
+    std::map<std::string, std::size_t> found;
+    for (std::size_t field_idx = 0; field_idx != fields_count; ++field_idx)
+        found[fields + offsets[field_idx]] = field_idx;
+    auto counts = [&](char const* path) { return types_counts + found.at(path) * ustore_doc_gist_types_k; };
+
+    EXPECT_EQ(presences[found.at("/name")], 3u);
+    EXPECT_EQ(counts("/name")[ustore_doc_gist_str_k], 3u);
+    EXPECT_EQ(types[found.at("/name")], ustore_doc_field_str_k);
+
+    EXPECT_EQ(presences[found.at("/age")], 3u);
+    EXPECT_EQ(counts("/age")[ustore_doc_gist_u64_k], 1u);
+    EXPECT_EQ(counts("/age")[ustore_doc_gist_i64_k], 1u);
+    EXPECT_EQ(counts("/age")[ustore_doc_gist_str_k], 1u);
+    EXPECT_EQ(types[found.at("/age")], ustore_doc_field_str_k);
+
+    EXPECT_EQ(presences[found.at("/height")], 1u);
+    EXPECT_EQ(types[found.at("/height")], ustore_doc_field_f64_k);
+    EXPECT_EQ(presences[found.at("/tags/0")], 1u);
+    EXPECT_EQ(types[found.at("/tags/0")], ustore_doc_field_bool_k);
+}
+
+#pragma region Graph Modality
+
+edge_t make_edge(ustore_key_t edge_id, ustore_key_t v1, ustore_key_t v2) {
+    return {v1, v2, edge_id};
+}
+
+std::vector<edge_t> make_edges(std::size_t vertices_count = 2, std::size_t next_connect = 1) {
+    std::vector<edge_t> es;
+    ustore_key_t edge_id = 0;
+    for (ustore_key_t vertex_id = 0; vertex_id != vertices_count; ++vertex_id) {
+        ustore_key_t connect_with = vertex_id + next_connect;
+        while (connect_with < vertices_count) {
+            edge_id++;
+            es.push_back(make_edge(edge_id, vertex_id, connect_with));
+            connect_with = connect_with + next_connect;
+        }
+    }
+    return es;
+}
+
+/**
+ * Upsert disconnected vertices into the graph.
+ */
+TEST(db, graph_upsert_vertices) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+
+    graph_collection_t net = db.main<graph_collection_t>();
+    std::vector<ustore_key_t> vertices {1, 4, 5, 2};
+    EXPECT_TRUE(net.upsert_vertices(vertices));
+
+    EXPECT_TRUE(*net.contains(1));
+    EXPECT_TRUE(*net.contains(2));
+    EXPECT_TRUE(*net.contains(4));
+    EXPECT_TRUE(*net.contains(5));
+}
+
+/**
+ * Upsert an edge and its member vertices into the graph.
+ */
+TEST(db, graph_upsert_edge) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
 
-    // Upsert By Field
-    modifier = R"("Charles")"_json.dump();
-    expected = R"( {"person": "Charles", "age": 26} )"_json.dump();
-    EXPECT_TRUE(collection[ckf(1, "/person")].upsert(modifier.c_str()));
-    result = collection[1].value();
-    M_EXPECT_EQ_JSON(result->c_str(), expected.c_str());
+    graph_collection_t net = db.main<graph_collection_t>();
+    edge_t edge {1, 2, 9};
+    EXPECT_TRUE(net.upsert_edge(edge));
+    EXPECT_TRUE(*net.contains(1));
+    EXPECT_TRUE(*net.contains(2));
+    EXPECT_FALSE(*net.contains(3));
 
-    modifier = R"(70)"_json.dump();
-    expected = R"( {"person": "Charles", "age": 26, "weight" : 70} )"_json.dump();
-    EXPECT_TRUE(collection[ckf(1, "/weight")].upsert(modifier.c_str()));
-    result = collection[1].value();
-    M_EXPECT_EQ_JSON(result->c_str(), expected.c_str());
+    auto neighbors = net.neighbors(1).throw_or_release();
+    EXPECT_EQ(neighbors.size(), 1);
+    EXPECT_EQ(neighbors[0], 2);
 }
 
 /**
- * Uses a well-known repository of JSON-Patches and JSON-MergePatches,
- * to validate that document modifications work adequately in corner cases.
+ * Tests "Graphs" Modality, with on of the simplest network designs - a triangle.
+ * Three vertices, three connections between them, forming 3 undirected, or 6 directed edges.
+ * Tests edge upsert, existence checks, degree computation, vertex removals.
  */
-TEST(db, docs_merge_and_patch) {
-    using json_t = nlohmann::json;
+TEST(db, graph_triangle) {
+
     database_t db;
     EXPECT_TRUE(db.open(config().c_str()));
     EXPECT_TRUE(db.clear());
-    docs_collection_t collection = db.main<docs_collection_t>();
 
-    std::ifstream f_patch("tests/patch.json");
-    json_t j_object = json_t::parse(f_patch);
-    for (auto it : j_object) {
-        auto doc = it["doc"].dump();
-        auto patch = it["patch"].dump();
-        auto expected = it["expected"].dump();
-        collection[1] = doc.c_str();
-        EXPECT_TRUE(collection[1].patch(patch.c_str()));
-        auto maybe_value = collection[1].value();
-        EXPECT_TRUE(maybe_value);
-        M_EXPECT_EQ_JSON(maybe_value->c_str(), expected.c_str());
+    graph_collection_t net = db.main<graph_collection_t>();
+
+    // triangle
+    edge_t edge1 {1, 2, 9};
+    edge_t edge2 {2, 3, 10};
+    edge_t edge3 {3, 1, 11};
+
+    EXPECT_TRUE(net.upsert_edge(edge1));
+    EXPECT_TRUE(net.upsert_edge(edge2));
+    EXPECT_TRUE(net.upsert_edge(edge3));
+
+    auto neighbors = net.neighbors(1).throw_or_release();
+    EXPECT_EQ(neighbors.size(), 2);
+    EXPECT_EQ(neighbors[0], 2);
+    EXPECT_EQ(neighbors[1], 3);
+
+    EXPECT_TRUE(*net.contains(1));
+    EXPECT_TRUE(*net.contains(2));
+    EXPECT_FALSE(*net.contains(9));
+    EXPECT_FALSE(*net.contains(10));
+    EXPECT_FALSE(*net.contains(1000));
+
+    EXPECT_EQ(*net.degree(1), 2u);
+    EXPECT_EQ(*net.degree(2), 2u);
+    EXPECT_EQ(*net.degree(3), 2u);
+    EXPECT_EQ(*net.degree(1, ustore_vertex_source_k), 1u);
+    EXPECT_EQ(*net.degree(2, ustore_vertex_source_k), 1u);
+    EXPECT_EQ(*net.degree(3, ustore_vertex_source_k), 1u);
+
+    EXPECT_TRUE(net.edges_containing(1));
+    EXPECT_EQ(net.edges_containing(1)->size(), 2ul);
+    EXPECT_EQ(net.edges_containing(1, ustore_vertex_source_k)->size(), 1ul);
+    EXPECT_EQ(net.edges_containing(1, ustore_vertex_target_k)->size(), 1ul);
+
+    EXPECT_EQ(net.edges_containing(3, ustore_vertex_target_k)->size(), 1ul);
+    EXPECT_EQ(net.edges_containing(2, ustore_vertex_source_k)->size(), 1ul);
+    EXPECT_EQ((*net.edges_containing(3, ustore_vertex_target_k))[0].source_id, 2);
+    EXPECT_EQ((*net.edges_containing(3, ustore_vertex_target_k))[0].target_id, 3);
+    EXPECT_EQ((*net.edges_containing(3, ustore_vertex_target_k))[0].id, 10);
+    EXPECT_EQ(net.edges_between(3, 1)->size(), 1ul);
+    EXPECT_EQ(net.edges_between(1, 3)->size(), 0ul);
+
+    // Check scans
+    EXPECT_TRUE(net.edges());
+    {
+        std::vector<edge_t> expected_edges {edge1, edge2, edge3};
+        std::vector<edge_t> exported_edges;
+
+        auto present_edges = *net.edges(ustore_vertex_source_k);
+        auto present_it = std::move(present_edges).begin();
+        auto count_results = 0;
+        while (!present_it.is_end()) {
+            exported_edges.push_back(*present_it);
+            ++present_it;
+            ++count_results;
+        }
+        EXPECT_EQ(count_results, 3);
+        EXPECT_EQ(exported_edges, expected_edges);
     }
 
-    std::ifstream f_merge("tests/merge.json");
-    j_object = json_t::parse(f_merge);
-    for (auto it : j_object) {
-        auto doc = it["doc"].dump();
-        auto merge = it["merge"].dump();
-        auto expected = it["expected"].dump();
-        collection[1] = doc.c_str();
-        EXPECT_TRUE(collection[1].merge(merge.c_str()));
-        auto maybe_value = collection[1].value();
-        EXPECT_TRUE(maybe_value);
-        M_EXPECT_EQ_JSON(maybe_value->c_str(), expected.c_str());
+    // Remove a single edge, making sure that the nodes info persists
+    EXPECT_TRUE(net.remove_edges({
+        {{&edge1.source_id}, 1},
+        {{&edge1.target_id}, 1},
+        {{&edge1.id}, 1},
+    }));
+    EXPECT_TRUE(*net.contains(1));
+    EXPECT_TRUE(*net.contains(2));
+    EXPECT_EQ(net.edges_between(1, 2)->size(), 0ul);
+
+    // Bring that edge back
+    EXPECT_TRUE(net.upsert_edges({
+        {{&edge1.source_id}, 1},
+        {{&edge1.target_id}, 1},
+        {{&edge1.id}, 1},
+    }));
+    EXPECT_EQ(net.edges_between(1, 2)->size(), 1ul);
+
+    // Remove a vertex
+    ustore_key_t vertex_to_remove = 2;
+    EXPECT_TRUE(net.remove_vertex(vertex_to_remove));
+    EXPECT_FALSE(*net.contains(vertex_to_remove));
+    EXPECT_EQ(net.edges_containing(vertex_to_remove)->size(), 0ul);
+    EXPECT_EQ(net.edges_between(1, vertex_to_remove)->size(), 0ul);
+    EXPECT_EQ(net.edges_between(vertex_to_remove, 1)->size(), 0ul);
+
+    // Bring back the whole graph
+    EXPECT_TRUE(net.upsert_edge(edge1));
+    EXPECT_TRUE(net.upsert_edge(edge2));
+    EXPECT_TRUE(net.upsert_edge(edge3));
+    EXPECT_TRUE(*net.contains(vertex_to_remove));
+    EXPECT_EQ(net.edges_containing(vertex_to_remove)->size(), 2ul);
+    EXPECT_EQ(net.edges_between(1, vertex_to_remove)->size(), 1ul);
+    EXPECT_EQ(net.edges_between(vertex_to_remove, 1)->size(), 0ul);
+}
+
+/**
+ * Further complicates the `graph_triangle` test by performing all of the updates
+ * and lookups in batches. This detects inconsistencies in concurrent updates to
+ * the underlying binary representation, triggered from a single high-level
+ * graph operation.
+ */
+TEST(db, graph_triangle_batch) {
+
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+
+    blobs_collection_t main = db.main();
+    graph_collection_t net = db.main<graph_collection_t>();
+
+    std::vector<edge_t> triangle {
+        {1, 2, 9},
+        {2, 3, 10},
+        {3, 1, 11},
+    };
+
+    EXPECT_TRUE(net.upsert_edges(edges(triangle)));
+    EXPECT_TRUE(*net.contains(1));
+    EXPECT_TRUE(*net.contains(2));
+    EXPECT_FALSE(*net.contains(9));
+    EXPECT_FALSE(*net.contains(10));
+    EXPECT_FALSE(*net.contains(1000));
+
+    EXPECT_EQ(*net.degree(1), 2u);
+    EXPECT_EQ(*net.degree(2), 2u);
+    EXPECT_EQ(*net.degree(3), 2u);
+    EXPECT_EQ(*net.degree(1, ustore_vertex_source_k), 1u);
+    EXPECT_EQ(*net.degree(2, ustore_vertex_source_k), 1u);
+    EXPECT_EQ(*net.degree(3, ustore_vertex_source_k), 1u);
+
+    EXPECT_TRUE(net.edges_containing(1));
+    EXPECT_EQ(net.edges_containing(1)->size(), 2ul);
+    EXPECT_EQ(net.edges_containing(1, ustore_vertex_source_k)->size(), 1ul);
+    EXPECT_EQ(net.edges_containing(1, ustore_vertex_target_k)->size(), 1ul);
+
+    EXPECT_EQ(net.edges_containing(3, ustore_vertex_target_k)->size(), 1ul);
+    EXPECT_EQ(net.edges_containing(2, ustore_vertex_source_k)->size(), 1ul);
+    EXPECT_EQ((*net.edges_containing(3, ustore_vertex_target_k))[0].source_id, 2);
+    EXPECT_EQ((*net.edges_containing(3, ustore_vertex_target_k))[0].target_id, 3);
+    EXPECT_EQ((*net.edges_containing(3, ustore_vertex_target_k))[0].id, 10);
+    EXPECT_EQ(net.edges_between(3, 1)->size(), 1ul);
+    EXPECT_EQ(net.edges_between(1, 3)->size(), 0ul);
+
+    // Check scans
+    EXPECT_TRUE(net.edges());
+    {
+        std::vector<edge_t> expected_edges {triangle.begin(), triangle.end()};
+        std::vector<edge_t> exported_edges;
+
+        auto present_edges = *net.edges(ustore_vertex_source_k);
+        auto present_it = std::move(present_edges).begin();
+        size_t count_results = 0ul;
+        while (!present_it.is_end()) {
+            exported_edges.push_back(*present_it);
+            ++present_it;
+            ++count_results;
+        }
+        EXPECT_EQ(count_results, triangle.size());
+        EXPECT_EQ(exported_edges, expected_edges);
     }
+
+    // Remove a single edge, making sure that the nodes info persists
+    EXPECT_TRUE(net.remove_edges(edges_view_t {
+        {{&triangle[0].source_id}, 1},
+        {{&triangle[0].target_id}, 1},
+        {{&triangle[0].id}, 1},
+    }));
+    EXPECT_TRUE(*net.contains(1));
+    EXPECT_TRUE(*net.contains(2));
+    EXPECT_EQ(net.edges_between(1, 2)->size(), 0ul);
+
+    // Bring that edge back
+    EXPECT_TRUE(net.upsert_edges(edges_view_t {
+        {{&triangle[0].source_id}, 1},
+        {{&triangle[0].target_id}, 1},
+        {{&triangle[0].id}, 1},
+    }));
+    EXPECT_EQ(net.edges_between(1, 2)->size(), 1ul);
+
+    // Remove a vertex
+    ustore_key_t vertex_to_remove = 2;
+    EXPECT_TRUE(net.remove_vertex(vertex_to_remove));
+    EXPECT_FALSE(*net.contains(vertex_to_remove));
+    EXPECT_EQ(net.edges_containing(vertex_to_remove)->size(), 0ul);
+    EXPECT_EQ(net.edges_between(1, vertex_to_remove)->size(), 0ul);
+    EXPECT_EQ(net.edges_between(vertex_to_remove, 1)->size(), 0ul);
+
+    // Bring back the whole graph
+    EXPECT_TRUE(net.upsert_edges(edges(triangle)));
+    EXPECT_TRUE(*net.contains(vertex_to_remove));
+    EXPECT_EQ(net.edges_containing(vertex_to_remove)->size(), 2ul);
+    EXPECT_EQ(net.edges_between(1, vertex_to_remove)->size(), 1ul);
+    EXPECT_EQ(net.edges_between(vertex_to_remove, 1)->size(), 0ul);
 }
 
 /**
- * Fills document collection with info about Alice, Bob and Carl,
- * sampling it later in a form of a table, using both low-level APIs,
- * and higher-level compile-time C++ meta-programming abstractions.
+ * Tries to make a transaction on a graph, that must fail to `commit`.
+ * Creates a "wedge": A-B-C. If a transaction changes the B-C edge,
+ * while A-B is updated externally, the commit will fail.
  */
-TEST(db, docs_table) {
-    using json_t = nlohmann::json;
+/**
+ * Repeated edges must be deduplicated, even if the engine merges the updates
+ * into the neighborhoods lazily, instead of reading them first.
+ */
+TEST(db, graph_upsert_repeated_edges) {
+
     database_t db;
     EXPECT_TRUE(db.open(config().c_str()));
     EXPECT_TRUE(db.clear());
 
-    // Inject basic data
-    docs_collection_t collection = db.main<docs_collection_t>();
-    auto json_alice = R"( { "person": "Alice", "age": 27, "height": 1 } )"_json.dump();
-    auto json_bob = R"( { "person": "Bob", "age": "27", "weight": 2 } )"_json.dump();
-    auto json_carl = R"( { "person": "Carl", "age": 24 } )"_json.dump();
-    collection[1] = json_alice.c_str();
-    collection[2] = json_bob.c_str();
-    collection[3] = json_carl.c_str();
-    M_EXPECT_EQ_JSON(*collection[1].value(), json_alice.c_str());
-    M_EXPECT_EQ_JSON(*collection[2].value(), json_bob.c_str());
-
-    // Just column names
-    {
-        auto maybe_fields = collection[1].gist();
-        auto fields = *maybe_fields;
+    graph_collection_t net = db.main<graph_collection_t>();
+    std::vector<edge_t> repeated {
+        {1, 3, 10},
+        {1, 2, 9},
+        {1, 3, 10},
+        {2, 1, 11},
+    };
+    EXPECT_TRUE(net.upsert_edges(edges(repeated)));
+    EXPECT_TRUE(net.upsert_edges(edges(repeated)));
 
-        std::vector<std::string> parsed;
-        for (auto field : fields)
-            parsed.emplace_back(field.data());
+    EXPECT_EQ(*net.degree(1), 3u);
+    EXPECT_EQ(*net.degree(1, ustore_vertex_source_k), 2u);
+    EXPECT_EQ(*net.degree(2), 2u);
+    EXPECT_EQ(*net.degree(3), 1u);
 
-        EXPECT_NE(std::find(parsed.begin(), parsed.end(), "/person"), parsed.end());
-        EXPECT_NE(std::find(parsed.begin(), parsed.end(), "/height"), parsed.end());
-        EXPECT_NE(std::find(parsed.begin(), parsed.end(), "/age"), parsed.end());
-        EXPECT_EQ(std::find(parsed.begin(), parsed.end(), "/weight"), parsed.end());
-    }
+    auto neighbors = net.neighbors(1, ustore_vertex_source_k).throw_or_release();
+    EXPECT_EQ(neighbors.size(), 2);
+    EXPECT_EQ(neighbors[0], 2);
+    EXPECT_EQ(neighbors[1], 3);
+}
 
-    // Single cell
-    {
-        auto header = table_header().with<std::uint32_t>("age");
-        auto maybe_table = collection[1].gather(header);
-        auto table = *maybe_table;
-        auto col0 = table.column<0>();
+TEST(db, graph_upsert_bulk) {
 
-        EXPECT_EQ(col0[0].value, 27);
-        EXPECT_FALSE(col0[0].converted);
-    }
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
 
-    // Single row
-    {
-        auto header = table_header() //
-                          .with<std::uint32_t>("age")
-                          .with<std::int32_t>("age")
-                          .with<std::string_view>("age");
+    graph_collection_t net = db.main<graph_collection_t>();
+    EXPECT_TRUE(net.upsert_edge(edge_t {1, 2, 9}));
 
-        auto maybe_table = collection[1].gather(header);
-        auto table = *maybe_table;
-        auto col0 = table.column<0>();
-        auto col1 = table.column<1>();
-        auto col2 = table.column<2>();
+    // Bulk upserts sort and group the relations, so repetitions and existing edges must be merged away
+    std::vector<edge_t> unsorted {{3, 1, 12}, {1, 3, 10}, {-5, 1, 11}, {1, 3, 10}, {1, 2, 9}, {1, 2, 13}};
+    auto view = edges(unsorted);
+    arena_t arena(db);
+    status_t status;
+    ustore_collection_t collection = ustore_collection_main_k;
+    ustore_graph_upsert_edges_t graph_upsert_edges {};
+    graph_upsert_edges.db = db;
+    graph_upsert_edges.error = status.member_ptr();
+    graph_upsert_edges.arena = arena.member_ptr();
+    graph_upsert_edges.options = ustore_option_write_bulk_k;
+    graph_upsert_edges.tasks_count = unsorted.size();
+    graph_upsert_edges.collections = &collection;
+    graph_upsert_edges.edges_ids = view.edge_ids.begin().get();
+    graph_upsert_edges.edges_stride = view.edge_ids.stride();
+    graph_upsert_edges.sources_ids = view.source_ids.begin().get();
+    graph_upsert_edges.sources_stride = view.source_ids.stride();
+    graph_upsert_edges.targets_ids = view.target_ids.begin().get();
+    graph_upsert_edges.targets_stride = view.target_ids.stride();
+    ustore_graph_upsert_edges(&graph_upsert_edges);
+    EXPECT_TRUE(status);
 
-        EXPECT_EQ(col0[0].value, 27);
-        EXPECT_FALSE(col0[0].converted);
-        EXPECT_EQ(col1[0].value, 27);
-        EXPECT_TRUE(col1[0].converted);
-        EXPECT_STREQ(col2[0].value.data(), "27");
-        EXPECT_TRUE(col2[0].converted);
-    }
+    EXPECT_EQ(*net.degree(1), 5u);
+    EXPECT_EQ(*net.degree(1, ustore_vertex_source_k), 3u);
+    EXPECT_EQ(*net.degree(2), 2u);
+    EXPECT_EQ(*net.degree(-5), 1u);
+    EXPECT_EQ(net.edges_between(1, 2)->size(), 2u);
 
-    // Single column
-    {
-        auto header = table_header().with<std::int32_t>("age");
-        auto maybe_table = collection[{1, 2, 3, 123456}].gather(header);
-        auto table = *maybe_table;
-        auto col0 = table.column<0>();
+    auto incoming = net.edges_containing(1, ustore_vertex_target_k).throw_or_release();
+    EXPECT_EQ(incoming.size(), 2u);
+    EXPECT_EQ(incoming[0].source_id, -5);
+    EXPECT_EQ(incoming[1].source_id, 3);
+}
 
-        EXPECT_EQ(col0[0].value, 27);
-        EXPECT_EQ(col0[1].value, 27);
-        EXPECT_TRUE(col0[1].converted);
-        EXPECT_EQ(col0[2].value, 24);
-    }
+TEST(db, graph_edge_attributes) {
 
-    // Single strings column
-    {
-        auto header = table_header().with<std::string_view>("age");
-        auto maybe_table = collection[{1, 2, 3, 123456}].gather(header);
-        auto table = *maybe_table;
-        auto col0 = table.column<0>();
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
 
-        EXPECT_STREQ(col0[0].value.data(), "27");
-        EXPECT_TRUE(col0[0].converted);
-        EXPECT_STREQ(col0[1].value.data(), "27");
-        EXPECT_STREQ(col0[2].value.data(), "24");
-    }
+    graph_collection_t net = db.main<graph_collection_t>();
+    std::vector<edge_t> weighted {{1, 2, 10}, {1, 3, 11}, {3, 1, 12}};
+    std::vector<ustore_float_t> weights {0.5f, 2.f, 4.f};
+    std::vector<std::int64_t> timestamps {100, 200, 300};
+    auto weights_column = strided_range(weights).immutable();
+    EXPECT_TRUE(net.upsert_edges(edges(weighted), weights_column, strided_range(timestamps).immutable()));
+
+    // Outgoing edges come first, and the attributes follow them
+    auto attributes = net.edges_attributes(1).throw_or_release();
+    ASSERT_EQ(attributes.weights.size(), 3u);
+    EXPECT_EQ(attributes.weights[0], 0.5f);
+    EXPECT_EQ(attributes.weights[1], 2.f);
+    EXPECT_EQ(attributes.weights[2], 4.f);
+    EXPECT_EQ(attributes.timestamps[2], 300);
+    EXPECT_EQ(net.edges_attributes(3, ustore_vertex_target_k)->timestamps[0], 200);
+
+    // Upserts without attributes keep the old ones, and new edges get the defaults
+    EXPECT_TRUE(net.upsert_edges(edges(std::vector<edge_t> {{1, 2, 10}, {1, 4, 13}})));
+    attributes = net.edges_attributes(1, ustore_vertex_source_k).throw_or_release();
+    ASSERT_EQ(attributes.weights.size(), 3u);
+    EXPECT_EQ(attributes.weights[0], 0.5f);
+    EXPECT_EQ(attributes.weights[2], 1.f);
+    EXPECT_EQ(attributes.timestamps[2], 0);
+
+    // Removals shift the attributes together with the relations
+    EXPECT_TRUE(net.remove_edge(edge_t {1, 2, 10}));
+    attributes = net.edges_attributes(1, ustore_vertex_source_k).throw_or_release();
+    ASSERT_EQ(attributes.weights.size(), 2u);
+    EXPECT_EQ(attributes.weights[0], 2.f);
+    EXPECT_EQ(attributes.timestamps[0], 200);
+
+    ustore_graph_csr_t csr = net.csr().throw_or_release();
+    ASSERT_EQ(csr.edges_count, 3u);
+    EXPECT_EQ(csr.weights[0], 2.f);
+    EXPECT_EQ(csr.weights[1], 1.f);
+    EXPECT_EQ(csr.weights[2], 4.f);
+
+    // Only the edges within the time window are followed
+    arena_t arena(db);
+    status_t status;
+    ustore_key_t seed = 1;
+    ustore_vertex_role_t role = ustore_vertex_source_k;
+    std::int64_t window[2] = {150, 250};
+    ustore_length_t* frontiers_offsets = nullptr;
+    ustore_key_t* frontiers = nullptr;
+    ustore_graph_traverse_t traverse {};
+    traverse.db = db;
+    traverse.error = status.member_ptr();
+    traverse.arena = arena.member_ptr();
+    traverse.collection = ustore_collection_main_k;
+    traverse.seeds_count = 1;
+    traverse.seeds = &seed;
+    traverse.seeds_stride = sizeof(ustore_key_t);
+    traverse.hops_count = 1;
+    traverse.roles = &role;
+    traverse.timestamps_window = window;
+    traverse.frontiers_offsets = &frontiers_offsets;
+    traverse.frontiers = &frontiers;
+    ustore_graph_traverse(&traverse);
+    EXPECT_TRUE(status);
+    ASSERT_EQ(frontiers_offsets[1], 1u);
+    EXPECT_EQ(frontiers[0], 3);
+}
 
-    // Multi-column
-    {
-        auto header = table_header() //
-                          .with<std::int32_t>("age")
-                          .with<std::string_view>("age")
-                          .with<std::string_view>("person")
-                          .with<float>("person")
-                          .with<std::int32_t>("height")
-                          .with<std::uint64_t>("weight");
+TEST(db, graph_transaction_watch) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    if (!db.supports_transactions())
+        return;
+    EXPECT_TRUE(db.clear());
 
-        auto maybe_table = collection[{1, 2, 3, 123456, 654321}].gather(header);
-        auto table = *maybe_table;
-        auto col0 = table.column<0>();
-        auto col1 = table.column<1>();
-        auto col2 = table.column<2>();
-        auto col3 = table.column<3>();
-        auto col4 = table.column<4>();
-        auto col5 = table.column<5>();
+    graph_collection_t net = db.main<graph_collection_t>();
+    edge_t edge_ab {'A', 'B', 19};
+    edge_t edge_bc {'B', 'C', 31};
+    EXPECT_TRUE(net.upsert_edge(edge_ab));
+    EXPECT_TRUE(net.upsert_edge(edge_bc));
 
-        EXPECT_EQ(col0[0].value, 27);
-        EXPECT_EQ(col0[1].value, 27);
-        EXPECT_TRUE(col0[1].converted);
-        EXPECT_EQ(col0[2].value, 24);
+    transaction_t txn = *db.transact();
+    graph_collection_t txn_net = txn.main<graph_collection_t>();
+    EXPECT_EQ(txn_net.degree('B'), 2);
+    EXPECT_TRUE(txn_net.remove_edge(edge_bc));
+    EXPECT_TRUE(net.remove_edge(edge_ab));
 
-        EXPECT_STREQ(col1[0].value.data(), "27");
-        EXPECT_TRUE(col1[0].converted);
-        EXPECT_STREQ(col1[1].value.data(), "27");
-        EXPECT_STREQ(col1[2].value.data(), "24");
-    }
+    EXPECT_FALSE(txn.commit());
+}
 
-    // Multi-column Type-punned exports
-    {
-        table_header_t header {{
-            field_type_t {"age", ustore_doc_field_i32_k},
-            field_type_t {"age", ustore_doc_field_str_k},
-            field_type_t {"person", ustore_doc_field_str_k},
-            field_type_t {"person", ustore_doc_field_f32_k},
-            field_type_t {"height", ustore_doc_field_i32_k},
-            field_type_t {"weight", ustore_doc_field_u64_k},
-        }};
+/**
+ * Constructs a larger graph, validating the degrees in a resulting network afterward.
+ */
+TEST(db, graph_random_fill) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
 
-        auto maybe_table = collection[{1, 2, 3, 123456, 654321}].gather(header);
-        auto table = *maybe_table;
-        auto col0 = table.column(0).as<std::int32_t>();
-        auto col1 = table.column(1).as<value_view_t>();
-        auto col2 = table.column(2).as<value_view_t>();
-        auto col3 = table.column(3).as<float>();
-        auto col4 = table.column(4).as<std::int32_t>();
-        auto col5 = table.column(5).as<std::uint64_t>();
+    graph_collection_t graph = db.main<graph_collection_t>();
 
-        EXPECT_EQ(col0[0].value, 27);
-        EXPECT_EQ(col0[1].value, 27);
-        EXPECT_TRUE(col0[1].converted);
-        EXPECT_EQ(col0[2].value, 24);
+    constexpr std::size_t vertices_count = 1000;
+    auto edges_vec = make_edges(vertices_count, 100);
+    EXPECT_TRUE(graph.upsert_edges(edges(edges_vec)));
 
-        EXPECT_STREQ(col1[0].value.c_str(), "27");
-        EXPECT_TRUE(col1[0].converted);
-        EXPECT_STREQ(col1[1].value.c_str(), "27");
-        EXPECT_STREQ(col1[2].value.c_str(), "24");
+    for (ustore_key_t vertex_id = 0; vertex_id != vertices_count; ++vertex_id) {
+        EXPECT_TRUE(graph.contains(vertex_id));
+        EXPECT_EQ(*graph.degree(vertex_id), 9u);
     }
 }
 
-#pragma region Graph Modality
+/**
+ * Inserts two edges with a shared vertex in two separate transactions.
+ * The latter insert must fail, as it depends on the preceding state of the vertex.
+ */
+TEST(db, graph_conflicting_transactions) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    if (!db.supports_transactions())
+        return;
+    EXPECT_TRUE(db.clear());
 
-edge_t make_edge(ustore_key_t edge_id, ustore_key_t v1, ustore_key_t v2) {
-    return {v1, v2, edge_id};
+    transaction_t txn = *db.transact();
+    graph_collection_t txn_net = txn.main<graph_collection_t>();
+    transaction_t txn2 = *db.transact();
+    graph_collection_t txn_net2 = txn2.main<graph_collection_t>();
+
+    edge_t edge4 {4, 5, 15};
+    edge_t edge5 {5, 6, 16};
+
+    EXPECT_TRUE(txn_net.upsert_edge(edge4));
+    EXPECT_TRUE(txn_net2.upsert_edge(edge5));
+    EXPECT_TRUE(txn.commit());
+    EXPECT_FALSE(txn2.commit());
 }
 
-std::vector<edge_t> make_edges(std::size_t vertices_count = 2, std::size_t next_connect = 1) {
-    std::vector<edge_t> es;
-    ustore_key_t edge_id = 0;
-    for (ustore_key_t vertex_id = 0; vertex_id != vertices_count; ++vertex_id) {
-        ustore_key_t connect_with = vertex_id + next_connect;
-        while (connect_with < vertices_count) {
-            edge_id++;
-            es.push_back(make_edge(edge_id, vertex_id, connect_with));
-            connect_with = connect_with + next_connect;
+/**
+ * Takes a single Graph Store and populates it with various 5-vertex shapes:
+ * a star, a pentagon, and five self-loops.
+ */
+TEST(db, graph_layering_shapes) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+
+    graph_collection_t graph = db.main<graph_collection_t>();
+
+    std::vector<ustore_key_t> vertices = {1, 2, 3, 4, 5};
+    auto over_the_vertices = [&](bool exist, size_t degree) {
+        for (auto& vertex_id : vertices) {
+            EXPECT_EQ(*graph.contains(vertex_id), exist);
+            EXPECT_EQ(*graph.degree(vertex_id), degree);
         }
-    }
-    return es;
+    };
+
+    // Before insertions, the graph is empty.
+    over_the_vertices(false, 0);
+
+    std::vector<edge_t> star {
+        {1, 3, 1},
+        {1, 4, 2},
+        {2, 4, 3},
+        {2, 5, 4},
+        {3, 5, 5},
+    };
+    std::vector<edge_t> pentagon {
+        {1, 2, 6},
+        {2, 3, 7},
+        {3, 4, 8},
+        {4, 5, 9},
+        {5, 1, 10},
+    };
+    std::vector<edge_t> self_loops {
+        {1, 1, 11},
+        {2, 2, 12},
+        {3, 3, 13},
+        {4, 4, 14},
+        {5, 5, 15},
+    };
+
+    EXPECT_TRUE(graph.upsert_edges(edges(star)));
+    over_the_vertices(true, 2u);
+    EXPECT_TRUE(graph.upsert_edges(edges(pentagon)));
+    over_the_vertices(true, 4u);
+    EXPECT_TRUE(graph.remove_edges(edges(star)));
+    over_the_vertices(true, 2u);
+    EXPECT_TRUE(graph.upsert_edges(edges(star)));
+    over_the_vertices(true, 4u);
+    EXPECT_TRUE(graph.remove_edges(edges(pentagon)));
+    over_the_vertices(true, 2u);
+    EXPECT_TRUE(graph.upsert_edges(edges(pentagon)));
+    over_the_vertices(true, 4u);
+    EXPECT_TRUE(graph.upsert_edges(edges(self_loops)));
+    over_the_vertices(true, 6u);
+    EXPECT_TRUE(graph.remove_edges(edges(star)));
+    EXPECT_TRUE(graph.remove_edges(edges(pentagon)));
+    over_the_vertices(true, 2u);
+    EXPECT_TRUE(graph.remove_edges(edges(self_loops)));
+    over_the_vertices(true, 0);
+    EXPECT_TRUE(db.clear());
+    over_the_vertices(false, 0);
 }
 
 /**
- * Upsert disconnected vertices into the graph.
+ * Tests vertex removals, which are the hardest operations on Graphs,
+ * as they trigger updates in all nodes connected to the removed one.
  */
-TEST(db, graph_upsert_vertices) {
+TEST(db, graph_remove_vertices) {
     database_t db;
     EXPECT_TRUE(db.open(config().c_str()));
     EXPECT_TRUE(db.clear());
 
-    graph_collection_t net = db.main<graph_collection_t>();
-    std::vector<ustore_key_t> vertices {1, 4, 5, 2};
-    EXPECT_TRUE(net.upsert_vertices(vertices));
+    graph_collection_t graph = db.main<graph_collection_t>();
 
-    EXPECT_TRUE(*net.contains(1));
-    EXPECT_TRUE(*net.contains(2));
-    EXPECT_TRUE(*net.contains(4));
-    EXPECT_TRUE(*net.contains(5));
+    constexpr std::size_t vertices_count = 1000;
+    auto edges_vec = make_edges(vertices_count, 100);
+    EXPECT_TRUE(graph.upsert_edges(edges(edges_vec)));
+
+    for (ustore_key_t vertex_id = 0; vertex_id != vertices_count; ++vertex_id) {
+        EXPECT_TRUE(graph.contains(vertex_id));
+        EXPECT_TRUE(*graph.contains(vertex_id));
+        EXPECT_TRUE(graph.remove_vertex(vertex_id));
+        EXPECT_TRUE(graph.contains(vertex_id));
+        EXPECT_FALSE(*graph.contains(vertex_id));
+    }
+
+    EXPECT_TRUE(graph.upsert_edges(edges(edges_vec)));
+    std::vector<ustore_key_t> vertices(vertices_count);
+    std::iota(vertices.begin(), vertices.end(), 0);
+    EXPECT_TRUE(graph.remove_vertices(vertices));
+    for (ustore_key_t vertex_id = 0; vertex_id != vertices_count; ++vertex_id) {
+        EXPECT_TRUE(graph.contains(vertex_id));
+        EXPECT_FALSE(*graph.contains(vertex_id));
+    }
 }
 
 /**
- * Upsert an edge and its member vertices into the graph.
+ * Removes just the known list of edges, checking that vertices remain
+ * in the graph, even though entirely disconnected.
  */
-TEST(db, graph_upsert_edge) {
+TEST(db, graph_remove_edges_keep_vertices) {
     database_t db;
     EXPECT_TRUE(db.open(config().c_str()));
     EXPECT_TRUE(db.clear());
 
-    graph_collection_t net = db.main<graph_collection_t>();
-    edge_t edge {1, 2, 9};
-    EXPECT_TRUE(net.upsert_edge(edge));
-    EXPECT_TRUE(*net.contains(1));
-    EXPECT_TRUE(*net.contains(2));
-    EXPECT_FALSE(*net.contains(3));
+    graph_collection_t graph = db.main<graph_collection_t>();
 
-    auto neighbors = net.neighbors(1).throw_or_release();
-    EXPECT_EQ(neighbors.size(), 1);
-    EXPECT_EQ(neighbors[0], 2);
-}
+    constexpr std::size_t vertices_count = 1000;
+    auto edges_vec = make_edges(vertices_count, 100);
+    EXPECT_TRUE(graph.upsert_edges(edges(edges_vec)));
+    EXPECT_TRUE(graph.remove_edges(edges(edges_vec)));
 
+    for (ustore_key_t vertex_id = 0; vertex_id != vertices_count; ++vertex_id) {
+        EXPECT_TRUE(graph.contains(vertex_id));
+        EXPECT_TRUE(*graph.contains(vertex_id));
+    }
+}
 /**
- * Tests "Graphs" Modality, with on of the simplest network designs - a triangle.
- * Three vertices, three connections between them, forming 3 undirected, or 6 directed edges.
- * Tests edge upsert, existence checks, degree computation, vertex removals.
+ * Add edges to the graph. Checks how many edges each vertex has.
+ * Then remove the edges, making sure that the vertices aren't
+ * connected to each other anymore.
  */
-TEST(db, graph_triangle) {
-
+TEST(db, graph_get_vertex_edges) {
     database_t db;
     EXPECT_TRUE(db.open(config().c_str()));
     EXPECT_TRUE(db.clear());
 
-    graph_collection_t net = db.main<graph_collection_t>();
-
-    // triangle
-    edge_t edge1 {1, 2, 9};
-    edge_t edge2 {2, 3, 10};
-    edge_t edge3 {3, 1, 11};
-
-    EXPECT_TRUE(net.upsert_edge(edge1));
-    EXPECT_TRUE(net.upsert_edge(edge2));
-    EXPECT_TRUE(net.upsert_edge(edge3));
-
-    auto neighbors = net.neighbors(1).throw_or_release();
-    EXPECT_EQ(neighbors.size(), 2);
-    EXPECT_EQ(neighbors[0], 2);
-    EXPECT_EQ(neighbors[1], 3);
-
-    EXPECT_TRUE(*net.contains(1));
-    EXPECT_TRUE(*net.contains(2));
-    EXPECT_FALSE(*net.contains(9));
-    EXPECT_FALSE(*net.contains(10));
-    EXPECT_FALSE(*net.contains(1000));
-
-    EXPECT_EQ(*net.degree(1), 2u);
-    EXPECT_EQ(*net.degree(2), 2u);
-    EXPECT_EQ(*net.degree(3), 2u);
-    EXPECT_EQ(*net.degree(1, ustore_vertex_source_k), 1u);
-    EXPECT_EQ(*net.degree(2, ustore_vertex_source_k), 1u);
-    EXPECT_EQ(*net.degree(3, ustore_vertex_source_k), 1u);
-
-    EXPECT_TRUE(net.edges_containing(1));
-    EXPECT_EQ(net.edges_containing(1)->size(), 2ul);
-    EXPECT_EQ(net.edges_containing(1, ustore_vertex_source_k)->size(), 1ul);
-    EXPECT_EQ(net.edges_containing(1, ustore_vertex_target_k)->size(), 1ul);
-
-    EXPECT_EQ(net.edges_containing(3, ustore_vertex_target_k)->size(), 1ul);
-    EXPECT_EQ(net.edges_containing(2, ustore_vertex_source_k)->size(), 1ul);
-    EXPECT_EQ((*net.edges_containing(3, ustore_vertex_target_k))[0].source_id, 2);
-    EXPECT_EQ((*net.edges_containing(3, ustore_vertex_target_k))[0].target_id, 3);
-    EXPECT_EQ((*net.edges_containing(3, ustore_vertex_target_k))[0].id, 10);
-    EXPECT_EQ(net.edges_between(3, 1)->size(), 1ul);
-    EXPECT_EQ(net.edges_between(1, 3)->size(), 0ul);
+    graph_collection_t graph = db.main<graph_collection_t>();
 
-    // Check scans
-    EXPECT_TRUE(net.edges());
-    {
-        std::vector<edge_t> expected_edges {edge1, edge2, edge3};
-        std::vector<edge_t> exported_edges;
+    constexpr std::size_t vertices_count = 1000;
+    auto edges_vec = make_edges(vertices_count, 100);
+    EXPECT_TRUE(graph.upsert_edges(edges(edges_vec)));
 
-        auto present_edges = *net.edges(ustore_vertex_source_k);
-        auto present_it = std::move(present_edges).begin();
-        auto count_results = 0;
-        while (!present_it.is_end()) {
-            exported_edges.push_back(*present_it);
-            ++present_it;
-            ++count_results;
-        }
-        EXPECT_EQ(count_results, 3);
-        EXPECT_EQ(exported_edges, expected_edges);
+    std::vector<edge_t> received_edges;
+    for (ustore_key_t vertex_id = 0; vertex_id != vertices_count; ++vertex_id) {
+        auto es = *graph.edges_containing(vertex_id);
+        EXPECT_EQ(es.size(), 9u);
+        for (size_t i = 0; i != es.size(); ++i)
+            received_edges.push_back(es[i]);
     }
+    EXPECT_TRUE(graph.remove_edges(edges(received_edges)));
 
-    // Remove a single edge, making sure that the nodes info persists
-    EXPECT_TRUE(net.remove_edges({
-        {{&edge1.source_id}, 1},
-        {{&edge1.target_id}, 1},
-        {{&edge1.id}, 1},
-    }));
-    EXPECT_TRUE(*net.contains(1));
-    EXPECT_TRUE(*net.contains(2));
-    EXPECT_EQ(net.edges_between(1, 2)->size(), 0ul);
-
-    // Bring that edge back
-    EXPECT_TRUE(net.upsert_edges({
-        {{&edge1.source_id}, 1},
-        {{&edge1.target_id}, 1},
-        {{&edge1.id}, 1},
-    }));
-    EXPECT_EQ(net.edges_between(1, 2)->size(), 1ul);
-
-    // Remove a vertex
-    ustore_key_t vertex_to_remove = 2;
-    EXPECT_TRUE(net.remove_vertex(vertex_to_remove));
-    EXPECT_FALSE(*net.contains(vertex_to_remove));
-    EXPECT_EQ(net.edges_containing(vertex_to_remove)->size(), 0ul);
-    EXPECT_EQ(net.edges_between(1, vertex_to_remove)->size(), 0ul);
-    EXPECT_EQ(net.edges_between(vertex_to_remove, 1)->size(), 0ul);
-
-    // Bring back the whole graph
-    EXPECT_TRUE(net.upsert_edge(edge1));
-    EXPECT_TRUE(net.upsert_edge(edge2));
-    EXPECT_TRUE(net.upsert_edge(edge3));
-    EXPECT_TRUE(*net.contains(vertex_to_remove));
-    EXPECT_EQ(net.edges_containing(vertex_to_remove)->size(), 2ul);
-    EXPECT_EQ(net.edges_between(1, vertex_to_remove)->size(), 1ul);
-    EXPECT_EQ(net.edges_between(vertex_to_remove, 1)->size(), 0ul);
+    for (ustore_key_t vertex_id = 0; vertex_id != vertices_count; ++vertex_id) {
+        EXPECT_TRUE(graph.contains(vertex_id));
+        EXPECT_TRUE(*graph.contains(vertex_id));
+        EXPECT_EQ(graph.edges_containing(vertex_id)->size(), 0);
+    }
 }
 
 /**
- * Further complicates the `graph_triangle` test by performing all of the updates
- * and lookups in batches. This detects inconsistencies in concurrent updates to
- * the underlying binary representation, triggered from a single high-level
- * graph operation.
+ * Getting the degrees of multiple vertices simultaneously.
  */
-TEST(db, graph_triangle_batch) {
-
+TEST(db, graph_degrees) {
     database_t db;
     EXPECT_TRUE(db.open(config().c_str()));
     EXPECT_TRUE(db.clear());
 
-    blobs_collection_t main = db.main();
-    graph_collection_t net = db.main<graph_collection_t>();
+    graph_collection_t graph = db.main<graph_collection_t>();
 
-    std::vector<edge_t> triangle {
-        {1, 2, 9},
-        {2, 3, 10},
-        {3, 1, 11},
-    };
+    constexpr std::size_t vertices_count = 1000;
+    std::vector<ustore_key_t> vertices(vertices_count);
+    std::iota(vertices.begin(), vertices.end(), 0);
 
-    EXPECT_TRUE(net.upsert_edges(edges(triangle)));
-    EXPECT_TRUE(*net.contains(1));
-    EXPECT_TRUE(*net.contains(2));
-    EXPECT_FALSE(*net.contains(9));
-    EXPECT_FALSE(*net.contains(10));
-    EXPECT_FALSE(*net.contains(1000));
+    auto edges_vec = make_edges(vertices_count, 100);
+    EXPECT_TRUE(graph.upsert_edges(edges(edges_vec)));
 
-    EXPECT_EQ(*net.degree(1), 2u);
-    EXPECT_EQ(*net.degree(2), 2u);
-    EXPECT_EQ(*net.degree(3), 2u);
-    EXPECT_EQ(*net.degree(1, ustore_vertex_source_k), 1u);
-    EXPECT_EQ(*net.degree(2, ustore_vertex_source_k), 1u);
-    EXPECT_EQ(*net.degree(3, ustore_vertex_source_k), 1u);
+    auto degrees = *graph.degrees(strided_range(vertices).immutable());
+    EXPECT_EQ(degrees.size(), vertices_count);
+}
 
-    EXPECT_TRUE(net.edges_containing(1));
-    EXPECT_EQ(net.edges_containing(1)->size(), 2ul);
-    EXPECT_EQ(net.edges_containing(1, ustore_vertex_source_k)->size(), 1ul);
-    EXPECT_EQ(net.edges_containing(1, ustore_vertex_target_k)->size(), 1ul);
+TEST(db, graph_degrees_and_presences) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
 
-    EXPECT_EQ(net.edges_containing(3, ustore_vertex_target_k)->size(), 1ul);
-    EXPECT_EQ(net.edges_containing(2, ustore_vertex_source_k)->size(), 1ul);
-    EXPECT_EQ((*net.edges_containing(3, ustore_vertex_target_k))[0].source_id, 2);
-    EXPECT_EQ((*net.edges_containing(3, ustore_vertex_target_k))[0].target_id, 3);
-    EXPECT_EQ((*net.edges_containing(3, ustore_vertex_target_k))[0].id, 10);
-    EXPECT_EQ(net.edges_between(3, 1)->size(), 1ul);
-    EXPECT_EQ(net.edges_between(1, 3)->size(), 0ul);
+    graph_collection_t graph = db.main<graph_collection_t>();
+    std::vector<edge_t> edges_vec {{1, 2, 10}, {1, 2, 11}, {1, 3, 12}, {3, 1, 13}};
+    EXPECT_TRUE(graph.upsert_edges(edges(edges_vec)));
 
-    // Check scans
-    EXPECT_TRUE(net.edges());
-    {
-        std::vector<edge_t> expected_edges {triangle.begin(), triangle.end()};
-        std::vector<edge_t> exported_edges;
+    arena_t arena(db);
+    status_t status;
+    ustore_key_t vertices[4] = {1, 2, 3, 4};
+    ustore_vertex_degree_t* out_degrees = nullptr;
+    ustore_vertex_degree_t* in_degrees = nullptr;
+
+    ustore_graph_find_degrees_t find_degrees {};
+    find_degrees.db = db;
+    find_degrees.error = status.member_ptr();
+    find_degrees.arena = arena.member_ptr();
+    find_degrees.tasks_count = 4;
+    find_degrees.vertices = vertices;
+    find_degrees.vertices_stride = sizeof(ustore_key_t);
+    find_degrees.out_degrees = &out_degrees;
+    find_degrees.in_degrees = &in_degrees;
+    ustore_graph_find_degrees(&find_degrees);
+    EXPECT_TRUE(status);
+    EXPECT_EQ(std::vector<ustore_vertex_degree_t>(out_degrees, out_degrees + 3),
+              (std::vector<ustore_vertex_degree_t> {3, 0, 1}));
+    EXPECT_EQ(std::vector<ustore_vertex_degree_t>(in_degrees, in_degrees + 3),
+              (std::vector<ustore_vertex_degree_t> {1, 2, 1}));
+    EXPECT_EQ(out_degrees[3], ustore_vertex_degree_missing_k);
+
+    EXPECT_TRUE(*graph.contains_edge(1, 2));
+    EXPECT_TRUE(*graph.contains_edge(3, 1));
+    EXPECT_FALSE(*graph.contains_edge(2, 1));
+    EXPECT_FALSE(*graph.contains_edge(4, 1));
+
+    std::vector<ustore_key_t> sources {1, 1, 1, 3};
+    std::vector<ustore_key_t> targets {2, 2, 3, 1};
+    std::vector<ustore_key_t> edge_ids {11, 12, 12, 13};
+    auto presences = *graph.contains_edges(strided_range(sources).immutable(),
+                                           strided_range(targets).immutable(),
+                                           strided_range(edge_ids).immutable());
+    EXPECT_TRUE(presences[0]);
+    EXPECT_FALSE(presences[1]);
+    EXPECT_TRUE(presences[2]);
+    EXPECT_TRUE(presences[3]);
+}
 
-        auto present_edges = *net.edges(ustore_vertex_source_k);
-        auto present_it = std::move(present_edges).begin();
-        size_t count_results = 0ul;
-        while (!present_it.is_end()) {
-            exported_edges.push_back(*present_it);
-            ++present_it;
-            ++count_results;
-        }
-        EXPECT_EQ(count_results, triangle.size());
-        EXPECT_EQ(exported_edges, expected_edges);
-    }
+TEST(db, graph_neighbors) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
 
-    // Remove a single edge, making sure that the nodes info persists
-    EXPECT_TRUE(net.remove_edges(edges_view_t {
-        {{&triangle[0].source_id}, 1},
-        {{&triangle[0].target_id}, 1},
-        {{&triangle[0].id}, 1},
-    }));
-    EXPECT_TRUE(*net.contains(1));
-    EXPECT_TRUE(*net.contains(2));
-    EXPECT_EQ(net.edges_between(1, 2)->size(), 0ul);
+    graph_collection_t graph = db.main<graph_collection_t>();
+    edge_t edge1 {1, 1, 17};
+    edge_t edge2 {1, 2, 15};
+    edge_t edge3 {2, 3, 16};
 
-    // Bring that edge back
-    EXPECT_TRUE(net.upsert_edges(edges_view_t {
-        {{&triangle[0].source_id}, 1},
-        {{&triangle[0].target_id}, 1},
-        {{&triangle[0].id}, 1},
-    }));
-    EXPECT_EQ(net.edges_between(1, 2)->size(), 1ul);
+    EXPECT_TRUE(graph.upsert_edge(edge1));
+    EXPECT_TRUE(graph.upsert_edge(edge2));
+    EXPECT_TRUE(graph.upsert_edge(edge3));
 
-    // Remove a vertex
-    ustore_key_t vertex_to_remove = 2;
-    EXPECT_TRUE(net.remove_vertex(vertex_to_remove));
-    EXPECT_FALSE(*net.contains(vertex_to_remove));
-    EXPECT_EQ(net.edges_containing(vertex_to_remove)->size(), 0ul);
-    EXPECT_EQ(net.edges_between(1, vertex_to_remove)->size(), 0ul);
-    EXPECT_EQ(net.edges_between(vertex_to_remove, 1)->size(), 0ul);
+    auto neighbors = graph.neighbors(1).throw_or_release();
+    EXPECT_EQ(neighbors.size(), 2);
+    EXPECT_EQ(neighbors[0], 1);
+    EXPECT_EQ(neighbors[1], 2);
 
-    // Bring back the whole graph
-    EXPECT_TRUE(net.upsert_edges(edges(triangle)));
-    EXPECT_TRUE(*net.contains(vertex_to_remove));
-    EXPECT_EQ(net.edges_containing(vertex_to_remove)->size(), 2ul);
-    EXPECT_EQ(net.edges_between(1, vertex_to_remove)->size(), 1ul);
-    EXPECT_EQ(net.edges_between(vertex_to_remove, 1)->size(), 0ul);
+    neighbors = graph.neighbors(2).throw_or_release();
+    EXPECT_EQ(neighbors.size(), 2);
+    EXPECT_EQ(neighbors[0], 1);
+    EXPECT_EQ(neighbors[1], 3);
 }
 
 /**
- * Tries to make a transaction on a graph, that must fail to `commit`.
- * Creates a "wedge": A-B-C. If a transaction changes the B-C edge,
- * while A-B is updated externally, the commit will fail.
+ * Neighborhoods of high-degree vertices are stored compressed,
+ * but must be updated and exported just like the small ones.
  */
-TEST(db, graph_transaction_watch) {
+TEST(db, graph_supernode) {
     database_t db;
     EXPECT_TRUE(db.open(config().c_str()));
-    if (!db.supports_transactions())
-        return;
     EXPECT_TRUE(db.clear());
 
-    graph_collection_t net = db.main<graph_collection_t>();
-    edge_t edge_ab {'A', 'B', 19};
-    edge_t edge_bc {'B', 'C', 31};
-    EXPECT_TRUE(net.upsert_edge(edge_ab));
-    EXPECT_TRUE(net.upsert_edge(edge_bc));
+    graph_collection_t graph = db.main<graph_collection_t>();
 
-    transaction_t txn = *db.transact();
-    graph_collection_t txn_net = txn.main<graph_collection_t>();
-    EXPECT_EQ(txn_net.degree('B'), 2);
-    EXPECT_TRUE(txn_net.remove_edge(edge_bc));
-    EXPECT_TRUE(net.remove_edge(edge_ab));
+    // Spans several blocks, mixing dense, sparse and undefined edge IDs
+    constexpr std::size_t spokes_count = 1000;
+    std::vector<edge_t> spokes;
+    for (ustore_key_t spoke = 1; spoke <= static_cast<ustore_key_t>(spokes_count); ++spoke)
+        spokes.push_back(edge_t {0, spoke * 7, spoke % 3 ? spoke : ustore_default_edge_id_k});
+    EXPECT_TRUE(graph.upsert_edges(edges(spokes)));
+    EXPECT_EQ(*graph.degree(0), spokes_count);
+    EXPECT_EQ(*graph.degree(0, ustore_vertex_source_k), spokes_count);
+
+    auto outgoing = *graph.edges_containing(0, ustore_vertex_source_k);
+    EXPECT_EQ(outgoing.size(), spokes_count);
+    for (std::size_t i = 0; i != spokes_count; ++i) {
+        EXPECT_EQ(outgoing[i].target_id, spokes[i].target_id);
+        EXPECT_EQ(outgoing[i].id, spokes[i].id);
+    }
 
-    EXPECT_FALSE(txn.commit());
+    // Patch the compressed neighborhood in both directions
+    EXPECT_TRUE(graph.upsert_edge(edge_t {3, 0, 1}));
+    EXPECT_TRUE(graph.remove_edge(spokes[500]));
+    EXPECT_EQ(*graph.degree(0), spokes_count);
+    EXPECT_EQ(graph.edges_between(0, spokes[500].target_id)->size(), 0u);
+    EXPECT_EQ(graph.edges_between(0, spokes[501].target_id)->size(), 1u);
+    EXPECT_EQ(graph.edges_between(3, 0)->size(), 1u);
+
+    // Removing the hub disconnects all of the spokes
+    EXPECT_TRUE(graph.remove_vertex(0));
+    EXPECT_FALSE(*graph.contains(0));
+    EXPECT_EQ(*graph.degree(3), 0u);
+    EXPECT_EQ(*graph.degree(spokes[0].target_id), 0u);
 }
 
-/**
- * Constructs a larger graph, validating the degrees in a resulting network afterward.
- */
-TEST(db, graph_random_fill) {
+TEST(db, graph_supernode_chunks) {
     database_t db;
     EXPECT_TRUE(db.open(config().c_str()));
     EXPECT_TRUE(db.clear());
 
     graph_collection_t graph = db.main<graph_collection_t>();
 
-    constexpr std::size_t vertices_count = 1000;
-    auto edges_vec = make_edges(vertices_count, 100);
+    // Large enough to be split into several chunks, inserted in batches
+    constexpr std::size_t spokes_count = 20000;
+    constexpr std::size_t batch_size = 1000;
+    std::vector<edge_t> spokes;
+    for (ustore_key_t spoke = 1; spoke <= static_cast<ustore_key_t>(spokes_count); ++spoke)
+        spokes.push_back(edge_t {0, spoke, spoke});
+    for (std::size_t i = 0; i != spokes_count; i += batch_size) {
+        std::vector<edge_t> batch {spokes.begin() + i, spokes.begin() + i + batch_size};
+        EXPECT_TRUE(graph.upsert_edges(edges(batch)));
+    }
+    EXPECT_EQ(*graph.degree(0), spokes_count);
+    EXPECT_EQ(graph.number_of_vertices(), spokes_count + 1);
+
+    auto outgoing = *graph.edges_containing(0, ustore_vertex_source_k);
+    EXPECT_EQ(outgoing.size(), spokes_count);
+    EXPECT_EQ(outgoing[0].target_id, spokes.front().target_id);
+    EXPECT_EQ(outgoing[spokes_count - 1].target_id, spokes.back().target_id);
+
+    // Patches touch individual chunks
+    constexpr ustore_key_t middle = static_cast<ustore_key_t>(spokes_count / 2);
+    EXPECT_TRUE(graph.upsert_edge(edge_t {middle, 0, 1}));
+    EXPECT_TRUE(graph.remove_edge(spokes[100]));
+    EXPECT_TRUE(graph.remove_edge(spokes[15000]));
+    EXPECT_EQ(*graph.degree(0), spokes_count - 1);
+    EXPECT_EQ(*graph.degree(0, ustore_vertex_target_k), 1u);
+    EXPECT_EQ(graph.edges_between(0, spokes[100].target_id)->size(), 0u);
+    EXPECT_EQ(graph.edges_between(0, spokes[101].target_id)->size(), 1u);
+    EXPECT_EQ(graph.edges_between(middle, 0)->size(), 1u);
+
+    ustore_graph_csr_t csr = graph.csr().throw_or_release();
+    EXPECT_EQ(csr.vertices_count, spokes_count + 1);
+    EXPECT_EQ(csr.edges_count, spokes_count - 1);
+    EXPECT_EQ(csr.vertices[0], 0);
+
+    // Removing the hub also removes its chunks
+    EXPECT_TRUE(graph.remove_vertex(0));
+    EXPECT_FALSE(*graph.contains(0));
+    EXPECT_EQ(*graph.degree(spokes[0].target_id), 0u);
+    EXPECT_EQ(graph.number_of_vertices(), spokes_count);
+    EXPECT_EQ(db.main().keys().size(), spokes_count);
+
+    // Chunks live under reserved keys
+    EXPECT_FALSE(graph.upsert_edge(edge_t {ustore_vertex_id_min_k - 1, 1, 1}));
+}
+
+TEST(db, graph_traverse) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
+    EXPECT_TRUE(db.clear());
+
+    graph_collection_t graph = db.main<graph_collection_t>();
+    std::vector<edge_t> edges_vec {{1, 2, 10}, {1, 3, 11}, {2, 4, 12}, {3, 4, 13}, {4, 1, 14}, {4, 5, 15}};
     EXPECT_TRUE(graph.upsert_edges(edges(edges_vec)));
 
-    for (ustore_key_t vertex_id = 0; vertex_id != vertices_count; ++vertex_id) {
-        EXPECT_TRUE(graph.contains(vertex_id));
-        EXPECT_EQ(*graph.degree(vertex_id), 9u);
-    }
+    arena_t arena(db);
+    status_t status;
+    ustore_key_t seeds[2] = {1, 1};
+    ustore_vertex_role_t role = ustore_vertex_source_k;
+    ustore_length_t* frontiers_offsets = nullptr;
+    ustore_key_t* frontiers = nullptr;
+    ustore_length_t* edges_offsets = nullptr;
+    ustore_key_t* followed_edges = nullptr;
+
+    ustore_graph_traverse_t traverse {};
+    traverse.db = db;
+    traverse.error = status.member_ptr();
+    traverse.arena = arena.member_ptr();
+    traverse.collection = ustore_collection_main_k;
+    traverse.seeds_count = 2;
+    traverse.seeds = seeds;
+    traverse.seeds_stride = sizeof(ustore_key_t);
+    traverse.hops_count = 3;
+    traverse.roles = &role;
+    traverse.dedup = ustore_traversal_dedup_visited_k;
+    traverse.frontiers_offsets = &frontiers_offsets;
+    traverse.frontiers = &frontiers;
+    traverse.edges_offsets = &edges_offsets;
+    traverse.edges = &followed_edges;
+
+    // Going back to the seed on the third hop doesn't expand it again
+    ustore_graph_traverse(&traverse);
+    EXPECT_TRUE(status);
+    std::vector<ustore_length_t> offsets {frontiers_offsets, frontiers_offsets + 4};
+    EXPECT_EQ(offsets, (std::vector<ustore_length_t> {0, 2, 3, 4}));
+    std::vector<ustore_key_t> reached {frontiers, frontiers + 4};
+    EXPECT_EQ(reached, (std::vector<ustore_key_t> {2, 3, 4, 5}));
+    EXPECT_EQ(edges_offsets[3], 6u);
+    EXPECT_EQ(followed_edges[0], 1);
+    EXPECT_EQ(followed_edges[1], 2);
+    EXPECT_EQ(followed_edges[2], 10);
+
+    // Without deduplication, every path is followed, limited to one edge per vertex
+    traverse.dedup = ustore_traversal_dedup_none_k;
+    traverse.fanout_limit = 1;
+    ustore_graph_traverse(&traverse);
+    EXPECT_TRUE(status);
+    offsets = {frontiers_offsets, frontiers_offsets + 4};
+    EXPECT_EQ(offsets, (std::vector<ustore_length_t> {0, 2, 4, 6}));
+    reached = {frontiers, frontiers + 6};
+    EXPECT_EQ(reached, (std::vector<ustore_key_t> {2, 2, 4, 4, 1, 1}));
 }
 
-/**
- * Inserts two edges with a shared vertex in two separate transactions.
- * The latter insert must fail, as it depends on the preceding state of the vertex.
- */
-TEST(db, graph_conflicting_transactions) {
+TEST(db, graph_csr) {
     database_t db;
     EXPECT_TRUE(db.open(config().c_str()));
-    if (!db.supports_transactions())
+    EXPECT_TRUE(db.clear());
+
+    graph_collection_t graph = db.main<graph_collection_t>();
+    EXPECT_TRUE(graph.upsert_edge(edge_t {1, 2, 15}));
+    EXPECT_TRUE(graph.upsert_edge(edge_t {1, 3, 16}));
+    EXPECT_TRUE(graph.upsert_edge(edge_t {3, 2, 17}));
+    EXPECT_TRUE(graph.upsert_vertex(4));
+
+    auto check_outgoing = [](ustore_graph_csr_t const& csr) {
+        EXPECT_EQ(csr.vertices_count, 4u);
+        EXPECT_EQ(csr.edges_count, 3u);
+        EXPECT_EQ(csr.vertices[0], 1);
+        EXPECT_EQ(csr.vertices[3], 4);
+        std::vector<ustore_size_t> offsets {csr.offsets, csr.offsets + csr.vertices_count + 1};
+        EXPECT_EQ(offsets, (std::vector<ustore_size_t> {0, 2, 2, 3, 3}));
+        std::vector<ustore_size_t> neighbors {csr.neighbors, csr.neighbors + csr.edges_count};
+        EXPECT_EQ(neighbors, (std::vector<ustore_size_t> {1, 2, 1}));
+        EXPECT_EQ(csr.edges_ids[2], 17);
+    };
+
+    ustore_graph_csr_t outgoing = graph.csr().throw_or_release();
+    check_outgoing(outgoing);
+
+    ustore_graph_csr_t undirected = graph.csr(ustore_vertex_role_any_k).throw_or_release();
+    EXPECT_EQ(undirected.edges_count, 6u);
+    EXPECT_EQ(undirected.offsets[2] - undirected.offsets[1], 2u);
+
+    // Batched lookups export the same triplets as `ustore_graph_find_edges()`
+    arena_t arena(db);
+    status_t status;
+    ustore_key_t vertices[3] = {3, 5, 1};
+    ustore_vertex_degree_t* degrees = nullptr;
+    ustore_key_t* edges = nullptr;
+    ustore_graph_find_csr_edges_t find {};
+    find.error = status.member_ptr();
+    find.arena = arena.member_ptr();
+    find.csr = &outgoing;
+    find.role = ustore_vertex_source_k;
+    find.tasks_count = 3;
+    find.vertices = vertices;
+    find.vertices_stride = sizeof(ustore_key_t);
+    find.degrees_per_vertex = &degrees;
+    find.edges_per_vertex = &edges;
+    ustore_graph_find_csr_edges(&find);
+    EXPECT_TRUE(status);
+    EXPECT_EQ(degrees[0], 1u);
+    EXPECT_EQ(degrees[1], ustore_vertex_degree_missing_k);
+    EXPECT_EQ(degrees[2], 2u);
+    EXPECT_EQ((std::vector<ustore_key_t> {edges, edges + 9}),
+              (std::vector<ustore_key_t> {3, 2, 17, 1, 2, 15, 1, 3, 16}));
+
+    if (!path())
         return;
+    std::string csr_path = fmt::format("{}/graph.csr", path());
+    ustore_graph_csr_t saved = graph.csr(ustore_vertex_source_k, csr_path.c_str()).throw_or_release();
+    check_outgoing(saved);
+    ustore_graph_free_csr(&saved);
+
+    ustore_graph_open_csr_t open {};
+    open.error = status.member_ptr();
+    open.path = csr_path.c_str();
+    open.csr = &saved;
+    ustore_graph_open_csr(&open);
+    EXPECT_TRUE(status);
+    check_outgoing(saved);
+    ustore_graph_free_csr(&saved);
+}
+
+TEST(db, graph_analytics) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
     EXPECT_TRUE(db.clear());
 
-    transaction_t txn = *db.transact();
-    graph_collection_t txn_net = txn.main<graph_collection_t>();
-    transaction_t txn2 = *db.transact();
-    graph_collection_t txn_net2 = txn2.main<graph_collection_t>();
+    // Two triangles joined by a bridge, a separate pair, and an isolated vertex
+    graph_collection_t graph = db.main<graph_collection_t>();
+    std::vector<edge_t> edges_vec {
+        {1, 2, 100},
+        {2, 3, 101},
+        {3, 1, 102},
+        {4, 5, 103},
+        {5, 6, 104},
+        {6, 4, 105},
+        {3, 4, 106},
+        {10, 11, 107},
+    };
+    EXPECT_TRUE(graph.upsert_edges(edges(edges_vec)));
+    EXPECT_TRUE(graph.upsert_vertex(20));
+    ustore_graph_csr_t csr = graph.csr(ustore_vertex_role_any_k).throw_or_release();
+    ASSERT_EQ(csr.vertices_count, 9u);
 
-    edge_t edge4 {4, 5, 15};
-    edge_t edge5 {5, 6, 16};
+    arena_t arena(db);
+    status_t status;
 
-    EXPECT_TRUE(txn_net.upsert_edge(edge4));
-    EXPECT_TRUE(txn_net2.upsert_edge(edge5));
-    EXPECT_TRUE(txn.commit());
-    EXPECT_FALSE(txn2.commit());
+    ustore_key_t* components = nullptr;
+    ustore_graph_components_t graph_components {};
+    graph_components.error = status.member_ptr();
+    graph_components.arena = arena.member_ptr();
+    graph_components.csr = &csr;
+    graph_components.labels = &components;
+    ustore_graph_components(&graph_components);
+    EXPECT_TRUE(status);
+    EXPECT_EQ((std::vector<ustore_key_t> {components, components + 9}),
+              (std::vector<ustore_key_t> {1, 1, 1, 1, 1, 1, 10, 10, 20}));
+
+    ustore_key_t sources[2] = {1, 42};
+    ustore_length_t* levels = nullptr;
+    ustore_graph_bfs_t graph_bfs {};
+    graph_bfs.error = status.member_ptr();
+    graph_bfs.arena = arena.member_ptr();
+    graph_bfs.csr = &csr;
+    graph_bfs.sources_count = 2;
+    graph_bfs.sources = sources;
+    graph_bfs.sources_stride = sizeof(ustore_key_t);
+    graph_bfs.levels = &levels;
+    ustore_graph_bfs(&graph_bfs);
+    EXPECT_TRUE(status);
+    ustore_length_t const m = ustore_length_missing_k;
+    EXPECT_EQ((std::vector<ustore_length_t> {levels, levels + 9}),
+              (std::vector<ustore_length_t> {0, 1, 1, 2, 3, 3, m, m, m}));
+
+    ustore_key_t* communities = nullptr;
+    ustore_float_t modularity = 0;
+    ustore_graph_louvain_t graph_louvain {};
+    graph_louvain.error = status.member_ptr();
+    graph_louvain.arena = arena.member_ptr();
+    graph_louvain.csr = &csr;
+    graph_louvain.labels = &communities;
+    graph_louvain.modularity = &modularity;
+    ustore_graph_louvain(&graph_louvain);
+    EXPECT_TRUE(status);
+    EXPECT_EQ((std::vector<ustore_key_t> {communities, communities + 9}),
+              (std::vector<ustore_key_t> {1, 1, 1, 4, 4, 4, 10, 10, 20}));
+    EXPECT_GT(modularity, 0.4f);
+
+    // Scores sum up to one and can be persisted next to the graph
+    ustore_float_t* scores = nullptr;
+    ustore_graph_pagerank_t graph_pagerank {};
+    graph_pagerank.db = db;
+    graph_pagerank.error = status.member_ptr();
+    graph_pagerank.arena = arena.member_ptr();
+    graph_pagerank.csr = &csr;
+    graph_pagerank.scores = &scores;
+    if (db.supports_named_collections()) {
+        blobs_collection_t ranks = *db["ranks"];
+        graph_pagerank.output_collection = ranks.member_ptr();
+        ustore_graph_pagerank(&graph_pagerank);
+        EXPECT_TRUE(status);
+        value_view_t persisted = *ranks[3].value();
+        ASSERT_EQ(persisted.size(), sizeof(ustore_float_t));
+        EXPECT_EQ(std::memcmp(persisted.data(), scores + 2, sizeof(ustore_float_t)), 0);
+        EXPECT_TRUE(db.drop("ranks"));
+    }
+    else {
+        ustore_graph_pagerank(&graph_pagerank);
+        EXPECT_TRUE(status);
+    }
+    EXPECT_NEAR(std::accumulate(scores, scores + 9, 0.0), 1.0, 1e-3);
+    EXPECT_GT(scores[2], scores[0]);
+    EXPECT_FLOAT_EQ(scores[6], scores[7]);
 }
 
+#pragma region Vectors Modality
+
 /**
- * Takes a single Graph Store and populates it with various 5-vertex shapes:
- * a star, a pentagon, and five self-loops.
+ * Tests "Vector Modality", including both CRUD and more analytical approximate search
+ * operations with just three distinctly different vectors in R3 space with Cosine metric.
  */
-TEST(db, graph_layering_shapes) {
+TEST(db, vectors) {
     database_t db;
     EXPECT_TRUE(db.open(config().c_str()));
     EXPECT_TRUE(db.clear());
 
-    graph_collection_t graph = db.main<graph_collection_t>();
-
-    std::vector<ustore_key_t> vertices = {1, 2, 3, 4, 5};
-    auto over_the_vertices = [&](bool exist, size_t degree) {
-        for (auto& vertex_id : vertices) {
-            EXPECT_EQ(*graph.contains(vertex_id), exist);
-            EXPECT_EQ(*graph.degree(vertex_id), degree);
-        }
+    constexpr std::size_t dims_k = 3;
+    ustore_key_t keys[3] = {'a', 'b', 'c'};
+    float vectors[3][dims_k] = {
+        {0.3, 0.1, 0.2},
+        {0.35, 0.1, 0.2},
+        {-0.1, 0.2, 0.5},
     };
 
-    // Before insertions, the graph is empty.
-    over_the_vertices(false, 0);
+    arena_t arena(db);
+    status_t status;
 
-    std::vector<edge_t> star {
-        {1, 3, 1},
-        {1, 4, 2},
-        {2, 4, 3},
-        {2, 5, 4},
-        {3, 5, 5},
-    };
-    std::vector<edge_t> pentagon {
-        {1, 2, 6},
-        {2, 3, 7},
-        {3, 4, 8},
-        {4, 5, 9},
-        {5, 1, 10},
-    };
-    std::vector<edge_t> self_loops {
-        {1, 1, 11},
-        {2, 2, 12},
-        {3, 3, 13},
-        {4, 4, 14},
-        {5, 5, 15},
-    };
+    float* vector_first_begin = &vectors[0][0];
+    ustore_vectors_write_t write {};
+    write.db = db;
+    write.arena = arena.member_ptr();
+    write.error = status.member_ptr();
+    write.dimensions = dims_k;
+    write.keys = keys;
+    write.keys_stride = sizeof(ustore_key_t);
+    write.vectors_starts = (ustore_bytes_cptr_t*)&vector_first_begin;
+    write.vectors_stride = sizeof(float) * dims_k;
+    write.tasks_count = 3;
+    ustore_vectors_write(&write);
+    EXPECT_TRUE(status);
 
-    EXPECT_TRUE(graph.upsert_edges(edges(star)));
-    over_the_vertices(true, 2u);
-    EXPECT_TRUE(graph.upsert_edges(edges(pentagon)));
-    over_the_vertices(true, 4u);
-    EXPECT_TRUE(graph.remove_edges(edges(star)));
-    over_the_vertices(true, 2u);
-    EXPECT_TRUE(graph.upsert_edges(edges(star)));
-    over_the_vertices(true, 4u);
-    EXPECT_TRUE(graph.remove_edges(edges(pentagon)));
-    over_the_vertices(true, 2u);
-    EXPECT_TRUE(graph.upsert_edges(edges(pentagon)));
-    over_the_vertices(true, 4u);
-    EXPECT_TRUE(graph.upsert_edges(edges(self_loops)));
-    over_the_vertices(true, 6u);
-    EXPECT_TRUE(graph.remove_edges(edges(star)));
-    EXPECT_TRUE(graph.remove_edges(edges(pentagon)));
-    over_the_vertices(true, 2u);
-    EXPECT_TRUE(graph.remove_edges(edges(self_loops)));
-    over_the_vertices(true, 0);
+    ustore_length_t max_results = 2;
+    ustore_length_t* found_results = nullptr;
+    ustore_key_t* found_keys = nullptr;
+    ustore_float_t* found_distances = nullptr;
+    ustore_vectors_search_t search {};
+    search.db = db;
+    search.arena = arena.member_ptr();
+    search.error = status.member_ptr();
+    search.dimensions = dims_k;
+    search.tasks_count = 1;
+    search.match_counts_limits = &max_results;
+    search.queries_starts = (ustore_bytes_cptr_t*)&vector_first_begin;
+    search.queries_stride = sizeof(float) * dims_k;
+    search.match_counts = &found_results;
+    search.match_keys = &found_keys;
+    search.match_metrics = &found_distances;
+    search.metric = ustore_vector_metric_cos_k;
+    ustore_vectors_search(&search);
+    EXPECT_TRUE(status);
+
+    EXPECT_EQ(found_results[0], max_results);
+    EXPECT_EQ(found_keys[0], ustore_key_t('a'));
+    EXPECT_EQ(found_keys[1], ustore_key_t('b'));
+}
+
+/**
+ * Reads compact vectors into a dense matrix, converting the scalars
+ * and zeroing the rows of missing keys.
+ */
+TEST(db, vectors_read) {
+    database_t db;
+    EXPECT_TRUE(db.open(config().c_str()));
     EXPECT_TRUE(db.clear());
-    over_the_vertices(false, 0);
+
+    constexpr std::size_t dims_k = 4;
+    ustore_key_t keys[2] = {1, 2};
+    float vectors[2][dims_k] = {
+        {0.5f, -1.5f, 2.f, 300.f},
+        {1.f, 2.f, 3.f, 4.f},
+    };
+
+    arena_t arena(db);
+    status_t status;
+
+    float* vector_first_begin = &vectors[0][0];
+    ustore_vectors_write_t write {};
+    write.db = db;
+    write.arena = arena.member_ptr();
+    write.error = status.member_ptr();
+    write.dimensions = dims_k;
+    write.keys = keys;
+    write.keys_stride = sizeof(ustore_key_t);
+    write.vectors_starts = (ustore_bytes_cptr_t*)&vector_first_begin;
+    write.vectors_stride = sizeof(float) * dims_k;
+    write.tasks_count = 2;
+    ustore_vectors_write(&write);
+    EXPECT_TRUE(status);
+
+    ustore_key_t requested_keys[3] = {2, 3, 1};
+    ustore_octet_t* presences = nullptr;
+    ustore_length_t* offsets = nullptr;
+    ustore_byte_t* matrix = nullptr;
+    ustore_vectors_read_t read {};
+    read.db = db;
+    read.arena = arena.member_ptr();
+    read.error = status.member_ptr();
+    read.dimensions = dims_k;
+    read.scalar_type = ustore_vector_scalar_f32_k;
+    read.keys = requested_keys;
+    read.keys_stride = sizeof(ustore_key_t);
+    read.tasks_count = 3;
+    read.presences = &presences;
+    read.offsets = &offsets;
+    read.vectors = &matrix;
+    ustore_vectors_read(&read);
+    EXPECT_TRUE(status);
+
+    EXPECT_EQ(presences[0], 0b101);
+    EXPECT_EQ(offsets[1], sizeof(float) * dims_k);
+    EXPECT_EQ(offsets[3], sizeof(float) * dims_k * 3);
+    float const* floats = reinterpret_cast<float const*>(matrix);
+    EXPECT_EQ(std::memcmp(floats, vectors[1], sizeof(float) * dims_k), 0);
+    EXPECT_EQ(floats[dims_k], 0.f);
+    EXPECT_EQ(std::memcmp(floats + dims_k * 2, vectors[0], sizeof(float) * dims_k), 0);
+
+    // Convert into rounded and saturated integers
+    read.scalar_type = ustore_vector_scalar_i8_k;
+    ustore_vectors_read(&read);
+    EXPECT_TRUE(status);
+    std::int8_t const* integers = reinterpret_cast<std::int8_t const*>(matrix);
+    EXPECT_EQ(integers[0], 1);
+    EXPECT_EQ(integers[dims_k * 2 + 1], -2);
+    EXPECT_EQ(integers[dims_k * 2 + 3], 127);
 }
 
 /**
- * Tests vertex removals, which are the hardest operations on Graphs,
- * as they trigger updates in all nodes connected to the removed one.
+ * Builds the index from many batches of vectors, and checks, that every
+ * stored vector is the closest match for itself.
  */
-TEST(db, graph_remove_vertices) {
+TEST(db, vectors_index) {
     database_t db;
     EXPECT_TRUE(db.open(config().c_str()));
     EXPECT_TRUE(db.clear());
 
-    graph_collection_t graph = db.main<graph_collection_t>();
+    constexpr std::size_t dims_k = 16;
+    constexpr std::size_t count_k = 1000;
+    constexpr std::size_t batch_k = 100;
+    std::vector<ustore_key_t> keys(count_k);
+    std::vector<float> vectors(count_k * dims_k);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::srand(42);
+    for (auto& scalar : vectors)
+        scalar = float(std::rand() % 200) / 100.f - 1.f;
 
-    constexpr std::size_t vertices_count = 1000;
-    auto edges_vec = make_edges(vertices_count, 100);
-    EXPECT_TRUE(graph.upsert_edges(edges(edges_vec)));
+    arena_t arena(db);
+    status_t status;
 
-    for (ustore_key_t vertex_id = 0; vertex_id != vertices_count; ++vertex_id) {
-        EXPECT_TRUE(graph.contains(vertex_id));
-        EXPECT_TRUE(*graph.contains(vertex_id));
-        EXPECT_TRUE(graph.remove_vertex(vertex_id));
-        EXPECT_TRUE(graph.contains(vertex_id));
-        EXPECT_FALSE(*graph.contains(vertex_id));
+    for (std::size_t batch_begin = 0; batch_begin != count_k; batch_begin += batch_k) {
+        float* vector_first_begin = vectors.data() + batch_begin * dims_k;
+        ustore_vectors_write_t write {};
+        write.db = db;
+        write.arena = arena.member_ptr();
+        write.error = status.member_ptr();
+        write.dimensions = dims_k;
+        write.keys = keys.data() + batch_begin;
+        write.keys_stride = sizeof(ustore_key_t);
+        write.vectors_starts = (ustore_bytes_cptr_t*)&vector_first_begin;
+        write.vectors_stride = sizeof(float) * dims_k;
+        write.tasks_count = batch_k;
+        write.metric = ustore_vector_metric_l2_k;
+        write.index_connectivity = 8;
+        ustore_vectors_write(&write);
+        EXPECT_TRUE(status);
     }
 
-    EXPECT_TRUE(graph.upsert_edges(edges(edges_vec)));
-    std::vector<ustore_key_t> vertices(vertices_count);
-    std::iota(vertices.begin(), vertices.end(), 0);
-    EXPECT_TRUE(graph.remove_vertices(vertices));
-    for (ustore_key_t vertex_id = 0; vertex_id != vertices_count; ++vertex_id) {
-        EXPECT_TRUE(graph.contains(vertex_id));
-        EXPECT_FALSE(*graph.contains(vertex_id));
+    // Negative keys are reserved for the index
+    ustore_key_t negative_key = -1;
+    float* vector_first_begin = vectors.data();
+    status_t negative_status;
+    ustore_vectors_write_t write {};
+    write.db = db;
+    write.arena = arena.member_ptr();
+    write.error = negative_status.member_ptr();
+    write.dimensions = dims_k;
+    write.keys = &negative_key;
+    write.vectors_starts = (ustore_bytes_cptr_t*)&vector_first_begin;
+    write.tasks_count = 1;
+    write.metric = ustore_vector_metric_l2_k;
+    ustore_vectors_write(&write);
+    EXPECT_FALSE(negative_status);
+
+    ustore_length_t max_results = 4;
+    for (std::size_t i = 0; i != count_k; i += 10) {
+        ustore_length_t* found_results = nullptr;
+        ustore_key_t* found_keys = nullptr;
+        ustore_float_t* found_distances = nullptr;
+        float* query_begin = vectors.data() + i * dims_k;
+        ustore_vectors_search_t search {};
+        search.db = db;
+        search.arena = arena.member_ptr();
+        search.error = status.member_ptr();
+        search.dimensions = dims_k;
+        search.tasks_count = 1;
+        search.match_counts_limits = &max_results;
+        search.queries_starts = (ustore_bytes_cptr_t*)&query_begin;
+        search.match_counts = &found_results;
+        search.match_keys = &found_keys;
+        search.match_metrics = &found_distances;
+        search.metric = ustore_vector_metric_l2_k;
+        ustore_vectors_search(&search);
+        EXPECT_TRUE(status);
+
+        EXPECT_EQ(found_results[0], max_results);
+        EXPECT_EQ(found_keys[0], keys[i]);
+        EXPECT_EQ(found_distances[0], 0.f);
+        for (std::size_t j = 1; j != found_results[0]; ++j)
+            EXPECT_LE(found_distances[j - 1], found_distances[j]);
     }
 }
 
 /**
- * Removes just the known list of edges, checking that vertices remain
- * in the graph, even though entirely disconnected.
+ * Quantization scales every vector separately, so large magnitudes
+ * neither overflow, nor lose the ordering of close vectors.
  */
-TEST(db, graph_remove_edges_keep_vertices) {
+TEST(db, vectors_unnormalized) {
     database_t db;
     EXPECT_TRUE(db.open(config().c_str()));
     EXPECT_TRUE(db.clear());
 
-    graph_collection_t graph = db.main<graph_collection_t>();
+    constexpr std::size_t dims_k = 8;
+    ustore_key_t keys[3] = {1, 2, 3};
+    float vectors[3][dims_k] {};
+    for (std::size_t i = 0; i != dims_k; ++i)
+        vectors[0][i] = 1000.f, vectors[1][i] = 1010.f, vectors[2][i] = -500.f;
 
-    constexpr std::size_t vertices_count = 1000;
-    auto edges_vec = make_edges(vertices_count, 100);
-    EXPECT_TRUE(graph.upsert_edges(edges(edges_vec)));
-    EXPECT_TRUE(graph.remove_edges(edges(edges_vec)));
+    arena_t arena(db);
+    status_t status;
 
-    for (ustore_key_t vertex_id = 0; vertex_id != vertices_count; ++vertex_id) {
-        EXPECT_TRUE(graph.contains(vertex_id));
-        EXPECT_TRUE(*graph.contains(vertex_id));
-    }
+    float* vector_first_begin = &vectors[0][0];
+    ustore_vectors_write_t write {};
+    write.db = db;
+    write.arena = arena.member_ptr();
+    write.error = status.member_ptr();
+    write.dimensions = dims_k;
+    write.keys = keys;
+    write.keys_stride = sizeof(ustore_key_t);
+    write.vectors_starts = (ustore_bytes_cptr_t*)&vector_first_begin;
+    write.vectors_stride = sizeof(float) * dims_k;
+    write.tasks_count = 3;
+    write.metric = ustore_vector_metric_l2_k;
+    ustore_vectors_write(&write);
+    EXPECT_TRUE(status);
+
+    ustore_length_t max_results = 3;
+    ustore_length_t* found_results = nullptr;
+    ustore_key_t* found_keys = nullptr;
+    ustore_float_t* found_distances = nullptr;
+    ustore_vectors_search_t search {};
+    search.db = db;
+    search.arena = arena.member_ptr();
+    search.error = status.member_ptr();
+    search.dimensions = dims_k;
+    search.tasks_count = 1;
+    search.match_counts_limits = &max_results;
+    search.queries_starts = (ustore_bytes_cptr_t*)&vector_first_begin;
+    search.match_counts = &found_results;
+    search.match_keys = &found_keys;
+    search.match_metrics = &found_distances;
+    search.metric = ustore_vector_metric_l2_k;
+    ustore_vectors_search(&search);
+    EXPECT_TRUE(status);
+
+    EXPECT_EQ(found_results[0], max_results);
+    EXPECT_EQ(found_keys[0], 1);
+    EXPECT_EQ(found_keys[1], 2);
+    EXPECT_EQ(found_keys[2], 3);
+    EXPECT_EQ(found_distances[0], 0.f);
+    EXPECT_NEAR(found_distances[1], 28.28427f, 0.5f); // sqrt(8 * 10^2)
 }
+
 /**
- * Add edges to the graph. Checks how many edges each vertex has.
- * Then remove the edges, making sure that the vertices aren't
- * connected to each other anymore.
+ * Quantized copies, packed into a companion collection, must be scanned
+ * with the same results, as the index nodes they mirror.
  */
-TEST(db, graph_get_vertex_edges) {
+TEST(db, vectors_packed) {
     database_t db;
     EXPECT_TRUE(db.open(config().c_str()));
+    if (!db.supports_named_collections())
+        return;
     EXPECT_TRUE(db.clear());
 
-    graph_collection_t graph = db.main<graph_collection_t>();
+    constexpr std::size_t dims_k = 16;
+    constexpr std::size_t count_k = 1000;
+    std::vector<ustore_key_t> keys(count_k);
+    std::vector<float> vectors(count_k * dims_k);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::srand(42);
+    for (auto& scalar : vectors)
+        scalar = float(std::rand() % 200) / 100.f - 1.f;
 
-    constexpr std::size_t vertices_count = 1000;
-    auto edges_vec = make_edges(vertices_count, 100);
-    EXPECT_TRUE(graph.upsert_edges(edges(edges_vec)));
+    blobs_collection_t packed = *db.create("vectors_packed");
+    ustore_collection_t packed_collection = packed;
+    arena_t arena(db);
+    status_t status;
 
-    std::vector<edge_t> received_edges;
-    for (ustore_key_t vertex_id = 0; vertex_id != vertices_count; ++vertex_id) {
-        auto es = *graph.edges_containing(vertex_id);
-        EXPECT_EQ(es.size(), 9u);
-        for (size_t i = 0; i != es.size(); ++i)
-            received_edges.push_back(es[i]);
-    }
-    EXPECT_TRUE(graph.remove_edges(edges(received_edges)));
+    float* vector_first_begin = vectors.data();
+    ustore_vectors_write_t write {};
+    write.db = db;
+    write.arena = arena.member_ptr();
+    write.error = status.member_ptr();
+    write.dimensions = dims_k;
+    write.keys = keys.data();
+    write.keys_stride = sizeof(ustore_key_t);
+    write.vectors_starts = (ustore_bytes_cptr_t*)&vector_first_begin;
+    write.vectors_stride = sizeof(float) * dims_k;
+    write.tasks_count = count_k;
+    write.metric = ustore_vector_metric_l2_k;
+    write.packed_collections = &packed_collection;
+    ustore_vectors_write(&write);
+    EXPECT_TRUE(status);
 
-    for (ustore_key_t vertex_id = 0; vertex_id != vertices_count; ++vertex_id) {
-        EXPECT_TRUE(graph.contains(vertex_id));
-        EXPECT_TRUE(*graph.contains(vertex_id));
-        EXPECT_EQ(graph.edges_containing(vertex_id)->size(), 0);
+    // The index is built for "l2", so "cos" queries fall back to exhaustive scans
+    constexpr std::size_t queries_k = 10;
+    ustore_length_t max_results = 4;
+    std::vector<ustore_key_t> found_per_layout[2];
+    for (std::size_t layout = 0; layout != 2; ++layout) {
+        ustore_length_t* found_results = nullptr;
+        ustore_key_t* found_keys = nullptr;
+        ustore_float_t* found_distances = nullptr;
+        float* query_begin = vectors.data();
+        ustore_vectors_search_t search {};
+        search.db = db;
+        search.arena = arena.member_ptr();
+        search.error = status.member_ptr();
+        search.dimensions = dims_k;
+        search.tasks_count = queries_k;
+        search.match_counts_limits = &max_results;
+        search.queries_starts = (ustore_bytes_cptr_t*)&query_begin;
+        search.queries_stride = sizeof(float) * dims_k;
+        search.match_counts = &found_results;
+        search.match_keys = &found_keys;
+        search.match_metrics = &found_distances;
+        search.metric = ustore_vector_metric_cos_k;
+        search.metric_threshold = -1;
+        search.packed_collections = layout ? &packed_collection : nullptr;
+        ustore_vectors_search(&search);
+        EXPECT_TRUE(status);
+
+        for (std::size_t i = 0; i != queries_k; ++i) {
+            EXPECT_EQ(found_results[i], max_results);
+            EXPECT_EQ(found_keys[i * max_results], keys[i]);
+        }
+        found_per_layout[layout].assign(found_keys, found_keys + queries_k * max_results);
     }
+    EXPECT_EQ(found_per_layout[0], found_per_layout[1]);
 }
 
 /**
- * Getting the degrees of multiple vertices simultaneously.
+ * Vectors, written as plain binary values, have no index and no quantized copies,
+ * so the search compares the originals in full precision.
  */
-TEST(db, graph_degrees) {
+TEST(db, vectors_without_index) {
     database_t db;
     EXPECT_TRUE(db.open(config().c_str()));
     EXPECT_TRUE(db.clear());
 
-    graph_collection_t graph = db.main<graph_collection_t>();
+    constexpr std::size_t dims_k = 20;
+    ustore_key_t keys[3] = {1, 2, 3};
+    float vectors[3][dims_k] {};
+    for (std::size_t i = 0; i != dims_k; ++i)
+        vectors[0][i] = 1.f, vectors[1][i] = 0.5f, vectors[2][i] = -1.f;
 
-    constexpr std::size_t vertices_count = 1000;
-    std::vector<ustore_key_t> vertices(vertices_count);
-    std::iota(vertices.begin(), vertices.end(), 0);
+    arena_t arena(db);
+    status_t status;
 
-    auto edges_vec = make_edges(vertices_count, 100);
-    EXPECT_TRUE(graph.upsert_edges(edges(edges_vec)));
+    ustore_bytes_cptr_t values = reinterpret_cast<ustore_bytes_cptr_t>(&vectors[0][0]);
+    ustore_length_t length = sizeof(float) * dims_k;
+    ustore_length_t offsets[3] = {0, length, length * 2};
+    ustore_write_t write {};
+    write.db = db;
+    write.error = status.member_ptr();
+    write.tasks_count = 3;
+    write.keys = keys;
+    write.keys_stride = sizeof(ustore_key_t);
+    write.values = &values;
+    write.offsets = offsets;
+    write.offsets_stride = sizeof(ustore_length_t);
+    write.lengths = &length;
+    ustore_write(&write);
+    EXPECT_TRUE(status);
 
-    auto degrees = *graph.degrees(strided_range(vertices).immutable());
-    EXPECT_EQ(degrees.size(), vertices_count);
+    float query[dims_k];
+    std::fill_n(query, dims_k, 0.6f);
+    float* query_begin = query;
+    ustore_length_t max_results = 2;
+    ustore_length_t* found_results = nullptr;
+    ustore_key_t* found_keys = nullptr;
+    ustore_float_t* found_distances = nullptr;
+    ustore_vectors_search_t search {};
+    search.db = db;
+    search.arena = arena.member_ptr();
+    search.error = status.member_ptr();
+    search.dimensions = dims_k;
+    search.tasks_count = 1;
+    search.match_counts_limits = &max_results;
+    search.queries_starts = (ustore_bytes_cptr_t*)&query_begin;
+    search.match_counts = &found_results;
+    search.match_keys = &found_keys;
+    search.match_metrics = &found_distances;
+    search.metric = ustore_vector_metric_l2_k;
+    ustore_vectors_search(&search);
+    EXPECT_TRUE(status);
+
+    EXPECT_EQ(found_results[0], max_results);
+    EXPECT_EQ(found_keys[0], 2);
+    EXPECT_EQ(found_keys[1], 1);
+    EXPECT_NEAR(found_distances[0], 0.4472136f, 1e-4); // sqrt(20 * 0.1^2)
 }
 
-TEST(db, graph_neighbors) {
+/**
+ * Batches of exhaustive queries are grouped by collection and answered in a single pass
+ * over blocks of 4096 vectors, split between threads. With more vectors than a block,
+ * and limits from a single match to more than a collection holds, every query must get
+ * the same matches, as a brute-force comparison, in its own region of the outputs.
+ */
+TEST(db, vectors_exhaustive_batch) {
     database_t db;
     EXPECT_TRUE(db.open(config().c_str()));
     EXPECT_TRUE(db.clear());
 
-    graph_collection_t graph = db.main<graph_collection_t>();
-    edge_t edge1 {1, 1, 17};
-    edge_t edge2 {1, 2, 15};
-    edge_t edge3 {2, 3, 16};
+    constexpr std::size_t dims_k = 16;
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+    auto random_vectors = [&](std::size_t count) {
+        std::vector<float> vectors(count * dims_k);
+        for (float& scalar : vectors)
+            scalar = distribution(generator);
+        return vectors;
+    };
 
-    EXPECT_TRUE(graph.upsert_edge(edge1));
-    EXPECT_TRUE(graph.upsert_edge(edge2));
-    EXPECT_TRUE(graph.upsert_edge(edge3));
+    arena_t arena(db);
+    status_t status;
+    ustore_length_t const length = sizeof(float) * dims_k;
+    auto write_vectors = [&](ustore_collection_t collection, std::vector<float> const& vectors) {
+        std::size_t count = vectors.size() / dims_k;
+        std::vector<ustore_key_t> keys(count);
+        std::iota(keys.begin(), keys.end(), 0);
+        std::vector<ustore_length_t> offsets(count);
+        for (std::size_t i = 0; i != count; ++i)
+            offsets[i] = static_cast<ustore_length_t>(i * length);
+
+        ustore_bytes_cptr_t values = reinterpret_cast<ustore_bytes_cptr_t>(vectors.data());
+        ustore_write_t write {};
+        write.db = db;
+        write.error = status.member_ptr();
+        write.arena = arena.member_ptr();
+        write.tasks_count = count;
+        write.collections = &collection;
+        write.keys = keys.data();
+        write.keys_stride = sizeof(ustore_key_t);
+        write.values = &values;
+        write.offsets = offsets.data();
+        write.offsets_stride = sizeof(ustore_length_t);
+        write.lengths = &length;
+        ustore_write(&write);
+        EXPECT_TRUE(status);
+    };
 
-    auto neighbors = graph.neighbors(1).throw_or_release();
-    EXPECT_EQ(neighbors.size(), 2);
-    EXPECT_EQ(neighbors[0], 1);
-    EXPECT_EQ(neighbors[1], 2);
+    // Queries alternate between two collections, if named ones are supported
+    std::vector<float> main_vectors = random_vectors(2 * 4096 + 300);
+    std::vector<float> other_vectors = random_vectors(4096 + 17);
+    ustore_collection_t main = db.main();
+    ustore_collection_t other = main;
+    if (db.supports_named_collections())
+        other = *db["other"];
+    write_vectors(main, main_vectors);
+    if (other != main)
+        write_vectors(other, other_vectors);
+    else
+        other_vectors = main_vectors;
 
-    neighbors = graph.neighbors(2).throw_or_release();
-    EXPECT_EQ(neighbors.size(), 2);
-    EXPECT_EQ(neighbors[0], 1);
-    EXPECT_EQ(neighbors[1], 3);
-}
+    constexpr std::size_t queries_count = 6;
+    std::array<ustore_length_t, queries_count> limits {1, 7, 64, 100, 3, 5000};
+    std::array<ustore_collection_t, queries_count> collections {main, other, main, other, main, other};
+    std::vector<float> queries = random_vectors(limits.size());
 
-#pragma region Vectors Modality
+    ustore_length_t* found_counts = nullptr;
+    ustore_length_t* found_offsets = nullptr;
+    ustore_key_t* found_keys = nullptr;
+    ustore_float_t* found_distances = nullptr;
+    ustore_bytes_cptr_t queries_begin = reinterpret_cast<ustore_bytes_cptr_t>(queries.data());
+    ustore_vectors_search_t search {};
+    search.db = db;
+    search.arena = arena.member_ptr();
+    search.error = status.member_ptr();
+    search.dimensions = dims_k;
+    search.tasks_count = limits.size();
+    search.collections = collections.data();
+    search.collections_stride = sizeof(ustore_collection_t);
+    search.match_counts_limits = limits.data();
+    search.match_counts_limits_stride = sizeof(ustore_length_t);
+    search.queries_starts = &queries_begin;
+    search.queries_stride = length;
+    search.match_counts = &found_counts;
+    search.match_offsets = &found_offsets;
+    search.match_keys = &found_keys;
+    search.match_metrics = &found_distances;
+    search.metric = ustore_vector_metric_l2_k;
+    ustore_vectors_search(&search);
+    EXPECT_TRUE(status);
+
+    for (std::size_t task_idx = 0; task_idx != limits.size(); ++task_idx) {
+        std::vector<float> const& vectors = collections[task_idx] == main ? main_vectors : other_vectors;
+        float const* query = queries.data() + task_idx * dims_k;
+        std::vector<std::pair<float, ustore_key_t>> expected(vectors.size() / dims_k);
+        for (std::size_t i = 0; i != expected.size(); ++i) {
+            float sum = 0;
+            for (std::size_t dim = 0; dim != dims_k; ++dim) {
+                float difference = vectors[i * dims_k + dim] - query[dim];
+                sum += difference * difference;
+            }
+            expected[i] = {std::sqrt(sum), static_cast<ustore_key_t>(i)};
+        }
+        std::sort(expected.begin(), expected.end());
+        expected.resize(std::min<std::size_t>(expected.size(), limits[task_idx]));
+
+        ASSERT_EQ(found_counts[task_idx], expected.size());
+        ustore_length_t offset = found_offsets[task_idx];
+        for (std::size_t i = 0; i != expected.size(); ++i) {
+            EXPECT_EQ(found_keys[offset + i], expected[i].second) << task_idx << ":" << i;
+            EXPECT_NEAR(found_distances[offset + i], expected[i].first, 1e-4) << task_idx << ":" << i;
+        }
+    }
+    EXPECT_TRUE(db.clear());
+}
 
 /**
- * Tests "Vector Modality", including both CRUD and more analytical approximate search
- * operations with just three distinctly different vectors in R3 space with Cosine metric.
+ * Bounded priority queues keep the highest priority entries in order. Inserting into
+ * the middle of a full queue must shift the tail by one slot, dropping just the last entry.
  */
-TEST(db, vectors) {
+TEST(db, vectors_limited_priority_queue) {
+    std::array<int, 4> buffer {};
+    limited_priority_queue_gt<int> queue(buffer.data(), buffer.data() + buffer.size());
+    auto contents = [&] { return std::vector<int>(queue.begin(), queue.end()); };
+    using ints_t = std::vector<int>;
+
+    // Growing into the free capacity
+    EXPECT_TRUE(queue.push(20));
+    EXPECT_TRUE(queue.push(40));
+    EXPECT_TRUE(queue.push(30));
+    EXPECT_EQ(contents(), (ints_t {40, 30, 20}));
+    EXPECT_TRUE(queue.push(10));
+    EXPECT_EQ(contents(), (ints_t {40, 30, 20, 10}));
+
+    // Full queue, inserting into the middle, the front and past the end
+    EXPECT_TRUE(queue.push(25));
+    EXPECT_EQ(contents(), (ints_t {40, 30, 25, 20}));
+    EXPECT_TRUE(queue.push(50));
+    EXPECT_EQ(contents(), (ints_t {50, 40, 30, 25}));
+    EXPECT_FALSE(queue.push(5));
+    EXPECT_EQ(contents(), (ints_t {50, 40, 30, 25}));
+    EXPECT_EQ(queue.size(), buffer.size());
+}
+
+TEST(db, vectors_filtered) {
     database_t db;
     EXPECT_TRUE(db.open(config().c_str()));
+    if (!db.supports_named_collections())
+        return;
     EXPECT_TRUE(db.clear());
 
-    constexpr std::size_t dims_k = 3;
-    ustore_key_t keys[3] = {'a', 'b', 'c'};
-    float vectors[3][dims_k] = {
-        {0.3, 0.1, 0.2},
-        {0.35, 0.1, 0.2},
-        {-0.1, 0.2, 0.5},
-    };
+    // Vectors get closer to the query with every key, but only some are eligible
+    constexpr std::size_t dims_k = 8;
+    constexpr std::size_t count_k = 6;
+    ustore_key_t keys[count_k] = {1, 2, 3, 4, 5, 6};
+    float vectors[count_k][dims_k] {};
+    for (std::size_t i = 0; i != count_k; ++i)
+        std::fill_n(vectors[i], dims_k, float(i));
+
+    docs_collection_t docs = *db.create<docs_collection_t>("vectors_filtered");
+    docs[1] = R"({"tenant":"a","in_stock":true})";
+    docs[2] = R"({"tenant":"a","in_stock":true})";
+    docs[3] = R"({"tenant":"b","in_stock":true})";
+    docs[4] = R"({"tenant":"a","in_stock":false})";
+    docs[6] = R"({"tenant":"a","in_stock":true})";
+    ustore_collection_t docs_collection = docs;
 
     arena_t arena(db);
     status_t status;
@@ -2233,40 +5833,74 @@ TEST(db, vectors) {
     float* vector_first_begin = &vectors[0][0];
     ustore_vectors_write_t write {};
     write.db = db;
-    write.arena = arena.member_ptr();
     write.error = status.member_ptr();
+    write.arena = arena.member_ptr();
+    write.tasks_count = count_k;
     write.dimensions = dims_k;
+    write.metric = ustore_vector_metric_l2_k;
     write.keys = keys;
     write.keys_stride = sizeof(ustore_key_t);
     write.vectors_starts = (ustore_bytes_cptr_t*)&vector_first_begin;
     write.vectors_stride = sizeof(float) * dims_k;
-    write.tasks_count = 3;
     ustore_vectors_write(&write);
     EXPECT_TRUE(status);
 
-    ustore_length_t max_results = 2;
+    float query[dims_k];
+    std::fill_n(query, dims_k, 10.f);
+    float* query_begin = query;
+    ustore_length_t max_results = 3;
     ustore_length_t* found_results = nullptr;
     ustore_key_t* found_keys = nullptr;
     ustore_float_t* found_distances = nullptr;
+    ustore_key_t allowed_keys[4] = {5, 2, 1, 6};
+    ustore_str_view_t fields[2] = {"tenant", "in_stock"};
+    ustore_str_view_t values[2] = {"a", "true"};
+
     ustore_vectors_search_t search {};
     search.db = db;
     search.arena = arena.member_ptr();
     search.error = status.member_ptr();
     search.dimensions = dims_k;
     search.tasks_count = 1;
+    search.metric = ustore_vector_metric_l2_k;
+    search.metric_threshold = -std::numeric_limits<ustore_float_t>::max();
     search.match_counts_limits = &max_results;
-    search.queries_starts = (ustore_bytes_cptr_t*)&vector_first_begin;
-    search.queries_stride = sizeof(float) * dims_k;
+    search.queries_starts = (ustore_bytes_cptr_t*)&query_begin;
     search.match_counts = &found_results;
     search.match_keys = &found_keys;
     search.match_metrics = &found_distances;
-    search.metric = ustore_vector_metric_cos_k;
+    search.allowed_keys = allowed_keys;
+    search.allowed_keys_count = 4;
     ustore_vectors_search(&search);
     EXPECT_TRUE(status);
-
-    EXPECT_EQ(found_results[0], max_results);
-    EXPECT_EQ(found_keys[0], ustore_key_t('a'));
-    EXPECT_EQ(found_keys[1], ustore_key_t('b'));
+    EXPECT_EQ(found_results[0], 3u);
+    EXPECT_EQ(found_keys[0], 6);
+    EXPECT_EQ(found_keys[1], 5);
+    EXPECT_EQ(found_keys[2], 2);
+
+    // Key 5 has no document, so it can't match the predicate
+    search.filter_fields_count = 2;
+    search.filter_collection = docs_collection;
+    search.filter_fields = fields;
+    search.filter_fields_stride = sizeof(ustore_str_view_t);
+    search.filter_values = values;
+    search.filter_values_stride = sizeof(ustore_str_view_t);
+    ustore_vectors_search(&search);
+    EXPECT_TRUE(status);
+    EXPECT_EQ(found_results[0], 3u);
+    EXPECT_EQ(found_keys[0], 6);
+    EXPECT_EQ(found_keys[1], 2);
+    EXPECT_EQ(found_keys[2], 1);
+
+    // Without the allow-list, only the predicate remains
+    search.allowed_keys = nullptr;
+    search.allowed_keys_count = 0;
+    ustore_vectors_search(&search);
+    EXPECT_TRUE(status);
+    EXPECT_EQ(found_results[0], 3u);
+    EXPECT_EQ(found_keys[0], 6);
+    EXPECT_EQ(found_keys[1], 2);
+    EXPECT_EQ(found_keys[2], 1);
 }
 
 int main(int argc, char** argv) {